@@ -0,0 +1,1456 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/tracer.h"
+#include "../basic/metrics_exporter.h"
+#include "../basic/progress.h"
+#include "../basic/stop_watch.h"
+#include "../basic/parallel.h"
+#include "../basic/thread_pool.h"
+#include "../basic/numa.h"
+#include "../basic/perf_counters.h"
+#include "../basic/file_utils.h"
+#include "../model/point_set.h"
+#include "../model/map.h"
+#include "../model/map_io.h"
+#include "../model/map_facet_merger.h"
+#include "../model/point_set_io.h"
+#include "../model/plane_detector.h"
+#include "../method/method_global.h"
+#include "../method/hypothesis_generator.h"
+#include "../method/face_selection.h"
+#include "../method/work_unit.h"
+#include "../method/memory_planner.h"
+#include "../method/tiled_reconstruction.h"
+#include "../method/reconstruction_evaluator.h"
+#include "../model/map_validator.h"
+#include "../model/streaming_index_builder.h"
+#include "../math/linear_program_solver.h"
+#include "../renderer/offscreen_renderer.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <functional>
+
+
+// Reconstructs the tiles listed in a manifest within a single process: a number of tile jobs run
+// concurrently and share the thread budget, and a job only generates its candidate faces once their
+// predicted memory (see HypothesisGenerator::estimate()) fits the memory budget next to the running
+// ones. Each worker keeps its solver environment across its tiles. For each tile, the reconstructed
+// model and a JSON file with the metrics of the job are written.
+//
+// The manifest has a tile per line: the input point cloud, the output mesh, and optionally the metrics
+// file (by default, the output file name with '.metrics.json'). Empty lines and lines starting with '#'
+// are skipped. With '-' as the manifest, the tiles are read from the standard input as they arrive
+// (e.g., from a pipe), and the program runs until the input is closed.
+//
+// With '--checkpoint', the state of a tile is saved next to its output after each stage: the refined
+// point set ('.refined.bvg'), and the candidate faces without and with the confidences (hypothesis
+// checkpoints, '.candidates.pfhc' and '.confidences.pfhc'). The checkpoints of a tile are removed once
+// its model is saved. With '--resume', a tile starts from its latest checkpoint that can be loaded
+// (e.g., after the process was killed), and checkpoints are saved as well.
+//
+// With '--job-memory', each tile must fit the given memory (see Method::memory_budget): a tile that is
+// predicted not to fit switches to cheaper options (see MemoryPlanner), up to reconstructing it in tiles
+// of its own, and a tile that can't fit that way, or exceeds the budget after generating its candidate 
+// faces or before launching the solver, fails at once (its metrics give the reason). The options of a
+// tile are restored when it ends, but they are shared by the jobs running meanwhile.
+//
+// With '--merge-faces', the adjacent coplanar faces of the models are merged into polygons (see
+// Method::merge_coplanar_faces).
+//
+// With '--cost-scheduling', the tiles are started by their predicted cost instead of their order: the
+// most costly first, with the smaller ones packed around them within the memory budget, and the jobs
+// get shares of the threads in proportion to their costs (see CostScheduler). The tiles are prepared
+// (read, and their planes refined) a few jobs ahead to choose from.
+//
+// With '--thumbnails N', N images of each model are rendered from around it without a display (see
+// OffscreenRenderer) and saved next to it ('.view<i>.png'). A tile doesn't fail without them.
+//
+// With '--pipeline', the reading and the writing of the tiles overlap their reconstruction: a reader
+// thread reads the point sets of the next tiles ahead of the jobs (as many as the jobs, within a quarter
+// of the memory budget), and a writer thread saves the models (and their thumbnails) while the jobs go
+// on with the next tiles (as many models waiting as the jobs). With '--cost-scheduling', the tiles are
+// prepared ahead already, and only the models are saved by the writer.
+//
+// With '--regularize-planes deg', the segments with nearly identical planes (within 'deg' degrees, and
+// close offsets) share a plane for the candidate faces (see Method::plane_regularization_angle).
+//
+// With '--sample-confidences N', the confidences of the candidate faces of the segments of more than N
+// points are estimated from N of their points, and only the faces the estimates leave undecided are
+// computed from all the points (see Method::sampled_confidences).
+//
+// With '--stream-index', the index of the points of each tile (a grid, unless the kd-tree is chosen) is
+// built while they are read (see StreamingIndexBuilder), rather than once read.
+//
+// With '--evaluate', the distances of the points of each tile to its model, the unexplained points and
+// the covered area of the model are measured (see ReconstructionEvaluator) and added to its metrics.
+//
+// With '--validate', the planes of the candidate faces and the topology of each model (closed, manifold,
+// oriented, without degenerate faces, see MapValidator) are checked, the tiles failing are reported as
+// failed instead of saving their models, and the self-intersections found are added to the metrics.
+//
+// With '--pin-threads compact|scatter', the threads of the pool are pinned to their cores, and with
+// '--huge-pages thp|hugetlb' the large arrays are backed by huge pages (see Numa), e.g., on the machines
+// with several sockets.
+//
+// With '--perf-counters', the cycles, the instructions, the cache and branch misses of the threads during
+// each stage are read from the hardware performance counters (see PerfCounters, on Linux) and added to
+// the profile of the tiles, in total and per thread.
+//
+// With '--auto-policy', the face selection of each tile picks its solver, threads, reductions and
+// engine from the statistics of its problem and the time limit (see SelectionPolicy), with the models
+// of the solvers fitted to the report of the Benchmark tool given by '--policy-calibration report.csv'
+// if any. With '--solver AUTO', the solver is picked for each program (see SolverPolicy).
+//
+// With '--metrics file', the durations and the counters of the stages, the memory of the tiles, the
+// depth of the queue, the busy threads and the tiles done and failed are written to the file in the
+// OpenMetrics format every '--metrics-interval' sec. (10 by default) and at the end, e.g., for the
+// textfile collector of a Prometheus node exporter while the manifest is read from a pipe ('-').
+//
+// usage: Batch manifest [--jobs N] [--threads N] [--memory MB] [--job-memory MB] [--solver SCIP|GLPK|LPSOLVE|AUTO]
+//                       [--time-limit sec] [--fitting w] [--coverage w] [--complexity w] [--regularize-planes deg]
+//                       [--sample-confidences N] [--checkpoint] [--resume] [--merge-faces] [--cost-scheduling] [--pipeline] [--stream-index] [--thumbnails N]
+//                       [--evaluate] [--validate] [--trace trace.json] [--metrics file] [--metrics-interval sec]
+//                       [--pin-threads none|compact|scatter] [--huge-pages none|thp|hugetlb] [--perf-counters]
+//                       [--auto-policy] [--policy-calibration report.csv]
+//
+// As a worker of a distributed run, it processes a single work unit (a component of the face selection
+// program or a tile, see WorkUnit) and writes its result, '-' standing for the standard input/output
+// (the messages then go to the standard error):
+//        Batch --work-unit unit result [--threads N]
+
+
+namespace {
+
+    struct Options {
+        Options()
+            : num_jobs(0), num_threads(0), memory_budget(0.0), job_memory(0.0), solver(LinearProgramSolver::SCIP)
+            , time_limit(0.0), fitting(0.43), coverage(0.27), complexity(0.3), regularization_angle(0.0), sample_size(0), checkpoint(false), resume(false), merge_faces(false), cost_scheduling(false), pipeline(false), stream_index(false), num_thumbnails(0), evaluate(false), validate(false), perf_counters(false), auto_policy(false), metrics_interval(10.0) {}
+
+        unsigned int num_jobs;      // 0 for a job per 4 threads
+        unsigned int num_threads;   // shared by all the jobs (0 for the number of hardware threads)
+        double       memory_budget; // in bytes (0 for no limit)
+        double       job_memory;    // of each tile, in bytes (0 for no limit)
+        LinearProgramSolver::SolverName solver;
+        double       time_limit;    // of the face selection of each tile
+        double       fitting;
+        double       coverage;
+        double       complexity;
+        double       regularization_angle;  // of the near-duplicate planes snapped together, in degree (0 for none)
+        unsigned int sample_size;   // of the segments the confidences are estimated from (0 for the exact confidences)
+        bool         checkpoint;    // save the state of the tiles after each stage
+        bool         resume;        // start the tiles from their checkpoints
+        bool         merge_faces;   // merge the coplanar faces of the models
+        bool         cost_scheduling;   // start the tiles by their predicted cost (see CostScheduler)
+        bool         pipeline;      // read and write the tiles while others are reconstructed (see JobQueue)
+        bool         stream_index;  // build the index of the points while reading them
+        unsigned int num_thumbnails;    // the images rendered of each model (0 for none)
+        bool         evaluate;      // measure the distances of the points to the models
+        bool         validate;      // check the candidate faces and the topology of the models
+        bool         perf_counters; // read the hardware performance counters during the stages
+        bool         auto_policy;   // let the face selection pick how it solves (see SelectionPolicy)
+        std::string  policy_calibration;    // the Benchmark report the policy is calibrated by, empty for none
+        std::string  trace_file;    // the timeline of the jobs (see Tracer), empty for none
+        std::string  metrics_file;  // the metrics of the run (see MetricsExporter), empty for none
+        double       metrics_interval;  // between the writes of the metrics, in sec.
+    };
+
+
+    struct Tile {
+        std::string input;
+        std::string output;
+        std::string metrics;
+
+        // the checkpoints (see the usage)
+        std::string refined_file() const     { return output + ".refined.bvg"; }
+        std::string candidates_file() const  { return output + ".candidates.pfhc"; }
+        std::string confidences_file() const { return output + ".confidences.pfhc"; }
+    };
+
+
+    // the stages of a tile the checkpoints are saved after
+    enum Checkpoint { NO_CHECKPOINT, REFINED_PLANES, CANDIDATE_FACES, CONFIDENCES };
+
+    const char* checkpoint_name(Checkpoint checkpoint) {
+        switch (checkpoint) {
+        case REFINED_PLANES:    return "refined planes";
+        case CANDIDATE_FACES:   return "candidate faces";
+        case CONFIDENCES:       return "confidences";
+        default:                return "none";
+        }
+    }
+
+
+    struct Metrics {
+        Metrics()
+            : succeeded(false), resumed_from(NO_CHECKPOINT), num_points(0), num_segments(0), num_candidate_faces(0), num_result_faces(0)
+            , read_time(0), refine_time(0), admission_time(0), generate_time(0), confidence_time(0)
+            , selection_time(0), evaluation_time(0), save_time(0), thumbnail_time(0), total_time(0), predicted_cost(0), num_threads(0), process_peak_memory(0) {}
+
+        bool        succeeded;
+        std::string error;
+        Checkpoint  resumed_from;
+        std::string memory_strategy;    // see MemoryPlanner
+
+        std::size_t num_points;
+        std::size_t num_segments;
+        HypothesisGenerator::Estimate estimate;
+        std::size_t num_candidate_faces;
+        std::size_t num_result_faces;
+
+        // in sec.
+        double      read_time;
+        double      refine_time;
+        double      admission_time;     // waiting for the memory budget
+        double      generate_time;
+        double      confidence_time;
+        double      selection_time;
+        double      evaluation_time;
+        double      save_time;
+        double      thumbnail_time;
+        double      total_time;
+
+        double      predicted_cost;     // see predicted_cost()
+        unsigned int num_threads;       // the share of the job (0 for Method::num_threads)
+
+        double      process_peak_memory;    // when the job ended, in bytes
+        std::string evaluation;         // see ReconstructionEvaluator::to_json(), empty if not evaluated
+        std::string validation;         // see MapValidator::to_json(), empty if not validated
+        std::vector<Profiler::Stage> stages;
+    };
+
+
+    // The tiles of the manifest, handed out to the workers. The manifest is read while the tiles
+    // are reconstructed, so it may be a pipe.
+    class TileQueue {
+    public:
+        TileQueue() : closed_(false) {}
+
+        void push(const Tile& tile) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tiles_.push_back(tile);
+            MetricsExporter::set_gauge("polyfit_queue_depth", "", static_cast<double>(tiles_.size()));
+            ready_.notify_one();
+        }
+
+        // no more tiles will be pushed
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            ready_.notify_all();
+        }
+
+        // waits for the next tile, and returns false if the queue is closed and empty
+        bool pop(Tile& tile) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this]() { return closed_ || !tiles_.empty(); });
+            if (tiles_.empty())
+                return false;
+            tile = tiles_.front();
+            tiles_.pop_front();
+            MetricsExporter::set_gauge("polyfit_queue_depth", "", static_cast<double>(tiles_.size()));
+            return true;
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable ready_;
+        std::deque<Tile>        tiles_;
+        bool                    closed_;
+    };
+
+
+    // Admits the jobs while the sum of their predicted memory fits the budget. A job is always
+    // admitted if no other one is, so a tile larger than the budget runs alone instead of never.
+    class MemoryBudget {
+    public:
+        MemoryBudget(double budget) : budget_(budget), used_(0.0), num_admitted_(0) {}
+
+        void acquire(double bytes) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (budget_ > 0.0)
+                released_.wait(lock, [this, bytes]() { return num_admitted_ == 0 || used_ + bytes <= budget_; });
+            used_ += bytes;
+            ++num_admitted_;
+        }
+
+        void release(double bytes) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            used_ -= bytes;
+            --num_admitted_;
+            released_.notify_all();
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable released_;
+        double                  budget_;
+        double                  used_;
+        std::size_t             num_admitted_;
+    };
+
+
+    // holds the memory of a job until it ends
+    class Admission {
+    public:
+        Admission(MemoryBudget& budget, double bytes) : budget_(budget), bytes_(bytes) { budget_.acquire(bytes_); }
+        ~Admission() { budget_.release(bytes_); }
+
+    private:
+        MemoryBudget& budget_;
+        double        bytes_;
+    };
+
+
+    std::string json_string(const std::string& str) {
+        std::string result = "\"";
+        for (std::size_t i = 0; i < str.size(); ++i) {
+            char c = str[i];
+            if (c == '\"' || c == '\\')
+                result += '\\';
+            if (static_cast<unsigned char>(c) < 0x20)
+                result += ' ';
+            else
+                result += c;
+        }
+        return result + "\"";
+    }
+
+
+    bool save_metrics(const Tile& tile, const Metrics& m) {
+        std::ofstream output(tile.metrics.c_str());
+        if (output.fail())
+            return false;
+
+        output.precision(9);
+        output << "{\n";
+        output << "  \"input\": " << json_string(tile.input) << ",\n";
+        output << "  \"output\": " << json_string(tile.output) << ",\n";
+        output << "  \"succeeded\": " << (m.succeeded ? "true" : "false") << ",\n";
+        output << "  \"error\": " << json_string(m.error) << ",\n";
+        output << "  \"resumed_from\": " << json_string(checkpoint_name(m.resumed_from)) << ",\n";
+        output << "  \"memory_strategy\": " << json_string(m.memory_strategy) << ",\n";
+        output << "  \"points\": " << m.num_points << ",\n";
+        output << "  \"segments\": " << m.num_segments << ",\n";
+        output << "  \"estimate\": {\"candidate_faces\": " << m.estimate.num_candidate_faces
+            << ", \"variables\": " << m.estimate.num_variables
+            << ", \"constraints\": " << m.estimate.num_constraints
+            << ", \"peak_memory\": " << m.estimate.peak_memory << "},\n";
+        output << "  \"candidate_faces\": " << m.num_candidate_faces << ",\n";
+        output << "  \"result_faces\": " << m.num_result_faces << ",\n";
+        output << "  \"times\": {\"read\": " << m.read_time
+            << ", \"refine_planes\": " << m.refine_time
+            << ", \"admission\": " << m.admission_time
+            << ", \"generate\": " << m.generate_time
+            << ", \"confidences\": " << m.confidence_time
+            << ", \"selection\": " << m.selection_time
+            << ", \"evaluation\": " << m.evaluation_time
+            << ", \"save\": " << m.save_time
+            << ", \"thumbnails\": " << m.thumbnail_time
+            << ", \"total\": " << m.total_time << "},\n";
+        output << "  \"predicted_cost\": " << m.predicted_cost << ",\n";
+        output << "  \"threads\": " << m.num_threads << ",\n";
+        output << "  \"process_peak_memory\": " << m.process_peak_memory << ",\n";
+        if (!m.evaluation.empty())
+            output << "  \"evaluation\": " << m.evaluation << ",\n";
+        if (!m.validation.empty())
+            output << "  \"validation\": " << m.validation << ",\n";
+        output << "  \"profile\": " << Profiler::to_json(m.stages);
+        output << "}\n";
+        return !output.fail();
+    }
+
+
+    // the stages recorded by the calling thread since the 'first' one
+    std::vector<Profiler::Stage> thread_stages(std::size_t first) {
+        const std::vector<Profiler::Stage>& all = Profiler::stages();
+        std::size_t thread = Profiler::thread_index();
+        std::vector<Profiler::Stage> stages;
+        for (std::size_t i = first; i < all.size(); ++i) {
+            if (all[i].thread == thread)
+                stages.push_back(all[i]);
+        }
+        return stages;
+    }
+
+
+    // Writes a checkpoint by 'save' into a file next to 'file_name' and then renames it, so a checkpoint
+    // is either complete or missing (e.g., if the process is killed while writing it).
+    bool save_checkpoint(const std::string& file_name, const std::function<bool(const std::string&)>& save) {
+        const std::string partial = FileUtils::name_less_extension(file_name) + ".partial." + FileUtils::extension(file_name);
+        if (!save(partial)) {
+            FileUtils::delete_file(partial);
+            Logger::err("-") << "failed saving checkpoint: " << file_name << std::endl;
+            return false;
+        }
+        if (FileUtils::is_file(file_name))
+            FileUtils::delete_file(file_name);
+        if (!FileUtils::rename_file(partial, file_name)) {
+            Logger::err("-") << "failed saving checkpoint: " << file_name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+
+    // shared by the jobs (they render one after another), nil without thumbnails
+    OffscreenRenderer* thumbnail_renderer = nil;
+
+    void save_thumbnails(const Tile& tile, Map* mesh, const Options& options, Metrics& m) {
+        if (!thumbnail_renderer || options.num_thumbnails == 0)
+            return;
+        StopWatch w;
+        int num = thumbnail_renderer->render_views(mesh, nil, static_cast<int>(options.num_thumbnails), tile.output);
+        m.thumbnail_time = w.elapsed();
+        if (num < static_cast<int>(options.num_thumbnails))
+            Logger::warn("-") << "only " << num << " of " << options.num_thumbnails << " thumbnails saved: " << tile.output << std::endl;
+    }
+
+
+    void delete_checkpoints(const Tile& tile) {
+        const std::string files[] = { tile.refined_file(), tile.candidates_file(), tile.confidences_file() };
+        for (std::size_t i = 0; i < 3; ++i) {
+            if (FileUtils::is_file(files[i]))
+                FileUtils::delete_file(files[i]);
+        }
+    }
+
+
+    // the options the memory planner may change, restored when a tile ends
+    class PlannedOptions {
+    public:
+        PlannedOptions()
+            : lazy_triplet_intersection_(Method::lazy_triplet_intersection), local_hypothesis_(Method::local_hypothesis)
+            , decompose_face_selection_(Method::decompose_face_selection), downsampling_cell_size_(Method::downsampling_cell_size) {}
+        ~PlannedOptions() {
+            Method::lazy_triplet_intersection = lazy_triplet_intersection_;
+            Method::local_hypothesis = local_hypothesis_;
+            Method::decompose_face_selection = decompose_face_selection_;
+            Method::downsampling_cell_size = downsampling_cell_size_;
+        }
+
+    private:
+        bool  lazy_triplet_intersection_;
+        bool  local_hypothesis_;
+        bool  decompose_face_selection_;
+        float downsampling_cell_size_;
+    };
+
+
+    // reconstructs a tile in tiles of its own (see TiledReconstruction) as planned, returns its model (nil if it fails)
+    Map::Ptr reconstruct_tiled(const Options& options, const MemoryPlanner::Plan& plan, PointSet* pset, Metrics& m) {
+        TiledReconstruction::Parameters params;
+        params.tile_size = plan.tile_size;
+        params.selection.fitting = options.fitting;
+        params.selection.coverage = options.coverage;
+        params.selection.complexity = options.complexity;
+        params.selection.solver = options.solver;
+        params.selection.time_limit = options.time_limit;
+
+        StopWatch w;
+        Map::Ptr mesh = TiledReconstruction::reconstruct(pset, params);
+        m.selection_time = w.elapsed();
+        if (!mesh) {
+            m.error = "tiled reconstruction failed";
+            return nil;
+        }
+        if (Method::merge_coplanar_faces)
+            mesh = MapFacetMerger::merged(mesh);
+        m.num_result_faces = mesh->size_of_facets();
+        return mesh;
+    }
+
+
+    // a tile between its stages: read (or resumed) with its planes refined and its run planned (see
+    // prepare()), then reconstructed (see execute())
+    struct Job {
+        Job() : cost(0.0), num_threads(0), first_stage(0), prefetched(false) {}
+
+        Tile                 tile;
+        Metrics              m;
+        PointSet::Ptr        pset;
+        std::unique_ptr<HypothesisGenerator> hypothesis;
+        Map::Ptr             mesh;          // the candidate faces of the checkpoint resumed from, if any
+        MemoryPlanner::Plan  plan;
+        double               cost;          // predicted (see predicted_cost())
+        unsigned int         num_threads;   // the share of the job (0 for Method::num_threads)
+        std::size_t          first_stage;   // of the profiler, of the stages not in the metrics yet
+        StopWatch            watch;         // since the tile was taken
+        bool                 prefetched;    // its point set was read ahead (see reader())
+        Map::Ptr             result;        // the model waiting for the writer (see writer())
+        PointSearch_var      search;        // the index of the points built while reading them, if any
+    };
+
+
+    // A rough cost of reconstructing a tile, from the predicted size of its problem: the candidate faces
+    // (generating them and their confidences), and the binary program, whose solving grows faster than
+    // its size. Only the ratios of the costs matter (see CostScheduler).
+    double predicted_cost(const HypothesisGenerator::Estimate& estimate) {
+        const double num_variables = static_cast<double>(estimate.num_variables);
+        return static_cast<double>(estimate.num_candidate_faces) + num_variables * std::log2(num_variables + 2.0);
+    }
+
+
+    // the point set of a tile: the refined one of its checkpoint, or the input, returns false if it fails
+    bool read_tile(const Options& options, Job& job) {
+        const Tile& tile = job.tile;
+        Metrics& m = job.m;
+
+        StopWatch w;
+        PointSet::Ptr pset;
+        if (options.resume && FileUtils::is_file(tile.refined_file())) {
+            pset = PointSetIO::read(tile.refined_file());
+            if (pset && !pset->groups().empty())
+                m.resumed_from = REFINED_PLANES;
+        }
+        if (m.resumed_from == NO_CHECKPOINT) {
+            // not worth it for the points to be downsampled
+            if (options.stream_index && Method::downsampling_cell_size <= 0.0f) {
+                StreamingIndexBuilder builder(PointSearch::Backend(Method::point_search_backend), 0, Method::num_threads);
+                pset = PointSetIO::read(tile.input, builder.callback());
+                if (pset)
+                    job.search = builder.finish(pset->points());
+            }
+            else
+                pset = PointSetIO::read(tile.input);
+            if (!pset) {
+                m.error = "failed loading point cloud from file";
+                return false;
+            }
+        }
+        m.read_time = w.elapsed();
+        job.pset = pset;
+        return true;
+    }
+
+
+    // the first stages of a tile (before its candidate faces), returns false if it fails
+    bool prepare(const Options& options, Job& job) {
+        const Tile& tile = job.tile;
+        Metrics& m = job.m;
+        const bool checkpoint = options.checkpoint || options.resume;
+
+        // a tile whose read ahead failed isn't read again
+        if (!job.pset && (job.prefetched || !read_tile(options, job)))
+            return false;
+        PointSet::Ptr pset = job.pset;
+
+        StopWatch w;
+        if (m.resumed_from == NO_CHECKPOINT && pset->groups().empty())
+            PlaneDetector::detect(pset, PlaneDetector::Parameters(), Method::num_threads);
+        m.num_points = pset->num_points();
+        m.num_segments = pset->groups().size();
+        m.read_time += w.elapsed();
+        if (pset->groups().empty()) {
+            m.error = "planar segments do not exist";
+            return false;
+        }
+
+        job.hypothesis.reset(new HypothesisGenerator(pset));
+        HypothesisGenerator& hypothesis = *job.hypothesis;
+        if (job.search) {
+            hypothesis.set_point_search(job.search);
+            job.search = nil;
+        }
+        if (m.resumed_from == REFINED_PLANES) {
+            w.start();
+            // the candidate faces of the latest checkpoint (a checkpoint that fails loading is skipped)
+            if (FileUtils::is_file(tile.confidences_file())) {
+                job.mesh = hypothesis.load_checkpoint(tile.confidences_file());
+                if (job.mesh && hypothesis.ready_for_optimization(job.mesh))
+                    m.resumed_from = CONFIDENCES;
+                else
+                    job.mesh = nil;
+            }
+            if (!job.mesh && FileUtils::is_file(tile.candidates_file())) {
+                job.mesh = hypothesis.load_checkpoint(tile.candidates_file());
+                if (job.mesh)
+                    m.resumed_from = CANDIDATE_FACES;
+            }
+            m.read_time += w.elapsed();
+            Logger::out("-") << "resuming " << tile.input << " from its checkpoint: " << checkpoint_name(m.resumed_from) << std::endl;
+        }
+        else {
+            w.start();
+            hypothesis.refine_planes();
+            m.refine_time = w.elapsed();
+            if (checkpoint)
+                save_checkpoint(tile.refined_file(), [&](const std::string& file) { return PointSetIO::save(file, pset); });
+        }
+
+        // the candidate faces and the binary program are the bulk of the memory of a job, which may need
+        // cheaper options to fit the memory of a tile
+        w.start();
+        job.plan = MemoryPlanner::plan(hypothesis, pset, Method::memory_budget);
+        m.estimate = job.plan.estimate;
+        m.memory_strategy = MemoryPlanner::strategy_name(job.plan.strategy);
+        m.admission_time = w.elapsed();
+        if (!job.plan.fits()) {
+            m.error = "memory budget exceeded: " + MemoryUsage::to_string(job.plan.predicted_memory) + " predicted even with tiling";
+            return false;
+        }
+        job.cost = predicted_cost(job.plan.estimate);
+        m.predicted_cost = job.cost;
+        return true;
+    }
+
+
+    // Saves the model of a tile, or keeps it in the job for the writer if 'deferred' (see writer()), 
+    // returns false if it fails.
+    bool save_result(Job& job, const Options& options, Map* mesh, bool deferred) {
+        if (options.validate && job.m.validation.empty()) {
+            MapValidator::Report report = MapValidator::validate(mesh, true, Method::num_threads);
+            job.m.validation = report.to_json();
+            if (!report.is_valid()) {
+                job.m.error = "invalid model: " + report.summary();
+                return false;
+            }
+        }
+        if (options.evaluate && job.pset && job.m.evaluation.empty()) {
+            StopWatch w;
+            ReconstructionEvaluator::Result result = ReconstructionEvaluator::evaluate(job.pset, mesh, ReconstructionEvaluator::Parameters(), Method::num_threads);
+            job.m.evaluation = ReconstructionEvaluator::to_json(result);
+            job.m.evaluation_time = w.elapsed();
+        }
+        if (deferred) {
+            job.result = mesh;
+            return true;
+        }
+
+        Metrics& m = job.m;
+        StopWatch w;
+        bool saved = MapIO::save(job.tile.output, mesh);
+        m.save_time = w.elapsed();
+        if (!saved) {
+            m.error = "failed saving reconstructed model to file";
+            return false;
+        }
+        save_thumbnails(job.tile, mesh, options, m);
+        if (options.checkpoint || options.resume)
+            delete_checkpoints(job.tile);
+        return true;
+    }
+
+
+    // the remaining stages of a prepared tile (its memory is admitted), returns false if it fails
+    bool execute(Job& job, const Options& options, SolverSession& session, bool deferred_save) {
+        const Tile& tile = job.tile;
+        Metrics& m = job.m;
+        const bool checkpoint = options.checkpoint || options.resume;
+        PointSet::Ptr pset = job.pset;
+        HypothesisGenerator& hypothesis = *job.hypothesis;
+        Map::Ptr mesh = job.mesh;
+
+        PlannedOptions planned_options;
+        MemoryPlanner::apply(job.plan);
+
+        if (job.plan.strategy == MemoryPlanner::TILING) {
+            mesh = reconstruct_tiled(options, job.plan, pset, m);
+            return mesh && save_result(job, options, mesh, deferred_save);
+        }
+
+        StopWatch w;
+        if (m.resumed_from < CANDIDATE_FACES) {
+            w.start();
+            mesh = hypothesis.generate();
+            m.generate_time = w.elapsed();
+            if (!mesh) {
+                m.error = "failed generating candidate faces";
+                return false;
+            }
+            if (options.validate) {
+                std::size_t num_invalid = hypothesis.validate_source_planes(mesh);
+                if (num_invalid > 0) {
+                    std::ostringstream error;
+                    error << "invalid candidate faces: " << num_invalid << " faces, edges or vertices with wrong planes";
+                    m.error = error.str();
+                    return false;
+                }
+            }
+            double bytes = pset->memory_usage().total() + mesh->memory_usage().total() + hypothesis.memory_usage().total();
+            if (!MemoryPlanner::check("after generate", bytes, Method::memory_budget)) {
+                m.error = "memory budget exceeded after generating the candidate faces";
+                return false;
+            }
+            if (checkpoint) {
+                // the checkpoints of the faces refer to the points by their order
+                if (Method::reorder_points_by_groups || Method::reorder_points_spatially)
+                    save_checkpoint(tile.refined_file(), [&](const std::string& file) { return PointSetIO::save(file, pset); });
+                save_checkpoint(tile.candidates_file(), [&](const std::string& file) { return hypothesis.save_checkpoint(mesh, file); });
+            }
+        }
+        m.num_candidate_faces = mesh->size_of_facets();
+
+        if (m.resumed_from < CONFIDENCES) {
+            w.start();
+            hypothesis.compute_confidences(mesh, false);
+            m.confidence_time = w.elapsed();
+            if (checkpoint)
+                save_checkpoint(tile.confidences_file(), [&](const std::string& file) { return hypothesis.save_checkpoint(mesh, file); });
+        }
+
+        w.start();
+        const HypothesisGenerator::Adjacency& adjacency = hypothesis.extract_adjacency(mesh);
+        FaceSelection selector(pset, mesh);
+        selector.set_session(&session);
+        selector.optimize(adjacency, options.solver);
+        m.selection_time = w.elapsed();
+        if (selector.memory_budget_exceeded()) {
+            m.error = "memory budget exceeded before launching the solver";
+            return false;
+        }
+        m.num_result_faces = mesh->size_of_facets();
+        if (m.num_result_faces == 0) {
+            m.error = "optimization failed: model has no face";
+            return false;
+        }
+        if (Method::merge_coplanar_faces)
+            mesh = MapFacetMerger::merged(mesh);
+
+        return save_result(job, options, mesh, deferred_save);
+    }
+
+
+    // the pipeline of a tile (see the Example) in the order of the manifest, returns false if it fails
+    bool reconstruct(Job& job, const Options& options, SolverSession& session, MemoryBudget& budget, bool deferred_save) {
+        if (!prepare(options, job))
+            return false;
+        StopWatch w;
+        Admission admission(budget, job.plan.predicted_memory);
+        job.m.admission_time += w.elapsed();
+        return execute(job, options, session, deferred_save);
+    }
+
+
+    // the end of a job: logs it and saves its metrics
+    void finish(Job& job, bool succeeded, std::atomic<std::size_t>& num_failed) {
+        Metrics& m = job.m;
+        m.succeeded = succeeded;
+        m.total_time = job.watch.elapsed();
+        m.process_peak_memory = Profiler::process_peak_memory();
+        std::vector<Profiler::Stage> stages = thread_stages(job.first_stage);
+        m.stages.insert(m.stages.end(), stages.begin(), stages.end());
+
+        if (m.succeeded)
+            Logger::out("-") << "tile done: " << job.tile.input << " -> " << job.tile.output << ". " << m.total_time << " sec" << std::endl;
+        else {
+            ++num_failed;
+            Logger::err("-") << "tile failed: " << job.tile.input << " (" << m.error << ")" << std::endl;
+        }
+        if (!save_metrics(job.tile, m))
+            Logger::err("-") << "failed saving metrics to file: " << job.tile.metrics << std::endl;
+        MetricsExporter::add_counter("polyfit_tiles", MetricsExporter::label("result", m.succeeded ? "done" : "failed"), 1.0);
+    }
+
+
+    // reconstructs the tiles of the queue one after another
+    void worker(unsigned int index, TileQueue& queue, const Options& options, MemoryBudget& budget, std::atomic<std::size_t>& num_failed) {
+        SolverSession session; // kept across the tiles of this worker
+        Tracer::set_thread_name("job " + std::to_string(index));
+
+        Tile tile;
+        while (queue.pop(tile)) {
+            Job job;
+            job.tile = tile;
+            job.first_stage = Profiler::stages().size();
+            bool succeeded = false;
+            try {
+                ProfileStage stage("tile");
+                succeeded = reconstruct(job, options, session, budget, false);
+            }
+            catch (const std::exception& e) {
+                job.m.error = e.what();
+            }
+            finish(job, succeeded, num_failed);
+        }
+    }
+
+
+    // The jobs handed over between the stages of the pipeline (see '--pipeline'): the tiles read ahead
+    // and the models to save. It holds at most 'capacity' jobs and, with a limit (0 for none), not more
+    // than 'max_bytes' of their memory (but always a job), so the tiles in flight are bounded.
+    class JobQueue {
+    public:
+        JobQueue(std::size_t capacity, double max_bytes)
+            : capacity_(std::max<std::size_t>(capacity, 1)), max_bytes_(max_bytes), bytes_(0.0), closed_(false) {}
+
+        // waits for room for the job
+        void push(std::unique_ptr<Job> job, double bytes) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            popped_.wait(lock, [this, bytes]() {
+                return jobs_.empty() || (jobs_.size() < capacity_ && (max_bytes_ <= 0.0 || bytes_ + bytes <= max_bytes_));
+            });
+            jobs_.push_back(std::make_pair(std::move(job), bytes));
+            bytes_ += bytes;
+            pushed_.notify_one();
+        }
+
+        // no more jobs will be pushed
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            pushed_.notify_all();
+        }
+
+        // waits for the next job, and returns false if the queue is closed and empty
+        bool pop(std::unique_ptr<Job>& job) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pushed_.wait(lock, [this]() { return closed_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return false;
+            job = std::move(jobs_.front().first);
+            bytes_ -= jobs_.front().second;
+            jobs_.pop_front();
+            popped_.notify_all();
+            return true;
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable pushed_;
+        std::condition_variable popped_;
+        std::deque< std::pair<std::unique_ptr<Job>, double> > jobs_;
+        std::size_t             capacity_;
+        double                  max_bytes_;
+        double                  bytes_;
+        bool                    closed_;
+    };
+
+
+    // reads the point sets of the tiles of the queue ahead of the workers
+    void reader(TileQueue& queue, JobQueue& prefetched, const Options& options) {
+        Tracer::set_thread_name("reader");
+
+        Tile tile;
+        while (queue.pop(tile)) {
+            std::unique_ptr<Job> job(new Job);
+            job->tile = tile;
+            job->prefetched = true;
+            job->first_stage = Profiler::stages().size();
+            try {
+                ProfileStage stage("read tile");
+                read_tile(options, *job);
+            }
+            catch (const std::exception& e) {
+                job->pset = nil;
+                job->m.error = e.what();
+            }
+            job->m.stages = thread_stages(job->first_stage);
+            const double bytes = job->pset ? job->pset->memory_usage().total() : 0.0;
+            prefetched.push(std::move(job), bytes);
+        }
+        prefetched.close();
+    }
+
+
+    // Hands the model of a job to the writer, or ends the job if it failed. The stages of the job so
+    // far go into its metrics, since the writer records its own ones.
+    void hand_over(std::unique_ptr<Job> job, bool succeeded, JobQueue& results, std::atomic<std::size_t>& num_failed) {
+        if (!succeeded || !job->result) {
+            finish(*job, succeeded, num_failed);
+            return;
+        }
+        std::vector<Profiler::Stage> stages = thread_stages(job->first_stage);
+        job->m.stages.insert(job->m.stages.end(), stages.begin(), stages.end());
+        const double bytes = job->result->memory_usage().total();
+        results.push(std::move(job), bytes);
+    }
+
+
+    // reconstructs the tiles read ahead one after another, and hands their models to the writer
+    void pipelined_worker(unsigned int index, JobQueue& prefetched, JobQueue& results, const Options& options, MemoryBudget& budget, std::atomic<std::size_t>& num_failed) {
+        SolverSession session; // kept across the tiles of this worker
+        Tracer::set_thread_name("job " + std::to_string(index));
+
+        std::unique_ptr<Job> job;
+        while (prefetched.pop(job)) {
+            job->first_stage = Profiler::stages().size();
+            bool succeeded = false;
+            try {
+                ProfileStage stage("tile");
+                succeeded = reconstruct(*job, options, session, budget, true);
+            }
+            catch (const std::exception& e) {
+                job->m.error = e.what();
+            }
+            // only the model goes on
+            job->mesh = nil;
+            job->hypothesis.reset();
+            job->pset = nil;
+            hand_over(std::move(job), succeeded, results, num_failed);
+        }
+    }
+
+
+    // saves the models while the workers reconstruct the next tiles
+    void writer(JobQueue& results, const Options& options, std::atomic<std::size_t>& num_failed) {
+        Tracer::set_thread_name("writer");
+
+        std::unique_ptr<Job> job;
+        while (results.pop(job)) {
+            job->first_stage = Profiler::stages().size();
+            bool saved = false;
+            try {
+                ProfileStage stage("save tile");
+                saved = save_result(*job, options, job->result, false);
+            }
+            catch (const std::exception& e) {
+                job->m.error = e.what();
+            }
+            job->result = nil;
+            finish(*job, saved, num_failed);
+        }
+    }
+
+
+    // Hands out the tiles by their predicted cost (see predicted_cost()) instead of their order: the
+    // workers prepare the tiles (see prepare()) up to a window of prepared ones, and start the most
+    // costly prepared tile whose predicted memory fits next to the running ones, so that the longest
+    // jobs start first and the small ones are packed around them. A job gets a share of the threads in
+    // proportion to its cost among the running and the prepared jobs (at least one thread, and at most
+    // the ones left by the running jobs), used by its parallel parts and its solver.
+    class CostScheduler {
+    public:
+        enum Task { PREPARE, EXECUTE, DONE };
+
+        CostScheduler(double memory_budget, unsigned int num_threads, std::size_t window)
+            : closed_(false), memory_budget_(memory_budget), used_memory_(0.0), num_threads_(num_threads), used_threads_(0)
+            , running_cost_(0.0), window_(std::max<std::size_t>(window, 1)), num_preparing_(0) {}
+
+        void push(const Tile& tile) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tiles_.push_back(tile);
+            MetricsExporter::set_gauge("polyfit_queue_depth", "", static_cast<double>(tiles_.size()));
+            changed_.notify_all();
+        }
+
+        // no more tiles will be pushed
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            changed_.notify_all();
+        }
+
+        // Waits for the next task of a worker: a tile to prepare (then prepared() must be called), a job
+        // to execute (with its memory and threads taken until finished() is called), or none.
+        Task next(Tile& tile, std::unique_ptr<Job>& job) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                // prepared jobs to choose from (or no more tiles to wait for)
+                if (!ready_.empty() && (ready_.size() + num_preparing_ >= window_ || tiles_.empty())) {
+                    std::size_t best = ready_.size();
+                    for (std::size_t i = 0; i < ready_.size(); ++i) {
+                        if (fits(*ready_[i]) && (best == ready_.size() || ready_[i]->cost > ready_[best]->cost))
+                            best = i;
+                    }
+                    if (best < ready_.size()) {
+                        job = std::move(ready_[best]);
+                        ready_.erase(ready_.begin() + best);
+                        start(*job);
+                        changed_.notify_all();
+                        return EXECUTE;
+                    }
+                }
+                // keeps preparing while a job waits for the memory of the running ones, up to twice the window
+                if (!tiles_.empty() && ready_.size() + num_preparing_ < 2 * window_) {
+                    tile = tiles_.front();
+                    tiles_.pop_front();
+                    MetricsExporter::set_gauge("polyfit_queue_depth", "", static_cast<double>(tiles_.size()));
+                    ++num_preparing_;
+                    return PREPARE;
+                }
+                if (closed_ && tiles_.empty() && ready_.empty() && num_preparing_ == 0)
+                    return DONE;
+                changed_.wait(lock);
+            }
+        }
+
+        // the end of the preparation of a tile, nil if it failed
+        void prepared(std::unique_ptr<Job> job) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --num_preparing_;
+            if (job) {
+                ready_.push_back(std::move(job));
+                ready_.back()->m.admission_time -= time_.elapsed();   // the waiting time is added when it starts
+            }
+            changed_.notify_all();
+        }
+
+        void finished(const Job& job) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            used_memory_ -= job.plan.predicted_memory;
+            used_threads_ -= job.num_threads;
+            running_cost_ -= job.cost;
+            running_.erase(&job);
+            changed_.notify_all();
+        }
+
+    private:
+        // a job is always started if none is running, so a tile larger than the budget runs alone
+        bool fits(const Job& job) const {
+            return running_.empty() || memory_budget_ <= 0.0 || used_memory_ + job.plan.predicted_memory <= memory_budget_;
+        }
+
+        void start(Job& job) {
+            double total_cost = running_cost_ + job.cost;
+            for (std::size_t i = 0; i < ready_.size(); ++i)
+                total_cost += ready_[i]->cost;
+            const unsigned int available = num_threads_ > used_threads_ ? num_threads_ - used_threads_ : 1u;
+            unsigned int share = total_cost > 0.0 ? static_cast<unsigned int>(std::ceil(num_threads_ * job.cost / total_cost)) : 1u;
+            job.num_threads = std::min(std::max(share, 1u), available);
+            job.m.num_threads = job.num_threads;
+            job.m.admission_time += time_.elapsed();
+
+            used_memory_ += job.plan.predicted_memory;
+            used_threads_ += job.num_threads;
+            running_cost_ += job.cost;
+            running_.insert(&job);
+        }
+
+    private:
+        std::mutex              mutex_;
+        std::condition_variable changed_;
+        std::deque<Tile>        tiles_;
+        bool                    closed_;
+        std::vector<std::unique_ptr<Job> > ready_;
+        std::set<const Job*>    running_;
+        StopWatch               time_;      // of the waiting of the prepared jobs
+
+        double                  memory_budget_;
+        double                  used_memory_;
+        unsigned int            num_threads_;
+        unsigned int            used_threads_;
+        double                  running_cost_;
+        std::size_t             window_;
+        std::size_t             num_preparing_;
+    };
+
+
+    // prepares and executes the tasks of the scheduler
+    // The models are handed to the writer if given (see writer()).
+    void cost_worker(unsigned int index, CostScheduler& scheduler, const Options& options, unsigned int prepare_threads, JobQueue* results, std::atomic<std::size_t>& num_failed) {
+        SolverSession session; // kept across the tiles of this worker
+        Tracer::set_thread_name("job " + std::to_string(index));
+
+        Tile tile;
+        std::unique_ptr<Job> job;
+        while (true) {
+            CostScheduler::Task task = scheduler.next(tile, job);
+            if (task == CostScheduler::DONE)
+                break;
+
+            if (task == CostScheduler::PREPARE) {
+                job.reset(new Job);
+                job->tile = tile;
+                job->first_stage = Profiler::stages().size();
+                ScopedThreadBudget threads(prepare_threads);
+                bool prepared = false;
+                try {
+                    ProfileStage stage("prepare tile");
+                    prepared = prepare(options, *job);
+                }
+                catch (const std::exception& e) {
+                    job->m.error = e.what();
+                }
+                job->m.stages = thread_stages(job->first_stage);
+                if (!prepared) {
+                    job->first_stage = Profiler::stages().size();   // the stages are recorded already
+                    finish(*job, false, num_failed);
+                    job.reset();
+                }
+                scheduler.prepared(std::move(job));
+            }
+            else {
+                job->first_stage = Profiler::stages().size();
+                ScopedThreadBudget threads(job->num_threads);
+                bool succeeded = false;
+                try {
+                    ProfileStage stage("tile");
+                    succeeded = execute(*job, options, session, results != nil);
+                }
+                catch (const std::exception& e) {
+                    job->m.error = e.what();
+                }
+                // the candidate faces go before the next job starts
+                job->mesh = nil;
+                job->hypothesis.reset();
+                job->pset = nil;
+                scheduler.finished(*job);
+                if (results)
+                    hand_over(std::move(job), succeeded, *results, num_failed);
+                else
+                    finish(*job, succeeded, num_failed);
+                job.reset();
+            }
+        }
+    }
+
+
+    // reads the tiles of the manifest into the queue (a TileQueue or a CostScheduler), returns the number of tiles
+    template <class Queue>
+    std::size_t read_manifest(std::istream& input, Queue& queue) {
+        std::size_t num = 0;
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            Tile tile;
+            if (!(fields >> tile.input) || tile.input[0] == '#')
+                continue;
+            if (!(fields >> tile.output)) {
+                Logger::err("-") << "no output file for tile: " << tile.input << std::endl;
+                continue;
+            }
+            if (!(fields >> tile.metrics))
+                tile.metrics = tile.output + ".metrics.json";
+            queue.push(tile);
+            ++num;
+        }
+        return num;
+    }
+
+
+    bool parse_solver(const std::string& name, LinearProgramSolver::SolverName& solver) {
+        std::string str = name;
+        std::transform(str.begin(), str.end(), str.begin(), ::toupper);
+#ifdef HAS_GUROBI
+        if (str == "GUROBI") { solver = LinearProgramSolver::GUROBI; return true; }
+#endif
+#ifdef HAS_HIGHS
+        if (str == "HIGHS")   { solver = LinearProgramSolver::HIGHS; return true; }
+#endif
+#ifdef HAS_ORTOOLS
+        if (str == "CPSAT")   { solver = LinearProgramSolver::CPSAT; return true; }
+#endif
+        if (str == "SCIP")    { solver = LinearProgramSolver::SCIP; return true; }
+        if (str == "GLPK")    { solver = LinearProgramSolver::GLPK; return true; }
+        if (str == "LPSOLVE") { solver = LinearProgramSolver::LPSOLVE; return true; }
+        if (str == "AUTO")    { solver = LinearProgramSolver::AUTO; return true; }
+        return false;
+    }
+
+
+    bool parse_options(int argc, char **argv, Options& options) {
+        for (int i = 2; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--checkpoint") {
+                options.checkpoint = true;
+                continue;
+            }
+            else if (arg == "--resume") {
+                options.resume = true;
+                continue;
+            }
+            else if (arg == "--merge-faces") {
+                options.merge_faces = true;
+                continue;
+            }
+            else if (arg == "--cost-scheduling") {
+                options.cost_scheduling = true;
+                continue;
+            }
+            else if (arg == "--evaluate") {
+                options.evaluate = true;
+                continue;
+            }
+            else if (arg == "--validate") {
+                options.validate = true;
+                continue;
+            }
+            else if (arg == "--pipeline") {
+                options.pipeline = true;
+                continue;
+            }
+            else if (arg == "--stream-index") {
+                options.stream_index = true;
+                continue;
+            }
+            else if (arg == "--perf-counters") {
+                options.perf_counters = true;
+                continue;
+            }
+            else if (arg == "--auto-policy") {
+                options.auto_policy = true;
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                std::cerr << "no value for option: " << arg << std::endl;
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--jobs")
+                options.num_jobs = static_cast<unsigned int>(std::max(std::atoi(value.c_str()), 0));
+            else if (arg == "--threads")
+                options.num_threads = static_cast<unsigned int>(std::max(std::atoi(value.c_str()), 0));
+            else if (arg == "--memory")
+                options.memory_budget = std::max(std::atof(value.c_str()), 0.0) * 1024.0 * 1024.0;
+            else if (arg == "--job-memory")
+                options.job_memory = std::max(std::atof(value.c_str()), 0.0) * 1024.0 * 1024.0;
+            else if (arg == "--time-limit")
+                options.time_limit = std::max(std::atof(value.c_str()), 0.0);
+            else if (arg == "--regularize-planes")
+                options.regularization_angle = std::max(std::atof(value.c_str()), 0.0);
+            else if (arg == "--sample-confidences")
+                options.sample_size = static_cast<unsigned int>(std::max(std::atoi(value.c_str()), 0));
+            else if (arg == "--fitting")
+                options.fitting = std::atof(value.c_str());
+            else if (arg == "--coverage")
+                options.coverage = std::atof(value.c_str());
+            else if (arg == "--complexity")
+                options.complexity = std::atof(value.c_str());
+            else if (arg == "--thumbnails")
+                options.num_thumbnails = static_cast<unsigned int>(std::max(std::atoi(value.c_str()), 0));
+            else if (arg == "--trace")
+                options.trace_file = value;
+            else if (arg == "--metrics")
+                options.metrics_file = value;
+            else if (arg == "--policy-calibration")
+                options.policy_calibration = value;
+            else if (arg == "--metrics-interval")
+                options.metrics_interval = std::max(std::atof(value.c_str()), 0.1);
+            else if (arg == "--pin-threads") {
+                Numa::Pinning pinning;
+                if (!Numa::parse_pinning(value, pinning)) {
+                    std::cerr << "unknown pinning: " << value << std::endl;
+                    return false;
+                }
+                Numa::set_pinning(pinning);
+            }
+            else if (arg == "--huge-pages") {
+                Numa::HugePages pages;
+                if (!Numa::parse_huge_pages(value, pages)) {
+                    std::cerr << "unknown huge pages: " << value << std::endl;
+                    return false;
+                }
+                Numa::set_huge_pages(pages);
+            }
+            else if (arg == "--solver") {
+                if (!parse_solver(value, options.solver)) {
+                    std::cerr << "unknown solver: " << value << std::endl;
+                    return false;
+                }
+            }
+            else {
+                std::cerr << "unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    // the worker mode: processes one work unit
+    int process_work_unit(int argc, char **argv) {
+        if (argc < 4) {
+            std::cerr << "usage: " << argv[0] << " --work-unit unit result [--threads N]" << std::endl;
+            return EXIT_FAILURE;
+        }
+        const std::string unit_file = argv[2];
+        const std::string result_file = argv[3];
+        if (argc >= 6 && std::string(argv[4]) == "--threads")
+            Method::num_threads = static_cast<unsigned int>(std::max(std::atoi(argv[5]), 0));
+
+        // with the result on the standard output, the messages (written to std::cout) go to the standard error
+        std::streambuf* stdout_buffer = std::cout.rdbuf();
+        if (result_file == "-")
+            std::cout.rdbuf(std::cerr.rdbuf());
+
+        Logger::initialize();
+        bool ok = false;
+        {
+            std::ifstream unit_stream;
+            if (unit_file != "-")
+                unit_stream.open(unit_file.c_str(), std::ios::binary);
+            std::ofstream result_stream;
+            if (result_file != "-")
+                result_stream.open(result_file.c_str(), std::ios::binary);
+            std::ostream stdout_stream(stdout_buffer);
+
+            std::istream& input = (unit_file == "-") ? std::cin : unit_stream;
+            std::ostream& output = (result_file == "-") ? stdout_stream : result_stream;
+            if (input.fail())
+                Logger::err("-") << "failed opening work unit: " << unit_file << std::endl;
+            else if (output.fail())
+                Logger::err("-") << "failed creating result file: " << result_file << std::endl;
+            else
+                ok = WorkUnit::process(input, output);
+            output.flush();
+        }
+        Logger::terminate();
+        std::cout.rdbuf(stdout_buffer);
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && std::string(argv[1]) == "--work-unit")
+        return process_work_unit(argc, argv);
+
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " manifest [--jobs N] [--threads N] [--memory MB] [--job-memory MB] [--solver SCIP|GLPK|LPSOLVE|AUTO]"
+            << " [--time-limit sec] [--fitting w] [--coverage w] [--complexity w] [--regularize-planes deg] [--sample-confidences N] [--checkpoint] [--resume] [--merge-faces] [--cost-scheduling] [--pipeline] [--stream-index] [--thumbnails N] [--evaluate] [--validate] [--trace trace.json] [--metrics file] [--metrics-interval sec]"
+            << " [--pin-threads none|compact|scatter] [--huge-pages none|thp|hugetlb] [--perf-counters] [--auto-policy] [--policy-calibration report.csv]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Options options;
+    if (!parse_options(argc, argv, options))
+        return EXIT_FAILURE;
+
+    // initialize the logger (this is not optional)
+    Logger::initialize();
+    Progress::instance();   // created before the workers use it
+
+    // the thread budget is split among the jobs, which don't start more threads than their share
+    const unsigned int num_threads = parallel_num_threads(options.num_threads);
+    const unsigned int num_jobs = options.num_jobs > 0 ? options.num_jobs : std::max(num_threads / 4, 1u);
+    Method::num_threads = std::max(num_threads / num_jobs, 1u);
+    // the thread of each job works in its stages as well, so the shared pool has one worker less per job
+    ThreadPool::set_num_threads(num_threads > num_jobs ? num_threads - num_jobs + 1 : 1);
+
+    Method::lambda_data_fitting = options.fitting;
+    Method::lambda_model_coverage = options.coverage;
+    Method::lambda_model_complexity = options.complexity;
+    Method::selection_time_limit = options.time_limit;
+    Method::memory_budget = options.job_memory;
+    Method::merge_coplanar_faces = options.merge_faces;
+    Method::plane_regularization_angle = options.regularization_angle;
+    Method::automatic_selection_policy = options.auto_policy;
+    Method::selection_policy_calibration = options.policy_calibration;
+    if (options.sample_size > 0) {
+        Method::sampled_confidences = true;
+        Method::confidence_sample_size = options.sample_size;
+    }
+
+    if (options.cost_scheduling)
+        Logger::out("-") << "running " << num_jobs << " jobs sharing " << num_threads << " threads by their costs" << std::endl;
+    else
+        Logger::out("-") << "running " << num_jobs << " jobs with " << Method::num_threads << " threads each" << std::endl;
+
+    if (!options.trace_file.empty())
+        Tracer::set_enabled(true);
+    if (options.perf_counters)
+        PerfCounters::set_enabled(true);
+
+    if (!options.metrics_file.empty()) {
+        MetricsExporter::set_enabled(true);
+        MetricsExporter::describe("polyfit_queue_depth", "The tiles read from the manifest and not started yet.");
+        MetricsExporter::describe("polyfit_tiles", "The tiles reconstructed, by result.");
+        MetricsExporter::set_gauge("polyfit_queue_depth", "", 0.0);
+        MetricsExporter::start_writer(options.metrics_file, options.metrics_interval);
+    }
+
+    if (options.num_thumbnails > 0) {
+        thumbnail_renderer = new OffscreenRenderer;
+        if (!thumbnail_renderer->is_valid()) {
+            Logger::warn("-") << "offscreen rendering not available, no thumbnails are saved" << std::endl;
+            delete thumbnail_renderer;
+            thumbnail_renderer = nil;
+        }
+    }
+
+    StopWatch w;
+    TileQueue queue;
+    MemoryBudget budget(options.memory_budget);
+    // the jobs take their shares of the threads by setting their thread budgets (see parallel_thread_budget())
+    CostScheduler scheduler(options.memory_budget, num_threads, 2 * num_jobs);
+    const unsigned int prepare_threads = Method::num_threads;
+    if (options.cost_scheduling)
+        Method::num_threads = 0;
+
+    // the pipeline: the tiles read ahead, and the models waiting for the writer
+    JobQueue prefetched(num_jobs, options.memory_budget / 4.0);
+    JobQueue results(num_jobs, 0.0);
+    const bool pipeline = options.pipeline;
+
+    std::atomic<std::size_t> num_failed(0);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < num_jobs; ++i) {
+        if (options.cost_scheduling)
+            workers.push_back(std::thread(cost_worker, i, std::ref(scheduler), std::cref(options), prepare_threads, pipeline ? &results : nil, std::ref(num_failed)));
+        else if (pipeline)
+            workers.push_back(std::thread(pipelined_worker, i, std::ref(prefetched), std::ref(results), std::cref(options), std::ref(budget), std::ref(num_failed)));
+        else
+            workers.push_back(std::thread(worker, i, std::ref(queue), std::cref(options), std::ref(budget), std::ref(num_failed)));
+    }
+    std::thread reader_thread, writer_thread;
+    if (pipeline && !options.cost_scheduling)
+        reader_thread = std::thread(reader, std::ref(queue), std::ref(prefetched), std::cref(options));
+    if (pipeline)
+        writer_thread = std::thread(writer, std::ref(results), std::cref(options), std::ref(num_failed));
+
+    const std::string manifest = argv[1];
+    std::size_t num_tiles = 0;
+    std::ifstream input;
+    if (manifest != "-") {
+        input.open(manifest.c_str());
+        if (input.fail())
+            Logger::err("-") << "failed opening manifest: " << manifest << std::endl;
+    }
+    if (manifest == "-" || !input.fail()) {
+        std::istream& stream = (manifest == "-") ? std::cin : input;
+        num_tiles = options.cost_scheduling ? read_manifest(stream, scheduler) : read_manifest(stream, queue);
+    }
+    queue.close();
+    scheduler.close();
+
+    if (reader_thread.joinable())
+        reader_thread.join();   // closes the queue of the tiles read ahead
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    results.close();
+    if (writer_thread.joinable())
+        writer_thread.join();
+
+    Logger::out("-") << num_tiles - num_failed << " of " << num_tiles << " tiles reconstructed. " << w.elapsed() << " sec" << std::endl;
+    delete thumbnail_renderer;
+
+    if (!options.metrics_file.empty()) {
+        MetricsExporter::stop_writer();     // with the final values
+        Logger::out("-") << "metrics saved to file: " << options.metrics_file << std::endl;
+    }
+
+    if (!options.trace_file.empty()) {
+        if (Tracer::save_json(options.trace_file))
+            Logger::out("-") << "timeline saved to file: " << options.trace_file << std::endl;
+        else
+            Logger::err("-") << "failed saving timeline to file: " << options.trace_file << std::endl;
+    }
+    return (num_tiles > 0 && num_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+};
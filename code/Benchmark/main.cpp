@@ -0,0 +1,289 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/stop_watch.h"
+#include "../basic/file_utils.h"
+#include "../math/linear_program.h"
+#include "../math/linear_program_solver.h"
+#include "../math/solver_policy.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+
+// Solves the linear programs saved in a directory (e.g., the face selection problems saved with
+// LinearProgram::save()) with every solver and a few solver options, and reports the time, the
+// objective, and the memory of each run. The pseudo-Boolean programs (e.g., saved as .opb) are
+// solved by CPSAT too. AUTO is run as well, with the backend it picked reported (see SolverPolicy),
+// and the report in CSV calibrates the policy (see SolverPolicy::calibrate()).
+//
+// usage: Benchmark directory [repetitions] [report.csv | report.json] [time limit]
+
+
+namespace {
+
+    struct Configuration {
+        std::string name;
+        LinearProgramSolver::SolverOptions options;
+    };
+
+    struct Run {
+        std::string program;
+        std::string solver;
+        std::string backend;        // the one AUTO picked (the solver otherwise)
+        std::string configuration;
+        unsigned int threads;       // of the configuration (0 lets the solver decide)
+        std::size_t variables;      // of the program
+        std::size_t constraints;
+        int         repetition;
+        std::string status;
+        double      wall_time;      // in sec.
+        double      cpu_time;       // in sec.
+        double      objective;
+        double      gap;            // to the best objective found for the program (-1 if not solved)
+        double      peak_memory;    // of the process so far, in MB
+        bool        solved;
+        bool        minimize;
+    };
+
+
+    std::string solver_name(LinearProgramSolver::SolverName solver) {
+        return SolverPolicy::solver_name(solver);
+    }
+
+
+    std::string status_name(LinearProgramSolver::Status status) {
+        switch (status) {
+        case LinearProgramSolver::STATUS_OPTIMAL:       return "optimal";
+        case LinearProgramSolver::STATUS_LIMIT_REACHED: return "limit reached";
+        case LinearProgramSolver::STATUS_INFEASIBLE:    return "infeasible";
+        case LinearProgramSolver::STATUS_UNBOUNDED:     return "unbounded";
+        default:                                        return "failed";
+        }
+    }
+
+
+    std::string json_string(const std::string& str) {
+        std::string result = "\"";
+        for (std::size_t i = 0; i < str.size(); ++i) {
+            if (str[i] == '"' || str[i] == '\\')
+                result += '\\';
+            result += str[i];
+        }
+        return result + "\"";
+    }
+
+
+    // the gap of each run to the best solution found for its program by any run
+    void compute_gaps(std::vector<Run>& runs) {
+        for (std::size_t i = 0; i < runs.size(); ++i) {
+            bool found = false;
+            double best = 0.0;
+            for (std::size_t j = 0; j < runs.size(); ++j) {
+                if (runs[j].program != runs[i].program || !runs[j].solved)
+                    continue;
+                if (!found || (runs[i].minimize ? runs[j].objective < best : runs[j].objective > best))
+                    best = runs[j].objective;
+                found = true;
+            }
+            runs[i].gap = -1.0;
+            if (runs[i].solved)
+                runs[i].gap = std::abs(runs[i].objective - best) / std::max(std::abs(best), 1e-10);
+        }
+    }
+
+
+    void write_csv(std::ostream& output, const std::vector<Run>& runs) {
+        output << "program,solver,backend,configuration,threads,variables,constraints,repetition,status,wall_time,cpu_time,objective,gap,peak_memory_mb" << std::endl;
+        for (std::size_t i = 0; i < runs.size(); ++i) {
+            const Run& r = runs[i];
+            output << r.program << "," << r.solver << "," << r.backend << "," << r.configuration << "," << r.threads << ","
+                << r.variables << "," << r.constraints << "," << r.repetition << "," << r.status << ","
+                << r.wall_time << "," << r.cpu_time << ",";
+            if (r.solved)
+                output << r.objective << "," << r.gap;
+            else
+                output << ",";
+            output << "," << r.peak_memory << std::endl;
+        }
+    }
+
+
+    void write_json(std::ostream& output, const std::vector<Run>& runs) {
+        output << "[" << std::endl;
+        for (std::size_t i = 0; i < runs.size(); ++i) {
+            const Run& r = runs[i];
+            output << "  { \"program\": " << json_string(r.program)
+                << ", \"solver\": " << json_string(r.solver)
+                << ", \"backend\": " << json_string(r.backend)
+                << ", \"configuration\": " << json_string(r.configuration)
+                << ", \"threads\": " << r.threads
+                << ", \"variables\": " << r.variables
+                << ", \"constraints\": " << r.constraints
+                << ", \"repetition\": " << r.repetition
+                << ", \"status\": " << json_string(r.status)
+                << ", \"wall_time\": " << r.wall_time
+                << ", \"cpu_time\": " << r.cpu_time;
+            if (r.solved)
+                output << ", \"objective\": " << r.objective << ", \"gap\": " << r.gap;
+            else
+                output << ", \"objective\": null, \"gap\": null";
+            output << ", \"peak_memory_mb\": " << r.peak_memory << " }" << (i + 1 < runs.size() ? "," : "") << std::endl;
+        }
+        output << "]" << std::endl;
+    }
+
+}
+
+
+int main(int argc, char **argv)
+{
+    // initialize the logger (this is not optional)
+    Logger::initialize();
+
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " directory [repetitions] [report.csv | report.json] [time limit]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string directory = argv[1];
+    const int repetitions = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 3;
+    const std::string report_file = (argc > 3) ? argv[3] : std::string();
+    const double time_limit = (argc > 4) ? std::atof(argv[4]) : 0.0;
+
+    // the programs saved in any of the formats LinearProgram can load
+    std::vector<std::string> files, program_files;
+    FileUtils::get_files(directory, files);
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        const std::string& ext = FileUtils::extension_in_lower_case(files[i]);
+        if (ext == "lp" || ext == "mps" || ext == "cip" || ext == "lpb" || ext == "opb")
+            program_files.push_back(files[i]);
+    }
+    std::sort(program_files.begin(), program_files.end());
+    if (program_files.empty()) {
+        std::cerr << "no linear program (*.lp, *.mps, *.cip, *.lpb, or *.opb) found in " << directory << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<LinearProgramSolver::SolverName> solvers;
+#ifdef HAS_GUROBI
+    solvers.push_back(LinearProgramSolver::GUROBI);
+#endif
+#ifdef HAS_HIGHS
+    solvers.push_back(LinearProgramSolver::HIGHS);
+#endif
+#ifdef HAS_ORTOOLS
+    solvers.push_back(LinearProgramSolver::CPSAT);
+#endif
+    solvers.push_back(LinearProgramSolver::SCIP);
+    solvers.push_back(LinearProgramSolver::GLPK);
+    solvers.push_back(LinearProgramSolver::LPSOLVE);
+    solvers.push_back(LinearProgramSolver::PORTFOLIO);
+    solvers.push_back(LinearProgramSolver::AUTO);
+
+    // the combinations of solver options compared (all with the same time limit)
+    std::vector<Configuration> configurations(1);
+    configurations[0].name = "default";
+    configurations[0].options.time_limit = time_limit;
+    unsigned int num_threads = std::thread::hardware_concurrency();
+    if (num_threads > 1) {
+        Configuration threaded;
+        threaded.name = std::to_string(num_threads) + " threads";
+        threaded.options.time_limit = time_limit;
+        threaded.options.num_threads = num_threads;
+        configurations.push_back(threaded);
+    }
+
+    std::vector<Run> runs;
+    for (std::size_t i = 0; i < program_files.size(); ++i) {
+        LinearProgram program;
+        if (!program.load(program_files[i])) {
+            std::cerr << "failed loading " << program_files[i] << std::endl;
+            continue;
+        }
+        std::cout << FileUtils::simple_name(program_files[i]) << ": " << program.num_variables() << " variables, "
+            << program.num_constraints() << " constraints" << std::endl;
+
+        for (std::size_t s = 0; s < solvers.size(); ++s) {
+#ifdef HAS_ORTOOLS
+            // CP-SAT only solves the pseudo-Boolean programs (e.g., the face selection)
+            if (solvers[s] == LinearProgramSolver::CPSAT && !program.is_pseudo_boolean())
+                continue;
+#endif
+            for (std::size_t c = 0; c < configurations.size(); ++c) {
+                for (int rep = 0; rep < repetitions; ++rep) {
+                    LinearProgramSolver solver;
+                    solver.set_verbose(false);
+                    solver.set_options(configurations[c].options);
+
+                    double cpu_start = Profiler::process_cpu_time();
+                    StopWatch w;
+                    bool solved = solver.solve(&program, solvers[s]);
+
+                    Run run;
+                    run.wall_time = w.elapsed();
+                    run.cpu_time = Profiler::process_cpu_time() - cpu_start;
+                    run.program = FileUtils::simple_name(program_files[i]);
+                    run.solver = solver_name(solvers[s]);
+                    run.backend = solver_name(solver.backend());
+                    run.configuration = configurations[c].name;
+                    run.threads = configurations[c].options.num_threads;
+                    run.variables = program.num_variables();
+                    run.constraints = program.num_constraints();
+                    run.repetition = rep;
+                    run.status = status_name(solver.status());
+                    run.solved = solved;
+                    run.objective = solved ? solver.objective_value() : 0.0;
+                    run.gap = -1.0;
+                    run.peak_memory = Profiler::process_peak_memory() / (1024.0 * 1024.0);
+                    run.minimize = (program.objective()->sense() != LinearObjective::MAXIMIZE);
+                    runs.push_back(run);
+
+                    std::cout << "    " << run.solver << (run.backend != run.solver ? " " + run.backend : std::string())
+                        << " (" << run.configuration << ") #" << rep << ": "
+                        << run.status << ", " << run.wall_time << " sec" << std::endl;
+                }
+            }
+        }
+    }
+    compute_gaps(runs);
+
+    if (report_file.empty()) {
+        write_csv(std::cout, runs);
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream output(report_file.c_str());
+    if (output.fail()) {
+        std::cerr << "could not create file: " << report_file << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (FileUtils::extension_in_lower_case(report_file) == "json")
+        write_json(output, runs);
+    else
+        write_csv(output, runs);
+    std::cout << "benchmark report saved to file: " << report_file << std::endl;
+    return EXIT_SUCCESS;
+};
@@ -0,0 +1,499 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/stop_watch.h"
+#include "../basic/file_utils.h"
+#include "../model/point_set.h"
+#include "../model/point_set_io.h"
+#include "../model/map.h"
+#include "../model/map_io.h"
+#include "../model/kdtree_search.h"
+#include "../model/plane_detector.h"
+#include "../model/synthetic_scene.h"
+#include "../method/method_global.h"
+#include "../method/hypothesis_generator.h"
+#include "../method/face_selection.h"
+#include "../method/alpha_shape_mesh.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <map>
+#include <cmath>
+
+
+// Measures the stages of the pipeline on some point clouds (by default, the data of the repository
+// and a synthetic scene, see SyntheticScene), for quantifying the changes of performance. The micro 
+// benchmarks (the kd-tree, the plane fitting, the alpha shapes, the I/O) are repeated at least 'repetitions' times and for at least 
+// 0.5 sec (in the way of Google Benchmark). The macro benchmarks run the whole pipeline 'repetitions' 
+// times, and the stages inside it (e.g., the triplet intersection and the pairwise cut) are taken from 
+// the Profiler. The face selection is run with each solver (and each formulation of the sharp edges) on
+// the same candidate faces. For each benchmark, the mean and the minimum time of an iteration, and the
+// throughput (in its own items, e.g., points or faces, per second) are reported.
+//
+// usage: BenchmarkStages [input.bvg ...] [--repetitions N] [--synthetic num_points] [--planes N] [--report report.csv | report.json]
+//                        [--work directory]
+
+
+namespace {
+
+    struct Row {
+        std::string input;
+        std::string benchmark;
+        std::size_t iterations;
+        double      mean_time;      // of an iteration, in sec.
+        double      min_time;       // of an iteration, in sec.
+        double      items;          // done by an iteration
+        std::string unit;           // of the items
+        double      throughput() const { return (mean_time > 0.0) ? items / mean_time : 0.0; }
+    };
+
+
+    struct Options {
+        Options() : repetitions(3), synthetic_points(100000), synthetic_planes(50) {}
+
+        std::vector<std::string> inputs;
+        int         repetitions;
+        std::size_t synthetic_points;   // 0 for no synthetic scene
+        std::size_t synthetic_planes;   // of the synthetic scene (see SyntheticScene)
+        std::string report_file;
+        std::string work_directory;     // of the temporary files
+    };
+
+
+    const double min_benchmark_time = 0.5;
+
+
+    // the times of the iterations of a benchmark
+    Row make_row(const std::string& input, const std::string& benchmark, const std::vector<double>& times, double items, const std::string& unit) {
+        Row row;
+        row.input = input;
+        row.benchmark = benchmark;
+        row.iterations = times.size();
+        row.mean_time = 0.0;
+        row.min_time = times.empty() ? 0.0 : times[0];
+        for (std::size_t i = 0; i < times.size(); ++i) {
+            row.mean_time += times[i];
+            row.min_time = std::min(row.min_time, times[i]);
+        }
+        if (!times.empty())
+            row.mean_time /= times.size();
+        row.items = items;
+        row.unit = unit;
+        return row;
+    }
+
+
+    // Runs 'setup' (not measured) and 'run' at least 'repetitions' times and for at least min_benchmark_time.
+    // 'run' returns the number of items it has done.
+    Row measure(const std::string& input, const std::string& benchmark, int repetitions, const std::string& unit,
+        const std::function<void()>& setup, const std::function<double()>& run)
+    {
+        std::vector<double> times;
+        double items = 0.0, total = 0.0;
+        while (int(times.size()) < repetitions || total < min_benchmark_time) {
+            if (setup)
+                setup();
+            StopWatch w;
+            items = run();
+            times.push_back(w.elapsed());
+            total += times.back();
+        }
+        Row row = make_row(input, benchmark, times, items, unit);
+        std::cout << "    " << benchmark << ": " << row.mean_time << " sec, " << row.throughput() << " " << unit << "/sec" << std::endl;
+        return row;
+    }
+
+
+    // the points (with their normals and colors) and the top-level groups (with their planes) of 'pset'
+    PointSet* copy_point_set(const PointSet* pset) {
+        PointSet* result = new PointSet;
+        result->points() = pset->points();
+        result->normals() = pset->normals();
+        result->colors() = pset->colors();
+        const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+        for (std::size_t i = 0; i < groups.size(); ++i) {
+            VertexGroup* g = new VertexGroup(result);
+            g->assign(groups[i]->begin(), groups[i]->end());
+            g->set_label(groups[i]->label());
+            g->set_color(groups[i]->color());
+            g->set_plane(groups[i]->plane());
+            result->groups().push_back(g);
+        }
+        return result;
+    }
+
+
+    std::string solver_name(LinearProgramSolver::SolverName solver) {
+        switch (solver) {
+#ifdef HAS_GUROBI
+        case LinearProgramSolver::GUROBI:   return "GUROBI";
+#endif
+#ifdef HAS_HIGHS
+        case LinearProgramSolver::HIGHS:    return "HIGHS";
+#endif
+#ifdef HAS_ORTOOLS
+        case LinearProgramSolver::CPSAT:    return "CPSAT";
+#endif
+        case LinearProgramSolver::SCIP:     return "SCIP";
+        case LinearProgramSolver::GLPK:     return "GLPK";
+        case LinearProgramSolver::LPSOLVE:  return "LPSOLVE";
+        default:                            return "PORTFOLIO";
+        }
+    }
+
+
+    // the time of the stages of the Profiler (of this thread), by their paths (e.g., 'generate/pairwise_cut')
+    void collect_stages(std::map< std::string, std::vector<double> >& times) {
+        const std::vector<Profiler::Stage>& stages = Profiler::stages();
+        const std::size_t thread = Profiler::thread_index();
+        std::vector<std::string> path;
+        for (std::size_t i = 0; i < stages.size(); ++i) {
+            const Profiler::Stage& s = stages[i];
+            if (!s.finished || s.thread != thread)
+                continue;
+            path.resize(s.depth);
+            path.push_back(s.name);
+            std::string name = path[0];
+            for (std::size_t j = 1; j < path.size(); ++j)
+                name += "/" + path[j];
+            times[name].push_back(s.wall_time);
+        }
+    }
+
+
+    // the benchmarks of an input ('name' identifies it in the report)
+    void benchmark(const std::string& name, PointSet* input, const Options& options, std::vector<Row>& rows) {
+        std::cout << name << ": " << input->num_points() << " points, " << input->groups().size() << " segments" << std::endl;
+        const int repetitions = options.repetitions;
+        const double num_points = input->num_points();
+        const std::string work = options.work_directory.empty() ? FileUtils::get_current_working_directory() : options.work_directory;
+        const std::string bvg_file = work + "/benchmark_stages.tmp.bvg";
+        const std::string obj_file = work + "/benchmark_stages.tmp.obj";
+        const std::string checkpoint_file = work + "/benchmark_stages.tmp.pfhc";
+
+        // ______________________ point cloud I/O ____________________________
+
+        rows.push_back(measure(name, "save bvg", repetitions, "points", nullptr, [&]() {
+            PointSetIO::save(bvg_file, input);
+            return num_points;
+        }));
+        rows.push_back(measure(name, "read bvg", repetitions, "points", nullptr, [&]() {
+            PointSet::Ptr pset = PointSetIO::read(bvg_file);
+            return num_points;
+        }));
+        FileUtils::delete_file(bvg_file);
+
+        // ______________________ kd-tree ____________________________________
+
+        const std::vector<vec3>& points = input->points();
+        KdTreeSearch tree;
+        rows.push_back(measure(name, "kd-tree build", repetitions, "points", nullptr, [&]() {
+            tree.build(points, Method::num_threads);
+            return num_points;
+        }));
+
+        const unsigned int k = 16;
+        std::vector<unsigned int> neighbors(points.size() * k);
+        std::vector<float> squared_distances(points.size() * k);
+        rows.push_back(measure(name, "kd-tree query (k = 16)", repetitions, "queries", nullptr, [&]() {
+            tree.find_closest_K_points(points.data(), points.size(), k, neighbors.data(), squared_distances.data(), Method::num_threads);
+            return num_points;
+        }));
+
+        // the average spacing, for the radius of the alpha shapes (as in the confidences)
+        double spacing = 0.0;
+        for (std::size_t i = 0; i < points.size(); ++i)
+            spacing += std::sqrt(squared_distances[i * k + 1]);
+        spacing /= std::max<std::size_t>(points.size(), 1);
+
+        // ______________________ planes _____________________________________
+
+        PointSet::Ptr pset = copy_point_set(input);
+        double grouped_points = 0.0;
+        for (std::size_t i = 0; i < pset->groups().size(); ++i)
+            grouped_points += pset->groups()[i]->size();
+        rows.push_back(measure(name, "PointSet::fit_plane", repetitions, "points", nullptr, [&]() {
+            for (std::size_t i = 0; i < pset->groups().size(); ++i)
+                pset->fit_plane(pset->groups()[i]);
+            return grouped_points;
+        }));
+
+        std::unique_ptr<HypothesisGenerator> generator;
+        rows.push_back(measure(name, "refine_planes", repetitions, "points", [&]() {
+            generator.reset();
+            pset = copy_point_set(input);
+            generator.reset(new HypothesisGenerator(pset));
+        }, [&]() {
+            generator->refine_planes();
+            return num_points;
+        }));
+
+        rows.push_back(measure(name, "AlphaShapeMesh::apply", repetitions, "points", nullptr, [&]() {
+            double num = 0.0;
+            for (std::size_t i = 0; i < pset->groups().size(); ++i) {
+                Map::Ptr mesh = AlphaShapeMesh::apply(pset->groups()[i], static_cast<float>(spacing * 5.0));
+                num += pset->groups()[i]->size();
+            }
+            return num;
+        }));
+
+        // ______________________ the pipeline ________________________________
+
+        std::map< std::string, std::vector<double> > stage_times;
+        std::vector<double> times;
+        double num_candidate_faces = 0.0;
+        Map::Ptr candidates;
+        for (int rep = 0; rep < repetitions; ++rep) {
+            generator.reset();
+            candidates = nil;
+            pset = copy_point_set(input);
+            generator.reset(new HypothesisGenerator(pset));
+            Profiler::reset();
+
+            StopWatch w;
+            generator->refine_planes();
+            candidates = generator->generate();
+            if (!candidates) {
+                Logger::err("-") << "failed generating candidate faces of " << name << std::endl;
+                return;
+            }
+            generator->compute_confidences(candidates, false);
+            generator->extract_adjacency(candidates);
+            times.push_back(w.elapsed());
+            collect_stages(stage_times);
+            num_candidate_faces = candidates->size_of_facets();
+        }
+        rows.push_back(make_row(name, "pipeline (candidate faces)", times, num_points, "points"));
+        for (std::map< std::string, std::vector<double> >::const_iterator it = stage_times.begin(); it != stage_times.end(); ++it) {
+            // the stages on the faces are measured in faces
+            const bool faces = it->first.find("generate") == 0 || it->first.find("extract_adjacency") == 0 || it->first.find("compute_facet_confidences") != std::string::npos;
+            rows.push_back(make_row(name, it->first, it->second, faces ? num_candidate_faces : num_points, faces ? "faces" : "points"));
+            std::cout << "    " << it->first << ": " << rows.back().mean_time << " sec" << std::endl;
+        }
+        if (!generator->save_checkpoint(candidates, checkpoint_file)) {
+            Logger::err("-") << "failed saving the candidate faces of " << name << std::endl;
+            return;
+        }
+
+        // ______________________ face selection ______________________________
+
+        // the candidate faces are restored before each run (the face selection deletes the faces not selected)
+        Map::Ptr mesh;
+        std::unique_ptr<HypothesisGenerator::Adjacency> adjacency;
+        auto load_candidates = [&]() {
+            adjacency.reset();
+            mesh = generator->load_checkpoint(checkpoint_file);
+        };
+        rows.push_back(measure(name, "extract_adjacency", repetitions, "faces", load_candidates, [&]() {
+            adjacency.reset(new HypothesisGenerator::Adjacency(generator->extract_adjacency(mesh)));
+            return num_candidate_faces;
+        }));
+
+        std::vector<LinearProgramSolver::SolverName> solvers;
+#ifdef HAS_GUROBI
+        solvers.push_back(LinearProgramSolver::GUROBI);
+#endif
+#ifdef HAS_HIGHS
+        solvers.push_back(LinearProgramSolver::HIGHS);
+#endif
+#ifdef HAS_ORTOOLS
+        solvers.push_back(LinearProgramSolver::CPSAT);
+#endif
+        solvers.push_back(LinearProgramSolver::SCIP);
+        solvers.push_back(LinearProgramSolver::GLPK);
+        solvers.push_back(LinearProgramSolver::LPSOLVE);
+        // each solver with the original and the tighter formulation of the sharp edges (see Method::tight_sharp_edges)
+        const bool tight_sharp_edges = Method::tight_sharp_edges;
+        for (std::size_t s = 0; s < solvers.size(); ++s) {
+            for (int tight = 0; tight < 2; ++tight) {
+                Method::tight_sharp_edges = (tight != 0);
+                const std::string label = solver_name(solvers[s]) + (tight ? ", tight" : "");
+
+                // the time of optimize() without the solves is the building of the binary program
+                std::vector<double> optimize_times, build_times;
+                for (int rep = 0; rep < repetitions; ++rep) {
+                    load_candidates();
+                    adjacency.reset(new HypothesisGenerator::Adjacency(generator->extract_adjacency(mesh)));
+                    Profiler::reset();
+                    StopWatch w;
+                    FaceSelection selector(pset, mesh);
+                    selector.optimize(*adjacency, solvers[s]);
+                    optimize_times.push_back(w.elapsed());
+
+                    double solve_time = 0.0;
+                    const std::vector<Profiler::Stage>& stages = Profiler::stages();
+                    for (std::size_t i = 0; i < stages.size(); ++i) {
+                        if (stages[i].name == "solve" && stages[i].finished)
+                            solve_time += stages[i].wall_time;
+                    }
+                    build_times.push_back(std::max(optimize_times.back() - solve_time, 0.0));
+                }
+                rows.push_back(make_row(name, "FaceSelection::optimize (" + label + ")", optimize_times, num_candidate_faces, "faces"));
+                rows.push_back(make_row(name, "FaceSelection::optimize (" + label + ")/build model", build_times, num_candidate_faces, "faces"));
+                std::cout << "    " << rows[rows.size() - 2].benchmark << ": " << rows[rows.size() - 2].mean_time << " sec, of which building the model: " << rows.back().mean_time << " sec" << std::endl;
+            }
+        }
+        Method::tight_sharp_edges = tight_sharp_edges;
+
+        // ______________________ mesh I/O ____________________________________
+
+        adjacency.reset();
+        mesh = generator->load_checkpoint(checkpoint_file);
+        FileUtils::delete_file(checkpoint_file);
+        rows.push_back(measure(name, "save obj", repetitions, "faces", nullptr, [&]() {
+            MapIO::save(obj_file, mesh);
+            return num_candidate_faces;
+        }));
+        rows.push_back(measure(name, "read obj", repetitions, "faces", nullptr, [&]() {
+            Map::Ptr m = MapIO::read(obj_file);
+            return num_candidate_faces;
+        }));
+        FileUtils::delete_file(obj_file);
+    }
+
+
+    std::string json_string(const std::string& str) {
+        std::string result = "\"";
+        for (std::size_t i = 0; i < str.size(); ++i) {
+            if (str[i] == '"' || str[i] == '\\')
+                result += '\\';
+            result += str[i];
+        }
+        return result + "\"";
+    }
+
+
+    void write_csv(std::ostream& output, const std::vector<Row>& rows) {
+        output << "input,benchmark,iterations,mean_time,min_time,items,unit,throughput" << std::endl;
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            const Row& r = rows[i];
+            output << r.input << "," << r.benchmark << "," << r.iterations << "," << r.mean_time << "," << r.min_time << ","
+                << r.items << "," << r.unit << "," << r.throughput() << std::endl;
+        }
+    }
+
+
+    void write_json(std::ostream& output, const std::vector<Row>& rows) {
+        output << "[" << std::endl;
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            const Row& r = rows[i];
+            output << "  { \"input\": " << json_string(r.input)
+                << ", \"benchmark\": " << json_string(r.benchmark)
+                << ", \"iterations\": " << r.iterations
+                << ", \"mean_time\": " << r.mean_time
+                << ", \"min_time\": " << r.min_time
+                << ", \"items\": " << r.items
+                << ", \"unit\": " << json_string(r.unit)
+                << ", \"throughput\": " << r.throughput() << " }" << (i + 1 < rows.size() ? "," : "") << std::endl;
+        }
+        output << "]" << std::endl;
+    }
+
+
+    bool parse_options(int argc, char **argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0) {
+                options.inputs.push_back(arg);
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "missing value of option " << arg << std::endl;
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--repetitions")
+                options.repetitions = std::max(std::atoi(value.c_str()), 1);
+            else if (arg == "--synthetic")
+                options.synthetic_points = static_cast<std::size_t>(std::max(std::atol(value.c_str()), 0L));
+            else if (arg == "--planes")
+                options.synthetic_planes = static_cast<std::size_t>(std::max(std::atol(value.c_str()), 1L));
+            else if (arg == "--report")
+                options.report_file = value;
+            else if (arg == "--work")
+                options.work_directory = value;
+            else {
+                std::cerr << "unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+
+int main(int argc, char **argv)
+{
+    // initialize the logger (this is not optional)
+    Logger::initialize();
+
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [input.bvg ...] [--repetitions N] [--synthetic num_points] [--planes N] [--report report.csv | report.json] [--work directory]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.inputs.empty()) {
+        options.inputs.push_back(std::string(POLYFIT_CODE_DIR) + "/../data/toy_data.bvg");
+        options.inputs.push_back(std::string(POLYFIT_CODE_DIR) + "/../data/sphere.bvg");
+    }
+
+    std::vector<Row> rows;
+    for (std::size_t i = 0; i < options.inputs.size(); ++i) {
+        PointSet::Ptr pset = PointSetIO::read(options.inputs[i]);
+        if (!pset) {
+            std::cerr << "failed loading point cloud from file: " << options.inputs[i] << std::endl;
+            continue;
+        }
+        if (pset->groups().empty())
+            PlaneDetector::detect(pset, PlaneDetector::Parameters(), Method::num_threads);
+        benchmark(FileUtils::simple_name(options.inputs[i]), pset, options, rows);
+    }
+    if (options.synthetic_points > 0) {
+        SyntheticScene::Parameters params;
+        params.num_points = options.synthetic_points;
+        params.num_planes = options.synthetic_planes;
+        PointSet::Ptr pset = SyntheticScene::generate(params);
+        benchmark("synthetic (" + std::to_string(options.synthetic_planes) + " planes, " + std::to_string(options.synthetic_points) + " points)", pset, options, rows);
+    }
+
+    if (options.report_file.empty()) {
+        write_csv(std::cout, rows);
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream output(options.report_file.c_str());
+    if (output.fail()) {
+        std::cerr << "could not create file: " << options.report_file << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (FileUtils::extension_in_lower_case(options.report_file) == "json")
+        write_json(output, rows);
+    else
+        write_csv(output, rows);
+    std::cout << "benchmark report saved to file: " << options.report_file << std::endl;
+    return EXIT_SUCCESS;
+};
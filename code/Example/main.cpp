@@ -19,13 +19,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 
 #include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/tracer.h"
 #include "../model/point_set.h"
 #include "../model/map.h"
 #include "../method/method_global.h"
 #include "../method/hypothesis_generator.h"
 #include "../method/face_selection.h"
 #include "../model/map_io.h"
+#include "../model/map_facet_merger.h"
 #include "../model/point_set_io.h"
+#include "../model/plane_detector.h"
 
 
 int main(int argc, char **argv)
@@ -37,6 +41,12 @@ int main(int argc, char **argv)
     const std::string input_file = (argc > 1) ? argv[1] : std::string(POLYFIT_CODE_DIR) + "/../data/toy_data.bvg";
     // output mesh file name
     const std::string output_file = (argc > 2) ? argv[2] : std::string(POLYFIT_CODE_DIR) + "/../data/toy_data-result.obj";
+    // (optional) file name of the profiling report (in JSON format)
+    const std::string profile_file = (argc > 3) ? argv[3] : std::string();
+    // (optional) file name of the timeline of the threads (in the Chrome trace format, see Tracer)
+    const std::string trace_file = (argc > 4) ? argv[4] : std::string();
+    if (!trace_file.empty())
+        Tracer::set_enabled(true);
 
     // below are the default parameters (change these when necessary)
     Method::lambda_data_fitting = 0.43;
@@ -50,6 +60,12 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    // the planar segments are detected if the point cloud doesn't have them
+    if (pset->groups().empty()) {
+        std::cout << "detecting planar segments..." << std::endl;
+        PlaneDetector::detect(pset, PlaneDetector::Parameters(), Method::num_threads);
+    }
+
     // step 1: refine planes
     std::cout << "refining planes..." << std::endl;
     const std::vector<VertexGroup::Ptr>& groups = pset->groups();
@@ -81,6 +97,13 @@ int main(int argc, char **argv)
     // now we don't need the point cloud anymore, and it can be deleted
     delete pset;
 
+    // the faces of the same plane as larger polygons (optional)
+    if (Method::merge_coplanar_faces) {
+        Map* merged = MapFacetMerger::merged(mesh);
+        delete mesh;
+        mesh = merged;
+    }
+
     // step 4: save result to file
     if (MapIO::save(output_file, mesh))
         std::cout << "reconstructed model saved to file: " << output_file << std::endl;
@@ -89,6 +112,20 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    // the time, memory, and counters of all the stages
+    if (!profile_file.empty()) {
+        if (Profiler::save_json(profile_file))
+            std::cout << "profiling report saved to file: " << profile_file << std::endl;
+        else
+            std::cerr << "failed saving profiling report to file: " << profile_file << std::endl;
+    }
+    if (!trace_file.empty()) {
+        if (Tracer::save_json(trace_file))
+            std::cout << "timeline saved to file: " << trace_file << std::endl;
+        else
+            std::cerr << "failed saving timeline to file: " << trace_file << std::endl;
+    }
+
     return EXIT_SUCCESS;
 };
 
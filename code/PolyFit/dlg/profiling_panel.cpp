@@ -0,0 +1,417 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "profiling_panel.h"
+
+#include <QPainter>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QHelpEvent>
+#include <QToolTip>
+
+#include "../basic/memory_usage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+
+
+namespace {
+
+	// a distinct and stable color for each stage name
+	QColor stageColor(const std::string& name) {
+		unsigned int hash = 0;
+		for (std::size_t i = 0; i < name.size(); ++i)
+			hash = hash * 31 + static_cast<unsigned char>(name[i]);
+		return QColor::fromHsv(static_cast<int>(hash % 360), 120, 230);
+	}
+
+	double counterValue(const Profiler::Stage& stage, const std::string& name, double default_value = -1.0) {
+		for (std::size_t i = 0; i < stage.counters.size(); ++i) {
+			if (stage.counters[i].first == name)
+				return stage.counters[i].second;
+		}
+		return default_value;
+	}
+
+	QString secondsText(double sec) {
+		return QString::number(sec, 'f', sec < 10.0 ? 3 : 1);
+	}
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+// the finished stages as bars over time, a row for each thread and nesting depth
+class TimelineView : public QWidget
+{
+public:
+	TimelineView(QWidget* parent) : QWidget(parent) {
+		setMinimumHeight(120);
+		setMouseTracking(true);
+	}
+
+	void setStages(const std::vector<Profiler::Stage>& stages) {
+		stages_.clear();
+		rows_.clear();
+		start_ = std::numeric_limits<double>::max();
+		end_ = -std::numeric_limits<double>::max();
+		for (std::size_t i = 0; i < stages.size(); ++i) {
+			const Profiler::Stage& s = stages[i];
+			if (!s.finished)
+				continue;
+			stages_.push_back(s);
+			start_ = std::min(start_, s.start_wall_time);
+			end_ = std::max(end_, s.start_wall_time + s.wall_time);
+			rows_[std::make_pair(s.thread, s.depth)] = 0;
+		}
+		int row = 0;
+		for (std::map<std::pair<std::size_t, int>, int>::iterator pos = rows_.begin(); pos != rows_.end(); ++pos)
+			pos->second = row++;
+		update();
+	}
+
+protected:
+	virtual void paintEvent(QPaintEvent*) {
+		QPainter painter(this);
+		painter.fillRect(rect(), palette().base());
+		if (stages_.empty()) {
+			painter.drawText(rect(), Qt::AlignCenter, "no stages recorded");
+			return;
+		}
+
+		const double duration = std::max(end_ - start_, 1e-6);
+		painter.drawText(QRect(0, height() - kAxisHeight, width() - kMargin, kAxisHeight), 
+			Qt::AlignRight | Qt::AlignVCenter, secondsText(duration) + " sec");
+		painter.drawText(QRect(kMargin, height() - kAxisHeight, width(), kAxisHeight), 
+			Qt::AlignLeft | Qt::AlignVCenter, "0");
+
+		for (std::size_t i = 0; i < stages_.size(); ++i) {
+			QRectF bar = barRect(i);
+			painter.fillRect(bar, stageColor(stages_[i].name));
+			painter.setPen(palette().color(QPalette::Mid));
+			painter.drawRect(bar);
+			painter.setPen(palette().color(QPalette::Text));
+			QString label = QString::fromStdString(stages_[i].name);
+			if (painter.fontMetrics().width(label) + 4 < bar.width())
+				painter.drawText(bar, Qt::AlignCenter, label);
+		}
+	}
+
+	virtual bool event(QEvent* e) {
+		if (e->type() == QEvent::ToolTip) {
+			QHelpEvent* help = static_cast<QHelpEvent*>(e);
+			for (std::size_t i = stages_.size(); i > 0; --i) {	// the inner stages are recorded last
+				const Profiler::Stage& s = stages_[i - 1];
+				if (barRect(i - 1).contains(help->pos())) {
+					QToolTip::showText(help->globalPos(), QString("%1\nthread %2: %3 sec (CPU %4 sec)")
+						.arg(QString::fromStdString(s.name)).arg(s.thread).arg(secondsText(s.wall_time)).arg(secondsText(s.cpu_time)));
+					return true;
+				}
+			}
+			QToolTip::hideText();
+			e->ignore();
+			return true;
+		}
+		return QWidget::event(e);
+	}
+
+private:
+	QRectF barRect(std::size_t i) const {
+		const Profiler::Stage& s = stages_[i];
+		const double duration = std::max(end_ - start_, 1e-6);
+		const double w = width() - 2 * kMargin;
+		const double h = std::min(double(kRowHeight), double(height() - kAxisHeight - kMargin) / std::max(std::size_t(1), rows_.size()));
+		const int row = rows_.find(std::make_pair(s.thread, s.depth))->second;
+		double x = kMargin + w * (s.start_wall_time - start_) / duration;
+		double length = std::max(1.0, w * s.wall_time / duration);
+		return QRectF(x, kMargin + row * h, length, h - 2);
+	}
+
+private:
+	enum { kMargin = 4, kRowHeight = 22, kAxisHeight = 18 };
+
+	std::vector<Profiler::Stage> stages_;
+	std::map<std::pair<std::size_t, int>, int> rows_;	// (thread, depth) -> row
+	double start_;
+	double end_;
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+// the incumbent (blue) and the bound (red) of a search over time
+class SearchPlot : public QWidget
+{
+public:
+	struct Sample {
+		double	time;
+		bool	has_incumbent;
+		double	incumbent;
+		bool	has_bound;
+		double	bound;
+	};
+
+	SearchPlot(QWidget* parent) : QWidget(parent) { setMinimumHeight(120); }
+
+	void clear() { samples_.clear(); update(); }
+	void add(const Sample& s) { samples_.push_back(s); update(); }
+
+protected:
+	virtual void paintEvent(QPaintEvent*) {
+		QPainter painter(this);
+		painter.fillRect(rect(), palette().base());
+
+		double t_max = 1e-6;
+		double y_min = std::numeric_limits<double>::max();
+		double y_max = -std::numeric_limits<double>::max();
+		for (std::size_t i = 0; i < samples_.size(); ++i) {
+			const Sample& s = samples_[i];
+			t_max = std::max(t_max, s.time);
+			if (s.has_incumbent) {
+				y_min = std::min(y_min, s.incumbent);
+				y_max = std::max(y_max, s.incumbent);
+			}
+			if (s.has_bound && std::abs(s.bound) < 1e20) {	// not the infinite bound of the start
+				y_min = std::min(y_min, s.bound);
+				y_max = std::max(y_max, s.bound);
+			}
+		}
+		if (y_min > y_max) {
+			painter.drawText(rect(), Qt::AlignCenter, "no search progress reported");
+			return;
+		}
+		if (y_max - y_min < 1e-9 * std::max(1.0, std::abs(y_max))) {
+			y_min -= 0.5;
+			y_max += 0.5;
+		}
+
+		const QRectF area(kMargin, kMargin, width() - 2 * kMargin, height() - 2 * kMargin - kAxisHeight);
+		painter.setPen(palette().color(QPalette::Text));
+		painter.drawText(QRect(kMargin, 0, width(), kAxisHeight), Qt::AlignLeft | Qt::AlignVCenter, QString::number(y_max, 'g', 8));
+		painter.drawText(QRect(kMargin, height() - kAxisHeight, width(), kAxisHeight), Qt::AlignLeft | Qt::AlignVCenter, QString::number(y_min, 'g', 8));
+		painter.drawText(QRect(0, height() - kAxisHeight, width() - kMargin, kAxisHeight), Qt::AlignRight | Qt::AlignVCenter, secondsText(t_max) + " sec");
+
+		painter.setRenderHint(QPainter::Antialiasing);
+		for (int curve = 0; curve < 2; ++curve) {
+			QPolygonF line;
+			for (std::size_t i = 0; i < samples_.size(); ++i) {
+				const Sample& s = samples_[i];
+				bool has = curve == 0 ? s.has_incumbent : (s.has_bound && std::abs(s.bound) < 1e20);
+				if (!has)
+					continue;
+				double y = curve == 0 ? s.incumbent : s.bound;
+				line << QPointF(area.left() + area.width() * s.time / t_max, area.bottom() - area.height() * (y - y_min) / (y_max - y_min));
+			}
+			painter.setPen(QPen(curve == 0 ? Qt::blue : Qt::red, 1.5));
+			painter.drawPolyline(line);
+		}
+	}
+
+private:
+	enum { kMargin = 4, kAxisHeight = 18 };
+
+	std::vector<Sample> samples_;
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+// the number of fans (of the candidate faces) of each size
+class FanHistogram : public QWidget
+{
+public:
+	FanHistogram(QWidget* parent) : QWidget(parent) { setMinimumHeight(120); }
+
+	void setCounts(const std::map<int, double>& counts) { counts_ = counts; update(); }
+
+protected:
+	virtual void paintEvent(QPaintEvent*) {
+		QPainter painter(this);
+		painter.fillRect(rect(), palette().base());
+		if (counts_.empty()) {
+			painter.drawText(rect(), Qt::AlignCenter, "no candidate faces");
+			return;
+		}
+
+		// by the logarithm of the counts, as the fans of two faces overwhelm the others
+		double max_height = 0;
+		for (std::map<int, double>::const_iterator pos = counts_.begin(); pos != counts_.end(); ++pos)
+			max_height = std::max(max_height, std::log10(1.0 + pos->second));
+
+		const double slot = double(width() - 2 * kMargin) / counts_.size();
+		const double area_height = height() - 2 * kLabelHeight - kMargin;
+		int i = 0;
+		for (std::map<int, double>::const_iterator pos = counts_.begin(); pos != counts_.end(); ++pos, ++i) {
+			double h = area_height * std::log10(1.0 + pos->second) / std::max(max_height, 1e-6);
+			QRectF bar(kMargin + i * slot + 0.1 * slot, kLabelHeight + area_height - h, 0.8 * slot, h);
+			painter.fillRect(bar, pos->first == 2 ? QColor(120, 180, 120) : QColor(200, 120, 100));
+			painter.setPen(palette().color(QPalette::Text));
+			painter.drawText(QRectF(bar.left() - 0.1 * slot, bar.top() - kLabelHeight, slot, kLabelHeight), Qt::AlignCenter, QString::number(pos->second, 'f', 0));
+			painter.drawText(QRectF(bar.left() - 0.1 * slot, height() - kLabelHeight, slot, kLabelHeight), Qt::AlignCenter, QString::number(pos->first));
+		}
+	}
+
+private:
+	enum { kMargin = 4, kLabelHeight = 16 };
+
+	std::map<int, double> counts_;	// size -> number of fans
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+ProfilingPanel::ProfilingPanel(QWidget *parent)
+	: QTabWidget(parent)
+{
+	timeline_ = new TimelineView(this);
+	addTab(timeline_, tr("Timeline"));
+
+	stageTree_ = new QTreeWidget(this);
+	stageTree_->setColumnCount(5);
+	stageTree_->setHeaderLabels(QStringList() << tr("Stage") << tr("Wall (sec)") << tr("CPU (sec)") << tr("Memory") << tr("Counters"));
+	stageTree_->header()->setStretchLastSection(true);
+	addTab(stageTree_, tr("Stages"));
+
+	searchPlot_ = new SearchPlot(this);
+	searchPlot_->setToolTip(tr("The incumbent (blue) and the bound (red) of the last search of the face selection"));
+	addTab(searchPlot_, tr("Solver"));
+
+	QWidget* hypothesis = new QWidget(this);
+	QVBoxLayout* layout = new QVBoxLayout;
+	hypothesisLabel_ = new QLabel(hypothesis);
+	hypothesisLabel_->setTextInteractionFlags(Qt::TextSelectableByMouse);
+	fanHistogram_ = new FanHistogram(hypothesis);
+	fanHistogram_->setToolTip(tr("The number of edges shared by 1, 2, 3... candidate faces"));
+	layout->addWidget(hypothesisLabel_);
+	layout->addWidget(fanHistogram_, 1);
+	hypothesis->setLayout(layout);
+	addTab(hypothesis, tr("Hypothesis"));
+
+	searchTimer_.start();
+	updateStages();
+}
+
+
+void ProfilingPanel::updateStages() {
+	const std::vector<Profiler::Stage>& stages = Profiler::stages();
+	timeline_->setStages(stages);
+
+	// nested by their depths within each thread
+	stageTree_->clear();
+	std::map<std::size_t, std::vector<QTreeWidgetItem*> > parents;	// thread -> the items of each depth
+	for (std::size_t i = 0; i < stages.size(); ++i) {
+		const Profiler::Stage& s = stages[i];
+		if (!s.finished)
+			continue;
+
+		QStringList counters;
+		for (std::size_t j = 0; j < s.counters.size(); ++j)
+			counters << QString("%1: %2").arg(QString::fromStdString(s.counters[j].first)).arg(s.counters[j].second, 0, 'g', 10);
+		QStringList columns;
+		columns << QString::fromStdString(s.name) << secondsText(s.wall_time) << secondsText(s.cpu_time)
+			<< QString::fromStdString(MemoryUsage::to_string(s.peak_memory_increase)) << counters.join(", ");
+
+		std::vector<QTreeWidgetItem*>& stack = parents[s.thread];
+		stack.resize(std::min(stack.size(), std::size_t(s.depth)));
+		QTreeWidgetItem* item = stack.empty() ? new QTreeWidgetItem(stageTree_, columns) : new QTreeWidgetItem(stack.back(), columns);
+		item->setToolTip(4, counters.join("\n"));
+		stack.push_back(item);
+	}
+	stageTree_->expandAll();
+	for (int i = 0; i < 4; ++i)
+		stageTree_->resizeColumnToContents(i);
+
+	updateHypothesis(stages);
+}
+
+
+void ProfilingPanel::updateHypothesis(const std::vector<Profiler::Stage>& stages) {
+	// the candidate faces of the last hypothesis, and the adjacency extracted from them first (the 
+	// later ones are of the selected faces)
+	std::size_t generate = stages.size();
+	for (std::size_t i = stages.size(); i > 0; --i) {
+		const Profiler::Stage& s = stages[i - 1];
+		if (s.finished && (s.name == "generate" || s.name == "generate_implicit")) {
+			generate = i - 1;
+			break;
+		}
+	}
+
+	std::map<int, double> fans;
+	QStringList lines;
+	if (generate < stages.size()) {
+		const Profiler::Stage& g = stages[generate];
+		const char* counters[] = { "candidate faces", "faces created", "cuts", "triplets computed", "proxy faces" };
+		// the counters of the stages nested in it
+		for (std::size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); ++c) {
+			double value = counterValue(g, counters[c]);
+			for (std::size_t i = generate + 1; value < 0 && i < stages.size() && !(stages[i].thread == g.thread && stages[i].depth <= g.depth); ++i) {
+				if (stages[i].thread == g.thread)
+					value = counterValue(stages[i], counters[c]);
+			}
+			if (value >= 0)
+				lines << QString("#%1: %2").arg(counters[c]).arg(value, 0, 'f', 0);
+		}
+
+		for (std::size_t i = generate + 1; i < stages.size(); ++i) {
+			const Profiler::Stage& s = stages[i];
+			if (!s.finished || s.name != "extract_adjacency")
+				continue;
+			const std::string prefix = "fans of size ";
+			for (std::size_t j = 0; j < s.counters.size(); ++j) {
+				if (s.counters[j].first.compare(0, prefix.size(), prefix) == 0)
+					fans[atoi(s.counters[j].first.c_str() + prefix.size())] = s.counters[j].second;
+			}
+			double super_edges = counterValue(s, "super edges");
+			if (super_edges >= 0)
+				lines << QString("#super edges: %1").arg(super_edges, 0, 'f', 0);
+			break;
+		}
+	}
+
+	hypothesisLabel_->setText(lines.isEmpty() ? tr("no candidate faces generated") : lines.join("\n"));
+	fanHistogram_->setCounts(fans);
+}
+
+
+void ProfilingPanel::clearSearch() {
+	searchPlot_->clear();
+	searchTimer_.restart();
+}
+
+
+void ProfilingPanel::addSearchProgress(bool has_incumbent, double incumbent, bool has_bound, double bound) {
+	SearchPlot::Sample s;
+	s.time = searchTimer_.elapsed() * 0.001;
+	s.has_incumbent = has_incumbent;
+	s.incumbent = incumbent;
+	s.has_bound = has_bound;
+	s.bound = bound;
+	searchPlot_->add(s);
+}
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PROFILING_PANEL_H
+#define PROFILING_PANEL_H
+
+#include <QTabWidget>
+#include <QElapsedTimer>
+
+#include "../basic/profiler.h"
+
+#include <vector>
+
+
+class QTreeWidget;
+class QLabel;
+
+// the bar chart of the timeline, the search curves and the fan histogram (see profiling_panel.cpp)
+class TimelineView;
+class SearchPlot;
+class FanHistogram;
+
+
+// Shows the profile of the stages run so far (see Profiler): their timeline (a row per thread and 
+// nesting depth), their wall time, CPU time, memory and counters, the incumbent and the bound of the 
+// last search of the face selection over time, and the sizes of the candidate faces (including the 
+// histogram of the sizes of the fans, i.e., of the number of faces sharing each edge).
+class ProfilingPanel : public QTabWidget
+{
+	Q_OBJECT
+
+public:
+	ProfilingPanel(QWidget *parent = 0);
+	~ProfilingPanel() {}
+
+public Q_SLOTS:
+	// reloads the stages from the profiler (e.g., once a stage completes)
+	void updateStages();
+
+	// starts a new search curve
+	void clearSearch();
+	// appends a sample to the search curve (the time is taken when it is received). It can be invoked 
+	// from any thread with a queued connection (see FaceSelection::set_search_callback()).
+	void addSearchProgress(bool has_incumbent, double incumbent, bool has_bound, double bound);
+
+private:
+	void updateHypothesis(const std::vector<Profiler::Stage>& stages);
+
+private:
+	TimelineView*	timeline_;
+	QTreeWidget*	stageTree_;
+	SearchPlot*		searchPlot_;
+	QLabel*			hypothesisLabel_;
+	FanHistogram*	fanHistogram_;
+
+	QElapsedTimer	searchTimer_;
+};
+
+#endif // PROFILING_PANEL_H
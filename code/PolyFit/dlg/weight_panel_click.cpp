@@ -47,6 +47,7 @@ static float area_of_triangle(QPointF a, QPointF b, QPointF c) {
 WeightPanelClick::WeightPanelClick(QWidget *parent)
 	: QDialog(parent)
 	, triangle_(3)
+	, clicked_(false)
 {
 	setupUi(this);
 
@@ -114,7 +115,8 @@ void WeightPanelClick::mousePressEvent(QMouseEvent* event)
 {
 	QPointF p = event->pos();
 
-	if (triangle_.containsPoint(p, Qt::OddEvenFill)) {
+	clicked_ = triangle_.containsPoint(p, Qt::OddEvenFill);
+	if (clicked_) {
 		pos_ = p;
 		computeWeight();
 		update();
@@ -156,6 +158,17 @@ void WeightPanelClick::mouseMoveEvent(QMouseEvent* event)
 }
 
 
+void WeightPanelClick::mouseReleaseEvent(QMouseEvent* event)
+{
+	if (clicked_) {
+		clicked_ = false;
+		emit weights_chosen();
+	}
+
+	QWidget::mouseReleaseEvent(event);
+}
+
+
 void WeightPanelClick::computeWeight() {
 	float area_sum = area_of_triangle(pos_fitting_, pos_coverage_, pos_complexity_);
 
@@ -39,6 +39,7 @@ public:
 
 	virtual void mousePressEvent(QMouseEvent *);
 	virtual void mouseMoveEvent(QMouseEvent *);
+	virtual void mouseReleaseEvent(QMouseEvent *);
 
 	void computeWeight();
 
@@ -47,6 +48,8 @@ public Q_SLOTS:
 
 Q_SIGNALS:
 	void weights_changed();
+	// the mouse is released after a click that changed the weights
+	void weights_chosen();
 
 private:
 	MainWindow*  mainWindow_;
@@ -61,6 +64,8 @@ private:
 
 	QPointF  pos_;
 	QPolygonF triangle_;
+
+	bool	 clicked_;	// the weights were changed by the last press
 };
 
 #endif // WEIGHT_PANEL_CLICK_H
@@ -34,6 +34,10 @@ WeightPanelManual::WeightPanelManual(QWidget *parent)
 	setupUi(this);
 	mainWindow_ = dynamic_cast<MainWindow*>(parent);
 	updateUI();
+
+	connect(lineEditFitting, SIGNAL(editingFinished()), this, SLOT(applyWeights()));
+	connect(lineEditCoverage, SIGNAL(editingFinished()), this, SLOT(applyWeights()));
+	connect(lineEditComplexity, SIGNAL(editingFinished()), this, SLOT(applyWeights()));
 }
 
 
@@ -56,4 +60,15 @@ void WeightPanelManual::updateWeights() {
 	Method::lambda_data_fitting = lineEditFitting->text().toFloat();
 	Method::lambda_model_coverage = lineEditCoverage->text().toFloat();
 	Method::lambda_model_complexity = lineEditComplexity->text().toFloat();
-}
\ No newline at end of file
+}
+
+
+void WeightPanelManual::applyWeights() {
+	// 'editingFinished' is also emitted when an unchanged field loses the focus
+	double fitting = Method::lambda_data_fitting;
+	double coverage = Method::lambda_model_coverage;
+	double complexity = Method::lambda_model_complexity;
+	updateWeights();
+	if (fitting != Method::lambda_data_fitting || coverage != Method::lambda_model_coverage || complexity != Method::lambda_model_complexity)
+		emit weights_chosen();
+}
@@ -39,6 +39,13 @@ public:
 public Q_SLOTS:
 	void updateUI();
 
+Q_SIGNALS:
+	// the weights were edited (and are already set)
+	void weights_chosen();
+
+private Q_SLOTS:
+	void applyWeights();
+
 private:
 	MainWindow*  mainWindow_;
 };
@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "gpu_compute_context.h"
+
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+#include <QThread>
+
+#include "../basic/logger.h"
+
+#include <algorithm>
+
+
+GpuComputeContext::GpuComputeContext()
+	: surface_(0)
+	, context_(0)
+	, thread_(0)
+	, failed_(false)
+{
+	// the surface must be created in the GUI thread, the context is created by the thread using it
+	QSurfaceFormat format;
+	format.setVersion(4, 3);
+	format.setProfile(QSurfaceFormat::CoreProfile);
+	surface_ = new QOffscreenSurface;
+	surface_->setFormat(format);
+	surface_->create();
+}
+
+
+GpuComputeContext::~GpuComputeContext() {
+	// the resources are released with the context
+	delete context_;
+	delete surface_;
+}
+
+
+bool GpuComputeContext::is_supported() {
+	return GLEW_VERSION_4_3 != 0;
+}
+
+
+bool GpuComputeContext::make_current(bool& created) {
+	created = false;
+	if (failed_)
+		return false;
+
+	if (context_ && thread_ != QThread::currentThread()) {
+		delete context_;
+		context_ = 0;
+	}
+	if (context_)
+		return context_->makeCurrent(surface_);
+
+	context_ = new QOpenGLContext;
+	context_->setFormat(surface_->format());
+	thread_ = QThread::currentThread();
+	if (!context_->create() || !context_->makeCurrent(surface_)) {
+		Logger::warn("-") << "failed creating an OpenGL context for the compute shaders" << std::endl;
+		failed_ = true;
+		return false;
+	}
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK || !is_supported()) {
+		Logger::warn("-") << "compute shaders are not supported (OpenGL 4.3 is required)" << std::endl;
+		failed_ = true;
+		context_->doneCurrent();
+		return false;
+	}
+	created = true;
+	return true;
+}
+
+
+void GpuComputeContext::done_current() {
+	if (context_)
+		context_->doneCurrent();
+}
+
+
+GLuint GpuComputeContext::create_program(const char* source, const char* name) {
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &source, 0);
+	glCompileShader(shader);
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE) {
+		char log[1024] = { 0 };
+		glGetShaderInfoLog(shader, sizeof(log) - 1, 0, log);
+		Logger::warn("-") << "failed compiling the " << name << " shader: " << log << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		Logger::warn("-") << "failed linking the " << name << " shader" << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+
+void GpuComputeContext::upload(GLuint buffer, int binding, const void* data, std::size_t bytes) {
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	// the buffers can't be empty
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<std::size_t>(bytes, 16), bytes > 0 ? data : 0, GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef GPU_COMPUTE_CONTEXT_H
+#define GPU_COMPUTE_CONTEXT_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+
+class QOpenGLContext;
+class QOffscreenSurface;
+class QThread;
+
+/**
+* An OpenGL 4.3 context for the compute shaders of the pipeline stages. The stages run in
+* worker threads (see JobRunner), so the context is created by the thread using it, and 
+* created again for each new thread (a context can only be current in its own thread).
+* Must be created in the GUI thread.
+*/
+
+class GpuComputeContext
+{
+public:
+	GpuComputeContext();
+	~GpuComputeContext();
+
+	// compute shaders are supported by the current context
+	static bool is_supported();
+
+	// Makes the context current in the calling thread, creating it if needed: 'created' is then
+	// set, and the resources (programs, buffers) of the previous context are lost. Returns false 
+	// if compute shaders can't be used (and fails from then on).
+	bool make_current(bool& created);
+	void done_current();
+
+	// returns 0 if the shader failed compiling (in the current context)
+	static GLuint create_program(const char* source, const char* name);
+
+	// uploads 'bytes' bytes to the shader storage 'buffer' and binds it at 'binding'
+	static void upload(GLuint buffer, int binding, const void* data, std::size_t bytes);
+
+private:
+	QOffscreenSurface*	surface_;
+	QOpenGLContext*		context_;
+	QThread*			thread_;
+	bool				failed_;
+};
+
+
+#endif // GPU_COMPUTE_CONTEXT_H
@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "gpu_facet_point_counter.h"
+
+#include <algorithm>
+
+
+namespace {
+
+	// the number of work groups (i.e., faces) of a dispatch (the minimum limit of OpenGL 4.3)
+	const std::size_t max_work_groups = 65535;
+
+	// A work group per face: the invocations test the points in turn against the bbox of the face
+	// and then with the crossing number test, and their sums are reduced in shared memory.
+	const char* shader_source =
+		"#version 430\n"
+		"layout(local_size_x = 256) in;\n"
+		"layout(std430, binding = 0) readonly buffer Points { vec2 points[]; };\n"
+		"layout(std430, binding = 1) readonly buffer Values { vec2 values[]; };\n"
+		"layout(std430, binding = 2) readonly buffer Corners { vec2 corners[]; };\n"
+		"layout(std430, binding = 3) readonly buffer Offsets { uint offsets[]; };\n"
+		"layout(std430, binding = 4) writeonly buffer Sums { vec2 sums[]; };\n"
+		"uniform uint num_points;\n"
+		"uniform uint first_polygon;\n"
+		"shared vec2 partial[256];\n"
+		"void main() {\n"
+		"	uint k = first_polygon + gl_WorkGroupID.x;\n"
+		"	uint first = offsets[k], last = offsets[k + 1];\n"
+		"	vec2 lo = corners[first], hi = corners[first];\n"
+		"	for (uint c = first + 1; c < last; ++c) {\n"
+		"		lo = min(lo, corners[c]);\n"
+		"		hi = max(hi, corners[c]);\n"
+		"	}\n"
+		"	vec2 sum = vec2(0.0);\n"
+		"	for (uint i = gl_LocalInvocationID.x; i < num_points; i += gl_WorkGroupSize.x) {\n"
+		"		vec2 p = points[i];\n"
+		"		if (any(lessThan(p, lo)) || any(greaterThan(p, hi)))\n"
+		"			continue;\n"
+		"		bool inside = false;\n"
+		"		for (uint c = first, d = last - 1; c < last; d = c++) {\n"
+		"			vec2 a = corners[d], b = corners[c];\n"
+		"			if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)\n"
+		"				inside = !inside;\n"
+		"		}\n"
+		"		if (inside)\n"
+		"			sum += values[i];\n"
+		"	}\n"
+		"	partial[gl_LocalInvocationID.x] = sum;\n"
+		"	barrier();\n"
+		"	for (uint s = gl_WorkGroupSize.x / 2; s > 0; s >>= 1) {\n"
+		"		if (gl_LocalInvocationID.x < s)\n"
+		"			partial[gl_LocalInvocationID.x] += partial[gl_LocalInvocationID.x + s];\n"
+		"		barrier();\n"
+		"	}\n"
+		"	if (gl_LocalInvocationID.x == 0)\n"
+		"		sums[k] = partial[0];\n"
+		"}\n";
+}
+
+
+GpuFacetPointCounter::GpuFacetPointCounter()
+	: program_(0)
+{
+	for (int i = 0; i < 5; ++i)
+		buffers_[i] = 0;
+}
+
+
+bool GpuFacetPointCounter::sum_points_in_polygons(
+	const std::vector<vec2>& points, const std::vector<vec2>& values,
+	const std::vector<vec2>& corners, const std::vector<unsigned int>& offsets,
+	std::vector<vec2>& sums
+) {
+	if (offsets.size() < 2 || points.size() != values.size())
+		return false;
+	std::size_t num_polygons = offsets.size() - 1;
+	sums.assign(num_polygons, vec2(0, 0));
+	if (points.empty())
+		return true;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	bool created = false;
+	if (!context_.make_current(created))
+		return false;
+	if (created) {
+		program_ = GpuComputeContext::create_program(shader_source, "point counting");
+		glGenBuffers(5, buffers_);
+	}
+	if (!program_) {
+		context_.done_current();
+		return false;
+	}
+
+	GpuComputeContext::upload(buffers_[0], 0, points.data(), points.size() * sizeof(vec2));
+	GpuComputeContext::upload(buffers_[1], 1, values.data(), values.size() * sizeof(vec2));
+	GpuComputeContext::upload(buffers_[2], 2, corners.data(), corners.size() * sizeof(vec2));
+	GpuComputeContext::upload(buffers_[3], 3, offsets.data(), offsets.size() * sizeof(unsigned int));
+	GpuComputeContext::upload(buffers_[4], 4, 0, num_polygons * sizeof(vec2));
+
+	glUseProgram(program_);
+	glUniform1ui(glGetUniformLocation(program_, "num_points"), static_cast<GLuint>(points.size()));
+	GLint first_polygon = glGetUniformLocation(program_, "first_polygon");
+	for (std::size_t first = 0; first < num_polygons; first += max_work_groups) {
+		glUniform1ui(first_polygon, static_cast<GLuint>(first));
+		glDispatchCompute(static_cast<GLuint>(std::min(max_work_groups, num_polygons - first)), 1, 1);
+	}
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	// only the sums are read back
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[4]);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, num_polygons * sizeof(vec2), sums.data());
+	glUseProgram(0);
+
+	bool ok = (glGetError() == GL_NO_ERROR);
+	context_.done_current();
+	return ok;
+}
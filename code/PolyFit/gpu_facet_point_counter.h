@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef GPU_FACET_POINT_COUNTER_H
+#define GPU_FACET_POINT_COUNTER_H
+
+#include "gpu_compute_context.h"
+#include "../method/facet_point_counter.h"
+
+#include <mutex>
+
+
+/**
+* Counts the supporting points of the candidate faces with an OpenGL compute shader (OpenGL 4.3),
+* one work group per face. The points, their values, and the faces are uploaded for each segment, 
+* and only the sums of the faces are read back. Must be created in the GUI thread (see 
+* GpuComputeContext).
+*/
+
+class GpuFacetPointCounter : public FacetPointCounter
+{
+public:
+	GpuFacetPointCounter();
+
+	std::string name() const { return "OpenGL compute shader"; }
+
+	bool sum_points_in_polygons(
+		const std::vector<vec2>& points, const std::vector<vec2>& values,
+		const std::vector<vec2>& corners, const std::vector<unsigned int>& offsets,
+		std::vector<vec2>& sums
+	);
+
+private:
+	GpuComputeContext	context_;
+	GLuint				program_;
+	GLuint				buffers_[5];	// the points, the values, the corners, the offsets, and the sums
+	std::mutex			mutex_;
+};
+
+
+#endif // GPU_FACET_POINT_COUNTER_H
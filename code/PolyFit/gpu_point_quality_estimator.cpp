@@ -0,0 +1,254 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "gpu_point_quality_estimator.h"
+#include "../basic/logger.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	const unsigned int max_neighbors = 32;
+	const int max_shells = 16;
+	// the grid has at most this number of cells
+	const double max_cells = double(1 << 25);
+	// the number of points of a dispatch (a work group has 64 invocations)
+	const std::size_t dispatch_size = 64 * 16384;
+
+	const char* shader_source =
+		"#version 430\n"
+		"#define MAX_K 32\n"
+		"layout(local_size_x = 64) in;\n"
+		"layout(std430, binding = 0) readonly buffer Coords { float coords[]; };\n"
+		"layout(std430, binding = 1) readonly buffer Cells { uint cell_start[]; };\n"
+		"layout(std430, binding = 2) readonly buffer Order { uint order[]; };\n"
+		"layout(std430, binding = 3) writeonly buffer Results { vec2 results[]; };\n"
+		"uniform ivec3 dims;\n"
+		"uniform vec3 origin;\n"
+		"uniform float cell_size;\n"
+		"uniform uint num_points;\n"
+		"uniform uint first_point;\n"
+		"uniform int max_shells;\n"
+		"uniform uvec3 sizes;\n"
+		"vec3 point(uint m) { return vec3(coords[3 * m], coords[3 * m + 1], coords[3 * m + 2]); }\n"
+		// the eigenvalues of the symmetric matrix (xx, xy, xz, yy, yz, zz), in ascending order
+		"vec3 eigen_values(float xx, float xy, float xz, float yy, float yz, float zz) {\n"
+		"	float p1 = xy * xy + xz * xz + yz * yz;\n"
+		"	float q = (xx + yy + zz) / 3.0;\n"
+		"	float p2 = (xx - q) * (xx - q) + (yy - q) * (yy - q) + (zz - q) * (zz - q) + 2.0 * p1;\n"
+		"	float p = sqrt(p2 / 6.0);\n"
+		"	if (p <= 0.0)\n"
+		"		return vec3(q);\n"
+		"	float bxx = (xx - q) / p, byy = (yy - q) / p, bzz = (zz - q) / p;\n"
+		"	float bxy = xy / p, bxz = xz / p, byz = yz / p;\n"
+		"	float r = 0.5 * (bxx * (byy * bzz - byz * byz) - bxy * (bxy * bzz - byz * bxz) + bxz * (bxy * byz - byy * bxz));\n"
+		"	float phi = acos(clamp(r, -1.0, 1.0)) / 3.0;\n"
+		"	float e_max = q + 2.0 * p * cos(phi);\n"
+		"	float e_min = q + 2.0 * p * cos(phi + 2.0943951);\n"
+		"	return vec3(e_min, 3.0 * q - e_max - e_min, e_max);\n"
+		"}\n"
+		"void main() {\n"
+		"	uint j = first_point + gl_GlobalInvocationID.x;\n"
+		"	if (j >= num_points)\n"
+		"		return;\n"
+		"	vec3 p = point(j);\n"
+		"	ivec3 c = clamp(ivec3(floor((p - origin) / cell_size)), ivec3(0), dims - 1);\n"
+		"	uint K = max(sizes.x, max(sizes.y, sizes.z));\n"
+		"	float best_d[MAX_K];\n"
+		"	uint best_i[MAX_K];\n"
+		"	uint num = 0;\n"
+		"	vec3 lo = origin + vec3(c) * cell_size;\n"
+		"	vec3 gap = min(p - lo, lo + vec3(cell_size) - p);\n"
+		"	float boundary = max(0.0, min(gap.x, min(gap.y, gap.z)));\n"
+		"	for (int r = 0; r <= max_shells; ++r) {\n"
+		"		for (int z = max(c.z - r, 0); z <= min(c.z + r, dims.z - 1); ++z) {\n"
+		"			for (int y = max(c.y - r, 0); y <= min(c.y + r, dims.y - 1); ++y) {\n"
+		"				bool face = (abs(z - c.z) == r || abs(y - c.y) == r);\n"
+		"				int step = face ? 1 : 2 * r;\n"
+		"				for (int x = c.x - r; x <= c.x + r; x += step) {\n"
+		"					if (x < 0 || x >= dims.x)\n"
+		"						continue;\n"
+		"					uint cell = (uint(z) * uint(dims.y) + uint(y)) * uint(dims.x) + uint(x);\n"
+		"					for (uint m = cell_start[cell]; m < cell_start[cell + 1]; ++m) {\n"
+		"						vec3 v = point(m) - p;\n"
+		"						float d = dot(v, v);\n"
+		"						if (num < K || d < best_d[num - 1]) {\n"
+		"							uint pos = (num < K) ? num++ : K - 1;\n"
+		"							while (pos > 0 && best_d[pos - 1] > d) {\n"
+		"								best_d[pos] = best_d[pos - 1];\n"
+		"								best_i[pos] = best_i[pos - 1];\n"
+		"								--pos;\n"
+		"							}\n"
+		"							best_d[pos] = d;\n"
+		"							best_i[pos] = m;\n"
+		"						}\n"
+		"					}\n"
+		"				}\n"
+		"			}\n"
+		"		}\n"
+		// the points of the next shells are farther than 'reach'
+		"		float reach = float(r) * cell_size + boundary;\n"
+		"		if (num == K && best_d[K - 1] <= reach * reach)\n"
+		"			break;\n"
+		"	}\n"
+		"	vec2 result = vec2(0.0);\n"
+		"	if (num == K) {\n"
+		"		vec3 s = vec3(0.0);\n"
+		"		float xx = 0.0, xy = 0.0, xz = 0.0, yy = 0.0, yz = 0.0, zz = 0.0;\n"
+		"		float spacing = 0.0, conf = 0.0;\n"
+		"		for (uint k = 0; k < K; ++k) {\n"
+		"			vec3 v = point(best_i[k]) - p;\n"
+		"			s += v;\n"
+		"			xx += v.x * v.x; xy += v.x * v.y; xz += v.x * v.z;\n"
+		"			yy += v.y * v.y; yz += v.y * v.z; zz += v.z * v.z;\n"
+		"			if (k < sizes.x)\n"
+		"				spacing += sqrt(best_d[k]);\n"
+		"			for (int t = 0; t < 3; ++t) {\n"
+		"				if (k + 1 != sizes[t])\n"
+		"					continue;\n"
+		"				float n = float(k + 1);\n"
+		"				vec3 m = s / n;\n"
+		"				vec3 e = eigen_values(xx / n - m.x * m.x, xy / n - m.x * m.y, xz / n - m.x * m.z,\n"
+		"					yy / n - m.y * m.y, yz / n - m.y * m.z, zz / n - m.z * m.z);\n"
+		"				if (e.z > 0.0)\n"
+		"					conf += (1.0 - 3.0 * e.x / (e.x + e.y + e.z)) * (e.y / e.z);\n"
+		"			}\n"
+		"		}\n"
+		"		result = vec2(conf / 3.0, spacing / float(sizes.x));\n"
+		"	}\n"
+		"	results[order[j]] = result;\n"
+		"}\n";
+}
+
+
+GpuPointQualityEstimator::GpuPointQualityEstimator()
+	: program_(0)
+{
+	for (int i = 0; i < 4; ++i)
+		buffers_[i] = 0;
+}
+
+
+bool GpuPointQualityEstimator::estimate(
+	const std::vector<vec3>& points, const unsigned int sizes[3],
+	std::vector<float>& planar_qualities, std::vector<float>& spacings
+) {
+	const unsigned int K = std::max(sizes[0], std::max(sizes[1], sizes[2]));
+	if (points.empty() || K == 0 || K > max_neighbors || sizes[0] == 0 || sizes[1] == 0 || sizes[2] == 0)
+		return false;
+
+	// The cells are sized for points sampling surfaces (about the area of the faces of the bbox) with
+	// a few points per cell, and enlarged to bound the number of cells.
+	Box3d box;
+	for (std::size_t i = 0; i < points.size(); ++i)
+		box.add_point(points[i]);
+	double w = std::max(double(box.x_max()) - box.x_min(), 1e-6);
+	double h = std::max(double(box.y_max()) - box.y_min(), 1e-6);
+	double d = std::max(double(box.z_max()) - box.z_min(), 1e-6);
+	double area = 2.0 * (w * h + h * d + w * d);
+	double cell_size = std::sqrt(area * 8.0 / points.size());
+	cell_size = std::max(cell_size, std::cbrt(w * h * d / max_cells) * 1.01);
+	int dims[3] = {
+		static_cast<int>(w / cell_size) + 1,
+		static_cast<int>(h / cell_size) + 1,
+		static_cast<int>(d / cell_size) + 1
+	};
+	const std::size_t num_cells = std::size_t(dims[0]) * dims[1] * dims[2];
+
+	// the points sorted by cells (a counting sort), with their original indices
+	std::vector<unsigned int> cells(points.size());
+	std::vector<unsigned int> cell_start(num_cells + 1, 0);
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		int c[3];
+		for (int k = 0; k < 3; ++k) {
+			c[k] = static_cast<int>(std::floor((double(points[i][k]) - box.min(k)) / cell_size));
+			ogf_clamp(c[k], 0, dims[k] - 1);
+		}
+		cells[i] = static_cast<unsigned int>((std::size_t(c[2]) * dims[1] + c[1]) * dims[0] + c[0]);
+		++cell_start[cells[i] + 1];
+	}
+	for (std::size_t c = 0; c < num_cells; ++c)
+		cell_start[c + 1] += cell_start[c];
+	std::vector<unsigned int> order(points.size());
+	std::vector<float> coords(points.size() * 3);
+	{
+		std::vector<unsigned int> next(cell_start.begin(), cell_start.end() - 1);
+		for (std::size_t i = 0; i < points.size(); ++i) {
+			unsigned int m = next[cells[i]]++;
+			order[m] = static_cast<unsigned int>(i);
+			coords[3 * m] = points[i].x;
+			coords[3 * m + 1] = points[i].y;
+			coords[3 * m + 2] = points[i].z;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	bool created = false;
+	if (!context_.make_current(created))
+		return false;
+	if (created) {
+		program_ = GpuComputeContext::create_program(shader_source, "point quality");
+		glGenBuffers(4, buffers_);
+	}
+	if (!program_) {
+		context_.done_current();
+		return false;
+	}
+
+	GpuComputeContext::upload(buffers_[0], 0, coords.data(), coords.size() * sizeof(float));
+	GpuComputeContext::upload(buffers_[1], 1, cell_start.data(), cell_start.size() * sizeof(unsigned int));
+	GpuComputeContext::upload(buffers_[2], 2, order.data(), order.size() * sizeof(unsigned int));
+	GpuComputeContext::upload(buffers_[3], 3, 0, points.size() * sizeof(vec2));
+
+	glUseProgram(program_);
+	glUniform3i(glGetUniformLocation(program_, "dims"), dims[0], dims[1], dims[2]);
+	glUniform3f(glGetUniformLocation(program_, "origin"), box.x_min(), box.y_min(), box.z_min());
+	glUniform1f(glGetUniformLocation(program_, "cell_size"), static_cast<float>(cell_size));
+	glUniform1ui(glGetUniformLocation(program_, "num_points"), static_cast<GLuint>(points.size()));
+	glUniform1i(glGetUniformLocation(program_, "max_shells"), max_shells);
+	glUniform3ui(glGetUniformLocation(program_, "sizes"), sizes[0], sizes[1], sizes[2]);
+	GLint first_point = glGetUniformLocation(program_, "first_point");
+	for (std::size_t first = 0; first < points.size(); first += dispatch_size) {
+		std::size_t n = std::min(dispatch_size, points.size() - first);
+		glUniform1ui(first_point, static_cast<GLuint>(first));
+		glDispatchCompute(static_cast<GLuint>((n + 63) / 64), 1, 1);
+		glFlush();	// a dispatch at a time (the long ones may be stopped by the driver)
+	}
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	std::vector<vec2> results(points.size());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers_[3]);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, results.size() * sizeof(vec2), results.data());
+	glUseProgram(0);
+
+	bool ok = (glGetError() == GL_NO_ERROR);
+	context_.done_current();
+	if (!ok)
+		return false;
+
+	planar_qualities.resize(points.size());
+	spacings.resize(points.size());
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		planar_qualities[i] = results[i].x;
+		spacings[i] = results[i].y;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef GPU_POINT_QUALITY_ESTIMATOR_H
+#define GPU_POINT_QUALITY_ESTIMATOR_H
+
+#include "gpu_compute_context.h"
+#include "../method/point_quality_estimator.h"
+
+#include <mutex>
+
+
+/**
+* Computes the planar qualities of the points with an OpenGL compute shader (OpenGL 4.3). 
+* The points are sorted into a uniform grid on the CPU, and each invocation finds the K nearest
+* neighbors of a point by visiting the shells of cells around it, until no closer point can be
+* found (the neighbors are kept sorted in registers, so K is at most 32). The covariances of the 
+* three neighborhoods and their eigenvalues (in closed form) are then computed in the same pass.
+* The points without K neighbors within 'max_shells' shells get a quality of 0, as the points 
+* with less than K neighbors on the CPU. Must be created in the GUI thread (see GpuComputeContext).
+*/
+
+class GpuPointQualityEstimator : public PointQualityEstimator
+{
+public:
+	GpuPointQualityEstimator();
+
+	std::string name() const { return "OpenGL compute shader"; }
+
+	bool estimate(
+		const std::vector<vec3>& points, const unsigned int sizes[3],
+		std::vector<float>& planar_qualities, std::vector<float>& spacings
+	);
+
+private:
+	GpuComputeContext	context_;
+	GLuint				program_;
+	GLuint				buffers_[4];	// the sorted coordinates, the cells, the order, and the results
+	std::mutex			mutex_;
+};
+
+
+#endif // GPU_POINT_QUALITY_ESTIMATOR_H
@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "job_runner.h"
+#include "../basic/logger.h"
+#include "../basic/progress.h"
+
+#include <QThread>
+
+#include <exception>
+
+
+namespace {
+
+	class JobThread : public QThread {
+	public:
+		JobThread(const std::function<void()>& work, QObject* parent) : QThread(parent), work_(work) {}
+
+	protected:
+		virtual void run() {
+			try {
+				work_();
+			}
+			catch (const std::exception& e) {
+				Logger::err("-") << "the job stopped: " << e.what() << std::endl;
+			}
+		}
+
+	private:
+		std::function<void()> work_;
+	};
+}
+
+
+JobRunner::JobRunner(QObject* parent)
+	: QObject(parent)
+	, thread_(0)
+{
+}
+
+
+JobRunner::~JobRunner() {
+	// the objects 'done' works on may be gone, so it is not run
+	if (thread_) {
+		Progress::instance()->cancel();
+		thread_->wait();
+	}
+}
+
+
+bool JobRunner::start(const QString& name, const std::function<void()>& work, const std::function<void()>& done) {
+	if (thread_) {
+		Logger::warn("-") << "please wait until \'" << name_.toStdString() << "\' completes" << std::endl;
+		return false;
+	}
+
+	name_ = name;
+	done_ = done;
+	Progress::instance()->clear_canceled();
+
+	// the thread emits 'finished' from the worker thread, the slot is queued to the GUI thread
+	thread_ = new JobThread(work, this);
+	connect(thread_, SIGNAL(finished()), this, SLOT(on_thread_finished()));
+	Q_EMIT started(name_);
+	thread_->start();
+	return true;
+}
+
+
+void JobRunner::cancel_and_wait() {
+	if (!thread_)
+		return;
+	Progress::instance()->cancel();
+	thread_->wait();
+	on_thread_finished();
+}
+
+
+void JobRunner::on_thread_finished() {
+	if (!thread_)
+		return;	// already handled by cancel_and_wait()
+
+	thread_->deleteLater();
+	thread_ = 0;
+
+	std::function<void()> done;
+	done.swap(done_);
+	if (done)
+		done();
+
+	QString name = name_;
+	name_.clear();
+	Q_EMIT finished(name);
+}
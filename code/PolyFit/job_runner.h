@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef JOB_RUNNER_H
+#define JOB_RUNNER_H
+
+#include <QObject>
+#include <QString>
+
+#include <functional>
+
+
+class QThread;
+
+/**
+* Runs a pipeline stage (a job) off the GUI thread, one at a time. The work runs in a 
+* worker thread and must not touch the widgets; 'done' runs in the GUI thread once the 
+* work has completed (e.g., to swap the resulting model into the canvas). The progress 
+* and the log messages of the work reach the GUI through its clients (see MainWindow), 
+* and a job is canceled through Progress::cancel().
+*/
+
+class JobRunner : public QObject
+{
+	Q_OBJECT
+
+public:
+	JobRunner(QObject* parent = 0);
+	~JobRunner();
+
+	bool is_running() const { return thread_ != 0; }
+	const QString& job_name() const { return name_; }
+
+	// returns false (and does nothing) if a job is already running
+	bool start(const QString& name, const std::function<void()>& work, const std::function<void()>& done);
+
+	// requests the running job to stop, waits for it, and runs its 'done'
+	void cancel_and_wait();
+
+Q_SIGNALS:
+	void started(const QString& name);
+	void finished(const QString& name);
+
+private Q_SLOTS:
+	void on_thread_finished();
+
+private:
+	QThread*				thread_;
+	QString					name_;
+	std::function<void()>	done_;
+};
+
+
+#endif // JOB_RUNNER_H
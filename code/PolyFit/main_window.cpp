@@ -25,16 +25,22 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QSettings>
 #include <QProgressBar>
 #include <QComboBox>
+#include <QCheckBox>
 #include <QMenu>
 #include <QToolButton>
+#include <QKeyEvent>
+#include <QThread>
+#include <QDockWidget>
 
 #include "paint_canvas.h"
 
 #include "dlg/wgt_render.h"
 #include "dlg/weight_panel_click.h"
 #include "dlg/weight_panel_manual.h"
+#include "dlg/profiling_panel.h"
 
 #include "../basic/file_utils.h"
+#include "../basic/profiler.h"
 #include "../model/map_attributes.h"
 #include "../model/map_builder.h"
 #include "../model/map_io.h"
@@ -100,6 +106,7 @@ MainWindow::MainWindow(QWidget *parent)
 	showMaximized();
 
 	createRenderingPanel();
+	createProfilingPanel();
 
 	createActions();
 	createStatusBar();
@@ -130,35 +137,56 @@ MainWindow::~MainWindow()
 
 
 void MainWindow::out_message(const std::string& msg) {
-	plainTextEditOutput->moveCursor(QTextCursor::End);
-	plainTextEditOutput->insertPlainText(QString::fromStdString(msg));
-	plainTextEditOutput->repaint();
-	plainTextEditOutput->update();
+	appendOutput(QString::fromStdString(msg));
 }
 
 
 void MainWindow::warn_message(const std::string& msg) {
-	plainTextEditOutput->moveCursor(QTextCursor::End);
-	plainTextEditOutput->insertPlainText(QString::fromStdString(msg));
-	plainTextEditOutput->repaint();
-	plainTextEditOutput->update();
+	appendOutput(QString::fromStdString(msg));
 }
 
 
 void MainWindow::err_message(const std::string& msg) {
+	appendOutput(QString::fromStdString(msg));
+}
+
+
+void MainWindow::status_message(const std::string& msg, int timeout) {
+	showStatus(QString::fromStdString(msg), timeout);
+}
+
+
+void MainWindow::notify_progress(std::size_t value) {
+	showProgress(static_cast<int>(value));
+}
+
+
+void MainWindow::appendOutput(const QString& msg) {
+	if (QThread::currentThread() != thread()) {
+		QMetaObject::invokeMethod(this, "appendOutput", Qt::QueuedConnection, Q_ARG(QString, msg));
+		return;
+	}
 	plainTextEditOutput->moveCursor(QTextCursor::End);
-	plainTextEditOutput->insertPlainText(QString::fromStdString(msg));
+	plainTextEditOutput->insertPlainText(msg);
 	plainTextEditOutput->repaint();
 	plainTextEditOutput->update();
 }
 
 
-void MainWindow::status_message(const std::string& msg, int timeout) {
-	statusBar()->showMessage(QString::fromStdString(msg), timeout);
+void MainWindow::showStatus(const QString& msg, int timeout) {
+	if (QThread::currentThread() != thread()) {
+		QMetaObject::invokeMethod(this, "showStatus", Qt::QueuedConnection, Q_ARG(QString, msg), Q_ARG(int, timeout));
+		return;
+	}
+	statusBar()->showMessage(msg, timeout);
 }
 
 
-void MainWindow::notify_progress(std::size_t value) {
+void MainWindow::showProgress(int value) {
+	if (QThread::currentThread() != thread()) {
+		QMetaObject::invokeMethod(this, "showProgress", Qt::QueuedConnection, Q_ARG(int, value));
+		return;
+	}
 	progress_bar_->setValue(value);
 	progress_bar_->setTextVisible(value != 0);
 	mainCanvas_->update_all();
@@ -178,10 +206,16 @@ void MainWindow::createActions() {
 	actionSaveCandidateFaces->setText("Save candidate faces");
 	connect(actionSaveCandidateFaces, SIGNAL(triggered()), this, SLOT(saveCandidateFaces()));
 
+	QAction* actionSaveProfilingReport = new QAction(this);
+	actionSaveProfilingReport->setText("Save profiling report");
+	connect(actionSaveProfilingReport, SIGNAL(triggered()), this, SLOT(saveProfilingReport()));
+
 	QMenu* saveMenu = new QMenu();
 	saveMenu->addAction(actionSaveReconstruction);
 	saveMenu->addSeparator();
 	saveMenu->addAction(actionSaveCandidateFaces);
+	saveMenu->addSeparator();
+	saveMenu->addAction(actionSaveProfilingReport);
 
 	QToolButton* saveToolButton = new QToolButton();
 	saveToolButton->setText("Save");
@@ -225,11 +259,31 @@ void MainWindow::createRenderingPanel() {
     verticalLayoutWeights->addWidget(panelClick_);
 	panelManual_ = nullptr;
 
+	checkBoxLiveSelection_ = new QCheckBox(tr("Live re-selection"), this);
+	checkBoxLiveSelection_->setToolTip(tr("Re-select the faces (within a short time limit) whenever the weights are changed"));
+	verticalLayoutWeights->addWidget(checkBoxLiveSelection_);
+
+	connect(panelClick_, SIGNAL(weights_chosen()), this, SLOT(weightsChosen()));
 	connect(pushButtonDefaultWeight, SIGNAL(pressed()), this, SLOT(resetWeights()));
 	connect(checkBoxManualInputWeights, SIGNAL(toggled(bool)), this, SLOT(setManualInputWeights(bool)));
 }
 
 
+void MainWindow::createProfilingPanel() {
+	profilingPanel_ = new ProfilingPanel(this);
+
+	QDockWidget* dock = new QDockWidget(tr("Profiling"), this);
+	dock->setObjectName("dockWidgetProfiling");
+	dock->setWidget(profilingPanel_);
+	addDockWidget(Qt::BottomDockWidgetArea, dock);
+	dock->hide();
+
+	QAction* action = dock->toggleViewAction();
+	action->setToolTip(tr("Show the timeline and the profile of the stages, the progress of the solver, and the statistics of the candidate faces"));
+	toolBarFile->addAction(action);
+}
+
+
 void MainWindow::updateWeights() {
     panelClick_->updateUI();
 	if (panelManual_)
@@ -261,7 +315,16 @@ void MainWindow::resetWeights() {
 	Method::lambda_model_complexity = default_complexity_;
 
 	panelClick_->updateUI();
-	panelManual_->updateUI();
+	if (panelManual_)
+		panelManual_->updateUI();
+
+	weightsChosen();
+}
+
+
+void MainWindow::weightsChosen() {
+	if (checkBoxLiveSelection_->isChecked())
+		mainCanvas_->liveSelection();
 }
 
 
@@ -270,6 +333,7 @@ void MainWindow::setManualInputWeights(bool b) {
         panelManual_ = new WeightPanelManual(this);
         verticalLayoutWeights->addWidget(panelManual_);
         connect(panelClick_, SIGNAL(weights_changed()), panelManual_, SLOT(updateUI()));
+        connect(panelManual_, SIGNAL(weights_chosen()), this, SLOT(weightsChosen()));
     }
 
 	if (b) {
@@ -285,10 +349,21 @@ void MainWindow::setManualInputWeights(bool b) {
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+	mainCanvas_->jobRunner()->cancel_and_wait();
 	writeSettings();
 	event->accept();
 }
 
+void MainWindow::keyPressEvent(QKeyEvent *e)
+{
+	if (e->key() == Qt::Key_Escape) {
+		Progress::instance()->cancel();
+		status_message("canceling...", 2000);
+	}
+	else
+		QMainWindow::keyPressEvent(e);
+}
+
 void MainWindow::createStatusBar()
 {	
 	statusLabel_ = new QLabel("Ready");
@@ -315,6 +390,11 @@ void MainWindow::createStatusBar()
 	numOptimizedFacesLabel_->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
 	statusBar()->addPermanentWidget(numOptimizedFacesLabel_, 1);
 
+	memoryLabel_ = new QLabel;
+	memoryLabel_->setFixedWidth(length);
+	memoryLabel_->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+	statusBar()->addPermanentWidget(memoryLabel_, 1);
+
 	QLabel* space2 = new QLabel;
 	statusBar()->addWidget(space2, 1);
 
@@ -338,10 +418,18 @@ void MainWindow::createToolBar()
 	solverBox_->setEditable(false);
 #ifdef HAS_GUROBI
     solverBox_->addItem("GUROBI");
+#endif
+#ifdef HAS_HIGHS
+	solverBox_->addItem("HIGHS");
+#endif
+#ifdef HAS_ORTOOLS
+	solverBox_->addItem("CPSAT");
 #endif
     solverBox_->addItem("SCIP");
 	solverBox_->addItem("GLPK");
 	solverBox_->addItem("LPSOLVE");
+	solverBox_->addItem("PORTFOLIO");
+	solverBox_->addItem("AUTO");
 
 	QLabel* label = new QLabel(this);
 	label->setText("    Solver");
@@ -366,12 +454,18 @@ void MainWindow::updateStatusBar()
 	QString hypoFaces = "#faces(hypo): 0";
 	QString optimizedFaces = "#faces(result): 0";
 
+	// the memory of the data (the point cloud, the candidate faces, and the result)
+	double memory = 0;
 	if (mainCanvas_->pointSet()) {
 		points = QString("#points: %1").arg(mainCanvas_->pointSet()->num_points());
+		memory += mainCanvas_->pointSet()->memory_usage().total();
 	}
 	if (mainCanvas_->hypothesisMesh()) {
 		hypoFaces = QString("#faces(candidates): %1").arg(mainCanvas_->hypothesisMesh()->size_of_facets());
+		memory += mainCanvas_->hypothesisMesh()->memory_usage().total();
 	}
+	if (mainCanvas_->optimizedMesh() && mainCanvas_->optimizedMesh() != mainCanvas_->hypothesisMesh())
+		memory += mainCanvas_->optimizedMesh()->memory_usage().total();
 	if (mainCanvas_->optimizedMesh()) {
 		// I need to report the number of planar faces, instead of the original face candidates
 		//optimizedFaces = QString("#faces(final): %1").arg(mainCanvas_->optimizedMesh()->size_of_facets());
@@ -383,6 +477,7 @@ void MainWindow::updateStatusBar()
 	numPointsLabel_->setText(points);
 	numHypoFacesLabel_->setText(hypoFaces);
 	numOptimizedFacesLabel_->setText(optimizedFaces);
+	memoryLabel_->setText(QString("memory: %1").arg(QString::fromStdString(MemoryUsage::to_string(memory))));
 }
 
 
@@ -451,7 +546,7 @@ bool MainWindow::open()
 {
 	QString fileName = QFileDialog::getOpenFileName(this,
 		tr("Open file"), curDataDirectory_,
-		tr("Supported Format (*.vg *.bvg *.obj)")
+		tr("Supported Format (*.vg *.bvg *.bvgz *.ply *.obj)")
 		);
 
 	if (fileName.isEmpty())
@@ -490,6 +585,11 @@ bool MainWindow::saveReconstruction()
 
 bool MainWindow::saveCandidateFaces()
 {
+	if (mainCanvas_->isBusy()) {	// the running stage works on the candidate faces
+		Logger::warn("-") << "please wait until the running stage completes (or press \'Esc\' to cancel)" << std::endl;
+		return false;
+	}
+
 	QString fileName = QFileDialog::getSaveFileName(this,
 		tr("Save candidate faces into an OBJ file"), optimizedMeshFileName_,
 		tr("Mesh (*.obj)")
@@ -515,29 +615,61 @@ bool MainWindow::saveCandidateFaces()
 }
 
 
+bool MainWindow::saveProfilingReport()
+{
+	QString fileName = QFileDialog::getSaveFileName(this,
+		tr("Save the profiling report of the stages into a JSON file"), curDataDirectory_,
+		tr("Profiling report (*.json)")
+	);
+
+	if (fileName.isEmpty())
+		return false;
+
+	if (Profiler::save_json(fileName.toStdString())) {
+		status_message("File saved", 500);
+		return true;
+	}
+
+	status_message("Saving failed", 500);
+	return false;
+}
+
+
 bool MainWindow::doOpen(const QString &fileName)
 {
+	if (mainCanvas_->isBusy()) {
+		Logger::warn("-") << "please wait until the running stage completes (or press \'Esc\' to cancel)" << std::endl;
+		return false;
+	}
+
 	std::string name = fileName.toStdString();
 	std::string ext = FileUtils::extension(name);
 	String::to_lowercase(ext);
 
-	Map* mesh = nil;
-	PointSet* pset = nil;
 	if (ext == "obj") {
-		mesh = MapIO::read(name);
-		if (mesh)
-			optimizedMeshFileName_ = fileName;
-	}
-	else {
-		pset = PointSetIO::read(name);
-		if (pset)
-			pointCloudFileName_ = fileName;
+		Map* mesh = MapIO::read(name);
+		fileOpened(fileName, mesh, nil);
+		return mesh != nil;
 	}
 
-	if (mesh)
+	// the points are shown as they are read, the current objects are kept until the reading completes
+	status_message("Reading file...", 0);
+	mainCanvas_->loadPointSet(fileName, [this, fileName](PointSet* pset) {
+		fileOpened(fileName, nil, pset);
+	});
+	return true;
+}
+
+
+void MainWindow::fileOpened(const QString &fileName, Map* mesh, PointSet* pset)
+{
+	if (mesh) {
+		optimizedMeshFileName_ = fileName;
 		canvas()->setMesh(mesh);
+	}
 
 	if (pset) {
+		pointCloudFileName_ = fileName;
 		canvas()->clear();
 		canvas()->setPointSet(pset);
 
@@ -567,12 +699,9 @@ bool MainWindow::doOpen(const QString &fileName)
 			actionGenerateQualityMeasures->setDisabled(true);
 			actionOptimization->setDisabled(true);
 		}
-		return true;
 	} 	
-	else {	
+	else
 		status_message("Open failed", 500);
-		return false;
-	} 
 }
 
 
@@ -603,9 +732,21 @@ LinearProgramSolver::SolverName MainWindow::active_solver() const {
 #ifdef HAS_GUROBI
 	else if (solverString == "GUROBI")
 		return LinearProgramSolver::GUROBI;
+#endif
+#ifdef HAS_HIGHS
+	else if (solverString == "HIGHS")
+		return LinearProgramSolver::HIGHS;
+#endif
+#ifdef HAS_ORTOOLS
+	else if (solverString == "CPSAT")
+		return LinearProgramSolver::CPSAT;
 #endif
 	else if (solverString == "LPSOLVE")
 		return LinearProgramSolver::LPSOLVE;
+	else if (solverString == "PORTFOLIO")
+		return LinearProgramSolver::PORTFOLIO;
+	else if (solverString == "AUTO")
+		return LinearProgramSolver::AUTO;
     else // default to SCIP
 		return LinearProgramSolver::SCIP;
 }
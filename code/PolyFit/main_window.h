@@ -31,12 +31,16 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "ui_main_window.h"
 
 class QLabel;
+class QCheckBox;
 class QComboBox;
 class PaintCanvas;
 class QProgressBar;
 class WeightPanelClick;
 class WeightPanelManual;
 class WgtRender;
+class ProfilingPanel;
+class Map;
+class PointSet;
 
 class MainWindow 
 	: public QMainWindow
@@ -66,10 +70,14 @@ public:
 
 	LinearProgramSolver::SolverName active_solver() const;
 
+	// the profile of the stages (see Profiler), updated once each stage completes
+	ProfilingPanel* profilingPanel() { return profilingPanel_; }
+
 public Q_SLOTS:
 	bool open();
 	bool saveReconstruction();
 	bool saveCandidateFaces();
+	bool saveProfilingReport();
 
 	void updateStatusBar();
 
@@ -77,20 +85,33 @@ public Q_SLOTS:
 
 	void resetWeights();
 	void setManualInputWeights(bool);
+	// in the live mode, the faces are re-selected as soon as new weights are chosen
+	void weightsChosen();
 
 	void about();
 
+private Q_SLOTS:
+	// the messages and the progress of the stages running in the worker thread are queued to these
+	void appendOutput(const QString& msg);
+	void showStatus(const QString& msg, int timeout);
+	void showProgress(int value);
+
 private:
 	void createActions(); 
 	void createStatusBar();
 	void createToolBar();
 
 	void createRenderingPanel();
+	void createProfilingPanel();
 
 	void readSettings();
 	void writeSettings();
 	
+	// the point clouds are read in the background (see PaintCanvas::loadPointSet()), so for them it
+	// only returns whether the reading started
 	bool doOpen(const QString &fileName);
+	// updates the window once a file is opened (or failed, if both are nil)
+	void fileOpened(const QString &fileName, Map* mesh, PointSet* pset);
 	bool doSave(const QString &fileName);
 
 	void setCurrentFile(const QString &fileName);
@@ -99,6 +120,8 @@ private:
 
 protected:
 	void closeEvent(QCloseEvent *e);
+	// 'Esc' cancels the running task (e.g., the face selection)
+	void keyPressEvent(QKeyEvent *e);
 
 private:
 	PaintCanvas*	mainCanvas_;
@@ -115,7 +138,8 @@ private:
 	QLabel *statusLabel_,
 		*numPointsLabel_,
 		*numHypoFacesLabel_,
-		*numOptimizedFacesLabel_;
+		*numOptimizedFacesLabel_,
+		*memoryLabel_;
 
 	//////////////////////////////////////////////////////////////////////////
 
@@ -123,6 +147,9 @@ private:
 
 	WeightPanelClick*	panelClick_;
 	WeightPanelManual*	panelManual_;
+	QCheckBox*			checkBoxLiveSelection_;
+
+	ProfilingPanel*		profilingPanel_;
 
 	float default_fitting_;
 	float default_coverage_;
@@ -20,22 +20,33 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "paint_canvas.h"
 
 #include <fstream>
+#include <memory>
 
 #include <QMessageBox>
 #include <QCoreApplication>
+#include <QMouseEvent>
+#include <QToolTip>
+#include <QThread>
+#include <QFileInfo>
 
 #include "../3rd_QGLViewer/QGLViewer/manipulatedCameraFrame.h"
 #include "../basic/file_utils.h"
 #include "../basic/stop_watch.h"
 #include "../model/map_editor.h"
 #include "../model/map_geometry.h"
+#include "../model/point_set_io.h"
 #include "../renderer/opengl_info.h"
 #include "../renderer/surface_render.h"
 #include "../renderer/point_set_render.h"
 #include "../method/hypothesis_generator.h"
 #include "../method/face_selection.h"
+#include "../method/method_global.h"
 
 #include "main_window.h"
+#include "job_runner.h"
+#include "dlg/profiling_panel.h"
+#include "gpu_facet_point_counter.h"
+#include "gpu_point_quality_estimator.h"
 
 
 using namespace qglviewer;
@@ -52,7 +63,12 @@ PaintCanvas::PaintCanvas(QWidget *parent)
 	, show_hint_text_(true)
 	, show_mouse_hint_(false)
 	, hypothesis_(nil)
+	, selection_(nil)
+	, point_counter_(nil)
+	, point_estimator_(nil)
 {
+	job_runner_ = new JobRunner(this);
+
 	setFPSIsDisplayed(true);
 
 	main_window_ = dynamic_cast<MainWindow*>(parent);
@@ -80,6 +96,18 @@ PaintCanvas::~PaintCanvas() {
 //	// this is required by the following destruction of textures, shaders, etc.
 //	makeCurrent();
 
+	delete job_runner_;	// stops the running stage (if any)
+	job_runner_ = 0;
+
+	if (point_counter_) {
+		FacetPointCounter::set_instance(nil);
+		delete point_counter_;
+	}
+	if (point_estimator_) {
+		PointQualityEstimator::set_instance(nil);
+		delete point_estimator_;
+	}
+
 	delete point_set_render_;
 	delete mesh_render_;
 
@@ -101,6 +129,16 @@ void PaintCanvas::clear() {
 		delete hypothesis_;
 		hypothesis_ = 0;
 	}
+
+	discardSelection();
+}
+
+
+void PaintCanvas::discardSelection() {
+	if (selection_) {
+		delete selection_;
+		selection_ = 0;
+	}
 }
 
 // in case you're running PolyFit on an ancient machine where 
@@ -116,6 +154,14 @@ void PaintCanvas::init()
 		Logger::err("-") << "OpenGL error detected and rendering disabled. You are still able to run PolyFit and export the result." << std::endl;
 		fatal_opengl_error = true;
 	}
+	else if (GpuComputeContext::is_supported()) {
+		// used with Method::device_point_counting
+		point_counter_ = new GpuFacetPointCounter;
+		FacetPointCounter::set_instance(point_counter_);
+		// used with Method::device_point_confidences
+		point_estimator_ = new GpuPointQualityEstimator;
+		PointQualityEstimator::set_instance(point_estimator_);
+	}
 
 	//////////////////////////////////////////////////////////////////////////
 
@@ -212,10 +258,15 @@ void PaintCanvas::draw() {
 	}
 
 	bool interacting = camera()->frame()->isManipulated();
-    if (point_set_ && show_input_ && point_set_render_)
-        point_set_render_->draw(point_set_);
+	bool busy = isBusy();	// the running stage works on the input and the candidates
+    if (point_set_ && show_input_ && point_set_render_ && !busy)
+        point_set_render_->draw(point_set_, interacting);
+	else if (loading_points_ && show_input_ && point_set_render_) {
+		std::lock_guard<std::mutex> lock(loading_points_->mutex);	// the worker keeps the points meanwhile
+		point_set_render_->draw_loading_points(loading_points_->points, loading_points_->num, loading_points_->total);
+	}
 
-	if (hypothesis_mesh_ && show_candidates_ && mesh_render_) {
+	if (hypothesis_mesh_ && show_candidates_ && mesh_render_ && !busy) {
 		EdgeStyle s = mesh_render_->mesh_style();
 		s.visible = true;
 		mesh_render_->set_mesh_style(s);
@@ -263,10 +314,61 @@ void PaintCanvas::draw() {
 
 
 void PaintCanvas::keyPressEvent(QKeyEvent *e) {
+	// 'C' cycles the coloring of the candidate faces: their colors, the number of supporting points, the covered area
+	if (e->key() == Qt::Key_C && e->modifiers() == Qt::NoModifier && mesh_render_) {
+		const std::string& current = mesh_render_->facet_scalar();
+		if (current.empty())
+			mesh_render_->set_facet_scalar(Method::facet_attrib_supporting_point_num);
+		else if (current == Method::facet_attrib_supporting_point_num)
+			mesh_render_->set_facet_scalar(Method::facet_attrib_covered_area);
+		else
+			mesh_render_->set_facet_scalar("");
+		update();
+		return;
+	}
 	e->ignore();
 }
 
 
+Map::Facet* PaintCanvas::pickCandidateFace(int x, int y) {
+	if (fatal_opengl_error || !hypothesis_mesh_ || !show_candidates_ || !mesh_render_ || isBusy())
+		return nil;
+
+	makeCurrent();
+	camera()->loadProjectionMatrix();
+	camera()->loadModelViewMatrix();
+	const qreal ratio = devicePixelRatio();
+	int px = static_cast<int>(x * ratio);
+	int py = static_cast<int>((height() - 1 - y) * ratio);
+	Map::Facet* f = mesh_render_->pick_facet(hypothesis_mesh_, px, py);
+	doneCurrent();
+	return f;
+}
+
+
+void PaintCanvas::mouseMoveEvent(QMouseEvent *e) {
+	QGLViewer::mouseMoveEvent(e);
+	if (e->buttons() != Qt::NoButton)
+		return;
+
+	Map::Facet* f = pickCandidateFace(e->x(), e->y());
+	if (!f) {
+		QToolTip::hideText();
+		return;
+	}
+
+	QString text = QString("candidate face (%1 vertices)").arg(f->degree());
+	MapFacetAttribute<double> supporting_point_num, facet_area, covered_area;
+	if (supporting_point_num.bind_if_defined(hypothesis_mesh_, Method::facet_attrib_supporting_point_num))
+		text += QString("\nsupporting points: %1").arg(supporting_point_num[f]);
+	if (facet_area.bind_if_defined(hypothesis_mesh_, Method::facet_attrib_facet_area))
+		text += QString("\narea: %1").arg(facet_area[f]);
+	if (covered_area.bind_if_defined(hypothesis_mesh_, Method::facet_attrib_covered_area))
+		text += QString("\ncovered area: %1").arg(covered_area[f]);
+	QToolTip::showText(e->globalPos(), text, this);
+}
+
+
 void PaintCanvas::snapshotScreen(const QString& fileName) {
 	bool need_hide = show_coord_sys_;
 	if (need_hide)
@@ -288,6 +390,10 @@ void PaintCanvas::snapshotScreen(const QString& fileName) {
 
 
 void PaintCanvas::update_graphics() {
+	if (QThread::currentThread() != thread()) {	// from a stage running in the worker thread
+		QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+		return;
+	}
 	update();
 
 	// This approach has significant drawbacks. For example, imagine you wanted to perform two such loops 
@@ -300,6 +406,10 @@ void PaintCanvas::update_graphics() {
 }
 
 void PaintCanvas::update_all() {
+	if (QThread::currentThread() != thread()) {	// from a stage running in the worker thread
+		QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+		return;
+	}
 	update();
 	main_window_->updateStatusBar();
 
@@ -414,11 +524,12 @@ void PaintCanvas::setMesh(Map* mesh) {
 
 void PaintCanvas::setPointSet(PointSet* pset) { 
 	point_set_ = pset; 
+	discardSelection();
 
     // assign each vertex group a random color
     // (in case the user doesn't provide color information)
     std::vector<VertexGroup::Ptr>& groups = pset->groups();
-    for (auto g : groups)
+    for (VertexGroup* g : groups)
         g->set_color(random_color());
 
 	fitScreen();
@@ -433,6 +544,56 @@ void PaintCanvas::setPointSet(PointSet* pset) {
 }
 
 
+void PaintCanvas::loadPointSet(const QString& fileName, const std::function<void(PointSet*)>& done) {
+	if (!checkIdle())
+		return;
+
+	std::shared_ptr<LoadingPoints> loading = std::make_shared<LoadingPoints>();
+	loading_points_ = loading;
+	const std::string name = fileName.toStdString();
+	std::shared_ptr<PointSet::Ptr> result = std::make_shared<PointSet::Ptr>();
+	runStage("reading " + QFileInfo(fileName).fileName(), [this, name, loading, result]() {
+		*result = PointSetIO::read(name, [this, loading](const vec3* points, std::size_t num, std::size_t total) {
+			std::lock_guard<std::mutex> lock(loading->mutex);
+			loading->points = points;
+			loading->num = num;
+			loading->total = total;
+			if (points && !loading->pending) {	// one at a time, the GUI draws the latest points
+				loading->pending = true;
+				QMetaObject::invokeMethod(this, "showLoadingPoints", Qt::QueuedConnection);
+			}
+		});
+	}, [this, result, done]() {
+		loading_points_.reset();
+		makeCurrent();
+		point_set_render_->release_loading_points();
+		done(*result);	// e.g., setPointSet() takes its reference
+	});
+}
+
+
+void PaintCanvas::showLoadingPoints() {
+	if (!loading_points_)
+		return;	// the load has completed
+
+	std::lock_guard<std::mutex> lock(loading_points_->mutex);
+	loading_points_->pending = false;
+	if (!loading_points_->points)
+		return;
+
+	// the view is fitted to the first points read (and to all of them once loaded, see setPointSet())
+	if (!loading_points_->fitted) {
+		Box3d box;
+		for (std::size_t i = 0; i < loading_points_->num; ++i)
+			box.add_point(loading_points_->points[i]);
+		setSceneBoundingBox(qglviewer::Vec(box.x_min(), box.y_min(), box.z_min()), qglviewer::Vec(box.x_max(), box.y_max(), box.z_max()));
+		showEntireScene();
+		loading_points_->fitted = true;
+	}
+	update();
+}
+
+
 Map* PaintCanvas::hypothesisMesh() const {
 	return hypothesis_mesh_;
 }
@@ -464,7 +625,63 @@ void PaintCanvas::setShowResult(bool b) {
 }
 
 
+bool PaintCanvas::isBusy() const {
+	return job_runner_ && job_runner_->is_running();
+}
+
+
+bool PaintCanvas::checkIdle() const {
+	if (isBusy()) {
+		Logger::warn("-") << "please wait until \'" << job_runner_->job_name().toStdString() << "\' completes (or press \'Esc\' to cancel)" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+void PaintCanvas::runStage(const QString& name, const std::function<void()>& work, const std::function<void()>& done) {
+	hint_text_ = name + "... (press \'Esc\' to cancel)";
+	hint_text2nd_ = "";
+	update();
+
+	job_runner_->start(name, work, [this, done]() {
+		if (Progress::instance()->is_canceled())
+			Logger::warn("-") << "canceled" << std::endl;
+		done();
+		update_all();
+		main_window_->profilingPanel()->updateStages();
+	});
+}
+
+
+void PaintCanvas::plotSearch(FaceSelection* selection) {
+	ProfilingPanel* panel = main_window_->profilingPanel();
+	QMetaObject::invokeMethod(panel, "clearSearch", Qt::QueuedConnection);
+
+	// the solvers may report at each node, so only the changes are queued (at most 20 times a second)
+	std::shared_ptr<StopWatch> watch = std::make_shared<StopWatch>();
+	std::shared_ptr<LinearProgramSolver::SearchProgress> last = std::make_shared<LinearProgramSolver::SearchProgress>();
+	std::shared_ptr<double> last_time = std::make_shared<double>(-1.0);
+	selection->set_search_callback([panel, watch, last, last_time](const LinearProgramSolver::SearchProgress& progress) {
+		if (progress.has_incumbent == last->has_incumbent && progress.incumbent == last->incumbent &&
+			progress.has_bound == last->has_bound && progress.bound == last->bound)
+			return;
+		double time = watch->elapsed();
+		if (time - *last_time < 0.05)
+			return;
+		*last_time = time;
+		*last = progress;
+		QMetaObject::invokeMethod(panel, "addSearchProgress", Qt::QueuedConnection,
+			Q_ARG(bool, progress.has_incumbent), Q_ARG(double, progress.incumbent),
+			Q_ARG(bool, progress.has_bound), Q_ARG(double, progress.bound));
+	});
+}
+
+
 void PaintCanvas::refinePlanes() {
+	if (!checkIdle())
+		return;
+
 	if (!pointSet()) {
 		Logger::warn("-") << "point set does not exist" << std::endl;
 		return;
@@ -482,21 +699,28 @@ void PaintCanvas::refinePlanes() {
 	if (hypothesis_)
 		delete hypothesis_;
 	hypothesis_ = new HypothesisGenerator(point_set_);
+	discardSelection();
 
-	hypothesis_->refine_planes();
+	HypothesisGenerator* hypothesis = hypothesis_;
+	runStage("refining planes", [hypothesis]() {
+		hypothesis->refine_planes();
+	}, [this]() {
+		point_set_->notify_change();
 
-	main_window_->checkBoxShowInput->setChecked(true);
-	main_window_->actionGenerateFacetHypothesis->setDisabled(false);
-	main_window_->defaultRenderingForCandidates();
-
-	hint_text_ = "Next: click \'Hypothesis\' to generate candidate faces.";
-	hint_text2nd_ = "";
+		main_window_->checkBoxShowInput->setChecked(true);
+		main_window_->actionGenerateFacetHypothesis->setDisabled(false);
+		main_window_->defaultRenderingForCandidates();
 
-	update_all();
+		hint_text_ = "Next: click \'Hypothesis\' to generate candidate faces.";
+		hint_text2nd_ = "";
+	});
 }
 
 
 void PaintCanvas::generateFacetHypothesis() {
+	if (!checkIdle())
+		return;
+
 	if (!point_set_) {
 		Logger::warn("-") << "point set does not exist" << std::endl;
 		return;
@@ -517,34 +741,45 @@ void PaintCanvas::generateFacetHypothesis() {
 
 	Logger::out("-") << "generating plane hypothesis..." << std::endl;
 
-	StopWatch w;
-	hypothesis_mesh_ = hypothesis_->generate();
-	if (hypothesis_mesh_) {
-		Logger::out("-") << "done. " << w.elapsed() << " sec." << std::endl;
-
-		MapFacetAttribute<Color> color(hypothesis_mesh_, "color");
-		FOR_EACH_FACET(Map, hypothesis_mesh_, it)
-			color[it] = random_color();
-
-		main_window_->checkBoxShowInput->setChecked(false);
-		main_window_->checkBoxShowCandidates->setChecked(true);
-		main_window_->actionGenerateQualityMeasures->setDisabled(false);
-		main_window_->defaultRenderingForCandidates();
-
-		hint_text_ = "Next: click \'Confidences\' to compute point/face confidences.";
-		hint_text2nd_ = "";
-
-		update_all();
-	}
-	else {
-		QMessageBox::warning(main_window_, "Error!", "Failed generating candidate faces. \nCheck if the input point cloud has good planar segments.");
-		hint_text_ = "Failed generating candidate faces :-(";
-		hint_text2nd_ = "Check if the input point cloud has good planar segments.";
-	}
+	discardSelection();
+	HypothesisGenerator* hypothesis = hypothesis_;
+	std::shared_ptr<Map::Ptr> result = std::make_shared<Map::Ptr>();
+	runStage("generating candidate faces", [hypothesis, result]() {
+		StopWatch w;
+		*result = hypothesis->generate();
+		if (*result)
+			Logger::out("-") << "done. " << w.elapsed() << " sec." << std::endl;
+	}, [this, result]() {
+		if (*result) {
+			hypothesis_mesh_ = *result;
+
+			MapFacetAttribute<Color> color(hypothesis_mesh_, "color");
+			FOR_EACH_FACET(Map, hypothesis_mesh_, it)
+				color[it] = random_color();
+			hypothesis_mesh_->notify_change();
+
+			main_window_->checkBoxShowInput->setChecked(false);
+			main_window_->checkBoxShowCandidates->setChecked(true);
+			main_window_->actionGenerateQualityMeasures->setDisabled(false);
+			main_window_->defaultRenderingForCandidates();
+
+			hint_text_ = "Next: click \'Confidences\' to compute point/face confidences.";
+			hint_text2nd_ = "";
+		}
+		else {
+			main_window_->actionGenerateFacetHypothesis->setDisabled(false);
+			QMessageBox::warning(main_window_, "Error!", "Failed generating candidate faces. \nCheck if the input point cloud has good planar segments.");
+			hint_text_ = "Failed generating candidate faces :-(";
+			hint_text2nd_ = "Check if the input point cloud has good planar segments.";
+		}
+	});
 }
 
 
 void PaintCanvas::generateQualityMeasures() {
+	if (!checkIdle())
+		return;
+
 	if (!point_set_) {
 		Logger::warn("-") << "point set does not exist" << std::endl;
 		return;
@@ -564,23 +799,31 @@ void PaintCanvas::generateQualityMeasures() {
 
 	main_window_->disableActions(true);
 	
-	hypothesis_->compute_confidences(hypothesis_mesh_, false);
-
-	main_window_->checkBoxShowCandidates->setChecked(true);
-	main_window_->actionOptimization->setDisabled(false);
-	main_window_->defaultRenderingForCandidates();
+	discardSelection();
+	HypothesisGenerator* hypothesis = hypothesis_;
+	Map* mesh = hypothesis_mesh_;
+	runStage("computing confidences", [hypothesis, mesh]() {
+		hypothesis->compute_confidences(mesh, false);
+	}, [this, s]() {
+		hypothesis_mesh_->notify_change();	// the quality measures of the faces are shown from the buffers
 
-	hint_text_ = "Next: click \'Optimization\' for face selection.";
-	hint_text2nd_ = "";
+		main_window_->checkBoxShowCandidates->setChecked(true);
+		main_window_->actionOptimization->setDisabled(false);
+		main_window_->defaultRenderingForCandidates();
 
-	if (s.visible)  // restore
-		mesh_render_->set_sharp_edge_style(s);
+		hint_text_ = "Next: click \'Optimization\' for face selection.";
+		hint_text2nd_ = "";
 
-	update_all();
+		if (s.visible)  // restore
+			mesh_render_->set_sharp_edge_style(s);
+	});
 }
 
 
 void PaintCanvas::optimization() {
+	if (!checkIdle())
+		return;
+
 	if (!point_set_) {
 		Logger::warn("-") << "point set does not exist" << std::endl;
 		return;
@@ -604,15 +847,31 @@ void PaintCanvas::optimization() {
 
 	main_window_->updateWeights();
 	main_window_->disableActions(true);
-	Map* mesh = Geom::duplicate(hypothesis_mesh_);
 
-	HypothesisGenerator::Adjacency adjacency = hypothesis_->extract_adjacency(mesh);
-	FaceSelection selector(point_set_, mesh);
-	selector.optimize(adjacency, main_window_->active_solver());
+	const LinearProgramSolver::SolverName solver = main_window_->active_solver();
+	std::shared_ptr<Map::Ptr> result = std::make_shared<Map::Ptr>();
+	runStage("selecting faces", [this, solver, result]() {
+		// the selection works on the candidate faces directly and only the selected ones are copied out, 
+		// so the (possibly huge) hypothesis mesh is not duplicated for each run
+		HypothesisGenerator::Adjacency adjacency = hypothesis_->extract_adjacency(hypothesis_mesh_);
+		// if only the weights changed since the last run, the binary program is reused
+		if (selection_)
+			plotSearch(selection_);
+		if (!selection_ || !selection_->re_optimize(hypothesis_mesh_, adjacency, solver)) {
+			discardSelection();
+			selection_ = new FaceSelection(point_set_, hypothesis_mesh_);
+			selection_->set_keep_candidates(true);
+			plotSearch(selection_);
+			selection_->optimize(adjacency, solver);
+		}
+
+		Map* mesh = selection_->selected_model(adjacency);
+		if (!mesh)
+			return;
 
-    // to have consistent orientation for the final model
-    adjacency = hypothesis_->extract_adjacency(mesh);
-    selector.re_orient(adjacency, main_window_->active_solver());
+		// to have consistent orientation for the final model
+		adjacency = hypothesis_->extract_adjacency(mesh);
+		selection_->re_orient(mesh, adjacency, solver);
 
 #if 0 // not stable!!!
     { // to stitch the coincident edges and related vertices
@@ -641,16 +900,117 @@ void PaintCanvas::optimization() {
     }
 #endif
 
-    optimized_mesh_ = mesh;
+		*result = mesh;
+	}, [this, result]() {
+		main_window_->actionOptimization->setDisabled(false);
+		if (!*result) {
+			Logger::warn("-") << "no faces were selected" << std::endl;
+			return;
+		}
 
-	main_window_->checkBoxShowInput->setChecked(false);
-	main_window_->checkBoxShowCandidates->setChecked(false);
-	main_window_->checkBoxShowResult->setChecked(true);
-	main_window_->actionOptimization->setDisabled(false);
-	main_window_->defaultRenderingForResult();
+		optimized_mesh_ = *result;
+
+		main_window_->checkBoxShowInput->setChecked(false);
+		main_window_->checkBoxShowCandidates->setChecked(false);
+		main_window_->checkBoxShowResult->setChecked(true);
+		main_window_->defaultRenderingForResult();
+
+		hint_text_ = "Done! You may tune the parameters to reproduce the result.";
+		hint_text2nd_ = "To see where the faces originate, check \'Per-face Color\' in the rendering panel.";
+	});
+}
+
+
+void PaintCanvas::liveSelection() {
+	static const QString name = "re-selecting faces";
+	if (isBusy()) {
+		if (job_runner_->job_name() != name) {
+			checkIdle();
+			return;
+		}
+		job_runner_->cancel_and_wait();	// superseded by the new weights
+	}
+
+	if (!selection_ || !hypothesis_mesh_ || !hypothesis_) {
+		Logger::warn("-") << "please click \'Optimization\' once before re-selecting the faces" << std::endl;
+		return;
+	}
 
-	hint_text_ = "Done! You may tune the parameters to reproduce the result.";
-	hint_text2nd_ = "To see where the faces originate, check \'Per-face Color\' in the rendering panel.";
+	main_window_->updateWeights();
 
+	const LinearProgramSolver::SolverName solver = main_window_->active_solver();
+	std::shared_ptr<HypothesisGenerator::Adjacency> adjacency = std::make_shared<HypothesisGenerator::Adjacency>();
+	std::shared_ptr<LiveIncumbent> incumbent = std::make_shared<LiveIncumbent>();
+	live_incumbent_ = incumbent;
+
+	// the selections found meanwhile are copied out in the worker thread (which owns the candidate
+	// faces until it completes), and shown without a consistent orientation
+	selection_->set_time_limit(Method::live_selection_time_limit);
+	plotSearch(selection_);
+	selection_->set_incumbent_callback([this, adjacency, incumbent](const std::vector<double>& X) {
+		Map* mesh = nil;
+		try {
+			mesh = selection_->selected_model(*adjacency, X);
+		}
+		catch (...) {	// a preview is not worth stopping the search
+		}
+		if (!mesh)
+			return;
+
+		std::lock_guard<std::mutex> lock(incumbent->mutex);
+		delete incumbent->mesh;
+		incumbent->mesh = mesh;
+		QMetaObject::invokeMethod(this, "showLiveIncumbent", Qt::QueuedConnection);
+	});
+
+	std::shared_ptr<Map::Ptr> result = std::make_shared<Map::Ptr>();
+	runStage(name, [this, solver, adjacency, result]() {
+		*adjacency = hypothesis_->extract_adjacency(hypothesis_mesh_);
+		if (!selection_->re_optimize(hypothesis_mesh_, *adjacency, solver)) {
+			Logger::warn("-") << "the binary program can't be reused, please click \'Optimization\'" << std::endl;
+			return;
+		}
+
+		Map* mesh = selection_->selected_model(*adjacency);
+		if (!mesh)
+			return;
+
+		HypothesisGenerator::Adjacency result_adjacency = hypothesis_->extract_adjacency(mesh);
+		selection_->re_orient(mesh, result_adjacency, solver);
+		*result = mesh;
+	}, [this, result]() {
+		live_incumbent_.reset();
+		if (selection_) {
+			selection_->set_time_limit(-1.0);
+			selection_->set_incumbent_callback(FaceSelection::IncumbentCallback());
+		}
+
+		if (!*result) {
+			Logger::warn("-") << "no faces were selected" << std::endl;
+			return;
+		}
+		optimized_mesh_ = *result;
+		main_window_->checkBoxShowResult->setChecked(true);
+
+		hint_text_ = "Re-selected with the new weights. Change the weights again to continue.";
+		hint_text2nd_ = "";
+	});
+}
+
+
+void PaintCanvas::showLiveIncumbent() {
+	if (!live_incumbent_)
+		return;	// the re-selection has completed
+
+	Map* mesh = nil;
+	{
+		std::lock_guard<std::mutex> lock(live_incumbent_->mutex);
+		std::swap(mesh, live_incumbent_->mesh);
+	}
+	if (!mesh)
+		return;
+
+	optimized_mesh_ = mesh;
+	main_window_->checkBoxShowResult->setChecked(true);
 	update_all();
 }
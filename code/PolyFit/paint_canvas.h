@@ -28,10 +28,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../model/point_set.h"
 #include "../model/map.h"
 
+#include <functional>
+#include <memory>
+#include <mutex>
+
 class MainWindow;
 class SurfaceRender;
 class PointSetRender;
 class HypothesisGenerator;
+class FaceSelection;
+class JobRunner;
+class GpuFacetPointCounter;
+class GpuPointQualityEstimator;
 
 class PaintCanvas : public QGLViewer
 {
@@ -58,6 +66,11 @@ public:
 	void setMesh(Map* mesh);
 	void setPointSet(PointSet* pset);
 
+	// Reads a point cloud in the worker thread (see JobRunner), drawing its points as they are read
+	// (see PointSetIO::read()). 'done' runs in the GUI thread with the point set, or nil if reading 
+	// failed (the current objects are kept until then, e.g., for setPointSet()).
+	void loadPointSet(const QString& fileName, const std::function<void(PointSet*)>& done);
+
 	// the active object
 	Map*		hypothesisMesh() const ;
 	Map*		optimizedMesh() const;
@@ -68,6 +81,14 @@ public:
 
 	void snapshotScreen(const QString& fileName);
 
+	// the candidate face under the pixel (x, y) of the widget, nil if none
+	Map::Facet* pickCandidateFace(int x, int y);
+
+	// the stages run in a worker thread (see JobRunner), one at a time. Meanwhile, the 
+	// input and the candidate faces (which they work on) are not drawn.
+	JobRunner* jobRunner() const { return job_runner_; }
+	bool isBusy() const;
+
 	void clear();
 
 	//////////////////////////////////////////////////////////////////////////
@@ -79,6 +100,9 @@ protected:
 	// Keyboard events functions
 	virtual void keyPressEvent(QKeyEvent *e);
 
+	// hovering a candidate face shows its quality measures
+	virtual void mouseMoveEvent(QMouseEvent *e);
+
 public Q_SLOTS:
 	void fitScreen() ;
 
@@ -90,14 +114,34 @@ public Q_SLOTS:
 	void generateFacetHypothesis();
 	void generateQualityMeasures();
 	void optimization();
+	// Re-selects the faces with the current weights (after a first 'Optimization') within the time limit of
+	// the live mode, starting from the previous selection. A running re-selection is canceled (its best
+	// selection is kept) and superseded, and the best selection found so far is shown meanwhile.
+	void liveSelection();
 
 	void setShowInput(bool);
 	void setShowCandidates(bool);
 	void setShowResult(bool);
 
+private Q_SLOTS:
+	// shows the latest selection reported by the running live re-selection
+	void showLiveIncumbent();
+	// shows the points read so far by the running load
+	void showLoadingPoints();
+
 private :
 	void drawCornerAxis();
 
+	// the face selection can't be re-optimized after its inputs changed
+	void discardSelection();
+	// the progress of the searches of 'selection' is plotted by the profiling panel
+	void plotSearch(FaceSelection* selection);
+
+	// runs a stage in the worker thread, 'done' runs in the GUI thread afterwards
+	void runStage(const QString& name, const std::function<void()>& work, const std::function<void()>& done);
+	// warns and returns false if a stage is running
+	bool checkIdle() const;
+
 protected:
 	MainWindow*	main_window_;
 	vec3		light_pos_;
@@ -117,6 +161,36 @@ protected:
 	PointSetRender* point_set_render_;
 
 	HypothesisGenerator* hypothesis_;
+	FaceSelection*		 selection_;	// kept for re-optimization with new weights
+
+	// the latest selection found by the live re-selection, handed over from the worker thread
+	struct LiveIncumbent {
+		LiveIncumbent() : mesh(nil) {}
+		~LiveIncumbent() { delete mesh; }
+
+		std::mutex	mutex;
+		Map*		mesh;	// not shown yet
+	};
+	std::shared_ptr<LiveIncumbent> live_incumbent_;	// of the running live re-selection
+
+	// the points read so far by the running load, handed over from the worker thread
+	struct LoadingPoints {
+		LoadingPoints() : points(nil), num(0), total(0), pending(false), fitted(false) {}
+		std::mutex	mutex;
+		const vec3*	points;		// nil if none (yet)
+		std::size_t	num;
+		std::size_t	total;
+		bool		pending;	// a showLoadingPoints() is queued
+		bool		fitted;		// the view was fitted to the first points
+	};
+	std::shared_ptr<LoadingPoints> loading_points_;	// of the running load
+
+	JobRunner*	job_runner_;
+
+	// counts the supporting points of the candidate faces on the GPU (nil if not supported)
+	GpuFacetPointCounter*	point_counter_;
+	// computes the planar qualities of the points on the GPU (nil if not supported)
+	GpuPointQualityEstimator*	point_estimator_;
 
 	bool		show_hint_text_;
 	QString     hint_text_;
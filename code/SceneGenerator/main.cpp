@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "../basic/logger.h"
+#include "../basic/stop_watch.h"
+#include "../model/point_set.h"
+#include "../model/point_set_io.h"
+#include "../model/synthetic_scene.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+
+// Writes the point cloud (with its planar segments) of a synthetic scene (see SyntheticScene), e.g.,
+// for charting how the stages scale with the number of planes and points:
+//     for p in 10 100 1000; do SceneGenerator scene_$p.bvg --planes $p --points 1000000; done
+//
+// usage: SceneGenerator output.bvg [--planes N] [--points N] [--noise sigma] [--outliers ratio]
+//                      [--missing ratio] [--gable ratio] [--no-ground] [--no-rotation] [--seed N]
+
+
+namespace {
+
+    bool parse_options(int argc, char **argv, SyntheticScene::Parameters& params) {
+        for (int i = 2; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--no-ground") {
+                params.ground = false;
+                continue;
+            }
+            else if (arg == "--no-rotation") {
+                params.rotate = false;
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                std::cerr << "missing value of option " << arg << std::endl;
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--planes")
+                params.num_planes = static_cast<std::size_t>(std::max(std::atof(value.c_str()), 1.0));
+            else if (arg == "--points")
+                params.num_points = static_cast<std::size_t>(std::max(std::atof(value.c_str()), 0.0));   // accepts 1e8
+            else if (arg == "--noise")
+                params.noise = static_cast<float>(std::atof(value.c_str()));
+            else if (arg == "--outliers")
+                params.outlier_ratio = static_cast<float>(std::atof(value.c_str()));
+            else if (arg == "--missing")
+                params.missing_ratio = static_cast<float>(std::atof(value.c_str()));
+            else if (arg == "--gable")
+                params.gable_ratio = static_cast<float>(std::atof(value.c_str()));
+            else if (arg == "--seed")
+                params.seed = static_cast<unsigned int>(std::atol(value.c_str()));
+            else {
+                std::cerr << "unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+
+int main(int argc, char **argv)
+{
+    // initialize the logger (this is not optional)
+    Logger::initialize();
+
+    SyntheticScene::Parameters params;
+    if (argc < 2 || !parse_options(argc, argv, params)) {
+        std::cerr << "usage: " << argv[0] << " output.bvg [--planes N] [--points N] [--noise sigma] [--outliers ratio]"
+            << " [--missing ratio] [--gable ratio] [--no-ground] [--no-rotation] [--seed N]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string output_file = argv[1];
+
+    StopWatch w;
+    PointSet::Ptr pset = SyntheticScene::generate(params);
+    std::cout << "generated " << pset->num_points() << " points on " << pset->groups().size() << " planes. " << w.elapsed() << " sec." << std::endl;
+
+    w.start();
+    if (!PointSetIO::save(output_file, pset)) {
+        std::cerr << "failed saving point cloud to file: " << output_file << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "point cloud saved to file: " << output_file << ". " << w.elapsed() << " sec." << std::endl;
+    return EXIT_SUCCESS;
+};
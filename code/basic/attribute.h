@@ -184,10 +184,46 @@ protected:
     }
 
 private:
+    template <class R, class A> friend class AttributeAccessor ;
     AttributeStore_var store_ ;
 } ;
 
 
+/**
+ * gives a direct access to the values of a bound Attribute: the chunks of its 
+ * store are resolved once (at construction), so an access is two loads from 
+ * typed arrays instead of a call through the store. Use it in the loops that 
+ * hit an attribute for each element. It is valid as long as the store doesn't 
+ * grow, i.e., as long as no record is created in the AttributeManager.
+ */
+
+template <class RECORD, class ATTRIBUTE> 
+class AttributeAccessor {
+public:
+    AttributeAccessor(const Attribute<RECORD,ATTRIBUTE>& attribute) {
+        ogf_assert(attribute.is_bound()) ;
+        const ::AttributeStore* store = attribute.store_ ;
+        ogf_assert(store->item_size() == sizeof(ATTRIBUTE)) ;
+        chunks_.resize(store->nb_chunks()) ;
+        for(unsigned int i=0; i<store->nb_chunks(); i++) {
+            chunks_[i] = reinterpret_cast<ATTRIBUTE*>(store->data(i, 0)) ;
+        }
+    }
+
+    ATTRIBUTE& operator[](const RECORD* record) const {
+        ogf_attribute_assert(RawAttributeStore::chunk_of(*record) < chunks_.size()) ;
+        return chunks_[RawAttributeStore::chunk_of(*record)][RawAttributeStore::offset_of(*record)] ;
+    }
+
+    ATTRIBUTE& operator[](const RECORD& record) const {
+        return operator[](&record) ;
+    }
+
+private:
+    std::vector<ATTRIBUTE*> chunks_ ;
+} ;
+
+
 //__________________________________________________________
 
 template <class RECORD, class ATTRIBUTE> inline 
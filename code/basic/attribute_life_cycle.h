@@ -43,6 +43,7 @@
 #include "../basic/smart_pointer.h"
 
 #include <string.h>
+#include <type_traits>
 
 
 
@@ -68,10 +69,14 @@ public:
 	* @param pod (plain ordinary datatype) if set, bitwise
 	*    copy is used rather than calling the virtual_xxx
 	*    functions.
+	* @param trivially_copyable if set, the items can be
+	*    copied bitwise in bulk (see is_bitwise_copyable()),
+	*    the single copies still calling the virtual_xxx
+	*    functions if pod is not set.
 	*/
 	AttributeLifeCycle(
-		unsigned int item_size, bool notify, bool pod
-		) : item_size_(item_size), notify_(notify), pod_(pod) {
+		unsigned int item_size, bool notify, bool pod, bool trivially_copyable = false
+		) : item_size_(item_size), notify_(notify), pod_(pod), trivially_copyable_(trivially_copyable) {
 	}
 
 	void construct(
@@ -152,12 +157,21 @@ public:
 
 	unsigned int item_size() const { return item_size_ ; }
 
+	/**
+	* whether a range of items can be copied (or copy constructed) 
+	* by a single memcpy, e.g., by AttributeManager::clone_records().
+	*/
+	bool is_bitwise_copyable() const { 
+		return !notify_ && (pod_ || trivially_copyable_) ; 
+	}
+
 	virtual AttributeLifeCycle* clone() = 0 ;
 
 protected:
 	unsigned int item_size_ ;
 	bool notify_ ;
 	bool pod_ ;
+	bool trivially_copyable_ ;
 } ;
 
 typedef SmartPointer<AttributeLifeCycle> AttributeLifeCycle_var;
@@ -234,7 +248,7 @@ class GenericAttributeLifeCycle : public AttributeLifeCycle {
 public:
 	GenericAttributeLifeCycle(
 		bool notify = false, bool pod = false
-		) : AttributeLifeCycle(sizeof(ATTRIBUTE), notify, pod) {
+		) : AttributeLifeCycle(sizeof(ATTRIBUTE), notify, pod, std::is_trivially_copyable<ATTRIBUTE>::value) {
 	}
 
 	virtual void virtual_construct(Memory::pointer addr) ;
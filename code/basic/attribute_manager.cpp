@@ -39,6 +39,7 @@
 #include "attribute_manager.h"
 #include "../basic/logger.h"
 #include <typeinfo>
+#include <algorithm>
 
 
 AttributeManager::~AttributeManager() {
@@ -76,35 +77,41 @@ AttributeManager::~AttributeManager() {
 	}
 }
 
+void AttributeManager::grow_chunk() {
+	rat_.grow() ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		stores_[i]->grow() ;
+		ogf_attribute_assert(stores_[i]->capacity() == capacity()) ;
+	}
+}
+
+void AttributeManager::reserve(unsigned int nb_records) {
+	while(capacity() - size_ < nb_records) {
+		grow_chunk() ;
+	}
+}
+
 void AttributeManager::new_record(Record* record) {
 	if(rat_.is_full()) {
-		rat_.grow() ;
-		for(std::set<AttributeStore*>::iterator 
-			it=attributes_.begin(); it!=attributes_.end(); it++
-			) {
-				(*it)->grow() ;
-				ogf_attribute_assert((*it)->capacity() == capacity()) ;
+		unsigned int nb = geometric_growth_ ? ogf_max(rat_.nb_chunks() / 2, 1u) : 1 ;
+		for(unsigned int i=0; i<nb; i++) {
+			grow_chunk() ;
 		}
 	}
 	record->set_record_id(rat_.new_record_id()) ;
 	unsigned int chunk  = record->record_id().chunk() ;
 	unsigned int offset = record->record_id().offset() ;
-	for(std::set<AttributeStore*>::iterator 
-		it=attributes_.begin(); it!=attributes_.end(); it++
-		) {
-			(*it)->construct(  (*it)->data(chunk,offset), record ) ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		stores_[i]->construct( stores_[i]->data(chunk,offset), record ) ;
 	} 
 	size_++ ;
 }
 
 void AttributeManager::new_record(Record* record, const Record* from) {
 	if(rat_.is_full()) {
-		rat_.grow() ;
-		for(std::set<AttributeStore*>::iterator 
-			it=attributes_.begin(); it!=attributes_.end(); it++
-			) {
-				(*it)->grow() ;
-				ogf_attribute_assert((*it)->capacity() == capacity()) ;
+		unsigned int nb = geometric_growth_ ? ogf_max(rat_.nb_chunks() / 2, 1u) : 1 ;
+		for(unsigned int i=0; i<nb; i++) {
+			grow_chunk() ;
 		}
 	}
 	record->set_record_id(rat_.new_record_id()) ;
@@ -114,13 +121,11 @@ void AttributeManager::new_record(Record* record, const Record* from) {
 	unsigned int chunk_from  = from->record_id().chunk() ;
 	unsigned int offset_from = from->record_id().offset() ; 
 
-	for(std::set<AttributeStore*>::iterator 
-		it=attributes_.begin(); it!=attributes_.end(); it++
-		) {
-			(*it)->copy_construct(  
-				(*it)->data(chunk,offset), record,
-				(*it)->data(chunk_from,offset_from), from
-				) ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		stores_[i]->copy_construct(  
+			stores_[i]->data(chunk,offset), record,
+			stores_[i]->data(chunk_from,offset_from), from
+			) ;
 	} 
 	size_++ ;
 }
@@ -132,23 +137,139 @@ void AttributeManager::copy_record(Record* record, const Record* from) {
 	unsigned int chunk_from  = from->record_id().chunk() ;
 	unsigned int offset_from = from->record_id().offset() ; 
 
-	for(std::set<AttributeStore*>::iterator 
-		it=attributes_.begin(); it!=attributes_.end(); it++
-		) {
-			(*it)->copy(  
-				(*it)->data(chunk,offset), record,
-				(*it)->data(chunk_from,offset_from), from
-				) ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		stores_[i]->copy(  
+			stores_[i]->data(chunk,offset), record,
+			stores_[i]->data(chunk_from,offset_from), from
+			) ;
 	} 
 }
 
+void AttributeManager::copy_records(
+	Record* const* to, const Record* const* from, unsigned int nb
+	) {
+		for(unsigned int i=0; i<stores_.size(); i++) {
+			AttributeStore* as = stores_[i] ;
+			for(unsigned int j=0; j<nb; j++) {
+				as->copy(
+					as->data(*to[j]), to[j],
+					as->data(*from[j]), from[j]
+					) ;
+			}
+		}
+}
+
+void AttributeManager::compact(Record* const* records, unsigned int nb) {
+	ogf_assert(int(nb) == size_) ;
+	unsigned int nb_chunks = (nb + RAT::CHUNK_SIZE - 1) / RAT::CHUNK_SIZE ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		AttributeStore* as = stores_[i] ;
+		RawAttributeStore packed(as->item_size()) ;
+		for(unsigned int j=0; j<nb_chunks; j++) {
+			packed.grow() ;
+		}
+		for(unsigned int j=0; j<nb; j++) {
+			Memory::pointer from = as->data(*records[j]) ;
+			as->copy_construct(
+				packed.data(j / RAT::CHUNK_SIZE, j % RAT::CHUNK_SIZE), records[j],
+				from, records[j]
+				) ;
+			as->destroy(from, records[j]) ;
+		}
+		// the old chunks are deallocated with packed
+		as->swap_data(packed) ;
+	}
+	rat_.reset(nb) ;
+	for(unsigned int j=0; j<nb; j++) {
+		records[j]->set_record_id(RecordId(j / RAT::CHUNK_SIZE, j % RAT::CHUNK_SIZE)) ;
+	}
+}
+
+void AttributeManager::clone_records(
+	AttributeManager* source, Record* const* to, const Record* const* from, 
+	unsigned int nb, const std::set<std::string>* names
+	) {
+		ogf_assert(size_ == 0) ;
+		ogf_assert(source->record_type_id() == record_type_id()) ;
+
+		// the stores of this manager receiving the named attributes of source
+		std::map<AttributeStore*, AttributeStore*> sources ;
+		for(
+			std::map<std::string, AttributeStore_var>::iterator 
+			it=source->named_attributes_.begin(); 
+		it!=source->named_attributes_.end(); it++
+			) {
+				if(names != nil && names->find(it->first) == names->end()) {
+					continue ;
+				}
+				AttributeStore* from_store = it->second ;
+				AttributeStore* to_store = nil ;
+				std::map<std::string, AttributeStore_var>::iterator found = named_attributes_.find(it->first) ;
+				if(found != named_attributes_.end()) {
+					to_store = found->second ;
+					if(to_store->attribute_type_id() != from_store->attribute_type_id()) {
+						Logger::warn("AttributeManager") << "attribute " << it->first 
+							<< " does not have the same type as the source attribute (not copied)" << std::endl ;
+						continue ;
+					}
+				} else {
+					to_store = from_store->clone() ;
+					to_store->bind(this) ;
+					bind_named_attribute_store(it->first, to_store) ;
+				}
+				sources[to_store] = from_store ;
+		}
+
+		// the records are packed, in the order of to
+		unsigned int nb_chunks = (nb + RAT::CHUNK_SIZE - 1) / RAT::CHUNK_SIZE ;
+		rat_.reset(nb) ;
+		for(unsigned int i=0; i<stores_.size(); i++) {
+			if(stores_[i]->nb_chunks() != nb_chunks) {
+				stores_[i]->clear() ;
+				while(stores_[i]->nb_chunks() < nb_chunks) {
+					stores_[i]->grow() ;
+				}
+			}
+		}
+		for(unsigned int j=0; j<nb; j++) {
+			to[j]->set_record_id(RecordId(j / RAT::CHUNK_SIZE, j % RAT::CHUNK_SIZE)) ;
+		}
+		size_ = nb ;
+
+		// whether the records of source are stored in the same order
+		bool same_order = true ;
+		for(unsigned int j=0; j<nb && same_order; j++) {
+			const RecordId& id = from[j]->record_id() ;
+			same_order = (id.chunk() == j / RAT::CHUNK_SIZE && id.offset() == j % RAT::CHUNK_SIZE) ;
+		}
+
+		for(unsigned int i=0; i<stores_.size(); i++) {
+			AttributeStore* as = stores_[i] ;
+			std::map<AttributeStore*, AttributeStore*>::iterator found = sources.find(as) ;
+			if(found == sources.end()) {
+				for(unsigned int j=0; j<nb; j++) {
+					as->construct(as->data(*to[j]), to[j]) ;
+				}
+			} else if(same_order && as->is_bitwise_copyable()) {
+				AttributeStore* from_store = found->second ;
+				for(unsigned int c=0; c<nb_chunks; c++) {
+					unsigned int nb_items = ogf_min(nb - c * RAT::CHUNK_SIZE, (unsigned int)RAT::CHUNK_SIZE) ;
+					Memory::copy(as->data(c, 0), from_store->data(c, 0), nb_items * as->item_size()) ;
+				}
+			} else {
+				AttributeStore* from_store = found->second ;
+				for(unsigned int j=0; j<nb; j++) {
+					as->copy_construct(as->data(*to[j]), to[j], from_store->data(*from[j]), from[j]) ;
+				}
+			}
+		}
+}
+
 void AttributeManager::delete_record(Record* record) {
 	unsigned int chunk  = record->record_id().chunk() ;
 	unsigned int offset = record->record_id().offset() ;
-	for(std::set<AttributeStore*>::iterator 
-		it=attributes_.begin(); it!=attributes_.end(); it++
-		) {
-			(*it)->destroy(  (*it)->data(chunk,offset), record ) ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		stores_[i]->destroy( stores_[i]->data(chunk,offset), record ) ;
 	}    
 	rat_.delete_record_id(record->record_id()) ;
 	record->record_id().forget() ;
@@ -172,6 +293,20 @@ void AttributeManager::clear() {
 	size_ = 0 ;
 }
 
+void AttributeManager::recycle() {
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		for(unsigned int chunk=0; chunk<rat_.nb_chunks(); chunk++) {
+			for(unsigned int offset=0; offset<RAT::CHUNK_SIZE; offset++) {
+				if(!rat_.cell(chunk,offset).is_free()) {
+					stores_[i]->destroy( stores_[i]->data(chunk,offset) ) ;
+				} 
+			}
+		}
+	}
+	rat_.recycle() ;
+	size_ = 0 ;
+}
+
 void AttributeManager::list_named_attributes(
 	std::vector<std::string>& names
 	) {
@@ -185,6 +320,29 @@ void AttributeManager::list_named_attributes(
 		}
 }
 
+void AttributeManager::memory_usage(MemoryUsage& usage) const {
+	usage.add("records", double(rat_.memory_usage())) ;
+	std::set<const AttributeStore*> named ;
+	for(
+		std::map<std::string, AttributeStore_var>::const_iterator 
+		it=named_attributes_.begin(); 
+	it!=named_attributes_.end(); it++
+		) {
+			const AttributeStore* store = it->second ;
+			usage.add(it->first, double(store->memory_usage())) ;
+			named.insert(store) ;
+	}
+	double unnamed = 0 ;
+	for(unsigned int i=0; i<stores_.size(); i++) {
+		if(named.find(stores_[i]) == named.end()) {
+			unnamed += double(stores_[i]->memory_usage()) ;
+		}
+	}
+	if(unnamed > 0) {
+		usage.add("unnamed attributes", unnamed) ;
+	}
+}
+
 bool AttributeManager::named_attribute_is_bound(
 	const std::string& name
 	) {
@@ -199,6 +357,7 @@ void AttributeManager::register_attribute_store(AttributeStore* as) {
 		attributes_.find(as) == attributes_.end() 
 		) ;
 	attributes_.insert(as) ;
+	stores_.push_back(as) ;
 
 	for(unsigned int chunk=0; chunk<rat_.nb_chunks(); chunk++) {
 		for(unsigned int offset=0; offset<RAT::CHUNK_SIZE; offset++) {
@@ -222,6 +381,7 @@ void AttributeManager::unregister_attribute_store(AttributeStore* as) {
 	std::set<AttributeStore*>::iterator it = attributes_.find(as) ;
 	ogf_assert(it != attributes_.end()) ;
 	attributes_.erase(it) ;
+	stores_.erase(std::find(stores_.begin(), stores_.end(), as)) ;
 }
 
 void AttributeManager::bind_named_attribute_store(
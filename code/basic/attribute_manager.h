@@ -41,6 +41,7 @@
 #include "basic_common.h"
 #include "rat.h"
 #include "attribute_store.h"
+#include "memory_usage.h"
 
 #include <set>
 #include <map>
@@ -55,13 +56,19 @@ public:
 
 	enum Mode { FIND=1, CREATE=2, FIND_OR_CREATE=3} ;
 
-	AttributeManager() : size_(0) { }
+	AttributeManager() : size_(0), geometric_growth_(false) { }
 	virtual ~AttributeManager() ;
 	unsigned int capacity() { return rat_.capacity(); }
 	unsigned int size() { return size_; }
 
 	void clear() ;
 
+	/**
+	* destroys all the record attributes, but keeps the chunks 
+	* of the stores for the next records.
+	*/
+	void recycle() ;
+
 	/**
 	* creates new record attributes, and puts the resulting id
 	* in the specified Record
@@ -80,6 +87,45 @@ public:
 	*/
 	void copy_record(Record* to, const Record* from) ;
 
+	/**
+	* copies the attributes of the nb from Records to the to Records
+	* (attribute by attribute, which is faster than record by record).
+	*/
+	void copy_records(Record* const* to, const Record* const* from, unsigned int nb) ;
+
+	/**
+	* makes room for nb_records records, such that the next creations
+	* don't have to grow the attribute stores.
+	*/
+	void reserve(unsigned int nb_records) ;
+
+	/**
+	* if set, a full manager grows by half of its capacity at once
+	* instead of by a single chunk (e.g., during the bulk edits of a Map).
+	*/
+	void set_geometric_growth(bool b) { geometric_growth_ = b ; }
+
+	/**
+	* moves the attributes of the nb records (which must be all the
+	* records of the manager) such that they are stored in this order,
+	* and releases the chunks that are no longer needed. The Records
+	* get new ids, and the AttributeAccessors are no longer valid.
+	*/
+	void compact(Record* const* records, unsigned int nb) ;
+
+	/**
+	* creates the records of the nb Records to (the manager must be empty), 
+	* stored in this order, with the named attributes of the Records from of 
+	* source (all of them, or only the given ones): the missing attributes are 
+	* created, the chunks of the bitwise copyable attributes are copied at once
+	* where the Records from are stored in the same order in source (e.g., 
+	* after a compaction), and the other attributes are copied record by record.
+	*/
+	void clone_records(
+		AttributeManager* source, Record* const* to, const Record* const* from, 
+		unsigned int nb, const std::set<std::string>* names = nil
+		) ;
+
 	/**
 	* destroys the record attributes corresponding to the
 	* specified record.
@@ -87,6 +133,12 @@ public:
 	void delete_record(Record* record) ;
 
 	void list_named_attributes(std::vector<std::string>& names) ;
+
+	/**
+	* adds the bytes of the record table ("records"), of each named 
+	* attribute (by name) and of the unnamed ones ("unnamed attributes").
+	*/
+	void memory_usage(MemoryUsage& usage) const ;
 	bool named_attribute_is_bound(const std::string& name) ;
 	void delete_named_attribute(const std::string& name) ;
 
@@ -126,11 +178,16 @@ protected:
 	template <class RECORD> friend class AttributeCopier ;
 
 private:
+	/** adds a chunk to the RAT and to all the attribute stores. */
+	void grow_chunk() ;
+
 	RAT rat_ ;
 	std::set<AttributeStore*> attributes_ ;
+	std::vector<AttributeStore*> stores_ ; // same as attributes_, for the loops on each record
 	std::map<std::string, AttributeStore_var> named_attributes_ ;
 
 	int size_ ;
+	bool geometric_growth_ ;
 } ;
 
 
@@ -43,7 +43,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <sstream>
 #include <typeinfo>
+#include <type_traits>
 
 
 /**
@@ -73,6 +76,12 @@ public:
 	virtual bool serialize_read(std::istream& in,   Memory::pointer addr) = 0 ;
 	virtual bool serialize_write(std::ostream& out, Memory::pointer addr) = 0 ;
 
+	/** 
+	* the size of a value if its bytes can be written as they are (i.e., its type is
+	* trivially copyable, see SerializedAttribute::write_binary()), and 0 otherwise.
+	*/
+	virtual unsigned int binary_item_size() const { return 0 ; }
+
 private:
 	typedef std::map<std::string, SmartPointer<AttributeSerializer> > SerializerMap ;
 	typedef std::map<std::string, std::string> StringMap ;
@@ -108,6 +117,9 @@ public:
 		out << attr ;
 		return true ;
 	}
+	virtual unsigned int binary_item_size() const {
+		return std::is_trivially_copyable<ATTRIBUTE>::value ? sizeof(ATTRIBUTE) : 0 ;
+	}
 
 } ;
 
@@ -245,6 +257,79 @@ public:
 		return SerializedAttributeRef(serializer_, attribute_store_->data(*record)) ;
 	}
 
+	/** true if the values can be written as their bytes (see AttributeSerializer::binary_item_size()). */
+	bool is_binary() const {
+		return is_bound() && serializer_->binary_item_size() > 0 ;
+	}
+
+	/**
+	* Writes the values of the records (in this order) as a binary chunk: a header line with the
+	* name, the type name, the size of a value and the number of values, followed by the bytes of
+	* the values. The values of consecutive records stored one after another (e.g., created in this
+	* order) are written at once, i.e., a chunk of the store is written with a single call.
+	*/
+	bool write_binary(std::ostream& out, const std::vector<const RECORD*>& records) {
+		if(!is_binary()) {
+			return false ;
+		}
+		const unsigned int item_size = serializer_->binary_item_size() ;
+		out << name_ << " " << type_name() << " " << item_size << " " << records.size() << "\n" ;
+		for(std::size_t i=0; i<records.size(); ) {
+			std::size_t n = contiguous_run(records, i) ;
+			out.write(reinterpret_cast<const char*>(attribute_store_->data(*records[i])), std::streamsize(n) * item_size) ;
+			i += n ;
+		}
+		return !out.fail() ;
+	}
+
+	/**
+	* Reads a binary chunk written by write_binary() into the values of the records (which must be
+	* as many as the values), creating the attribute from its name and type name if needed. The
+	* records stored one after another (e.g., just created in the order they were written) are read
+	* by chunks of the store at once.
+	*/
+	bool read_binary(AttributeManager* manager, std::istream& in, const std::vector<RECORD*>& records) {
+		std::string header ;
+		std::getline(in, header) ;
+		std::istringstream header_in(header) ;
+		std::string name, attribute_type_name ;
+		unsigned int item_size = 0 ;
+		std::size_t count = 0 ;
+		header_in >> name >> attribute_type_name >> item_size >> count ;
+		if(header_in.fail()) {
+			return false ;
+		}
+		bind(manager, name, attribute_type_name) ;
+		if(!is_binary() || serializer_->binary_item_size() != item_size || count != records.size()) {
+			in.ignore(std::streamsize(count) * item_size) ;	// skips the values
+			return false ;
+		}
+		for(std::size_t i=0; i<records.size(); ) {
+			std::size_t n = contiguous_run(records, i) ;
+			in.read(reinterpret_cast<char*>(attribute_store_->data(*records[i])), std::streamsize(n) * item_size) ;
+			i += n ;
+		}
+		return !in.fail() ;
+	}
+
+private:
+	/** the number of records from 'first' whose values are next to each other in the same chunk. */
+	template <class PTR> 
+	static std::size_t contiguous_run(const std::vector<PTR>& records, std::size_t first) {
+		const unsigned int chunk = RawAttributeStore::chunk_of(*records[first]) ;
+		unsigned int offset = RawAttributeStore::offset_of(*records[first]) ;
+		std::size_t last = first + 1 ;
+		while(
+			last < records.size() && 
+			RawAttributeStore::chunk_of(*records[last]) == chunk && 
+			RawAttributeStore::offset_of(*records[last]) == offset + 1
+			) {
+				++offset ;
+				++last ;
+		}
+		return last - first ;
+	}
+
 private:
 	AttributeManager* attribute_manager_ ;
 	AttributeStore* attribute_store_ ;
@@ -99,6 +99,9 @@ public:
 	void bind(AttributeManager* manager) ;
 	AttributeManager* attribute_manager() const { return manager_; }
 
+	/** see AttributeLifeCycle::is_bitwise_copyable() */
+	bool is_bitwise_copyable() const { return life_cycle_->is_bitwise_copyable() ; }
+
 	virtual const std::type_info& attribute_type_id() const = 0 ;
 
 	/** returns an empty AttributeStore() of the same type. */
@@ -0,0 +1,167 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "block_codec.h"
+
+#include <cstring>
+
+
+// The compressed data is a sequence of (literals, match) pairs, each starting with a token byte
+// giving the number of literals (high 4 bits) and the length of the match minus its minimum 
+// (low 4 bits); 15 means that more bytes follow, each adding up to 255. The literals are followed
+// by the 2-byte offset of the match, then by the extra length bytes of the match. The last pair
+// only has literals.
+
+namespace {
+
+	const std::size_t	min_match = 4;
+	const std::size_t	max_offset = 65535;
+	const int			hash_bits = 14;
+	// the last bytes are always literals (so the match search never reads beyond the end)
+	const std::size_t	last_literals = 5;
+
+	inline unsigned int read32(const unsigned char* p) {
+		unsigned int v;
+		std::memcpy(&v, p, 4);
+		return v;
+	}
+
+	inline unsigned int hash(unsigned int v) {
+		return (v * 2654435761u) >> (32 - hash_bits);
+	}
+
+	void write_length(std::vector<unsigned char>& result, std::size_t length) {
+		for (; length >= 255; length -= 255)
+			result.push_back(255);
+		result.push_back(static_cast<unsigned char>(length));
+	}
+
+	void write_sequence(std::vector<unsigned char>& result, const unsigned char* literals, std::size_t num_literals, std::size_t offset, std::size_t match_length) {
+		std::size_t extra = (match_length > 0) ? match_length - min_match : 0;
+		unsigned char token = static_cast<unsigned char>(((num_literals < 15 ? num_literals : 15) << 4) | (extra < 15 ? extra : 15));
+		result.push_back(token);
+		if (num_literals >= 15)
+			write_length(result, num_literals - 15);
+		result.insert(result.end(), literals, literals + num_literals);
+		if (match_length == 0)
+			return;
+		result.push_back(static_cast<unsigned char>(offset & 0xff));
+		result.push_back(static_cast<unsigned char>(offset >> 8));
+		if (extra >= 15)
+			write_length(result, extra - 15);
+	}
+
+	// reads an extended length, returns false if it goes beyond 'end'
+	inline bool read_length(const unsigned char*& p, const unsigned char* end, std::size_t& length) {
+		unsigned char b;
+		do {
+			if (p == end)
+				return false;
+			b = *p++;
+			length += b;
+		} while (b == 255);
+		return true;
+	}
+}
+
+
+namespace BlockCodec {
+
+	std::size_t max_compressed_size(std::size_t size) {
+		return size + size / 255 + 16;
+	}
+
+
+	void compress(const unsigned char* data, std::size_t size, std::vector<unsigned char>& result) {
+		result.clear();
+		result.reserve(max_compressed_size(size));
+
+		const unsigned char* anchor = data;	// the first literal not yet written
+		if (size > min_match + last_literals) {
+			std::vector<std::size_t> table(std::size_t(1) << hash_bits, std::size_t(-1));
+			const unsigned char* end = data + size;
+			const unsigned char* limit = end - last_literals;
+			const unsigned char* p = data;
+			while (p + min_match <= limit) {
+				unsigned int v = read32(p);
+				unsigned int h = hash(v);
+				std::size_t candidate = table[h];
+				table[h] = p - data;
+				if (candidate == std::size_t(-1) || std::size_t(p - data) - candidate > max_offset || read32(data + candidate) != v) {
+					++p;
+					continue;
+				}
+
+				const unsigned char* match = data + candidate;
+				std::size_t length = min_match;
+				while (p + length < limit && match[length] == p[length])
+					++length;
+
+				write_sequence(result, anchor, p - anchor, p - match, length);
+				p += length;
+				anchor = p;
+			}
+		}
+		write_sequence(result, anchor, data + size - anchor, 0, 0);
+	}
+
+
+	bool decompress(const unsigned char* data, std::size_t data_size, unsigned char* result, std::size_t size) {
+		const unsigned char* p = data;
+		const unsigned char* end = data + data_size;
+		unsigned char* out = result;
+		unsigned char* out_end = result + size;
+
+		while (p < end) {
+			unsigned char token = *p++;
+
+			std::size_t num_literals = token >> 4;
+			if (num_literals == 15 && !read_length(p, end, num_literals))
+				return false;
+			if (num_literals > std::size_t(end - p) || num_literals > std::size_t(out_end - out))
+				return false;
+			std::memcpy(out, p, num_literals);
+			p += num_literals;
+			out += num_literals;
+
+			if (p == end)	// the last sequence
+				break;
+
+			if (end - p < 2)
+				return false;
+			std::size_t offset = p[0] | (std::size_t(p[1]) << 8);
+			p += 2;
+			std::size_t length = token & 15;
+			if (length == 15 && !read_length(p, end, length))
+				return false;
+			length += min_match;
+
+			if (offset == 0 || offset > std::size_t(out - result) || length > std::size_t(out_end - out))
+				return false;
+			// byte per byte: the match may overlap the output
+			const unsigned char* match = out - offset;
+			for (std::size_t i = 0; i < length; ++i)
+				out[i] = match[i];
+			out += length;
+		}
+
+		return out == out_end;
+	}
+
+}
@@ -0,0 +1,51 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_BLOCK_CODEC_H_
+#define _BASIC_BLOCK_CODEC_H_
+
+#include "basic_common.h"
+
+#include <vector>
+#include <cstddef>
+
+
+/**
+* A fast lossless compression of byte blocks (a byte-aligned LZ77, in the spirit of LZ4). Each 
+* block is compressed independently of the others, so that the blocks of a file can be compressed 
+* and decompressed by different threads. It trades ratio for speed: it is meant for data that 
+* was already made compact (quantized, delta-encoded), in which it removes the remaining repeats.
+*/
+
+namespace BlockCodec {
+
+	// the maximum size of the compressed data of a block of 'size' bytes
+	std::size_t BASIC_API max_compressed_size(std::size_t size);
+
+	// compresses the 'size' bytes of 'data', replacing the content of 'result'
+	void BASIC_API compress(const unsigned char* data, std::size_t size, std::vector<unsigned char>& result);
+
+	// decompresses a block into the 'size' bytes of 'result'. Returns false if the data is 
+	// corrupted or if it doesn't decompress to exactly 'size' bytes.
+	bool BASIC_API decompress(const unsigned char* data, std::size_t data_size, unsigned char* result, std::size_t size);
+
+}
+
+
+#endif
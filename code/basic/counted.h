@@ -43,6 +43,8 @@
 #include "smart_pointer.h"
 #include "assertions.h"
 
+#include <atomic>
+
 
 
 //____________________________________________________________________________
@@ -52,6 +54,10 @@
 * "reference count" memory management. They can be 
 * referred to by using SmartPointer<T>, calling ref()
 * and unref() when necessary.
+* The count is atomic, so that the objects can be shared by
+* several threads (the increments are relaxed, the decrements
+* acquire/release, so that the last owner sees all the writes
+* before deleting the object).
 * @see SmartPointer
 */
 
@@ -59,8 +65,12 @@ class BASIC_API Counted {
 
 public:
 	Counted() ;
+	// a copy is a new object, not referred to yet
+	Counted(const Counted&) ;
 	virtual ~Counted() ;
 
+	Counted& operator=(const Counted&) { return *this ; }
+
 	void ref() const ;
 	void unref() const ;
 	bool is_shared() const ;
@@ -70,7 +80,7 @@ public:
 
 protected:
 private:
-	int nb_refs_ ;
+	mutable std::atomic<int> nb_refs_ ;
 } ;
 
 //____________________________________________________________________________
@@ -78,24 +88,37 @@ private:
 inline Counted::Counted() : nb_refs_(0) {
 }
 
+inline Counted::Counted(const Counted&) : nb_refs_(0) {
+}
+
 inline void Counted::ref() const {
-	Counted* non_const_this = (Counted *)this ;
-	non_const_this->nb_refs_++ ;
+	nb_refs_.fetch_add(1, std::memory_order_relaxed) ;
 }
 
 inline void Counted::unref() const {
-	Counted* non_const_this = (Counted *)this ;    
-	non_const_this->nb_refs_-- ;
+	int nb_refs = nb_refs_.fetch_sub(1, std::memory_order_acq_rel) - 1 ;
 
-	ogf_assert(nb_refs_ >= 0) ;
+	ogf_assert(nb_refs >= 0) ;
 
-	if(nb_refs_ == 0) {
+	if(nb_refs == 0) {
 		delete this ;
 	}
 }
 
 inline bool Counted::is_shared() const {
-	return (nb_refs_ > 1) ;
+	return (nb_refs_.load(std::memory_order_acquire) > 1) ;
+}
+
+inline void Counted::ref(const Counted* counted) {
+	if(counted != nil) {
+		counted->ref() ;
+	}
+}
+
+inline void Counted::unref(const Counted* counted) {
+	if(counted != nil) {
+		counted->unref() ;
+	}
 }
 
 
@@ -310,6 +310,43 @@ public:
 		init() ;
 	}
 
+	/**
+	* Destroys all the elements, but keeps the chunks for the
+	* next creations (e.g., to reuse the list for another task
+	* of the same size without allocating memory).
+	*/
+	void recycle() {
+		{for(
+			Node* it = end_->next_; it != end_; it = it->next_
+			) {
+				it->data()->~T() ;
+		}}
+		{for(
+			Node* it=inactive_end_->next_; it!=inactive_end_; it=it->next_
+			) {
+				it->data()->~T() ;
+		}}
+
+		std::vector<Node*> chunks ;
+		chunks.swap(chunks_) ;
+		init() ;
+
+		// the free list in the order of the addresses
+		Node head ;
+		Node* tail = &head ;
+		for(unsigned int i=0; i<chunks.size(); i++) {
+			Memory::clear(chunks[i], sizeof(Node) * chunk_size) ;
+			for(unsigned int j=0; j<chunk_size; j++) {
+				tail->next_ = &(chunks[i][j]) ;
+				tail = tail->next_ ;
+				tail->prev_ = nil ;
+			}
+		}
+		tail->next_ = nil ;
+		free_list_ = head.next_ ;
+		chunks_.swap(chunks) ;
+	}
+
 	void clear_inactive_items() {
 		Node* it = inactive_end_->next_ ;
 		while(it != inactive_end_) {
@@ -324,9 +361,16 @@ public:
 	}
 
 	int size() const     { return size_ ; }
+	bool has_inactive_items() const { 
+		return inactive_end_->next_ != inactive_end_ ; 
+	}
 	int capacity() const { 
 		return chunks_.size() * chunk_size ;
 	}
+	/** the bytes allocated by the list (the chunks of nodes) */
+	std::size_t memory_usage() const {
+		return chunks_.size() * chunk_size * sizeof(Node) + chunks_.capacity() * sizeof(Node*) ;
+	}
 
 	iterator begin() { return iterator(end_->next_) ; }
 	iterator end() { return iterator(end_) ; }
@@ -429,6 +473,55 @@ public:
 		size_++ ;
 	}
 
+	/**
+	* Relinks the (active) elements in the order of items,
+	* which must contain each of them exactly once. Note that
+	* the elements are not moved in memory.
+	*/
+	void reorder(T* const* items, unsigned int nb) {
+		ogf_assert(int(nb) == size_) ;
+		end_->next_ = end_ ;
+		end_->prev_ = end_ ;
+		for(unsigned int i=0; i<nb; i++) {
+			append_node_to_list(reinterpret_cast<Node*>(items[i]), end_) ;
+		}
+	}
+
+	/**
+	* Deallocates the chunks that contain no element, and sorts
+	* the free list by address, such that the next created
+	* elements are next to each other in memory.
+	*/
+	void release_free_chunks() {
+		std::vector<Node*> kept ;
+		Node head ;
+		Node* tail = &head ;
+		for(unsigned int i=0; i<chunks_.size(); i++) {
+			Node* chunk = chunks_[i] ;
+			unsigned int nb_free = 0 ;
+			for(unsigned int j=0; j<chunk_size; j++) {
+				if(chunk[j].is_free()) {
+					nb_free++ ;
+				}
+			}
+			if(nb_free == chunk_size) {
+				Memory::clear(chunk, sizeof(Node) * chunk_size) ;
+				delete[] chunk ;
+				continue ;
+			}
+			for(unsigned int j=0; j<chunk_size && nb_free>0; j++) {
+				if(chunk[j].is_free()) {
+					tail->next_ = &(chunk[j]) ;
+					tail = tail->next_ ;
+				}
+			}
+			kept.push_back(chunk) ;
+		}
+		tail->next_ = nil ;
+		free_list_ = head.next_ ;
+		chunks_.swap(kept) ;
+	}
+
 protected:
 	void grow() {
 		Node* new_chunk = new Node[chunk_size] ;
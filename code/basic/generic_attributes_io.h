@@ -71,6 +71,36 @@ inline bool get_serializable_attributes(
 		return result ;
 }
 
+/**
+* Same as above, except that the attributes whose values can be written as their bytes
+* (see SerializedAttribute::write_binary()) go to 'binary_attributes' (and are not declared).
+*/
+template <class T> 
+inline bool get_serializable_attributes(
+	GenericAttributeManager<T>* manager, std::vector<SerializedAttribute<T> >& attributes,
+	std::vector<SerializedAttribute<T> >& binary_attributes,
+	std::ostream& out, const std::string& location, const std::string& attribute_kw = "# attribute"
+	) {
+		bool result = false ;
+		std::vector<std::string> names ;
+		manager->list_named_attributes(names) ;
+		for(unsigned int i=0; i<names.size(); i++) {
+			SerializedAttribute<T> attribute(manager, names[i]) ;
+			if(attribute.is_binary()) {
+				binary_attributes.push_back(attribute) ;
+			} else if(attribute.is_bound()) {
+				out << attribute_kw << " " << names[i] << " " << location << " " 
+					<< attribute.type_name() << std::endl ;
+				attributes.push_back(attribute) ;
+				result = true ;
+			} else {
+				std::cerr << "Attribute " << names[i] << " on " << location 
+					<< " is not serializable" << std::endl ;
+			}
+		}
+		return result ;
+}
+
 template <class T> 
 inline void serialize_read_attributes(
 	std::istream& in, const T* item, std::vector<SerializedAttribute<T> >& attributes
@@ -0,0 +1,123 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "instrumentation.h"
+
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+
+namespace {
+
+	std::atomic<std::size_t>	num_allocations(0);
+	std::atomic<std::size_t>	num_allocated_bytes(0);
+
+	// the event counters, in the order of their creation. A function-local static, as the counters
+	// of the other libraries are created during their static initialization.
+	std::mutex& counters_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+	std::vector<EventCounter*>& all_counters() {
+		static std::vector<EventCounter*> counters;
+		return counters;
+	}
+
+}
+
+
+EventCounter::EventCounter(const char* name) : name_(name), value_(0) {
+	std::lock_guard<std::mutex> lock(counters_mutex());
+	all_counters().push_back(this);
+}
+
+
+EventCounter::~EventCounter() {
+	std::lock_guard<std::mutex> lock(counters_mutex());
+	std::vector<EventCounter*>& counters = all_counters();
+	counters.erase(std::remove(counters.begin(), counters.end(), this), counters.end());
+}
+
+
+namespace Instrumentation {
+
+	bool enabled() {
+#ifdef POLYFIT_INSTRUMENTATION
+		return true;
+#else
+		return false;
+#endif
+	}
+
+
+	void counters(std::vector< std::pair<std::string, std::size_t> >& values) {
+		values.clear();
+		if (!enabled())
+			return;
+
+		values.push_back(std::make_pair(std::string("allocations"), num_allocations.load(std::memory_order_relaxed)));
+		values.push_back(std::make_pair(std::string("allocated bytes"), num_allocated_bytes.load(std::memory_order_relaxed)));
+		std::lock_guard<std::mutex> lock(counters_mutex());
+		const std::vector<EventCounter*>& counters = all_counters();
+		for (std::size_t i = 0; i < counters.size(); ++i)
+			values.push_back(std::make_pair(std::string(counters[i]->name()), counters[i]->value()));
+	}
+
+}
+
+
+#ifdef POLYFIT_INSTRUMENTATION
+
+namespace {
+
+	void* counted_malloc(std::size_t size) {
+		num_allocations.fetch_add(1, std::memory_order_relaxed);
+		num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+		return std::malloc(size == 0 ? 1 : size);
+	}
+
+	void* counted_new(std::size_t size) {
+		for (;;) {
+			void* p = counted_malloc(size);
+			if (p)
+				return p;
+			std::new_handler handler = std::set_new_handler(0);
+			std::set_new_handler(handler);
+			if (!handler)
+				throw std::bad_alloc();
+			handler();
+		}
+	}
+
+}
+
+
+void* operator new(std::size_t size) { return counted_new(size); }
+void* operator new[](std::size_t size) { return counted_new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return counted_malloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_malloc(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
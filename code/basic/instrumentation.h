@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_INSTRUMENTATION_H_
+#define _BASIC_INSTRUMENTATION_H_
+
+#include "basic_common.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <utility>
+
+
+/**
+* The counters of the instrumentation build (configured with POLYFIT_INSTRUMENTATION): the number of
+* allocations and of allocated bytes (counted by a replacement of the global operator new), and the
+* EventCounters of the hot loops (e.g., the cuts, the kNN queries). The Profiler adds the increase of
+* each counter during a stage to the counters of the stage, so they appear in the profiling JSON.
+* The counters are global: the events of all the threads during a stage are attributed to it (e.g.,
+* the ones of the workers of parallel_for(), but also the ones of concurrent jobs).
+* In the other builds, the counters compile to nothing.
+*
+* NOTE: the global operator new is replaced by the 'basic' library, which works on Linux and macOS 
+*       (where the first definition loaded replaces the one of the C++ library for the whole process),
+*       but not for the other DLLs on Windows.
+*/
+
+// A counter of an event (e.g., a cut), which must have static storage duration.
+class BASIC_API EventCounter
+{
+public:
+	EventCounter(const char* name);
+	~EventCounter();
+
+#ifdef POLYFIT_INSTRUMENTATION
+	void add(std::size_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+#else
+	void add(std::size_t = 1) {}
+#endif
+
+	const char* name() const { return name_; }
+	std::size_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	const char*					name_;
+	std::atomic<std::size_t>	value_;
+};
+
+
+namespace Instrumentation {
+
+	// if this is an instrumentation build
+	BASIC_API bool enabled();
+
+	// the current values of the counters (the allocations first), by their names
+	BASIC_API void counters(std::vector< std::pair<std::string, std::size_t> >& values);
+
+}
+
+
+#endif
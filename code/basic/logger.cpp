@@ -40,6 +40,8 @@
 #include "basic_types.h"
 #include "assertions.h"
 #include <stdarg.h>
+#include <memory>
+#include <chrono>
 
 /* 
 Disables the warning caused by passing 'this' as an argument while
@@ -62,6 +64,8 @@ inline std::ostream& noop(std::ostream& out) { return out ; }
 
 int LoggerStreamBuf::sync(){
 	std::string str(this->str());
+	if (str.empty())	// e.g., the std::endl of a disabled message
+		return 0;
 	loggerStream_->notify(str);
 	this->str("");
 	return 0;
@@ -69,8 +73,87 @@ int LoggerStreamBuf::sync(){
 
 //_________________________________________________________
 
-LoggerStream::LoggerStream(Logger* logger)
-: std::ostream(new LoggerStreamBuf(this)), logger_(logger) {
+/**
+* A bounded lock-free queue of messages (D. Vyukov's MPMC queue,
+* used with a single consumer). Each cell has a sequence number 
+* that tells the producers and the consumer whose turn it is.
+*/
+class LoggerQueue {
+public:
+	struct Message {
+		LoggerStream::Kind kind ;
+		std::string feature ;
+		std::string text ;
+	} ;
+
+	LoggerQueue(std::size_t capacity) // a power of two
+		: cells_(new Cell[capacity]), mask_(capacity - 1), enqueue_pos_(0), dequeue_pos_(0) {
+		for (std::size_t i = 0; i < capacity; ++i)
+			cells_[i].sequence.store(i, std::memory_order_relaxed) ;
+	}
+
+	// returns false if the queue is full
+	bool push(Message& msg) {
+		std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed) ;
+		for (;;) {
+			Cell& cell = cells_[pos & mask_] ;
+			std::size_t seq = cell.sequence.load(std::memory_order_acquire) ;
+			std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos) ;
+			if (diff == 0) {
+				if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.msg.kind = msg.kind ;
+					cell.msg.feature.swap(msg.feature) ;
+					cell.msg.text.swap(msg.text) ;
+					cell.sequence.store(pos + 1, std::memory_order_release) ;
+					return true ;
+				}
+			}
+			else if (diff < 0)
+				return false ;
+			else
+				pos = enqueue_pos_.load(std::memory_order_relaxed) ;
+		}
+	}
+
+	// returns false if the queue is empty
+	bool pop(Message& msg) {
+		std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed) ;
+		for (;;) {
+			Cell& cell = cells_[pos & mask_] ;
+			std::size_t seq = cell.sequence.load(std::memory_order_acquire) ;
+			std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1) ;
+			if (diff == 0) {
+				if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					msg.kind = cell.msg.kind ;
+					msg.feature.swap(cell.msg.feature) ;
+					msg.text.swap(cell.msg.text) ;
+					cell.sequence.store(pos + mask_ + 1, std::memory_order_release) ;
+					return true ;
+				}
+			}
+			else if (diff < 0)
+				return false ;
+			else
+				pos = dequeue_pos_.load(std::memory_order_relaxed) ;
+		}
+	}
+
+private:
+	struct Cell {
+		std::atomic<std::size_t> sequence ;
+		Message msg ;
+	} ;
+
+	std::unique_ptr<Cell[]>	 cells_ ;
+	std::size_t				 mask_ ;
+	std::atomic<std::size_t> enqueue_pos_ ;
+	std::atomic<std::size_t> dequeue_pos_ ;
+} ;
+
+//_________________________________________________________
+
+LoggerStream::LoggerStream(Logger* logger, Kind kind)
+: std::ostream(new LoggerStreamBuf(this)), logger_(logger), kind_(kind) {
 }
 
 LoggerStream::~LoggerStream() {
@@ -198,6 +281,17 @@ bool Logger::set_value(FeatureName name, const std::string& value)
 		}
 		return true ;
 	} 
+	else if (name == LOG_LEVEL) {
+		if (value == "out")
+			level_ = LoggerStream::OUT ;
+		else if (value == "warn")
+			level_ = LoggerStream::WARN ;
+		else if (value == "err")
+			level_ = LoggerStream::ERR ;
+		else
+			return false ;
+		return true ;
+	}
 	else {
 		ogf_assert_not_reached;
 		return false ;
@@ -232,6 +326,14 @@ bool Logger::resolve(FeatureName name, std::string& value) const {
 		}
 		return true ;
 	} 
+	else if (name == LOG_LEVEL) {
+		switch (level_) {
+		case LoggerStream::OUT:  value = "out" ;  break ;
+		case LoggerStream::WARN: value = "warn" ; break ;
+		default:                 value = "err" ;  break ;
+		}
+		return true ;
+	}
 	else {
 		ogf_assert_not_reached;
 		return false ;
@@ -240,28 +342,48 @@ bool Logger::resolve(FeatureName name, std::string& value) const {
 
 
 void Logger::register_client(LoggerClient* c){
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
 	clients.insert(c);
 }
 
 void Logger::unregister_client(LoggerClient* c){
+	// the client still receives the messages written before
+	wait_delivered();
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
 	clients.erase(c);
 }
 
 bool Logger::is_client(LoggerClient* c){
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
 	return clients.find(c) != clients.end();
 }
 
 
-Logger::Logger() : out_(this), warn_(this), err_(this), status_(this) {
+Logger::Logger() 
+: thread_(std::this_thread::get_id())
+, out_(this, LoggerStream::OUT), warn_(this, LoggerStream::WARN), err_(this, LoggerStream::ERR), status_(this, LoggerStream::STATUS)
+, level_(LoggerStream::OUT), queue_(new LoggerQueue(1024)), stop_(false), num_queued_(0), num_delivered_(0) {
 	log_everything_ = false ;
 
 	// add a default client printing stuff to std::cout
 	default_client_ = new CoutLogger(); 
 	register_client(default_client_ );
 	file_client_ = nil ;
+
+	delivery_thread_ = std::thread(&Logger::deliver_queued, this);
 }
 
 Logger::~Logger() {
+	// delivers the remaining messages
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex_);
+		stop_ = true;
+	}
+	wake_.notify_one();
+	delivery_thread_.join();
+	delete queue_;
+	queue_ = nil;
+
 	delete default_client_;
 	default_client_ = nil;
 
@@ -291,43 +413,104 @@ LoggerStream& Logger::status() {
 	return instance_->status_stream() ;
 }
 
+bool Logger::is_enabled(LoggerStream::Kind kind, const std::string& feature) {
+	ogf_assert(instance_ != nil) ;
+	if (kind == LoggerStream::STATUS)
+		return true ;
+	if (kind < instance_->level_)
+		return false ;
+	return kind != LoggerStream::OUT || instance_->feature_enabled(feature) ;
+}
+
+void Logger::flush() {
+	ogf_assert(instance_ != nil) ;
+	instance_->wait_delivered() ;
+}
+
+bool Logger::feature_enabled(const std::string& feature) const {
+	if (log_everything_)
+		return log_features_exclude_.empty() || log_features_exclude_.find(feature) == log_features_exclude_.end() ;
+	return !log_features_.empty() && log_features_.find(feature) != log_features_.end() ;
+}
+
+// a disabled stream fails, so the messages written to it are not even formatted
 LoggerStream& Logger::out_stream(const std::string& feature) {
-	current_feature_ = feature ;
-	return out_ ;
+	LoggerStream& s = stream(LoggerStream::OUT) ;
+	s.feature_ = feature ;
+	s.clear(is_enabled(LoggerStream::OUT, feature) ? std::ios::goodbit : std::ios::badbit) ;
+	return s ;
 }
 
 LoggerStream& Logger::err_stream(const std::string& feature) {
-	current_feature_ = feature ;
-	return err_ ;
+	LoggerStream& s = stream(LoggerStream::ERR) ;
+	s.feature_ = feature ;
+	return s ;
 }
 
 LoggerStream& Logger::warn_stream(const std::string& feature) {
-	current_feature_ = feature ;
-	return warn_ ;
+	LoggerStream& s = stream(LoggerStream::WARN) ;
+	s.feature_ = feature ;
+	s.clear(is_enabled(LoggerStream::WARN, feature) ? std::ios::goodbit : std::ios::badbit) ;
+	return s ;
 }
 
 LoggerStream& Logger::status_stream() {
-	return status_ ;
+	return stream(LoggerStream::STATUS) ;
 }
 
 
+namespace {
+	// the streams of a thread other than the one that created the logger
+	struct ThreadStreams {
+		ThreadStreams(Logger* logger) 
+			: logger_(logger)
+			, out_(logger, LoggerStream::OUT), warn_(logger, LoggerStream::WARN)
+			, err_(logger, LoggerStream::ERR), status_(logger, LoggerStream::STATUS) {
+		}
+
+		Logger*		 logger_ ;
+		LoggerStream out_ ;
+		LoggerStream warn_ ;
+		LoggerStream err_ ;
+		LoggerStream status_ ;
+	} ;
+}
+
+LoggerStream& Logger::stream(LoggerStream::Kind kind) {
+	if (std::this_thread::get_id() == thread_) {
+		switch (kind) {
+		case LoggerStream::OUT:  return out_ ;
+		case LoggerStream::WARN: return warn_ ;
+		case LoggerStream::ERR:  return err_ ;
+		default:                 return status_ ;
+		}
+	}
+
+	// created on the first message of the thread, and again if the logger was re-initialized
+	static thread_local std::unique_ptr<ThreadStreams> streams ;
+	if (!streams || streams->logger_ != this)
+		streams.reset(new ThreadStreams(this)) ;
+	switch (kind) {
+	case LoggerStream::OUT:  return streams->out_ ;
+	case LoggerStream::WARN: return streams->warn_ ;
+	case LoggerStream::ERR:  return streams->err_ ;
+	default:                 return streams->status_ ;
+	}
+}
+
+
+// the features were filtered when the message was written (see out_stream())
 void Logger::notify_out(const std::string& message){
-	if( 
-		(log_everything_ && log_features_exclude_.find(current_feature_)
-		== log_features_exclude_.end() )
-		|| (log_features_.find(current_feature_) != log_features_.end())
-		) {
-			std::set<LoggerClient*>::iterator it = clients.begin();
-			if (current_feature_.empty()) {
-				for (; it != clients.end(); it++) {
-					(*it)->out_message( message );
-				}
-			} else {
-				for (; it != clients.end(); it++) {
-					(*it)->out_message( current_feature_ + " " + message );
-				}
-			}
-	} 
+	std::set<LoggerClient*>::iterator it = clients.begin();
+	if (current_feature_.empty()) {
+		for (; it != clients.end(); it++) {
+			(*it)->out_message( message );
+		}
+	} else {
+		for (; it != clients.end(); it++) {
+			(*it)->out_message( current_feature_ + " " + message );
+		}
+	}
 }
 void Logger::notify_warn(const std::string& message){
 	std::set<LoggerClient*>::iterator it = clients.begin();
@@ -369,15 +552,76 @@ void Logger::notify_status(const std::string& message, int timeout){
 
 
 void Logger::notify(LoggerStream* s, std::string& message) {
-	if(s == &out_) {
+	// a client writing a message while it is notified
+	if (std::this_thread::get_id() == delivery_thread_.get_id()) {
+		deliver(s->kind_, s->feature_, message);
+		return;
+	}
+
+	LoggerQueue::Message msg;
+	msg.kind = s->kind_;
+	msg.feature = s->feature_;
+	msg.text.swap(message);
+	while (!queue_->push(msg)) {	// full: waits for the delivery thread
+		wake_.notify_one();
+		std::this_thread::yield();
+	}
+	++num_queued_;
+	wake_.notify_one();
+
+	if (s->kind_ == LoggerStream::ERR)
+		wait_delivered();
+}
+
+
+void Logger::deliver_queued() {
+	LoggerQueue::Message msg;
+	for (;;) {
+		while (queue_->pop(msg)) {
+			deliver(msg.kind, msg.feature, msg.text);
+			++num_delivered_;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex_);
+		delivered_.notify_all();
+		if (stop_ && num_delivered_ == num_queued_)
+			return;
+		// the timeout covers a message queued right before waiting
+		wake_.wait_for(lock, std::chrono::milliseconds(10));
+	}
+}
+
+
+void Logger::wait_delivered() {
+	if (std::this_thread::get_id() == delivery_thread_.get_id())
+		return;
+
+	std::size_t target = num_queued_;
+	std::unique_lock<std::mutex> lock(wake_mutex_);
+	while (num_delivered_ < target) {
+		wake_.notify_one();
+		delivered_.wait_for(lock, std::chrono::milliseconds(10));
+	}
+}
+
+
+void Logger::deliver(LoggerStream::Kind kind, const std::string& feature, const std::string& message) {
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+	current_feature_ = feature ;
+	switch (kind) {
+	case LoggerStream::OUT:
 		notify_out(message);
-	} else if (s == &warn_) {
+		break;
+	case LoggerStream::WARN:
 		notify_warn(message);
-	} else if (s == &err_) {
+		break;
+	case LoggerStream::ERR:
 		notify_err(message);
-	} else if(s == &status_) {
+		break;
+	case LoggerStream::STATUS:
 		notify_status(message, 0);
-	} else {
+		break;
+	default:
 		ogf_assert(false) ;
 	}
 }
@@ -45,12 +45,17 @@
 #include <sstream>
 #include <string>
 #include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 
 
 //_________________________________________________________
 
 class Logger ;
 class LoggerStream ;
+class LoggerQueue ;
 
 class LoggerStreamBuf : public std::stringbuf {
 public:
@@ -65,8 +70,9 @@ private:
 
 class LoggerStream : public std::ostream {
 public:
+	enum Kind { OUT, WARN, ERR, STATUS } ;
 
-	LoggerStream(Logger* logger);
+	LoggerStream(Logger* logger, Kind kind);
     virtual ~LoggerStream() ;
 
 protected:
@@ -74,8 +80,11 @@ protected:
 private:
 
 	Logger* logger_ ;
+	Kind	kind_ ;
+	std::string feature_ ;	// of the message being written
 
     friend class ::LoggerStreamBuf;
+    friend class Logger;
 } ;
 
 
@@ -136,6 +145,17 @@ private:
 * a string corresponding to the name of the class.
 * Logger::warn() puts the message into the status bar, 
 * so it doesn't need the name.
+* The messages can be written from any thread: each thread 
+* writes into streams of its own, and the clients are 
+* notified of one complete message at a time.
+* The complete messages are put into a lock-free queue and 
+* delivered to the clients by a background thread, so the 
+* writers never wait for the clients (e.g., the GUI). The 
+* errors are delivered before Logger::err() returns. 
+* A message whose level (LOG_LEVEL) or feature is disabled
+* is not formatted at all: its stream is in a failed state
+* and ignores everything written to it. Hot loops can also 
+* test Logger::is_enabled() before computing the values.
 */
 
 class BASIC_API Logger {
@@ -178,10 +198,23 @@ public:
 	*/
 	static LoggerStream& status() ;
 
+	/**
+	* returns true if a message of the given kind and feature
+	* would be delivered. Example: <pre>
+	*   if (Logger::is_enabled(LoggerStream::OUT, "-"))
+	*       Logger::out("-") << "energy: " << compute_energy() << std::endl ;
+	* </pre>
+	*/
+	static bool is_enabled(LoggerStream::Kind kind, const std::string& feature) ;
+
+	/** waits until all the messages written so far have been delivered to the clients */
+	static void flush() ;
+
 	enum FeatureName {
 		LOG_FILE_NAME, 
 		LOG_REGISTER_FEATURES, 
-		LOG_EXCLUDE_FEATURES
+		LOG_EXCLUDE_FEATURES,
+		LOG_LEVEL		// "out" (default), "warn", or "err": the least severe messages logged
 	};
 	virtual bool set_value(FeatureName name, const std::string& value)  ;
 	virtual bool resolve(FeatureName name, std::string& value) const ;
@@ -196,12 +229,21 @@ protected:
 	//void flush_stream(LoggerStream* s) ;
 	void notify(LoggerStream* from, std::string& message);
 
+	// notifies the clients (on the delivery thread, or on the calling thread if it is the delivery thread)
+	void deliver(LoggerStream::Kind kind, const std::string& feature, const std::string& message);
+	void deliver_queued() ;
+	void wait_delivered() ;
+	bool feature_enabled(const std::string& feature) const ;
+
 protected:
 	LoggerStream& out_stream(const std::string& feature) ;
 	LoggerStream& err_stream(const std::string& feature) ;
 	LoggerStream& warn_stream(const std::string& feature) ;
 	LoggerStream& status_stream() ;
 
+	// the stream of the calling thread
+	LoggerStream& stream(LoggerStream::Kind kind) ;
+
 	void notify_out(const std::string& message);
 	void notify_warn(const std::string& message);
 	void notify_err(const std::string& message);
@@ -215,6 +257,8 @@ private:
 	LoggerClient* file_client_;
 
 
+	// the streams of the thread that created the logger (the other threads have their own)
+	std::thread::id thread_ ;
 	LoggerStream out_ ;
 	LoggerStream warn_ ;
 	LoggerStream err_ ;
@@ -226,10 +270,25 @@ private:
 	bool log_everything_ ;
 	std::string log_file_name_ ;
 
-	std::string current_feature_ ;
+	std::string current_feature_ ;	// of the message being notified
+
+	std::atomic<int> level_ ;		// the least severe kind logged (LoggerStream::ERR > WARN > OUT)
+
+	// the messages waiting for delivery, and the thread delivering them
+	LoggerQueue* queue_ ;
+	std::thread	 delivery_thread_ ;
+	std::atomic<bool> stop_ ;
+	std::atomic<std::size_t> num_queued_ ;
+	std::atomic<std::size_t> num_delivered_ ;
+	std::mutex	 wake_mutex_ ;
+	std::condition_variable wake_ ;			// a message was queued
+	std::condition_variable delivered_ ;	// the queue was emptied
 
 	std::set<LoggerClient*> clients; // list of registered clients (observers)
 
+	// serializes the notifications and the changes of the clients (recursive in case a client logs)
+	std::recursive_mutex mutex_ ;
+
 	friend class LoggerStream ;
 } ;
 
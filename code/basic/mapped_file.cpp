@@ -0,0 +1,124 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "mapped_file.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef WIN32
+
+MappedFile::MappedFile(const std::string& file_name) 
+: data_(nil)
+, size_(0)
+, file_(INVALID_HANDLE_VALUE)
+, mapping_(nil)
+{
+	file_ = ::CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nil, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nil);
+	if (file_ == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+		close();
+		return;
+	}
+
+	mapping_ = ::CreateFileMappingA(file_, nil, PAGE_READONLY, 0, 0, nil);
+	if (mapping_ == nil) {
+		close();
+		return;
+	}
+
+	data_ = static_cast<const char*>(::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (data_ == nil) {
+		close();
+		return;
+	}
+	size_ = static_cast<std::size_t>(size.QuadPart);
+}
+
+
+void MappedFile::advise_sequential() const {
+	// the file is opened with FILE_FLAG_SEQUENTIAL_SCAN
+}
+
+
+void MappedFile::close() {
+	if (data_)
+		::UnmapViewOfFile(data_);
+	if (mapping_)
+		::CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE)
+		::CloseHandle(file_);
+	data_ = nil;
+	size_ = 0;
+	mapping_ = nil;
+	file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& file_name) 
+: data_(nil)
+, size_(0)
+{
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat info;
+	if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* addr = ::mmap(nil, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			data_ = static_cast<const char*>(addr);
+			size_ = static_cast<std::size_t>(info.st_size);
+		}
+	}
+	::close(fd);	// the mapping stays valid
+}
+
+
+void MappedFile::advise_sequential() const {
+	if (data_)
+		::madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+}
+
+
+void MappedFile::close() {
+	if (data_)
+		::munmap(const_cast<char*>(data_), size_);
+	data_ = nil;
+	size_ = 0;
+}
+
+#endif
+
+
+MappedFile::~MappedFile() {
+	close();
+}
@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_MAPPED_FILE_H_
+#define _BASIC_MAPPED_FILE_H_
+
+#include "basic_common.h"
+#include "basic_types.h"
+
+#include <string>
+
+
+/**
+* A read-only memory mapping of a whole file. The content is paged in on demand (by the operating 
+* system, from its page cache), so reading a large file through the mapping needs neither a stream
+* buffer nor a copy of the bytes that are not used.
+*
+* usage example:
+*   MappedFile file(file_name);
+*   if (file.is_open())
+*       parse(file.data(), file.size());
+*/
+
+class BASIC_API MappedFile
+{
+public:
+	// maps the file (is_open() tells if it succeeded)
+	MappedFile(const std::string& file_name);
+	~MappedFile();
+
+	bool is_open() const { return data_ != nil; }
+
+	const char* data() const { return data_; }
+	std::size_t size() const { return size_; }
+
+	// tells the operating system that the content will be read from the beginning to the end
+	void advise_sequential() const;
+
+	// unmaps the file
+	void close();
+
+private:
+	// not copyable
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+	const char*	data_;
+	std::size_t	size_;
+
+#ifdef WIN32
+	void*	file_;
+	void*	mapping_;
+#endif
+};
+
+
+#endif
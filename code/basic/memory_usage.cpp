@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "memory_usage.h"
+#include "profiler.h"
+
+#include <sstream>
+
+
+void MemoryUsage::add(const std::string& name, double bytes) {
+	for (std::size_t i = 0; i < items_.size(); ++i) {
+		if (items_[i].name == name) {
+			items_[i].bytes += bytes;
+			return;
+		}
+	}
+	items_.push_back(Item(name, bytes));
+}
+
+
+void MemoryUsage::add(const std::string& prefix, const MemoryUsage& other) {
+	for (std::size_t i = 0; i < other.items_.size(); ++i)
+		add(prefix + "/" + other.items_[i].name, other.items_[i].bytes);
+}
+
+
+double MemoryUsage::total() const {
+	double sum = 0;
+	for (std::size_t i = 0; i < items_.size(); ++i)
+		sum += items_[i].bytes;
+	return sum;
+}
+
+
+void MemoryUsage::add_to_profile(const std::string& owner) const {
+	for (std::size_t i = 0; i < items_.size(); ++i)
+		Profiler::add_counter("memory " + owner + "/" + items_[i].name, items_[i].bytes);
+	Profiler::add_counter("memory " + owner, total());
+}
+
+
+std::string MemoryUsage::to_string(double bytes) {
+	static const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+	int unit = 0;
+	while (bytes >= 1024.0 && unit < 4) {
+		bytes /= 1024.0;
+		++unit;
+	}
+
+	std::ostringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(unit == 0 ? 0 : 1);
+	out << bytes << " " << units[unit];
+	return out.str();
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_MEMORY_USAGE_H_
+#define _BASIC_MEMORY_USAGE_H_
+
+#include "basic_common.h"
+
+#include <string>
+#include <vector>
+
+
+/**
+* A breakdown of the memory used by a data structure, in bytes (e.g., the topology and each 
+* named attribute of a Map). Only the memory owned by the structure is counted, i.e., the 
+* capacity of its arrays, not what the stored elements may point to.
+*
+* usage example:
+*   MemoryUsage usage = mesh->memory_usage();
+*   Logger::out("-") << "candidate mesh: " << MemoryUsage::to_string(usage.total()) << std::endl;
+*   usage.add_to_profile("candidate mesh");
+*/
+
+class BASIC_API MemoryUsage
+{
+public:
+	struct Item {
+		Item(const std::string& n = "", double b = 0) : name(n), bytes(b) {}
+		std::string	name;
+		double		bytes;
+	};
+
+	// adds 'bytes' to the item 'name' (created if needed)
+	void add(const std::string& name, double bytes);
+	// adds the items of 'other' as "prefix/name"
+	void add(const std::string& prefix, const MemoryUsage& other);
+
+	const std::vector<Item>& items() const { return items_; }
+	double total() const;
+
+	// adds the items and the total as the counters "memory <owner>/<item>" (in bytes) 
+	// of the current profiling stage (see Profiler)
+	void add_to_profile(const std::string& owner) const;
+
+	// e.g., "12.3 MB"
+	static std::string to_string(double bytes);
+
+	// the memory allocated by a vector
+	template <class T, class A> 
+	static double of(const std::vector<T, A>& v) { return double(v.capacity()) * sizeof(T); }
+
+private:
+	std::vector<Item> items_;
+};
+
+
+#endif
@@ -0,0 +1,379 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "metrics_exporter.h"
+#include "logger.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <map>
+#include <cstdio>
+#include <algorithm>
+
+
+std::atomic<bool> MetricsExporter::enabled_(false);
+
+
+namespace {
+
+	enum Type { COUNTER, GAUGE, HISTOGRAM, SUMMARY };
+
+	const char* type_name(Type type) {
+		switch (type) {
+		case COUNTER:	return "counter";
+		case GAUGE:		return "gauge";
+		case HISTOGRAM:	return "histogram";
+		default:		return "summary";
+		}
+	}
+
+	struct Series {
+		Series() : value(0), sum(0), count(0) {}
+
+		double				value;		// of a counter or a gauge
+		std::vector<double>	buckets;	// the cumulative counts of a histogram (without +Inf, i.e., 'count')
+		double				sum;
+		double				count;
+	};
+
+	struct Family {
+		Family() : type(GAUGE) {}
+
+		Type								type;
+		std::string							help;
+		std::vector<double>					upper_bounds;	// of the buckets of a histogram
+		std::map<std::string, Series>		series;			// by their labels
+	};
+
+	std::mutex						metrics_mutex;
+	std::map<std::string, Family>	metrics_families;
+	std::map<std::string, std::string>	metrics_help;	// described before their first series
+
+
+	// of the durations, in sec.
+	std::vector<double> duration_buckets() {
+		const double bounds[] = { 0.001, 0.01, 0.1, 0.5, 1, 5, 10, 30, 60, 300, 600, 1800, 3600, 7200 };
+		return std::vector<double>(bounds, bounds + sizeof(bounds) / sizeof(bounds[0]));
+	}
+
+	// of the sizes of the memory, from 1 MB to 64 GB
+	std::vector<double> memory_buckets() {
+		std::vector<double> bounds;
+		for (double b = 1024.0 * 1024.0; b <= 64.0 * 1024.0 * 1024.0 * 1024.0; b *= 4.0)
+			bounds.push_back(b);
+		return bounds;
+	}
+
+
+	// the family 'name' (the mutex must be locked), created with 'type'
+	Family& family_locked(const std::string& name, Type type) {
+		std::map<std::string, Family>::iterator pos = metrics_families.find(name);
+		if (pos != metrics_families.end())
+			return pos->second;
+
+		Family& family = metrics_families[name];
+		family.type = type;
+		std::map<std::string, std::string>::const_iterator help = metrics_help.find(name);
+		if (help != metrics_help.end())
+			family.help = help->second;
+		if (type == HISTOGRAM)
+			family.upper_bounds = duration_buckets();
+		return family;
+	}
+
+
+	void observe_locked(const std::string& name, const std::string& labels, double value, Type type) {
+		Family& family = family_locked(name, type);
+		Series& series = family.series[labels];
+		if (family.type == HISTOGRAM) {
+			if (series.buckets.size() != family.upper_bounds.size())
+				series.buckets.resize(family.upper_bounds.size(), 0.0);
+			for (std::size_t i = 0; i < family.upper_bounds.size(); ++i) {
+				if (value <= family.upper_bounds[i])
+					series.buckets[i] += 1.0;
+			}
+		}
+		series.sum += value;
+		series.count += 1.0;
+	}
+
+
+	std::string number(double value) {
+		std::ostringstream out;
+		out.precision(12);
+		out << value;
+		return out.str();
+	}
+
+
+	// the name of a sample of a series with its labels (and more, e.g., the bound of a bucket)
+	std::string sample(const std::string& name, const std::string& labels, const std::string& more = "") {
+		if (labels.empty() && more.empty())
+			return name;
+		if (labels.empty())
+			return name + "{" + more + "}";
+		if (more.empty())
+			return name + "{" + labels + "}";
+		return name + "{" + labels + "," + more + "}";
+	}
+
+
+	// the samples of the process, sampled when the metrics are written
+	void sample_process() {
+		ThreadPool* pool = ThreadPool::instance();
+		MetricsExporter::set_gauge("polyfit_pool_threads", "", ThreadPool::num_threads());
+		MetricsExporter::set_gauge("polyfit_active_threads", "", pool->num_running() + pool->num_reserved());
+		MetricsExporter::set_gauge("polyfit_process_peak_memory_bytes", "", Profiler::process_peak_memory());
+		MetricsExporter::set_gauge("polyfit_process_cpu_seconds", "", Profiler::process_cpu_time());
+	}
+
+
+	// writes the metrics periodically
+	class Writer {
+	public:
+		Writer(const std::string& file_name, double interval) 
+			: file_name_(file_name), interval_(interval), stopping_(false), thread_(&Writer::run, this) {}
+		~Writer() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			wake_.notify_all();
+			thread_.join();
+			MetricsExporter::save(file_name_);	// the final values
+		}
+
+	private:
+		void run() {
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (!stopping_) {
+				wake_.wait_for(lock, std::chrono::duration<double>(interval_), [this]() { return stopping_; });
+				if (stopping_)
+					break;
+				lock.unlock();
+				MetricsExporter::save(file_name_);
+				lock.lock();
+			}
+		}
+
+	private:
+		std::string				file_name_;
+		double					interval_;
+		bool					stopping_;
+		std::mutex				mutex_;
+		std::condition_variable	wake_;
+		std::thread				thread_;
+	};
+
+	std::mutex					writer_mutex;
+	std::unique_ptr<Writer>		writer;
+
+}
+
+
+void MetricsExporter::set_enabled(bool b) {
+	if (b && !enabled_) {
+		describe("polyfit_stage_duration_seconds", "The wall time of the stages of the Profiler.");
+		describe("polyfit_stage_counter", "The counters of the stages of the Profiler.");
+		describe("polyfit_job_peak_memory_increase_bytes", "The increase of the peak resident memory during the top-level stages.");
+		describe("polyfit_pool_threads", "The global thread budget.");
+		describe("polyfit_active_threads", "The threads running tasks of the pool or reserved by the solvers.");
+		describe("polyfit_process_peak_memory_bytes", "The peak resident memory of the process.");
+		describe("polyfit_process_cpu_seconds", "The CPU time of all the threads of the process.");
+		set_buckets("polyfit_job_peak_memory_increase_bytes", memory_buckets());
+	}
+	enabled_ = b;
+}
+
+
+void MetricsExporter::describe(const std::string& name, const std::string& help) {
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	metrics_help[name] = help;
+	std::map<std::string, Family>::iterator pos = metrics_families.find(name);
+	if (pos != metrics_families.end())
+		pos->second.help = help;
+}
+
+
+void MetricsExporter::add_counter(const std::string& name, const std::string& labels, double value) {
+	if (!is_enabled())
+		return;
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	family_locked(name, COUNTER).series[labels].value += value;
+}
+
+
+void MetricsExporter::set_gauge(const std::string& name, const std::string& labels, double value) {
+	if (!is_enabled())
+		return;
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	family_locked(name, GAUGE).series[labels].value = value;
+}
+
+
+void MetricsExporter::observe(const std::string& name, const std::string& labels, double value) {
+	if (!is_enabled())
+		return;
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	observe_locked(name, labels, value, HISTOGRAM);
+}
+
+
+void MetricsExporter::set_buckets(const std::string& name, const std::vector<double>& upper_bounds) {
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	Family& family = family_locked(name, HISTOGRAM);
+	if (family.type != HISTOGRAM || family.upper_bounds == upper_bounds)
+		return;
+	family.upper_bounds = upper_bounds;
+	family.series.clear();	// their buckets don't match anymore
+}
+
+
+void MetricsExporter::observe_summary(const std::string& name, const std::string& labels, double value) {
+	if (!is_enabled())
+		return;
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	observe_locked(name, labels, value, SUMMARY);
+}
+
+
+std::string MetricsExporter::label(const std::string& key, const std::string& value) {
+	std::string result = key + "=\"";
+	for (std::size_t i = 0; i < value.size(); ++i) {
+		char c = value[i];
+		if (c == '\\' || c == '\"')
+			result += '\\';
+		if (c == '\n')
+			result += "\\n";
+		else
+			result += c;
+	}
+	return result + "\"";
+}
+
+
+void MetricsExporter::record_stage(const std::string& name, int depth, double wall_time, double peak_memory_increase,
+	const std::vector< std::pair<std::string, double> >& counters) 
+{
+	if (!is_enabled())
+		return;
+
+	const std::string stage = label("stage", name);
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	observe_locked("polyfit_stage_duration_seconds", stage, wall_time, HISTOGRAM);
+	for (std::size_t i = 0; i < counters.size(); ++i)
+		observe_locked("polyfit_stage_counter", stage + "," + label("counter", counters[i].first), counters[i].second, SUMMARY);
+	if (depth == 0)
+		observe_locked("polyfit_job_peak_memory_increase_bytes", stage, peak_memory_increase, HISTOGRAM);
+}
+
+
+void MetricsExporter::reset() {
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	metrics_families.clear();
+}
+
+
+std::string MetricsExporter::to_text() {
+	if (is_enabled())
+		sample_process();
+
+	std::ostringstream out;
+	std::lock_guard<std::mutex> lock(metrics_mutex);
+	for (std::map<std::string, Family>::const_iterator it = metrics_families.begin(); it != metrics_families.end(); ++it) {
+		const std::string& name = it->first;
+		const Family& family = it->second;
+		out << "# TYPE " << name << " " << type_name(family.type) << "\n";
+		if (!family.help.empty())
+			out << "# HELP " << name << " " << family.help << "\n";
+
+		for (std::map<std::string, Series>::const_iterator s = family.series.begin(); s != family.series.end(); ++s) {
+			const std::string& labels = s->first;
+			const Series& series = s->second;
+			switch (family.type) {
+			case COUNTER:
+				out << sample(name + "_total", labels) << " " << number(series.value) << "\n";
+				break;
+			case GAUGE:
+				out << sample(name, labels) << " " << number(series.value) << "\n";
+				break;
+			case HISTOGRAM:
+				for (std::size_t i = 0; i < family.upper_bounds.size(); ++i) {
+					double count = i < series.buckets.size() ? series.buckets[i] : 0.0;
+					out << sample(name + "_bucket", labels, "le=\"" + number(family.upper_bounds[i]) + "\"") << " " << number(count) << "\n";
+				}
+				out << sample(name + "_bucket", labels, "le=\"+Inf\"") << " " << number(series.count) << "\n";
+				// fall through to the sum and the count
+			case SUMMARY:
+				out << sample(name + "_sum", labels) << " " << number(series.sum) << "\n";
+				out << sample(name + "_count", labels) << " " << number(series.count) << "\n";
+				break;
+			}
+		}
+	}
+	out << "# EOF\n";
+	return out.str();
+}
+
+
+bool MetricsExporter::save(const std::string& file_name) {
+	const std::string text = to_text();
+	const std::string temporary = file_name + ".tmp";
+	{
+		std::ofstream output(temporary.c_str(), std::ios::binary);
+		if (output.fail()) {
+			Logger::err("-") << "could not create file: " << temporary << std::endl;
+			return false;
+		}
+		output << text;
+		if (output.fail()) {
+			Logger::err("-") << "failed writing metrics to file: " << temporary << std::endl;
+			return false;
+		}
+	}
+
+#ifdef WIN32
+	std::remove(file_name.c_str());	// rename() doesn't replace a file
+#endif
+	if (std::rename(temporary.c_str(), file_name.c_str()) != 0) {
+		Logger::err("-") << "failed saving metrics to file: " << file_name << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+void MetricsExporter::start_writer(const std::string& file_name, double interval) {
+	std::lock_guard<std::mutex> lock(writer_mutex);
+	writer.reset();
+	writer.reset(new Writer(file_name, std::max(interval, 0.1)));
+}
+
+
+void MetricsExporter::stop_writer() {
+	std::lock_guard<std::mutex> lock(writer_mutex);
+	writer.reset();
+}
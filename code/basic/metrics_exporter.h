@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_METRICS_EXPORTER_H_
+#define _BASIC_METRICS_EXPORTER_H_
+
+#include "basic_common.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+
+
+/**
+* Publishes the counters, gauges and histograms of a long-running process (e.g., the Batch tool reading
+* its tiles from a pipe) in the OpenMetrics text format, written to a file for a scraper (e.g., the
+* textfile collector of the Prometheus node exporter). Once enabled, the stages of the Profiler feed it:
+*   - polyfit_stage_duration_seconds (histogram, by stage),
+*   - polyfit_stage_counter (summary, by stage and counter): the counters of the stages, e.g., the 
+*     "candidate faces", the "kNN queries" (whose rate is the throughput) or the "gap to LP bound",
+*   - polyfit_job_peak_memory_increase_bytes (histogram): the increase of the peak resident memory 
+*     during the top-level stages (e.g., a tile of the Batch tool).
+* The threads of the pool and the peak resident memory of the process are sampled when the metrics are
+* written, and the clients add their own ones (e.g., the depth of a queue as a gauge).
+*
+* usage example:
+*   MetricsExporter::set_enabled(true);
+*   MetricsExporter::start_writer("polyfit.prom", 10.0);	// every 10 sec, and when stopped
+*   MetricsExporter::set_gauge("polyfit_queue_depth", "", queue.size());
+*   MetricsExporter::stop_writer();
+*
+* When disabled (the default), recording costs a single test of a flag. The stages are recorded when
+* they end (not in the inner loops), under a mutex.
+*/
+
+class BASIC_API MetricsExporter
+{
+public:
+	static void set_enabled(bool b);
+	static bool is_enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	// A series is given by the name of its family and its labels ('key="value",...', see label(), empty 
+	// for none). A family has the type of its first series, and no help text unless described.
+	static void describe(const std::string& name, const std::string& help);
+	static void add_counter(const std::string& name, const std::string& labels, double value);
+	static void set_gauge(const std::string& name, const std::string& labels, double value);
+	// an observation of a histogram (with the buckets of the durations in seconds unless set)
+	static void observe(const std::string& name, const std::string& labels, double value);
+	static void set_buckets(const std::string& name, const std::vector<double>& upper_bounds);
+	// an observation of a summary (its sum and count, without quantiles)
+	static void observe_summary(const std::string& name, const std::string& labels, double value);
+
+	// the label 'key="value"', with the value escaped
+	static std::string label(const std::string& key, const std::string& value);
+
+	// the end of a stage of the Profiler
+	static void record_stage(const std::string& name, int depth, double wall_time, double peak_memory_increase,
+		const std::vector< std::pair<std::string, double> >& counters);
+
+	// removes all the series
+	static void reset();
+
+	static std::string to_text();
+	// writes a temporary file renamed at once, so that a reader never sees a partial file
+	static bool save(const std::string& file_name);
+
+	// Writes the metrics to 'file_name' every 'interval' sec. from a thread of its own, and once more 
+	// when stopped.
+	static void start_writer(const std::string& file_name, double interval);
+	static void stop_writer();
+
+private:
+	static std::atomic<bool> enabled_;
+};
+
+
+#endif
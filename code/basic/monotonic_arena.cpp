@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "monotonic_arena.h"
+
+#include <cstdint>
+#include <algorithm>
+
+
+namespace {
+
+	inline char* align_up(char* p, std::size_t alignment) {
+		const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(p);
+		return reinterpret_cast<char*>((address + alignment - 1) & ~std::uintptr_t(alignment - 1));
+	}
+
+}
+
+
+MonotonicArena::MonotonicArena(std::size_t chunk_size /* = 64 * 1024 */)
+	: chunks_(nil), current_(nil), end_(nil), last_block_(nil), buffer_(nil), buffer_size_(0)
+	, next_chunk_size_(std::max<std::size_t>(chunk_size, 1024)), bytes_reserved_(0)
+{
+}
+
+
+MonotonicArena::MonotonicArena(void* buffer, std::size_t size, std::size_t chunk_size /* = 64 * 1024 */)
+	: chunks_(nil), current_(static_cast<char*>(buffer)), end_(static_cast<char*>(buffer) + size), last_block_(nil)
+	, buffer_(static_cast<char*>(buffer)), buffer_size_(size)
+	, next_chunk_size_(std::max<std::size_t>(chunk_size, 1024)), bytes_reserved_(0)
+{
+}
+
+
+void* MonotonicArena::allocate(std::size_t bytes, std::size_t alignment /* = alignof(std::max_align_t) */) {
+	char* p = current_ ? align_up(current_, alignment) : nil;
+	if (!p || p + bytes > end_) {
+		add_chunk(bytes, alignment);
+		p = align_up(current_, alignment);
+	}
+	current_ = p + bytes;
+	last_block_ = p;
+	return p;
+}
+
+
+void MonotonicArena::deallocate(void* p, std::size_t bytes) {
+	if (p && p == last_block_ && static_cast<char*>(p) + bytes == current_) {
+		current_ = last_block_;
+		last_block_ = nil;
+	}
+}
+
+
+void MonotonicArena::add_chunk(std::size_t bytes, std::size_t alignment) {
+	// the chunks double up to the maximum size, a larger block gets a chunk of its own
+	const std::size_t header = sizeof(Chunk) + alignof(std::max_align_t);
+	const std::size_t size = std::max(next_chunk_size_, bytes + alignment + header);
+	if (next_chunk_size_ < max_chunk_size)
+		next_chunk_size_ = std::min(2 * next_chunk_size_, max_chunk_size);
+
+	Chunk* chunk = static_cast<Chunk*>(::operator new(size));
+	chunk->next = chunks_;
+	chunks_ = chunk;
+	bytes_reserved_ += size;
+
+	current_ = reinterpret_cast<char*>(chunk) + sizeof(Chunk);
+	end_ = reinterpret_cast<char*>(chunk) + size;
+	last_block_ = nil;
+}
+
+
+void MonotonicArena::release() {
+	while (chunks_) {
+		Chunk* next = chunks_->next;
+		::operator delete(chunks_);
+		chunks_ = next;
+	}
+	bytes_reserved_ = 0;
+	current_ = buffer_;
+	end_ = buffer_ ? buffer_ + buffer_size_ : nil;
+	last_block_ = nil;
+}
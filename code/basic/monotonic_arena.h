@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_MONOTONIC_ARENA_H_
+#define _BASIC_MONOTONIC_ARENA_H_
+
+#include "basic_common.h"
+#include "basic_types.h"
+
+#include <new>
+#include <cstddef>
+#include <type_traits>
+
+
+/**
+* The memory of the short-lived containers of a stage (e.g., the cutting planes of the faces, the pieces
+* of a face being cut): the blocks are taken one after the other from chunks of growing sizes, and only
+* freed all together when the arena is released or destroyed. Freeing a block does nothing, but for the
+* last one taken (e.g., a vector growing), so an arena is meant for the containers that live as long as
+* the stage (or the task) owning it. An optional buffer (e.g., a local array) is used before any chunk, 
+* so a small task may not allocate at all.
+*
+* An arena is not thread-safe: each thread (e.g., each task of the pool) uses its own. The containers 
+* take it by their allocator (see ArenaAllocator) and must be destroyed before it.
+*/
+
+class BASIC_API MonotonicArena
+{
+public:
+	MonotonicArena(std::size_t chunk_size = 64 * 1024);
+	MonotonicArena(void* buffer, std::size_t size, std::size_t chunk_size = 64 * 1024);
+	~MonotonicArena() { release(); }
+
+	void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+	void  deallocate(void* p, std::size_t bytes);
+
+	// frees the chunks at once (the buffer is used again)
+	void release();
+
+	// the memory of the chunks (not counting the buffer)
+	std::size_t bytes_reserved() const { return bytes_reserved_; }
+
+private:
+	MonotonicArena(const MonotonicArena&);
+	MonotonicArena& operator=(const MonotonicArena&);
+
+	void add_chunk(std::size_t bytes, std::size_t alignment);
+
+private:
+	struct Chunk { Chunk* next; };
+
+	Chunk*		chunks_;		// the last one first
+	char*		current_;		// the free space of the current chunk (or buffer)
+	char*		end_;
+	char*		last_block_;	// the block taken last (reclaimed if freed next)
+
+	char*		buffer_;
+	std::size_t	buffer_size_;
+
+	std::size_t	next_chunk_size_;
+	std::size_t	bytes_reserved_;
+
+	static const std::size_t max_chunk_size = 4 * 1024 * 1024;
+};
+
+
+/**
+* The allocator of the containers using an arena, e.g., 
+*     std::set<Plane3d*, std::less<Plane3d*>, ArenaAllocator<Plane3d*> > planes(ArenaAllocator<Plane3d*>(&arena));
+* Without an arena, it uses the heap (like std::allocator). The allocator propagates with the contents of the
+* containers, so the moved and swapped containers keep using their arena.
+*/
+
+template <class T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator(MonotonicArena* arena = nil) : arena_(arena) {}
+	template <class U> ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+	T* allocate(std::size_t n) {
+		if (arena_)
+			return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+	void deallocate(T* p, std::size_t n) {
+		if (arena_)
+			arena_->deallocate(p, n * sizeof(T));
+		else
+			::operator delete(p);
+	}
+
+	MonotonicArena* arena() const { return arena_; }
+
+	template <class U> struct rebind { typedef ArenaAllocator<U> other; };
+
+private:
+	MonotonicArena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() == b.arena(); }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() != b.arena(); }
+
+
+#endif
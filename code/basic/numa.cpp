@@ -0,0 +1,277 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "numa.h"
+#include "logger.h"
+
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
+
+#ifdef WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+	// -1 until set or read from the environment
+	std::atomic<int> numa_pinning(-1);
+	std::atomic<int> numa_huge_pages(-1);
+
+	std::mutex numa_mutex;
+	std::vector< std::vector<unsigned int> > numa_nodes;	// their processors, read once
+	bool numa_nodes_read = false;
+
+	std::map<void*, std::size_t> numa_mappings;	// the mapped blocks and their lengths
+	bool hugetlb_warned = false;
+
+
+	// e.g., "0-31,64-95"
+	std::vector<unsigned int> parse_cpu_list(const std::string& list) {
+		std::vector<unsigned int> cpus;
+		std::istringstream input(list);
+		std::string range;
+		while (std::getline(input, range, ',')) {
+			if (range.find_first_of("0123456789") == std::string::npos)
+				continue;
+			std::size_t dash = range.find('-');
+			int first = std::atoi(range.substr(0, dash).c_str());
+			int last = (dash == std::string::npos) ? first : std::atoi(range.substr(dash + 1).c_str());
+			for (int cpu = first; cpu <= last; ++cpu)
+				cpus.push_back(static_cast<unsigned int>(cpu));
+		}
+		return cpus;
+	}
+
+
+	const std::vector< std::vector<unsigned int> >& nodes() {
+		std::lock_guard<std::mutex> lock(numa_mutex);
+		if (numa_nodes_read)
+			return numa_nodes;
+		numa_nodes_read = true;
+
+#ifdef __linux__
+		for (unsigned int node = 0; ; ++node) {
+			std::ifstream input(("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist").c_str());
+			if (input.fail())
+				break;
+			std::string list;
+			std::getline(input, list);
+			std::vector<unsigned int> cpus = parse_cpu_list(list);
+			if (!cpus.empty())
+				numa_nodes.push_back(cpus);
+		}
+#endif
+		// a single node of all the processors otherwise
+		if (numa_nodes.empty()) {
+			std::vector<unsigned int> cpus;
+			for (unsigned int i = 0; i < std::max(std::thread::hardware_concurrency(), 1u); ++i)
+				cpus.push_back(i);
+			numa_nodes.push_back(cpus);
+		}
+		return numa_nodes;
+	}
+
+
+	// the processor of the index-th thread
+	unsigned int cpu_of_thread(std::size_t index, Numa::Pinning pinning) {
+		const std::vector< std::vector<unsigned int> >& all = nodes();
+		std::vector<unsigned int> order;
+		if (pinning == Numa::COMPACT) {
+			for (std::size_t n = 0; n < all.size(); ++n)
+				order.insert(order.end(), all[n].begin(), all[n].end());
+		}
+		else {
+			std::size_t longest = 0;
+			for (std::size_t n = 0; n < all.size(); ++n)
+				longest = std::max(longest, all[n].size());
+			for (std::size_t i = 0; i < longest; ++i) {
+				for (std::size_t n = 0; n < all.size(); ++n) {
+					if (i < all[n].size())
+						order.push_back(all[n][i]);
+				}
+			}
+		}
+		return order[index % order.size()];
+	}
+
+
+	int from_environment(const char* variable, const char* const names[], int num) {
+		const char* value = std::getenv(variable);
+		if (value) {
+			for (int i = 0; i < num; ++i) {
+				if (std::string(value) == names[i])
+					return i;
+			}
+			Logger::warn("-") << "unknown value of " << variable << ": " << value << std::endl;
+		}
+		return 0;
+	}
+
+	const char* const pinning_names[] = { "none", "compact", "scatter" };
+	const char* const huge_pages_names[] = { "none", "thp", "hugetlb" };
+
+}
+
+
+unsigned int Numa::num_nodes() {
+	return static_cast<unsigned int>(nodes().size());
+}
+
+
+std::vector<unsigned int> Numa::node_cpus(unsigned int node) {
+	const std::vector< std::vector<unsigned int> >& all = nodes();
+	return node < all.size() ? all[node] : std::vector<unsigned int>();
+}
+
+
+void Numa::set_pinning(Pinning pinning) {
+	numa_pinning = pinning;
+}
+
+
+Numa::Pinning Numa::pinning() {
+	if (numa_pinning < 0)
+		numa_pinning = from_environment("POLYFIT_PIN_THREADS", pinning_names, 3);
+	return static_cast<Pinning>(numa_pinning.load());
+}
+
+
+bool Numa::pin_thread(std::size_t index) {
+	const Pinning mode = pinning();
+	if (mode == NO_PINNING)
+		return false;
+	const unsigned int cpu = cpu_of_thread(index, mode);
+
+#if defined(WIN32)
+	if (cpu >= sizeof(DWORD_PTR) * 8)	// beyond the first processor group
+		return false;
+	return ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+
+void Numa::set_huge_pages(HugePages pages) {
+	numa_huge_pages = pages;
+}
+
+
+Numa::HugePages Numa::huge_pages() {
+	if (numa_huge_pages < 0)
+		numa_huge_pages = from_environment("POLYFIT_HUGE_PAGES", huge_pages_names, 3);
+	return static_cast<HugePages>(numa_huge_pages.load());
+}
+
+
+bool Numa::parse_pinning(const std::string& name, Pinning& pinning) {
+	for (int i = 0; i < 3; ++i) {
+		if (name == pinning_names[i]) {
+			pinning = static_cast<Pinning>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool Numa::parse_huge_pages(const std::string& name, HugePages& pages) {
+	for (int i = 0; i < 3; ++i) {
+		if (name == huge_pages_names[i]) {
+			pages = static_cast<HugePages>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void* Numa::allocate(std::size_t bytes) {
+#ifdef __linux__
+	const HugePages pages = huge_pages();
+	if (bytes >= large_size && pages != NO_HUGE_PAGES) {
+		void* p = MAP_FAILED;
+		std::size_t length = bytes;
+		if (pages == HUGETLB) {
+			length = (bytes + large_size - 1) / large_size * large_size;
+			p = ::mmap(nil, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p == MAP_FAILED) {
+				std::lock_guard<std::mutex> lock(numa_mutex);
+				if (!hugetlb_warned)
+					Logger::warn("-") << "no huge pages left, normal pages are used" << std::endl;
+				hugetlb_warned = true;
+			}
+		}
+		if (p == MAP_FAILED) {
+			length = bytes;
+			p = ::mmap(nil, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+			::madvise(p, length, MADV_HUGEPAGE);
+#endif
+		}
+		std::lock_guard<std::mutex> lock(numa_mutex);
+		numa_mappings[p] = length;
+		return p;
+	}
+#endif
+	void* p = std::malloc(std::max<std::size_t>(bytes, 1));
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+
+void Numa::deallocate(void* p, std::size_t bytes) {
+	if (!p)
+		return;
+#ifdef __linux__
+	// the mode may have changed since, so the mappings are looked up
+	if (bytes >= large_size) {
+		std::unique_lock<std::mutex> lock(numa_mutex);
+		std::map<void*, std::size_t>::iterator pos = numa_mappings.find(p);
+		if (pos != numa_mappings.end()) {
+			const std::size_t length = pos->second;
+			numa_mappings.erase(pos);
+			lock.unlock();
+			::munmap(p, length);
+			return;
+		}
+	}
+#endif
+	std::free(p);
+}
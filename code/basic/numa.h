@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_NUMA_H_
+#define _BASIC_NUMA_H_
+
+#include "basic_common.h"
+#include "basic_types.h"
+
+#include <string>
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstddef>
+
+
+/**
+* The placement of the threads and the large arrays on the machines with several memory nodes (e.g., 
+* dual-socket workers), where reading the memory of the other socket becomes the limit once the points
+* and the candidate faces are shared by the threads:
+*   - pinning: the workers of the pool (see ThreadPool) stay on their cores, filling a node first
+*     (COMPACT) or spreading over the nodes in turn (SCATTER), so the pages they first touched stay 
+*     local;
+*   - huge pages: the large arrays (see LargeArrayAllocator) are backed by transparent huge pages 
+*     (TRANSPARENT) or by the reserved huge pages of the system (HUGETLB, falling back to the normal
+*     pages if none is left), so that fewer TLB entries cover them.
+* A page goes to the node of the thread first writing it, so the large arrays are left uninitialized
+* when allocated and filled in parallel by the threads of the pool (e.g., the padded mirror of the points,
+* see PointSet::update_padded_points()): with the pool pinned, their pages are spread over the nodes of 
+* the threads instead of the node of the allocating thread.
+*
+* Both default to none, or the environment variables POLYFIT_PIN_THREADS (none, compact, scatter) and
+* POLYFIT_HUGE_PAGES (none, thp, hugetlb), or the setters (e.g., from the command line). Pinning applies
+* to the workers started afterwards (see ThreadPool::set_num_threads()). Without the support of the 
+* system (e.g., not on Linux), they do nothing.
+*/
+
+class BASIC_API Numa
+{
+public:
+	enum Pinning { NO_PINNING, COMPACT, SCATTER };
+	enum HugePages { NO_HUGE_PAGES, TRANSPARENT, HUGETLB };
+
+	// the memory nodes (1 if unknown) and their processors
+	static unsigned int num_nodes();
+	static std::vector<unsigned int> node_cpus(unsigned int node);
+
+	static void set_pinning(Pinning pinning);
+	static Pinning pinning();
+	// pins the calling thread to the processor of the index-th thread of the pool, returns false if not pinned
+	static bool pin_thread(std::size_t index);
+
+	static void set_huge_pages(HugePages pages);
+	static HugePages huge_pages();
+
+	// e.g., from the command line, return false for an unknown name
+	static bool parse_pinning(const std::string& name, Pinning& pinning);
+	static bool parse_huge_pages(const std::string& name, HugePages& pages);
+
+	// The memory of the large arrays: the blocks of at least 'large_size' bytes are mapped with the huge
+	// pages chosen, the others come from the heap. It throws std::bad_alloc if it fails.
+	static void* allocate(std::size_t bytes);
+	static void  deallocate(void* p, std::size_t bytes);
+
+	static const std::size_t large_size = 2 * 1024 * 1024;
+};
+
+
+/**
+* The allocator of the large arrays (e.g., std::vector<float, LargeArrayAllocator<float> >): their memory
+* comes from Numa::allocate(), and the elements constructed with no value are left uninitialized (e.g., 
+* by resize()), so that the threads filling them touch their pages first.
+*/
+
+template <class T>
+class LargeArrayAllocator
+{
+public:
+	typedef T value_type;
+
+	LargeArrayAllocator() {}
+	template <class U> LargeArrayAllocator(const LargeArrayAllocator<U>&) {}
+
+	T* allocate(std::size_t n) { return static_cast<T*>(Numa::allocate(n * sizeof(T))); }
+	void deallocate(T* p, std::size_t n) { Numa::deallocate(p, n * sizeof(T)); }
+
+	template <class U> void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+	template <class U, class... Args> void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+	template <class U> struct rebind { typedef LargeArrayAllocator<U> other; };
+};
+
+template <class T, class U>
+bool operator==(const LargeArrayAllocator<T>&, const LargeArrayAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const LargeArrayAllocator<T>&, const LargeArrayAllocator<U>&) { return false; }
+
+
+#endif
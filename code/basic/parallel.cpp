@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "parallel.h"
+#include "progress.h"
+#include "tracer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+
+namespace {
+	thread_local unsigned int thread_budget = 0;
+}
+
+
+unsigned int parallel_thread_budget() {
+	return thread_budget;
+}
+
+
+void parallel_set_thread_budget(unsigned int num_threads) {
+	thread_budget = num_threads;
+}
+
+
+unsigned int parallel_num_threads(unsigned int num_threads) {
+	if (num_threads == 0)
+		num_threads = (thread_budget > 0) ? thread_budget : ThreadPool::num_threads();
+	return std::max(num_threads, 1u);
+}
+
+
+void parallel_for(
+	std::size_t n,
+	const std::function<void(std::size_t)>& task,
+	ProgressLogger* progress,
+	unsigned int num_threads
+) 
+{
+	if (n == 0)
+		return;
+
+	std::size_t num = std::min<std::size_t>(parallel_num_threads(num_threads), n);
+
+	const std::size_t start = progress ? progress->value() : 0;
+
+	std::atomic<std::size_t> next_task(0);
+	auto runner = [&]() {
+		TraceZone zone("parallel_for", "basic");
+		for (std::size_t idx = next_task++; idx < n; idx = next_task++) {
+			task(idx);
+			if (progress)
+				progress->next();
+		}
+	};
+
+	// the runners take the tasks in turn, and the calling thread is one of them
+	if (num == 1)
+		runner();
+	else {
+		TaskGroup group;
+		const unsigned int budget = thread_budget;	// for the nested calls of the tasks
+		for (std::size_t i = 1; i < num; ++i)
+			group.run([&runner, budget]() { ScopedThreadBudget scope(budget); runner(); });
+		runner();
+
+		// the time the calling thread waits for the slowest runner (running other tasks meanwhile)
+		TraceZone zone("parallel_for join", "basic");
+		group.wait();
+	}
+
+	if (progress)
+		progress->notify(start + n);
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_PARALLEL_H_
+#define _BASIC_PARALLEL_H_
+
+#include "basic_common.h"
+#include "basic_types.h"
+
+#include <functional>
+
+
+class ProgressLogger;
+
+
+/**
+* Runs task(i) for each i in [0, n) using up to 'num_threads' threads (0 means 
+* the global thread budget, see ThreadPool). The threads are the workers of the 
+* shared pool and the calling thread, which returns when all the tasks are done.
+* The tasks are handed out in order, but they may complete in any order. If a
+* task throws, the exception is rethrown once the other runners are done.
+* 
+* If 'progress' is given, it is advanced by one for each task done, by the 
+* thread that did the task (see ProgressLogger for the notifications).
+*/
+BASIC_API void parallel_for(
+	std::size_t n, 
+	const std::function<void(std::size_t)>& task, 
+	ProgressLogger* progress = nil,
+	unsigned int num_threads = 0
+);
+
+// returns the number of threads a parallel_for() with 'num_threads' (0 means 
+// the global thread budget) would use
+BASIC_API unsigned int parallel_num_threads(unsigned int num_threads = 0);
+
+// The thread budget of the calling thread, used instead of the global one by its 
+// parallel_for() calls with 0 threads (e.g., for the concurrent jobs of the Batch 
+// tool given different shares of the threads), and passed on to their runners.
+// 0 (the default) stands for the global thread budget.
+BASIC_API unsigned int parallel_thread_budget();
+BASIC_API void parallel_set_thread_budget(unsigned int num_threads);
+
+// sets the thread budget of the calling thread until it goes out of scope
+class ScopedThreadBudget {
+public:
+	ScopedThreadBudget(unsigned int num_threads) : previous_(parallel_thread_budget()) { 
+		parallel_set_thread_budget(num_threads); 
+	}
+	~ScopedThreadBudget() { parallel_set_thread_budget(previous_); }
+
+private:
+	unsigned int previous_;
+};
+
+
+#endif
@@ -0,0 +1,156 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "perf_counters.h"
+#include "logger.h"
+
+#include <mutex>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#	include <unistd.h>
+#	include <sys/syscall.h>
+#	include <linux/perf_event.h>
+#endif
+
+
+std::atomic<int> PerfCounters::enabled_(-1);
+
+
+namespace {
+
+	// the counters of a thread (-1 for the events that could not be opened)
+	struct ThreadCounters {
+		int fds[PerfCounters::NUM_EVENTS];
+	};
+
+	std::mutex					perf_mutex;
+	std::vector<ThreadCounters>	perf_threads;
+	bool						perf_warned = false;
+
+	thread_local bool			perf_attached = false;
+
+
+#ifdef __linux__
+	int open_counter(PerfCounters::Event e) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		switch (e) {
+		case PerfCounters::CYCLES:			attr.config = PERF_COUNT_HW_CPU_CYCLES;		break;
+		case PerfCounters::INSTRUCTIONS:	attr.config = PERF_COUNT_HW_INSTRUCTIONS;	break;
+		case PerfCounters::CACHE_MISSES:	attr.config = PERF_COUNT_HW_CACHE_MISSES;	break;
+		case PerfCounters::BRANCH_MISSES:	attr.config = PERF_COUNT_HW_BRANCH_MISSES;	break;
+		default:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		}
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		// for scaling the counts when the kernel multiplexes the counters
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		// the calling thread, on any processor
+		return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+
+	double read_counter(int fd) {
+		if (fd < 0)
+			return 0.0;
+		unsigned long long values[3] = { 0, 0, 0 };	// the count, the time enabled and the time running
+		if (::read(fd, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0)
+			return 0.0;
+		return double(values[0]) * double(values[1]) / double(values[2]);
+	}
+#endif
+
+}
+
+
+void PerfCounters::set_enabled(bool b) {
+	enabled_ = b ? 1 : 0;
+}
+
+
+bool PerfCounters::is_enabled() {
+	int enabled = enabled_.load(std::memory_order_relaxed);
+	if (enabled < 0) {
+		const char* value = std::getenv("POLYFIT_PERF_COUNTERS");
+		enabled = (value && std::string(value) == "1") ? 1 : 0;
+		enabled_ = enabled;
+	}
+	return enabled == 1;
+}
+
+
+void PerfCounters::attach_thread() {
+	if (perf_attached || !is_enabled())
+		return;
+	perf_attached = true;
+
+	ThreadCounters counters;
+	bool opened = false;
+	for (int i = 0; i < NUM_EVENTS; ++i) {
+#ifdef __linux__
+		counters.fds[i] = open_counter(Event(i));
+#else
+		counters.fds[i] = -1;
+#endif
+		opened = opened || counters.fds[i] >= 0;
+	}
+
+	std::lock_guard<std::mutex> lock(perf_mutex);
+	if (!opened) {
+		if (!perf_warned) {
+			perf_warned = true;
+			Logger::warn("-") << "the hardware performance counters are not available "
+				"(see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+		}
+		return;
+	}
+	perf_threads.push_back(counters);
+}
+
+
+void PerfCounters::read(std::vector<Values>& threads) {
+	std::lock_guard<std::mutex> lock(perf_mutex);
+	threads.assign(perf_threads.size(), Values());
+#ifdef __linux__
+	for (std::size_t t = 0; t < perf_threads.size(); ++t) {
+		for (int i = 0; i < NUM_EVENTS; ++i)
+			threads[t].counts[i] = read_counter(perf_threads[t].fds[i]);
+	}
+#endif
+}
+
+
+const char* PerfCounters::name(Event e) {
+	switch (e) {
+	case CYCLES:		return "cycles";
+	case INSTRUCTIONS:	return "instructions";
+	case CACHE_MISSES:	return "cache_misses";
+	case BRANCH_MISSES:	return "branch_misses";
+	case LLC_MISSES:	return "llc_misses";
+	default:			return "unknown";
+	}
+}
@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_PERF_COUNTERS_H_
+#define _BASIC_PERF_COUNTERS_H_
+
+#include "basic_common.h"
+
+#include <vector>
+#include <atomic>
+
+
+/**
+* The hardware performance counters of the threads (the cycles, the instructions, the cache misses, the
+* branch misses and the misses of the last level cache), for telling whether a stage is bound by the 
+* memory accesses or by the branches, e.g., to check that a change of the data layout improves the 
+* locality. They are read with perf_event_open() on Linux, one counter per event, scaled when the kernel
+* multiplexes them.
+*
+* When enabled, each thread opens its counters the first time it calls attach_thread(): the Profiler
+* does it when a thread begins a stage, and the workers of the ThreadPool before their tasks. The 
+* Profiler then adds the counts of all the attached threads during each stage to the stage, in total 
+* and per thread (see Profiler::Stage::perf), so they appear in the profiling JSON.
+*
+* It is disabled by default, or enabled by the environment variable POLYFIT_PERF_COUNTERS (set to 1), or
+* by set_enabled() (e.g., from the command line). Without the support of the system (e.g., not on Linux, 
+* or if /proc/sys/kernel/perf_event_paranoid doesn't allow it), the threads have no counters, and the 
+* stages no counts.
+*/
+
+class BASIC_API PerfCounters
+{
+public:
+	enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, LLC_MISSES, NUM_EVENTS };
+
+	struct Values {
+		Values() { for (int i = 0; i < NUM_EVENTS; ++i) counts[i] = 0.0; }
+		double counts[NUM_EVENTS];
+	};
+
+	static void set_enabled(bool b);
+	static bool is_enabled();
+
+	// opens the counters of the calling thread, once, if enabled (and counting from then)
+	static void attach_thread();
+
+	// the counts of the attached threads (in the order they were attached) since they were attached
+	static void read(std::vector<Values>& threads);
+
+	// e.g., "cycles", "llc_misses"
+	static const char* name(Event e);
+
+private:
+	static std::atomic<int> enabled_;	// -1 until decided (by the environment or by set_enabled())
+};
+
+
+#endif
@@ -0,0 +1,329 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "profiler.h"
+#include "logger.h"
+#include "tracer.h"
+#include "metrics_exporter.h"
+#include "instrumentation.h"
+
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <map>
+#include <algorithm>
+
+#ifdef WIN32
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <sys/time.h>
+#	include <sys/resource.h>
+#endif // WIN32
+
+
+namespace {
+
+	std::mutex						profiler_mutex;
+	std::vector<Profiler::Stage>	profiler_stages;
+
+	// the indices of the stages that have not ended, for each thread
+	std::map< std::thread::id, std::vector<std::size_t> >	profiler_running;
+	std::map< std::thread::id, std::size_t >				profiler_threads;	// the index of each thread
+
+
+	// the index of the calling thread (the mutex must be locked)
+	std::size_t thread_index_locked() {
+		std::map< std::thread::id, std::size_t >::iterator pos = profiler_threads.find(std::this_thread::get_id());
+		if (pos != profiler_threads.end())
+			return pos->second;
+		std::size_t index = profiler_threads.size();
+		profiler_threads[std::this_thread::get_id()] = index;
+		return index;
+	}
+
+
+	// in sec. (StopWatch rounds to 10 ms, which is too coarse for short stages)
+	double wall_clock() {
+		typedef std::chrono::steady_clock Clock;
+		return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+	}
+
+
+	// the counts and the instructions per cycle (as the members of a JSON object)
+	void write_perf_counts(std::ostream& out, const PerfCounters::Values& values) {
+		for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i)
+			out << (i > 0 ? ", " : "") << "\"" << PerfCounters::name(PerfCounters::Event(i)) << "\": " << values.counts[i];
+		const double cycles = values.counts[PerfCounters::CYCLES];
+		out << ", \"ipc\": " << (cycles > 0 ? values.counts[PerfCounters::INSTRUCTIONS] / cycles : 0.0);
+	}
+
+
+	std::string json_string(const std::string& str) {
+		std::string result = "\"";
+		for (std::size_t i = 0; i < str.size(); ++i) {
+			char c = str[i];
+			if (c == '\"' || c == '\\')
+				result += '\\';
+			if (static_cast<unsigned char>(c) < 0x20)
+				result += ' ';
+			else
+				result += c;
+		}
+		return result + "\"";
+	}
+
+}
+
+
+double Profiler::process_cpu_time() {
+#ifdef WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return 0;
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernel_time.dwLowDateTime;
+	kernel.HighPart = kernel_time.dwHighDateTime;
+	user.LowPart = user_time.dwLowDateTime;
+	user.HighPart = user_time.dwHighDateTime;
+	return double(kernel.QuadPart + user.QuadPart) * 1e-7;	// in 100-nanosecond units
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return	double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + 
+			double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+
+double Profiler::process_peak_memory() {
+#ifdef WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return double(counters.PeakWorkingSetSize);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#	ifdef __APPLE__
+	return double(usage.ru_maxrss);				// in bytes
+#	else
+	return double(usage.ru_maxrss) * 1024.0;	// in kilobytes
+#	endif
+#endif
+}
+
+
+void Profiler::begin_stage(const std::string& name) {
+	std::vector< std::pair<std::string, std::size_t> > instrumentation;
+	Instrumentation::counters(instrumentation);
+	const bool perf = PerfCounters::is_enabled();
+	std::vector<PerfCounters::Values> perf_counts;
+	if (perf) {
+		PerfCounters::attach_thread();
+		PerfCounters::read(perf_counts);
+	}
+
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+
+	std::vector<std::size_t>& running = profiler_running[std::this_thread::get_id()];
+
+	Stage stage;
+	stage.name = name;
+	stage.depth = static_cast<int>(running.size());
+	stage.thread = thread_index_locked();
+	stage.start_wall_time = wall_clock();
+	stage.start_cpu_time = process_cpu_time();
+	stage.start_peak_memory = process_peak_memory();
+	stage.start_instrumentation.swap(instrumentation);
+	stage.has_perf = perf;
+	stage.start_perf.swap(perf_counts);
+
+	running.push_back(profiler_stages.size());
+	profiler_stages.push_back(stage);
+}
+
+
+void Profiler::end_stage() {
+	std::vector< std::pair<std::string, std::size_t> > instrumentation;
+	Instrumentation::counters(instrumentation);
+	std::vector<PerfCounters::Values> perf_counts;
+	if (PerfCounters::is_enabled())
+		PerfCounters::read(perf_counts);
+
+	std::unique_lock<std::mutex> lock(profiler_mutex);
+	std::vector<std::size_t>& running = profiler_running[std::this_thread::get_id()];
+	if (running.empty()) {
+		lock.unlock();
+		Logger::warn("-") << "no profiling stage to end" << std::endl;
+		return;
+	}
+
+	Stage& stage = profiler_stages[running.back()];
+	stage.wall_time = wall_clock() - stage.start_wall_time;
+	stage.cpu_time = process_cpu_time() - stage.start_cpu_time;
+	stage.peak_memory_increase = process_peak_memory() - stage.start_peak_memory;
+	stage.finished = true;
+
+	// the counters created during the stage started from 0
+	for (std::size_t i = 0; i < instrumentation.size(); ++i) {
+		std::size_t start = 0;
+		for (std::size_t j = 0; j < stage.start_instrumentation.size(); ++j) {
+			if (stage.start_instrumentation[j].first == instrumentation[i].first) {
+				start = stage.start_instrumentation[j].second;
+				break;
+			}
+		}
+		if (instrumentation[i].second > start)
+			stage.counters.push_back(std::make_pair(instrumentation[i].first, double(instrumentation[i].second - start)));
+	}
+	stage.start_instrumentation.clear();
+
+	// the threads attached during the stage counted from 0
+	if (stage.has_perf) {
+		for (std::size_t t = 0; t < perf_counts.size(); ++t) {
+			PerfCounters::Values delta;
+			bool ran = false;
+			for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i) {
+				double start = (t < stage.start_perf.size()) ? stage.start_perf[t].counts[i] : 0.0;
+				delta.counts[i] = std::max(perf_counts[t].counts[i] - start, 0.0);
+				stage.perf.counts[i] += delta.counts[i];
+				ran = ran || delta.counts[i] > 0;
+			}
+			if (ran)
+				stage.perf_threads.push_back(std::make_pair(t, delta));
+		}
+	}
+	stage.start_perf.clear();
+
+	running.pop_back();
+
+	const bool tracing = Tracer::is_enabled();
+	const bool exporting = MetricsExporter::is_enabled();
+	if (!tracing && !exporting)
+		return;
+
+	// the stages are on the timeline and in the metrics as well
+	const Stage finished = stage;
+	lock.unlock();
+	if (tracing) {
+		const double start = finished.start_wall_time * 1e6;
+		const double end = start + finished.wall_time * 1e6;
+		Tracer::record(finished.name, "stage", start, end);
+	}
+	if (exporting)
+		MetricsExporter::record_stage(finished.name, finished.depth, finished.wall_time, finished.peak_memory_increase, finished.counters);
+}
+
+
+void Profiler::add_counter(const std::string& name, double value) {
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	const std::vector<std::size_t>& running = profiler_running[std::this_thread::get_id()];
+	if (running.empty())
+		return;
+
+	std::vector< std::pair<std::string, double> >& counters = profiler_stages[running.back()].counters;
+	for (std::size_t i = 0; i < counters.size(); ++i) {
+		if (counters[i].first == name) {
+			counters[i].second += value;
+			return;
+		}
+	}
+	counters.push_back(std::make_pair(name, value));
+}
+
+
+void Profiler::reset() {
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	profiler_stages.clear();
+	profiler_running.clear();
+	profiler_threads.clear();
+}
+
+
+std::vector<Profiler::Stage> Profiler::stages() {
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	return profiler_stages;
+}
+
+
+std::size_t Profiler::thread_index() {
+	std::lock_guard<std::mutex> lock(profiler_mutex);
+	return thread_index_locked();
+}
+
+
+std::string Profiler::to_json() {
+	return to_json(stages());
+}
+
+
+std::string Profiler::to_json(const std::vector<Stage>& all) {
+	std::ostringstream out;
+	out.precision(9);
+	out << "{\n  \"stages\": [";
+	for (std::size_t i = 0; i < all.size(); ++i) {
+		const Stage& s = all[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "    {";
+		out << "\"name\": " << json_string(s.name);
+		out << ", \"depth\": " << s.depth;
+		out << ", \"thread\": " << s.thread;
+		out << ", \"finished\": " << (s.finished ? "true" : "false");
+		out << ", \"wall_time\": " << s.wall_time;
+		out << ", \"cpu_time\": " << s.cpu_time;
+		out << ", \"peak_memory_increase\": " << s.peak_memory_increase;
+		out << ", \"counters\": {";
+		for (std::size_t j = 0; j < s.counters.size(); ++j) {
+			if (j > 0)
+				out << ", ";
+			out << json_string(s.counters[j].first) << ": " << s.counters[j].second;
+		}
+		out << "}";
+		if (s.has_perf) {
+			out << ", \"perf\": {";
+			write_perf_counts(out, s.perf);
+			out << ", \"threads\": [";
+			for (std::size_t j = 0; j < s.perf_threads.size(); ++j) {
+				out << (j > 0 ? ", " : "") << "{\"thread\": " << s.perf_threads[j].first << ", ";
+				write_perf_counts(out, s.perf_threads[j].second);
+				out << "}";
+			}
+			out << "]}";
+		}
+		out << "}";
+	}
+	out << "\n  ]\n}\n";
+	return out.str();
+}
+
+
+bool Profiler::save_json(const std::string& file_name) {
+	std::ofstream output(file_name.c_str());
+	if (output.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+	output << to_json();
+	return !output.fail();
+}
@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_PROFILER_H_
+#define _BASIC_PROFILER_H_
+
+#include "basic_common.h"
+#include "perf_counters.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+
+/**
+* Records the stages of a run (e.g., generating the candidate faces, and cutting the faces within it).
+* For each stage, the wall time, the CPU time (of all the threads of the process), the increase of the 
+* peak resident memory, and some counters (e.g., the number of cuts) are recorded. The stages can be 
+* nested, and the report can be exported as JSON for tracking the performance across versions and data.
+*
+* usage example:
+*   {
+*      ProfileStage stage("generate");
+*      // do the task ...
+*      Profiler::add_counter("faces created", num);
+*   }
+*   Profiler::save_json("profile.json");
+*
+* The stages can be recorded by several threads at a time (e.g., concurrent jobs), each one nesting its
+* own stages. The stages of a thread are ended by the thread that started them.
+* If the Tracer is enabled, the stages are also recorded on its timeline. In the instrumentation build,
+* the allocations and the events counted during a stage are added to its counters (see EventCounter).
+* With the hardware performance counters enabled, their counts during a stage are recorded too, in 
+* total and per thread (see PerfCounters).
+*/
+
+class BASIC_API Profiler
+{
+public:
+	struct Stage {
+		Stage() : depth(0), thread(0), wall_time(0), cpu_time(0), peak_memory_increase(0), has_perf(false), start_wall_time(0), start_cpu_time(0), start_peak_memory(0), finished(false) {}
+
+		std::string	name;
+		int			depth;					// 0 for a top-level stage (of its thread)
+		std::size_t	thread;					// see thread_index()
+		double		wall_time;				// in sec.
+		double		cpu_time;				// in sec.
+		double		peak_memory_increase;	// in bytes
+		std::vector< std::pair<std::string, double> > counters;
+
+		// the hardware performance counts of all the threads during the stage, and of each thread that
+		// ran then (by its index in PerfCounters::read()), if the counters are enabled
+		bool						has_perf;
+		PerfCounters::Values		perf;
+		std::vector< std::pair<std::size_t, PerfCounters::Values> > perf_threads;
+
+		// used while the stage is running
+		double		start_wall_time;
+		double		start_cpu_time;
+		double		start_peak_memory;
+		std::vector< std::pair<std::string, std::size_t> > start_instrumentation;	// see Instrumentation::counters()
+		std::vector<PerfCounters::Values> start_perf;
+		bool		finished;
+	};
+
+	static void begin_stage(const std::string& name);
+	static void end_stage();
+
+	// adds 'value' to the counter 'name' of the current (innermost) stage
+	static void add_counter(const std::string& name, double value);
+
+	// removes all the recorded stages
+	static void reset();
+
+	static std::vector<Stage> stages();
+
+	// the index of the calling thread among the threads that have recorded stages (i.e., 0 for the 
+	// first one), or the index it will get
+	static std::size_t thread_index();
+
+	static std::string to_json();
+	static bool save_json(const std::string& file_name);
+
+	// the same for some of the stages (e.g., the ones of a thread)
+	static std::string to_json(const std::vector<Stage>& stages);
+
+	// in sec.
+	static double process_cpu_time();
+	// in bytes (0 if not available)
+	static double process_peak_memory();
+};
+
+
+// starts a stage in the constructor and ends it in the destructor
+class BASIC_API ProfileStage
+{
+public:
+	ProfileStage(const std::string& name) { Profiler::begin_stage(name); }
+	~ProfileStage() { Profiler::end_stage(); }
+};
+
+
+#endif
@@ -39,18 +39,29 @@
 #include "progress.h"
 #include "assertions.h"
 
+#include <chrono>
+
+
+namespace {
+	// the minimum time between two notifications of a logger
+	const double notification_interval = 0.05;
+
+	double seconds_now() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
 
 Progress* Progress::instance_ = nil ;
 
-Progress::Progress() : client_(nil), level_(0), canceled_(false) {
+Progress::Progress() : client_(nil), level_(0), canceled_(false), range_begin_(0), range_end_(100), num_stages_(0) {
 }
 
 Progress::~Progress() {
 }
 
 void Progress::push() { 
-	level_++ ; 
-	if(level_ == 1) {
+	if(++level_ == 1) {
 		clear_canceled() ;
 	}
 }
@@ -62,7 +73,9 @@ void Progress::pop() {
 
 void Progress::notify(std::size_t new_val) {
 	if(client_ != nil && level_ < 2) {
-		client_->notify_progress(new_val) ;
+		std::size_t begin = range_begin_ ;
+		std::size_t end = range_end_ ;
+		client_->notify_progress(begin + new_val * (end - begin) / 100) ;
 	}
 }
 
@@ -85,10 +98,8 @@ ProgressClient::~ProgressClient() {
 //_________________________________________________________
 
 ProgressLogger::ProgressLogger(std::size_t max_val, const std::string& task_name, bool quiet)
-: max_val_(max_val), task_name_(task_name), quiet_(quiet) 
+: max_val_(max_val), task_name_(task_name), cur_val_(0), cur_percent_(0), notifying_(false), last_notified_(0), quiet_(quiet) 
 {
-	cur_val_ = 0 ; 
-	cur_percent_ = 0 ;
 	Progress::instance()->push() ;
 	if(!quiet_) {
 		Progress::instance()->notify(0) ;
@@ -102,7 +113,8 @@ void ProgressLogger::reset(std::size_t max_val)  {
 
 ProgressLogger::~ProgressLogger() {
     Progress::instance()->notify(100) ;
-    Progress::instance()->notify(0) ;
+    if (!Progress::instance()->in_stage())	// the next logger of the stage continues from here
+        Progress::instance()->notify(0) ;
     Progress::instance()->pop() ;
 }
 
@@ -118,14 +130,44 @@ void ProgressLogger::notify(std::size_t new_val) {
 
 
 void ProgressLogger::update() {
-	std::size_t percent = cur_val_ * 100 / ogf_max<std::size_t>(1, max_val_-1) ;
-	
-	if(percent != cur_percent_) {
-		cur_percent_ = percent ;
+	std::size_t percent = ogf_min<std::size_t>(cur_val_ * 100 / ogf_max<std::size_t>(1, max_val_-1), 100) ;
+	if(percent == cur_percent_)
+		return ;
+
+	// another thread is notifying
+	if (notifying_.exchange(true, std::memory_order_acquire))
+		return ;
 
+	double now = seconds_now() ;
+	if (percent == 0 || percent == 100 || now - last_notified_ >= notification_interval) {
+		cur_percent_ = percent ;
+		last_notified_ = now ;
 		if(!quiet_) {
-			Progress::instance()->notify(ogf_min<std::size_t>(cur_percent_, 100)) ;
+			Progress::instance()->notify(percent) ;
 		}
 	}
+	notifying_.store(false, std::memory_order_release) ;
+}
+
+//_________________________________________________________
+
+ProgressStage::ProgressStage(std::size_t begin, std::size_t end) {
+	Progress* progress = Progress::instance() ;
+	prev_begin_ = progress->range_begin_ ;
+	prev_end_ = progress->range_end_ ;
+	std::size_t span = prev_end_ - prev_begin_ ;
+	progress->range_begin_ = prev_begin_ + ogf_min<std::size_t>(begin, 100) * span / 100 ;
+	progress->range_end_ = prev_begin_ + ogf_min<std::size_t>(end, 100) * span / 100 ;
+	++progress->num_stages_ ;
+	progress->notify(0) ;
+}
+
+ProgressStage::~ProgressStage() {
+	Progress* progress = Progress::instance() ;
+	progress->notify(100) ;
+	progress->range_begin_ = prev_begin_ ;
+	progress->range_end_ = prev_end_ ;
+	if (--progress->num_stages_ == 0)
+		progress->notify(0) ;
 }
 
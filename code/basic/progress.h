@@ -41,6 +41,8 @@
 #include "basic_common.h"
 #include "basic_types.h"
 
+#include <atomic>
+
 
 class ProgressClient ;
 
@@ -61,14 +63,23 @@ public:
 	void push() ;
 	void pop() ;
 
+	// the part of the bar covered by the current stage (see ProgressStage)
+	bool in_stage() const { return num_stages_ > 0 ; }
+
 	void cancel()            { canceled_ = true ;  }
 	void clear_canceled()    { canceled_ = false ; }
 	bool is_canceled() const { return canceled_ ;  }
 private:
 	static Progress* instance_ ;
 	ProgressClient* client_ ;
-	int  level_ ;
-	bool canceled_ ;
+	std::atomic<int>  level_ ;		// the progress loggers may be created by concurrent jobs
+	std::atomic<bool> canceled_ ;	// set from the GUI thread, read by the stages in the worker thread
+
+	std::atomic<std::size_t> range_begin_ ;	// in percent
+	std::atomic<std::size_t> range_end_ ;
+	std::atomic<int>		 num_stages_ ;
+
+	friend class ProgressStage ;
 } ;
 
 //_________________________________________________________
@@ -84,6 +95,12 @@ public:
 
 //_________________________________________________________
 
+/**
+* The value can be incremented from several threads (e.g., by the
+* tasks of parallel_for()). The client is notified by one thread at 
+* a time, and at most 20 times per second (the first and the last 
+* percent are always notified).
+*/
 class BASIC_API ProgressLogger {
 public:
 	ProgressLogger(std::size_t max_val = 100, const std::string& task_name = "", bool quiet = false) ;
@@ -97,17 +114,45 @@ public:
 	void reset() { notify(0) ; }
 	void reset(std::size_t max_val) ;
 
+	std::size_t value() const { return cur_val_ ; }
+
 protected:
 	virtual void update() ;
 
 private:
 	std::size_t max_val_ ;
 	std::string task_name_ ;
-	std::size_t cur_val_ ;
-	std::size_t cur_percent_ ;
+	std::atomic<std::size_t> cur_val_ ;
+	std::atomic<std::size_t> cur_percent_ ;
+	std::atomic<bool>		 notifying_ ;
+	double					 last_notified_ ;	// in seconds, only accessed by the notifying thread
 	bool quiet_ ;
 } ;
 
+//_________________________________________________________
+
+/**
+* Maps the progress of the loggers created during its lifetime to
+* the part [begin, end] (in percent) of the progress bar, so that a
+* single bar covers all the stages of a pipeline. The stages can be
+* nested: the part is then relative to the part of the outer stage.
+* Example: <pre>
+*   { ProgressStage stage(0, 60) ;   hypothesis.generate() ; }
+*   { ProgressStage stage(60, 100) ; selector.optimize(adjacency) ; }
+* </pre>
+* As the bar, the stages are shared by the whole program, so they 
+* are meant for one pipeline at a time.
+*/
+class BASIC_API ProgressStage {
+public:
+	ProgressStage(std::size_t begin, std::size_t end) ;
+	~ProgressStage() ;
+
+private:
+	std::size_t prev_begin_ ;
+	std::size_t prev_end_ ;
+} ;
+
 
 #endif
 
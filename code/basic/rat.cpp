@@ -71,3 +71,30 @@ void RAT::grow() {
 	free_list_ = RecordId(chunk,0) ;
 }
 
+void RAT::recycle() {
+	free_list_.forget() ;
+	for(unsigned int i=capacity(); i>0; i--) {
+		RecordId& ref = cell((i-1) / CHUNK_SIZE, (i-1) % CHUNK_SIZE) ;
+		ref = free_list_ ;
+		ref.free() ;
+		free_list_ = RecordId((i-1) / CHUNK_SIZE, (i-1) % CHUNK_SIZE) ;
+	}
+}
+
+void RAT::reset(unsigned int nb_used) {
+	clear() ;
+	unsigned int nb = (nb_used + CHUNK_SIZE - 1) / CHUNK_SIZE ;
+	for(unsigned int i=0; i<nb; i++) {
+		RawAttributeStore::grow() ;
+	}
+	for(unsigned int i=0; i<nb_used; i++) {
+		cell(i / CHUNK_SIZE, i % CHUNK_SIZE) = RecordId(i / CHUNK_SIZE, i % CHUNK_SIZE) ;
+	}
+	for(unsigned int i=nb*CHUNK_SIZE; i>nb_used; i--) {
+		RecordId& ref = cell((i-1) / CHUNK_SIZE, (i-1) % CHUNK_SIZE) ;
+		ref = free_list_ ;
+		ref.free() ;
+		free_list_ = RecordId((i-1) / CHUNK_SIZE, (i-1) % CHUNK_SIZE) ;
+	}
+}
+
@@ -75,6 +75,18 @@ public:
 	*/
 	virtual void grow() ;
 
+	/**
+	* makes the RAT hold the nb_used records of ids 0 to
+	* nb_used-1 (with as few chunks as possible), the rest
+	* of the last chunk being free.
+	*/
+	void reset(unsigned int nb_used) ;
+
+	/**
+	* frees all the records, keeping the chunks.
+	*/
+	void recycle() ;
+
 protected:
 	RecordId& cell(unsigned int chunk, unsigned int offset) {
 		return *reinterpret_cast<RecordId*>(
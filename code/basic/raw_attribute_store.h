@@ -64,6 +64,10 @@ public:
 	unsigned int capacity() const { 
 		return (unsigned int) data_.size() * CHUNK_SIZE ;
 	}
+	/** the bytes allocated by the chunks */
+	std::size_t memory_usage() const {
+		return std::size_t(capacity()) * item_size_ ;
+	}
 
 	Memory::pointer data(
 		unsigned int chunk, unsigned int offset
@@ -77,8 +81,18 @@ public:
 		return data(r.record_id().chunk(), r.record_id().offset()) ;
 	}
 
+	// the location of the item of a record (e.g., for the direct accesses of AttributeAccessor)
+	static unsigned int chunk_of(const Record& r)  { return r.record_id().chunk() ; }
+	static unsigned int offset_of(const Record& r) { return r.record_id().offset() ; }
+
 	virtual void grow() ;
 
+	/** exchanges the data with rhs (which must have the same item size). */
+	void swap_data(RawAttributeStore& rhs) {
+		ogf_assert(rhs.item_size_ == item_size_) ;
+		data_.swap(rhs.data_) ;
+	}
+
 private:
 	unsigned int item_size_ ;
 	std::vector<Memory::pointer> data_ ;
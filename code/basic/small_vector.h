@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _BASIC_SMALL_VECTOR_H_
+#define _BASIC_SMALL_VECTOR_H_
+
+#include "basic_common.h"
+#include "assertions.h"
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+
+// A vector of trivially copyable elements whose first N elements are stored in the
+// object itself, so the short sequences (e.g., the vertices of a facet) don't need 
+// any allocation. It moves to the heap only when it grows beyond N elements.
+template <class T, std::size_t N>
+class SmallVector
+{
+public:
+	typedef T				value_type;
+	typedef T*				iterator;
+	typedef const T*		const_iterator;
+
+	SmallVector() : data_(inline_data()), size_(0), capacity_(N) {}
+	SmallVector(const SmallVector& rhs) : data_(inline_data()), size_(0), capacity_(N) { assign(rhs.begin(), rhs.end()); }
+	~SmallVector() { release(); }
+
+	SmallVector& operator=(const SmallVector& rhs) {
+		if (this != &rhs)
+			assign(rhs.begin(), rhs.end());
+		return *this;
+	}
+
+	void assign(const T* first, const T* last) {
+		size_ = 0;
+		reserve(std::size_t(last - first));
+		std::memcpy(static_cast<void*>(data_), first, sizeof(T) * (last - first));
+		size_ = std::size_t(last - first);
+	}
+
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	std::size_t capacity() const { return capacity_; }
+
+	void clear() { size_ = 0; }
+
+	void reserve(std::size_t n) {
+		if (n <= capacity_)
+			return;
+		std::size_t capacity = capacity_ * 2 > n ? capacity_ * 2 : n;
+		T* data = static_cast<T*>(::operator new(sizeof(T) * capacity));
+		std::memcpy(static_cast<void*>(data), data_, sizeof(T) * size_);
+		release();
+		data_ = data;
+		capacity_ = capacity;
+	}
+
+	void resize(std::size_t n, const T& value = T()) {
+		reserve(n);
+		for (std::size_t i = size_; i < n; ++i)
+			data_[i] = value;
+		size_ = n;
+	}
+
+	void push_back(const T& value) {
+		if (size_ == capacity_) {
+			T copy = value;	// 'value' may be one of the elements
+			reserve(size_ + 1);
+			data_[size_++] = copy;
+		}
+		else
+			data_[size_++] = value;
+	}
+
+	void pop_back() { ogf_assert(size_ > 0); --size_; }
+
+	T& operator[](std::size_t i) { ogf_assert(i < size_); return data_[i]; }
+	const T& operator[](std::size_t i) const { ogf_assert(i < size_); return data_[i]; }
+
+	T& back() { ogf_assert(size_ > 0); return data_[size_ - 1]; }
+	const T& back() const { ogf_assert(size_ > 0); return data_[size_ - 1]; }
+
+	T* data() { return data_; }
+	const T* data() const { return data_; }
+
+	iterator begin() { return data_; }
+	iterator end() { return data_ + size_; }
+	const_iterator begin() const { return data_; }
+	const_iterator end() const { return data_ + size_; }
+
+private:
+	T* inline_data() { return reinterpret_cast<T*>(&storage_); }
+
+	void release() {
+		if (data_ != inline_data())
+			::operator delete(data_);
+	}
+
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially copyable types");
+
+	typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type	storage_;
+	T*				data_;
+	std::size_t		size_;
+	std::size_t		capacity_;
+};
+
+
+#endif
@@ -45,7 +45,8 @@
 /**
 * Automatic memory management using reference counting. 
 * This class can be used with classes inheriting
-* the Counted class.
+* the Counted class. Moving a SmartPointer transfers
+* the reference without touching the count.
 * @see Counted
 */
 
@@ -55,10 +56,12 @@ public:
 	SmartPointer() ;
 	SmartPointer(T* ptr) ;
 	SmartPointer(const SmartPointer<T>& rhs) ;
+	SmartPointer(SmartPointer<T>&& rhs) noexcept ;
 	~SmartPointer() ;
 
 	SmartPointer<T>& operator=(T* ptr) ;
 	SmartPointer<T>& operator=(const SmartPointer<T>& rhs) ;
+	SmartPointer<T>& operator=(SmartPointer<T>&& rhs) noexcept ;
 
 	T* get() { return pointer_; }
 	const T* get() const { return pointer_; }
@@ -102,6 +105,11 @@ SmartPointer<T>::SmartPointer(
 								  T::ref(pointer_) ;
 } 
 
+template <class T> inline 
+SmartPointer<T>::SmartPointer(SmartPointer<T>&& rhs) noexcept : pointer_(rhs.pointer_) {
+	rhs.pointer_ = nil ;
+}
+
 template <class T> inline
 SmartPointer<T>::~SmartPointer() {
 	T::unref(pointer_) ;
@@ -128,6 +136,17 @@ SmartPointer<T>& SmartPointer<T>::operator=(const SmartPointer<T>& rhs) {
 	return *this ;
 }
 
+template <class T> inline
+SmartPointer<T>& SmartPointer<T>::operator=(SmartPointer<T>&& rhs) noexcept {
+	if(&rhs != this) {
+		T* old = pointer_ ;
+		pointer_ = rhs.pointer_ ;
+		rhs.pointer_ = nil ;
+		T::unref(old) ;
+	}
+	return *this ;
+}
+
 template <class T> inline
 void SmartPointer<T>::forget() {
 	T::unref(pointer_) ;
@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "text_io.h"
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <locale>
+
+
+namespace {
+
+	// true if d is exactly halfway between f and its neighbor in the direction of d
+	inline bool is_float_midpoint(double d, float f) {
+		float g = std::nextafter(f, d > double(f) ? HUGE_VALF : -HUGE_VALF);
+		return (double(f) + double(g)) * 0.5 == d;
+	}
+}
+
+
+namespace TextIO {
+
+	// The common case (up to 19 significant digits and a small exponent) is computed exactly in double 
+	// precision, the others (and the doubles halfway between two floats) go through a stream.
+	bool parse_float(const char* first, const char* last, float& value) {
+		static const double powers[] = { 
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 
+		};
+
+		const char* s = first;
+		bool negative = false;
+		if (s < last && (*s == '-' || *s == '+')) {
+			negative = (*s == '-');
+			++s;
+		}
+
+		Numeric::uint64 mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool any = false, inexact = false;
+		for (; s < last && *s >= '0' && *s <= '9'; ++s) {
+			any = true;
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*s - '0');
+				if (mantissa > 0)
+					++digits;
+			}
+			else {
+				++exponent;
+				inexact |= (*s != '0');
+			}
+		}
+		if (s < last && *s == '.') {
+			for (++s; s < last && *s >= '0' && *s <= '9'; ++s) {
+				any = true;
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (*s - '0');
+					if (mantissa > 0)
+						++digits;
+					--exponent;
+				}
+				else
+					inexact |= (*s != '0');
+			}
+		}
+		if (!any)
+			return false;
+		if (s < last && (*s == 'e' || *s == 'E')) {
+			++s;
+			bool negative_exponent = false;
+			if (s < last && (*s == '-' || *s == '+')) {
+				negative_exponent = (*s == '-');
+				++s;
+			}
+			if (s == last)
+				return false;
+			int e = 0;
+			for (; s < last && *s >= '0' && *s <= '9'; ++s)
+				e = ogf_min(e * 10 + (*s - '0'), 100000);
+			exponent += negative_exponent ? -e : e;
+		}
+		if (s != last)
+			return false;
+
+		if (!inexact && mantissa <= (Numeric::uint64(1) << 53) && exponent >= -22 && exponent <= 22) {
+			double d = double(mantissa);
+			d = (exponent < 0) ? d / powers[-exponent] : d * powers[exponent];
+			float f = float(d);
+			if (double(f) == d || !is_float_midpoint(d, f)) {
+				value = negative ? -f : f;
+				return true;
+			}
+		}
+
+		std::istringstream in(std::string(first, last));
+		in.imbue(std::locale::classic());
+		in >> value;
+		return !in.fail() && in.peek() == std::char_traits<char>::eof();
+	}
+
+
+	void append_integer(std::string& out, long long value) {
+		char digits[24];
+		int n = 0;
+		unsigned long long v = value < 0 ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+		do {
+			digits[n++] = static_cast<char>('0' + v % 10);
+			v /= 10;
+		} while (v > 0);
+		if (value < 0)
+			out.push_back('-');
+		while (n > 0)
+			out.push_back(digits[--n]);
+	}
+
+
+	void append_float(std::string& out, double value, int precision) {
+		// the "%g" format is the default format of the streams (the program keeps the classic C locale)
+		char text[64];
+		int n = std::snprintf(text, sizeof(text), "%.*g", precision, value);
+		if (n > 0)
+			out.append(text, ogf_min<std::size_t>(std::size_t(n), sizeof(text) - 1));
+	}
+}
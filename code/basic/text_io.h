@@ -0,0 +1,103 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_TEXT_IO_H_
+#define _BASIC_TEXT_IO_H_
+
+#include "basic_common.h"
+#include "basic_types.h"
+
+#include <string>
+
+
+/**
+* Parsing and formatting the numbers of the ASCII file formats in memory (e.g., in a MappedFile or 
+* in the buffer of a chunk formatted by a thread), without the streams and their locale. The 
+* results are the same as those of operator>>() and operator<<() in the classic locale.
+*/
+
+namespace TextIO {
+
+	inline bool is_space(char c) {
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+	}
+
+	// finds the next token, moving 'p' to its end
+	inline bool next_token(const char*& p, const char* end, const char*& first, const char*& last) {
+		while (p < end && is_space(*p))
+			++p;
+		if (p == end)
+			return false;
+		first = p;
+		while (p < end && !is_space(*p))
+			++p;
+		last = p;
+		return true;
+	}
+
+	inline bool skip_token(const char*& p, const char* end) {
+		const char* first, *last;
+		return next_token(p, end, first, last);
+	}
+
+	inline bool read_string(const char*& p, const char* end, std::string& str) {
+		const char* first, *last;
+		if (!next_token(p, end, first, last))
+			return false;
+		str.assign(first, last);
+		return true;
+	}
+
+	template <class T>
+	inline bool read_integer(const char*& p, const char* end, T& value) {
+		const char* first, *last;
+		if (!next_token(p, end, first, last))
+			return false;
+		bool negative = (*first == '-');
+		if (*first == '-' || *first == '+')
+			++first;
+		if (first == last)
+			return false;
+		long long v = 0;
+		for (; first < last; ++first) {
+			if (*first < '0' || *first > '9')
+				return false;
+			v = v * 10 + (*first - '0');
+		}
+		value = static_cast<T>(negative ? -v : v);
+		return true;
+	}
+
+	// Parses a float the way operator>>() does (correctly rounded, whatever the C locale).
+	bool BASIC_API parse_float(const char* first, const char* last, float& value);
+
+	inline bool read_float(const char*& p, const char* end, float& value) {
+		const char* first, *last;
+		return next_token(p, end, first, last) && parse_float(first, last, value);
+	}
+
+	// appends the decimal digits of 'value'
+	void BASIC_API append_integer(std::string& out, long long value);
+
+	// appends 'value' as operator<<() does with the given precision (and the default format)
+	void BASIC_API append_float(std::string& out, double value, int precision);
+}
+
+
+#endif
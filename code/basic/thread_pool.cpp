@@ -0,0 +1,369 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "thread_pool.h"
+#include "progress.h"
+#include "tracer.h"
+#include "numa.h"
+#include "perf_counters.h"
+
+#include <deque>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+
+ThreadPool* ThreadPool::instance_ = nil;
+
+
+namespace {
+
+	// the budget set by ThreadPool::set_num_threads() (0 if not set)
+	unsigned int requested_threads = 0;
+	std::mutex instance_mutex;
+
+	// the pool and the index of the worker that runs on the calling thread (if any)
+	thread_local ThreadPool* current_pool = nil;
+	thread_local std::size_t current_worker = 0;
+
+	const std::size_t no_worker = std::size_t(-1);
+
+	unsigned int default_num_threads() {
+		const char* value = std::getenv("POLYFIT_NUM_THREADS");
+		if (value && std::atoi(value) > 0)
+			return static_cast<unsigned int>(std::atoi(value));
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+}
+
+
+struct ThreadPool::Task {
+	Task() : group(nil) {}
+
+	std::function<void()>	function;
+	TaskGroup*				group;
+};
+
+
+struct ThreadPool::Queue {
+	std::mutex			mutex;
+	std::deque<Task>	tasks;
+};
+
+
+ThreadPool* ThreadPool::instance() {
+	std::lock_guard<std::mutex> lock(instance_mutex);
+	if (!instance_)
+		instance_ = new ThreadPool(num_threads());
+	return instance_;
+}
+
+
+void ThreadPool::set_num_threads(unsigned int n) {
+	std::lock_guard<std::mutex> lock(instance_mutex);
+	requested_threads = n;
+	if (instance_ && instance_->num_workers_ + 1 != num_threads()) {
+		instance_->stop();
+		instance_->start(num_threads() - 1);
+	}
+}
+
+
+unsigned int ThreadPool::num_threads() {
+	return requested_threads > 0 ? requested_threads : default_num_threads();
+}
+
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+	: shared_(new Queue), queues_(nil), num_workers_(0), num_pending_(0), reserved_(0), running_(0), stopping_(false)
+{
+	start(num_threads - 1);
+}
+
+
+ThreadPool::~ThreadPool() {
+	stop();
+	delete shared_;
+}
+
+
+void ThreadPool::start(unsigned int num_workers) {
+	num_workers_ = num_workers;
+	queues_ = new Queue[std::max<std::size_t>(num_workers_, 1)];
+	stopping_ = false;
+	for (std::size_t i = 0; i < num_workers_; ++i)
+		workers_.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+
+// the workers finish the pending tasks first
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_all();
+	for (std::size_t i = 0; i < workers_.size(); ++i)
+		workers_[i].join();
+	workers_.clear();
+
+	delete[] queues_;
+	queues_ = nil;
+	num_workers_ = 0;
+}
+
+
+void ThreadPool::submit(const std::function<void()>& function, TaskGroup* group) {
+	Task task;
+	task.function = function;
+	task.group = group;
+
+	// a worker keeps its tasks, the others put them in the shared queue
+	Queue* queue = (current_pool == this) ? &queues_[current_worker] : shared_;
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->tasks.push_back(task);
+	}
+	++num_pending_;
+
+	// the lock makes sure a worker going to sleep sees the task
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+	}
+	wake_.notify_one();
+}
+
+
+bool ThreadPool::pop_task(std::size_t index, Task& task) {
+	if (num_pending_ == 0)
+		return false;
+
+	// the last task of its own queue first (still in the cache)
+	if (index != no_worker) {
+		Queue& own = queues_[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			--num_pending_;
+			return true;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(shared_->mutex);
+		if (!shared_->tasks.empty()) {
+			task = shared_->tasks.front();
+			shared_->tasks.pop_front();
+			--num_pending_;
+			return true;
+		}
+	}
+
+	// steals the oldest task of another worker
+	for (std::size_t k = 1; k <= num_workers_; ++k) {
+		std::size_t victim = (index == no_worker ? k - 1 : (index + k) % num_workers_);
+		if (victim == index)
+			continue;
+		Queue& other = queues_[victim];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (!other.tasks.empty()) {
+			task = other.tasks.front();
+			other.tasks.pop_front();
+			--num_pending_;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void ThreadPool::run(Task& task) {
+	std::exception_ptr error;
+	if (!task.group->is_canceled()) {
+		++running_;
+		try {
+			task.function();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		--running_;
+	}
+	TaskGroup* group = task.group;
+	task = Task();	// releases the captures before the group is done
+	group->done(error);
+}
+
+
+bool ThreadPool::run_pending_task() {
+	Task task;
+	if (!pop_task(current_pool == this ? current_worker : no_worker, task))
+		return false;
+	run(task);
+	return true;
+}
+
+
+void ThreadPool::work(std::size_t index) {
+	current_pool = this;
+	current_worker = index;
+	Tracer::set_thread_name("worker " + std::to_string(index));
+	Numa::pin_thread(index + 1);	// the calling thread is the first one of the budget
+
+	Task task;
+	for (;;) {
+		// the workers beyond the budget left by the reservations pause
+		if (index + reserved_ < num_workers_ && pop_task(index, task)) {
+			PerfCounters::attach_thread();	// once the counters are enabled (counted by the stages then)
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		if (stopping_ && num_pending_ == 0)
+			return;
+		wake_.wait(lock, [&]() {
+			return (num_pending_ > 0 && index + reserved_ < num_workers_) || (stopping_ && num_pending_ == 0);
+		});
+	}
+}
+
+//_________________________________________________________
+
+TaskGroup::TaskGroup(bool user_cancelable)
+	: pool_(ThreadPool::instance()), user_cancelable_(user_cancelable), canceled_(false), num_running_(0)
+{
+}
+
+
+TaskGroup::~TaskGroup() {
+	wait_tasks();
+}
+
+
+void TaskGroup::run(const std::function<void()>& task) {
+	++num_running_;
+	pool_->submit(task, this);
+}
+
+
+void TaskGroup::wait() {
+	wait_tasks();
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::swap(error, error_);
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+
+void TaskGroup::wait_tasks() {
+	while (num_running_ > 0) {
+		if (pool_->run_pending_task())
+			continue;
+
+		// the tasks of the group are running on other threads (and may submit new tasks)
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (num_running_ == 0)
+			break;
+		finished_.wait_for(lock, std::chrono::milliseconds(1));
+	}
+
+	// the last task has released the group
+	std::lock_guard<std::mutex> lock(mutex_);
+}
+
+
+bool TaskGroup::is_canceled() const {
+	return canceled_ || (user_cancelable_ && Progress::instance()->is_canceled());
+}
+
+
+void TaskGroup::done(std::exception_ptr error) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (error) {
+		if (!error_)
+			error_ = error;
+		canceled_ = true;
+	}
+	if (--num_running_ == 0)
+		finished_.notify_all();
+}
+
+//_________________________________________________________
+
+ThreadReservation::ThreadReservation(unsigned int n) : granted_(0) {
+	if (n == 0)
+		return;
+
+	ThreadPool* pool = ThreadPool::instance();
+	unsigned int reserved = pool->reserved_;
+	do {
+		unsigned int available = static_cast<unsigned int>(pool->num_workers_) - std::min(reserved, static_cast<unsigned int>(pool->num_workers_));
+		granted_ = std::min(n, available);
+	} while (!pool->reserved_.compare_exchange_weak(reserved, reserved + granted_));
+}
+
+
+ThreadReservation::~ThreadReservation() {
+	if (granted_ == 0)
+		return;
+
+	ThreadPool* pool = ThreadPool::instance();
+	pool->reserved_ -= granted_;
+	{
+		std::lock_guard<std::mutex> lock(pool->sleep_mutex_);
+	}
+	pool->wake_.notify_all();
+}
+
+//_________________________________________________________
+
+void parallel_for_range(
+	std::size_t n,
+	std::size_t grain,
+	const std::function<void(std::size_t first, std::size_t last)>& task,
+	unsigned int num_threads
+)
+{
+	grain = std::max<std::size_t>(grain, 1);
+	const std::size_t num_ranges = (n + grain - 1) / grain;
+	if (num_ranges == 0)
+		return;
+
+	std::atomic<std::size_t> next_range(0);
+	auto runner = [&]() {
+		TraceZone zone("parallel_for_range", "basic");
+		for (std::size_t r = next_range++; r < num_ranges; r = next_range++)
+			task(r * grain, std::min(n, (r + 1) * grain));
+	};
+
+	std::size_t num = std::min<std::size_t>(num_threads > 0 ? num_threads : ThreadPool::num_threads(), num_ranges);
+	TaskGroup group;
+	for (std::size_t i = 1; i < num; ++i)
+		group.run(runner);
+	runner();
+
+	TraceZone zone("parallel_for_range join", "basic");
+	group.wait();
+}
@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_THREAD_POOL_H_
+#define _BASIC_THREAD_POOL_H_
+
+#include "basic_common.h"
+#include "basic_types.h"
+
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+
+class TaskGroup;
+
+
+/**
+* The threads shared by all the stages of the program (parallel_for() runs its tasks here), so that
+* the stages never spawn threads of their own. Each worker has its own queue of tasks: a worker runs 
+* the tasks it submitted last first (they are still in its cache), and an idle worker steals the 
+* oldest task of another one (usually the largest remaining piece of work). A thread waiting for its
+* tasks (see TaskGroup::wait()) runs pending tasks meanwhile, so the tasks can be nested freely.
+*
+* The global thread budget is the number of threads doing work, including the calling thread: the 
+* pool has one worker less. It is the number of hardware threads by default, or the environment 
+* variable POLYFIT_NUM_THREADS, or set_num_threads() (e.g., from the command line). 
+* The threads of a solver are taken from the same budget (see ThreadReservation), and the workers
+* beyond the remaining budget pause until the solver is done.
+* The workers are pinned to their cores if requested (see Numa::set_pinning()).
+*/
+
+class BASIC_API ThreadPool
+{
+public:
+	static ThreadPool* instance();
+
+	// the global thread budget (0 means the number of hardware threads). Changing it restarts the
+	// workers, so it is meant to be set before running the stages.
+	static void set_num_threads(unsigned int n);
+	static unsigned int num_threads();
+
+	// the number of threads currently used outside the pool (see ThreadReservation)
+	unsigned int num_reserved() const { return reserved_; }
+
+	// the number of threads currently running a task of the pool (the workers, and the threads waiting
+	// for their tasks), e.g., for the metrics of a service (see MetricsExporter)
+	unsigned int num_running() const { return running_; }
+
+	// runs one pending task on the calling thread; returns false if there was none
+	bool run_pending_task();
+
+	// for internal use (see TaskGroup)
+	void submit(const std::function<void()>& task, TaskGroup* group);
+
+private:
+	ThreadPool(unsigned int num_threads);
+	~ThreadPool();
+
+	struct Task;
+	struct Queue;
+
+	void start(unsigned int num_workers);
+	void stop();
+	void work(std::size_t index);
+	bool pop_task(std::size_t index, Task& task);
+	void run(Task& task);
+
+private:
+	static ThreadPool* instance_;
+
+	Queue*						shared_;	// the tasks submitted by the threads outside the pool
+	Queue*						queues_;	// one per worker
+	std::size_t					num_workers_;
+	std::vector<std::thread>	workers_;
+
+	std::atomic<std::size_t>	num_pending_;
+	std::atomic<unsigned int>	reserved_;
+	std::atomic<unsigned int>	running_;
+	std::atomic<bool>			stopping_;
+	std::mutex					sleep_mutex_;
+	std::condition_variable		wake_;
+
+	friend class ThreadReservation;
+};
+
+
+/**
+* A set of tasks run by the thread pool, and waited for together. Example:
+*   TaskGroup group;
+*   group.run([&]() { build_left(); });
+*   group.run([&]() { build_right(); });
+*   group.wait();
+*
+* A canceled group skips the tasks that have not started yet. A group created as 'user_cancelable'
+* is also canceled by Progress::cancel() (e.g., the cancel button of the GUI). If a task throws, the
+* group is canceled and wait() rethrows the first exception.
+*/
+
+class BASIC_API TaskGroup
+{
+public:
+	TaskGroup(bool user_cancelable = false);
+	~TaskGroup();	// waits for the tasks
+
+	void run(const std::function<void()>& task);
+
+	// runs pending tasks until all the tasks of the group are done
+	void wait();
+
+	void cancel() { canceled_ = true; }
+	bool is_canceled() const;
+
+private:
+	void wait_tasks();
+	void done(std::exception_ptr error);
+
+private:
+	ThreadPool*					pool_;
+	bool						user_cancelable_;
+	std::atomic<bool>			canceled_;
+	std::atomic<std::size_t>	num_running_;
+	std::exception_ptr			error_;
+	std::mutex					mutex_;
+	std::condition_variable		finished_;
+
+	friend class ThreadPool;
+};
+
+
+/**
+* Takes 'n' threads from the global budget while it lives (e.g., for the threads of a solver), so the
+* pool workers and the solver together don't oversubscribe the cores. At most all the workers are 
+* reserved; granted() tells how many were.
+*/
+
+class BASIC_API ThreadReservation
+{
+public:
+	ThreadReservation(unsigned int n);
+	~ThreadReservation();
+
+	unsigned int granted() const { return granted_; }
+
+private:
+	unsigned int granted_;
+};
+
+
+/**
+* Runs task(first, last) on the subranges of [0, n), each having 'grain' indices (except the last 
+* one), using up to 'num_threads' threads (0 means the global budget). A grain large enough for a 
+* subrange to take more than a few microseconds keeps the scheduling cost negligible.
+*/
+BASIC_API void parallel_for_range(
+	std::size_t n,
+	std::size_t grain,
+	const std::function<void(std::size_t first, std::size_t last)>& task,
+	unsigned int num_threads = 0
+);
+
+
+/**
+* Reduces the subranges of [0, n) in parallel: map(first, last) computes the value of a subrange,
+* and the values are combined with 'combine' (which must be associative) in the order of the
+* subranges, so the result doesn't depend on the number of threads.
+* Example (the sum of a vector):
+*   double sum = parallel_reduce<double>(v.size(), 4096, 0.0,
+*      [&](std::size_t first, std::size_t last) { return std::accumulate(&v[first], &v[last], 0.0); },
+*      std::plus<double>());
+*/
+template <class T, class Map, class Combine>
+T parallel_reduce(std::size_t n, std::size_t grain, const T& identity, Map map, Combine combine, unsigned int num_threads = 0) {
+	grain = std::max<std::size_t>(grain, 1);
+	const std::size_t num_ranges = (n + grain - 1) / grain;
+	if (num_ranges == 0)
+		return identity;
+
+	std::vector<T> values(num_ranges, identity);
+	parallel_for_range(num_ranges, 1, [&](std::size_t first, std::size_t last) {
+		for (std::size_t r = first; r < last; ++r)
+			values[r] = map(r * grain, std::min(n, (r + 1) * grain));
+	}, num_threads);
+
+	T result = identity;
+	for (std::size_t r = 0; r < num_ranges; ++r)
+		result = combine(result, values[r]);
+	return result;
+}
+
+
+#endif
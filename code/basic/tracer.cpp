@@ -0,0 +1,177 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "tracer.h"
+#include "logger.h"
+
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+
+std::atomic<bool> Tracer::enabled_(false);
+
+
+namespace {
+
+	struct Event {
+		std::string name;
+		const char* category;
+		double		start;		// in microseconds
+		double		duration;	// in microseconds
+	};
+
+	// the zones of a thread. It is only locked by the thread itself and by the export.
+	struct ThreadBuffer {
+		ThreadBuffer(std::size_t i) : index(i) {}
+
+		std::mutex			mutex;
+		std::size_t			index;
+		std::string			name;
+		std::vector<Event>	events;
+	};
+
+	std::mutex										tracer_mutex;
+	std::vector< std::shared_ptr<ThreadBuffer> >	tracer_buffers;		// kept after their threads have ended
+	std::atomic<double>								tracer_origin(0.0);	// the time when the recording started
+
+
+	// the buffer of the calling thread (created at its first zone)
+	ThreadBuffer& thread_buffer() {
+		thread_local std::shared_ptr<ThreadBuffer> buffer;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(tracer_mutex);
+			buffer = std::make_shared<ThreadBuffer>(tracer_buffers.size());
+			tracer_buffers.push_back(buffer);
+		}
+		return *buffer;
+	}
+
+
+	std::string json_string(const std::string& str) {
+		std::string result = "\"";
+		for (std::size_t i = 0; i < str.size(); ++i) {
+			char c = str[i];
+			if (c == '\"' || c == '\\')
+				result += '\\';
+			if (static_cast<unsigned char>(c) < 0x20)
+				result += ' ';
+			else
+				result += c;
+		}
+		return result + "\"";
+	}
+
+}
+
+
+void Tracer::set_enabled(bool b) {
+	if (b && !enabled_)
+		reset();
+	enabled_ = b;
+}
+
+
+double Tracer::now() {
+	typedef std::chrono::steady_clock Clock;
+	return std::chrono::duration<double, std::micro>(Clock::now().time_since_epoch()).count();
+}
+
+
+void Tracer::record(const std::string& name, const char* category, double start, double end) {
+	// the zones started before the recording
+	const double origin = tracer_origin;
+	if (start < origin)
+		return;
+
+	Event e;
+	e.name = name;
+	e.category = category;
+	e.start = start - origin;
+	e.duration = end - start;
+
+	ThreadBuffer& buffer = thread_buffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events.push_back(e);
+}
+
+
+void Tracer::set_thread_name(const std::string& name) {
+	ThreadBuffer& buffer = thread_buffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.name = name;
+}
+
+
+void Tracer::reset() {
+	std::lock_guard<std::mutex> lock(tracer_mutex);
+	for (std::size_t i = 0; i < tracer_buffers.size(); ++i) {
+		std::lock_guard<std::mutex> buffer_lock(tracer_buffers[i]->mutex);
+		tracer_buffers[i]->events.clear();
+	}
+	tracer_origin = now();
+}
+
+
+std::string Tracer::to_json() {
+	std::ostringstream out;
+	out.precision(15);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	bool first = true;
+	std::lock_guard<std::mutex> lock(tracer_mutex);
+	for (std::size_t i = 0; i < tracer_buffers.size(); ++i) {
+		ThreadBuffer& buffer = *tracer_buffers[i];
+		std::lock_guard<std::mutex> buffer_lock(buffer.mutex);
+
+		std::string name = buffer.name;
+		if (name.empty()) {
+			std::ostringstream thread_name;
+			thread_name << "thread " << buffer.index;
+			name = thread_name.str();
+		}
+		out << (first ? "\n" : ",\n");
+		first = false;
+		out << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.index 
+			<< ", \"args\": {\"name\": " << json_string(name) << "}}";
+
+		for (std::size_t j = 0; j < buffer.events.size(); ++j) {
+			const Event& e = buffer.events[j];
+			out << ",\n  {\"name\": " << json_string(e.name) << ", \"cat\": " << json_string(e.category)
+				<< ", \"ph\": \"X\", \"ts\": " << e.start << ", \"dur\": " << e.duration
+				<< ", \"pid\": 1, \"tid\": " << buffer.index << "}";
+		}
+	}
+	out << "\n]}\n";
+	return out.str();
+}
+
+
+bool Tracer::save_json(const std::string& file_name) {
+	std::ofstream output(file_name.c_str());
+	if (output.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+	output << to_json();
+	return !output.fail();
+}
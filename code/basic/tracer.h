@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BASIC_TRACER_H_
+#define _BASIC_TRACER_H_
+
+#include "basic_common.h"
+
+#include <string>
+#include <atomic>
+
+
+/**
+* Records a timeline of the zones of code executed by each thread (e.g., the stages of the pipeline,
+* the tasks of parallel_for(), the solves), which is saved in the Chrome trace format (to be viewed 
+* in chrome://tracing or https://ui.perfetto.dev), for finding the load imbalance and the serial parts.
+* The stages of the Profiler are recorded as zones as well.
+* When the tracer is disabled (the default), a zone costs a single test of a flag.
+*
+* usage example:
+*   Tracer::set_enabled(true);
+*   {
+*      TraceZone zone("cut facet", "generate");
+*      // do the task ...
+*   }
+*   Tracer::save_json("trace.json");
+*
+* Each thread records its zones into its own buffer, so the threads don't contend while tracing.
+*/
+
+class BASIC_API Tracer
+{
+public:
+	// starting recording also clears the zones recorded before
+	static void set_enabled(bool b);
+	static bool is_enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	// in microseconds (the clock of the Profiler)
+	static double now();
+
+	// a zone of the calling thread
+	static void record(const std::string& name, const char* category, double start, double end);
+
+	// the name of the calling thread in the timeline (e.g., "job 2"), otherwise "thread <index>"
+	static void set_thread_name(const std::string& name);
+
+	// removes all the recorded zones
+	static void reset();
+
+	static std::string to_json();
+	static bool save_json(const std::string& file_name);
+
+private:
+	static std::atomic<bool> enabled_;
+};
+
+
+// records a zone from the constructor to the destructor (the names must outlive the zone)
+class TraceZone
+{
+public:
+	TraceZone(const char* name, const char* category = "polyfit") 
+		: name_(name), category_(category), start_(Tracer::is_enabled() ? Tracer::now() : -1.0) {}
+	~TraceZone() { 
+		if (start_ >= 0.0) 
+			Tracer::record(name_, category_, start_, Tracer::now()); 
+	}
+
+private:
+	const char* name_;
+	const char* category_;
+	double		start_;
+};
+
+
+#endif
@@ -40,6 +40,74 @@ inline std::string from_integer(Int v, int width, char fill) {
 }
 
 
+namespace {
+
+	// Constructs an element in the last block, adding a block if it is full. The blocks double in size
+	// (up to a limit), and a new one has room for at least "min_size" elements.
+	template <typename T, typename... Args>
+	T* allocate(std::vector< std::vector<T> >& blocks, std::size_t min_size, Args&&... args) {
+		if (blocks.empty() || blocks.back().size() == blocks.back().capacity()) {
+			std::size_t size = blocks.empty() ? 16 : std::min<std::size_t>(blocks.back().capacity() * 2, 1 << 16);
+			blocks.push_back(std::vector<T>());	// the elements don't move with the blocks
+			blocks.back().reserve(std::max(size, min_size));
+		}
+		blocks.back().emplace_back(std::forward<Args>(args)...);
+		return &blocks.back().back();
+	}
+
+}
+
+
+ProgramElement::ProgramElement(LinearProgram* program, const std::string& name /* = "" */, int idx /* = 0 */)
+	: program_(program)
+	, name_(name.empty() ? 0 : new std::string(name))
+	, index_(idx)
+	, name_prefix_(0)
+{
+}
+
+
+ProgramElement::ProgramElement(const ProgramElement& other)
+	: program_(other.program_)
+	, name_(other.name_ ? new std::string(*other.name_) : 0)
+	, index_(other.index_)
+	, name_prefix_(other.name_prefix_)
+{
+}
+
+
+ProgramElement& ProgramElement::operator=(const ProgramElement& other) {
+	if (this != &other) {
+		program_ = other.program_;
+		set_name(other.name_ ? *other.name_ : std::string());
+		if (!other.name_) {
+			delete name_;
+			name_ = 0;
+		}
+		index_ = other.index_;
+		name_prefix_ = other.name_prefix_;
+	}
+	return *this;
+}
+
+
+std::string ProgramElement::name() const {
+	if (name_)
+		return *name_;
+	if (name_prefix_)
+		return name_prefix_ + from_integer(index_, 9, '0');
+	return std::string();
+}
+
+
+void ProgramElement::set_name(const std::string& n) {
+	if (name_)
+		*name_ = n;
+	else
+		name_ = new std::string(n);
+}
+
+
 //double Bound::infinity_ = std::numeric_limits<double>::max();
 double Bound::infinity_ = 1e20;		// in SCIP, values larger than 1e20 are considered infinity
 
@@ -173,6 +241,7 @@ Variable::Variable(LinearProgram* program, VariableType t /* = CONTINUOUS*/)
 	, variable_type_(t)
 	, solution_value_(0.0)
 {
+	set_name_prefix('x');
 	if (t == BINARY)
 		Bound::set_bounds(0.0, 1.0);
 }
@@ -193,30 +262,122 @@ double Variable::solution_value(bool rounded /* = false*/) const {
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+
+std::size_t SparseRow::find(int var_index) const {
+	const int* pos = std::lower_bound(indices_, indices_ + size_, var_index);
+	if (pos != indices_ + size_ && *pos == var_index)
+		return static_cast<std::size_t>(pos - indices_);
+	return size_;
+}
+
+
+double SparseRow::coefficient(int var_index) const {
+	std::size_t k = find(var_index);
+	return (k < size_) ? values_[k] : 0.0;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 
 LinearExpression::LinearExpression(LinearProgram* program)
 	: ProgramElement(program)
+	, num_merged_(0)
+	, in_matrix_(false)
 {
 }
 
 
 void LinearExpression::add_coefficient(int var_index, double coeff) {
-	if (coefficients_.find(var_index) == coefficients_.end())
-		coefficients_[var_index] = coeff;
-	else
-		coefficients_[var_index] += coeff;
+	if (in_matrix_)
+		detach();
+	indices_.push_back(var_index);
+	values_.push_back(coeff);
+}
+
+
+void LinearExpression::add_coefficients(const std::vector<int>& var_indices, const std::vector<double>& coeffs) {
+	if (var_indices.size() != coeffs.size()) {
+		std::cerr << "the numbers of variables and coefficients don't match" << std::endl;
+		return;
+	}
+	if (in_matrix_)
+		detach();
+	indices_.insert(indices_.end(), var_indices.begin(), var_indices.end());
+	values_.insert(values_.end(), coeffs.begin(), coeffs.end());
+}
+
+
+SparseRow LinearExpression::coefficients() const {
+	if (in_matrix_)
+		return program()->constraint_matrix().row(index());
+
+	merge();
+	return SparseRow(indices_.data(), values_.data(), indices_.size());
+}
+
+
+void LinearExpression::clear() {
+	if (in_matrix_)
+		detach();
+	indices_.clear();
+	values_.clear();
+	num_merged_ = 0;
+}
+
+
+void LinearExpression::merge() const {
+	if (num_merged_ == indices_.size())
+		return;
+
+	// nothing to do if the new coefficients continue the sorted sequence (e.g., variable by variable)
+	bool sorted = true;
+	for (std::size_t i = std::max<std::size_t>(num_merged_, 1); i < indices_.size() && sorted; ++i)
+		sorted = (indices_[i - 1] < indices_[i]);
+
+	if (!sorted) {
+		// the stable sort accumulates the repeated variables in the order they were added
+		std::vector<std::pair<int, double> > entries(indices_.size());
+		for (std::size_t i = 0; i < indices_.size(); ++i)
+			entries[i] = std::make_pair(indices_[i], values_[i]);
+		std::stable_sort(entries.begin(), entries.end(), 
+			[](const std::pair<int, double>& a, const std::pair<int, double>& b) { return a.first < b.first; }
+		);
+
+		std::size_t num = 0;
+		for (std::size_t i = 0; i < entries.size(); ++i) {
+			if (num > 0 && indices_[num - 1] == entries[i].first)
+				values_[num - 1] += entries[i].second;
+			else {
+				indices_[num] = entries[i].first;
+				values_[num] = entries[i].second;
+				++num;
+			}
+		}
+		indices_.resize(num);
+		values_.resize(num);
+	}
+	num_merged_ = indices_.size();
 }
 
+
+void LinearExpression::detach() {
+	const SparseRow row = program()->constraint_matrix().row(index());
+	indices_.assign(row.indices(), row.indices() + row.size());
+	values_.assign(row.values(), row.values() + row.size());
+	num_merged_ = indices_.size();
+	in_matrix_ = false;
+	program()->matrix_dirty_ = true;
+}
+
+
 double LinearExpression::solution_value(bool rounded /* = false*/) const {
 	double solution = 0.0;
 
 	const std::vector<Variable*>& variables = program()->variables();
-	std::unordered_map<int, double>::const_iterator it = coefficients_.begin();
-	for (; it != coefficients_.end(); ++it) {
-		int var_index = it->first;
-		solution += variables[var_index]->solution_value(rounded) * it->second;
-	}
+	const SparseRow coeffs = coefficients();
+	for (std::size_t k = 0; k < coeffs.size(); ++k)
+		solution += variables[coeffs.index(k)]->solution_value(rounded) * coeffs.value(k);
 	return solution;
 }
 
@@ -227,7 +388,9 @@ double LinearExpression::solution_value(bool rounded /* = false*/) const {
 LinearConstraint::LinearConstraint(LinearProgram* program, LinearConstraint::BoundType bt, double lb, double ub) 
 	: LinearExpression(program)
 	, Bound(bt, lb, ub) 
+	, lazy_(false)
 {
+	set_name_prefix('c');
 }
 
 
@@ -245,6 +408,7 @@ LinearObjective::LinearObjective(LinearProgram* program, Sense s)
 
 LinearProgram::LinearProgram()
 	: name_("unknown")
+	, matrix_dirty_(false)
 {
 	// intentionally set the objective to UNDEFINED, so it will allow me to warn
 	// the user if he/she forgot to set the objective sense.
@@ -261,18 +425,150 @@ LinearProgram::~LinearProgram()
 
 
 void LinearProgram::clear() {
-	for (std::size_t i = 0; i < variables_.size(); ++i)
-		delete variables_[i];
 	variables_.clear();
+	variable_blocks_.clear();
 
-	for (std::size_t i = 0; i < constraints_.size(); ++i)
-		delete constraints_[i];
 	constraints_.clear();
+	constraint_blocks_.clear();
+	matrix_.clear();
+	matrix_dirty_ = false;
 
 	objective_->clear();
 }
 
 
+namespace {
+	// the bytes of the name given to an element (none for the default names)
+	double name_bytes(const ProgramElement& e) {
+		return e.has_name() ? double(sizeof(std::string) + e.name().size()) : 0.0;
+	}
+}
+
+
+MemoryUsage LinearProgram::memory_usage() const {
+	MemoryUsage usage;
+
+	double variables = MemoryUsage::of(variables_) + MemoryUsage::of(variable_blocks_);
+	for (std::size_t i = 0; i < variable_blocks_.size(); ++i)
+		variables += MemoryUsage::of(variable_blocks_[i]);
+	for (std::size_t i = 0; i < variables_.size(); ++i)
+		variables += name_bytes(*variables_[i]);
+	usage.add("variables", variables);
+
+	double constraints = MemoryUsage::of(constraints_) + MemoryUsage::of(constraint_blocks_);
+	for (std::size_t i = 0; i < constraint_blocks_.size(); ++i)
+		constraints += MemoryUsage::of(constraint_blocks_[i]);
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		const LinearConstraint* c = constraints_[i];
+		constraints += MemoryUsage::of(c->indices_) + MemoryUsage::of(c->values_) + name_bytes(*c);
+	}
+	usage.add("constraints", constraints);
+
+	usage.add("constraint matrix", MemoryUsage::of(matrix_.row_start) + MemoryUsage::of(matrix_.columns) + MemoryUsage::of(matrix_.values));
+	usage.add("objective", sizeof(LinearObjective) + MemoryUsage::of(objective_->indices_) + MemoryUsage::of(objective_->values_));
+	return usage;
+}
+
+
+void SparseMatrix::clear() {
+	row_start.assign(1, 0);
+	columns.clear();
+	values.clear();
+}
+
+
+void ConstraintBlock::add(LinearConstraint::BoundType bt, double lb, double ub, const int* indices, const double* values, std::size_t num, bool is_lazy) {
+	bound_types.push_back(bt);
+	lower.push_back(lb);
+	upper.push_back(ub);
+	lazy.push_back(is_lazy ? 1 : 0);
+
+	// the rows are short, the insertion sort accumulates the repeated variables in place
+	const std::size_t start = rows.columns.size();
+	for (std::size_t k = 0; k < num; ++k) {
+		std::size_t pos = rows.columns.size();
+		while (pos > start && rows.columns[pos - 1] > indices[k])
+			--pos;
+		if (pos > start && rows.columns[pos - 1] == indices[k])
+			rows.values[pos - 1] += values[k];
+		else {
+			rows.columns.insert(rows.columns.begin() + pos, indices[k]);
+			rows.values.insert(rows.values.begin() + pos, values[k]);
+		}
+	}
+	rows.row_start.push_back(rows.columns.size());
+}
+
+
+void ConstraintBlock::reserve(std::size_t num_rows, std::size_t num_nonzeros) {
+	bound_types.reserve(num_rows);
+	lower.reserve(num_rows);
+	upper.reserve(num_rows);
+	lazy.reserve(num_rows);
+	rows.row_start.reserve(num_rows + 1);
+	rows.columns.reserve(num_nonzeros);
+	rows.values.reserve(num_nonzeros);
+}
+
+
+void ConstraintBlock::clear() {
+	bound_types.clear();
+	lower.clear();
+	upper.clear();
+	lazy.clear();
+	rows.clear();
+}
+
+
+void LinearProgram::finalize() {
+	objective_->merge();
+	if (!matrix_dirty_ && matrix_.num_rows() == constraints_.size())
+		return;
+
+	std::size_t num_nonzeros = 0;
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		const LinearConstraint* c = constraints_[i];
+		if (c->in_matrix_)
+			num_nonzeros += matrix_.row(c->index()).size();
+		else {
+			c->merge();
+			num_nonzeros += c->indices_.size();
+		}
+	}
+
+	SparseMatrix matrix;
+	matrix.row_start.reserve(constraints_.size() + 1);
+	matrix.columns.reserve(num_nonzeros);
+	matrix.values.reserve(num_nonzeros);
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		LinearConstraint* c = constraints_[i];
+		if (c->in_matrix_) {
+			const SparseRow row = matrix_.row(c->index());
+			matrix.columns.insert(matrix.columns.end(), row.indices(), row.indices() + row.size());
+			matrix.values.insert(matrix.values.end(), row.values(), row.values() + row.size());
+		}
+		else {
+			matrix.columns.insert(matrix.columns.end(), c->indices_.begin(), c->indices_.end());
+			matrix.values.insert(matrix.values.end(), c->values_.begin(), c->values_.end());
+			// release the memory of the row
+			std::vector<int>().swap(c->indices_);
+			std::vector<double>().swap(c->values_);
+			c->num_merged_ = 0;
+		}
+		matrix.row_start.push_back(matrix.columns.size());
+	}
+
+	// the rows are stored in the order of the constraints
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		constraints_[i]->set_index(static_cast<int>(i));
+		constraints_[i]->in_matrix_ = true;
+	}
+
+	std::swap(matrix_, matrix);
+	matrix_dirty_ = false;
+}
+
+
 Variable* LinearProgram::create_variable(
 	Variable::VariableType vt /* = Variable::CONTINUOUS */, 
 	Variable::BoundType bt /* = Variable::FREE */, 
@@ -280,14 +576,14 @@ Variable* LinearProgram::create_variable(
 	double ub /* = +Variable::infinity() */, 
 	const std::string& name /* = "" */)
 {
-	Variable* v = new Variable(this, vt);
+	Variable* v = allocate(variable_blocks_, 1, this, vt);
 	v->set_bounds(bt, lb, ub);
 
 	std::size_t idx = variables_.size();
 	v->set_index(idx);
 
-	const std::string& fixed_name = name.empty() ? "x" + from_integer(idx, 9, '0') : name;
-	v->set_name(fixed_name);
+	if (!name.empty())	// the default name is given by the index
+		v->set_name(name);
 
 	variables_.push_back(v);
 	return v;
@@ -296,8 +592,12 @@ Variable* LinearProgram::create_variable(
 
 std::vector<Variable*> LinearProgram::create_n_variables(std::size_t n) {
 	std::vector<Variable*> variables;
+	variables.reserve(n);
+	variables_.reserve(variables_.size() + n);
 	for (std::size_t i = 0; i < n; ++i) {
-		Variable* v = create_variable();
+		Variable* v = allocate(variable_blocks_, n - i, this, Variable::CONTINUOUS);
+		v->set_index(variables_.size());
+		variables_.push_back(v);
 		variables.push_back(v);
 	}
 	return variables;
@@ -310,29 +610,67 @@ LinearConstraint* LinearProgram::create_constraint(
 	double ub /* = +Variable::infinity() */, 
 	const std::string& name /* = "" */ )
 {
-	LinearConstraint* c = new LinearConstraint(this, bt, lb, ub);
+	LinearConstraint* c = allocate(constraint_blocks_, 1, this, bt, lb, ub);
 
 	std::size_t idx = constraints_.size();
 	c->set_index(idx);
 
-	const std::string& fixed_name = name.empty() ? "c" + from_integer(idx, 9, '0') : name;
-	c->set_name(fixed_name);
+	if (!name.empty())	// the default name is given by the index
+		c->set_name(name);
 
 	constraints_.push_back(c);
+	matrix_dirty_ = true;
 	return c;
 }
 
 
 std::vector<LinearConstraint*> LinearProgram::create_n_constraints(std::size_t n) {
 	std::vector<LinearConstraint*> constraints;
+	constraints.reserve(n);
+	constraints_.reserve(constraints_.size() + n);
 	for (std::size_t i = 0; i < n; ++i) {
-		LinearConstraint* v = create_constraint();
-		constraints.push_back(v);
+		LinearConstraint* c = allocate(constraint_blocks_, n - i, this, LinearConstraint::FREE, -LinearConstraint::infinity(), +LinearConstraint::infinity());
+		c->set_index(constraints_.size());
+		constraints_.push_back(c);
+		constraints.push_back(c);
 	}
+	matrix_dirty_ = true;
 	return constraints;
 }
 
 
+void LinearProgram::add_constraints(const std::vector<const ConstraintBlock*>& blocks) {
+	finalize();
+
+	std::size_t num_rows = 0, num_nonzeros = 0;
+	for (std::size_t b = 0; b < blocks.size(); ++b) {
+		num_rows += blocks[b]->num_rows();
+		num_nonzeros += blocks[b]->rows.num_nonzeros();
+	}
+	matrix_.row_start.reserve(matrix_.row_start.size() + num_rows);
+	matrix_.columns.reserve(matrix_.columns.size() + num_nonzeros);
+	matrix_.values.reserve(matrix_.values.size() + num_nonzeros);
+
+	const std::vector<LinearConstraint*>& constraints = create_n_constraints(num_rows);
+	std::size_t idx = 0;
+	for (std::size_t b = 0; b < blocks.size(); ++b) {
+		const ConstraintBlock& block = *blocks[b];
+		matrix_.columns.insert(matrix_.columns.end(), block.rows.columns.begin(), block.rows.columns.end());
+		matrix_.values.insert(matrix_.values.end(), block.rows.values.begin(), block.rows.values.end());
+		const std::size_t offset = matrix_.row_start.back();
+		for (std::size_t i = 0; i < block.num_rows(); ++i, ++idx) {
+			matrix_.row_start.push_back(offset + block.rows.row_start[i + 1]);
+
+			LinearConstraint* c = constraints[idx];
+			c->set_bounds(block.bound_types[i], block.lower[i], block.upper[i]);
+			c->set_lazy(block.lazy[i] != 0);
+			c->in_matrix_ = true;
+		}
+	}
+	matrix_dirty_ = false;
+}
+
+
 LinearObjective* LinearProgram::create_objective(LinearObjective::Sense sense /* = LinearObjective::MINIMIZE*/) {
 	if (objective_)
 		delete objective_;
@@ -416,3 +754,38 @@ bool LinearProgram::is_binary_proram() const {
 	std::size_t num = num_binary_variables();
 	return (num > 0) && (num == variables_.size());
 }
+
+
+namespace {
+	bool is_integral(double value) {
+		return std::abs(value - std::floor(value + 0.5)) <= 1e-9;
+	}
+}
+
+
+// returns true if the variables are all 0-1 and the constraints have integral coefficients and bounds
+bool LinearProgram::is_pseudo_boolean() const {
+	for (std::size_t i = 0; i < variables_.size(); ++i) {
+		const Variable* v = variables_[i];
+		if (v->variable_type() == Variable::BINARY)
+			continue;
+		double lb, ub;
+		v->get_bounds(lb, ub);
+		if (v->variable_type() != Variable::INTEGER || lb < 0.0 || ub > 1.0)
+			return false;
+	}
+
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		const LinearConstraint* c = constraints_[i];
+		double lb, ub;
+		c->get_bounds(lb, ub);
+		if ((lb > -Bound::infinity() && !is_integral(lb)) || (ub < Bound::infinity() && !is_integral(ub)))
+			return false;
+		const SparseRow coeffs = c->coefficients();
+		for (std::size_t k = 0; k < coeffs.size(); ++k) {
+			if (!is_integral(coeffs.value(k)))
+				return false;
+		}
+	}
+	return !variables_.empty();
+}
@@ -21,10 +21,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define _MATH_LINEAR_PROGRAM_H_
 
 #include "math_common.h"
+#include "../basic/memory_usage.h"
 
 #include <string>
+#include <iosfwd>
 #include <vector>
-#include <unordered_map>
 
 
 class LinearProgram;
@@ -35,10 +36,17 @@ class MATH_API ProgramElement
 public:
 	// A program element cannot belong to multiple models.
 	// "program" is the program the owns this element.
-	ProgramElement(LinearProgram* program, const std::string& name = "", int idx = 0) : program_(program), name_(name), index_(idx) {}
-
-	const std::string& name() const { return name_; }
-	void set_name(const std::string& n) { name_ = n; }
+	ProgramElement(LinearProgram* program, const std::string& name = "", int idx = 0);
+	ProgramElement(const ProgramElement& other);
+	ProgramElement& operator=(const ProgramElement& other);
+	~ProgramElement() { delete name_; }
+
+	// Returns the name given by set_name(), or else a default one made of the index (e.g., x000000012 
+	// for a variable, c000000012 for a constraint). Only the given names are stored, so the millions of
+	// elements of a large program don't cost a string each.
+	std::string name() const;
+	void set_name(const std::string& n);
+	bool has_name() const { return name_ != 0; }
 
 	int index() const { return index_; }
 	void set_index(int idx) { index_ = idx; }
@@ -47,10 +55,15 @@ public:
 	const LinearProgram* program() const { return program_; }
 	LinearProgram* program() { return program_; }
 
+protected:
+	// the first letter of the default names (none if 0)
+	void set_name_prefix(char prefix) { name_prefix_ = prefix; }
+
 private:
 	LinearProgram * program_; // the program the owns this element
-	std::string		name_;
+	std::string*	name_;	  // null if none was given
 	int				index_;
+	char			name_prefix_;
 };
 
 
@@ -115,6 +128,36 @@ private:
 };
 
 
+// A read-only view of the coefficients of an expression, sorted by the variable indices (a variable
+// appears at most once). It is invalidated by any change of the expression and by LinearProgram::finalize().
+class MATH_API SparseRow
+{
+public:
+	SparseRow(const int* indices = 0, const double* values = 0, std::size_t size = 0) : indices_(indices), values_(values), size_(size) {}
+
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	// the variable index and the coefficient of the k-th entry
+	int	   index(std::size_t k) const { return indices_[k]; }
+	double value(std::size_t k) const { return values_[k]; }
+
+	// the arrays of the entries, e.g., to be handed over to the solvers at once
+	const int*	  indices() const { return indices_; }
+	const double* values() const { return values_; }
+
+	// the position of the variable (by a binary search), or size() if it is not in the expression
+	std::size_t find(int var_index) const;
+	// the coefficient of the variable (0 if it is not in the expression)
+	double coefficient(int var_index) const;
+
+private:
+	const int*	  indices_;
+	const double* values_;
+	std::size_t	  size_;
+};
+
+
 class MATH_API LinearExpression : public ProgramElement
 {
 public:
@@ -122,9 +165,13 @@ public:
 	// "program" is the program the owns this expression.
 	LinearExpression(LinearProgram* program);
 
+	// The coefficients are appended and only merged (i.e., sorted and accumulated) when they are queried
+	// or when the program is finalized, so building long expressions is cheap.
 	void add_coefficient(int var_index, double coeff);	// coefficients can accumulate
+	void add_coefficients(const std::vector<int>& var_indices, const std::vector<double>& coeffs);
 
-	const std::unordered_map<int, double>& coefficients() const { return coefficients_; }
+	// Note: not thread-safe unless the program has been finalized (the coefficients may have to be merged).
+	SparseRow coefficients() const;
 
 	// Evaluates the value of this expression at the solution found.
 	// Note: (1) valid only if the problem was successfully solved.
@@ -132,10 +179,22 @@ public:
 	//           variable value will be rounded to the nearest integer.
 	double solution_value(bool rounded = false) const;
 	
-	void clear() { coefficients_.clear(); }
+	void clear();
+
+private:
+	void merge() const;
+	void detach();	// copies the row out of the constraint matrix to modify it
 
 private:
-	std::unordered_map<int, double>	coefficients_;
+	friend class LinearProgram;
+
+	// the coefficients that don't live in the constraint matrix of the program (the first 'num_merged_'
+	// ones are sorted and unique, the others have been appended since)
+	mutable std::vector<int>	indices_;
+	mutable std::vector<double>	values_;
+	mutable std::size_t			num_merged_;
+
+	bool in_matrix_;	// true if this is a constraint stored in the constraint matrix of the program
 };
 
 
@@ -145,6 +204,14 @@ public:
 	// A constraint cannot belong to several models.
 	// "program" is the program the owns this constraint.
 	LinearConstraint(LinearProgram* program, LinearConstraint::BoundType bt, double lb, double ub);
+
+	// A lazy constraint is not put in the initial relaxation. The solvers supporting it (i.e., SCIP and 
+	// GUROBI) add it only when a solution violates it, the others treat it as a usual constraint.
+	void set_lazy(bool b) { lazy_ = b; }
+	bool is_lazy() const { return lazy_; }
+
+private:
+	bool lazy_;
 };
 
 
@@ -166,6 +233,54 @@ private:
 };
 
 
+// The constraint matrix in the compressed sparse row (CSR) format, i.e., the coefficients of the i-th
+// constraint are the entries [row_start[i], row_start[i + 1]) of 'columns' (the variable indices) and 
+// 'values'. Each row is sorted by the variable indices.
+class MATH_API SparseMatrix
+{
+public:
+	SparseMatrix() : row_start(1, 0) {}
+
+	std::size_t num_rows() const { return row_start.size() - 1; }
+	std::size_t num_nonzeros() const { return values.size(); }
+
+	SparseRow row(std::size_t i) const {
+		return SparseRow(columns.data() + row_start[i], values.data() + row_start[i], row_start[i + 1] - row_start[i]);
+	}
+
+	void clear();
+
+	std::vector<std::size_t> row_start;	// of size num_rows() + 1
+	std::vector<int>		 columns;
+	std::vector<double>		 values;
+};
+
+
+// A block of constraints in the CSR format, e.g., formulated by a thread on its own, to be added to a
+// program at once (see LinearProgram::add_constraints()) without creating the constraints one by one.
+class MATH_API ConstraintBlock
+{
+public:
+	ConstraintBlock() {}
+
+	std::size_t num_rows() const { return rows.num_rows(); }
+	bool empty() const { return bound_types.empty(); }
+
+	// Appends a constraint of the "num" coefficients "indices" and "values" (as add_constraint() of 
+	// LinearProgramBuilder). The row is sorted and the repeated variables are accumulated.
+	void add(LinearConstraint::BoundType bt, double lb, double ub, const int* indices, const double* values, std::size_t num, bool lazy = false);
+
+	void reserve(std::size_t num_rows, std::size_t num_nonzeros);
+	void clear();
+
+	std::vector<LinearConstraint::BoundType> bound_types;
+	std::vector<double>	lower;
+	std::vector<double>	upper;
+	std::vector<char>	lazy;
+	SparseMatrix		rows;
+};
+
+
 class MATH_API LinearProgram
 {
 public:
@@ -204,6 +319,10 @@ public:
 	// Note: constraints with be given default names, e.g., c0, c1...
 	std::vector<LinearConstraint*> create_n_constraints(std::size_t n);
 
+	// Adds the constraints of the blocks (in this order). Their coefficients go straight into the 
+	// constraint matrix, which is finalized first if it is not up to date.
+	void add_constraints(const std::vector<const ConstraintBlock*>& blocks);
+
 	// create the objective function and returns the pointer.
 	LinearObjective* create_objective(LinearObjective::Sense sense = LinearObjective::MINIMIZE);
 
@@ -230,12 +349,32 @@ public:
 	bool is_mix_integer_program() const;	// returns true if mixed inter program
 	bool is_integer_program() const;		// returns true if inter program
 	bool is_binary_proram() const;			// returns true if binary program
+
+	// Returns true if the variables are all 0-1 (binary, or integers within [0, 1]) and the constraints
+	// have integral coefficients and bounds, i.e., the program can be written in the pseudo-Boolean
+	// format ("opb", see save()) and solved by CPSAT (only the objective may have real coefficients).
+	bool is_pseudo_boolean() const;
 	
 	//////////////////////////////////////////////////////////////////////////
 
 	// clear all variables, constraints, and the objective.
 	void clear();
 
+	// the memory used by the "variables", the "constraints" (with the coefficients that are not in the 
+	// matrix yet), the "constraint matrix", and the "objective"
+	MemoryUsage memory_usage() const;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// Moves the coefficients of the constraints into the constraint matrix (and merges those of the
+	// objective). The solvers call it before solving. Coefficients can still be added afterwards, which
+	// takes the modified constraints out of the matrix until the next finalize().
+	void finalize();
+	bool is_finalized() const { return !matrix_dirty_; }
+
+	// The coefficients of all the constraints. Valid only if the program has been finalized.
+	const SparseMatrix& constraint_matrix() const { return matrix_; }
+
 	//////////////////////////////////////////////////////////////////////////
 
 		// read/write linear program from/to a file. Format determined by file extension:
@@ -255,18 +394,47 @@ public:
 	//            handlers. The CIP format is the only format within SCIP that allows to write 
 	//            and read all constraints; all other file formats are restricted to some 
 	//            particular sub-class of constraint integer programs.
+	//  - "lpb":  a binary snapshot of the program (the raw arrays of the bounds, the types, the 
+	//            constraint matrix, and the objective, in the native byte order). It is written 
+	//            and read in time linear to its size, without any parsing.
+	//  - "opb":  the linear pseudo-Boolean format of the PB competitions (for the PB and MaxSAT 
+	//            solvers), only for the pseudo-Boolean programs (see is_pseudo_boolean()). The 
+	//            variables are named x1, x2... (in the order of the program), and the objective is
+	//            minimized, with integral coefficients: it is scaled by a power of 10 keeping about 
+	//            9 significant digits (and negated if maximized), as noted in a comment of the file. 
+	//            It is read as written (i.e., with the scaled objective).
 	bool load(const std::string& file_name);
 
 	// the parameter "use_simple_name" provides an option to save the variables/constrains' 
-	// original names or simple names like x0, x1... and c0, c1...
+	// original names or simple names like x0, x1... and c0, c1... (a binary snapshot doesn't
+	// store any names then)
 	bool save(const std::string& file_name, bool use_simple_name = false) const;
+
+	// the binary snapshot ("lpb") written to or read from a stream, e.g., as a part of a larger file.
+	// 'name' stands for the source in the messages (and names the program if it has no names).
+	bool write_binary(std::ostream& output, bool with_names) const;
+	bool read_binary(std::istream& input, const std::string& name);
 	
+private:
+	bool save_binary(const std::string& file_name, bool with_names) const;
+	bool save_pseudo_boolean(const std::string& file_name) const;
+	bool load_binary(const std::string& file_name);
+
 private:
 	std::string			name_;
 	LinearObjective*	objective_;
 
 	std::vector<Variable*>			variables_;
 	std::vector<LinearConstraint*>	constraints_;
+
+	// The variables and the constraints live in blocks of growing sizes (the addresses never change), so 
+	// they are not allocated one by one.
+	std::vector< std::vector<Variable> >			variable_blocks_;
+	std::vector< std::vector<LinearConstraint> >	constraint_blocks_;
+
+	friend class LinearExpression;
+	SparseMatrix	matrix_;
+	bool			matrix_dirty_;	// true if some constraints are not in the matrix
 };
 
 
@@ -0,0 +1,87 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "linear_program_builder.h"
+
+
+std::size_t LinearProgramRecorder::add_variables(std::size_t n, Variable::VariableType vt, Variable::BoundType bt, double lb, double ub) {
+	std::size_t first = program_->num_variables();
+	for (std::size_t i = 0; i < n; ++i)
+		program_->create_variable(vt, bt, lb, ub);
+	return first;
+}
+
+
+void LinearProgramRecorder::add_constraint(LinearConstraint::BoundType bt, double lb, double ub, const std::vector<int>& var_indices, const std::vector<double>& coeffs, bool lazy) {
+	LinearConstraint* c = program_->create_constraint(bt, lb, ub);
+	c->add_coefficients(var_indices, coeffs);
+	c->set_lazy(lazy);
+}
+
+
+void LinearProgramBuilder::add_constraints(const std::vector<const ConstraintBlock*>& blocks) {
+	std::vector<int>	indices;
+	std::vector<double> values;
+	for (std::size_t b = 0; b < blocks.size(); ++b) {
+		const ConstraintBlock& block = *blocks[b];
+		for (std::size_t i = 0; i < block.num_rows(); ++i) {
+			const SparseRow row = block.rows.row(i);
+			indices.assign(row.indices(), row.indices() + row.size());
+			values.assign(row.values(), row.values() + row.size());
+			add_constraint(block.bound_types[i], block.lower[i], block.upper[i], indices, values, block.lazy[i] != 0);
+		}
+	}
+}
+
+
+void build_program(const LinearProgram& program, LinearProgramBuilder& builder) {
+	build_constraints(program, builder);
+
+	const LinearObjective* objective = program.objective();
+	builder.set_objective_sense(objective->sense());
+	const SparseRow obj_coeffs = objective->coefficients();
+	for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+		builder.add_objective_coefficient(obj_coeffs.index(k), obj_coeffs.value(k));
+}
+
+
+void build_constraints(const LinearProgram& program, LinearProgramBuilder& builder) {
+	const std::vector<Variable*>& variables = program.variables();
+	for (std::size_t i = 0; i < variables.size(); ++i) {
+		const Variable* v = variables[i];
+		double lb, ub;
+		v->get_bounds(lb, ub);
+		builder.add_variables(1, v->variable_type(), v->bound_type(), lb, ub);
+	}
+
+	std::vector<int>	indices;
+	std::vector<double> values;
+	const std::vector<LinearConstraint*>& constraints = program.constraints();
+	for (std::size_t i = 0; i < constraints.size(); ++i) {
+		const LinearConstraint* c = constraints[i];
+		const SparseRow row = c->coefficients();
+		indices.assign(row.indices(), row.indices() + row.size());
+		values.assign(row.values(), row.values() + row.size());
+
+		double lb, ub;
+		c->get_bounds(lb, ub);
+		builder.add_constraint(c->bound_type(), lb, ub, indices, values, c->is_lazy());
+	}
+}
@@ -0,0 +1,111 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MATH_LINEAR_PROGRAM_BUILDER_H_
+#define _MATH_LINEAR_PROGRAM_BUILDER_H_
+
+#include "math_common.h"
+#include "linear_program.h"
+
+#include <vector>
+
+
+// An interface to formulate a linear program variable by variable and constraint by constraint. It is
+// implemented by LinearProgramRecorder (keeping the whole model in a LinearProgram) and by the streaming 
+// builders of the solvers (see LinearProgramSolver::create_builder()), which create the rows of the 
+// solver right away, so the model exists only once.
+class MATH_API LinearProgramBuilder
+{
+public:
+	LinearProgramBuilder() : store_names_(false) {}
+	virtual ~LinearProgramBuilder() {}
+
+	// Adds n variables and returns the index of the first one (the variables are indexed in the order
+	// they are added, starting from 0). The bounds are ignored for BINARY variables.
+	virtual std::size_t add_variables(
+		std::size_t n,
+		Variable::VariableType vt,
+		Variable::BoundType bt = Variable::FREE,
+		double lb = -Variable::infinity(),
+		double ub = +Variable::infinity()
+	) = 0;
+
+	// Adds a constraint. Only the bounds implied by the bound type are read (e.g., "lb" for LOWER).
+	// See LinearConstraint::set_lazy() for "lazy".
+	virtual void add_constraint(
+		LinearConstraint::BoundType bt, 
+		double lb, 
+		double ub, 
+		const std::vector<int>& var_indices, 
+		const std::vector<double>& coeffs,
+		bool lazy = false
+	) = 0;
+
+	// Adds the constraints of the blocks (in this order), e.g., formulated by several threads. By default,
+	// they are added one by one.
+	virtual void add_constraints(const std::vector<const ConstraintBlock*>& blocks);
+
+	virtual void set_objective_sense(LinearObjective::Sense sense) = 0;
+	virtual void add_objective_coefficient(int var_index, double coeff) = 0;	// coefficients can accumulate
+
+	virtual std::size_t num_variables() const = 0;
+	virtual std::size_t num_constraints() const = 0;
+
+	// A name costs memory for each variable and constraint, so the streaming builders don't give any 
+	// unless this is turned on (e.g., for debugging).
+	void set_store_names(bool b) { store_names_ = b; }
+	bool store_names() const { return store_names_; }
+
+private:
+	bool store_names_;
+};
+
+
+// formulates the program in a LinearProgram (which keeps its default names)
+class MATH_API LinearProgramRecorder : public LinearProgramBuilder
+{
+public:
+	LinearProgramRecorder(LinearProgram* program) : program_(program) {}
+
+	virtual std::size_t add_variables(std::size_t n, Variable::VariableType vt, Variable::BoundType bt = Variable::FREE, double lb = -Variable::infinity(), double ub = +Variable::infinity());
+	virtual void add_constraint(LinearConstraint::BoundType bt, double lb, double ub, const std::vector<int>& var_indices, const std::vector<double>& coeffs, bool lazy = false);
+	// the rows go straight into the constraint matrix (see LinearProgram::add_constraints())
+	virtual void add_constraints(const std::vector<const ConstraintBlock*>& blocks) { program_->add_constraints(blocks); }
+
+	virtual void set_objective_sense(LinearObjective::Sense sense) { program_->objective()->set_sense(sense); }
+	virtual void add_objective_coefficient(int var_index, double coeff) { program_->objective()->add_coefficient(var_index, coeff); }
+
+	virtual std::size_t num_variables() const { return program_->num_variables(); }
+	virtual std::size_t num_constraints() const { return program_->num_constraints(); }
+
+private:
+	LinearProgram* program_;
+};
+
+
+// Formulates an existing program with a builder, e.g., to hand it over to a solver.
+MATH_API void build_program(const LinearProgram& program, LinearProgramBuilder& builder);
+
+// Formulates only the variables and the constraints of an existing program (e.g., to pair them with 
+// another objective). The program is only read, so several threads can do it at a time once it has
+// been finalized.
+MATH_API void build_constraints(const LinearProgram& program, LinearProgramBuilder& builder);
+
+
+#endif
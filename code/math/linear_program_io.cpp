@@ -23,6 +23,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
+#include <cmath>
 
 #include "scip/scip.h"
 #include "scip/scipdefplugins.h"
@@ -78,7 +80,10 @@ namespace details {
 #ifdef SORT_VARIABLES_IN_INCREASING_ORDER
 
 	std::vector<std::pair<int, double>> ordered_coefficients(const LinearExpression* expr, bool increasing_order /* = true*/) {
-		std::vector<std::pair<int, double>> coeffs(expr->coefficients().begin(), expr->coefficients().end());
+		const SparseRow row = expr->coefficients();
+		std::vector<std::pair<int, double>> coeffs(row.size());
+		for (std::size_t k = 0; k < row.size(); ++k)
+			coeffs[k] = std::make_pair(row.index(k), row.value(k));
 
 		// it is possible to make the order an parameter when constructing SortObj, but this is a bit more efficient 
 		if (increasing_order) {
@@ -102,10 +107,365 @@ namespace details {
 	}
 #endif
 
+	//////////////////////////////////////////////////////////////////////////
+
+	// the binary snapshot ("lpb") starts with this tag and its version
+	static const char		 BINARY_TAG[4] = { 'P', 'F', 'L', 'P' };
+	static const uint32_t BINARY_VERSION = 1;
+
+	template <typename T>
+	void write_array(std::ostream& output, const T* data, std::size_t n) {
+		if (n > 0)
+			output.write(reinterpret_cast<const char*>(data), n * sizeof(T));
+	}
+
+	template <typename T>
+	void write_value(std::ostream& output, const T& value) {
+		write_array(output, &value, 1);
+	}
+
+	void write_string(std::ostream& output, const std::string& str) {
+		write_value(output, static_cast<uint32_t>(str.size()));
+		write_array(output, str.data(), str.size());
+	}
+
+	template <typename T>
+	bool read_array(std::istream& input, T* data, std::size_t n) {
+		if (n > 0)
+			input.read(reinterpret_cast<char*>(data), n * sizeof(T));
+		return !input.fail();
+	}
+
+	template <typename T>
+	bool read_value(std::istream& input, T& value) {
+		return read_array(input, &value, 1);
+	}
+
+	bool read_string(std::istream& input, std::string& str) {
+		uint32_t size = 0;
+		if (!read_value(input, size))
+			return false;
+		str.resize(size);
+		return size == 0 || read_array(input, &str[0], size);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// writes a term of the pseudo-Boolean format ("+3 x12 "), the variables counting from 1
+	void write_term(std::ostream& output, long long coeff, int var_index) {
+		output << (coeff < 0 ? "" : "+") << coeff << " x" << var_index + 1 << " ";
+	}
+
+	// writes "row >= bound ;" (or "= bound") scaled by 'sign' (-1 turns "<=" into ">=")
+	void write_pseudo_boolean_constraint(std::ostream& output, const SparseRow& row, int sign, const char* relation, double bound) {
+		for (std::size_t k = 0; k < row.size(); ++k)
+			write_term(output, sign * std::llround(row.value(k)), row.index(k));
+		output << relation << " " << sign * std::llround(bound) << " ;\n";
+	}
+
+}
+
+
+bool LinearProgram::save_binary(const std::string& file_name, bool with_names) const {
+	std::ofstream output(file_name.c_str(), std::ios::binary);
+	if (output.fail()) {
+		std::cerr << "could not create/open file to save:\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+	return write_binary(output, with_names);
+}
+
+
+bool LinearProgram::write_binary(std::ostream& output, bool with_names) const {
+	// the coefficients of the constraints are written straight from the constraint matrix
+	const_cast<LinearProgram*>(this)->finalize();
+
+	const uint64_t num_variables = variables_.size();
+	const uint64_t num_constraints = constraints_.size();
+	output.write(details::BINARY_TAG, sizeof(details::BINARY_TAG));
+	details::write_value(output, details::BINARY_VERSION);
+	details::write_value(output, static_cast<uint8_t>(with_names));
+	details::write_value(output, static_cast<uint8_t>(objective_->sense()));
+	details::write_value(output, num_variables);
+	details::write_value(output, num_constraints);
+	details::write_value(output, static_cast<uint64_t>(matrix_.num_nonzeros()));
+
+	std::vector<uint8_t> var_types(num_variables), bound_types(num_variables);
+	std::vector<double> lower(num_variables), upper(num_variables);
+	for (std::size_t i = 0; i < num_variables; ++i) {
+		const Variable* v = variables_[i];
+		var_types[i] = static_cast<uint8_t>(v->variable_type());
+		bound_types[i] = static_cast<uint8_t>(v->bound_type());
+		v->get_bounds(lower[i], upper[i]);
+	}
+	details::write_array(output, var_types.data(), num_variables);
+	details::write_array(output, bound_types.data(), num_variables);
+	details::write_array(output, lower.data(), num_variables);
+	details::write_array(output, upper.data(), num_variables);
+
+	std::vector<uint8_t> lazy(num_constraints);
+	bound_types.resize(num_constraints);
+	lower.resize(num_constraints);
+	upper.resize(num_constraints);
+	for (std::size_t i = 0; i < num_constraints; ++i) {
+		const LinearConstraint* c = constraints_[i];
+		bound_types[i] = static_cast<uint8_t>(c->bound_type());
+		lazy[i] = c->is_lazy();
+		c->get_bounds(lower[i], upper[i]);
+	}
+	details::write_array(output, bound_types.data(), num_constraints);
+	details::write_array(output, lazy.data(), num_constraints);
+	details::write_array(output, lower.data(), num_constraints);
+	details::write_array(output, upper.data(), num_constraints);
+
+	std::vector<uint64_t> row_start(matrix_.row_start.begin(), matrix_.row_start.end());
+	details::write_array(output, row_start.data(), row_start.size());
+	details::write_array(output, matrix_.columns.data(), matrix_.columns.size());
+	details::write_array(output, matrix_.values.data(), matrix_.values.size());
+
+	const SparseRow obj_coeffs = objective_->coefficients();
+	details::write_value(output, static_cast<uint64_t>(obj_coeffs.size()));
+	details::write_array(output, obj_coeffs.indices(), obj_coeffs.size());
+	details::write_array(output, obj_coeffs.values(), obj_coeffs.size());
+
+	if (with_names) {
+		details::write_string(output, name_);
+		for (std::size_t i = 0; i < num_variables; ++i)
+			details::write_string(output, variables_[i]->name());
+		for (std::size_t i = 0; i < num_constraints; ++i)
+			details::write_string(output, constraints_[i]->name());
+	}
+
+	return !output.fail();
+}
+
+
+bool LinearProgram::load_binary(const std::string& file_name) {
+	std::ifstream input(file_name.c_str(), std::ios::binary);
+	if (input.fail()) {
+		std::cerr << "could not open file: \'" << file_name << "\'" << std::endl;
+		return false;
+	}
+	return read_binary(input, file_name);
+}
+
+
+bool LinearProgram::read_binary(std::istream& input, const std::string& name) {
+	clear();
+
+	char tag[sizeof(details::BINARY_TAG)];
+	uint32_t version = 0;
+	uint8_t with_names = 0, sense = 0;
+	uint64_t num_variables = 0, num_constraints = 0, num_nonzeros = 0;
+	if (!details::read_array(input, tag, sizeof(tag)) || !std::equal(tag, tag + sizeof(tag), details::BINARY_TAG) ||
+		!details::read_value(input, version) || version != details::BINARY_VERSION)
+	{
+		std::cerr << "not a binary linear program (or of an unsupported version): \'" << name << "\'" << std::endl;
+		return false;
+	}
+	if (!details::read_value(input, with_names) || !details::read_value(input, sense) ||
+		!details::read_value(input, num_variables) || !details::read_value(input, num_constraints) || !details::read_value(input, num_nonzeros))
+	{
+		std::cerr << "corrupted binary linear program: \'" << name << "\'" << std::endl;
+		return false;
+	}
+
+	// the arrays must fit in the rest of the file (before anything is allocated for them)
+	std::streampos position = input.tellg();
+	input.seekg(0, std::ios::end);
+	uint64_t remaining = static_cast<uint64_t>(input.tellg() - position);
+	input.seekg(position);
+	const uint64_t max_count = remaining / sizeof(uint8_t);
+	if (num_variables > max_count || num_constraints > max_count || num_nonzeros > max_count ||
+		num_variables * (2 + 2 * sizeof(double)) + num_constraints * (2 + 2 * sizeof(double)) + (num_constraints + 1) * sizeof(uint64_t) + 
+		num_nonzeros * (sizeof(int) + sizeof(double)) + sizeof(uint64_t) > remaining)
+	{
+		std::cerr << "corrupted binary linear program: \'" << name << "\'" << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> var_types(num_variables), var_bound_types(num_variables);
+	std::vector<double> var_lower(num_variables), var_upper(num_variables);
+	std::vector<uint8_t> cons_bound_types(num_constraints), lazy(num_constraints);
+	std::vector<double> cons_lower(num_constraints), cons_upper(num_constraints);
+	std::vector<uint64_t> row_start(num_constraints + 1);
+	SparseMatrix matrix;
+	matrix.columns.resize(num_nonzeros);
+	matrix.values.resize(num_nonzeros);
+	uint64_t num_obj_coeffs = 0;
+	bool ok = details::read_array(input, var_types.data(), num_variables) &&
+		details::read_array(input, var_bound_types.data(), num_variables) &&
+		details::read_array(input, var_lower.data(), num_variables) &&
+		details::read_array(input, var_upper.data(), num_variables) &&
+		details::read_array(input, cons_bound_types.data(), num_constraints) &&
+		details::read_array(input, lazy.data(), num_constraints) &&
+		details::read_array(input, cons_lower.data(), num_constraints) &&
+		details::read_array(input, cons_upper.data(), num_constraints) &&
+		details::read_array(input, row_start.data(), row_start.size()) &&
+		details::read_array(input, matrix.columns.data(), num_nonzeros) &&
+		details::read_array(input, matrix.values.data(), num_nonzeros) &&
+		details::read_value(input, num_obj_coeffs);
+
+	// the rows must be sorted and within the variables (as the matrix of a finalized program)
+	for (std::size_t i = 0; ok && i < num_constraints; ++i) {
+		ok = row_start[i] <= row_start[i + 1] && row_start[i + 1] <= num_nonzeros;
+		for (uint64_t k = row_start[i]; ok && k < row_start[i + 1]; ++k)
+			ok = matrix.columns[k] >= 0 && uint64_t(matrix.columns[k]) < num_variables && (k == row_start[i] || matrix.columns[k - 1] < matrix.columns[k]);
+	}
+	ok = ok && row_start[0] == 0 && row_start[num_constraints] == num_nonzeros && num_obj_coeffs <= num_variables;
+
+	std::vector<int> obj_indices(ok ? num_obj_coeffs : 0);
+	std::vector<double> obj_values(ok ? num_obj_coeffs : 0);
+	ok = ok && details::read_array(input, obj_indices.data(), obj_indices.size()) && details::read_array(input, obj_values.data(), obj_values.size());
+	for (std::size_t k = 0; ok && k < obj_indices.size(); ++k)
+		ok = obj_indices[k] >= 0 && uint64_t(obj_indices[k]) < num_variables;
+	if (!ok) {
+		std::cerr << "corrupted binary linear program: \'" << name << "\'" << std::endl;
+		return false;
+	}
+
+	const std::vector<Variable*>& variables = create_n_variables(num_variables);
+	for (std::size_t i = 0; i < num_variables; ++i) {
+		Variable* v = variables[i];
+		v->set_variable_type(static_cast<Variable::VariableType>(var_types[i]));
+		v->set_bounds(static_cast<Variable::BoundType>(var_bound_types[i]), var_lower[i], var_upper[i]);
+	}
+
+	const std::vector<LinearConstraint*>& constraints = create_n_constraints(num_constraints);
+	for (std::size_t i = 0; i < num_constraints; ++i) {
+		LinearConstraint* c = constraints[i];
+		c->set_bounds(static_cast<LinearConstraint::BoundType>(cons_bound_types[i]), cons_lower[i], cons_upper[i]);
+		c->set_lazy(lazy[i] != 0);
+		c->set_index(static_cast<int>(i));
+		c->in_matrix_ = true;
+	}
+
+	// the coefficients go straight into the constraint matrix
+	matrix.row_start.assign(row_start.begin(), row_start.end());
+	std::swap(matrix_, matrix);
+	matrix_dirty_ = false;
+
+	objective_->set_sense(static_cast<LinearObjective::Sense>(sense));
+	objective_->add_coefficients(obj_indices, obj_values);
+
+	if (with_names) {
+		std::string name;
+		ok = details::read_string(input, name);
+		name_ = name;
+		for (std::size_t i = 0; ok && i < num_variables; ++i) {
+			ok = details::read_string(input, name);
+			variables[i]->set_name(name);
+		}
+		for (std::size_t i = 0; ok && i < num_constraints; ++i) {
+			ok = details::read_string(input, name);
+			constraints[i]->set_name(name);
+		}
+		if (!ok)
+			std::cerr << "the names of the binary linear program are truncated: \'" << name << "\'" << std::endl;
+	}
+	else
+		name_ = details::base_name(name);
+
+	return true;
+}
+
+
+bool LinearProgram::save_pseudo_boolean(const std::string& file_name) const {
+	if (!is_pseudo_boolean()) {
+		std::cerr << "not a pseudo-Boolean program (0-1 variables, integral constraints): \'" << file_name << "\'" << std::endl;
+		return false;
+	}
+
+	std::ofstream output(file_name.c_str());
+	if (output.fail()) {
+		std::cerr << "could not create/open file to save:\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+
+	// the rows written: two for a double bounded constraint, one more for each fixed variable
+	std::size_t num_rows = 0;
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		switch (constraints_[i]->bound_type()) {
+		case LinearConstraint::FREE:	break;
+		case LinearConstraint::DOUBLE:	num_rows += 2; break;
+		default:						++num_rows; break;
+		}
+	}
+	for (std::size_t i = 0; i < variables_.size(); ++i) {
+		double lb, ub;
+		variables_[i]->get_bounds(lb, ub);
+		if (variables_[i]->variable_type() != Variable::BINARY && (lb > 0.0 || ub < 1.0))
+			++num_rows;
+	}
+
+	// the objective with (about) 9 significant digits of its largest coefficient, unless all are integral
+	const SparseRow obj_coeffs = objective_->coefficients();
+	double max_coeff = 0.0;
+	bool integral = true;
+	for (std::size_t k = 0; k < obj_coeffs.size(); ++k) {
+		max_coeff = std::max(max_coeff, std::abs(obj_coeffs.value(k)));
+		integral = integral && std::abs(obj_coeffs.value(k) - std::floor(obj_coeffs.value(k) + 0.5)) <= 1e-9;
+	}
+	double scale = 1.0;
+	if (!integral && max_coeff > 0.0)
+		scale = std::pow(10.0, std::floor(9.0 - std::log10(max_coeff)));
+	const double sign = (objective_->sense() == LinearObjective::MAXIMIZE) ? -1.0 : 1.0;
+
+	output << "* #variable= " << variables_.size() << " #constraint= " << num_rows << "\n";
+	output << "* " << (name_.empty() ? std::string("program") : name_) << ": the objective is " 
+		<< (sign < 0 ? "maximized, i.e., its negation minimized, " : "minimized, ") << "with its coefficients scaled by " << scale << "\n";
+	output << "min: ";
+	for (std::size_t k = 0; k < obj_coeffs.size(); ++k) {
+		const long long coeff = std::llround(sign * scale * obj_coeffs.value(k));
+		if (coeff != 0)
+			details::write_term(output, coeff, obj_coeffs.index(k));
+	}
+	output << ";\n";
+
+	for (std::size_t i = 0; i < constraints_.size(); ++i) {
+		const LinearConstraint* c = constraints_[i];
+		const SparseRow row = c->coefficients();
+		double lb, ub;
+		c->get_bounds(lb, ub);
+		switch (c->bound_type()) {
+		case LinearConstraint::FIXED:
+			details::write_pseudo_boolean_constraint(output, row, 1, "=", lb);
+			break;
+		case LinearConstraint::LOWER:
+			details::write_pseudo_boolean_constraint(output, row, 1, ">=", lb);
+			break;
+		case LinearConstraint::UPPER:
+			details::write_pseudo_boolean_constraint(output, row, -1, ">=", ub);
+			break;
+		case LinearConstraint::DOUBLE:
+			details::write_pseudo_boolean_constraint(output, row, 1, ">=", lb);
+			details::write_pseudo_boolean_constraint(output, row, -1, ">=", ub);
+			break;
+		default:
+			break;
+		}
+	}
+
+	// the integer variables fixed by their bounds (to 0 or 1)
+	for (std::size_t i = 0; i < variables_.size(); ++i) {
+		double lb, ub;
+		variables_[i]->get_bounds(lb, ub);
+		if (variables_[i]->variable_type() != Variable::BINARY && (lb > 0.0 || ub < 1.0)) {
+			details::write_term(output, 1, static_cast<int>(i));
+			output << "= " << (lb > 0.0 ? 1 : 0) << " ;\n";
+		}
+	}
+
+	return !output.fail();
 }
 
 
 bool LinearProgram::save(const std::string& file_name, bool simple_name /* = false*/) const {
+	if (details::extension(file_name) == "lpb")
+		return save_binary(file_name, !simple_name);
+	if (details::extension(file_name) == "opb")
+		return save_pseudo_boolean(file_name);
+
 	std::ofstream output(file_name.c_str());
 	if (output.fail()) {
 		std::cerr << "could not create/open file to save:\'" << file_name << "\'" << std::endl;
@@ -253,7 +613,9 @@ bool LinearProgram::load(const std::string& file_name) {
 	clear();
 
 	const std::string& ext = details::extension(file_name);
-	if (ext != "lp" && ext != "mps" && ext != "cip") {
+	if (ext == "lpb")
+		return load_binary(file_name);
+	if (ext != "lp" && ext != "mps" && ext != "cip" && ext != "opb") {
 		std::cerr << "unsupported format: \'" << ext << "\'" << std::endl;
 		return false;
 	}
@@ -19,11 +19,40 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 
 #include "linear_program_solver.h"
+#include "solution_cache.h"
+#include "solver_policy.h"
+#include "../basic/logger.h"
+#include "../basic/tracer.h"
+#include "../basic/thread_pool.h"
 
 #include <iostream>
 #include <cmath>
 
 
+namespace {
+
+	// the zone of a solve on the timeline (see Tracer)
+	const char* trace_zone_name(LinearProgramSolver::SolverName solver) {
+		switch (solver) {
+#ifdef HAS_GUROBI
+		case LinearProgramSolver::GUROBI:	return "solve GUROBI";
+#endif
+#ifdef HAS_HIGHS
+		case LinearProgramSolver::HIGHS:	return "solve HIGHS";
+#endif
+#ifdef HAS_ORTOOLS
+		case LinearProgramSolver::CPSAT:	return "solve CPSAT";
+#endif
+		case LinearProgramSolver::SCIP:		return "solve SCIP";
+		case LinearProgramSolver::GLPK:		return "solve GLPK";
+		case LinearProgramSolver::LPSOLVE:	return "solve LPSOLVE";
+		default:							return "solve PORTFOLIO";
+		}
+	}
+
+}
+
+
 bool LinearProgramSolver::check_program(const LinearProgram* program) const {
 	if (program->objective()->sense() == LinearObjective::UNDEFINED) {
 		std::cerr << "incomplete objective: undefined objective sense." << std::endl;
@@ -55,11 +84,70 @@ void LinearProgramSolver::upload_solution(const LinearProgram* program) {
 }
 
 
+bool LinearProgramSolver::has_initial_solution(const LinearProgram* program) const {
+	return has_initial_solution(program->num_variables());
+}
+
+
+bool LinearProgramSolver::has_initial_solution(std::size_t num_variables) const {
+	return !initial_solution_.empty() && initial_solution_.size() == num_variables;
+}
+
+
+bool LinearProgramSolver::has_variable_hints(std::size_t num_variables) const {
+	return !hints_.empty() && hints_.size() == num_variables && priorities_.size() == num_variables;
+}
+
+
 bool LinearProgramSolver::solve(const LinearProgram* program, SolverName solver) {
+	status_ = STATUS_FAILED;
+
+	// the solvers load the coefficients from the constraint matrix (nothing to do if it is up to date)
+	const_cast<LinearProgram*>(program)->finalize();
+
+	if (!cache_)
+		return solve_uncached(program, solver);
+
+	const std::string key = SolutionCache::key(*program);
+	if (cache_->lookup(key, result_, objective_value_) && result_.size() == program->num_variables()) {
+		if (verbose_)
+			Logger::out("-") << "solution found in the cache" << std::endl;
+		status_ = STATUS_OPTIMAL;
+		upload_solution(program);
+		return true;
+	}
+
+	bool solved = solve_uncached(program, solver);
+	if (solved && status_ == STATUS_OPTIMAL)
+		cache_->store(key, result_, objective_value_);
+	return solved;
+}
+
+
+bool LinearProgramSolver::solve_uncached(const LinearProgram* program, SolverName solver) {
+	if (solver == AUTO) {
+		solver = SolverPolicy::choose(*program, options_.num_threads);
+		if (verbose_)
+			Logger::out("-") << "solving with " << SolverPolicy::solver_name(solver) << " (chosen for " 
+				<< program->num_variables() << " variables)" << std::endl;
+	}
+	backend_ = solver;
+
+	TraceZone zone(trace_zone_name(solver), "solver");
+	// the threads of the solver (besides the calling one) are taken from the budget of the pool
+	ThreadReservation reservation(options_.num_threads > 1 ? options_.num_threads - 1 : 0);
 	switch (solver) {
 #ifdef HAS_GUROBI
 	case GUROBI:
         return _solve_GUROBI(program);
+#endif
+#ifdef HAS_HIGHS
+	case HIGHS:
+		return _solve_HIGHS(program);
+#endif
+#ifdef HAS_ORTOOLS
+	case CPSAT:
+		return _solve_CPSAT(program);
 #endif
 	case GLPK:
         return _solve_GLPK(program);
@@ -67,7 +155,42 @@ bool LinearProgramSolver::solve(const LinearProgram* program, SolverName solver)
         return _solve_LPSOLVE(program);
 	case SCIP:
         return _solve_SCIP(program);
+	case PORTFOLIO:
+		return _solve_PORTFOLIO(program);
+	default:
+		return false;
+	}
+}
+
+
+
+LinearProgramSolver::StreamingBuilder* LinearProgramSolver::create_builder(SolverName solver, const std::string& name /* = "" */) const {
+	switch (solver) {
+	case SCIP:
+	case AUTO:
+		return _create_SCIP_builder(name);
+	case GLPK:
+		return _create_GLPK_builder(name);
+	default:
+		return 0;
 	}
-    return false;
 }
 
+
+bool LinearProgramSolver::solve(StreamingBuilder* builder) {
+	status_ = STATUS_FAILED;
+	if (!builder)
+		return false;
+
+	backend_ = builder->solver();
+	TraceZone zone(trace_zone_name(builder->solver()), "solver");
+	ThreadReservation reservation(options_.num_threads > 1 ? options_.num_threads - 1 : 0);
+	switch (builder->solver()) {
+	case SCIP:
+		return _solve_SCIP(builder);
+	case GLPK:
+		return _solve_GLPK(builder);
+	default:
+		return false;
+	}
+}
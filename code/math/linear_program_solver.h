@@ -22,8 +22,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "math_common.h"
 #include "linear_program.h"
+#include "linear_program_builder.h"
 
 #include <vector>
+#include <functional>
+#include <atomic>
+
+
+class SolverSession;
+class SolutionCache;
 
 
 class MATH_API LinearProgramSolver
@@ -32,22 +39,154 @@ public:
 	enum SolverName { 
 #ifdef HAS_GUROBI	// Gurobi is commercial and requires license :-(
 		GUROBI,	
+#endif
+#ifdef HAS_HIGHS	// free (MIT), and faster than SCIP on the face selection problems
+		HIGHS,
+#endif
+#ifdef HAS_ORTOOLS	// the CP-SAT solver of OR-Tools (Apache 2.0), only for the pseudo-Boolean programs (see LinearProgram::is_pseudo_boolean())
+		CPSAT,
 #endif
 		SCIP,		// Recommended default value.
 		GLPK,
 		LPSOLVE,
+		PORTFOLIO,	// races several of the above (see set_portfolio()) and takes the first to finish
+		AUTO		// picks one of the above for each program, by its size and the threads (see SolverPolicy)
+	};
+
+	// the state of a branch-and-bound search (see SolverOptions::progress_callback)
+	struct SearchProgress {
+		SearchProgress() : nodes(0), has_incumbent(false), incumbent(0.0), has_bound(false), bound(0.0) {}
+
+		long long	nodes;			// explored so far
+		bool		has_incumbent;
+		double		incumbent;		// the objective value of the best solution found
+		bool		has_bound;
+		double		bound;			// the best bound of the objective value
+	};
+
+	// controls the search (the default options impose no limits)
+	struct SolverOptions {
+		SolverOptions() : time_limit(0.0), relative_gap(-1.0), num_threads(0), node_limit(0), store_names(false), deterministic(false), random_seed(0), interrupt(0) {}
+
+		double		 time_limit;	// in seconds (0 for no limit)
+		double		 relative_gap;	// stop if the gap between the incumbent and the bound is below it (negative for the default of each solver, i.e., 1e-4 for SCIP)
+		unsigned int num_threads;	// for GUROBI, HIGHS, CPSAT, and SCIP if built with a task processing interface (0 lets the solver decide)
+		long long	 node_limit;	// maximum number of branch-and-bound nodes (0 for no limit)
+
+		// Gives the names of the variables and the constraints to the solver, e.g., to read its messages 
+		// or to write its model. Setting a name costs time and memory for each of them.
+		bool		 store_names;
+
+		// Makes the result reproducible for a program regardless of the number of threads: SCIP runs its
+		// concurrent solve in the deterministic mode, and PORTFOLIO waits for all the racers and takes the
+		// first of the roster with a proven result (instead of the first to finish). Only a time limit
+		// remains timing-dependent (use a node limit instead).
+		bool		 deterministic;
+		unsigned int random_seed;	// for the randomized parts of SCIP, GUROBI, HIGHS, and CPSAT (GLPK and LPSOLVE don't randomize)
+
+		// If provided, the search stops as if a limit was hit once the flag becomes true (e.g., set from
+		// another thread, or by the progress callback). It is polled by the solver, so it may take a 
+		// moment to take effect.
+		const std::atomic<bool>* interrupt;
+
+		// Called regularly during the search of a MIP (after each node for SCIP and GLPK), e.g., to show 
+		// the progress and cancel the search by the interrupt flag. LPSOLVE reports no bound, and the
+		// racers of PORTFOLIO don't report anything (they run in other threads).
+		// NOTE: it is called from within the solver and must not throw.
+		std::function<void(const SearchProgress& progress)> progress_callback;
+
+		// Called with the objective value and the variable values of each improving solution found.
+		// NOTE: it is called from within the solver (which may run in a worker thread) and must not throw.
+		//       With SCIP running in several threads, only the solutions passed to the main instance are reported.
+		std::function<void(double objective, const std::vector<double>& x)> incumbent_callback;
+	};
+
+	enum Status {
+		STATUS_OPTIMAL,			// solved to optimality (within the relative gap)
+		STATUS_LIMIT_REACHED,	// a limit was hit, and the result is the best solution found so far
+		STATUS_INFEASIBLE,
+		STATUS_UNBOUNDED,
+		STATUS_FAILED			// no solution was found
+	};
+
+	// A builder that formulates the program directly in a solver backend, so the model exists only 
+	// once (instead of a LinearProgram and its copy in the solver). It is solved by solve(builder).
+	class MATH_API StreamingBuilder : public LinearProgramBuilder {
+	public:
+		virtual SolverName solver() const = 0;
 	};
 
 public:
-	LinearProgramSolver() {}
+	LinearProgramSolver() : verbose_(true), status_(STATUS_FAILED), backend_(SCIP), session_(0), cache_(0) {}
 	~LinearProgramSolver() {}
 
-	// Solves the problem and returns false if fails.
+	// Solves the problem and returns false if fails. If a limit of the options is hit, the best
+	// solution found is returned and status() is STATUS_LIMIT_REACHED.
 	// NOTE: The SCIP and CBC solvers are slower than Gurobi but acceptable. 
 	//       GLPK and LPSOLVE may be too slow or even fail for large problems.
 	//       If you have a really LARGE problem, you may consider using Gurobi.
     bool solve(const LinearProgram* program, SolverName solver);
 
+	// Returns a new builder for the solver (to be deleted by the caller), or null if the solver can't 
+	// be streamed into (only SCIP and GLPK can). AUTO streams into SCIP, as the size of the program 
+	// is not known yet.
+	StreamingBuilder* create_builder(SolverName solver, const std::string& name = "") const;
+
+	// Solves the program formulated by the builder (a builder can be solved once). The result is only
+	// available by solution() and objective_value().
+	bool solve(StreamingBuilder* builder);
+
+	// Provides a starting point for the next solve(), e.g., the solution of a previous run on
+	// the same variables and constraints. It is used as a MIP start by GUROBI, HIGHS, SCIP, and GLPK
+	// (and as a hint by CPSAT, LPSOLVE has no such facility), and ignored if its size differs from the
+	// number of variables.
+	void set_initial_solution(const std::vector<double>& x) { initial_solution_ = x; }
+	void clear_initial_solution() { initial_solution_.clear(); }
+
+	// Guides the branching of the next solve() with what is known of the variables beforehand (e.g.,
+	// how well the data support a face), one entry per variable: 'hints' gives the value a variable
+	// is likely to take (negative for no hint), and 'priorities' the order in which the variables are
+	// branched on (higher first, 0 is the default). Unlike an initial solution, the hints don't need
+	// to be feasible and may be partial. They are used by GUROBI (VarHintVal and BranchPriority), SCIP
+	// (the branching priorities and directions), LPSOLVE (the branching weights and modes), and CPSAT
+	// (as its solution hint, if no initial solution is provided), and ignored by HIGHS and GLPK, or if
+	// their size differs from the number of variables.
+	void set_variable_hints(const std::vector<double>& hints, const std::vector<int>& priorities) {
+		hints_ = hints; priorities_ = priorities;
+	}
+	void clear_variable_hints() { hints_.clear(); priorities_.clear(); }
+
+	// Turns the informative messages of solve() on/off (errors are always reported). Turn them
+	// off when the solver runs in a worker thread.
+	void set_verbose(bool b) { verbose_ = b; }
+
+	void set_options(const SolverOptions& options) { options_ = options; }
+	const SolverOptions& options() const { return options_; }
+
+	// Returns how the last solve() ended.
+	Status status() const { return status_; }
+
+	// Returns the backend of the last solve(), i.e., the one picked for AUTO (SCIP before any solve).
+	SolverName backend() const { return backend_; }
+
+	// The backends raced by PORTFOLIO, each in its own thread on a private copy of the program. The first
+	// one that proves optimality (or infeasibility) wins and the others are interrupted. Otherwise, the best
+	// solution is taken when all of them stopped, e.g., at the time limit of the options that they share.
+	// By default, all the available backends are raced. 
+	void set_portfolio(const std::vector<SolverName>& solvers) { portfolio_ = solvers; }
+	const std::vector<SolverName>& portfolio() const { return portfolio_; }
+
+	// Solves in the environment kept by "session" (see SolverSession), instead of setting up a new one
+	// for each solve. Null (the default) means no session.
+	void set_session(SolverSession* session) { session_ = session; }
+	SolverSession* session() const { return session_; }
+
+	// With a cache, solve() first looks the program up by its key (see SolutionCache::key()) and only
+	// solves it if it was not found, taking the stored solution as optimal. The optimal solutions found
+	// are stored. Null (the default) means no cache. Not used by solve(builder).
+	void set_cache(SolutionCache* cache) { cache_ = cache; }
+	SolutionCache* cache() const { return cache_; }
+
 	// Returns the result. 
 	// The result can also be retrieved using Variable::solution_value().
 	// NOTE: (1) result is valid only if the solver succeeded.
@@ -63,18 +202,79 @@ public:
 private:
 	bool check_program(const LinearProgram* program) const;
 	void upload_solution(const LinearProgram* program);
+	bool has_initial_solution(const LinearProgram* program) const;
+	bool has_initial_solution(std::size_t num_variables) const;
+	bool has_variable_hints(std::size_t num_variables) const;
+	bool solve_uncached(const LinearProgram* program, SolverName solver);
 
 private:
 #ifdef HAS_GUROBI
 	bool _solve_GUROBI(const LinearProgram* program);
+#endif
+#ifdef HAS_HIGHS
+	bool _solve_HIGHS(const LinearProgram* program);
+#endif
+#ifdef HAS_ORTOOLS
+	bool _solve_CPSAT(const LinearProgram* program);
 #endif
 	bool _solve_SCIP(const LinearProgram* program);
 	bool _solve_GLPK(const LinearProgram* program);
+
+	// the streaming builders (created by the _create_*_builder() of the same solver)
+	StreamingBuilder* _create_SCIP_builder(const std::string& name) const;
+	StreamingBuilder* _create_GLPK_builder(const std::string& name) const;
+	bool _solve_SCIP(StreamingBuilder* builder);
+	bool _solve_GLPK(StreamingBuilder* builder);
 	bool _solve_LPSOLVE(const LinearProgram* program);
+	bool _solve_PORTFOLIO(const LinearProgram* program);
 
 private:
 	std::vector<double> result_;
 	double				objective_value_;
+
+	std::vector<double> initial_solution_;
+	std::vector<double> hints_;			// negative: no hint
+	std::vector<int>	priorities_;
+	bool				verbose_;
+
+	SolverOptions		options_;
+	Status				status_;
+	SolverName			backend_;
+
+	std::vector<SolverName> portfolio_;
+	SolverSession*			session_;
+	SolutionCache*			cache_;
+};
+
+
+struct Scip;
+
+// Keeps the environment of a solver across the solves of many programs (e.g., the small components of
+// a batch of tiles), which saves setting it up for each of them. Only SCIP has an environment worth 
+// keeping (its plugins): GLPK has none, and GUROBI already shares a single one. A session can be used 
+// by only one solver at a time.
+class MATH_API SolverSession
+{
+public:
+	SolverSession() : scip_(0), problem_(0), reoptimization_(false) {}
+	~SolverSession();
+
+	// With reoptimization (off by default), SCIP keeps the problem after its solve. A next program with
+	// as many variables and constraints is taken as the same one with another objective (e.g., new 
+	// weights), and solved by reusing the search of the previous runs. 
+	// NOTE: only the numbers of variables and constraints are checked. Changing this clears the session.
+	void set_reoptimization(bool b);
+	bool reoptimization() const { return reoptimization_; }
+
+	// frees the environment (the next solve sets up a new one)
+	void clear();
+
+private:
+	friend class LinearProgramSolver;
+
+	Scip*									scip_;
+	LinearProgramSolver::StreamingBuilder*	problem_;	// the problem kept for reoptimization
+	bool									reoptimization_;
 };
 
 #endif
@@ -0,0 +1,256 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "linear_program_solver.h"
+#include "../basic/logger.h"
+
+
+#ifdef HAS_ORTOOLS
+
+#include <ortools/sat/cp_model.pb.h>
+#include <ortools/sat/cp_model_checker.h>
+#include <ortools/sat/cp_model_solver.h>
+#include <ortools/sat/sat_parameters.pb.h>
+#include <ortools/sat/model.h>
+#include <ortools/util/time_limit.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+
+	// the bound of a constraint in the domain of CP-SAT (the int64 extremes stand for the infinities)
+	inline int64_t cp_sat_bound(double value) {
+		if (value <= -Variable::infinity())
+			return std::numeric_limits<int64_t>::min();
+		if (value >= Variable::infinity())
+			return std::numeric_limits<int64_t>::max();
+		return static_cast<int64_t>(std::llround(value));
+	}
+
+	// the value of the objective for a solution of CP-SAT (computed from the real coefficients)
+	double cp_sat_objective(const SparseRow& obj_coeffs, const operations_research::sat::CpSolverResponse& response, std::vector<double>& x) {
+		x.resize(response.solution_size());
+		for (int i = 0; i < response.solution_size(); ++i)
+			x[i] = static_cast<double>(response.solution(i));
+		double value = 0.0;
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			value += obj_coeffs.value(k) * x[obj_coeffs.index(k)];
+		return value;
+	}
+
+}
+
+
+bool LinearProgramSolver::_solve_CPSAT(const LinearProgram* program) {
+	using namespace operations_research::sat;
+
+	try {
+		if (!check_program(program))
+			return false;
+		// CP-SAT only takes integral constraints (the objective may have real coefficients)
+		if (!program->is_pseudo_boolean()) {
+			Logger::err("-") << "CP-SAT only solves the pseudo-Boolean programs (0-1 variables, integral constraints)" << std::endl;
+			return false;
+		}
+
+		const std::vector<Variable*>& variables = program->variables();
+		const std::vector<LinearConstraint*>& constraints = program->constraints();
+		const SparseMatrix& matrix = program->constraint_matrix();
+
+		CpModelProto model;
+		if (options_.store_names)
+			model.set_name(program->name());
+
+		// the variables (all 0-1)
+		for (std::size_t i = 0; i < variables.size(); ++i) {
+			const Variable* var = variables[i];
+			double lb = 0.0, ub = 1.0;
+			if (var->variable_type() != Variable::BINARY) {
+				var->get_bounds(lb, ub);
+				lb = std::ceil(lb);
+				ub = std::floor(ub);
+			}
+			IntegerVariableProto* v = model.add_variables();
+			v->add_domain(static_cast<int64_t>(lb));
+			v->add_domain(static_cast<int64_t>(ub));
+			if (options_.store_names)
+				v->set_name(var->has_name() ? var->name() : "x" + std::to_string(i));
+		}
+
+		// The constraints, from the rows of the matrix. CP-SAT has no lazy constraints, so they are usual constraints.
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const LinearConstraint* c = constraints[i];
+			if (c->bound_type() == LinearConstraint::FREE)
+				continue;
+
+			double lb = -Variable::infinity(), ub = Variable::infinity();
+			switch (c->bound_type())
+			{
+			case LinearConstraint::FIXED:
+				lb = ub = c->get_bound();
+				break;
+			case LinearConstraint::LOWER:
+				lb = c->get_bound();
+				break;
+			case LinearConstraint::UPPER:
+				ub = c->get_bound();
+				break;
+			default:
+				c->get_bounds(lb, ub);
+				break;
+			}
+
+			ConstraintProto* constraint = model.add_constraints();
+			if (options_.store_names)
+				constraint->set_name(c->has_name() ? c->name() : "c" + std::to_string(i));
+			LinearConstraintProto* linear = constraint->mutable_linear();
+			const SparseRow row = matrix.row(i);
+			for (std::size_t k = 0; k < row.size(); ++k) {
+				linear->add_vars(row.index(k));
+				linear->add_coeffs(static_cast<int64_t>(std::llround(row.value(k))));
+			}
+			linear->add_domain(cp_sat_bound(lb));
+			linear->add_domain(cp_sat_bound(ub));
+		}
+
+		// the objective, with its real coefficients (CP-SAT scales them to integers itself)
+		const LinearObjective* objective = program->objective();
+		const SparseRow obj_coeffs = objective->coefficients();
+		FloatObjectiveProto* float_objective = model.mutable_floating_point_objective();
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k) {
+			float_objective->add_vars(obj_coeffs.index(k));
+			float_objective->add_coeffs(obj_coeffs.value(k));
+		}
+		float_objective->set_maximize(objective->sense() == LinearObjective::MAXIMIZE);
+
+		// the starting point (if provided) is used as a hint
+		if (has_initial_solution(program)) {
+			PartialVariableAssignment* hint = model.mutable_solution_hint();
+			for (std::size_t i = 0; i < initial_solution_.size(); ++i) {
+				hint->add_vars(static_cast<int>(i));
+				hint->add_values(static_cast<int64_t>(std::llround(initial_solution_[i])));
+			}
+		}
+		// otherwise, the variable hints (if provided) make a partial one
+		else if (has_variable_hints(program->num_variables())) {
+			PartialVariableAssignment* hint = model.mutable_solution_hint();
+			for (std::size_t i = 0; i < hints_.size(); ++i) {
+				if (hints_[i] < 0.0)
+					continue;
+				hint->add_vars(static_cast<int>(i));
+				hint->add_values(static_cast<int64_t>(std::llround(hints_[i])));
+			}
+		}
+
+		// search control
+		SatParameters parameters;
+		parameters.set_log_search_progress(false);
+		if (options_.time_limit > 0.0)
+			parameters.set_max_time_in_seconds(options_.time_limit);
+		if (options_.relative_gap >= 0.0)
+			parameters.set_relative_gap_limit(options_.relative_gap);
+		if (options_.num_threads > 0)
+			parameters.set_num_workers(static_cast<int>(options_.num_threads));
+		parameters.set_random_seed(static_cast<int>(options_.random_seed));
+		// the workers are interleaved in a deterministic order instead of running concurrently
+		if (options_.deterministic)
+			parameters.set_interleave_search(true);
+		// CP-SAT has no branch-and-bound nodes, the node limit is taken as a limit of the conflicts
+		if (options_.node_limit > 0)
+			parameters.set_max_number_of_conflicts(options_.node_limit);
+
+		Model environment;
+		environment.Add(NewSatParameters(parameters));
+		// NOTE: CP-SAT only reads the flag, but takes it as modifiable
+		if (options_.interrupt)
+			environment.GetOrCreate<operations_research::TimeLimit>()->RegisterExternalBooleanAsLimit(const_cast<std::atomic<bool>*>(options_.interrupt));
+
+		// CP-SAT reports the improving solutions only, so the progress is reported with them
+		if (options_.incumbent_callback || options_.progress_callback) {
+			environment.Add(NewFeasibleSolutionObserver([this, &obj_coeffs](const CpSolverResponse& response) {
+				std::vector<double> x;
+				const double value = cp_sat_objective(obj_coeffs, response, x);
+				if (options_.progress_callback) {
+					SearchProgress progress;
+					progress.nodes = response.num_branches();
+					progress.has_incumbent = true;
+					progress.incumbent = value;
+					progress.has_bound = true;
+					progress.bound = response.best_objective_bound();
+					options_.progress_callback(progress);
+				}
+				if (options_.incumbent_callback)
+					options_.incumbent_callback(value, x);
+			}));
+		}
+
+		// Optimize model
+		if (verbose_)
+			Logger::out("-") << "using the CP-SAT solver (OR-Tools)." << std::endl;
+		const CpSolverResponse response = SolveCpModel(model, &environment);
+
+		// the best solution found (also available if the search was stopped by a limit)
+		bool has_solution = (response.status() == CpSolverStatus::OPTIMAL || response.status() == CpSolverStatus::FEASIBLE);
+		if (has_solution) {
+			objective_value_ = cp_sat_objective(obj_coeffs, response, result_);
+			upload_solution(program);
+			status_ = STATUS_LIMIT_REACHED;
+		}
+
+		switch (response.status()) {
+		case CpSolverStatus::OPTIMAL:
+			status_ = STATUS_OPTIMAL;
+			break;
+
+		case CpSolverStatus::FEASIBLE:
+		case CpSolverStatus::UNKNOWN:
+			if (verbose_ || !has_solution)
+				std::cerr << "optimization was stopped by a limit (status = " << CpSolverStatus_Name(response.status()) << ")" << std::endl;
+			break;
+
+		case CpSolverStatus::INFEASIBLE:
+			std::cerr << "model is infeasible" << std::endl;
+			status_ = STATUS_INFEASIBLE;
+			break;
+
+		case CpSolverStatus::MODEL_INVALID:
+			Logger::err("-") << "CP-SAT rejected the model: " << ValidateCpModel(model) << std::endl;
+			break;
+
+		default:
+			std::cerr << "optimization was stopped with status = " << CpSolverStatus_Name(response.status()) << std::endl;
+			break;
+		}
+
+		return has_solution;
+	}
+	catch (const std::exception& e) {
+		Logger::err("-") << "CP-SAT: " << e.what() << std::endl;
+	}
+	catch (...) {
+		std::cerr << "Exception during optimization" << std::endl;
+	}
+
+	return false;
+}
+
+#endif
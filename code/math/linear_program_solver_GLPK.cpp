@@ -23,124 +23,310 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../3rd_glpk/glpk.h"
 
 #include <iostream>
+#include <algorithm>
+#include <climits>
+
+
+namespace {
+
+	// the state shared with the callback of the branch-and-cut search
+	struct GLPKSearch {
+		const std::vector<double>* start;	// the starting point (if provided)
+		bool start_submitted;
+		long long node_limit;
+		const std::atomic<bool>* interrupt;
+		const std::function<void(double, const std::vector<double>&)>* incumbent_callback;
+		bool has_reported;
+		double reported_objective;
+		const std::function<void(const LinearProgramSolver::SearchProgress&)>* progress_callback;
+	};
+
+	// Reports the incumbent if it has changed. It is checked in every call of the callback, because the
+	// solutions found by the heuristics (including the starting point) don't raise GLP_IBINGO.
+	void glpk_report_incumbent(glp_tree* tree, GLPKSearch* search) {
+		glp_prob* prob = glp_ios_get_prob(tree);
+		int mip_status = glp_mip_status(prob);
+		if (mip_status != GLP_FEAS && mip_status != GLP_OPT)
+			return;
+		double objective = glp_mip_obj_val(prob);
+		if (search->has_reported && objective == search->reported_objective)
+			return;
+		search->has_reported = true;
+		search->reported_objective = objective;
+
+		std::vector<double> x(glp_get_num_cols(prob));
+		for (std::size_t i = 0; i < x.size(); ++i)
+			x[i] = glp_mip_col_val(prob, static_cast<int>(i) + 1);	// glpk uses 1-based arrays
+		(*search->incumbent_callback)(objective, x);
+	}
 
+	// reports the nodes, the incumbent, and the best bound of the active nodes
+	void glpk_report_progress(glp_tree* tree, GLPKSearch* search) {
+		glp_prob* prob = glp_ios_get_prob(tree);
+		int num_active = 0, num_nodes = 0, num_total = 0;
+		glp_ios_tree_size(tree, &num_active, &num_nodes, &num_total);
+
+		LinearProgramSolver::SearchProgress progress;
+		progress.nodes = num_total;
+		int mip_status = glp_mip_status(prob);
+		progress.has_incumbent = (mip_status == GLP_FEAS || mip_status == GLP_OPT);
+		if (progress.has_incumbent)
+			progress.incumbent = glp_mip_obj_val(prob);
+		int best = glp_ios_best_node(tree);
+		progress.has_bound = (best != 0);
+		if (progress.has_bound)
+			progress.bound = glp_ios_node_bound(tree, best);
+		(*search->progress_callback)(progress);
+	}
 
-bool LinearProgramSolver::_solve_GLPK(const LinearProgram* program) {
-	try {
-		if (!check_program(program))
-			return false;
+	void glpk_search_callback(glp_tree* tree, void* info) {
+		GLPKSearch* search = static_cast<GLPKSearch*>(info);
+		if (search->incumbent_callback)
+			glpk_report_incumbent(tree, search);
+		if (search->interrupt && search->interrupt->load()) {
+			glp_ios_terminate(tree);
+			return;
+		}
 
-		glp_prob* lp = glp_create_prob();
-		if (!lp) {
-			std::cerr << "error in creating a LP model" << std::endl;
-			return false;
+		switch (glp_ios_reason(tree)) {
+		case GLP_IHEUR: { // supplies the starting point as a heuristic solution
+			if (!search->start || search->start_submitted)
+				return;
+			search->start_submitted = true;
+
+			std::vector<double> x(search->start->size() + 1, 0.0);	// glpk uses 1-based arrays
+			std::copy(search->start->begin(), search->start->end(), x.begin() + 1);
+			if (glp_ios_heur_sol(tree, x.data()) != 0)
+				Logger::warn("-") << "the initial solution was rejected by GLPK" << std::endl;
+			break;
+		}
+		case GLP_ISELECT: {
+			if (search->progress_callback)
+				glpk_report_progress(tree, search);
+			if (search->node_limit <= 0)
+				return;
+			int num_active = 0, num_nodes = 0, num_total = 0;
+			glp_ios_tree_size(tree, &num_active, &num_nodes, &num_total);
+			if (num_total >= search->node_limit)
+				glp_ios_terminate(tree);
+			break;
+		}
+		default:
+			break;
 		}
-		glp_set_prob_name(lp, program->name().c_str());
+	}
+
+}
+
+
+namespace {
 
-		std::size_t num_integer_variables = 0;
+	int glpk_bound_type(Bound::BoundType bt) {
+		switch (bt) {
+		case Bound::FIXED:  return GLP_FX;
+		case Bound::LOWER:  return GLP_LO;
+		case Bound::UPPER:  return GLP_UP;
+		case Bound::DOUBLE: return GLP_DB;
+		case Bound::FREE:
+		default:
+			return GLP_FR;
+		}
+	}
 
-		// create variables
-		const std::vector<Variable*>& variables = program->variables();
-		glp_add_cols(lp, variables.size());
-		for (std::size_t i = 0; i < variables.size(); ++i) {
-			const Variable* var = variables[i];
-			glp_set_col_name(lp, i + 1, var->name().c_str());
 
-			if (var->variable_type() == Variable::INTEGER) {
-				glp_set_col_kind(lp, i + 1, GLP_IV);	// glpk uses 1-based arrays
-				++num_integer_variables;
+	// Formulates the program directly in GLPK.
+	class GLPKProgramBuilder : public LinearProgramSolver::StreamingBuilder {
+	public:
+		GLPKProgramBuilder(const std::string& name) : lp_(glp_create_prob()), num_integer_variables_(0), num_constraints_(0) {
+			if (lp_)
+				glp_set_prob_name(lp_, name.c_str());
+		}
+		~GLPKProgramBuilder() {
+			if (lp_)
+				glp_delete_prob(lp_);
+		}
+
+		LinearProgramSolver::SolverName solver() const { return LinearProgramSolver::GLPK; }
+
+		std::size_t add_variables(std::size_t n, Variable::VariableType vt, Variable::BoundType bt, double lb, double ub) {
+			std::size_t first = num_variables();
+			if (n == 0)	// glpk doesn't accept adding 0 columns
+				return first;
+			glp_add_cols(lp_, static_cast<int>(n));
+			for (std::size_t i = 0; i < n; ++i) {
+				int col = static_cast<int>(first + i) + 1;	// glpk uses 1-based arrays
+				if (store_names())
+					glp_set_col_name(lp_, col, ("x" + std::to_string(first + i)).c_str());
+				set_column(col, vt, bt, lb, ub);
+			}
+			return first;
+		}
+
+		// GLPK has no lazy constraints, so all are added to the program
+		void add_constraint(LinearConstraint::BoundType bt, double lb, double ub, const std::vector<int>& var_indices, const std::vector<double>& coeffs, bool /* lazy */) {
+			int row = glp_add_rows(lp_, 1);
+			indices_.resize(var_indices.size() + 1);	// glpk uses 1-based arrays
+			values_.resize(coeffs.size() + 1);			// glpk uses 1-based arrays
+			for (std::size_t k = 0; k < var_indices.size(); ++k) {
+				indices_[k + 1] = var_indices[k] + 1;
+				values_[k + 1] = coeffs[k];
 			}
-			else if (var->variable_type() == Variable::BINARY) {
-				glp_set_col_kind(lp, i + 1, GLP_BV);	// glpk uses 1-based arrays
-				++num_integer_variables;
+			glp_set_mat_row(lp_, row, static_cast<int>(var_indices.size()), indices_.data(), values_.data());
+			glp_set_row_bnds(lp_, row, glpk_bound_type(bt), lb, ub);
+			if (store_names())
+				glp_set_row_name(lp_, row, ("c" + std::to_string(num_constraints_)).c_str());
+			++num_constraints_;
+		}
+
+		// Loads the whole program. The columns and the rows are added at once, and the constraint matrix is
+		// loaded at once (in the triplet form that glpk expects) instead of row by row. The names of the 
+		// program are only given if store_names() is on.
+		void load_program(const LinearProgram& program) {
+			const std::vector<Variable*>& variables = program.variables();
+			if (!variables.empty())	// glpk doesn't accept adding 0 columns
+				glp_add_cols(lp_, static_cast<int>(variables.size()));
+			for (std::size_t i = 0; i < variables.size(); ++i) {
+				const Variable* var = variables[i];
+				double lb, ub;
+				var->get_bounds(lb, ub);
+				set_column(static_cast<int>(i) + 1, var->variable_type(), var->bound_type(), lb, ub);
+				if (store_names())
+					glp_set_col_name(lp_, static_cast<int>(i) + 1, var->name().c_str());
 			}
-			else {
-				glp_set_col_kind(lp, i + 1, GLP_CV);	// continuous variable
+
+			const std::vector<LinearConstraint*>& constraints = program.constraints();
+			if (!constraints.empty())	// glpk doesn't accept adding 0 rows
+				glp_add_rows(lp_, static_cast<int>(constraints.size()));
+			num_constraints_ = constraints.size();
+
+			const SparseMatrix& matrix = program.constraint_matrix();
+			if (matrix.num_nonzeros() > 0) {
+				std::vector<int>	rows(matrix.num_nonzeros() + 1, 0);		// glpk uses 1-based arrays
+				std::vector<int>	columns(matrix.num_nonzeros() + 1, 0);	// glpk uses 1-based arrays
+				std::vector<double> values(matrix.num_nonzeros() + 1, 0.0);	// glpk uses 1-based arrays
+				for (std::size_t i = 0; i < matrix.num_rows(); ++i) {
+					for (std::size_t k = matrix.row_start[i]; k < matrix.row_start[i + 1]; ++k) {
+						rows[k + 1] = static_cast<int>(i) + 1;
+						columns[k + 1] = matrix.columns[k] + 1;
+					}
+				}
+				std::copy(matrix.values.begin(), matrix.values.end(), values.begin() + 1);
+				glp_load_matrix(lp_, static_cast<int>(matrix.num_nonzeros()), rows.data(), columns.data(), values.data());
 			}
 
-			int bound_type = GLP_FR;
-			switch (var->bound_type())
-			{
-			case Variable::FIXED:  bound_type = GLP_FX; break;
-			case Variable::LOWER:  bound_type = GLP_LO; break;
-			case Variable::UPPER:  bound_type = GLP_UP; break;
-			case Variable::DOUBLE: bound_type = GLP_DB; break;
-			case Variable::FREE:
-			default:
-				break;
+			for (std::size_t i = 0; i < constraints.size(); ++i) {
+				const LinearConstraint* c = constraints[i];
+				double lb, ub;
+				c->get_bounds(lb, ub);
+				glp_set_row_bnds(lp_, static_cast<int>(i) + 1, glpk_bound_type(c->bound_type()), lb, ub);
+				if (store_names())
+					glp_set_row_name(lp_, static_cast<int>(i) + 1, c->name().c_str());
 			}
 
-			double lb, ub;
-			var->get_bounds(lb, ub);
-			glp_set_col_bnds(lp, i + 1, bound_type, lb, ub);
+			// determine the coefficient of each variable in the objective function
+			const LinearObjective* objective = program.objective();
+			set_objective_sense(objective->sense());
+			const SparseRow obj_coeffs = objective->coefficients();
+			for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+				glp_set_obj_coef(lp_, obj_coeffs.index(k) + 1, obj_coeffs.value(k)); // glpk uses 1-based arrays
 		}
 
-		// Add constraints
+		void set_objective_sense(LinearObjective::Sense sense) {
+			glp_set_obj_dir(lp_, sense == LinearObjective::MAXIMIZE ? GLP_MAX : GLP_MIN);
+		}
 
-		const std::vector<LinearConstraint*>& constraints = program->constraints();
-		glp_add_rows(lp, constraints.size());
+		void add_objective_coefficient(int var_index, double coeff) {
+			int col = var_index + 1;	// glpk uses 1-based arrays
+			glp_set_obj_coef(lp_, col, glp_get_obj_coef(lp_, col) + coeff);
+		}
 
-		for (std::size_t i = 0; i < constraints.size(); ++i) {
-			const LinearConstraint* c = constraints[i];
-			const std::unordered_map<int, double>& coeffs = c->coefficients();
-			std::unordered_map<int, double>::const_iterator cur = coeffs.begin();
+		std::size_t num_variables() const { return static_cast<std::size_t>(glp_get_num_cols(lp_)); }
+		std::size_t num_constraints() const { return num_constraints_; }
 
-			std::vector<int>	indices(coeffs.size() + 1, 0);		// glpk uses 1-based arrays
-			std::vector<double> coefficients(coeffs.size() + 1, 0.0);  // glpk uses 1-based arrays
-			std::size_t idx = 1; // glpk uses 1-based arrays
-			for (; cur != coeffs.end(); ++cur) {
-				std::size_t var_idx = cur->first;
-				double coeff = cur->second;
+		glp_prob* lp() { return lp_; }
+		std::size_t num_integer_variables() const { return num_integer_variables_; }
 
-				indices[idx] = var_idx + 1;	 // glpk uses 1-based arrays
-				coefficients[idx] = coeff;
-				++idx;
+	private:
+		// sets the kind and the bounds of an added column
+		void set_column(int col, Variable::VariableType vt, Variable::BoundType bt, double lb, double ub) {
+			if (vt == Variable::INTEGER) {
+				glp_set_col_kind(lp_, col, GLP_IV);
+				++num_integer_variables_;
 			}
-
-			glp_set_mat_row(lp, i + 1, static_cast<int>(coeffs.size()), indices.data(), coefficients.data());
-
-			int bound_type = GLP_FR;
-			switch (c->bound_type())
-			{
-			case LinearConstraint::FIXED:  bound_type = GLP_FX; break;
-			case LinearConstraint::LOWER:  bound_type = GLP_LO; break;
-			case LinearConstraint::UPPER:  bound_type = GLP_UP; break;
-			case LinearConstraint::DOUBLE: bound_type = GLP_DB; break;
-			case LinearConstraint::FREE:
-			default:
-				break;
+			else if (vt == Variable::BINARY) {
+				glp_set_col_kind(lp_, col, GLP_BV);	// also sets the bounds [0, 1]
+				++num_integer_variables_;
+				return;
 			}
+			// a new column is continuous already
 
-			double lb, ub;
-			c->get_bounds(lb, ub);
-			glp_set_row_bnds(lp, i + 1, bound_type, lb, ub);
-
-			glp_set_row_name(lp, i + 1, c->name().c_str());
+			glp_set_col_bnds(lp_, col, glpk_bound_type(bt), lb, ub);
 		}
 
-		// set objective 
+	private:
+		glp_prob*			lp_;
+		std::size_t			num_integer_variables_;
+		std::size_t			num_constraints_;
+		std::vector<int>	indices_;	// the buffers of a row
+		std::vector<double>	values_;
+	};
+
+}
 
-		// determine the coefficient of each variable in the objective function
-		const LinearObjective* objective = program->objective();
-		const std::unordered_map<int, double>& obj_coeffs = objective->coefficients();
-		std::unordered_map<int, double>::const_iterator cur = obj_coeffs.begin();
-		for (; cur != obj_coeffs.end(); ++cur) {
-			std::size_t var_idx = cur->first;
-			double coeff = cur->second;
-			glp_set_obj_coef(lp, var_idx + 1, coeff); // glpk uses 1-based arrays
+
+LinearProgramSolver::StreamingBuilder* LinearProgramSolver::_create_GLPK_builder(const std::string& name) const {
+	GLPKProgramBuilder* builder = new GLPKProgramBuilder(name);
+	if (!builder->lp()) {
+		std::cerr << "error in creating a LP model" << std::endl;
+		delete builder;
+		return 0;
+	}
+	return builder;
+}
+
+
+bool LinearProgramSolver::_solve_GLPK(const LinearProgram* program) {
+	if (!check_program(program))
+		return false;
+
+	GLPKProgramBuilder* builder = static_cast<GLPKProgramBuilder*>(_create_GLPK_builder(program->name()));
+	if (!builder)
+		return false;
+	builder->set_store_names(options_.store_names);
+	builder->load_program(*program);
+	bool status = _solve_GLPK(builder);
+	delete builder;
+
+	if (status)
+		upload_solution(program);
+	return status;
+}
+
+
+bool LinearProgramSolver::_solve_GLPK(StreamingBuilder* streaming_builder) {
+	try {
+		GLPKProgramBuilder* builder = static_cast<GLPKProgramBuilder*>(streaming_builder);
+		glp_prob* lp = builder->lp();
+		const std::size_t num_variables = builder->num_variables();
+		const std::size_t num_integer_variables = builder->num_integer_variables();
+		if (num_variables == 0) {
+			std::cerr << "variable set is empty" << std::endl;
+			return false;
 		}
 
-		Logger::out("-") << "using the GLPK solver" << std::endl;
+		if (verbose_)
+			Logger::out("-") << "using the GLPK solver" << std::endl;
 
-		// Set objective function sense
-		bool minimize = (objective->sense() == LinearObjective::MINIMIZE);
-		glp_set_obj_dir(lp, minimize ? GLP_MIN : GLP_MAX);
 		int msg_level = GLP_MSG_ERR;
 		int status = -1;
+		int time_limit = INT_MAX;	// in milliseconds
+		if (options_.time_limit > 0.0 && options_.time_limit * 1000.0 < INT_MAX)
+			time_limit = static_cast<int>(options_.time_limit * 1000.0);
 		if (num_integer_variables == 0) { // continuous problem
 			glp_smcp parm;
 			glp_init_smcp(&parm);
 			parm.msg_lev = msg_level;
+			parm.tm_lim = time_limit;
 			status = glp_simplex(lp, &parm);
 		}
 		else { // solve as MIP problem
@@ -148,28 +334,77 @@ bool LinearProgramSolver::_solve_GLPK(const LinearProgram* program) {
 			glp_init_iocp(&parm);
 			parm.msg_lev = msg_level;
 			parm.presolve = GLP_ON;
+			parm.tm_lim = time_limit;
+			if (options_.relative_gap >= 0.0)
+				parm.mip_gap = options_.relative_gap;
+
+			GLPKSearch search = { 0, false, options_.node_limit, options_.interrupt, 0, false, 0.0, 0 };
+			if (options_.progress_callback)
+				search.progress_callback = &options_.progress_callback;
+			if (options_.node_limit > 0 || options_.interrupt || options_.progress_callback) {
+				parm.cb_func = glpk_search_callback;
+				parm.cb_info = &search;
+			}
+			bool with_start = has_initial_solution(num_variables);
+			if (with_start || options_.incumbent_callback) {
+				// The starting point and the improving solutions are exchanged in the callback, which sees the 
+				// original problem only if the presolver is off. In that case the LP relaxation has to be solved 
+				// beforehand.
+				glp_smcp lp_parm;
+				glp_init_smcp(&lp_parm);
+				lp_parm.msg_lev = msg_level;
+				if (glp_simplex(lp, &lp_parm) == 0) {
+					parm.presolve = GLP_OFF;
+					parm.cb_func = glpk_search_callback;
+					parm.cb_info = &search;
+					if (with_start)
+						search.start = &initial_solution_;
+					if (options_.incumbent_callback)
+						search.incumbent_callback = &options_.incumbent_callback;
+				}
+			}
 			// The routine glp_intopt is a driver to the MIP solver based on the branch-and-cut method,
 			// which is a hybrid of branch-and-bound and cutting plane methods.
 			status = glp_intopt(lp, &parm);	
 		}
 
+		// the best integer solution (also available if the search was stopped by a limit)
+		auto extract_mip_solution = [&]() -> bool {
+			int mip_status = glp_mip_status(lp);
+			if (mip_status != GLP_OPT && mip_status != GLP_FEAS)
+				return false;
+			objective_value_ = glp_mip_obj_val(lp);
+			result_.resize(num_variables);
+			for (std::size_t i = 0; i < num_variables; ++i) {
+				result_[i] = glp_mip_col_val(lp, i + 1);	 // glpk uses 1-based arrays
+			}
+			return true;
+		};
+
+		bool has_solution = false;
 		switch (status) {
 		case 0: {
 			if (num_integer_variables == 0) { // continuous problem
 				objective_value_ = glp_get_obj_val(lp);
-				result_.resize(variables.size());
-				for (std::size_t i = 0; i < variables.size(); ++i) {
+				result_.resize(num_variables);
+				for (std::size_t i = 0; i < num_variables; ++i) {
 					result_[i] = glp_get_col_prim(lp, i + 1);	 // glpk uses 1-based arrays
 				}
+				has_solution = true;
+				status_ = STATUS_OPTIMAL;
 			}
 			else { // MIP problem
-				objective_value_ = glp_mip_obj_val(lp);
-				result_.resize(variables.size());
-				for (std::size_t i = 0; i < variables.size(); ++i) {
-					result_[i] = glp_mip_col_val(lp, i + 1);	 // glpk uses 1-based arrays
+				int mip_status = glp_mip_status(lp);
+				has_solution = extract_mip_solution();
+				if (mip_status == GLP_OPT)
+					status_ = STATUS_OPTIMAL;
+				else if (mip_status == GLP_FEAS)
+					status_ = STATUS_LIMIT_REACHED;
+				else if (mip_status == GLP_NOFEAS) {
+					std::cerr << "model is infeasible" << std::endl;
+					status_ = STATUS_INFEASIBLE;
 				}
 			}
-			upload_solution(program);
 			break;
 		}
 
@@ -207,16 +442,27 @@ bool LinearProgramSolver::_solve_GLPK(const LinearProgram* program) {
 		case GLP_EMIPGAP:
 			std::cerr << 
 				"The search was prematurely terminated, because the relative mip gap tolerance has been reached." << std::endl;
+			has_solution = extract_mip_solution();
+			if (has_solution)
+				status_ = STATUS_OPTIMAL;	// within the gap
 			break;
 
 		case GLP_ETMLIM:
 			std::cerr << "The search was prematurely terminated, because the time limit has been exceeded." << std::endl;
+			if (num_integer_variables > 0)
+				has_solution = extract_mip_solution();
+			if (has_solution)
+				status_ = STATUS_LIMIT_REACHED;
 			break;
 
 		case GLP_ESTOP:
-			std::cerr << 
-				"The search was prematurely terminated by application. (This code may appear only"
-				"if the advanced solver interface is used.)" << std::endl;
+			if (verbose_)
+				std::cerr << 
+					"The search was prematurely terminated by application. (This code may appear only"
+					"if the advanced solver interface is used.)" << std::endl;
+			has_solution = extract_mip_solution();	// e.g., the node limit has been reached or interrupted
+			if (has_solution)
+				status_ = STATUS_LIMIT_REACHED;
 			break;
 
 		default:
@@ -224,9 +470,8 @@ bool LinearProgramSolver::_solve_GLPK(const LinearProgram* program) {
 			break;
 		}
 
-		glp_delete_prob(lp);
-
-		return (status == 0);
+		// the problem is deleted with the builder
+		return has_solution;
 	}
 	catch (std::exception e) {
 		std::cerr << "Error code = " << e.what() << std::endl;
@@ -25,6 +25,54 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifdef HAS_GUROBI
 
 #include <gurobi_c++.h>
+#include <cmath>
+
+
+namespace {
+
+	// reports the improving solutions and stops the search on interrupt
+	class GurobiSearchCallback : public GRBCallback {
+	public:
+		GurobiSearchCallback(
+			const std::vector<GRBVar>& X, 
+			const std::function<void(double, const std::vector<double>&)>& report, 
+			const std::atomic<bool>* interrupt,
+			const std::function<void(const LinearProgramSolver::SearchProgress&)>& progress
+		)
+			: X_(X), report_(report), interrupt_(interrupt), progress_(progress) {}
+
+	protected:
+		void callback() {
+			if (interrupt_ && interrupt_->load()) {
+				abort();
+				return;
+			}
+			if (where == GRB_CB_MIP && progress_) {
+				LinearProgramSolver::SearchProgress progress;
+				progress.nodes = static_cast<long long>(getDoubleInfo(GRB_CB_MIP_NODCNT));
+				progress.incumbent = getDoubleInfo(GRB_CB_MIP_OBJBST);
+				progress.has_incumbent = (std::abs(progress.incumbent) < GRB_INFINITY);
+				progress.bound = getDoubleInfo(GRB_CB_MIP_OBJBND);
+				progress.has_bound = (std::abs(progress.bound) < GRB_INFINITY);
+				progress_(progress);
+				return;
+			}
+			if (where != GRB_CB_MIPSOL || !report_)
+				return;
+			double* values = getSolution(X_.data(), static_cast<int>(X_.size()));
+			std::vector<double> x(values, values + X_.size());
+			delete[] values;
+			report_(getDoubleInfo(GRB_CB_MIPSOL_OBJ), x);
+		}
+
+	private:
+		const std::vector<GRBVar>& X_;
+		const std::function<void(double, const std::vector<double>&)>& report_;
+		const std::atomic<bool>* interrupt_;
+		const std::function<void(const LinearProgramSolver::SearchProgress&)>& progress_;
+	};
+
+}
 
 
 bool LinearProgramSolver::_solve_GUROBI(const LinearProgram* program) {
@@ -62,35 +110,54 @@ bool LinearProgramSolver::_solve_GUROBI(const LinearProgram* program) {
 		// Integrate new variables
 		model.update();
 
+		// the starting point (if provided) is used as a MIP start
+		if (has_initial_solution(program)) {
+			for (std::size_t i = 0; i < variables.size(); ++i)
+				X[i].set(GRB_DoubleAttr_Start, initial_solution_[i]);
+		}
+
+		// the hints (if provided) guide the branching
+		if (has_variable_hints(variables.size())) {
+			for (std::size_t i = 0; i < variables.size(); ++i) {
+				if (hints_[i] >= 0.0)
+					X[i].set(GRB_DoubleAttr_VarHintVal, hints_[i]);
+				if (priorities_[i] != 0)
+					X[i].set(GRB_IntAttr_BranchPriority, priorities_[i]);
+			}
+		}
+
 		// Add constraints
 		const std::vector<LinearConstraint*>& constraints = program->constraints();
+		const SparseMatrix& matrix = program->constraint_matrix();
+		std::vector<GRBVar> cstr_variables;
 		for (std::size_t i = 0; i < constraints.size(); ++i) {
-			GRBLinExpr expr;
 			const LinearConstraint* c = constraints[i];
-			const std::unordered_map<int, double>& coeffs = c->coefficients();
-			std::unordered_map<int, double>::const_iterator cur = coeffs.begin();
-			for (; cur != coeffs.end(); ++cur) {
-                std::size_t var_idx = static_cast<std::size_t>(cur->first);
-				double coeff = cur->second;
-				expr += coeff * X[var_idx];
-			}
+			const SparseRow coeffs = matrix.row(i);
+			cstr_variables.resize(coeffs.size());
+			for (std::size_t k = 0; k < coeffs.size(); ++k)
+				cstr_variables[k] = X[coeffs.index(k)];
+
+			// the coefficients are added at once
+			GRBLinExpr expr;
+			expr.addTerms(coeffs.values(), cstr_variables.data(), static_cast<int>(coeffs.size()));
 
+			int lazy = c->is_lazy() ? 1 : 0;	// 1: the constraint is pulled in once it is violated
 			switch (c->bound_type())
 			{
 			case LinearConstraint::FIXED:
-				model.addConstr(expr == c->get_bound());
+				model.addConstr(expr == c->get_bound()).set(GRB_IntAttr_Lazy, lazy);
 				break;
 			case LinearConstraint::LOWER:
-				model.addConstr(expr >= c->get_bound());
+				model.addConstr(expr >= c->get_bound()).set(GRB_IntAttr_Lazy, lazy);
 				break;
 			case LinearConstraint::UPPER:
-				model.addConstr(expr <= c->get_bound());
+				model.addConstr(expr <= c->get_bound()).set(GRB_IntAttr_Lazy, lazy);
 				break;
 			case LinearConstraint::DOUBLE: {
 				double lb, ub;
 				c->get_bounds(lb, ub);
-				model.addConstr(expr >= lb);
-				model.addConstr(expr <= ub);
+				model.addConstr(expr >= lb).set(GRB_IntAttr_Lazy, lazy);
+				model.addConstr(expr <= ub).set(GRB_IntAttr_Lazy, lazy);
 				break;
 				}
 			default:
@@ -102,32 +169,50 @@ bool LinearProgramSolver::_solve_GUROBI(const LinearProgram* program) {
 		GRBLinExpr obj;
 
 		const LinearObjective* objective = program->objective();
-		const std::unordered_map<int, double>& obj_coeffs = objective->coefficients();
-		std::unordered_map<int, double>::const_iterator it = obj_coeffs.begin();
-		for (; it != obj_coeffs.end(); ++it) {
-            std::size_t var_idx = static_cast<std::size_t>(it->first);
-			double coeff = it->second;
-			obj += coeff * X[var_idx];
-		}
+		const SparseRow obj_coeffs = objective->coefficients();
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			obj += obj_coeffs.value(k) * X[obj_coeffs.index(k)];
 		// Set objective function sense
 		bool minimize = (objective->sense() == LinearObjective::MINIMIZE);
 		model.setObjective(obj, minimize ? GRB_MINIMIZE : GRB_MAXIMIZE);
 
+		// search control
+		if (options_.time_limit > 0.0)
+			model.set(GRB_DoubleParam_TimeLimit, options_.time_limit);
+		if (options_.relative_gap >= 0.0)
+			model.set(GRB_DoubleParam_MIPGap, options_.relative_gap);
+		if (options_.num_threads > 0)
+			model.set(GRB_IntParam_Threads, static_cast<int>(options_.num_threads));
+		model.set(GRB_IntParam_Seed, static_cast<int>(options_.random_seed));	// GUROBI is deterministic for a given seed
+		if (options_.node_limit > 0)
+			model.set(GRB_DoubleParam_NodeLimit, static_cast<double>(options_.node_limit));
+
+		GurobiSearchCallback search_callback(X, options_.incumbent_callback, options_.interrupt, options_.progress_callback);
+		if (options_.incumbent_callback || options_.interrupt || options_.progress_callback)
+			model.setCallback(&search_callback);
+
 		// Optimize model
-        Logger::out("-") << "using the GUROBI solver (version " << GRB_VERSION_MAJOR << "." << GRB_VERSION_MINOR << ")." << std::endl;
+        if (verbose_)
+            Logger::out("-") << "using the GUROBI solver (version " << GRB_VERSION_MAJOR << "." << GRB_VERSION_MINOR << ")." << std::endl;
 		model.optimize();
 
-        int status = model.get(GRB_IntAttr_Status);
-        switch (status) {
-		case GRB_OPTIMAL: {
+        // the best solution found (also available if the search was stopped by a limit)
+        bool has_solution = (model.get(GRB_IntAttr_SolCount) > 0);
+        if (has_solution) {
 			objective_value_ = model.get(GRB_DoubleAttr_ObjVal);
 			result_.resize(variables.size());
 			for (std::size_t i = 0; i < variables.size(); ++i) {
 				result_[i] = X[i].get(GRB_DoubleAttr_X);
 			}
 			upload_solution(program);
+			status_ = STATUS_LIMIT_REACHED;
+        }
+
+        int status = model.get(GRB_IntAttr_Status);
+        switch (status) {
+		case GRB_OPTIMAL:
+			status_ = STATUS_OPTIMAL;
 			break;
-		}
 		
 		case GRB_INF_OR_UNBD:
 			std::cerr << "model is infeasible or unbounded" << std::endl;
@@ -135,10 +220,22 @@ bool LinearProgramSolver::_solve_GUROBI(const LinearProgram* program) {
 
 		case GRB_INFEASIBLE:
 			std::cerr << "model is infeasible" << std::endl;
+			status_ = STATUS_INFEASIBLE;
 			break;
 
 		case GRB_UNBOUNDED:
 			std::cerr << "model is unbounded" << std::endl;
+			status_ = STATUS_UNBOUNDED;
+			break;
+
+		case GRB_TIME_LIMIT:
+		case GRB_NODE_LIMIT:
+			std::cerr << "optimization was stopped by a limit (status = " << status << ")" << std::endl;
+			break;
+
+		case GRB_INTERRUPTED:
+			if (verbose_)
+				std::cerr << "optimization was interrupted" << std::endl;
 			break;
 
 		default:
@@ -146,7 +243,7 @@ bool LinearProgramSolver::_solve_GUROBI(const LinearProgram* program) {
 			break;
 		}
 
-		return (status == GRB_OPTIMAL);
+		return has_solution;
 	}
 	catch (GRBException e) {
         Logger::err("-") << e.getMessage() << " (error code: " << e.getErrorCode() << ")." << std::endl;
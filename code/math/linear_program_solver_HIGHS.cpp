@@ -0,0 +1,261 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "linear_program_solver.h"
+#include "../basic/logger.h"
+
+
+#ifdef HAS_HIGHS
+
+#include <Highs.h>
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// what the callback of HiGHS needs from the options
+	struct HighsSearchContext {
+		const std::atomic<bool>* interrupt;
+		const std::function<void(const LinearProgramSolver::SearchProgress&)>* progress;
+		const std::function<void(double, const std::vector<double>&)>* report;
+		std::size_t num_variables;
+	};
+
+	// reports the improving solutions and the progress, and stops the search on interrupt (HiGHS 1.7 and later)
+	void highs_search_callback(int callback_type, const std::string& /* message */,
+		const HighsCallbackDataOut* data_out, HighsCallbackDataIn* data_in, void* user_data)
+	{
+		const HighsSearchContext* context = static_cast<const HighsSearchContext*>(user_data);
+		if (callback_type == kCallbackMipInterrupt) {
+			if (context->interrupt && context->interrupt->load())
+				data_in->user_interrupt = true;
+			if (*context->progress) {
+				LinearProgramSolver::SearchProgress progress;
+				progress.nodes = static_cast<long long>(data_out->mip_node_count);
+				progress.incumbent = data_out->mip_primal_bound;
+				progress.has_incumbent = (std::abs(progress.incumbent) < kHighsInf);
+				progress.bound = data_out->mip_dual_bound;
+				progress.has_bound = (std::abs(progress.bound) < kHighsInf);
+				(*context->progress)(progress);
+			}
+		}
+		else if (callback_type == kCallbackMipImprovingSolution && *context->report && data_out->mip_solution) {
+			std::vector<double> x(data_out->mip_solution, data_out->mip_solution + context->num_variables);
+			(*context->report)(data_out->objective_function_value, x);
+		}
+	}
+
+	inline double highs_bound(double value) {
+		if (value <= -Variable::infinity())
+			return -kHighsInf;
+		if (value >= Variable::infinity())
+			return kHighsInf;
+		return value;
+	}
+
+}
+
+
+bool LinearProgramSolver::_solve_HIGHS(const LinearProgram* program) {
+	try {
+		if (!check_program(program))
+			return false;
+
+		const std::vector<Variable*>& variables = program->variables();
+		const std::vector<LinearConstraint*>& constraints = program->constraints();
+		const SparseMatrix& matrix = program->constraint_matrix();
+
+		HighsLp lp;
+		lp.num_col_ = static_cast<HighsInt>(variables.size());
+		lp.num_row_ = static_cast<HighsInt>(constraints.size());
+
+		// the variables
+		lp.col_cost_.assign(variables.size(), 0.0);
+		lp.col_lower_.resize(variables.size());
+		lp.col_upper_.resize(variables.size());
+		lp.integrality_.assign(variables.size(), HighsVarType::kContinuous);
+		bool has_integers = false;
+		for (std::size_t i = 0; i < variables.size(); ++i) {
+			const Variable* var = variables[i];
+			double lb, ub;
+			var->get_bounds(lb, ub);
+			if (var->variable_type() == Variable::BINARY) {
+				lb = 0;
+				ub = 1;
+			}
+			if (var->variable_type() != Variable::CONTINUOUS) {
+				lp.integrality_[i] = HighsVarType::kInteger;
+				has_integers = true;
+			}
+			lp.col_lower_[i] = highs_bound(lb);
+			lp.col_upper_[i] = highs_bound(ub);
+			if (options_.store_names)
+				lp.col_names_.push_back(var->has_name() ? var->name() : "x" + std::to_string(i));
+		}
+		if (!has_integers)
+			lp.integrality_.clear();
+
+		// the objective
+		const LinearObjective* objective = program->objective();
+		const SparseRow obj_coeffs = objective->coefficients();
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			lp.col_cost_[obj_coeffs.index(k)] += obj_coeffs.value(k);
+		lp.sense_ = (objective->sense() == LinearObjective::MINIMIZE) ? ObjSense::kMinimize : ObjSense::kMaximize;
+
+		// The constraints: the matrix is passed as it is in the program (CSR). HiGHS has no lazy constraints, so
+		// they are usual constraints.
+		lp.row_lower_.resize(constraints.size());
+		lp.row_upper_.resize(constraints.size());
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const LinearConstraint* c = constraints[i];
+			double lb = -kHighsInf, ub = kHighsInf;
+			switch (c->bound_type())
+			{
+			case LinearConstraint::FIXED:
+				lb = ub = c->get_bound();
+				break;
+			case LinearConstraint::LOWER:
+				lb = c->get_bound();
+				break;
+			case LinearConstraint::UPPER:
+				ub = c->get_bound();
+				break;
+			case LinearConstraint::DOUBLE:
+				c->get_bounds(lb, ub);
+				break;
+			default:
+				break;
+			}
+			lp.row_lower_[i] = highs_bound(lb);
+			lp.row_upper_[i] = highs_bound(ub);
+			if (options_.store_names)
+				lp.row_names_.push_back(c->has_name() ? c->name() : "c" + std::to_string(i));
+		}
+		lp.a_matrix_.format_ = MatrixFormat::kRowwise;
+		lp.a_matrix_.num_col_ = lp.num_col_;
+		lp.a_matrix_.num_row_ = lp.num_row_;
+		lp.a_matrix_.start_.assign(matrix.row_start.begin(), matrix.row_start.end());
+		lp.a_matrix_.index_.assign(matrix.columns.begin(), matrix.columns.end());
+		lp.a_matrix_.value_ = matrix.values;
+
+		Highs highs;
+		highs.setOptionValue("output_flag", false);
+
+		// search control
+		if (options_.time_limit > 0.0)
+			highs.setOptionValue("time_limit", options_.time_limit);
+		if (options_.relative_gap >= 0.0)
+			highs.setOptionValue("mip_rel_gap", options_.relative_gap);
+		// NOTE: the scheduler of HiGHS is shared by the process, so the number of threads is taken at its first solve
+		if (options_.num_threads > 0)
+			highs.setOptionValue("threads", static_cast<HighsInt>(options_.num_threads));
+		highs.setOptionValue("random_seed", static_cast<HighsInt>(options_.random_seed));	// HiGHS is deterministic for a given seed
+		if (options_.node_limit > 0)
+			highs.setOptionValue("mip_max_nodes", static_cast<HighsInt>(std::min<long long>(options_.node_limit, kHighsIInf)));
+
+		if (highs.passModel(lp) == HighsStatus::kError) {
+			Logger::err("-") << "HiGHS failed to load the model" << std::endl;
+			return false;
+		}
+
+		// the starting point (if provided) is used as a MIP start
+		if (has_initial_solution(program)) {
+			HighsSolution start;
+			start.col_value = initial_solution_;
+			start.value_valid = true;
+			highs.setSolution(start);
+		}
+
+		HighsSearchContext context = { options_.interrupt, &options_.progress_callback, &options_.incumbent_callback, variables.size() };
+		if (options_.incumbent_callback || options_.interrupt || options_.progress_callback) {
+			highs.setCallback(highs_search_callback, &context);
+			highs.startCallback(kCallbackMipInterrupt);
+			if (options_.incumbent_callback)
+				highs.startCallback(kCallbackMipImprovingSolution);
+		}
+
+		// Optimize model
+		if (verbose_)
+			Logger::out("-") << "using the HiGHS solver (version " << highsVersionMajor() << "." << highsVersionMinor() << ")." << std::endl;
+		if (highs.run() == HighsStatus::kError) {
+			Logger::err("-") << "HiGHS failed to solve the model" << std::endl;
+			return false;
+		}
+
+		// the best solution found (also available if the search was stopped by a limit)
+		const HighsInfo& info = highs.getInfo();
+		bool has_solution = (info.primal_solution_status == kSolutionStatusFeasible);
+		if (has_solution) {
+			objective_value_ = info.objective_function_value;
+			result_ = highs.getSolution().col_value;
+			upload_solution(program);
+			status_ = STATUS_LIMIT_REACHED;
+		}
+
+		HighsModelStatus status = highs.getModelStatus();
+		switch (status) {
+		case HighsModelStatus::kOptimal:
+			status_ = STATUS_OPTIMAL;
+			break;
+
+		case HighsModelStatus::kUnboundedOrInfeasible:
+			std::cerr << "model is infeasible or unbounded" << std::endl;
+			break;
+
+		case HighsModelStatus::kInfeasible:
+			std::cerr << "model is infeasible" << std::endl;
+			status_ = STATUS_INFEASIBLE;
+			break;
+
+		case HighsModelStatus::kUnbounded:
+			std::cerr << "model is unbounded" << std::endl;
+			status_ = STATUS_UNBOUNDED;
+			break;
+
+		case HighsModelStatus::kTimeLimit:
+		case HighsModelStatus::kSolutionLimit:
+		case HighsModelStatus::kIterationLimit:
+			std::cerr << "optimization was stopped by a limit (status = " << highs.modelStatusToString(status) << ")" << std::endl;
+			break;
+
+		case HighsModelStatus::kInterrupt:
+			if (verbose_)
+				std::cerr << "optimization was interrupted" << std::endl;
+			break;
+
+		default:
+			std::cerr << "optimization was stopped with status = " << highs.modelStatusToString(status) << std::endl;
+			break;
+		}
+
+		return has_solution;
+	}
+	catch (const std::exception& e) {
+		Logger::err("-") << "HiGHS: " << e.what() << std::endl;
+	}
+	catch (...) {
+		std::cerr << "Exception during optimization" << std::endl;
+	}
+
+	return false;
+}
+
+#endif
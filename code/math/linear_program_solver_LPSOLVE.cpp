@@ -23,6 +23,54 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../basic/logger.h"
 
 #include <iostream>
+#include <cmath>
+
+
+namespace {
+
+	// the state shared with the callbacks of the branch-and-bound search
+	struct LPSolveSearch {
+		long long node_limit;
+		const std::atomic<bool>* interrupt;
+		const std::function<void(double, const std::vector<double>&)>* incumbent_callback;
+		std::size_t num_variables;
+		const std::function<void(const LinearProgramSolver::SearchProgress&)>* progress_callback;
+		bool has_incumbent;
+		double incumbent;	// the working objective is that of the current node, not of the best solution
+	};
+
+	// reports the progress, and stops the search when the node limit is reached or on interrupt
+	int __WINAPI lpsolve_abort(lprec* lp, void* handle) {
+		const LPSolveSearch* search = static_cast<const LPSolveSearch*>(handle);
+		if (search->progress_callback) {
+			LinearProgramSolver::SearchProgress progress;
+			progress.nodes = get_total_nodes(lp);
+			progress.has_incumbent = search->has_incumbent;
+			progress.incumbent = search->incumbent;
+			(*search->progress_callback)(progress);
+		}
+		if (search->interrupt && search->interrupt->load())
+			return TRUE;
+		return (search->node_limit > 0 && get_total_nodes(lp) >= search->node_limit) ? TRUE : FALSE;
+	}
+
+	// records and reports the improving solutions
+	void __WINAPI lpsolve_message(lprec* lp, void* handle, int message) {
+		if (message != MSG_MILPFEASIBLE && message != MSG_MILPBETTER)
+			return;
+		LPSolveSearch* search = static_cast<LPSolveSearch*>(handle);
+		search->has_incumbent = true;
+		search->incumbent = get_working_objective(lp);
+		if (!*search->incumbent_callback)
+			return;
+		REAL* values = 0;
+		if (get_ptr_variables(lp, &values) && values) {
+			std::vector<double> x(values, values + search->num_variables);
+			(*search->incumbent_callback)(get_working_objective(lp), x);
+		}
+	}
+
+}
 
 
 bool LinearProgramSolver::_solve_LPSOLVE(const LinearProgram* program) {
@@ -30,34 +78,119 @@ bool LinearProgramSolver::_solve_LPSOLVE(const LinearProgram* program) {
 		if (!check_program(program))
 			return false;
 
-		// Note that there are several restrictions with its row entry mode:
-		// Only use set_add_rowmode() after a make_lp call. Also, if this function is used, first add the objective function 
-		// and after that add the constraints. Don't call other API functions while in row entry mode. No other data matrix 
-		// access is allowed while in row entry mode. After adding the constraints, turn row entry mode back off. Once turned 
-		// off, you cannot switch back to row entry mode. So in short:
-		//	- turn row entry mode on
-		//	- set the objective function
-		//	- create the constraints
-		//	- turn row entry mode off
+		// lp_solve keeps its matrix by columns, so the program is loaded column by column (with the 
+		// objective as row 0), which is much faster than adding the rows one by one. The rows are set up
+		// first: changing the type of a row afterwards would flip the signs of its coefficients.
 
 		// Create a new LP model
 		const std::vector<Variable*>& variables = program->variables();
 		const std::vector<LinearConstraint*>& constraints = program->constraints();
-		lprec* lp = make_lp(constraints.size(), variables.size());
+		lprec* lp = make_lp(static_cast<int>(constraints.size()), 0);
 		if (!lp) {
 			std::cerr << "error in creating a LP model" << std::endl;
 			return false;
 		}
 
 		set_lp_name(lp, const_cast<char*>(program->name().c_str()));
-		set_verbose(lp, SEVERE);
-		set_presolve(lp, PRESOLVE_ROWS | PRESOLVE_COLS | PRESOLVE_LINDEP, get_presolveloops(lp));
+		::set_verbose(lp, SEVERE);	// not the member of LinearProgramSolver
+		// the improving solutions are reported during the search, when the presolved columns haven't been restored yet
+		if (options_.incumbent_callback)
+			set_presolve(lp, PRESOLVE_ROWS | PRESOLVE_LINDEP, get_presolveloops(lp));
+		else
+			set_presolve(lp, PRESOLVE_ROWS | PRESOLVE_COLS | PRESOLVE_LINDEP, get_presolveloops(lp));
+
+		if (options_.time_limit > 0.0)
+			set_timeout(lp, static_cast<long>(std::ceil(options_.time_limit)));
+		if (options_.relative_gap >= 0.0)
+			set_mip_gap(lp, FALSE, options_.relative_gap);
+
+		LPSolveSearch search = { options_.node_limit, options_.interrupt, &options_.incumbent_callback, variables.size(), 0, false, 0.0 };
+		if (options_.progress_callback)
+			search.progress_callback = &options_.progress_callback;
+		if (options_.node_limit > 0 || options_.interrupt || options_.progress_callback)
+			put_abortfunc(lp, lpsolve_abort, &search);
+		if (options_.incumbent_callback || options_.progress_callback)
+			put_msgfunc(lp, lpsolve_message, &search, MSG_MILPFEASIBLE | MSG_MILPBETTER);
+
+		// Set objective function sense
+		const LinearObjective* objective = program->objective();
+		set_sense(lp, objective->sense() == LinearObjective::MAXIMIZE); // true for maximize
+
+		// set the types and the right-hand sides of the constraints
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const LinearConstraint* c = constraints[i];
+			int row_idx = static_cast<int>(i) + 1;	// The LP_SOLVE manual says the first element is ignored
+			switch (c->bound_type())
+			{
+			case LinearConstraint::FIXED:
+				set_constr_type(lp, row_idx, EQ);
+				set_rh(lp, row_idx, c->get_bound());
+				break;
+			case LinearConstraint::LOWER:
+				set_constr_type(lp, row_idx, GE);
+				set_rh(lp, row_idx, c->get_bound());
+				break;
+			case LinearConstraint::UPPER:
+				set_constr_type(lp, row_idx, LE);
+				set_rh(lp, row_idx, c->get_bound());
+				break;
+			case LinearConstraint::DOUBLE: {
+				double lb, ub;
+				c->get_bounds(lb, ub);
+				set_constr_type(lp, row_idx, GE); // I choose GE and I will set the range using set_rh_range()
+				set_rh(lp, row_idx, lb);
+				set_rh_range(lp, row_idx, ub - lb);
+				break;
+				}
+			default:
+				break;
+			}
+			if (options_.store_names)
+				set_row_name(lp, row_idx, const_cast<char*>(c->name().c_str()));
+		}
+
+		// the columns of the constraint matrix (i.e., its transpose), each with its objective coefficient 
+		// first and its rows in order
+		const SparseMatrix& matrix = program->constraint_matrix();
+		const SparseRow obj_coeffs = objective->coefficients();
+		std::vector<std::size_t> column_start(variables.size() + 1, 0);
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			++column_start[obj_coeffs.index(k) + 1];
+		for (std::size_t k = 0; k < matrix.num_nonzeros(); ++k)
+			++column_start[matrix.columns[k] + 1];
+		for (std::size_t j = 0; j < variables.size(); ++j)
+			column_start[j + 1] += column_start[j];
+
+		std::vector<int>  rows(column_start.back());
+		std::vector<REAL> values(column_start.back());
+		std::vector<std::size_t> pos(column_start.begin(), column_start.end() - 1);
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k) {
+			std::size_t j = obj_coeffs.index(k);
+			rows[pos[j]] = 0;
+			values[pos[j]++] = obj_coeffs.value(k);
+		}
+		for (std::size_t i = 0; i < matrix.num_rows(); ++i) {
+			for (std::size_t k = matrix.row_start[i]; k < matrix.row_start[i + 1]; ++k) {
+				std::size_t j = matrix.columns[k];
+				rows[pos[j]] = static_cast<int>(i) + 1;
+				values[pos[j]++] = matrix.values[k];
+			}
+		}
+
+		// add the columns (add_columnex() reads the arrays from 0)
+		resize_lp(lp, static_cast<int>(constraints.size()), static_cast<int>(variables.size()));
+		for (std::size_t j = 0; j < variables.size(); ++j) {
+			int count = static_cast<int>(column_start[j + 1] - column_start[j]);
+			add_columnex(lp, count, values.data() + column_start[j], rows.data() + column_start[j]);
+		}
 
 		// create variables
 		for (std::size_t i = 0; i < variables.size(); ++i) {
 			const Variable* var = variables[i];
 
 			std::size_t var_idx = i + 1;	// The LP_SOLVE manual says the first element is ignored
+			if (options_.store_names)
+				set_col_name(lp, static_cast<int>(var_idx), const_cast<char*>(var->name().c_str()));
 			if (var->variable_type() == Variable::INTEGER)
 				set_int(lp, var_idx, TRUE);
 			else if (var->variable_type() == Variable::BINARY)
@@ -92,91 +225,44 @@ bool LinearProgramSolver::_solve_LPSOLVE(const LinearProgram* program) {
 			}
 		}
 
-		// turn row entry mode on
-		set_add_rowmode(lp, TRUE);
-
-		// set objective 
-
-		// The LP_SOLVE manual says the first element is ignored, so any value is OK.
-		std::vector<double> row(variables.size() + 1, 0);
-
-		// determine the coefficient of each variable in the objective function
-		const LinearObjective* objective = program->objective();
-		const std::unordered_map<int, double>& obj_coeffs = objective->coefficients();
-		std::unordered_map<int, double>::const_iterator cur = obj_coeffs.begin();
-		for (; cur != obj_coeffs.end(); ++cur) {
-			std::size_t var_idx = cur->first;
-			double coeff = cur->second;
-			row[var_idx + 1] = coeff;	// The LP_SOLVE manual says the first element is ignored
-		}
-		set_obj_fn(lp, row.data());
-
-		// Set objective function sense
-		set_sense(lp, objective->sense() == LinearObjective::MAXIMIZE); // true for maximize
-
-		// Add constraints
-
-		for (std::size_t i = 0; i < constraints.size(); ++i) {
-			const LinearConstraint* c = constraints[i];
-			const std::unordered_map<int, double>& coeffs = c->coefficients();
-			std::unordered_map<int, double>::const_iterator cur = coeffs.begin();
-
-			// Liangliang: Annoying LPSOLVE: some functions read an array from 0 but some from 1!!!
-			// set_rowex() is one of the functions that read arrays forom 0.
-			// The LP_SOLVE manual: In contrary to set_row(), set_rowex() reads the arrays starting from element 0.
-			std::vector<int>	indices(coeffs.size(), 0);			
-			std::vector<double> coefficients(coeffs.size(), 0.0);
-			std::size_t idx = 0; // lp_solve uses 1-based arrays
-			for (; cur != coeffs.end(); ++cur) {
-				std::size_t var_idx = cur->first;
-				double coeff = cur->second;
-
-				indices[idx] = var_idx + 1;	 // The LP_SOLVE manual says the first element is ignored
-				coefficients[idx] = coeff;
-				++idx;
-			}
-
-			// set the coefficients
-			std::size_t row_idx = i + 1;	// The LP_SOLVE manual says the first element is ignored
-			set_rowex(lp, row_idx, static_cast<int>(indices.size()), coefficients.data(), indices.data());
-			switch (c->bound_type())
-			{
-			case LinearConstraint::FIXED:
-				set_constr_type(lp, row_idx, EQ);
-				set_rh(lp, row_idx, c->get_bound());
-				break;
-			case LinearConstraint::LOWER:
-				set_constr_type(lp, row_idx, GE);
-				set_rh(lp, row_idx, c->get_bound());
-				break;
-			case LinearConstraint::UPPER:
-				set_constr_type(lp, row_idx, LE);
-				set_rh(lp, row_idx, c->get_bound());
-				break;
-			case LinearConstraint::DOUBLE: {
-				double lb, ub;
-				c->get_bounds(lb, ub);
-				set_constr_type(lp, row_idx, GE); // I choose GE and I will set the range using set_rh_range()
-				set_rh(lp, row_idx, lb);
-				set_rh_range(lp, row_idx, ub - lb);
-				break;
-				}
-			default:
-				break;
+		// the hints (if provided) guide the branching: the variables with the lowest weights are branched
+		// on first (the weights are read from 0), and the hinted values give the first branch
+		if (has_variable_hints(variables.size())) {
+			std::vector<REAL> weights(variables.size());
+			for (std::size_t i = 0; i < variables.size(); ++i) {
+				weights[i] = -static_cast<REAL>(priorities_[i]);
+				if (hints_[i] >= 0.0 && variables[i]->variable_type() != Variable::CONTINUOUS)
+					set_var_branch(lp, static_cast<int>(i) + 1, hints_[i] >= 0.5 ? BRANCH_CEILING : BRANCH_FLOOR);
 			}
+			set_var_weights(lp, weights.data());
 		}
 
-		// turn row entry mode off
-		set_add_rowmode(lp, FALSE);
 
-		Logger::out("-") << "using the LPSOLVE solver" << std::endl;
+		if (verbose_)
+			Logger::out("-") << "using the LPSOLVE solver" << std::endl;
 		int status = ::solve(lp);
-		switch (status) {
-		case 0: {
-			objective_value_ = get_objective(lp);
+
+		// the best solution found (also available if the search was stopped by a limit)
+		// NOTE: get_variables() only gives the columns kept by the presolve, so the values are queried
+		//       in the original model (the rows come first in it)
+		auto extract_solution = [&]() -> bool {
 			result_.resize(variables.size());
-			get_variables(lp, result_.data());
+			if (!get_ptr_variables(lp, 0))	// checks the solution is valid
+				return false;
+			const int num_rows = get_Norig_rows(lp);
+			for (std::size_t i = 0; i < variables.size(); ++i)
+				result_[i] = get_var_primalresult(lp, num_rows + static_cast<int>(i) + 1);
+			objective_value_ = get_objective(lp);
 			upload_solution(program);
+			return true;
+		};
+
+		bool has_solution = false;
+		switch (status) {
+		case 0: {
+			has_solution = extract_solution();
+			if (has_solution)
+				status_ = STATUS_OPTIMAL;
 			break;
 		}
 		case -2:
@@ -184,12 +270,17 @@ bool LinearProgramSolver::_solve_LPSOLVE(const LinearProgram* program) {
 			break;
 		case 1:
 			std::cerr << "The model is sub-optimal. Only happens if there are integer variables and there is already an integer solution found. The solution is not guaranteed the most optimal one." << std::endl;
+			has_solution = extract_solution();
+			if (has_solution)
+				status_ = STATUS_LIMIT_REACHED;
 			break;
 		case 2:
 			std::cerr << "The model is infeasible" << std::endl;
+			status_ = STATUS_INFEASIBLE;
 			break;
 		case 3:
 			std::cerr << "The model is unbounded" << std::endl;
+			status_ = STATUS_UNBOUNDED;
 			break;
 		case 4:
 			std::cerr << "The model is degenerative" << std::endl;
@@ -198,10 +289,19 @@ bool LinearProgramSolver::_solve_LPSOLVE(const LinearProgram* program) {
 			std::cerr << "Numerical failure encountered" << std::endl;
 			break;
 		case 6:
-			std::cerr << "The abort() routine was called" << std::endl;
+			if (verbose_)
+				std::cerr << "The abort() routine was called" << std::endl;
+			if (get_solutioncount(lp) > 0)	// e.g., the node limit has been reached or interrupted
+				has_solution = extract_solution();
+			if (has_solution)
+				status_ = STATUS_LIMIT_REACHED;
 			break;
 		case 7:
 			std::cerr << "A timeout occurred" << std::endl;
+			if (get_solutioncount(lp) > 0)
+				has_solution = extract_solution();
+			if (has_solution)
+				status_ = STATUS_LIMIT_REACHED;
 			break;
 		case 9:
 			std::cerr << "The model could be solved by presolve. This can only happen if presolve is active via set_presolve()" << std::endl;
@@ -216,7 +316,7 @@ bool LinearProgramSolver::_solve_LPSOLVE(const LinearProgram* program) {
 
 		delete_lp(lp);
 
-		return (status == 0);
+		return has_solution;
 	}
 	catch (std::exception e) {
 		std::cerr << "Error code = " << e.what() << std::endl;
@@ -0,0 +1,239 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "linear_program_solver.h"
+#include "../basic/logger.h"
+#include "../basic/parallel.h"
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+
+namespace {
+
+	const char* solver_string(LinearProgramSolver::SolverName name) {
+		switch (name) {
+#ifdef HAS_GUROBI
+		case LinearProgramSolver::GUROBI:	return "GUROBI";
+#endif
+#ifdef HAS_HIGHS
+		case LinearProgramSolver::HIGHS:	return "HIGHS";
+#endif
+#ifdef HAS_ORTOOLS
+		case LinearProgramSolver::CPSAT:	return "CPSAT";
+#endif
+		case LinearProgramSolver::SCIP:		return "SCIP";
+		case LinearProgramSolver::GLPK:		return "GLPK";
+		case LinearProgramSolver::LPSOLVE:	return "LPSOLVE";
+		default:							return "PORTFOLIO";
+		}
+	}
+
+
+	// each racer works on its own copy, because the solvers write the solution back to the program
+	void copy_program(const LinearProgram& program, LinearProgram& copy) {
+		copy.set_name(program.name());
+
+		const std::vector<Variable*>& variables = program.variables();
+		for (std::size_t i = 0; i < variables.size(); ++i) {
+			const Variable* v = variables[i];
+			double lb, ub;
+			v->get_bounds(lb, ub);
+			copy.create_variable(v->variable_type(), v->bound_type(), lb, ub, v->has_name() ? v->name() : std::string());
+		}
+
+		const std::vector<LinearConstraint*>& constraints = program.constraints();
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const LinearConstraint* c = constraints[i];
+			double lb, ub;
+			c->get_bounds(lb, ub);
+			LinearConstraint* cc = copy.create_constraint(c->bound_type(), lb, ub, c->has_name() ? c->name() : std::string());
+			cc->set_lazy(c->is_lazy());
+			const SparseRow coeffs = c->coefficients();
+			cc->add_coefficients(std::vector<int>(coeffs.indices(), coeffs.indices() + coeffs.size()), std::vector<double>(coeffs.values(), coeffs.values() + coeffs.size()));
+		}
+
+		const LinearObjective* objective = program.objective();
+		LinearObjective* co = copy.create_objective(objective->sense());
+		const SparseRow obj_coeffs = objective->coefficients();
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			co->add_coefficient(obj_coeffs.index(k), obj_coeffs.value(k));
+
+		copy.finalize();
+	}
+
+
+	// the other racers can't do better than a proven result
+	bool is_decisive(LinearProgramSolver::Status status) {
+		return status == LinearProgramSolver::STATUS_OPTIMAL ||
+			status == LinearProgramSolver::STATUS_INFEASIBLE ||
+			status == LinearProgramSolver::STATUS_UNBOUNDED;
+	}
+
+
+	bool is_better(double objective, double than, LinearObjective::Sense sense) {
+		return (sense == LinearObjective::MAXIMIZE) ? (objective > than) : (objective < than);
+	}
+
+}
+
+
+bool LinearProgramSolver::_solve_PORTFOLIO(const LinearProgram* program) {
+	if (!check_program(program))
+		return false;
+
+	std::vector<SolverName> candidates = portfolio_;
+	if (candidates.empty()) {
+#ifdef HAS_GUROBI
+		candidates.push_back(GUROBI);
+#endif
+#ifdef HAS_HIGHS
+		candidates.push_back(HIGHS);
+#endif
+#ifdef HAS_ORTOOLS
+		if (program->is_pseudo_boolean())
+			candidates.push_back(CPSAT);
+#endif
+		candidates.push_back(SCIP);
+		candidates.push_back(GLPK);
+		candidates.push_back(LPSOLVE);
+	}
+
+	// each backend runs at most once (e.g., GLPK keeps its environment in a global)
+	std::vector<SolverName> solvers;
+	for (std::size_t i = 0; i < candidates.size(); ++i) {
+		if (candidates[i] != PORTFOLIO && candidates[i] != AUTO && std::find(solvers.begin(), solvers.end(), candidates[i]) == solvers.end())
+			solvers.push_back(candidates[i]);
+	}
+	if (solvers.empty()) {
+		Logger::err("-") << "no solver in the portfolio" << std::endl;
+		return false;
+	}
+
+	if (verbose_) {
+		std::string names;
+		for (std::size_t i = 0; i < solvers.size(); ++i)
+			names += std::string(" ") + solver_string(solvers[i]);
+		Logger::out("-") << "racing the solvers:" << names << std::endl;
+	}
+
+	const LinearObjective::Sense sense = program->objective()->sense();
+	const std::size_t num = solvers.size();
+
+	std::vector<LinearProgram>		 copies(num);
+	std::vector<LinearProgramSolver> racers(num);
+
+	std::atomic<bool>		 stop(false);
+	std::atomic<std::size_t> num_finished(0);
+	std::mutex				 mutex;	
+	int						 winner = -1;	// the first racer with a proven result
+
+	// only the improvements over the best solution of all racers are reported
+	bool   has_incumbent = false;
+	double incumbent = 0.0;
+	std::function<void(double, const std::vector<double>&)> report;
+	if (options_.incumbent_callback) {
+		report = [&](double objective, const std::vector<double>& x) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (has_incumbent && !is_better(objective, incumbent, sense))
+				return;
+			has_incumbent = true;
+			incumbent = objective;
+			options_.incumbent_callback(objective, x);
+		};
+	}
+
+	for (std::size_t i = 0; i < num; ++i) {
+		copy_program(*program, copies[i]);
+
+		SolverOptions options = options_;	// the limits are shared, e.g., the same deadline for all
+		options.interrupt = &stop;
+		options.incumbent_callback = report;
+		options.progress_callback = nullptr;	// it would be called from the racers' threads
+
+		racers[i].set_verbose(false);
+		racers[i].set_options(options);
+		racers[i].set_initial_solution(initial_solution_);
+		racers[i].set_variable_hints(hints_, priorities_);
+	}
+
+	// an extra task forwards the interrupt of the caller to the racers
+	const bool forward_interrupt = (options_.interrupt != 0);
+	const std::size_t num_tasks = num + (forward_interrupt ? 1 : 0);
+	parallel_for(num_tasks, [&](std::size_t i) {
+		if (i == num) {
+			while (num_finished < num) {
+				if (options_.interrupt->load())
+					stop = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			return;
+		}
+
+		racers[i].solve(&copies[i], solvers[i]);
+		if (is_decisive(racers[i].status()) && !options_.deterministic) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (winner < 0) {
+				winner = static_cast<int>(i);
+				stop = true;	// cancels the others
+			}
+		}
+		++num_finished;
+	}, 0, static_cast<unsigned int>(num_tasks));
+
+	// in the deterministic mode all of them run to the end, and the first of the roster wins
+	if (options_.deterministic) {
+		for (std::size_t i = 0; i < num && winner < 0; ++i) {
+			if (is_decisive(racers[i].status()))
+				winner = static_cast<int>(i);
+		}
+	}
+
+	// without a proven result, the best solution found when all of them stopped
+	int chosen = winner;
+	if (chosen < 0) {
+		for (std::size_t i = 0; i < num; ++i) {
+			if (racers[i].status() != STATUS_LIMIT_REACHED)
+				continue;
+			if (chosen < 0 || is_better(racers[i].objective_value(), racers[chosen].objective_value(), sense))
+				chosen = static_cast<int>(i);
+		}
+	}
+
+	if (chosen < 0) {
+		Logger::err("-") << "none of the solvers found a solution" << std::endl;
+		return false;
+	}
+
+	const LinearProgramSolver& best = racers[chosen];
+	status_ = best.status();
+	if (status_ == STATUS_INFEASIBLE || status_ == STATUS_UNBOUNDED)
+		return false;
+
+	if (verbose_)
+		Logger::out("-") << solver_string(solvers[chosen]) << (winner >= 0 ? " won the race" : " has the best solution at the limit") << std::endl;
+
+	result_ = best.solution();
+	objective_value_ = best.objective_value();
+	upload_solution(program);
+	return true;
+}
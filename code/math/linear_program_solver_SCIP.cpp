@@ -26,116 +26,337 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <iostream>
 
 
-bool LinearProgramSolver::_solve_SCIP(const LinearProgram* program) {
-	try {
-		if (!check_program(program))
-			return false;
+// the data of the event handler that reports the improving solutions and stops the search on interrupt
+struct SCIP_EventhdlrData {
+	const std::function<void(double, const std::vector<double>&)>* callback;	// null if not reported
+	const std::atomic<bool>* interrupt;											// null if not polled
+	const std::vector<SCIP_VAR*>* variables;
+	const std::function<void(const LinearProgramSolver::SearchProgress&)>* progress;	// null if not reported
+};
+
+
+// The interrupt flag is polled after each node and each LP solved. The handler is included once per
+// environment and each solve gives it its own data (null if nothing is reported or polled), so it 
+// always catches all the events.
+static const SCIP_EVENTTYPE eventTypesSearch = SCIP_EVENTTYPE_BESTSOLFOUND | SCIP_EVENTTYPE_NODESOLVED | SCIP_EVENTTYPE_LPSOLVED;
+
+
+static SCIP_DECL_EVENTINIT(eventInitSearch) {
+	SCIP_CALL(SCIPcatchEvent(scip, eventTypesSearch, eventhdlr, NULL, NULL));
+	return SCIP_OKAY;
+}
+
+
+static SCIP_DECL_EVENTEXIT(eventExitSearch) {
+	SCIP_CALL(SCIPdropEvent(scip, eventTypesSearch, eventhdlr, NULL, -1));
+	return SCIP_OKAY;
+}
+
 
-		Scip* scip = 0;
-		SCIP_CALL(SCIPcreate(&scip));
-		SCIP_CALL(SCIPincludeDefaultPlugins(scip));
+static SCIP_DECL_EVENTEXEC(eventExecSearch) {
+	SCIP_EVENTHDLRDATA* data = SCIPeventhdlrGetData(eventhdlr);
+	if (!data)
+		return SCIP_OKAY;
+	if (data->callback && SCIPeventGetType(event) == SCIP_EVENTTYPE_BESTSOLFOUND) {
+		SCIP_SOL* sol = SCIPeventGetSol(event);
+		const std::vector<SCIP_VAR*>& variables = *data->variables;
+		std::vector<double> x(variables.size());
+		for (std::size_t i = 0; i < variables.size(); ++i)
+			x[i] = SCIPgetSolVal(scip, sol, variables[i]);
+		(*data->callback)(SCIPgetSolOrigObj(scip, sol), x);
+	}
+	if (data->progress && SCIPeventGetType(event) == SCIP_EVENTTYPE_NODESOLVED) {
+		LinearProgramSolver::SearchProgress progress;
+		progress.nodes = SCIPgetNNodes(scip);
+		progress.has_incumbent = SCIPgetNSols(scip) > 0;
+		if (progress.has_incumbent)
+			progress.incumbent = SCIPgetPrimalbound(scip);
+		progress.bound = SCIPgetDualbound(scip);
+		progress.has_bound = !SCIPisInfinity(scip, REALABS(progress.bound));
+		(*data->progress)(progress);
+	}
+	if (data->interrupt && data->interrupt->load() && !SCIPisStopped(scip))
+		SCIP_CALL(SCIPinterruptSolve(scip));
+	return SCIP_OKAY;
+}
+
+
+namespace {
+
+	// creates a SCIP environment with the default plugins and the event handler of the searches
+	SCIP_RETCODE create_environment(Scip** scip) {
+		SCIP_CALL(SCIPcreate(scip));
+		SCIP_CALL(SCIPincludeDefaultPlugins(*scip));
 
 		// disable scip output to stdout
-		SCIPmessagehdlrSetQuiet(SCIPgetMessagehdlr(scip), TRUE);
+		SCIPmessagehdlrSetQuiet(SCIPgetMessagehdlr(*scip), TRUE);
 
 		// use wall clock time because getting CPU user seconds
 		// involves calling times() which is very expensive
-		SCIP_CALL(SCIPsetIntParam(scip, "timing/clocktype", SCIP_CLOCKTYPE_WALL));
-
-		// create empty problem 
-		SCIP_CALL(SCIPcreateProbBasic(scip, program->name().c_str()));
-
-		// create variables
-		const std::vector<Variable*>& variables = program->variables();
-		std::vector<SCIP_VAR*> scip_variables;
-		for (std::size_t i = 0; i < variables.size(); ++i) {
-			const Variable* var = variables[i];
-			SCIP_VAR* v = 0;
-
-			double lb, ub;
-			var->get_bounds(lb, ub);
-
-//			SCIP_CALL(SCIPfreeTransform(scip));
-			// The true objective coefficient will be set later in ExtractObjective.
-			double tmp_obj_coef = 0.0;
-			switch (var->variable_type())
-			{
-			case Variable::CONTINUOUS:
-				SCIP_CALL(SCIPcreateVar(scip, &v, var->name().c_str(), lb, ub, tmp_obj_coef, SCIP_VARTYPE_CONTINUOUS, TRUE, FALSE, 0, 0, 0, 0, 0));
-				break;
-			case Variable::INTEGER:
-				SCIP_CALL(SCIPcreateVar(scip, &v, var->name().c_str(), lb, ub, tmp_obj_coef, SCIP_VARTYPE_INTEGER, TRUE, FALSE, 0, 0, 0, 0, 0));
-				break;
-			case Variable::BINARY:
-				SCIP_CALL(SCIPcreateVar(scip, &v, var->name().c_str(), 0, 1, tmp_obj_coef, SCIP_VARTYPE_BINARY, TRUE, FALSE, 0, 0, 0, 0, 0));
-				break;
+		SCIP_CALL(SCIPsetIntParam(*scip, "timing/clocktype", SCIP_CLOCKTYPE_WALL));
+
+		SCIP_EVENTHDLR* eventhdlr = 0;
+		SCIP_CALL(SCIPincludeEventhdlrBasic(*scip, &eventhdlr, "search", "reports the improving solutions and polls the interrupt flag", eventExecSearch, 0));
+		SCIP_CALL(SCIPsetEventhdlrInit(*scip, eventhdlr, eventInitSearch));
+		SCIP_CALL(SCIPsetEventhdlrExit(*scip, eventhdlr, eventExitSearch));
+		return SCIP_OKAY;
+	}
+
+
+	// Formulates the program directly in SCIP. The constraints are released as soon as they are added
+	// (SCIP keeps them), and only the variables are kept to retrieve the solution.
+	// A builder given an environment (e.g., the one of a SolverSession) only frees its problem.
+	class SCIPProgramBuilder : public LinearProgramSolver::StreamingBuilder {
+	public:
+		SCIPProgramBuilder(Scip* environment = 0) : scip_(environment), owns_scip_(environment == 0), num_constraints_(0), failed_(false) {}
+
+		~SCIPProgramBuilder() {
+			if (!scip_)
+				return;
+			// since the SCIPcreateVar captures all variables, we have to release them now
+			for (std::size_t i = 0; i < variables_.size(); ++i)
+				SCIPreleaseVar(scip_, &variables_[i]);
+			// remember this has always to be the last call to scip
+			if (owns_scip_)
+				SCIPfree(&scip_);
+			else
+				SCIPfreeProb(scip_);
+		}
+
+		bool initialize(const std::string& name, bool reoptimization = false) {
+			if (owns_scip_) {
+				call(create_environment(&scip_));
+				if (failed_)
+					return false;
+			}
+
+			// create empty problem 
+			call(SCIPcreateProbBasic(scip_, name.empty() ? "unknown" : name.c_str()));
+			if (reoptimization)
+				call(SCIPenableReoptimization(scip_, TRUE));
+			return !failed_;
+		}
+
+		// the next solve of a reoptimized problem minimizes (or maximizes) "objective" instead
+		void change_objective(const LinearObjective& objective) {
+			std::vector<double> coeffs(variables_.size(), 0.0);
+			const SparseRow obj_coeffs = objective.coefficients();
+			for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+				coeffs[obj_coeffs.index(k)] = obj_coeffs.value(k);
+			SCIP_OBJSENSE sense = objective.sense() == LinearObjective::MAXIMIZE ? SCIP_OBJSENSE_MAXIMIZE : SCIP_OBJSENSE_MINIMIZE;
+			call(SCIPchgReoptObjective(scip_, sense, variables_.data(), coeffs.data(), static_cast<int>(variables_.size())));
+		}
+
+		LinearProgramSolver::SolverName solver() const { return LinearProgramSolver::SCIP; }
+
+		std::size_t add_variables(std::size_t n, Variable::VariableType vt, Variable::BoundType bt, double lb, double ub) {
+			std::size_t first = variables_.size();
+			effective_bounds(bt, lb, ub);
+			SCIP_VARTYPE type = SCIP_VARTYPE_CONTINUOUS;
+			switch (vt) {
+			case Variable::CONTINUOUS:	type = SCIP_VARTYPE_CONTINUOUS; break;
+			case Variable::INTEGER:		type = SCIP_VARTYPE_INTEGER; break;
+			case Variable::BINARY:		type = SCIP_VARTYPE_BINARY; lb = 0; ub = 1; break;
 			}
-			// add the SCIP_VAR object to the scip problem
-			SCIP_CALL(SCIPaddVar(scip, v));
-
-			// storing the SCIP_VAR pointer for later access
-			scip_variables.push_back(v);
-		}
-
-		// Add constraints
-
-		std::vector<SCIP_CONS*> scip_constraints;
-		const std::vector<LinearConstraint*>& constraints = program->constraints();
-		for (std::size_t i = 0; i < constraints.size(); ++i) {
-			const LinearConstraint* c = constraints[i];
-			const std::unordered_map<int, double>& coeffs = c->coefficients();
-			std::unordered_map<int, double>::const_iterator cur = coeffs.begin();
-
-			std::vector<SCIP_VAR*>	cstr_variables(coeffs.size());
-			std::vector<double>		cstr_values(coeffs.size());
-			std::size_t idx = 0;
-			for (; cur != coeffs.end(); ++cur) {
-				std::size_t var_idx = cur->first;
-				double coeff = cur->second;
-				cstr_variables[idx] = scip_variables[var_idx];
-				cstr_values[idx] = coeff;
-				++idx;
+
+			for (std::size_t i = 0; i < n && !failed_; ++i) {
+				const std::string& name = store_names() ? "x" + std::to_string(variables_.size()) : std::string();
+				SCIP_VAR* v = 0;
+				// The true objective coefficient will be set later by add_objective_coefficient().
+				call(SCIPcreateVar(scip_, &v, name.c_str(), lb, ub, 0.0, type, TRUE, FALSE, 0, 0, 0, 0, 0));
+				if (failed_)
+					break;
+				// add the SCIP_VAR object to the scip problem
+				call(SCIPaddVar(scip_, v));
+				// storing the SCIP_VAR pointer for later access
+				variables_.push_back(v);
 			}
+			return first;
+		}
 
-			// create SCIP_CONS object
+		void add_constraint(LinearConstraint::BoundType bt, double lb, double ub, const std::vector<int>& var_indices, const std::vector<double>& coeffs, bool lazy) {
+			if (failed_)
+				return;
+			effective_bounds(bt, lb, ub);
+			cstr_variables_.resize(var_indices.size());
+			for (std::size_t k = 0; k < var_indices.size(); ++k)
+				cstr_variables_[k] = variables_[var_indices[k]];
+
+			const std::string& name = store_names() ? "c" + std::to_string(num_constraints_) : std::string();
 			SCIP_CONS* cons = 0;
-			const std::string& name = c->name();
+			call(SCIPcreateConsLinear(scip_, &cons, name.c_str(), static_cast<int>(var_indices.size()), cstr_variables_.data(), const_cast<double*>(coeffs.data()), lb, ub, 
+				lazy ? FALSE : TRUE,	// initial: a lazy constraint is not in the initial LP ...
+				TRUE,					// separate: ... the constraint handler adds it once it is violated
+				TRUE, TRUE, TRUE, FALSE, FALSE, FALSE, 
+				lazy ? TRUE : FALSE,	// removable: it may leave the LP again when it is not tight
+				FALSE));
+			if (failed_)
+				return;
+			call(SCIPaddCons(scip_, cons));			// add the constraint to scip
+			call(SCIPreleaseCons(scip_, &cons));	// scip holds it from now on
+			++num_constraints_;
+		}
+
+		void set_objective_sense(LinearObjective::Sense sense) {
+			if (!failed_)
+				call(SCIPsetObjsense(scip_, sense == LinearObjective::MAXIMIZE ? SCIP_OBJSENSE_MAXIMIZE : SCIP_OBJSENSE_MINIMIZE));
+		}
+
+		void add_objective_coefficient(int var_index, double coeff) {
+			if (!failed_)
+				call(SCIPaddVarObj(scip_, variables_[var_index], coeff));
+		}
 
-			double lb, ub;
-			c->get_bounds(lb, ub);
+		std::size_t num_variables() const { return variables_.size(); }
+		std::size_t num_constraints() const { return num_constraints_; }
 
-//			SCIP_CALL(SCIPfreeTransform(scip));
-			SCIP_CALL(SCIPcreateConsLinear(scip, &cons, name.c_str(), coeffs.size(), cstr_variables.data(), cstr_values.data(), lb, ub, TRUE, TRUE, TRUE, TRUE, TRUE, FALSE, FALSE, FALSE, FALSE, FALSE));
-			SCIP_CALL(SCIPaddCons(scip, cons));			// add the constraint to scip
+		bool failed() const { return failed_; }
+		Scip* scip() { return scip_; }
+		const std::vector<SCIP_VAR*>& variables() const { return variables_; }
 
-			// store the constraint for later on
-			scip_constraints.push_back(cons);
+	private:
+		void call(SCIP_RETCODE retcode) {
+			if (retcode != SCIP_OKAY) {
+				SCIPerrorMessage("Error <%d> in function call\n", retcode);
+				failed_ = true;
+			}
+		}
+
+		// SCIP wants both bounds (the unused one of LOWER and UPPER is infinite)
+		static void effective_bounds(Bound::BoundType bt, double& lb, double& ub) {
+			switch (bt) {
+			case Bound::FIXED:	ub = lb; break;
+			case Bound::LOWER:	ub = +Bound::infinity(); break;
+			case Bound::UPPER:	lb = -Bound::infinity(); break;
+			case Bound::DOUBLE:	break;
+			case Bound::FREE:
+			default:
+				lb = -Bound::infinity(); 
+				ub = +Bound::infinity(); 
+				break;
+			}
 		}
 
-		// set objective
+	private:
+		Scip*					scip_;
+		bool					owns_scip_;
+		std::vector<SCIP_VAR*>	variables_;
+		std::vector<SCIP_VAR*>	cstr_variables_;	// the buffer of a row
+		std::size_t				num_constraints_;
+		bool					failed_;
+	};
 
-		// determine the coefficient of each variable in the objective function
-		const LinearObjective* objective = program->objective();
-		const std::unordered_map<int, double>& obj_coeffs = objective->coefficients();
-		std::unordered_map<int, double>::const_iterator it = obj_coeffs.begin();
-		for (; it != obj_coeffs.end(); ++it) {
-			std::size_t var_idx = it->first;
-			double coeff = it->second;
-//			SCIP_CALL(SCIPfreeTransform(scip));
-			SCIP_CALL(SCIPchgVarObj(scip, scip_variables[var_idx], coeff));
+}
+
+
+LinearProgramSolver::StreamingBuilder* LinearProgramSolver::_create_SCIP_builder(const std::string& name) const {
+	SCIPProgramBuilder* builder = new SCIPProgramBuilder;
+	if (!builder->initialize(name)) {
+		Logger::err("-") << "failed creating the SCIP problem" << std::endl;
+		delete builder;
+		return 0;
+	}
+	return builder;
+}
+
+
+bool LinearProgramSolver::_solve_SCIP(const LinearProgram* program) {
+	if (!check_program(program))
+		return false;
+
+	SCIPProgramBuilder* builder = 0;
+	if (session_) {
+		// a reoptimized problem is kept by the session, and only its objective changes
+		SCIPProgramBuilder* previous = static_cast<SCIPProgramBuilder*>(session_->problem_);
+		if (previous && !previous->failed() && previous->num_variables() == program->num_variables() && previous->num_constraints() == program->num_constraints()) {
+			builder = previous;
+			builder->change_objective(*program->objective());
+		}
+		else {
+			delete previous;
+			session_->problem_ = 0;
+			if (!session_->scip_ && create_environment(&session_->scip_) != SCIP_OKAY) {
+				Logger::err("-") << "failed creating the SCIP environment" << std::endl;
+				session_->clear();
+				return false;
+			}
+			builder = new SCIPProgramBuilder(session_->scip_);
+			if (!builder->initialize(program->name(), session_->reoptimization_)) {
+				Logger::err("-") << "failed creating the SCIP problem" << std::endl;
+				delete builder;
+				return false;
+			}
+			builder->set_store_names(options_.store_names);
+			build_program(*program, *builder);
 		}
+	}
+	else {
+		builder = static_cast<SCIPProgramBuilder*>(_create_SCIP_builder(program->name()));
+		if (!builder)
+			return false;
+		builder->set_store_names(options_.store_names);
+		build_program(*program, *builder);
+	}
+
+	bool status = _solve_SCIP(builder);
+	if (session_ && session_->reoptimization_)
+		session_->problem_ = builder;
+	else
+		delete builder;
+
+	if (status)
+		upload_solution(program);
+	return status;
+}
 
-		// set the objective sense
-//		SCIP_CALL(SCIPfreeTransform(scip));
-		bool minimize = (objective->sense() == LinearObjective::MINIMIZE);
-		SCIP_CALL(SCIPsetObjsense(scip, minimize ? SCIP_OBJSENSE_MINIMIZE : SCIP_OBJSENSE_MAXIMIZE));
+
+bool LinearProgramSolver::_solve_SCIP(StreamingBuilder* streaming_builder) {
+	try {
+		SCIPProgramBuilder* builder = static_cast<SCIPProgramBuilder*>(streaming_builder);
+		if (builder->failed()) {
+			Logger::err("-") << "failed formulating the problem in SCIP" << std::endl;
+			return false;
+		}
+
+		Scip* scip = builder->scip();
+		const std::vector<SCIP_VAR*>& scip_variables = builder->variables();
 
 		// set SCIP parameters
 		double tolerance = 1e-7;
 		SCIP_CALL(SCIPsetRealParam(scip, "numerics/feastol", tolerance));
 		SCIP_CALL(SCIPsetRealParam(scip, "numerics/dualfeastol", tolerance));
-		double MIP_gap = 1e-4;
+		double MIP_gap = (options_.relative_gap >= 0.0) ? options_.relative_gap : 1e-4;
 		SCIP_CALL(SCIPsetRealParam(scip, "limits/gap", MIP_gap));
+		// the environment may be reused (see SolverSession), so the limits not given are reset
+		if (options_.time_limit > 0.0)
+			SCIP_CALL(SCIPsetRealParam(scip, "limits/time", options_.time_limit));
+		else
+			SCIP_CALL(SCIPresetParam(scip, "limits/time"));
+		if (options_.node_limit > 0)
+			SCIP_CALL(SCIPsetLongintParam(scip, "limits/nodes", options_.node_limit));
+		else
+			SCIP_CALL(SCIPresetParam(scip, "limits/nodes"));
+
+		// the concurrent solve runs in parallel only if SCIP is built with a task processing interface
+		// (e.g., TPI_TNYC using the vendored tinycthread), otherwise it falls back to the sequential solve.
+		// It can't be combined with reoptimization.
+		bool reoptimization = SCIPisReoptEnabled(scip);
+		bool concurrent = (options_.num_threads > 1 && !reoptimization);
+		if (concurrent)
+			SCIP_CALL(SCIPsetIntParam(scip, "parallel/maxnthreads", static_cast<int>(options_.num_threads)));
+		else
+			SCIP_CALL(SCIPresetParam(scip, "parallel/maxnthreads"));
+		SCIP_CALL(SCIPsetIntParam(scip, "parallel/mode", options_.deterministic ? 1 : 0));	// 1: deterministic, 0: opportunistic
+		SCIP_CALL(SCIPsetIntParam(scip, "randomization/randomseedshift", static_cast<int>(options_.random_seed)));
+
+		SCIP_EVENTHDLRDATA search_data = { 0, options_.interrupt, &scip_variables, 0 };
+		if (options_.incumbent_callback)
+			search_data.callback = &options_.incumbent_callback;
+		if (options_.progress_callback)
+			search_data.progress = &options_.progress_callback;
+		SCIP_EVENTHDLR* eventhdlr = SCIPfindEventhdlr(scip, "search");
+		if (eventhdlr)
+			SCIPeventhdlrSetData(eventhdlr, &search_data);
 
 		// Always turn presolve on (it's the SCIP default).
 		bool presolve = true;
@@ -144,40 +365,74 @@ bool LinearProgramSolver::_solve_SCIP(const LinearProgram* program) {
 		else 
 			SCIP_CALL(SCIPsetIntParam(scip, "presolving/maxrounds", 0));  // disable presolve
 
-		Logger::out("-") << "using the SCIP solver" << std::endl;
+		// hand over the starting point (if provided) as a primal solution
+		if (has_initial_solution(scip_variables.size())) {
+			SCIP_SOL* start = 0;
+			SCIP_CALL(SCIPcreateOrigSol(scip, &start, 0));
+			for (std::size_t i = 0; i < scip_variables.size(); ++i)
+				SCIP_CALL(SCIPsetSolVal(scip, start, scip_variables[i], initial_solution_[i]));
+			SCIP_Bool stored = FALSE;
+			SCIP_CALL(SCIPaddSolFree(scip, &start, &stored));
+			if (!stored && verbose_)
+				Logger::warn("-") << "the initial solution was rejected by SCIP" << std::endl;
+		}
+
+		// the hints (if provided) guide the branching: the priorities order the variables and the hinted
+		// values give the direction of the first child
+		if (has_variable_hints(scip_variables.size())) {
+			for (std::size_t i = 0; i < scip_variables.size(); ++i) {
+				if (priorities_[i] != 0)
+					SCIP_CALL(SCIPchgVarBranchPriority(scip, scip_variables[i], priorities_[i]));
+				if (hints_[i] >= 0.0) {
+					const double lb = SCIPvarGetLbOriginal(scip_variables[i]);
+					const double ub = SCIPvarGetUbOriginal(scip_variables[i]);
+					const bool upwards = (hints_[i] - lb >= ub - hints_[i]);
+					SCIP_CALL(SCIPchgVarBranchDirection(scip, scip_variables[i], upwards ? SCIP_BRANCHDIR_UPWARDS : SCIP_BRANCHDIR_DOWNWARDS));
+				}
+			}
+		}
+
+		if (verbose_)
+			Logger::out("-") << "using the SCIP solver" << std::endl;
 
 		bool status = false;
 		// this tells scip to start the solution process
-		if (SCIPsolve(scip) == SCIP_OKAY) {
+		SCIP_RETCODE retcode = concurrent ? SCIPsolveConcurrent(scip) : SCIPsolve(scip);
+		if (retcode == SCIP_OKAY) {
 			// get the best found solution from scip
 			SCIP_SOL* sol = SCIPgetBestSol(scip);
 			if (sol) {
 				// If optimal or feasible solution is found.
 				objective_value_ = SCIPgetSolOrigObj(scip, sol);
-				result_.resize(variables.size());
-				for (std::size_t i = 0; i < variables.size(); ++i) {
+				result_.resize(scip_variables.size());
+				for (std::size_t i = 0; i < scip_variables.size(); ++i) {
 					result_[i] = SCIPgetSolVal(scip, sol, scip_variables[i]);
 				}
 				status = true;
-				upload_solution(program);
 			}
 		}
 
 		// report the status: optimal, infeasible, etc.
 		SCIP_STATUS scip_status = SCIPgetStatus(scip);
+		// a limit (time, nodes, etc.) returns the best solution found so far
+		status_ = status ? STATUS_LIMIT_REACHED : STATUS_FAILED;
 		switch (scip_status) {
 		case SCIP_STATUS_OPTIMAL:
 			// provides info only if fails.
+			status_ = STATUS_OPTIMAL;
 			break;
 		case SCIP_STATUS_GAPLIMIT:
 			// To be consistent with the other solvers.
 			// provides info only if fails.
+			status_ = STATUS_OPTIMAL;
 			break;
 		case SCIP_STATUS_INFEASIBLE:
 			std::cerr << "model was infeasible" << std::endl;
+			status_ = STATUS_INFEASIBLE;
 			break;
 		case SCIP_STATUS_UNBOUNDED:
 			std::cerr << "model was unbounded" << std::endl;
+			status_ = STATUS_UNBOUNDED;
 			break;
 		case SCIP_STATUS_INFORUNBD:
 			std::cerr << "model was either infeasible or unbounded" << std::endl;
@@ -185,27 +440,28 @@ bool LinearProgramSolver::_solve_SCIP(const LinearProgram* program) {
 		case SCIP_STATUS_TIMELIMIT:
 			std::cerr << "aborted due to time limit" << std::endl;
 			break;
+		case SCIP_STATUS_NODELIMIT:
+		case SCIP_STATUS_TOTALNODELIMIT:
+			std::cerr << "aborted due to node limit" << std::endl;
+			break;
+		case SCIP_STATUS_USERINTERRUPT:
+			if (verbose_)
+				std::cerr << "interrupted" << std::endl;
+			break;
 		default:
 			std::cerr << "aborted with status: " << scip_status << std::endl;
 			break;
 		}
 
-		SCIP_CALL(SCIPresetParams(scip));
-
-		// since the SCIPcreateVar captures all variables, we have to release them now
-		for (std::size_t i = 0; i < scip_variables.size(); ++i)
-			SCIP_CALL(SCIPreleaseVar(scip, &scip_variables[i]));
-		scip_variables.clear();
-
-		// the same for the constraints
-		for (std::size_t i = 0; i < scip_constraints.size(); ++i) 
-			SCIP_CALL(SCIPreleaseCons(scip, &scip_constraints[i]));
-		scip_constraints.clear();
-
-		// after releasing all vars and cons we can free the scip problem
-	   // remember this has always to be the last call to scip
-		SCIP_CALL(SCIPfree(&scip));
-
+		// The event handler is done with its data (which lives on this stack) once the search is freed. A 
+		// reoptimized problem keeps what the next run reuses, and the other ones are freed with the builder 
+		// (which also releases the variables).
+		if (reoptimization)
+			SCIP_CALL(SCIPfreeReoptSolve(scip));
+		else
+			SCIP_CALL(SCIPfreeTransform(scip));
+		if (eventhdlr)
+			SCIPeventhdlrSetData(eventhdlr, 0);
 		return status;
 	}
 	catch (std::exception e) {
@@ -216,3 +472,28 @@ bool LinearProgramSolver::_solve_SCIP(const LinearProgram* program) {
 	}
 	return false;
 }
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+SolverSession::~SolverSession() {
+	clear();
+}
+
+
+void SolverSession::set_reoptimization(bool b) {
+	if (b != reoptimization_) {
+		clear();
+		reoptimization_ = b;
+	}
+}
+
+
+void SolverSession::clear() {
+	delete problem_;	// before the environment it belongs to
+	problem_ = 0;
+	if (scip_)
+		SCIPfree(&scip_);
+	scip_ = 0;
+}
@@ -45,6 +45,7 @@
 #include "line.h"
 #include "plane.h"
 #include "matrix.h"
+#include "../basic/small_vector.h"
 
 /**
  * Gathers different base types for geometric operations. 
@@ -171,11 +172,31 @@ typedef GenericBox2d<Numeric::float32>		Box2d;
 typedef GenericBox3d<Numeric::float32>		Box3d;
 
 
+//____________________ precision of the geometric computations ___________________
+
+// The points are stored in single precision (vec3), which keeps the point clouds small, while the 
+// geometric computations of the reconstruction (e.g., the intersections of the supporting planes) 
+// run in double precision, unless POLYFIT_FLOAT_GEOMETRY is defined at compile time.
+#ifdef POLYFIT_FLOAT_GEOMETRY
+typedef Numeric::float32					geom_real;
+#else
+typedef Numeric::float64					geom_real;
+#endif
+
+typedef vecng<3, geom_real>					geom_vec3;
+typedef GenericPlane3<geom_real>			geom_plane3;
+
+
 // typedef std::vector<vec2> Polygon2d ;
 class Polygon2d : public std::vector < vec2 > {};
 // typedef std::vector<vec3> Polygon3d ;
 class Polygon3d : public std::vector < vec3 > {};
 
+// the polygons of facet-local work (the facets rarely have more than 12 vertices), 
+// which don't allocate any memory unless they are larger
+typedef SmallVector<vec2, 16>				SmallPolygon2d;
+typedef SmallVector<vec3, 16>				SmallPolygon3d;
+
 
 //_________________________________________________________
 
@@ -369,6 +390,14 @@ namespace Geom {
 		return plg2d;
 	}
 
+	// the same as above, writing into the caller's polygon 'plg2d' (e.g., a SmallPolygon2d)
+	template <class Polygon3, class Polygon2>
+	inline void  to_2d(const vec3& orig, const vec3& base1, const vec3& base2, const Polygon3& plg3d, Polygon2& plg2d) {
+		plg2d.resize(plg3d.size());
+		for (std::size_t i = 0; i < plg3d.size(); ++i)
+			plg2d[i] = Geom::to_2d(orig, base1, base2, plg3d[i]);
+	}
+
 
 	// the 3D coordinates of a 2D point 'p' w.r.t. the coordinate system defined by (orig, base1, base2)
 	inline vec3 to_3d(const vec3& orig, const vec3& base1, const vec3& base2, const vec2& p) {
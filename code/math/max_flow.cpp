@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "max_flow.h"
+
+#include <algorithm>
+#include <limits>
+
+
+namespace {
+	const std::size_t npos = std::size_t(-1);
+}
+
+
+MaxFlow::MaxFlow(std::size_t num_nodes)
+	: source_(num_nodes)
+	, sink_(num_nodes + 1)
+	, first_(num_nodes + 2, npos)
+	, source_caps_(num_nodes, 0.0)
+	, sink_caps_(num_nodes, 0.0)
+	, constant_(0.0)
+{
+}
+
+
+void MaxFlow::add_terminal_weights(std::size_t node, double source_cap, double sink_cap) {
+	source_caps_[node] += source_cap;
+	sink_caps_[node] += sink_cap;
+}
+
+
+void MaxFlow::add_edge(std::size_t from, std::size_t to, double cap, double reverse_cap) {
+	if (from != to)
+		add_arc_pair(from, to, cap, reverse_cap);
+}
+
+
+void MaxFlow::add_arc_pair(std::size_t from, std::size_t to, double cap, double reverse_cap) {
+	Arc a = { to, first_[from], cap };
+	first_[from] = arcs_.size();
+	arcs_.push_back(a);
+	Arc b = { from, first_[to], reverse_cap };
+	first_[to] = arcs_.size();
+	arcs_.push_back(b);
+}
+
+
+bool MaxFlow::build_levels() {
+	level_.assign(first_.size(), -1);
+	std::vector<std::size_t> queue(1, source_);
+	level_[source_] = 0;
+	for (std::size_t head = 0; head < queue.size(); ++head) {
+		std::size_t v = queue[head];
+		for (std::size_t a = first_[v]; a != npos; a = arcs_[a].next) {
+			const Arc& arc = arcs_[a];
+			if (arc.residual > 0 && level_[arc.to] < 0) {
+				level_[arc.to] = level_[v] + 1;
+				queue.push_back(arc.to);
+			}
+		}
+	}
+	return level_[sink_] >= 0;
+}
+
+
+// the blocking flow is pushed along the paths of increasing levels (iteratively, as the paths may be long)
+double MaxFlow::augment(std::size_t start, double limit) {
+	std::vector<std::size_t> path;	// the arcs from 'start'
+	double total = 0.0;
+	std::size_t v = start;
+	while (true) {
+		if (v == sink_) {
+			double pushed = limit;
+			for (std::size_t k = 0; k < path.size(); ++k)
+				pushed = std::min(pushed, arcs_[path[k]].residual);
+			for (std::size_t k = 0; k < path.size(); ++k) {
+				arcs_[path[k]].residual -= pushed;
+				arcs_[path[k] ^ 1].residual += pushed;
+			}
+			total += pushed;
+			limit -= pushed;
+			if (limit <= 0)
+				return total;
+			// restarts from the tail of the first saturated arc
+			std::size_t k = 0;
+			while (k < path.size() && arcs_[path[k]].residual > 0)
+				++k;
+			path.resize(k);
+			v = path.empty() ? start : arcs_[path.back()].to;
+			continue;
+		}
+
+		std::size_t& a = current_[v];
+		while (a != npos && (arcs_[a].residual <= 0 || level_[arcs_[a].to] != level_[v] + 1))
+			a = arcs_[a].next;
+		if (a != npos) {
+			path.push_back(a);
+			v = arcs_[a].to;
+			continue;
+		}
+
+		// a dead end: it is skipped from now on
+		if (path.empty())
+			return total;
+		level_[v] = -1;
+		path.pop_back();
+		v = path.empty() ? start : arcs_[path.back()].to;
+		current_[v] = arcs_[current_[v]].next;
+	}
+}
+
+
+double MaxFlow::compute() {
+	// the terminal arcs (the common part of the two capacities of a node is cut either way)
+	for (std::size_t v = 0; v < source_caps_.size(); ++v) {
+		double common = std::min(source_caps_[v], sink_caps_[v]);
+		constant_ += common;
+		if (source_caps_[v] > common)
+			add_arc_pair(source_, v, source_caps_[v] - common, 0.0);
+		if (sink_caps_[v] > common)
+			add_arc_pair(v, sink_, sink_caps_[v] - common, 0.0);
+	}
+	source_caps_.assign(source_caps_.size(), 0.0);
+	sink_caps_.assign(sink_caps_.size(), 0.0);
+
+	double flow = 0.0;
+	while (build_levels()) {
+		current_ = first_;
+		flow += augment(source_, std::numeric_limits<double>::max());
+	}
+	// the nodes reachable from the source in the residual graph are on its side (see is_source_side())
+	build_levels();
+	return flow + constant_;
+}
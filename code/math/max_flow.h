@@ -0,0 +1,80 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MATH_MAX_FLOW_H_
+#define _MATH_MAX_FLOW_H_
+
+#include "math_common.h"
+
+#include <vector>
+
+
+// The maximum flow (i.e., the minimum s-t cut) of a graph with capacities, by Dinic's algorithm. It 
+// minimizes the energies of binary labelings with submodular pairwise terms: each node pays its
+// source capacity if it ends on the sink side, and its sink capacity if it ends on the source side, 
+// and each edge pays its capacity if its nodes end on different sides.
+// Example: <pre>
+//   MaxFlow graph(2);
+//   graph.add_terminal_weights(0, 5.0, 1.0);
+//   graph.add_edge(0, 1, 2.0, 2.0);
+//   double energy = graph.compute();
+//   bool source_side = graph.is_source_side(1);
+// </pre>
+class MATH_API MaxFlow
+{
+public:
+	MaxFlow(std::size_t num_nodes = 0);
+
+	std::size_t num_nodes() const { return first_.size() - 2; }
+
+	// the capacities are added to those given before (they must not be negative)
+	void add_terminal_weights(std::size_t node, double source_cap, double sink_cap);
+	void add_edge(std::size_t from, std::size_t to, double cap, double reverse_cap);
+
+	// returns the value of the maximum flow (i.e., the cost of the minimum cut)
+	double compute();
+
+	// after compute(): true if the node is on the source side of the minimum cut
+	bool is_source_side(std::size_t node) const { return level_[node] >= 0; }
+
+private:
+	void add_arc_pair(std::size_t from, std::size_t to, double cap, double reverse_cap);
+	bool build_levels();
+	double augment(std::size_t node, double limit);
+
+private:
+	struct Arc {
+		std::size_t to;
+		std::size_t next;		// the next arc of the same node
+		double		residual;
+	};
+
+	std::size_t			source_, sink_;
+	std::vector<Arc>	arcs_;		// the arcs 2k and 2k + 1 are reverse of each other
+	std::vector<std::size_t> first_;	// the first arc of each node (npos if none)
+	std::vector<std::size_t> current_;
+	std::vector<int>	level_;
+
+	// the terminal weights, paired into a single arc per node when the graph is built
+	std::vector<double>	source_caps_, sink_caps_;
+	double				constant_;	// the flow that goes directly from the source to the sink
+};
+
+
+#endif
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "math_common.h"
 #include "vecg.h"
 #include <cassert>
+#include <cmath>
 
 // A 3D Plane of equation a.x + b.y + c.z + d = 0
 template <class FT>
@@ -41,6 +42,11 @@ public:
 	GenericPlane3(const Point3& p, const Vector3& n);
 	GenericPlane3(FT a, FT b, FT c, FT d) { coeff_[0] = a;	coeff_[1] = b;	coeff_[2] = c;	coeff_[3] = d; }
 	GenericPlane3() {}
+	// the same plane in another precision
+	template <class FT2> explicit GenericPlane3(const GenericPlane3<FT2>& plane) {
+		for (int i = 0; i < 4; ++i)
+			coeff_[i] = FT(plane.data()[i]);
+	}
 
 	inline FT a() const { return coeff_[0]; }
 	inline FT b() const { return coeff_[1]; }
@@ -81,6 +87,28 @@ public:
 	// squared distance of a point 'p' to this plane
 	FT	squared_ditance(const Point3 &p) const;
 
+	//______ batch versions, over the points pts[indices[0]], ..., pts[indices[n - 1]] (or the first n
+	// points of 'pts' if 'indices' is nil). The iterations are independent, and the reductions spread
+	// over several accumulators, so the compiler vectorizes the loops for the target instruction set.
+
+	// the signed distances of the points (positive on the positive side)
+	void signed_distances(const Point3* pts, const unsigned int* indices, std::size_t n, FT* distances) const;
+	// the largest distance of the points (0 if there is none)
+	FT	max_distance(const Point3* pts, const unsigned int* indices, std::size_t n) const;
+	// the number of points closer than 'threshold'. It stops counting once 'max_count' is exceeded 
+	// (so the result is at most max_count + 1).
+	std::size_t count_within(const Point3* pts, const unsigned int* indices, std::size_t n, FT threshold, 
+		std::size_t max_count = ~std::size_t(0)) const;
+	// the numbers of points on the positive and the negative sides, farther than 'threshold'
+	void count_sides(const Point3* pts, const unsigned int* indices, std::size_t n, FT threshold, 
+		std::size_t& positive, std::size_t& negative) const;
+
+	// the same over points padded to 4 coordinates (x, y, z, unused), e.g., PointSet::padded_points(), 
+	// so that each point is one aligned load of 16 bytes (for float)
+	void signed_distances_padded(const FT* padded, const unsigned int* indices, std::size_t n, FT* distances) const;
+	std::size_t count_within_padded(const FT* padded, const unsigned int* indices, std::size_t n, FT threshold,
+		std::size_t max_count = ~std::size_t(0)) const;
+
 	// compute the intersection with 'line'.
 	// returns false if the line is parallel with this plane.
 	// NOTE: both line and the plane are unlimited.
@@ -115,6 +143,48 @@ private:
 
 
 
+// The intersection points of 'plane1', 'plane2' and each of the 'n' planes 'planes' (by Cramer's rule,
+// directly from their coefficients). 'valid[i]' is 1 if the i-th triplet meets at a single point, which
+// is then 'points[i]', and 0 if the normals are linearly dependent, or nearly so: the determinant of the 
+// normals is not above 'min_det' times the product of their lengths. The cross product of the first two
+// normals is shared by the triplets, and the loop has no branch, so the compiler vectorizes it.
+template <class FT> inline
+void plane_triplet_intersections(const GenericPlane3<FT>& plane1, const GenericPlane3<FT>& plane2, const GenericPlane3<FT>* planes, 
+	std::size_t n, FT min_det, vecng<3, FT>* points, unsigned char* valid) 
+{
+	const FT x1 = plane1.a(), y1 = plane1.b(), z1 = plane1.c(), d1 = plane1.d();
+	const FT x2 = plane2.a(), y2 = plane2.b(), z2 = plane2.c(), d2 = plane2.d();
+	const FT x12 = y1 * z2 - z1 * y2, y12 = z1 * x2 - x1 * z2, z12 = x1 * y2 - y1 * x2;
+	const FT sqr_min_det = min_det * min_det * (x1 * x1 + y1 * y1 + z1 * z1) * (x2 * x2 + y2 * y2 + z2 * z2);
+	for (std::size_t i = 0; i < n; ++i) {
+		const FT* c = planes[i].data();
+		const FT x3 = c[0], y3 = c[1], z3 = c[2], d3 = c[3];
+		const FT x23 = y2 * z3 - z2 * y3, y23 = z2 * x3 - x2 * z3, z23 = x2 * y3 - y2 * x3;
+		const FT x31 = y3 * z1 - z3 * y1, y31 = z3 * x1 - x3 * z1, z31 = x3 * y1 - y3 * x1;
+		const FT det = x1 * x23 + y1 * y23 + z1 * z23;
+		const bool ok = det * det > sqr_min_det * (x3 * x3 + y3 * y3 + z3 * z3);
+		const FT div = ok ? det : FT(1);
+		points[i] = vecng<3, FT>(
+			(x23 * (-d1) - x31 * d2 - x12 * d3) / div,
+			(y23 * (-d1) - y31 * d2 - y12 * d3) / div,
+			(z23 * (-d1) - z31 * d2 - z12 * d3) / div
+			);
+		valid[i] = ok ? 1 : 0;
+	}
+}
+
+
+// computes the intersection point 'p' of three planes (see plane_triplet_intersections(), which gives the
+// same point). returns false if they don't meet at a single point (their normals are linearly dependent,
+// or nearly so with respect to 'min_det').
+template <class FT> inline
+bool plane_triplet_intersection(const GenericPlane3<FT>& plane1, const GenericPlane3<FT>& plane2, const GenericPlane3<FT>& plane3, vecng<3, FT>& p, FT min_det = FT(0)) {
+	unsigned char valid = 0;
+	plane_triplet_intersections(plane1, plane2, &plane3, 1, min_det, &p, &valid);
+	return valid != 0;
+}
+
+
 template <class FT>	std::ostream& operator<<(std::ostream& os, const GenericPlane3<FT>& plane);
 template <class FT>	std::istream& operator>>(std::istream& is, GenericPlane3<FT>& plane);
 
@@ -268,6 +338,176 @@ FT GenericPlane3<FT>::squared_ditance(const Point3& p) const {
 }
 
 
+namespace PlaneKernels {
+
+	// the points of the batch versions: a span of points, or the points of a list of indices
+	template <class Point3>
+	struct Span {
+		Span(const Point3* pts) : pts_(pts) {}
+		const Point3& operator()(std::size_t i) const { return pts_[i]; }
+		const Point3* pts_;
+	};
+
+	template <class Point3>
+	struct Gather {
+		Gather(const Point3* pts, const unsigned int* indices) : pts_(pts), indices_(indices) {}
+		const Point3& operator()(std::size_t i) const { return pts_[indices_[i]]; }
+		const Point3* pts_;
+		const unsigned int* indices_;
+	};
+
+	// the points given as 4 coordinates each (the 4th being ignored)
+	template <class FT, class Point3>
+	struct PaddedGather {
+		PaddedGather(const FT* padded, const unsigned int* indices) : padded_(padded), indices_(indices) {}
+		Point3 operator()(std::size_t i) const { 
+			const FT* p = padded_ + 4 * std::size_t(indices_[i]);
+			return Point3(p[0], p[1], p[2]);
+		}
+		const FT* padded_;
+		const unsigned int* indices_;
+	};
+
+	template <class FT, class Points> inline
+	FT max_abs_value(const FT* c, const Points& points, std::size_t n) {
+		const int lanes = 4;
+		FT m[lanes] = { FT(0), FT(0), FT(0), FT(0) };
+		std::size_t i = 0;
+		for (; i + lanes <= n; i += lanes) {
+			for (int l = 0; l < lanes; ++l) {
+				const typename GenericPlane3<FT>::Point3& p = points(i + l);
+				FT v = std::abs(c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3]);
+				m[l] = v > m[l] ? v : m[l];
+			}
+		}
+		for (; i < n; ++i) {
+			const typename GenericPlane3<FT>::Point3& p = points(i);
+			FT v = std::abs(c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3]);
+			m[0] = v > m[0] ? v : m[0];
+		}
+		FT m01 = m[0] > m[1] ? m[0] : m[1];
+		FT m23 = m[2] > m[3] ? m[2] : m[3];
+		return m01 > m23 ? m01 : m23;
+	}
+
+	// the number of points whose squared value is below 'sqr_value', in blocks between the tests of 'max_count'
+	template <class FT, class Points> inline
+	std::size_t count_below(const FT* c, const Points& points, std::size_t n, FT sqr_value, std::size_t max_count) {
+		const std::size_t block_size = 256;
+		std::size_t count = 0;
+		for (std::size_t start = 0; start < n; start += block_size) {
+			std::size_t end = start + block_size < n ? start + block_size : n;
+			for (std::size_t i = start; i < end; ++i) {
+				const typename GenericPlane3<FT>::Point3& p = points(i);
+				FT v = c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3];
+				count += (v * v < sqr_value) ? 1 : 0;
+			}
+			if (count > max_count)
+				return max_count + 1;
+		}
+		return count;
+	}
+
+	template <class FT, class Points> inline
+	void count_sides(const FT* c, const Points& points, std::size_t n, FT sqr_value, std::size_t& positive, std::size_t& negative) {
+		positive = negative = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			const typename GenericPlane3<FT>::Point3& p = points(i);
+			FT v = c[0] * p.x + c[1] * p.y + c[2] * p.z + c[3];
+			bool off = v * v > sqr_value;
+			positive += (off && v > 0) ? 1 : 0;
+			negative += (off && v <= 0) ? 1 : 0;
+		}
+	}
+}
+
+
+template <class FT> inline
+void GenericPlane3<FT>::signed_distances(const Point3* pts, const unsigned int* indices, std::size_t n, FT* distances) const {
+	const FT inv = FT(1) / std::sqrt(coeff_[0] * coeff_[0] + coeff_[1] * coeff_[1] + coeff_[2] * coeff_[2]);
+	const FT a = coeff_[0] * inv, b = coeff_[1] * inv, c = coeff_[2] * inv, d = coeff_[3] * inv;
+	if (indices) {
+		for (std::size_t i = 0; i < n; ++i) {
+			const Point3& p = pts[indices[i]];
+			distances[i] = a * p.x + b * p.y + c * p.z + d;
+		}
+	}
+	else {
+		for (std::size_t i = 0; i < n; ++i)
+			distances[i] = a * pts[i].x + b * pts[i].y + c * pts[i].z + d;
+	}
+}
+
+
+template <class FT> inline
+void GenericPlane3<FT>::signed_distances_padded(const FT* padded, const unsigned int* indices, std::size_t n, FT* distances) const {
+	const FT inv = FT(1) / std::sqrt(coeff_[0] * coeff_[0] + coeff_[1] * coeff_[1] + coeff_[2] * coeff_[2]);
+	const FT a = coeff_[0] * inv, b = coeff_[1] * inv, c = coeff_[2] * inv, d = coeff_[3] * inv;
+	if (indices) {
+		for (std::size_t i = 0; i < n; ++i) {
+			const FT* p = padded + 4 * std::size_t(indices[i]);
+			distances[i] = a * p[0] + b * p[1] + c * p[2] + d;
+		}
+	}
+	else {
+		for (std::size_t i = 0; i < n; ++i) {
+			const FT* p = padded + 4 * i;
+			distances[i] = a * p[0] + b * p[1] + c * p[2] + d;
+		}
+	}
+}
+
+
+template <class FT> inline
+FT GenericPlane3<FT>::max_distance(const Point3* pts, const unsigned int* indices, std::size_t n) const {
+	FT m = indices ?
+		PlaneKernels::max_abs_value(coeff_, PlaneKernels::Gather<Point3>(pts, indices), n) :
+		PlaneKernels::max_abs_value(coeff_, PlaneKernels::Span<Point3>(pts), n);
+	return m / std::sqrt(coeff_[0] * coeff_[0] + coeff_[1] * coeff_[1] + coeff_[2] * coeff_[2]);
+}
+
+
+template <class FT> inline
+std::size_t GenericPlane3<FT>::count_within(const Point3* pts, const unsigned int* indices, std::size_t n, FT threshold, std::size_t max_count) const {
+	// the same test as squared_ditance(p) < threshold * threshold, without the divisions
+	FT sqr_value = threshold * threshold * (coeff_[0] * coeff_[0] + coeff_[1] * coeff_[1] + coeff_[2] * coeff_[2]);
+	return indices ?
+		PlaneKernels::count_below(coeff_, PlaneKernels::Gather<Point3>(pts, indices), n, sqr_value, max_count) :
+		PlaneKernels::count_below(coeff_, PlaneKernels::Span<Point3>(pts), n, sqr_value, max_count);
+}
+
+
+template <class FT> inline
+std::size_t GenericPlane3<FT>::count_within_padded(const FT* padded, const unsigned int* indices, std::size_t n, FT threshold, std::size_t max_count) const {
+	FT sqr_value = threshold * threshold * (coeff_[0] * coeff_[0] + coeff_[1] * coeff_[1] + coeff_[2] * coeff_[2]);
+	if (indices)
+		return PlaneKernels::count_below(coeff_, PlaneKernels::PaddedGather<FT, Point3>(padded, indices), n, sqr_value, max_count);
+
+	const FT* c = coeff_;
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < n; ++i) {
+		const FT* p = padded + 4 * i;
+		FT v = c[0] * p[0] + c[1] * p[1] + c[2] * p[2] + c[3];
+		count += (v * v < sqr_value) ? 1 : 0;
+		if (count > max_count)
+			return max_count + 1;
+	}
+	return count;
+}
+
+
+template <class FT> inline
+void GenericPlane3<FT>::count_sides(const Point3* pts, const unsigned int* indices, std::size_t n, FT threshold, 
+	std::size_t& positive, std::size_t& negative) const 
+{
+	FT sqr_value = threshold * threshold * (coeff_[0] * coeff_[0] + coeff_[1] * coeff_[1] + coeff_[2] * coeff_[2]);
+	if (indices)
+		PlaneKernels::count_sides(coeff_, PlaneKernels::Gather<Point3>(pts, indices), n, sqr_value, positive, negative);
+	else
+		PlaneKernels::count_sides(coeff_, PlaneKernels::Span<Point3>(pts), n, sqr_value, positive, negative);
+}
+
+
 template <class FT> inline
 bool GenericPlane3<FT>::intersection(const Line3& line) const {
 	Vector3 dir = line.direction();
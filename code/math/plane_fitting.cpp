@@ -0,0 +1,301 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "plane_fitting.h"
+#include "../basic/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// the sums of the points, relative to an origin
+	struct Moments {
+		Moments() : n(0) {
+			for (int k = 0; k < 3; ++k) s[k] = 0.0;
+			for (int k = 0; k < 6; ++k) ss[k] = 0.0;
+		}
+		void add(const Moments& other) {
+			n += other.n;
+			for (int k = 0; k < 3; ++k) s[k] += other.s[k];
+			for (int k = 0; k < 6; ++k) ss[k] += other.ss[k];
+		}
+
+		std::size_t n;
+		double s[3];
+		double ss[6];	// xx, xy, yy, xz, yz, zz (as the matrices of MatrixUtil)
+	};
+
+
+	// four independent sets of sums, so consecutive points don't wait for each other
+	void accumulate(const vec3* points, const unsigned int* indices, std::size_t n, const double origin[3], Moments& m) {
+		const int lanes = 4;
+		double s[9][lanes];
+		for (int k = 0; k < 9; ++k) {
+			for (int l = 0; l < lanes; ++l)
+				s[k][l] = 0.0;
+		}
+
+		std::size_t i = 0;
+		for (; i + lanes <= n; i += lanes) {
+			for (int l = 0; l < lanes; ++l) {
+				const vec3& p = points[indices[i + l]];
+				double x = p.x - origin[0], y = p.y - origin[1], z = p.z - origin[2];
+				s[0][l] += x;		s[1][l] += y;		s[2][l] += z;
+				s[3][l] += x * x;	s[4][l] += x * y;	s[5][l] += y * y;
+				s[6][l] += x * z;	s[7][l] += y * z;	s[8][l] += z * z;
+			}
+		}
+		for (int l = 0; i < n; ++i, ++l) {
+			const vec3& p = points[indices[i]];
+			double x = p.x - origin[0], y = p.y - origin[1], z = p.z - origin[2];
+			s[0][l] += x;		s[1][l] += y;		s[2][l] += z;
+			s[3][l] += x * x;	s[4][l] += x * y;	s[5][l] += y * y;
+			s[6][l] += x * z;	s[7][l] += y * z;	s[8][l] += z * z;
+		}
+
+		m.n += n;
+		for (int k = 0; k < 9; ++k) {
+			double sum = (s[k][0] + s[k][1]) + (s[k][2] + s[k][3]);
+			if (k < 3)
+				m.s[k] += sum;
+			else
+				m.ss[k - 3] += sum;
+		}
+	}
+
+
+	Plane3d plane_of(const Moments& m, const double origin[3]) {
+		double mean[3] = { 0.0, 0.0, 0.0 };
+		if (m.n > 0) {
+			for (int k = 0; k < 3; ++k)
+				mean[k] = m.s[k] / m.n;
+		}
+		vec3 center(float(origin[0] + mean[0]), float(origin[1] + mean[1]), float(origin[2] + mean[2]));
+
+		// If the system is under-determined, the trivial basis (as PrincipalAxes3d)
+		if (m.n < 4)
+			return Plane3d(center, vec3(0, 0, 1));
+
+		double cov[6] = {
+			m.ss[0] / m.n - mean[0] * mean[0],
+			m.ss[1] / m.n - mean[0] * mean[1],
+			m.ss[2] / m.n - mean[1] * mean[1],
+			m.ss[3] / m.n - mean[0] * mean[2],
+			m.ss[4] / m.n - mean[1] * mean[2],
+			m.ss[5] / m.n - mean[2] * mean[2]
+		};
+		if (cov[0] <= 0) cov[0] = 1.e-30;
+		if (cov[2] <= 0) cov[2] = 1.e-30;
+		if (cov[5] <= 0) cov[5] = 1.e-30;
+
+		double eigen_values[3];
+		vec3 eigen_vectors[3];
+		PlaneFitting::eigen_symmetric(cov, eigen_values, eigen_vectors);
+		return Plane3d(center, eigen_vectors[2]);
+	}
+
+
+	inline void cross(const double a[3], const double b[3], double c[3]) {
+		c[0] = a[1] * b[2] - a[2] * b[1];
+		c[1] = a[2] * b[0] - a[0] * b[2];
+		c[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline double dot(const double a[3], const double b[3]) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline void normalize(double v[3]) {
+		double len = std::sqrt(dot(v, v));
+		if (len > 0) {
+			v[0] /= len;	v[1] /= len;	v[2] /= len;
+		}
+	}
+
+
+	// a unit eigen vector of the eigen value 'e' (of multiplicity 1) of the symmetric matrix 'a': 
+	// the largest cross product of two rows of (a - e I)
+	void eigen_vector(const double a[3][3], double e, double v[3]) {
+		double rows[3][3];
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j)
+				rows[i][j] = a[i][j] - (i == j ? e : 0.0);
+		}
+		double c[3][3];
+		cross(rows[0], rows[1], c[0]);
+		cross(rows[0], rows[2], c[1]);
+		cross(rows[1], rows[2], c[2]);
+		int best = 0;
+		double best_len = dot(c[0], c[0]);
+		for (int k = 1; k < 3; ++k) {
+			double len = dot(c[k], c[k]);
+			if (len > best_len) {
+				best = k;
+				best_len = len;
+			}
+		}
+		if (best_len > 0) {
+			for (int k = 0; k < 3; ++k)
+				v[k] = c[best][k];
+			normalize(v);
+		}
+		else {
+			v[0] = 1.0;	v[1] = 0.0;	v[2] = 0.0;
+		}
+	}
+
+
+	// a unit eigen vector of the eigen value 'e' of the symmetric matrix 'a', orthogonal to the unit
+	// eigen vector 'u' of another eigen value: from the 2x2 matrix of 'a' in the plane orthogonal to 'u'
+	void eigen_vector_orthogonal(const double a[3][3], const double u[3], double e, double v[3]) {
+		double s[3], t[3];
+		if (std::fabs(u[0]) > std::fabs(u[1])) {
+			s[0] = -u[2];	s[1] = 0.0;		s[2] = u[0];
+		}
+		else {
+			s[0] = 0.0;		s[1] = u[2];	s[2] = -u[1];
+		}
+		normalize(s);
+		cross(u, s, t);
+
+		double as[3], at[3];
+		for (int i = 0; i < 3; ++i) {
+			as[i] = a[i][0] * s[0] + a[i][1] * s[1] + a[i][2] * s[2];
+			at[i] = a[i][0] * t[0] + a[i][1] * t[1] + a[i][2] * t[2];
+		}
+		double m00 = dot(s, as) - e, m01 = dot(s, at), m11 = dot(t, at) - e;
+
+		// the null vector of the row of larger norm of the 2x2 matrix minus e
+		double x, y;
+		if (m00 * m00 + m01 * m01 >= m01 * m01 + m11 * m11) {
+			x = -m01;	y = m00;
+		}
+		else {
+			x = m11;	y = -m01;
+		}
+		double len = std::sqrt(x * x + y * y);
+		if (len > 0) {
+			x /= len;	y /= len;
+		}
+		else {	// a double eigen value: any direction of the plane
+			x = 1.0;	y = 0.0;
+		}
+		for (int k = 0; k < 3; ++k)
+			v[k] = x * s[k] + y * t[k];
+	}
+}
+
+
+void PlaneFitting::eigen_symmetric(const double mat[6], double eigen_values[3], vec3 eigen_vectors[3]) {
+	// scaled, so the cubes stay in the range of doubles
+	double scale = 0.0;
+	for (int k = 0; k < 6; ++k)
+		scale = std::max(scale, std::fabs(mat[k]));
+	if (scale == 0.0) {
+		for (int k = 0; k < 3; ++k) {
+			eigen_values[k] = 0.0;
+			eigen_vectors[k] = vec3(k == 0, k == 1, k == 2);
+		}
+		return;
+	}
+
+	double a[3][3] = {
+		{ mat[0] / scale, mat[1] / scale, mat[3] / scale },
+		{ mat[1] / scale, mat[2] / scale, mat[4] / scale },
+		{ mat[3] / scale, mat[4] / scale, mat[5] / scale }
+	};
+
+	// the eigen values, from the trigonometric solution of the characteristic polynomial 
+	double q = (a[0][0] + a[1][1] + a[2][2]) / 3.0;
+	double b00 = a[0][0] - q, b11 = a[1][1] - q, b22 = a[2][2] - q;
+	double p = std::sqrt((b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * (a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2])) / 6.0);
+	if (p <= 1e-15) {	// a multiple of the identity
+		for (int k = 0; k < 3; ++k) {
+			eigen_values[k] = q * scale;
+			eigen_vectors[k] = vec3(k == 0, k == 1, k == 2);
+		}
+		return;
+	}
+	double det =
+		b00 * (b11 * b22 - a[1][2] * a[1][2]) -
+		a[0][1] * (a[0][1] * b22 - a[1][2] * a[0][2]) +
+		a[0][2] * (a[0][1] * a[1][2] - b11 * a[0][2]);
+	double r = ogf_max(-1.0, ogf_min(1.0, det / (2.0 * p * p * p)));
+	double phi = std::acos(r) / 3.0;
+	double e0 = q + 2.0 * p * std::cos(phi);
+	double e2 = q + 2.0 * p * std::cos(phi + 2.0 * M_PI / 3.0);
+	double e1 = 3.0 * q - e0 - e2;
+
+	// the eigen vector of the eigen value farthest from the others first, then the one of the middle
+	// eigen value orthogonal to it, and the third one orthogonal to both
+	double v[3][3];
+	if (e0 - e1 >= e1 - e2) {
+		eigen_vector(a, e0, v[0]);
+		eigen_vector_orthogonal(a, v[0], e1, v[1]);
+		cross(v[0], v[1], v[2]);
+	}
+	else {
+		eigen_vector(a, e2, v[2]);
+		eigen_vector_orthogonal(a, v[2], e1, v[1]);
+		cross(v[1], v[2], v[0]);
+	}
+
+	eigen_values[0] = e0 * scale;
+	eigen_values[1] = e1 * scale;
+	eigen_values[2] = e2 * scale;
+	for (int k = 0; k < 3; ++k)
+		eigen_vectors[k] = vec3(float(v[k][0]), float(v[k][1]), float(v[k][2]));
+}
+
+
+Plane3d PlaneFitting::fit(const std::vector<vec3>& points, const unsigned int* indices, std::size_t n, unsigned int num_threads) {
+	if (n == 0)
+		return Plane3d(vec3(0, 0, 0), vec3(0, 0, 1));
+
+	const vec3& first = points[indices[0]];
+	const double origin[3] = { first.x, first.y, first.z };
+	Moments m;
+	if (n <= parallel_size || parallel_num_threads(num_threads) == 1)
+		accumulate(points.data(), indices, n, origin, m);
+	else {
+		// the chunks don't depend on the number of threads, and are summed in order
+		const std::size_t chunk_size = 65536;
+		std::size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+		std::vector<Moments> chunks(num_chunks);
+		parallel_for(num_chunks, [&](std::size_t c) {
+			std::size_t start = c * chunk_size;
+			accumulate(points.data(), indices + start, std::min(chunk_size, n - start), origin, chunks[c]);
+		}, nil, num_threads);
+		for (std::size_t c = 0; c < num_chunks; ++c)
+			m.add(chunks[c]);
+	}
+	return plane_of(m, origin);
+}
+
+
+void PlaneFitting::fit(const std::vector<vec3>& points, const unsigned int* indices, const std::size_t* offsets, std::size_t num_sets,
+	std::vector<Plane3d>& planes, unsigned int num_threads)
+{
+	planes.resize(num_sets);
+	parallel_for(num_sets, [&](std::size_t i) {
+		planes[i] = fit(points, indices + offsets[i], offsets[i + 1] - offsets[i], 1);
+	}, nil, num_threads);
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MATH_PLANE_FITTING_H_
+#define _MATH_PLANE_FITTING_H_
+
+#include "math_common.h"
+#include "math_types.h"
+
+#include <vector>
+#include <cstddef>
+
+
+/**
+* Least-squares fitting of planes to the points given by their indices, the same planes as
+* PrincipalAxes3d (through the centroid, orthogonal to the smallest principal axis) but faster:
+* - the covariance is reduced in one pass over the indices, relative to the first point (which 
+*   keeps the precision for the points far from the origin), with independent accumulators that
+*   the compiler can vectorize, and by several threads for the large sets;
+* - the eigen vectors of the 3x3 covariance are computed in closed form instead of by the Jacobi 
+*   iterations of MatrixUtil::eigen_symmetric().
+* The batch version fits thousands of sets at once (e.g., all the vertex groups), in parallel.
+*/
+
+class MATH_API PlaneFitting
+{
+public:
+	// the plane of points[indices[0]], ..., points[indices[n - 1]]. The sets with more than 
+	// parallel_size points are reduced by up to 'num_threads' threads (0 means the number of hardware
+	// threads). Like PrincipalAxes3d, less than 4 points give the horizontal plane of their centroid.
+	static Plane3d fit(const std::vector<vec3>& points, const unsigned int* indices, std::size_t n, unsigned int num_threads = 1);
+
+	// the planes of the sets of points indices[offsets[i]] to indices[offsets[i + 1] - 1], for i in 
+	// [0, num_sets), each set fitted by one thread
+	static void fit(const std::vector<vec3>& points, const unsigned int* indices, const std::size_t* offsets, std::size_t num_sets,
+		std::vector<Plane3d>& planes, unsigned int num_threads = 0);
+
+	// the eigen values (in decreasing order) and the unit eigen vectors of the symmetric matrix 
+	// 'mat', stored as in MatrixUtil::eigen_symmetric() ({ m11, m12, m22, m13, m23, m33 })
+	static void eigen_symmetric(const double mat[6], double eigen_values[3], vec3 eigen_vectors[3]);
+
+	static const std::size_t parallel_size = 1 << 18;
+};
+
+#endif
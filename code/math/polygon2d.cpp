@@ -39,11 +39,16 @@
 
 #include "polygon2d.h"
 #include "math_types.h"
+#include "../basic/instrumentation.h"
 
 #include <fstream>
 #include <cstdlib> // for qsort
 
 
+namespace {
+	EventCounter num_point_in_polygon_tests("point-in-polygon tests");
+}
+
 
 namespace Geom {
 
@@ -191,9 +196,14 @@ namespace Geom {
 	}
 
 
-	bool point_is_in_polygon(const Polygon2d& polygon, const vec2& p) {
+	bool point_is_in_polygon(const Polygon2d& P, const vec2& p) {
+		return point_is_in_polygon(P.data(), P.size(), p);
+	}
+
+
+	bool point_is_in_polygon(const vec2* polygon, std::size_t n, const vec2& p) {
+		num_point_in_polygon_tests.add();
 		bool inside = false;
-		std::size_t n = polygon.size();
 		for (std::size_t i = 0, j = n - 1; i < n; j = i, ++i) {
 			const vec2& u0 = polygon[i];
 			const vec2& u1 = polygon[j];  // current edge
@@ -213,6 +223,150 @@ namespace Geom {
 	}
 
 
+	// A polygon is convex iff it always turns in the same direction, and it is 
+	// not self-intersecting (i.e., it goes back and forth at most once along x 
+	// and along y). Collinear vertices are allowed.
+	bool polygon_is_convex(const Polygon2d& P) {
+		return polygon_is_convex(P.data(), P.size());
+	}
+
+
+	bool polygon_is_convex(const vec2* P, std::size_t n) {
+		if (n < 3)
+			return false;
+
+		int orientation = 0;
+		int x_first = 0, x_sign = 0, x_flips = 0;
+		int y_first = 0, y_sign = 0, y_flips = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			const vec2& p0 = P[i];
+			const vec2& p1 = P[(i + 1) % n];
+			const vec2& p2 = P[(i + 2) % n];
+			double dx = p1.x - p0.x, dy = p1.y - p0.y;
+			double cross = dx * (p2.y - p1.y) - dy * (p2.x - p1.x);
+			if (cross != 0) {
+				int s = (cross > 0) ? 1 : -1;
+				if (orientation == 0)
+					orientation = s;
+				else if (s != orientation)
+					return false;
+			}
+
+			if (dx != 0) {
+				int s = (dx > 0) ? 1 : -1;
+				if (x_sign == 0)
+					x_first = s;
+				else if (s != x_sign)
+					++x_flips;
+				x_sign = s;
+			}
+			if (dy != 0) {
+				int s = (dy > 0) ? 1 : -1;
+				if (y_sign == 0)
+					y_first = s;
+				else if (s != y_sign)
+					++y_flips;
+				y_sign = s;
+			}
+		}
+		if (x_sign != x_first)
+			++x_flips;
+		if (y_sign != y_first)
+			++y_flips;
+
+		return orientation != 0 && x_flips <= 2 && y_flips <= 2;
+	}
+
+
+	PolygonClassifier::PolygonClassifier(const Polygon2d& P) {
+		init(P.data(), P.size());
+	}
+
+
+	PolygonClassifier::PolygonClassifier(const vec2* P, std::size_t n) {
+		init(P, n);
+	}
+
+
+	void PolygonClassifier::init(const vec2* P, std::size_t n) {
+		convex_ = polygon_is_convex(P, n);
+		if (!convex_) {
+			polygon_.assign(P, P + n);
+			return;
+		}
+
+		// the edges are oriented counterclockwise, so the inner side is on their left
+		double s = (signed_area(P, n) > 0) ? 1.0 : -1.0;
+		edges_.resize(n);
+		for (std::size_t i = 0; i < n; ++i) {
+			const vec2& p = P[i];
+			const vec2& q = P[(i + 1) % n];
+			double dx = s * (double(q.x) - p.x);
+			double dy = s * (double(q.y) - p.y);
+			Edge& e = edges_[i];
+			e.a = -dy;
+			e.b = dx;
+			e.c = dy * p.x - dx * p.y;
+			// the top-left rule: the left and the top edges are closed, the others are open
+			e.closed = (dy < 0) || (dy == 0 && dx < 0);
+		}
+	}
+
+
+	bool PolygonClassifier::contains(const vec2& p) const {
+		if (!convex_)
+			return point_is_in_polygon(polygon_.data(), polygon_.size(), p);
+
+		num_point_in_polygon_tests.add();
+		for (std::size_t i = 0; i < edges_.size(); ++i) {
+			const Edge& e = edges_[i];
+			double v = e.a * p.x + e.b * p.y + e.c;
+			if (v < 0 || (v == 0 && !e.closed))
+				return false;
+		}
+		return true;
+	}
+
+
+	void PolygonClassifier::classify(const vec2* pts, const unsigned int* indices, std::size_t n, Numeric::uint8* mask) const {
+		if (!convex_) {
+			for (std::size_t i = 0; i < n; ++i)
+				mask[i] = point_is_in_polygon(polygon_.data(), polygon_.size(), indices ? pts[indices[i]] : pts[i]) ? 1 : 0;
+			return;
+		}
+
+		// the points are classified by blocks, edge by edge, without branches (so 
+		// the inner loop is vectorized)
+		num_point_in_polygon_tests.add(n);
+		const std::size_t block_size = 256;
+		double x[block_size], y[block_size];
+		for (std::size_t start = 0; start < n; start += block_size) {
+			std::size_t m = ogf_min(block_size, n - start);
+			Numeric::uint8* block_mask = mask + start;
+			for (std::size_t k = 0; k < m; ++k) {
+				const vec2& p = indices ? pts[indices[start + k]] : pts[start + k];
+				x[k] = p.x;
+				y[k] = p.y;
+				block_mask[k] = 1;
+			}
+			for (std::size_t i = 0; i < edges_.size(); ++i) {
+				const double a = edges_[i].a, b = edges_[i].b, c = edges_[i].c;
+				const int closed = edges_[i].closed ? 1 : 0;
+				for (std::size_t k = 0; k < m; ++k) {
+					double v = a * x[k] + b * y[k] + c;
+					block_mask[k] &= Numeric::uint8((v > 0) | ((v == 0) & closed));
+				}
+			}
+		}
+	}
+
+
+	void points_in_polygon(const Polygon2d& P, const vec2* pts, std::size_t n, Numeric::uint8* mask) {
+		PolygonClassifier classifier(P);
+		classifier.classify(pts, nil, n, mask);
+	}
+
+
 	// http://astronomy.swin.edu.au/~pbourke/geometry/polyarea/
 	vec2 barycenter(const Polygon2d& P) {
 		ogf_assert(P.size() > 0) ;
@@ -303,9 +457,13 @@ namespace Geom {
 
 	// http://astronomy.swin.edu.au/~pbourke/geometry/polyarea/
 	double signed_area(const Polygon2d& P) {
+		return signed_area(P.data(), P.size()) ;
+	}
+
+	double signed_area(const vec2* P, std::size_t n) {
 		double result = 0 ;
-		for(unsigned int i=0; i<P.size(); i++) {
-			unsigned int j = (i+1) % P.size() ;
+		for(std::size_t i=0; i<n; i++) {
+			std::size_t j = (i+1) % n ;
 			const vec2& t1 = P[i] ;
 			const vec2& t2 = P[j] ;
 			result += t1.x * t2.y - t2.x * t1.y ;
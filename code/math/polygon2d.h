@@ -54,6 +54,9 @@ namespace Geom {
 
 	double MATH_API signed_area(const Polygon2d& P) ;
 
+	// the versions taking the 'n' vertices of a polygon work with any storage (e.g., a SmallPolygon2d)
+	double MATH_API signed_area(const vec2* P, std::size_t n) ;
+
 	inline double area(const Polygon2d& P) { 
 		return ::fabs(signed_area(P)) ; 
 	}
@@ -70,6 +73,7 @@ namespace Geom {
 
 	// NOTE: works for both convex and non-convex polygons.
 	bool MATH_API point_is_in_polygon(const Polygon2d& P, const vec2& p);
+	bool MATH_API point_is_in_polygon(const vec2* P, std::size_t n, const vec2& p);
 
 	/** 
 	* Note: the barycenter of a polygon is not 
@@ -80,6 +84,42 @@ namespace Geom {
 	vec2 MATH_API vertices_barycenter(const Polygon2d& P) ;
 
 	bool MATH_API polygon_is_convex(const Polygon2d& P) ;
+	bool MATH_API polygon_is_convex(const vec2* P, std::size_t n) ;
+
+	/**
+	* Classifies many points against the same polygon. For a convex polygon the 
+	* edge equations are computed once, and a point is inside iff it is on the 
+	* inner side of all of them (the points on an edge shared by two adjacent 
+	* faces belong to exactly one of them). Other polygons use the crossing test.
+	*/
+	class MATH_API PolygonClassifier {
+	public:
+		PolygonClassifier(const Polygon2d& P) ;
+		PolygonClassifier(const vec2* P, std::size_t n) ;
+
+		bool is_convex() const { return convex_ ; }
+
+		bool contains(const vec2& p) const ;
+
+		// mask[i] is 1 if pts[i] (or pts[indices[i]] if 'indices' is not nil) is inside, and 0 otherwise
+		void classify(const vec2* pts, const unsigned int* indices, std::size_t n, Numeric::uint8* mask) const ;
+
+	private:
+		struct Edge {
+			double a, b, c ;	// a * x + b * y + c > 0 on the inner side
+			bool   closed ;		// if the points on the edge are inside
+		} ;
+
+		void init(const vec2* P, std::size_t n) ;
+
+	private:
+		bool					convex_ ;
+		SmallVector<Edge, 16>	edges_ ;
+		SmallPolygon2d			polygon_ ;	// only kept for the crossing test of a non-convex polygon
+	} ;
+
+	// mask[i] is 1 if pts[i] is inside P, and 0 otherwise
+	void MATH_API points_in_polygon(const Polygon2d& P, const vec2* pts, std::size_t n, Numeric::uint8* mask) ;
 
 }
 
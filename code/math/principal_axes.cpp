@@ -38,6 +38,7 @@
 
 #include "principal_axes.h"
 #include "semi_definite_symmetric_eigen.h"
+#include "plane_fitting.h"
 
 
 PrincipalAxes3d::PrincipalAxes3d() {
@@ -87,25 +88,8 @@ void PrincipalAxes3d::end() {
 			M_[5] = 1.e-30 ; 
 		}
 
-		double eigen_vectors[9] ;
-		MatrixUtil::eigen_symmetric(M_, 3, eigen_vectors, eigen_value_) ;
-
-		axis_[0] = vec3(
-			float(eigen_vectors[0]), float(eigen_vectors[1]), float(eigen_vectors[2])
-		) ;
-
-		axis_[1] = vec3(
-			float(eigen_vectors[3]), float(eigen_vectors[4]), float(eigen_vectors[5])
-		) ;
-
-		axis_[2] = vec3(
-			float(eigen_vectors[6]), float(eigen_vectors[7]), float(eigen_vectors[8])
-		) ;
-
-		// Normalize the eigen vectors
-		for(int i=0; i<3; i++) {
-			axis_[i] = normalize(axis_[i]) ;
-		}
+		// closed form (the Jacobi iterations of MatrixUtil stop at a coarse tolerance)
+		PlaneFitting::eigen_symmetric(M_, eigen_value_, axis_) ;
 	}
 
 }
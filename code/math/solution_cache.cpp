@@ -0,0 +1,253 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "solution_cache.h"
+#include "linear_program.h"
+#include "../basic/logger.h"
+#include "../basic/file_utils.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+
+namespace {
+
+	// Two independent 64-bit FNV-1a hashes of the same bytes, so an accidental collision is out of
+	// question for the number of programs a cache ever sees.
+	class ProgramHash {
+	public:
+		ProgramHash() : h1_(14695981039346656037ULL), h2_(0x9e3779b97f4a7c15ULL) {}
+
+		void add(const void* data, std::size_t size) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (std::size_t i = 0; i < size; ++i) {
+				h1_ = (h1_ ^ bytes[i]) * 1099511628211ULL;
+				h2_ = (h2_ ^ bytes[i]) * 0x100000001b3ULL + 0x632be59bd9b4e019ULL;
+			}
+		}
+		void add(long long value) { add(&value, sizeof(value)); }
+		void add(double value) {
+			if (value == 0.0)	// -0.0 and 0.0 are the same coefficient
+				value = 0.0;
+			add(&value, sizeof(value));
+		}
+		void add(const Bound& bound) {
+			double lb, ub;
+			bound.get_bounds(lb, ub);
+			add(static_cast<long long>(bound.bound_type()));
+			switch (bound.bound_type()) {	// the bound that doesn't apply may be anything
+			case Bound::FIXED:
+			case Bound::LOWER:
+				add(lb);
+				break;
+			case Bound::UPPER:
+				add(ub);
+				break;
+			case Bound::DOUBLE:
+				add(lb);
+				add(ub);
+				break;
+			default:
+				break;
+			}
+		}
+		void add(const SparseRow& row) {
+			add(static_cast<long long>(row.size()));
+			for (std::size_t k = 0; k < row.size(); ++k) {
+				add(static_cast<long long>(row.index(k)));
+				add(row.value(k));
+			}
+		}
+
+		std::string digest() const {
+			char buffer[33];
+			std::snprintf(buffer, sizeof(buffer), "%016llx%016llx", static_cast<unsigned long long>(h1_), static_cast<unsigned long long>(h2_));
+			return buffer;
+		}
+
+	private:
+		unsigned long long h1_;
+		unsigned long long h2_;
+	};
+
+
+	const char		   cache_magic[4] = { 'P', 'F', 'S', 'C' };
+	const unsigned int cache_version = 1;
+
+}
+
+
+std::string SolutionCache::key(const LinearProgram& program) {
+	ProgramHash hash;
+	hash.add(static_cast<long long>(program.num_variables()));
+	hash.add(static_cast<long long>(program.num_constraints()));
+
+	const std::vector<Variable*>& variables = program.variables();
+	for (std::size_t i = 0; i < variables.size(); ++i) {
+		hash.add(static_cast<long long>(variables[i]->variable_type()));
+		hash.add(*variables[i]);
+	}
+
+	const LinearObjective* objective = program.objective();
+	hash.add(static_cast<long long>(objective->sense()));
+	hash.add(objective->coefficients());
+
+	const std::vector<LinearConstraint*>& constraints = program.constraints();
+	for (std::size_t i = 0; i < constraints.size(); ++i) {
+		hash.add(*constraints[i]);
+		hash.add(constraints[i]->coefficients());
+	}
+
+	return hash.digest();
+}
+
+
+bool MemorySolutionCache::lookup(const std::string& key, std::vector<double>& x, double& objective) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::unordered_map<std::string, std::list<Entry>::iterator>::iterator pos = index_.find(key);
+	if (pos == index_.end())
+		return false;
+
+	entries_.splice(entries_.begin(), entries_, pos->second);
+	x = pos->second->x;
+	objective = pos->second->objective;
+	return true;
+}
+
+
+void MemorySolutionCache::store(const std::string& key, const std::vector<double>& x, double objective) {
+	if (capacity_ == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::unordered_map<std::string, std::list<Entry>::iterator>::iterator pos = index_.find(key);
+	if (pos != index_.end()) {
+		pos->second->x = x;
+		pos->second->objective = objective;
+		entries_.splice(entries_.begin(), entries_, pos->second);
+		return;
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.x = x;
+	entry.objective = objective;
+	entries_.push_front(entry);
+	index_[key] = entries_.begin();
+
+	while (entries_.size() > capacity_) {
+		index_.erase(entries_.back().key);
+		entries_.pop_back();
+	}
+}
+
+
+std::size_t MemorySolutionCache::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.size();
+}
+
+
+void MemorySolutionCache::clear() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_.clear();
+	index_.clear();
+}
+
+
+DirectorySolutionCache::DirectorySolutionCache(const std::string& directory) : directory_(directory) {
+	if (!FileUtils::is_directory(directory_) && !FileUtils::create_directory(directory_))
+		Logger::err("-") << "failed creating the cache directory: " << directory_ << std::endl;
+}
+
+
+std::string DirectorySolutionCache::file_name(const std::string& key) const {
+	return directory_ + "/" + key + ".sol";
+}
+
+
+bool DirectorySolutionCache::lookup(const std::string& key, std::vector<double>& x, double& objective) {
+	std::ifstream input(file_name(key).c_str(), std::ios::binary);
+	if (input.fail())
+		return false;
+
+	char magic[4];
+	unsigned int version = 0;
+	unsigned long long num = 0;
+	input.read(magic, sizeof(magic));
+	input.read(reinterpret_cast<char*>(&version), sizeof(version));
+	input.read(reinterpret_cast<char*>(&num), sizeof(num));
+	input.read(reinterpret_cast<char*>(&objective), sizeof(objective));
+	if (!input || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 || version != cache_version) {
+		Logger::warn("-") << "ignored invalid cache file: " << file_name(key) << std::endl;
+		return false;
+	}
+
+	// checks the size against the file before allocating
+	std::streampos start = input.tellg();
+	input.seekg(0, std::ios::end);
+	std::streamoff remaining = input.tellg() - start;
+	if (remaining < 0 || static_cast<unsigned long long>(remaining) != num * sizeof(double)) {
+		Logger::warn("-") << "ignored truncated cache file: " << file_name(key) << std::endl;
+		return false;
+	}
+	input.seekg(start);
+
+	x.resize(static_cast<std::size_t>(num));
+	if (num > 0)
+		input.read(reinterpret_cast<char*>(x.data()), static_cast<std::streamsize>(num * sizeof(double)));
+	return !input.fail();
+}
+
+
+void DirectorySolutionCache::store(const std::string& key, const std::vector<double>& x, double objective) {
+	// written to a temporary file first, so a concurrent lookup never sees a partial file
+	std::ostringstream temp;
+	temp << file_name(key) << "." << std::this_thread::get_id() << ".tmp";
+	const std::string temp_name = temp.str();
+
+	{
+		std::ofstream output(temp_name.c_str(), std::ios::binary);
+		if (output.fail()) {
+			Logger::warn("-") << "could not write the cache file: " << temp_name << std::endl;
+			return;
+		}
+		unsigned long long num = x.size();
+		output.write(cache_magic, sizeof(cache_magic));
+		output.write(reinterpret_cast<const char*>(&cache_version), sizeof(cache_version));
+		output.write(reinterpret_cast<const char*>(&num), sizeof(num));
+		output.write(reinterpret_cast<const char*>(&objective), sizeof(objective));
+		if (!x.empty())
+			output.write(reinterpret_cast<const char*>(x.data()), static_cast<std::streamsize>(x.size() * sizeof(double)));
+		if (output.fail()) {
+			output.close();
+			std::remove(temp_name.c_str());
+			Logger::warn("-") << "could not write the cache file: " << temp_name << std::endl;
+			return;
+		}
+	}
+
+	const std::string name = file_name(key);
+	std::remove(name.c_str());	// rename() doesn't replace existing files on Windows
+	if (std::rename(temp_name.c_str(), name.c_str()) != 0)
+		std::remove(temp_name.c_str());
+}
@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MATH_SOLUTION_CACHE_H_
+#define _MATH_SOLUTION_CACHE_H_
+
+#include "math_common.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+
+class LinearProgram;
+
+
+// Keeps the optimal solutions of programs by a key identifying them (see key()), so solving the same
+// program again (e.g., an unchanged tile of a batch) is a lookup. Used by LinearProgramSolver (see 
+// LinearProgramSolver::set_cache()). The implementations must be thread-safe.
+class MATH_API SolutionCache
+{
+public:
+	virtual ~SolutionCache() {}
+
+	// Returns false if no solution is stored for the key.
+	virtual bool lookup(const std::string& key, std::vector<double>& x, double& objective) = 0;
+	virtual void store(const std::string& key, const std::vector<double>& x, double objective) = 0;
+
+	// A canonical hash (as 32 hexadecimal digits) of the sense, the variables (types and bounds), the 
+	// objective, and the constraints (bounds and coefficients) of the program. The names don't matter.
+	// NOTE: the program must have been finalized.
+	static std::string key(const LinearProgram& program);
+};
+
+
+// Keeps the most recently used solutions in memory.
+class MATH_API MemorySolutionCache : public SolutionCache
+{
+public:
+	MemorySolutionCache(std::size_t capacity = 64) : capacity_(capacity) {}
+
+	bool lookup(const std::string& key, std::vector<double>& x, double& objective);
+	void store(const std::string& key, const std::vector<double>& x, double objective);
+
+	std::size_t size() const;
+	void clear();
+
+private:
+	struct Entry {
+		std::string			key;
+		std::vector<double> x;
+		double				objective;
+	};
+
+	std::size_t								capacity_;
+	std::list<Entry>						entries_;	// the most recently used first
+	std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+	mutable std::mutex						mutex_;
+};
+
+
+// Keeps the solutions as files (named by their keys) in a directory, so they survive the process 
+// and can be shared by the runs of a batch. Nothing is ever evicted.
+class MATH_API DirectorySolutionCache : public SolutionCache
+{
+public:
+	// The directory is created if it doesn't exist.
+	DirectorySolutionCache(const std::string& directory);
+
+	bool lookup(const std::string& key, std::vector<double>& x, double& objective);
+	void store(const std::string& key, const std::vector<double>& x, double objective);
+
+	const std::string& directory() const { return directory_; }
+
+private:
+	std::string file_name(const std::string& key) const;
+
+private:
+	std::string directory_;
+};
+
+#endif
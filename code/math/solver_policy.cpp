@@ -0,0 +1,283 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "solver_policy.h"
+#include "linear_program.h"
+#include "../basic/logger.h"
+#include "../basic/basic_types.h"
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <cmath>
+#include <cstdlib>
+
+
+namespace {
+
+	// The built-in models, from the relative speeds of the backends on the face selection problems:
+	// GUROBI and HIGHS are the fastest, SCIP is the fastest free one on the large problems (and uses 
+	// the threads if built with a task processing interface), and GLPK and LPSOLVE have the least 
+	// overhead on the small problems but stall on the large ones.
+	std::map<LinearProgramSolver::SolverName, SolverPolicy::Model> default_models() {
+		typedef SolverPolicy::Model Model;
+		std::map<LinearProgramSolver::SolverName, Model> models;
+#ifdef HAS_GUROBI
+		models[LinearProgramSolver::GUROBI] = Model(2e-5, 1.1, 0.5, 0);
+#endif
+#ifdef HAS_HIGHS
+		models[LinearProgramSolver::HIGHS] = Model(5e-5, 1.15, 0.3, 0);
+#endif
+#ifdef HAS_ORTOOLS
+		models[LinearProgramSolver::CPSAT] = Model(2e-4, 1.15, 0.6, 0);
+#endif
+		models[LinearProgramSolver::SCIP] = Model(1e-4, 1.25, 0.2, 0);
+		models[LinearProgramSolver::GLPK] = Model(1e-5, 1.7, 0.0, 20000);
+		models[LinearProgramSolver::LPSOLVE] = Model(2e-5, 1.7, 0.0, 10000);
+		return models;
+	}
+
+
+	std::mutex& models_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	// NOTE: the caller holds the mutex
+	std::map<LinearProgramSolver::SolverName, SolverPolicy::Model>& models() {
+		static std::map<LinearProgramSolver::SolverName, SolverPolicy::Model> models = default_models();
+		return models;
+	}
+
+
+	// the optimal runs of a backend in a report: the number of variables, the threads, and the time
+	struct Sample {
+		double	variables;
+		double	threads;
+		double	time;
+	};
+
+}
+
+
+const char* SolverPolicy::solver_name(LinearProgramSolver::SolverName solver) {
+	switch (solver) {
+#ifdef HAS_GUROBI
+	case LinearProgramSolver::GUROBI:	return "GUROBI";
+#endif
+#ifdef HAS_HIGHS
+	case LinearProgramSolver::HIGHS:	return "HIGHS";
+#endif
+#ifdef HAS_ORTOOLS
+	case LinearProgramSolver::CPSAT:	return "CPSAT";
+#endif
+	case LinearProgramSolver::SCIP:		return "SCIP";
+	case LinearProgramSolver::GLPK:		return "GLPK";
+	case LinearProgramSolver::LPSOLVE:	return "LPSOLVE";
+	case LinearProgramSolver::PORTFOLIO:	return "PORTFOLIO";
+	default:							return "AUTO";
+	}
+}
+
+
+bool SolverPolicy::solver_from_name(const std::string& name, LinearProgramSolver::SolverName& solver) {
+	const LinearProgramSolver::SolverName solvers[] = {
+#ifdef HAS_GUROBI
+		LinearProgramSolver::GUROBI,
+#endif
+#ifdef HAS_HIGHS
+		LinearProgramSolver::HIGHS,
+#endif
+#ifdef HAS_ORTOOLS
+		LinearProgramSolver::CPSAT,
+#endif
+		LinearProgramSolver::SCIP, LinearProgramSolver::GLPK, LinearProgramSolver::LPSOLVE,
+		LinearProgramSolver::PORTFOLIO, LinearProgramSolver::AUTO
+	};
+	for (std::size_t i = 0; i < sizeof(solvers) / sizeof(solvers[0]); ++i) {
+		if (name == solver_name(solvers[i])) {
+			solver = solvers[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+
+SolverPolicy::Model SolverPolicy::model(LinearProgramSolver::SolverName solver) {
+	std::lock_guard<std::mutex> lock(models_mutex());
+	std::map<LinearProgramSolver::SolverName, Model>::const_iterator pos = models().find(solver);
+	if (pos == models().end())
+		pos = models().find(LinearProgramSolver::SCIP);
+	return pos->second;
+}
+
+
+void SolverPolicy::set_model(LinearProgramSolver::SolverName solver, const Model& model) {
+	if (solver == LinearProgramSolver::PORTFOLIO || solver == LinearProgramSolver::AUTO)
+		return;
+	std::lock_guard<std::mutex> lock(models_mutex());
+	models()[solver] = model;
+}
+
+
+double SolverPolicy::predicted_time(LinearProgramSolver::SolverName solver, std::size_t num_variables, bool pseudo_boolean, unsigned int num_threads) {
+	if (solver == LinearProgramSolver::PORTFOLIO || solver == LinearProgramSolver::AUTO)
+		return -1.0;
+#ifdef HAS_ORTOOLS
+	if (solver == LinearProgramSolver::CPSAT && !pseudo_boolean)
+		return -1.0;
+#else
+	(void)pseudo_boolean;
+#endif
+
+	Model m;
+	{
+		std::lock_guard<std::mutex> lock(models_mutex());
+		std::map<LinearProgramSolver::SolverName, Model>::const_iterator pos = models().find(solver);
+		if (pos == models().end())
+			return -1.0;
+		m = pos->second;
+	}
+	if (m.max_variables > 0 && num_variables > m.max_variables)
+		return -1.0;
+
+	const double threads = std::max(num_threads, 1u);
+	return m.scale * std::pow(double(std::max<std::size_t>(num_variables, 1)), m.exponent) / (1.0 + m.thread_speedup * (threads - 1.0));
+}
+
+
+LinearProgramSolver::SolverName SolverPolicy::choose(std::size_t num_variables, bool pseudo_boolean, unsigned int num_threads) {
+	std::vector<LinearProgramSolver::SolverName> solvers;
+	{
+		std::lock_guard<std::mutex> lock(models_mutex());
+		std::map<LinearProgramSolver::SolverName, Model>::const_iterator it = models().begin();
+		for (; it != models().end(); ++it)
+			solvers.push_back(it->first);
+	}
+
+	LinearProgramSolver::SolverName best = LinearProgramSolver::SCIP;
+	double best_time = -1.0;
+	for (std::size_t i = 0; i < solvers.size(); ++i) {
+		double t = predicted_time(solvers[i], num_variables, pseudo_boolean, num_threads);
+		if (t >= 0.0 && (best_time < 0.0 || t < best_time)) {
+			best = solvers[i];
+			best_time = t;
+		}
+	}
+	return best;
+}
+
+
+LinearProgramSolver::SolverName SolverPolicy::choose(const LinearProgram& program, unsigned int num_threads) {
+	return choose(program.num_variables(), program.is_pseudo_boolean(), num_threads);
+}
+
+
+bool SolverPolicy::calibrate(const std::string& report_file) {
+	std::ifstream input(report_file.c_str());
+	if (input.fail()) {
+		Logger::err("-") << "could not open file: " << report_file << std::endl;
+		return false;
+	}
+
+	// the columns are found by their names in the header
+	std::string line;
+	std::getline(input, line);
+	std::vector<std::string> header;
+	String::split_string(line, ',', header, false);
+	int solver_col = -1, status_col = -1, time_col = -1, variables_col = -1, threads_col = -1;
+	for (std::size_t i = 0; i < header.size(); ++i) {
+		const std::string& name = header[i];
+		if (name == "solver") solver_col = int(i);
+		else if (name == "status") status_col = int(i);
+		else if (name == "wall_time") time_col = int(i);
+		else if (name == "variables") variables_col = int(i);
+		else if (name == "threads") threads_col = int(i);
+	}
+	if (solver_col < 0 || status_col < 0 || time_col < 0 || variables_col < 0) {
+		Logger::err("-") << report_file << " is not a report of the Benchmark tool with the sizes of the programs" << std::endl;
+		return false;
+	}
+
+	std::map<LinearProgramSolver::SolverName, std::vector<Sample> > samples;
+	while (std::getline(input, line)) {
+		std::vector<std::string> fields;
+		String::split_string(line, ',', fields, false);
+		if (int(fields.size()) != int(header.size()) || fields[status_col] != "optimal")
+			continue;
+		LinearProgramSolver::SolverName solver;
+		if (!solver_from_name(fields[solver_col], solver) || solver == LinearProgramSolver::PORTFOLIO || solver == LinearProgramSolver::AUTO)
+			continue;
+		Sample s;
+		s.variables = std::atof(fields[variables_col].c_str());
+		s.threads = threads_col >= 0 ? std::max(std::atof(fields[threads_col].c_str()), 1.0) : 1.0;
+		s.time = std::max(std::atof(fields[time_col].c_str()), 1e-3);	// below the resolution of the timer
+		if (s.variables > 0)
+			samples[solver].push_back(s);
+	}
+
+	std::size_t num_calibrated = 0;
+	std::map<LinearProgramSolver::SolverName, std::vector<Sample> >::const_iterator it = samples.begin();
+	for (; it != samples.end(); ++it) {
+		const std::vector<Sample>& runs = it->second;
+		Model m = model(it->first);
+
+		// log(time) = log(scale) + exponent * log(variables), on the runs with one thread
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (std::size_t i = 0; i < runs.size(); ++i) {
+			if (runs[i].threads > 1.0)
+				continue;
+			double x = std::log(runs[i].variables);
+			double y = std::log(runs[i].time);
+			n += 1; sx += x; sy += y; sxx += x * x; sxy += x * y;
+		}
+		if (n == 0)
+			continue;
+		const double var_x = sxx - sx * sx / n;
+		if (var_x > 1e-6)
+			m.exponent = std::max(0.5, std::min((sxy - sx * sy / n) / var_x, 3.0));
+		m.scale = std::exp((sy - m.exponent * sx) / n);
+
+		// the speedup of the runs with more threads than the time predicted with one thread
+		double speedup = 0.0;
+		int num_threaded = 0;
+		for (std::size_t i = 0; i < runs.size(); ++i) {
+			if (runs[i].threads <= 1.0)
+				continue;
+			double single = m.scale * std::pow(runs[i].variables, m.exponent);
+			speedup += (single / runs[i].time - 1.0) / (runs[i].threads - 1.0);
+			++num_threaded;
+		}
+		if (num_threaded > 0)
+			m.thread_speedup = std::max(0.0, std::min(speedup / num_threaded, 1.0));
+
+		set_model(it->first, m);
+		Logger::out("-") << solver_name(it->first) << ": " << m.scale << " * n^" << m.exponent << " sec, thread speedup "
+			<< m.thread_speedup << " (from " << runs.size() << " runs)" << std::endl;
+		++num_calibrated;
+	}
+
+	if (num_calibrated == 0) {
+		Logger::warn("-") << report_file << " has no optimal run of a backend with one thread" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _MATH_SOLVER_POLICY_H_
+#define _MATH_SOLVER_POLICY_H_
+
+#include "math_common.h"
+#include "linear_program_solver.h"
+
+#include <string>
+
+
+class LinearProgram;
+
+
+/**
+* Picks the backend of LinearProgramSolver for a program (see LinearProgramSolver::AUTO), i.e., the 
+* available backend predicted to solve it first from its number of variables and the threads given.
+* The time of a backend is modeled as 'scale * n^exponent' seconds for n variables with one thread, 
+* divided by '1 + thread_speedup * (threads - 1)' with more threads, and GLPK and LPSOLVE are not 
+* considered beyond the sizes they stall at (CPSAT only takes the pseudo-Boolean programs). 
+*
+* The built-in models are rough; calibrate() fits them to the runs of the Benchmark tool, e.g., on the
+* face selection problems of the user's data saved with LinearProgram::save(). The models are shared
+* by the process (and can be changed while other threads solve).
+*/
+
+class MATH_API SolverPolicy
+{
+public:
+	struct Model {
+		Model() : scale(1e-4), exponent(1.25), thread_speedup(0.0), max_variables(0) {}
+		Model(double s, double e, double speedup, std::size_t max) : scale(s), exponent(e), thread_speedup(speedup), max_variables(max) {}
+
+		double		scale;			// in seconds
+		double		exponent;
+		double		thread_speedup;	// the gain of each thread beyond the first one (0 for none)
+		std::size_t	max_variables;	// beyond which the backend is not considered (0 for no limit)
+	};
+
+	static const char* solver_name(LinearProgramSolver::SolverName solver);
+	// returns false if the name is none of the solvers (in upper case, e.g., "SCIP")
+	static bool solver_from_name(const std::string& name, LinearProgramSolver::SolverName& solver);
+
+	// the model of a backend (the one of SCIP for PORTFOLIO and AUTO)
+	static Model model(LinearProgramSolver::SolverName solver);
+	static void set_model(LinearProgramSolver::SolverName solver, const Model& model);
+
+	// The predicted time (in seconds) of a backend on a program of 'num_variables' variables with
+	// 'num_threads' threads (0 counts as one), or a negative value if the backend isn't available or 
+	// can't take the program.
+	static double predicted_time(LinearProgramSolver::SolverName solver, std::size_t num_variables, bool pseudo_boolean, unsigned int num_threads);
+
+	// the available backend with the smallest predicted time (SCIP if none can take the program)
+	static LinearProgramSolver::SolverName choose(std::size_t num_variables, bool pseudo_boolean, unsigned int num_threads);
+	static LinearProgramSolver::SolverName choose(const LinearProgram& program, unsigned int num_threads);
+
+	// Fits the models of the backends to a report of the Benchmark tool (in CSV): the scale and the 
+	// exponent to the optimal runs with one thread (by least squares in the logarithms, the exponent 
+	// only if the programs have different sizes), and the thread speedup to the optimal runs with more
+	// threads. The runs that hit a limit, and those of PORTFOLIO and AUTO, are ignored. Returns false 
+	// (and keeps the models) if the report can't be read or has no such run.
+	static bool calibrate(const std::string& report_file);
+};
+
+
+#endif
@@ -38,11 +38,15 @@ explicit specifier.
 
 #include <CGAL/Delaunay_triangulation_2.h>
 #include <CGAL/Triangulation_hierarchy_2.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_2.h>
+#include <CGAL/property_map.h>
 
 #include "../model/point_set.h"
 #include "../model/vertex_group.h"
 
 #include <string>
+#include <vector>
 
 
 
@@ -96,6 +100,8 @@ typedef CGAL_AlphaShape::Vertex_handle						Vertex_handle;
 class AlphaShape : public CGAL_AlphaShape  
 {
 public:
+	AlphaShape() : num_duplicated_(0) {}
+
 	// the input is a list of points.
 	// NOTE: an 'id' (same as the order in the list) will be given 
 	//       during the construction of the alpha shape (this allow 
@@ -103,6 +109,16 @@ public:
 	template <typename InputIterator>
 	AlphaShape(InputIterator first, InputIterator beyond);  
 
+	// (Re)builds the alpha shape of the points, so that an alpha shape can be reused (see thread_instance()).
+	// The points are inserted in a spatial (Hilbert) order, each one located from the previously inserted 
+	// one, and they get the same ids as with the constructor.
+	template <typename InputIterator>
+	void build(InputIterator first, InputIterator beyond);
+
+	// an alpha shape owned by the calling thread, for the computations that don't keep their alpha shapes
+	// (this saves the construction of the triangulation hierarchy and the maps for each of them)
+	static AlphaShape& thread_instance();
+
 	std::vector<Face_handle> get_all_finite_facets();
 
 	// Determine the number of connected solid components. 
@@ -124,15 +140,36 @@ private:
 template <typename InputIterator>
 AlphaShape::AlphaShape(InputIterator first, InputIterator beyond) {
 	num_duplicated_ = 0;
-	InputIterator it = first;
-	for (int id = 0; it != beyond; ++it, ++id) {
-		const Point2& p = *it;
-		Vertex_handle vh = Ht::insert(p);
-		if (vh->index() == -1) {
+	build(first, beyond);
+}
+
+
+template <typename InputIterator>
+void AlphaShape::build(InputIterator first, InputIterator beyond) {
+	clear();
+	num_duplicated_ = 0;
+
+	const std::vector<Point2> points(first, beyond);
+	std::vector<std::size_t> order(points.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	typedef CGAL::Spatial_sort_traits_adapter_2<K, CGAL::Pointer_property_map<Point2>::const_type> Sort_traits;
+	CGAL::spatial_sort(order.begin(), order.end(), Sort_traits(CGAL::make_property_map(points)));
+
+	Face_handle hint;
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		int id = static_cast<int>(order[i]);
+		Vertex_handle vh = Ht::insert(points[id], hint);
+		if (vh->index() == -1)
 			vh->set_index(id);
-		}
-		else
+		else {
+			// a duplicated point keeps the smallest id (the first one in the list)
+			if (id < vh->index())
+				vh->set_index(id);
 			++num_duplicated_;
+		}
+		hint = vh->face();
 	}
 
 	//if (num_duplicated_ > 0)
@@ -160,6 +197,12 @@ AlphaShape::AlphaShape(InputIterator first, InputIterator beyond) {
 }
 
 
+inline AlphaShape& AlphaShape::thread_instance() {
+	thread_local AlphaShape as;
+	return as;
+}
+
+
 inline std::vector<Face_handle> AlphaShape::get_all_finite_facets()
 {
 	std::vector<Face_handle> facets;
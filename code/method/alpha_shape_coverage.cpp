@@ -0,0 +1,217 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "alpha_shape_coverage.h"
+#include "alpha_shape.h"
+#include "segment_footprint.h"
+#include "segment_projection.h"
+#include "../math/polygon2d.h"
+#include "../model/vertex_group.h"
+#include "../model/point_set.h"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+
+
+namespace {
+	// the maximum number of cells along each axis
+	const double max_resolution = 4096.0;
+
+	typedef vecng<2, double> dvec2;
+
+	// > 0 if p is on the left of the directed line (a, b)
+	inline double side(const dvec2& a, const dvec2& b, const dvec2& p) {
+		return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	}
+
+	// clips the convex polygon 'poly' by the half plane on the inner side of the edge (a, b) of a 
+	// polygon with the given orientation (1 for counterclockwise, -1 for clockwise)
+	void clip(const std::vector<dvec2>& poly, const dvec2& a, const dvec2& b, double orientation, std::vector<dvec2>& result) {
+		result.clear();
+		for (std::size_t i = 0; i < poly.size(); ++i) {
+			const dvec2& p = poly[i];
+			const dvec2& q = poly[(i + 1) % poly.size()];
+			double dp = side(a, b, p) * orientation;
+			double dq = side(a, b, q) * orientation;
+			if (dp >= 0)
+				result.push_back(p);
+			if ((dp >= 0) != (dq >= 0)) {
+				double t = dp / (dp - dq);
+				result.push_back(dvec2(p.x + t * (q.x - p.x), p.y + t * (q.y - p.y)));
+			}
+		}
+	}
+
+	double area(const std::vector<dvec2>& poly) {
+		double result = 0;
+		for (std::size_t i = 0; i < poly.size(); ++i) {
+			const dvec2& p = poly[i];
+			const dvec2& q = poly[(i + 1) % poly.size()];
+			result += p.x * q.y - q.x * p.y;
+		}
+		return std::fabs(result) * 0.5;
+	}
+}
+
+
+void AlphaShapeCoverage::build(const VertexGroup* g, float radius) {
+	corners_.clear();
+	cell_start_.clear();
+	entries_.clear();
+	nx_ = ny_ = 0;
+
+	const PointSet* pset = g->point_set();
+	if (!pset || g->size() < 3)
+		return;
+
+	// the alpha triangles of the footprint of the segment, if computed with the same radius
+	if (radius > 0 && SegmentFootprint::is_up_to_date(g, radius))
+		corners_ = g->footprint().alpha_triangles;
+	else {
+		const Plane3d& plane = g->plane();
+		const std::vector<vec3>& points = pset->points();
+		const VertexGroup::Projection* projection = SegmentProjection::of(g);
+		std::list<Point2> pts;
+		for (std::size_t i = 0; i < g->size(); ++i)
+			pts.push_back(to_cgal_point(projection ? projection->points[i] : plane.to_2d(points[g->at(i)])));
+
+		AlphaShape& as = AlphaShape::thread_instance();
+		as.build(pts.begin(), pts.end());
+		as.set_alpha(radius * radius);
+		for (AlphaShape::Finite_faces_iterator fit = as.finite_faces_begin(); fit != as.finite_faces_end(); ++fit) {
+			if (as.classify(fit) == AlphaShape::INTERIOR) {
+				for (int i = 0; i < 3; ++i)
+					corners_.push_back(to_my_point(fit->vertex(i)->point()));
+			}
+		}
+	}
+	if (corners_.empty())
+		return;
+
+	Box2d box;
+	for (std::size_t i = 0; i < corners_.size(); ++i)
+		box.add_point(corners_[i]);
+
+	// the alpha triangles are small (their edges are shorter than 2 * radius), so most of them 
+	// overlap a single cell
+	std::size_t num_triangles = corners_.size() / 3;
+	double w = double(box.x_max()) - box.x_min();
+	double h = double(box.y_max()) - box.y_min();
+	double extent = std::max(w, h);
+	cell_size_ = std::max(2.0 * radius, std::sqrt(w * h / num_triangles));
+	cell_size_ = std::max(cell_size_, extent / max_resolution);
+	if (cell_size_ <= 0)
+		cell_size_ = 1.0;
+
+	origin_ = vec2(box.x_min(), box.y_min());
+	nx_ = static_cast<int>(w / cell_size_) + 1;
+	ny_ = static_cast<int>(h / cell_size_) + 1;
+
+	// each triangle is registered in all the cells overlapped by its bounding box
+	cell_start_.assign(std::size_t(nx_) * ny_ + 1, 0);
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<unsigned int> next;
+		if (pass == 1) {
+			for (std::size_t c = 1; c < cell_start_.size(); ++c)
+				cell_start_[c] += cell_start_[c - 1];
+			entries_.resize(cell_start_.back());
+			next.assign(cell_start_.begin(), cell_start_.end() - 1);
+		}
+
+		for (std::size_t t = 0; t < num_triangles; ++t) {
+			const vec2* tri = &corners_[t * 3];
+			int ix0, iy0, ix1, iy1;
+			cell_range(
+				std::min(tri[0].x, std::min(tri[1].x, tri[2].x)), std::min(tri[0].y, std::min(tri[1].y, tri[2].y)),
+				std::max(tri[0].x, std::max(tri[1].x, tri[2].x)), std::max(tri[0].y, std::max(tri[1].y, tri[2].y)),
+				ix0, iy0, ix1, iy1
+			);
+			for (int iy = iy0; iy <= iy1; ++iy) {
+				for (int ix = ix0; ix <= ix1; ++ix) {
+					std::size_t c = std::size_t(iy) * nx_ + ix;
+					if (pass == 0)
+						++cell_start_[c + 1];
+					else
+						entries_[next[c]++] = static_cast<unsigned int>(t);
+				}
+			}
+		}
+	}
+}
+
+
+void AlphaShapeCoverage::cell_range(double x_min, double y_min, double x_max, double y_max, int& ix0, int& iy0, int& ix1, int& iy1) const {
+	ix0 = static_cast<int>(std::floor((x_min - origin_.x) / cell_size_));
+	iy0 = static_cast<int>(std::floor((y_min - origin_.y) / cell_size_));
+	ix1 = static_cast<int>(std::floor((x_max - origin_.x) / cell_size_));
+	iy1 = static_cast<int>(std::floor((y_max - origin_.y) / cell_size_));
+	ogf_clamp(ix0, 0, nx_ - 1);	ogf_clamp(iy0, 0, ny_ - 1);
+	ogf_clamp(ix1, 0, nx_ - 1);	ogf_clamp(iy1, 0, ny_ - 1);
+}
+
+
+double AlphaShapeCoverage::covered_area(const Polygon2d& plg) const {
+	if (corners_.empty() || plg.size() < 3)
+		return 0.0;
+
+	Box2d box;
+	for (std::size_t i = 0; i < plg.size(); ++i)
+		box.add_point(plg[i]);
+	int qx0, qy0, qx1, qy1;
+	cell_range(box.x_min(), box.y_min(), box.x_max(), box.y_max(), qx0, qy0, qx1, qy1);
+
+	double orientation = (Geom::signed_area(plg) > 0) ? 1.0 : -1.0;
+
+	double result = 0.0;
+	std::vector<dvec2> poly, clipped;
+	for (int iy = qy0; iy <= qy1; ++iy) {
+		for (int ix = qx0; ix <= qx1; ++ix) {
+			std::size_t c = std::size_t(iy) * nx_ + ix;
+			for (unsigned int k = cell_start_[c]; k < cell_start_[c + 1]; ++k) {
+				const vec2* tri = &corners_[entries_[k] * 3];
+				double x_min = std::min(tri[0].x, std::min(tri[1].x, tri[2].x));
+				double y_min = std::min(tri[0].y, std::min(tri[1].y, tri[2].y));
+				double x_max = std::max(tri[0].x, std::max(tri[1].x, tri[2].x));
+				double y_max = std::max(tri[0].y, std::max(tri[1].y, tri[2].y));
+
+				// a triangle overlapping several of the visited cells is only counted in the first one
+				int tx0, ty0, tx1, ty1;
+				cell_range(x_min, y_min, x_max, y_max, tx0, ty0, tx1, ty1);
+				if (std::max(tx0, qx0) != ix || std::max(ty0, qy0) != iy)
+					continue;
+
+				if (x_max < box.x_min() || x_min > box.x_max() || y_max < box.y_min() || y_min > box.y_max())
+					continue;
+
+				poly.clear();
+				for (int i = 0; i < 3; ++i)
+					poly.push_back(dvec2(tri[i].x, tri[i].y));
+				for (std::size_t i = 0, j = plg.size() - 1; i < plg.size() && !poly.empty(); j = i, ++i) {
+					clip(poly, dvec2(plg[j].x, plg[j].y), dvec2(plg[i].x, plg[i].y), orientation, clipped);
+					poly.swap(clipped);
+				}
+				result += area(poly);
+			}
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _ALPHA_SHAPE_COVERAGE_H_
+#define _ALPHA_SHAPE_COVERAGE_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+class VertexGroup;
+
+// The alpha shape of all the points of a segment (i.e., a VertexGroup), computed once in
+// the 2D frame (base1/base2) of its supporting plane. The area of a candidate face covered 
+// by the points is obtained by clipping the alpha triangles against the face polygon, instead
+// of computing a new alpha shape of the points projected in each face.
+class METHOD_API AlphaShapeCoverage
+{
+public:
+	AlphaShapeCoverage() : cell_size_(1.0), nx_(0), ny_(0) {}
+
+	// reuses the alpha shape of the footprint of the segment, if computed with this radius (see SegmentFootprint)
+	void build(const VertexGroup* g, float radius);
+
+	// returns the area of the intersection of the alpha shape and the *convex* polygon 'plg' 
+	// (given in the frame of the supporting plane)
+	double covered_area(const Polygon2d& plg) const;
+
+private:
+	// the range of the cells overlapped by the box [x_min, x_max] x [y_min, y_max] (clamped to the grid)
+	void cell_range(double x_min, double y_min, double x_max, double y_max, int& ix0, int& iy0, int& ix1, int& iy1) const;
+
+private:
+	std::vector<vec2>			corners_;		// every three consecutive corners form a triangle
+	vec2						origin_;		// the lower corner of the grid
+	double						cell_size_;
+	int							nx_, ny_;
+	// the triangles overlapping cell c are entries_[cell_start_[c], cell_start_[c+1])
+	std::vector<unsigned int>	cell_start_;	
+	std::vector<unsigned int>	entries_;
+};
+
+#endif
@@ -64,25 +64,21 @@ Map* AlphaShapeMesh::apply(AlphaShape* as, const Plane3d& plane, float radius) {
 	if (faces.empty())
         return nullptr;
 
-	Map* mesh = new Map;
-	MapBuilder builder(mesh);
-	builder.set_quiet(true);
-	builder.begin_surface();
-
-	for (std::size_t i = 0; i < points.size(); ++i)
-		builder.add_vertex(points[i]);
-
+	std::vector<unsigned int> face_offsets(1, 0);
+	std::vector<unsigned int> face_indices;
+	face_offsets.reserve(faces.size() + 1);
+	face_indices.reserve(faces.size() * 3);
 	for (std::size_t i = 0; i < faces.size(); ++i) {
 		const Triangle& tri = faces[i];
-		builder.begin_facet();
-        for (std::size_t j = 0; j < 3; ++j) {
-            int idx = tri[j];
-			builder.add_vertex_to_facet(idx);
-		}
-		builder.end_facet();
+        for (std::size_t j = 0; j < 3; ++j)
+			face_indices.push_back(tri[j]);
+		face_offsets.push_back(static_cast<unsigned int>(face_indices.size()));
 	}
 
-	builder.end_surface();
+	Map* mesh = new Map;
+	MapBuilder builder(mesh);
+	builder.set_quiet(true);
+	builder.build_from_arrays(points, face_offsets, face_indices);
 
 	return mesh;
 }
@@ -107,7 +103,8 @@ Map* AlphaShapeMesh::apply(const VertexGroup* g, float radius) {
 		pts.push_back(qq);
 	}
 
-	AlphaShape as(pts.begin(), pts.end());
+	AlphaShape& as = AlphaShape::thread_instance();
+	as.build(pts.begin(), pts.end());
 
 	return apply(&as, plane, radius);
 }
@@ -130,6 +127,42 @@ Map* AlphaShapeMesh::apply(const PointSet* pset, const std::vector<unsigned int>
 		pts.push_back(qq);
 	}
 
-	AlphaShape as(pts.begin(), pts.end());
+	AlphaShape& as = AlphaShape::thread_instance();
+	as.build(pts.begin(), pts.end());
 	return apply(&as, plane, radius);
 }
+
+
+double AlphaShapeMesh::covered_area(const PointSet* pset, const std::vector<unsigned int>& point_indices, const Plane3d& plane, float radius) {
+	if (point_indices.size() < 10)	// the same as apply()
+		return 0.0;
+
+	const std::vector<vec3>& points = pset->points();
+
+	std::list<Point2> pts;
+	for (std::size_t i = 0; i < point_indices.size(); ++i) {
+		unsigned int idx = point_indices[i];
+		const vec3& p = points[idx];
+		const vec2& q = plane.to_2d(p);
+		const Point2& qq = to_cgal_point(q);
+		pts.push_back(qq);
+	}
+
+	AlphaShape& as = AlphaShape::thread_instance();
+	as.build(pts.begin(), pts.end());
+	double alpha_value = radius * radius;
+	as.set_alpha(alpha_value);
+
+	double area = 0.0;
+	for (AlphaShape::Finite_faces_iterator fit = as.finite_faces_begin(); fit != as.finite_faces_end(); ++fit) {
+		if (as.classify(fit) == AlphaShape::INTERIOR) {
+			const vec2& a = to_my_point(fit->vertex(0)->point());
+			const vec2& b = to_my_point(fit->vertex(1)->point());
+			const vec2& c = to_my_point(fit->vertex(2)->point());
+			double cross = (double(b.x) - a.x) * (double(c.y) - a.y) - (double(b.y) - a.y) * (double(c.x) - a.x);
+			area += std::fabs(cross) * 0.5;
+		}
+	}
+
+	return area;
+}
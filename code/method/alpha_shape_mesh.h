@@ -42,4 +42,9 @@ public:
 	// the input is a subset of a point cloud and the points lie on plane
 	static Map* apply(const PointSet* pset, const std::vector<unsigned int>& point_indices, const Plane3d& plane, float radius);
 
+	// the area of the alpha shape of a subset of a point cloud (the points lie on plane). This is the 
+	// total area of the mesh that apply() would return, but it is computed directly from the 2D 
+	// triangulation without building the mesh.
+	static double covered_area(const PointSet* pset, const std::vector<unsigned int>& point_indices, const Plane3d& plane, float radius);
+
 };
\ No newline at end of file
@@ -0,0 +1,137 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "box_tree.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+	const std::size_t max_leaf_size = 4;
+
+	// test if the box is within distance 'tolerance' to the plane
+	bool plane_overlaps_box(const Plane3d& plane, const Box3d& box, double tolerance) {
+		double a = plane.a(), b = plane.b(), c = plane.c(), d = plane.d();
+		double len = std::sqrt(a * a + b * b + c * c);
+		if (len <= 0)
+			return true;
+
+		double cx = 0.5 * (double(box.x_min()) + box.x_max());
+		double cy = 0.5 * (double(box.y_min()) + box.y_max());
+		double cz = 0.5 * (double(box.z_min()) + box.z_max());
+		double ex = 0.5 * (double(box.x_max()) - box.x_min());
+		double ey = 0.5 * (double(box.y_max()) - box.y_min());
+		double ez = 0.5 * (double(box.z_max()) - box.z_min());
+
+		double dist = std::abs(a * cx + b * cy + c * cz + d) / len;
+		double radius = (std::abs(a) * ex + std::abs(b) * ey + std::abs(c) * ez) / len;
+		return dist <= radius + tolerance;
+	}
+
+	struct CenterLess {
+		CenterLess(const std::vector<Box3d>& boxes, unsigned int axis) : boxes_(boxes), axis_(axis) {}
+		bool operator()(std::size_t i, std::size_t j) const {
+			return (boxes_[i].min(axis_) + boxes_[i].max(axis_)) < (boxes_[j].min(axis_) + boxes_[j].max(axis_));
+		}
+		const std::vector<Box3d>& boxes_;
+		unsigned int axis_;
+	};
+}
+
+
+BoxTree::BoxTree(const std::vector<Box3d>& boxes) 
+	: boxes_(boxes) 
+{
+	indices_.resize(boxes_.size());
+	for (std::size_t i = 0; i < indices_.size(); ++i)
+		indices_[i] = i;
+
+	if (!boxes_.empty()) {
+		nodes_.reserve(2 * boxes_.size() / max_leaf_size + 1);
+		build(0, boxes_.size());
+	}
+}
+
+
+std::size_t BoxTree::build(std::size_t begin, std::size_t end) {
+	std::size_t id = nodes_.size();
+	nodes_.push_back(Node());
+
+	Box3d box;
+	for (std::size_t i = begin; i < end; ++i)
+		box.add_box(boxes_[indices_[i]]);
+	nodes_[id].box = box;
+
+	if (end - begin <= max_leaf_size) {
+		nodes_[id].begin = begin;
+		nodes_[id].end = end;
+		nodes_[id].is_leaf = true;
+		return id;
+	}
+
+	// split at the median along the longest axis
+	unsigned int axis = 0;
+	if (box.height() > box.width())
+		axis = 1;
+	if (box.depth() > std::max(box.width(), box.height()))
+		axis = 2;
+
+	std::size_t mid = begin + (end - begin) / 2;
+	std::nth_element(indices_.begin() + begin, indices_.begin() + mid, indices_.begin() + end, CenterLess(boxes_, axis));
+
+	// the children are added after this node, so 'nodes_[id]' can't be held as a reference
+	std::size_t left = build(begin, mid);
+	std::size_t right = build(mid, end);
+	nodes_[id].begin = left;
+	nodes_[id].end = right;
+	nodes_[id].is_leaf = false;
+	return id;
+}
+
+
+void BoxTree::intersected_boxes(const Plane3d& plane, double tolerance, std::vector<std::size_t>& result) const {
+	result.clear();
+	if (nodes_.empty())
+		return;
+
+	std::vector<std::size_t> stack(1, 0);
+	while (!stack.empty()) {
+		const Node& node = nodes_[stack.back()];
+		stack.pop_back();
+		if (!plane_overlaps_box(plane, node.box, tolerance))
+			continue;
+
+		if (node.is_leaf) {
+			for (std::size_t i = node.begin; i < node.end; ++i) {
+				std::size_t idx = indices_[i];
+				if (plane_overlaps_box(plane, boxes_[idx], tolerance))
+					result.push_back(idx);
+			}
+		}
+		else {
+			stack.push_back(node.begin);
+			stack.push_back(node.end);
+		}
+	}
+
+	// report the boxes in the order they were given
+	std::sort(result.begin(), result.end());
+}
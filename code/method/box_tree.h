@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _BOX_TREE_H_
+#define _BOX_TREE_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+// A bounding volume hierarchy over a set of axis-aligned boxes. It answers which boxes 
+// are (nearly) intersected by a plane, in roughly logarithmic time instead of testing 
+// all the boxes.
+class METHOD_API BoxTree
+{
+public:
+	BoxTree(const std::vector<Box3d>& boxes);
+
+	// collects the indices of the boxes intersecting 'plane', or within a distance of
+	// 'tolerance' to it. The test is conservative: a reported box may still miss the plane.
+	void intersected_boxes(const Plane3d& plane, double tolerance, std::vector<std::size_t>& result) const;
+
+private:
+	struct Node {
+		Box3d		box;
+		// for leaves: [begin, end) is a range in 'indices_'; for inner nodes: the two children
+		std::size_t begin;
+		std::size_t end;
+		bool		is_leaf;
+	};
+
+	// returns the index of the node built for indices_[begin, end)
+	std::size_t build(std::size_t begin, std::size_t end);
+
+private:
+	std::vector<Box3d>			boxes_;
+	std::vector<std::size_t>	indices_;
+	std::vector<Node>			nodes_;
+};
+
+#endif
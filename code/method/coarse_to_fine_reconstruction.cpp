@@ -0,0 +1,277 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "coarse_to_fine_reconstruction.h"
+#include "method_global.h"
+#include "hypothesis_generator.h"
+#include "face_selection.h"
+#include "reconstruction_context.h"
+#include "../basic/logger.h"
+#include "../basic/parallel.h"
+#include "../basic/stop_watch.h"
+#include "../model/map.h"
+#include "../model/map_builder.h"
+#include "../model/map_editor.h"
+#include "../model/point_set.h"
+#include "../model/point_set_downsampler.h"
+#include "../model/plane_detector.h"
+#include "../model/kdtree_search.h"
+
+#include <cmath>
+
+
+namespace {
+
+	// A copy of the points of the given segments (all of them if 'segments' is nil) and of the segments.
+	// The other points are left out.
+	PointSet* copy_segments(const PointSet* pset, const std::vector<VertexGroup*>* segments) {
+		std::vector<VertexGroup*> groups;
+		if (segments)
+			groups = *segments;
+		else {
+			for (std::size_t i = 0; i < pset->groups().size(); ++i)
+				groups.push_back(pset->groups()[i]);
+		}
+
+		// the new index of each point kept
+		std::vector<int> index(pset->points().size(), segments ? -1 : 0);
+		std::vector<unsigned int> kept;
+		if (segments) {
+			for (std::size_t i = 0; i < groups.size(); ++i) {
+				const VertexGroup* g = groups[i];
+				for (std::size_t k = 0; k < g->size(); ++k)
+					index[g->at(k)] = 0;
+			}
+		}
+		for (std::size_t v = 0; v < index.size(); ++v) {
+			if (index[v] == 0) {
+				index[v] = static_cast<int>(kept.size());
+				kept.push_back(static_cast<unsigned int>(v));
+			}
+		}
+
+		PointSet* copy = new PointSet;
+		copy->points().resize(kept.size());
+		for (std::size_t k = 0; k < kept.size(); ++k)
+			copy->points()[k] = pset->points()[kept[k]];
+		if (pset->has_normals()) {
+			copy->normals().resize(kept.size());
+			for (std::size_t k = 0; k < kept.size(); ++k)
+				copy->normals()[k] = pset->normals()[kept[k]];
+		}
+		if (pset->has_colors()) {
+			copy->colors().resize(kept.size());
+			for (std::size_t k = 0; k < kept.size(); ++k)
+				copy->colors()[k] = pset->colors()[kept[k]];
+		}
+		if (pset->has_weights()) {
+			copy->weights().resize(kept.size());
+			for (std::size_t k = 0; k < kept.size(); ++k)
+				copy->weights()[k] = pset->weights()[kept[k]];
+		}
+
+		for (std::size_t i = 0; i < groups.size(); ++i) {
+			const VertexGroup* g = groups[i];
+			VertexGroup::Ptr part = new VertexGroup(copy);
+			part->reserve(g->size());
+			for (std::size_t k = 0; k < g->size(); ++k)
+				part->push_back(static_cast<unsigned int>(index[g->at(k)]));
+			part->set_label(g->label());
+			part->set_color(g->color());
+			part->set_plane(g->plane());
+			copy->groups().push_back(std::move(part));
+		}
+		return copy;
+	}
+
+
+	// selects the faces of the candidates 'mesh' of 'pset' (generated by 'hypothesis'), returns false if none is selected
+	bool select_faces(PointSet* pset, HypothesisGenerator& hypothesis, Map* mesh, const Reconstruction::Parameters& params, const ReconstructionContext& context) {
+		hypothesis.compute_confidences(mesh, false);
+		const HypothesisGenerator::Adjacency& adjacency = hypothesis.extract_adjacency(mesh);
+		FaceSelection selector(pset, mesh);
+		selector.set_context(&context);
+		selector.optimize(adjacency, params.solver);
+		return mesh->size_of_facets() > 0;
+	}
+
+
+	// Points on the faces of the coarse model, no farther apart than 'spacing' (each face is split 
+	// into a fan of triangles, which are sampled on a regular grid).
+	void sample_faces(const Map* mesh, float spacing, std::vector<vec3>& samples) {
+		samples.clear();
+		FOR_EACH_FACET_CONST(Map, mesh, it) {
+			const Map::Halfedge* h = it->halfedge();
+			const vec3& a = h->vertex()->point();
+			for (const Map::Halfedge* jt = h->next(); jt->next() != h; jt = jt->next()) {
+				const vec3& b = jt->vertex()->point();
+				const vec3& c = jt->next()->vertex()->point();
+				float longest = ogf_max(distance(a, b), ogf_max(distance(b, c), distance(c, a)));
+				int n = ogf_max(1, static_cast<int>(std::ceil(longest / spacing)));
+				for (int i = 0; i <= n; ++i) {
+					for (int j = 0; i + j <= n; ++j)
+						samples.push_back(a + (float(i) / n) * (b - a) + (float(j) / n) * (c - a));
+				}
+			}
+		}
+	}
+}
+
+
+Map* CoarseToFineReconstruction::reconstruct(const PointSet* pset, const Parameters& params) {
+	if (!pset || pset->points().empty()) {
+		Logger::err("-") << "the input has no point" << std::endl;
+		return nil;
+	}
+
+	// the settings of both passes (see ReconstructionContext)
+	ReconstructionContext context;
+	context.lambda_data_fitting = params.selection.fitting;
+	context.lambda_model_coverage = params.selection.coverage;
+	context.lambda_model_complexity = params.selection.complexity;
+	if (params.selection.time_limit > 0.0)
+		context.selection_time_limit = params.selection.time_limit;
+
+	PointSet::Ptr input = copy_segments(pset, nil);
+	if (input->groups().empty())
+		PlaneDetector::detect(input, PlaneDetector::Parameters(), Method::num_threads);
+	if (input->groups().empty()) {
+		Logger::err("-") << "planar segments do not exist" << std::endl;
+		return nil;
+	}
+
+	const Box3d& box = input->bbox();
+	float diagonal = 2.0f * box.radius();
+	float cell_size = params.coarse_cell_size > 0 ? params.coarse_cell_size : diagonal / 200.0f;
+	float band = params.band > 0 ? params.band : 3.0f * cell_size;
+
+	// the coarse pass
+	StopWatch w;
+	std::vector<vec3> samples;
+	const float spacing = 0.5f * band;
+	{
+		PointSet::Ptr coarse = copy_segments(input, nil);
+		PointSetDownsampler::voxel_grid(coarse, cell_size, Method::num_threads);
+		HypothesisGenerator hypothesis(coarse);
+		hypothesis.set_context(&context);
+		hypothesis.refine_planes(params.coarse_angle, params.coarse_distance_factor);
+		Map::Ptr mesh = hypothesis.generate();
+		if (mesh && select_faces(coarse, hypothesis, mesh, params.selection, context))
+			sample_faces(mesh, spacing, samples);
+		Logger::out("-") << "coarse pass: " << coarse->groups().size() << " segments, " 
+			<< (mesh ? mesh->size_of_facets() : 0) << " faces. " << w.elapsed() << " sec" << std::endl;
+	}
+	if (samples.empty())
+		Logger::warn("-") << "the coarse pass has no model, the fine pass is not pruned" << std::endl;
+
+	KdTreeSearch_var coarse_surface;
+	if (!samples.empty()) {
+		coarse_surface = new KdTreeSearch;
+		coarse_surface->build(samples, Method::num_threads);
+	}
+	// a point is near the coarse model if it is within the band (up to the spacing of the samples)
+	const double max_squared_distance = double(band + spacing) * double(band + spacing);
+	auto near_coarse_model = [&](const vec3& p) {
+		double squared_distance = 0.0;
+		return !coarse_surface || (coarse_surface->find_closest_point(p, squared_distance) >= 0 && squared_distance <= max_squared_distance);
+	};
+
+	// the fine segments near the coarse model (tested at up to 64 of their points, evenly spread)
+	std::vector<VertexGroup::Ptr>& groups = input->groups();
+	std::vector<char> keep(groups.size(), 0);
+	parallel_for(groups.size(), [&](std::size_t i) {
+		const VertexGroup* g = groups[i];
+		std::size_t step = ogf_max<std::size_t>(1, g->size() / 64);
+		for (std::size_t k = 0; k < g->size() && !keep[i]; k += step)
+			keep[i] = near_coarse_model(input->points()[g->at(k)]);
+	}, nil, Method::num_threads);
+	std::vector<VertexGroup*> kept;
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		if (keep[i])
+			kept.push_back(groups[i]);
+	}
+	Logger::out("-") << kept.size() << " of the " << groups.size() << " segments are near the coarse model" << std::endl;
+	if (kept.empty()) {
+		Logger::err("-") << "no segment is near the coarse model" << std::endl;
+		return nil;
+	}
+
+	// the fine pass
+	w.start();
+	PointSet::Ptr fine = copy_segments(input, &kept);
+	input.forget();
+
+	HypothesisGenerator hypothesis(fine);
+	hypothesis.set_context(&context);
+	hypothesis.refine_planes();
+	Map::Ptr mesh = hypothesis.generate();
+	if (!mesh) {
+		Logger::err("-") << "failed generating candidate faces" << std::endl;
+		return nil;
+	}
+
+	// the candidate faces with no vertex (nor the center) near the coarse model are dropped
+	if (coarse_surface) {
+		std::vector<Map::Facet*> facets;
+		FOR_EACH_FACET(Map, mesh, it)
+			facets.push_back(it);
+		std::vector<char> near(facets.size(), 0);
+		parallel_for(facets.size(), [&](std::size_t i) {
+			Map::Halfedge* h = facets[i]->halfedge();
+			vec3 center(0, 0, 0);
+			int degree = 0;
+			do {
+				const vec3& p = h->vertex()->point();
+				near[i] = near[i] || near_coarse_model(p);
+				center = center + p;
+				++degree;
+				h = h->next();
+			} while (h != facets[i]->halfedge() && !near[i]);
+			if (!near[i])
+				near[i] = near_coarse_model(center / static_cast<float>(degree));
+		}, nil, Method::num_threads);
+
+		MapEditor editor(mesh);
+		std::size_t num_dropped = 0;
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			if (!near[i]) {
+				editor.erase_facet(facets[i]->halfedge());
+				++num_dropped;
+			}
+		}
+		Logger::out("-") << num_dropped << " of the " << facets.size() << " candidate faces are far from the coarse model" << std::endl;
+	}
+
+	if (!select_faces(fine, hypothesis, mesh, params.selection, context)) {
+		Logger::err("-") << "optimization failed: model has no face" << std::endl;
+		return nil;
+	}
+	Logger::out("-") << "fine pass: " << mesh->size_of_facets() << " faces. " << w.elapsed() << " sec" << std::endl;
+
+	// a plain copy of the model (its attributes refer to the point set and the planes of the fine pass)
+	Reconstruction::Mesh buffers;
+	Reconstruction::extract_buffers(mesh, buffers);
+	std::vector<vec3> points(buffers.num_vertices());
+	for (std::size_t i = 0; i < points.size(); ++i)
+		points[i] = vec3(buffers.vertices[i * 3], buffers.vertices[i * 3 + 1], buffers.vertices[i * 3 + 2]);
+	Map* result = new Map;
+	MapBuilder builder(result);
+	builder.build_from_arrays(points, buffers.face_offsets, buffers.face_indices);
+	return result;
+}
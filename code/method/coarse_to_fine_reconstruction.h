@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _COARSE_TO_FINE_RECONSTRUCTION_H_
+#define _COARSE_TO_FINE_RECONSTRUCTION_H_
+
+#include "method_common.h"
+#include "reconstruction.h"
+
+
+class Map;
+class PointSet;
+
+
+/**
+* A two-level reconstruction of large scenes, most of whose candidate faces are obviously irrelevant.
+* The coarse pass reconstructs a downsampled copy of the points, with the segments merged aggressively
+* (see HypothesisGenerator::refine_planes()), which is cheap. The fine pass then works with the full
+* segments, keeping only those near the coarse model for generating the candidate faces, and only the
+* candidate faces near the coarse model for the confidences and the face selection.
+*/
+
+class METHOD_API CoarseToFineReconstruction
+{
+public:
+	struct Parameters {
+		Parameters() : coarse_angle(25.0f), coarse_distance_factor(2.0f), coarse_cell_size(0.0f), band(0.0f) {}
+
+		float coarse_angle;				// the merging of the segments of the coarse pass (see
+		float coarse_distance_factor;	// HypothesisGenerator::refine_planes())
+		float coarse_cell_size;			// of the downsampling of the coarse pass (0: 1/200 of the diagonal of the scene)
+		float band;						// the distance to the coarse model up to which the segments and the
+										// candidate faces are kept (0: three cells of the downsampling)
+		Reconstruction::Parameters	selection;	// of both passes
+	};
+
+public:
+	// Reconstructs the model of a point set (the segments are detected if it has none). If the coarse 
+	// pass has no model, the fine pass works with all the segments and candidate faces. Returns nil 
+	// (and logs why) if it fails. The point set is not changed.
+	static Map* reconstruct(const PointSet* pset, const Parameters& params);
+};
+
+
+#endif
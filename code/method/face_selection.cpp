@@ -20,26 +20,813 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "face_selection.h"
 #include "method_global.h"
+#include "memory_planner.h"
+#include "reconstruction_context.h"
+#include "selection_policy.h"
 #include "../basic/stop_watch.h"
+#include "../basic/profiler.h"
 #include "../model/point_set.h"
 #include "../model/map_geometry.h"
 #include "../basic/logger.h"
 #include "../model/map_editor.h"
+#include "../model/map_builder.h"
+#include "../model/map_copier.h"
+#include "../basic/parallel.h"
+#include "../basic/progress.h"
+#include "../math/solution_cache.h"
+#include "../math/max_flow.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace {
+
+	// Shows the progress of a search (by the gap between the incumbent and the bound), and cancels it
+	// when the user cancels the progress. It must outlive the solves it is attached to.
+	class SearchMonitor {
+	public:
+		SearchMonitor(bool verbose = true) : progress_(100), interrupt_(false), verbose_(verbose), last_notified_(-1.0), last_logged_(0.0) {}
+
+		// also forwards each progress to 'callback' (e.g., see FaceSelection::set_search_callback())
+		void set_callback(const std::function<void(const LinearProgramSolver::SearchProgress&)>& callback) { callback_ = callback; }
+
+		void attach(LinearProgramSolver::SolverOptions& options) {
+			options.interrupt = &interrupt_;
+			options.progress_callback = [this](const LinearProgramSolver::SearchProgress& progress) { report(progress); };
+		}
+
+	private:
+		void report(const LinearProgramSolver::SearchProgress& progress) {
+			if (interrupt_.load())
+				return;
+			if (progress_.is_canceled()) {
+				interrupt_ = true;
+				Logger::warn("-") << "canceling the search..." << std::endl;
+				return;
+			}
+			if (callback_)
+				callback_(progress);
+
+			double time = watch_.elapsed();
+			if (time - last_notified_ < 0.5)
+				return;
+			last_notified_ = time;
+
+			double gap = 1.0;
+			if (progress.has_incumbent && progress.has_bound)
+				gap = std::min(std::abs(progress.incumbent - progress.bound) / std::max(std::abs(progress.incumbent), 1e-10), 1.0);
+			// notified directly (instead of only on changes) so the pending events, e.g., a click on 
+			// 'cancel', are handled while the gap stagnates
+			Progress::instance()->notify(static_cast<std::size_t>(100.0 * (1.0 - gap)));
+
+			if (verbose_ && time - last_logged_ >= 5.0) {
+				last_logged_ = time;
+				Logger::out(" ") << "    nodes: " << progress.nodes;
+				if (progress.has_incumbent)
+					Logger::out(" ") << ", incumbent: " << progress.incumbent;
+				if (progress.has_bound)
+					Logger::out(" ") << ", bound: " << progress.bound;
+				Logger::out(" ") << ", " << time << " sec" << std::endl;
+			}
+		}
+
+	private:
+		ProgressLogger		progress_;
+		std::atomic<bool>	interrupt_;
+		bool				verbose_;
+		std::function<void(const LinearProgramSolver::SearchProgress&)>	callback_;
+		StopWatch			watch_;
+		double				last_notified_;
+		double				last_logged_;
+	};
+
+
+	// the options of the solvers of the face selection problem
+	LinearProgramSolver::SolverOptions selection_solver_options(double time_limit, SearchMonitor* monitor = 0) {
+		LinearProgramSolver::SolverOptions options;
+		options.time_limit = time_limit;
+		options.deterministic = Method::deterministic;
+		options.num_threads = parallel_thread_budget();	// the share of a job, if given (0 lets the solver decide)
+		if (monitor)
+			monitor->attach(options);
+		return options;
+	}
+
+
+	// the cache of the solutions of the face selection problem set by the options (null if none), 
+	// shared by the selections of concurrent jobs
+	SolutionCache* selection_cache() {
+		static std::mutex mutex;
+		static std::unique_ptr<SolutionCache> cache;
+		static std::string directory;
+		static unsigned int capacity = 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!cache || directory != Method::selection_cache_directory || capacity != Method::selection_cache_capacity) {
+			directory = Method::selection_cache_directory;
+			capacity = Method::selection_cache_capacity;
+			if (!directory.empty())
+				cache.reset(new DirectorySolutionCache(directory));
+			else if (capacity > 0)
+				cache.reset(new MemorySolutionCache(capacity));
+			else
+				cache.reset();
+		}
+		return cache.get();
+	}
+
+
+	class UnionFind {
+	public:
+		UnionFind(std::size_t n) : parent_(n) {
+			for (std::size_t i = 0; i < n; ++i)
+				parent_[i] = i;
+		}
+		std::size_t find(std::size_t i) {
+			while (parent_[i] != i) {
+				parent_[i] = parent_[parent_[i]];
+				i = parent_[i];
+			}
+			return i;
+		}
+		void unite(std::size_t i, std::size_t j) {
+			i = find(i);
+			j = find(j);
+			if (i < j)
+				parent_[j] = i;
+			else if (j < i)
+				parent_[i] = j;
+		}
+	private:
+		std::vector<std::size_t> parent_;
+	};
+
+
+	// a part of a linear program that shares no constraint with the rest of it
+	struct ProgramComponent {
+		std::vector<std::size_t> variables;		// indices in the whole program
+		std::vector<std::size_t> constraints;	// indices in the whole program
+	};
+
+
+	// Groups the variables linked by the constraints. The components are sorted by decreasing number of
+	// variables (so the largest ones are started first), and "local_index" gives the position of each 
+	// variable in its component.
+	std::vector<ProgramComponent> connected_components(const LinearProgram& program, std::vector<std::size_t>& local_index) {
+		std::size_t num_variables = program.num_variables();
+		const std::vector<LinearConstraint*>& constraints = program.constraints();
+
+		UnionFind sets(num_variables);
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const SparseRow coeffs = constraints[i]->coefficients();
+			if (coeffs.empty())
+				continue;
+			std::size_t first = coeffs.index(0);
+			for (std::size_t k = 1; k < coeffs.size(); ++k)
+				sets.unite(first, coeffs.index(k));
+		}
+
+		std::vector<std::size_t> component_of_root(num_variables, num_variables);
+		std::vector<ProgramComponent> components;
+		local_index.assign(num_variables, 0);
+		for (std::size_t i = 0; i < num_variables; ++i) {
+			std::size_t root = sets.find(i);
+			if (component_of_root[root] == num_variables) {
+				component_of_root[root] = components.size();
+				components.push_back(ProgramComponent());
+			}
+			ProgramComponent& comp = components[component_of_root[root]];
+			local_index[i] = comp.variables.size();
+			comp.variables.push_back(i);
+		}
+
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const SparseRow coeffs = constraints[i]->coefficients();
+			if (!coeffs.empty())
+				components[component_of_root[sets.find(coeffs.index(0))]].constraints.push_back(i);
+		}
+
+		std::stable_sort(components.begin(), components.end(), [](const ProgramComponent& a, const ProgramComponent& b) {
+			return a.variables.size() > b.variables.size();
+		});
+		return components;
+	}
+
+
+	// the statistics of the face selection problem (formulated in 'program') the policy decides from
+	SelectionPolicy::Statistics problem_statistics(const HypothesisGenerator::Adjacency& adjacency, const LinearProgram& program, std::size_t num_faces) {
+		SelectionPolicy::Statistics statistics;
+		statistics.num_faces = num_faces;
+		statistics.num_variables = program.num_variables();
+		statistics.num_constraints = program.num_constraints();
+		for (std::size_t i = 0; i < adjacency.size(); ++i) {
+			std::size_t size = adjacency[i].size();
+			if (statistics.fan_sizes.size() <= size)
+				statistics.fan_sizes.resize(size + 1, 0);
+			++statistics.fan_sizes[size];
+		}
+
+		std::vector<std::size_t> local_index;
+		std::vector<ProgramComponent> components = connected_components(program, local_index);
+		for (std::size_t i = 0; i < components.size(); ++i)
+			statistics.component_variables.push_back(components[i].variables.size());
+		return statistics;
+	}
+
+
+	// creates in "sub" the program of a component, with the variables indexed by their positions in the component
+	void extract_component(const LinearProgram& program, const ProgramComponent& comp, const std::vector<std::size_t>& local_index, LinearProgram& sub) {
+		const std::vector<Variable*>& variables = program.variables();
+		for (std::size_t i = 0; i < comp.variables.size(); ++i) {
+			const Variable* v = variables[comp.variables[i]];
+			double lb, ub;
+			v->get_bounds(lb, ub);
+			sub.create_variable(v->variable_type(), v->bound_type(), lb, ub);
+		}
+
+		const std::vector<LinearConstraint*>& constraints = program.constraints();
+		for (std::size_t i = 0; i < comp.constraints.size(); ++i) {
+			const LinearConstraint* c = constraints[comp.constraints[i]];
+			double lb, ub;
+			c->get_bounds(lb, ub);
+			LinearConstraint* sc = sub.create_constraint(c->bound_type(), lb, ub);
+			sc->set_lazy(c->is_lazy());
+			const SparseRow coeffs = c->coefficients();
+			for (std::size_t k = 0; k < coeffs.size(); ++k)
+				sc->add_coefficient(static_cast<int>(local_index[coeffs.index(k)]), coeffs.value(k));
+		}
+
+		const LinearObjective* objective = program.objective();
+		LinearObjective* so = sub.create_objective(objective->sense());
+		const SparseRow obj_coeffs = objective->coefficients();
+		for (std::size_t i = 0; i < comp.variables.size(); ++i) {
+			std::size_t pos = obj_coeffs.find(static_cast<int>(comp.variables[i]));
+			if (pos < obj_coeffs.size())
+				so->add_coefficient(static_cast<int>(i), obj_coeffs.value(pos));
+		}
+	}
+
+
+	const double presolve_epsilon = 1e-9;
+
+
+	// the bounds of a constraint (the unused bound of a one-sided constraint is infinite)
+	void effective_bounds(const LinearConstraint* c, double& lb, double& ub) {
+		lb = -Bound::infinity();
+		ub = +Bound::infinity();
+		switch (c->bound_type()) {
+		case Bound::FIXED:	lb = ub = c->get_bound(); break;
+		case Bound::LOWER:	lb = c->get_bound(); break;
+		case Bound::UPPER:	ub = c->get_bound(); break;
+		case Bound::DOUBLE:	c->get_bounds(lb, ub); break;
+		default: break;
+		}
+	}
+
+
+	// Presolve of a binary program: fixes the variables forced by the constraints (e.g., all the faces of
+	// a fan with fewer than four faces), propagates the fixings through the other constraints until nothing
+	// changes, and drops the constraints that can't be violated anymore.
+	class BinaryPresolve {
+	public:
+		// returns false if the program is found to be infeasible
+		bool run(const LinearProgram& program) {
+			const std::vector<LinearConstraint*>& constraints = program.constraints();
+			std::size_t num_variables = program.num_variables();
+			value_.assign(num_variables, -1);
+			dropped_.assign(constraints.size(), 0);
+			num_fixed_ = num_dropped_ = 0;
+
+			std::vector< std::vector<std::size_t> > variable_constraints(num_variables);
+			for (std::size_t i = 0; i < constraints.size(); ++i) {
+				const SparseRow coeffs = constraints[i]->coefficients();
+				for (std::size_t k = 0; k < coeffs.size(); ++k)
+					variable_constraints[coeffs.index(k)].push_back(i);
+			}
+
+			std::vector<std::size_t> queue(constraints.size());
+			std::vector<char> queued(constraints.size(), 1);
+			for (std::size_t i = 0; i < constraints.size(); ++i)
+				queue[i] = i;
+
+			while (!queue.empty()) {
+				std::size_t ci = queue.back();
+				queue.pop_back();
+				queued[ci] = 0;
+				if (dropped_[ci])
+					continue;
+
+				const LinearConstraint* c = constraints[ci];
+				const SparseRow coeffs = c->coefficients();
+				double lb, ub;
+				effective_bounds(c, lb, ub);
+
+				bool changed = true;
+				while (changed) {
+					changed = false;
+					double min_activity = 0.0, max_activity = 0.0;
+					activity(coeffs, min_activity, max_activity);
+					if (min_activity > ub + presolve_epsilon || max_activity < lb - presolve_epsilon)
+						return false;
+					if (min_activity >= lb - presolve_epsilon && max_activity <= ub + presolve_epsilon) {
+						dropped_[ci] = 1;
+						++num_dropped_;
+						break;
+					}
+
+					for (std::size_t k = 0; k < coeffs.size(); ++k) {
+						std::size_t var = coeffs.index(k);
+						double a = coeffs.value(k);
+						if (value_[var] != -1 || a == 0.0)
+							continue;
+
+						// can the constraint still be satisfied with the variable set to 1 (resp. 0)?
+						bool one_feasible = (a > 0) ? (min_activity + a <= ub + presolve_epsilon) : (max_activity + a >= lb - presolve_epsilon);
+						bool zero_feasible = (a > 0) ? (max_activity - a >= lb - presolve_epsilon) : (min_activity - a <= ub + presolve_epsilon);
+						if (one_feasible && zero_feasible)
+							continue;
+						if (!one_feasible && !zero_feasible)
+							return false;
+
+						value_[var] = one_feasible ? 1 : 0;
+						++num_fixed_;
+						const std::vector<std::size_t>& neighbors = variable_constraints[var];
+						for (std::size_t j = 0; j < neighbors.size(); ++j) {
+							std::size_t cj = neighbors[j];
+							if (!queued[cj] && !dropped_[cj]) {
+								queued[cj] = 1;
+								queue.push_back(cj);
+							}
+						}
+						changed = true;
+						break;	// the activity range has changed
+					}
+				}
+			}
+			return true;
+		}
+
+		std::size_t num_fixed() const { return num_fixed_; }
+		std::size_t num_dropped() const { return num_dropped_; }
+
+		// creates in "reduced" the program on the free variables and the remaining constraints
+		void reduce(const LinearProgram& program, LinearProgram& reduced) {
+			const std::vector<Variable*>& variables = program.variables();
+			reduced_index_.assign(variables.size(), 0);
+			free_variables_.clear();
+			for (std::size_t i = 0; i < variables.size(); ++i) {
+				if (value_[i] != -1)
+					continue;
+				reduced_index_[i] = free_variables_.size();
+				free_variables_.push_back(i);
+				Variable* v = reduced.create_variable();
+				v->set_variable_type(Variable::BINARY);
+			}
+
+			const std::vector<LinearConstraint*>& constraints = program.constraints();
+			for (std::size_t i = 0; i < constraints.size(); ++i) {
+				if (dropped_[i])
+					continue;
+				const LinearConstraint* c = constraints[i];
+				const SparseRow coeffs = c->coefficients();
+				double shift = 0.0;
+				for (std::size_t k = 0; k < coeffs.size(); ++k) {
+					if (value_[coeffs.index(k)] == 1)
+						shift += coeffs.value(k);
+				}
+
+				double lb, ub;
+				effective_bounds(c, lb, ub);
+				LinearConstraint* rc = reduced.create_constraint(c->bound_type(), lb - shift, ub - shift);
+				rc->set_lazy(c->is_lazy());
+				for (std::size_t k = 0; k < coeffs.size(); ++k) {
+					if (value_[coeffs.index(k)] == -1)
+						rc->add_coefficient(static_cast<int>(reduced_index_[coeffs.index(k)]), coeffs.value(k));
+				}
+			}
+
+			const LinearObjective* objective = program.objective();
+			LinearObjective* ro = reduced.create_objective(objective->sense());
+			const SparseRow obj_coeffs = objective->coefficients();
+			for (std::size_t k = 0; k < obj_coeffs.size(); ++k) {
+				if (value_[obj_coeffs.index(k)] == -1)
+					ro->add_coefficient(static_cast<int>(reduced_index_[obj_coeffs.index(k)]), obj_coeffs.value(k));
+			}
+			reduced.finalize();
+		}
+
+		// the part of a solution of the whole program on the free variables
+		std::vector<double> reduce_solution(const std::vector<double>& X) const {
+			std::vector<double> x(free_variables_.size());
+			for (std::size_t i = 0; i < free_variables_.size(); ++i)
+				x[i] = X[free_variables_[i]];
+			return x;
+		}
+
+		// the solution of the whole program from a solution "x" of the reduced one
+		std::vector<double> restore_solution(const std::vector<double>& x) const {
+			std::vector<double> X(value_.size());
+			for (std::size_t i = 0; i < value_.size(); ++i)
+				X[i] = (value_[i] == -1) ? x[reduced_index_[i]] : double(value_[i]);
+			return X;
+		}
+
+	private:
+		void activity(const SparseRow& coeffs, double& min_activity, double& max_activity) const {
+			for (std::size_t k = 0; k < coeffs.size(); ++k) {
+				double a = coeffs.value(k);
+				int v = value_[coeffs.index(k)];
+				if (v == 1) {
+					min_activity += a;
+					max_activity += a;
+				}
+				else if (v == -1) {
+					if (a > 0)
+						max_activity += a;
+					else
+						min_activity += a;
+				}
+			}
+		}
+
+	private:
+		std::vector<int>			value_;			// -1: free, otherwise the fixed value
+		std::vector<char>			dropped_;		// per constraint
+		std::vector<std::size_t>	reduced_index_;	// index of each free variable in the reduced program
+		std::vector<std::size_t>	free_variables_;
+		std::size_t					num_fixed_;
+		std::size_t					num_dropped_;
+	};
+
+
+	// Contracts the faces whose super edges force them to be selected together. The faces of the super
+	// edges of a size other than 4 can't be selected, and so neither can the single face of a super edge
+	// of 4 faces whose other faces can't: the remaining two faces of a super edge whose other two faces
+	// can't be selected are either both selected or both not (as is the edge). These faces are merged 
+	// into one variable (with the sum of their objective coefficients), repeatedly until nothing changes,
+	// and the program is rewritten on the merged variables.
+	class FanContraction {
+	public:
+		void run(const HypothesisGenerator::Adjacency& adjacency, const std::vector<std::size_t>& fan_start, const std::vector< std::vector<std::size_t> >& face_fans,
+			const std::vector<std::size_t>& fan_facets, const std::vector<std::size_t>& edge_usage, const std::vector<std::size_t>& edge_sharp, std::size_t num_variables) 
+		{
+			const std::size_t num_faces = face_fans.size();
+			UnionFind sets(num_faces);
+			std::vector<char> excluded(num_faces, 0);	// per root of the merged faces
+			for (std::size_t i = 0; i < adjacency.size(); ++i) {
+				if (adjacency[i].size() != 4) {
+					for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos)
+						excluded[fan_facets[pos]] = 1;
+				}
+			}
+
+			std::vector<std::size_t> queue;
+			std::vector<char> queued(adjacency.size(), 0);
+			for (std::size_t i = adjacency.size(); i > 0; --i) {
+				if (adjacency[i - 1].size() == 4) {
+					queue.push_back(i - 1);
+					queued[i - 1] = 1;
+				}
+			}
+			std::vector< std::vector<std::size_t> > members(num_faces);		// per root of the merged faces
+			for (std::size_t f = 0; f < num_faces; ++f)
+				members[f].assign(1, f);
+			while (!queue.empty()) {
+				std::size_t i = queue.back();
+				queue.pop_back();
+				queued[i] = 0;
+
+				std::size_t free_faces[4], num_free = 0;
+				for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos) {
+					std::size_t f = fan_facets[pos];
+					if (!excluded[sets.find(f)])
+						free_faces[num_free++] = f;
+				}
+				std::size_t changed = num_faces;
+				if (num_free == 1) {
+					excluded[sets.find(free_faces[0])] = 1;
+					changed = free_faces[0];
+				}
+				else if (num_free == 2 && sets.find(free_faces[0]) != sets.find(free_faces[1])) {
+					std::size_t a = sets.find(free_faces[0]), b = sets.find(free_faces[1]);
+					sets.unite(a, b);
+					std::size_t root = sets.find(a), other = (root == a) ? b : a;
+					if (members[root].size() < members[other].size())
+						members[root].swap(members[other]);
+					members[root].insert(members[root].end(), members[other].begin(), members[other].end());
+					std::vector<std::size_t>().swap(members[other]);
+				}
+				if (changed == num_faces)
+					continue;
+
+				// the faces merged with the excluded one change the number of free faces of their super edges 
+				const std::vector<std::size_t>& merged = members[sets.find(changed)];
+				for (std::size_t m = 0; m < merged.size(); ++m) {
+					const std::vector<std::size_t>& fans = face_fans[merged[m]];
+					for (std::size_t k = 0; k < fans.size(); ++k) {
+						if (!queued[fans[k]] && adjacency[fans[k]].size() == 4) {
+							queued[fans[k]] = 1;
+							queue.push_back(fans[k]);
+						}
+					}
+				}
+			}
+
+			// the variable each variable is replaced with (or excluded for 0)
+			excluded_ = num_variables;
+			target_.assign(num_variables, excluded_);
+			num_merged_ = 0;
+			std::vector<std::size_t> root_variable(num_faces, excluded_);
+			std::size_t next = 0;
+			for (std::size_t f = 0; f < num_faces; ++f) {
+				std::size_t root = sets.find(f);
+				if (excluded[root])
+					continue;
+				if (root_variable[root] == excluded_)
+					root_variable[root] = next++;
+				else
+					++num_merged_;
+				target_[f] = root_variable[root];
+			}
+			num_excluded_ = num_faces - next - num_merged_;
+			for (std::size_t i = 0; i < adjacency.size(); ++i) {
+				if (adjacency[i].size() != 4)
+					continue;
+				std::size_t num_free = 0, free_face = num_faces;
+				for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos) {
+					if (!excluded[sets.find(fan_facets[pos])]) {
+						++num_free;
+						free_face = fan_facets[pos];
+					}
+				}
+				if (num_free == 0) {					// and the edge can't be sharp
+					num_excluded_ += 2;
+					continue;
+				}
+				if (num_free == 2) {					// the two faces are merged, and the edge is used with them
+					target_[edge_usage[i]] = target_[free_face];
+					++num_merged_;
+				}
+				else
+					target_[edge_usage[i]] = next++;
+				target_[edge_sharp[i]] = next++;
+			}
+			num_reduced_ = next;
+		}
+
+		// the number of variables merged into others, and the number of variables that can't be 1
+		std::size_t num_merged() const { return num_merged_; }
+		std::size_t num_excluded() const { return num_excluded_; }
+
+		// creates in "reduced" the program on the merged variables (the constraints with no variable left are dropped)
+		void reduce(const LinearProgram& program, LinearProgram& reduced) const {
+			for (std::size_t i = 0; i < num_reduced_; ++i) {
+				Variable* v = reduced.create_variable();
+				v->set_variable_type(Variable::BINARY);
+			}
+
+			std::map<int, double> terms;
+			const std::vector<LinearConstraint*>& constraints = program.constraints();
+			for (std::size_t i = 0; i < constraints.size(); ++i) {
+				const LinearConstraint* c = constraints[i];
+				const SparseRow coeffs = c->coefficients();
+				terms.clear();
+				for (std::size_t k = 0; k < coeffs.size(); ++k) {
+					std::size_t t = target_[coeffs.index(k)];
+					if (t != excluded_)
+						terms[static_cast<int>(t)] += coeffs.value(k);
+				}
+				for (std::map<int, double>::iterator it = terms.begin(); it != terms.end();) {
+					if (std::abs(it->second) < presolve_epsilon)
+						terms.erase(it++);
+					else
+						++it;
+				}
+				if (terms.empty())
+					continue;
+
+				double lb, ub;
+				effective_bounds(c, lb, ub);
+				LinearConstraint* rc = reduced.create_constraint(c->bound_type(), lb, ub);
+				rc->set_lazy(c->is_lazy());
+				for (std::map<int, double>::const_iterator it = terms.begin(); it != terms.end(); ++it)
+					rc->add_coefficient(it->first, it->second);
+			}
+
+			const LinearObjective* objective = program.objective();
+			LinearObjective* ro = reduced.create_objective(objective->sense());
+			const SparseRow obj_coeffs = objective->coefficients();
+			for (std::size_t k = 0; k < obj_coeffs.size(); ++k) {
+				std::size_t t = target_[obj_coeffs.index(k)];
+				if (t != excluded_)
+					ro->add_coefficient(static_cast<int>(t), obj_coeffs.value(k));
+			}
+			reduced.finalize();
+		}
+
+		// the solution of the reduced program given by a solution of the whole program
+		std::vector<double> reduce_solution(const std::vector<double>& X) const {
+			std::vector<double> x(num_reduced_, 0.0);
+			for (std::size_t i = 0; i < X.size(); ++i) {
+				if (target_[i] != excluded_)
+					x[target_[i]] = X[i];
+			}
+			return x;
+		}
+
+		// the solution of the whole program from a solution "x" of the reduced one
+		std::vector<double> restore_solution(const std::vector<double>& x) const {
+			std::vector<double> X(target_.size(), 0.0);
+			for (std::size_t i = 0; i < target_.size(); ++i) {
+				if (target_[i] != excluded_)
+					X[i] = x[target_[i]];
+			}
+			return X;
+		}
+
+	private:
+		std::vector<std::size_t>	target_;		// the variable of the reduced program, or excluded_
+		std::size_t					excluded_;
+		std::size_t					num_reduced_;
+		std::size_t					num_merged_;
+		std::size_t					num_excluded_;
+	};
+
+
+	// the LP relaxation of a binary program: the same program with all variables continuous in [0, 1]
+	void relax_program(const LinearProgram& program, LinearProgram& relaxed) {
+		for (std::size_t i = 0; i < program.num_variables(); ++i)
+			relaxed.create_variable(Variable::CONTINUOUS, Variable::DOUBLE, 0.0, 1.0);
+
+		const std::vector<LinearConstraint*>& constraints = program.constraints();
+		for (std::size_t i = 0; i < constraints.size(); ++i) {
+			const LinearConstraint* c = constraints[i];
+			double lb, ub;
+			c->get_bounds(lb, ub);
+			LinearConstraint* rc = relaxed.create_constraint(c->bound_type(), lb, ub);
+			rc->set_lazy(c->is_lazy());
+			const SparseRow coeffs = c->coefficients();
+			rc->add_coefficients(std::vector<int>(coeffs.indices(), coeffs.indices() + coeffs.size()), std::vector<double>(coeffs.values(), coeffs.values() + coeffs.size()));
+		}
+
+		const LinearObjective* objective = program.objective();
+		LinearObjective* ro = relaxed.create_objective(objective->sense());
+		const SparseRow obj_coeffs = objective->coefficients();
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			ro->add_coefficient(obj_coeffs.index(k), obj_coeffs.value(k));
+	}
+
+
+	double objective_value(const LinearProgram& program, const std::vector<double>& X) {
+		double value = 0.0;
+		const SparseRow obj_coeffs = program.objective()->coefficients();
+		for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+			value += obj_coeffs.value(k) * X[obj_coeffs.index(k)];
+		return value;
+	}
+
+
+	// the activity of each constraint of a finalized program for "X"
+	std::vector<double> constraint_activities(const LinearProgram& program, const std::vector<double>& X) {
+		const SparseMatrix& matrix = program.constraint_matrix();
+		std::vector<double> activities(matrix.num_rows(), 0.0);
+		for (std::size_t i = 0; i < matrix.num_rows(); ++i) {
+			const SparseRow row = matrix.row(i);
+			for (std::size_t k = 0; k < row.size(); ++k)
+				activities[i] += row.value(k) * X[row.index(k)];
+		}
+		return activities;
+	}
+
+
+	bool satisfies(const LinearConstraint* c, double activity) {
+		const double eps = 1e-6;
+		double lb, ub;
+		c->get_bounds(lb, ub);
+		switch (c->bound_type()) {
+		case LinearConstraint::FIXED:	return std::abs(activity - lb) < eps;
+		case LinearConstraint::LOWER:	return activity > lb - eps;
+		case LinearConstraint::UPPER:	return activity < ub + eps;
+		case LinearConstraint::DOUBLE:	return activity > lb - eps && activity < ub + eps;
+		default:						return true;
+		}
+	}
+
+
+	// Keeps the objective value of a solution of a finalized program and the number of constraints it
+	// violates up to date as its variables change, each change only visiting the constraints of the
+	// variable.
+	class SelectionEvaluator {
+	public:
+		SelectionEvaluator(const LinearProgram& program, const std::vector<double>& X) 
+			: program_(program), X_(X), objective_(0.0), num_violated_(0)
+		{
+			const SparseMatrix& matrix = program.constraint_matrix();
+			column_start_.assign(program.num_variables() + 1, 0);
+			for (std::size_t i = 0; i < matrix.num_rows(); ++i) {
+				const SparseRow row = matrix.row(i);
+				for (std::size_t k = 0; k < row.size(); ++k)
+					++column_start_[row.index(k) + 1];
+			}
+			for (std::size_t v = 0; v < program.num_variables(); ++v)
+				column_start_[v + 1] += column_start_[v];
+			column_rows_.resize(column_start_.back());
+			column_values_.resize(column_start_.back());
+			std::vector<std::size_t> next(column_start_.begin(), column_start_.end() - 1);
+			for (std::size_t i = 0; i < matrix.num_rows(); ++i) {
+				const SparseRow row = matrix.row(i);
+				for (std::size_t k = 0; k < row.size(); ++k) {
+					std::size_t pos = next[row.index(k)]++;
+					column_rows_[pos] = i;
+					column_values_[pos] = row.value(k);
+				}
+			}
+
+			cost_.assign(program.num_variables(), 0.0);
+			const SparseRow obj_coeffs = program.objective()->coefficients();
+			for (std::size_t k = 0; k < obj_coeffs.size(); ++k)
+				cost_[obj_coeffs.index(k)] += obj_coeffs.value(k);
+			for (std::size_t v = 0; v < X_.size(); ++v)
+				objective_ += cost_[v] * X_[v];
+
+			activities_ = constraint_activities(program, X_);
+			const std::vector<LinearConstraint*>& constraints = program.constraints();
+			for (std::size_t i = 0; i < constraints.size(); ++i)
+				num_violated_ += !satisfies(constraints[i], activities_[i]);
+		}
+
+		const std::vector<double>& solution() const { return X_; }
+		double objective() const { return objective_; }
+		std::size_t num_violated() const { return num_violated_; }
+		double cost(std::size_t var) const { return cost_[var]; }
+
+		// the constraints of a variable are at [column_begin(var), column_end(var)) of the rows and the values
+		std::size_t column_begin(std::size_t var) const { return column_start_[var]; }
+		std::size_t column_end(std::size_t var) const { return column_start_[var + 1]; }
+		std::size_t row(std::size_t pos) const { return column_rows_[pos]; }
+		double value(std::size_t pos) const { return column_values_[pos]; }
+
+		void set(std::size_t var, double value) {
+			double delta = value - X_[var];
+			if (delta == 0.0)
+				return;
+			X_[var] = value;
+			objective_ += cost_[var] * delta;
+			const std::vector<LinearConstraint*>& constraints = program_.constraints();
+			for (std::size_t pos = column_start_[var]; pos < column_start_[var + 1]; ++pos) {
+				std::size_t i = column_rows_[pos];
+				bool was_satisfied = satisfies(constraints[i], activities_[i]);
+				activities_[i] += column_values_[pos] * delta;
+				bool is_satisfied = satisfies(constraints[i], activities_[i]);
+				if (was_satisfied != is_satisfied) {
+					if (is_satisfied)
+						--num_violated_;
+					else
+						++num_violated_;
+				}
+			}
+		}
+
+	private:
+		const LinearProgram&		program_;
+		std::vector<double>			X_;
+		std::vector<double>			cost_;
+		std::vector<double>			activities_;
+		double						objective_;
+		std::size_t					num_violated_;
+		std::vector<std::size_t>	column_start_;
+		std::vector<std::size_t>	column_rows_;
+		std::vector<double>			column_values_;
+	};
+
+}
 
 
 FaceSelection::FaceSelection(PointSet* pset, Map* model)
 	: pset_(pset)
 	, model_(model)
+	, keep_candidates_(false)
+	, time_limit_(-1.0)
+	, session_(nil)
+	, context_(nil)
+	, memory_budget_exceeded_(false)
+	, total_points_(0.0)
+	, bbox_area_(0.0)
 {
 }
 
 
 void FaceSelection::optimize(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name) {
+	ScopedThreadBudget budget(thread_budget());
     if (pset_ == nullptr || model_ == nullptr)
 		return;
 
+	ProfileStage stage("optimize");
+
 	facet_attrib_supporting_vertex_group_.bind_if_defined(model_, Method::facet_attrib_supporting_vertex_group);
 	if (!facet_attrib_supporting_vertex_group_.is_bound()) {
 		Logger::err("-") << "attribute " << Method::facet_attrib_supporting_vertex_group << " doesn't exist" << std::endl;
@@ -55,282 +842,1959 @@ void FaceSelection::optimize(const HypothesisGenerator::Adjacency& adjacency, Li
 		Logger::err("-") << "attribute " << Method::facet_attrib_facet_area << " doesn't exist" << std::endl;
 		return;
 	}
-	facet_attrib_covered_area_.bind_if_defined(model_, Method::facet_attrib_covered_area);
-	if (!facet_attrib_covered_area_.is_bound()) {
-		Logger::err("-") << "attribute " << Method::facet_attrib_covered_area << " doesn't exist" << std::endl;
-		return;
+	facet_attrib_covered_area_.bind_if_defined(model_, Method::facet_attrib_covered_area);
+	if (!facet_attrib_covered_area_.is_bound()) {
+		Logger::err("-") << "attribute " << Method::facet_attrib_covered_area << " doesn't exist" << std::endl;
+		return;
+	}
+
+	edge_source_planes_.bind_if_defined(model_, "EdgeSourcePlanes");
+	vertex_source_planes_.bind_if_defined(model_, "VertexSourcePlanes");
+	facet_attrib_supporting_plane_.bind_if_defined(model_, "FacetSupportingPlane");
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// the total weight of the points, i.e., their number unless the point set was downsampled
+	double total_points = pset_->total_weight();
+	std::size_t idx = 0;
+	MapFacetAttribute<std::size_t>	facet_indices(model_);
+	// the attributes are hit for every face (and every fan), so they are accessed directly
+	AttributeAccessor<Map::Facet, std::size_t> facet_index(facet_indices);
+	FOR_EACH_FACET(Map, model_, it) {
+		Map::Facet* f = it;
+		facet_index[f] = idx;
+		++idx;
+	}
+
+	//-------------------------------------
+
+	StopWatch w;
+    Logger::out("-") << "face selection..." << std::endl;
+
+	//-------------------------------------
+
+	// binary variables:
+	// x[0] ... x[num_faces - 1] : binary labels of all the input faces
+	// x[num_faces] ... x[num_faces + num_edges] : binary labels of all the intersecting edges (remain or not)
+	// x[num_faces + num_edges] ... x[num_faces + num_edges + num_edges] : binary labels of corner edges (sharp edge of not)
+
+	Logger::out("-") << "formulating binary program...." << std::endl;
+	w.start();
+
+	std::size_t num_faces = model_->size_of_facets();
+	std::size_t num_edges = 0;
+
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+	// the variables of the super edges, indexed by their positions in the adjacency
+	edge_usage_status_.assign(adjacency.size(), 0);	// keep or remove an intersecting edges
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const SuperEdge& fan = adjacency[i];
+		if (fan.size() == 4) {
+			std::size_t var_idx = num_faces + num_edges;
+			edge_usage_status_[i] = var_idx;
+			++num_edges;
+		}
+	}
+
+	program_.clear();
+
+	edge_sharp_status_.assign(adjacency.size(), 0);	// the edge is sharp or not
+	std::size_t num_sharp_edges = 0;
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const SuperEdge& fan = adjacency[i];
+		if (fan.size() == 4) {
+			std::size_t var_idx = num_faces + num_edges + num_sharp_edges;
+			edge_sharp_status_[i] = var_idx;
+			++num_sharp_edges;
+		}
+	}
+	assert(num_edges == num_sharp_edges);
+
+	// the per-face terms of the objective, which don't depend on the weights
+	total_points_ = total_points;
+	bbox_area_ = model_->bbox().area();
+	facet_point_num_.assign(num_faces, 0.0);
+	facet_uncovered_area_.assign(num_faces, 0.0);
+	facet_coverage_ratio_.assign(num_faces, 0.0);
+	AttributeAccessor<Map::Facet, double> point_num(facet_attrib_supporting_point_num_);
+	AttributeAccessor<Map::Facet, double> facet_area(facet_attrib_facet_area_);
+	AttributeAccessor<Map::Facet, double> covered_area(facet_attrib_covered_area_);
+	FOR_EACH_FACET(Map, model_, it) {
+		Map::Facet* f = it;
+		std::size_t var_idx = facet_index[f];
+		facet_point_num_[var_idx] = point_num[f];
+		facet_uncovered_area_[var_idx] = (facet_area[f] - covered_area[f]);
+		if (facet_area[f] > 0.0)
+			facet_coverage_ratio_[var_idx] = std::min(covered_area[f] / facet_area[f], 1.0);
+	}
+
+	fan_facets_.clear();
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const SuperEdge& fan = adjacency[i];
+		for (std::size_t j = 0; j < fan.size(); ++j)
+			fan_facets_.push_back(facet_index[fan[j]->facet()]);
+	}
+	solution_.clear();
+
+	std::size_t total_variables = num_faces + num_edges + num_sharp_edges;
+	Logger::out("-") << "#total variables: " << total_variables << std::endl;
+	Logger::out(" ") << "    - face is selected: " << num_faces << std::endl;
+	Logger::out(" ") << "    - edge is used: " << num_edges << std::endl;
+	Logger::out(" ") << "    - edge is sharp: " << num_sharp_edges << std::endl;
+
+	// the builder the program is formulated with: either one creating the rows of the solver right away,
+	// or a recorder keeping the program in program_ (for presolve, decomposition, and re-optimization)
+	LinearProgramSolver solver;
+	LinearProgramSolver::StreamingBuilder* streaming = 0;
+	if (Method::stream_face_selection && !Method::graph_cut_selection && !Method::lagrangian_face_selection) {
+		solver.set_options(selection_solver_options(time_limit()));
+		streaming = solver.create_builder(solver_name, "face_selection");
+		if (!streaming)
+			Logger::warn("-") << "the solver can't build the program on the fly, keeping the whole program" << std::endl;
+	}
+
+	LinearProgramRecorder recorder(&program_);
+	LinearProgramBuilder* builder = &recorder;
+	if (streaming) {
+#ifndef NDEBUG
+		streaming->set_store_names(true);
+#endif
+		builder = streaming;
+	}
+	else
+		program_.create_objective(LinearObjective::MINIMIZE);
+	formulate(adjacency, *builder);
+
+	Logger::out("-") << "#total constraints: " << builder->num_constraints() << std::endl;
+	Logger::out("-") << "formulating binary program done. " << w.elapsed() << " sec" << std::endl;
+	Profiler::add_counter("variables", double(builder->num_variables()));
+	Profiler::add_counter("constraints", double(builder->num_constraints()));
+
+	facet_attrib_supporting_vertex_group_.unbind();
+	facet_attrib_supporting_point_num_.unbind();
+	facet_attrib_facet_area_.unbind();
+	facet_attrib_covered_area_.unbind();
+
+	vertex_source_planes_.unbind();
+	edge_source_planes_.unbind();
+	facet_attrib_supporting_plane_.unbind();
+
+	if (streaming) {
+		ProfileStage stage("solve");
+		StopWatch t;
+		Logger::out("-") << "solving the binary program. Please wait..." << std::endl;
+		SearchMonitor monitor;
+		monitor.set_callback(search_callback_);
+		LinearProgramSolver::SolverOptions options = selection_solver_options(time_limit(), &monitor);
+		if (incumbent_callback_)
+			options.incumbent_callback = [this](double, const std::vector<double>& x) { incumbent_callback_(x); };
+		solver.set_options(options);
+		bool solved = solver.solve(streaming);
+		delete streaming;
+		if (solved) {
+			Logger::out("-") << "solving the binary program done. " << t.elapsed() << " sec" << std::endl;
+			if (solver.status() == LinearProgramSolver::STATUS_LIMIT_REACHED)
+				Logger::warn("-") << "time limit reached, using the best solution found" << std::endl;
+			apply_solution(adjacency, solver.solution());
+		}
+		else
+			Logger::out("-") << "solving the binary program failed. " << t.elapsed() << " sec." << std::endl;
+	}
+	else
+		solve(adjacency, solver_name, false);
+}
+
+
+void FaceSelection::formulate(const HypothesisGenerator::Adjacency& adjacency, LinearProgramBuilder& builder) {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+	std::size_t num_faces = facet_point_num_.size();
+	std::size_t total_variables = num_faces + 2 * (edge_sharp_status_.size() - std::count(edge_sharp_status_.begin(), edge_sharp_status_.end(), 0));
+
+#if 1
+	builder.add_variables(total_variables, Variable::BINARY);
+#else // Liangliang: I was just curious about how the results look like if all variables 
+	//             are relaxed to be continuous.
+	builder.add_variables(total_variables, Variable::CONTINUOUS, Variable::DOUBLE, 0, 1);
+#endif
+
+	builder.set_objective_sense(LinearObjective::MINIMIZE);
+	write_objective(current_weights(), builder);
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// the faces of the super edges, in the same order as fan_facets_
+	std::vector<std::size_t> fan_start(adjacency.size() + 1, 0);
+	for (std::size_t i = 0; i < adjacency.size(); ++i)
+		fan_start[i + 1] = fan_start[i] + adjacency[i].size();
+
+	// The constraints are formulated in parallel by chunks of the super edges, each into its own blocks
+	// of rows, which are then added in order (i.e., the program is the same as formulated in serial).
+	const std::size_t chunk_size = 16384;
+	const std::size_t num_chunks = (adjacency.size() + chunk_size - 1) / chunk_size;
+	std::vector<ConstraintBlock> fan_blocks(num_chunks), sharp_blocks(num_chunks), border_blocks(num_chunks);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		const std::size_t begin = c * chunk_size;
+		const std::size_t end = std::min(begin + chunk_size, adjacency.size());
+		ConstraintBlock& fan_block = fan_blocks[c];
+		ConstraintBlock& sharp_block = sharp_blocks[c];
+		ConstraintBlock& border_block = border_blocks[c];
+		fan_block.reserve(end - begin, fan_start[end] - fan_start[begin] + (end - begin));
+
+		std::vector<int> indices;
+		std::vector<double> coeffs;
+
+		// Add constraints: the number of faces associated with an edge must be either 2 or 0
+		for (std::size_t i = begin; i < end; ++i) {
+			indices.clear();
+			coeffs.clear();
+			const SuperEdge& fan = adjacency[i];
+			for (std::size_t j = 0; j < fan.size(); ++j) {
+				indices.push_back(int(fan_facets_[fan_start[i] + j]));
+				coeffs.push_back(1.0);
+			}
+
+			if (fan.size() == 4) {
+				indices.push_back(int(edge_usage_status_[i]));
+				coeffs.push_back(-2.0);  // 
+			}
+			else { // boundary edge
+				// will be set to 0 (i.e., we don't allow open surface)
+			}
+			fan_block.add(LinearConstraint::FIXED, 0.0, 0.0, indices.data(), coeffs.data(), indices.size());
+		}
+
+		// Add constraints: for the sharp edges. The explanation of posing this constraint can be found here:
+		// https://user-images.githubusercontent.com/15526536/30185644-12085a9c-942b-11e7-831d-290dd2a4d50c.png
+		double M = 1.0;
+		for (std::size_t i = begin; i < end; ++i) {
+			const SuperEdge& fan = adjacency[i];
+			if (fan.size() != 4)
+				continue;
+
+			// if an edge is sharp, the edge must be selected first:
+			// X[var_edge_usage_idx] >= X[var_edge_sharp_idx]	
+			int var_edge_usage_idx = int(edge_usage_status_[i]);
+			int var_edge_sharp_idx = int(edge_sharp_status_[i]);
+			indices.assign(1, var_edge_usage_idx);		coeffs.assign(1, 1.0);
+			indices.push_back(var_edge_sharp_idx);		coeffs.push_back(-1.0);
+			sharp_block.add(LinearConstraint::LOWER, 0.0, 0.0, indices.data(), coeffs.data(), indices.size());
+
+			// The tighter formulation: if the faces are two pairs of coplanar faces (a, b) and (c, d), the edge
+			// is sharp exactly if one face of each pair is selected, i.e., X[var_edge_sharp_idx] >= |X[a] - X[b]| 
+			// (and the same for c and d). The relaxation then can't both select the faces of each pair halfway
+			// and leave the edge not sharp.
+			if (Method::tight_sharp_edges) {
+				std::size_t partner[4] = { 4, 4, 4, 4 };
+				for (std::size_t j = 0; j < fan.size(); ++j) {
+					for (std::size_t k = 0; k < fan.size(); ++k) {
+						if (k != j && facet_attrib_supporting_plane_[fan[j]->facet()] == facet_attrib_supporting_plane_[fan[k]->facet()])
+							partner[j] = (partner[j] == 4) ? k : 5;	// 5: more than one coplanar face
+					}
+				}
+				bool paired = true;
+				for (std::size_t j = 0; j < fan.size(); ++j)
+					paired = paired && partner[j] < 4;
+				if (paired) {
+					for (std::size_t j = 0; j < fan.size(); ++j) {
+						// X[var_edge_sharp_idx] - X[fid1] + X[fid2] >= 0
+						indices.assign(1, var_edge_sharp_idx);							coeffs.assign(1, 1.0);
+						indices.push_back(int(fan_facets_[fan_start[i] + j]));			coeffs.push_back(-1.0);
+						indices.push_back(int(fan_facets_[fan_start[i] + partner[j]]));	coeffs.push_back(1.0);
+						sharp_block.add(LinearConstraint::LOWER, 0.0, 0.0, indices.data(), coeffs.data(), indices.size());
+					}
+					continue;
+				}
+			}
+
+			for (std::size_t j = 0; j < fan.size(); ++j) {
+				Plane3d* plane1 = facet_attrib_supporting_plane_[fan[j]->facet()];
+				int fid1 = int(fan_facets_[fan_start[i] + j]);
+				for (std::size_t k = j + 1; k < fan.size(); ++k) {
+					Plane3d* plane2 = facet_attrib_supporting_plane_[fan[k]->facet()];
+					int fid2 = int(fan_facets_[fan_start[i] + k]);
+
+					if (plane1 != plane2) {
+						// the constraint is:
+						//X[var_edge_sharp_idx] + M * (3 - (X[fid1] + X[fid2] + X[var_edge_usage_idx])) >= 1
+						// which equals to  
+						//X[var_edge_sharp_idx] - M * X[fid1] - M * X[fid2] - M * X[var_edge_usage_idx] >= 1 - 3M
+						indices.assign(1, var_edge_sharp_idx);	coeffs.assign(1, 1.0);
+						indices.push_back(fid1);				coeffs.push_back(-M);
+						indices.push_back(fid2);				coeffs.push_back(-M);
+						indices.push_back(var_edge_usage_idx);	coeffs.push_back(-M);
+						sharp_block.add(LinearConstraint::LOWER, 1.0 - 3.0 * M, 0.0, indices.data(), coeffs.data(), indices.size(), Method::lazy_sharp_edges);
+					}
+				}
+			}
+		}
+
+#if 1
+		// Add some optional constraints: border faces must be removed
+		for (std::size_t i = begin; i < end; ++i) {
+			const SuperEdge &fan = adjacency[i];
+			if (fan.size() == 1) { // boundary edge
+				const int fid = int(fan_facets_[fan_start[i]]);
+				const double one = 1.0;
+				border_block.add(LinearConstraint::FIXED, 0.0, 0.0, &fid, &one, 1);
+			}
+		}
+#endif
+	}, nil, Method::num_threads);
+
+	std::vector<const ConstraintBlock*> blocks;
+	blocks.reserve(3 * num_chunks);
+	for (std::size_t c = 0; c < num_chunks; ++c)
+		blocks.push_back(&fan_blocks[c]);
+	for (std::size_t c = 0; c < num_chunks; ++c)
+		blocks.push_back(&sharp_blocks[c]);
+	for (std::size_t c = 0; c < num_chunks; ++c)
+		blocks.push_back(&border_blocks[c]);
+	builder.add_constraints(blocks);
+}
+
+
+void FaceSelection::update_objective() {
+	program_.objective()->clear();
+	LinearProgramRecorder recorder(&program_);
+	write_objective(current_weights(), recorder);
+}
+
+
+void FaceSelection::write_objective(const Weights& weights, LinearProgramBuilder& builder) const {
+	//double coeff_data_fitting = Method::lambda_data_fitting / total_points;
+	//double coeff_coverage = Method::lambda_model_coverage / model_->bbox().area();
+	//double coeff_complexity = Method::lambda_model_complexity / double(fans.size());
+	// choose a better scale
+	double coeff_data_fitting = weights.data_fitting;
+	double coeff_coverage = total_points_ * weights.model_coverage / bbox_area_;
+	double coeff_complexity = total_points_ * weights.model_complexity / double(edge_sharp_status_.size());
+
+	// accumulate model complexity term
+	for (std::size_t i = 0; i < edge_sharp_status_.size(); ++i) {
+		std::size_t var_idx = edge_sharp_status_[i];
+		if (var_idx != 0)
+			builder.add_objective_coefficient(int(var_idx), coeff_complexity);
+	}
+
+	for (std::size_t var_idx = 0; var_idx < facet_point_num_.size(); ++var_idx) {
+		// accumulate data fitting term
+		builder.add_objective_coefficient(int(var_idx), -coeff_data_fitting * facet_point_num_[var_idx]);
+
+		// accumulate model coverage term
+		builder.add_objective_coefficient(int(var_idx), coeff_coverage * facet_uncovered_area_[var_idx]);
+	}
+}
+
+
+bool FaceSelection::can_re_optimize(Map* model, const HypothesisGenerator::Adjacency& adjacency) const {
+	if (!model || program_.num_variables() == 0 || model->size_of_facets() != facet_point_num_.size() || adjacency.size() != edge_sharp_status_.size())
+		return false;
+
+	std::size_t idx = 0;
+	MapFacetAttribute<std::size_t>	facet_indices(model);
+	FOR_EACH_FACET(Map, model, it) {
+		Map::Facet* f = it;
+		facet_indices[f] = idx;
+		++idx;
+	}
+
+	// the super edges must connect the same faces as the ones the program was formulated for
+	std::size_t pos = 0;
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const HypothesisGenerator::SuperEdge& fan = adjacency[i];
+		if ((fan.size() == 4) != (edge_sharp_status_[i] != 0))
+			return false;
+		for (std::size_t j = 0; j < fan.size(); ++j, ++pos) {
+			if (pos >= fan_facets_.size() || fan_facets_[pos] != facet_indices[fan[j]->facet()])
+				return false;
+		}
+	}
+	return pos == fan_facets_.size();
+}
+
+
+bool FaceSelection::re_optimize(Map* model, const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name) {
+	ScopedThreadBudget budget(thread_budget());
+	if (!can_re_optimize(model, adjacency))
+		return false;
+
+	ProfileStage stage("re_optimize");
+
+	model_ = model;
+	Logger::out("-") << "face selection with the new weights..." << std::endl;
+	update_objective();
+	solve(adjacency, solver_name, true);
+	return true;
+}
+
+
+bool FaceSelection::solve_weights(const std::vector<Weights>& weights, LinearProgramSolver::SolverName solver_name, std::vector< std::vector<double> >& solutions) {
+	ScopedThreadBudget budget(thread_budget());
+	solutions.assign(weights.size(), std::vector<double>());
+	if (program_.num_variables() == 0) {
+		Logger::err("-") << "no binary program to reuse (it is not kept with the streamed formulation)" << std::endl;
+		return false;
+	}
+
+	ProfileStage stage("solve_weights");
+	StopWatch w;
+	Logger::out("-") << "solving the binary program for " << weights.size() << " weights. Please wait..." << std::endl;
+
+	// the rows are read by all the configurations, which is thread-safe once they are in the matrix
+	program_.finalize();
+
+	// GLPK keeps its environment in global variables, and all the Gurobi models share one environment
+	bool concurrent = (solver_name == LinearProgramSolver::SCIP || solver_name == LinearProgramSolver::LPSOLVE);
+	parallel_for(weights.size(), [&](std::size_t i) {
+		LinearProgramSolver solver;
+		solver.set_verbose(false);
+		solver.set_options(selection_solver_options(time_limit()));
+		if (solution_.size() == program_.num_variables())
+			solver.set_initial_solution(solution_);
+
+		bool solved = false;
+		LinearProgramSolver::StreamingBuilder* builder = solver.create_builder(solver_name);
+		if (builder) {	// the program goes to the solver right away
+			build_constraints(program_, *builder);
+			builder->set_objective_sense(LinearObjective::MINIMIZE);
+			write_objective(weights[i], *builder);
+			solved = solver.solve(builder);
+			delete builder;
+		}
+		else {			// the solver needs a program of its own
+			LinearProgram program;
+			program.create_objective(LinearObjective::MINIMIZE);
+			LinearProgramRecorder recorder(&program);
+			build_constraints(program_, recorder);
+			write_objective(weights[i], recorder);
+			solved = solver.solve(&program, solver_name);
+		}
+		if (solved)
+			solutions[i] = solver.solution();
+	}, nil, concurrent ? Method::num_threads : 1);
+
+	std::size_t num_failed = 0;
+	for (std::size_t i = 0; i < solutions.size(); ++i) {
+		if (solutions[i].empty())
+			++num_failed;
+	}
+	if (num_failed > 0)
+		Logger::err("-") << num_failed << " of the " << weights.size() << " configurations could not be solved" << std::endl;
+	Logger::out("-") << "solving the binary program for " << weights.size() << " weights done. " << w.elapsed() << " sec" << std::endl;
+	return true;
+}
+
+
+std::vector<Map*> FaceSelection::optimize_weights(HypothesisGenerator* generator, Map* hypothesis, const std::vector<Weights>& weights, LinearProgramSolver::SolverName solver_name) {
+	std::vector<Map*> models(weights.size(), nil);
+	if (!generator || !hypothesis)
+		return models;
+
+	std::vector< std::vector<double> > solutions;
+	if (!solve_weights(weights, solver_name, solutions))
+		return models;
+
+	// the selections are copied out of the candidates, which are thus not duplicated for each of them
+	HypothesisGenerator::Adjacency adjacency = generator->extract_adjacency(hypothesis);
+	if (!can_re_optimize(hypothesis, adjacency)) {
+		Logger::err("-") << "the candidate faces are not the ones the binary program was formulated for" << std::endl;
+		return models;
+	}
+	for (std::size_t i = 0; i < solutions.size(); ++i) {
+		if (!solutions[i].empty())
+			models[i] = extract_selection(hypothesis, adjacency, solutions[i]);
+	}
+	return models;
+}
+
+
+void FaceSelection::solve(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name, bool warm_start) {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+	// Optimize model
+	StopWatch w;
+	Logger::out("-") << "solving the binary program. Please wait..." << std::endl;
+
+#if 0
+    // Save the problem into a file (in lp format), allowing me to use other solvers to
+    // solve it (easy to compare the performance of different solvers, e.g., with the 
+    // Benchmark program on a directory of such files). Saved as .opb, it is ready for the
+    // pseudo-Boolean and MaxSAT solvers.
+    program_.save("D:/tmp/bunny.lp");
+#endif
+
+	// the presolve and the decomposition read the coefficients from the constraint matrix
+	program_.finalize();
+	program_.memory_usage().add_to_profile("binary program");
+
+	// the memory checkpoint before launching the solver (see Method::memory_budget)
+	memory_budget_exceeded_ = false;
+	if (Method::memory_budget > 0.0) {
+		double bytes = pset_->memory_usage().total() + model_->memory_usage().total() + program_.memory_usage().total();
+		if (!MemoryPlanner::check("before solving", bytes, Method::memory_budget)) {
+			memory_budget_exceeded_ = true;
+			return;
+		}
+	}
+
+	// how the problem is solved: as set by the options, or as picked from the problem by the policy
+	SelectionPolicy::Decision decision = SelectionPolicy::options(solver_name);
+	if (Method::automatic_selection_policy) {
+		ProfileStage stage("policy");
+		SelectionPolicy::Statistics statistics = problem_statistics(adjacency, program_, facet_point_num_.size());
+		statistics.time_limit = time_limit();
+		statistics.num_threads = parallel_num_threads(parallel_thread_budget());
+		decision = SelectionPolicy::decide(statistics, solver_name);
+		SelectionPolicy::record(decision, statistics);
+	}
+	solver_name = decision.solver;
+	ScopedThreadBudget threads(decision.num_threads > 0 ? decision.num_threads : parallel_thread_budget());
+
+	if (decision.engine == SelectionPolicy::GRAPH_CUT) {
+		ProfileStage stage("graph cut");
+		std::vector<double> X;
+		if (solve_graph_cut(adjacency, current_weights(), X)) {
+			Logger::out("-") << "labeling the cells by a graph cut done. " << w.elapsed() << " sec" << std::endl;
+			if (decision.neighborhood_search)
+				search_neighborhoods(adjacency, solver_name, X);
+			apply_solution(adjacency, X);
+		}
+		else
+			Logger::out("-") << "labeling the cells by a graph cut failed. " << w.elapsed() << " sec." << std::endl;
+		return;
+	}
+
+	if (decision.engine == SelectionPolicy::LAGRANGIAN) {
+		ProfileStage stage("Lagrangian");
+		std::vector<double> X;
+		if (solve_lagrangian(adjacency, X)) {
+			Logger::out("-") << "solving the Lagrangian relaxation done. " << w.elapsed() << " sec" << std::endl;
+			if (decision.neighborhood_search)
+				search_neighborhoods(adjacency, solver_name, X);
+			apply_solution(adjacency, X);
+		}
+		else
+			Logger::out("-") << "solving the Lagrangian relaxation failed. " << w.elapsed() << " sec." << std::endl;
+		return;
+	}
+
+	if (decision.engine == SelectionPolicy::APPROXIMATE) {
+		ProfileStage stage("approximate");
+		std::vector<double> X;
+		if (solve_approximately(adjacency, solver_name, X)) {
+			Logger::out("-") << "solving the binary program approximately done. " << w.elapsed() << " sec" << std::endl;
+			if (decision.neighborhood_search)
+				search_neighborhoods(adjacency, solver_name, X);
+			apply_solution(adjacency, X);
+		}
+		else
+			Logger::out("-") << "solving the binary program failed. " << w.elapsed() << " sec." << std::endl;
+		return;
+	}
+
+	std::vector<double> start;
+	if (warm_start && solution_.size() == program_.num_variables())
+		start = solution_;
+	else if (!start_selection_.empty() && start_selection_.size() == facet_point_num_.size()) {
+		std::vector<std::size_t> fan_start;
+		std::vector< std::vector<std::size_t> > face_fans;
+		fan_structure(adjacency, fan_start, face_fans);
+		std::vector<double> scores(start_selection_.begin(), start_selection_.end());
+		std::vector<char> selected;
+		repair_selection(adjacency, fan_start, face_fans, scores, selected);
+		if (complete_selection(adjacency, fan_start, selected, start))
+			Logger::out("-") << "start from the given selection: objective " << objective_value(program_, start) << std::endl;
+		else
+			start.clear();
+	}
+	else if (Method::greedy_selection_start) {
+		start = greedy_selection(adjacency);
+		if (!start.empty())
+			Logger::out("-") << "greedy start: objective " << objective_value(program_, start) << std::endl;
+	}
+
+	VariableHints hints;
+	if (Method::selection_variable_hints)
+		variable_hints(hints);
+
+	// the program handed to the solver, and its solution
+	const LinearProgram* program = &program_;
+	std::vector<double> X;
+
+	FanContraction contraction;
+	LinearProgram contracted;
+	bool is_contracted = false;
+	if (decision.contract) {
+		ProfileStage stage("contract");
+		std::vector<std::size_t> fan_start;
+		std::vector< std::vector<std::size_t> > face_fans;
+		fan_structure(adjacency, fan_start, face_fans);
+		contraction.run(adjacency, fan_start, face_fans, fan_facets_, edge_usage_status_, edge_sharp_status_, program_.num_variables());
+		contraction.reduce(program_, contracted);
+		Logger::out("-") << "contraction merged " << contraction.num_merged() << " variables and excluded "
+			<< contraction.num_excluded() << " variables (" << contracted.num_variables() << " variables and "
+			<< contracted.constraints().size() << " constraints left)" << std::endl;
+		Profiler::add_counter("merged variables", double(contraction.num_merged()));
+
+		program = &contracted;
+		if (!start.empty())
+			start = contraction.reduce_solution(start);
+		if (!hints.empty()) {
+			hints.values = contraction.reduce_solution(hints.values);
+			hints.priorities = contraction.reduce_solution(hints.priorities);
+		}
+		is_contracted = true;
+	}
+
+	BinaryPresolve presolve;
+	LinearProgram reduced;
+	bool solved = false;
+	bool presolved = false;
+	if (decision.presolve) {
+		ProfileStage stage("presolve");
+		if (!presolve.run(*program)) {
+			Logger::err("-") << "the binary program is infeasible (found by presolve)" << std::endl;
+			return;
+		}
+		presolve.reduce(*program, reduced);
+		Logger::out("-") << "presolve fixed " << presolve.num_fixed() << " variables and dropped "
+			<< presolve.num_dropped() << " constraints" << std::endl;
+		Profiler::add_counter("fixed variables", double(presolve.num_fixed()));
+		Profiler::add_counter("dropped constraints", double(presolve.num_dropped()));
+
+		program = &reduced;
+		if (!start.empty())
+			start = presolve.reduce_solution(start);
+		if (!hints.empty()) {
+			hints.values = presolve.reduce_solution(hints.values);
+			hints.priorities = presolve.reduce_solution(hints.priorities);
+		}
+		presolved = true;
+	}
+
+	{
+		ProfileStage stage("solve");
+		// the improving solutions of the program handed to the solver, reported for the whole program
+		IncumbentCallback report;
+		if (incumbent_callback_) {
+			report = [this, &presolve, presolved, &contraction, is_contracted](const std::vector<double>& x) {
+				std::vector<double> restored = presolved ? presolve.restore_solution(x) : x;
+				incumbent_callback_(is_contracted ? contraction.restore_solution(restored) : restored);
+			};
+		}
+
+		if (program->num_variables() == 0)	// everything was fixed by presolve (or the contraction)
+			solved = true;
+		else if (decision.decompose)
+			solved = solve_components(*program, solver_name, decision.parallel, start, hints, X, report);
+		else {
+			SearchMonitor monitor;
+			monitor.set_callback(search_callback_);
+			LinearProgramSolver solver;
+			LinearProgramSolver::SolverOptions options = selection_solver_options(time_limit(), &monitor);
+			if (report)
+				options.incumbent_callback = [&report](double, const std::vector<double>& x) { report(x); };
+			solver.set_options(options);
+			solver.set_cache(selection_cache());
+			solver.set_session(session());
+			if (!start.empty())
+				solver.set_initial_solution(start);
+			hints.apply(solver);
+			solved = solver.solve(program, solver_name);
+			if (solved)
+				X = solver.solution();
+			if (solver.status() == LinearProgramSolver::STATUS_LIMIT_REACHED)
+				Logger::warn("-") << "time limit reached, using the best solution found" << std::endl;
+		}
+	}
+	if (solved && presolved)
+		X = presolve.restore_solution(X);
+	if (solved && is_contracted)
+		X = contraction.restore_solution(X);
+	if (solved) {
+		Logger::out("-") << "solving the binary program done. " << w.elapsed() << " sec" << std::endl;
+		if (decision.neighborhood_search)
+			search_neighborhoods(adjacency, solver_name, X);
+		apply_solution(adjacency, X);
+	}
+	else {
+        Logger::out("-") << "solving the binary program failed. " << w.elapsed() << " sec." << std::endl;
+	}
+}
+
+
+bool FaceSelection::solve_approximately(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name, std::vector<double>& X) const {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+	// the LP relaxation gives the fractional selection to round, and a lower bound of the optimum
+	LinearProgram relaxed;
+	relax_program(program_, relaxed);
+	LinearProgramSolver solver;
+	solver.set_options(selection_solver_options(time_limit()));
+	if (!solver.solve(&relaxed, solver_name)) {
+		Logger::err("-") << "failed solving the LP relaxation" << std::endl;
+		return false;
+	}
+	const std::vector<double>& relaxation = solver.solution();
+	double bound = solver.objective_value();
+
+	std::vector<std::size_t> fan_start;
+	std::vector< std::vector<std::size_t> > face_fans;
+	fan_structure(adjacency, fan_start, face_fans);
+
+	std::vector<char> selected;
+	repair_selection(adjacency, fan_start, face_fans, relaxation, selected);
+
+	if (!complete_selection(adjacency, fan_start, selected, X)) {
+		Logger::err("-") << "the rounded selection violates the constraints" << std::endl;
+		return false;
+	}
+	double value = objective_value(program_, X);
+
+	// polish: a short search of the solver starting from the rounded selection
+	if (Method::approximate_polish_time > 0.0) {
+		LinearProgramSolver polisher;
+		polisher.set_options(selection_solver_options(Method::approximate_polish_time));
+		polisher.set_initial_solution(X);
+		if (polisher.solve(&program_, solver_name) && polisher.objective_value() < value) {
+			X = polisher.solution();
+			value = polisher.objective_value();
+		}
+	}
+
+	double gap = (value - bound) / std::max(std::abs(value), 1e-10);
+	Logger::out("-") << "approximate selection: objective " << value << ", LP bound " << bound 
+		<< ", gap " << 100.0 * gap << "%" << std::endl;
+	Profiler::add_counter("gap to LP bound", gap);
+	return true;
+}
+
+
+void FaceSelection::search_neighborhoods(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name, std::vector<double>& X) const {
+	if (X.size() != program_.num_variables())
+		return;
+	SelectionEvaluator evaluator(program_, X);
+	if (evaluator.num_violated() > 0) {
+		Logger::warn("-") << "the selection violates " << evaluator.num_violated() << " constraints, no neighborhood search" << std::endl;
+		return;
+	}
+
+	const std::size_t num_faces = facet_point_num_.size();
+	const std::size_t size = std::max<std::size_t>(Method::neighborhood_size, 1);
+	std::vector<std::size_t> fan_start;
+	std::vector< std::vector<std::size_t> > face_fans;
+	fan_structure(adjacency, fan_start, face_fans);
+
+	const double initial = evaluator.objective();
+	const std::vector<LinearConstraint*>& constraints = program_.constraints();
+
+	// the marks of the current neighborhood, reset after each one
+	std::vector<std::size_t> local_index(program_.num_variables(), program_.num_variables());
+	std::vector<char> face_visited(num_faces, 0), fan_visited(adjacency.size(), 0), row_visited(constraints.size(), 0);
+
+	StopWatch w;
+	std::size_t num_rounds = 0, num_improved = 0, num_stalled = 0;
+	const std::size_t max_stalled = 2 * (num_faces / size + 1);
+	while (w.elapsed() < Method::neighborhood_search_time && num_stalled < max_stalled) {
+		// a neighborhood: the faces reached from a seed across the super edges (breadth first), the seeds 
+		// spread deterministically over the faces
+		std::size_t seed = std::size_t((Numeric::uint64(num_rounds) * 2654435761u) % num_faces);
+		++num_rounds;
+		std::vector<std::size_t> faces(1, seed), fans;
+		face_visited[seed] = 1;
+		for (std::size_t head = 0; head < faces.size() && faces.size() < size; ++head) {
+			const std::vector<std::size_t>& around = face_fans[faces[head]];
+			for (std::size_t k = 0; k < around.size() && faces.size() < size; ++k) {
+				std::size_t i = around[k];
+				if (fan_visited[i])
+					continue;
+				fan_visited[i] = 1;
+				fans.push_back(i);
+				for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos) {
+					std::size_t f = fan_facets_[pos];
+					if (!face_visited[f] && faces.size() < size) {
+						face_visited[f] = 1;
+						faces.push_back(f);
+					}
+				}
+			}
+		}
+
+		// the free variables: the faces and the variables of all their super edges
+		std::vector<std::size_t> variables(faces);
+		for (std::size_t j = 0; j < faces.size(); ++j) {
+			const std::vector<std::size_t>& around = face_fans[faces[j]];
+			for (std::size_t k = 0; k < around.size(); ++k) {
+				std::size_t i = around[k];
+				if (!fan_visited[i]) {
+					fan_visited[i] = 1;
+					fans.push_back(i);
+				}
+			}
+		}
+		for (std::size_t k = 0; k < fans.size(); ++k) {
+			if (adjacency[fans[k]].size() == 4) {
+				variables.push_back(edge_usage_status_[fans[k]]);
+				variables.push_back(edge_sharp_status_[fans[k]]);
+			}
+		}
+		for (std::size_t j = 0; j < variables.size(); ++j)
+			local_index[variables[j]] = j;
+
+		// the sub-program on the free variables, the others fixed to their values
+		LinearProgram sub;
+		for (std::size_t j = 0; j < variables.size(); ++j) {
+			Variable* v = sub.create_variable();
+			v->set_variable_type(Variable::BINARY);
+		}
+		std::vector<std::size_t> rows;
+		for (std::size_t j = 0; j < variables.size(); ++j) {
+			for (std::size_t pos = evaluator.column_begin(variables[j]); pos < evaluator.column_end(variables[j]); ++pos) {
+				std::size_t r = evaluator.row(pos);
+				if (!row_visited[r]) {
+					row_visited[r] = 1;
+					rows.push_back(r);
+				}
+			}
+		}
+		const SparseMatrix& matrix = program_.constraint_matrix();
+		for (std::size_t k = 0; k < rows.size(); ++k) {
+			const LinearConstraint* c = constraints[rows[k]];
+			const SparseRow row = matrix.row(rows[k]);
+			double shift = 0.0;
+			for (std::size_t t = 0; t < row.size(); ++t) {
+				if (local_index[row.index(t)] == program_.num_variables())
+					shift += row.value(t) * evaluator.solution()[row.index(t)];
+			}
+			double lb, ub;
+			effective_bounds(c, lb, ub);
+			LinearConstraint* sc = sub.create_constraint(c->bound_type(), lb - shift, ub - shift);
+			sc->set_lazy(c->is_lazy());
+			for (std::size_t t = 0; t < row.size(); ++t) {
+				std::size_t j = local_index[row.index(t)];
+				if (j != program_.num_variables())
+					sc->add_coefficient(static_cast<int>(j), row.value(t));
+			}
+		}
+		LinearObjective* so = sub.create_objective(LinearObjective::MINIMIZE);
+		std::vector<double> start(variables.size());
+		for (std::size_t j = 0; j < variables.size(); ++j) {
+			if (evaluator.cost(variables[j]) != 0.0)
+				so->add_coefficient(static_cast<int>(j), evaluator.cost(variables[j]));
+			start[j] = evaluator.solution()[variables[j]];
+		}
+		sub.finalize();
+
+		for (std::size_t j = 0; j < faces.size(); ++j)
+			face_visited[faces[j]] = 0;
+		for (std::size_t k = 0; k < fans.size(); ++k)
+			fan_visited[fans[k]] = 0;
+		for (std::size_t k = 0; k < rows.size(); ++k)
+			row_visited[rows[k]] = 0;
+		for (std::size_t j = 0; j < variables.size(); ++j)
+			local_index[variables[j]] = program_.num_variables();
+
+		// the selection of the neighborhood, kept if it improves the objective without violating anything
+		LinearProgramSolver solver;
+		solver.set_verbose(false);
+		solver.set_options(selection_solver_options(std::max(Method::neighborhood_search_time - w.elapsed(), 0.01)));
+		solver.set_initial_solution(start);
+		bool improved = false;
+		if (solver.solve(&sub, solver_name)) {
+			const std::vector<double>& x = solver.solution();
+			const double before = evaluator.objective();
+			for (std::size_t j = 0; j < variables.size(); ++j)
+				evaluator.set(variables[j], x[j] > 0.5 ? 1.0 : 0.0);
+			if (evaluator.num_violated() == 0 && evaluator.objective() < before - 1e-9 * std::max(std::abs(before), 1.0))
+				improved = true;
+			else {
+				for (std::size_t j = 0; j < variables.size(); ++j)
+					evaluator.set(variables[j], start[j]);
+			}
+		}
+		if (improved) {
+			++num_improved;
+			num_stalled = 0;
+			if (incumbent_callback_)
+				incumbent_callback_(evaluator.solution());
+		}
+		else
+			++num_stalled;
+	}
+
+	X = evaluator.solution();
+	Logger::out("-") << "neighborhood search: objective " << initial << " -> " << evaluator.objective() << " ("
+		<< num_improved << " of " << num_rounds << " neighborhoods improved). " << w.elapsed() << " sec" << std::endl;
+	Profiler::add_counter("improved neighborhoods", double(num_improved));
+}
+
+
+bool FaceSelection::solve_lagrangian(const HypothesisGenerator::Adjacency& adjacency, std::vector<double>& X) const {
+	MapFacetAttribute<Plane3d*> supporting_plane;
+	supporting_plane.bind_if_defined(model_, "FacetSupportingPlane");
+	if (!supporting_plane.is_bound()) {
+		Logger::err("-") << "the candidate faces have no supporting planes" << std::endl;
+		return false;
+	}
+
+	const std::size_t num_faces = facet_point_num_.size();
+	std::vector<std::size_t> fan_start;
+	std::vector< std::vector<std::size_t> > face_fans;
+	fan_structure(adjacency, fan_start, face_fans);
+
+	// the pairs of faces (j, k) of each super edge of 4 faces that make it sharp, as the bits 4 * j + k 
+	const Weights weights = current_weights();
+	const double coeff_coverage = total_points_ * weights.model_coverage / bbox_area_;
+	const double coeff_complexity = total_points_ * weights.model_complexity / double(edge_sharp_status_.size());
+	std::vector<unsigned short> sharp_pairs(adjacency.size(), 0);
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const HypothesisGenerator::SuperEdge& fan = adjacency[i];
+		if (fan.size() != 4)
+			continue;
+		for (std::size_t j = 0; j < 4; ++j) {
+			for (std::size_t k = j + 1; k < 4; ++k) {
+				if (supporting_plane[fan[j]->facet()] != supporting_plane[fan[k]->facet()])
+					sharp_pairs[i] |= (unsigned short)(1 << (4 * j + k));
+			}
+		}
+	}
+	supporting_plane.unbind();
+
+	// the cost of each face in the objective, and its positions in the super edges
+	std::vector<double> cost(num_faces);
+	for (std::size_t f = 0; f < num_faces; ++f)
+		cost[f] = coeff_coverage * facet_uncovered_area_[f] - weights.data_fitting * facet_point_num_[f];
+	std::vector<std::size_t> position_start(num_faces + 1, 0), positions(fan_facets_.size());
+	for (std::size_t pos = 0; pos < fan_facets_.size(); ++pos)
+		++position_start[fan_facets_[pos] + 1];
+	for (std::size_t f = 0; f < num_faces; ++f)
+		position_start[f + 1] += position_start[f];
+	{
+		std::vector<std::size_t> next(position_start.begin(), position_start.end() - 1);
+		for (std::size_t pos = 0; pos < fan_facets_.size(); ++pos)
+			positions[next[fan_facets_[pos]]++] = pos;
+	}
+
+	// The constraints of each super edge only involve its own faces, so each super edge gets a copy of 
+	// its faces, and the copies are tied to the faces by multipliers (one per position in fan_facets_).
+	// The relaxation then decouples: each face is selected if its cost minus its multipliers is negative,
+	// and each super edge picks the cheapest of its valid configurations (no face, or two of its 4 faces
+	// and the complexity term if they make it sharp). Its value is a lower bound of the optimum, raised
+	// by subgradient steps on the multipliers. The decisions of the faces and their copies are rounded 
+	// (by their votes) and repaired into the feasible selections giving the upper bound.
+	std::vector<double> multipliers(fan_facets_.size(), 0.0);
+	std::vector<char> face_selected(num_faces, 0), copy_selected(fan_facets_.size(), 0);
+	std::vector<double> face_value(num_faces, 0.0), edge_value(adjacency.size(), 0.0);
+
+	double lower = -std::numeric_limits<double>::max();
+	double upper = std::numeric_limits<double>::max();
+	double theta = 2.0;
+	std::size_t stalled = 0;
+	const double limit = time_limit();
+	StopWatch w;
+
+	std::vector<double> scores(num_faces);
+	std::vector<char> selected;
+	std::vector<double> candidate;
+	std::size_t iter = 0;
+	for (; iter < Method::lagrangian_iterations; ++iter) {
+		parallel_for(num_faces, [&](std::size_t f) {
+			double reduced = cost[f];
+			for (std::size_t k = position_start[f]; k < position_start[f + 1]; ++k)
+				reduced -= multipliers[positions[k]];
+			face_selected[f] = reduced < 0.0;
+			face_value[f] = std::min(reduced, 0.0);
+		}, nil, Method::num_threads);
+
+		parallel_for(adjacency.size(), [&](std::size_t i) {
+			const std::size_t first = fan_start[i];
+			for (std::size_t pos = first; pos < fan_start[i + 1]; ++pos)
+				copy_selected[pos] = 0;
+			edge_value[i] = 0.0;
+			if (adjacency[i].size() != 4)
+				return;
+			std::size_t best_j = 4, best_k = 4;
+			for (std::size_t j = 0; j < 4; ++j) {
+				for (std::size_t k = j + 1; k < 4; ++k) {
+					double value = multipliers[first + j] + multipliers[first + k];
+					if (sharp_pairs[i] & (1 << (4 * j + k)))
+						value += coeff_complexity;
+					if (value < edge_value[i]) {
+						edge_value[i] = value;
+						best_j = j;
+						best_k = k;
+					}
+				}
+			}
+			if (best_j < 4) {
+				copy_selected[first + best_j] = 1;
+				copy_selected[first + best_k] = 1;
+			}
+		}, nil, Method::num_threads);
+
+		double value = 0.0;
+		for (std::size_t f = 0; f < num_faces; ++f)
+			value += face_value[f];
+		for (std::size_t i = 0; i < adjacency.size(); ++i)
+			value += edge_value[i];
+		if (value > lower + 1e-9 * std::max(std::abs(lower), 1.0)) {
+			lower = value;
+			stalled = 0;
+		}
+		else if (++stalled >= 20) {
+			theta *= 0.5;
+			stalled = 0;
+		}
+
+		// a feasible selection from the votes of each face and its copies
+		if (iter % 10 == 0 || iter + 1 == Method::lagrangian_iterations) {
+			for (std::size_t f = 0; f < num_faces; ++f) {
+				double votes = face_selected[f];
+				for (std::size_t k = position_start[f]; k < position_start[f + 1]; ++k)
+					votes += copy_selected[positions[k]];
+				scores[f] = votes / double(1 + position_start[f + 1] - position_start[f]);
+			}
+			repair_selection(adjacency, fan_start, face_fans, scores, selected);
+			if (complete_selection(adjacency, fan_start, selected, candidate)) {
+				double candidate_value = objective_value(program_, candidate);
+				if (candidate_value < upper) {
+					upper = candidate_value;
+					X.swap(candidate);
+					if (incumbent_callback_)
+						incumbent_callback_(X);
+				}
+			}
+		}
+
+		double norm = 0.0;
+		for (std::size_t pos = 0; pos < fan_facets_.size(); ++pos) {
+			double g = double(copy_selected[pos]) - double(face_selected[fan_facets_[pos]]);
+			norm += g * g;
+		}
+		if (norm == 0.0)	// the faces and their copies agree: the relaxed selection is optimal
+			break;
+		if (upper < std::numeric_limits<double>::max() && upper - lower <= 1e-6 * std::max(std::abs(upper), 1.0))
+			break;
+		if (limit > 0.0 && w.elapsed() > limit) {
+			Logger::warn("-") << "time limit reached, using the best selection found" << std::endl;
+			break;
+		}
+
+		// the step towards an estimate of the optimum (the best selection, or a bit above the bound)
+		double target = upper < std::numeric_limits<double>::max() ? upper : lower + 0.1 * std::max(std::abs(lower), 1.0);
+		double step = theta * (target - value) / norm;
+		parallel_for(fan_facets_.size(), [&](std::size_t pos) {
+			multipliers[pos] += step * (double(copy_selected[pos]) - double(face_selected[fan_facets_[pos]]));
+		}, nil, Method::num_threads);
+	}
+
+	// the relaxed selection itself, if it is consistent
+	for (std::size_t f = 0; f < num_faces; ++f)
+		scores[f] = face_selected[f];
+	repair_selection(adjacency, fan_start, face_fans, scores, selected);
+	if (complete_selection(adjacency, fan_start, selected, candidate)) {
+		double candidate_value = objective_value(program_, candidate);
+		if (candidate_value < upper) {
+			upper = candidate_value;
+			X.swap(candidate);
+		}
+	}
+	if (upper == std::numeric_limits<double>::max()) {
+		Logger::err("-") << "no valid selection was found" << std::endl;
+		return false;
+	}
+
+	double gap = (upper - lower) / std::max(std::abs(upper), 1e-10);
+	Logger::out("-") << "Lagrangian selection: objective " << upper << ", bound " << lower
+		<< ", gap " << 100.0 * gap << "% (" << iter << " iterations)" << std::endl;
+	Profiler::add_counter("Lagrangian iterations", double(iter));
+	Profiler::add_counter("gap to Lagrangian bound", gap);
+	return true;
+}
+
+
+bool FaceSelection::solve_graph_cut(const HypothesisGenerator::Adjacency& adjacency, const Weights& weights, std::vector<double>& X) const {
+	MapFacetAttribute<Plane3d*> supporting_plane;
+	supporting_plane.bind_if_defined(model_, "FacetSupportingPlane");
+	MapFacetAttribute<VertexGroup*> supporting_group;
+	supporting_group.bind_if_defined(model_, Method::facet_attrib_supporting_vertex_group);
+	if (!supporting_plane.is_bound() || !supporting_group.is_bound()) {
+		Logger::err("-") << "the candidate faces have no supporting planes" << std::endl;
+		return false;
+	}
+
+	// the planes, the centers, and the segments of the faces (in the order of their variables)
+	const std::size_t num_faces = facet_point_num_.size();
+	std::vector<const Plane3d*> planes;
+	std::unordered_map<const Plane3d*, std::size_t> plane_index;
+	std::vector<std::size_t> face_plane(num_faces);
+	std::vector<vec3> centers(num_faces);
+	std::vector<const VertexGroup*> face_group(num_faces);
+	std::size_t idx = 0;
+	FOR_EACH_FACET_CONST(Map, model_, it) {
+		if (idx == num_faces)
+			break;
+		const Plane3d* plane = supporting_plane[it];
+		std::unordered_map<const Plane3d*, std::size_t>::const_iterator pos = plane_index.find(plane);
+		if (pos == plane_index.end()) {
+			pos = plane_index.insert(std::make_pair(plane, planes.size())).first;
+			planes.push_back(plane);
+		}
+		face_plane[idx] = pos->second;
+		centers[idx] = Geom::facet_center(it);
+		face_group[idx] = supporting_group[it];
+		++idx;
+	}
+	supporting_plane.unbind();
+	supporting_group.unbind();
+	if (idx != num_faces) {
+		Logger::err("-") << "the model doesn't match the binary program" << std::endl;
+		return false;
+	}
+
+	// The faces partition the box into convex cells (the candidate faces are the arrangement of the 
+	// planes), so a cell is identified by the sides of the planes it lies on. The two cells of a face 
+	// are given by the sides of its center, on either side of its own plane.
+	const std::size_t num_words = (planes.size() + 63) / 64;
+	std::vector<Numeric::uint64> keys(num_faces * num_words, 0);
+	parallel_for(num_faces, [&](std::size_t f) {
+		Numeric::uint64* key = &keys[f * num_words];
+		for (std::size_t p = 0; p < planes.size(); ++p) {
+			if (p != face_plane[f] && planes[p]->orient(centers[f]) == POSITIVE)
+				key[p / 64] |= Numeric::uint64(1) << (p % 64);
+		}
+	}, nil, Method::num_threads);
+
+	// the side 2 * f + 1 of the face f is on the positive side of its plane
+	auto key_word = [&](std::size_t side, std::size_t w) -> Numeric::uint64 {
+		std::size_t f = side / 2, p = face_plane[f];
+		Numeric::uint64 word = keys[f * num_words + w];
+		if ((side & 1) && w == p / 64)
+			word |= Numeric::uint64(1) << (p % 64);
+		return word;
+	};
+	std::vector<std::size_t> sides(2 * num_faces);
+	for (std::size_t s = 0; s < sides.size(); ++s)
+		sides[s] = s;
+	std::sort(sides.begin(), sides.end(), [&](std::size_t a, std::size_t b) {
+		for (std::size_t w = 0; w < num_words; ++w) {
+			Numeric::uint64 ka = key_word(a, w), kb = key_word(b, w);
+			if (ka != kb)
+				return ka < kb;
+		}
+		return a < b;
+	});
+	std::vector<std::size_t> cell_of(sides.size());
+	std::size_t num_cells = 0;
+	for (std::size_t k = 0; k < sides.size(); ++k) {
+		bool same = (k > 0);
+		for (std::size_t w = 0; same && w < num_words; ++w)
+			same = key_word(sides[k], w) == key_word(sides[k - 1], w);
+		if (!same)
+			++num_cells;
+		cell_of[sides[k]] = num_cells - 1;
+	}
+
+	// the side of each plane the points of its segment face (by their normals, or away from the center
+	// of the points without normals)
+	const vec3 center = pset_->bbox().center();
+	std::unordered_map<const VertexGroup*, bool> outside_positive;
+	auto is_outside_positive = [&](std::size_t f) -> bool {
+		const VertexGroup* g = face_group[f];
+		std::unordered_map<const VertexGroup*, bool>::const_iterator pos = outside_positive.find(g);
+		if (pos != outside_positive.end())
+			return pos->second;
+		const Plane3d* plane = planes[face_plane[f]];
+		bool positive = (plane->orient(center) != POSITIVE);
+		if (g && pset_->has_normals()) {
+			const vec3 n = plane->normal();
+			const std::vector<vec3>& normals = pset_->normals();
+			double sum = 0.0;
+			for (std::size_t i = 0; i < g->size(); ++i)
+				sum += dot(normals[g->at(i)], n);
+			if (sum != 0.0)
+				positive = (sum > 0.0);
+		}
+		outside_positive[g] = positive;
+		return positive;
+	};
+
+	// The labeling pays, for each face, its data fitting term if its cells are not inside (behind the
+	// points) and outside (in front of them), and its coverage and complexity terms (the super edges of
+	// the face, each shared by two faces) if it separates its cells. The faces of the fans crossing the 
+	// box have their cells outside, and the faces of the other irregular fans can't be selected.
+	const double coeff_coverage = total_points_ * weights.model_coverage / bbox_area_;
+	const double coeff_complexity = total_points_ * weights.model_complexity / double(edge_sharp_status_.size());
+	std::vector<std::size_t> fan_start;
+	std::vector< std::vector<std::size_t> > face_fans;
+	fan_structure(adjacency, fan_start, face_fans);
+
+	std::vector<double> cost_inside(num_cells, 0.0), cost_outside(num_cells, 0.0), separation(num_faces, 0.0);
+	std::vector<char> on_border(num_faces, 0), fixed(num_faces, 0);
+	double total = 1.0;
+	for (std::size_t f = 0; f < num_faces; ++f) {
+		std::size_t num_edges = 0;
+		for (std::size_t k = 0; k < face_fans[f].size(); ++k) {
+			std::size_t size = adjacency[face_fans[f][k]].size();
+			if (size == 4)
+				++num_edges;
+			else if (size == 1)
+				on_border[f] = 1;
+			else
+				fixed[f] = 1;
+		}
+
+		const double fitting = weights.data_fitting * facet_point_num_[f];
+		const std::size_t front = cell_of[2 * f + (is_outside_positive(f) ? 1 : 0)];
+		const std::size_t back = cell_of[2 * f + (is_outside_positive(f) ? 0 : 1)];
+		cost_inside[front] += fitting;
+		cost_outside[back] += fitting;
+		separation[f] = coeff_coverage * facet_uncovered_area_[f] + coeff_complexity * 0.5 * num_edges;
+		total += 2.0 * fitting + separation[f];
+	}
+
+	MaxFlow graph(num_cells);	// the source side is inside
+	for (std::size_t c = 0; c < num_cells; ++c)
+		graph.add_terminal_weights(c, cost_outside[c], cost_inside[c]);
+	for (std::size_t f = 0; f < num_faces; ++f) {
+		const std::size_t a = cell_of[2 * f], b = cell_of[2 * f + 1];
+		if (on_border[f]) {
+			graph.add_terminal_weights(a, 0.0, total);
+			graph.add_terminal_weights(b, 0.0, total);
+		}
+		double cap = fixed[f] ? total : separation[f];
+		graph.add_edge(a, b, cap, cap);
+	}
+	const double energy = graph.compute();
+
+	std::vector<char> selected(num_faces, 0);
+	std::size_t num_selected = 0;
+	for (std::size_t f = 0; f < num_faces; ++f) {
+		selected[f] = graph.is_source_side(cell_of[2 * f]) != graph.is_source_side(cell_of[2 * f + 1]);
+		num_selected += selected[f];
+	}
+	std::size_t num_inside = 0;
+	for (std::size_t c = 0; c < num_cells; ++c)
+		num_inside += graph.is_source_side(c);
+	Logger::out("-") << num_cells << " cells, " << num_inside << " inside, " << num_selected
+		<< " faces selected (energy " << energy << ")" << std::endl;
+	Profiler::add_counter("cells", double(num_cells));
+
+	// The selection is closed, but the edges around which the labels alternate get four faces (the binary
+	// program allows two). They are kept as they are.
+	if (!complete_selection(adjacency, fan_start, selected, X)) {
+		std::size_t num_non_manifold = 0;
+		for (std::size_t i = 0; i < adjacency.size(); ++i) {
+			std::size_t count = 0;
+			for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos)
+				count += selected[fan_facets_[pos]];
+			num_non_manifold += (count > 2);
+		}
+		Logger::warn("-") << num_non_manifold << " edges with four selected faces" << std::endl;
+	}
+	return true;
+}
+
+
+void FaceSelection::repair_selection(const HypothesisGenerator::Adjacency& adjacency, const std::vector<std::size_t>& fan_start, const std::vector< std::vector<std::size_t> >& face_fans, const std::vector<double>& scores, std::vector<char>& selected) const {
+	// Rounds the faces, then repairs the super edges until each one has 0 or 2 selected faces (and
+	// none for the ones of a size other than 4). A super edge with a single face gets the most likely 
+	// second one if the two faces together are likely enough, otherwise the face is dropped. A face is 
+	// added at most once, so the repair terminates.
+	std::size_t num_faces = facet_point_num_.size();
+	std::vector<char> added(num_faces, 0);
+	selected.assign(num_faces, 0);
+	for (std::size_t f = 0; f < num_faces; ++f)
+		selected[f] = scores[f] >= 0.5;
+
+	std::vector<std::size_t> queue;
+	std::vector<char> queued(adjacency.size(), 1);
+	for (std::size_t i = adjacency.size(); i > 0; --i)
+		queue.push_back(i - 1);
+	while (!queue.empty()) {
+		std::size_t i = queue.back();
+		queue.pop_back();
+		queued[i] = 0;
+
+		std::size_t num_selected = 0, weakest = num_faces, strongest = num_faces;
+		for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos) {
+			std::size_t f = fan_facets_[pos];
+			if (selected[f]) {
+				++num_selected;
+				if (weakest == num_faces || scores[f] < scores[weakest])
+					weakest = f;
+			}
+			else if (!added[f] && (strongest == num_faces || scores[f] > scores[strongest]))
+				strongest = f;
+		}
+		if (num_selected == 0 || (num_selected == 2 && adjacency[i].size() == 4))
+			continue;
+
+		std::size_t changed = weakest;
+		if (adjacency[i].size() == 4 && num_selected == 1 && strongest != num_faces && scores[strongest] + scores[weakest] >= 1.0) {
+			changed = strongest;
+			selected[strongest] = 1;
+			added[strongest] = 1;
+		}
+		else
+			selected[weakest] = 0;
+
+		const std::vector<std::size_t>& fans = face_fans[changed];
+		for (std::size_t k = 0; k < fans.size(); ++k) {
+			if (!queued[fans[k]]) {
+				queued[fans[k]] = 1;
+				queue.push_back(fans[k]);
+			}
+		}
+	}
+}
+
+
+void FaceSelection::fan_structure(const HypothesisGenerator::Adjacency& adjacency, std::vector<std::size_t>& fan_start, std::vector< std::vector<std::size_t> >& face_fans) const {
+	fan_start.assign(adjacency.size() + 1, 0);
+	for (std::size_t i = 0; i < adjacency.size(); ++i)
+		fan_start[i + 1] = fan_start[i] + adjacency[i].size();
+
+	face_fans.assign(facet_point_num_.size(), std::vector<std::size_t>());
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos)
+			face_fans[fan_facets_[pos]].push_back(i);
+	}
+}
+
+
+bool FaceSelection::complete_selection(const HypothesisGenerator::Adjacency& adjacency, const std::vector<std::size_t>& fan_start, const std::vector<char>& selected, std::vector<double>& X) const {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+	std::size_t num_faces = facet_point_num_.size();
+	X.assign(program_.num_variables(), 0.0);
+	for (std::size_t f = 0; f < num_faces; ++f)
+		X[f] = selected[f] ? 1.0 : 0.0;
+	std::vector<char> is_sharp_variable(X.size(), 0);
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const SuperEdge& fan = adjacency[i];
+		if (fan.size() != 4)
+			continue;
+		std::size_t num_selected = 0;
+		for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos)
+			num_selected += selected[fan_facets_[pos]];
+		X[edge_usage_status_[i]] = num_selected == 2 ? 1.0 : 0.0;
+		is_sharp_variable[edge_sharp_status_[i]] = 1;
+	}
+
+	const std::vector<LinearConstraint*>& constraints = program_.constraints();
+	std::vector<double> activities = constraint_activities(program_, X);
+	for (std::size_t i = 0; i < constraints.size(); ++i) {
+		if (satisfies(constraints[i], activities[i]))
+			continue;
+		const SparseRow row = constraints[i]->coefficients();
+		for (std::size_t k = 0; k < row.size(); ++k) {
+			if (is_sharp_variable[row.index(k)] && row.value(k) > 0)
+				X[row.index(k)] = 1.0;
+		}
 	}
 
-	edge_source_planes_.bind_if_defined(model_, "EdgeSourcePlanes");
-	vertex_source_planes_.bind_if_defined(model_, "VertexSourcePlanes");
-	facet_attrib_supporting_plane_.bind_if_defined(model_, "FacetSupportingPlane");
+	activities = constraint_activities(program_, X);
+	for (std::size_t i = 0; i < constraints.size(); ++i) {
+		if (!satisfies(constraints[i], activities[i]))
+			return false;
+	}
+	return true;
+}
 
-	//////////////////////////////////////////////////////////////////////////
 
-	double total_points = double(pset_->points().size());
-	std::size_t idx = 0;
-	MapFacetAttribute<std::size_t>	facet_indices(model_);
-	FOR_EACH_FACET(Map, model_, it) {
-		Map::Facet* f = it;
-		facet_indices[f] = idx;
-		++idx;
+FaceSelection::VariableHints FaceSelection::VariableHints::subset(const std::vector<std::size_t>& indices) const {
+	VariableHints sub;
+	sub.values.resize(indices.size());
+	sub.priorities.resize(indices.size());
+	for (std::size_t j = 0; j < indices.size(); ++j) {
+		sub.values[j] = values[indices[j]];
+		sub.priorities[j] = priorities[indices[j]];
 	}
+	return sub;
+}
 
-	//-------------------------------------
 
-	StopWatch w;
-    Logger::out("-") << "face selection..." << std::endl;
+void FaceSelection::VariableHints::apply(LinearProgramSolver& solver) const {
+	if (empty())
+		return;
+	std::vector<int> p(priorities.size());
+	for (std::size_t i = 0; i < priorities.size(); ++i)
+		p[i] = static_cast<int>(std::lround(priorities[i]));
+	solver.set_variable_hints(values, p);
+}
 
-	//-------------------------------------
 
-	// binary variables:
-	// x[0] ... x[num_faces - 1] : binary labels of all the input faces
-	// x[num_faces] ... x[num_faces + num_edges] : binary labels of all the intersecting edges (remain or not)
-	// x[num_faces + num_edges] ... x[num_faces + num_edges + num_edges] : binary labels of corner edges (sharp edge of not)
+void FaceSelection::variable_hints(VariableHints& hints) const {
+	// only the faces get hints (the edge variables follow from them)
+	hints.values.assign(program_.num_variables(), -1.0);
+	hints.priorities.assign(program_.num_variables(), 0.0);
+	const std::size_t num_faces = facet_point_num_.size();
+	if (num_faces == 0 || facet_coverage_ratio_.size() != num_faces || num_faces > program_.num_variables())
+		return;
 
-	Logger::out("-") << "formulating binary program...." << std::endl;
-	w.start();
+	// the support of a face is measured against the average support of the supported faces
+	double total_support = 0.0;
+	std::size_t num_supported = 0;
+	for (std::size_t i = 0; i < num_faces; ++i) {
+		if (facet_point_num_[i] > 0.0) {
+			total_support += facet_point_num_[i];
+			++num_supported;
+		}
+	}
+	const double mean_support = (num_supported > 0) ? total_support / num_supported : 1.0;
 
-	std::size_t num_faces = model_->size_of_facets();
-	std::size_t num_edges = 0;
+	std::size_t num_likely = 0, num_unlikely = 0;
+	for (std::size_t i = 0; i < num_faces; ++i) {
+		if (facet_point_num_[i] <= 0.0) {
+			hints.values[i] = 0.0;
+			++num_unlikely;
+		}
+		else if (facet_coverage_ratio_[i] >= Method::selection_hint_coverage) {
+			const double support = std::min(facet_point_num_[i] / mean_support, 1.0);
+			hints.values[i] = 1.0;
+			hints.priorities[i] = 1.0 + std::floor(9.0 * facet_coverage_ratio_[i] * support + 0.5);	// in [1, 10]
+			++num_likely;
+		}
+	}
+	Logger::out("-") << "hints: " << num_likely << " faces likely selected, " << num_unlikely << " unlikely" << std::endl;
+}
 
-	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
-	std::map<const SuperEdge*, std::size_t> edge_usage_status;	// keep or remove an intersecting edges
+
+std::vector<double> FaceSelection::greedy_selection(const HypothesisGenerator::Adjacency& adjacency) const {
+	std::size_t num_faces = facet_point_num_.size();
+	std::vector<std::size_t> fan_start;
+	std::vector< std::vector<std::size_t> > face_fans;
+	fan_structure(adjacency, fan_start, face_fans);
+
+	// the cost of selecting each face (i.e., its data fitting and coverage terms), and the faces that
+	// can't be selected because they bound a super edge of a size other than 4
+	const LinearObjective* objective = program_.objective();
+	std::vector<double> cost(num_faces);
+	for (std::size_t f = 0; f < num_faces; ++f)
+		cost[f] = objective->coefficients().coefficient(int(f));
+	std::vector<char> forbidden(num_faces, 0);
 	for (std::size_t i = 0; i < adjacency.size(); ++i) {
-		const SuperEdge& fan = adjacency[i];
-		if (fan.size() == 4) {
-			std::size_t var_idx = num_faces + num_edges;
-			edge_usage_status[&fan] = var_idx;
-			++num_edges;
+		if (adjacency[i].size() != 4) {
+			for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos)
+				forbidden[fan_facets_[pos]] = 1;
 		}
 	}
 
-	//double coeff_data_fitting = Method::lambda_data_fitting / total_points;
-	//double coeff_coverage = Method::lambda_model_coverage / model_->bbox().area();
-	//double coeff_complexity = Method::lambda_model_complexity / double(fans.size());
-	// choose a better scale
-	double coeff_data_fitting = Method::lambda_data_fitting;
-	double coeff_coverage = total_points * Method::lambda_model_coverage / model_->bbox().area();
-	double coeff_complexity = total_points * Method::lambda_model_complexity / double(adjacency.size());
+	// the seeds are tried from the most to the least confident face
+	std::vector<std::size_t> seeds;
+	for (std::size_t f = 0; f < num_faces; ++f) {
+		if (!forbidden[f] && cost[f] < 0.0)
+			seeds.push_back(f);
+	}
+	std::stable_sort(seeds.begin(), seeds.end(), [&cost](std::size_t a, std::size_t b) { return cost[a] < cost[b]; });
+
+	// Grows a closed surface from each seed: every super edge reached by the surface gets the cheapest
+	// second face that doesn't give any super edge more than two faces. A surface is kept if it lowers 
+	// the cost, and discarded if it can't be closed.
+	std::vector<char> selected(num_faces, 0);
+	std::vector<std::size_t> fan_count(adjacency.size(), 0);	// selected faces of each super edge
+	std::vector<std::size_t> grown, queue;
+	for (std::size_t s = 0; s < seeds.size(); ++s) {
+		std::size_t seed = seeds[s];
+		bool fits = !selected[seed];
+		for (std::size_t k = 0; fits && k < face_fans[seed].size(); ++k)
+			fits = fan_count[face_fans[seed][k]] == 0;
+		if (!fits)
+			continue;
 
-	program_.clear();
-	LinearObjective* objective = program_.create_objective(LinearObjective::MINIMIZE);
+		grown.clear();
+		queue.clear();
+		grown.push_back(seed);
+		double grown_cost = cost[seed];
+		selected[seed] = 1;
+		for (std::size_t k = 0; k < face_fans[seed].size(); ++k) {
+			++fan_count[face_fans[seed][k]];
+			queue.push_back(face_fans[seed][k]);
+		}
 
-	std::map<const SuperEdge*, std::size_t> edge_sharp_status;	// the edge is sharp or not
-	std::size_t num_sharp_edges = 0;
-	for (std::size_t i = 0; i < adjacency.size(); ++i) {
-		const SuperEdge& fan = adjacency[i];
-		if (fan.size() == 4) {
-			std::size_t var_idx = num_faces + num_edges + num_sharp_edges;
-			edge_sharp_status[&fan] = var_idx;
+		bool closed = true;
+		while (closed && !queue.empty()) {
+			std::size_t i = queue.back();
+			queue.pop_back();
+			if (fan_count[i] != 1)
+				continue;
 
-			// accumulate model complexity term
-			objective->add_coefficient(var_idx, coeff_complexity);
-			++num_sharp_edges;
+			std::size_t best = num_faces;
+			for (std::size_t pos = fan_start[i]; pos < fan_start[i + 1]; ++pos) {
+				std::size_t f = fan_facets_[pos];
+				if (selected[f] || forbidden[f] || (best != num_faces && cost[f] >= cost[best]))
+					continue;
+				bool fits = true;
+				for (std::size_t k = 0; fits && k < face_fans[f].size(); ++k)
+					fits = fan_count[face_fans[f][k]] < 2;
+				if (fits)
+					best = f;
+			}
+			if (best == num_faces) {
+				closed = false;
+				break;
+			}
+
+			grown.push_back(best);
+			grown_cost += cost[best];
+			selected[best] = 1;
+			for (std::size_t k = 0; k < face_fans[best].size(); ++k) {
+				++fan_count[face_fans[best][k]];
+				queue.push_back(face_fans[best][k]);
+			}
+		}
+
+		if (!closed || grown_cost >= 0.0) {
+			for (std::size_t j = 0; j < grown.size(); ++j) {
+				std::size_t f = grown[j];
+				selected[f] = 0;
+				for (std::size_t k = 0; k < face_fans[f].size(); ++k)
+					--fan_count[face_fans[f][k]];
+			}
 		}
 	}
-	assert(num_edges == num_sharp_edges);
 
-	FOR_EACH_FACET(Map, model_, it) {
-		Map::Facet* f = it;
-		std::size_t var_idx = facet_indices[f];
+	std::vector<double> X;
+	if (!complete_selection(adjacency, fan_start, selected, X))
+		X.clear();
+	return X;
+}
 
-		// accumulate data fitting term
-		double num = facet_attrib_supporting_point_num_[f];
-		objective->add_coefficient(var_idx, -coeff_data_fitting * num);
 
-		// accumulate model coverage term
-		double uncovered_area = (facet_attrib_facet_area_[f] - facet_attrib_covered_area_[f]);
-		objective->add_coefficient(var_idx, coeff_coverage * uncovered_area);
+void FaceSelection::apply_solution(const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) {
+	// mark results
+	solution_ = X;
+	if (!keep_candidates_)
+		apply_selection(model_, adjacency, X);
+}
+
+
+Map* FaceSelection::selected_model(const HypothesisGenerator::Adjacency& adjacency) const {
+	if (!keep_candidates_ || solution_.empty() || !model_)
+		return nil;
+	return extract_selection(model_, adjacency, solution_);
+}
+
+
+Map* FaceSelection::selected_model(const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) const {
+	if (!keep_candidates_ || X.size() != program_.num_variables() || !model_)
+		return nil;
+	return extract_selection(model_, adjacency, X);
+}
+
+
+double FaceSelection::time_limit() const {
+	if (time_limit_ >= 0.0)
+		return time_limit_;
+	return context_ ? context_->selection_time_limit : Method::selection_time_limit;
+}
+
+
+FaceSelection::Weights FaceSelection::current_weights() const {
+	if (context_)
+		return Weights(context_->lambda_data_fitting, context_->lambda_model_coverage, context_->lambda_model_complexity);
+	return Weights(Method::lambda_data_fitting, Method::lambda_model_coverage, Method::lambda_model_complexity);
+}
+
+
+SolverSession* FaceSelection::session() const {
+	if (session_)
+		return session_;
+	return context_ ? context_->session : nil;
+}
+
+
+unsigned int FaceSelection::thread_budget() const {
+	return context_ ? context_->thread_budget() : parallel_thread_budget();
+}
+
+
+void FaceSelection::apply_selection(Map* model, const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) const {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+	std::size_t idx = 0;
+	MapFacetAttribute<std::size_t>	facet_indices(model);
+	FOR_EACH_FACET(Map, model, it) {
+		Map::Facet* f = it;
+		facet_indices[f] = idx;
+		++idx;
 	}
 
-	std::size_t total_variables = num_faces + num_edges + num_sharp_edges;
-	Logger::out("-") << "#total variables: " << total_variables << std::endl;
-	Logger::out(" ") << "    - face is selected: " << num_faces << std::endl;
-	Logger::out(" ") << "    - edge is used: " << num_edges << std::endl;
-	Logger::out(" ") << "    - edge is sharp: " << num_sharp_edges << std::endl;
+	if (Method::bulk_selection_extraction) {
+		rebuild_selection(model, adjacency, X, facet_indices);
+		return;
+	}
 
-#if 1
-	const std::vector<Variable*>& variables = program_.create_n_variables(total_variables);
-	for (std::size_t i = 0; i < total_variables; ++i) {
-		Variable* v = variables[i];
-		v->set_variable_type(Variable::BINARY);
+	std::vector<Map::Facet*> to_delete;
+	FOR_EACH_FACET(Map, model, it) {
+		Map::Facet* f = it;
+		std::size_t fid = facet_indices[f];
+		//if (static_cast<int>(X[fid]) == 0) { // Liangliang: be careful, floating point!!!
+		//if (static_cast<int>(X[fid]) != 1) { // Liangliang: be careful, floating point!!!
+		if (static_cast<int>(std::round(X[fid])) == 0) {
+			to_delete.push_back(f);
+		}
 	}
-#else // Liangliang: I was just curious about how the results look like if all variables 
-	//             are relaxed to be continuous.
-	const std::vector<Variable*>& variables = program_.create_n_variables(total_variables);
-	for (std::size_t i = 0; i < total_variables; ++i) {
-		Variable* v = variables[i];
-		v->set_variable_type(Variable::CONTINUOUS);
-		v->set_bounds(Variable::DOUBLE, 0, 1);
+
+	MapEditor editor(model);
+	for (std::size_t i = 0; i < to_delete.size(); ++i) {
+		Map::Facet* f = to_delete[i];
+		editor.erase_facet(f->halfedge());
 	}
-#endif
 
 	//////////////////////////////////////////////////////////////////////////
 
-	// Add constraints: the number of faces associated with an edge must be either 2 or 0
-	std::size_t var_edge_used_idx = 0;
+	// mark the sharp edges
+	MapHalfedgeAttribute<bool> edge_is_sharp(model, "SharpEdge");
+	FOR_EACH_EDGE(Map, model, it)
+		edge_is_sharp[it] = false;
+
 	for (std::size_t i = 0; i < adjacency.size(); ++i) {
-		LinearConstraint* c = program_.create_constraint(LinearConstraint::FIXED, 0.0, 0.0);
 		const SuperEdge& fan = adjacency[i];
-		for (std::size_t j = 0; j < fan.size(); ++j) {
-			MapTypes::Facet* f = fan[j]->facet();
-			std::size_t var_idx = facet_indices[f];
-			c->add_coefficient(var_idx, 1.0);
+		if (fan.size() != 4)
+			continue;
+
+		std::size_t idx_sharp_var = edge_sharp_status_[i];
+		if (static_cast<int>(X[idx_sharp_var]) == 1) {
+			for (std::size_t j = 0; j < fan.size(); ++j) {
+				Map::Halfedge* e = fan[j];
+				Map::Facet* f = e->facet();
+				if (f) { // some faces may be deleted
+					std::size_t fid = facet_indices[f];
+					// if (static_cast<int>(X[fid]) == 1) { // Liangliang: be careful, floating point!!!
+					if (static_cast<int>(std::round(X[fid])) == 1) {
+						edge_is_sharp[e] = true;
+						break;
+					}
+				}
+			}
 		}
+	}
+}
 
-		if (fan.size() == 4) {
-			std::size_t var_idx = num_faces + var_edge_used_idx;
-			c->add_coefficient(var_idx, -2.0);  // 
-			++var_edge_used_idx;
+
+void FaceSelection::rebuild_selection(Map* model, const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X, MapFacetAttribute<std::size_t>& facet_indices) const {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+	std::vector<Map::Facet*> selected;
+	MapFacetAttribute<int> selected_index(model);
+	FOR_EACH_FACET(Map, model, it) {
+		Map::Facet* f = it;
+		selected_index[f] = -1;
+		if (static_cast<int>(std::round(X[facet_indices[f]])) == 1) {
+			selected_index[f] = int(selected.size());
+			selected.push_back(f);
 		}
-		else { // boundary edge
-		    // will be set to 0 (i.e., we don't allow open surface)
+	}
+
+	// the indexed face set of the selected faces (starting each one from the origin of its halfedge(), 
+	// as MapCopier does)
+	std::vector<vec3> points;
+	std::vector<unsigned int> face_offsets(1, 0), face_indices;
+	{
+		MapVertexAttribute<int> vertex_id(model);
+		FOR_EACH_VERTEX(Map, model, it)
+			vertex_id[it] = -1;
+		for (std::size_t i = 0; i < selected.size(); ++i) {
+			Map::Halfedge* h = selected[i]->halfedge();
+			do {
+				Map::Vertex* v = h->opposite()->vertex();
+				if (vertex_id[v] == -1) {
+					vertex_id[v] = int(points.size());
+					points.push_back(v->point());
+				}
+				face_indices.push_back(static_cast<unsigned int>(vertex_id[v]));
+				h = h->next();
+			} while (h != selected[i]->halfedge());
+			face_offsets.push_back(static_cast<unsigned int>(face_indices.size()));
 		}
 	}
 
-	// Add constraints: for the sharp edges. The explanation of posing this constraint can be found here:
-	// https://user-images.githubusercontent.com/15526536/30185644-12085a9c-942b-11e7-831d-290dd2a4d50c.png
-	double M = 1.0;
+	// the sharp edges (see apply_selection()), as the selected face and the position of the halfedge in it
+	std::vector< std::pair<std::size_t, std::size_t> > sharp_edges;
 	for (std::size_t i = 0; i < adjacency.size(); ++i) {
 		const SuperEdge& fan = adjacency[i];
-		if (fan.size() != 4)
+		if (fan.size() != 4 || static_cast<int>(X[edge_sharp_status_[i]]) != 1)
 			continue;
-
-		// if an edge is sharp, the edge must be selected first:
-		// X[var_edge_usage_idx] >= X[var_edge_sharp_idx]	
-		LinearConstraint* c = program_.create_constraint();
-		std::size_t var_edge_usage_idx = edge_usage_status[&fan];
-		c->add_coefficient(var_edge_usage_idx, 1.0);
-		std::size_t var_edge_sharp_idx = edge_sharp_status[&fan];
-		c->add_coefficient(var_edge_sharp_idx, -1.0);
-		c->set_bound(LinearConstraint::LOWER, 0.0);
-
 		for (std::size_t j = 0; j < fan.size(); ++j) {
-			MapTypes::Facet* f1 = fan[j]->facet();
-			Plane3d* plane1 = facet_attrib_supporting_plane_[f1];
-			std::size_t fid1 = facet_indices[f1];
-			for (std::size_t k = j + 1; k < fan.size(); ++k) {
-				MapTypes::Facet* f2 = fan[k]->facet();
-				Plane3d* plane2 = facet_attrib_supporting_plane_[f2];
-				std::size_t fid2 = facet_indices[f2];
-
-				if (plane1 != plane2) {
-					// the constraint is:
-					//X[var_edge_sharp_idx] + M * (3 - (X[fid1] + X[fid2] + X[var_edge_usage_idx])) >= 1
-					// which equals to  
-					//X[var_edge_sharp_idx] - M * X[fid1] - M * X[fid2] - M * X[var_edge_usage_idx] >= 1 - 3M
-					c = program_.create_constraint();
-					c->add_coefficient(var_edge_sharp_idx, 1.0);
-					c->add_coefficient(fid1, -M);
-					c->add_coefficient(fid2, -M);
-					c->add_coefficient(var_edge_usage_idx, -M);
-					c->set_bound(LinearConstraint::LOWER, 1.0 - 3.0 * M);
-				}
+			Map::Halfedge* e = fan[j];
+			int s = selected_index[e->facet()];
+			if (s != -1) {
+				std::size_t pos = 0;
+				for (Map::Halfedge* h = selected[s]->halfedge(); h != e; h = h->next())
+					++pos;
+				sharp_edges.push_back(std::make_pair(std::size_t(s), pos));
+				break;
 			}
 		}
 	}
 
-#if 1
-    // Add some optional constraints: border faces must be removed
-    for (std::size_t i = 0; i < adjacency.size(); ++i) {
-        const SuperEdge &fan = adjacency[i];
-        if (fan.size() == 1) { // boundary edge
-            MapTypes::Facet* f = fan[0]->facet();
-            std::size_t var_idx = facet_indices[f];
-            LinearConstraint* c = program_.create_constraint(LinearConstraint::FIXED, 0.0, 0.0);
-            c->add_coefficient(var_idx, 1.0);
-        }
-    }
-#endif
+	// The faces are built at once into a temporary mesh keeping their attributes, then the model is
+	// emptied (keeping its attributes bound) and rebuilt from the same arrays, and the chunks it no 
+	// longer uses are released.
+	MapCopier copier;
+	copier.set_copy_all_attributes(true);
+	Map::Ptr copy = new Map;
+	std::vector<Map::Facet*> copies;
+	{
+		MapBuilder builder(copy);
+		builder.set_quiet(true);
+		builder.build_from_arrays(points, face_offsets, face_indices, &copies);
+	}
+	copier.copy_facet_attributes(copy, copies, model, selected);
+	selected_index.unbind();
+	facet_indices.unbind();
+
+	model->recycle();
+	std::vector<Map::Facet*> facets;
+	{
+		MapBuilder builder(model);
+		builder.set_quiet(true);
+		builder.build_from_arrays(points, face_offsets, face_indices, &facets);
+	}
+	copier.copy_facet_attributes(model, facets, copy, copies);
+
+	MapHalfedgeAttribute<bool> edge_is_sharp(model, "SharpEdge");
+	FOR_EACH_EDGE(Map, model, it)
+		edge_is_sharp[it] = false;
+	for (std::size_t k = 0; k < sharp_edges.size(); ++k) {
+		Map::Facet* f = facets[sharp_edges[k].first];
+		if (!f)
+			continue;
+		// the facets built from the arrays start at the same vertex (see MapBuilder::build_from_arrays())
+		Map::Halfedge* h = f->halfedge();
+		for (std::size_t pos = 0; pos < sharp_edges[k].second; ++pos)
+			h = h->next();
+		edge_is_sharp[h] = true;
+	}
+	edge_is_sharp.unbind();
 
-	Logger::out("-") << "#total constraints: " << program_.constraints().size() << std::endl;
-	Logger::out("-") << "formulating binary program done. " << w.elapsed() << " sec" << std::endl;
+	std::vector<Map::Facet*> order;
+	order.reserve(facets.size());
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		if (facets[i])
+			order.push_back(facets[i]);
+	}
+	model->compact(order);
+}
 
-	//////////////////////////////////////////////////////////////////////////
 
-	// Optimize model
-	Logger::out("-") << "solving the binary program. Please wait..." << std::endl;
-	w.start();
+Map* FaceSelection::extract_selection(Map* candidates, const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) const {
+	typedef typename HypothesisGenerator::SuperEdge SuperEdge;
 
-#if 0
-    // Save the problem into a file (in lp format), allowing me to use other solvers to
-    // solve it (easy to compare the performance of different solvers).
-    program_.save("D:/tmp/bunny.lp");
-#endif
+	std::size_t idx = 0;
+	MapFacetAttribute<std::size_t>	facet_indices(candidates);
+	std::vector<Map::Facet*> selected;
+	FOR_EACH_FACET(Map, candidates, it) {
+		Map::Facet* f = it;
+		facet_indices[f] = idx;
+		if (static_cast<int>(std::round(X[idx])) == 1)
+			selected.push_back(f);
+		++idx;
+	}
 
-	LinearProgramSolver solver;
-	if (solver.solve(&program_, solver_name)) {
-		Logger::out("-") << "solving the binary program done. " << w.elapsed() << " sec" << std::endl;
+	Map* model = new Map;
+	std::vector<Map::Facet*> copies;
+	{
+		MapCopier copier;
+		copier.set_copy_all_attributes(true);
+		MapBuilder builder(model);
+		builder.set_quiet(true);
+		builder.begin_surface();
+		copier.copy(builder, candidates, selected, copies);
+		builder.end_surface();
+	}
+
+	// the halfedges of the copies
+	MapHalfedgeAttribute<Map::Halfedge*> copy_of(candidates);
+	for (std::size_t i = 0; i < selected.size(); ++i) {
+		Map::Halfedge* h = selected[i]->halfedge();
+		Map::Halfedge* c = copies[i]->halfedge();
+		do {
+			copy_of[h] = c;
+			h = h->next();
+			c = c->next();
+		} while (h != selected[i]->halfedge());
+	}
+
+	// mark the sharp edges (see apply_selection())
+	MapHalfedgeAttribute<bool> edge_is_sharp(model, "SharpEdge");
+	FOR_EACH_EDGE(Map, model, it)
+		edge_is_sharp[it] = false;
+
+	for (std::size_t i = 0; i < adjacency.size(); ++i) {
+		const SuperEdge& fan = adjacency[i];
+		if (fan.size() != 4)
+			continue;
 
-		// mark results
-		const std::vector<double>& X = solver.solution();
-		std::vector<Map::Facet*> to_delete;
-		FOR_EACH_FACET(Map, model_, it) {
-			Map::Facet* f = it;
-			std::size_t fid = facet_indices[f];
-			//if (static_cast<int>(X[fid]) == 0) { // Liangliang: be careful, floating point!!!
-			//if (static_cast<int>(X[fid]) != 1) { // Liangliang: be careful, floating point!!!
-			if (static_cast<int>(std::round(X[fid])) == 0) {
-				to_delete.push_back(f);
+		std::size_t idx_sharp_var = edge_sharp_status_[i];
+		if (static_cast<int>(X[idx_sharp_var]) == 1) {
+			for (std::size_t j = 0; j < fan.size(); ++j) {
+				Map::Halfedge* e = fan[j];
+				std::size_t fid = facet_indices[e->facet()];
+				if (static_cast<int>(std::round(X[fid])) == 1) {
+					edge_is_sharp[copy_of[e]] = true;
+					break;
+				}
 			}
 		}
+	}
+	return model;
+}
 
-		MapEditor editor(model_);
-		for (std::size_t i = 0; i < to_delete.size(); ++i) {
-			Map::Facet* f = to_delete[i];
-			editor.erase_facet(f->halfedge());
-		}
 
-		//////////////////////////////////////////////////////////////////////////
+bool FaceSelection::solve_components(const LinearProgram& program, LinearProgramSolver::SolverName solver_name, bool parallel, const std::vector<double>& start, const VariableHints& hints, std::vector<double>& X, const IncumbentCallback& report) const {
+	std::vector<std::size_t> local_index;
+	std::vector<ProgramComponent> components = connected_components(program, local_index);
+	Logger::out("-") << "#independent components: " << components.size() << std::endl;
+	Profiler::add_counter("components", double(components.size()));
+
+	bool use_start = (start.size() == program.num_variables());
+	if (components.size() <= 1 && !component_dispatcher_) {
+		SearchMonitor monitor;
+		monitor.set_callback(search_callback_);
+		LinearProgramSolver solver;
+		LinearProgramSolver::SolverOptions options = selection_solver_options(time_limit(), &monitor);
+		if (report)
+			options.incumbent_callback = [&report](double, const std::vector<double>& x) { report(x); };
+		solver.set_options(options);
+		solver.set_cache(selection_cache());
+		solver.set_session(session());
+		if (use_start)
+			solver.set_initial_solution(start);
+		hints.apply(solver);
+		if (!solver.solve(&program, solver_name))
+			return false;
+		X = solver.solution();
+		if (solver.status() == LinearProgramSolver::STATUS_LIMIT_REACHED)
+			Logger::warn("-") << "time limit reached, using the best solution found" << std::endl;
+		return true;
+	}
 
-		// mark the sharp edges
-		MapHalfedgeAttribute<bool> edge_is_sharp(model_, "SharpEdge");
-		FOR_EACH_EDGE(Map, model_, it)
-			edge_is_sharp[it] = false;
+	if (component_dispatcher_) {
+		std::vector<LinearProgram> subs(components.size());
+		std::vector<const LinearProgram*> programs(components.size());
+		parallel_for(components.size(), [&](std::size_t i) {
+			extract_component(program, components[i], local_index, subs[i]);
+			subs[i].finalize();
+			programs[i] = &subs[i];
+		}, nil, Method::num_threads);
+
+		std::vector< std::vector<double> > solutions(components.size());
+		if (!component_dispatcher_(programs, time_limit(), solutions) || solutions.size() != components.size()) {
+			Logger::err("-") << "dispatching the components failed" << std::endl;
+			return false;
+		}
 
-		for (std::size_t i = 0; i < adjacency.size(); ++i) {
-			const SuperEdge& fan = adjacency[i];
-			if (fan.size() != 4)
+		X.assign(program.num_variables(), 0.0);
+		std::size_t num_failed = 0;
+		for (std::size_t i = 0; i < components.size(); ++i) {
+			const ProgramComponent& comp = components[i];
+			if (solutions[i].size() != comp.variables.size()) {
+				++num_failed;
 				continue;
+			}
+			for (std::size_t j = 0; j < comp.variables.size(); ++j)
+				X[comp.variables[j]] = solutions[i][j];
+		}
+		if (num_failed > 0) {
+			Logger::err("-") << num_failed << " of the " << components.size() << " components could not be solved" << std::endl;
+			return false;
+		}
+		return true;
+	}
 
-			std::size_t idx_sharp_var = edge_sharp_status[&fan];
-			if (static_cast<int>(X[idx_sharp_var]) == 1) {
-				for (std::size_t j = 0; j < fan.size(); ++j) {
-					Map::Halfedge* e = fan[j];
-					Map::Facet* f = e->facet();
-					if (f) { // some faces may be deleted
-						std::size_t fid = facet_indices[f];
-						// if (static_cast<int>(X[fid]) == 1) { // Liangliang: be careful, floating point!!!
-						if (static_cast<int>(std::round(X[fid])) == 1) {
-							edge_is_sharp[e] = true;
-							break;
-						}
-					}
+	// GLPK keeps its environment in global variables, and all the Gurobi models share one environment
+	bool concurrent = parallel && (solver_name == LinearProgramSolver::SCIP || solver_name == LinearProgramSolver::LPSOLVE);
+
+	// the time limit applies to all the components together
+	const double total_time_limit = time_limit();
+	StopWatch w;
+	X.assign(program.num_variables(), 0.0);
+	std::vector<char> solved(components.size(), 0);	// 0: failed, 1: optimal, 2: limit reached
+
+	// the components solved one after another share the environment of the solver (and can be 
+	// canceled; the concurrent ones would report from the worker threads)
+	SolverSession own_session;
+	SolverSession* session = this->session() ? this->session() : &own_session;
+	SearchMonitor monitor(false);
+	SolutionCache* cache = selection_cache();	// also takes the components identical to the ones of earlier runs
+
+	// the reported solution: the start (or nothing selected, which is feasible) with the solved components
+	std::vector<double> incumbent;
+	if (report)
+		incumbent = use_start ? start : X;
+	std::mutex incumbent_mutex;
+	double last_report = -1.0;
+	parallel_for(components.size(), [&](std::size_t i) {
+		const ProgramComponent& comp = components[i];
+		LinearProgram sub;
+		extract_component(program, comp, local_index, sub);
+
+		double time_limit = 0.0;
+		if (total_time_limit > 0.0)
+			time_limit = std::max(total_time_limit - w.elapsed(), 0.01);
+
+		LinearProgramSolver solver;
+		solver.set_verbose(false);
+		solver.set_options(selection_solver_options(time_limit, concurrent ? 0 : &monitor));
+		solver.set_cache(cache);
+		if (!concurrent)
+			solver.set_session(session);
+		if (use_start) {
+			std::vector<double> comp_start(comp.variables.size());
+			for (std::size_t j = 0; j < comp.variables.size(); ++j)
+				comp_start[j] = start[comp.variables[j]];
+			solver.set_initial_solution(comp_start);
+		}
+		if (!hints.empty())
+			hints.subset(comp.variables).apply(solver);
+
+		if (solver.solve(&sub, solver_name)) {
+			const std::vector<double>& x = solver.solution();
+			for (std::size_t j = 0; j < comp.variables.size(); ++j)
+				X[comp.variables[j]] = x[j];
+			solved[i] = (solver.status() == LinearProgramSolver::STATUS_LIMIT_REACHED) ? 2 : 1;
+
+			if (report) {
+				std::lock_guard<std::mutex> lock(incumbent_mutex);
+				for (std::size_t j = 0; j < comp.variables.size(); ++j)
+					incumbent[comp.variables[j]] = x[j];
+				if (w.elapsed() - last_report >= 0.5) {
+					last_report = w.elapsed();
+					report(incumbent);
 				}
 			}
 		}
-	}
-	else {
-        Logger::out("-") << "solving the binary program failed. " << w.elapsed() << " sec." << std::endl;
-	}
+	}, nil, concurrent ? Method::num_threads : 1);
 
-	facet_attrib_supporting_vertex_group_.unbind();
-	facet_attrib_supporting_point_num_.unbind();
-	facet_attrib_facet_area_.unbind();
-	facet_attrib_covered_area_.unbind();
+	std::size_t num_limited = std::count(solved.begin(), solved.end(), 2);
+	if (num_limited > 0)
+		Logger::warn("-") << "time limit reached for " << num_limited << " components, using the best solutions found" << std::endl;
 
-	vertex_source_planes_.unbind();
-	edge_source_planes_.unbind();
-	facet_attrib_supporting_plane_.unbind();
+	std::size_t num_failed = std::count(solved.begin(), solved.end(), 0);
+	if (num_failed > 0) {
+		Logger::err("-") << num_failed << " of the " << components.size() << " components could not be solved" << std::endl;
+		return false;
+	}
+	return true;
 }
 
 
-
 void FaceSelection::re_orient(const HypothesisGenerator::Adjacency &adjacency, LinearProgramSolver::SolverName solver_name) {
-    if (model_ == nullptr)
+    re_orient(model_, adjacency, solver_name);
+}
+
+
+void FaceSelection::re_orient(Map* model, const HypothesisGenerator::Adjacency &adjacency, LinearProgramSolver::SolverName solver_name) const {
+	ScopedThreadBudget budget(thread_budget());
+    if (model == nullptr)
         return;
 
+    ProfileStage stage("re_orient");
+
 #if 1
     // check if input is legal
     for (std::size_t i = 0; i<adjacency.size(); ++i) {
@@ -343,8 +2807,8 @@ void FaceSelection::re_orient(const HypothesisGenerator::Adjacency &adjacency, L
 #endif
 
     std::size_t idx = 0;
-    MapFacetAttribute<std::size_t>	facet_indices(model_);
-    FOR_EACH_FACET(Map, model_, it) {
+    MapFacetAttribute<std::size_t>	facet_indices(model);
+    FOR_EACH_FACET(Map, model, it) {
         Map::Facet* f = it;
         facet_indices[f] = idx;
         ++idx;
@@ -357,22 +2821,131 @@ void FaceSelection::re_orient(const HypothesisGenerator::Adjacency &adjacency, L
 
     //-------------------------------------
 
+    // Every edge joins two faces, so each constraint of the program below only says whether two faces
+    // flip together or not. Propagating this over the faces gives its optimum directly (per connected 
+    // group of faces, the labeling that flips fewer faces), and the program is only solved if the 
+    // propagation finds a conflict.
+    std::vector<char> flip;
+    if (propagate_orientation(adjacency, facet_indices, model->size_of_facets(), flip))
+        Logger::out("-") << "orientation propagated. " << w.elapsed() << " sec" << std::endl;
+    else {
+        Logger::warn("-") << "inconsistent orientations, solving the binary program" << std::endl;
+        if (!solve_orientation(model, adjacency, facet_indices, solver_name, flip))
+            return;
+    }
+
+    MapFacetAttribute<bool> visited(model);
+    FOR_EACH_FACET(Map, model, it) {
+        Map::Facet* f = it;
+        visited[f] = false;
+    }
+
+    MapEditor editor(model);
+    FOR_EACH_FACET(Map, model, it) {
+        Map::Facet* f = it;
+        std::size_t fid = facet_indices[f];
+        if (flip[fid] && !visited[f]) {
+            editor.reorient_facet(f->halfedge());
+            visited[f] = true;
+        }
+    }
+    // Note: A border edge is now parallel to its opposite edge.
+    // We scan all border edges for this property. If it holds, we
+    // reorient the associated hole and search again until no border
+    // edge with that property exists any longer. Then, all holes are
+    // reoriented.
+    FOR_EACH_HALFEDGE(Map, model, it) {
+        if (it->is_border() && it->vertex() == it->opposite()->vertex()) {
+            editor.reorient_facet(it);
+        }
+    }
+    model->compute_facet_normals();
+}
+
+
+bool FaceSelection::propagate_orientation(const HypothesisGenerator::Adjacency& adjacency, MapFacetAttribute<std::size_t>& facet_indices, std::size_t num_faces, std::vector<char>& flip) const {
+    typedef typename HypothesisGenerator::SuperEdge SuperEdge;
+
+    // the neighbors of each face, and whether exactly one of the two must flip
+    std::vector<std::size_t> start(num_faces + 1, 0);
+    std::vector<std::size_t> ends(adjacency.size() * 2);
+    std::vector<char> differ(adjacency.size());
+    for (std::size_t i = 0; i < adjacency.size(); ++i) {
+        const SuperEdge& fan = adjacency[i];
+        differ[i] = dot(Geom::vector(fan[0]), Geom::vector(fan[1])) > 0;
+        ++start[facet_indices[fan[0]->facet()] + 1];
+        ++start[facet_indices[fan[1]->facet()] + 1];
+    }
+    for (std::size_t f = 0; f < num_faces; ++f)
+        start[f + 1] += start[f];
+    std::vector<std::size_t> neighbors(start.back());
+    std::vector<std::size_t> pos(start.begin(), start.end() - 1);
+    for (std::size_t i = 0; i < adjacency.size(); ++i) {
+        const SuperEdge& fan = adjacency[i];
+        std::size_t f0 = facet_indices[fan[0]->facet()];
+        std::size_t f1 = facet_indices[fan[1]->facet()];
+        ends[pos[f0]] = i;
+        neighbors[pos[f0]++] = f1;
+        ends[pos[f1]] = i;
+        neighbors[pos[f1]++] = f0;
+    }
+
+    const char unlabeled = 2;
+    flip.assign(num_faces, unlabeled);
+    std::vector<std::size_t> group;
+    for (std::size_t seed = 0; seed < num_faces; ++seed) {
+        if (flip[seed] != unlabeled)
+            continue;
+
+        // breadth-first over the group of faces connected to the seed
+        group.clear();
+        group.push_back(seed);
+        flip[seed] = 0;
+        std::size_t num_flipped = 0;
+        for (std::size_t head = 0; head < group.size(); ++head) {
+            std::size_t f = group[head];
+            for (std::size_t k = start[f]; k < start[f + 1]; ++k) {
+                std::size_t g = neighbors[k];
+                char label = flip[f] ^ differ[ends[k]];
+                if (flip[g] == unlabeled) {
+                    flip[g] = label;
+                    num_flipped += label;
+                    group.push_back(g);
+                }
+                else if (flip[g] != label)
+                    return false;
+            }
+        }
+
+        // flipping all the faces of a group keeps it consistent
+        if (num_flipped * 2 > group.size()) {
+            for (std::size_t j = 0; j < group.size(); ++j)
+                flip[group[j]] = !flip[group[j]];
+        }
+    }
+    return true;
+}
+
+
+bool FaceSelection::solve_orientation(Map* model, const HypothesisGenerator::Adjacency& adjacency, MapFacetAttribute<std::size_t>& facet_indices, LinearProgramSolver::SolverName solver_name, std::vector<char>& flip) const {
+    StopWatch w;
+
     // binary variables:
     // x[0] ... x[num_faces - 1] : binary labels of all the input faces
 
     Logger::out("-") << "formulating binary program...." << std::endl;
     w.start();
 
-    program_.clear();
-
-    const std::vector<Variable*>& variables = program_.create_n_variables(model_->size_of_facets());
+    // a separate program, so that the one of the face selection can still be re-optimized
+    LinearProgram program;
+    const std::vector<Variable*>& variables = program.create_n_variables(model->size_of_facets());
     for (std::size_t i = 0; i < variables.size(); ++i) {
         Variable* v = variables[i];
         v->set_variable_type(Variable::BINARY);
     }
 
-    LinearObjective* objective = program_.create_objective(LinearObjective::MINIMIZE);
-    FOR_EACH_FACET(Map, model_, it) {
+    LinearObjective* objective = program.create_objective(LinearObjective::MINIMIZE);
+    FOR_EACH_FACET(Map, model, it) {
         Map::Facet* f = it;
         std::size_t var_idx = facet_indices[f];
         objective->add_coefficient(var_idx, 1.0);
@@ -396,19 +2969,19 @@ void FaceSelection::re_orient(const HypothesisGenerator::Adjacency &adjacency, L
         std::size_t var_idx1 = facet_indices[f1];
 
         if (dot(Geom::vector(h0), Geom::vector(h1)) > 0) { // one must flip: x_i + x_j = 1
-            LinearConstraint* c = program_.create_constraint(LinearConstraint::FIXED, 1.0, 1.0);
+            LinearConstraint* c = program.create_constraint(LinearConstraint::FIXED, 1.0, 1.0);
             c->add_coefficient(var_idx0, 1.0);
             c->add_coefficient(var_idx1, 1.0);
         }
         else { // both flip, or both not: x_i - x_j = 0
-            LinearConstraint* c = program_.create_constraint(LinearConstraint::FIXED, 0.0, 0.0);
+            LinearConstraint* c = program.create_constraint(LinearConstraint::FIXED, 0.0, 0.0);
             c->add_coefficient(var_idx0,  1.0);
             c->add_coefficient(var_idx1, -1.0);
         }
     }
 
-    Logger::out("-") << "#total variables: " << program_.variables().size() << std::endl;
-    Logger::out("-") << "#total constraints: " << program_.constraints().size() << std::endl;
+    Logger::out("-") << "#total variables: " << program.variables().size() << std::endl;
+    Logger::out("-") << "#total constraints: " << program.constraints().size() << std::endl;
     Logger::out("-") << "formulating binary program done. " << w.elapsed() << " sec" << std::endl;
 
     //////////////////////////////////////////////////////////////////////////
@@ -418,38 +2991,20 @@ void FaceSelection::re_orient(const HypothesisGenerator::Adjacency &adjacency, L
     w.start();
 
     LinearProgramSolver solver;
-    if (solver.solve(&program_, solver_name)) {
-        Logger::out("-") << "solving the binary program done. " << w.elapsed() << " sec" << std::endl;
-
-        MapFacetAttribute<bool> visited(model_);
-        FOR_EACH_FACET(Map, model_, it) {
-            Map::Facet* f = it;
-            visited[f] = false;
-        }
-
-        const std::vector<double>& X = solver.solution();
-        MapEditor editor(model_);
-        FOR_EACH_FACET(Map, model_, it) {
-            Map::Facet* f = it;
-            std::size_t fid = facet_indices[f];
-            if (static_cast<int>(std::round(X[fid])) == 1 && !visited[f]) {
-                editor.reorient_facet(f->halfedge());
-                visited[f] = true;
-            }
-        }
-        // Note: A border edge is now parallel to its opposite edge.
-        // We scan all border edges for this property. If it holds, we
-        // reorient the associated hole and search again until no border
-        // edge with that property exists any longer. Then, all holes are
-        // reoriented.
-        FOR_EACH_HALFEDGE(Map, model_, it) {
-            if (it->is_border() && it->vertex() == it->opposite()->vertex()) {
-                editor.reorient_facet(it);
-            }
-        }
-        model_->compute_facet_normals();
+    bool solved = false;
+    {
+        ProfileStage stage("solve");
+        solved = solver.solve(&program, solver_name);
     }
-    else {
+    if (!solved) {
         Logger::out("-") << "solving the binary program failed. " << w.elapsed() << " sec." << std::endl;
+        return false;
     }
+    Logger::out("-") << "solving the binary program done. " << w.elapsed() << " sec" << std::endl;
+
+    const std::vector<double>& X = solver.solution();
+    flip.resize(X.size());
+    for (std::size_t i = 0; i < X.size(); ++i)
+        flip[i] = static_cast<int>(std::round(X[i])) == 1;
+    return true;
 }
@@ -25,17 +25,20 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../math/math_types.h"
 #include "../math/linear_program.h"
 #include "../math/linear_program_solver.h"
+#include "../math/linear_program_builder.h"
 #include "../model/map_attributes.h"
 
 
 #include <vector>
 #include <string>
 #include <map>
+#include <functional>
 
 
 class Map;
 class PointSet;
 class VertexGroup;
+class ReconstructionContext;
 
 namespace MapTypes {
 	class Vertex;
@@ -47,29 +50,254 @@ namespace MapTypes {
 // to determine if a face should be selected or not
 class METHOD_API FaceSelection
 {
+public:
+	// the weights of the terms of the objective (see Method::lambda_*)
+	struct Weights {
+		Weights(double fitting, double coverage, double complexity) : data_fitting(fitting), model_coverage(coverage), model_complexity(complexity) {}
+
+		double data_fitting;
+		double model_coverage;
+		double model_complexity;
+	};
+
 public:
 	FaceSelection(PointSet* pset, Map* model);
 	~FaceSelection() {}
 
 	virtual void optimize(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name);
 
+	// By default, the faces that are not selected are erased from the model. If the candidates are kept,
+	// the model is not changed and only the selection is recorded (a view on the candidate faces), which
+	// selected_model() copies out. The selection can then be re-run on the same candidates (e.g., with
+	// other weights) without duplicating them each time.
+	void set_keep_candidates(bool b) { keep_candidates_ = b; }
+
+	// the time limit (in seconds) of the solves of this selection, overriding Method::selection_time_limit
+	// (negative for the option, 0 for no limit)
+	void set_time_limit(double seconds) { time_limit_ = seconds; }
+
+	// Solves in the environment of "session" (see SolverSession), e.g., one kept by a worker across the
+	// tiles of a batch. The solves running concurrently (see Method::parallel_face_selection) don't use
+	// it. Null (the default) means no session.
+	void set_session(SolverSession* session) { session_ = session; }
+
+	// Takes the weights, the time limit, the thread budget, and the session (unless set above) from 
+	// "context" (see ReconstructionContext) instead of the options, e.g., for a run among several 
+	// concurrent ones with other weights. The context must outlive the selection. Null (the default)
+	// means the options.
+	void set_context(const ReconstructionContext* context) { context_ = context; }
+
+	// Called with each improving selection found while solving (e.g., to show the best one so far), as a
+	// solution of the whole program (see selected_model()). The decomposed solve reports the start with
+	// the components solved so far, at most twice a second. The Lagrangian solve reports its improving
+	// repaired selections, and the approximate solve reports nothing.
+	// NOTE: it is called from within the solver (which may run in a worker thread) and must not throw.
+	typedef std::function<void(const std::vector<double>& X)> IncumbentCallback;
+	void set_incumbent_callback(const IncumbentCallback& callback) { incumbent_callback_ = callback; }
+
+	// Called with the progress of the search (the nodes explored, the incumbent and the bound), as often 
+	// as the solver reports it (see LinearProgramSolver::SolverOptions::progress_callback), e.g., to plot
+	// how the gap closes. The solve of several independent components, the approximate and the Lagrangian 
+	// solves report nothing.
+	// NOTE: it is called from within the solver (which may run in a worker thread) and must not throw.
+	typedef std::function<void(const LinearProgramSolver::SearchProgress& progress)> SearchCallback;
+	void set_search_callback(const SearchCallback& callback) { search_callback_ = callback; }
+
+	// Solves the independent components of the decomposed solve (see Method::decompose_face_selection)
+	// elsewhere, e.g., on other machines (see WorkUnit): the dispatcher is given the components as 
+	// programs of their own (with the time limit of the selection) and fills in their solutions (empty
+	// for the failed ones). Returns false if it can't dispatch them. Null (the default) solves here.
+	typedef std::function<bool(const std::vector<const LinearProgram*>& components, double time_limit, std::vector< std::vector<double> >& solutions)> ComponentDispatcher;
+	void set_component_dispatcher(const ComponentDispatcher& dispatcher) { component_dispatcher_ = dispatcher; }
+
+	// Starts the solvers from the selection of the faces "selected" (indexed in the order of the faces of the
+	// model), e.g., the one of a previous run on partly regenerated candidate faces. It is repaired into a
+	// valid solution of the program first (e.g., dropping the faces whose super edges became invalid).
+	// An empty selection (the default) means no such start.
+	void set_start_selection(const std::vector<char>& selected) { start_selection_ = selected; }
+
+	// the solution of the last successful solve (empty if none): the faces are its first variables, in the 
+	// order of the faces of the model
+	const std::vector<double>& solution() const { return solution_; }
+
+	// true if the last solve gave up before launching the solver, the memory of the points, the candidate
+	// faces, and the binary program exceeding Method::memory_budget (the model is then unchanged)
+	bool memory_budget_exceeded() const { return memory_budget_exceeded_; }
+
+	// Returns a new mesh (to be deleted by the caller) with the faces of the model selected by the last
+	// solve and its sharp edges marked, or null if there is no selection. Only for kept candidates.
+	Map* selected_model(const HypothesisGenerator::Adjacency& adjacency) const;
+
+	// the same for a solution "X" reported to the incumbent callback
+	Map* selected_model(const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) const;
+
+	// Re-optimizes after the weights (i.e., Method::lambda_*) have changed. The variables and the
+	// constraints formulated by the last optimize() are kept, only the objective is rewritten, and
+	// the previous selection is given to the solver as a starting point.
+	// NOTE: "model" must be the candidate faces optimize() worked on (if they were kept) or another
+	//       copy of them (e.g., a new duplicate of the hypothesis mesh), and "adjacency" must be 
+	//       extracted from it. Returns false if the program can't be reused, in which case optimize() 
+	//       should be called instead. 
+	virtual bool re_optimize(Map* model, const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name);
+
+	// returns true if the program of the last optimize() can be reused for the model
+	bool can_re_optimize(Map* model, const HypothesisGenerator::Adjacency& adjacency) const;
+
+	// Solves the program of the last optimize() for each of the weights (e.g., a grid of them), 
+	// concurrently with SCIP and LPSOLVE. The program is shared read-only, each configuration only 
+	// writes its own objective into its own solver. "solutions" receives a selection per configuration
+	// (empty if it failed). Returns false if there is no program to reuse (e.g., it was streamed).
+	// NOTE: neither the model nor the weights of this selection (i.e., Method::lambda_*) change.
+	bool solve_weights(const std::vector<Weights>& weights, LinearProgramSolver::SolverName solver_name, std::vector< std::vector<double> >& solutions);
+
+	// Does solve_weights() and returns the results as new meshes (to be deleted by the caller, null for the
+	// failed configurations) with the faces of "hypothesis" selected by each configuration.
+	// NOTE: "hypothesis" must be the candidate faces optimize() worked on (see re_optimize()), and 
+	//       "generator" the one that generated them.
+	std::vector<Map*> optimize_weights(HypothesisGenerator* generator, Map* hypothesis, const std::vector<Weights>& weights, LinearProgramSolver::SolverName solver_name);
+
     // NOTE: the adjacency is the one extracted after the face optimization step
     virtual void re_orient(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name);
 
+    // the same for another model, e.g., the one returned by selected_model()
+    void re_orient(Map* model, const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name) const;
+
+private:
+	// The branching hints of the variables of a program (see LinearProgramSolver::set_variable_hints()), 
+	// the priorities as reals so that they are reduced with the program like a solution (see BinaryPresolve
+	// and FanContraction). Empty means no hints.
+	struct VariableHints {
+		std::vector<double> values;
+		std::vector<double> priorities;
+
+		bool empty() const { return values.empty(); }
+		// the hints of the variables of "indices" (e.g., of a component)
+		VariableHints subset(const std::vector<std::size_t>& indices) const;
+		// hands them over to "solver" (nothing if empty)
+		void apply(LinearProgramSolver& solver) const;
+	};
+
+	// formulates the variables, the objective, and the constraints with "builder"
+	void formulate(const HypothesisGenerator::Adjacency& adjacency, LinearProgramBuilder& builder);
+
+	// writes the objective terms for the weights
+	void write_objective(const Weights& weights, LinearProgramBuilder& builder) const;
+
+	// (re)writes the objective of program_ using the current weights
+	void update_objective();
+
+	// solves program_ and erases the faces of model_ that are not selected
+	void solve(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name, bool warm_start);
+
+	// Splits the program into its independent components (the constraints are posed per super edge, so 
+	// the components are the groups of faces connected by super edges) and solves them separately.
+	// "start" is an optional starting point. The solution of the whole program is returned in "X". 
+	// Returns false if a component fails. With "parallel", the components are solved concurrently 
+	// (only by SCIP and LPSOLVE, see Method::parallel_face_selection).
+	// "hints" (if not empty) guide the branching of the solvers. "report" (if any) receives the 
+	// improving solutions of "program".
+	bool solve_components(const LinearProgram& program, LinearProgramSolver::SolverName solver_name, bool parallel, const std::vector<double>& start, const VariableHints& hints, std::vector<double>& X, const IncumbentCallback& report) const;
+
+	// Solves the LP relaxation of program_ and rounds its solution to a valid selection "X", which is
+	// optionally polished by a short search of the solver. The gap to the LP bound is logged.
+	bool solve_approximately(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name, std::vector<double>& X) const;
+
+	// Improves a valid selection "X" of program_ by large neighborhood search (see Method::neighborhood_search):
+	// the sub-program of a neighborhood of faces, with the other variables fixed, is solved and its result
+	// kept if it improves the objective, until the time is up or no neighborhood improves.
+	void search_neighborhoods(const HypothesisGenerator::Adjacency& adjacency, LinearProgramSolver::SolverName solver_name, std::vector<double>& X) const;
+
+	// Relaxes the constraints of the super edges with Lagrange multipliers (see Method::lagrangian_face_selection)
+	// and repairs the relaxed selections into a valid one "X". The gap to the Lagrangian bound is logged.
+	bool solve_lagrangian(const HypothesisGenerator::Adjacency& adjacency, std::vector<double>& X) const;
+
+	// Labels the cells of the arrangement of the planes inside or outside by a minimum s-t cut (see
+	// Method::graph_cut_selection), and selects the faces between the cells of different labels.
+	bool solve_graph_cut(const HypothesisGenerator::Adjacency& adjacency, const Weights& weights, std::vector<double>& X) const;
+
+	// The hints of the solvers on the variables of program_ (see LinearProgramSolver::set_variable_hints()
+	// and Method::selection_variable_hints): the faces well supported and covered by the points are likely
+	// selected and branched on first (the better, the earlier), and the faces without support are likely
+	// not selected.
+	void variable_hints(VariableHints& hints) const;
+
+	// Builds a closed surface from the most confident faces by growing it across the super edges. The 
+	// result is a valid solution of program_ (empty if none was found), used as a start by the solvers.
+	std::vector<double> greedy_selection(const HypothesisGenerator::Adjacency& adjacency) const;
+
+	// Rounds the faces by their "scores" (in [0, 1]) and repairs the super edges until each one has 0 or 2
+	// selected faces. "selected" receives a selection satisfying the fan constraints.
+	void repair_selection(const HypothesisGenerator::Adjacency& adjacency, const std::vector<std::size_t>& fan_start, const std::vector< std::vector<std::size_t> >& face_fans, const std::vector<double>& scores, std::vector<char>& selected) const;
+
+	// the position of the first face of each super edge in fan_facets_, and the super edges of each face
+	void fan_structure(const HypothesisGenerator::Adjacency& adjacency, std::vector<std::size_t>& fan_start, std::vector< std::vector<std::size_t> >& face_fans) const;
+
+	// Gives the solution "X" of program_ that selects the faces "selected". Returns false if it violates
+	// a constraint.
+	bool complete_selection(const HypothesisGenerator::Adjacency& adjacency, const std::vector<std::size_t>& fan_start, const std::vector<char>& selected, std::vector<double>& X) const;
+
+	// keeps the solution "X" and erases the faces of model_ that are not selected (unless the candidates are kept)
+	void apply_solution(const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X);
+
+	// Labels the faces of model_ to flip for a consistent orientation (with as few flips as possible), 
+	// by propagating the relative orientations across the edges. Returns false if they conflict.
+	bool propagate_orientation(const HypothesisGenerator::Adjacency& adjacency, MapFacetAttribute<std::size_t>& facet_indices, std::size_t num_faces, std::vector<char>& flip) const;
+
+	// the same by solving a binary program (for the inputs the propagation fails on)
+	bool solve_orientation(Map* model, const HypothesisGenerator::Adjacency& adjacency, MapFacetAttribute<std::size_t>& facet_indices, LinearProgramSolver::SolverName solver_name, std::vector<char>& flip) const;
+
+	// erases the faces of "model" that are not selected by "X" and marks its sharp edges
+	void apply_selection(Map* model, const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) const;
+
+	// the same by rebuilding "model" at once from the selected faces (see Method::bulk_selection_extraction)
+	void rebuild_selection(Map* model, const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X, MapFacetAttribute<std::size_t>& facet_indices) const;
+
+	// the same without changing "candidates": copies the selected faces into a new mesh
+	Map* extract_selection(Map* candidates, const HypothesisGenerator::Adjacency& adjacency, const std::vector<double>& X) const;
+
+	// the time limit of the solves (see set_time_limit())
+	double time_limit() const;
+	// the weights of the objective, the session of the solves, and the thread budget the public functions
+	// run with, of the context if any (see set_context())
+	Weights current_weights() const;
+	SolverSession* session() const;
+	unsigned int thread_budget() const;
+
 private:
 	PointSet* pset_;
 	Map*      model_;
+	bool      keep_candidates_;
+	double    time_limit_;
+	SolverSession* session_;
+	const ReconstructionContext* context_;
+	bool	  memory_budget_exceeded_;
+
+	IncumbentCallback incumbent_callback_;
+	SearchCallback	  search_callback_;
+	ComponentDispatcher component_dispatcher_;
 
 	LinearProgram	program_;
 
+	// the weight-independent parts of the program, kept for re-optimization
+	std::vector<double>			facet_point_num_;		// indexed by faces
+	std::vector<double>			facet_uncovered_area_;	// indexed by faces
+	std::vector<double>			facet_coverage_ratio_;	// indexed by faces, the covered part of the area
+	std::vector<std::size_t>	edge_usage_status_;		// indexed by super edges
+	std::vector<std::size_t>	edge_sharp_status_;		// indexed by super edges
+	std::vector<std::size_t>	fan_facets_;			// the faces of all super edges, in order
+	double						total_points_;
+	double						bbox_area_;
+	std::vector<double>			solution_;				// of the last successful solve
+	std::vector<char>			start_selection_;		// indexed by faces (see set_start_selection())
+
 	MapFacetAttribute<VertexGroup*> facet_attrib_supporting_vertex_group_;
 	MapFacetAttribute<double>		facet_attrib_supporting_point_num_;
 	MapFacetAttribute<double>		facet_attrib_facet_area_;
 	MapFacetAttribute<double>		facet_attrib_covered_area_;
 
 	MapFacetAttribute<Plane3d*>					facet_attrib_supporting_plane_;
-	MapVertexAttribute< std::set<Plane3d*> >	vertex_source_planes_;
-	MapHalfedgeAttribute< std::set<Plane3d*> >	edge_source_planes_;
+	MapVertexAttribute< PlaneIdSet<3> >		vertex_source_planes_;
+	MapHalfedgeAttribute< PlaneIdSet<2> >		edge_source_planes_;
 };
 
 #endif
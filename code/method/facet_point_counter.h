@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _FACET_POINT_COUNTER_H_
+#define _FACET_POINT_COUNTER_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+
+#include <string>
+#include <vector>
+
+
+// A device (e.g., a GPU) that counts the supporting points of the candidate faces in bulk, instead of
+// HypothesisGenerator::facet_points_projected_in() face by face. The points of a segment and the faces 
+// on its plane are given in the 2D frame of the plane, and only the sums per face are returned. The 
+// application registers its counter (see set_instance()), e.g., once it has an OpenGL context.
+class METHOD_API FacetPointCounter
+{
+public:
+	virtual ~FacetPointCounter() {}
+
+	virtual std::string name() const = 0;
+
+	// For each polygon k (its corners are corners[offsets[k], offsets[k + 1])), computes the sums of 
+	// the 'values' of the 'points' inside it. Returns false on failure, and the caller then counts 
+	// the points itself.
+	virtual bool sum_points_in_polygons(
+		const std::vector<vec2>& points, const std::vector<vec2>& values,
+		const std::vector<vec2>& corners, const std::vector<unsigned int>& offsets,
+		std::vector<vec2>& sums
+	) = 0;
+
+	// the counter used by HypothesisGenerator::compute_confidences() (see Method::device_point_counting),
+	// nil if none (the counter is not owned)
+	static FacetPointCounter* instance() { return instance_; }
+	static void set_instance(FacetPointCounter* counter) { instance_ = counter; }
+
+private:
+	static FacetPointCounter* instance_;
+};
+
+#endif
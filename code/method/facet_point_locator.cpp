@@ -0,0 +1,159 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "facet_point_locator.h"
+#include "segment_projection.h"
+#include "../model/vertex_group.h"
+#include "../model/point_set.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+	// the maximum number of cells along each axis
+	const double max_resolution = 1024.0;
+}
+
+
+void FacetPointLocator::build(const std::vector<const Polygon2d*>& faces) {
+	classifiers_.clear();
+	boxes_.assign(faces.size(), Box2d());
+	cell_start_.clear();
+	entries_.clear();
+	nx_ = ny_ = 0;
+
+	Box2d box;
+	double area = 0.0;
+	classifiers_.reserve(faces.size());
+	for (std::size_t k = 0; k < faces.size(); ++k) {
+		const Polygon2d& plg = *faces[k];
+		classifiers_.push_back(Geom::PolygonClassifier(plg));
+		if (plg.size() < 3)
+			continue;	// never contains a point (the box is not initialized)
+		for (std::size_t i = 0; i < plg.size(); ++i)
+			boxes_[k].add_point(plg[i]);
+		box.add_point(vec2(boxes_[k].x_min(), boxes_[k].y_min()));
+		box.add_point(vec2(boxes_[k].x_max(), boxes_[k].y_max()));
+		area += double(boxes_[k].width()) * boxes_[k].height();
+	}
+	if (!box.initialized())
+		return;
+
+	// the cells are about the average size of the faces
+	double w = double(box.x_max()) - box.x_min();
+	double h = double(box.y_max()) - box.y_min();
+	double extent = std::max(w, h);
+	if (extent <= 0)
+		cell_size_ = 1.0;
+	else
+		cell_size_ = std::max(std::sqrt(area / faces.size()), extent / max_resolution);
+
+	origin_ = vec2(box.x_min(), box.y_min());
+	nx_ = static_cast<int>(w / cell_size_) + 1;
+	ny_ = static_cast<int>(h / cell_size_) + 1;
+
+	// the faces of each cell, in increasing order (two passes: counting, then filling)
+	cell_start_.assign(std::size_t(nx_) * ny_ + 1, 0);
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<unsigned int> next;
+		if (pass == 1) {
+			for (std::size_t c = 1; c < cell_start_.size(); ++c)
+				cell_start_[c] += cell_start_[c - 1];
+			entries_.resize(cell_start_.back());
+			next.assign(cell_start_.begin(), cell_start_.end() - 1);
+		}
+		for (std::size_t k = 0; k < boxes_.size(); ++k) {
+			const Box2d& b = boxes_[k];
+			if (!b.initialized())
+				continue;
+			int x_min = std::min(static_cast<int>((b.x_min() - origin_.x) / cell_size_), nx_ - 1);
+			int y_min = std::min(static_cast<int>((b.y_min() - origin_.y) / cell_size_), ny_ - 1);
+			int x_max = std::min(static_cast<int>((b.x_max() - origin_.x) / cell_size_), nx_ - 1);
+			int y_max = std::min(static_cast<int>((b.y_max() - origin_.y) / cell_size_), ny_ - 1);
+			for (int iy = y_min; iy <= y_max; ++iy) {
+				for (int ix = x_min; ix <= x_max; ++ix) {
+					std::size_t c = std::size_t(iy) * nx_ + ix;
+					if (pass == 0)
+						++cell_start_[c + 1];
+					else
+						entries_[next[c]++] = static_cast<unsigned int>(k);
+				}
+			}
+		}
+	}
+}
+
+
+void FacetPointLocator::locate(const VertexGroup* g, float max_dist, std::vector<float>& counts, std::vector< std::vector<unsigned int> >& points) const {
+	counts.assign(classifiers_.size(), 0.0f);
+	points.assign(classifiers_.size(), std::vector<unsigned int>());
+	const PointSet* pset = g->point_set();
+	if (!pset || g->empty() || nx_ == 0)
+		return;
+
+	const Plane3d& plane = g->plane();
+	const vec3& orig = plane.point();
+	const vec3& base1 = plane.base1();
+	const vec3& base2 = plane.base2();
+	const std::vector<vec3>& pts = pset->points();
+	const std::vector<float>& confidences = pset->planar_qualities();
+	const bool weighted = pset->has_weights();
+	const std::vector<float>& weights = pset->weights();
+
+	// the distances of all the points in one batch (or those of the projection kept with the segment)
+	const VertexGroup::Projection* projection = SegmentProjection::of(g);
+	std::vector<float> computed;
+	if (!projection) {
+		computed.resize(g->size());
+		if (const float* padded = pset->padded_points())
+			plane.signed_distances_padded(padded, g->data(), g->size(), computed.data());
+		else
+			plane.signed_distances(pts.data(), g->data(), g->size(), computed.data());
+	}
+	const std::vector<float>& distances = projection ? projection->distances : computed;
+
+	const float epsilon = max_dist * 0.5f;	// as in HypothesisGenerator::facet_points_projected_in()
+	for (std::size_t i = 0; i < g->size(); ++i) {
+		unsigned int idx = g->at(i);
+		vec2 p = projection ? projection->points[i] : Geom::to_2d(orig, base1, base2, pts[idx]);
+		double x = (double(p.x) - origin_.x) / cell_size_;
+		double y = (double(p.y) - origin_.y) / cell_size_;
+		if (x < 0 || y < 0)
+			continue;
+		int ix = static_cast<int>(x), iy = static_cast<int>(y);
+		if (ix >= nx_ || iy >= ny_)
+			continue;
+
+		std::size_t c = std::size_t(iy) * nx_ + ix;
+		for (unsigned int e = cell_start_[c]; e < cell_start_[c + 1]; ++e) {
+			unsigned int k = entries_[e];
+			const Box2d& b = boxes_[k];
+			if (p.x < b.x_min() || p.x > b.x_max() || p.y < b.y_min() || p.y > b.y_max())
+				continue;
+			if (!classifiers_[k].contains(p))
+				continue;
+			points[k].push_back(idx);
+			float dist = std::abs(distances[i]);
+			if (dist < epsilon) // in case of numerical issues (floating point precision)
+				counts[k] += (1 - dist / epsilon) * confidences[idx] * (weighted ? weights[idx] : 1.0f);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _FACET_POINT_LOCATOR_H_
+#define _FACET_POINT_LOCATOR_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+#include "../math/polygon2d.h"
+
+#include <vector>
+
+
+class VertexGroup;
+
+// Locates the points of a segment (i.e., a VertexGroup), projected onto its supporting plane, in the 
+// candidate faces on that plane, in a single pass over the points. The faces are sorted into a uniform
+// 2D grid by their bounding boxes, and each point is only classified against the faces whose box 
+// overlaps its cell. This inverts HypothesisGenerator::facet_points_projected_in(), which visits the 
+// points (or the grid cells of the points) of the segment again for each face.
+class METHOD_API FacetPointLocator
+{
+public:
+	FacetPointLocator() : cell_size_(1.0), nx_(0), ny_(0) {}
+
+	// the faces, by their polygons in the base1/base2 frame of the plane of the segment
+	void build(const std::vector<const Polygon2d*>& faces);
+
+	// Locates the points of 'g' in the faces: points[k] receives the points (in the order of the group)
+	// projected in face k, and counts[k] the sum of their weighted confidences, computed as in 
+	// HypothesisGenerator::facet_points_projected_in().
+	void locate(const VertexGroup* g, float max_dist, std::vector<float>& counts, std::vector< std::vector<unsigned int> >& points) const;
+
+private:
+	vec2								origin_;		// the lower corner of the grid
+	double								cell_size_;
+	int									nx_, ny_;
+	std::vector<Geom::PolygonClassifier> classifiers_;	// of the faces
+	std::vector<Box2d>					boxes_;
+	std::vector<unsigned int>			cell_start_;	// the faces of cell c are entries_[cell_start_[c], cell_start_[c+1])
+	std::vector<unsigned int>			entries_;
+};
+
+#endif
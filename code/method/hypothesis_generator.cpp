@@ -22,11 +22,36 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "alpha_shape.h"
 #include "method_global.h"
 #include "alpha_shape_mesh.h"
+#include "box_tree.h"
+#include "segment_point_grid.h"
+#include "segment_projection.h"
+#include "reconstruction_context.h"
+#include "facet_point_locator.h"
+#include "stratified_sample.h"
+#include "plane_predicates.h"
+#include "vertex_registry.h"
+#include "plane_arrangement.h"
+#include "implicit_hypothesis.h"
+#include "alpha_shape_coverage.h"
+#include "facet_point_counter.h"
+#include "point_quality_estimator.h"
+#include "raster_coverage.h"
+#include "occupancy_grid.h"
+#include "segment_footprint.h"
 #include "../basic/progress.h"
 #include "../basic/logger.h"
 #include "../basic/assertions.h"
 #include "../basic/stop_watch.h"
+#include "../basic/profiler.h"
+#include "../basic/tracer.h"
+#include "../basic/instrumentation.h"
+#include "../basic/parallel.h"
+#include "../math/linear_program.h"
+#include "../math/plane_fitting.h"
 #include "../model/vertex_group.h"
+#include "../model/group_table.h"
+#include "../model/point_set_downsampler.h"
+#include "../model/point_set_normals.h"
 #include "../model/point_set.h"
 #include "../model/iterators.h"
 #include "../model/map.h"
@@ -34,12 +59,19 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../model/map_editor.h"
 #include "../model/map_circulators.h"
 #include "../model/map_geometry.h"
+#include "../model/map_geometry_cache.h"
+#include "../model/frozen_map.h"
+#include "../model/compact_mesh.h"
 #include "../model/kdtree_search.h"
 
 #include <CGAL/convex_hull_2.h>
 #include <CGAL/Projection_traits_xy_3.h>
 
 #include <algorithm>
+#include <numeric>
+#include <limits>
+#include <fstream>
+#include <sstream>
 
 
 
@@ -48,34 +80,65 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 //#define DISPLAY_ADJACENCY_STATISTICS
 
 
+// the events of the hot loops (see Instrumentation)
+namespace {
+	EventCounter num_cut_calls("cut() calls");
+	EventCounter num_split_edge_calls("split_edge() calls");
+	EventCounter num_triplet_hits("triplet intersection hits");
+	EventCounter num_triplet_misses("triplet intersection misses");
+	EventCounter num_dropped_cutters("cutters dropped by the pieces");
+	EventCounter num_sliver_cuts("sliver cuts skipped");
+	EventCounter num_snapped_intersections("intersections snapped to edge ends");
+}
+
+
+namespace {
+
+	// 64-bit FNV-1a hash of the inputs of the confidences (see HypothesisGenerator::outdated_facets())
+	class FNVHash {
+	public:
+		FNVHash() : h_(14695981039346656037ULL) {}
+
+		void add_bytes(const void* data, std::size_t size) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (std::size_t i = 0; i < size; ++i)
+				h_ = (h_ ^ bytes[i]) * 1099511628211ULL;
+		}
+		template <typename T>
+		void add(const T& value) { add_bytes(&value, sizeof(T)); }
+
+		Numeric::uint64 value() const { return h_; }
+
+	private:
+		Numeric::uint64 h_;
+	};
+
+}
+
+
 HypothesisGenerator::HypothesisGenerator(PointSet* pset)
 	: pset_(pset)
+	, keep_planes_(false)
+	, context_(nil)
+	, min_piece_width_(0.0)
+	, confidence_max_dist_(0.0f)
+	, confidence_radius_(0.0f)
+	, use_confidence_(false)
 {
 }
 
 
+unsigned int HypothesisGenerator::thread_budget() const {
+	return context_ ? context_->thread_budget() : parallel_thread_budget();
+}
+
+
 HypothesisGenerator::~HypothesisGenerator()
 {
 	clear();
 }
 
 
-static std::list<unsigned int> points_on_plane(VertexGroup* g, const Plane3d& plane, float dist_threshold) {
-	std::list<unsigned int> result;
-
-	const std::vector<vec3>& points = g->point_set()->points();
-	for (std::size_t i = 0; i < g->size(); ++i) {
-		int idx = g->at(i);
-		const vec3& p = points[idx];
-
-		float sdist = plane.squared_ditance(p);
-		float dist = std::sqrt(sdist);
-		if (dist < dist_threshold)
-			result.push_back(idx);
-	}
-	return result;
-}
-
 void HypothesisGenerator::merge(VertexGroup* g1, VertexGroup* g2) {
 	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
 	const std::vector<vec3>& points = pset_->points();
@@ -109,33 +172,211 @@ void HypothesisGenerator::merge(VertexGroup* g1, VertexGroup* g2) {
 }
 
 
-void HypothesisGenerator::refine_planes() {
+// the number of points of 'g' within 'dist_threshold' to 'plane'. It stops counting once 'max_count' is exceeded.
+static std::size_t num_points_on_plane(VertexGroup* g, const Plane3d& plane, float dist_threshold, std::size_t max_count) {
+	const PointSet* pset = g->point_set();
+	if (const float* padded = pset->padded_points())
+		return plane.count_within_padded(padded, g->data(), g->size(), dist_threshold, max_count);
+	return plane.count_within(pset->points().data(), g->data(), g->size(), dist_threshold, max_count);
+}
+
+
+namespace {
+
+	class UnionFind {
+	public:
+		UnionFind(std::size_t n) : parent_(n) {
+			for (std::size_t i = 0; i < n; ++i)
+				parent_[i] = i;
+		}
+		std::size_t find(std::size_t i) {
+			while (parent_[i] != i) {
+				parent_[i] = parent_[parent_[i]];
+				i = parent_[i];
+			}
+			return i;
+		}
+		// the root of a set is always its smallest element
+		void unite(std::size_t i, std::size_t j) {
+			i = find(i);
+			j = find(j);
+			if (i < j)
+				parent_[j] = i;
+			else if (j < i)
+				parent_[i] = j;
+		}
+	private:
+		std::vector<std::size_t> parent_;
+	};
+
+
+	// Buckets unit normals in a uniform grid. The cells have the size of the chord of the angle threshold, so 
+	// all the normals within the angle threshold of a normal are in the 27 cells around it.
+	class NormalGrid {
+	public:
+		NormalGrid(float theta) : cell_size_(2.0f * std::sin(theta * 0.5f)) {}
+
+		void insert(const vec3& n, std::size_t idx) {
+			cells_[key(cell_coord(n.x), cell_coord(n.y), cell_coord(n.z))].push_back(idx);
+		}
+
+		// calls f(idx) for every normal in the cells around 'n'
+		template <class FUNCTION>
+		void for_each_neighbor(const vec3& n, FUNCTION& f) const {
+			int cx = cell_coord(n.x), cy = cell_coord(n.y), cz = cell_coord(n.z);
+			for (int x = cx - 1; x <= cx + 1; ++x) {
+				for (int y = cy - 1; y <= cy + 1; ++y) {
+					for (int z = cz - 1; z <= cz + 1; ++z) {
+						std::unordered_map<int, std::vector<std::size_t> >::const_iterator pos = cells_.find(key(x, y, z));
+						if (pos == cells_.end())
+							continue;
+						const std::vector<std::size_t>& indices = pos->second;
+						for (std::size_t i = 0; i < indices.size(); ++i)
+							f(indices[i]);
+					}
+				}
+			}
+		}
+
+	private:
+		int cell_coord(float v) const { return static_cast<int>(std::floor((v + 1.0f) / cell_size_)); }
+		static int key(int x, int y, int z) { return ((x + 1) * 1024 + (y + 1)) * 1024 + (z + 1); }
+
+	private:
+		float cell_size_;
+		std::unordered_map<int, std::vector<std::size_t> > cells_;
+	};
+
+}
+
+
+void HypothesisGenerator::merge_planes(float dist_threshold, float theta) {
+	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	const float cos_theta = std::cos(theta);
+
+	bool merged = false;
+	do
+	{
+		merged = false;
+		std::sort(groups.begin(), groups.end(), VertexGroupCmpIncreasing());
+
+		NormalGrid grid(theta);
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			grid.insert(groups[i]->plane().normal(), i);
+
+		// all the merges of this round are collected first (the planes are refit after that)
+		UnionFind components(groups.size());
+		std::vector<std::size_t> last_tested(groups.size(), groups.size());
+		for (std::size_t i = 0; i < groups.size(); ++i) {
+			VertexGroup* g1 = groups[i];
+			const Plane3d& plane1 = g1->plane();
+			const vec3& n1 = plane1.normal();
+			float num_threshold = g1->size() / 5.0f;
+			std::size_t max_count = static_cast<std::size_t>(num_threshold);
+
+			// the smaller group (i.e., g1, which has the smaller index) decides the threshold
+			auto test = [&](std::size_t j) {
+				if (j <= i || last_tested[j] == i)
+					return;
+				last_tested[j] = i;
+				if (components.find(i) == components.find(j))
+					return;
+
+				VertexGroup* g2 = groups[j];
+				const Plane3d& plane2 = g2->plane();
+				if (std::abs(dot(n1, plane2.normal())) > cos_theta) {
+					if (num_points_on_plane(g1, plane2, dist_threshold, max_count) > num_threshold ||
+						num_points_on_plane(g2, plane1, dist_threshold, max_count) > num_threshold)
+					{
+						components.unite(i, j);
+						merged = true;
+					}
+				}
+			};
+			// two planes are nearly parallel if their normals (in either orientation) are close
+			grid.for_each_neighbor(n1, test);
+			grid.for_each_neighbor(-n1, test);
+		}
+
+		if (!merged)
+			break;
+
+		// the members of each component, in increasing order of their sizes
+		std::map<std::size_t, std::vector<std::size_t> > members;
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			members[components.find(i)].push_back(i);
+
+		std::vector<VertexGroup::Ptr> new_groups;
+		std::map<std::size_t, std::vector<std::size_t> >::const_iterator pos = members.begin();
+		for (; pos != members.end(); ++pos) {
+			const std::vector<std::size_t>& indices = pos->second;
+			if (indices.size() == 1) {
+				new_groups.push_back(groups[indices[0]]);
+				continue;
+			}
+
+			VertexGroup::Ptr g = new VertexGroup;
+			g->set_point_set(pset_);
+			Color color = groups[indices[0]]->color();
+			float weight = 0.0f;
+			for (std::size_t k = 0; k < indices.size(); ++k) {
+				VertexGroup* member = groups[indices[k]];
+				g->insert(g->end(), member->begin(), member->end());
+				float w = static_cast<float>(member->size());
+				if (k > 0)
+					color = fused_color(color, weight, member->color(), w);
+				weight += w;
+			}
+			g->set_color(color);
+			pset_->fit_plane(g);
+			new_groups.push_back(g);
+		}
+		groups.swap(new_groups);
+	} while (merged);
+}
+
+
+void HypothesisGenerator::refine_planes(float angle, float distance_factor) {
+	ScopedThreadBudget budget(thread_budget());
+	ProfileStage stage("refine_planes");
+
 	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
 	const std::vector<vec3>& points = pset_->points();
+	if (Method::padded_point_kernels)	// for the tests of the merges
+		pset_->update_padded_points();
 
 	std::size_t num = groups.size();
 
+	// the planes are fitted in one batch (each group by one thread), the distances are summed in order
+	GroupTable table(groups);
+	table.fit_planes(points, 0, table.num_top_level(), Method::num_threads);
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		groups[i]->set_plane(table.plane(i));
+	std::vector<float> max_dists(groups.size(), -FLT_MAX);
+	parallel_for(groups.size(), [&](std::size_t i) {
+		if (table.num_points(i) > 0)
+			max_dists[i] = std::sqrt(table.max_squared_distance(i, points));
+	});
+
 	float avg_max_dist = 0;
-	for (std::size_t i = 0; i < groups.size(); ++i) {
-		VertexGroup* g = groups[i];
-		pset_->fit_plane(g);
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		avg_max_dist += max_dists[i];
+	avg_max_dist /= groups.size();
+	avg_max_dist *= distance_factor;
 
-		float g_max_dist = -FLT_MAX;
-		const Plane3d& plane = g->plane();
-		for (std::size_t j = 0; j < g->size(); ++j) {
-			int idx = g->at(j);
-			const vec3& p = points[idx];
-			float sdist = plane.squared_ditance(p);
-			g_max_dist = std::max(g_max_dist, std::sqrt(sdist));
-		}
+	float theta = static_cast<float>(M_PI * angle / 180.0f);	// in radian
 
-		avg_max_dist += g_max_dist;
+	if (Method::fast_plane_merging) {
+		merge_planes(avg_max_dist, theta);
+		std::sort(groups.begin(), groups.end(), VertexGroupCmpDecreasing());
+		if (num - groups.size() > 0) {
+			Logger::out("-") << num - groups.size() << " planar segments merged" << std::endl;
+		}
+		Profiler::add_counter("segments merged", double(num - groups.size()));
+		apply_plane_budget();
+		return;
 	}
-	avg_max_dist /= groups.size();
-	avg_max_dist /= 2.0f;
 
-	float theta = 10.0f;				// in degree
-	theta = static_cast<float>(M_PI * theta / 180.0f);	// in radian
 	bool merged = false;
 	do
 	{
@@ -147,14 +388,14 @@ void HypothesisGenerator::refine_planes() {
 			const Plane3d& plane1 = g1->plane();
 			const vec3& n1 = plane1.normal();
 			float num_threshold = g1->size() / 5.0f;
+			std::size_t max_count = static_cast<std::size_t>(num_threshold);
 			for (std::size_t j = i + 1; j < groups.size(); ++j) {
 				VertexGroup* g2 = groups[j];
 				const Plane3d& plane2 = g2->plane();
 				const vec3& n2 = plane2.normal();
 				if (std::abs(dot(n1, n2)) > std::cos(theta)) {
-					const std::list<unsigned int>& set1on2 = points_on_plane(g1, plane2, avg_max_dist);
-					const std::list<unsigned int>& set2on1 = points_on_plane(g2, plane1, avg_max_dist);
-					if (set1on2.size() > num_threshold || set2on1.size() > num_threshold) {
+					if (num_points_on_plane(g1, plane2, avg_max_dist, max_count) > num_threshold ||
+						num_points_on_plane(g2, plane1, avg_max_dist, max_count) > num_threshold) {
 						merge(g1, g2);
 						merged = true;
 						break;
@@ -171,48 +412,323 @@ void HypothesisGenerator::refine_planes() {
 	if (num - groups.size() > 0) {
 		Logger::out("-") << num - groups.size() << " planar segments merged" << std::endl;
 	}
+	Profiler::add_counter("segments merged", double(num - groups.size()));
+	apply_plane_budget();
+}
+
+
+void HypothesisGenerator::apply_plane_budget() {
+	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	budget_report_ = BudgetReport();
+	budget_report_.num_segments = groups.size();
+	budget_report_.num_kept = groups.size();
+
+	bool limit_count = Method::max_planes > 0 && groups.size() > Method::max_planes;
+	bool limit_coverage = Method::plane_budget_coverage > 0.0 && Method::plane_budget_coverage < 1.0;
+	if (!limit_count && !limit_coverage)
+		return;
+
+	ProfileStage stage("plane_budget");
+
+	// the weighted number of points of each segment, and its score (the same times the mean planar quality)
+	const bool has_qualities = pset_->has_planar_qualities();
+	std::vector<double> weights(groups.size(), 0.0), scores(groups.size(), 0.0);
+	parallel_for(groups.size(), [&](std::size_t i) {
+		const VertexGroup* g = groups[i];
+		for (std::size_t k = 0; k < g->size(); ++k) {
+			double w = pset_->weight(g->at(k));
+			weights[i] += w;
+			scores[i] += has_qualities ? w * pset_->planar_qualities()[g->at(k)] : w;
+		}
+	}, nil, Method::num_threads);
+	double total_weight = 0.0;
+	for (std::size_t i = 0; i < weights.size(); ++i)
+		total_weight += weights[i];
+
+	std::vector<std::size_t> order(groups.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&scores](std::size_t a, std::size_t b) { return scores[a] > scores[b]; });
+
+	std::size_t num_kept = 0;
+	double kept_weight = 0.0;
+	while (num_kept < order.size()) {
+		if (limit_count && num_kept >= Method::max_planes)
+			break;
+		if (limit_coverage && num_kept > 0 && kept_weight >= Method::plane_budget_coverage * total_weight)
+			break;
+		kept_weight += weights[order[num_kept]];
+		++num_kept;
+	}
+	if (num_kept == groups.size())
+		return;
+
+	// a segment is absorbed by a kept one of nearly the same orientation if its points are closer to
+	// the plane of the latter than twice the mean RMS distance of the kept segments to their planes 
+	// (both using up to 64 points of the segments, evenly spread)
+	const std::size_t max_samples = 64;
+	const std::vector<vec3>& points = pset_->points();
+	auto mean_distance = [&](const VertexGroup* g, const Plane3d& plane, bool squared) {
+		std::size_t step = ogf_max<std::size_t>(1, g->size() / max_samples);
+		double sum = 0.0;
+		std::size_t n = 0;
+		for (std::size_t k = 0; k < g->size(); k += step, ++n) {
+			double d2 = plane.squared_ditance(points[g->at(k)]);
+			sum += squared ? d2 : std::sqrt(d2);
+		}
+		return n > 0 ? sum / n : 0.0;
+	};
+	double rms = 0.0;
+	for (std::size_t i = 0; i < num_kept; ++i) {
+		const VertexGroup* g = groups[order[i]];
+		rms += std::sqrt(mean_distance(g, g->plane(), true));
+	}
+	const double absorb_distance = 2.0 * rms / num_kept;
+	const double cos_theta = std::cos(M_PI * 10.0 / 180.0);
+
+	std::vector<int> target(order.size() - num_kept, -1);
+	parallel_for(target.size(), [&](std::size_t d) {
+		const VertexGroup* g = groups[order[num_kept + d]];
+		double best = absorb_distance;
+		for (std::size_t i = 0; i < num_kept; ++i) {
+			const Plane3d& plane = groups[order[i]]->plane();
+			if (std::abs(dot(plane.normal(), g->plane().normal())) < cos_theta)
+				continue;
+			double dist = mean_distance(g, plane, false);
+			if (dist < best) {
+				best = dist;
+				target[d] = static_cast<int>(order[i]);
+			}
+		}
+	}, nil, Method::num_threads);
+
+	std::vector<char> kept(groups.size(), 0), refit(groups.size(), 0);
+	for (std::size_t i = 0; i < num_kept; ++i)
+		kept[order[i]] = 1;
+	for (std::size_t d = 0; d < target.size(); ++d) {
+		VertexGroup* g = groups[order[num_kept + d]];
+		std::pair<std::string, std::size_t> entry(g->label(), g->size());
+		if (target[d] >= 0) {
+			VertexGroup* host = groups[target[d]];
+			host->insert(host->end(), g->begin(), g->end());
+			refit[target[d]] = 1;
+			kept_weight += weights[order[num_kept + d]];
+			budget_report_.absorbed.push_back(entry);
+		}
+		else
+			budget_report_.dropped.push_back(entry);
+	}
+
+	std::vector<VertexGroup::Ptr> remaining;
+	remaining.reserve(num_kept);
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		if (!kept[i])
+			continue;
+		if (refit[i])
+			pset_->fit_plane(groups[i]);
+		remaining.push_back(std::move(groups[i]));
+	}
+	groups.swap(remaining);
+	pset_->notify_change();
+
+	budget_report_.num_kept = groups.size();
+	budget_report_.kept_fraction = total_weight > 0.0 ? kept_weight / total_weight : 1.0;
+	Logger::out("-") << "plane budget: kept " << groups.size() << " of " << budget_report_.num_segments << " segments ("
+		<< budget_report_.absorbed.size() << " absorbed, " << budget_report_.dropped.size() << " dropped), explaining "
+		<< 100.0 * budget_report_.kept_fraction << "% of the points" << std::endl;
+	if (!budget_report_.dropped.empty()) {
+		std::ostringstream dropped;
+		const std::size_t max_listed = 20;
+		for (std::size_t i = 0; i < budget_report_.dropped.size() && i < max_listed; ++i)
+			dropped << (i > 0 ? ", " : "") << budget_report_.dropped[i].first << " (" << budget_report_.dropped[i].second << " points)";
+		if (budget_report_.dropped.size() > max_listed)
+			dropped << ", ...";
+		Logger::out("-") << "dropped segments: " << dropped.str() << std::endl;
+	}
+	Profiler::add_counter("segments absorbed", double(budget_report_.absorbed.size()));
+	Profiler::add_counter("segments dropped", double(budget_report_.dropped.size()));
+}
+
+
+Plane3d* HypothesisGenerator::add_supporting_plane(const Plane3d& plane) {
+	plane_arena_.push_back(plane);
+	Plane3d* stored = &plane_arena_.back();
+	plane_index_[stored] = static_cast<unsigned int>(supporting_planes_.size());
+	supporting_planes_.push_back(stored);
+	return stored;
+}
+
+
+unsigned int HypothesisGenerator::plane_id(const Plane3d* plane) const {
+	std::unordered_map<const Plane3d*, unsigned int>::const_iterator pos = plane_index_.find(plane);
+	ogf_assert(pos != plane_index_.end());
+	return pos->second;
 }
 
 
 void HypothesisGenerator::collect_valid_planes() {
 	supporting_planes_.clear();
+	bbox_planes_.clear();
+	plane_index_.clear();
 	plane_segments_.clear();
 	vertex_group_plane_.clear();
+	snapped_segments_.clear();
 
 	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	if (!keep_planes_) {
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			pset_->fit_plane(groups[i]);
+		if (Method::plane_regularization_angle > 0.0)
+			regularize_planes(groups);
+	}
+
 	for (std::size_t i = 0; i < groups.size(); ++i) {
 		VertexGroup* g = groups[i];
-		pset_->fit_plane(g);
-
+		if (snapped_segments_.find(g) != snapped_segments_.end())
+			continue;
 		plane_segments_.push_back(g);
-		Plane3d* plane = new Plane3d(g->plane());
-		supporting_planes_.push_back(plane);
+		Plane3d* plane = add_supporting_plane(g->plane());
 		vertex_group_plane_[g] = plane;
 	}
+	std::map<VertexGroup*, VertexGroup*>::const_iterator it = snapped_segments_.begin();
+	for (; it != snapped_segments_.end(); ++it)
+		vertex_group_plane_[it->first] = vertex_group_plane_[it->second];
+}
+
+
+void HypothesisGenerator::regularize_planes(std::vector<VertexGroup::Ptr>& groups) {
+	ProfileStage stage("regularize_planes");
+	const std::vector<vec3>& points = pset_->points();
+	const std::size_t n = groups.size();
+
+	// the centroid of each segment and the largest distance of its points to its plane
+	std::vector<vec3> centroids(n);
+	std::vector<float> max_dists(n, 0.0f);
+	parallel_for(n, [&](std::size_t i) {
+		const VertexGroup* g = groups[i];
+		vec3 sum(0, 0, 0);
+		for (std::size_t k = 0; k < g->size(); ++k)
+			sum += points[g->at(k)];
+		centroids[i] = g->empty() ? sum : sum / static_cast<float>(g->size());
+		max_dists[i] = g->plane().max_distance(points.data(), g->data(), g->size());
+	}, nil, Method::num_threads);
+
+	float avg_max_dist = 0;
+	for (std::size_t i = 0; i < n; ++i)
+		avg_max_dist += max_dists[i];
+	const float dist_threshold = static_cast<float>(Method::plane_regularization_distance) * avg_max_dist / std::max<std::size_t>(n, 1);
+	const float theta = static_cast<float>(M_PI * Method::plane_regularization_angle / 180.0);
+	const float cos_theta = std::cos(theta);
+
+	// the tight pairs: nearly parallel planes, each one through the centroid of the other segment
+	auto tight = [&](const Plane3d& plane, std::size_t i, std::size_t j) -> bool {
+		return std::abs(dot(plane.normal(), groups[j]->plane().normal())) > cos_theta &&
+			plane.squared_ditance(centroids[j]) < dist_threshold * dist_threshold &&
+			groups[j]->plane().squared_ditance(centroids[i]) < dist_threshold * dist_threshold;
+	};
+	NormalGrid grid(theta);
+	for (std::size_t i = 0; i < n; ++i)
+		grid.insert(groups[i]->plane().normal(), i);
+	UnionFind components(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		const Plane3d& plane = groups[i]->plane();
+		auto test = [&](std::size_t j) {
+			if (j > i && !groups[i]->empty() && !groups[j]->empty() && tight(plane, i, j))
+				components.unite(i, j);
+		};
+		grid.for_each_neighbor(plane.normal(), test);
+		grid.for_each_neighbor(-plane.normal(), test);
+	}
+
+	std::map<std::size_t, std::vector<std::size_t> > clusters;
+	for (std::size_t i = 0; i < n; ++i)
+		clusters[components.find(i)].push_back(i);
+
+	// The chains of pairs may drift, so the members far from the plane of the whole cluster are left out
+	// (the plane is then fitted to the rest)
+	std::size_t num_snapped = 0;
+	std::map<std::size_t, std::vector<std::size_t> >::iterator pos = clusters.begin();
+	for (; pos != clusters.end(); ++pos) {
+		std::vector<std::size_t>& members = pos->second;
+		if (members.size() < 2)
+			continue;
+
+		Plane3d shared;
+		bool fitted = false;
+		for (int round = 0; round < 2 && members.size() >= 2; ++round) {
+			std::vector<unsigned int> indices;
+			for (std::size_t k = 0; k < members.size(); ++k) {
+				const VertexGroup* g = groups[members[k]];
+				indices.insert(indices.end(), g->begin(), g->end());
+			}
+			shared = PlaneFitting::fit(points, indices.data(), indices.size());
+
+			std::vector<std::size_t> kept;
+			for (std::size_t k = 0; k < members.size(); ++k) {
+				std::size_t i = members[k];
+				if (std::abs(dot(shared.normal(), groups[i]->plane().normal())) > cos_theta &&
+					shared.squared_ditance(centroids[i]) < dist_threshold * dist_threshold)
+					kept.push_back(i);
+			}
+			fitted = (kept.size() == members.size());
+			if (fitted)
+				break;
+			members.swap(kept);
+		}
+		if (!fitted)
+			continue;
+
+		// the largest segment carries the plane (the first one if several are as large)
+		std::size_t representative = members[0];
+		for (std::size_t k = 1; k < members.size(); ++k) {
+			if (groups[members[k]]->size() > groups[representative]->size())
+				representative = members[k];
+		}
+		for (std::size_t k = 0; k < members.size(); ++k) {
+			VertexGroup* g = groups[members[k]];
+			g->set_plane(shared);
+			if (members[k] != representative) {
+				snapped_segments_[g] = groups[representative];
+				++num_snapped;
+			}
+		}
+	}
+
+	if (num_snapped > 0)
+		Logger::out("-") << num_snapped << " planes snapped to the planes of nearly identical segments" << std::endl;
+	Profiler::add_counter("planes snapped", double(num_snapped));
+}
+
+
+void HypothesisGenerator::snapped_members(std::map<VertexGroup*, std::vector<VertexGroup*> >& members) const {
+	members.clear();
+	std::map<VertexGroup*, VertexGroup*>::const_iterator it = snapped_segments_.begin();
+	for (; it != snapped_segments_.end(); ++it)
+		members[it->second].push_back(it->first);
 }
 
 
 
 static void check_source_planes(Map* mesh) {
 	MapFacetAttribute<Plane3d*>					face_supporting_plane(mesh, "FacetSupportingPlane");
-	MapHalfedgeAttribute< std::set<Plane3d*> >	edge_source_planes(mesh, "EdgeSourcePlanes");
-	MapVertexAttribute< std::set<Plane3d*> >	vertex_source_planes(mesh, "VertexSourcePlanes");
+	MapHalfedgeAttribute< PlaneIdSet<2> >		edge_source_planes(mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >			vertex_source_planes(mesh, "VertexSourcePlanes");
 
 	FOR_EACH_FACET(Map, mesh, it) {
 		if (face_supporting_plane[it] == nil)
-			std::cerr << "fatal error: face_supporting_plane[it] == nil" << std::endl;
+			Logger::err("-") << "face_supporting_plane[it] == nil" << std::endl;
 	}
 
 	FOR_EACH_HALFEDGE(Map, mesh, it) {
-		const std::set<Plane3d*>& tmp = edge_source_planes[it];
+		const PlaneIdSet<2>& tmp = edge_source_planes[it];
 		if (tmp.size() != 2)
-			std::cerr << "fatal error: edge_source_planes[it].size() != 2. Size = " << tmp.size() << std::endl;
+			Logger::err("-") << "edge_source_planes[it].size() != 2. Size = " << tmp.size() << std::endl;
 	}
 
 	FOR_EACH_VERTEX(Map, mesh, it) {
-		const std::set<Plane3d*>& tmp = vertex_source_planes[it];
+		const PlaneIdSet<3>& tmp = vertex_source_planes[it];
 		if (tmp.size() != 3)
-			std::cerr << "vertex_source_planes[it].size() != 3. Size = " << tmp.size() << std::endl;
+			Logger::err("-") << "vertex_source_planes[it].size() != 3. Size = " << tmp.size() << std::endl;
 	}
 }
 
@@ -225,13 +741,24 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	MapBuilder builder(mesh);
 
 	MapFacetAttribute<Plane3d*> face_supporting_plane(mesh, "FacetSupportingPlane");
-	MapHalfedgeAttribute< std::set<Plane3d*> >	edge_source_planes(mesh, "EdgeSourcePlanes");
-	MapVertexAttribute< std::set<Plane3d*> >	vertex_source_planes(mesh, "VertexSourcePlanes");
+	MapHalfedgeAttribute< PlaneIdSet<2> >		edge_source_planes(mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >			vertex_source_planes(mesh, "VertexSourcePlanes");
 
 	float xmin = box.x_min() - delta, xmax = box.x_max() + delta;
 	float ymin = box.y_min() - delta, ymax = box.y_max() + delta;
 	float zmin = box.z_min() - delta, zmax = box.z_max() + delta;
 
+	// the planes are created for the first bbox mesh, and the same planes are used afterwards
+	const bool reuse_planes = (bbox_planes_.size() == 6);
+	std::size_t num_faces = 0;
+	auto bbox_plane = [&](MapTypes::Facet* f) -> Plane3d* {
+		if (reuse_planes)
+			return bbox_planes_[num_faces++];
+		Plane3d* plane = add_supporting_plane(Geom::facet_plane(f));
+		bbox_planes_.push_back(plane);
+		return plane;
+	};
+
 	builder.begin_surface();
 
 	builder.add_vertex(vec3(xmin, ymin, zmin));  // 0
@@ -251,8 +778,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	builder.add_vertex_to_facet(3);
 	builder.end_facet();
 	MapTypes::Facet* f = builder.current_facet();
-	Plane3d* plane = new Plane3d(Geom::facet_plane(f));
-	supporting_planes_.push_back(plane);
+	Plane3d* plane = bbox_plane(f);
 	face_supporting_plane[f] = plane;
 
 	builder.begin_facet();
@@ -262,8 +788,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	builder.add_vertex_to_facet(2);
 	builder.end_facet();
 	f = builder.current_facet();
-	plane = new Plane3d(Geom::facet_plane(f));
-	supporting_planes_.push_back(plane);
+	plane = bbox_plane(f);
 	face_supporting_plane[f] = plane;
 
 	builder.begin_facet();
@@ -273,8 +798,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	builder.add_vertex_to_facet(5);
 	builder.end_facet();
 	f = builder.current_facet();
-	plane = new Plane3d(Geom::facet_plane(f));
-	supporting_planes_.push_back(plane);
+	plane = bbox_plane(f);
 	face_supporting_plane[f] = plane;
 
 	builder.begin_facet();
@@ -284,8 +808,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	builder.add_vertex_to_facet(7);
 	builder.end_facet();
 	f = builder.current_facet();
-	plane = new Plane3d(Geom::facet_plane(f));
-	supporting_planes_.push_back(plane);
+	plane = bbox_plane(f);
 	face_supporting_plane[f] = plane;
 
 	builder.begin_facet();
@@ -295,8 +818,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	builder.add_vertex_to_facet(6);
 	builder.end_facet();
 	f = builder.current_facet();
-	plane = new Plane3d(Geom::facet_plane(f));
-	supporting_planes_.push_back(plane);
+	plane = bbox_plane(f);
 	face_supporting_plane[f] = plane;
 
 	builder.begin_facet();
@@ -306,8 +828,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	builder.add_vertex_to_facet(3);
 	builder.end_facet();
 	f = builder.current_facet();
-	plane = new Plane3d(Geom::facet_plane(f));
-	supporting_planes_.push_back(plane);
+	plane = bbox_plane(f);
 	face_supporting_plane[f] = plane;
 
 	builder.end_surface();
@@ -316,8 +837,8 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 	FOR_EACH_HALFEDGE(Map, mesh, it) {
 		Plane3d* plane1 = face_supporting_plane[it->facet()];
 		Plane3d* plane2 = face_supporting_plane[it->opposite()->facet()];
-		edge_source_planes[it].insert(plane1);
-		edge_source_planes[it].insert(plane2);
+		edge_source_planes[it].insert(plane_id(plane1));
+		edge_source_planes[it].insert(plane_id(plane2));
 	}
 
 	// assign the original planes for each vertex
@@ -325,7 +846,7 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 		VertexInHalfedgeCirculator cit(it);
 		for (; !cit->end(); ++cit) {
 			Plane3d* plane = face_supporting_plane[cit->facet()];
-			vertex_source_planes[it].insert(plane);
+			vertex_source_planes[it].insert(plane_id(plane));
 		}
 		if (cit->size() != 3)
 			Logger::err("-") << "fatal_error. A bbox mesh corner does not relate to 3 planes" << std::endl;
@@ -336,9 +857,12 @@ Map* HypothesisGenerator::construct_bbox_mesh() {
 
 
 Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
+	if (Method::parallel_proxy_mesh)
+		return compute_proxy_mesh_parallel(bbox_mesh);
+
 	MapFacetAttribute<Plane3d*>					bbox_mesh_face_supporting_plane(bbox_mesh, "FacetSupportingPlane");
-	MapHalfedgeAttribute< std::set<Plane3d*> >	bbox_mesh_edge_source_planes(bbox_mesh, "EdgeSourcePlanes");
-	MapVertexAttribute< std::set<Plane3d*> >	bbox_mesh_vertex_source_planes(bbox_mesh, "VertexSourcePlanes");
+	MapHalfedgeAttribute< PlaneIdSet<2> >		bbox_mesh_edge_source_planes(bbox_mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >			bbox_mesh_vertex_source_planes(bbox_mesh, "VertexSourcePlanes");
 
 	Map* mesh = new Map;
 	MapBuilder builder(mesh);
@@ -346,8 +870,8 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 	MapFacetAttribute<Color> color(mesh, "color");
 	MapFacetAttribute<VertexGroup*> facet_supporting_vertex_group(mesh, Method::facet_attrib_supporting_vertex_group);
 	MapFacetAttribute<Plane3d*>		face_supporting_plane(mesh, "FacetSupportingPlane");
-	MapHalfedgeAttribute< std::set<Plane3d*> >	edge_source_planes(mesh, "EdgeSourcePlanes");
-	MapVertexAttribute< std::set<Plane3d*> >	vertex_source_planes(mesh, "VertexSourcePlanes");
+	MapHalfedgeAttribute< PlaneIdSet<2> >		edge_source_planes(mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >			vertex_source_planes(mesh, "VertexSourcePlanes");
 
 	builder.begin_surface();
 	int idx = 0;
@@ -356,7 +880,9 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 		Plane3d* plane = vertex_group_plane_[g];
 
 		std::vector<vec3> points;
-		std::vector< std::set<Plane3d*> > point_source_planes;
+		unsigned int id = plane_id(plane);
+
+		std::vector< PlaneIdSet<3> > point_source_planes;
 		FOR_EACH_EDGE_CONST(Map, bbox_mesh, it) {
 			const vec3& s = it->prev()->vertex()->point();
 			const vec3& t = it->vertex()->point();
@@ -367,8 +893,8 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 				if (plane->intersection(Line3d::from_two_points(s, t), p)) {
 					points.push_back(p);
 
-					std::set<Plane3d*> planes = bbox_mesh_edge_source_planes[it];
-					planes.insert(plane);
+					PlaneIdSet<3> planes(bbox_mesh_edge_source_planes[it]);
+					planes.insert(id);
 					point_source_planes.push_back(planes);
 				}
 				else
@@ -378,13 +904,13 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 				if (ss == ZERO) {
 					points.push_back(s);
 
-					std::set<Plane3d*> planes = bbox_mesh_vertex_source_planes[it->prev()->vertex()];
+					const PlaneIdSet<3>& planes = bbox_mesh_vertex_source_planes[it->prev()->vertex()];
 					point_source_planes.push_back(planes);
 				}
 				else if (st == ZERO) {
 					points.push_back(t);
 
-					std::set<Plane3d*> planes = bbox_mesh_vertex_source_planes[it->vertex()];
+					const PlaneIdSet<3>& planes = bbox_mesh_vertex_source_planes[it->vertex()];
 					point_source_planes.push_back(planes);
 				}
 				else {
@@ -407,7 +933,7 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 			CGAL::convex_hull_2(pts.begin(), pts.end(), std::back_inserter(hull), Projection());
 
 			std::vector<vec3> ch;
-			std::vector< std::set<Plane3d*> > ch_source_planes;
+			std::vector< PlaneIdSet<3> > ch_source_planes;
 
 			for (std::list<Point3>::iterator it = hull.begin(); it != hull.end(); ++it) {
 				int idx = int(it->z());
@@ -436,16 +962,16 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 					FacetHalfedgeCirculator cir(f);
 					for (; !cir->end(); ++cir) {
 						MapTypes::Halfedge* h = cir->halfedge();
-						edge_source_planes[h].insert(plane);
+						edge_source_planes[h].insert(id);
 
 						FOR_EACH_FACET(Map, bbox_mesh, fc) {
 							Plane3d* bbox_plane = bbox_mesh_face_supporting_plane[fc];
 							if ((bbox_plane->squared_ditance(h->vertex()->point()) < 1e-6) && (bbox_plane->squared_ditance(h->prev()->vertex()->point()) < 1e-6)) {
-								edge_source_planes[h].insert(bbox_plane);
+								edge_source_planes[h].insert(plane_id(bbox_plane));
 								break;
 							}
 						}
-						std::set<Plane3d*> tmp = edge_source_planes[h];
+						const PlaneIdSet<2>& tmp = edge_source_planes[h];
 						if (tmp.size() != 2) {
 							Logger::err("-") << "fatal error: edge_source_planes[h].size() != 2. Size = " << tmp.size() << std::endl;
 						}
@@ -471,7 +997,220 @@ Map* HypothesisGenerator::compute_proxy_mesh(Map* bbox_mesh) {
 	builder.end_surface();
 
 	FOR_EACH_HALFEDGE(Map, mesh, it) {
-		const std::set<Plane3d*>& tmp = edge_source_planes[it];
+		const PlaneIdSet<2>& tmp = edge_source_planes[it];
+		if (tmp.size() == 2 && edge_source_planes[it->opposite()].size() != 2)
+			edge_source_planes[it->opposite()] = tmp;
+	}
+
+	check_source_planes(bbox_mesh);
+	check_source_planes(mesh);
+
+	return mesh;
+}
+
+
+namespace {
+
+	// the face of a segment in compute_proxy_mesh_parallel(), built apart from the mesh
+	struct ProxyFace {
+		ProxyFace() : num_points(0) {}
+
+		std::size_t num_points;					// the number of points clipped from the bbox
+		std::vector<vec3>			 points;	// the convex hull, counterclockwise in the plane frame
+		std::vector< PlaneIdSet<3> > point_planes;
+		std::vector< PlaneIdSet<2> > edge_planes;	// of the edge from the point to the next one
+	};
+
+	// the convex hull (Andrew's monotone chain) of the 2D points 'xs' and 'ys': the indices of the 
+	// hull points, counterclockwise from the lexicographically smallest one. The collinear and the 
+	// duplicated points are dropped.
+	void monotone_chain_hull(const std::vector<geom_real>& xs, const std::vector<geom_real>& ys, std::vector<std::size_t>& hull) {
+		const std::size_t n = xs.size();
+		std::vector<std::size_t> order(n);
+		for (std::size_t i = 0; i < n; ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+			return xs[a] < xs[b] || (xs[a] == xs[b] && ys[a] < ys[b]);
+		});
+
+		auto cross = [&](std::size_t o, std::size_t a, std::size_t b) -> geom_real {
+			return (xs[a] - xs[o]) * (ys[b] - ys[o]) - (ys[a] - ys[o]) * (xs[b] - xs[o]);
+		};
+
+		hull.assign(2 * n, 0);
+		std::size_t k = 0;
+		for (std::size_t i = 0; i < n; ++i) {			// the lower hull
+			while (k >= 2 && cross(hull[k - 2], hull[k - 1], order[i]) <= 0)
+				--k;
+			hull[k++] = order[i];
+		}
+		for (std::size_t i = n - 1, t = k + 1; i > 0; --i) {	// the upper hull
+			while (k >= t && cross(hull[k - 2], hull[k - 1], order[i - 1]) <= 0)
+				--k;
+			hull[k++] = order[i - 1];
+		}
+		hull.resize(k > 1 ? k - 1 : k);	// the last point is the first one
+	}
+
+}
+
+
+Map* HypothesisGenerator::compute_proxy_mesh_parallel(Map* bbox_mesh) {
+	MapFacetAttribute<Plane3d*>					bbox_mesh_face_supporting_plane(bbox_mesh, "FacetSupportingPlane");
+	MapHalfedgeAttribute< PlaneIdSet<2> >		bbox_mesh_edge_source_planes(bbox_mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >			bbox_mesh_vertex_source_planes(bbox_mesh, "VertexSourcePlanes");
+
+	// the corners, the edges, and the planes of the bbox, in the order compute_proxy_mesh() visits them
+	std::vector<vec3> corners;
+	std::vector< PlaneIdSet<3> > corner_planes;
+	std::map<const MapTypes::Vertex*, std::size_t> corner_index;
+	FOR_EACH_VERTEX_CONST(Map, bbox_mesh, it) {
+		corner_index[it] = corners.size();
+		corners.push_back(it->point());
+		corner_planes.push_back(bbox_mesh_vertex_source_planes[it]);
+	}
+	std::vector< std::pair<std::size_t, std::size_t> > edges;
+	std::vector< PlaneIdSet<2> > edge_planes;
+	FOR_EACH_EDGE_CONST(Map, bbox_mesh, it) {
+		edges.push_back(std::make_pair(corner_index[it->prev()->vertex()], corner_index[it->vertex()]));
+		edge_planes.push_back(bbox_mesh_edge_source_planes[it]);
+	}
+	std::vector<Plane3d*> bbox_planes;
+	FOR_EACH_FACET_CONST(Map, bbox_mesh, it)
+		bbox_planes.push_back(bbox_mesh_face_supporting_plane[it]);
+
+	std::vector<Plane3d*> planes(plane_segments_.size());
+	for (std::size_t i = 0; i < plane_segments_.size(); ++i)
+		planes[i] = vertex_group_plane_[plane_segments_[i]];
+
+	// Each face only reads the bbox and its plane, so the faces are computed in parallel. The clipping
+	// evaluates the plane once per corner, and the crossings of the edges are interpolated from these
+	// values in the frame of the plane.
+	std::vector<ProxyFace> faces(plane_segments_.size());
+	parallel_for(plane_segments_.size(), [&](std::size_t i) {
+		const Plane3d* plane = planes[i];
+		const unsigned int id = plane_id(plane);
+		const geom_plane3 gplane(*plane);
+		const geom_vec3 origin = gplane.point();
+		const geom_vec3 base1 = gplane.base1();
+		const geom_vec3 base2 = gplane.base2();
+
+		std::vector<geom_real> values(corners.size());
+		std::vector<Sign> signs(corners.size());
+		for (std::size_t c = 0; c < corners.size(); ++c) {
+			values[c] = gplane.value(geom_vec3(corners[c]));
+			signs[c] = plane->orient(corners[c]);
+		}
+
+		std::vector<geom_vec3> points;
+		std::vector< PlaneIdSet<3> > point_planes;
+		for (std::size_t e = 0; e < edges.size(); ++e) {
+			std::size_t cs = edges[e].first, ct = edges[e].second;
+			Sign ss = signs[cs], st = signs[ct];
+			if ((ss == POSITIVE && st == NEGATIVE) || (ss == NEGATIVE && st == POSITIVE)) {
+				const geom_vec3 s(corners[cs]), t(corners[ct]);
+				points.push_back(s + (t - s) * (values[cs] / (values[cs] - values[ct])));
+				PlaneIdSet<3> ids(edge_planes[e]);
+				ids.insert(id);
+				point_planes.push_back(ids);
+			}
+			else if (ss == ZERO) {
+				points.push_back(geom_vec3(corners[cs]));
+				point_planes.push_back(corner_planes[cs]);
+			}
+			else if (st == ZERO) {
+				points.push_back(geom_vec3(corners[ct]));
+				point_planes.push_back(corner_planes[ct]);
+			}
+		}
+
+		ProxyFace& face = faces[i];
+		face.num_points = points.size();
+		if (points.size() < 3)
+			return;
+
+		std::vector<geom_real> xs(points.size()), ys(points.size());
+		for (std::size_t k = 0; k < points.size(); ++k) {
+			const geom_vec3 vec = points[k] - origin;
+			xs[k] = dot(vec, base1);
+			ys[k] = dot(vec, base2);
+		}
+		std::vector<std::size_t> hull;
+		monotone_chain_hull(xs, ys, hull);
+
+		for (std::size_t k = 0; k < hull.size(); ++k) {
+			const geom_vec3& p = points[hull[k]];
+			face.points.push_back(vec3(float(p.x), float(p.y), float(p.z)));
+			face.point_planes.push_back(point_planes[hull[k]]);
+		}
+		for (std::size_t k = 0; k < face.points.size(); ++k) {
+			const vec3& s = face.points[k];
+			const vec3& t = face.points[(k + 1) % face.points.size()];
+			PlaneIdSet<2> ids;
+			ids.insert(id);
+			for (std::size_t b = 0; b < bbox_planes.size(); ++b) {
+				if (bbox_planes[b]->squared_ditance(s) < 1e-6 && bbox_planes[b]->squared_ditance(t) < 1e-6) {
+					ids.insert(plane_id(bbox_planes[b]));
+					break;
+				}
+			}
+			face.edge_planes.push_back(ids);
+		}
+	}, nil, Method::num_threads);
+
+	// the faces are appended to the mesh in one batch, in the order of the segments
+	Map* mesh = new Map;
+	MapBuilder builder(mesh);
+
+	MapFacetAttribute<Color> color(mesh, "color");
+	MapFacetAttribute<VertexGroup*> facet_supporting_vertex_group(mesh, Method::facet_attrib_supporting_vertex_group);
+	MapFacetAttribute<Plane3d*>		face_supporting_plane(mesh, "FacetSupportingPlane");
+	MapHalfedgeAttribute< PlaneIdSet<2> >		edge_source_planes(mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >			vertex_source_planes(mesh, "VertexSourcePlanes");
+
+	builder.begin_surface();
+	int idx = 0;
+	for (std::size_t i = 0; i < faces.size(); ++i) {
+		const ProxyFace& face = faces[i];
+		if (face.num_points < 3 || face.points.size() < 3) {
+			Logger::err("-") << "fatal error. Check if this is a degenerate case" << std::endl;
+			continue;
+		}
+
+		std::vector<MapTypes::Vertex*> vertices;
+		for (std::size_t j = 0; j < face.points.size(); ++j) {
+			builder.add_vertex(face.points[j]);
+			MapTypes::Vertex* v = builder.current_vertex();
+			vertex_source_planes[v] = face.point_planes[j];
+			vertices.push_back(v);
+		}
+		builder.begin_facet();
+		for (int k = idx; k < idx + int(face.points.size()); ++k)
+			builder.add_vertex_to_facet(k);
+		builder.end_facet();
+
+		VertexGroup* g = plane_segments_[i];
+		Map::Facet* f = builder.current_facet();
+		color[f] = g->color();
+		facet_supporting_vertex_group[f] = g;
+		face_supporting_plane[f] = planes[i];
+
+		FacetHalfedgeCirculator cir(f);
+		for (; !cir->end(); ++cir) {
+			MapTypes::Halfedge* h = cir->halfedge();
+			std::size_t j = std::find(vertices.begin(), vertices.end(), h->prev()->vertex()) - vertices.begin();
+			edge_source_planes[h] = face.edge_planes[j];
+			if (edge_source_planes[h].size() != 2)
+				Logger::err("-") << "fatal error: edge_source_planes[h].size() != 2. Size = " << edge_source_planes[h].size() << std::endl;
+		}
+
+		idx += int(face.points.size());
+	}
+
+	builder.end_surface();
+
+	FOR_EACH_HALFEDGE(Map, mesh, it) {
+		const PlaneIdSet<2>& tmp = edge_source_planes[it];
 		if (tmp.size() == 2 && edge_source_planes[it->opposite()].size() != 2)
 			edge_source_planes[it->opposite()] = tmp;
 	}
@@ -495,141 +1234,467 @@ static bool halfedge_exists_between_vertices(Map::Vertex* v1, Map::Vertex* v2) {
 }
 
 
-// test if face f and plane intersect
-bool HypothesisGenerator::do_intersect(MapTypes::Facet* f, Plane3d* plane)
-{
-    std::vector<Intersection> vts;
-    compute_intersections(f, plane, vts);
+namespace {
 
-    return (vts.size() > 1);
-}
+	// Classifies the halfedges of a face against a plane, with the tests compute_intersections() 
+	// used to do edge by edge: the plane passes through the target vertex of a halfedge (i.e., the vertex 
+	// is within the snapping distance), or it crosses the interior of the halfedge. The plane equation 
+	// is evaluated only once per vertex (each vertex is shared by two halfedges), in a straight loop 
+	// over the vertices. The results are kept in stack buffers indexed by the position of the halfedge 
+	// in the face, and the heap is only used for faces with a very large number of vertices.
+	class FacePlaneClassifier {
+	public:
+		enum Status { NONE, AT_VERTEX, ON_EDGE };
 
+		FacePlaneClassifier(Map::Facet* f, const Plane3d* plane);
 
-std::set<Plane3d *> HypothesisGenerator::collect_cutting_planes(MapTypes::Facet *face, Map *mesh) {
-	std::set<Plane3d*> cutting_planes;
-	FOR_EACH_FACET(Map, mesh, it) {
-		Map::Facet* f = it;
-		if (f != face) {
-		    Plane3d* plane = facet_attrib_supporting_plane_[f];
-		    if (plane != facet_attrib_supporting_plane_[face]) {
-			    if (do_intersect(f, facet_attrib_supporting_plane_[face]))
-                    cutting_planes.insert(plane);
+		std::size_t size() const { return size_; }
+		Map::Halfedge* halfedge(std::size_t i) const { return halfedges_[i]; }
+		Status status(std::size_t i) const { return Status(status_[i]); }
+
+	private:
+		FacePlaneClassifier(const FacePlaneClassifier&);
+		FacePlaneClassifier& operator=(const FacePlaneClassifier&);
+
+		enum { buffer_size = 32 };
+
+		std::size_t		size_;
+		Map::Halfedge**	halfedges_;
+		float*			values_;
+		unsigned char*	status_;
+
+		Map::Halfedge*	halfedge_buffer_[buffer_size];
+		float			value_buffer_[buffer_size];
+		unsigned char	status_buffer_[buffer_size];
+
+		std::vector<Map::Halfedge*>	halfedge_heap_;
+		std::vector<float>			value_heap_;
+		std::vector<unsigned char>	status_heap_;
+	};
+
+
+	FacePlaneClassifier::FacePlaneClassifier(Map::Facet* f, const Plane3d* plane) 
+		: size_(0)
+		, halfedges_(halfedge_buffer_)
+		, values_(value_buffer_)
+		, status_(status_buffer_)
+	{
+		Map::Halfedge* h = f->halfedge();
+		do {
+			if (size_ < buffer_size)
+				halfedge_buffer_[size_] = h;
+			else {
+				if (size_ == buffer_size)
+					halfedge_heap_.assign(halfedge_buffer_, halfedge_buffer_ + buffer_size);
+				halfedge_heap_.push_back(h);
 			}
+			++size_;
+			h = h->next();
+		} while (h != f->halfedge());
+
+		if (size_ > buffer_size) {
+			value_heap_.resize(size_);
+			status_heap_.resize(size_);
+			halfedges_ = &halfedge_heap_[0];
+			values_ = &value_heap_[0];
+			status_ = &status_heap_[0];
+		}
+
+		// the values at the target vertices (the same computation as Plane3d::value())
+		const float a = plane->a(), b = plane->b(), c = plane->c(), d = plane->d();
+		for (std::size_t i = 0; i < size_; ++i) {
+			const vec3& p = halfedges_[i]->vertex()->point();
+			values_[i] = a * p.x + b * p.y + c * p.z + d;
+		}
+
+		// the same as Plane3d::squared_ditance()
+		const float den = a * a + b * b + c * c;
+		for (std::size_t i = 0; i < size_; ++i)
+			status_[i] = ((values_[i] * values_[i]) / den <= Method::snap_sqr_distance_threshold) ? AT_VERTEX : NONE;
+
+		for (std::size_t i = 0; i < size_; ++i) {
+			if (status_[i] == AT_VERTEX)
+				continue;
+			std::size_t prev = (i == 0) ? size_ - 1 : i - 1;	// the source vertex of halfedge i
+			if (status_[prev] == AT_VERTEX)
+				continue;
+			// the sides of the end points are certified by the filtered predicates (the float values 
+			// decide almost always, and only the points very close to the plane are tested exactly)
+			Sign ss = PlanePredicates::orient(*plane, halfedges_[prev]->vertex()->point(), values_[prev]);
+			Sign st = PlanePredicates::orient(*plane, halfedges_[i]->vertex()->point(), values_[i]);
+			if (ss == ZERO || st == ZERO || ss != st)
+				status_[i] = ON_EDGE;
 		}
 	}
-	return cutting_planes;
+
 }
 
 
-void HypothesisGenerator::compute_intersections(
-        MapTypes::Facet* f,
-        Plane3d* plane,
-        std::vector<Intersection>& vts)
+// test if face f and plane intersect, i.e., if compute_intersections() would find at least two intersecting
+// points. It does the same tests, but nothing is stored and it stops as soon as two points are found.
+bool HypothesisGenerator::do_intersect(MapTypes::Facet* f, Plane3d* plane, const CutAttributes& attribs)
 {
-    vts.clear();
-
-    Map::Halfedge* h = f->halfedge();
-    do {
-        const vec3& s = h->opposite()->vertex()->point();
-        const vec3& t = h->vertex()->point();
-        if (plane->squared_ditance(t) <= Method::snap_sqr_distance_threshold) {		// plane cuts at vertex 't'
-            Intersection it(Intersection::EXISTING_VERTEX);
-            it.vtx = h->vertex();
-            vts.push_back(it);
-        }
-        else if (plane->squared_ditance(s) > Method::snap_sqr_distance_threshold) {	// cut at the edge
-            const std::set<Plane3d*>& source_planes = edge_source_planes_[h];
-            if (source_planes.size() == 2) {  // if the edge was computed from two faces, I use the source faces for computing the intersecting point
-                if (plane->intersection(s, t)) {
-                    Plane3d* plane1 = *(source_planes.begin());
-                    Plane3d* plane2 = *(source_planes.rbegin());
-                    Plane3d* plane3 = plane;
-                    if (plane3 != plane1 && plane3 != plane2) {
-                        vec3* p = query_intersection(plane1, plane2, plane3);
-                        if (p) {
-                            Intersection it(Intersection::NEW_VERTEX);
-                            it.edge = h;
-                            it.pos = *p;
-                            vts.push_back(it);
-                        }
-                        else {
-                            vec3 q;
-                            if (intersection_plane_triplet(plane1, plane2, plane3, q)) {
-                                triplet_intersection_[plane1][plane2][plane3] = p; // store the intersection in our data base
-                                Intersection it(Intersection::NEW_VERTEX);
-                                it.edge = h;
-                                it.pos = q;
-                                vts.push_back(it);
-                            }
-                            else
-                                Logger::warn("-") << "fatal error. should have intersection. " << std::endl;
-                        }
-                    }
-                    else {
-                        Logger::warn("-") << "fatal error. should have 3 different planes. " << std::endl;
-                    }
-                }
+    FacePlaneClassifier classifier(f, plane);
+    unsigned int id = plane_id(plane);
+    int num = 0;
+    for (std::size_t i = 0; i < classifier.size(); ++i) {
+        FacePlaneClassifier::Status status = classifier.status(i);
+        if (status == FacePlaneClassifier::AT_VERTEX)		// plane cuts at the target vertex
+            ++num;
+        else if (status == FacePlaneClassifier::ON_EDGE) {	// cut at the edge
+            Map::Halfedge* h = classifier.halfedge(i);
+            const PlaneIdSet<2>& source_planes = attribs.edge_source_planes[h];
+            if (source_planes.size() == 2) {
+                unsigned int id1 = source_planes[0];
+                unsigned int id2 = source_planes[1];
+                vec3 q;
+                if (id != id1 && id != id2 &&
+                    (query_intersection(id1, id2, id) || 
+                     intersection_plane_triplet(supporting_planes_[id1], supporting_planes_[id2], plane, q)))
+                    ++num;
             }
             else {
                 vec3 p;
-                if (plane->intersection(s, t, p)) {
-                    Intersection it(Intersection::NEW_VERTEX);
-                    it.edge = h;
-                    it.pos = p;
-                    vts.push_back(it);
-                }
+                if (PlanePredicates::intersection(*plane, h->opposite()->vertex()->point(), h->vertex()->point(), p))
+                    ++num;
             }
         }
-        h = h->next();
-    } while (h != f->halfedge());
+        if (num > 1)
+            return true;
+    }
+
+    return false;
 }
 
 
-// split an existing edge, meanwhile, assign the new edges the original source faces (the old edge lies in the intersection of the two faces)
-MapTypes::Vertex* HypothesisGenerator::split_edge(const Intersection& ep, MapEditor* editor, Plane3d* cutter) {
-	const std::set<Plane3d*>& sfs = edge_source_planes_[ep.edge];
-	assert(sfs.size() == 2);
+// an oriented box: the rectangle of a segment on its supporting plane (from the principal axes of 
+// the points of the segment), inflated by a margin in all directions
+struct HypothesisGenerator::SegmentExtent {
+	SegmentExtent() : valid(false) {}
 
-    MapTypes::Vertex* v = editor->split_edge(ep.edge);
-    v->set_point(ep.pos);
+	bool	valid;		// false for the planes without segment (e.g., the faces of the bounding box)
+	vec3	center;
+	vec3	axis[3];
+	double	half_size[3];
+};
 
-    if (sfs.size() == 2) {
+
+void HypothesisGenerator::compute_segment_extents(double margin, std::vector<SegmentExtent>& extents) const {
+	extents.assign(supporting_planes_.size(), SegmentExtent());
+
+	const std::vector<vec3>& points = pset_->points();
+	for (std::size_t i = 0; i < plane_segments_.size(); ++i) {
+		VertexGroup* g = plane_segments_[i];
+		std::map<VertexGroup*, Plane3d*>::const_iterator pos = vertex_group_plane_.find(g);
+		if (pos == vertex_group_plane_.end() || g->empty())
+			continue;
+		const Plane3d* plane = pos->second;
+
+		PrincipalAxes2d pca;
+		pca.begin();
+		for (std::size_t j = 0; j < g->size(); ++j)
+			pca.add_point(plane->to_2d(points[g->at(j)]));
+		pca.end();
+
+		const vec2 center = pca.center();
+		const vec2 axis[2] = { pca.axis(0), pca.axis(1) };
+		double min_coord[2] = {  DBL_MAX,  DBL_MAX };
+		double max_coord[2] = { -DBL_MAX, -DBL_MAX };
+		for (std::size_t j = 0; j < g->size(); ++j) {
+			const vec2 q = plane->to_2d(points[g->at(j)]) - center;
+			for (int k = 0; k < 2; ++k) {
+				double c = dot(q, axis[k]);
+				min_coord[k] = std::min(min_coord[k], c);
+				max_coord[k] = std::max(max_coord[k], c);
+			}
+		}
+
+		SegmentExtent& extent = extents[plane_id(plane)];
+		extent.valid = true;
+		vec2 mid = center;
+		for (int k = 0; k < 2; ++k) {
+			mid = mid + axis[k] * float(0.5 * (min_coord[k] + max_coord[k]));
+			extent.axis[k] = normalize(plane->base1() * axis[k].x + plane->base2() * axis[k].y);
+			extent.half_size[k] = 0.5 * (max_coord[k] - min_coord[k]) + margin;
+		}
+		extent.center = plane->to_3d(mid);
+		extent.axis[2] = normalize(plane->normal());
+		extent.half_size[2] = margin;
+	}
+}
+
+
+namespace {
+
+	// separating axis test of two oriented boxes (see "Real-Time Collision Detection", C. Ericson, Section 4.4)
+	template <class Extent>
+	bool extents_overlap(const Extent& a, const Extent& b) {
+		if (!a.valid || !b.valid)
+			return true;
+
+		const double epsilon = 1e-6;	// for nearly parallel edges, whose cross products are close to zero
+		double R[3][3], AbsR[3][3];
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				R[i][j] = dot(a.axis[i], b.axis[j]);
+				AbsR[i][j] = std::fabs(R[i][j]) + epsilon;
+			}
+		}
+
+		const vec3 d = b.center - a.center;
+		const double t[3] = { dot(d, a.axis[0]), dot(d, a.axis[1]), dot(d, a.axis[2]) };
+		const double* ea = a.half_size;
+		const double* eb = b.half_size;
+
+		// the axes of a
+		for (int i = 0; i < 3; ++i) {
+			double rb = eb[0] * AbsR[i][0] + eb[1] * AbsR[i][1] + eb[2] * AbsR[i][2];
+			if (std::fabs(t[i]) > ea[i] + rb)
+				return false;
+		}
+
+		// the axes of b
+		for (int j = 0; j < 3; ++j) {
+			double ra = ea[0] * AbsR[0][j] + ea[1] * AbsR[1][j] + ea[2] * AbsR[2][j];
+			if (std::fabs(t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j]) > ra + eb[j])
+				return false;
+		}
+
+		// the cross products of an axis of a and an axis of b
+		for (int i = 0; i < 3; ++i) {
+			int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+			for (int j = 0; j < 3; ++j) {
+				int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+				double ra = ea[i1] * AbsR[i2][j] + ea[i2] * AbsR[i1][j];
+				double rb = eb[j1] * AbsR[i][j2] + eb[j2] * AbsR[i][j1];
+				if (std::fabs(t[i2] * R[i1][j] - t[i1] * R[i2][j]) > ra + rb)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+}
+
+
+void HypothesisGenerator::collect_cutting_planes(
+	MapTypes::Facet* face, 
+	const std::vector<MapTypes::Facet*>& faces, 
+	const BoxTree& tree, 
+	double tolerance,
+	const CutAttributes& attribs,
+	CutterSet& cutting_planes,
+	const std::vector<SegmentExtent>* extents /* = nil */) 
+{
+	// only the faces whose bounding boxes are close enough to the supporting plane can intersect it
+	Plane3d* face_plane = attribs.supporting_plane[face];
+	std::vector<std::size_t> candidates;
+	tree.intersected_boxes(*face_plane, tolerance, candidates);
+
+	for (std::size_t i = 0; i < candidates.size(); ++i) {
+		Map::Facet* f = faces[candidates[i]];
+		if (f != face) {
+		    Plane3d* plane = attribs.supporting_plane[f];
+		    if (plane != face_plane) {
+			    if (extents && !extents_overlap((*extents)[plane_id(plane)], (*extents)[plane_id(face_plane)]))
+				    continue;
+			    if (do_intersect(f, face_plane, attribs))
+                    cutting_planes.insert(plane);
+			}
+		}
+	}
+}
+
+
+void HypothesisGenerator::compute_intersections(
+        MapTypes::Facet* f,
+        Plane3d* plane,
+        const CutAttributes& attribs,
+        std::vector<Intersection>& vts)
+{
+    vts.clear();
+    unsigned int id3 = plane_id(plane);
+
+    FacePlaneClassifier classifier(f, plane);
+    for (std::size_t i = 0; i < classifier.size(); ++i) {
+        Map::Halfedge* h = classifier.halfedge(i);
+        FacePlaneClassifier::Status status = classifier.status(i);
+        if (status == FacePlaneClassifier::AT_VERTEX) {		// plane cuts at vertex 't'
+            Intersection it(Intersection::EXISTING_VERTEX);
+            it.vtx = h->vertex();
+            vts.push_back(it);
+        }
+        else if (status == FacePlaneClassifier::ON_EDGE) {	// cut at the edge
+            const PlaneIdSet<2>& source_planes = attribs.edge_source_planes[h];
+            if (source_planes.size() == 2) {  // if the edge was computed from two faces, I use the source faces for computing the intersecting point
+                unsigned int id1 = source_planes[0];
+                unsigned int id2 = source_planes[1];
+                Plane3d* plane1 = supporting_planes_[id1];
+                Plane3d* plane2 = supporting_planes_[id2];
+                Plane3d* plane3 = plane;
+                if (id3 != id1 && id3 != id2) {
+                    const vec3* p = query_intersection(id1, id2, id3);
+                    if (p) {
+                        Intersection it(Intersection::NEW_VERTEX);
+                        it.edge = h;
+                        it.pos = *p;
+                        vts.push_back(it);
+                    }
+                    else {
+                        vec3 q;
+                        if (intersection_plane_triplet(plane1, plane2, plane3, q)) {
+                            Intersection it(Intersection::NEW_VERTEX);
+                            it.edge = h;
+                            it.pos = q;
+                            vts.push_back(it);
+                        }
+                        else
+                            Logger::warn("-") << "fatal error. should have intersection. " << std::endl;
+                    }
+                }
+                else {
+                    Logger::warn("-") << "fatal error. should have 3 different planes. " << std::endl;
+                }
+            }
+            else {
+                vec3 p;
+                if (PlanePredicates::intersection(*plane, h->opposite()->vertex()->point(), h->vertex()->point(), p)) {
+                    Intersection it(Intersection::NEW_VERTEX);
+                    it.edge = h;
+                    it.pos = p;
+                    vts.push_back(it);
+                }
+            }
+        }
+    }
+}
+
+
+void HypothesisGenerator::snap_intersections(Plane3d* cutter, const CutAttributes& attribs, std::vector<Intersection>& vts) {
+	// the registered vertex of each intersection
+	std::vector< std::pair<const vec3*, std::size_t> > vertices(vts.size());
+	for (std::size_t i = 0; i < vts.size(); ++i) {
+		Intersection& it = vts[i];
+		if (it.type == Intersection::EXISTING_VERTEX)
+			vertices[i].first = vertex_registry_.snap(attribs.vertex_source_planes[it.vtx], it.vtx->point());
+		else {
+			PlaneIdSet<3> planes(attribs.edge_source_planes[it.edge]);
+			planes.insert(plane_id(cutter));
+			vertices[i].first = vertex_registry_.snap(planes, it.pos);
+			it.pos = *vertices[i].first;
+		}
+		vertices[i].second = i;
+	}
+
+	// one intersection per vertex, an existing vertex rather than a new one
+	std::sort(vertices.begin(), vertices.end(), [&vts](const std::pair<const vec3*, std::size_t>& a, const std::pair<const vec3*, std::size_t>& b) {
+		if (a.first != b.first)
+			return a.first < b.first;
+		bool a_exists = (vts[a.second].type == Intersection::EXISTING_VERTEX);
+		bool b_exists = (vts[b.second].type == Intersection::EXISTING_VERTEX);
+		return a_exists != b_exists ? a_exists : a.second < b.second;
+	});
+	std::vector<std::size_t> kept;
+	for (std::size_t i = 0; i < vertices.size(); ++i) {
+		if (i == 0 || vertices[i].first != vertices[i - 1].first)
+			kept.push_back(vertices[i].second);
+	}
+	if (kept.size() == vts.size())
+		return;
+
+	std::sort(kept.begin(), kept.end());
+	std::vector<Intersection> unique_vts;
+	for (std::size_t i = 0; i < kept.size(); ++i)
+		unique_vts.push_back(vts[kept[i]]);
+	vts.swap(unique_vts);
+}
+
+
+// split an existing edge, meanwhile, assign the new edges the original source faces (the old edge lies in the intersection of the two faces)
+MapTypes::Vertex* HypothesisGenerator::split_edge(const Intersection& ep, MapEditor* editor, Plane3d* cutter, CutAttributes& attribs) {
+	num_split_edge_calls.add();
+	const PlaneIdSet<2>& sfs = attribs.edge_source_planes[ep.edge];
+	assert(sfs.size() == 2);
+
+    MapTypes::Vertex* v = editor->split_edge(ep.edge);
+    v->set_point(ep.pos);
+
+    if (sfs.size() == 2) {
         MapTypes::Halfedge* h = v->halfedge();
-        edge_source_planes_[h] = sfs;
-        edge_source_planes_[h->opposite()] = sfs;
+        attribs.edge_source_planes[h] = sfs;
+        attribs.edge_source_planes[h->opposite()] = sfs;
 
         h = h->next();
-        edge_source_planes_[h] = sfs;
-        edge_source_planes_[h->opposite()] = sfs;
+        attribs.edge_source_planes[h] = sfs;
+        attribs.edge_source_planes[h->opposite()] = sfs;
     }
     else {
         Logger::warn("-") << "edge_source_planes.size != 2" << std::endl;
     }
 
-    vertex_source_planes_[v] = sfs;
-    vertex_source_planes_[v].insert(cutter);
+    attribs.vertex_source_planes[v] = PlaneIdSet<3>(sfs);
+    attribs.vertex_source_planes[v].insert(plane_id(cutter));
 
     return v;
 }
 
 
-std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* cutter, Map* mesh) {
+bool HypothesisGenerator::is_sliver_cut(MapTypes::Facet* f, Plane3d* cutter, std::vector<Intersection>& vts) const {
+	const double sqr_width = min_piece_width_ * min_piece_width_;
+	for (std::size_t i = 0; i < vts.size(); ++i) {
+		Intersection& it = vts[i];
+		if (it.type != Intersection::NEW_VERTEX)
+			continue;
+		Map::Vertex* ends[2] = { it.edge->opposite()->vertex(), it.edge->vertex() };
+		double d0 = distance2(it.pos, ends[0]->point());
+		double d1 = distance2(it.pos, ends[1]->point());
+		if (std::min(d0, d1) < sqr_width) {
+			it.type = Intersection::EXISTING_VERTEX;
+			it.vtx = ends[d0 <= d1 ? 0 : 1];
+			num_snapped_intersections.add();
+		}
+	}
+
+	// the widths of the two pieces, from the farthest vertices on the two sides of the cutter
+	const geom_plane3 plane(*cutter);
+	const geom_real len = length(geom_vec3(plane.a(), plane.b(), plane.c()));
+	double positive = 0, negative = 0;
+	Map::Halfedge* h = f->halfedge();
+	do {
+		double v = double(plane.value(geom_vec3(h->vertex()->point())) / len);
+		positive = std::max(positive, v);
+		negative = std::max(negative, -v);
+		h = h->next();
+	} while (h != f->halfedge());
+	return std::min(positive, negative) < min_piece_width_;
+}
+
+
+std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* cutter, MapEditor& editor, CutAttributes& attribs) {
+	num_cut_calls.add();
 	std::vector<Map::Facet*> new_faces;
 
     std::vector<Intersection> vts;
-    compute_intersections(f, cutter, vts);
+    compute_intersections(f, cutter, attribs, vts);
+    if (Method::vertex_snapping_registry)
+        snap_intersections(cutter, attribs, vts);
+    if (min_piece_width_ > 0 && vts.size() == 2 && is_sliver_cut(f, cutter, vts)) {
+        num_sliver_cuts.add();
+        return new_faces;
+    }
     if (vts.size() < 2) // no actual intersection
         return new_faces;
     else if (vts.size() >= 3) {
 #if 0
-        std::cerr << "This might cause an error: number of intersecting points is " << vts.size() << std::endl;
+        Logger::warn("-") << "This might cause an error: number of intersecting points is " << vts.size() << std::endl;
         for (std::size_t i = 0; i < vts.size(); ++i) {
             const auto &v = vts[i];
             if (v.type == Intersection::EXISTING_VERTEX)
-                std::cerr << "\t" << i << ": plane intersects an existing vertex: " << v.vtx << " ("
+                Logger::warn("-") << "\t" << i << ": plane intersects an existing vertex: " << v.vtx << " ("
                                   << v.vtx->point() << ")" << std::endl;
             else if (v.type == Intersection::NEW_VERTEX)
-                std::cerr << "\t" << i << ": plane intersects an edge: " << v.edge << " at (" << v.pos << "). Source: "
+                Logger::warn("-") << "\t" << i << ": plane intersects an edge: " << v.edge << " at (" << v.pos << "). Source: "
                                   << v.edge->opposite()->vertex() << " (" << v.edge->opposite()->vertex()->point()
                                   << "). Target: " << v.edge->vertex() << " (" << v.edge->vertex()->point() << ")"
                                   << std::endl;
@@ -675,7 +1740,6 @@ std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* c
     }
 
     // now we can assume there is only two intersecting points
-    MapEditor editor(mesh);
 
     Map::Vertex* v0 = nil;
     Map::Vertex* v1 = nil;
@@ -683,16 +1747,16 @@ std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* c
 		// test if the two intersecting points are both very close to an existing vertex.
 		// Since we allow snapping, we test if the two intersecting points are the same.
 		if (vts[0].type == Intersection::NEW_VERTEX && vts[1].type == Intersection::NEW_VERTEX) {
-            v0 = split_edge(vts[0], &editor, cutter);
-            v1 = split_edge(vts[1], &editor, cutter);
+            v0 = split_edge(vts[0], &editor, cutter, attribs);
+            v1 = split_edge(vts[1], &editor, cutter, attribs);
         }
         else if (vts[0].type == Intersection::NEW_VERTEX && vts[1].type == Intersection::EXISTING_VERTEX) {
-            v0 = split_edge(vts[0], &editor, cutter);
+            v0 = split_edge(vts[0], &editor, cutter, attribs);
             v1 = vts[1].vtx;
         }
         else if (vts[0].type == Intersection::EXISTING_VERTEX && vts[1].type == Intersection::NEW_VERTEX) {
             v0 = vts[0].vtx;
-            v1 = split_edge(vts[1], &editor, cutter);
+            v1 = split_edge(vts[1], &editor, cutter, attribs);
         }
         else if (vts[0].type == Intersection::EXISTING_VERTEX && vts[1].type == Intersection::EXISTING_VERTEX) {
             if (halfedge_exists_between_vertices(vts[0].vtx, vts[1].vtx))
@@ -708,6 +1772,9 @@ std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* c
 
 	//////////////////////////////////////////////////////////////////////////
 
+	if (!v0 || !v1 || v0 == v1)
+		return new_faces;
+
 	Map::Halfedge* h0 = v0->halfedge();
 	if (h0->facet() != f) {
 		do {
@@ -728,20 +1795,22 @@ std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* c
 	}
 	assert(h1->facet() == f);
 
-    VertexGroup* g = facet_attrib_supporting_vertex_group_[f];
+    VertexGroup* g = attribs.supporting_vertex_group[f];
 	if (editor.can_split_facet(h0, h1)) {
 		Map::Halfedge* h = editor.split_facet(h0, h1);
 		if (h) {
-			edge_source_planes_[h].insert(facet_attrib_supporting_plane_[f]);
-			edge_source_planes_[h].insert(cutter);
-			edge_source_planes_[h->opposite()].insert(facet_attrib_supporting_plane_[f]);
-			edge_source_planes_[h->opposite()].insert(cutter);
+			unsigned int id1 = plane_id(attribs.supporting_plane[f]);
+			unsigned int id2 = plane_id(cutter);
+			attribs.edge_source_planes[h].insert(id1);
+			attribs.edge_source_planes[h].insert(id2);
+			attribs.edge_source_planes[h->opposite()].insert(id1);
+			attribs.edge_source_planes[h->opposite()].insert(id2);
 
 			Map::Facet* f1 = h->facet();
-			facet_attrib_supporting_vertex_group_[f1] = g;
+			attribs.supporting_vertex_group[f1] = g;
 			new_faces.push_back(f1);
 			Map::Facet* f2 = h->opposite()->facet();
-			facet_attrib_supporting_vertex_group_[f2] = g;
+			attribs.supporting_vertex_group[f2] = g;
 			new_faces.push_back(f2);
 		}
 		else
@@ -752,58 +1821,415 @@ std::vector<Map::Facet*> HypothesisGenerator::cut(MapTypes::Facet* f, Plane3d* c
 }
 
 
-void HypothesisGenerator::pairwise_cut(Map* mesh)
+HypothesisGenerator::CutAttributes::CutAttributes(Map* mesh)
+	: color(mesh, "color")
+	, supporting_vertex_group(mesh, Method::facet_attrib_supporting_vertex_group)
+	, supporting_plane(mesh, "FacetSupportingPlane")
+	, edge_source_planes(mesh, "EdgeSourcePlanes")
+	, vertex_source_planes(mesh, "VertexSourcePlanes")
 {
-	std::vector<MapTypes::Facet*> all_faces;
+}
+
+
+// The faces of the proxy mesh do not share any vertices or edges, so each face can be copied into 
+// its own mesh and cut there independently of the others. Merging the result back creates the new 
+// vertices, halfedges and facets in the order the cuts created them, i.e., the merged mesh is
+// identical to the one obtained by cutting the face in place.
+class HypothesisGenerator::FacetSubmesh : public MapMutator
+{
+public:
+	// 'submesh' can be given to start from an existing mesh (then 'f' is nil and nothing is extracted), 
+	// or to extract 'f' into an empty (e.g., recycled) mesh
+	FacetSubmesh(Map::Facet* f, Map* submesh = nil) : facet_(f), facet_copy_(nil), submesh_(submesh ? submesh : new Map), attribs_(submesh_) {
+		set_target(submesh_);
+	}
+
+	Map::Facet* facet() const { return facet_; }
+	Map::Facet* facet_copy() const { return facet_copy_; }
+	Map* submesh() const { return submesh_; }
+	CutAttributes& attributes() { return attribs_; }
+
+	// copies the face (with its vertices and its border halfedges) from the mesh accessed by 'from'
+	void extract(const CutAttributes& from);
+
+	// merges the (cut) copy back into 'mesh', i.e., the mesh the face was extracted from. The faces 
+	// created in 'mesh' are appended to 'new_facets' if it is given.
+	void merge_into(Map* mesh, CutAttributes& to, std::vector<Map::Facet*>* new_facets = nil);
+
+private:
+	Map::Facet* facet_;
+	Map::Facet* facet_copy_;
+	Map::Ptr	submesh_;
+	CutAttributes attribs_;
+
+	// the elements of the original mesh corresponding to the elements of the submesh
+	std::map<Map::Vertex*, Map::Vertex*>		vertices_;
+	std::map<Map::Halfedge*, Map::Halfedge*>	halfedges_;
+	std::map<Map::Facet*, Map::Facet*>			facets_;
+};
+
+
+void HypothesisGenerator::FacetSubmesh::extract(const CutAttributes& from) {
+	std::map<Map::Vertex*, Map::Vertex*>		vertex_copy;
+	std::map<Map::Halfedge*, Map::Halfedge*>	halfedge_copy;
+
+	Map::Facet* f = new_facet();
+	facets_[f] = facet_;
+	facet_copy_ = f;
+
+	std::vector<Map::Halfedge*> halfedges;
+	Map::Halfedge* h = facet_->halfedge();
+	do {
+		halfedges.push_back(h);
+		halfedges.push_back(h->opposite());
+
+		Map::Vertex* v = new_vertex();
+		vertex_copy[h->vertex()] = v;
+		vertices_[v] = h->vertex();
+		h = h->next();
+	} while (h != facet_->halfedge());
+
+	for (std::size_t i = 0; i < halfedges.size(); ++i) {
+		Map::Halfedge* sh = new_halfedge();
+		halfedge_copy[halfedges[i]] = sh;
+		halfedges_[sh] = halfedges[i];
+	}
+
+	for (std::size_t i = 0; i < halfedges.size(); ++i) {
+		Map::Halfedge* oh = halfedges[i];
+		Map::Halfedge* sh = halfedge_copy[oh];
+		set_halfedge_next(sh, halfedge_copy[oh->next()]);
+		set_halfedge_prev(sh, halfedge_copy[oh->prev()]);
+		set_halfedge_opposite(sh, halfedge_copy[oh->opposite()]);
+		set_halfedge_vertex(sh, vertex_copy[oh->vertex()]);
+		set_halfedge_facet(sh, oh->facet() ? f : nil);
+		attribs_.edge_source_planes[sh] = from.edge_source_planes[oh];
+	}
+
+	std::map<Map::Vertex*, Map::Vertex*>::iterator pos = vertex_copy.begin();
+	for (; pos != vertex_copy.end(); ++pos) {
+		Map::Vertex* ov = pos->first;
+		Map::Vertex* sv = pos->second;
+		sv->set_point(ov->point());
+		set_vertex_halfedge(sv, halfedge_copy[ov->halfedge()]);
+		attribs_.vertex_source_planes[sv] = from.vertex_source_planes[ov];
+	}
+
+	set_facet_halfedge(f, halfedge_copy[facet_->halfedge()]);
+	attribs_.color[f] = from.color[facet_];
+	attribs_.supporting_vertex_group[f] = from.supporting_vertex_group[facet_];
+	attribs_.supporting_plane[f] = from.supporting_plane[facet_];
+}
+
+
+void HypothesisGenerator::FacetSubmesh::merge_into(Map* mesh, CutAttributes& to, std::vector<Map::Facet*>* new_facets /* = nil */) {
+	set_target(mesh);
+
+	// the elements created by the cuts (the submesh lists its elements in the order they were created)
+	FOR_EACH_VERTEX(Map, submesh_, it) {
+		if (vertices_.find(it) == vertices_.end())
+			vertices_[it] = new_vertex();
+	}
+	FOR_EACH_HALFEDGE(Map, submesh_, it) {
+		if (halfedges_.find(it) == halfedges_.end())
+			halfedges_[it] = new_halfedge();
+	}
+	FOR_EACH_FACET(Map, submesh_, it) {
+		if (facets_.find(it) == facets_.end()) {
+			facets_[it] = new_facet();
+			if (new_facets)
+				new_facets->push_back(facets_[it]);
+		}
+	}
+
+	FOR_EACH_HALFEDGE(Map, submesh_, it) {
+		Map::Halfedge* h = halfedges_[it];
+		set_halfedge_next(h, halfedges_[it->next()]);
+		set_halfedge_prev(h, halfedges_[it->prev()]);
+		set_halfedge_opposite(h, halfedges_[it->opposite()]);
+		set_halfedge_vertex(h, vertices_[it->vertex()]);
+		set_halfedge_facet(h, it->facet() ? facets_[it->facet()] : nil);
+		to.edge_source_planes[h] = attribs_.edge_source_planes[it];
+	}
+	FOR_EACH_VERTEX(Map, submesh_, it) {
+		Map::Vertex* v = vertices_[it];
+		v->set_point(it->point());
+		set_vertex_halfedge(v, halfedges_[it->halfedge()]);
+		to.vertex_source_planes[v] = attribs_.vertex_source_planes[it];
+	}
+	FOR_EACH_FACET(Map, submesh_, it) {
+		Map::Facet* f = facets_[it];
+		set_facet_halfedge(f, halfedges_[it->halfedge()]);
+		to.color[f] = attribs_.color[it];
+		to.supporting_vertex_group[f] = attribs_.supporting_vertex_group[it];
+		to.supporting_plane[f] = attribs_.supporting_plane[it];
+	}
+
+	set_target(submesh_);
+}
+
+
+namespace {
+
+	// Tests if all the vertices of face 'f' are clearly on the same side of 'plane', i.e., farther than 
+	// twice the snapping distance and than the rounding errors of the plane equation, so that cut() 
+	// would not find any intersection. It is conservative: a face close to the plane is not a miss.
+	bool face_misses_plane(Map::Facet* f, const Plane3d* plane) {
+		const float a = plane->a(), b = plane->b(), c = plane->c(), d = plane->d();
+		const float margin = 2.0f * std::sqrt(float(Method::snap_sqr_distance_threshold)) * std::sqrt(a * a + b * b + c * c);
+		int side = 0;
+		Map::Halfedge* h = f->halfedge();
+		do {
+			const vec3& p = h->vertex()->point();
+			const float v = a * p.x + b * p.y + c * p.z + d;
+			const float error = 1e-5f * (std::abs(a * p.x) + std::abs(b * p.y) + std::abs(c * p.z) + std::abs(d));
+			if (std::abs(v) <= margin + error)
+				return false;
+			int s = (v > 0) ? 1 : -1;
+			if (side != 0 && s != side)
+				return false;
+			side = s;
+			h = h->next();
+		} while (h != f->halfedge());
+		return true;
+	}
+
+
+	// the length of the intersection of (convex) face 'f' and 'plane', i.e., the distance between the
+	// points where the plane crosses the boundary of the face (0 if it misses the face)
+	double chord_length(Map::Facet* f, const Plane3d* plane) {
+		const geom_plane3 p(*plane);
+		std::vector<geom_vec3> crossings;
+		Map::Halfedge* h = f->halfedge();
+		do {
+			const geom_vec3 s(h->opposite()->vertex()->point());
+			const geom_vec3 t(h->vertex()->point());
+			const geom_real vs = p.value(s);
+			const geom_real vt = p.value(t);
+			if (vt == 0)
+				crossings.push_back(t);
+			else if ((vs < 0 && vt > 0) || (vs > 0 && vt < 0))
+				crossings.push_back(s + (t - s) * (vs / (vs - vt)));
+			h = h->next();
+		} while (h != f->halfedge());
+
+		double length = 0;
+		for (std::size_t i = 0; i < crossings.size(); ++i) {
+			for (std::size_t j = i + 1; j < crossings.size(); ++j)
+				length = std::max(length, double(distance(crossings[i], crossings[j])));
+		}
+		return length;
+	}
+
+
+	// a piece of the face being cut, with the cutters (their indices in the order of the cuts) that
+	// may still intersect it, from 'next' on
+	struct FacePiece {
+		FacePiece(MapTypes::Facet* f = nil, MonotonicArena* arena = nil) : face(f), cutters(ArenaAllocator<unsigned int>(arena)), next(0) {}
+
+		MapTypes::Facet*	face;
+		std::vector<unsigned int, ArenaAllocator<unsigned int> >	cutters;
+		std::size_t			next;
+	};
+	typedef std::vector<FacePiece, ArenaAllocator<FacePiece> >	FacePieces;
+
+}
+
+
+std::size_t HypothesisGenerator::cut_facet(MapTypes::Facet* f, const CutterSet& cutting_planes, Map* mesh, CutAttributes& attribs)
+{
+	// f will be cut by all the intersecting_faces
+	// note: after each cut, the original face doesn't exist any more and it is replaced by multiple pieces.
+	//       then each piece will be cut by another face.
+	// note: the pieces are kept in the order they are created (instead of their addresses), such that 
+	//       cutting a copy of the face gives exactly the same result.
+	// note: the planes are ordered by their addresses, which may differ between runs. In the deterministic
+	//       mode the face is cut in the order of the plane indices.
+	// note: with Method::longest_cut_first, the face is cut first by the planes crossing it along the
+	//       longest lines (in the order of the plane indices for the same length), which separate the 
+	//       most cutters from each other, so the pieces are left with fewer cutters.
+	// note: a piece inherits the remaining cutters of the face it was cut from, except those that clearly 
+	//       miss it (see face_misses_plane()), which then are never tested against its own pieces. The 
+	//       other pieces are tested as if no cutter was dropped, so the result is the same.
+	std::vector<Plane3d*> cutters(cutting_planes.begin(), cutting_planes.end());
+	if (Method::deterministic) {
+		std::sort(cutters.begin(), cutters.end(), [this](const Plane3d* a, const Plane3d* b) {
+			return plane_id(a) < plane_id(b);
+		});
+	}
+	if (Method::longest_cut_first) {
+		std::vector< std::pair<double, unsigned int> > order(cutters.size());
+		for (std::size_t i = 0; i < cutters.size(); ++i)
+			order[i] = std::make_pair(-chord_length(f, cutters[i]), plane_id(cutters[i]));
+		std::sort(order.begin(), order.end());
+		for (std::size_t i = 0; i < cutters.size(); ++i)
+			cutters[i] = supporting_planes_[order[i].second];
+	}
+
+	// the pieces are only seen by the cuts, so the observers of the mesh (if any) can wait
+	MapBulkEdit bulk_edit(mesh);
+	MapEditor editor(mesh);
+
+	// the pieces and their cutters only live during the cut, so they are taken from a local arena (on 
+	// the stack first), which frees them at once
+	alignas(std::max_align_t) char buffer[8192];
+	MonotonicArena arena(buffer, sizeof(buffer));
+	const ArenaAllocator<FacePiece> allocator(&arena);
+
+	std::size_t num_cuts = 0;
+	FacePieces pieces(1, FacePiece(f, &arena), allocator);
+	for (unsigned int i = 0; i < cutters.size(); ++i)
+		pieces[0].cutters.push_back(i);
+
+	FacePieces new_pieces(allocator);		// the new faces
+	FacePieces remained_pieces(allocator);	// faces that will be cut later
+	for (unsigned int i = 0; i < cutters.size(); ++i) {
+		new_pieces.clear();
+		remained_pieces.clear();
+		Plane3d* cutter = cutters[i];
+		for (std::size_t j = 0; j < pieces.size(); ++j) {
+			FacePiece& piece = pieces[j];
+			if (piece.next == piece.cutters.size() || piece.cutters[piece.next] != i) {
+				remained_pieces.push_back(std::move(piece));
+				continue;
+			}
+			++piece.next;
+
+			std::vector<MapTypes::Facet*> tmp = cut(piece.face, cutter, editor, attribs);
+			if (tmp.empty()) {
+				remained_pieces.push_back(std::move(piece));
+				continue;
+			}
+			++num_cuts;
+
+			for (std::size_t k = 0; k < tmp.size(); ++k) {
+				FacePiece child(tmp[k], &arena);
+				for (std::size_t l = piece.next; l < piece.cutters.size(); ++l) {
+					unsigned int c = piece.cutters[l];
+					if (face_misses_plane(tmp[k], cutters[c]))
+						num_dropped_cutters.add();
+					else
+						child.cutters.push_back(c);
+				}
+				new_pieces.push_back(std::move(child));
+			}
+		}
+		pieces.swap(new_pieces);
+		for (std::size_t j = 0; j < remained_pieces.size(); ++j)
+			pieces.push_back(std::move(remained_pieces[j]));
+	}
+	return num_cuts;
+}
+
+
+void HypothesisGenerator::collect_face_cutters(Map* mesh, const CutAttributes& attribs, std::vector<MapTypes::Facet*>& all_faces, std::vector<CutterSet>& face_cutters, MonotonicArena& arena)
+{
+	all_faces.clear();
 	FOR_EACH_FACET(Map, mesh, it) {
 		MapTypes::Facet* f = it;
 		all_faces.push_back(f);
 	}
 
-	std::map< MapTypes::Facet*, std::set<Plane3d *> > face_cutters;
+	// a bounding box for each face, such that the cutting planes can be collected without testing all the faces
+	std::vector<Box3d> boxes(all_faces.size());
+	for (std::size_t i = 0; i < all_faces.size(); ++i) {
+		FacetHalfedgeCirculator cir(all_faces[i]);
+		for (; !cir->end(); ++cir)
+			boxes[i].add_point(cir->halfedge()->vertex()->point());
+	}
+	BoxTree tree(boxes);
+
+	// a vertex within the snapping distance counts as an intersection, and the box test is done in a
+	// different precision than the intersection tests. So the tolerance is generous (a few false 
+	// candidates are harmless because they are tested exactly).
+	double tolerance = 2.0 * std::sqrt(Method::snap_sqr_distance_threshold) + 1e-5 * mesh->bbox().radius();
+
+	// in the local mode, two planes only cut each other if the extents of their segments overlap
+	std::vector<SegmentExtent> extents;
+	if (Method::local_hypothesis)
+		compute_segment_extents(Method::local_hypothesis_margin * mesh->bbox().radius(), extents);
+
+	face_cutters.assign(all_faces.size(), CutterSet(std::less<Plane3d*>(), ArenaAllocator<Plane3d*>(&arena)));
     for (std::size_t i = 0; i < all_faces.size(); ++i) {
         MapTypes::Facet *f = all_faces[i];
-        face_cutters[f] = collect_cutting_planes(f, mesh);
+        collect_cutting_planes(f, all_faces, tree, tolerance, attribs, face_cutters[i], Method::local_hypothesis ? &extents : nil);
     }
+}
 
-	ProgressLogger progress(all_faces.size());
-	for (std::size_t i = 0; i < all_faces.size(); ++i) {
-		MapTypes::Facet* f = all_faces[i];
 
-		std::set<Plane3d*>& cutting_planes = face_cutters[f];
-		if (cutting_planes.empty())
-			continue;
+void HypothesisGenerator::pairwise_cut(Map* mesh)
+{
+	CutAttributes attribs(mesh);
+	min_piece_width_ = Method::min_piece_width * pset_->bbox().radius();
+	if (Method::vertex_snapping_registry)
+		vertex_registry_.reset(std::sqrt(Method::snap_sqr_distance_threshold));
 
-		// f will be cut by all the intersecting_faces
-		// note: after each cut, the original face doesn't exist any more and it is replaced by multiple pieces.
-		//       then each piece will be cut by another face.
-		std::vector<MapTypes::Facet*> faces_to_be_cut;
-		faces_to_be_cut.push_back(f);
-		while (!cutting_planes.empty()) {
-			std::set<MapTypes::Facet*> new_faces;		// stores the new faces
-			std::set<MapTypes::Facet*> remained_faces;	// faces that will be cut later
-            Plane3d* cutter = *(cutting_planes.begin());
-			for (std::size_t j = 0; j < faces_to_be_cut.size(); ++j) {
-				MapTypes::Facet* current_face = faces_to_be_cut[j];
-				std::vector<MapTypes::Facet*> tmp = cut(current_face, cutter, mesh);
-				new_faces.insert(tmp.begin(), tmp.end());
-				if (tmp.empty()) {
-					remained_faces.insert(current_face);
-				}
-			}
-			faces_to_be_cut = std::vector<MapTypes::Facet*>(new_faces.begin(), new_faces.end());
-			faces_to_be_cut.insert(faces_to_be_cut.end(), remained_faces.begin(), remained_faces.end());
-            cutting_planes.erase(cutter);
+	// the cutting planes of the faces are freed at once at the end of the stage
+	std::vector<MapTypes::Facet*> all_faces;
+	MonotonicArena arena;
+	std::vector<CutterSet> face_cutters;
+	collect_face_cutters(mesh, attribs, all_faces, face_cutters, arena);
+
+	const std::size_t num_exact = PlanePredicates::num_exact_decisions();
+	if (!Method::parallel_pairwise_cut || parallel_num_threads(Method::num_threads) == 1) {
+		std::size_t num_cuts = 0;
+		ProgressLogger progress(all_faces.size());
+		for (std::size_t i = 0; i < all_faces.size(); ++i) {
+			if (!face_cutters[i].empty())
+				num_cuts += cut_facet(all_faces[i], face_cutters[i], mesh, attribs);
+			progress.next();
 		}
+		Profiler::add_counter("cuts", double(num_cuts));
+		Profiler::add_counter("exact plane predicates", double(PlanePredicates::num_exact_decisions() - num_exact));
+		return;
+	}
+
+	// The faces are processed in batches: each face of a batch is copied and cut by a worker thread 
+	// (the workers only read the original mesh), and then merged back in the original order. The
+	// submeshes are recycled from one batch to the next, so they allocate their memory only once.
+	const std::size_t batch_size = 16 * parallel_num_threads(Method::num_threads);
+	std::vector<Map::Ptr> pool(std::min(batch_size, all_faces.size()));
+	for (std::size_t k = 0; k < pool.size(); ++k)
+		pool[k] = new Map;
 
-		progress.next();
+	std::vector<FacetSubmesh*> submeshes(pool.size(), nil);
+	std::vector<std::size_t> num_cuts(all_faces.size(), 0);
+	ProgressLogger progress(all_faces.size());
+	for (std::size_t first = 0; first < all_faces.size(); first += batch_size) {
+		std::size_t n = std::min(batch_size, all_faces.size() - first);
+		parallel_for(n, [&](std::size_t k) {
+			std::size_t i = first + k;
+			if (face_cutters[i].empty())
+				return;
+			TraceZone zone("cut facet", "generate");
+			pool[k]->recycle();
+			FacetSubmesh* sub = new FacetSubmesh(all_faces[i], pool[k]);
+			sub->extract(attribs);
+			num_cuts[i] = cut_facet(sub->facet_copy(), face_cutters[i], sub->submesh(), sub->attributes());
+			submeshes[k] = sub;
+		}, &progress, Method::num_threads);
+
+		for (std::size_t k = 0; k < n; ++k) {
+			if (submeshes[k]) {
+				submeshes[k]->merge_into(mesh, attribs);
+				delete submeshes[k];
+				submeshes[k] = nil;
+			}
+		}
 	}
+	Profiler::add_counter("cuts", double(std::accumulate(num_cuts.begin(), num_cuts.end(), std::size_t(0))));
+	Profiler::add_counter("exact plane predicates", double(PlanePredicates::num_exact_decisions() - num_exact));
 }
 
 
+// the relative determinant of the normals below which three planes are nearly degenerate (see
+// plane_triplet_intersections()), so that their intersection is left to CGAL
+static const geom_real triplet_min_det = geom_real(1024) * std::numeric_limits<geom_real>::epsilon();
+
+
 // compute the intersection of a plane triplet
 // returns true if the intersection exists (p returns the point)
-bool HypothesisGenerator::intersection_plane_triplet(const Plane3d* plane1, const Plane3d* plane2, const Plane3d* plane3, vec3& p) {
+bool HypothesisGenerator::intersection_plane_triplet(const Plane3d* plane1, const Plane3d* plane2, const Plane3d* plane3, vec3& p) const {
 	if (plane1 == nil || plane2 == nil || plane3 == nil) {
 		Logger::err("-") << "null planes" << std::endl;
 		return false;
@@ -813,6 +2239,15 @@ bool HypothesisGenerator::intersection_plane_triplet(const Plane3d* plane1, cons
 		return false;
 	}
 
+	// in the precision of the geometric computations (see geom_real), from the coefficients of the 
+	// planes (instead of CGAL planes rebuilt from a point and a normal rounded to floats)
+	geom_vec3 q;
+	if (plane_triplet_intersection(geom_plane3(*plane1), geom_plane3(*plane2), geom_plane3(*plane3), q, triplet_min_det)) {
+		p = vec3(q);
+		return true;
+	}
+
+	// the (nearly) degenerate cases, told apart by CGAL
 	CGAL::Object obj = CGAL::intersection(to_cgal_plane(*plane1), to_cgal_plane(*plane2), to_cgal_plane(*plane3));
 
 	// pt is the intersection point of the 3 planes 
@@ -836,31 +2271,129 @@ bool HypothesisGenerator::intersection_plane_triplet(const Plane3d* plane1, cons
 void HypothesisGenerator::triplet_intersection() {
 	triplet_intersection_.clear();
 
-	std::sort(supporting_planes_.begin(), supporting_planes_.end());
+	// the triplets will be computed on demand by query_intersection()
+	if (Method::lazy_triplet_intersection)
+		return;
+
+	// the triplets (i, j, k) of each pair (i, j) are solved in one batch, and only the nearly 
+	// degenerate ones go through intersection_plane_triplet()
+	const std::size_t n = supporting_planes_.size();
+	std::vector<geom_plane3> planes(n);
+	for (std::size_t i = 0; i < n; ++i)
+		planes[i] = geom_plane3(*supporting_planes_[i]);
+	std::vector<geom_vec3> points(n);
+	std::vector<unsigned char> valid(n);
+
+	std::size_t num_degenerate = 0;
+	for (std::size_t i = 0; i < n; ++i) {
+		for (std::size_t j = i + 1; j < n; ++j) {
+			std::size_t m = n - j - 1;
+			plane_triplet_intersections(planes[i], planes[j], planes.data() + j + 1, m, triplet_min_det, points.data(), valid.data());
+			for (std::size_t l = 0; l < m; ++l) {
+				std::size_t k = j + 1 + l;
+				if (valid[l])
+					triplet_intersection_.insert(i, j, k, vec3(points[l])); // store the intersection in our data base
+				else {
+					++num_degenerate;
+					vec3 p;
+					if (intersection_plane_triplet(supporting_planes_[i], supporting_planes_[j], supporting_planes_[k], p))
+						triplet_intersection_.insert(i, j, k, p);
+				}
+			}
+		}
+	}
+	Profiler::add_counter("degenerate triplets", double(num_degenerate));
+}
+
 
-	for (std::size_t i = 0; i < supporting_planes_.size(); ++i) {
-		Plane3d* plane1 = supporting_planes_[i];
-		for (std::size_t j = i + 1; j < supporting_planes_.size(); ++j) {
-			Plane3d* plane2 = supporting_planes_[j];
-			for (std::size_t k = j + 1; k < supporting_planes_.size(); ++k) {
-				Plane3d* plane3 = supporting_planes_[k];
+namespace {
 
-				assert(plane1 < plane2);
-				assert(plane2 < plane3);
+	// The short edges of a mesh, in the order of the halfedges. The halfedges removed by collapsing
+	// an edge are dropped from the queue (through the observer callbacks).
+	class ShortEdgeQueue : public MapCombelObserver<Map::Halfedge>
+	{
+	public:
+		ShortEdgeQueue(Map* mesh, double sqr_threshold) : MapCombelObserver<Map::Halfedge>(mesh), sqr_threshold_(sqr_threshold) {
+			FOR_EACH_HALFEDGE(Map, mesh, it) {
+				std::size_t r = halfedges_.size();
+				rank_[it] = r;
+				halfedges_.push_back(it);
+			}
+			FOR_EACH_EDGE(Map, mesh, it)
+				update(it);
+		}
 
-				vec3 p;
-				if (intersection_plane_triplet(plane1, plane2, plane3, p)) {
-					vec3* new_point = new vec3(p);
-					triplet_intersection_[plane1][plane2][plane3] = new_point; // store the intersection in our data base
-					intersecting_points_.push_back(new_point);
+		virtual void remove(Map::Halfedge* h) {
+			std::unordered_map<Map::Halfedge*, std::size_t>::iterator pos = rank_.find(h);
+			if (pos != rank_.end()) {
+				queue_.erase(pos->second);
+				rank_.erase(pos);
+			}
+		}
+
+		// Collapses the short edges in the same order as rescanning all the edges after each collapse, 
+		// i.e., always the first collapsible short edge. A collapse does not create halfedges and the 
+		// remaining vertex keeps its position, so only the edges around that vertex can change their 
+		// lengths. Returns the number of collapsed edges ('num_failed' returns the number of short 
+		// edges that cannot be collapsed).
+		int collapse(MapEditor& editor, std::size_t& num_failed) {
+			int count = 0;
+			std::set<std::size_t>::iterator it = queue_.begin();
+			while (it != queue_.end()) {
+				Map::Halfedge* h = halfedges_[*it];
+				Map::Vertex* v = h->vertex();
+				if (editor.collapse_edge(h)) {	// 'it' is invalidated
+					++count;
+					Map::Halfedge* cir = v->halfedge();
+					do {
+						update(cir->edge_key());
+						cir = cir->next_around_vertex();
+					} while (cir != v->halfedge());
+					it = queue_.begin();
 				}
+				else
+					++it;
 			}
+			num_failed = queue_.size();
+			return count;
 		}
-	}
+
+	private:
+		void update(Map::Halfedge* e) {
+			std::size_t r = rank_[e];
+			if (distance2(e->vertex()->point(), e->prev()->vertex()->point()) < sqr_threshold_)
+				queue_.insert(r);
+			else
+				queue_.erase(r);
+		}
+
+	private:
+		double sqr_threshold_;
+		std::vector<Map::Halfedge*>						halfedges_;
+		std::unordered_map<Map::Halfedge*, std::size_t>	rank_;
+		std::set<std::size_t>							queue_;
+	};
+
 }
 
 
 void HypothesisGenerator::remove_degenerated_facets(Map* mesh) {
+	if (Method::fast_degenerate_removal) {
+		MapEditor editor(mesh);
+		std::size_t num_failed = 0;
+		int count = 0;
+		{
+			ShortEdgeQueue queue(mesh, Method::snap_sqr_distance_threshold);
+			count = queue.collapse(editor, num_failed);
+		}
+		if (count > 0)
+			Logger::out("-") << count << " degenerate edges collapsed" << std::endl;
+		Profiler::add_counter("edges collapsed", count);
+		if (num_failed > 0)
+			Logger::warn("-") << num_failed << " degenerate edges could not be collapsed" << std::endl;
+		return;
+	}
+
 	// You can't collect all the edges and then collapse them one by one, 
 	// because collapsing one edge affects other neighboring edges.
 	// std::vector<Map::Halfedge*> to_collapse;
@@ -884,38 +2417,68 @@ void HypothesisGenerator::remove_degenerated_facets(Map* mesh) {
 
 	if (count > 0)
 		Logger::out("-") << count << " degenerate edges collapsed" << std::endl;
+	Profiler::add_counter("edges collapsed", count);
 }
 
 
-vec3* HypothesisGenerator::query_intersection(Plane3d* plane1, Plane3d* plane2, Plane3d* plane3) {
-	Plane3d* min_plane = ogf_min(plane1, plane2, plane3);
-	Plane3d* max_plane = ogf_max(plane1, plane2, plane3);
+void HypothesisGenerator::compact_mesh(Map* mesh) {
+	if (mesh->size_of_facets() == 0)
+		return;
 
-	Plane3d* mid_plane = 0;
-	if (plane1 != min_plane && plane1 != max_plane)
-		mid_plane = plane1;
-	else if (plane2 != min_plane && plane2 != max_plane)
-		mid_plane = plane2;
-	else if (plane3 != min_plane && plane3 != max_plane)
-		mid_plane = plane3;
+	Box3d box = Geom::bounding_box(mesh);
+	std::vector< std::pair<std::pair<unsigned int, Numeric::uint64>, Map::Facet*> > keys;
+	keys.reserve(mesh->size_of_facets());
+	FOR_EACH_FACET(Map, mesh, f) {
+		unsigned int id = plane_id(facet_attrib_supporting_plane_[f]);
+		keys.push_back(std::make_pair(std::make_pair(id, Geom::morton_code(Geom::facet_center(f), box)), f));
+	}
+	std::stable_sort(keys.begin(), keys.end(), 
+		[](const std::pair<std::pair<unsigned int, Numeric::uint64>, Map::Facet*>& a, const std::pair<std::pair<unsigned int, Numeric::uint64>, Map::Facet*>& b) {
+			return a.first < b.first; 
+		}
+	);
 
-	if (triplet_intersection_.find(min_plane) == triplet_intersection_.end())
-		return 0;
+	std::vector<Map::Facet*> facets(keys.size());
+	for (std::size_t i = 0; i < keys.size(); ++i)
+		facets[i] = keys[i].second;
+	mesh->compact(facets);
+}
 
-	std::map<Plane3d*, std::map<Plane3d*, vec3*> >& tmp2 = triplet_intersection_[min_plane];
-	if (tmp2.find(mid_plane) == tmp2.end())
-		return 0;
 
-	std::map<Plane3d*, vec3*>& tmp3 = tmp2[mid_plane];
-	if (tmp3.find(max_plane) == tmp3.end())
-		return 0;
+const vec3* HypothesisGenerator::query_intersection(unsigned int i, unsigned int j, unsigned int k) const {
+	if (!Method::lazy_triplet_intersection) {
+		const vec3* p = triplet_intersection_.find(i, j, k);
+		if (p)
+			num_triplet_hits.add();
+		else
+			num_triplet_misses.add();
+		return p;
+	}
 
-	return tmp3[max_plane];
+	// the table may grow, so the (possibly concurrent) queries are serialized
+	std::lock_guard<std::mutex> lock(triplet_intersection_mutex_);
+	const vec3* p = triplet_intersection_.find(i, j, k);
+	if (p) {
+		num_triplet_hits.add();
+		return p;
+	}
+	num_triplet_misses.add();
+
+	// the planes are always passed in the order of their indices (as the eager precomputation 
+	// does), so a triplet gives the same point regardless of the order it is queried
+	if (i > j) std::swap(i, j);
+	if (j > k) std::swap(j, k);
+	if (i > j) std::swap(i, j);
+	vec3 q;
+	if (intersection_plane_triplet(supporting_planes_[i], supporting_planes_[j], supporting_planes_[k], q))
+		return triplet_intersection_.insert(i, j, k, q); // first wins: the stored point never changes
+	return nil;
 }
 
 
 
 Map* HypothesisGenerator::generate() {
+	ScopedThreadBudget budget(thread_budget());
 	if (!pset_)
 		return nil;
 
@@ -924,12 +2487,28 @@ Map* HypothesisGenerator::generate() {
 		return nil;
 	}
 
+	ProfileStage stage("generate");
+
+	if (Method::reorder_points_spatially) {
+		ProfileStage stage("reorder_points_spatially");
+		pset_->reorder_spatially();
+	}
+	if (Method::reorder_points_by_groups) {
+		ProfileStage stage("reorder_points");
+		pset_->reorder_by_groups();
+	}
+
 	collect_valid_planes();
 
-	Map* bbox_mesh = construct_bbox_mesh();
-	Map* mesh = compute_proxy_mesh(bbox_mesh);
-	if (!mesh)
-		return nil;
+	Map* mesh = nil;
+	{
+		ProfileStage stage("compute_proxy_mesh");
+		Map* bbox_mesh = construct_bbox_mesh();
+		mesh = compute_proxy_mesh(bbox_mesh);
+		if (!mesh)
+			return nil;
+		Profiler::add_counter("proxy faces", mesh->size_of_facets());
+	}
 
 	check_source_planes(mesh);
 
@@ -938,14 +2517,39 @@ Map* HypothesisGenerator::generate() {
 	edge_source_planes_.bind(mesh, "EdgeSourcePlanes");
 	vertex_source_planes_.bind(mesh, "VertexSourcePlanes");
 
-	triplet_intersection();
-	pairwise_cut(mesh);
+	{
+		ProfileStage stage("triplet_intersection");
+		triplet_intersection();
+		Profiler::add_counter("triplets computed", double(triplet_intersection_.size()));
+	}
+	{
+		ProfileStage stage(Method::plane_arrangement ? "plane_arrangement" : "pairwise_cut");
+		if (Method::plane_arrangement)
+			arrange_planes(mesh);
+		else
+			pairwise_cut(mesh);
+		Profiler::add_counter("faces created", mesh->size_of_facets());
+	}
 	check_source_planes(mesh);
 
-	remove_degenerated_facets(mesh);
+	{
+		ProfileStage stage("remove_degenerated_facets");
+		remove_degenerated_facets(mesh);
+	}
 	check_source_planes(mesh);
+	Profiler::add_counter("candidate faces", mesh->size_of_facets());
 
-	facet_attrib_supporting_vertex_group_.unbind();
+	{
+		ProfileStage stage("compact_mesh");
+		compact_mesh(mesh);
+	}
+
+	// with the source planes, which are dropped below
+	mesh->memory_usage().add_to_profile("candidate mesh");
+	memory_usage().add_to_profile("hypothesis generator");
+	pset_->memory_usage().add_to_profile("point set");
+
+	facet_attrib_supporting_vertex_group_.unbind();
 	facet_attrib_supporting_plane_.unbind();
 	edge_source_planes_.unbind();
 	vertex_source_planes_.unbind();
@@ -954,17 +2558,776 @@ Map* HypothesisGenerator::generate() {
 }
 
 
+namespace {
+
+	// Deletes faces together with their halfedges and vertices. The faces must make up entire connected 
+	// components (in the candidate mesh, the faces of each plane are not connected to other faces).
+	class FacetEraser : public MapMutator
+	{
+	public:
+		FacetEraser(Map* mesh) : MapMutator(mesh) {}
+
+		void erase(const std::vector<Map::Facet*>& facets) {
+			std::set<Halfedge*>	halfedges;
+			std::set<Vertex*>	vertices;
+			for (std::size_t i = 0; i < facets.size(); ++i) {
+				Halfedge* h = facets[i]->halfedge();
+				do {
+					halfedges.insert(h);
+					halfedges.insert(h->opposite());
+					vertices.insert(h->vertex());
+					h = h->next();
+				} while (h != facets[i]->halfedge());
+			}
+
+			for (std::size_t i = 0; i < facets.size(); ++i)
+				delete_facet(facets[i]);
+			for (std::set<Halfedge*>::iterator it = halfedges.begin(); it != halfedges.end(); ++it)
+				delete_halfedge(*it);
+			for (std::set<Vertex*>::iterator it = vertices.begin(); it != vertices.end(); ++it)
+				delete_vertex(*it);
+		}
+	};
+
+}
+
+
+std::size_t HypothesisGenerator::compute_arrangements(Map* mesh, const CutAttributes& attribs, std::vector<MapTypes::Facet*>& all_faces, std::vector<PlaneArrangement*>& arrangements)
+{
+	MonotonicArena arena;
+	std::vector<CutterSet> face_cutters;
+	collect_face_cutters(mesh, attribs, all_faces, face_cutters, arena);
+
+	// The arrangements only read the mesh, and each one is independent of the others, so they are 
+	// computed in parallel. The lines are inserted in the order of the plane indices.
+	const geom_real snap_distance = std::sqrt(geom_real(Method::snap_sqr_distance_threshold));
+	arrangements.assign(all_faces.size(), nil);
+	std::vector<std::size_t> num_splits(all_faces.size(), 0);
+	ProgressLogger progress(all_faces.size());
+	parallel_for(all_faces.size(), [&](std::size_t i) {
+		TraceZone zone("arrange plane", "generate");
+
+		MapTypes::Facet* f = all_faces[i];
+		const geom_plane3 plane(*attribs.supporting_plane[f]);
+		const geom_vec3 origin = plane.point();
+		const geom_vec3 base1 = plane.base1();
+		const geom_vec3 base2 = plane.base2();
+
+		std::vector<PlaneArrangement::Point> points;
+		std::vector< PlaneIdSet<3> > point_planes;
+		std::vector< PlaneIdSet<2> > edge_planes;
+		Map::Halfedge* h = f->halfedge();
+		do {
+			geom_vec3 v = geom_vec3(h->vertex()->point()) - origin;
+			points.push_back(PlaneArrangement::Point(dot(v, base1), dot(v, base2)));
+			point_planes.push_back(attribs.vertex_source_planes[h->vertex()]);
+			edge_planes.push_back(attribs.edge_source_planes[h->next()]);
+			h = h->next();
+		} while (h != f->halfedge());
+
+		PlaneArrangement* arrangement = new PlaneArrangement(plane_id(attribs.supporting_plane[f]), snap_distance);
+		arrangement->set_boundary(points, point_planes, edge_planes);
+
+		std::vector<Plane3d*> cutters(face_cutters[i].begin(), face_cutters[i].end());
+		std::sort(cutters.begin(), cutters.end(), [this](const Plane3d* a, const Plane3d* b) {
+			return plane_id(a) < plane_id(b);
+		});
+		for (std::size_t j = 0; j < cutters.size(); ++j) {
+			// the signed distance to the cutter, in the frame of the plane
+			const geom_plane3 cutter(*cutters[j]);
+			const geom_vec3 n(cutter.a(), cutter.b(), cutter.c());
+			const geom_real len = length(n);
+			if (len <= 0)
+				continue;
+			const geom_real a = dot(n, base1) / len;
+			const geom_real b = dot(n, base2) / len;
+			const geom_real c = cutter.value(origin) / len;
+			num_splits[i] += arrangement->insert_line(plane_id(cutters[j]), a, b, c);
+		}
+		arrangements[i] = arrangement;
+	}, &progress, Method::parallel_pairwise_cut ? Method::num_threads : 1);
+
+	return std::accumulate(num_splits.begin(), num_splits.end(), std::size_t(0));
+}
+
+
+vec3 HypothesisGenerator::arrangement_point(const Plane3d* plane, const PlaneArrangement::Vertex& v) const {
+	// the shared intersection of the three planes if it exists, or else the point on the plane
+	const PlaneIdSet<3>& planes = v.planes;
+	const vec3* p = (planes.size() == 3) ? query_intersection(planes[0], planes[1], planes[2]) : nil;
+	if (p)
+		return *p;
+	const geom_plane3 q(*plane);
+	const geom_vec3 r = q.point() + q.base1() * v.p.x + q.base2() * v.p.y;
+	return vec3(float(r.x), float(r.y), float(r.z));
+}
+
+
+void HypothesisGenerator::arrange_planes(Map* mesh)
+{
+	CutAttributes attribs(mesh);
+
+	std::vector<MapTypes::Facet*> all_faces;
+	std::vector<PlaneArrangement*> arrangements;
+	std::size_t num_splits = compute_arrangements(mesh, attribs, all_faces, arrangements);
+
+	// the faces of the arrangements replace the proxy faces
+	FacetSubmesh cells(nil, new Map);
+	CutAttributes& cell_attribs = cells.attributes();
+	MapBuilder builder(cells.submesh());
+	builder.begin_surface();
+	int offset = 0;
+	for (std::size_t i = 0; i < all_faces.size(); ++i) {
+		PlaneArrangement* arrangement = arrangements[i];
+		MapTypes::Facet* proxy = all_faces[i];
+
+		Plane3d* plane = attribs.supporting_plane[proxy];
+		const std::vector<PlaneArrangement::Vertex>& vertices = arrangement->vertices();
+		for (std::size_t k = 0; k < vertices.size(); ++k) {
+			builder.add_vertex(arrangement_point(plane, vertices[k]));
+			cell_attribs.vertex_source_planes[builder.current_vertex()] = vertices[k].planes;
+		}
+
+		const std::vector<PlaneArrangement::Face>& faces = arrangement->faces();
+		for (std::size_t k = 0; k < faces.size(); ++k) {
+			const PlaneArrangement::Face& face = faces[k];
+			std::size_t num_facets = cells.submesh()->size_of_facets();
+			builder.begin_facet();
+			for (std::size_t j = 0; j < face.vertices.size(); ++j)
+				builder.add_vertex_to_facet(offset + int(face.vertices[j]));
+			builder.end_facet();
+			if (cells.submesh()->size_of_facets() == num_facets)
+				continue;	// rejected by the builder
+
+			Map::Facet* f = builder.current_facet();
+			cell_attribs.color[f] = attribs.color[proxy];
+			cell_attribs.supporting_vertex_group[f] = attribs.supporting_vertex_group[proxy];
+			cell_attribs.supporting_plane[f] = plane;
+
+			// the halfedge ending at the (j + 1)-th vertex is the edge from the j-th vertex
+			FacetHalfedgeCirculator cir(f);
+			for (; !cir->end(); ++cir) {
+				MapTypes::Halfedge* e = cir->halfedge();
+				for (std::size_t j = 0; j < face.vertices.size(); ++j) {
+					if (builder.vertex(offset + int(face.vertices[(j + 1) % face.vertices.size()])) == e->vertex()) {
+						cell_attribs.edge_source_planes[e] = face.edges[j];
+						break;
+					}
+				}
+			}
+		}
+		offset += int(vertices.size());
+		delete arrangement;
+	}
+	builder.end_surface();
+
+	FOR_EACH_HALFEDGE(Map, cells.submesh(), it) {
+		if (it->facet() == nil)
+			cell_attribs.edge_source_planes[it] = cell_attribs.edge_source_planes[it->opposite()];
+	}
+
+	FacetEraser(mesh).erase(all_faces);
+	cells.merge_into(mesh, attribs);
+
+	Profiler::add_counter("cuts", double(num_splits));
+}
+
+
+ImplicitHypothesis* HypothesisGenerator::generate_implicit() {
+	ScopedThreadBudget budget(thread_budget());
+	if (!pset_)
+		return nil;
+
+	if (pset_->groups().empty()) {
+		Logger::warn("-") << "planar segments do not exist" << std::endl;
+		return nil;
+	}
+
+	ProfileStage stage("generate_implicit");
+
+	if (Method::reorder_points_spatially) {
+		ProfileStage stage("reorder_points_spatially");
+		pset_->reorder_spatially();
+	}
+	if (Method::reorder_points_by_groups) {
+		ProfileStage stage("reorder_points");
+		pset_->reorder_by_groups();
+	}
+
+	collect_valid_planes();
+
+	Map::Ptr proxy_mesh;
+	{
+		ProfileStage stage("compute_proxy_mesh");
+		Map* bbox_mesh = construct_bbox_mesh();
+		proxy_mesh = compute_proxy_mesh(bbox_mesh);
+		delete bbox_mesh;
+		if (!proxy_mesh)
+			return nil;
+		Profiler::add_counter("proxy faces", proxy_mesh->size_of_facets());
+	}
+	{
+		ProfileStage stage("triplet_intersection");
+		triplet_intersection();
+		Profiler::add_counter("triplets computed", double(triplet_intersection_.size()));
+	}
+
+	ImplicitHypothesis* hypothesis = new ImplicitHypothesis;
+	{
+		ProfileStage stage("plane_arrangement");
+		CutAttributes attribs(proxy_mesh);
+		std::vector<MapTypes::Facet*> proxy_faces;
+		std::vector<PlaneArrangement*> arrangements;
+		std::size_t num_splits = compute_arrangements(proxy_mesh, attribs, proxy_faces, arrangements);
+
+		hypothesis->face_offsets_.push_back(0);
+		for (std::size_t i = 0; i < proxy_faces.size(); ++i) {
+			PlaneArrangement* arrangement = arrangements[i];
+			Plane3d* plane = attribs.supporting_plane[proxy_faces[i]];
+			unsigned int id = plane_id(plane);
+			VertexGroup* g = attribs.supporting_vertex_group[proxy_faces[i]];
+
+			const unsigned int offset = static_cast<unsigned int>(hypothesis->points_.size());
+			const std::vector<PlaneArrangement::Vertex>& vertices = arrangement->vertices();
+			for (std::size_t k = 0; k < vertices.size(); ++k) {
+				hypothesis->points_.push_back(arrangement_point(plane, vertices[k]));
+				hypothesis->vertex_planes_.push_back(vertices[k].planes);
+			}
+
+			const std::vector<PlaneArrangement::Face>& faces = arrangement->faces();
+			for (std::size_t k = 0; k < faces.size(); ++k) {
+				const PlaneArrangement::Face& face = faces[k];
+				for (std::size_t j = 0; j < face.vertices.size(); ++j) {
+					// the plane of the edge other than the supporting plane (the supporting plane if unknown)
+					const PlaneIdSet<2>& edge = face.edges[j];
+					unsigned int other = id;
+					for (std::size_t l = 0; l < edge.size(); ++l) {
+						if (edge[l] != id)
+							other = edge[l];
+					}
+					hypothesis->corner_vertices_.push_back(offset + face.vertices[j]);
+					hypothesis->corner_edge_planes_.push_back(other);
+				}
+				hypothesis->face_planes_.push_back(id);
+				hypothesis->face_segments_.push_back(g);
+				hypothesis->face_offsets_.push_back(hypothesis->corner_vertices_.size());
+			}
+			delete arrangement;
+		}
+		Profiler::add_counter("cuts", double(num_splits));
+	}
+	Profiler::add_counter("candidate faces", double(hypothesis->num_faces()));
+
+	hypothesis->memory_usage().add_to_profile("implicit hypothesis");
+	memory_usage().add_to_profile("hypothesis generator");
+	pset_->memory_usage().add_to_profile("point set");
+	return hypothesis;
+}
+
+
+Map* HypothesisGenerator::materialize(const ImplicitHypothesis* hypothesis, const std::vector<std::size_t>* faces, std::vector<MapTypes::Facet*>* facets) const {
+	if (!hypothesis)
+		return nil;
+
+	std::vector<std::size_t> all_faces;
+	if (!faces) {
+		all_faces.resize(hypothesis->num_faces());
+		for (std::size_t i = 0; i < all_faces.size(); ++i)
+			all_faces[i] = i;
+		faces = &all_faces;
+	}
+	if (facets)
+		facets->assign(faces->size(), nil);
+
+	Map* mesh = new Map;
+	CutAttributes attribs(mesh);
+	MapFacetAttribute<double> supporting_point_num, facet_area, covered_area;
+	if (hypothesis->has_statistics()) {
+		supporting_point_num.bind(mesh, Method::facet_attrib_supporting_point_num);
+		facet_area.bind(mesh, Method::facet_attrib_facet_area);
+		covered_area.bind(mesh, Method::facet_attrib_covered_area);
+	}
+
+	// the vertices are added when they are first used
+	std::unordered_map<unsigned int, int> builder_vertices;
+	MapBuilder builder(mesh);
+	builder.begin_surface();
+	for (std::size_t i = 0; i < faces->size(); ++i) {
+		std::size_t f = (*faces)[i];
+		std::size_t begin = hypothesis->face_begin(f);
+		std::size_t end = hypothesis->face_end(f);
+		for (std::size_t c = begin; c < end; ++c) {
+			unsigned int v = hypothesis->corner_vertex(c);
+			if (builder_vertices.find(v) == builder_vertices.end()) {
+				builder_vertices[v] = static_cast<int>(builder_vertices.size());
+				builder.add_vertex(hypothesis->point(v));
+				attribs.vertex_source_planes[builder.current_vertex()] = hypothesis->vertex_planes(v);
+			}
+		}
+
+		std::size_t num_facets = mesh->size_of_facets();
+		builder.begin_facet();
+		for (std::size_t c = begin; c < end; ++c)
+			builder.add_vertex_to_facet(builder_vertices[hypothesis->corner_vertex(c)]);
+		builder.end_facet();
+		if (mesh->size_of_facets() == num_facets)
+			continue;	// rejected by the builder
+
+		Map::Facet* facet = builder.current_facet();
+		if (facets)
+			(*facets)[i] = facet;
+		unsigned int id = hypothesis->face_plane(f);
+		VertexGroup* g = hypothesis->face_segment(f);
+		attribs.color[facet] = g ? g->color() : Color();
+		attribs.supporting_vertex_group[facet] = g;
+		attribs.supporting_plane[facet] = supporting_planes_[id];
+		if (hypothesis->has_statistics()) {
+			const ImplicitHypothesis::FaceStatistics& stats = hypothesis->statistics(f);
+			supporting_point_num[facet] = stats.supporting_point_num;
+			facet_area[facet] = stats.area;
+			covered_area[facet] = stats.covered_area;
+		}
+
+		// the halfedge ending at the next corner is the edge from the corner
+		FacetHalfedgeCirculator cir(facet);
+		for (; !cir->end(); ++cir) {
+			MapTypes::Halfedge* e = cir->halfedge();
+			for (std::size_t c = begin; c < end; ++c) {
+				std::size_t next = (c + 1 == end) ? begin : c + 1;
+				if (builder.vertex(builder_vertices[hypothesis->corner_vertex(next)]) == e->vertex()) {
+					PlaneIdSet<2> planes;
+					planes.insert(id);
+					planes.insert(hypothesis->corner_edge_plane(c));
+					attribs.edge_source_planes[e] = planes;
+					break;
+				}
+			}
+		}
+	}
+	builder.end_surface();
+
+	FOR_EACH_HALFEDGE(Map, mesh, it) {
+		if (it->facet() == nil)
+			attribs.edge_source_planes[it] = attribs.edge_source_planes[it->opposite()];
+	}
+	return mesh;
+}
+
+
+void HypothesisGenerator::compute_confidences(ImplicitHypothesis* hypothesis, bool use_conficence /* = false */) {
+	ScopedThreadBudget budget(thread_budget());
+	if (!hypothesis)
+		return;
+
+	ProfileStage stage("compute_confidences");
+
+	downsample_points();
+	ProgressLogger progress(pset_->num_points() + hypothesis->num_faces());
+	prepare_confidences(use_conficence, &progress);
+
+	StopWatch w;
+	Logger::out("-") << "computing face confidences..." << std::endl;
+
+	// the faces of each plane are contiguous, and only the faces of one plane exist as a mesh at a time
+	ProfileStage facet_stage("compute_facet_confidences");
+	hypothesis->statistics_.assign(hypothesis->num_faces(), ImplicitHypothesis::FaceStatistics());
+	std::size_t first = 0;
+	while (first < hypothesis->num_faces()) {
+		std::size_t last = first + 1;
+		while (last < hypothesis->num_faces() && hypothesis->face_plane(last) == hypothesis->face_plane(first))
+			++last;
+
+		std::vector<std::size_t> faces;
+		for (std::size_t i = first; i < last; ++i)
+			faces.push_back(i);
+		std::vector<MapTypes::Facet*> facets;
+		Map::Ptr mesh = materialize(hypothesis, &faces, &facets);
+
+		std::vector<MapTypes::Facet*> valid;
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			if (facets[i])
+				valid.push_back(facets[i]);
+		}
+		compute_facet_confidences(mesh, valid, &progress);
+
+		MapFacetAttribute<double> supporting_point_num(mesh, Method::facet_attrib_supporting_point_num);
+		MapFacetAttribute<double> facet_area(mesh, Method::facet_attrib_facet_area);
+		MapFacetAttribute<double> covered_area(mesh, Method::facet_attrib_covered_area);
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			if (!facets[i])
+				continue;
+			ImplicitHypothesis::FaceStatistics& stats = hypothesis->statistics_[faces[i]];
+			stats.supporting_point_num = supporting_point_num[facets[i]];
+			stats.area = facet_area[facets[i]];
+			stats.covered_area = covered_area[facets[i]];
+		}
+		first = last;
+	}
+	Profiler::add_counter("faces", double(hypothesis->num_faces()));
+
+	Logger::out("-") << "done. " << w.elapsed() << " sec." << std::endl;
+}
+
+
+bool HypothesisGenerator::regenerate(Map* mesh, const std::vector<VertexGroup*>& edited_segments) {
+	ScopedThreadBudget budget(thread_budget());
+	if (!mesh || !pset_)
+		return false;
+
+	if (bbox_planes_.size() != 6) {
+		Logger::warn("-") << "candidate faces do not exist. Please generate them first" << std::endl;
+		return false;
+	}
+
+	// editing a segment snapped to a shared plane (see regularize_planes()) dissolves its cluster: all the
+	// segments of the cluster get their own planes
+	std::vector<VertexGroup*> segments(edited_segments);
+	if (!snapped_segments_.empty()) {
+		std::set<VertexGroup*> representatives;
+		for (std::size_t i = 0; i < edited_segments.size(); ++i) {
+			std::map<VertexGroup*, VertexGroup*>::const_iterator pos = snapped_segments_.find(edited_segments[i]);
+			representatives.insert(pos != snapped_segments_.end() ? pos->second : edited_segments[i]);
+		}
+		std::map<VertexGroup*, VertexGroup*>::iterator it = snapped_segments_.begin();
+		while (it != snapped_segments_.end()) {
+			if (representatives.find(it->second) == representatives.end()) {
+				++it;
+				continue;
+			}
+			segments.push_back(it->first);
+			segments.push_back(it->second);
+			snapped_segments_.erase(it++);
+		}
+	}
+
+	StopWatch w;
+	Logger::out("-") << "regenerating candidate faces for " << segments.size() << " edited segments..." << std::endl;
+
+	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	std::set<VertexGroup*> existing;
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		existing.insert(groups[i]);
+
+	// The edited segments get new planes (with new indices), so the intersections of all the other 
+	// planes remain valid. The old planes are kept (unused) in 'supporting_planes_'.
+	std::vector<VertexGroup::Ptr> old_segments = plane_segments_;	// the dropped segments are released at the end
+	std::set<unsigned int> retired_planes;
+	std::vector<Plane3d*> new_planes;
+	std::set<VertexGroup*> edited;
+	for (std::size_t i = 0; i < segments.size(); ++i) {
+		VertexGroup* g = segments[i];
+		if (!edited.insert(g).second)
+			continue;
+
+		std::map<VertexGroup*, Plane3d*>::iterator pos = vertex_group_plane_.find(g);
+		if (pos != vertex_group_plane_.end()) {
+			retired_planes.insert(plane_id(pos->second));
+			vertex_group_plane_.erase(pos);
+		}
+
+		if (existing.find(g) != existing.end() && !g->empty()) {
+			pset_->fit_plane(g);
+			Plane3d* plane = add_supporting_plane(g->plane());
+			vertex_group_plane_[g] = plane;
+			new_planes.push_back(plane);
+		}
+	}
+
+	plane_segments_.clear();
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		if (vertex_group_plane_.find(groups[i]) != vertex_group_plane_.end() && snapped_segments_.find(groups[i]) == snapped_segments_.end())
+			plane_segments_.push_back(groups[i]);
+	}
+
+	// the triplets involving the new planes (which have the largest indices)
+	if (!Method::lazy_triplet_intersection) {
+		for (std::size_t n = 0; n < new_planes.size(); ++n) {
+			unsigned int k = plane_id(new_planes[n]);
+			for (unsigned int i = 0; i < k; ++i) {
+				for (unsigned int j = i + 1; j < k; ++j) {
+					vec3 p;
+					if (intersection_plane_triplet(supporting_planes_[i], supporting_planes_[j], supporting_planes_[k], p))
+						triplet_intersection_.insert(i, j, k, p);
+				}
+			}
+		}
+	}
+
+	// The proxy faces of all the planes and their cutting planes, by which the planes to be rebuilt 
+	// are decided: the new planes, and the planes whose proxy faces are cut by a new plane.
+	Map* bbox_mesh = construct_bbox_mesh();
+	FacetSubmesh proxy(nil, compute_proxy_mesh(bbox_mesh));
+	delete bbox_mesh;
+
+	std::vector<MapTypes::Facet*> proxy_faces;
+	MonotonicArena arena;
+	std::vector<CutterSet> face_cutters;
+	collect_face_cutters(proxy.submesh(), proxy.attributes(), proxy_faces, face_cutters, arena);
+
+	std::set<Plane3d*> rebuilt_planes(new_planes.begin(), new_planes.end());
+	for (std::size_t i = 0; i < proxy_faces.size(); ++i) {
+		for (std::size_t j = 0; j < new_planes.size(); ++j) {
+			if (face_cutters[i].find(new_planes[j]) != face_cutters[i].end())
+				rebuilt_planes.insert(proxy.attributes().supporting_plane[proxy_faces[i]]);
+		}
+	}
+
+	// ... and the planes whose faces were cut by an old plane
+	CutAttributes attribs(mesh);
+	std::vector<MapTypes::Facet*> obsolete_faces;
+	std::map<Plane3d*, std::vector<MapTypes::Facet*> > plane_faces;
+	FOR_EACH_FACET(Map, mesh, it) {
+		Plane3d* plane = attribs.supporting_plane[it];
+		if (retired_planes.find(plane_id(plane)) != retired_planes.end()) {
+			obsolete_faces.push_back(it);
+			continue;
+		}
+		plane_faces[plane].push_back(it);
+
+		FacetHalfedgeCirculator cir(it);
+		for (; !cir->end(); ++cir) {
+			MapTypes::Halfedge* h = cir->halfedge();
+			const PlaneIdSet<2>& edge_planes = attribs.edge_source_planes[h];
+			const PlaneIdSet<3>& vertex_planes = attribs.vertex_source_planes[h->vertex()];
+			bool touched = false;
+			for (std::set<unsigned int>::const_iterator pos = retired_planes.begin(); pos != retired_planes.end(); ++pos) {
+				if (edge_planes.contains(*pos) || vertex_planes.contains(*pos)) {
+					touched = true;
+					break;
+				}
+			}
+			if (touched) {
+				rebuilt_planes.insert(plane);
+				break;
+			}
+		}
+	}
+
+	for (std::set<Plane3d*>::const_iterator it = rebuilt_planes.begin(); it != rebuilt_planes.end(); ++it) {
+		const std::vector<MapTypes::Facet*>& faces = plane_faces[*it];
+		obsolete_faces.insert(obsolete_faces.end(), faces.begin(), faces.end());
+	}
+
+	// the proxy faces of the other planes are removed, and the remaining ones are cut
+	std::vector<bool> to_rebuild(proxy_faces.size(), false);
+	std::vector<MapTypes::Facet*> unchanged_proxy_faces;
+	for (std::size_t i = 0; i < proxy_faces.size(); ++i) {
+		to_rebuild[i] = (rebuilt_planes.find(proxy.attributes().supporting_plane[proxy_faces[i]]) != rebuilt_planes.end());
+		if (!to_rebuild[i])
+			unchanged_proxy_faces.push_back(proxy_faces[i]);
+	}
+	FacetEraser(proxy.submesh()).erase(unchanged_proxy_faces);
+
+	min_piece_width_ = Method::min_piece_width * pset_->bbox().radius();
+	for (std::size_t i = 0; i < proxy_faces.size(); ++i) {
+		if (to_rebuild[i] && !face_cutters[i].empty())
+			cut_facet(proxy_faces[i], face_cutters[i], proxy.submesh(), proxy.attributes());
+	}
+	remove_degenerated_facets(proxy.submesh());
+
+	// replaces the obsolete faces by the new ones
+	std::size_t num_kept = mesh->size_of_facets() - obsolete_faces.size();
+	FacetEraser(mesh).erase(obsolete_faces);
+	std::vector<MapTypes::Facet*> new_faces;
+	proxy.merge_into(mesh, attribs, &new_faces);
+	check_source_planes(mesh);
+
+	if (ready_for_optimization(mesh) && confidence_radius_ > 0.0f) {
+		ProgressLogger progress(new_faces.size());
+		compute_facet_confidences(mesh, new_faces, &progress);
+	}
+
+	Logger::out("-") << rebuilt_planes.size() << " planes rebuilt (" << new_faces.size() << " new faces, " 
+		<< num_kept << " faces kept). " << w.elapsed() << " sec." << std::endl;
+	return true;
+}
+
+
+HypothesisGenerator::Estimate HypothesisGenerator::estimate() {
+	ScopedThreadBudget budget(thread_budget());
+	Estimate result;
+	if (!pset_ || pset_->groups().empty())
+		return result;
+
+	StopWatch w;
+	Logger::out("-") << "estimating problem size..." << std::endl;
+
+	collect_valid_planes();
+	Map* bbox_mesh = construct_bbox_mesh();
+	Map* mesh = compute_proxy_mesh(bbox_mesh);
+
+	// the proxy faces, in the 2D frames of their supporting planes
+	std::vector<const Plane3d*> planes;
+	std::vector<SmallPolygon3d> polygons;
+	std::vector<SmallPolygon2d> polygons_2d;
+	{
+		MapFacetAttribute<Plane3d*> supporting_plane(mesh, "FacetSupportingPlane");
+		FOR_EACH_FACET(Map, mesh, it) {
+			const Plane3d* plane = supporting_plane[it];
+			planes.push_back(plane);
+			polygons.push_back(SmallPolygon3d());
+			Geom::facet_polygon(it, polygons.back());
+			polygons_2d.push_back(SmallPolygon2d());
+			Geom::to_2d(plane->point(), plane->base1(), plane->base2(), polygons.back(), polygons_2d.back());
+		}
+	}
+	result.num_proxy_faces = planes.size();
+
+	std::vector<SegmentExtent> extents;
+	if (Method::local_hypothesis)
+		compute_segment_extents(Method::local_hypothesis_margin * mesh->bbox().radius(), extents);
+
+	// the number of planes crossing each proxy face, and of their crossings inside the face
+	const std::size_t max_sampled_pairs = 4096;
+	const float snap_distance = static_cast<float>(std::sqrt(Method::snap_sqr_distance_threshold));
+	double num_faces = 0, num_vertices = 0, num_edges = 0, num_border_edges = 0;
+	for (std::size_t i = 0; i < planes.size(); ++i) {
+		const SmallPolygon3d& plg = polygons[i];
+
+		std::vector<std::size_t> crossing;
+		for (std::size_t j = 0; j < planes.size(); ++j) {
+			if (j == i)
+				continue;
+			if (Method::local_hypothesis && !extents_overlap(extents[plane_id(planes[i])], extents[plane_id(planes[j])]))
+				continue;
+			std::size_t positive = 0, negative = 0;
+			planes[j]->count_sides(plg.data(), nil, plg.size(), snap_distance, positive, negative);
+			if (positive > 0 && negative > 0)
+				crossing.push_back(j);
+		}
+
+		// the pairs of crossing lines meeting inside the face (by deterministic sampling if there are too many)
+		std::size_t num_pairs = crossing.size() * (crossing.size() - (crossing.empty() ? 0 : 1)) / 2;
+		std::size_t step = std::max<std::size_t>(1, num_pairs / max_sampled_pairs);
+		std::size_t num_tested = 0, num_inside = 0, pair = 0;
+		const Geom::PolygonClassifier classifier(polygons_2d[i].data(), polygons_2d[i].size());
+		for (std::size_t a = 0; a < crossing.size(); ++a) {
+			for (std::size_t b = a + 1; b < crossing.size(); ++b, ++pair) {
+				if (pair % step != 0)
+					continue;
+				++num_tested;
+				vec3 p;
+				if (intersection_plane_triplet(planes[i], planes[crossing[a]], planes[crossing[b]], p)) {
+					const Plane3d* plane = planes[i];
+					if (classifier.contains(Geom::to_2d(plane->point(), plane->base1(), plane->base2(), p)))
+						++num_inside;
+				}
+			}
+		}
+		double k = double(crossing.size());
+		double c = (num_tested > 0) ? double(num_pairs) * num_inside / num_tested : 0.0;
+
+		// an arrangement of k lines with c crossings inside a convex polygon with n sides
+		double n = double(plg.size());
+		num_faces += 1 + k + c;
+		num_vertices += n + 2 * k + c;
+		num_edges += k + 2 * c;				// the pieces of the lines (each is shared with another plane)
+		num_border_edges += n + 2 * k;		// the pieces of the boundary of the proxy face
+	}
+
+	// each interior edge is shared by the faces of two planes (i.e., it gives a fan of 4 faces), 
+	// and a border edge gives a fan of a single face
+	double num_fans_4 = num_edges * 0.5;
+	double num_fans_1 = num_border_edges;
+	result.num_candidate_faces = static_cast<std::size_t>(num_faces);
+	result.num_variables = static_cast<std::size_t>(num_faces + 2 * num_fans_4);
+	// per fan: the number of faces; per fan of 4 faces: edge usage and 4 sharp edge constraints; per border fan: removal
+	result.num_constraints = static_cast<std::size_t>(num_fans_4 + num_fans_1 + 5 * num_fans_4 + num_fans_1);
+
+	// the candidate mesh...
+	double num_halfedges = 4 * num_fans_4 + 2 * num_fans_1;
+	double mesh_memory =
+		num_halfedges * (sizeof(Map::Halfedge) + sizeof(PlaneIdSet<2>)) +
+		num_vertices * (sizeof(Map::Vertex) + sizeof(PlaneIdSet<3>)) +
+		num_faces * (sizeof(Map::Facet) + sizeof(Color) + sizeof(VertexGroup*) + sizeof(Plane3d*) + 3 * sizeof(double));
+	// ... and the binary program (in hash maps of coefficients, about 40 bytes per entry)
+	double num_coefficients = num_faces + num_fans_4 + (5 * num_fans_4 + num_fans_1) + 2 * num_fans_4 + 16 * num_fans_4 + num_fans_1;
+	double program_memory =
+		result.num_variables * sizeof(Variable) +
+		result.num_constraints * sizeof(LinearConstraint) +
+		num_coefficients * 40.0;
+	result.peak_memory = static_cast<std::size_t>(mesh_memory + program_memory);
+	result.mesh_memory = static_cast<std::size_t>(mesh_memory);
+	result.program_memory = static_cast<std::size_t>(program_memory);
+
+	// a slot of the table (the key and the index, at half load) and the point of each triplet
+	double num_planes = double(supporting_planes_.size());
+	double num_triplets = num_planes * (num_planes - 1) * (num_planes - 2) / 6.0;
+	result.triplet_memory = static_cast<std::size_t>(num_triplets * (2 * (sizeof(Numeric::uint64) + sizeof(unsigned int)) + sizeof(vec3)));
+
+	delete bbox_mesh;
+	delete mesh;
+	clear();
+
+	Logger::out("-") << "estimated: " << result.num_proxy_faces << " proxy faces, "
+		<< result.num_candidate_faces << " candidate faces, "
+		<< result.num_variables << " variables, " 
+		<< result.num_constraints << " constraints, "
+		<< result.peak_memory / (1024 * 1024) << " MB. " << w.elapsed() << " sec." << std::endl;
+
+	return result;
+}
+
+
 void HypothesisGenerator::clear() {
-	for (std::size_t i = 0; i < supporting_planes_.size(); ++i)
-		delete supporting_planes_[i];
 	supporting_planes_.clear();
+	plane_arena_.clear();
+	bbox_planes_.clear();
+
+	plane_index_.clear();
+	triplet_intersection_.clear();
+	vertex_registry_.reset(std::sqrt(Method::snap_sqr_distance_threshold));
+}
+
+
+MemoryUsage HypothesisGenerator::memory_usage() const {
+	MemoryUsage usage;
+
+	// the nodes of the associative containers are estimated as the value and two pointers
+	double planes = plane_arena_.size() * sizeof(Plane3d) + MemoryUsage::of(supporting_planes_) + MemoryUsage::of(bbox_planes_);
+	planes += plane_index_.size() * (sizeof(std::pair<const Plane3d*, unsigned int>) + 2 * sizeof(void*)) + plane_index_.bucket_count() * sizeof(void*);
+	planes += vertex_group_plane_.size() * (sizeof(std::pair<VertexGroup*, Plane3d*>) + 4 * sizeof(void*));
+	planes += snapped_segments_.size() * (sizeof(std::pair<VertexGroup*, VertexGroup*>) + 4 * sizeof(void*));
+	usage.add("planes", planes);
+
+	std::lock_guard<std::mutex> lock(triplet_intersection_mutex_);
+	usage.add("triplet intersections", double(triplet_intersection_.memory_usage()));
+	usage.add("vertex registry", double(vertex_registry_.memory_usage()));
+	return usage;
+}
+
+
+
+
+namespace {
+
+	// restores the settings of the queries of an index shared with the other stages (see
+	// PointSet::point_search())
+	class SearchSettings {
+	public:
+		SearchSettings(PointSearch* search) : search_(search), epsilon_(search->epsilon()), max_visited_leaves_(0) {
+			if (search->backend() == PointSearch::KD_TREE)
+				max_visited_leaves_ = static_cast<KdTreeSearch*>(search)->max_visited_leaves();
+		}
+		~SearchSettings() {
+			search_->set_epsilon(epsilon_);
+			if (search_->backend() == PointSearch::KD_TREE)
+				static_cast<KdTreeSearch*>(search_)->set_max_visited_leaves(max_visited_leaves_);
+		}
+
+	private:
+		PointSearch*	search_;
+		double			epsilon_;
+		unsigned int	max_visited_leaves_;
+	};
 
-	for (std::size_t i = 0; i < intersecting_points_.size(); ++i)
-		delete intersecting_points_[i];
-	intersecting_points_.clear();
 }
 
 
+void HypothesisGenerator::set_point_search(PointSearch* search) {
+	if (pset_)
+		pset_->set_point_search(search);
+}
 
 
 float HypothesisGenerator::compute_point_confidences(PointSet* pset, int s1 /* = 6 */, int s2 /* = 16 */, int s3 /* = 32 */, ProgressLogger* progress) {
@@ -974,10 +3337,36 @@ float HypothesisGenerator::compute_point_confidences(PointSet* pset, int s1 /* =
 	if (planar_qualities.size() != points.size())
 		planar_qualities.resize(points.size());
 
-	KdTreeSearch_var kdtree = new KdTreeSearch;
-	kdtree->begin();
-	kdtree->add_vertex_set(pset);
-	kdtree->end();
+	PointQualityEstimator* estimator = PointQualityEstimator::instance();
+	if (Method::device_point_confidences && estimator && !points.empty()) {
+		StopWatch w;
+		const unsigned int sizes[3] = { unsigned(s1), unsigned(s2), unsigned(s3) };
+		std::vector<float> spacings;
+		if (estimator->estimate(points, sizes, planar_qualities, spacings) && spacings.size() == points.size()) {
+			// summed in order, as PointSetNormals::estimate()
+			double total = 0;
+			for (std::size_t i = 0; i < spacings.size(); ++i)
+				total += spacings[i];
+			Logger::out("-") << "point confidences computed by " << estimator->name() << ". " << w.elapsed() << " sec." << std::endl;
+			return static_cast<float>(total / points.size());
+		}
+		Logger::warn("-") << estimator->name() << " failed computing the point confidences (computed on the CPU instead)" << std::endl;
+		planar_qualities.resize(points.size());
+	}
+
+	// the index shared by the stages, with the settings of the queries of this stage (restored after)
+	PointSearch_var search = pset->point_search(PointSearch::Backend(Method::point_search_backend), Method::num_threads,
+		Method::point_index_cache_directory);
+	SearchSettings settings(search);
+	search->set_epsilon(Method::point_search_epsilon);
+	if (search->backend() == PointSearch::KD_TREE)
+		static_cast<KdTreeSearch*>(search.get())->set_max_visited_leaves(Method::point_search_max_leaves);
+
+	if (Method::parallel_point_confidences) {
+		// a single query per point (see PointSetNormals), the same pass as the region growing
+		const unsigned int sizes[3] = { unsigned(s1), unsigned(s2), unsigned(s3) };
+		return PointSetNormals::estimate(points, search, sizes, planar_qualities, nil, nil, 0, Method::num_threads, progress);
+	}
 
 	std::vector<int> neighbor_size;
 	neighbor_size.push_back(s1);
@@ -994,7 +3383,7 @@ float HypothesisGenerator::compute_point_confidences(PointSet* pset, int s1 /* =
 		for (int j = 0; j < 3; ++j) {
 			std::vector<unsigned int> neighbors;
 			std::vector<double> sqr_distances;
-			kdtree->find_closest_K_points(p, neighbor_size[j], neighbors, sqr_distances);
+			search->find_closest_K_points(p, neighbor_size[j], neighbors, sqr_distances);
 
 			PrincipalAxes3d pca;
 			pca.begin();
@@ -1028,109 +3417,779 @@ float HypothesisGenerator::compute_point_confidences(PointSet* pset, int s1 /* =
 }
 
 
-void HypothesisGenerator::compute_confidences(Map* mesh, bool use_conficence /* = false */) {
-	facet_attrib_supporting_vertex_group_.bind(mesh, Method::facet_attrib_supporting_vertex_group);
+void HypothesisGenerator::downsample_points() {
+	if (Method::downsampling_cell_size > 0.0f) {
+		StopWatch w;
+		ProfileStage stage("downsample_points");
+		std::size_t num = pset_->num_points();
+		PointSetDownsampler::voxel_grid(pset_, Method::downsampling_cell_size, Method::num_threads);
+		Logger::out("-") << "downsampled " << num << " points to " << pset_->num_points() << ". " << w.elapsed() << " sec." << std::endl;
+		Profiler::add_counter("points downsampled", double(num - pset_->num_points()));
+	}
+}
+
 
+void HypothesisGenerator::prepare_confidences(bool use_conficence, ProgressLogger* progress) {
 	StopWatch w;
 	Logger::out("-") << "computing point confidences..." << std::endl;
-    ProgressLogger progress(pset_->num_points() + mesh->size_of_facets());
-	double avg_spacing = compute_point_confidences(pset_, 6, 16, 25, &progress);
-	float radius = static_cast<float>(avg_spacing)* 5.0f;
+	double avg_spacing = 0;
+	const unsigned int sizes[3] = { 6, 16, 25 };
+	PointSet::QualityParameters& cached = pset_->quality_parameters();
+	if (Method::reuse_point_confidences && pset_->has_planar_qualities() && cached.is_valid() &&
+		std::equal(sizes, sizes + 3, cached.sizes)) 
+	{
+		// e.g., loaded with the points
+		avg_spacing = cached.average_spacing;
+		Logger::out("-") << "reused the point confidences" << std::endl;
+	}
+	else {
+		ProfileStage stage("compute_point_confidences");
+		avg_spacing = compute_point_confidences(pset_, sizes[0], sizes[1], sizes[2], progress);
+		std::copy(sizes, sizes + 3, cached.sizes);
+		cached.average_spacing = static_cast<float>(avg_spacing);
+		// a single query per point in the parallel version
+		Profiler::add_counter("kNN queries", double(pset_->num_points() * (Method::parallel_point_confidences ? 1 : 3)));
+	}
+	if (Method::padded_point_kernels)
+		pset_->update_padded_points();
+
+	confidence_radius_ = static_cast<float>(avg_spacing)* 5.0f;
 	Logger::out("-") << "done. avg spacing: " << avg_spacing << ". " << w.elapsed() << " sec." << std::endl;
 
-	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
 	const std::vector<vec3>& pts = pset_->points();
 
+	GroupTable table(pset_->groups());
+	std::vector<float> max_dists(table.num_top_level(), 0.0f);
+	parallel_for(max_dists.size(), [&](std::size_t i) {
+		max_dists[i] = table.max_squared_distance(i, pts);
+	});
 	float max_dist = 0;
-	for (std::size_t i = 0; i < groups.size(); ++i) {
-		VertexGroup* g = groups[i];
-		const Plane3d& plane = g->plane();
-		for (std::size_t j = 0; j < g->size(); ++j) {
-			int idx = g->at(j);
-			const vec3& p = pts[idx];
-			float sdist = plane.squared_ditance(p);
-			max_dist = std::max(max_dist, sdist);
-		}
-	}
-	max_dist = std::sqrt(max_dist);
+	for (std::size_t i = 0; i < max_dists.size(); ++i)
+		max_dist = std::max(max_dist, max_dists[i]);
+	confidence_max_dist_ = std::sqrt(max_dist);
+	use_confidence_ = use_conficence;
+}
 
-	//////////////////////////////////////////////////////////////////////////
 
-	MapFacetAttribute<double>	facet_attrib_supporting_point_num(mesh, Method::facet_attrib_supporting_point_num);
-	MapFacetAttribute<double>	facet_attrib_facet_area(mesh, Method::facet_attrib_facet_area);
-	MapFacetAttribute<double>	facet_attrib_covered_area(mesh, Method::facet_attrib_covered_area);
+void HypothesisGenerator::compute_confidences(Map* mesh, bool use_conficence /* = false */) {
+	ScopedThreadBudget budget(thread_budget());
+	ProfileStage stage("compute_confidences");
+
+	downsample_points();
+	ProgressLogger progress(pset_->num_points() + mesh->size_of_facets());
+	prepare_confidences(use_conficence, &progress);
 
+	StopWatch w;
 	Logger::out("-") << "computing face confidences..." << std::endl;
 	w.start();
-	FOR_EACH_FACET(Map, mesh, it) {
-		Map::Facet* f = it;
 
-		double face_area = Geom::facet_area(f);
-		if (face_area < 1e-16) {
-			Logger::err("-") << "degenerate facet with area: " << face_area << std::endl;
-			FacetHalfedgeCirculator cir(f);
-			for (; !cir->end(); ++cir) {
-				Logger::err("-") << cir->vertex()->point() << std::endl;
-			}
-			Logger::err("-") << std::endl;
+	std::vector<Map::Facet*> facets;
+	facets.reserve(mesh->size_of_facets());
+	if (Method::incremental_facet_confidences) {
+		outdated_facets(mesh, facets);
+		Logger::out("-") << mesh->size_of_facets() - facets.size() << " faces are up to date" << std::endl;
+		Profiler::add_counter("faces up to date", double(mesh->size_of_facets() - facets.size()));
+	}
+	else {
+		FOR_EACH_FACET(Map, mesh, it)
+			facets.push_back(it);
+	}
+	if (Method::free_space_pruning) {
+		ProfileStage stage("prune_free_space_facets");
+		std::vector<Map::Facet*> remaining;
+		prune_free_space_facets(mesh, facets, remaining, &progress);
+		facets.swap(remaining);
+	}
+	if (Method::sampled_confidences) {
+		ProfileStage stage("estimate_facet_confidences");
+		std::vector<Map::Facet*> exact;
+		estimate_facet_confidences(mesh, facets, exact, &progress);
+		facets.swap(exact);
+	}
+	{
+		ProfileStage stage("compute_facet_confidences");
+		compute_facet_confidences(mesh, facets, &progress);
+		Profiler::add_counter("faces", double(facets.size()));
+	}
+
+	Logger::out("-") << "done. " << w.elapsed() << " sec." << std::endl;
+}
+
+
+void HypothesisGenerator::outdated_facets(Map* mesh, std::vector<MapTypes::Facet*>& outdated) {
+	facet_attrib_supporting_vertex_group_.bind(mesh, Method::facet_attrib_supporting_vertex_group);
+	MapFacetAttribute<Numeric::uint64> signature(mesh, Method::facet_attrib_confidence_signature);
+
+	// the inputs shared by all the faces: the points (with their planar qualities and weights) and the
+	// parameters of the confidences
+	FNVHash shared;
+	shared.add(pset_->id());
+	shared.add(pset_->points_version());
+	shared.add(confidence_max_dist_);
+	shared.add(confidence_radius_);
+	shared.add(use_confidence_);
+	shared.add(pset_->has_weights());
+	shared.add(Method::segment_alpha_shapes);
+	shared.add(Method::raster_coverage);
+	shared.add(Method::raster_coverage_cell_size);
+	shared.add(Method::raster_coverage_closing);
+	shared.add(Method::sampled_confidences);
+	if (Method::sampled_confidences) {
+		shared.add(Method::confidence_sample_size);
+		shared.add(Method::confidence_sample_seed);
+		shared.add(Method::confidence_interval_sigmas);
+	}
+
+	// the points and the plane of each segment (and of the segments snapped to it), hashed once
+	std::map<VertexGroup*, std::vector<VertexGroup*> > members;
+	snapped_members(members);
+	std::vector<VertexGroup*> groups;
+	std::unordered_map<const VertexGroup*, Numeric::uint64> group_signatures;
+	FOR_EACH_FACET(Map, mesh, it) {
+		VertexGroup* g = facet_attrib_supporting_vertex_group_[it];
+		if (g && group_signatures.insert(std::make_pair(g, 0)).second) {
+			groups.push_back(g);
+			if (members.find(g) != members.end())
+				groups.insert(groups.end(), members[g].begin(), members[g].end());
+		}
+	}
+	std::vector<Numeric::uint64> hashes(groups.size());
+	parallel_for(groups.size(), [&](std::size_t i) {
+		const VertexGroup* g = groups[i];
+		FNVHash h = shared;
+		h.add_bytes(g->data(), g->size() * sizeof(unsigned int));
+		h.add_bytes(g->plane().data(), 4 * sizeof(g->plane().data()[0]));
+		hashes[i] = h.value();
+	}, nil, Method::num_threads);
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		group_signatures[groups[i]] = hashes[i];
+	std::map<VertexGroup*, std::vector<VertexGroup*> >::const_iterator cluster = members.begin();
+	for (; cluster != members.end(); ++cluster) {
+		std::unordered_map<const VertexGroup*, Numeric::uint64>::iterator pos = group_signatures.find(cluster->first);
+		if (pos == group_signatures.end())
 			continue;
+		FNVHash h;
+		h.add(pos->second);
+		for (std::size_t k = 0; k < cluster->second.size(); ++k)
+			h.add(group_signatures[cluster->second[k]]);
+		pos->second = h.value();
+	}
+
+	FOR_EACH_FACET(Map, mesh, it) {
+		VertexGroup* g = facet_attrib_supporting_vertex_group_[it];
+		FNVHash h;
+		h.add(g ? group_signatures[g] : shared.value());
+		Map::Halfedge* jt = it->halfedge();
+		do {
+			h.add_bytes(jt->vertex()->point().data(), sizeof(vec3));
+			jt = jt->next();
+		} while (jt != it->halfedge());
+
+		// the new faces have no signature (i.e., 0)
+		if (signature[it] != h.value()) {
+			signature[it] = h.value();
+			outdated.push_back(it);
 		}
+	}
+}
 
-		VertexGroup* g = facet_attrib_supporting_vertex_group_[f];
 
-		std::vector<unsigned int> points;
-		double num = facet_points_projected_in(pset_, g, f, max_dist, points);
-		if (use_conficence)
-			facet_attrib_supporting_point_num[f] = num;
-		else
-			facet_attrib_supporting_point_num[f] = static_cast<double>(points.size());
+void HypothesisGenerator::compute_facet_confidences(Map* mesh, const std::vector<MapTypes::Facet*>& facets, ProgressLogger* progress) {
+	facet_attrib_supporting_vertex_group_.bind(mesh, Method::facet_attrib_supporting_vertex_group);
+
+	const float max_dist = confidence_max_dist_;
+	const float radius = confidence_radius_;
+	const bool use_conficence = use_confidence_;
+
+	// the segments the faces lie on, and the ones snapped to their planes (see regularize_planes())
+	std::map<VertexGroup*, std::vector<VertexGroup*> > members;
+	snapped_members(members);
+	const std::vector<VertexGroup*> no_members;
+	auto members_of = [&](VertexGroup* g) -> const std::vector<VertexGroup*>& {
+		std::map<VertexGroup*, std::vector<VertexGroup*> >::const_iterator pos = members.find(g);
+		return (pos == members.end()) ? no_members : pos->second;
+	};
+	std::vector<VertexGroup*> groups;
+	std::set<VertexGroup*> visited;
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		VertexGroup* g = facet_attrib_supporting_vertex_group_[facets[i]];
+		if (g && visited.insert(g).second) {
+			groups.push_back(g);
+			const std::vector<VertexGroup*>& snapped = members_of(g);
+			groups.insert(groups.end(), snapped.begin(), snapped.end());
+		}
+	}
+
+	MapFacetAttribute<double>	supporting_point_num_attrib(mesh, Method::facet_attrib_supporting_point_num);
+	MapFacetAttribute<double>	facet_area_attrib(mesh, Method::facet_attrib_facet_area);
+	MapFacetAttribute<double>	covered_area_attrib(mesh, Method::facet_attrib_covered_area);
+
+	// the attributes are accessed for each face (no face is created below)
+	AttributeAccessor<Map::Facet, double>		facet_attrib_supporting_point_num(supporting_point_num_attrib);
+	AttributeAccessor<Map::Facet, double>		facet_attrib_facet_area(facet_area_attrib);
+	AttributeAccessor<Map::Facet, double>		facet_attrib_covered_area(covered_area_attrib);
+	AttributeAccessor<Map::Facet, VertexGroup*>	facet_supporting_group(facet_attrib_supporting_vertex_group_);
+
+	// the area and the projected polygon of each face are computed once, and shared by the 
+	// point counting and the coverage below
+	MapGeometryCache geometry(mesh);
+
+	// the points of each segment are projected onto its plane once, for all the stages below
+	if (Method::segment_projections)
+		SegmentProjection::update(groups);
+
+	// the projected points of each segment are sorted into a grid once, so the points projected 
+	// in a face are found without testing all the points of its segment
+	std::vector<SegmentPointGrid> grids;
+	std::unordered_map<const VertexGroup*, const SegmentPointGrid*> segment_grids;
+	if (Method::segment_point_grids && !Method::one_pass_point_location) {
+		grids.resize(groups.size());
+		parallel_for(groups.size(), [&](std::size_t i) {
+			grids[i].build(groups[i]);
+		}, nil, Method::num_threads);
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			segment_grids[groups[i]] = &grids[i];
+	}
+	auto grid_of = [&](const VertexGroup* g) -> const SegmentPointGrid* {
+		std::unordered_map<const VertexGroup*, const SegmentPointGrid*>::const_iterator pos = segment_grids.find(g);
+		return (pos == segment_grids.end()) ? nil : pos->second;
+	};
+
+	// the footprints of the segments are kept with them, and only computed for the new (or refit) ones
+	if (Method::segment_footprints) {
+		const bool alpha = Method::segment_alpha_shapes && !Method::raster_coverage;
+		SegmentFootprint::update(groups, alpha ? radius : 0.0f);
+	}
 
-		facet_attrib_facet_area[f] = face_area;
+	// the alpha shape of each segment is computed once, and the area of a face covered by its 
+	// points is obtained by clipping the alpha triangles against the face
+	std::vector<AlphaShapeCoverage> coverages;
+	std::unordered_map<const VertexGroup*, const AlphaShapeCoverage*> segment_coverages;
+	if (Method::segment_alpha_shapes && !Method::raster_coverage) {
+		coverages.resize(groups.size());
+		parallel_for(groups.size(), [&](std::size_t i) {
+			coverages[i].build(groups[i], radius);
+		}, nil, Method::num_threads);
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			segment_coverages[groups[i]] = &coverages[i];
+	}
+	// or the points of each segment are rasterized once into an occupancy bitmap (the radius is 5 
+	// times the average spacing, see prepare_confidences())
+	std::vector<RasterCoverage> rasters;
+	std::unordered_map<const VertexGroup*, const RasterCoverage*> segment_rasters;
+	if (Method::raster_coverage) {
+		const double cell_size = Method::raster_coverage_cell_size * radius / 5.0;
+		rasters.resize(groups.size());
+		parallel_for(groups.size(), [&](std::size_t i) {
+			rasters[i].build(groups[i], cell_size, Method::raster_coverage_closing);
+		}, nil, Method::num_threads);
+		for (std::size_t i = 0; i < groups.size(); ++i)
+			segment_rasters[groups[i]] = &rasters[i];
+	}
+	auto covered_area_of = [&](Map::Facet* f, const VertexGroup* g, const std::vector<unsigned int>& points) -> double {
+		std::unordered_map<const VertexGroup*, const RasterCoverage*>::const_iterator raster = segment_rasters.find(g);
+		if (raster != segment_rasters.end())
+			return raster->second->covered_area(geometry.facet_polygon_2d(f, &g->plane()));
+
+		std::unordered_map<const VertexGroup*, const AlphaShapeCoverage*>::const_iterator pos = segment_coverages.find(g);
+		if (pos != segment_coverages.end()) {
+			return pos->second->covered_area(geometry.facet_polygon_2d(f, &g->plane()));
+		}
 
-		Map::Ptr alpha_mesh = AlphaShapeMesh::apply(pset_, points, g->plane(), radius);
-		double covered_area = 0;
-		if (alpha_mesh) {
-			FOR_EACH_FACET(Map, alpha_mesh, it)
-				covered_area += Geom::triangle_area(it);
+		return AlphaShapeMesh::covered_area(pset_, points, g->plane(), radius);
+	};
+
+	// the number of points (or the total weight of the points of a downsampled point set)
+	auto weight_of = [&](const std::vector<unsigned int>& points) -> double {
+		if (!pset_->has_weights())
+			return static_cast<double>(points.size());
+		double weight = 0.0;
+		for (std::size_t i = 0; i < points.size(); ++i)
+			weight += pset_->weights()[points[i]];
+		return weight;
+	};
+
+	// The supporting points may be counted in bulk by a device, when the coverage doesn't need the
+	// points of each face (i.e., with a coverage computed once per segment)
+	std::vector<double> device_nums;
+	const bool per_segment_coverage = Method::raster_coverage || Method::segment_alpha_shapes;
+	const bool on_device = Method::device_point_counting && per_segment_coverage && members.empty() &&
+		device_points_projected_in(facets, max_dist, use_conficence, geometry, device_nums);
+
+	// Or the points of each segment are located in the faces on its plane in one pass (see FacetPointLocator):
+	// slot[i] is the position of face i among the faces of its segment, which the segments snapped to it share
+	struct Located {
+		std::vector<float>							counts;
+		std::vector< std::vector<unsigned int> >	points;
+	};
+	std::vector<std::size_t> slot(facets.size(), 0);
+	std::unordered_map<const VertexGroup*, Located> located;
+	if (!on_device && Method::one_pass_point_location) {
+		std::vector<VertexGroup*> reps;
+		std::unordered_map<VertexGroup*, std::vector<std::size_t> > rep_facets;
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			VertexGroup* g = facet_supporting_group[facets[i]];
+			if (!g)
+				continue;
+			std::vector<std::size_t>& indices = rep_facets[g];
+			if (indices.empty())
+				reps.push_back(g);
+			slot[i] = indices.size();
+			indices.push_back(i);
 		}
-		facet_attrib_covered_area[f] = covered_area;
+		for (std::size_t k = 0; k < groups.size(); ++k)
+			located[groups[k]];		// the entries are created here, and only filled below
+		// a segment and the ones snapped to it are located by the same task, since they project the same faces
+		parallel_for(reps.size(), [&](std::size_t k) {
+			const std::vector<std::size_t>& indices = rep_facets[reps[k]];
+			std::vector<VertexGroup*> cluster(1, reps[k]);
+			const std::vector<VertexGroup*>& snapped = members_of(reps[k]);
+			cluster.insert(cluster.end(), snapped.begin(), snapped.end());
+			for (std::size_t j = 0; j < cluster.size(); ++j) {
+				VertexGroup* g = cluster[j];
+				std::vector<Polygon2d> polygons(indices.size());
+				std::vector<const Polygon2d*> faces(indices.size());
+				for (std::size_t m = 0; m < indices.size(); ++m) {
+					polygons[m] = geometry.facet_polygon_2d(facets[indices[m]], &g->plane());
+					faces[m] = &polygons[m];
+				}
+				FacetPointLocator locator;
+				locator.build(faces);
+				Located& result = located[g];
+				locator.locate(g, max_dist, result.counts, result.points);
+			}
+		}, nil, Method::num_threads);
+	}
 
-		if (covered_area > face_area) {
+	auto supporting_point_num_of = [&](std::size_t i, VertexGroup* g, std::vector<unsigned int>& points) -> double {
+		if (on_device)
+			return device_nums[i];
+		double num = 0.0;
+		std::unordered_map<const VertexGroup*, Located>::iterator pos = located.find(g);
+		if (pos != located.end()) {
+			// each (face, segment) pair is asked once, so its points are handed over
+			num = pos->second.counts[slot[i]];
+			points.swap(pos->second.points[slot[i]]);
+		}
+		else
+			num = facet_points_projected_in(pset_, g, facets[i], max_dist, points, grid_of(g), &geometry);
+		return use_conficence ? num : weight_of(points);
+	};
+	// the support of a face by the points of its segment and of the segments snapped to it
+	auto support_of = [&](std::size_t i, Map::Facet* f, VertexGroup* g, double& covered_area) -> double {
+		std::vector<unsigned int> points;
+		double num = supporting_point_num_of(i, g, points);
+		covered_area = covered_area_of(f, g, points);
+		const std::vector<VertexGroup*>& snapped = members_of(g);
+		for (std::size_t k = 0; k < snapped.size(); ++k) {
+			std::vector<unsigned int> member_points;
+			num += supporting_point_num_of(i, snapped[k], member_points);
+			covered_area += covered_area_of(f, snapped[k], member_points);
+		}
+		return num;
+	};
+
+	if (Method::parallel_facet_confidences) {
+		// The facets are independent, so they are processed in parallel. The results are written
+		// to the attributes afterwards, in the order of the facets.
+		// When all the faces are processed, the areas are taken from a frozen view of the mesh, 
+		// which computes them at once (in parallel) before the faces are visited.
+		FrozenMap* frozen = nil;
+		if (facets.size() == mesh->size_of_facets())
+			frozen = new FrozenMap(mesh, Method::num_threads);
+		std::vector<double> facet_areas(facets.size(), 0.0);
+		std::vector<double> supporting_point_nums(facets.size(), 0.0);
+		std::vector<double> covered_areas(facets.size(), 0.0);
+		parallel_for(facets.size(), [&](std::size_t i) {
+			TraceZone zone("facet confidence", "confidences");
+			Map::Facet* f = facets[i];
+			double face_area = frozen ? frozen->facet_area(f) : geometry.facet_area(f);
+			facet_areas[i] = face_area;
+			if (face_area < 1e-16)
+				return;	// reported below
+
+			VertexGroup* g = facet_supporting_group[f];
+
+			double covered_area = 0.0;
+			supporting_point_nums[i] = support_of(i, f, g, covered_area);
 			// this may not be an error (floating point precision limit)
-			facet_attrib_covered_area[f] = face_area;
+			covered_areas[i] = std::min(covered_area, face_area);
+		}, progress, Method::num_threads);
+
+		if (frozen) {
+			ogf_assert(frozen->is_valid());
+			delete frozen;
+		}
+
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			Map::Facet* f = facets[i];
+			double face_area = facet_areas[i];
+			if (face_area < 1e-16) {
+				Logger::err("-") << "degenerate facet with area: " << face_area << std::endl;
+				FacetHalfedgeCirculator cir(f);
+				for (; !cir->end(); ++cir) {
+					Logger::err("-") << cir->vertex()->point() << std::endl;
+				}
+				Logger::err("-") << std::endl;
+				continue;
+			}
+
+			facet_attrib_supporting_point_num[f] = supporting_point_nums[i];
+			facet_attrib_facet_area[f] = face_area;
+			facet_attrib_covered_area[f] = covered_areas[i];
+		}
+	}
+	else {
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			TraceZone zone("facet confidence", "confidences");
+			Map::Facet* f = facets[i];
+
+			double face_area = geometry.facet_area(f);
+			if (face_area < 1e-16) {
+				Logger::err("-") << "degenerate facet with area: " << face_area << std::endl;
+				FacetHalfedgeCirculator cir(f);
+				for (; !cir->end(); ++cir) {
+					Logger::err("-") << cir->vertex()->point() << std::endl;
+				}
+				Logger::err("-") << std::endl;
+				continue;
+			}
+
+			VertexGroup* g = facet_supporting_group[f];
+
+			double covered_area = 0.0;
+			facet_attrib_supporting_point_num[f] = support_of(i, f, g, covered_area);
+
+			facet_attrib_facet_area[f] = face_area;
+			facet_attrib_covered_area[f] = covered_area;
+
+			if (covered_area > face_area) {
+				// this may not be an error (floating point precision limit)
+				facet_attrib_covered_area[f] = face_area;
+			}
+			if (progress)
+				progress->next();
 		}
-		progress.next();
 	}
 
 	facet_attrib_supporting_vertex_group_.unbind();
+}
 
-	Logger::out("-") << "done. " << w.elapsed() << " sec." << std::endl;
+
+void HypothesisGenerator::prune_free_space_facets(Map* mesh, const std::vector<MapTypes::Facet*>& facets, std::vector<MapTypes::Facet*>& remaining, ProgressLogger* progress) {
+	facet_attrib_supporting_vertex_group_.bind(mesh, Method::facet_attrib_supporting_vertex_group);
+	remaining.clear();
+
+	StopWatch w;
+	const double max_dist = confidence_max_dist_;
+	const double radius = confidence_radius_;
+
+	// how far from a face the projected points of its segment may cover it (see compute_facet_confidences()):
+	// within the radius of the alpha shapes, or within the occupied cells of the bitmaps and their closing
+	double reach = radius;
+	if (Method::raster_coverage) {
+		const double cell_size = Method::raster_coverage_cell_size * radius / 5.0;
+		reach = std::max(reach, (Method::raster_coverage_closing + 1) * cell_size * std::sqrt(2.0));
+	}
+
+	// the coverage is of the projected points, so the distances of the points of each segment (and of 
+	// the ones snapped to it) to its plane add to the reach
+	std::map<VertexGroup*, std::vector<VertexGroup*> > members;
+	snapped_members(members);
+	std::vector<VertexGroup*> groups;
+	std::unordered_map<const VertexGroup*, std::size_t> group_index;
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		VertexGroup* g = facet_attrib_supporting_vertex_group_[facets[i]];
+		if (g && group_index.insert(std::make_pair(g, groups.size())).second)
+			groups.push_back(g);
+	}
+	const std::vector<vec3>& points = pset_->points();
+	std::vector<double> bands(groups.size());
+	parallel_for(groups.size(), [&](std::size_t k) {
+		const VertexGroup* g = groups[k];
+		const Plane3d& plane = g->plane();
+		double max_squared = 0.0;
+		for (std::size_t i = 0; i < g->size(); ++i)
+			max_squared = std::max(max_squared, double(plane.squared_ditance(points[g->at(i)])));
+		std::map<VertexGroup*, std::vector<VertexGroup*> >::const_iterator pos = members.find(groups[k]);
+		if (pos != members.end()) {
+			for (std::size_t m = 0; m < pos->second.size(); ++m) {
+				const VertexGroup* s = pos->second[m];
+				for (std::size_t i = 0; i < s->size(); ++i)
+					max_squared = std::max(max_squared, double(plane.squared_ditance(points[s->at(i)])));
+			}
+		}
+		bands[k] = std::max(max_dist, std::sqrt(reach * reach + max_squared));
+	}, nil, Method::num_threads);
+
+	OccupancyGrid grid;
+	grid.build(points, std::max(max_dist, reach));
+
+	// the degenerate faces are left to be reported by the computation
+	MapGeometryCache geometry(mesh);
+	std::vector<double> areas(facets.size(), 0.0);
+	std::vector<Numeric::uint8> empty(facets.size(), 0);
+	parallel_for(facets.size(), [&](std::size_t i) {
+		Map::Facet* f = facets[i];
+		const VertexGroup* g = facet_attrib_supporting_vertex_group_[f];
+		areas[i] = geometry.facet_area(f);
+		if (!g || areas[i] < 1e-16)
+			return;
+		SmallPolygon3d plg;
+		Geom::facet_polygon(f, plg);
+		if (plg.size() < 3)
+			return;
+		const double band = bands[group_index.find(g)->second];
+		if (!grid.is_occupied_near(&plg[0], plg.size(), normalize(g->plane().normal()), band))
+			empty[i] = 1;
+	}, nil, Method::num_threads);
+
+	MapFacetAttribute<double>	supporting_point_num_attrib(mesh, Method::facet_attrib_supporting_point_num);
+	MapFacetAttribute<double>	facet_area_attrib(mesh, Method::facet_attrib_facet_area);
+	MapFacetAttribute<double>	covered_area_attrib(mesh, Method::facet_attrib_covered_area);
+	std::size_t num_empty = 0;
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		Map::Facet* f = facets[i];
+		if (!empty[i]) {
+			remaining.push_back(f);
+			continue;
+		}
+		supporting_point_num_attrib[f] = 0.0;
+		facet_area_attrib[f] = areas[i];
+		covered_area_attrib[f] = 0.0;
+		++num_empty;
+		if (progress)
+			progress->next();
+	}
+
+	Logger::out("-") << num_empty << " faces have no point nearby (of " << grid.num_occupied_cells() 
+		<< " occupied cells). " << w.elapsed() << " sec." << std::endl;
+	Profiler::add_counter("faces in free space", double(num_empty));
+	facet_attrib_supporting_vertex_group_.unbind();
+}
+
+
+void HypothesisGenerator::estimate_facet_confidences(Map* mesh, const std::vector<MapTypes::Facet*>& facets, std::vector<MapTypes::Facet*>& exact, ProgressLogger* progress) {
+	facet_attrib_supporting_vertex_group_.bind(mesh, Method::facet_attrib_supporting_vertex_group);
+	exact.clear();
+
+	StopWatch w;
+	const float max_dist = confidence_max_dist_;
+	const float radius = confidence_radius_;
+	const float epsilon = max_dist * 0.5f;	// as in facet_points_projected_in()
+
+	// the faces of each large segment (the segments with snapped ones are computed exactly)
+	std::map<VertexGroup*, std::vector<VertexGroup*> > members;
+	snapped_members(members);
+	std::vector<VertexGroup*> groups;
+	std::unordered_map<VertexGroup*, std::vector<std::size_t> > group_facets;
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		VertexGroup* g = facet_attrib_supporting_vertex_group_[facets[i]];
+		if (!g || g->size() <= Method::confidence_sample_size || members.find(g) != members.end()) {
+			exact.push_back(facets[i]);
+			continue;
+		}
+		std::vector<std::size_t>& indices = group_facets[g];
+		if (indices.empty())
+			groups.push_back(g);
+		indices.push_back(i);
+	}
+
+	// the terms of the objective of the face selection (see FaceSelection), by which a face is worth selecting
+	// if its coverage term is smaller than its data fitting term
+	const double bbox_area = mesh->bbox().area();
+	const double lambda_coverage = context_ ? context_->lambda_model_coverage : Method::lambda_model_coverage;
+	const double coeff_coverage = (bbox_area > 0) ? pset_->total_weight() * lambda_coverage / bbox_area : 0.0;
+	const double coeff_data_fitting = context_ ? context_->lambda_data_fitting : Method::lambda_data_fitting;
+	const double sigmas = Method::confidence_interval_sigmas;
+
+	std::vector<double> nums(facets.size(), 0.0), areas(facets.size(), 0.0), covered(facets.size(), 0.0);
+	std::vector<Numeric::uint8> conclusive(facets.size(), 0);
+	MapGeometryCache geometry(mesh);
+	parallel_for(groups.size(), [&](std::size_t k) {
+		VertexGroup* g = groups[k];
+		const std::vector<std::size_t>& indices = group_facets[g];
+		StratifiedSample sample;
+		sample.build(g, Method::confidence_sample_size, Method::confidence_sample_seed + g->at(0) + static_cast<unsigned int>(g->size()));
+		const VertexGroup* sampled = sample.group();
+
+		// the sampled points of each face
+		std::vector<Polygon2d> polygons(indices.size());
+		std::vector<const Polygon2d*> faces(indices.size());
+		for (std::size_t m = 0; m < indices.size(); ++m) {
+			polygons[m] = geometry.facet_polygon_2d(facets[indices[m]], &g->plane());
+			faces[m] = &polygons[m];
+		}
+		FacetPointLocator locator;
+		locator.build(faces);
+		std::vector<float> counts;
+		std::vector< std::vector<unsigned int> > points;
+		locator.locate(sampled, max_dist, counts, points);
+
+		// the coverage of the sample, its points being sqrt(scale) times farther apart than the points
+		// of the segment: an error band of that width along the faces boundaries is accounted for
+		const double spread = std::sqrt(sample.scale());
+		RasterCoverage raster;
+		AlphaShapeCoverage alpha;
+		double band = 0.0;
+		if (Method::raster_coverage) {
+			const double cell_size = Method::raster_coverage_cell_size * radius / 5.0;
+			raster.build(sampled, cell_size * spread, Method::raster_coverage_closing);
+			band = cell_size * (spread - 1.0);
+		}
+		else {
+			alpha.build(sampled, static_cast<float>(radius * spread));
+			band = radius * (spread - 1.0);
+		}
+
+		const Plane3d& plane = g->plane();
+		const std::vector<vec3>& pts = pset_->points();
+		const std::vector<float>& confidences = pset_->planar_qualities();
+		std::vector<double> values;
+		for (std::size_t m = 0; m < indices.size(); ++m) {
+			std::size_t i = indices[m];
+			Map::Facet* f = facets[i];
+			double face_area = geometry.facet_area(f);
+			areas[i] = face_area;
+			if (face_area < 1e-16)
+				continue;	// reported by the exact computation
+
+			const std::vector<unsigned int>& in = points[m];
+			values.resize(in.size());
+			for (std::size_t j = 0; j < in.size(); ++j) {
+				unsigned int idx = in[j];
+				float weight = pset_->weight(idx);
+				if (use_confidence_) {
+					float dist = std::sqrt(plane.squared_ditance(pts[idx]));
+					values[j] = (dist < epsilon) ? (1 - dist / epsilon) * confidences[idx] * weight : 0.0;
+				}
+				else
+					values[j] = weight;
+			}
+			double variance = 0.0;
+			double num = sample.total(in, values, variance);
+
+			const Polygon2d& plg = polygons[m];
+			double area = Method::raster_coverage ? raster.covered_area(plg) : alpha.covered_area(plg);
+			area = std::min(area, face_area);
+			double perimeter = 0.0;
+			for (std::size_t j = 0, l = plg.size() - 1; j < plg.size(); l = j, ++j)
+				perimeter += distance(plg[l], plg[j]);
+
+			// the cost of the face (negative if it is worth selecting), and how far it may be from the estimate
+			double cost = coeff_coverage * (face_area - area) - coeff_data_fitting * num;
+			double error = sigmas * coeff_data_fitting * std::sqrt(variance) + coeff_coverage * std::min(perimeter * band, face_area);
+			if (std::abs(cost) > error) {
+				nums[i] = num;
+				covered[i] = area;
+				conclusive[i] = 1;
+			}
+		}
+	}, nil, Method::num_threads);
+
+	MapFacetAttribute<double>	supporting_point_num_attrib(mesh, Method::facet_attrib_supporting_point_num);
+	MapFacetAttribute<double>	facet_area_attrib(mesh, Method::facet_attrib_facet_area);
+	MapFacetAttribute<double>	covered_area_attrib(mesh, Method::facet_attrib_covered_area);
+	std::size_t num_estimated = 0;
+	for (std::size_t k = 0; k < groups.size(); ++k) {
+		const std::vector<std::size_t>& indices = group_facets[groups[k]];
+		for (std::size_t m = 0; m < indices.size(); ++m) {
+			std::size_t i = indices[m];
+			Map::Facet* f = facets[i];
+			if (!conclusive[i]) {
+				exact.push_back(f);
+				continue;
+			}
+			supporting_point_num_attrib[f] = nums[i];
+			facet_area_attrib[f] = areas[i];
+			covered_area_attrib[f] = covered[i];
+			++num_estimated;
+			if (progress)
+				progress->next();
+		}
+	}
+
+	Logger::out("-") << "confidences of " << num_estimated << " faces estimated from samples, " 
+		<< exact.size() << " faces to compute. " << w.elapsed() << " sec." << std::endl;
+	Profiler::add_counter("faces estimated", double(num_estimated));
+	facet_attrib_supporting_vertex_group_.unbind();
 }
 
 
-float HypothesisGenerator::facet_points_projected_in(PointSet* pset, VertexGroup* g, MapTypes::Facet* f, float max_dist, std::vector<unsigned int>& points) {
+float HypothesisGenerator::facet_points_projected_in(PointSet* pset, VertexGroup* g, MapTypes::Facet* f, float max_dist, std::vector<unsigned int>& points, const SegmentPointGrid* grid /* = nil */, MapGeometryCache* geometry /* = nil */) {
 	const Plane3d& plane = g->plane();
 	const vec3& orig = plane.point();
 	const vec3& base1 = plane.base1();
 	const vec3& base2 = plane.base2();
 
-	const Polygon3d& plg3d = Geom::facet_polygon(f);
-	const Polygon2d& plg2d = Geom::to_2d(orig, base1, base2, plg3d);
+	// without a cache, the polygon is written into buffers reused by the calls of each thread
+	static thread_local SmallPolygon3d local_plg;
+	static thread_local Polygon2d local_plg2d;
+	if (!geometry) {
+		Geom::facet_polygon(f, local_plg);
+		Geom::to_2d(orig, base1, base2, local_plg, local_plg2d);
+	}
+	const Polygon2d& plg2d = geometry ? geometry->facet_polygon_2d(f, &plane) : local_plg2d;
 	const std::vector<vec3>& pts = pset->points();
 	const std::vector<float>& confidences = pset->planar_qualities();
+	// the points of a downsampled point set count for the points they stand for
+	const bool weighted = pset->has_weights();
+	const std::vector<float>& weights = pset->weights();
+
+	// the projection of the segment, if kept (see SegmentProjection)
+	const VertexGroup::Projection* projection = SegmentProjection::of(g);
 
 	points.clear();
 	float epsilon = max_dist * 0.5f;// considering noise and outliers
 	float count = 0.0f;
+	if (grid) {
+		std::vector<unsigned int> positions;
+		grid->points_in_polygon(plg2d, positions);
+		for (std::size_t i = 0; i < positions.size(); ++i)
+			points.push_back(g->at(positions[i]));
+
+		// the distances in one batch (into a buffer reused by the calls of each thread)
+		static thread_local std::vector<float> distances;
+		distances.resize(points.size());
+		if (projection) {
+			for (std::size_t i = 0; i < positions.size(); ++i)
+				distances[i] = projection->distances[positions[i]];
+		}
+		else if (const float* padded = pset->padded_points())
+			plane.signed_distances_padded(padded, points.data(), points.size(), distances.data());
+		else
+			plane.signed_distances(pts.data(), points.data(), points.size(), distances.data());
+		for (std::size_t i = 0; i < points.size(); ++i) {
+			unsigned int idx = points[i];
+			float dist = std::abs(distances[i]);
+			if (dist < epsilon) { // in case of numerical issues (floating point precision)
+				count += (1 - dist / epsilon) * confidences[idx] * (weighted ? weights[idx] : 1.0f);
+			}
+		}
+		return count;
+	}
+
+	// the projections are classified in one batch
+	static thread_local std::vector<vec2> projections;
+	static thread_local std::vector<Numeric::uint8> inside;
+	inside.resize(g->size());
+	if (!projection) {
+		projections.resize(g->size());
+		for (int i = 0; i < g->size(); ++i)
+			projections[i] = Geom::to_2d(orig, base1, base2, pts[g->at(i)]);
+	}
+	const vec2* projected = projection ? projection->points.data() : projections.data();
+	Geom::PolygonClassifier classifier(plg2d);
+	classifier.classify(projected, nil, g->size(), inside.data());
+
 	for (int i = 0; i < g->size(); ++i) {
 		unsigned int idx = g->at(i);
 		const vec3& p = pts[idx];
-		const vec2& q = Geom::to_2d(orig, base1, base2, p);
-		if (Geom::point_is_in_polygon(plg2d, q)) {
+		if (inside[i]) {
 			points.push_back(idx);
-			float dist = std::sqrt(plane.squared_ditance(p));
+			float dist = projection ? std::abs(projection->distances[i]) : std::sqrt(plane.squared_ditance(p));
 			if (dist < epsilon) { // in case of numerical issues (floating point precision)
-				count += (1 - dist / epsilon) * confidences[idx];
+				count += (1 - dist / epsilon) * confidences[idx] * (weighted ? weights[idx] : 1.0f);
 			}
 		}
 	}
@@ -1140,78 +4199,176 @@ float HypothesisGenerator::facet_points_projected_in(PointSet* pset, VertexGroup
 
 
 
-HypothesisGenerator::Adjacency HypothesisGenerator::extract_adjacency(Map* mesh) {
-	vertex_source_planes_.bind(mesh, "VertexSourcePlanes");
+bool HypothesisGenerator::device_points_projected_in(const std::vector<MapTypes::Facet*>& facets, float max_dist, bool use_confidence, MapGeometryCache& geometry, std::vector<double>& nums) {
+	FacetPointCounter* counter = FacetPointCounter::instance();
+	if (!counter || facets.empty())
+		return false;
 
-	// an edge is denoted by its two end points
-	typedef typename std::map< vec3*, std::set<MapTypes::Halfedge*> >	Edge_map;
-	typedef typename std::map< vec3*, Edge_map >						Face_pool;
-	Face_pool face_pool;
+	StopWatch w;
+	ProfileStage stage("device_point_counting");
+
+	// the faces of each segment (in the order the segments are first met)
+	std::vector<VertexGroup*> groups;
+	std::unordered_map<VertexGroup*, std::vector<std::size_t> > group_facets;
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		VertexGroup* g = facet_attrib_supporting_vertex_group_[facets[i]];
+		std::vector<std::size_t>& indices = group_facets[g];
+		if (indices.empty())
+			groups.push_back(g);
+		indices.push_back(i);
+	}
 
-	FOR_EACH_HALFEDGE(Map, mesh, h) {
-		if (h->facet() == 0)
+	const std::vector<vec3>& pts = pset_->points();
+	const std::vector<float>& confidences = pset_->planar_qualities();
+	const float epsilon = max_dist * 0.5f;	// as in facet_points_projected_in()
+
+	nums.assign(facets.size(), 0.0);
+	std::vector<vec2> points, values, corners, sums;
+	std::vector<unsigned int> offsets;
+	for (std::size_t k = 0; k < groups.size(); ++k) {
+		VertexGroup* g = groups[k];
+		const std::vector<std::size_t>& indices = group_facets[g];
+		if (!g)
 			continue;
+		const Plane3d& plane = g->plane();
+		const vec3& orig = plane.point();
+		const vec3& base1 = plane.base1();
+		const vec3& base2 = plane.base2();
+
+		// the projected points, with their number (x) and their confidence (y), which don't depend on the faces
+		const VertexGroup::Projection* projection = SegmentProjection::of(g);
+		points.resize(g->size());
+		values.resize(g->size());
+		for (std::size_t i = 0; i < g->size(); ++i) {
+			unsigned int idx = g->at(i);
+			points[i] = projection ? projection->points[i] : Geom::to_2d(orig, base1, base2, pts[idx]);
+			float weight = pset_->weight(idx);
+			float dist = projection ? std::abs(projection->distances[i]) : std::sqrt(plane.squared_ditance(pts[idx]));
+			values[i] = vec2(weight, dist < epsilon ? (1 - dist / epsilon) * confidences[idx] * weight : 0.0f);
+		}
 
-		Map::Vertex* sd = h->opposite()->vertex();
-		Map::Vertex* td = h->vertex();
+		corners.clear();
+		offsets.assign(1, 0);
+		for (std::size_t i = 0; i < indices.size(); ++i) {
+			const Polygon2d& plg = geometry.facet_polygon_2d(facets[indices[i]], &plane);
+			corners.insert(corners.end(), plg.begin(), plg.end());
+			offsets.push_back(static_cast<unsigned int>(corners.size()));
+		}
 
-		std::set<Plane3d*>& set_s = vertex_source_planes_[sd];
-		std::set<Plane3d*>& set_t = vertex_source_planes_[td];
-		CGAL_assertion(set_s.size() == 3);
-		CGAL_assertion(set_t.size() == 3);
+		if (!counter->sum_points_in_polygons(points, values, corners, offsets, sums) || sums.size() != indices.size()) {
+			Logger::warn("-") << counter->name() << " failed counting the supporting points (counted on the CPU instead)" << std::endl;
+			return false;
+		}
+		for (std::size_t i = 0; i < indices.size(); ++i)
+			nums[indices[i]] = use_confidence ? sums[i].y : sums[i].x;
+	}
 
-		std::vector<Plane3d*> s_planes(set_s.begin(), set_s.end());
-		CGAL_assertion(s_planes[0] < s_planes[1]);
-		CGAL_assertion(s_planes[1] < s_planes[2]);
-		vec3* s = triplet_intersection_[s_planes[0]][s_planes[1]][s_planes[2]];
+	Logger::out("-") << "supporting points counted by " << counter->name() << ". " << w.elapsed() << " sec." << std::endl;
+	return true;
+}
 
-		std::vector<Plane3d*> t_planes(set_t.begin(), set_t.end());
-		CGAL_assertion(t_planes[0] < t_planes[1]);
-		CGAL_assertion(t_planes[1] < t_planes[2]);
-		vec3* t = triplet_intersection_[t_planes[0]][t_planes[1]][t_planes[2]];
 
-		if (s > t)
-			std::swap(s, t);
-		face_pool[s][t].insert(h);
-	}
+HypothesisGenerator::Adjacency HypothesisGenerator::extract_adjacency(Map* mesh) {
+	ScopedThreadBudget budget(thread_budget());
+	ProfileStage stage("extract_adjacency");
 
-#ifdef DISPLAY_ADJACENCY_STATISTICS
-	std::map<std::size_t, std::size_t>   num_each_sized_fans;
-	for (std::size_t i = 1; i < 20; ++i)
-		num_each_sized_fans[i] = 0;
-#endif
+	vertex_source_planes_.bind(mesh, "VertexSourcePlanes");
+
+	// Each arrangement vertex (i.e., intersecting point of a plane triplet, which may be shared by 
+	// several mesh vertices) gets a dense id, and an edge is denoted by the ids of its two end points.
+	// The ids and the super edges are numbered in the order they are first met, so the result 
+	// doesn't depend on the memory addresses. The nodes of the maps are taken from the arena of the
+	// stage (and freed at once), and the maps are reserved, so they don't leave their buckets behind.
+	typedef std::pair<const vec3* const, unsigned int>			VertexId;
+	typedef std::pair<const Numeric::uint64, unsigned int>	EdgeId;
+	typedef std::unordered_map<const vec3*, unsigned int, std::hash<const vec3*>, std::equal_to<const vec3*>, ArenaAllocator<VertexId> >		VertexIds;
+	typedef std::unordered_map<Numeric::uint64, unsigned int, std::hash<Numeric::uint64>, std::equal_to<Numeric::uint64>, ArenaAllocator<EdgeId> >	EdgeIds;
+	MonotonicArena arena(1024 * 1024);
+	VertexIds vertex_ids(mesh->size_of_vertices(), std::hash<const vec3*>(), std::equal_to<const vec3*>(), ArenaAllocator<VertexId>(&arena));
+	std::vector<const vec3*> points;
+	EdgeIds edge_ids(mesh->size_of_halfedges() / 2, std::hash<Numeric::uint64>(), std::equal_to<Numeric::uint64>(), ArenaAllocator<EdgeId>(&arena));
 
 	Adjacency fans;
-	Face_pool::const_iterator it = face_pool.begin();
-	for (; it != face_pool.end(); ++it) {
-		const vec3* s = it->first;
-		const Edge_map& tmp = it->second;
-		Edge_map::const_iterator cur = tmp.begin();
-		for (; cur != tmp.end(); ++cur) {
-			const vec3* t = cur->first;
-			const std::set<Map::Halfedge*>& faces = cur->second;
-			SuperEdge fan;
-			fan.s = s;
-			fan.t = t;
-			fan.insert(fan.end(), faces.begin(), faces.end());
-			fans.push_back(fan);
 
-#ifdef DISPLAY_ADJACENCY_STATISTICS
-			++num_each_sized_fans[fan.size()];
-#endif
+	// the super edge of each halfedge
+	std::vector< std::pair<unsigned int, Map::Halfedge*> > edge_halfedges;
+	edge_halfedges.reserve(mesh->size_of_halfedges());
+	std::vector<std::size_t>& counts = fans.offsets_;
+
+	// The sweep runs on an index-based copy of the mesh: the intersecting point of each vertex is 
+	// looked up once into a dense column (instead of once for each of its halfedges), and the 
+	// halfedges are visited in the arrays of the copy, in pairs (see CompactMesh::assign()).
+	CompactMesh compact;
+	CompactMesh::MapElements elements;
+	compact.assign(mesh, &elements);
+
+	CompactVertexAttribute<const vec3*> vertex_point(&compact, nil);
+	FOR_EACH_COMPACT_VERTEX(&compact, v) {
+		const PlaneIdSet<3>& set = vertex_source_planes_[elements.vertices[v]];
+		if (set.size() == 3)
+			vertex_point[v] = query_intersection(set[0], set[1], set[2]);
+	}
+
+	FOR_EACH_COMPACT_HALFEDGE(&compact, h) {
+		if (compact.is_border(h))
+			continue;
+
+		const vec3* ends[2] = {
+			vertex_point[compact.vertex(compact.opposite(h))],
+			vertex_point[compact.vertex(h)]
+		};
+		CGAL_assertion(ends[0] != nil);
+		CGAL_assertion(ends[1] != nil);
+		Numeric::uint64 ids[2];
+		for (int i = 0; i < 2; ++i) {
+			std::pair<VertexIds::iterator, bool> pos = 
+				vertex_ids.insert(std::make_pair(ends[i], static_cast<unsigned int>(points.size())));
+			if (pos.second)
+				points.push_back(ends[i]);
+			ids[i] = pos.first->second;
+		}
+		if (ids[0] > ids[1])
+			std::swap(ids[0], ids[1]);
+
+		Numeric::uint64 key = (ids[0] << 32) | ids[1];
+		std::pair<EdgeIds::iterator, bool> pos = 
+			edge_ids.insert(std::make_pair(key, static_cast<unsigned int>(fans.ends_.size())));
+		if (pos.second) {
+			fans.ends_.push_back(std::make_pair(points[ids[0]], points[ids[1]]));
+			counts.push_back(0);
 		}
+		unsigned int edge = pos.first->second;
+		++counts[edge + 1];
+		edge_halfedges.push_back(std::make_pair(edge, elements.halfedges[h]));
 	}
 
-#ifdef DISPLAY_ADJACENCY_STATISTICS
+	// counting sort of the halfedges by their super edges
+	for (std::size_t i = 1; i < counts.size(); ++i)
+		counts[i] += counts[i - 1];
+	fans.halfedges_.resize(edge_halfedges.size());
+	std::vector<std::size_t> next(counts.begin(), counts.end() - 1);
+	for (std::size_t i = 0; i < edge_halfedges.size(); ++i)
+		fans.halfedges_[next[edge_halfedges[i].first]++] = edge_halfedges[i].second;
+
+	// the sizes of the fans (e.g., shown by the profiling panel of the GUI), 2 for the edges of a manifold
+	std::map<std::size_t, std::size_t>   num_each_sized_fans;
+	for (std::size_t i = 0; i < fans.size(); ++i)
+		++num_each_sized_fans[fans[i].size()];
+
 	std::map<std::size_t, std::size_t>::iterator pos = num_each_sized_fans.begin();
 	for (; pos != num_each_sized_fans.end(); ++pos) {
-		if (pos->second > 0)
-			std::cout << "\t" << pos->first << " - sized fans: " << pos->second << std::endl;
-	}
+		std::ostringstream name;
+		name << "fans of size " << pos->first;
+		Profiler::add_counter(name.str(), double(pos->second));
+#ifdef DISPLAY_ADJACENCY_STATISTICS
+		std::cout << "\t" << pos->first << " - sized fans: " << pos->second << std::endl;
 #endif
+	}
 
 	vertex_source_planes_.unbind();
 
+	Profiler::add_counter("triplet lookups", double(compact.size_of_vertices()));
+	Profiler::add_counter("super edges", double(fans.size()));
 	return fans;
 }
 
@@ -1224,3 +4381,414 @@ bool HypothesisGenerator::ready_for_optimization(Map* mesh) const {
 		MapFacetAttribute<double>::is_defined(mesh, Method::facet_attrib_covered_area)
 		);
 }
+
+
+std::size_t HypothesisGenerator::validate_source_planes(Map* mesh) const {
+	if (!MapFacetAttribute<Plane3d*>::is_defined(mesh, "FacetSupportingPlane") ||
+		!MapHalfedgeAttribute< PlaneIdSet<2> >::is_defined(mesh, "EdgeSourcePlanes") ||
+		!MapVertexAttribute< PlaneIdSet<3> >::is_defined(mesh, "VertexSourcePlanes"))
+		return 0;
+
+	MapFacetAttribute<Plane3d*>				face_supporting_plane(mesh, "FacetSupportingPlane");
+	MapHalfedgeAttribute< PlaneIdSet<2> >	edge_source_planes(mesh, "EdgeSourcePlanes");
+	MapVertexAttribute< PlaneIdSet<3> >		vertex_source_planes(mesh, "VertexSourcePlanes");
+
+	const unsigned int num_planes = static_cast<unsigned int>(supporting_planes_.size());
+	std::size_t num_invalid = 0;
+	FOR_EACH_FACET(Map, mesh, it) {
+		if (face_supporting_plane[it] == nil || plane_index_.find(face_supporting_plane[it]) == plane_index_.end())
+			++num_invalid;
+	}
+	FOR_EACH_HALFEDGE(Map, mesh, it) {
+		const PlaneIdSet<2>& edge = edge_source_planes[it];
+		const PlaneIdSet<3>& vertex = vertex_source_planes[it->vertex()];
+		bool valid = edge.size() == 2 && edge[1] < num_planes && vertex.size() == 3;
+		for (PlaneIdSet<2>::const_iterator id = edge.begin(); valid && id != edge.end(); ++id)
+			valid = vertex.contains(*id);
+		if (!valid)
+			++num_invalid;
+	}
+	FOR_EACH_VERTEX(Map, mesh, it) {
+		const PlaneIdSet<3>& vertex = vertex_source_planes[it];
+		if (vertex.size() != 3 || vertex[2] >= num_planes)
+			++num_invalid;
+	}
+	return num_invalid;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+	const char	checkpoint_tag[4] = { 'P', 'F', 'H', 'C' };
+	const int	checkpoint_version = 2;		// 2: the snapped segments
+
+	template <class T>
+	void write_value(std::ostream& output, const T& value) {
+		output.write((const char*)&value, sizeof(T));
+	}
+
+	template <class T>
+	bool read_value(std::istream& input, T& value) {
+		input.read((char*)&value, sizeof(T));
+		return !input.fail();
+	}
+
+	template <unsigned int N>
+	void write_plane_ids(std::ostream& output, const PlaneIdSet<N>& ids) {
+		write_value(output, static_cast<int>(ids.size()));
+		for (typename PlaneIdSet<N>::const_iterator it = ids.begin(); it != ids.end(); ++it)
+			write_value(output, *it);
+	}
+
+	template <unsigned int N>
+	bool read_plane_ids(std::istream& input, unsigned int num_planes, PlaneIdSet<N>& ids) {
+		int num = 0;
+		if (!read_value(input, num) || num < 0 || num > static_cast<int>(N))
+			return false;
+
+		ids.clear();
+		for (int i = 0; i < num; ++i) {
+			unsigned int id = 0;
+			if (!read_value(input, id) || id >= num_planes)
+				return false;
+			ids.insert(id);
+		}
+		return true;
+	}
+
+
+	// Restores the exact topology (and the order of the elements) of a mesh written by save_checkpoint()
+	class CheckpointTopology : public MapMutator
+	{
+	public:
+		CheckpointTopology(Map* mesh) : MapMutator(mesh) {}
+
+		// reads the vertices and the halfedges (with their source planes), and the facets, which 
+		// are returned in the order they were written
+		bool read(
+			std::istream& input,
+			unsigned int num_planes,
+			MapVertexAttribute< PlaneIdSet<3> >& vertex_source_planes,
+			MapHalfedgeAttribute< PlaneIdSet<2> >& edge_source_planes,
+			std::vector<Map::Facet*>& facets
+		);
+	};
+
+
+	bool CheckpointTopology::read(
+		std::istream& input,
+		unsigned int num_planes,
+		MapVertexAttribute< PlaneIdSet<3> >& vertex_source_planes,
+		MapHalfedgeAttribute< PlaneIdSet<2> >& edge_source_planes,
+		std::vector<Map::Facet*>& facets)
+	{
+		int num_vertices = 0, num_halfedges = 0, num_facets = 0;
+		if (!read_value(input, num_vertices) || !read_value(input, num_halfedges) || !read_value(input, num_facets))
+			return false;
+		if (num_vertices < 0 || num_halfedges < 0 || num_facets < 0)
+			return false;
+
+		// all the elements are created first, so the records can refer to each other by their indices
+		std::vector<Vertex*>	vertices(num_vertices);
+		std::vector<Halfedge*>	halfedges(num_halfedges);
+		for (int i = 0; i < num_vertices; ++i)
+			vertices[i] = new_vertex();
+		for (int i = 0; i < num_halfedges; ++i)
+			halfedges[i] = new_halfedge();
+		facets.resize(num_facets);
+		for (int i = 0; i < num_facets; ++i)
+			facets[i] = new_facet();
+
+		for (int i = 0; i < num_vertices; ++i) {
+			vec3 p;
+			int h = -1;
+			if (!read_value(input, p) || !read_value(input, h) || h < 0 || h >= num_halfedges)
+				return false;
+			Vertex* v = vertices[i];
+			v->set_point(p);
+			set_vertex_halfedge(v, halfedges[h]);
+			if (!read_plane_ids(input, num_planes, vertex_source_planes[v]))
+				return false;
+		}
+
+		for (int i = 0; i < num_halfedges; ++i) {
+			int next = -1, prev = -1, opposite = -1, v = -1, f = -1;
+			if (!read_value(input, next) || !read_value(input, prev) || !read_value(input, opposite) || !read_value(input, v) || !read_value(input, f))
+				return false;
+			if (next < 0 || next >= num_halfedges || prev < 0 || prev >= num_halfedges || opposite < 0 || opposite >= num_halfedges)
+				return false;
+			if (v < 0 || v >= num_vertices || f < -1 || f >= num_facets)
+				return false;
+
+			Halfedge* h = halfedges[i];
+			set_halfedge_next(h, halfedges[next]);
+			set_halfedge_prev(h, halfedges[prev]);
+			set_halfedge_opposite(h, halfedges[opposite]);
+			set_halfedge_vertex(h, vertices[v]);
+			set_halfedge_facet(h, f >= 0 ? facets[f] : nil);
+			if (!read_plane_ids(input, num_planes, edge_source_planes[h]))
+				return false;
+		}
+
+		for (int i = 0; i < num_facets; ++i) {
+			int h = -1;
+			if (!read_value(input, h) || h < 0 || h >= num_halfedges)
+				return false;
+			set_facet_halfedge(facets[i], halfedges[h]);
+		}
+
+		return true;
+	}
+}
+
+
+bool HypothesisGenerator::save_checkpoint(Map* mesh, const std::string& file_name) const {
+	if (!mesh || !pset_)
+		return false;
+
+	std::ofstream output(file_name.c_str(), std::fstream::binary);
+	if (output.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+
+	output.write(checkpoint_tag, sizeof(checkpoint_tag));
+	write_value(output, checkpoint_version);
+
+	// the planes, each with the index of its segment in the point set (-1 for the bbox faces, and -2 
+	// for the planes no longer used after regenerate())
+	std::map<const VertexGroup*, int> group_index;
+	const std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		group_index[groups[i]] = static_cast<int>(i);
+
+	std::unordered_map<const Plane3d*, int> plane_group;
+	for (std::map<VertexGroup*, Plane3d*>::const_iterator it = vertex_group_plane_.begin(); it != vertex_group_plane_.end(); ++it) {
+		std::map<const VertexGroup*, int>::const_iterator pos = group_index.find(it->first);
+		if (pos != group_index.end() && snapped_segments_.find(it->first) == snapped_segments_.end())
+			plane_group[it->second] = pos->second;
+	}
+
+	write_value(output, static_cast<int>(supporting_planes_.size()));
+	for (std::size_t i = 0; i < supporting_planes_.size(); ++i) {
+		const Plane3d* plane = supporting_planes_[i];
+		for (std::size_t j = 0; j < 4; ++j)
+			write_value(output, (*plane)[j]);
+		std::unordered_map<const Plane3d*, int>::const_iterator pos = plane_group.find(plane);
+		if (pos != plane_group.end())
+			write_value(output, pos->second);
+		else
+			write_value(output, std::find(bbox_planes_.begin(), bbox_planes_.end(), plane) != bbox_planes_.end() ? -1 : -2);
+	}
+
+	// the segments snapped to the plane of another one (see regularize_planes()), as (segment, representative)
+	std::vector< std::pair<int, int> > snapped;
+	for (std::map<VertexGroup*, VertexGroup*>::const_iterator it = snapped_segments_.begin(); it != snapped_segments_.end(); ++it) {
+		std::map<const VertexGroup*, int>::const_iterator member = group_index.find(it->first);
+		std::map<const VertexGroup*, int>::const_iterator representative = group_index.find(it->second);
+		if (member != group_index.end() && representative != group_index.end())
+			snapped.push_back(std::make_pair(member->second, representative->second));
+	}
+	write_value(output, static_cast<int>(snapped.size()));
+	for (std::size_t i = 0; i < snapped.size(); ++i) {
+		write_value(output, snapped[i].first);
+		write_value(output, snapped[i].second);
+	}
+
+	// the topology, in which the elements refer to each other by their indices
+	std::unordered_map<const Map::Vertex*, int>		vertex_index;
+	std::unordered_map<const Map::Halfedge*, int>	halfedge_index;
+	std::unordered_map<const Map::Facet*, int>		facet_index;
+	FOR_EACH_VERTEX(Map, mesh, it) {
+		int idx = static_cast<int>(vertex_index.size());
+		vertex_index[it] = idx;
+	}
+	FOR_EACH_HALFEDGE(Map, mesh, it) {
+		int idx = static_cast<int>(halfedge_index.size());
+		halfedge_index[it] = idx;
+	}
+	FOR_EACH_FACET(Map, mesh, it) {
+		int idx = static_cast<int>(facet_index.size());
+		facet_index[it] = idx;
+	}
+
+	write_value(output, mesh->size_of_vertices());
+	write_value(output, mesh->size_of_halfedges());
+	write_value(output, mesh->size_of_facets());
+
+	MapVertexAttribute< PlaneIdSet<3> >		vertex_source_planes(mesh, "VertexSourcePlanes");
+	FOR_EACH_VERTEX(Map, mesh, it) {
+		write_value(output, it->point());
+		write_value(output, halfedge_index[it->halfedge()]);
+		write_plane_ids(output, vertex_source_planes[it]);
+	}
+
+	MapHalfedgeAttribute< PlaneIdSet<2> >	edge_source_planes(mesh, "EdgeSourcePlanes");
+	FOR_EACH_HALFEDGE(Map, mesh, it) {
+		write_value(output, halfedge_index[it->next()]);
+		write_value(output, halfedge_index[it->prev()]);
+		write_value(output, halfedge_index[it->opposite()]);
+		write_value(output, vertex_index[it->vertex()]);
+		write_value(output, it->facet() ? facet_index[it->facet()] : -1);
+		write_plane_ids(output, edge_source_planes[it]);
+	}
+
+	FOR_EACH_FACET(Map, mesh, it)
+		write_value(output, halfedge_index[it->halfedge()]);
+
+	// the face attributes
+	MapFacetAttribute<Color>			color(mesh, "color");
+	MapFacetAttribute<VertexGroup*>		supporting_vertex_group(mesh, Method::facet_attrib_supporting_vertex_group);
+	MapFacetAttribute<Plane3d*>			supporting_plane(mesh, "FacetSupportingPlane");
+	FOR_EACH_FACET(Map, mesh, it) {
+		const Plane3d* plane = supporting_plane[it];
+		write_value(output, plane ? static_cast<int>(plane_id(plane)) : -1);
+		std::map<const VertexGroup*, int>::const_iterator pos = group_index.find(supporting_vertex_group[it]);
+		write_value(output, pos != group_index.end() ? pos->second : -1);
+		write_value(output, color[it]);
+	}
+
+	bool has_confidences = ready_for_optimization(mesh);
+	write_value(output, static_cast<int>(has_confidences));
+	if (has_confidences) {
+		write_value(output, confidence_max_dist_);
+		write_value(output, confidence_radius_);
+		write_value(output, static_cast<int>(use_confidence_));
+
+		MapFacetAttribute<double> facet_attrib_supporting_point_num(mesh, Method::facet_attrib_supporting_point_num);
+		MapFacetAttribute<double> facet_attrib_facet_area(mesh, Method::facet_attrib_facet_area);
+		MapFacetAttribute<double> facet_attrib_covered_area(mesh, Method::facet_attrib_covered_area);
+		FOR_EACH_FACET(Map, mesh, it) {
+			write_value(output, facet_attrib_supporting_point_num[it]);
+			write_value(output, facet_attrib_facet_area[it]);
+			write_value(output, facet_attrib_covered_area[it]);
+		}
+	}
+
+	if (output.fail()) {
+		Logger::err("-") << "failed writing file\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+Map* HypothesisGenerator::load_checkpoint(const std::string& file_name) {
+	if (!pset_)
+		return nil;
+
+	std::ifstream input(file_name.c_str(), std::fstream::binary);
+	if (input.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return nil;
+	}
+
+	char tag[4];
+	int version = 0;
+	input.read(tag, sizeof(tag));
+	if (input.fail() || !std::equal(tag, tag + 4, checkpoint_tag) || !read_value(input, version) || version != checkpoint_version) {
+		Logger::err("-") << "\'" << file_name << "\' is not a hypothesis checkpoint file" << std::endl;
+		return nil;
+	}
+
+	clear();
+	plane_segments_.clear();
+	vertex_group_plane_.clear();
+	snapped_segments_.clear();
+
+	Map* mesh = nil;
+	auto corrupted = [&]() -> Map* {
+		Logger::err("-") << "corrupted file or the point set doesn't match: \'" << file_name << "\'" << std::endl;
+		delete mesh;
+		clear();
+		plane_segments_.clear();
+		vertex_group_plane_.clear();
+		snapped_segments_.clear();
+		return nil;
+	};
+
+	std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	int num_planes = 0;
+	if (!read_value(input, num_planes) || num_planes < 0)
+		return corrupted();
+	for (int i = 0; i < num_planes; ++i) {
+		float coeff[4];
+		int group = -1;
+		if (!read_value(input, coeff) || !read_value(input, group) || group < -2 || group >= static_cast<int>(groups.size()))
+			return corrupted();
+
+		Plane3d* plane = add_supporting_plane(Plane3d(coeff[0], coeff[1], coeff[2], coeff[3]));
+		if (group == -1)
+			bbox_planes_.push_back(plane);
+		else if (group >= 0) {
+			VertexGroup* g = groups[group];
+			plane_segments_.push_back(g);
+			vertex_group_plane_[g] = plane;
+		}
+	}
+
+	int num_snapped = 0;
+	if (!read_value(input, num_snapped) || num_snapped < 0)
+		return corrupted();
+	for (int i = 0; i < num_snapped; ++i) {
+		int member = -1, representative = -1;
+		if (!read_value(input, member) || !read_value(input, representative) || member < 0 || representative < 0 ||
+			member >= static_cast<int>(groups.size()) || representative >= static_cast<int>(groups.size()))
+			return corrupted();
+		std::map<VertexGroup*, Plane3d*>::const_iterator pos = vertex_group_plane_.find(groups[representative]);
+		if (pos == vertex_group_plane_.end())
+			return corrupted();
+		VertexGroup* g = groups[member];
+		snapped_segments_[g] = groups[representative];
+		vertex_group_plane_[g] = pos->second;
+		g->set_plane(*pos->second);
+	}
+
+	mesh = new Map;
+	CutAttributes attribs(mesh);
+	std::vector<Map::Facet*> facets;
+	CheckpointTopology topology(mesh);
+	if (!topology.read(input, num_planes, attribs.vertex_source_planes, attribs.edge_source_planes, facets))
+		return corrupted();
+
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		Map::Facet* f = facets[i];
+		int plane = -1, group = -1;
+		if (!read_value(input, plane) || !read_value(input, group) || !read_value(input, attribs.color[f]))
+			return corrupted();
+		if (plane < -1 || plane >= num_planes || group < -1 || group >= static_cast<int>(groups.size()))
+			return corrupted();
+		attribs.supporting_plane[f] = plane >= 0 ? supporting_planes_[plane] : nil;
+		attribs.supporting_vertex_group[f] = group >= 0 ? groups[group].get() : nil;
+	}
+
+	int has_confidences = 0;
+	if (!read_value(input, has_confidences))
+		return corrupted();
+	if (has_confidences) {
+		int use_confidence = 0;
+		if (!read_value(input, confidence_max_dist_) || !read_value(input, confidence_radius_) || !read_value(input, use_confidence))
+			return corrupted();
+		use_confidence_ = (use_confidence != 0);
+
+		MapFacetAttribute<double> facet_attrib_supporting_point_num(mesh, Method::facet_attrib_supporting_point_num);
+		MapFacetAttribute<double> facet_attrib_facet_area(mesh, Method::facet_attrib_facet_area);
+		MapFacetAttribute<double> facet_attrib_covered_area(mesh, Method::facet_attrib_covered_area);
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			Map::Facet* f = facets[i];
+			if (!read_value(input, facet_attrib_supporting_point_num[f]) || 
+				!read_value(input, facet_attrib_facet_area[f]) || 
+				!read_value(input, facet_attrib_covered_area[f]))
+				return corrupted();
+		}
+	}
+
+	// the intersections of the plane triplets are needed by extract_adjacency()
+	triplet_intersection();
+
+	Logger::out("-") << "checkpoint loaded: " << supporting_planes_.size() << " planes, " 
+		<< mesh->size_of_facets() << " candidate faces" << (has_confidences ? " (with confidences)" : "") << std::endl;
+	return mesh;
+}
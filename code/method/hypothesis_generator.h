@@ -24,9 +24,19 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../math/polygon2d.h"
 #include "../model/vertex_group.h"
 #include "../model/map_attributes.h"
+#include "../model/point_search.h"
+#include "triplet_intersection_table.h"
+#include "plane_id_set.h"
+#include "vertex_registry.h"
+#include "plane_arrangement.h"
+#include "../basic/monotonic_arena.h"
 
 #include <string>
 #include <vector>
+#include <set>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
 
 
 class Map;
@@ -34,6 +44,11 @@ class PointSet;
 class VertexGroup;
 class MapEditor;
 class ProgressLogger;
+class BoxTree;
+class SegmentPointGrid;
+class MapGeometryCache;
+class ImplicitHypothesis;
+class ReconstructionContext;
 
 namespace MapTypes {
 	class Vertex;
@@ -47,40 +62,243 @@ public:
 	HypothesisGenerator(PointSet* pset);
 	~HypothesisGenerator();
 
-	void refine_planes();
+	// Merges the nearly coplanar segments: those whose planes make an angle below 'angle' (in degree)
+	// and that have enough points within 'distance_factor' times the average of the largest distances 
+	// of the segments to their planes. Larger values merge more (e.g., for a coarse pass).
+	void refine_planes(float angle = 10.0f, float distance_factor = 0.5f);
+
+	// what the plane budget (see Method::max_planes) of the last refine_planes() discarded
+	struct BudgetReport {
+		BudgetReport() : num_segments(0), num_kept(0), kept_fraction(1.0) {}
+
+		std::size_t num_segments;	// before the budget
+		std::size_t num_kept;
+		double		kept_fraction;	// of the (weighted) points of the segments, in the kept segments
+		std::vector< std::pair<std::string, std::size_t> > absorbed;	// the label and the size of the absorbed segments
+		std::vector< std::pair<std::string, std::size_t> > dropped;		// and of the dropped ones
+	};
+	const BudgetReport& budget_report() const { return budget_report_; }
+
+	// Keeps the planes of the segments as they are in generate(), instead of refitting them to the
+	// points, e.g., for a part of a larger point set whose segments were fitted (and refined) as a 
+	// whole, so that all the parts use the same planes (see TiledReconstruction).
+	void set_keep_planes(bool keep) { keep_planes_ = keep; }
+
+	// Takes the weights of the face selection (which decide the faces worth computing exactly, see
+	// Method::sampled_confidences) and the thread budget from 'context' instead of the options (see
+	// ReconstructionContext). The context must outlive the generator; nil (the default) means the options.
+	void set_context(const ReconstructionContext* context) { context_ = context; }
 
 	Map* generate();
 
+	// A prediction of the size of the problem, for deciding how (or whether) to run generate()
+	struct Estimate {
+		Estimate() : num_proxy_faces(0), num_candidate_faces(0), num_variables(0), num_constraints(0), peak_memory(0)
+			, mesh_memory(0), program_memory(0), triplet_memory(0) {}
+
+		std::size_t num_proxy_faces;
+		std::size_t num_candidate_faces;
+		std::size_t num_variables;		// of the binary program formulated by FaceSelection
+		std::size_t num_constraints;	// of the binary program formulated by FaceSelection
+		std::size_t peak_memory;		// a rough number of bytes of the candidate mesh and the binary program 
+										// (the internal memory of the solver is not included)
+		std::size_t mesh_memory;		// the parts of peak_memory: the candidate mesh,
+		std::size_t program_memory;		// and the binary program
+		std::size_t triplet_memory;		// of the intersections of all the plane triplets if they are precomputed
+										// (see Method::lazy_triplet_intersection), not in peak_memory
+	};
+
+	// Predicts the size of the problem from the refined planes, without doing the cuts. The proxy 
+	// faces are computed exactly, and the candidate faces are counted from the intersections of the 
+	// planes inside each proxy face (assuming general position, i.e., no three intersecting lines 
+	// meet at a point). For proxy faces intersected by too many planes, the pairs of intersecting 
+	// lines are sampled. It respects Method::local_hypothesis.
+	Estimate estimate();
+
+	// the memory used by the "planes" (with their indices) and the "triplet intersections"
+	MemoryUsage memory_usage() const;
+
 	void compute_confidences(Map* mesh, bool use_conficence = false);
 
-	// Intersection: a set of 'faces' intersecting at a common edge
-	struct SuperEdge : public std::vector<MapTypes::Halfedge*> {
+	// An index of the points already built (e.g., while they were read, see StreamingIndexBuilder), 
+	// shared with the point set (see PointSet::point_search()), which the computation of the point 
+	// confidences uses instead of building one, unless the points have changed meanwhile (e.g., 
+	// downsampled).
+	void set_point_search(PointSearch* search);
+
+	// The implicit alternative to generate() (see ImplicitHypothesis): the candidate faces are the faces
+	// of the arrangements of the planes (see PlaneArrangement), which are kept without building the 
+	// mesh. Returns nil on failure (the caller deletes the result).
+	ImplicitHypothesis* generate_implicit();
+
+	// the same as compute_confidences() for an implicit hypothesis: the faces of each plane are 
+	// materialized (one plane at a time) only for computing their statistics
+	void compute_confidences(ImplicitHypothesis* hypothesis, bool use_conficence = false);
+
+	// Builds a new mesh (to be deleted by the caller) with the faces 'faces' (their indices) of an implicit
+	// hypothesis, or all of them if 'faces' is nil, e.g., the faces of a few planes for rendering, or all
+	// the candidates for the face selection. The mesh has the attributes of the one returned by generate() 
+	// (and the confidences if computed), so it is ready for extract_adjacency(). If given, 'facets' 
+	// receives the face created for each index (nil for the faces rejected as invalid).
+	Map* materialize(const ImplicitHypothesis* hypothesis, const std::vector<std::size_t>* faces = nil, std::vector<MapTypes::Facet*>* facets = nil) const;
+
+	// Updates the candidate faces 'mesh' (generated by generate(), with or without the confidences) after 
+	// some segments have been edited, e.g., dropped (i.e., removed from the point set), refit, or merged 
+	// (the merged segment is refit and the absorbed one is dropped). Each edited segment gets a new plane. 
+	// Only the faces lying on the edited planes, or cut by their old or new planes, are rebuilt (and their 
+	// confidences recomputed, with the parameters of the last compute_confidences()), and all the other 
+	// faces are kept. Newly added segments must also be listed in 'segments'.
+	bool regenerate(Map* mesh, const std::vector<VertexGroup*>& segments);
+
+	// Intersection: a set of 'faces' intersecting at a common edge. It refers to the halfedges 
+	// stored in the Adjacency, so it is only valid as long as the Adjacency exists.
+	class SuperEdge {
+	public:
+		SuperEdge() : s(nil), t(nil), begin_(nil), end_(nil) {}
+		SuperEdge(const vec3* s_, const vec3* t_, MapTypes::Halfedge* const* begin, MapTypes::Halfedge* const* end) 
+			: s(s_), t(t_), begin_(begin), end_(end) {}
+
+		std::size_t size() const { return end_ - begin_; }
+		MapTypes::Halfedge* operator[](std::size_t i) const { return begin_[i]; }
+
+		MapTypes::Halfedge* const* begin() const { return begin_; }
+		MapTypes::Halfedge* const* end() const { return end_; }
+
 		const vec3* s;
 		const vec3* t;
+
+	private:
+		MapTypes::Halfedge* const* begin_;
+		MapTypes::Halfedge* const* end_;
+	};
+
+	// All the super edges, with their halfedges stored contiguously: the halfedges of the i-th 
+	// super edge are halfedges_[offsets_[i], offsets_[i + 1]).
+	class Adjacency {
+	public:
+		Adjacency() : offsets_(1, 0) {}
+
+		std::size_t size() const { return ends_.size(); }
+		SuperEdge operator[](std::size_t i) const {
+			return SuperEdge(ends_[i].first, ends_[i].second, halfedges_.data() + offsets_[i], halfedges_.data() + offsets_[i + 1]);
+		}
+
+	private:
+		std::vector< std::pair<const vec3*, const vec3*> >	ends_;
+		std::vector<std::size_t>							offsets_;
+		std::vector<MapTypes::Halfedge*>					halfedges_;
+
+		friend class HypothesisGenerator;
 	};
-	typedef typename std::vector<SuperEdge>		Adjacency;
 
 	// the adjacency information will be used to formulate the hard constraints.
 	Adjacency extract_adjacency(Map* mesh);
 
 	bool ready_for_optimization(Map* mesh) const;
 
+	// Checks the bookkeeping of the planes of the candidate faces (see generate()): each face has one of
+	// the supporting planes, each edge two source planes and each vertex three, including the two of each
+	// edge ending at it. Returns the number of the faces, edges and vertices failing (0 if the mesh has no
+	// source planes, e.g., a loaded model), see MapValidator for the topology.
+	std::size_t validate_source_planes(Map* mesh) const;
+
+	// Writes the candidate faces (i.e., the mesh returned by generate(), with the confidences if they
+	// have been computed) and the supporting planes into a binary checkpoint file.
+	bool save_checkpoint(Map* mesh, const std::string& file_name) const;
+
+	// Restores the candidate faces and the supporting planes from a checkpoint written by save_checkpoint()
+	// for the same (refined) point set, so the face selection can be rerun without generate() and
+	// compute_confidences(). The returned mesh is ready for extract_adjacency(). Returns nil on failure.
+	Map* load_checkpoint(const std::string& file_name);
+
 private:
 	// construct mesh for the bbox of the point set
 	Map* construct_bbox_mesh();
 
 	Map* compute_proxy_mesh(Map* bbox_mesh);
+	// the same faces computed in parallel for the segments (see Method::parallel_proxy_mesh)
+	Map* compute_proxy_mesh_parallel(Map* bbox_mesh);
 
 	// pairwise cut
 	void pairwise_cut(Map* mesh);
 
+	// the alternative to pairwise_cut() (see Method::plane_arrangement): replaces each proxy face by the
+	// arrangement of its cutting planes, computed on its plane (see PlaneArrangement)
+	void arrange_planes(Map* mesh);
+
+	// the attributes read and written when cutting the faces of a mesh. Each mesh being cut (i.e., the 
+	// candidate mesh, or the copy of a single face when cutting in parallel) is accessed through its own 
+	// instance, so the worker threads never share an attribute.
+	struct CutAttributes {
+		CutAttributes(Map* mesh);
+
+		MapFacetAttribute<Color>					color;
+		MapFacetAttribute<VertexGroup*>				supporting_vertex_group;
+		MapFacetAttribute<Plane3d*>					supporting_plane;
+		MapHalfedgeAttribute< PlaneIdSet<2> >		edge_source_planes;
+		MapVertexAttribute< PlaneIdSet<3> >			vertex_source_planes;
+	};
+
+	// a copy of a single face of the candidate mesh, which is cut by a worker thread and then merged back
+	class FacetSubmesh;
+
+	// the cutting planes of a face, in the arena of the stage collecting them (see collect_face_cutters())
+	typedef std::set<Plane3d*, std::less<Plane3d*>, ArenaAllocator<Plane3d*> > CutterSet;
+
+	// collects the cutting planes of all the faces of a proxy mesh (see collect_cutting_planes()). The 
+	// faces are returned in 'faces', and their cutting planes in 'cutters', whose nodes are taken from 
+	// 'arena' (so they are freed at once, with the arena of the caller).
+	void collect_face_cutters(Map* mesh, const CutAttributes& attribs, std::vector<MapTypes::Facet*>& faces, std::vector<CutterSet>& cutters, MonotonicArena& arena);
+
+	// the inflated extent (an oriented box) of a segment, for the local hypothesis mode
+	struct SegmentExtent;
+
+	// the extents of the segments, indexed by the ids of their supporting planes
+	void compute_segment_extents(double margin, std::vector<SegmentExtent>& extents) const;
+
+	// cut face 'f' (and then the resulting pieces) by all the 'cutting_planes'. Returns the number of cuts.
+	std::size_t cut_facet(MapTypes::Facet* f, const CutterSet& cutting_planes, Map* mesh, CutAttributes& attribs);
+
+	// the arrangements of the cutting planes of all the faces of a proxy mesh (returned in 'faces', see 
+	// collect_face_cutters()), to be deleted by the caller. Returns the number of faces split by the lines.
+	std::size_t compute_arrangements(Map* mesh, const CutAttributes& attribs, std::vector<MapTypes::Facet*>& faces, std::vector<PlaneArrangement*>& arrangements);
+
+	// the position of a vertex of the arrangement of 'plane'
+	vec3 arrangement_point(const Plane3d* plane, const PlaneArrangement::Vertex& v) const;
+
 private:
 	void collect_valid_planes();
 
+	// Snaps the planes of the segments of each tight cluster of nearly identical planes to a shared one (see 
+	// Method::plane_regularization_angle): the clusters are found by union-find over the nearly parallel pairs
+	// of planes with close offsets, and the plane fitted to all the points of a cluster replaces the planes of
+	// its segments. The largest segment of a cluster carries the shared plane, and 'snapped_segments_' records
+	// the others (which contribute their points to the confidences of its faces).
+	void regularize_planes(std::vector<VertexGroup::Ptr>& groups);
+
+	// the segments snapped to the plane of each representative segment (see regularize_planes())
+	void snapped_members(std::map<VertexGroup*, std::vector<VertexGroup*> >& members) const;
+
+	// stores a copy of 'plane' in 'plane_arena_' and appends it to 'supporting_planes_'. Returns the stored 
+	// plane, whose index (see plane_id()) identifies the plane in the source plane sets.
+	Plane3d* add_supporting_plane(const Plane3d& plane);
+
+	// the index of a plane in 'supporting_planes_'
+	unsigned int plane_id(const Plane3d* plane) const;
+
 	void merge(VertexGroup* g1, VertexGroup* g2);
 
+	// keeps the best segments within the plane budget (see Method::max_planes), absorbing or dropping the others
+	void apply_plane_budget();
+
+	// Merges the nearly coplanar groups round by round: in each round, all the pairs of nearly parallel 
+	// planes are tested (using their current planes), the groups to be merged are resolved by union-find, 
+	// and then the planes of the merged groups are refit. 'theta' is the angle threshold (in radian), 
+	// and 'dist_threshold' decides whether a point supports a plane.
+	void merge_planes(float dist_threshold, float theta);
+
 	// test if face 'f' insects plane 'plane'
-	bool do_intersect(MapTypes::Facet* f, Plane3d* plane);
+	bool do_intersect(MapTypes::Facet* f, Plane3d* plane, const CutAttributes& attribs);
 
     struct Intersection {
         enum Type { EXISTING_VERTEX, NEW_VERTEX };
@@ -102,35 +320,91 @@ private:
     void compute_intersections(
             MapTypes::Facet* f,
             Plane3d* plane,
+            const CutAttributes& attribs,
             std::vector<Intersection>& intersections
     );
 
-	std::vector<MapTypes::Facet*> cut(MapTypes::Facet* f, Plane3d* cutter, Map* mesh);
+	// snaps the intersecting points to the vertices registered by the cuts (see Method::vertex_snapping_registry),
+	// and keeps one intersection per vertex (an existing vertex rather than a new one)
+	void snap_intersections(Plane3d* cutter, const CutAttributes& attribs, std::vector<Intersection>& intersections);
+
+	// Snaps the new intersecting points closer than 'min_piece_width_' to an end of their edge to that 
+	// end, and tells if the cut would still leave a piece narrower than 'min_piece_width_' (its farthest 
+	// vertex from the cutter), see Method::min_piece_width
+	bool is_sliver_cut(MapTypes::Facet* f, Plane3d* cutter, std::vector<Intersection>& intersections) const;
+
+	std::vector<MapTypes::Facet*> cut(MapTypes::Facet* f, Plane3d* cutter, MapEditor& editor, CutAttributes& attribs);
 
 	// split an existing edge, meanwhile, assign the new edges the original source faces (the old edge 
 	// lies in the intersection of the two faces)
-	MapTypes::Vertex* split_edge(const Intersection& ep, MapEditor* editor, Plane3d* cutting_plane);
-
-	// collect all faces in 'mesh' that intersect 'face'
-	std::set<Plane3d *> collect_cutting_planes(MapTypes::Facet* face, Map* mesh);
+	MapTypes::Vertex* split_edge(const Intersection& ep, MapEditor* editor, Plane3d* cutting_plane, CutAttributes& attribs);
+
+	// collect the supporting planes of all the 'faces' that intersect the supporting plane of 'face' into
+	// 'cutting_planes'. 'tree' is built over the bounding boxes of 'faces', and 'tolerance' enlarges the boxes 
+	// to account for snapping. If 'extents' is given, only the planes whose segment extents overlap the one 
+	// of 'face' are collected.
+	void collect_cutting_planes(
+		MapTypes::Facet* face, 
+		const std::vector<MapTypes::Facet*>& faces, 
+		const BoxTree& tree, 
+		double tolerance,
+		const CutAttributes& attribs,
+		CutterSet& cutting_planes,
+		const std::vector<SegmentExtent>* extents = nil
+	);
 
 	void triplet_intersection();
 
-	// query the intersecting point for existing data base, i.e., triplet_intersection_
-	vec3* query_intersection(Plane3d* plane1, Plane3d* plane2, Plane3d* plane3);
+	// query the intersecting point for existing data base, i.e., triplet_intersection_. In lazy mode, a 
+	// triplet that has not been queried before is computed and stored.
+	// The planes are given by their indices in 'supporting_planes_'.
+	const vec3* query_intersection(unsigned int i, unsigned int j, unsigned int k) const;
 
 	// compute the intersection of a plane triplet
 	// returns true if the intersection exists (p returns the point)
-	bool intersection_plane_triplet(const Plane3d* plane1, const Plane3d* plane2, const Plane3d* plane3, vec3& p);
+	bool intersection_plane_triplet(const Plane3d* plane1, const Plane3d* plane2, const Plane3d* plane3, vec3& p) const;
 
 	// the pairwise intersection may result in tiny faces and we may have numerical problems when computing the 
 	// face confidences where face area is the denominator. To handle this, we simply remove these degenerate 
 	// faces by collapsing the edges.
 	void remove_degenerated_facets(Map* mesh);
 
+	// after the cuts, the elements of the mesh are scattered in memory. This orders the faces by supporting 
+	// plane and then along a Z-order curve, and compacts the mesh accordingly (see Map::compact()).
+	void compact_mesh(Map* mesh);
+
 	// std::vector<unsigned int>& points returns the point indices projected in f.
 	// returns the 'number' of points projected in f (accounts for a notion of confidence)
-	float facet_points_projected_in(PointSet* pset, VertexGroup* g, MapTypes::Facet* f, float max_dist, std::vector<unsigned int>& points);
+	// if 'grid' (built for g) is given, only the points in the grid cells overlapping f are tested.
+	// if 'geometry' is given, the polygon of f in the frame of g's plane is taken from it.
+	float facet_points_projected_in(PointSet* pset, VertexGroup* g, MapTypes::Facet* f, float max_dist, std::vector<unsigned int>& points, const SegmentPointGrid* grid = nil, MapGeometryCache* geometry = nil);
+
+	// the same 'numbers' for all the 'facets', computed in bulk by the FacetPointCounter (one call per 
+	// segment): 'nums' receives the weighted counts if 'use_confidence', otherwise the numbers of the 
+	// points. Returns false if there is no counter or if it failed.
+	bool device_points_projected_in(const std::vector<MapTypes::Facet*>& facets, float max_dist, bool use_confidence, MapGeometryCache& geometry, std::vector<double>& nums);
+
+	// Returns in 'outdated' the faces of 'mesh' whose confidences were not computed with their current inputs
+	// (see Method::incremental_facet_confidences), and records these inputs for the next call (with the 
+	// parameters of the last prepare_confidences()).
+	void outdated_facets(Map* mesh, std::vector<MapTypes::Facet*>& outdated);
+
+	// computes the confidences of the 'facets' of 'mesh' (using the parameters of the last compute_confidences())
+	void compute_facet_confidences(Map* mesh, const std::vector<MapTypes::Facet*>& facets, ProgressLogger* progress);
+
+	// gives no support and no coverage to the 'facets' no point is near (see Method::free_space_pruning),
+	// and returns in 'remaining' the faces still to be computed
+	void prune_free_space_facets(Map* mesh, const std::vector<MapTypes::Facet*>& facets, std::vector<MapTypes::Facet*>& remaining, ProgressLogger* progress);
+
+	// estimates the confidences of the 'facets' on the large segments from a subsample of their points (see 
+	// Method::sampled_confidences), and returns in 'exact' the faces still to be computed exactly: those 
+	// whose estimates are not conclusive, and those of the small segments
+	void estimate_facet_confidences(Map* mesh, const std::vector<MapTypes::Facet*>& facets, std::vector<MapTypes::Facet*>& exact, ProgressLogger* progress);
+
+	// the first steps of compute_confidences(): the downsampling of the points (see Method::downsampling_cell_size),
+	// and then the confidences of the points and the parameters of the face confidences
+	void downsample_points();
+	void prepare_confidences(bool use_conficence, ProgressLogger* progress);
 
 	// returns average spacing
 	float compute_point_confidences(PointSet* pset, int s1 = 6, int s2 = 16, int s3 = 32, ProgressLogger* progress = nullptr);
@@ -138,34 +412,55 @@ private:
 	// clear cached intermediate results
 	void clear();
 
+private:
+	// the thread budget the public functions run with, of the context if any (see set_context())
+	unsigned int thread_budget() const;
+
 private:
 	PointSet* pset_;
+	bool	  keep_planes_;
+	const ReconstructionContext* context_;
+	BudgetReport budget_report_;
 
 	MapFacetAttribute<VertexGroup*> facet_attrib_supporting_vertex_group_;
 	MapFacetAttribute<Plane3d*>		facet_attrib_supporting_plane_;
 
 	std::vector<VertexGroup::Ptr>		plane_segments_;
 	std::map<VertexGroup*, Plane3d*>	vertex_group_plane_;
+	std::map<VertexGroup*, VertexGroup*>	snapped_segments_;	// to the segment carrying their plane
 
+	std::deque<Plane3d>	   plane_arena_;			// owns the planes (the addresses never change until clear())
 	std::vector<Plane3d*>  supporting_planes_;		// including the bbox face planes
+	std::vector<Plane3d*>  bbox_planes_;			// the planes of the six bbox faces (reused by regenerate())
 	float				   max_dist_;				// maximum distance to the supporting plane
+	double				   min_piece_width_;		// of the cuts (see Method::min_piece_width), set before cutting
 	
-	// How to use: triplet_intersection_[plane_min][plane_mid][plane_max]
-	std::map<Plane3d*, std::map<Plane3d*, std::map<Plane3d*, vec3*> > >  triplet_intersection_;
+	// the parameters of the last compute_confidences(), with which regenerate() computes the confidences of the new faces
+	float	confidence_max_dist_;
+	float	confidence_radius_;
+	bool	use_confidence_;
+
+	// the index of each plane in 'supporting_planes_' (the source plane sets and the plane triplets use these indices)
+	std::unordered_map<const Plane3d*, unsigned int>  plane_index_;
+
+	// intersecting points of the plane triplets, either all precomputed or computed on demand (see 
+	// Method::lazy_triplet_intersection). How to use: query_intersection()
+	mutable TripletIntersectionTable  triplet_intersection_;
+	mutable std::mutex				  triplet_intersection_mutex_;
 
-	// precomputed intersecting points of all plane triplets
-	std::vector< vec3*>		intersecting_points_;
+	// the vertices created by the cuts (see Method::vertex_snapping_registry)
+	VertexRegistry					  vertex_registry_;
 
 	// to avoid numerical issues (there are always small differences when computing the intersecting 
 	// point of a plane triplet), I store how a edge is computed (from two planes). Then, I just need 
 	// to query the intersecting point of a plane triplet 
 	// from a precomputed table. By doing so, I can avoid this numerical issues.  
-	MapHalfedgeAttribute< std::set<Plane3d*> > edge_source_planes_;
+	MapHalfedgeAttribute< PlaneIdSet<2> > edge_source_planes_;
 
 	// to avoid numerical issues (due to floating point precision, there are always small differences 
 	// when computing the intersection of a plane triplet), I store how a vertex is computed (from
 	// three planes). Then, I just need to compare the three plane to identify if two points are the same. 
-	MapVertexAttribute< std::set<Plane3d*> > vertex_source_planes_;
+	MapVertexAttribute< PlaneIdSet<3> > vertex_source_planes_;
 };
 
 #endif
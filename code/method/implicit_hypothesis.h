@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _IMPLICIT_HYPOTHESIS_H_
+#define _IMPLICIT_HYPOTHESIS_H_
+
+#include "method_common.h"
+#include "plane_id_set.h"
+#include "../math/math_types.h"
+#include "../basic/memory_usage.h"
+
+#include <vector>
+
+
+class VertexGroup;
+
+
+// The candidate faces without the mesh (see HypothesisGenerator::generate_implicit()): the faces of 
+// the arrangement of each supporting plane, as lists of vertices identified by their planes, and the
+// statistics of the faces used by the face selection. It takes a small part of the memory of the mesh
+// with its attributes. The faces are materialized as a mesh on demand (see HypothesisGenerator::
+// materialize()), e.g., the faces of a few planes for rendering, or all the candidates for the face
+// selection once the generation and the confidences are done.
+// The faces of each plane are contiguous, and a vertex is shared by the faces of its plane.
+class METHOD_API ImplicitHypothesis
+{
+public:
+	// the statistics of a face (see HypothesisGenerator::compute_confidences())
+	struct FaceStatistics {
+		FaceStatistics() : supporting_point_num(0), area(0), covered_area(0) {}
+
+		double supporting_point_num;
+		double area;
+		double covered_area;
+	};
+
+public:
+	ImplicitHypothesis() {}
+
+	std::size_t num_faces() const { return face_planes_.size(); }
+	std::size_t num_vertices() const { return points_.size(); }
+
+	// the index of the supporting plane of face 'f', and the segment it comes from
+	unsigned int face_plane(std::size_t f) const { return face_planes_[f]; }
+	VertexGroup* face_segment(std::size_t f) const { return face_segments_[f]; }
+
+	// the corners of face 'f' are the corners [face_begin(f), face_end(f))
+	std::size_t face_begin(std::size_t f) const { return face_offsets_[f]; }
+	std::size_t face_end(std::size_t f) const { return face_offsets_[f + 1]; }
+
+	// the vertex of a corner, and the plane (other than the supporting plane) of the edge from the 
+	// corner to the next one
+	unsigned int corner_vertex(std::size_t c) const { return corner_vertices_[c]; }
+	unsigned int corner_edge_plane(std::size_t c) const { return corner_edge_planes_[c]; }
+
+	const vec3& point(unsigned int v) const { return points_[v]; }
+	const PlaneIdSet<3>& vertex_planes(unsigned int v) const { return vertex_planes_[v]; }
+
+	bool has_statistics() const { return !statistics_.empty() && statistics_.size() == num_faces(); }
+	const FaceStatistics& statistics(std::size_t f) const { return statistics_[f]; }
+
+	// the memory used by the vertices, the faces, and the statistics
+	MemoryUsage memory_usage() const;
+
+private:
+	std::vector<vec3>			points_;
+	std::vector< PlaneIdSet<3> >	vertex_planes_;
+
+	std::vector<unsigned int>	face_planes_;
+	std::vector<VertexGroup*>	face_segments_;
+	std::vector<std::size_t>	face_offsets_;		// num_faces() + 1 entries
+	std::vector<unsigned int>	corner_vertices_;
+	std::vector<unsigned int>	corner_edge_planes_;
+
+	std::vector<FaceStatistics>	statistics_;
+
+	friend class HypothesisGenerator;
+};
+
+#endif
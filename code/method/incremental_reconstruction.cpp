@@ -0,0 +1,310 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "incremental_reconstruction.h"
+#include "method_global.h"
+#include "hypothesis_generator.h"
+#include "face_selection.h"
+#include "../basic/logger.h"
+#include "../basic/color.h"
+#include "../basic/stop_watch.h"
+#include "../model/map_attributes.h"
+#include "../model/map_facet_merger.h"
+
+#include <set>
+#include <sstream>
+#include <algorithm>
+
+
+namespace {
+
+	bool box_contains(const Box3d& box, const vec3& p) {
+		return
+			p.x >= box.x_min() && p.x <= box.x_max() &&
+			p.y >= box.y_min() && p.y <= box.y_max() &&
+			p.z >= box.z_min() && p.z <= box.z_max();
+	}
+
+}
+
+
+IncrementalReconstruction::IncrementalReconstruction()
+	: generator_(nil)
+{
+}
+
+
+IncrementalReconstruction::~IncrementalReconstruction() {
+	delete generator_;
+}
+
+
+bool IncrementalReconstruction::reconstruct(const Reconstruction::Input& input, const Reconstruction::Parameters& params, Reconstruction::Mesh& result) {
+	result.clear();
+	delete generator_;
+	generator_ = nil;
+	candidates_ = nil;
+	label_segments_.clear();
+	selection_.clear();
+
+	if (input.num_points == 0 || !input.points) {
+		Logger::err("-") << "the input has no point" << std::endl;
+		return false;
+	}
+	if (!input.labels) {
+		Logger::err("-") << "the input has no labels (the updates need the segments of the points)" << std::endl;
+		return false;
+	}
+
+	params_ = params;
+	context_ = ReconstructionContext();
+	context_.lambda_data_fitting = params.fitting;
+	context_.lambda_model_coverage = params.coverage;
+	context_.lambda_model_complexity = params.complexity;
+	if (params.time_limit > 0.0)
+		context_.selection_time_limit = params.time_limit;
+	pset_ = Reconstruction::create_point_set(input);
+	if (pset_->groups().empty()) {
+		Logger::err("-") << "planar segments do not exist" << std::endl;
+		return false;
+	}
+
+	std::map<int, unsigned int> first_points;
+	for (std::size_t i = 0; i < input.num_points; ++i) {
+		if (input.labels[i] >= 0)
+			first_points.insert(std::make_pair(input.labels[i], static_cast<unsigned int>(i)));
+	}
+
+	if (!generate(&first_points))
+		return false;
+	return select(std::vector<char>(), result);
+}
+
+
+bool IncrementalReconstruction::update(const Reconstruction::Input& input, Reconstruction::Mesh& result) {
+	result.clear();
+	if (!generator_ || !candidates_) {
+		Logger::err("-") << "no reconstruction to update. Please reconstruct first" << std::endl;
+		return false;
+	}
+	if (input.num_points == 0 || !input.points) {
+		Logger::warn("-") << "the update has no point" << std::endl;
+		return select(selection_, result);
+	}
+	if (pset_->has_normals() && !input.normals) {
+		Logger::err("-") << "the points of the update have no normals" << std::endl;
+		return false;
+	}
+
+	StopWatch w;
+	const unsigned int first = pset_->num_points();
+	std::vector<VertexGroup*> segments;
+	if (!append(input, segments))
+		return false;
+
+	bool inside = true;
+	const std::vector<vec3>& points = pset_->points();
+	for (std::size_t i = first; i < points.size() && inside; ++i)
+		inside = box_contains(box_, points[i]);
+	if (!inside) {
+		// the bbox planes of the candidate faces would no longer enclose the points
+		Logger::out("-") << "the new points extend the bounding box. Regenerating all the candidate faces" << std::endl;
+		pset_->planar_qualities().clear();
+		if (!generate(nil))
+			return false;
+		return select(std::vector<char>(), result);
+	}
+
+	Logger::out("-") << "appended " << input.num_points << " points to " << segments.size() << " segments. " << w.elapsed() << " sec." << std::endl;
+
+	// the previous selection follows the kept faces (the rebuilt ones are not selected)
+	MapFacetAttribute<char> selected(candidates_);
+	if (selection_.size() == candidates_->size_of_facets()) {
+		std::size_t idx = 0;
+		FOR_EACH_FACET(Map, candidates_, it)
+			selected[it] = selection_[idx++];
+	}
+	else {
+		FOR_EACH_FACET(Map, candidates_, it)
+			selected[it] = 0;
+	}
+
+	if (!generator_->regenerate(candidates_, segments) || candidates_->size_of_facets() == 0) {
+		Logger::err("-") << "failed regenerating candidate faces" << std::endl;
+		return false;
+	}
+
+	std::vector<char> start;
+	start.reserve(candidates_->size_of_facets());
+	FOR_EACH_FACET(Map, candidates_, it)
+		start.push_back(selected[it]);
+	return select(start, result);
+}
+
+
+bool IncrementalReconstruction::append(const Reconstruction::Input& input, std::vector<VertexGroup*>& segments) {
+	std::vector<vec3>& points = pset_->points();
+	const std::size_t first = points.size();
+	const bool copy_normals = pset_->has_normals();
+	const bool pad_weights = pset_->has_weights();
+	const bool pad_qualities = pset_->has_planar_qualities();
+
+	points.resize(first + input.num_points);
+	std::copy(input.points, input.points + input.num_points * 3, points[first].data());
+	if (copy_normals) {
+		std::vector<vec3>& normals = pset_->normals();
+		normals.resize(first + input.num_points);
+		std::copy(input.normals, input.normals + input.num_points * 3, normals[first].data());
+	}
+	if (pad_weights)	// the new points stand for themselves only
+		pset_->weights().resize(first + input.num_points, 1.0f);
+
+	std::set<VertexGroup*> grown;
+	if (input.labels) {
+		std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+		for (std::size_t i = 0; i < input.num_points; ++i) {
+			int label = input.labels[i];
+			if (label < 0)
+				continue;
+
+			std::map<int, VertexGroup::Ptr>::iterator pos = label_segments_.find(label);
+			if (pos == label_segments_.end()) {
+				VertexGroup* g = new VertexGroup(pset_);
+				std::ostringstream name;
+				name << "segment_" << label;
+				g->set_label(name.str());
+				g->set_color(random_color());
+				pos = label_segments_.insert(std::make_pair(label, VertexGroup::Ptr(g))).first;
+			}
+			if (!pos->second)	// the segment of the label was dropped by the refinement of the planes
+				continue;
+			pos->second->push_back(static_cast<unsigned int>(first + i));
+			grown.insert(pos->second);
+		}
+
+		// the new segments join the point set once they can be fitted
+		for (std::set<VertexGroup*>::const_iterator it = grown.begin(); it != grown.end(); ++it) {
+			VertexGroup* g = *it;
+			if (std::find(groups.begin(), groups.end(), g) != groups.end())
+				segments.push_back(g);
+			else if (g->size() >= 3) {
+				pset_->fit_plane(g);
+				groups.push_back(g);
+				segments.push_back(g);
+			}
+		}
+	}
+
+	// The planar qualities of the new points are not recomputed (the neighborhoods of the old points 
+	// would change as well): the new points of a segment get the average quality of its old points.
+	if (pad_qualities) {
+		std::vector<float>& qualities = pset_->planar_qualities();
+		qualities.resize(first + input.num_points, 1.0f);
+		for (std::size_t i = 0; i < segments.size(); ++i) {
+			VertexGroup* g = segments[i];
+			double sum = 0.0;
+			std::size_t num = 0;
+			for (std::size_t k = 0; k < g->size(); ++k) {
+				if (g->at(k) < first) {
+					sum += qualities[g->at(k)];
+					++num;
+				}
+			}
+			if (num == 0)
+				continue;
+			const float avg = static_cast<float>(sum / num);
+			for (std::size_t k = 0; k < g->size(); ++k) {
+				if (g->at(k) >= first)
+					qualities[g->at(k)] = avg;
+			}
+		}
+	}
+
+	pset_->invalidate_bbox();
+	pset_->notify_points_change();
+	return true;
+}
+
+
+bool IncrementalReconstruction::generate(const std::map<int, unsigned int>* first_points) {
+	delete generator_;
+	generator_ = new HypothesisGenerator(pset_);
+	generator_->set_context(&context_);
+	selection_.clear();
+
+	// the labels are mapped before the confidences, which may downsample the points
+	if (first_points) {
+		generator_->refine_planes();
+		update_label_segments(*first_points);
+	}
+	candidates_ = generator_->generate();
+	if (!candidates_ || candidates_->size_of_facets() == 0) {
+		Logger::err("-") << "failed generating candidate faces" << std::endl;
+		candidates_ = nil;
+		return false;
+	}
+	generator_->compute_confidences(candidates_, false);
+	box_ = pset_->bbox();
+	return true;
+}
+
+
+bool IncrementalReconstruction::select(const std::vector<char>& start, Reconstruction::Mesh& result) {
+	const HypothesisGenerator::Adjacency& adjacency = generator_->extract_adjacency(candidates_);
+	FaceSelection selector(pset_, candidates_);
+	selector.set_keep_candidates(true);
+	selector.set_context(&context_);
+	selector.set_start_selection(start);
+	selector.optimize(adjacency, params_.solver);
+
+	const std::vector<double>& X = selector.solution();
+	selection_.clear();
+	if (X.size() >= candidates_->size_of_facets()) {
+		selection_.resize(candidates_->size_of_facets());
+		for (std::size_t i = 0; i < selection_.size(); ++i)
+			selection_[i] = X[i] > 0.5 ? 1 : 0;
+	}
+
+	Map::Ptr model = selector.selected_model(adjacency);
+	if (!model || model->size_of_facets() == 0) {
+		Logger::err("-") << "optimization failed: model has no face" << std::endl;
+		return false;
+	}
+	if (Method::merge_coplanar_faces)
+		model = MapFacetMerger::merged(model);
+
+	Reconstruction::extract_buffers(model, result);
+	return true;
+}
+
+
+void IncrementalReconstruction::update_label_segments(const std::map<int, unsigned int>& first_points) {
+	// the refinement of the planes merges the segments, so the point of a label may be in a larger one
+	std::vector<VertexGroup*> point_segments(pset_->num_points(), nil);
+	const std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		VertexGroup* g = groups[i];
+		for (std::size_t k = 0; k < g->size(); ++k)
+			point_segments[g->at(k)] = g;
+	}
+
+	label_segments_.clear();
+	for (std::map<int, unsigned int>::const_iterator it = first_points.begin(); it != first_points.end(); ++it)
+		label_segments_[it->first] = point_segments[it->second];
+}
@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _INCREMENTAL_RECONSTRUCTION_H_
+#define _INCREMENTAL_RECONSTRUCTION_H_
+
+#include "method_common.h"
+#include "reconstruction.h"
+#include "reconstruction_context.h"
+#include "../math/math_types.h"
+#include "../model/map.h"
+#include "../model/point_set.h"
+
+#include <vector>
+#include <map>
+
+
+class HypothesisGenerator;
+
+
+/**
+* A reconstruction kept across the arrival of new points, e.g., of scans revisiting an area: update()
+* appends the points to their segments and only redoes the work they affect. The segments of the new 
+* points are refit and only their candidate faces (and the faces cut by their old or new planes) are 
+* regenerated, with their confidences (see HypothesisGenerator::regenerate()). The faces of the other
+* segments keep their confidences, and the face selection starts from the previous selection. The
+* candidate faces are always kept as a mesh (i.e., Method::implicit_hypothesis is ignored).
+*/
+
+class METHOD_API IncrementalReconstruction
+{
+public:
+	IncrementalReconstruction();
+	~IncrementalReconstruction();
+
+	// Reconstructs the model of the input from scratch into 'result' (as Reconstruction::reconstruct()),
+	// and keeps what the updates need. The input must have labels, which identify the segments of the
+	// points of the following updates. Returns false (and logs why) if it fails.
+	bool reconstruct(const Reconstruction::Input& input, const Reconstruction::Parameters& params, Reconstruction::Mesh& result);
+
+	// Appends the points of 'input' and updates the model into 'result'. The points with the labels of 
+	// the previous inputs join their segments, and the other labels make new segments. The points 
+	// without a label (i.e., negative) only count as points. If the new points extend the bounding box
+	// of the scene, the candidate faces can't be kept and everything is recomputed. Returns false (and 
+	// logs why) if it fails, or if there was no reconstruction to update.
+	bool update(const Reconstruction::Input& input, Reconstruction::Mesh& result);
+
+	// the points of all the inputs so far (null before reconstruct())
+	const PointSet* point_set() const { return pset_; }
+
+private:
+	// appends the points of 'input' to the point set, and returns in 'segments' those that got new points
+	bool append(const Reconstruction::Input& input, std::vector<VertexGroup*>& segments);
+
+	// Generates the candidate faces and their confidences from scratch. If 'first_points' (the first point
+	// of each label) is given, the planes are refined first and the labels mapped to the refined segments.
+	bool generate(const std::map<int, unsigned int>* first_points);
+
+	// selects the faces of the candidates (starting from 'start' if not empty) and extracts the model
+	bool select(const std::vector<char>& start, Reconstruction::Mesh& result);
+
+	// the segment of each label after the refinement of the planes: the one of its first point (nil if dropped)
+	void update_label_segments(const std::map<int, unsigned int>& first_points);
+
+private:
+	PointSet::Ptr			pset_;
+	HypothesisGenerator*	generator_;
+	Map::Ptr				candidates_;
+	Box3d					box_;		// of the points the candidate faces were generated for
+	Reconstruction::Parameters params_;
+	ReconstructionContext	context_;	// of the parameters, for the generator and the face selection
+
+	std::map<int, VertexGroup::Ptr>		label_segments_;
+	std::vector<char>					selection_;			// of the candidate faces, by the last select()
+};
+
+
+#endif
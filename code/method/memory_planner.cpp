@@ -0,0 +1,202 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "memory_planner.h"
+#include "method_global.h"
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/parallel.h"
+#include "../basic/memory_usage.h"
+#include "../model/point_set.h"
+
+#include <unordered_set>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// the options a strategy is predicted with
+	struct Options {
+		bool lazy_triplets;
+		bool decomposition;
+	};
+
+	// the memory of the candidate faces and of the binary program (with the copy in the solver)
+	double problem_memory(const HypothesisGenerator::Estimate& estimate, const Options& options) {
+		// the lazy table only holds the triplets queried, i.e., about the vertices of the candidate faces
+		double triplets = options.lazy_triplets ? 
+			double(estimate.num_candidate_faces) * (2 * (sizeof(Numeric::uint64) + sizeof(unsigned int)) + sizeof(vec3)) :
+			double(estimate.triplet_memory);
+		// the solver holds its own copy of the program, or of a component at a time (the components are
+		// unknown before formulating the program, a component being assumed a quarter of it)
+		double solver = options.decomposition ? 0.25 * estimate.program_memory : double(estimate.program_memory);
+		return double(estimate.peak_memory) + triplets + solver;
+	}
+
+}
+
+
+const char* MemoryPlanner::strategy_name(Strategy strategy) {
+	switch (strategy) {
+	case AS_IS:				return "as is";
+	case LAZY_TRIPLETS:		return "lazy triplet intersections";
+	case LOCAL_HYPOTHESIS:	return "local hypothesis";
+	case DECOMPOSITION:		return "decomposed face selection";
+	case DOWNSAMPLING:		return "downsampling";
+	case TILING:			return "tiling";
+	default:				return "over budget";
+	}
+}
+
+
+double MemoryPlanner::point_memory(const PointSet* pset, float cell_size) {
+	const std::size_t num = pset->num_points();
+	if (num == 0)
+		return 0.0;
+
+	// the points left are about the occupied cells of the grid
+	std::size_t num_left = num;
+	if (cell_size > 0.0f) {
+		const Box3d& box = pset->bbox();
+		const std::vector<vec3>& points = pset->points();
+		std::unordered_set<Numeric::uint64> cells;
+		cells.reserve(num / 4);
+		for (std::size_t i = 0; i < num; ++i) {
+			const vec3& p = points[i];
+			Numeric::uint64 x = static_cast<Numeric::uint64>((p.x - box.x_min()) / cell_size);
+			Numeric::uint64 y = static_cast<Numeric::uint64>((p.y - box.y_min()) / cell_size);
+			Numeric::uint64 z = static_cast<Numeric::uint64>((p.z - box.z_min()) / cell_size);
+			cells.insert((x << 42) | ((y & 0x1FFFFF) << 21) | (z & 0x1FFFFF));
+		}
+		num_left = std::min(num, cells.size());
+	}
+
+	// the point set while the candidate faces are generated, or the points left with the spatial index
+	// of the confidences and the planar qualities (about 24 bytes per point) once they are downsampled
+	double per_point = pset->memory_usage().total() / num;
+	return std::max(num * per_point, num_left * (per_point + 24.0));
+}
+
+
+MemoryPlanner::Plan MemoryPlanner::plan(HypothesisGenerator& hypothesis, const PointSet* pset, double budget) {
+	Plan plan;
+	plan.budget = budget;
+	plan.estimate = hypothesis.estimate();
+
+	Options options;
+	options.lazy_triplets = Method::lazy_triplet_intersection;
+	options.decomposition = Method::decompose_face_selection;
+
+	double points = point_memory(pset, 0.0f);
+	plan.predicted_memory = points + problem_memory(plan.estimate, options);
+	if (budget <= 0.0 || plan.predicted_memory <= budget)
+		return plan;
+
+	plan.strategy = LAZY_TRIPLETS;
+	options.lazy_triplets = true;
+	plan.predicted_memory = points + problem_memory(plan.estimate, options);
+	if (plan.predicted_memory <= budget)
+		return plan;
+
+	plan.strategy = LOCAL_HYPOTHESIS;
+	if (!Method::local_hypothesis) {
+		Method::local_hypothesis = true;
+		plan.estimate = hypothesis.estimate();
+		Method::local_hypothesis = false;
+	}
+	plan.predicted_memory = points + problem_memory(plan.estimate, options);
+	if (plan.predicted_memory <= budget)
+		return plan;
+
+	plan.strategy = DECOMPOSITION;
+	options.decomposition = true;
+	const double problem = problem_memory(plan.estimate, options);
+	plan.predicted_memory = points + problem;
+	if (plan.predicted_memory <= budget)
+		return plan;
+
+	// the cells from 1/2000 to 1/250 of the diagonal of the scene (the coarsest is kept for the tiles)
+	plan.strategy = DOWNSAMPLING;
+	const float diagonal = 2.0f * pset->bbox().radius();
+	for (float fraction = 1.0f / 2000.0f; fraction <= 1.0f / 250.0f; fraction *= 2.0f) {
+		plan.downsampling_cell_size = diagonal * fraction;
+		points = point_memory(pset, plan.downsampling_cell_size);
+		plan.predicted_memory = points + problem;
+		if (plan.predicted_memory <= budget)
+			return plan;
+	}
+
+	// the tiles hold a copy of their points next to the scene, and run up to Method::num_threads at a time
+	plan.strategy = TILING;
+	const Box3d& box = pset->bbox();
+	const float width = std::max(box.x_max() - box.x_min(), box.y_max() - box.y_min());
+	const double num_threads = double(parallel_num_threads(Method::num_threads));
+	for (unsigned int grid = 2; grid <= 16; ++grid) {
+		double num_tiles = double(grid * grid);
+		plan.tile_size = width / grid * 1.0001f;
+		plan.predicted_memory = 2.0 * points + std::min(num_tiles, num_threads) * problem / num_tiles;
+		if (plan.predicted_memory <= budget)
+			return plan;
+	}
+
+	plan.strategy = OVER_BUDGET;
+	plan.predicted_memory = 2.0 * points;
+	return plan;
+}
+
+
+void MemoryPlanner::apply(const Plan& plan) {
+	if (!plan.fits()) {
+		Logger::err("-") << "the memory budget (" << MemoryUsage::to_string(plan.budget) << ") can't be met, "
+			<< "even with tiling (" << MemoryUsage::to_string(plan.predicted_memory) << " predicted)" << std::endl;
+		return;
+	}
+
+	if (plan.strategy >= LAZY_TRIPLETS)
+		Method::lazy_triplet_intersection = true;
+	if (plan.strategy >= LOCAL_HYPOTHESIS)
+		Method::local_hypothesis = true;
+	if (plan.strategy >= DECOMPOSITION)
+		Method::decompose_face_selection = true;
+	if (plan.strategy >= DOWNSAMPLING)
+		Method::downsampling_cell_size = plan.downsampling_cell_size;
+
+	if (plan.strategy != AS_IS) {
+		std::ostringstream strategy;
+		strategy << strategy_name(plan.strategy);
+		if (plan.strategy == TILING)
+			strategy << " (tiles of " << plan.tile_size << ")";
+		Logger::warn("-") << "memory budget " << MemoryUsage::to_string(plan.budget) << ": using " << strategy.str()
+			<< ", " << MemoryUsage::to_string(plan.predicted_memory) << " predicted" << std::endl;
+	}
+	Profiler::add_counter("memory predicted", plan.predicted_memory);
+	Profiler::add_counter("memory strategy", double(plan.strategy));
+}
+
+
+bool MemoryPlanner::check(const std::string& name, double bytes, double budget) {
+	Profiler::add_counter("memory " + name, bytes);
+	if (budget <= 0.0 || bytes <= budget)
+		return true;
+	Logger::err("-") << "memory budget exceeded " << name << ": " << MemoryUsage::to_string(bytes) 
+		<< " used of " << MemoryUsage::to_string(budget) << std::endl;
+	return false;
+}
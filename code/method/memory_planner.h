@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MEMORY_PLANNER_H_
+#define _MEMORY_PLANNER_H_
+
+#include "method_common.h"
+#include "hypothesis_generator.h"
+
+#include <string>
+
+
+class PointSet;
+
+
+/**
+* Picks the cheapest way of running the pipeline within a memory budget (see Method::memory_budget),
+* so that a large tile degrades gracefully instead of crashing the process. The memory is predicted
+* from the refined planes (see HypothesisGenerator::estimate()) and from the points, and the strategies
+* are tried in order, each added to the previous ones:
+*   - as is;
+*   - the lazy triplet intersections (no table of all the plane triplets);
+*   - the local hypothesis (fewer candidate faces);
+*   - the decomposed face selection (the solver holds one component at a time);
+*   - the downsampling of the points (smaller point set and spatial index);
+*   - the tiling of the scene (see TiledReconstruction), each tile getting a share of the candidate
+*     faces and the binary program.
+* If even the tiles don't fit (e.g., the points alone don't), the plan is over budget, for failing 
+* fast with a clear status.
+*
+* The memory is also checked at the checkpoints of the pipeline (after generating the candidate faces,
+* and before launching the solver) against the accounted memory of the data (see MemoryUsage).
+*/
+
+class METHOD_API MemoryPlanner
+{
+public:
+	enum Strategy { AS_IS, LAZY_TRIPLETS, LOCAL_HYPOTHESIS, DECOMPOSITION, DOWNSAMPLING, TILING, OVER_BUDGET };
+
+	static const char* strategy_name(Strategy strategy);
+
+	struct Plan {
+		Plan() : strategy(AS_IS), budget(0), predicted_memory(0), downsampling_cell_size(0), tile_size(0) {}
+
+		bool fits() const { return strategy != OVER_BUDGET; }
+
+		Strategy	strategy;			// the last strategy applied (with all the ones before it)
+		double		budget;				// in bytes
+		double		predicted_memory;	// with the strategy, in bytes (of a tile for TILING)
+		float		downsampling_cell_size;	// for DOWNSAMPLING and TILING (0 for no downsampling)
+		float		tile_size;			// for TILING
+		HypothesisGenerator::Estimate	estimate;	// of the last estimate made
+	};
+
+public:
+	// Plans the run of 'hypothesis' (after refine_planes()) within 'budget' bytes. Enabling the local 
+	// hypothesis re-estimates the problem. The Method options of the strategies are left unchanged 
+	// (see apply()). A budget of 0 gives AS_IS.
+	static Plan plan(HypothesisGenerator& hypothesis, const PointSet* pset, double budget);
+
+	// Sets the Method options of the strategies of the plan (and the downsampling cell size), and logs
+	// the plan. Nothing is changed if the plan is over budget.
+	// NOTE: the Method options are shared by all the threads (e.g., the jobs of the Batch tool).
+	static void apply(const Plan& plan);
+
+	// the memory checkpoint 'name': returns false (and logs why) if 'bytes' exceed 'budget' (0 means
+	// no limit). 'bytes' is also added as the counter "memory <name>" of the current profiling stage.
+	static bool check(const std::string& name, double bytes, double budget);
+
+private:
+	// the memory of the points and the spatial index of the confidences, with the points downsampled
+	// on a grid of 'cell_size' (0 for no downsampling)
+	static double point_memory(const PointSet* pset, float cell_size);
+};
+
+
+#endif
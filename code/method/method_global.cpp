@@ -9,12 +9,138 @@ namespace Method {
 
 	double snap_sqr_distance_threshold = 1e-14;
 
+	bool vertex_snapping_registry = false;
+
+	bool local_hypothesis = false;
+	double local_hypothesis_margin = 0.05;
+
+	double min_piece_width = 0.0;
+
+	bool longest_cut_first = true;
+
+	bool plane_arrangement = false;
+
+	bool implicit_hypothesis = false;
+
+	bool fast_plane_merging = true;
+
+	unsigned int max_planes = 0;
+	double plane_budget_coverage = 1.0;
+
+	double plane_regularization_angle = 0.0;
+	double plane_regularization_distance = 1.0;
+
+	bool lazy_triplet_intersection = true;
+
+	bool fast_degenerate_removal = true;
+
+	bool segment_point_grids = true;
+	bool one_pass_point_location = true;
+
+	bool segment_alpha_shapes = false;
+
+	bool raster_coverage = false;
+	double raster_coverage_cell_size = 2.0;
+	unsigned int raster_coverage_closing = 1;
+
+	bool segment_footprints = false;
+
+	bool segment_projections = true;
+
+	bool device_point_counting = false;
+
+	bool decompose_face_selection = true;
+
+	bool presolve_face_selection = true;
+
+	bool contract_fans = false;
+
+	bool bulk_selection_extraction = false;
+
+	double selection_time_limit = 0.0;
+	double live_selection_time_limit = 2.0;
+
+	bool stream_face_selection = false;
+
+	bool lazy_sharp_edges = false;
+
+	bool tight_sharp_edges = false;
+
+	bool approximate_face_selection = false;
+	double approximate_polish_time = 0.0;
+
+	bool lagrangian_face_selection = false;
+	unsigned int lagrangian_iterations = 500;
+
+	bool graph_cut_selection = false;
+
+	bool neighborhood_search = false;
+	double neighborhood_search_time = 10.0;
+	unsigned int neighborhood_size = 300;
+
+	bool greedy_selection_start = true;
+
+	bool   selection_variable_hints = true;
+	double selection_hint_coverage = 0.5;
+
+	bool automatic_selection_policy = false;
+	std::string selection_policy_calibration = "";
+
+	std::string selection_cache_directory = "";
+
+	unsigned int selection_cache_capacity = 0;
+
+	double memory_budget = 0.0;
+
+	bool merge_coplanar_faces = false;
+
+	//________________ multi-threading ____________________
+
+	unsigned int num_threads = 0;
+
+	bool parallel_pairwise_cut = false;
+
+	bool parallel_proxy_mesh = false;
+
+	bool parallel_point_confidences = true;
+	bool device_point_confidences = false;
+	int point_search_backend = 0;
+	double point_search_epsilon = 0.0;
+	unsigned int point_search_max_leaves = 0;
+	std::string point_index_cache_directory = "";
+
+	bool reorder_points_by_groups = false;
+
+	bool reorder_points_spatially = false;
+
+	float downsampling_cell_size = 0.0f;
+
+	bool reuse_point_confidences = true;
+
+	bool parallel_facet_confidences = true;
+
+	bool padded_point_kernels = false;
+
+	bool incremental_facet_confidences = false;
+
+	bool sampled_confidences = false;
+	unsigned int confidence_sample_size = 4096;
+	unsigned int confidence_sample_seed = 1;
+	double confidence_interval_sigmas = 2.0;
+
+	bool free_space_pruning = true;
+
+	bool parallel_face_selection = true;
+
+	bool deterministic = false;
+
 	//________________ names for various quality measures ____________________
 
 	std::string facet_attrib_supporting_vertex_group = "facet_supporting_vertex_group";
 	std::string facet_attrib_supporting_point_num = "facet_supporting_point_num";
 	std::string facet_attrib_facet_area = "facet_area";
 	std::string facet_attrib_covered_area = "facet_covered_area";
+	std::string facet_attrib_confidence_signature = "facet_confidence_signature";
 
 
 }
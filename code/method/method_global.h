@@ -15,12 +15,328 @@ namespace Method {
 
 	extern METHOD_API double snap_sqr_distance_threshold;
 
+	// snap the intersecting points of the cuts to the vertices registered by the cuts so far, through a 
+	// spatial hash shared by the cutting threads (keyed by the three planes of a vertex and its position), 
+	// instead of comparing the intersecting points of a face pairwise. The duplicated intersecting points 
+	// are merged, and the face is then cut (where it was left uncut before)
+	extern METHOD_API bool vertex_snapping_registry;
+
+	// local hypothesis: two planes only cut each other if the extents of their segments overlap. The extent of 
+	// a segment is its bounding rectangle on the supporting plane (along the principal axes of its points), 
+	// inflated by 'local_hypothesis_margin' (relative to the radius of the bounding box of the point cloud).
+	extern METHOD_API bool local_hypothesis;
+	extern METHOD_API double local_hypothesis_margin;
+
+	// avoid the slivers at cut time: an intersecting point of a cut closer than 'min_piece_width' to an 
+	// end of its edge is snapped to that end (the existing vertex), and a cut that would still leave a
+	// piece narrower than it (measured from the cutter) is skipped, so the face is not split. Relative to 
+	// the radius of the bounding box of the point cloud (0 means the faces are cut as they are)
+	extern METHOD_API double min_piece_width;
+
+	// cut each face first by the planes crossing it along the longest lines, instead of in the order of 
+	// the planes (which depends on their addresses, or their indices in the deterministic mode), so the 
+	// early cuts separate the other planes and the pieces need fewer cuts. The order only depends on the
+	// geometry, so it is also deterministic
+	extern METHOD_API bool longest_cut_first;
+
+	// generate the candidate faces plane by plane, instead of cutting the faces of the mesh by the planes 
+	// one after another: the cutting planes of each proxy face are intersected with its plane, and the
+	// arrangement of the resulting 2D lines is computed inside the face (in parallel for the planes). 
+	// The vertices are identified by their three planes
+	extern METHOD_API bool plane_arrangement;
+
+	// keep the candidate faces as an ImplicitHypothesis (the faces of the arrangements of the planes) while
+	// computing their confidences, and build the mesh only for the face selection (see Reconstruction)
+	extern METHOD_API bool implicit_hypothesis;
+
+	// merge the nearly coplanar segments in rounds (using union-find) in refine_planes(), instead of 
+	// restarting the search after each single merge
+	extern METHOD_API bool fast_plane_merging;
+
+	// the plane budget applied at the end of refine_planes(), which bounds the cost of the candidate faces 
+	// (growing with the cube of the number of planes): the segments are ranked by their weighted number of
+	// points times their mean planar quality (if the points have one), and only the best ones are kept, at
+	// most 'max_planes' of them (0 means no limit) and no more than needed to explain the fraction 
+	// 'plane_budget_coverage' of the points of all the segments (1 means all of them). A discarded segment
+	// is absorbed into the kept segment whose plane fits its points, if any, and dropped otherwise.
+	extern METHOD_API unsigned int max_planes;
+	extern METHOD_API double plane_budget_coverage;
+
+	// The regularization of the planes before the candidate faces: the segments whose planes make an angle 
+	// below 'plane_regularization_angle' (in degree, 0 disables it), and whose centroids lie closer to each
+	// other's plane than 'plane_regularization_distance' times the average largest distance of the segments
+	// to their planes, share the plane fitted to all their points. The segments stay apart (a face on the 
+	// shared plane gets the points of each), but the nearly identical planes that refine_planes() left no 
+	// longer cut thin wedges. It is skipped for the planes kept as they are (see set_keep_planes()).
+	extern METHOD_API double plane_regularization_angle;
+	extern METHOD_API double plane_regularization_distance;
+
+	// compute the intersecting point of a plane triplet only when it is queried for the first time,
+	// instead of precomputing all the triplets (which is cubic in the number of planes)
+	extern METHOD_API bool lazy_triplet_intersection;
+
+	// remove the degenerate edges by revisiting only the short edges after each collapse, instead of 
+	// rescanning all the edges (gives the same result)
+	extern METHOD_API bool fast_degenerate_removal;
+
+	// sort the projected points of each segment into a 2D grid, so the points projected in a candidate
+	// face are found by visiting only the grid cells overlapping the face
+	extern METHOD_API bool segment_point_grids;
+
+	// locate the projected points of each segment in the candidate faces on its plane in one pass, each
+	// point being only tested against the faces whose bounding box overlaps its grid cell (see 
+	// FacetPointLocator), instead of collecting the points of each face separately. It takes precedence
+	// over segment_point_grids (the results are the same)
+	extern METHOD_API bool one_pass_point_location;
+
+	// compute a single alpha shape per segment and obtain the covered area of each candidate face by
+	// clipping it against the face, instead of computing an alpha shape of the points projected in 
+	// each face (the results differ slightly, at the face boundaries)
+	extern METHOD_API bool segment_alpha_shapes;
+
+	// for quick runs: obtain the covered area of each candidate face from an occupancy bitmap of the
+	// points of its segment (see RasterCoverage) instead of an alpha shape. The cells are 
+	// 'raster_coverage_cell_size' times the average point spacing, and the gaps of up to 
+	// 'raster_coverage_closing' cells are closed. It takes precedence over segment_alpha_shapes
+	extern METHOD_API bool raster_coverage;
+	extern METHOD_API double raster_coverage_cell_size;
+	extern METHOD_API unsigned int raster_coverage_closing;
+
+	// compute the footprint of each segment (its projected points, their convex hull, and their alpha
+	// shape with segment_alpha_shapes; see SegmentFootprint) once and keep it with the segment, for the
+	// coverages of the candidate faces of the next runs and for the outlines drawn by the viewer
+	extern METHOD_API bool segment_footprints;
+
+	// project the points of each segment onto its plane (with their distances to it) once its plane is
+	// final, and keep the projection with the segment for the stages working in the 2D frame of the 
+	// plane (see SegmentProjection), instead of projecting the points again in each of them
+	extern METHOD_API bool segment_projections;
+
+	// count the supporting points of the candidate faces in bulk with the FacetPointCounter registered 
+	// by the application (e.g., on the GPU), when the coverage is computed once per segment (see
+	// raster_coverage and segment_alpha_shapes)
+	extern METHOD_API bool device_point_counting;
+
+	// solve the independent components of the face selection problem (i.e., groups of candidate faces
+	// that share no edge, e.g., separate buildings) as separate binary programs
+	extern METHOD_API bool decompose_face_selection;
+
+	// before solving the face selection problem, fix the variables forced by the constraints (e.g., the
+	// faces of the fans with less than four faces), propagate the fixings, and drop the constraints that
+	// can't be violated anymore (gives the same result)
+	extern METHOD_API bool presolve_face_selection;
+
+	// before the presolve, merge the faces that their super edges force to be selected together (the two
+	// faces left in a super edge whose other faces can't be selected), repeatedly, into one variable
+	extern METHOD_API bool contract_fans;
+
+	// after the face selection, rebuild the model from the selected faces at once (from arrays, with the
+	// attributes of the faces and the sharp edges) instead of erasing the other faces one by one, which
+	// is much faster when most of the candidate faces are dropped. The other attributes of the vertices
+	// and the halfedges are not kept
+	extern METHOD_API bool bulk_selection_extraction;
+
+	// time limit (in seconds) for solving the face selection problem. When it is reached, the best solution 
+	// found so far is used (0 means no limit)
+	extern METHOD_API double selection_time_limit;
+
+	// time limit (in seconds) of the re-selection started in the live mode of the GUI whenever the weights
+	// are changed (the best solution found by then is shown)
+	extern METHOD_API double live_selection_time_limit;
+
+	// formulate the face selection problem directly in the solver (SCIP and GLPK only), instead of
+	// keeping a copy of it in memory. The presolve, the decomposition, and the re-optimization with
+	// new weights are not available then
+	extern METHOD_API bool stream_face_selection;
+
+	// add the constraints linking the sharp edges to the faces only when the solver finds them violated
+	// (SCIP and GUROBI only, the other solvers add all of them). Most of them are never tight, which
+	// keeps the relaxations small
+	extern METHOD_API bool lazy_sharp_edges;
+
+	// formulate the sharp edges of two crossing pairs of coplanar faces by the differences of the faces of
+	// each pair (4 constraints per edge without big-M terms), which gives a much tighter LP relaxation and
+	// fewer branch-and-bound nodes. The other edges keep the original constraints
+	extern METHOD_API bool tight_sharp_edges;
+
+	// select the faces by rounding the solution of the LP relaxation (e.g., for quick previews). The
+	// selection is valid, but not necessarily optimal: its gap to the LP bound is reported. No presolve
+	// or decomposition is done then
+	extern METHOD_API bool approximate_face_selection;
+
+	// time (in seconds) the solver may spend improving the rounded selection (0 means no polishing)
+	extern METHOD_API double approximate_polish_time;
+
+	// select the faces by a Lagrangian relaxation of the binary program: the constraints of each super 
+	// edge are relaxed with multipliers, the subproblems of the faces and the super edges are solved in 
+	// parallel, and the multipliers are updated by subgradient steps. The relaxed selections are repaired
+	// into valid ones, and the gap of the best one to the Lagrangian bound is reported. It takes precedence
+	// over approximate_face_selection
+	extern METHOD_API bool lagrangian_face_selection;
+
+	// the maximum number of subgradient steps of the Lagrangian relaxation
+	extern METHOD_API unsigned int lagrangian_iterations;
+
+	// for very large scenes: instead of solving the binary program, label the cells bounded by the 
+	// candidate faces inside or outside by a minimum s-t cut (in polynomial time), and select the faces
+	// between cells of different labels. The result is closed, but the complexity term is approximated
+	// per face, and the orientation of the faces is taken from the normals of the points (or away from
+	// their center). It takes precedence over lagrangian_face_selection and approximate_face_selection
+	extern METHOD_API bool graph_cut_selection;
+
+	// improve the selection (of any of the solves, e.g., one limited in time) by large neighborhood 
+	// search: the faces around a seed (reached across the super edges) are freed, the others fixed, and
+	// the small program of the freed faces is solved and its result kept if it is better
+	extern METHOD_API bool neighborhood_search;
+
+	// the time (in seconds) of the neighborhood search, and the number of faces of each neighborhood
+	extern METHOD_API double		neighborhood_search_time;
+	extern METHOD_API unsigned int	neighborhood_size;
+
+	// start the solvers from a closed surface grown greedily from the most confident faces (ignored by
+	// LPSOLVE, which accepts no starting point)
+	extern METHOD_API bool greedy_selection_start;
+
+	// guide the branching of the solvers on the face selection problem with the confidences of the faces:
+	// the faces with some support and at least this ratio of their area covered by the points are hinted
+	// as selected and branched on first, and the faces without support as not selected (see 
+	// LinearProgramSolver::set_variable_hints(), ignored by HIGHS and GLPK)
+	extern METHOD_API bool	 selection_variable_hints;
+	extern METHOD_API double selection_hint_coverage;
+
+	// pick the backend (for the solver AUTO, or instead of GLPK and LPSOLVE on the problems they stall
+	// on), the threads, the reductions, the decomposition, and the exact solve or a heuristic from the
+	// statistics of the face selection problem and the time limit, instead of the options above (see
+	// SelectionPolicy). Ignored with stream_face_selection, where the problem isn't kept
+	extern METHOD_API bool automatic_selection_policy;
+
+	// a report of the Benchmark tool (in CSV) the models of the backends of the policy are fitted to 
+	// (see SolverPolicy::calibrate()), empty means the built-in models
+	extern METHOD_API std::string selection_policy_calibration;
+
+	// keep the optimal solutions of the face selection problem as files in this directory, so a run on
+	// an unchanged input skips solving (empty means no such cache)
+	extern METHOD_API std::string selection_cache_directory;
+
+	// number of the most recent solutions of the face selection problem kept in memory, if no cache
+	// directory is given (0 means no cache)
+	extern METHOD_API unsigned int selection_cache_capacity;
+
+	// the memory (in bytes) the reconstruction of a point cloud may use (0 means no limit). The pipelines
+	// given a budget (e.g., the Batch tool) switch to cheaper options until the predicted memory fits it
+	// (see MemoryPlanner), and the face selection gives up before launching the solver if the accounted
+	// memory of the points, the candidate faces, and the binary program exceeds it
+	extern METHOD_API double memory_budget;
+
+	// merge the adjacent coplanar faces of the reconstructed model into polygons (see MapFacetMerger),
+	// dropping the boundary vertices that are no corners, which cuts the faces of the saved models
+	extern METHOD_API bool merge_coplanar_faces;
+
+	//________________ multi-threading ____________________
+
+	// number of threads used by the parallel parts of the method (0 means all hardware threads)
+	extern METHOD_API unsigned int num_threads;
+
+	// cut the candidate faces of different supporting planes in parallel (gives the same result
+	// as cutting them one after another)
+	extern METHOD_API bool parallel_pairwise_cut;
+
+	// compute the proxy faces (the planes of the segments clipped by the bbox) in parallel, with the 
+	// clipping and the convex hulls computed in the frames of the planes instead of with CGAL
+	extern METHOD_API bool parallel_proxy_mesh;
+
+	// compute the point confidences in parallel, with a single K-nearest neighbor query per point 
+	// (the smaller neighborhoods are the prefixes of the largest one)
+	extern METHOD_API bool parallel_point_confidences;
+	// compute the point confidences with the PointQualityEstimator registered by the application (e.g., 
+	// on the GPU), with the same semantics as the parallel version (the CPU is used if it fails)
+	extern METHOD_API bool device_point_confidences;
+	// the spatial index of the points for the neighbor queries: 0 chooses it from the points (a grid 
+	// for the large point clouds of roughly uniform density, a kd-tree otherwise), 1 is a kd-tree, and 
+	// 2 a grid (see PointSearch::Backend)
+	extern METHOD_API int point_search_backend;
+	// the K nearest neighbors used for the point confidences may be farther than the true ones by this
+	// factor (i.e., (1 + epsilon) times the distances), which makes the queries faster. The confidences
+	// are statistics of the neighborhoods, so they hardly change (0 means the exact neighbors)
+	extern METHOD_API double point_search_epsilon;
+	// the maximum number of leaves of the kd-tree visited by a K nearest neighbor query of the point
+	// confidences (0 means no limit)
+	extern METHOD_API unsigned int point_search_max_leaves;
+	// keep the kd-trees of the point clouds as files in this directory (named after a hash of the points,
+	// e.g., next to the scans), so later runs on the same points load them instead of building them 
+	// (empty means no such cache)
+	extern METHOD_API std::string point_index_cache_directory;
+
+	// before generating the candidate faces, reorder the points so that the points of each planar 
+	// segment are contiguous (see PointSet::reorder_by_groups()), which makes the loops over the 
+	// points of a segment scan the memory in order. It changes the order of the points in the point
+	// set (and thus of the saved files)
+	extern METHOD_API bool reorder_points_by_groups;
+
+	// before generating the candidate faces (and before the first reorder_points_by_groups), reorder the
+	// points by their Morton codes (see PointSet::reorder_spatially()), so that the kNN queries of the
+	// point confidences and the loops over the points of a segment visit the memory of the points near
+	// in space together, instead of in the order of the scans. It also changes the order of the points
+	extern METHOD_API bool reorder_points_spatially;
+
+	// the size of the cells of the voxel grid the points are downsampled on before computing the 
+	// confidences (see PointSetDownsampler), the remaining points being weighted by the number of points
+	// they stand for. It changes the point set (0 means no downsampling)
+	extern METHOD_API float downsampling_cell_size;
+
+	// reuse the planar qualities of the points (and their average spacing) when they have been computed
+	// with the same neighborhood sizes, e.g., saved with the points in the .vg/.bvg files, instead of 
+	// computing the point confidences again
+	extern METHOD_API bool reuse_point_confidences;
+
+	// compute the confidences of the candidate faces in parallel (gives the same result as computing 
+	// them one after another)
+	extern METHOD_API bool parallel_facet_confidences;
+
+	// keep a copy of the points padded to 16 bytes each (see PointSet::padded_points()) for the distance
+	// kernels of the plane refinement and of the face confidences
+	extern METHOD_API bool padded_point_kernels;
+
+	// compute the confidences of only the candidate faces whose inputs changed since the last computation
+	// of their confidences (the points, the geometry of the face, its supporting segment and the plane of
+	// the segment, and the parameters), e.g., in an editing session where the segments are edited and the 
+	// confidences computed again. The inputs are recorded in a facet attribute
+	extern METHOD_API bool incremental_facet_confidences;
+
+	// estimate the confidences of the candidate faces of the large segments (of more than 
+	// 'confidence_sample_size' points) from a stratified random subsample of their points (see 
+	// StratifiedSample, seeded by 'confidence_sample_seed'), and only compute exactly the faces whose 
+	// estimated cost in the objective of the face selection (their data fitting and coverage terms) is 
+	// within 'confidence_interval_sigmas' standard deviations, plus the error band of the coverage, of
+	// zero, i.e., those the estimates can't tell whether they are worth selecting
+	extern METHOD_API bool sampled_confidences;
+	extern METHOD_API unsigned int confidence_sample_size;
+	extern METHOD_API unsigned int confidence_sample_seed;
+	extern METHOD_API double confidence_interval_sigmas;
+
+	// give no support and no coverage to the candidate faces no point is near (e.g., deep inside the 
+	// scene or in the open air), found with a coarse voxel grid of the points (see OccupancyGrid), 
+	// instead of locating the points of their segments in them and computing their coverage. They stay
+	// candidates, as closing the model may need them (the results are the same)
+	extern METHOD_API bool free_space_pruning;
+
+	// solve the components of the face selection problem in parallel (only with the solvers that can 
+	// run in several threads, i.e., SCIP and LPSOLVE)
+	extern METHOD_API bool parallel_face_selection;
+
+	// make the results identical for any number of threads and across runs: the faces are cut by the
+	// planes in the order of the plane indices (instead of their addresses), and the solvers run with 
+	// a fixed seed in their deterministic modes. A time limit for the face selection still depends on
+	// the timing
+	extern METHOD_API bool deterministic;
+
 	//________________ names for various quality measures ____________________
 
 	extern METHOD_API std::string facet_attrib_supporting_vertex_group;
 	extern METHOD_API std::string facet_attrib_supporting_point_num;
 	extern METHOD_API std::string facet_attrib_facet_area;
 	extern METHOD_API std::string facet_attrib_covered_area;
+	extern METHOD_API std::string facet_attrib_confidence_signature;
 
 }
 
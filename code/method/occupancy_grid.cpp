@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "occupancy_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+void OccupancyGrid::build(const std::vector<vec3>& points, double cell_size, int max_cells) {
+	bits_.clear();
+	num_[0] = num_[1] = num_[2] = 0;
+	if (points.empty())
+		return;
+
+	Box3d box;
+	for (std::size_t i = 0; i < points.size(); ++i)
+		box.add_point(points[i]);
+	origin_ = vec3(box.x_min(), box.y_min(), box.z_min());
+
+	const double extent = std::max(std::max(box.width(), box.height()), box.depth());
+	cell_size_ = std::max(cell_size, extent / std::max(max_cells, 1));
+	if (cell_size_ <= 0.0)
+		cell_size_ = 1.0;	// all the points at the same location
+	for (int d = 0; d < 3; ++d)
+		num_[d] = std::max(1, std::min(max_cells, int(std::ceil((box.max(d) - box.min(d)) / cell_size_))));
+
+	const std::size_t num = std::size_t(num_[0]) * num_[1] * num_[2];
+	bits_.assign((num + 63) / 64, 0);
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		int cell[3];
+		for (int d = 0; d < 3; ++d)
+			cell[d] = std::min(num_[d] - 1, std::max(0, int((points[i][d] - origin_[d]) / cell_size_)));
+		const std::size_t index = (std::size_t(cell[2]) * num_[1] + cell[1]) * num_[0] + cell[0];
+		bits_[index / 64] |= Numeric::uint64(1) << (index % 64);
+	}
+}
+
+
+std::size_t OccupancyGrid::num_occupied_cells() const {
+	std::size_t num = 0;
+	for (std::size_t i = 0; i < bits_.size(); ++i) {
+		for (Numeric::uint64 w = bits_[i]; w; w &= w - 1)
+			++num;
+	}
+	return num;
+}
+
+
+bool OccupancyGrid::is_occupied_near(const vec3* plg, std::size_t n, const vec3& normal, double band) const {
+	if (bits_.empty() || n == 0)
+		return false;
+
+	// the bounding box of the polygon enlarged by the band, and the slab around its plane (the 
+	// vertices of the polygon may deviate from the plane slightly)
+	const double offset = dot(normal, plg[0]);
+	double lower[3], upper[3];
+	double deviation = 0.0;
+	for (int d = 0; d < 3; ++d)
+		lower[d] = upper[d] = plg[0][d];
+	for (std::size_t i = 1; i < n; ++i) {
+		for (int d = 0; d < 3; ++d) {
+			lower[d] = std::min(lower[d], double(plg[i][d]));
+			upper[d] = std::max(upper[d], double(plg[i][d]));
+		}
+		deviation = std::max(deviation, std::abs(dot(normal, plg[i]) - offset));
+	}
+	const double margin = 1e-3 * cell_size_;	// for the rounding of the voxel coordinates
+	const double slab = band + deviation + margin;
+	int first[3], last[3];
+	for (int d = 0; d < 3; ++d) {
+		lower[d] -= band + margin;
+		upper[d] += band + margin;
+		const double grid_end = origin_[d] + num_[d] * cell_size_;
+		if (upper[d] < origin_[d] - margin || lower[d] > grid_end + margin)
+			return false;
+		first[d] = std::min(num_[d] - 1, std::max(0, int(std::floor((lower[d] - origin_[d]) / cell_size_))));
+		last[d] = std::min(num_[d] - 1, std::max(0, int(std::floor((upper[d] - origin_[d]) / cell_size_))));
+	}
+
+	// the columns of voxels along the dominant axis of the normal, and in each column the voxels the 
+	// slab crosses
+	int a = 0;
+	for (int d = 1; d < 3; ++d) {
+		if (std::abs(normal[d]) > std::abs(normal[a]))
+			a = d;
+	}
+	const int u = (a + 1) % 3;
+	const int w = (a + 2) % 3;
+	const double na = normal[a];
+	if (std::abs(na) < 1e-6)
+		return true;	// not a unit normal, the polygon can't be tested
+	const double reach = slab / std::abs(na);
+
+	int cell[3];
+	for (int iu = first[u]; iu <= last[u]; ++iu) {
+		const double u0 = origin_[u] + iu * cell_size_;
+		const double u1 = u0 + cell_size_;
+		for (int iw = first[w]; iw <= last[w]; ++iw) {
+			const double w0 = origin_[w] + iw * cell_size_;
+			const double w1 = w0 + cell_size_;
+			// the coordinate of the plane along the axis at the corners of the column
+			const double c00 = (offset - normal[u] * u0 - normal[w] * w0) / na;
+			const double c01 = (offset - normal[u] * u0 - normal[w] * w1) / na;
+			const double c10 = (offset - normal[u] * u1 - normal[w] * w0) / na;
+			const double c11 = (offset - normal[u] * u1 - normal[w] * w1) / na;
+			const double lo = std::max(lower[a], std::min(std::min(c00, c01), std::min(c10, c11)) - reach);
+			const double hi = std::min(upper[a], std::max(std::max(c00, c01), std::max(c10, c11)) + reach);
+			if (lo > hi)
+				continue;
+			const int i0 = std::min(num_[a] - 1, std::max(0, int(std::floor((lo - origin_[a]) / cell_size_))));
+			const int i1 = std::min(num_[a] - 1, std::max(0, int(std::floor((hi - origin_[a]) / cell_size_))));
+			cell[u] = iu;
+			cell[w] = iw;
+			for (int ia = i0; ia <= i1; ++ia) {
+				cell[a] = ia;
+				if (is_occupied(cell[0], cell[1], cell[2]))
+					return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _OCCUPANCY_GRID_H_
+#define _OCCUPANCY_GRID_H_
+
+#include "method_common.h"
+#include "../basic/basic_types.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+// A coarse voxel grid of the space occupied by the points (one bit per voxel), telling cheaply whether
+// any point may be near a planar polygon (e.g., a candidate face far from the data, deep inside the 
+// scene or in the open air). The test is conservative: it may report points near a polygon that has 
+// none (the voxels are tested, not the points), but never misses a point.
+class METHOD_API OccupancyGrid
+{
+public:
+	OccupancyGrid() : cell_size_(1.0) { num_[0] = num_[1] = num_[2] = 0; }
+
+	// The voxels are at least 'cell_size' wide, and larger if needed for at most 'max_cells' voxels 
+	// along each axis of the bounding box of the points.
+	void build(const std::vector<vec3>& points, double cell_size, int max_cells = 256);
+
+	double cell_size() const { return cell_size_; }
+	std::size_t num_occupied_cells() const;
+
+	// Returns true if some voxel within 'band' of the polygon of the n points 'plg' (planar, with the 
+	// unit 'normal') holds points, i.e., if a point may be within 'band' of the polygon. Only the voxels
+	// near the plane of the polygon, inside its bounding box (enlarged by the band), are visited.
+	bool is_occupied_near(const vec3* plg, std::size_t n, const vec3& normal, double band) const;
+
+private:
+	bool is_occupied(int i, int j, int k) const {
+		const std::size_t index = (std::size_t(k) * num_[1] + j) * num_[0] + i;
+		return (bits_[index / 64] >> (index % 64)) & 1;
+	}
+
+private:
+	vec3	origin_;		// the lower corner of the grid
+	double	cell_size_;
+	int		num_[3];
+	std::vector<Numeric::uint64>	bits_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "plane_arrangement.h"
+
+
+PlaneArrangement::PlaneArrangement(unsigned int plane, geom_real snap_distance) 
+	: plane_(plane), snap_distance_(snap_distance) 
+{
+}
+
+
+void PlaneArrangement::set_boundary(const std::vector<Point>& points, const std::vector< PlaneIdSet<3> >& point_planes, const std::vector< PlaneIdSet<2> >& edge_planes) {
+	vertices_.clear();
+	faces_.clear();
+	crossings_.clear();
+
+	Face face;
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		Vertex v;
+		v.p = points[i];
+		v.planes = point_planes[i];
+		face.vertices.push_back(static_cast<unsigned int>(vertices_.size()));
+		face.edges.push_back(edge_planes[i]);
+		vertices_.push_back(v);
+	}
+	if (face.vertices.size() >= 3)
+		faces_.push_back(face);
+}
+
+
+unsigned int PlaneArrangement::crossing(unsigned int v, unsigned int w, const PlaneIdSet<2>& edge, unsigned int plane) {
+	PlaneIdSet<3> planes(edge);
+	planes.insert(plane);
+
+	// the two faces of the edge create the same vertex
+	const bool has_key = (planes.size() == 3);
+	Numeric::uint64 key = 0;
+	if (has_key) {
+		key = (Numeric::uint64(planes[0]) << 42) | (Numeric::uint64(planes[1]) << 21) | Numeric::uint64(planes[2]);
+		std::unordered_map<Numeric::uint64, unsigned int>::const_iterator pos = crossings_.find(key);
+		if (pos != crossings_.end())
+			return pos->second;
+	}
+
+	Vertex x;
+	geom_real t = values_[v] / (values_[v] - values_[w]);
+	x.p = vertices_[v].p + (vertices_[w].p - vertices_[v].p) * t;
+	x.planes = planes;
+
+	unsigned int id = static_cast<unsigned int>(vertices_.size());
+	vertices_.push_back(x);
+	values_.push_back(0);
+	sides_.push_back(0);
+	if (has_key)
+		crossings_[key] = id;
+	return id;
+}
+
+
+std::size_t PlaneArrangement::insert_line(unsigned int plane, geom_real a, geom_real b, geom_real c) {
+	values_.resize(vertices_.size());
+	sides_.resize(vertices_.size());
+	for (std::size_t i = 0; i < vertices_.size(); ++i) {
+		const Point& p = vertices_[i].p;
+		values_[i] = a * p.x + b * p.y + c;
+		sides_[i] = (values_[i] > snap_distance_) ? 1 : ((values_[i] < -snap_distance_) ? -1 : 0);
+	}
+
+	std::size_t num_split = 0;
+	std::size_t num_faces = faces_.size();
+	for (std::size_t i = 0; i < num_faces; ++i) {
+		const Face& f = faces_[i];
+		bool positive = false, negative = false;
+		for (std::size_t k = 0; k < f.vertices.size(); ++k) {
+			positive = positive || (sides_[f.vertices[k]] > 0);
+			negative = negative || (sides_[f.vertices[k]] < 0);
+		}
+		if (!positive || !negative)
+			continue;
+
+		// the vertices on the line go to both sides, together with the crossings of the edges
+		Face parts[2];
+		for (std::size_t k = 0; k < f.vertices.size(); ++k) {
+			unsigned int v = f.vertices[k];
+			unsigned int w = f.vertices[(k + 1) % f.vertices.size()];
+			const PlaneIdSet<2>& edge = f.edges[k];
+			if (sides_[v] >= 0) {
+				parts[0].vertices.push_back(v);
+				parts[0].edges.push_back(edge);
+			}
+			if (sides_[v] <= 0) {
+				parts[1].vertices.push_back(v);
+				parts[1].edges.push_back(edge);
+			}
+			if (sides_[v] * sides_[w] < 0) {
+				unsigned int x = crossing(v, w, edge, plane);
+				for (int j = 0; j < 2; ++j) {
+					parts[j].vertices.push_back(x);
+					parts[j].edges.push_back(edge);
+				}
+			}
+		}
+
+		// the edge between two vertices on the line lies on the line
+		PlaneIdSet<2> cut;
+		cut.insert(plane_);
+		cut.insert(plane);
+		for (int j = 0; j < 2; ++j) {
+			Face& part = parts[j];
+			for (std::size_t k = 0; k < part.vertices.size(); ++k) {
+				unsigned int v = part.vertices[k];
+				unsigned int w = part.vertices[(k + 1) % part.vertices.size()];
+				if (sides_[v] == 0 && sides_[w] == 0)
+					part.edges[k] = cut;
+			}
+		}
+
+		faces_[i].vertices.swap(parts[0].vertices);
+		faces_[i].edges.swap(parts[0].edges);
+		faces_.push_back(parts[1]);
+		++num_split;
+	}
+	return num_split;
+}
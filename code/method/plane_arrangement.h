@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _PLANE_ARRANGEMENT_H_
+#define _PLANE_ARRANGEMENT_H_
+
+#include "method_common.h"
+#include "plane_id_set.h"
+#include "../math/math_types.h"
+#include "../basic/basic_types.h"
+
+#include <vector>
+#include <unordered_map>
+
+
+// The arrangement of the lines in which the cutting planes intersect a supporting plane, inside the
+// (convex) proxy face of the plane (see Method::plane_arrangement). It is computed in the 2D frame of
+// the plane (see Plane3d::to_2d()) on plain arrays, and each vertex is tagged by the planes it lies on,
+// so the arrangements of different planes are independent of each other. The faces stay convex: a 
+// line splits a face into two, and the vertices it creates on the edges are shared by the two faces
+// of each edge (they are identified by their three planes).
+class METHOD_API PlaneArrangement
+{
+public:
+	typedef vecng<2, geom_real>	Point;
+
+	struct Vertex {
+		Point			p;
+		PlaneIdSet<3>	planes;
+	};
+
+	// a convex face: its vertices (in the order of the proxy face), and the planes of the edge from 
+	// each vertex to the next one
+	struct Face {
+		std::vector<unsigned int>		vertices;
+		std::vector< PlaneIdSet<2> >	edges;
+	};
+
+	// 'plane' is the index of the supporting plane. The vertices closer than 'snap_distance' to a line
+	// are on the line.
+	PlaneArrangement(unsigned int plane, geom_real snap_distance);
+
+	// starts from the proxy face: its points, the planes of the points, and the planes of the edge from
+	// each point to the next one
+	void set_boundary(const std::vector<Point>& points, const std::vector< PlaneIdSet<3> >& point_planes, const std::vector< PlaneIdSet<2> >& edge_planes);
+
+	// Splits the faces by the line a * x + b * y + c = 0 of the plane of index 'plane', where the
+	// value is the signed distance to that plane. Returns the number of faces split.
+	std::size_t insert_line(unsigned int plane, geom_real a, geom_real b, geom_real c);
+
+	const std::vector<Vertex>& vertices() const { return vertices_; }
+	const std::vector<Face>& faces() const { return faces_; }
+
+private:
+	// the vertex where the line of 'plane' crosses the edge (v, w) lying on the planes 'edge'
+	unsigned int crossing(unsigned int v, unsigned int w, const PlaneIdSet<2>& edge, unsigned int plane);
+
+private:
+	unsigned int		plane_;
+	geom_real			snap_distance_;
+
+	std::vector<Vertex>	vertices_;
+	std::vector<Face>	faces_;
+
+	// for the current line: the values of the vertices, and their sides (-1, 0, or 1)
+	std::vector<geom_real>		values_;
+	std::vector<signed char>	sides_;
+
+	// the vertices created by the lines, keyed by their three planes
+	std::unordered_map<Numeric::uint64, unsigned int>	crossings_;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _PLANE_ID_SET_H_
+#define _PLANE_ID_SET_H_
+
+#include "../basic/assertions.h"
+
+#include <cstddef>
+
+
+// A sorted set of at most N plane indices, stored inline (no heap allocation). It is
+// used to record the planes an edge (2 planes) or a vertex (3 planes) is computed from.
+template <unsigned int N>
+class PlaneIdSet
+{
+public:
+	typedef const unsigned int* const_iterator;
+
+	PlaneIdSet() : size_(0) {}
+
+	// copies the ids of a (smaller) set
+	template <unsigned int M>
+	explicit PlaneIdSet(const PlaneIdSet<M>& rhs) : size_(0) {
+		for (const_iterator it = rhs.begin(); it != rhs.end(); ++it)
+			insert(*it);
+	}
+
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	void clear() { size_ = 0; }
+
+	const_iterator begin() const { return ids_; }
+	const_iterator end() const { return ids_ + size_; }
+
+	// the ids are in increasing order
+	unsigned int operator[](std::size_t i) const { ogf_debug_assert(i < size_); return ids_[i]; }
+
+	bool contains(unsigned int id) const {
+		for (unsigned int i = 0; i < size_; ++i) {
+			if (ids_[i] == id)
+				return true;
+		}
+		return false;
+	}
+
+	// returns false if the set is full (then 'id' is not inserted)
+	bool insert(unsigned int id) {
+		unsigned int pos = 0;
+		while (pos < size_ && ids_[pos] < id)
+			++pos;
+		if (pos < size_ && ids_[pos] == id)
+			return true;
+		if (size_ == N)
+			return false;
+		for (unsigned int i = size_; i > pos; --i)
+			ids_[i] = ids_[i - 1];
+		ids_[pos] = id;
+		++size_;
+		return true;
+	}
+
+	bool operator==(const PlaneIdSet<N>& rhs) const {
+		if (size_ != rhs.size_)
+			return false;
+		for (unsigned int i = 0; i < size_; ++i) {
+			if (ids_[i] != rhs.ids_[i])
+				return false;
+		}
+		return true;
+	}
+	bool operator!=(const PlaneIdSet<N>& rhs) const { return !(*this == rhs); }
+
+private:
+	unsigned int ids_[N];
+	unsigned int size_;
+};
+
+#endif
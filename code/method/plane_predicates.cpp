@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "plane_predicates.h"
+#include "cgal_types.h"
+#include "../basic/logger.h"
+
+#include <atomic>
+
+
+namespace {
+	std::atomic<std::size_t> exact_decisions(0);
+}
+
+
+Sign PlanePredicates::exact_orient(const Plane3d& plane, const vec3& p) {
+	++exact_decisions;
+
+	// the predicates of the kernel are exact on the (float, thus exactly representable) coefficients
+	K::Plane_3 cgal_plane(plane.a(), plane.b(), plane.c(), plane.d());
+	CGAL::Oriented_side side = cgal_plane.oriented_side(Point3(p.x, p.y, p.z));
+	if (side == CGAL::ON_POSITIVE_SIDE)
+		return POSITIVE;
+	else if (side == CGAL::ON_NEGATIVE_SIDE)
+		return NEGATIVE;
+	return ZERO;
+}
+
+
+bool PlanePredicates::intersection(const Plane3d& plane, const vec3& s, const vec3& t, vec3& p) {
+	Sign ss = orient(plane, s);
+	Sign st = orient(plane, t);
+	if (ss == ZERO) {
+		p = s;
+		return true;
+	}
+	else if (st == ZERO) {
+		p = t;
+		return true;
+	}
+	else if (ss == st)
+		return false;
+
+	if (plane.intersection(Line3d::from_two_points(s, t), p))
+		return true;
+
+	Logger::warn("-") << "fatal error. Should have intersection" << std::endl;
+	return false;
+}
+
+
+std::size_t PlanePredicates::num_exact_decisions() {
+	return exact_decisions;
+}
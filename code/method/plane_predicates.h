@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _PLANE_PREDICATES_H_
+#define _PLANE_PREDICATES_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+#include "../basic/basic_types.h"
+
+#include <cmath>
+#include <limits>
+
+
+// Filtered predicates of the side of a point w.r.t. a plane, for the cutting decisions of the
+// hypothesis generator. The value of the plane equation is first evaluated in float, and its
+// sign is used if the value is larger than the error bound of this evaluation. Only the 
+// uncertain cases (i.e., the points very close to the plane) are decided with exact arithmetic.
+// Unlike Plane3d::orient(), the result is ZERO only if the point is exactly on the plane.
+class METHOD_API PlanePredicates
+{
+public:
+	// the side of 'p', where 'value' is a * p.x + b * p.y + c * p.z + d computed in float 
+	// (e.g., by Plane3d::value())
+	static Sign orient(const Plane3d& plane, const vec3& p, float value) {
+		const float* c = plane.data();
+		float magnitude = std::abs(c[0] * p.x) + std::abs(c[1] * p.y) + std::abs(c[2] * p.z) + std::abs(c[3]);
+		// the bound of the rounding errors of the four operations, with a margin
+		float bound = magnitude * (5.0f * std::numeric_limits<float>::epsilon());
+		if (std::abs(value) > bound && magnitude > std::numeric_limits<float>::min())
+			return value > 0 ? POSITIVE : NEGATIVE;
+		return exact_orient(plane, p);
+	}
+
+	static Sign orient(const Plane3d& plane, const vec3& p) {
+		return orient(plane, p, plane.value(p));
+	}
+
+	// computes the intersection 'p' of the plane with the line segment (s, t). It returns false 
+	// if s and t are (strictly) on the same side. The same as Plane3d::intersection(s, t, p), 
+	// with the sides given by orient().
+	static bool intersection(const Plane3d& plane, const vec3& s, const vec3& t, vec3& p);
+
+	// the number of the decisions that were made with exact arithmetic
+	static std::size_t num_exact_decisions();
+
+private:
+	static Sign exact_orient(const Plane3d& plane, const vec3& p);
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _POINT_QUALITY_ESTIMATOR_H_
+#define _POINT_QUALITY_ESTIMATOR_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+
+#include <string>
+#include <vector>
+
+
+// A device (e.g., a GPU) that computes the planar qualities of the points, with the same semantics as
+// PointSetNormals::estimate(): the confidence of each point from the covariances of its sizes[0], 
+// sizes[1], and sizes[2] nearest neighbors (0 if it has less neighbors than the largest size), and 
+// the spacing of each point (the mean distance to its sizes[0] nearest neighbors, 0 without enough 
+// neighbors), from which the caller computes the average spacing. The application registers its 
+// estimator (see set_instance()), e.g., once it has an OpenGL context.
+class METHOD_API PointQualityEstimator
+{
+public:
+	virtual ~PointQualityEstimator() {}
+
+	virtual std::string name() const = 0;
+
+	// Returns false on failure (e.g., the sizes are too large for the device), and the caller then 
+	// computes the qualities on the CPU.
+	virtual bool estimate(
+		const std::vector<vec3>& points, const unsigned int sizes[3], 
+		std::vector<float>& planar_qualities, std::vector<float>& spacings
+	) = 0;
+
+	// the estimator used by HypothesisGenerator::compute_point_confidences() (see 
+	// Method::device_point_confidences), nil if none (the estimator is not owned)
+	static PointQualityEstimator* instance() { return instance_; }
+	static void set_instance(PointQualityEstimator* estimator) { instance_ = estimator; }
+
+private:
+	static PointQualityEstimator* instance_;
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "raster_coverage.h"
+#include "segment_projection.h"
+#include "../model/vertex_group.h"
+#include "../model/point_set.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+	// the maximum number of cells along each axis
+	const double max_resolution = 4096.0;
+
+	inline unsigned int bit_count(Numeric::uint64 w) {
+		w = w - ((w >> 1) & 0x5555555555555555ULL);
+		w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+		w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return static_cast<unsigned int>((w * 0x0101010101010101ULL) >> 56);
+	}
+
+	// the mask of the bits [b0, b1] (0 <= b0 <= b1 < 64) of a word
+	inline Numeric::uint64 bit_mask(int b0, int b1) {
+		Numeric::uint64 high = (b1 == 63) ? ~Numeric::uint64(0) : ((Numeric::uint64(1) << (b1 + 1)) - 1);
+		return high & ~((Numeric::uint64(1) << b0) - 1);
+	}
+
+	// the row 'in' shifted by one column towards the larger (dir = 1) or the smaller (dir = -1) columns
+	void shift_row(const Numeric::uint64* in, int num_words, int dir, Numeric::uint64* out) {
+		for (int w = 0; w < num_words; ++w) {
+			if (dir > 0)
+				out[w] = (in[w] << 1) | (w > 0 ? in[w - 1] >> 63 : 0);
+			else
+				out[w] = (in[w] >> 1) | (w + 1 < num_words ? in[w + 1] << 63 : 0);
+		}
+	}
+}
+
+
+void RasterCoverage::build(const VertexGroup* g, double cell_size, unsigned int closing) {
+	bits_.clear();
+	nx_ = ny_ = words_per_row_ = 0;
+
+	const PointSet* pset = g->point_set();
+	if (!pset || g->empty() || cell_size <= 0)
+		return;
+
+	// the projected points of the segment, if kept (see SegmentProjection and SegmentFootprint)
+	const VertexGroup::Projection* projection = SegmentProjection::of(g);
+	std::vector<vec2> projected;
+	if (!projection && !g->has_footprint()) {
+		const Plane3d& plane = g->plane();
+		const std::vector<vec3>& points = pset->points();
+		projected.resize(g->size());
+		for (std::size_t i = 0; i < g->size(); ++i)
+			projected[i] = plane.to_2d(points[g->at(i)]);
+	}
+	const std::vector<vec2>& pts = projection ? projection->points : (g->has_footprint() ? g->footprint().points : projected);
+	Box2d box;
+	for (std::size_t i = 0; i < pts.size(); ++i)
+		box.add_point(pts[i]);
+
+	double w = double(box.x_max()) - box.x_min();
+	double h = double(box.y_max()) - box.y_min();
+	cell_size_ = std::max(cell_size, std::max(w, h) / max_resolution);
+
+	// the margin leaves room for the dilation, so the closing doesn't depend on the grid boundary
+	const int margin = static_cast<int>(closing) + 1;
+	origin_ = vec2(float(box.x_min() - margin * cell_size_), float(box.y_min() - margin * cell_size_));
+	nx_ = static_cast<int>((box.x_max() - origin_.x) / cell_size_) + 1 + margin;
+	ny_ = static_cast<int>((box.y_max() - origin_.y) / cell_size_) + 1 + margin;
+	words_per_row_ = (nx_ + 63) / 64;
+	bits_.assign(std::size_t(words_per_row_) * ny_, 0);
+
+	for (std::size_t i = 0; i < pts.size(); ++i) {
+		int ix = static_cast<int>((pts[i].x - origin_.x) / cell_size_);
+		int iy = static_cast<int>((pts[i].y - origin_.y) / cell_size_);
+		ogf_clamp(ix, 0, nx_ - 1);	ogf_clamp(iy, 0, ny_ - 1);
+		bits_[std::size_t(iy) * words_per_row_ + ix / 64] |= Numeric::uint64(1) << (ix % 64);
+	}
+
+	for (unsigned int k = 0; k < closing; ++k)
+		dilate();
+	for (unsigned int k = 0; k < closing; ++k)
+		erode();
+}
+
+
+void RasterCoverage::dilate() {
+	// each row is first dilated horizontally, and then the rows are combined with their neighbors
+	std::vector<Numeric::uint64> rows(bits_.size()), left(words_per_row_), right(words_per_row_);
+	for (int iy = 0; iy < ny_; ++iy) {
+		const Numeric::uint64* in = &bits_[std::size_t(iy) * words_per_row_];
+		Numeric::uint64* out = &rows[std::size_t(iy) * words_per_row_];
+		shift_row(in, words_per_row_, 1, &left[0]);
+		shift_row(in, words_per_row_, -1, &right[0]);
+		for (int w = 0; w < words_per_row_; ++w)
+			out[w] = in[w] | left[w] | right[w];
+	}
+	for (int iy = 0; iy < ny_; ++iy) {
+		Numeric::uint64* out = &bits_[std::size_t(iy) * words_per_row_];
+		const Numeric::uint64* row = &rows[std::size_t(iy) * words_per_row_];
+		for (int w = 0; w < words_per_row_; ++w) {
+			Numeric::uint64 v = row[w];
+			if (iy > 0)			v |= row[w - words_per_row_];
+			if (iy + 1 < ny_)	v |= row[w + words_per_row_];
+			out[w] = v;
+		}
+		// the bits beyond the last column stay empty
+		if (nx_ % 64 != 0)
+			out[words_per_row_ - 1] &= bit_mask(0, nx_ % 64 - 1);
+	}
+}
+
+
+void RasterCoverage::erode() {
+	// the same as dilate() on the complement, the cells outside the grid being empty
+	std::vector<Numeric::uint64> rows(bits_.size()), left(words_per_row_), right(words_per_row_);
+	for (int iy = 0; iy < ny_; ++iy) {
+		const Numeric::uint64* in = &bits_[std::size_t(iy) * words_per_row_];
+		Numeric::uint64* out = &rows[std::size_t(iy) * words_per_row_];
+		shift_row(in, words_per_row_, 1, &left[0]);
+		shift_row(in, words_per_row_, -1, &right[0]);
+		for (int w = 0; w < words_per_row_; ++w)
+			out[w] = in[w] & left[w] & right[w];
+	}
+	for (int iy = 0; iy < ny_; ++iy) {
+		Numeric::uint64* out = &bits_[std::size_t(iy) * words_per_row_];
+		const Numeric::uint64* row = &rows[std::size_t(iy) * words_per_row_];
+		for (int w = 0; w < words_per_row_; ++w) {
+			Numeric::uint64 v = row[w];
+			v &= (iy > 0) ? row[w - words_per_row_] : 0;
+			v &= (iy + 1 < ny_) ? row[w + words_per_row_] : 0;
+			out[w] = v;
+		}
+	}
+}
+
+
+std::size_t RasterCoverage::num_occupied_cells() const {
+	std::size_t num = 0;
+	for (std::size_t i = 0; i < bits_.size(); ++i)
+		num += bit_count(bits_[i]);
+	return num;
+}
+
+
+double RasterCoverage::covered_area(const Polygon2d& plg) const {
+	if (bits_.empty() || plg.size() < 3)
+		return 0.0;
+
+	Box2d box;
+	for (std::size_t i = 0; i < plg.size(); ++i)
+		box.add_point(plg[i]);
+	int iy0 = static_cast<int>(std::ceil((box.y_min() - origin_.y) / cell_size_ - 0.5));
+	int iy1 = static_cast<int>(std::floor((box.y_max() - origin_.y) / cell_size_ - 0.5));
+	iy0 = std::max(iy0, 0);
+	iy1 = std::min(iy1, ny_ - 1);
+
+	// the cells of each row whose centers are inside the polygon form the spans between the pairs
+	// of (sorted) crossings of the polygon boundary with the horizontal line through the centers
+	std::size_t num = 0;
+	std::vector<double> crossings;
+	for (int iy = iy0; iy <= iy1; ++iy) {
+		const double y = origin_.y + (iy + 0.5) * cell_size_;
+		crossings.clear();
+		for (std::size_t i = 0, j = plg.size() - 1; i < plg.size(); j = i, ++i) {
+			const vec2& a = plg[j];
+			const vec2& b = plg[i];
+			if ((a.y <= y) != (b.y <= y))
+				crossings.push_back(a.x + (y - a.y) / (double(b.y) - a.y) * (double(b.x) - a.x));
+		}
+		std::sort(crossings.begin(), crossings.end());
+
+		const Numeric::uint64* row = &bits_[std::size_t(iy) * words_per_row_];
+		for (std::size_t k = 0; k + 1 < crossings.size(); k += 2) {
+			int ix0 = static_cast<int>(std::ceil((crossings[k] - origin_.x) / cell_size_ - 0.5));
+			int ix1 = static_cast<int>(std::floor((crossings[k + 1] - origin_.x) / cell_size_ - 0.5));
+			ix0 = std::max(ix0, 0);
+			ix1 = std::min(ix1, nx_ - 1);
+			if (ix0 > ix1)
+				continue;
+			for (int w = ix0 / 64; w <= ix1 / 64; ++w) {
+				int b0 = (w == ix0 / 64) ? ix0 % 64 : 0;
+				int b1 = (w == ix1 / 64) ? ix1 % 64 : 63;
+				num += bit_count(row[w] & bit_mask(b0, b1));
+			}
+		}
+	}
+	return double(num) * cell_size_ * cell_size_;
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _RASTER_COVERAGE_H_
+#define _RASTER_COVERAGE_H_
+
+#include "method_common.h"
+#include "../basic/basic_types.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+class VertexGroup;
+
+// A cheaper alternative to AlphaShapeCoverage for quick runs: the points of a segment (i.e., a 
+// VertexGroup) are rasterized, in the 2D frame (base1/base2) of its supporting plane, into an 
+// occupancy bitmap (one bit per cell), optionally closed (i.e., dilated then eroded) to fill the
+// small gaps between the points. The area of a candidate face covered by the points is the number
+// of occupied cells whose centers are inside the face, times the area of a cell.
+class METHOD_API RasterCoverage
+{
+public:
+	RasterCoverage() : cell_size_(1.0), nx_(0), ny_(0), words_per_row_(0) {}
+
+	// 'cell_size' is the size of the cells, and 'closing' the number of cells the gaps are closed by.
+	// The projected points of the footprint of the segment are used if it has one (see SegmentFootprint).
+	void build(const VertexGroup* g, double cell_size, unsigned int closing);
+
+	// returns the area of the part of the polygon 'plg' (given in the frame of the supporting plane) 
+	// covered by the occupied cells
+	double covered_area(const Polygon2d& plg) const;
+
+	std::size_t num_occupied_cells() const;
+
+private:
+	// the dilation (or the erosion) of the bitmap by one cell in the 8 directions
+	void dilate();
+	void erode();
+
+private:
+	vec2	origin_;		// the lower corner of the grid
+	double	cell_size_;
+	int		nx_, ny_;
+	int		words_per_row_;
+	std::vector<Numeric::uint64>	bits_;	// the rows, the bit (x % 64) of word (x / 64) for column x
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "reconstruction.h"
+#include "method_global.h"
+#include "hypothesis_generator.h"
+#include "implicit_hypothesis.h"
+#include "face_selection.h"
+#include "reconstruction_context.h"
+#include "../basic/logger.h"
+#include "../basic/color.h"
+#include "../basic/parallel.h"
+#include "../basic/progress.h"
+#include "../model/map.h"
+#include "../model/map_enumerator.h"
+#include "../model/map_facet_merger.h"
+#include "../model/point_set.h"
+#include "../model/plane_detector.h"
+
+#include <map>
+#include <sstream>
+#include <cstring>
+
+
+PointSet* Reconstruction::create_point_set(const Input& input) {
+	PointSet* pset = new PointSet;
+	if (input.num_points == 0 || !input.points)
+		return pset;
+
+	// vec3 is three floats, so the arrays are copied as a whole
+	std::vector<vec3>& points = pset->points();
+	points.resize(input.num_points);
+	std::memcpy(points[0].data(), input.points, input.num_points * sizeof(vec3));
+	if (input.normals) {
+		std::vector<vec3>& normals = pset->normals();
+		normals.resize(input.num_points);
+		std::memcpy(normals[0].data(), input.normals, input.num_points * sizeof(vec3));
+	}
+
+	if (input.labels) {
+		std::map<int, VertexGroup*> groups;
+		int last_label = -1;
+		VertexGroup* last_group = nil;
+		for (std::size_t i = 0; i < input.num_points; ++i) {
+			int label = input.labels[i];
+			if (label < 0)
+				continue;
+			if (label != last_label || !last_group) {	// the labels come in runs, mostly
+				VertexGroup*& g = groups[label];
+				if (!g) {
+					g = new VertexGroup(pset);
+					std::ostringstream name;
+					name << "segment_" << label;
+					g->set_label(name.str());
+					g->set_color(random_color());
+				}
+				last_label = label;
+				last_group = g;
+			}
+			last_group->push_back(static_cast<unsigned int>(i));
+		}
+
+		for (std::map<int, VertexGroup*>::const_iterator it = groups.begin(); it != groups.end(); ++it)
+			pset->groups().push_back(it->second);
+
+		// each group is fitted by one thread
+		std::vector<VertexGroup::Ptr>& result = pset->groups();
+		parallel_for(result.size(), [&](std::size_t i) {
+			if (result[i]->size() >= 3)
+				pset->fit_plane(result[i]);
+		}, nil, Method::num_threads);
+	}
+	return pset;
+}
+
+
+void Reconstruction::extract_buffers(const Map* mesh, Mesh& result) {
+	result.clear();
+	result.vertices.reserve(mesh->size_of_vertices() * 3);
+	result.face_offsets.reserve(mesh->size_of_facets() + 1);
+	result.face_indices.reserve(mesh->size_of_halfedges() / 2);
+
+	Attribute<Map::Vertex, int>	vertex_id(mesh->vertex_attribute_manager());
+	MapEnumerator::enumerate_vertices(const_cast<Map*>(mesh), vertex_id);
+	FOR_EACH_VERTEX_CONST(Map, mesh, it) {
+		const vec3& p = it->point();
+		result.vertices.push_back(p.x);
+		result.vertices.push_back(p.y);
+		result.vertices.push_back(p.z);
+	}
+
+	result.face_offsets.push_back(0);
+	FOR_EACH_FACET_CONST(Map, mesh, it) {
+		Map::Halfedge* jt = it->halfedge();
+		do {
+			result.face_indices.push_back(static_cast<unsigned int>(vertex_id[jt->vertex()]));
+			jt = jt->next();
+		} while (jt != it->halfedge());
+		result.face_offsets.push_back(static_cast<unsigned int>(result.face_indices.size()));
+	}
+}
+
+
+bool Reconstruction::reconstruct(const Input& input, const Parameters& params, Mesh& result, SolverSession* session) {
+	result.clear();
+	if (input.num_points == 0 || !input.points) {
+		Logger::err("-") << "the input has no point" << std::endl;
+		return false;
+	}
+
+	// the weights, the time limit and the session of this run only, so that the calls from several 
+	// threads don't share them (the other options are shared, see ReconstructionContext)
+	ReconstructionContext context;
+	context.lambda_data_fitting = params.fitting;
+	context.lambda_model_coverage = params.coverage;
+	context.lambda_model_complexity = params.complexity;
+	if (params.time_limit > 0.0)
+		context.selection_time_limit = params.time_limit;
+	context.session = session;
+	ScopedThreadBudget budget(context.thread_budget());
+
+	// one progress bar for the whole pipeline: its parts roughly follow the typical running times of the stages
+	ProgressStage pipeline(0, 100);
+	PointSet::Ptr pset = create_point_set(input);
+	if (pset->groups().empty()) {
+		ProgressStage stage(0, 15);
+		PlaneDetector::detect(pset, PlaneDetector::Parameters(), context.thread_budget());
+	}
+	if (pset->groups().empty()) {
+		Logger::err("-") << "planar segments do not exist" << std::endl;
+		return false;
+	}
+
+	HypothesisGenerator hypothesis(pset);
+	hypothesis.set_context(&context);
+	Map::Ptr mesh;
+	if (Method::implicit_hypothesis) {
+		ImplicitHypothesis* implicit = nil;
+		{
+			ProgressStage stage(15, 50);
+			hypothesis.refine_planes();
+			implicit = hypothesis.generate_implicit();
+		}
+		if (!implicit) {
+			Logger::err("-") << "failed generating candidate faces" << std::endl;
+			return false;
+		}
+		{
+			ProgressStage stage(50, 75);
+			hypothesis.compute_confidences(implicit, false);
+		}
+		mesh = hypothesis.materialize(implicit);
+		delete implicit;
+	}
+	else {
+		{
+			ProgressStage stage(15, 50);
+			hypothesis.refine_planes();
+			mesh = hypothesis.generate();
+		}
+		if (mesh) {
+			ProgressStage stage(50, 75);
+			hypothesis.compute_confidences(mesh, false);
+		}
+	}
+	if (!mesh || mesh->size_of_facets() == 0) {
+		Logger::err("-") << "failed generating candidate faces" << std::endl;
+		return false;
+	}
+
+	{
+		ProgressStage stage(75, 100);
+		const HypothesisGenerator::Adjacency& adjacency = hypothesis.extract_adjacency(mesh);
+		FaceSelection selector(pset, mesh);
+		selector.set_context(&context);
+		selector.optimize(adjacency, params.solver);
+	}
+	if (mesh->size_of_facets() == 0) {
+		Logger::err("-") << "optimization failed: model has no face" << std::endl;
+		return false;
+	}
+	if (Method::merge_coplanar_faces)
+		mesh = MapFacetMerger::merged(mesh);
+
+	extract_buffers(mesh, result);
+	return true;
+}
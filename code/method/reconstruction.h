@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _RECONSTRUCTION_H_
+#define _RECONSTRUCTION_H_
+
+#include "method_common.h"
+#include "../basic/basic_types.h"
+#include "../math/linear_program_solver.h"
+
+#include <vector>
+#include <cstddef>
+
+
+class Map;
+class PointSet;
+
+
+/**
+* The whole pipeline (as the Example: plane detection if needed, plane refinement, candidate faces,
+* confidences, and face selection) on the data of the memory, for embedding PolyFit in an application
+* without writing and parsing files. The input is a view of the arrays of the caller (copied once into
+* the point set, the labels are not copied), and the result is given as flat buffers.
+*/
+
+class METHOD_API Reconstruction
+{
+public:
+	// a view of the arrays of the caller, which must stay valid during reconstruct()
+	struct Input {
+		Input() : num_points(0), points(nil), normals(nil), labels(nil) {}
+
+		std::size_t  num_points;
+		const float* points;	// x, y, z of each point
+		const float* normals;	// (optional) nx, ny, nz of each point
+		const int*	 labels;	// (optional) the planar segment of each point (negative for none), detected if nil
+	};
+
+	struct Parameters {
+		Parameters()
+			: fitting(0.43), coverage(0.27), complexity(0.3)
+			, solver(LinearProgramSolver::SCIP), time_limit(0.0)
+		{}
+
+		double fitting;		// the weights (see Method::lambda_*)
+		double coverage;
+		double complexity;
+		LinearProgramSolver::SolverName solver;
+		double time_limit;	// of the face selection in seconds (0: Method::selection_time_limit)
+	};
+
+	// the faces of the model are polygons: the vertices of face f are face_indices[face_offsets[f]]
+	// to face_indices[face_offsets[f + 1] - 1] (ordered as in the OBJ files)
+	struct Mesh {
+		std::vector<float>			vertices;		// x, y, z of each vertex
+		std::vector<unsigned int>	face_offsets;	// the number of faces + 1
+		std::vector<unsigned int>	face_indices;
+
+		std::size_t num_vertices() const { return vertices.size() / 3; }
+		std::size_t num_faces() const { return face_offsets.empty() ? 0 : face_offsets.size() - 1; }
+		void clear() { vertices.clear(); face_offsets.clear(); face_indices.clear(); }
+	};
+
+public:
+	// Reconstructs the model of the input into 'result'. The session (if provided) keeps the solver 
+	// of the face selection between the calls (e.g., one per thread, see SolverSession). Returns false
+	// (and logs why) if it fails.
+	// The weights only apply to this call (see ReconstructionContext), so the threads can reconstruct 
+	// with different ones. The number of threads is Method::num_threads (0: the thread budget).
+	static bool reconstruct(const Input& input, const Parameters& params, Mesh& result, SolverSession* session = nil);
+
+	// the point set of the input, with a group (and its fitted plane) per label
+	static PointSet* create_point_set(const Input& input);
+
+	// the flat buffers of a model
+	static void extract_buffers(const Map* mesh, Mesh& result);
+};
+
+
+#endif
@@ -0,0 +1,33 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "reconstruction_context.h"
+#include "method_global.h"
+
+
+ReconstructionContext::ReconstructionContext()
+	: lambda_data_fitting(Method::lambda_data_fitting)
+	, lambda_model_coverage(Method::lambda_model_coverage)
+	, lambda_model_complexity(Method::lambda_model_complexity)
+	, selection_time_limit(Method::selection_time_limit)
+	, num_threads(Method::num_threads)
+	, session(nil)
+{
+}
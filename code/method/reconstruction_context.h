@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _RECONSTRUCTION_CONTEXT_H_
+#define _RECONSTRUCTION_CONTEXT_H_
+
+#include "method_common.h"
+#include "../basic/basic_types.h"
+#include "../basic/parallel.h"
+
+
+class SolverSession;
+
+/**
+* The few settings of one reconstruction that are otherwise read from the options shared by the process:
+* the weights of the objective (Method::lambda_*), the time limit of the face selection, the thread 
+* budget, and the solver session. Only these are isolated, so several reconstructions can run at the same
+* time in one process as long as they differ in nothing else (e.g., the configurations of a sweep of the
+* weights, or the jobs of the batch tool with the same options). It is given to HypothesisGenerator and 
+* FaceSelection (see their set_context()), which read the options without one.
+* NOTE: everything else is shared by the runs: the other options (which must not be changed while a run
+*       is going on), the names of the attributes, the messages (see Logger, interleaved), the progress 
+*       bar (see Progress), and the thread pool. A run can't be cancelled through its context.
+*/
+
+class METHOD_API ReconstructionContext
+{
+public:
+	// the current options
+	ReconstructionContext();
+
+	// the thread budget of the stages of the run (see ScopedThreadBudget): the one of the context, 
+	// or the one of the calling thread if the context has none
+	unsigned int thread_budget() const { return num_threads > 0 ? num_threads : parallel_thread_budget(); }
+
+	double lambda_data_fitting;		// the weights of the terms of the objective (see Method::lambda_*)
+	double lambda_model_coverage;
+	double lambda_model_complexity;
+	double selection_time_limit;	// of the face selection, in seconds (0 for no limit)
+	unsigned int num_threads;		// 0: the thread budget of the calling thread
+	SolverSession* session;			// the environment the face selection solves in (null: none)
+};
+
+
+#endif
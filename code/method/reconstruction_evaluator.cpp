@@ -0,0 +1,183 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "reconstruction_evaluator.h"
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/parallel.h"
+#include "../basic/stop_watch.h"
+#include "../model/point_set.h"
+#include "../model/map.h"
+#include "../model/triangle_tree.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// the points queried together (by a task)
+	const std::size_t num_chunk_points = 4096;
+
+
+	// the metrics of the points[indices] from their squared distances
+	ReconstructionEvaluator::Metrics metrics_of(const unsigned int* indices, std::size_t n, const std::vector<float>& sqr_distances, float threshold) {
+		ReconstructionEvaluator::Metrics m;
+		m.num_points = n;
+		if (n == 0)
+			return m;
+
+		const float sqr_threshold = threshold * threshold;
+		double sum = 0.0, sum_sqr = 0.0, max_sqr = 0.0;
+		std::size_t num_unexplained = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			const double d2 = sqr_distances[indices ? indices[i] : i];
+			sum += std::sqrt(d2);
+			sum_sqr += d2;
+			max_sqr = std::max(max_sqr, d2);
+			num_unexplained += (d2 > sqr_threshold) ? 1 : 0;
+		}
+		m.rms_distance = std::sqrt(sum_sqr / n);
+		m.mean_distance = sum / n;
+		m.hausdorff_distance = std::sqrt(max_sqr);
+		m.unexplained_fraction = double(num_unexplained) / n;
+		return m;
+	}
+
+
+	void metrics_to_json(std::ostream& output, const ReconstructionEvaluator::Metrics& m) {
+		output << "\"points\": " << m.num_points
+			<< ", \"rms_distance\": " << m.rms_distance
+			<< ", \"mean_distance\": " << m.mean_distance
+			<< ", \"hausdorff_distance\": " << m.hausdorff_distance
+			<< ", \"unexplained_fraction\": " << m.unexplained_fraction;
+	}
+
+}
+
+
+ReconstructionEvaluator::Result ReconstructionEvaluator::evaluate(const PointSet* pset, const Map* mesh, const Parameters& params, unsigned int num_threads) {
+	ProfileStage stage("evaluate");
+	StopWatch w;
+	Result result;
+
+	const std::vector<vec3>& points = pset->points();
+	const std::size_t n = points.size();
+
+	// the spacing of the points, and the threshold from it
+	float spacing = params.spacing;
+	if (spacing <= 0.0f && pset->quality_parameters().is_valid())
+		spacing = pset->quality_parameters().average_spacing;
+	float threshold = params.distance_threshold;
+	if (threshold <= 0.0f)
+		threshold = (spacing > 0.0f) ? 3.0f * spacing : 0.005f * 2.0f * static_cast<float>(pset->bbox().radius());
+	result.distance_threshold = threshold;
+
+	TriangleTree tree(mesh);
+	Profiler::add_counter("triangles", double(tree.num_triangles()));
+
+	// the points of each segment are queried together (they are near to each other), then the idle ones
+	std::vector<unsigned int> order;
+	order.reserve(n);
+	std::vector<char> queued(n, 0);
+	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		const VertexGroup* g = groups[i];
+		for (std::size_t j = 0; j < g->size(); ++j) {
+			const unsigned int v = g->at(j);
+			if (!queued[v]) {
+				queued[v] = 1;
+				order.push_back(v);
+			}
+		}
+	}
+	for (unsigned int v = 0; v < n; ++v) {
+		if (!queued[v])
+			order.push_back(v);
+	}
+
+	std::vector<float> sqr_distances(n, 1e30f);
+	std::vector<unsigned int> triangles(n, 0);
+	if (tree.num_triangles() > 0) {
+		const std::size_t num_chunks = (n + num_chunk_points - 1) / num_chunk_points;
+		parallel_for(num_chunks, [&](std::size_t c) {
+			const std::size_t first = c * num_chunk_points;
+			const std::size_t num = std::min(n, first + num_chunk_points) - first;
+			float d2[num_chunk_points];
+			unsigned int t[num_chunk_points];
+			tree.closest(points.data(), &order[first], num, d2, t);
+			for (std::size_t k = 0; k < num; ++k) {
+				sqr_distances[order[first + k]] = d2[k];
+				triangles[order[first + k]] = t[k];
+			}
+		}, nil, num_threads);
+	}
+	else
+		Logger::warn("-") << "the model has no face to evaluate against" << std::endl;
+
+	result.all = metrics_of(nil, n, sqr_distances, threshold);
+	result.segments.resize(groups.size());
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		result.segments[i] = metrics_of(groups[i]->data(), groups[i]->size(), sqr_distances, threshold);
+
+	// the area covered by the explained points on their nearest triangles
+	std::vector<unsigned int> hits(tree.num_triangles(), 0);
+	const float sqr_threshold = threshold * threshold;
+	for (std::size_t v = 0; v < n; ++v) {
+		if (sqr_distances[v] <= sqr_threshold)
+			++hits[triangles[v]];
+	}
+	double area = 0.0, covered = 0.0;
+	for (std::size_t t = 0; t < hits.size(); ++t) {
+		const double a = tree.area(t);
+		area += a;
+		if (hits[t] > 0)
+			covered += (spacing > 0.0f) ? std::min(a, hits[t] * double(spacing) * spacing) : a;
+	}
+	result.coverage_ratio = area > 0.0 ? covered / area : 0.0;
+
+	Profiler::add_counter("rms distance", result.all.rms_distance);
+	Profiler::add_counter("hausdorff distance", result.all.hausdorff_distance);
+	Profiler::add_counter("unexplained fraction", result.all.unexplained_fraction);
+	Profiler::add_counter("coverage ratio", result.coverage_ratio);
+
+	Logger::out("-") << "evaluated " << n << " points against " << tree.num_triangles() << " triangles. rms: " << result.all.rms_distance
+		<< ", hausdorff: " << result.all.hausdorff_distance << ", unexplained: " << result.all.unexplained_fraction * 100.0 << "%"
+		<< ", coverage: " << result.coverage_ratio * 100.0 << "%. " << w.elapsed() << " sec." << std::endl;
+	return result;
+}
+
+
+std::string ReconstructionEvaluator::to_json(const Result& result) {
+	std::ostringstream output;
+	output.precision(9);
+	output << "{";
+	metrics_to_json(output, result.all);
+	output << ", \"coverage_ratio\": " << result.coverage_ratio
+		<< ", \"distance_threshold\": " << result.distance_threshold
+		<< ", \"segments\": [";
+	for (std::size_t i = 0; i < result.segments.size(); ++i) {
+		output << (i > 0 ? ", {" : "{");
+		metrics_to_json(output, result.segments[i]);
+		output << "}";
+	}
+	output << "]}";
+	return output.str();
+}
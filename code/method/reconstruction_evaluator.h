@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _RECONSTRUCTION_EVALUATOR_H_
+#define _RECONSTRUCTION_EVALUATOR_H_
+
+#include "method_common.h"
+
+#include <string>
+#include <vector>
+
+
+class PointSet;
+class Map;
+
+
+/**
+* Measures how well a reconstructed model explains its input points, e.g., for checking every tile of a
+* batch: the distances of the points to the surface (RMS, mean and the one-sided Hausdorff distance, i.e.,
+* the farthest point), the fraction of the points farther than a threshold (the unexplained ones), and the
+* fraction of the area of the model covered by the explained points (each covering a square of the average
+* spacing on its nearest triangle, or the whole triangle if the spacing is unknown). The metrics are given
+* for all the points and for each segment (vertex group) of the point set.
+*
+* The distances come from a bounding volume hierarchy over the triangles of the model (see TriangleTree),
+* queried by the points of each segment in turn (coherent queries) in parallel.
+*/
+
+class METHOD_API ReconstructionEvaluator
+{
+public:
+	struct Parameters {
+		Parameters() : distance_threshold(0.0f), spacing(0.0f) {}
+
+		// beyond which a point is unexplained (0 for 3 times the spacing)
+		float distance_threshold;
+		// the average spacing of the points (0 for the one of their planar qualities, or unknown)
+		float spacing;
+	};
+
+	struct Metrics {
+		Metrics() : num_points(0), rms_distance(0), mean_distance(0), hausdorff_distance(0), unexplained_fraction(0) {}
+
+		std::size_t num_points;
+		double		rms_distance;
+		double		mean_distance;
+		double		hausdorff_distance;
+		double		unexplained_fraction;
+	};
+
+	struct Result {
+		Result() : coverage_ratio(0), distance_threshold(0) {}
+
+		Metrics					all;
+		std::vector<Metrics>	segments;		// of the vertex groups, in their order
+		double					coverage_ratio;
+		double					distance_threshold;	// used
+	};
+
+	// The metrics are also added to the counters of the current profiling stage (see Profiler).
+	static Result evaluate(const PointSet* pset, const Map* mesh, const Parameters& params = Parameters(), unsigned int num_threads = 0);
+
+	// e.g., for the metrics of a batch: {"rms_distance": ..., "segments": [{...}, ...]}
+	static std::string to_json(const Result& result);
+};
+
+
+#endif
@@ -0,0 +1,143 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "segment_footprint.h"
+#include "segment_projection.h"
+#include "method_global.h"
+#include "alpha_shape.h"
+#include "../basic/parallel.h"
+#include "../model/vertex_group.h"
+#include "../model/point_set.h"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+
+
+namespace {
+
+	inline double cross(const vec2& o, const vec2& a, const vec2& b) {
+		return (double(a.x) - o.x) * (double(b.y) - o.y) - (double(a.y) - o.y) * (double(b.x) - o.x);
+	}
+
+	// Andrew's monotone chain: the convex hull of the points (counterclockwise, without collinear points)
+	void convex_hull(std::vector<vec2> points, std::vector<vec2>& hull) {
+		hull.clear();
+		std::sort(points.begin(), points.end(), [](const vec2& a, const vec2& b) {
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		});
+		points.erase(std::unique(points.begin(), points.end(), [](const vec2& a, const vec2& b) {
+			return a.x == b.x && a.y == b.y;
+		}), points.end());
+		if (points.size() < 3) {
+			hull = points;
+			return;
+		}
+
+		hull.resize(2 * points.size());
+		std::size_t k = 0;
+		for (std::size_t i = 0; i < points.size(); ++i) {	// the lower part
+			while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+				--k;
+			hull[k++] = points[i];
+		}
+		for (std::size_t i = points.size() - 1, t = k + 1; i > 0; --i) {	// the upper part
+			while (k >= t && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0)
+				--k;
+			hull[k++] = points[i - 1];
+		}
+		hull.resize(k - 1);	// the last point is the first one
+	}
+
+	double area(const std::vector<vec2>& polygon) {
+		double result = 0.0;
+		for (std::size_t i = 0; i < polygon.size(); ++i) {
+			const vec2& p = polygon[i];
+			const vec2& q = polygon[(i + 1) % polygon.size()];
+			result += double(p.x) * q.y - double(q.x) * p.y;
+		}
+		return std::fabs(result) * 0.5;
+	}
+}
+
+
+void SegmentFootprint::compute(VertexGroup* g, float radius) {
+	g->invalidate_footprint();
+	const PointSet* pset = g->point_set();
+	if (!pset)
+		return;
+
+	VertexGroup::Footprint& fp = g->footprint();
+	const Plane3d& plane = g->plane();
+	const std::vector<vec3>& points = pset->points();
+	if (const VertexGroup::Projection* projection = SegmentProjection::of(g))
+		fp.points = projection->points;
+	else {
+		fp.points.resize(g->size());
+		for (std::size_t i = 0; i < g->size(); ++i)
+			fp.points[i] = plane.to_2d(points[g->at(i)]);
+	}
+
+	convex_hull(fp.points, fp.hull);
+	fp.area = area(fp.hull);
+
+	if (radius > 0) {
+		fp.radius = radius;
+		fp.area = 0.0;
+		if (fp.points.size() >= 3) {
+			std::list<Point2> pts;
+			for (std::size_t i = 0; i < fp.points.size(); ++i)
+				pts.push_back(to_cgal_point(fp.points[i]));
+
+			AlphaShape& as = AlphaShape::thread_instance();
+			as.build(pts.begin(), pts.end());
+			as.set_alpha(radius * radius);
+			for (AlphaShape::Finite_faces_iterator fit = as.finite_faces_begin(); fit != as.finite_faces_end(); ++fit) {
+				if (as.classify(fit) == AlphaShape::INTERIOR) {
+					for (int i = 0; i < 3; ++i)
+						fp.alpha_triangles.push_back(to_my_point(fit->vertex(i)->point()));
+					const vec2* tri = &fp.alpha_triangles[fp.alpha_triangles.size() - 3];
+					fp.area += std::fabs(cross(tri[0], tri[1], tri[2])) * 0.5;
+				}
+			}
+		}
+	}
+
+	fp.valid = true;
+}
+
+
+bool SegmentFootprint::is_up_to_date(const VertexGroup* g, float radius) {
+	const VertexGroup::Footprint& fp = g->footprint();
+	return fp.valid && (radius <= 0 || fp.radius == radius);
+}
+
+
+void SegmentFootprint::update(const std::vector<VertexGroup*>& groups, float radius) {
+	std::vector<VertexGroup*> outdated;
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		if (!is_up_to_date(groups[i], radius))
+			outdated.push_back(groups[i]);
+	}
+
+	parallel_for(outdated.size(), [&](std::size_t i) {
+		compute(outdated[i], radius);
+	}, nil, Method::num_threads);
+}
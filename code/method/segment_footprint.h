@@ -0,0 +1,48 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _SEGMENT_FOOTPRINT_H_
+#define _SEGMENT_FOOTPRINT_H_
+
+#include "method_common.h"
+
+#include <vector>
+
+
+class VertexGroup;
+
+// Computes the footprints of the segments (see VertexGroup::Footprint), which are kept with the
+// segments so that the stages working in the 2D frames of the planes share them (e.g., the 
+// coverages of the candidate faces, and the outlines of the highlighted segments in the viewer).
+class METHOD_API SegmentFootprint
+{
+public:
+	// computes the footprint of the group (replacing the existing one), with the alpha shape of 
+	// the given radius if radius > 0
+	static void compute(VertexGroup* g, float radius);
+
+	// true if the footprint of the group is valid and has the alpha shape of the given radius (if > 0)
+	static bool is_up_to_date(const VertexGroup* g, float radius);
+
+	// computes in parallel the footprints of the groups that are not up to date
+	static void update(const std::vector<VertexGroup*>& groups, float radius);
+};
+
+#endif
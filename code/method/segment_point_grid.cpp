@@ -0,0 +1,181 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "segment_point_grid.h"
+#include "segment_projection.h"
+#include "../math/polygon2d.h"
+#include "../model/vertex_group.h"
+#include "../model/point_set.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+	// the average number of points in a cell
+	const double points_per_cell = 4.0;
+	// the maximum number of cells along each axis
+	const double max_resolution = 4096.0;
+
+	// test if the segment [p, q] intersects the rectangle [x0, x1] x [y0, y1] (Liang-Barsky clipping)
+	bool segment_intersects_rectangle(const vec2& p, const vec2& q, double x0, double y0, double x1, double y1) {
+		double t0 = 0.0, t1 = 1.0;
+		double dx = double(q.x) - p.x;
+		double dy = double(q.y) - p.y;
+		double pp[4] = { -dx, dx, -dy, dy };
+		double qq[4] = { p.x - x0, x1 - p.x, p.y - y0, y1 - p.y };
+		for (int i = 0; i < 4; ++i) {
+			if (pp[i] == 0) {
+				if (qq[i] < 0)
+					return false;	// parallel to this side and outside
+			}
+			else {
+				double t = qq[i] / pp[i];
+				if (pp[i] < 0)
+					t0 = std::max(t0, t);
+				else
+					t1 = std::min(t1, t);
+				if (t0 > t1)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+
+void SegmentPointGrid::build(const VertexGroup* g) {
+	projections_.clear();
+	cell_start_.clear();
+	entries_.clear();
+	nx_ = ny_ = 0;
+
+	const PointSet* pset = g->point_set();
+	if (!pset || g->empty())
+		return;
+
+	const Plane3d& plane = g->plane();
+	const vec3& orig = plane.point();
+	const vec3& base1 = plane.base1();
+	const vec3& base2 = plane.base2();
+
+	// the same projection as in HypothesisGenerator::facet_points_projected_in() (the one kept with
+	// the segment, if any)
+	if (const VertexGroup::Projection* projection = SegmentProjection::of(g))
+		projections_ = projection->points;
+	else {
+		const std::vector<vec3>& points = pset->points();
+		projections_.resize(g->size());
+		for (std::size_t i = 0; i < g->size(); ++i)
+			projections_[i] = Geom::to_2d(orig, base1, base2, points[g->at(i)]);
+	}
+	Box2d box;
+	for (std::size_t i = 0; i < projections_.size(); ++i)
+		box.add_point(projections_[i]);
+
+	double w = double(box.x_max()) - box.x_min();
+	double h = double(box.y_max()) - box.y_min();
+	double extent = std::max(w, h);
+	if (extent <= 0)
+		cell_size_ = 1.0;
+	else
+		cell_size_ = std::max(std::sqrt(w * h * points_per_cell / projections_.size()), extent / max_resolution);
+
+	origin_ = vec2(box.x_min(), box.y_min());
+	nx_ = static_cast<int>(w / cell_size_) + 1;
+	ny_ = static_cast<int>(h / cell_size_) + 1;
+
+	// counting sort of the points into the cells (which keeps them in increasing positions in each cell)
+	std::vector<unsigned int> cells(projections_.size());
+	cell_start_.assign(std::size_t(nx_) * ny_ + 1, 0);
+	for (std::size_t i = 0; i < projections_.size(); ++i) {
+		int ix = std::min(static_cast<int>((projections_[i].x - origin_.x) / cell_size_), nx_ - 1);
+		int iy = std::min(static_cast<int>((projections_[i].y - origin_.y) / cell_size_), ny_ - 1);
+		cells[i] = static_cast<unsigned int>(iy * nx_ + ix);
+		++cell_start_[cells[i] + 1];
+	}
+	for (std::size_t c = 1; c < cell_start_.size(); ++c)
+		cell_start_[c] += cell_start_[c - 1];
+
+	entries_.resize(projections_.size());
+	std::vector<unsigned int> next(cell_start_.begin(), cell_start_.end() - 1);
+	for (std::size_t i = 0; i < projections_.size(); ++i)
+		entries_[next[cells[i]]++] = static_cast<unsigned int>(i);
+}
+
+
+void SegmentPointGrid::points_in_polygon(const Polygon2d& plg, std::vector<unsigned int>& positions) const {
+	positions.clear();
+	if (projections_.empty() || plg.size() < 3)
+		return;
+
+	Box2d box;
+	for (std::size_t i = 0; i < plg.size(); ++i)
+		box.add_point(plg[i]);
+
+	int x_min = static_cast<int>(std::floor((box.x_min() - origin_.x) / cell_size_));
+	int y_min = static_cast<int>(std::floor((box.y_min() - origin_.y) / cell_size_));
+	int x_max = static_cast<int>(std::floor((box.x_max() - origin_.x) / cell_size_));
+	int y_max = static_cast<int>(std::floor((box.y_max() - origin_.y) / cell_size_));
+	x_min = std::max(x_min, 0);		y_min = std::max(y_min, 0);
+	x_max = std::min(x_max, nx_ - 1);	y_max = std::min(y_max, ny_ - 1);
+
+	// the cells are slightly enlarged, so the points near a cell border (up to the rounding 
+	// done when sorting them into the cells) can't escape the classification of their cell
+	double margin = cell_size_ * 1e-3;
+	Geom::PolygonClassifier classifier(plg);
+	std::vector<Numeric::uint8> inside;
+	for (int iy = y_min; iy <= y_max; ++iy) {
+		for (int ix = x_min; ix <= x_max; ++ix) {
+			unsigned int c = static_cast<unsigned int>(iy * nx_ + ix);
+			unsigned int begin = cell_start_[c], end = cell_start_[c + 1];
+			if (begin == end)
+				continue;
+
+			double x0 = origin_.x + ix * cell_size_ - margin;
+			double y0 = origin_.y + iy * cell_size_ - margin;
+			double x1 = origin_.x + (ix + 1) * cell_size_ + margin;
+			double y1 = origin_.y + (iy + 1) * cell_size_ + margin;
+
+			bool on_border = false;
+			for (std::size_t i = 0, j = plg.size() - 1; i < plg.size(); j = i, ++i) {
+				if (segment_intersects_rectangle(plg[j], plg[i], x0, y0, x1, y1)) {
+					on_border = true;
+					break;
+				}
+			}
+
+			if (on_border) {
+				inside.resize(end - begin);
+				classifier.classify(projections_.data(), entries_.data() + begin, end - begin, inside.data());
+				for (unsigned int k = begin; k < end; ++k) {
+					if (inside[k - begin])
+						positions.push_back(entries_[k]);
+				}
+			}
+			else if (classifier.contains(projections_[entries_[begin]])) {
+				// the boundary doesn't cross the cell: all its points are inside
+				positions.insert(positions.end(), entries_.begin() + begin, entries_.begin() + end);
+			}
+		}
+	}
+
+	std::sort(positions.begin(), positions.end());
+}
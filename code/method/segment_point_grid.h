@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _SEGMENT_POINT_GRID_H_
+#define _SEGMENT_POINT_GRID_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+class VertexGroup;
+
+// A uniform 2D grid of the points of a segment (i.e., a VertexGroup), projected onto 
+// its supporting plane in the plane's base1/base2 frame. It finds the points projected
+// inside a polygon on that plane by only visiting the cells overlapping the polygon. 
+// The cells that are entirely inside (or outside) the polygon are accepted (or rejected)
+// as a whole, and only the points in the cells crossed by the polygon boundary are tested.
+class METHOD_API SegmentPointGrid
+{
+public:
+	SegmentPointGrid() : cell_size_(1.0), nx_(0), ny_(0) {}
+
+	void build(const VertexGroup* g);
+
+	// collects the positions (in the vertex group, in increasing order) of the points whose 
+	// projections are inside the polygon 'plg' (given in the same frame as the projection).
+	void points_in_polygon(const Polygon2d& plg, std::vector<unsigned int>& positions) const;
+
+private:
+	vec2						origin_;		// the lower corner of the grid
+	double						cell_size_;
+	int							nx_, ny_;
+	std::vector<vec2>			projections_;	// the projected points, indexed by position
+	std::vector<unsigned int>	cell_start_;	// the points of cell c are entries_[cell_start_[c], cell_start_[c+1])
+	std::vector<unsigned int>	entries_;
+};
+
+#endif
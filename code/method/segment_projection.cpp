@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "segment_projection.h"
+#include "method_global.h"
+#include "../basic/parallel.h"
+#include "../model/point_set.h"
+
+
+void SegmentProjection::compute(VertexGroup* g) {
+	g->invalidate_projection();
+	const PointSet* pset = g->point_set();
+	if (!pset)
+		return;
+
+	VertexGroup::Projection& proj = g->projection();
+	const Plane3d& plane = g->plane();
+	const vec3& orig = plane.point();
+	const vec3& base1 = plane.base1();
+	const vec3& base2 = plane.base2();
+	const std::vector<vec3>& points = pset->points();
+	proj.points.resize(g->size());
+	for (std::size_t i = 0; i < g->size(); ++i)
+		proj.points[i] = Geom::to_2d(orig, base1, base2, points[g->at(i)]);
+
+	// the distances in one batch
+	proj.distances.resize(g->size());
+	if (const float* padded = pset->padded_points())
+		plane.signed_distances_padded(padded, g->data(), g->size(), proj.distances.data());
+	else
+		plane.signed_distances(points.data(), g->data(), g->size(), proj.distances.data());
+
+	proj.valid = true;
+}
+
+
+void SegmentProjection::update(const std::vector<VertexGroup*>& groups) {
+	std::vector<VertexGroup*> outdated;
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		if (groups[i] && !groups[i]->has_projection())
+			outdated.push_back(groups[i]);
+	}
+
+	parallel_for(outdated.size(), [&](std::size_t i) {
+		compute(outdated[i]);
+	}, nil, Method::num_threads);
+}
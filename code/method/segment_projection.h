@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _SEGMENT_PROJECTION_H_
+#define _SEGMENT_PROJECTION_H_
+
+#include "method_common.h"
+#include "../model/vertex_group.h"
+
+#include <vector>
+
+
+// Computes the projections of the segments (see VertexGroup::Projection), which are kept with the
+// segments so that the stages working in the 2D frames of the planes (e.g., the point counting and
+// the coverages of the candidate faces, the grids of the points, and the footprints) don't project
+// the points again. A projection is invalidated when the plane of its segment is refit (e.g., after 
+// a merge), and recomputed by the next update().
+class METHOD_API SegmentProjection
+{
+public:
+	// computes the projection of the group (replacing the existing one)
+	static void compute(VertexGroup* g);
+
+	// the projection of the group, or null if it is not up to date
+	static const VertexGroup::Projection* of(const VertexGroup* g) {
+		return g->has_projection() ? &g->projection() : nil;
+	}
+
+	// computes in parallel the projections of the groups that are not up to date
+	static void update(const std::vector<VertexGroup*>& groups);
+};
+
+#endif
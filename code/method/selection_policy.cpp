@@ -0,0 +1,191 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "selection_policy.h"
+#include "method_global.h"
+#include "../math/solver_policy.h"
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+
+namespace {
+
+	// the problems with fewer variables are solved as they are, in one thread: the reductions and the
+	// threads cost more than they save
+	const std::size_t	small_problem = 1000;
+	const double		small_time = 0.1;	// in seconds
+
+	// a heuristic is used if the exact solve is predicted to take this many times the time limit
+	const double		heuristic_factor = 4.0;
+
+
+	// calibrates the models of the backends once per file given by the options
+	void calibrate_solvers() {
+		static std::mutex mutex;
+		static std::string calibrated;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (Method::selection_policy_calibration.empty() || Method::selection_policy_calibration == calibrated)
+			return;
+		calibrated = Method::selection_policy_calibration;
+		SolverPolicy::calibrate(calibrated);
+	}
+
+}
+
+
+const char* SelectionPolicy::engine_name(Engine engine) {
+	switch (engine) {
+	case EXACT:			return "exact";
+	case APPROXIMATE:	return "LP rounding";
+	case LAGRANGIAN:	return "Lagrangian relaxation";
+	default:			return "graph cut";
+	}
+}
+
+
+SelectionPolicy::Decision SelectionPolicy::options(LinearProgramSolver::SolverName solver) {
+	Decision decision;
+	decision.solver = solver;
+	decision.contract = Method::contract_fans;
+	decision.presolve = Method::presolve_face_selection;
+	decision.decompose = Method::decompose_face_selection;
+	decision.parallel = Method::parallel_face_selection;
+	if (Method::graph_cut_selection)
+		decision.engine = GRAPH_CUT;
+	else if (Method::lagrangian_face_selection)
+		decision.engine = LAGRANGIAN;
+	else if (Method::approximate_face_selection)
+		decision.engine = APPROXIMATE;
+	decision.neighborhood_search = Method::neighborhood_search;
+	return decision;
+}
+
+
+double SelectionPolicy::predicted_time(const Statistics& statistics, LinearProgramSolver::SolverName solver, bool decompose, bool parallel) {
+	const unsigned int threads = std::max(statistics.num_threads, 1u);
+	if (!decompose || statistics.component_variables.size() <= 1)
+		return SolverPolicy::predicted_time(solver, statistics.num_variables, true, threads);
+
+	// the components one after another with all the threads, or concurrently with one thread each
+	double total = 0.0, longest = 0.0;
+	for (std::size_t i = 0; i < statistics.component_variables.size(); ++i) {
+		double t = SolverPolicy::predicted_time(solver, statistics.component_variables[i], true, parallel ? 1 : threads);
+		if (t < 0.0)
+			return -1.0;
+		total += t;
+		longest = std::max(longest, t);
+	}
+	return parallel ? std::max(total / threads, longest) : total;
+}
+
+
+SelectionPolicy::Decision SelectionPolicy::decide(const Statistics& statistics, LinearProgramSolver::SolverName solver) {
+	calibrate_solvers();
+
+	Decision decision;
+	const std::vector<std::size_t>& sizes = statistics.fan_sizes;
+	const bool small = statistics.num_variables < small_problem;
+
+	// the reductions give the same result: the presolve fixes the faces of the fans of less than four
+	// faces, and the contraction merges the pairs of faces that fans of two faces tie together
+	decision.presolve = !small;
+	decision.contract = !small && sizes.size() > 2 && sizes[2] > 0;
+	decision.decompose = statistics.component_variables.size() > 1;
+
+	// the backend, for the largest program it is given
+	const std::size_t largest = decision.decompose ? statistics.component_variables.front() : statistics.num_variables;
+	const unsigned int threads = std::max(statistics.num_threads, 1u);
+	decision.solver = solver;
+	if (solver == LinearProgramSolver::AUTO || solver == LinearProgramSolver::PORTFOLIO)
+		decision.solver = SolverPolicy::choose(largest, true, threads);
+	else if ((solver == LinearProgramSolver::GLPK || solver == LinearProgramSolver::LPSOLVE) && SolverPolicy::predicted_time(solver, largest, true, threads) < 0.0) {
+		decision.solver = SolverPolicy::choose(largest, true, threads);
+		Logger::warn("-") << SolverPolicy::solver_name(solver) << " stalls on " << largest << " variables, using "
+			<< SolverPolicy::solver_name(decision.solver) << " instead" << std::endl;
+	}
+
+	// GLPK keeps its environment in global variables, and all the Gurobi models share one environment
+	decision.parallel = decision.decompose && threads > 1 &&
+		(decision.solver == LinearProgramSolver::SCIP || decision.solver == LinearProgramSolver::LPSOLVE);
+	decision.predicted_time = predicted_time(statistics, decision.solver, decision.decompose, decision.parallel);
+	if (decision.parallel) {
+		// the components one after another may use the threads better (e.g., one large component)
+		double sequential = predicted_time(statistics, decision.solver, true, false);
+		if (sequential >= 0.0 && sequential < decision.predicted_time) {
+			decision.parallel = false;
+			decision.predicted_time = sequential;
+		}
+	}
+
+	decision.num_threads = threads;
+	if (!decision.parallel && decision.predicted_time >= 0.0 && decision.predicted_time < small_time)
+		decision.num_threads = 1;
+
+	// the engine: a heuristic (improved by the neighborhood search) if the exact solve is hopeless
+	// within the time limit, and the neighborhood search after an exact solve that may hit it
+	const double limit = statistics.time_limit;
+	if (limit > 0.0 && decision.predicted_time > heuristic_factor * limit) {
+		decision.engine = (threads > 1) ? LAGRANGIAN : APPROXIMATE;	// the subproblems of the former are solved in parallel
+		decision.neighborhood_search = true;
+	}
+	else {
+		decision.engine = EXACT;
+		decision.neighborhood_search = limit > 0.0 && decision.predicted_time > limit;
+	}
+	return decision;
+}
+
+
+void SelectionPolicy::record(const Decision& decision, const Statistics& statistics) {
+	std::size_t small_fans = 0;
+	for (std::size_t i = 0; i < std::min<std::size_t>(statistics.fan_sizes.size(), 4); ++i)
+		small_fans += statistics.fan_sizes[i];
+	Logger::out("-") << "selection policy: " << statistics.num_variables << " variables, " << statistics.num_constraints 
+		<< " constraints, " << statistics.component_variables.size() << " components, " << small_fans 
+		<< " fans of less than four faces" << std::endl;
+
+	Logger::out(" ") << "    - " << engine_name(decision.engine) << " with " << SolverPolicy::solver_name(decision.solver) 
+		<< ", " << decision.num_threads << " threads" << std::endl;
+	Logger::out(" ") << "    - contraction: " << (decision.contract ? "yes" : "no") << ", presolve: " << (decision.presolve ? "yes" : "no")
+		<< ", decomposition: " << (decision.decompose ? (decision.parallel ? "parallel" : "yes") : "no") 
+		<< ", neighborhood search: " << (decision.neighborhood_search ? "yes" : "no") << std::endl;
+	if (decision.predicted_time >= 0.0)
+		Logger::out(" ") << "    - exact solve predicted: " << decision.predicted_time << " sec" << std::endl;
+
+	Profiler::add_counter(std::string("policy solver ") + SolverPolicy::solver_name(decision.solver), 1.0);
+	Profiler::add_counter("policy engine", double(decision.engine));
+	Profiler::add_counter("policy threads", double(decision.num_threads));
+	Profiler::add_counter("policy contraction", decision.contract ? 1.0 : 0.0);
+	Profiler::add_counter("policy presolve", decision.presolve ? 1.0 : 0.0);
+	Profiler::add_counter("policy decomposition", decision.decompose ? 1.0 : 0.0);
+	Profiler::add_counter("policy parallel components", decision.parallel ? 1.0 : 0.0);
+	Profiler::add_counter("policy neighborhood search", decision.neighborhood_search ? 1.0 : 0.0);
+	Profiler::add_counter("policy predicted time", decision.predicted_time);
+	for (std::size_t i = 0; i < statistics.fan_sizes.size(); ++i) {
+		if (statistics.fan_sizes[i] > 0)
+			Profiler::add_counter("policy fans of " + std::to_string(i) + " faces", double(statistics.fan_sizes[i]));
+	}
+	Profiler::add_counter("policy components", double(statistics.component_variables.size()));
+	Profiler::add_counter("policy largest component", statistics.component_variables.empty() ? 0.0 : double(statistics.component_variables.front()));
+}
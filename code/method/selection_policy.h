@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _SELECTION_POLICY_H_
+#define _SELECTION_POLICY_H_
+
+#include "method_common.h"
+#include "../math/linear_program_solver.h"
+
+#include <string>
+#include <vector>
+
+
+/**
+* Picks how the face selection problem is solved (see Method::automatic_selection_policy) from its 
+* statistics, measured once it is formulated, and the time limit: the backend (see SolverPolicy, 
+* which predicts the time of each backend), the threads, the contraction, the presolve, the 
+* decomposition (and whether its components are solved in parallel), and the engine, i.e., the 
+* exact binary program, or a heuristic if the exact solve is predicted to take much longer than the
+* time limit (then followed by the neighborhood search). The graph cut is never picked, as it 
+* approximates the complexity term.
+*
+* The decisions are logged, and recorded as counters of the profiling stage "policy" (see Profiler).
+* The models of the backends are calibrated by the report of the Benchmark tool given by
+* Method::selection_policy_calibration.
+*/
+
+class METHOD_API SelectionPolicy
+{
+public:
+	enum Engine { EXACT, APPROXIMATE, LAGRANGIAN, GRAPH_CUT };
+
+	static const char* engine_name(Engine engine);
+
+	struct Statistics {
+		Statistics() : num_faces(0), num_variables(0), num_constraints(0), time_limit(0.0), num_threads(1) {}
+
+		std::size_t	num_faces;
+		std::size_t	num_variables;
+		std::size_t	num_constraints;
+		std::vector<std::size_t> fan_sizes;				// the number of the super edges of each size
+		std::vector<std::size_t> component_variables;	// of each component (in decreasing order)
+		double		time_limit;		// in seconds (0 for no limit)
+		unsigned int num_threads;	// the thread budget of the selection
+	};
+
+	struct Decision {
+		Decision() : solver(LinearProgramSolver::SCIP), num_threads(0), contract(false), presolve(false), decompose(false)
+			, parallel(false), engine(EXACT), neighborhood_search(false), predicted_time(-1.0) {}
+
+		LinearProgramSolver::SolverName solver;
+		unsigned int	num_threads;	// the thread budget of the solve (0 for the one of the caller)
+		bool			contract;		// see Method::contract_fans
+		bool			presolve;		// see Method::presolve_face_selection
+		bool			decompose;		// see Method::decompose_face_selection
+		bool			parallel;		// see Method::parallel_face_selection
+		Engine			engine;
+		bool			neighborhood_search;
+		double			predicted_time;	// of the exact solve, in seconds (negative if unknown)
+	};
+
+public:
+	// the decision of the Method options (i.e., as set by the user), with the given solver
+	static Decision options(LinearProgramSolver::SolverName solver);
+
+	// Decides for the problem of 'statistics'. A solver other than AUTO is kept, unless it is GLPK or 
+	// LPSOLVE and the problem (or its largest component) is beyond the size they stall at.
+	static Decision decide(const Statistics& statistics, LinearProgramSolver::SolverName solver);
+
+	// logs the decision and records it in the current profiling stage
+	static void record(const Decision& decision, const Statistics& statistics);
+
+private:
+	// the predicted time of the exact solve of the components with 'solver' (negative if unknown)
+	static double predicted_time(const Statistics& statistics, LinearProgramSolver::SolverName solver, bool decompose, bool parallel);
+};
+
+
+#endif
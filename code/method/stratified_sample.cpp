@@ -0,0 +1,161 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "stratified_sample.h"
+#include "segment_projection.h"
+#include "../model/point_set.h"
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+
+namespace {
+	// the average number of sampled points in a stratum
+	const double samples_per_stratum = 8.0;
+	// the maximum number of strata along each axis
+	const double max_resolution = 256.0;
+}
+
+
+void StratifiedSample::build(const VertexGroup* g, std::size_t size, unsigned int seed) {
+	sample_ = new VertexGroup(const_cast<PointSet*>(g->point_set()));
+	sample_->set_plane(g->plane());
+	num_points_ = g->size();
+	strata_.clear();
+	stratum_of_.clear();
+
+	const PointSet* pset = g->point_set();
+	if (!pset || g->empty())
+		return;
+	if (g->size() <= size) {
+		sample_->assign(g->begin(), g->end());
+		strata_.resize(1);
+		strata_[0].num_points = strata_[0].num_samples = static_cast<unsigned int>(g->size());
+		for (std::size_t i = 0; i < g->size(); ++i)
+			stratum_of_[g->at(i)] = 0;
+		return;
+	}
+
+	const Plane3d& plane = g->plane();
+	const vec3& orig = plane.point();
+	const vec3& base1 = plane.base1();
+	const vec3& base2 = plane.base2();
+	const std::vector<vec3>& points = pset->points();
+
+	// the projection kept with the segment, if any (see SegmentProjection)
+	const VertexGroup::Projection* projection = SegmentProjection::of(g);
+	std::vector<vec2> computed;
+	if (!projection) {
+		computed.resize(g->size());
+		for (std::size_t i = 0; i < g->size(); ++i)
+			computed[i] = Geom::to_2d(orig, base1, base2, points[g->at(i)]);
+	}
+	const std::vector<vec2>& projections = projection ? projection->points : computed;
+	Box2d box;
+	for (std::size_t i = 0; i < projections.size(); ++i)
+		box.add_point(projections[i]);
+
+	double w = double(box.x_max()) - box.x_min();
+	double h = double(box.y_max()) - box.y_min();
+	double extent = std::max(w, h);
+	double cell_size = 1.0;
+	if (extent > 0)
+		cell_size = std::max(std::sqrt(w * h * samples_per_stratum / size), extent / max_resolution);
+	int nx = static_cast<int>(w / cell_size) + 1;
+	int ny = static_cast<int>(h / cell_size) + 1;
+
+	// the points of each cell (counting sort, keeping the order of the group in each cell)
+	std::vector<unsigned int> cells(g->size());
+	std::vector<unsigned int> cell_start(std::size_t(nx) * ny + 1, 0);
+	for (std::size_t i = 0; i < g->size(); ++i) {
+		int ix = std::min(static_cast<int>((projections[i].x - box.x_min()) / cell_size), nx - 1);
+		int iy = std::min(static_cast<int>((projections[i].y - box.y_min()) / cell_size), ny - 1);
+		cells[i] = static_cast<unsigned int>(iy * nx + ix);
+		++cell_start[cells[i] + 1];
+	}
+	for (std::size_t c = 1; c < cell_start.size(); ++c)
+		cell_start[c] += cell_start[c - 1];
+	std::vector<unsigned int> entries(g->size());
+	{
+		std::vector<unsigned int> next(cell_start.begin(), cell_start.end() - 1);
+		for (std::size_t i = 0; i < g->size(); ++i)
+			entries[next[cells[i]]++] = g->at(i);
+	}
+
+	// a partial shuffle of each nonempty cell (the generator is used directly, its sequence being the
+	// same on all platforms, unlike the distributions of the standard library)
+	std::mt19937 rng(seed);
+	const double fraction = double(size) / g->size();
+	for (std::size_t c = 0; c + 1 < cell_start.size(); ++c) {
+		unsigned int begin = cell_start[c], n = cell_start[c + 1] - cell_start[c];
+		if (n == 0)
+			continue;
+		unsigned int m = static_cast<unsigned int>(n * fraction + 0.5);
+		m = std::min(n, std::max(m, 2u));
+		for (unsigned int j = 0; j < m; ++j)
+			std::swap(entries[begin + j], entries[begin + j + rng() % (n - j)]);
+
+		Stratum s;
+		s.num_points = n;
+		s.num_samples = m;
+		for (unsigned int j = 0; j < m; ++j) {
+			sample_->push_back(entries[begin + j]);
+			stratum_of_[entries[begin + j]] = static_cast<unsigned int>(strata_.size());
+		}
+		strata_.push_back(s);
+	}
+}
+
+
+double StratifiedSample::scale() const {
+	if (sample_.is_nil() || sample_->empty())
+		return 1.0;
+	return double(num_points_) / sample_->size();
+}
+
+
+double StratifiedSample::total(const std::vector<unsigned int>& points, const std::vector<double>& values, double& variance) const {
+	// the sum and the sum of the squares of the values in each stratum met
+	std::unordered_map<unsigned int, std::pair<double, double> > sums;
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		std::unordered_map<unsigned int, unsigned int>::const_iterator pos = stratum_of_.find(points[i]);
+		if (pos == stratum_of_.end())
+			continue;
+		std::pair<double, double>& s = sums[pos->second];
+		s.first += values[i];
+		s.second += values[i] * values[i];
+	}
+
+	double result = 0.0;
+	variance = 0.0;
+	std::unordered_map<unsigned int, std::pair<double, double> >::const_iterator it = sums.begin();
+	for (; it != sums.end(); ++it) {
+		const Stratum& s = strata_[it->first];
+		double N = s.num_points, m = s.num_samples;
+		result += N / m * it->second.first;
+		if (s.num_samples > 1 && s.num_samples < s.num_points) {
+			// the sample variance of the values in the stratum (the points without value count 0)
+			double var = (it->second.second - it->second.first * it->second.first / m) / (m - 1);
+			variance += N * N * (1.0 - m / N) * std::max(var, 0.0) / m;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _STRATIFIED_SAMPLE_H_
+#define _STRATIFIED_SAMPLE_H_
+
+#include "method_common.h"
+#include "../model/vertex_group.h"
+
+#include <vector>
+#include <unordered_map>
+
+
+// A stratified random subsample of the points of a segment (i.e., a VertexGroup), for estimating the 
+// confidences of its candidate faces from a bounded number of points (see Method::sampled_confidences).
+// The strata are the cells of a uniform 2D grid over the points projected onto the plane of the segment,
+// and each stratum contributes a share of the sample proportional to its number of points (at least two
+// points, or all of them). The totals over a face are estimated by weighting each sampled point by the
+// inverse of the sampling fraction of its stratum, which also gives the variance of the estimates.
+class METHOD_API StratifiedSample
+{
+public:
+	StratifiedSample() : num_points_(0) {}
+
+	// draws about 'size' points of 'g', the random generator being seeded by 'seed' (so the sample 
+	// only depends on the points, the plane and the seed)
+	void build(const VertexGroup* g, std::size_t size, unsigned int seed);
+
+	// the sampled points, with the point set and the plane of the segment
+	const VertexGroup* group() const { return sample_; }
+
+	// the number of points of the segment per sampled point
+	double scale() const;
+
+	// the estimated total of the values[i] of the sampled points[i] (given by their indices in the point 
+	// set, the other sampled points having no value) over all the points of the segment, and its variance
+	double total(const std::vector<unsigned int>& points, const std::vector<double>& values, double& variance) const;
+
+private:
+	struct Stratum {
+		unsigned int	num_points;		// of the segment
+		unsigned int	num_samples;
+	};
+
+	VertexGroup::Ptr	sample_;
+	std::size_t			num_points_;
+	std::vector<Stratum>	strata_;
+	std::unordered_map<unsigned int, unsigned int>	stratum_of_;	// of each sampled point
+};
+
+#endif
@@ -0,0 +1,457 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "tiled_reconstruction.h"
+#include "method_global.h"
+#include "hypothesis_generator.h"
+#include "face_selection.h"
+#include "reconstruction_context.h"
+#include "../basic/logger.h"
+#include "../basic/parallel.h"
+#include "../model/map.h"
+#include "../model/map_builder.h"
+#include "../model/plane_detector.h"
+#include "../model/point_set_roi_index.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+
+
+namespace {
+
+	// the grid of the tiles on the ground
+	struct TileGrid {
+		float x_min, y_min;
+		float width_x, width_y;	// of a tile
+		int   num_x, num_y;
+		float overlap;
+	};
+
+	inline bool same(const vec3& a, const vec3& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+
+	// Clips a convex polygon by the half-space of the points whose 'axis' coordinate is on the 'positive'
+	// side of 'value' (Sutherland-Hodgman). The points on the plane are kept only if 'keep_on_plane', so 
+	// that a face lying on a seam goes to a single tile. The new vertices are put exactly on the plane.
+	void clip(std::vector<vec3>& polygon, int axis, float value, bool positive, bool keep_on_plane) {
+		std::vector<vec3> result;
+		result.reserve(polygon.size() + 2);
+		const std::size_t n = polygon.size();
+		for (std::size_t i = 0; i < n; ++i) {
+			const vec3& a = polygon[i];
+			const vec3& b = polygon[(i + 1) % n];
+			double da = positive ? double(a[axis]) - value : value - double(a[axis]);
+			double db = positive ? double(b[axis]) - value : value - double(b[axis]);
+			bool a_in = keep_on_plane ? da >= 0 : da > 0;
+			bool b_in = keep_on_plane ? db >= 0 : db > 0;
+			if (a_in)
+				result.push_back(a);
+			if (a_in != b_in && da != db) {
+				double t = da / (da - db);
+				vec3 p = a + static_cast<float>(t) * (b - a);
+				p[axis] = value;
+				result.push_back(p);
+			}
+		}
+
+		// the duplicated vertices (e.g., a vertex on the plane and the intersection point)
+		polygon.clear();
+		for (std::size_t i = 0; i < result.size(); ++i) {
+			if (polygon.empty() || !same(result[i], polygon.back()))
+				polygon.push_back(result[i]);
+		}
+		while (polygon.size() > 1 && same(polygon.front(), polygon.back()))
+			polygon.pop_back();
+		if (polygon.size() < 3)
+			polygon.clear();
+	}
+
+
+	// merges the points closer than a tolerance, with a hash grid of cells of the size of the tolerance
+	class VertexWelder {
+	public:
+		VertexWelder(float tolerance) : tolerance_(tolerance) {}
+
+		unsigned int weld(const vec3& p) {
+			Numeric::int64 c[3];
+			for (int a = 0; a < 3; ++a)
+				c[a] = static_cast<Numeric::int64>(std::floor(p[a] / tolerance_));
+
+			for (Numeric::int64 x = c[0] - 1; x <= c[0] + 1; ++x) {
+				for (Numeric::int64 y = c[1] - 1; y <= c[1] + 1; ++y) {
+					for (Numeric::int64 z = c[2] - 1; z <= c[2] + 1; ++z) {
+						Cells::const_iterator pos = cells_.find(key(x, y, z));
+						if (pos == cells_.end())
+							continue;
+						for (std::size_t i = 0; i < pos->second.size(); ++i) {
+							unsigned int v = pos->second[i];
+							if (distance2(points_[v], p) <= tolerance_ * tolerance_)
+								return v;
+						}
+					}
+				}
+			}
+
+			unsigned int v = static_cast<unsigned int>(points_.size());
+			points_.push_back(p);
+			cells_[key(c[0], c[1], c[2])].push_back(v);
+			return v;
+		}
+
+		const std::vector<vec3>& points() const { return points_; }
+
+	private:
+		static Numeric::uint64 key(Numeric::int64 x, Numeric::int64 y, Numeric::int64 z) {
+			return (Numeric::uint64(x) * 73856093u) ^ (Numeric::uint64(y) * 19349663u) ^ (Numeric::uint64(z) * 83492791u);
+		}
+
+	private:
+		float tolerance_;
+		std::vector<vec3> points_;
+		typedef std::unordered_map<Numeric::uint64, std::vector<unsigned int> > Cells;
+		Cells cells_;
+	};
+
+
+	inline Numeric::uint64 edge_key(unsigned int a, unsigned int b) {
+		return (Numeric::uint64(a) << 32) | b;
+	}
+
+	// the directed edges of the faces
+	void collect_edges(const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& indices, std::unordered_set<Numeric::uint64>& edges) {
+		edges.clear();
+		for (std::size_t f = 0; f + 1 < offsets.size(); ++f) {
+			for (unsigned int i = offsets[f]; i < offsets[f + 1]; ++i) {
+				unsigned int j = (i + 1 < offsets[f + 1]) ? i + 1 : offsets[f];
+				edges.insert(edge_key(indices[i], indices[j]));
+			}
+		}
+	}
+
+
+	// the vertices on a seam, sorted along it
+	struct Seam {
+		int		axis;		// of the coordinate fixed on the seam
+		float	value;
+		std::vector< std::pair<float, unsigned int> > vertices;	// (coordinate along the seam, vertex)
+	};
+
+
+	// the settings of the pipeline of a tile (see ReconstructionContext)
+	ReconstructionContext tile_context(const TiledReconstruction::Parameters& params, SolverSession* session) {
+		ReconstructionContext context;
+		context.lambda_data_fitting = params.selection.fitting;
+		context.lambda_model_coverage = params.selection.coverage;
+		context.lambda_model_complexity = params.selection.complexity;
+		if (params.selection.time_limit > 0.0)
+			context.selection_time_limit = params.selection.time_limit;
+		context.session = session;
+		return context;
+	}
+
+
+	// the pipeline of a tile, with the weights of the parameters
+	bool run_tile(const TiledReconstruction::Tile& tile, const TiledReconstruction::Parameters& params, Reconstruction::Mesh& result, SolverSession* session) {
+		result.clear();
+		PointSet* pset = tile.pset;
+		if (!pset || pset->groups().empty())
+			return false;
+
+		const ReconstructionContext context = tile_context(params, session);
+		HypothesisGenerator hypothesis(pset);
+		hypothesis.set_context(&context);
+		hypothesis.set_keep_planes(true);
+		Map::Ptr mesh = hypothesis.generate();
+		if (!mesh)
+			return false;
+		hypothesis.compute_confidences(mesh, false);
+
+		const HypothesisGenerator::Adjacency& adjacency = hypothesis.extract_adjacency(mesh);
+		FaceSelection selector(pset, mesh);
+		selector.set_context(&context);
+		selector.optimize(adjacency, params.selection.solver);
+		if (mesh->size_of_facets() == 0)
+			return false;
+
+		Reconstruction::extract_buffers(mesh, result);
+		return true;
+	}
+}
+
+
+void TiledReconstruction::partition(const PointSet* pset, const Parameters& params, std::vector<Tile>& tiles) {
+	tiles.clear();
+	const std::vector<vec3>& points = pset->points();
+	if (points.empty())
+		return;
+
+	const Box3d& box = pset->bbox();
+	float tile_size = params.tile_size > 0 ? params.tile_size : ogf_max(box.width(), box.height());
+	TileGrid grid;
+	grid.x_min = box.x_min();
+	grid.y_min = box.y_min();
+	grid.num_x = tile_size > 0 ? ogf_max(1, int(std::ceil(box.width() / tile_size))) : 1;
+	grid.num_y = tile_size > 0 ? ogf_max(1, int(std::ceil(box.height() / tile_size))) : 1;
+	grid.width_x = box.width() / grid.num_x;
+	grid.width_y = box.height() / grid.num_y;
+	grid.overlap = params.overlap > 0 ? params.overlap : 0.1f * tile_size;
+
+	tiles.resize(std::size_t(grid.num_x) * grid.num_y);
+	for (int j = 0; j < grid.num_y; ++j) {
+		for (int i = 0; i < grid.num_x; ++i) {
+			Tile& tile = tiles[j * grid.num_x + i];
+			// the last tiles end exactly at the box
+			float x0 = grid.x_min + i * grid.width_x;
+			float y0 = grid.y_min + j * grid.width_y;
+			float x1 = (i == grid.num_x - 1) ? box.x_max() : grid.x_min + (i + 1) * grid.width_x;
+			float y1 = (j == grid.num_y - 1) ? box.y_max() : grid.y_min + (j + 1) * grid.width_y;
+			tile.core.add_point(vec3(x0, y0, box.z_min()));
+			tile.core.add_point(vec3(x1, y1, box.z_max()));
+			tile.extent.add_point(vec3(x0 - grid.overlap, y0 - grid.overlap, box.z_min()));
+			tile.extent.add_point(vec3(x1 + grid.overlap, y1 + grid.overlap, box.z_max()));
+			tile.neighbors[0] = (i > 0) ? j * grid.num_x + i - 1 : -1;
+			tile.neighbors[1] = (i < grid.num_x - 1) ? j * grid.num_x + i + 1 : -1;
+			tile.neighbors[2] = (j > 0) ? (j - 1) * grid.num_x + i : -1;
+			tile.neighbors[3] = (j < grid.num_y - 1) ? (j + 1) * grid.num_x + i : -1;
+		}
+	}
+
+	// The points of each tile (in increasing order), with the parts of the segments and the planes (and
+	// the labels and colors) of the whole segments, from the cells of a spatial index of the points: the
+	// one kept by the point set if it is up to date (see PointSet::update_roi_index()), or a temporary one.
+	const PointSetRoiIndex* index = pset->roi_index();
+	PointSetRoiIndex* own_index = index ? nil : new PointSetRoiIndex(pset);
+	if (!index)
+		index = own_index;
+	parallel_for(tiles.size(), [&](std::size_t t) {
+		tiles[t].pset = index->extract(tiles[t].extent, 3);
+	}, nil, Method::num_threads);
+	delete own_index;
+}
+
+
+bool TiledReconstruction::reconstruct_tile(const Tile& tile, const Parameters& params, Reconstruction::Mesh& result, SolverSession* session) {
+	return run_tile(tile, params, result, session);
+}
+
+
+Map* TiledReconstruction::stitch(const std::vector<Tile>& tiles, const std::vector<Reconstruction::Mesh>& results, const Parameters& params) {
+	Box3d box;
+	for (std::size_t t = 0; t < tiles.size(); ++t)
+		box.add_box(tiles[t].core);
+	if (!box.initialized())
+		return nil;
+	float tolerance = params.weld_tolerance > 0 ? params.weld_tolerance : 1e-5f * box.radius();
+	if (tolerance <= 0)
+		tolerance = 1e-6f;
+
+	// the faces of each tile, clipped on the sides shared with a neighbor
+	std::vector< std::vector< std::vector<vec3> > > polygons(tiles.size());
+	parallel_for(tiles.size(), [&](std::size_t t) {
+		const Reconstruction::Mesh& mesh = results[t];
+		const Box3d& core = tiles[t].core;
+		const Tile& tile = tiles[t];
+		for (std::size_t f = 0; f < mesh.num_faces(); ++f) {
+			std::vector<vec3> polygon;
+			for (unsigned int i = mesh.face_offsets[f]; i < mesh.face_offsets[f + 1]; ++i) {
+				const float* p = &mesh.vertices[mesh.face_indices[i] * 3];
+				polygon.push_back(vec3(p[0], p[1], p[2]));
+			}
+			// a face on a seam goes to the tile on the side of the minimum coordinates
+			if (tile.neighbors[0] >= 0 && !polygon.empty())	clip(polygon, 0, core.x_min(), true, false);
+			if (tile.neighbors[1] >= 0 && !polygon.empty())	clip(polygon, 0, core.x_max(), false, true);
+			if (tile.neighbors[2] >= 0 && !polygon.empty())	clip(polygon, 1, core.y_min(), true, false);
+			if (tile.neighbors[3] >= 0 && !polygon.empty())	clip(polygon, 1, core.y_max(), false, true);
+			if (!polygon.empty())
+				polygons[t].push_back(polygon);
+		}
+	}, nil, Method::num_threads);
+
+	// the vertices of the tiles are welded (those of the seams are computed by both neighbors)
+	VertexWelder welder(tolerance);
+	std::vector<unsigned int> face_offsets(1, 0), face_indices;
+	for (std::size_t t = 0; t < polygons.size(); ++t) {
+		for (std::size_t f = 0; f < polygons[t].size(); ++f) {
+			const std::vector<vec3>& polygon = polygons[t][f];
+			std::size_t first = face_indices.size();
+			for (std::size_t i = 0; i < polygon.size(); ++i) {
+				unsigned int v = welder.weld(polygon[i]);
+				if (face_indices.size() == first || face_indices.back() != v)
+					face_indices.push_back(v);
+			}
+			while (face_indices.size() > first + 1 && face_indices.back() == face_indices[first])
+				face_indices.pop_back();
+			if (face_indices.size() < first + 3)
+				face_indices.resize(first);
+			else
+				face_offsets.push_back(static_cast<unsigned int>(face_indices.size()));
+		}
+		std::vector< std::vector<vec3> >().swap(polygons[t]);
+	}
+	const std::vector<vec3>& points = welder.points();
+
+	// the seams and their vertices
+	std::vector<Seam> seams;
+	for (std::size_t t = 0; t < tiles.size(); ++t) {
+		if (tiles[t].neighbors[1] >= 0) {
+			Seam seam;	seam.axis = 0;	seam.value = tiles[t].core.x_max();
+			seams.push_back(seam);
+		}
+		if (tiles[t].neighbors[3] >= 0) {
+			Seam seam;	seam.axis = 1;	seam.value = tiles[t].core.y_max();
+			seams.push_back(seam);
+		}
+	}
+	// the tiles of a row (or a column) share the seam
+	std::sort(seams.begin(), seams.end(), [](const Seam& a, const Seam& b) {
+		return a.axis < b.axis || (a.axis == b.axis && a.value < b.value);
+	});
+	seams.erase(std::unique(seams.begin(), seams.end(), [](const Seam& a, const Seam& b) {
+		return a.axis == b.axis && a.value == b.value;
+	}), seams.end());
+	std::vector< std::vector<int> > vertex_seams(points.size());
+	for (std::size_t s = 0; s < seams.size(); ++s) {
+		Seam& seam = seams[s];
+		for (std::size_t v = 0; v < points.size(); ++v) {
+			if (std::abs(points[v][seam.axis] - seam.value) <= tolerance) {
+				seam.vertices.push_back(std::make_pair(points[v][1 - seam.axis], static_cast<unsigned int>(v)));
+				vertex_seams[v].push_back(static_cast<int>(s));
+			}
+		}
+		std::sort(seam.vertices.begin(), seam.vertices.end());
+	}
+
+	// The T-junctions: the border edges on a seam are split at the vertices of the seam lying on 
+	// them (the faces of one side may have been cut where those of the other side were not).
+	std::unordered_set<Numeric::uint64> edges;
+	collect_edges(face_offsets, face_indices, edges);
+	std::vector<unsigned int> new_offsets(1, 0), new_indices;
+	new_indices.reserve(face_indices.size());
+	std::size_t num_splits = 0;
+	for (std::size_t f = 0; f + 1 < face_offsets.size(); ++f) {
+		for (unsigned int i = face_offsets[f]; i < face_offsets[f + 1]; ++i) {
+			unsigned int a = face_indices[i];
+			unsigned int b = face_indices[(i + 1 < face_offsets[f + 1]) ? i + 1 : face_offsets[f]];
+			new_indices.push_back(a);
+			if (edges.count(edge_key(b, a)) > 0 || vertex_seams[a].empty() || vertex_seams[b].empty())
+				continue;
+
+			int s = -1;
+			for (std::size_t k = 0; k < vertex_seams[a].size() && s < 0; ++k) {
+				if (std::find(vertex_seams[b].begin(), vertex_seams[b].end(), vertex_seams[a][k]) != vertex_seams[b].end())
+					s = vertex_seams[a][k];
+			}
+			if (s < 0)
+				continue;
+
+			const Seam& seam = seams[s];
+			const vec3& pa = points[a];
+			const vec3& pb = points[b];
+			vec3 dir = pb - pa;
+			float len2 = dir.length2();
+			if (len2 <= 0)
+				continue;
+			float lo = ogf_min(pa[1 - seam.axis], pb[1 - seam.axis]) - tolerance;
+			float hi = ogf_max(pa[1 - seam.axis], pb[1 - seam.axis]) + tolerance;
+			std::vector< std::pair<float, unsigned int> > splits;
+			std::vector< std::pair<float, unsigned int> >::const_iterator it = std::lower_bound(seam.vertices.begin(), seam.vertices.end(), std::make_pair(lo, 0u));
+			for (; it != seam.vertices.end() && it->first <= hi; ++it) {
+				unsigned int v = it->second;
+				if (v == a || v == b)
+					continue;
+				float t = dot(points[v] - pa, dir) / len2;
+				if (t <= 0 || t >= 1)
+					continue;
+				if (distance2(pa + t * dir, points[v]) <= tolerance * tolerance)
+					splits.push_back(std::make_pair(t, v));
+			}
+			std::sort(splits.begin(), splits.end());
+			for (std::size_t k = 0; k < splits.size(); ++k)
+				new_indices.push_back(splits[k].second);
+			num_splits += splits.size();
+		}
+		new_offsets.push_back(static_cast<unsigned int>(new_indices.size()));
+	}
+
+	// the edges left on the border (where the neighbors selected different faces, or on the scene border)
+	collect_edges(new_offsets, new_indices, edges);
+	std::size_t num_border_edges = 0;
+	for (std::unordered_set<Numeric::uint64>::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+		if (edges.count((*it << 32) | (*it >> 32)) == 0)
+			++num_border_edges;
+	}
+
+	Map* mesh = new Map;
+	MapBuilder builder(mesh);
+	builder.build_from_arrays(points, new_offsets, new_indices);
+	Logger::out("-") << "stitched " << tiles.size() << " tiles: " << mesh->size_of_facets() << " faces, "
+		<< num_splits << " T-junctions split, " << num_border_edges << " border edges" << std::endl;
+	return mesh;
+}
+
+
+Map* TiledReconstruction::reconstruct(PointSet* pset, const Parameters& params) {
+	if (!pset || pset->points().empty()) {
+		Logger::err("-") << "the input has no point" << std::endl;
+		return nil;
+	}
+
+	if (pset->groups().empty())
+		PlaneDetector::detect(pset, PlaneDetector::Parameters(), Method::num_threads);
+	if (pset->groups().empty()) {
+		Logger::err("-") << "planar segments do not exist" << std::endl;
+		return nil;
+	}
+
+	// the planes are refined for the whole scene, so the tiles share them
+	{
+		const ReconstructionContext context = tile_context(params, nil);
+		HypothesisGenerator hypothesis(pset);
+		hypothesis.set_context(&context);
+		hypothesis.refine_planes();
+	}
+
+	std::vector<Tile> tiles;
+	pset->update_roi_index();
+	partition(pset, params, tiles);
+	Logger::out("-") << "reconstructing " << tiles.size() << " tiles" << std::endl;
+
+	std::vector<Reconstruction::Mesh> results(tiles.size());
+	parallel_for(tiles.size(), [&](std::size_t t) {
+		if (!run_tile(tiles[t], params, results[t], nil))
+			Logger::warn("-") << "tile " << t << " has no model" << std::endl;
+		tiles[t].pset.forget();		// only the boxes are needed from now on
+	}, nil, Method::num_threads);
+
+	std::size_t num_models = 0;
+	for (std::size_t t = 0; t < results.size(); ++t) {
+		if (results[t].num_faces() > 0)
+			++num_models;
+	}
+	if (num_models == 0) {
+		Logger::err("-") << "no tile has a model" << std::endl;
+		return nil;
+	}
+
+	return stitch(tiles, results, params);
+}
@@ -0,0 +1,87 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _TILED_RECONSTRUCTION_H_
+#define _TILED_RECONSTRUCTION_H_
+
+#include "method_common.h"
+#include "reconstruction.h"
+#include "../math/math_types.h"
+#include "../model/point_set.h"
+
+#include <vector>
+
+
+class Map;
+
+
+/**
+* The reconstruction of large scenes (e.g., a city district) in tiles, where a single run would give
+* too many candidate faces and a too large binary program. The scene is partitioned in a grid of
+* tiles on the ground (the x-y plane), each tile including the points of an overlapping band around
+* it, and each tile is reconstructed independently (in parallel). The faces of each tile are then
+* clipped to the tile (inside the band, where both neighbors saw the same points), and the tiles are
+* stitched: the vertices on the seams are welded, and the T-junctions split the edges of the seams.
+*
+* The segments are refined once for the whole scene and split between the tiles with their planes,
+* so the neighboring tiles cut their faces by the same planes and their faces meet at the seams. The
+* result is watertight where the neighbors agree on the faces in the bands; the border edges left 
+* are reported. The tiles can also be reconstructed by other processes (e.g., the Batch tool), with
+* partition() and stitch().
+*/
+
+class METHOD_API TiledReconstruction
+{
+public:
+	struct Parameters {
+		Parameters() : tile_size(0.0f), overlap(0.0f), weld_tolerance(0.0f) {}
+
+		float tile_size;		// the largest width of a tile (0: the whole scene in one tile)
+		float overlap;			// the width of the band around each tile (0: a tenth of the tile size)
+		float weld_tolerance;	// the distance of the vertices welded at the seams (0: 1e-5 of the scene size)
+		Reconstruction::Parameters	selection;	// of the reconstruction of each tile
+	};
+
+	struct Tile {
+		Box3d			core;		// the part of the scene the tile reconstructs
+		Box3d			extent;		// the core and the band
+		PointSet::Ptr	pset;		// the points of the extent, with the parts of the segments (and their planes)
+		int				neighbors[4];	// the tiles on the side of x_min, x_max, y_min and y_max (-1 if none)
+	};
+
+public:
+	// the tiles of the point set, whose segments must have been refined (the segments of less than
+	// three points in a tile are not given to the tile)
+	static void partition(const PointSet* pset, const Parameters& params, std::vector<Tile>& tiles);
+
+	// reconstructs a tile with the planes of its segments (see Reconstruction::reconstruct()). Returns 
+	// false if the tile has no model (e.g., no segment).
+	static bool reconstruct_tile(const Tile& tile, const Parameters& params, Reconstruction::Mesh& result, SolverSession* session = nil);
+
+	// stitches the models of the tiles (some may be empty) into one mesh
+	static Map* stitch(const std::vector<Tile>& tiles, const std::vector<Reconstruction::Mesh>& results, const Parameters& params);
+
+	// The whole of it: refines the segments of the point set, partitions it, reconstructs the tiles
+	// (the tiles in parallel, up to Method::num_threads), and stitches them. Returns nil (and logs
+	// why) if no tile has a model.
+	static Map* reconstruct(PointSet* pset, const Parameters& params);
+};
+
+
+#endif
@@ -0,0 +1,121 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "triplet_intersection_table.h"
+#include "../basic/assertions.h"
+
+#include <algorithm>
+
+
+namespace {
+	const Numeric::uint64 empty_key = ~Numeric::uint64(0);
+
+	// 21 bits for each plane index
+	const unsigned int max_plane_index = (1u << 21) - 1;
+}
+
+
+TripletIntersectionTable::TripletIntersectionTable() {
+	rehash(64);
+}
+
+
+void TripletIntersectionTable::clear() {
+	keys_.clear();
+	indices_.clear();
+	points_.clear();
+	rehash(64);
+}
+
+
+std::size_t TripletIntersectionTable::memory_usage() const {
+	return keys_.capacity() * sizeof(Key) + indices_.capacity() * sizeof(unsigned int) + points_.size() * sizeof(vec3);
+}
+
+
+void TripletIntersectionTable::reserve(std::size_t n) {
+	std::size_t num_slots = keys_.size();
+	while (num_slots < n * 2)
+		num_slots *= 2;
+	if (num_slots > keys_.size())
+		rehash(num_slots);
+}
+
+
+TripletIntersectionTable::Key TripletIntersectionTable::key(unsigned int i, unsigned int j, unsigned int k) {
+	// sort the indices, so the order of the planes doesn't matter
+	if (i > j) std::swap(i, j);
+	if (j > k) std::swap(j, k);
+	if (i > j) std::swap(i, j);
+	ogf_assert(k <= max_plane_index);
+	return (Key(i) << 42) | (Key(j) << 21) | Key(k);
+}
+
+
+std::size_t TripletIntersectionTable::slot(Key k) const {
+	// the number of slots is a power of two
+	std::size_t mask = keys_.size() - 1;
+	std::size_t s = std::size_t((k * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	while (keys_[s] != empty_key && keys_[s] != k)
+		s = (s + 1) & mask;
+	return s;
+}
+
+
+void TripletIntersectionTable::rehash(std::size_t num_slots) {
+	std::vector<Key>			keys(num_slots, empty_key);
+	std::vector<unsigned int>	indices(num_slots, 0);
+	keys_.swap(keys);
+	indices_.swap(indices);
+
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		if (keys[i] != empty_key) {
+			std::size_t s = slot(keys[i]);
+			keys_[s] = keys[i];
+			indices_[s] = indices[i];
+		}
+	}
+}
+
+
+const vec3* TripletIntersectionTable::find(unsigned int i, unsigned int j, unsigned int k) const {
+	std::size_t s = slot(key(i, j, k));
+	if (keys_[s] == empty_key)
+		return nil;
+	return &points_[indices_[s]];
+}
+
+
+const vec3* TripletIntersectionTable::insert(unsigned int i, unsigned int j, unsigned int k, const vec3& p) {
+	Key kk = key(i, j, k);
+	std::size_t s = slot(kk);
+	if (keys_[s] != empty_key)
+		return &points_[indices_[s]];
+
+	keys_[s] = kk;
+	indices_[s] = static_cast<unsigned int>(points_.size());
+	points_.push_back(p);
+
+	// keep the load factor below 0.5
+	if (points_.size() * 2 > keys_.size())
+		rehash(keys_.size() * 2);
+
+	return &points_.back();
+}
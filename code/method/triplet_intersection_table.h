@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _TRIPLET_INTERSECTION_TABLE_H_
+#define _TRIPLET_INTERSECTION_TABLE_H_
+
+#include "method_common.h"
+#include "../math/math_types.h"
+#include "../basic/basic_types.h"
+
+#include <vector>
+#include <deque>
+
+
+// The intersecting points of plane triplets, keyed on the indices of the three planes. 
+// It is a flat open-addressing hash table, and the points are stored in large blocks
+// (a deque). The pointers returned by find() and insert() remain valid until clear(), 
+// so they can be used as the identities of the points even if the table still grows.
+class METHOD_API TripletIntersectionTable
+{
+public:
+	TripletIntersectionTable();
+
+	void clear();
+
+	// prepares for storing 'n' points
+	void reserve(std::size_t n);
+
+	std::size_t size() const { return points_.size(); }
+
+	// the bytes used by the slots and the points
+	std::size_t memory_usage() const;
+
+	// returns the intersecting point of planes i, j, and k (in any order); nil if not stored
+	const vec3* find(unsigned int i, unsigned int j, unsigned int k) const;
+
+	// stores 'p' as the intersecting point of planes i, j, and k (in any order). If the
+	// triplet is already stored, the existing point is kept. Returns the stored point.
+	const vec3* insert(unsigned int i, unsigned int j, unsigned int k, const vec3& p);
+
+private:
+	typedef Numeric::uint64 Key;
+
+	static Key key(unsigned int i, unsigned int j, unsigned int k);
+
+	// the slot where 'k' is stored (or the empty slot where it should be)
+	std::size_t slot(Key k) const;
+
+	void rehash(std::size_t num_slots);
+
+private:
+	std::vector<Key>			keys_;		// one per slot
+	std::vector<unsigned int>	indices_;	// one per slot: index of the point in points_
+	std::deque<vec3>			points_;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "vertex_registry.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// locks the mutexes of some shards (in increasing order) for its lifetime
+	class ShardLocks {
+	public:
+		ShardLocks(std::mutex* mutexes, const std::size_t* shards, std::size_t n) : mutexes_(mutexes), shards_(shards), n_(n) {
+			for (std::size_t i = 0; i < n_; ++i)
+				mutexes_[shards_[i]].lock();
+		}
+		~ShardLocks() {
+			for (std::size_t i = n_; i > 0; --i)
+				mutexes_[shards_[i - 1]].unlock();
+		}
+
+	private:
+		std::mutex* mutexes_;
+		const std::size_t* shards_;
+		std::size_t n_;
+	};
+
+}
+
+
+VertexRegistry::VertexRegistry() : snap_distance_(0.0), cell_size_(1e-9) {
+}
+
+
+void VertexRegistry::reset(double snap_distance) {
+	for (std::size_t i = 0; i < num_shards; ++i) {
+		std::lock_guard<std::mutex> lock(mutexes_[i]);
+		shards_[i].triplets.clear();
+		shards_[i].cells.clear();
+		shards_[i].points.clear();
+	}
+	snap_distance_ = snap_distance;
+	// the cells may not be too small for the range of the indices
+	cell_size_ = std::max(2.0 * snap_distance, 1e-9);
+}
+
+
+std::size_t VertexRegistry::size() const {
+	std::size_t num = 0;
+	for (std::size_t i = 0; i < num_shards; ++i) {
+		std::lock_guard<std::mutex> lock(mutexes_[i]);
+		num += shards_[i].points.size();
+	}
+	return num;
+}
+
+
+std::size_t VertexRegistry::memory_usage() const {
+	// the nodes of the hash maps are estimated as the value and two pointers
+	std::size_t bytes = 0;
+	for (std::size_t i = 0; i < num_shards; ++i) {
+		std::lock_guard<std::mutex> lock(mutexes_[i]);
+		const Shard& s = shards_[i];
+		bytes += s.points.size() * sizeof(vec3);
+		bytes += s.triplets.size() * (sizeof(std::pair<Numeric::uint64, const vec3*>) + 2 * sizeof(void*)) + s.triplets.bucket_count() * sizeof(void*);
+		bytes += s.cells.size() * (sizeof(std::pair<Cell, std::vector<const vec3*> >) + 2 * sizeof(void*)) + s.cells.bucket_count() * sizeof(void*);
+		bytes += s.points.size() * sizeof(const vec3*);		// in the cells
+	}
+	return bytes;
+}
+
+
+VertexRegistry::Cell VertexRegistry::cell(const vec3& p) const {
+	Cell c;
+	c.x = static_cast<Numeric::int64>(std::floor(p.x / cell_size_));
+	c.y = static_cast<Numeric::int64>(std::floor(p.y / cell_size_));
+	c.z = static_cast<Numeric::int64>(std::floor(p.z / cell_size_));
+	return c;
+}
+
+
+const vec3* VertexRegistry::snap(const PlaneIdSet<3>& planes, const vec3& p) {
+	const bool has_key = (planes.size() == 3);
+	const Numeric::uint64 key = has_key ? 
+		((Numeric::uint64(planes[0]) << 42) | (Numeric::uint64(planes[1]) << 21) | Numeric::uint64(planes[2])) : 0;
+
+	// the cells overlapped by the ball of the snapping distance (the cells are twice as large, so there
+	// are at most two along each axis), and the shards to lock
+	const double d = snap_distance_;
+	const Numeric::int64 lo[3] = {
+		static_cast<Numeric::int64>(std::floor((p.x - d) / cell_size_)),
+		static_cast<Numeric::int64>(std::floor((p.y - d) / cell_size_)),
+		static_cast<Numeric::int64>(std::floor((p.z - d) / cell_size_))
+	};
+	const Numeric::int64 hi[3] = {
+		static_cast<Numeric::int64>(std::floor((p.x + d) / cell_size_)),
+		static_cast<Numeric::int64>(std::floor((p.y + d) / cell_size_)),
+		static_cast<Numeric::int64>(std::floor((p.z + d) / cell_size_))
+	};
+	Cell cells[8];
+	std::size_t num_cells = 0;
+	for (Numeric::int64 x = lo[0]; x <= hi[0] && x <= lo[0] + 1; ++x) {
+		for (Numeric::int64 y = lo[1]; y <= hi[1] && y <= lo[1] + 1; ++y) {
+			for (Numeric::int64 z = lo[2]; z <= hi[2] && z <= lo[2] + 1; ++z) {
+				Cell& c = cells[num_cells++];
+				c.x = x;
+				c.y = y;
+				c.z = z;
+			}
+		}
+	}
+
+	std::size_t shards[9];
+	std::size_t num_locked = 0;
+	for (std::size_t i = 0; i < num_cells; ++i)
+		shards[num_locked++] = shard(cells[i]);
+	if (has_key)
+		shards[num_locked++] = shard(key);
+	std::sort(shards, shards + num_locked);
+	num_locked = std::unique(shards, shards + num_locked) - shards;
+	ShardLocks locks(mutexes_, shards, num_locked);
+
+	if (has_key) {
+		const std::unordered_map<Numeric::uint64, const vec3*>& triplets = shards_[shard(key)].triplets;
+		std::unordered_map<Numeric::uint64, const vec3*>::const_iterator pos = triplets.find(key);
+		if (pos != triplets.end())
+			return pos->second;
+	}
+
+	const vec3* result = nil;
+	double min_sqr_distance = d * d;
+	for (std::size_t i = 0; i < num_cells; ++i) {
+		const Shard& s = shards_[shard(cells[i])];
+		std::unordered_map<Cell, std::vector<const vec3*>, CellHash>::const_iterator pos = s.cells.find(cells[i]);
+		if (pos == s.cells.end())
+			continue;
+		const std::vector<const vec3*>& points = pos->second;
+		for (std::size_t j = 0; j < points.size(); ++j) {
+			double dx = double(points[j]->x) - p.x, dy = double(points[j]->y) - p.y, dz = double(points[j]->z) - p.z;
+			double sd = dx * dx + dy * dy + dz * dz;
+			if (sd <= min_sqr_distance) {
+				min_sqr_distance = sd;
+				result = points[j];
+			}
+		}
+	}
+
+	if (!result) {
+		const Cell home = cell(p);
+		Shard& s = shards_[shard(home)];
+		s.points.push_back(p);
+		result = &s.points.back();
+		s.cells[home].push_back(result);
+	}
+	if (has_key)
+		shards_[shard(key)].triplets[key] = result;
+	return result;
+}
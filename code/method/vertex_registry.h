@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#ifndef _VERTEX_REGISTRY_H_
+#define _VERTEX_REGISTRY_H_
+
+#include "method_common.h"
+#include "plane_id_set.h"
+#include "../math/math_types.h"
+#include "../basic/basic_types.h"
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+
+// The vertices of the arrangement of the planes, shared by the threads cutting the faces (see 
+// Method::vertex_snapping_registry). A vertex is registered with the planes it lies on and its 
+// position, and the later vertices of the same three planes, or within the snapping distance of
+// it, get its position. The positions are hashed on a grid of cells twice the snapping distance,
+// so a query visits at most 8 cells. The table is split in shards locked separately (in the order 
+// of the shards, so the threads don't wait for each other unless their vertices are close). The 
+// returned pointers identify the vertices, and remain valid until reset().
+class METHOD_API VertexRegistry
+{
+public:
+	VertexRegistry();
+
+	// empties the registry, with a new snapping distance
+	void reset(double snap_distance);
+
+	// The registered position of the vertex of 'planes' (its three planes, or fewer if it isn't known
+	// how the vertex came to be, e.g., a corner of a proxy face) at 'p': the position of the same three
+	// planes if it is registered, or else the closest one within the snapping distance, or else 'p', 
+	// which is then registered.
+	const vec3* snap(const PlaneIdSet<3>& planes, const vec3& p);
+
+	std::size_t size() const;
+
+	// the bytes used by the tables and the points
+	std::size_t memory_usage() const;
+
+private:
+	struct Cell {
+		Numeric::int64 x, y, z;
+		bool operator==(const Cell& rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+	};
+	struct CellHash {
+		std::size_t operator()(const Cell& c) const {
+			Numeric::uint64 h = Numeric::uint64(c.x) * 0x9E3779B97F4A7C15ull;
+			h ^= Numeric::uint64(c.y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= Numeric::uint64(c.z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			return std::size_t(h ^ (h >> 32));
+		}
+	};
+
+	struct Shard {
+		std::unordered_map<Numeric::uint64, const vec3*>				triplets;	// keyed on the sorted plane indices
+		std::unordered_map<Cell, std::vector<const vec3*>, CellHash>	cells;
+		std::deque<vec3>												points;		// registered in this shard
+	};
+
+	enum { num_shards = 64 };
+
+	Cell cell(const vec3& p) const;
+	static std::size_t shard(const Cell& c) { return CellHash()(c) % num_shards; }
+	static std::size_t shard(Numeric::uint64 key) { return std::size_t((key * 0x9E3779B97F4A7C15ull) >> 40) % num_shards; }
+
+private:
+	double		snap_distance_;
+	double		cell_size_;
+	Shard		shards_[num_shards];
+	mutable std::mutex	mutexes_[num_shards];
+};
+
+#endif
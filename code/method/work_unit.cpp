@@ -0,0 +1,306 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "work_unit.h"
+#include "method_global.h"
+#include "../basic/logger.h"
+#include "../math/linear_program.h"
+#include "../model/point_set.h"
+#include "../model/point_set_serializer_vg.h"
+
+#include <iostream>
+#include <sstream>
+#include <iterator>
+#include <cstring>
+
+
+namespace {
+
+	// the blobs start with this tag, their version, and their kind
+	const char			   TAG[4] = { 'P', 'F', 'W', 'U' };
+	const Numeric::uint32  VERSION = 1;
+
+	template <typename T>
+	void write_array(std::ostream& output, const T* data, std::size_t n) {
+		if (n > 0)
+			output.write(reinterpret_cast<const char*>(data), n * sizeof(T));
+	}
+
+	template <typename T>
+	void write_value(std::ostream& output, const T& value) {
+		write_array(output, &value, 1);
+	}
+
+	void write_header(std::ostream& output, WorkUnit::Kind kind) {
+		output.write(TAG, sizeof(TAG));
+		write_value(output, VERSION);
+		write_value(output, static_cast<Numeric::uint8>(kind));
+	}
+
+	void write_box(std::ostream& output, const Box3d& box) {
+		float values[6] = { box.x_min(), box.y_min(), box.z_min(), box.x_max(), box.y_max(), box.z_max() };
+		write_array(output, values, 6);
+	}
+
+
+	// reads a blob in memory (the units are read as a whole, e.g., from a pipe)
+	class BlobReader {
+	public:
+		BlobReader(const std::string& blob) : data_(blob.data()), end_(blob.data() + blob.size()) {}
+
+		template <typename T>
+		bool get_array(T* values, std::size_t n) {
+			if (n > static_cast<std::size_t>(end_ - data_) / sizeof(T))
+				return false;
+			if (n > 0)
+				std::memcpy(values, data_, n * sizeof(T));
+			data_ += n * sizeof(T);
+			return true;
+		}
+
+		template <typename T>
+		bool get(T& value) { return get_array(&value, 1); }
+
+		template <typename T>
+		bool get_vector(std::vector<T>& values) {
+			Numeric::uint64 n = 0;
+			if (!get(n) || n > static_cast<Numeric::uint64>(end_ - data_) / sizeof(T))
+				return false;
+			values.resize(static_cast<std::size_t>(n));
+			return get_array(values.data(), values.size());
+		}
+
+		bool get_box(Box3d& box) {
+			float values[6];
+			if (!get_array(values, 6))
+				return false;
+			box.clear();
+			box.add_point(vec3(values[0], values[1], values[2]));
+			box.add_point(vec3(values[3], values[4], values[5]));
+			return true;
+		}
+
+		// the header, of a blob of the given kind (or any kind if 'kind' is 0)
+		bool get_header(Numeric::uint8& kind) {
+			char tag[sizeof(TAG)];
+			Numeric::uint32 version = 0;
+			Numeric::uint8 expected = kind;
+			if (!get_array(tag, sizeof(tag)) || std::memcmp(tag, TAG, sizeof(TAG)) != 0 || !get(version) || version != VERSION) {
+				Logger::err("-") << "not a work unit (or of an unsupported version or byte order)" << std::endl;
+				return false;
+			}
+			if (!get(kind) || (expected != 0 && kind != expected)) {
+				Logger::err("-") << "unexpected kind of work unit" << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		const char*& data() { return data_; }
+		const char* end() const { return end_; }
+
+	private:
+		const char* data_;
+		const char* end_;
+	};
+
+
+	bool read_blob(std::istream& input, std::string& blob) {
+		blob.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+		if (input.bad()) {
+			Logger::err("-") << "failed reading work unit" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+
+	bool process_program(BlobReader& reader, std::ostream& output) {
+		WorkUnit::ProgramResult result;
+		Numeric::uint8 solver_name = 0;
+		double time_limit = 0.0;
+		LinearProgram program;
+		bool ok = reader.get(solver_name) && reader.get(time_limit);
+		if (ok) {
+			// the program is the rest of the blob
+			std::istringstream stream(std::string(reader.data(), reader.end()));
+			ok = program.read_binary(stream, "work unit");
+		}
+		if (!ok)
+			Logger::err("-") << "corrupted program work unit" << std::endl;
+		else {
+			LinearProgramSolver solver;
+			LinearProgramSolver::SolverOptions options;
+			options.time_limit = time_limit;
+			options.deterministic = Method::deterministic;
+			solver.set_options(options);
+			if (solver.solve(&program, static_cast<LinearProgramSolver::SolverName>(solver_name))) {
+				result.solution = solver.solution();
+				result.objective = solver.objective_value();
+			}
+			result.status = solver.status();
+		}
+
+		write_header(output, WorkUnit::PROGRAM_RESULT);
+		write_value(output, static_cast<Numeric::uint8>(result.status));
+		write_value(output, result.objective);
+		write_value(output, static_cast<Numeric::uint64>(result.solution.size()));
+		write_array(output, result.solution.data(), result.solution.size());
+		return ok && !result.solution.empty() && !output.fail();
+	}
+
+
+	bool process_tile(BlobReader& reader, std::ostream& output) {
+		TiledReconstruction::Tile tile;
+		TiledReconstruction::Parameters params;
+		Numeric::int32 neighbors[4];
+		Numeric::uint8 solver_name = 0;
+		bool ok = reader.get_box(tile.core) && reader.get_box(tile.extent) && reader.get_array(neighbors, 4) &&
+			reader.get(params.selection.fitting) && reader.get(params.selection.coverage) && reader.get(params.selection.complexity) &&
+			reader.get(solver_name) && reader.get(params.selection.time_limit);
+		if (ok) {
+			for (int k = 0; k < 4; ++k)
+				tile.neighbors[k] = neighbors[k];
+			params.selection.solver = static_cast<LinearProgramSolver::SolverName>(solver_name);
+			tile.pset = new PointSet;
+			ok = PointSetSerializer_vg::read_bvg(tile.pset, reader.data(), reader.end(), "the work unit");
+		}
+		if (!ok)
+			Logger::err("-") << "corrupted tile work unit" << std::endl;
+
+		Reconstruction::Mesh mesh;
+		bool reconstructed = ok && TiledReconstruction::reconstruct_tile(tile, params, mesh);
+
+		write_header(output, WorkUnit::TILE_RESULT);
+		write_value(output, static_cast<Numeric::uint8>(reconstructed));
+		write_value(output, static_cast<Numeric::uint64>(mesh.vertices.size()));
+		write_array(output, mesh.vertices.data(), mesh.vertices.size());
+		write_value(output, static_cast<Numeric::uint64>(mesh.face_offsets.size()));
+		write_array(output, mesh.face_offsets.data(), mesh.face_offsets.size());
+		write_value(output, static_cast<Numeric::uint64>(mesh.face_indices.size()));
+		write_array(output, mesh.face_indices.data(), mesh.face_indices.size());
+		return reconstructed && !output.fail();
+	}
+}
+
+
+bool WorkUnit::write_program(std::ostream& output, const LinearProgram& program, LinearProgramSolver::SolverName solver, double time_limit) {
+	write_header(output, PROGRAM);
+	write_value(output, static_cast<Numeric::uint8>(solver));
+	write_value(output, time_limit);
+	return program.write_binary(output, false);
+}
+
+
+bool WorkUnit::write_tile(std::ostream& output, const TiledReconstruction::Tile& tile, const TiledReconstruction::Parameters& params) {
+	if (!tile.pset) {
+		Logger::err("-") << "the tile has no point set" << std::endl;
+		return false;
+	}
+
+	write_header(output, TILE);
+	write_box(output, tile.core);
+	write_box(output, tile.extent);
+	Numeric::int32 neighbors[4];
+	for (int k = 0; k < 4; ++k)
+		neighbors[k] = tile.neighbors[k];
+	write_array(output, neighbors, 4);
+	write_value(output, params.selection.fitting);
+	write_value(output, params.selection.coverage);
+	write_value(output, params.selection.complexity);
+	write_value(output, static_cast<Numeric::uint8>(params.selection.solver));
+	write_value(output, params.selection.time_limit);
+	return PointSetSerializer_vg::write_bvg(tile.pset, output);
+}
+
+
+bool WorkUnit::process(std::istream& input, std::ostream& output) {
+	std::string blob;
+	if (!read_blob(input, blob))
+		return false;
+
+	BlobReader reader(blob);
+	Numeric::uint8 kind = 0;
+	if (!reader.get_header(kind))
+		return false;
+
+	switch (kind) {
+	case PROGRAM:	return process_program(reader, output);
+	case TILE:		return process_tile(reader, output);
+	default:
+		Logger::err("-") << "not a work unit to be processed (kind " << int(kind) << ")" << std::endl;
+		return false;
+	}
+}
+
+
+bool WorkUnit::read_program_result(std::istream& input, ProgramResult& result) {
+	result = ProgramResult();
+	std::string blob;
+	if (!read_blob(input, blob))
+		return false;
+
+	BlobReader reader(blob);
+	Numeric::uint8 kind = PROGRAM_RESULT;
+	Numeric::uint8 status = 0;
+	if (!reader.get_header(kind))
+		return false;
+	if (!reader.get(status) || !reader.get(result.objective) || !reader.get_vector(result.solution)) {
+		Logger::err("-") << "corrupted program result" << std::endl;
+		result = ProgramResult();
+		return false;
+	}
+	result.status = static_cast<LinearProgramSolver::Status>(status);
+	return true;
+}
+
+
+bool WorkUnit::read_tile_result(std::istream& input, Reconstruction::Mesh& result) {
+	result.clear();
+	std::string blob;
+	if (!read_blob(input, blob))
+		return false;
+
+	BlobReader reader(blob);
+	Numeric::uint8 kind = TILE_RESULT;
+	Numeric::uint8 reconstructed = 0;
+	if (!reader.get_header(kind))
+		return false;
+	if (!reader.get(reconstructed) || !reader.get_vector(result.vertices) ||
+		!reader.get_vector(result.face_offsets) || !reader.get_vector(result.face_indices))
+	{
+		Logger::err("-") << "corrupted tile result" << std::endl;
+		result.clear();
+		return false;
+	}
+
+	// the faces must refer to the vertices
+	bool valid = result.vertices.size() % 3 == 0 && (result.face_offsets.empty() || 
+		(result.face_offsets.front() == 0 && result.face_offsets.back() == result.face_indices.size()));
+	for (std::size_t f = 0; valid && f < result.num_faces(); ++f)
+		valid = result.face_offsets[f] <= result.face_offsets[f + 1];
+	for (std::size_t i = 0; valid && i < result.face_indices.size(); ++i)
+		valid = result.face_indices[i] < result.num_vertices();
+	if (!valid) {
+		Logger::err("-") << "corrupted tile result" << std::endl;
+		result.clear();
+		return false;
+	}
+	return reconstructed != 0;
+}
@@ -0,0 +1,77 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _WORK_UNIT_H_
+#define _WORK_UNIT_H_
+
+#include "method_common.h"
+#include "reconstruction.h"
+#include "tiled_reconstruction.h"
+#include "../math/linear_program_solver.h"
+
+#include <iosfwd>
+#include <vector>
+
+
+class LinearProgram;
+
+
+/**
+* Self-contained units of work, for running parts of a reconstruction on other machines: a component 
+* of the face selection program (see FaceSelection::set_component_dispatcher()), or a tile with its 
+* points and segments (see TiledReconstruction). A unit is written as a binary blob, which a worker 
+* (e.g., 'Batch --work-unit unit result') turns into a result blob to be read back for merging. The
+* transport is left to the caller (e.g., files, or the standard input and output).
+*
+* The programs are stored as binary linear programs ("lpb") and the point sets as .bvg files, so the
+* blobs are in the byte order of the machine, as those files (the workers must share it).
+*/
+
+class METHOD_API WorkUnit
+{
+public:
+	enum Kind { PROGRAM = 1, TILE = 2, PROGRAM_RESULT = 3, TILE_RESULT = 4 };
+
+	// the solution of a program unit
+	struct ProgramResult {
+		ProgramResult() : status(LinearProgramSolver::STATUS_FAILED), objective(0.0) {}
+
+		LinearProgramSolver::Status	status;
+		double						objective;
+		std::vector<double>			solution;	// empty if no solution was found
+	};
+
+public:
+	// a program to be solved by 'solver' within 'time_limit' seconds (0 for no limit)
+	static bool write_program(std::ostream& output, const LinearProgram& program, LinearProgramSolver::SolverName solver, double time_limit);
+
+	// a tile to be reconstructed with 'params.selection'
+	static bool write_tile(std::ostream& output, const TiledReconstruction::Tile& tile, const TiledReconstruction::Parameters& params);
+
+	// The worker: reads a unit, processes it, and writes its result (also if it failed, so the caller
+	// learns about it). Returns false (and logs why) if the unit can't be read or processing fails.
+	static bool process(std::istream& input, std::ostream& output);
+
+	// read the results written by process()
+	static bool read_program_result(std::istream& input, ProgramResult& result);
+	static bool read_tile_result(std::istream& input, Reconstruction::Mesh& result);
+};
+
+
+#endif
@@ -0,0 +1,436 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "compact_mesh.h"
+#include "map_attributes.h"
+#include "map_builder.h"
+#include "iterators.h"
+#include "../basic/assertions.h"
+
+
+const CompactMesh::Index CompactMesh::invalid;
+
+
+CompactMesh::~CompactMesh() {
+	// the attributes may outlive the mesh, then they are just not updated anymore
+	for (int t = 0; t < 3; ++t) {
+		for (std::size_t i = 0; i < columns_[t].size(); ++i)
+			columns_[t][i]->mesh_ = nil;
+	}
+}
+
+
+void CompactMesh::clear() {
+	point_.clear();
+	vertex_halfedge_.clear();
+	vertex_deleted_.clear();
+
+	halfedge_next_.clear();
+	halfedge_prev_.clear();
+	halfedge_vertex_.clear();
+	halfedge_facet_.clear();
+	halfedge_deleted_.clear();
+
+	facet_halfedge_.clear();
+	facet_deleted_.clear();
+
+	for (int t = 0; t < 3; ++t) {
+		free_[t].clear();
+		for (std::size_t i = 0; i < columns_[t].size(); ++i)
+			columns_[t][i]->shrink(0);
+	}
+}
+
+
+void CompactMesh::assign(const Map* map, MapElements* elements /* = nil */) {
+	clear();
+
+	Map* m = const_cast<Map*>(map);	// the temporary attributes don't change the mesh
+	MapVertexAttribute<Index>	vertex_index(m);
+	MapHalfedgeAttribute<Index>	halfedge_index(m);
+	MapFacetAttribute<Index>	facet_index(m);
+
+	std::vector<Map::Vertex*> vertices;
+	vertices.reserve(map->size_of_vertices());
+	FOR_EACH_VERTEX_CONST(Map, map, it) {
+		vertex_index[it] = static_cast<Index>(vertices.size());
+		vertices.push_back(const_cast<Map::Vertex*>(&*it));
+	}
+
+	// the opposite halfedges are numbered in pairs (the first one is met first)
+	std::vector<Map::Halfedge*> halfedges;
+	halfedges.reserve(map->size_of_halfedges());
+	FOR_EACH_HALFEDGE_CONST(Map, map, it) {
+		halfedge_index[it] = invalid;
+	}
+	FOR_EACH_HALFEDGE_CONST(Map, map, it) {
+		if (halfedge_index[it] != invalid)
+			continue;
+		Map::Halfedge* h = const_cast<Map::Halfedge*>(&*it);
+		halfedge_index[h] = static_cast<Index>(halfedges.size());
+		halfedges.push_back(h);
+		halfedge_index[h->opposite()] = static_cast<Index>(halfedges.size());
+		halfedges.push_back(h->opposite());
+	}
+
+	std::vector<Map::Facet*> facets;
+	facets.reserve(map->size_of_facets());
+	FOR_EACH_FACET_CONST(Map, map, it) {
+		facet_index[it] = static_cast<Index>(facets.size());
+		facets.push_back(const_cast<Map::Facet*>(&*it));
+	}
+
+	point_.resize(vertices.size());
+	vertex_halfedge_.resize(vertices.size());
+	vertex_deleted_.assign(vertices.size(), 0);
+	for (std::size_t i = 0; i < vertices.size(); ++i) {
+		point_[i] = vertices[i]->point();
+		vertex_halfedge_[i] = vertices[i]->halfedge() ? halfedge_index[vertices[i]->halfedge()] : invalid;
+	}
+
+	halfedge_next_.resize(halfedges.size());
+	halfedge_prev_.resize(halfedges.size());
+	halfedge_vertex_.resize(halfedges.size());
+	halfedge_facet_.resize(halfedges.size());
+	halfedge_deleted_.assign(halfedges.size(), 0);
+	for (std::size_t i = 0; i < halfedges.size(); ++i) {
+		Map::Halfedge* h = halfedges[i];
+		halfedge_next_[i] = halfedge_index[h->next()];
+		halfedge_prev_[i] = halfedge_index[h->prev()];
+		halfedge_vertex_[i] = vertex_index[h->vertex()];
+		halfedge_facet_[i] = h->facet() ? facet_index[h->facet()] : invalid;
+	}
+
+	facet_halfedge_.resize(facets.size());
+	facet_deleted_.assign(facets.size(), 0);
+	for (std::size_t i = 0; i < facets.size(); ++i)
+		facet_halfedge_[i] = halfedge_index[facets[i]->halfedge()];
+
+	for (int t = 0; t < 3; ++t) {
+		std::size_t size = size_of(ElementType(t));
+		for (std::size_t i = 0; i < columns_[t].size(); ++i) {
+			for (std::size_t j = 0; j < size; ++j)
+				columns_[t][i]->created(static_cast<Index>(j), size);
+		}
+	}
+
+	if (elements) {
+		elements->vertices.swap(vertices);
+		elements->halfedges.swap(halfedges);
+		elements->facets.swap(facets);
+	}
+}
+
+
+std::vector<Map::Facet*> CompactMesh::extract(Map* map) const {
+	std::vector<Map::Facet*> facets(facets_capacity(), nil);
+
+	MapBuilder builder(map);
+	builder.begin_surface();
+
+	std::vector<int> vertex_id(vertices_capacity(), -1);
+	int num = 0;
+	FOR_EACH_COMPACT_VERTEX(this, v) {
+		vertex_id[v] = num++;
+		builder.add_vertex(point_[v]);
+	}
+
+	FOR_EACH_COMPACT_FACET(this, f) {
+		builder.begin_facet();
+		CompactFacetHalfedgeCirculator cir(this, f);
+		for (; !cir->end(); ++cir)
+			builder.add_vertex_to_facet(vertex_id[cir->vertex()]);
+		builder.end_facet();
+		facets[f] = builder.current_facet();
+	}
+
+	builder.end_surface();
+	return facets;
+}
+
+
+std::size_t CompactMesh::size_of(ElementType type) const {
+	switch (type) {
+	case VERTEX:	return vertices_capacity();
+	case HALFEDGE:	return halfedges_capacity();
+	default:		return facets_capacity();
+	}
+}
+
+
+CompactMesh::Index CompactMesh::create(ElementType type) {
+	Index i = invalid;
+	if (!free_[type].empty()) {
+		i = free_[type].back();
+		free_[type].pop_back();
+	}
+
+	switch (type) {
+	case VERTEX:
+		if (i == invalid) {
+			i = static_cast<Index>(point_.size());
+			point_.push_back(vec3(0, 0, 0));
+			vertex_halfedge_.push_back(invalid);
+			vertex_deleted_.push_back(0);
+		}
+		vertex_halfedge_[i] = invalid;
+		vertex_deleted_[i] = 0;
+		break;
+	case HALFEDGE:
+		if (i == invalid) {
+			i = static_cast<Index>(halfedge_next_.size());
+			halfedge_next_.push_back(invalid);
+			halfedge_prev_.push_back(invalid);
+			halfedge_vertex_.push_back(invalid);
+			halfedge_facet_.push_back(invalid);
+			halfedge_deleted_.push_back(0);
+		}
+		halfedge_next_[i] = halfedge_prev_[i] = halfedge_vertex_[i] = halfedge_facet_[i] = invalid;
+		halfedge_deleted_[i] = 0;
+		break;
+	default:
+		if (i == invalid) {
+			i = static_cast<Index>(facet_halfedge_.size());
+			facet_halfedge_.push_back(invalid);
+			facet_deleted_.push_back(0);
+		}
+		facet_halfedge_[i] = invalid;
+		facet_deleted_[i] = 0;
+		break;
+	}
+
+	std::size_t size = size_of(type);
+	for (std::size_t k = 0; k < columns_[type].size(); ++k)
+		columns_[type][k]->created(i, size);
+	return i;
+}
+
+
+void CompactMesh::release(ElementType type, Index i) {
+	switch (type) {
+	case VERTEX:	ogf_assert(!vertex_deleted_[i]);	vertex_deleted_[i] = 1;		break;
+	case HALFEDGE:	ogf_assert(!halfedge_deleted_[i]);	halfedge_deleted_[i] = 1;	break;
+	default:		ogf_assert(!facet_deleted_[i]);		facet_deleted_[i] = 1;		break;
+	}
+	free_[type].push_back(i);
+}
+
+
+CompactMesh::Index CompactMesh::new_vertex(const vec3& p) {
+	Index v = create(VERTEX);
+	point_[v] = p;
+	return v;
+}
+
+
+CompactMesh::Index CompactMesh::new_edge() {
+	// the free halfedges are released in pairs, and the second one is on top
+	Index h1 = create(HALFEDGE);
+	Index h0 = create(HALFEDGE);
+	if (h0 > h1)
+		std::swap(h0, h1);
+	ogf_assert((h0 ^ 1) == h1);
+	set_next(h0, h1);
+	set_next(h1, h0);
+	return h0;
+}
+
+
+CompactMesh::Index CompactMesh::new_facet() {
+	return create(FACET);
+}
+
+
+void CompactMesh::delete_vertex(Index v) {
+	release(VERTEX, v);
+}
+
+
+void CompactMesh::delete_edge(Index h) {
+	Index h0 = h & ~Index(1);
+	release(HALFEDGE, h0);
+	release(HALFEDGE, h0 + 1);
+}
+
+
+void CompactMesh::delete_facet(Index f) {
+	release(FACET, f);
+}
+
+
+namespace {
+
+	// the new index of each element (keeping the order), and the number of the remaining ones
+	std::size_t pack(const std::vector<char>& deleted, std::vector<CompactMesh::Index>& map) {
+		map.resize(deleted.size());
+		std::size_t num = 0;
+		for (std::size_t i = 0; i < deleted.size(); ++i)
+			map[i] = deleted[i] ? CompactMesh::invalid : static_cast<CompactMesh::Index>(num++);
+		return num;
+	}
+
+	template <class T>
+	void move_elements(std::vector<T>& values, const std::vector<CompactMesh::Index>& map, std::size_t num) {
+		for (std::size_t i = 0; i < map.size(); ++i) {
+			if (map[i] != CompactMesh::invalid)
+				values[map[i]] = values[i];
+		}
+		values.resize(num);
+	}
+
+	inline CompactMesh::Index remap(CompactMesh::Index i, const std::vector<CompactMesh::Index>& map) {
+		return (i == CompactMesh::invalid) ? i : map[i];
+	}
+
+}
+
+
+void CompactMesh::collect_garbage(std::vector<Index>* vertex_map, std::vector<Index>* halfedge_map, std::vector<Index>* facet_map) {
+	std::vector<Index> vmap, hmap, fmap;
+	std::size_t nv = pack(vertex_deleted_, vmap);
+	std::size_t nh = pack(halfedge_deleted_, hmap);
+	std::size_t nf = pack(facet_deleted_, fmap);
+
+	move_elements(point_, vmap, nv);
+	move_elements(vertex_halfedge_, vmap, nv);
+	for (std::size_t i = 0; i < nv; ++i)
+		vertex_halfedge_[i] = remap(vertex_halfedge_[i], hmap);
+	vertex_deleted_.assign(nv, 0);
+
+	move_elements(halfedge_next_, hmap, nh);
+	move_elements(halfedge_prev_, hmap, nh);
+	move_elements(halfedge_vertex_, hmap, nh);
+	move_elements(halfedge_facet_, hmap, nh);
+	for (std::size_t i = 0; i < nh; ++i) {
+		halfedge_next_[i] = remap(halfedge_next_[i], hmap);
+		halfedge_prev_[i] = remap(halfedge_prev_[i], hmap);
+		halfedge_vertex_[i] = remap(halfedge_vertex_[i], vmap);
+		halfedge_facet_[i] = remap(halfedge_facet_[i], fmap);
+	}
+	halfedge_deleted_.assign(nh, 0);
+
+	move_elements(facet_halfedge_, fmap, nf);
+	for (std::size_t i = 0; i < nf; ++i)
+		facet_halfedge_[i] = remap(facet_halfedge_[i], hmap);
+	facet_deleted_.assign(nf, 0);
+
+	const std::vector<Index>* maps[3] = { &vmap, &hmap, &fmap };
+	const std::size_t sizes[3] = { nv, nh, nf };
+	for (int t = 0; t < 3; ++t) {
+		free_[t].clear();
+		const std::vector<Index>& map = *maps[t];
+		for (std::size_t k = 0; k < columns_[t].size(); ++k) {
+			CompactColumn* column = columns_[t][k];
+			for (std::size_t i = 0; i < map.size(); ++i) {
+				if (map[i] != invalid && map[i] != i)
+					column->moved(static_cast<Index>(i), map[i]);
+			}
+			column->shrink(sizes[t]);
+		}
+	}
+
+	if (vertex_map)		vertex_map->swap(vmap);
+	if (halfedge_map)	halfedge_map->swap(hmap);
+	if (facet_map)		facet_map->swap(fmap);
+}
+
+
+Box3d CompactMesh::bbox() const {
+	Box3d result;
+	FOR_EACH_COMPACT_VERTEX(this, v)
+		result.add_point(point_[v]);
+	return result;
+}
+
+
+void CompactMesh::attach(CompactColumn* column) {
+	columns_[column->element_type()].push_back(column);
+}
+
+
+void CompactMesh::detach(CompactColumn* column) {
+	std::vector<CompactColumn*>& columns = columns_[column->element_type()];
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		if (columns[i] == column) {
+			columns.erase(columns.begin() + i);
+			return;
+		}
+	}
+}
+
+
+//_________________________________________________________
+
+
+CompactColumn::CompactColumn(CompactMesh* mesh, CompactMesh::ElementType type) : mesh_(mesh), type_(type) {
+	mesh_->attach(this);
+}
+
+
+CompactColumn::~CompactColumn() {
+	if (mesh_)
+		mesh_->detach(this);
+}
+
+
+//_________________________________________________________
+
+
+namespace Geom {
+
+	vec3 facet_normal(const CompactMesh* mesh, CompactMesh::Index f) {
+		vec3 result(0, 0, 0);
+		CompactMesh::Index h = mesh->facet_halfedge(f);
+		CompactMesh::Index cir = h;
+		do {
+			vec3 v0 = mesh->vector(cir);
+			vec3 v1 = mesh->vector(mesh->opposite(mesh->prev(cir)));
+			result = result + cross(v0, v1);
+			cir = mesh->next(cir);
+		} while (cir != h);
+		return normalize(result);
+	}
+
+
+	double facet_area(const CompactMesh* mesh, CompactMesh::Index f) {
+		double result = 0;
+		CompactMesh::Index start = mesh->facet_halfedge(f);
+		const vec3& p = mesh->point(mesh->vertex(start));
+		CompactMesh::Index h = mesh->next(start);
+		do {
+			result += triangle_area(
+				p,
+				mesh->point(mesh->vertex(h)),
+				mesh->point(mesh->vertex(mesh->next(h)))
+				);
+			h = mesh->next(h);
+		} while (h != start);
+		return result;
+	}
+
+
+	Polygon3d facet_polygon(const CompactMesh* mesh, CompactMesh::Index f) {
+		Polygon3d plg;
+		CompactFacetHalfedgeCirculator cir(mesh, f);
+		for (; !cir->end(); ++cir)
+			plg.push_back(mesh->point(cir->vertex()));
+		return plg;
+	}
+
+}
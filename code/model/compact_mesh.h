@@ -0,0 +1,372 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _GEOM_COMPACT_MESH_H_
+#define _GEOM_COMPACT_MESH_H_
+
+#include "model_common.h"
+#include "map.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+/**
+* CompactMesh is an index-based halfedge mesh: the vertices, the halfedges and the facets are numbered, and
+* their links (next/prev/opposite/vertex/facet) are stored in contiguous arrays of 32-bit indices. The deleted
+* elements are kept in free lists (and reused by the next creations) until collect_garbage() packs the arrays.
+* The per-element data live in dense attribute columns (see CompactAttribute) that follow the packing.
+*
+* It is an alternative to Map for the traversal-heavy computations on large hypotheses: an up-to-date copy is 
+* made by assign(), and a Map is created from it by extract(). The conventions are those of Map: a halfedge
+* points to its target vertex, the border halfedges have no facet (i.e., CompactMesh::invalid).
+*/
+
+class CompactColumn;
+
+class MODEL_API CompactMesh
+{
+public:
+	typedef unsigned int Index;
+	static const Index invalid = 0xffffffff;
+
+	enum ElementType { VERTEX = 0, HALFEDGE = 1, FACET = 2 };
+
+	// the source elements of a copy (see assign()), indexed as in the compact mesh
+	struct MapElements {
+		std::vector<Map::Vertex*>	vertices;
+		std::vector<Map::Halfedge*>	halfedges;
+		std::vector<Map::Facet*>	facets;
+	};
+
+public:
+	CompactMesh() {}
+	CompactMesh(const Map* map) { assign(map); }
+	~CompactMesh();
+
+	// ________________________ conversion _____________________________
+
+	// Replaces the content by a copy of the topology and the geometry of 'map' (the attributes are not 
+	// copied). The elements are numbered in the order of the lists of 'map'.
+	void assign(const Map* map, MapElements* elements = nil);
+
+	// Appends the facets to 'map' (e.g., an empty one), and returns the new element of each facet. It goes
+	// through MapBuilder, which fixes the non-manifold vertices (as for the files).
+	std::vector<Map::Facet*> extract(Map* map) const;
+
+	void clear();
+
+	// ________________________ access _________________________________
+
+	// the sizes of the arrays, including the deleted elements (i.e., the valid indices)
+	std::size_t vertices_capacity() const	{ return vertex_halfedge_.size(); }
+	std::size_t halfedges_capacity() const	{ return halfedge_next_.size(); }
+	std::size_t facets_capacity() const		{ return facet_halfedge_.size(); }
+
+	// the numbers of the elements not deleted
+	std::size_t size_of_vertices() const	{ return vertices_capacity() - free_[VERTEX].size(); }
+	std::size_t size_of_halfedges() const	{ return halfedges_capacity() - free_[HALFEDGE].size(); }
+	std::size_t size_of_facets() const		{ return facets_capacity() - free_[FACET].size(); }
+
+	bool vertex_is_deleted(Index v) const	{ return vertex_deleted_[v] != 0; }
+	bool halfedge_is_deleted(Index h) const { return halfedge_deleted_[h] != 0; }
+	bool facet_is_deleted(Index f) const	{ return facet_deleted_[f] != 0; }
+
+	const vec3& point(Index v) const		{ return point_[v]; }
+	void set_point(Index v, const vec3& p)	{ point_[v] = p; }
+	Index vertex_halfedge(Index v) const	{ return vertex_halfedge_[v]; }	// a halfedge pointing to v
+
+	Index next(Index h) const		{ return halfedge_next_[h]; }
+	Index prev(Index h) const		{ return halfedge_prev_[h]; }
+	Index opposite(Index h) const	{ return h ^ 1; }	// the halfedges are created in pairs
+	Index vertex(Index h) const		{ return halfedge_vertex_[h]; }
+	Index facet(Index h) const		{ return halfedge_facet_[h]; }
+	bool  is_border(Index h) const	{ return halfedge_facet_[h] == invalid; }
+
+	Index facet_halfedge(Index f) const { return facet_halfedge_[f]; }
+
+	// ________________________ modification ___________________________
+
+	// The low-level operations (as those of MapMutator): the creations reuse the deleted elements, and
+	// the links are set by the caller.
+	Index new_vertex(const vec3& p);
+	Index new_edge();		// a pair of opposite halfedges, returns the first one
+	Index new_facet();
+
+	void delete_vertex(Index v);
+	void delete_edge(Index h);	// deletes h and its opposite
+	void delete_facet(Index f);
+
+	void set_vertex_halfedge(Index v, Index h)	{ vertex_halfedge_[v] = h; }
+	void set_next(Index h, Index n)				{ halfedge_next_[h] = n; halfedge_prev_[n] = h; }
+	void set_halfedge_vertex(Index h, Index v)	{ halfedge_vertex_[h] = v; }
+	void set_halfedge_facet(Index h, Index f)	{ halfedge_facet_[h] = f; }
+	void set_facet_halfedge(Index f, Index h)	{ facet_halfedge_[f] = h; }
+
+	// Removes the deleted elements from the arrays (and the attribute columns) and renumbers the others,
+	// keeping their order. Each 'map' (if provided) receives the new index of each old one (or invalid).
+	void collect_garbage(std::vector<Index>* vertex_map = nil, std::vector<Index>* halfedge_map = nil, std::vector<Index>* facet_map = nil);
+
+	// ________________________ geometry ________________________________
+
+	vec3 vector(Index h) const { return point_[vertex(h)] - point_[vertex(opposite(h))]; }
+
+	Box3d bbox() const;
+
+private:
+	// an element of a type is created (either at the end, or in a deleted place)
+	Index create(ElementType type);
+	void release(ElementType type, Index i);
+	std::size_t size_of(ElementType type) const;
+
+	friend class CompactColumn;
+	void attach(CompactColumn* column);
+	void detach(CompactColumn* column);
+
+	// forbids copying, the attributes are bound to a mesh
+	CompactMesh(const CompactMesh&);
+	CompactMesh& operator=(const CompactMesh&);
+
+private:
+	std::vector<vec3>	point_;
+	std::vector<Index>	vertex_halfedge_;
+	std::vector<char>	vertex_deleted_;
+
+	std::vector<Index>	halfedge_next_;
+	std::vector<Index>	halfedge_prev_;
+	std::vector<Index>	halfedge_vertex_;
+	std::vector<Index>	halfedge_facet_;
+	std::vector<char>	halfedge_deleted_;
+
+	std::vector<Index>	facet_halfedge_;
+	std::vector<char>	facet_deleted_;
+
+	std::vector<Index>			free_[3];		// the deleted elements of each type
+	std::vector<CompactColumn*>	columns_[3];	// the attributes on each type
+};
+
+
+//_________________________________________________________
+
+// The base of the attribute columns, which the mesh keeps in sync with its elements.
+class MODEL_API CompactColumn
+{
+public:
+	CompactColumn(CompactMesh* mesh, CompactMesh::ElementType type);
+	virtual ~CompactColumn();
+
+	CompactMesh* mesh() const { return mesh_; }
+	CompactMesh::ElementType element_type() const { return type_; }
+
+protected:
+	friend class CompactMesh;
+
+	// the element 'i' is created: the column grows to 'size' (if needed), and 'i' gets the default value
+	virtual void created(CompactMesh::Index i, std::size_t size) = 0;
+	// the element 'i' moves to 'to' (to <= i), then the column is shrunk to 'size'
+	virtual void moved(CompactMesh::Index i, CompactMesh::Index to) = 0;
+	virtual void shrink(std::size_t size) = 0;
+	
+	CompactMesh* mesh_;
+	CompactMesh::ElementType type_;
+};
+
+
+// A dense column of values, one per element of a type (indexed as the elements).
+template <class T>
+class CompactAttribute : public CompactColumn
+{
+public:
+	CompactAttribute(CompactMesh* mesh, CompactMesh::ElementType type, const T& default_value = T()) 
+		: CompactColumn(mesh, type), default_value_(default_value) 
+	{
+		values_.assign(size_of(mesh, type), default_value);
+	}
+
+	T& operator[](CompactMesh::Index i)				{ return values_[i]; }
+	const T& operator[](CompactMesh::Index i) const { return values_[i]; }
+
+	std::vector<T>& values()			 { return values_; }
+	const std::vector<T>& values() const { return values_; }
+
+protected:
+	virtual void created(CompactMesh::Index i, std::size_t size) {
+		if (values_.size() < size)
+			values_.resize(size, default_value_);
+		values_[i] = default_value_;
+	}
+	virtual void moved(CompactMesh::Index i, CompactMesh::Index to) { values_[to] = values_[i]; }
+	virtual void shrink(std::size_t size) { values_.resize(size); }
+
+	static std::size_t size_of(const CompactMesh* mesh, CompactMesh::ElementType type) {
+		switch (type) {
+		case CompactMesh::VERTEX:	return mesh->vertices_capacity();
+		case CompactMesh::HALFEDGE:	return mesh->halfedges_capacity();
+		default:					return mesh->facets_capacity();
+		}
+	}
+
+private:
+	std::vector<T>	values_;
+	T				default_value_;
+};
+
+
+template <class T>
+class CompactVertexAttribute : public CompactAttribute<T> {
+public:
+	CompactVertexAttribute(CompactMesh* mesh, const T& default_value = T()) : CompactAttribute<T>(mesh, CompactMesh::VERTEX, default_value) {}
+};
+
+template <class T>
+class CompactHalfedgeAttribute : public CompactAttribute<T> {
+public:
+	CompactHalfedgeAttribute(CompactMesh* mesh, const T& default_value = T()) : CompactAttribute<T>(mesh, CompactMesh::HALFEDGE, default_value) {}
+};
+
+template <class T>
+class CompactFacetAttribute : public CompactAttribute<T> {
+public:
+	CompactFacetAttribute(CompactMesh* mesh, const T& default_value = T()) : CompactAttribute<T>(mesh, CompactMesh::FACET, default_value) {}
+};
+
+
+//_________________________________________________________
+
+/* The circulators have the interface of those of map_circulators.h, on indices. Usage example:
+
+CompactFacetHalfedgeCirculator cir(mesh, f);
+for (; !cir->end(); ++cir) {
+	const vec3& p = mesh->point(cir->vertex());
+	// ...
+}
+*/
+
+class CompactCirculatorBase
+{
+public:
+	typedef CompactMesh::Index Index;
+
+	CompactCirculatorBase(const CompactMesh* mesh, Index h) : mesh_(mesh), end_(h), run_(h), steps_(0) {}
+
+	void reset() {
+		run_ = end_;
+		steps_ = 0;
+	}
+
+	// Return current vertex/halfedge pointed to by circulator.
+	Index vertex() const	{ return mesh_->vertex(run_); }
+	Index halfedge() const	{ return run_; }
+
+	Index opposite() const	{ return mesh_->opposite(run_); }
+	Index next() const		{ return mesh_->next(run_); }
+	Index prev() const		{ return mesh_->prev(run_); }
+
+	bool is_border() const		{ return mesh_->is_border(run_); }
+	bool is_border_edge() const { return mesh_->is_border(run_) || mesh_->is_border(opposite()); }
+
+	/// Has circulator come full circle?
+	bool end() const { return run_ == end_ && steps_ > 0; }
+
+	/// Return number of steps.
+	int size() const { return steps_; }
+
+protected:
+	const CompactMesh*	mesh_;
+	Index				end_;
+	Index				run_;
+	unsigned int		steps_;
+};
+
+
+// Circulator to move around a facet.
+class CompactFacetHalfedgeCirculator : public CompactCirculatorBase
+{
+public:
+	CompactFacetHalfedgeCirculator(const CompactMesh* mesh, Index f) : CompactCirculatorBase(mesh, mesh->facet_halfedge(f)) {}
+
+	// Return the adjacent face across the current halfedge.
+	Index facet() const { return mesh_->facet(opposite()); }
+
+	CompactFacetHalfedgeCirculator& operator++() {
+		run_ = mesh_->next(run_);
+		++steps_;
+		return *this;
+	}
+	CompactFacetHalfedgeCirculator& operator--() {
+		run_ = mesh_->prev(run_);
+		++steps_;
+		return *this;
+	}
+
+	/// Return a pointer to circulator self.
+	CompactFacetHalfedgeCirculator* operator->() { return this; }
+};
+
+
+// Circulator to move around a vertex, on the halfedges leaving it.
+class CompactVertexOutHalfedgeCirculator : public CompactCirculatorBase
+{
+public:
+	CompactVertexOutHalfedgeCirculator(const CompactMesh* mesh, Index v) : CompactCirculatorBase(mesh, mesh->opposite(mesh->vertex_halfedge(v))) {}
+
+	// Return the facet on the left of the current halfedge.
+	Index facet() const { return mesh_->facet(run_); }
+
+	CompactVertexOutHalfedgeCirculator& operator++() {
+		run_ = mesh_->next(mesh_->opposite(run_));
+		++steps_;
+		return *this;
+	}
+	CompactVertexOutHalfedgeCirculator& operator--() {
+		run_ = mesh_->opposite(mesh_->prev(run_));
+		++steps_;
+		return *this;
+	}
+
+	/// Return a pointer to circulator self.
+	CompactVertexOutHalfedgeCirculator* operator->() { return this; }
+};
+
+
+// the iterations on the elements not deleted (as those of iterators.h)
+#define FOR_EACH_COMPACT_VERTEX(mesh, v)		\
+	for (CompactMesh::Index v = 0; v < (mesh)->vertices_capacity(); ++v)	\
+		if (!(mesh)->vertex_is_deleted(v))
+
+#define FOR_EACH_COMPACT_HALFEDGE(mesh, h)		\
+	for (CompactMesh::Index h = 0; h < (mesh)->halfedges_capacity(); ++h)	\
+		if (!(mesh)->halfedge_is_deleted(h))
+
+#define FOR_EACH_COMPACT_FACET(mesh, f)		\
+	for (CompactMesh::Index f = 0; f < (mesh)->facets_capacity(); ++f)	\
+		if (!(mesh)->facet_is_deleted(f))
+
+
+namespace Geom {
+
+	// the same computations as those of map_geometry.h (and the same results for a copy of a Map)
+	MODEL_API vec3		facet_normal(const CompactMesh* mesh, CompactMesh::Index f);
+	MODEL_API double	facet_area(const CompactMesh* mesh, CompactMesh::Index f);
+	MODEL_API Polygon3d	facet_polygon(const CompactMesh* mesh, CompactMesh::Index f);
+
+}
+
+
+#endif
@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "frozen_map.h"
+#include "map_geometry.h"
+#include "iterators.h"
+#include "../basic/parallel.h"
+
+
+FrozenMap::FrozenMap(Map* map, unsigned int num_threads /* = 0 */)
+	: MapCombelObserver<Map::Vertex>(map)
+	, MapCombelObserver<Map::Halfedge>(map)
+	, MapCombelObserver<Map::Facet>(map)
+	, map_(map)
+	, valid_(true)
+	, facet_index_(nil)
+{
+	bbox_ = map->bbox() ;
+
+	vertices_.reserve(map->size_of_vertices()) ;
+	FOR_EACH_VERTEX_CONST(Map, map, it)
+		vertices_.push_back(it) ;
+
+	halfedges_.reserve(map->size_of_halfedges()) ;
+	FOR_EACH_HALFEDGE_CONST(Map, map, it)
+		halfedges_.push_back(it) ;
+
+	facet_index_attrib_.bind(map) ;
+	facets_.reserve(map->size_of_facets()) ;
+	FOR_EACH_FACET(Map, map, it) {
+		facet_index_attrib_[it] = static_cast<unsigned int>(facets_.size()) ;
+		facets_.push_back(it) ;
+	}
+	facet_index_ = new AttributeAccessor<Map::Facet, unsigned int>(facet_index_attrib_) ;
+
+	facet_normals_.resize(facets_.size()) ;
+	facet_areas_.resize(facets_.size()) ;
+	parallel_for(facets_.size(), [&](std::size_t i) {
+		facet_normals_[i] = Geom::facet_normal(facets_[i]) ;
+		facet_areas_[i] = Geom::facet_area(facets_[i]) ;
+	}, nil, num_threads) ;
+}
+
+
+FrozenMap::~FrozenMap() {
+	delete facet_index_ ;
+	facet_index_attrib_.unbind() ;
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _GEOM_FROZEN_MAP_H_
+#define _GEOM_FROZEN_MAP_H_
+
+#include "model_common.h"
+#include "map.h"
+#include "map_attributes.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+/**
+* FrozenMap is a read-only view of a map for the parallel algorithms. Everything a reader 
+* may otherwise compute lazily is resolved when the view is created (the bounding box, the 
+* element arrays, the index of each facet, and the normal and the area of the facets), so 
+* any number of threads can traverse and read the view and its map without locks.
+*
+* The view is created by one thread, and the map must not be modified while it is in use 
+* (is_valid() turns false on any creation or deletion of an element). The other attributes 
+* the readers need are bound before the parallel section, and read through AttributeAccessor 
+* (binding an attribute creates a store in the map, which is not thread-safe).
+*/
+
+class MODEL_API FrozenMap 
+	: public MapCombelObserver<Map::Vertex>
+	, public MapCombelObserver<Map::Halfedge>
+	, public MapCombelObserver<Map::Facet>
+{
+public:
+	// the facet geometry is computed with up to 'num_threads' threads (0 means all)
+	FrozenMap(Map* map, unsigned int num_threads = 0) ;
+	virtual ~FrozenMap() ;
+
+	const Map* map() const { return map_ ; }
+	bool is_valid() const { return valid_ ; }
+
+	const Box3d& bbox() const { return bbox_ ; }
+
+	std::size_t nb_vertices() const  { return vertices_.size() ; }
+	std::size_t nb_halfedges() const { return halfedges_.size() ; }
+	std::size_t nb_facets() const    { return facets_.size() ; }
+
+	const Map::Vertex* vertex(std::size_t i) const		{ return vertices_[i] ; }
+	const Map::Halfedge* halfedge(std::size_t i) const	{ return halfedges_[i] ; }
+	const Map::Facet* facet(std::size_t i) const		{ return facets_[i] ; }
+
+	const std::vector<const Map::Facet*>& facets() const { return facets_ ; }
+
+	// the position of f in facets()
+	unsigned int facet_index(const Map::Facet* f) const { return (*facet_index_)[f] ; }
+
+	const vec3& facet_normal(std::size_t i) const { return facet_normals_[i] ; }
+	double facet_area(std::size_t i) const { return facet_areas_[i] ; }
+	const vec3& facet_normal(const Map::Facet* f) const { return facet_normals_[facet_index(f)] ; }
+	double facet_area(const Map::Facet* f) const { return facet_areas_[facet_index(f)] ; }
+
+	// MapCombelObserver interface
+	virtual void add(Map::Vertex* v)		{ valid_ = false ; }
+	virtual void remove(Map::Vertex* v)		{ valid_ = false ; }
+	virtual void add(Map::Halfedge* h)		{ valid_ = false ; }
+	virtual void remove(Map::Halfedge* h)	{ valid_ = false ; }
+	virtual void add(Map::Facet* f)			{ valid_ = false ; }
+	virtual void remove(Map::Facet* f)		{ valid_ = false ; }
+
+private:
+	const Map*	map_ ;
+	bool		valid_ ;
+	Box3d		bbox_ ;
+
+	std::vector<const Map::Vertex*>		vertices_ ;
+	std::vector<const Map::Halfedge*>	halfedges_ ;
+	std::vector<const Map::Facet*>		facets_ ;
+
+	MapFacetAttribute<unsigned int>					facet_index_attrib_ ;
+	AttributeAccessor<Map::Facet, unsigned int>*	facet_index_ ;	// resolved once all the records exist
+	std::vector<vec3>								facet_normals_ ;
+	std::vector<double>								facet_areas_ ;
+} ;
+
+#endif
@@ -0,0 +1,460 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "grid_search.h"
+#include "../basic/parallel.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <cfloat>
+#include <cmath>
+
+
+namespace {
+	// the points found by a query of the calling thread, as (squared distance, index). For the
+	// K nearest neighbor queries, it is a max-heap of the K closest points found so far.
+	typedef std::pair<float, unsigned int>	Found;
+	thread_local std::vector<Found>	found;
+
+	// the number of points per occupied cell aimed at when the cell size is chosen from the points
+	const double target_points_per_cell = 8.0;
+
+	// the number of bits of the cell coordinates in the keys of the cells
+	const int key_bits = 21;
+	const int max_cells_per_axis = 1 << (key_bits - 1);
+
+	// the cell coordinates are clamped to this, which keeps them (and their differences) in 
+	// the range of an int for any query point
+	const double max_cell_coordinate = double(1 << 29);
+}
+
+
+GridSearch::GridSearch(double cell_size /* = 0 */)  
+: user_cell_size_(cell_size)
+, cell_size_(1.0)
+, origin_(0, 0, 0)
+, occupancy_variation_(0.0)
+{
+	dims_[0] = dims_[1] = dims_[2] = 0;
+}
+
+
+GridSearch::~GridSearch() {
+}
+
+
+void GridSearch::cell_of(const vec3& p, int cell[3]) const {
+	for (int a = 0; a < 3; ++a) {
+		double c = std::floor((double(p[a]) - origin_[a]) / cell_size_);
+		c = ogf_max(-max_cell_coordinate, ogf_min(c, max_cell_coordinate));
+		cell[a] = int(c);
+	}
+}
+
+
+Numeric::uint64 GridSearch::key_of(int i, int j, int k) {
+	return Numeric::uint64(i) | (Numeric::uint64(j) << key_bits) | (Numeric::uint64(k) << (2 * key_bits));
+}
+
+
+std::size_t GridSearch::count_occupied_cells(const vec3* points, std::size_t n, const vec3& origin, double cell_size) {
+	std::unordered_set<Numeric::uint64> keys;
+	keys.reserve(n / 4);
+	for (std::size_t i = 0; i < n; ++i) {
+		const vec3& p = points[i];
+		int i0 = int((p.x - origin.x) / cell_size);
+		int j0 = int((p.y - origin.y) / cell_size);
+		int k0 = int((p.z - origin.z) / cell_size);
+		keys.insert(key_of(i0, j0, k0));
+	}
+	return keys.size();
+}
+
+
+double GridSearch::auto_cell_size(const vec3* points, std::size_t n, const Box3d& box) {
+	double extent[3] = { box.width(), box.height(), box.depth() };
+	double max_extent = ogf_max(extent[0], ogf_max(extent[1], extent[2]));
+	double min_cell_size = ogf_max(max_extent / max_cells_per_axis, 1e-20);
+
+	// first, as if the points filled the bounding box
+	double volume = 1.0;
+	for (int a = 0; a < 3; ++a)
+		volume *= ogf_max(extent[a], max_extent * 1e-3);
+	double cell_size = ogf_max(std::cbrt(volume * target_points_per_cell / n), min_cell_size);
+
+	// most points lie on surfaces, so the cells are enlarged (as for a 2D distribution) if they 
+	// have less points than aimed at
+	const vec3 origin(box.x_min(), box.y_min(), box.z_min());
+	double average = double(n) / count_occupied_cells(points, n, origin, cell_size);
+	if (average < target_points_per_cell)
+		cell_size *= std::sqrt(target_points_per_cell / average);
+	return cell_size;
+}
+
+
+void GridSearch::build(const std::vector<vec3>& points, unsigned int num_threads /* = 0 */) {
+	points_.clear();
+	indices_.clear();
+	cells_.clear();
+	occupancy_variation_ = 0.0;
+	dims_[0] = dims_[1] = dims_[2] = 0;
+	if (points.empty())
+		return;
+
+	Box3d box;
+	for (std::size_t i = 0; i < points.size(); ++i)
+		box.add_point(points[i]);
+	origin_ = vec3(box.x_min(), box.y_min(), box.z_min());
+
+	double extent[3] = { box.width(), box.height(), box.depth() };
+	double max_extent = ogf_max(extent[0], ogf_max(extent[1], extent[2]));
+	// the cells must be large enough for their coordinates to fit in the keys
+	double min_cell_size = ogf_max(max_extent / max_cells_per_axis, 1e-20);
+
+	if (user_cell_size_ > 0)
+		cell_size_ = ogf_max(user_cell_size_, min_cell_size);
+	else
+		cell_size_ = auto_cell_size(points.data(), points.size(), box);
+
+	for (int a = 0; a < 3; ++a)
+		dims_[a] = ogf_min(int(extent[a] / cell_size_) + 1, max_cells_per_axis);
+
+	// sort the points by cell (and by index in each cell)
+	std::size_t n = points.size();
+	std::vector< std::pair<Numeric::uint64, unsigned int> > keys(n);
+	parallel_for(n, [&](std::size_t i) {
+		int cell[3];
+		cell_of(points[i], cell);
+		for (int a = 0; a < 3; ++a)
+			cell[a] = ogf_min(cell[a], dims_[a] - 1);
+		keys[i] = std::make_pair(key_of(cell[0], cell[1], cell[2]), static_cast<unsigned int>(i));
+	}, nil, num_threads);
+	std::sort(keys.begin(), keys.end());
+	build_cells(points, keys);
+}
+
+
+void GridSearch::build_cells(const std::vector<vec3>& points, const Keys& keys) {
+	const std::size_t n = keys.size();
+	points_.resize(n);
+	indices_.resize(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		indices_[i] = keys[i].second;
+		points_[i] = points[keys[i].second];
+	}
+
+	for (std::size_t i = 0; i < n; ) {
+		std::size_t j = i + 1;
+		while (j < n && keys[j].first == keys[i].first)
+			++j;
+		cells_[keys[i].first] = Range(static_cast<unsigned int>(i), static_cast<unsigned int>(j));
+		i = j;
+	}
+
+	double mean = double(n) / cells_.size();
+	double variance = 0.0;
+	std::unordered_map<Numeric::uint64, Range>::const_iterator it = cells_.begin();
+	for (; it != cells_.end(); ++it)
+		variance += ogf_sqr(double(it->second.second - it->second.first) - mean);
+	variance /= cells_.size();
+	occupancy_variation_ = std::sqrt(variance) / mean;
+}
+
+
+namespace {
+	// the cells relative to the anchor are offset by this, for their coordinates to be positive
+	const Numeric::int64 chunk_offset = Numeric::int64(1) << (key_bits - 1);
+	const Numeric::uint64 cell_mask = (Numeric::uint64(1) << key_bits) - 1;
+
+	Numeric::int64 absolute_cell(float x, double cell_size) {
+		// exact for a power of two cell size
+		return static_cast<Numeric::int64>(std::floor(double(x) / cell_size));
+	}
+}
+
+
+double GridSearch::chunk_cell_size(const vec3* points, std::size_t n, double cell_size /* = 0 */) {
+	if (cell_size <= 0) {
+		if (n == 0)
+			return 1.0;
+		Box3d box;
+		for (std::size_t i = 0; i < n; ++i)
+			box.add_point(points[i]);
+		cell_size = auto_cell_size(points, n, box);
+	}
+	return std::exp2(std::round(std::log2(cell_size)));
+}
+
+
+bool GridSearch::chunk_keys(const vec3* points, std::size_t first, std::size_t n, double cell_size, const vec3& anchor, Keys& keys) {
+	Numeric::int64 base[3];
+	for (int a = 0; a < 3; ++a)
+		base[a] = absolute_cell(anchor[a], cell_size) - chunk_offset;
+
+	keys.resize(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		Numeric::uint64 key = 0;
+		for (int a = 0; a < 3; ++a) {
+			Numeric::int64 c = absolute_cell(points[i][a], cell_size) - base[a];
+			if (c < 0 || c > Numeric::int64(cell_mask))
+				return false;
+			key |= Numeric::uint64(c) << (a * key_bits);
+		}
+		keys[i] = std::make_pair(key, static_cast<unsigned int>(first + i));
+	}
+	std::sort(keys.begin(), keys.end());
+	return true;
+}
+
+
+bool GridSearch::build_from_chunks(const std::vector<vec3>& points, double cell_size, const vec3& anchor, Keys& keys) {
+	points_.clear();
+	indices_.clear();
+	cells_.clear();
+	occupancy_variation_ = 0.0;
+	dims_[0] = dims_[1] = dims_[2] = 0;
+	if (keys.size() != points.size() || points.empty())
+		return false;
+
+	// the range of the cells, which becomes the grid
+	Numeric::uint64 lo[3] = { cell_mask, cell_mask, cell_mask };
+	Numeric::uint64 hi[3] = { 0, 0, 0 };
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		for (int a = 0; a < 3; ++a) {
+			Numeric::uint64 c = (keys[i].first >> (a * key_bits)) & cell_mask;
+			lo[a] = ogf_min(lo[a], c);
+			hi[a] = ogf_max(hi[a], c);
+		}
+	}
+
+	// the origin must be exact as a float for cell_of() to find the cells of the chunks
+	vec3 origin;
+	for (int a = 0; a < 3; ++a) {
+		if (hi[a] - lo[a] + 1 > Numeric::uint64(max_cells_per_axis))
+			return false;
+		Numeric::int64 base = absolute_cell(anchor[a], cell_size) - chunk_offset + Numeric::int64(lo[a]);
+		double o = double(base) * cell_size;
+		if (double(float(o)) != o)
+			return false;
+		origin[a] = float(o);
+		dims_[a] = int(hi[a] - lo[a] + 1);
+	}
+	cell_size_ = cell_size;
+	origin_ = origin;
+
+	// the cells relative to the lowest one (without borrows, the coordinates are above it)
+	const Numeric::uint64 lowest = lo[0] | (lo[1] << key_bits) | (lo[2] << (2 * key_bits));
+	parallel_for(keys.size(), [&](std::size_t i) { keys[i].first -= lowest; });
+	build_cells(points, keys);
+	return true;
+}
+
+
+void GridSearch::search_cell(const vec3& p, int i, int j, int k, float max_squared_distance, unsigned int max_found) const {
+	std::unordered_map<Numeric::uint64, Range>::const_iterator it = cells_.find(key_of(i, j, k));
+	if (it == cells_.end())
+		return;
+
+	for (unsigned int m = it->second.first; m < it->second.second; ++m) {
+		float sd = distance2(points_[m], p);
+		if (max_found == 0) {			// all the points in the range
+			if (sd < max_squared_distance)
+				found.push_back(Found(sd, indices_[m]));
+		}
+		else {
+			Found f(sd, indices_[m]);
+			if (found.size() < max_found) {
+				found.push_back(f);
+				std::push_heap(found.begin(), found.end());
+			}
+			else if (f < found.front()) {
+				std::pop_heap(found.begin(), found.end());
+				found.back() = f;
+				std::push_heap(found.begin(), found.end());
+			}
+		}
+	}
+}
+
+
+void GridSearch::search_ring(const vec3& p, const int center[3], int ring, unsigned int k) const {
+	int lo[3], hi[3];
+	for (int a = 0; a < 3; ++a) {
+		lo[a] = ogf_max(center[a] - ring, 0);
+		hi[a] = ogf_min(center[a] + ring, dims_[a] - 1);
+	}
+
+	for (int i = lo[0]; i <= hi[0]; ++i) {
+		bool i_on_ring = (std::abs(i - center[0]) == ring);
+		for (int j = lo[1]; j <= hi[1]; ++j) {
+			if (i_on_ring || std::abs(j - center[1]) == ring) {
+				for (int l = lo[2]; l <= hi[2]; ++l)
+					search_cell(p, i, j, l, FLT_MAX, k);
+			}
+			else {		// only the two cells on the ring
+				if (center[2] - ring >= 0 && center[2] - ring < dims_[2])
+					search_cell(p, i, j, center[2] - ring, FLT_MAX, k);
+				if (ring > 0 && center[2] + ring >= 0 && center[2] + ring < dims_[2])
+					search_cell(p, i, j, center[2] + ring, FLT_MAX, k);
+			}
+		}
+	}
+}
+
+
+void GridSearch::collect_K_points(const vec3& p, unsigned int k) const {
+	found.clear();
+	if (k == 0 || points_.empty())
+		return;
+
+	int center[3];
+	cell_of(p, center);
+
+	// the rings closer than 'first' are outside the grid, and the ones farther than 'last' too
+	int first = 0, last = 0;
+	for (int a = 0; a < 3; ++a) {
+		first = ogf_max(first, ogf_max(-center[a], center[a] - (dims_[a] - 1)));
+		last = ogf_max(last, ogf_max(center[a], dims_[a] - 1 - center[a]));
+	}
+
+	for (int ring = first; ring <= last; ++ring) {
+		search_ring(p, center, ring, k);
+		if (found.size() < k)
+			continue;
+
+		// the distance from p to the next ring
+		double bound = DBL_MAX;
+		for (int a = 0; a < 3; ++a) {
+			double lo = origin_[a] + double(center[a] - ring) * cell_size_;
+			double hi = origin_[a] + double(center[a] + ring + 1) * cell_size_;
+			bound = ogf_min(bound, ogf_min(double(p[a]) - lo, hi - double(p[a])));
+		}
+		if (found.front().first < ogf_sqr(bound * (1.0 + epsilon_)))
+			break;
+	}
+	std::sort_heap(found.begin(), found.end());
+}
+
+
+void GridSearch::collect_points_in_radius(const vec3& p, double squared_radius) const {
+	found.clear();
+	if (points_.empty())
+		return;
+
+	double radius = std::sqrt(squared_radius);
+	int lo[3], hi[3];
+	for (int a = 0; a < 3; ++a) {
+		double l = std::floor((double(p[a]) - radius - origin_[a]) / cell_size_);
+		double h = std::floor((double(p[a]) + radius - origin_[a]) / cell_size_);
+		lo[a] = int(ogf_max(l, 0.0));
+		hi[a] = int(ogf_min(h, double(dims_[a] - 1)));
+		if (lo[a] > hi[a])
+			return;
+	}
+
+	double num_cells = double(hi[0] - lo[0] + 1) * double(hi[1] - lo[1] + 1) * double(hi[2] - lo[2] + 1);
+	if (num_cells > cells_.size()) {	// a huge range: faster to test all the points
+		for (std::size_t m = 0; m < points_.size(); ++m) {
+			float sd = distance2(points_[m], p);
+			if (sd < float(squared_radius))
+				found.push_back(Found(sd, indices_[m]));
+		}
+	}
+	else {
+		for (int i = lo[0]; i <= hi[0]; ++i)
+			for (int j = lo[1]; j <= hi[1]; ++j)
+				for (int k = lo[2]; k <= hi[2]; ++k)
+					search_cell(p, i, j, k, float(squared_radius), 0);
+	}
+	std::sort(found.begin(), found.end());
+}
+
+
+int GridSearch::find_closest_point(const vec3& p) const {
+	collect_K_points(p, 1);
+	if (found.size() == 1)
+		return found[0].second;
+	else
+		return -1;
+}
+
+
+int GridSearch::find_closest_point(const vec3& p, double& squared_distance) const {
+	collect_K_points(p, 1);
+	if (found.size() == 1) {
+		squared_distance = found[0].first;
+		return found[0].second;
+	}
+	else
+		return -1;
+}
+
+
+void GridSearch::find_closest_K_points(
+	const vec3& p, unsigned int k, std::vector<unsigned int>& neighbors
+	) const {
+		collect_K_points(p, k);
+
+		std::size_t num = found.size();
+		neighbors.resize(num);
+		for (std::size_t i = 0; i < num; ++i)
+			neighbors[i] = found[i].second;
+}
+
+
+void GridSearch::find_closest_K_points(
+	const vec3& p, unsigned int k, std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
+	) const {
+		collect_K_points(p, k);
+
+		std::size_t num = found.size();
+		neighbors.resize(num);
+		squared_distances.resize(num);
+		for (std::size_t i = 0; i < num; ++i) {
+			neighbors[i] = found[i].second;
+			squared_distances[i] = found[i].first;
+		}
+}
+
+
+void GridSearch::find_points_in_radius(
+	const vec3& p, double squared_radius, std::vector<unsigned int>& neighbors
+	) const {
+		collect_points_in_radius(p, squared_radius);
+
+		std::size_t num = found.size();
+		neighbors.resize(num);
+		for (std::size_t i = 0; i < num; ++i)
+			neighbors[i] = found[i].second;
+}
+
+
+void GridSearch::find_points_in_radius(
+	const vec3& p, double squared_radius, std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
+	) const {
+		collect_points_in_radius(p, squared_radius);
+
+		std::size_t num = found.size();
+		neighbors.resize(num);
+		squared_distances.resize(num);
+		for (std::size_t i = 0; i < num; ++i) {
+			neighbors[i] = found[i].second;
+			squared_distances[i] = found[i].first;
+		}
+}
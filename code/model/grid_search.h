@@ -0,0 +1,144 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MODEL_GRID_SEARCH_H_
+#define _MODEL_GRID_SEARCH_H_
+
+#include "point_search.h"
+
+#include <unordered_map>
+
+
+// A uniform grid of cubic cells, only the occupied cells being stored (in a hash table). For the
+// points of roughly uniform density (e.g., LiDAR scans), its radius queries visit fewer points than
+// the ones of a kd-tree, and its K nearest neighbor queries search the rings of cells around the 
+// query point until no closer point can be found.
+class MODEL_API GridSearch : public PointSearch {
+public:
+	// 'cell_size' 0 means chosen from the points, with a few points per occupied cell
+	GridSearch(double cell_size = 0);
+	virtual ~GridSearch();
+
+	virtual Backend backend() const { return GRID; }
+
+	virtual void build(const std::vector<vec3>& points, unsigned int num_threads = 0) ;
+
+	double cell_size() const { return cell_size_; }
+	std::size_t num_occupied_cells() const { return cells_.size(); }
+
+	// the standard deviation of the numbers of points in the occupied cells, relative to their mean
+	// (0 for a perfectly uniform distribution)
+	double occupancy_variation() const { return occupancy_variation_; }
+
+	//______________ construction by chunks ______________________
+
+	// The cells of the points can also be sorted by chunks, from any threads at the same time, e.g., 
+	// as the points are read (see StreamingIndexBuilder): chunk_keys() computes the sorted cells of a 
+	// chunk relative to an 'anchor' (any point, the same for all the chunks), and the chunks merged 
+	// (still sorted) make the grid in build_from_chunks(). The cell size is a power of two (see 
+	// chunk_cell_size()), for the cells relative to the anchor to be exactly the ones of the grid.
+	// chunk_keys() returns false if a point is too far from the anchor, and build_from_chunks() 
+	// if the points span too many cells, then build() is needed.
+	typedef std::vector< std::pair<Numeric::uint64, unsigned int> >	Keys;
+
+	// the cell size build() would choose for the n 'points' (or 'cell_size' if it is not 0), rounded
+	// to a power of two
+	static double chunk_cell_size(const vec3* points, std::size_t n, double cell_size = 0);
+
+	// the sorted cells of the n 'points', whose indices start at 'first'
+	static bool chunk_keys(const vec3* points, std::size_t first, std::size_t n, double cell_size, const vec3& anchor, Keys& keys);
+
+	// 'keys' are the merged chunks of all the 'points' (they are modified)
+	bool build_from_chunks(const std::vector<vec3>& points, double cell_size, const vec3& anchor, Keys& keys);
+
+	//________________ closest point ____________________________
+
+	virtual int find_closest_point(const vec3& p, double& squared_distance) const ;
+	virtual int find_closest_point(const vec3& p) const ;
+
+	//_________________ K-nearest neighbors ____________________
+
+	virtual void find_closest_K_points(
+		const vec3& p, unsigned int k, 
+		std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
+		) const ;
+
+	virtual void find_closest_K_points(
+		const vec3& p, unsigned int k, 
+		std::vector<unsigned int>& neighbors
+		) const ;
+
+	using PointSearch::find_closest_K_points;
+
+	//___________________ radius search __________________________
+
+	virtual void find_points_in_radius(const vec3& p, double squared_radius, 
+		std::vector<unsigned int>& neighbors
+		) const ;
+
+	virtual void find_points_in_radius(const vec3& p, double squared_radius, 
+		std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
+		) const ;
+
+	using PointSearch::find_points_in_radius;
+
+protected:
+	// the cell containing p (possibly outside the grid)
+	void cell_of(const vec3& p, int cell[3]) const ;
+	static Numeric::uint64 key_of(int i, int j, int k) ;
+
+	// the cell size with a few points per occupied cell for the n 'points' in 'box'
+	static double auto_cell_size(const vec3* points, std::size_t n, const Box3d& box) ;
+
+	// the number of occupied cells for the given cell size and origin
+	static std::size_t count_occupied_cells(const vec3* points, std::size_t n, const vec3& origin, double cell_size) ;
+
+	// the points, the ranges of the cells and the occupancy variation from the 'keys' of the points
+	// sorted by cell
+	void build_cells(const std::vector<vec3>& points, const Keys& keys) ;
+
+	// adds the points of a cell to the points found: the ones closer than 'max_squared_distance' if
+	// 'max_found' is 0, otherwise the ones among the 'max_found' closest points so far
+	void search_cell(const vec3& p, int i, int j, int k, float max_squared_distance, unsigned int max_found) const ;
+
+	// searches the cells at Chebyshev distance 'ring' from the cell 'center' for the k closest points
+	void search_ring(const vec3& p, const int center[3], int ring, unsigned int k) const ;
+
+	void collect_K_points(const vec3& p, unsigned int k) const ;
+	void collect_points_in_radius(const vec3& p, double squared_radius) const ;
+
+protected:
+	double		user_cell_size_;
+	double		cell_size_;
+	vec3		origin_;
+	int			dims_[3];		// the number of cells along the axes (the ones beyond are empty)
+	double		occupancy_variation_;
+
+	std::vector<vec3>			points_;	// the points sorted by cell
+	std::vector<unsigned int>	indices_;	// their indices in the points given to build()
+
+	// the range [first, second) of the points of each occupied cell in points_
+	typedef std::pair<unsigned int, unsigned int>	Range;
+	std::unordered_map<Numeric::uint64, Range>	cells_;
+} ;
+
+
+typedef	SmartPointer<GridSearch>	GridSearch_var;
+
+#endif
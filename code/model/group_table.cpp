@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "group_table.h"
+#include "point_set.h"
+#include "../math/plane_fitting.h"
+
+#include <algorithm>
+
+
+void GroupTable::clear() {
+	offsets_.assign(1, 0);
+	indices_.clear();
+	a_.clear();	b_.clear();	c_.clear();	d_.clear();
+	labels_.clear();
+	colors_.clear();
+	parents_.clear();
+	num_top_level_ = 0;
+}
+
+
+void GroupTable::build(const std::vector<VertexGroup::Ptr>& groups) {
+	clear();
+
+	std::size_t num_groups = groups.size(), num_indices = 0;
+	bool has_children = false;
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		num_indices += groups[i]->size();
+		std::vector<VertexGroup*> children = groups[i]->children();
+		for (std::size_t j = 0; j < children.size(); ++j)
+			num_indices += children[j]->size();
+		num_groups += children.size();
+		has_children |= !children.empty();
+	}
+	offsets_.reserve(num_groups + 1);
+	indices_.reserve(num_indices);
+	a_.reserve(num_groups);	b_.reserve(num_groups);	c_.reserve(num_groups);	d_.reserve(num_groups);
+	labels_.reserve(num_groups);
+	colors_.reserve(num_groups);
+
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		add(groups[i], -1);
+	num_top_level_ = groups.size();
+
+	if (has_children) {
+		parents_.assign(num_top_level_, -1);
+		for (std::size_t i = 0; i < groups.size(); ++i) {
+			std::vector<VertexGroup*> children = groups[i]->children();
+			for (std::size_t j = 0; j < children.size(); ++j)
+				add(children[j], static_cast<int>(i));
+		}
+	}
+}
+
+
+void GroupTable::add(const VertexGroup* g, int parent) {
+	indices_.insert(indices_.end(), g->begin(), g->end());
+	offsets_.push_back(indices_.size());
+
+	const Plane3d& plane = g->plane();
+	a_.push_back(plane.a());
+	b_.push_back(plane.b());
+	c_.push_back(plane.c());
+	d_.push_back(plane.d());
+
+	labels_.push_back(g->label());
+	colors_.push_back(g->color());
+	if (parent >= 0)
+		parents_.push_back(parent);
+}
+
+
+void GroupTable::set_plane(std::size_t g, const Plane3d& plane) {
+	a_[g] = plane.a();
+	b_[g] = plane.b();
+	c_[g] = plane.c();
+	d_[g] = plane.d();
+}
+
+
+void GroupTable::fit_planes(const std::vector<vec3>& points, std::size_t first, std::size_t last, unsigned int num_threads) {
+	std::vector<Plane3d> planes;
+	PlaneFitting::fit(points, indices_.data(), &offsets_[first], last - first, planes, num_threads);
+	for (std::size_t g = first; g < last; ++g)
+		set_plane(g, planes[g - first]);
+}
+
+
+float GroupTable::max_squared_distance(std::size_t g, const std::vector<vec3>& points) const {
+	float dist = plane(g).max_distance(points.data(), begin(g), num_points(g));
+	return dist * dist;
+}
+
+
+void GroupTable::assign_to(PointSet* pset) const {
+	std::vector<VertexGroup::Ptr>& groups = pset->groups();
+	groups.clear();
+	for (std::size_t i = 0; i < size(); ++i) {
+		VertexGroup* g = new VertexGroup(pset);
+		g->assign(begin(i), end(i));
+		g->set_plane(plane(i));
+		g->set_label(labels_[i]);
+		g->set_color(colors_[i]);
+		if (i < num_top_level_)
+			groups.push_back(g);
+		else
+			groups[parents_[i]]->add_child(g);
+	}
+}
+
+
+MemoryUsage GroupTable::memory_usage() const {
+	MemoryUsage usage;
+	usage.add("indices", MemoryUsage::of(offsets_) + MemoryUsage::of(indices_));
+	usage.add("planes", MemoryUsage::of(a_) + MemoryUsage::of(b_) + MemoryUsage::of(c_) + MemoryUsage::of(d_));
+	double labels = MemoryUsage::of(labels_);
+	for (std::size_t i = 0; i < labels_.size(); ++i)
+		labels += labels_[i].capacity();
+	usage.add("labels", labels);
+	usage.add("colors", MemoryUsage::of(colors_));
+	usage.add("hierarchy", MemoryUsage::of(parents_));
+	return usage;
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _GROUP_TABLE_H_
+#define _GROUP_TABLE_H_
+
+#include "model_common.h"
+#include "vertex_group.h"
+#include "../basic/memory_usage.h"
+
+#include <string>
+#include <vector>
+
+
+class PointSet;
+
+/**
+* A compact table of vertex groups: the point indices of all the groups in one contiguous array
+* (group i has the indices [offset(i), offset(i + 1))), the planes in parallel arrays of their
+* coefficients, and the labels, colors and hierarchy in side tables. The children of the groups
+* follow the top-level groups, and the parents are only stored if there are children.
+*
+* It is built from the vertex groups of a point set (which stay the interface of the rest of the
+* code, e.g., to edit the groups), and it makes the loops over all the points of all the groups 
+* read memory in order.
+*/
+
+class MODEL_API GroupTable
+{
+public:
+	GroupTable() : offsets_(1, 0), num_top_level_(0) {}
+	GroupTable(const std::vector<VertexGroup::Ptr>& groups) { build(groups); }
+
+	// the groups and their children
+	void build(const std::vector<VertexGroup::Ptr>& groups);
+	void clear();
+
+	std::size_t size() const { return offsets_.size() - 1; }
+	// the groups [0, num_top_level()) have no parent
+	std::size_t num_top_level() const { return num_top_level_; }
+
+	std::size_t num_points(std::size_t g) const { return offsets_[g + 1] - offsets_[g]; }
+	const unsigned int* begin(std::size_t g) const { return indices_.data() + offsets_[g]; }
+	const unsigned int* end(std::size_t g) const { return indices_.data() + offsets_[g + 1]; }
+
+	Plane3d plane(std::size_t g) const { return Plane3d(a_[g], b_[g], c_[g], d_[g]); }
+	void set_plane(std::size_t g, const Plane3d& plane);
+
+	// the same as plane(g).squared_ditance(p)
+	float squared_distance(std::size_t g, const vec3& p) const {
+		float v = a_[g] * p.x + b_[g] * p.y + c_[g] * p.z + d_[g];
+		return (v * v) / (a_[g] * a_[g] + b_[g] * b_[g] + c_[g] * c_[g]);
+	}
+	// fits the planes of the groups [first, last) to their points (see PlaneFitting), in parallel
+	void fit_planes(const std::vector<vec3>& points, std::size_t first, std::size_t last, unsigned int num_threads = 0);
+
+	// the largest squared distance of the points of group g to its plane (0 if it has no points)
+	float max_squared_distance(std::size_t g, const std::vector<vec3>& points) const;
+
+	const std::string& label(std::size_t g) const { return labels_[g]; }
+	const Color& color(std::size_t g) const { return colors_[g]; }
+	// the index of the parent of group g (-1 for the top-level groups)
+	int parent(std::size_t g) const { return parents_.empty() ? -1 : parents_[g]; }
+
+	// creates the vertex groups of 'pset' (and their children), replacing its groups
+	void assign_to(PointSet* pset) const;
+
+	MemoryUsage memory_usage() const;
+
+private:
+	void add(const VertexGroup* g, int parent);
+
+private:
+	std::vector<std::size_t>	offsets_;
+	std::vector<unsigned int>	indices_;
+	std::vector<float>			a_, b_, c_, d_;
+	std::vector<std::string>	labels_;
+	std::vector<Color>			colors_;
+	std::vector<int>			parents_;
+	std::size_t					num_top_level_;
+};
+
+#endif
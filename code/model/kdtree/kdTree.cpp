@@ -29,6 +29,9 @@
 #include "kdTree.h"
 #include <float.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <thread>
+#include <string.h>
 
 
 namespace kdtree  {
@@ -43,47 +46,82 @@ namespace kdtree  {
 	// ******************
 	// global definitions
 	// ******************
-	bool     g_queryAll;
+	// NOTE: the query parameters are thread local, so different threads can query
+	//       the same tree at the same time (see the re-entrant queryPosition()).
+	thread_local bool     g_queryAll;
 
 	//=====================================================
 	// global parameters for range search
 	//-----------------------------------------------------
-	float    g_queryOffsets[3];
-	Vector3D g_queryPosition;
+	thread_local float    g_queryOffsets[3];
+	thread_local Vector3D g_queryPosition;
+	//-----------------------------------------------------
+	// parameters for approximate nearest neighbours search
+	//-----------------------------------------------------
+	thread_local float        g_queryErrorFactor;	// 1 / (1 + epsilon)^2
+	thread_local unsigned int g_queryLeavesLeft;
 	//=====================================================
 
 	//=====================================================
 	// global parameters for line intersection search
 	//-----------------------------------------------------
-	bool     g_queryToLine;
-	Vector3D g_queryLine[2];
-	Vector3D g_queryLineDir;
+	thread_local bool     g_queryToLine;
+	thread_local Vector3D g_queryLine[2];
+	thread_local Vector3D g_queryLineDir;
 	//-----------------------------------------------------
 	// parameters for cylinder intersection
 	//-----------------------------------------------------
-	float g_queryMaxDist, g_queryMaxSqrDist, g_queryMaxSqrRange;
+	thread_local float g_queryMaxDist, g_queryMaxSqrDist, g_queryMaxSqrRange;
 	//-----------------------------------------------------
 	// parameters for cone intersection
 	//-----------------------------------------------------
-	Vector3D g_queryEye;
-	float g_queryMaxCosAngle, g_queryMaxTanAngle, g_queryMinSqrRange;
+	thread_local Vector3D g_queryEye;
+	thread_local float g_queryMaxCosAngle, g_queryMaxTanAngle, g_queryMinSqrRange;
 	//=====================================================
 
 	KdTree::KdTree(const Vector3D *positions, unsigned int nOfPositions, unsigned int maxBucketSize) {
 		m_bucketSize			= maxBucketSize;
 		m_nOfPositions			= nOfPositions;
 		m_points				= new KdTreePoint[nOfPositions];
-		m_nOfFoundNeighbours	= 0;
-		m_nOfNeighbours			= 0;
-		m_queryPriorityQueue	= new PQueue();
 		for (unsigned int i=0; i<nOfPositions; i++) {
 			m_points[i].pos = positions[i];
 			m_points[i].index = i;
 		}
+		build(1);
+	}
+
+	KdTree::KdTree(const float *coordinates, unsigned int nOfPositions, unsigned int stride, unsigned int maxBucketSize, unsigned int nOfThreads) {
+		m_bucketSize			= maxBucketSize;
+		m_nOfPositions			= nOfPositions;
+		m_points				= new KdTreePoint[nOfPositions];
+		const float* p = coordinates;
+		for (unsigned int i=0; i<nOfPositions; i++, p+=stride) {
+			m_points[i].pos = Vector3D(p[0], p[1], p[2]);
+			m_points[i].index = i;
+		}
+		build(nOfThreads);
+	}
+
+	KdTree::KdTree(const float *const *positions, unsigned int nOfPositions, unsigned int maxBucketSize, unsigned int nOfThreads) {
+		m_bucketSize			= maxBucketSize;
+		m_nOfPositions			= nOfPositions;
+		m_points				= new KdTreePoint[nOfPositions];
+		for (unsigned int i=0; i<nOfPositions; i++) {
+			const float* p = positions[i];
+			m_points[i].pos = Vector3D(p[0], p[1], p[2]);
+			m_points[i].index = i;
+		}
+		build(nOfThreads);
+	}
+
+	void KdTree::build(unsigned int nOfThreads) {
+		m_nOfFoundNeighbours	= 0;
+		m_nOfNeighbours			= 0;
+		m_queryPriorityQueue	= new PQueue();
 		m_root = new KdNode();
 		Vector3D maximum, minimum;
-		getSpread(m_points, nOfPositions, maximum, minimum);
-		createTree(*m_root, 0, nOfPositions, maximum, minimum);
+		getSpread(m_points, m_nOfPositions, maximum, minimum);
+		createTree(*m_root, 0, m_nOfPositions, maximum, minimum, nOfThreads);
 		m_root->createBoundingBox(m_boundingBoxLowCorner, m_boundingBoxHighCorner);
 		setNOfNeighbours(1);
 	}
@@ -95,6 +133,140 @@ namespace kdtree  {
 		delete m_queryPriorityQueue;
 	}
 
+	KdTree::KdTree() {
+		m_bucketSize			= 0;
+		m_nOfPositions			= 0;
+		m_points				= NULL;
+		m_root					= NULL;
+		m_nOfFoundNeighbours	= 0;
+		m_nOfNeighbours			= 0;
+		m_queryPriorityQueue	= NULL;
+	}
+
+	// ******************
+	// serialization
+	// ******************
+	namespace {
+		const char			g_fileMagic[4] = { 'K', 'D', 'T', 'R' };
+		const unsigned int	g_fileVersion = 1;
+		const unsigned char	g_nodeTag = 0, g_leafTag = 1;
+		// deeper trees are not created by createTree(), so such a stream is corrupted
+		const unsigned int	g_maxDepth = 256;
+	}
+
+	bool KdTree::write(std::ostream& out) const {
+		out.write(g_fileMagic, sizeof(g_fileMagic));
+		out.write(reinterpret_cast<const char*>(&g_fileVersion), sizeof(g_fileVersion));
+		out.write(reinterpret_cast<const char*>(&m_nOfPositions), sizeof(m_nOfPositions));
+		out.write(reinterpret_cast<const char*>(&m_bucketSize), sizeof(m_bucketSize));
+		if (m_nOfPositions > 0)
+			out.write(reinterpret_cast<const char*>(m_points), std::streamsize(m_nOfPositions) * sizeof(KdTreePoint));
+		writeNode(out, m_root);
+		return !out.fail();
+	}
+
+	void KdTree::writeNode(std::ostream& out, const BaseKdNode* node) const {
+		const KdLeaf* leaf = dynamic_cast<const KdLeaf*>(node);
+		if (leaf) {
+			unsigned int first = static_cast<unsigned int>(leaf->m_points - m_points);
+			out.write(reinterpret_cast<const char*>(&g_leafTag), sizeof(g_leafTag));
+			out.write(reinterpret_cast<const char*>(&first), sizeof(first));
+			out.write(reinterpret_cast<const char*>(&leaf->m_nOfElements), sizeof(leaf->m_nOfElements));
+		}
+		else {
+			const KdNode* inner = static_cast<const KdNode*>(node);
+			out.write(reinterpret_cast<const char*>(&g_nodeTag), sizeof(g_nodeTag));
+			out.write(reinterpret_cast<const char*>(&inner->m_dim), sizeof(inner->m_dim));
+			out.write(reinterpret_cast<const char*>(&inner->m_cutVal), sizeof(inner->m_cutVal));
+			writeNode(out, inner->m_children[0]);
+			writeNode(out, inner->m_children[1]);
+		}
+	}
+
+	KdTree* KdTree::read(std::istream& in) {
+		char magic[4];
+		unsigned int version = 0;
+		KdTree* tree = new KdTree();
+		in.read(magic, sizeof(magic));
+		in.read(reinterpret_cast<char*>(&version), sizeof(version));
+		in.read(reinterpret_cast<char*>(&tree->m_nOfPositions), sizeof(tree->m_nOfPositions));
+		in.read(reinterpret_cast<char*>(&tree->m_bucketSize), sizeof(tree->m_bucketSize));
+		if (!in || memcmp(magic, g_fileMagic, sizeof(magic)) != 0 || version != g_fileVersion || tree->m_bucketSize <= 0) {
+			delete tree;
+			return NULL;
+		}
+
+		// checks the size against the stream before allocating
+		std::streampos start = in.tellg();
+		in.seekg(0, std::ios::end);
+		std::streamoff remaining = in.tellg() - start;
+		in.seekg(start);
+		if (remaining < 0 || static_cast<unsigned long long>(remaining) < static_cast<unsigned long long>(tree->m_nOfPositions) * sizeof(KdTreePoint)) {
+			delete tree;
+			return NULL;
+		}
+
+		tree->m_points = new KdTreePoint[tree->m_nOfPositions];
+		if (tree->m_nOfPositions > 0)
+			in.read(reinterpret_cast<char*>(tree->m_points), std::streamsize(tree->m_nOfPositions) * sizeof(KdTreePoint));
+		bool valid = !in.fail();
+		for (unsigned int i = 0; valid && i < tree->m_nOfPositions; ++i)
+			valid = (tree->m_points[i].index >= 0 && static_cast<unsigned int>(tree->m_points[i].index) < tree->m_nOfPositions);
+
+		BaseKdNode* root = valid ? tree->readNode(in, 0) : NULL;
+		tree->m_root = dynamic_cast<KdNode*>(root);	// the root is never a leaf
+		if (!tree->m_root) {
+			delete root;
+			delete tree;
+			return NULL;
+		}
+
+		tree->m_queryPriorityQueue = new PQueue();
+		tree->m_root->createBoundingBox(tree->m_boundingBoxLowCorner, tree->m_boundingBoxHighCorner);
+		tree->setNOfNeighbours(1);
+		return tree;
+	}
+
+	BaseKdNode* KdTree::readNode(std::istream& in, unsigned int depth) {
+		unsigned char tag = 0;
+		in.read(reinterpret_cast<char*>(&tag), sizeof(tag));
+		if (!in || depth > g_maxDepth) {
+			return NULL;
+		}
+
+		if (tag == g_leafTag) {
+			unsigned int first = 0, count = 0;
+			in.read(reinterpret_cast<char*>(&first), sizeof(first));
+			in.read(reinterpret_cast<char*>(&count), sizeof(count));
+			if (!in || first > m_nOfPositions || count > m_nOfPositions - first) {
+				return NULL;
+			}
+			KdLeaf* leaf = new KdLeaf();
+			leaf->m_points = m_points + first;
+			leaf->m_nOfElements = count;
+			return leaf;
+		}
+		else if (tag == g_nodeTag) {
+			KdNode* node = new KdNode();
+			node->m_children = new BaseKdNode*[2];
+			node->m_children[0] = NULL;
+			node->m_children[1] = NULL;
+			in.read(reinterpret_cast<char*>(&node->m_dim), sizeof(node->m_dim));
+			in.read(reinterpret_cast<char*>(&node->m_cutVal), sizeof(node->m_cutVal));
+			if (in && node->m_dim < 3) {
+				node->m_children[0] = readNode(in, depth + 1);
+				if (node->m_children[0])
+					node->m_children[1] = readNode(in, depth + 1);
+			}
+			if (!node->m_children[1]) {
+				delete node;
+				return NULL;
+			}
+			return node;
+		}
+		return NULL;
+	}
+
 	void KdTree::queryPosition(const Vector3D &position) {
 		if (m_neighbours.size() == 0) {
 			return;
@@ -106,6 +278,8 @@ namespace kdtree  {
 		m_queryPriorityQueue->init();
 		m_queryPriorityQueue->insert(-1, FLT_MAX);
 		g_queryPosition     =   position;
+		g_queryErrorFactor  =   1.0f;
+		g_queryLeavesLeft   =   UINT_MAX;
 		float dist = BaseKdNode::computeBoxDistance(position, m_boundingBoxLowCorner, m_boundingBoxHighCorner);
 		m_root->queryNode(dist, m_queryPriorityQueue);
 
@@ -126,6 +300,59 @@ namespace kdtree  {
 		}
 	}
 
+	void KdTree::queryPosition(const Vector3D &position, unsigned int k, PQueue& queue, std::vector<Neighbour>& neighbours) const {
+		neighbours.clear();
+		if (k == 0) {
+			return;
+		}
+		g_queryAll          =   false;
+		g_queryOffsets[0]   =   0.0;
+		g_queryOffsets[1]   =   0.0;
+		g_queryOffsets[2]   =   0.0;
+		queue.setSize(k);
+		queue.insert(-1, FLT_MAX);
+		g_queryPosition     =   position;
+		g_queryErrorFactor  =   1.0f;
+		g_queryLeavesLeft   =   UINT_MAX;
+		float dist = BaseKdNode::computeBoxDistance(position, m_boundingBoxLowCorner, m_boundingBoxHighCorner);
+		m_root->queryNode(dist, &queue);
+
+		collectNeighbours(queue, neighbours);
+	}
+
+	void KdTree::queryPosition(const Vector3D &position, unsigned int k, float epsilon, unsigned int maxLeaves, 
+		PQueue& queue, std::vector<Neighbour>& neighbours) const {
+		neighbours.clear();
+		if (k == 0) {
+			return;
+		}
+		g_queryAll          =   false;
+		g_queryOffsets[0]   =   0.0;
+		g_queryOffsets[1]   =   0.0;
+		g_queryOffsets[2]   =   0.0;
+		queue.setSize(k);
+		queue.insert(-1, FLT_MAX);
+		g_queryPosition     =   position;
+		g_queryErrorFactor  =   1.0f / SQR(1.0f + epsilon);
+		g_queryLeavesLeft   =   (maxLeaves > 0) ? maxLeaves : UINT_MAX;
+		float dist = BaseKdNode::computeBoxDistance(position, m_boundingBoxLowCorner, m_boundingBoxHighCorner);
+		m_root->queryNode(dist, &queue);
+
+		collectNeighbours(queue, neighbours);
+	}
+
+	void KdTree::collectNeighbours(PQueue& queue, std::vector<Neighbour>& neighbours) {
+		if (queue.getMax().index == -1) {
+			queue.removeMax();
+		}
+
+		neighbours.resize(queue.getNofElements());
+		for(int i=int(neighbours.size())-1; i>=0; i--) {
+			neighbours[i] = queue.getMax();
+			queue.removeMax();
+		}
+	}
+
 	void KdTree::queryRange(const Vector3D &position, float maxSqrDistance, bool queryAll ) {
 		if (m_neighbours.size() == 0) {
 			if ( queryAll ) {
@@ -141,6 +368,8 @@ namespace kdtree  {
 		m_queryPriorityQueue->init();
 		m_queryPriorityQueue->insert(-1, maxSqrDistance);
 		g_queryPosition     =   position;
+		g_queryErrorFactor  =   1.0f;
+		g_queryLeavesLeft   =   UINT_MAX;
 
 		float dist = BaseKdNode::computeBoxDistance(position, m_boundingBoxLowCorner, m_boundingBoxHighCorner);	
 		m_root->queryNode(dist, m_queryPriorityQueue);
@@ -162,6 +391,28 @@ namespace kdtree  {
 		}
 	}
 
+	void KdTree::queryRange(const Vector3D &position, float maxSqrDistance, unsigned int k, bool queryAll, 
+		PQueue& queue, std::vector<Neighbour>& neighbours) const {
+		neighbours.clear();
+		if (k == 0) {
+			return;
+		}
+		g_queryAll          =   queryAll;
+		g_queryOffsets[0]   =   0.0;
+		g_queryOffsets[1]   =   0.0;
+		g_queryOffsets[2]   =   0.0;
+		queue.setSize(k);
+		queue.insert(-1, maxSqrDistance);
+		g_queryPosition     =   position;
+		g_queryErrorFactor  =   1.0f;
+		g_queryLeavesLeft   =   UINT_MAX;
+
+		float dist = BaseKdNode::computeBoxDistance(position, m_boundingBoxLowCorner, m_boundingBoxHighCorner);	
+		m_root->queryNode(dist, &queue);
+
+		collectNeighbours(queue, neighbours);
+	}
+
 	void KdTree::queryLineIntersection( const Vector3D& v1, const Vector3D& v2, float maxDist, bool toLine, bool queryAll )
 	{
 		if (m_neighbours.size() == 0) {
@@ -202,6 +453,30 @@ namespace kdtree  {
 		}
 	}
 
+	void KdTree::queryLineIntersection( const Vector3D& v1, const Vector3D& v2, float maxDist, bool toLine, 
+		unsigned int k, bool queryAll, PQueue& queue, std::vector<Neighbour>& neighbours) const
+	{
+		neighbours.clear();
+		if (k == 0) {
+			return;
+		}
+		g_queryAll          =   queryAll;
+		g_queryToLine       =   toLine;
+		g_queryMaxDist      =   maxDist;
+		g_queryMaxSqrDist   =   maxDist * maxDist;
+		g_queryLine[0]      =   v1;
+		g_queryLine[1]      =   v2;
+		g_queryLineDir      =   v2 - v1;
+		g_queryMaxSqrRange  =   g_queryLineDir.getSquaredLength();  // maximal square range
+		g_queryLineDir.normalize();
+		queue.setSize(k);
+		queue.insert(-1, FLT_MAX);
+
+		m_root->queryLineIntersection(&queue);
+
+		collectNeighbours(queue, neighbours);
+	}
+
 	void KdTree::queryConeIntersection( const Vector3D& eye, const Vector3D& v1, const Vector3D& v2, float maxAngle, bool toLine, bool queryAll )
 	{
 		if (m_neighbours.size() == 0) {
@@ -244,6 +519,32 @@ namespace kdtree  {
 		}
 	}
 
+	void KdTree::queryConeIntersection( const Vector3D& eye, const Vector3D& v1, const Vector3D& v2, float maxAngle, 
+		bool toLine, unsigned int k, bool queryAll, PQueue& queue, std::vector<Neighbour>& neighbours) const
+	{
+		neighbours.clear();
+		if (k == 0) {
+			return;
+		}
+		g_queryAll          =   queryAll;
+		g_queryToLine       =   toLine;
+		g_queryMaxCosAngle  =   cosf(maxAngle);
+		g_queryMaxTanAngle  =   tanf(maxAngle);
+		g_queryEye          =   eye;
+		g_queryLine[0]      =   v1;
+		g_queryLine[1]      =   v2;
+		g_queryMinSqrRange  =   (v1 - eye).getSquaredLength();      // minimal square range
+		g_queryLineDir      =   v2 - eye;
+		g_queryMaxSqrRange  =   g_queryLineDir.getSquaredLength();  // maximal square range
+		g_queryLineDir.normalize();
+		queue.setSize(k);
+		queue.insert(-1, FLT_MAX);
+
+		m_root->queryConeIntersection(&queue);
+
+		collectNeighbours(queue, neighbours);
+	}
+
 	void KdTree::setNOfNeighbours (const unsigned int newNOfNeighbours) {
 		if (newNOfNeighbours != m_nOfNeighbours) {
 			m_nOfNeighbours = newNOfNeighbours;
@@ -255,6 +556,10 @@ namespace kdtree  {
 	}
 
 	void KdTree::createTree(KdNode &node, int start, int end, Vector3D maximum, Vector3D minimum) {
+		createTree(node, start, end, maximum, minimum, 1);
+	}
+
+	void KdTree::createTree(KdNode &node, int start, int end, Vector3D maximum, Vector3D minimum, unsigned int nOfThreads) {
 		int	mid;
 
 		int n = end-start;
@@ -300,6 +605,25 @@ namespace kdtree  {
 
 		BaseKdNode** childNodes = new BaseKdNode*[2];
 		node.m_children = childNodes;
+
+		// the two subtrees cover disjoint ranges of m_points, so they can be created concurrently
+		static const int minPointsPerThread = 65536;
+		if (nOfThreads > 1 && n >= 2 * minPointsPerThread && mid-start > m_bucketSize && end-mid > m_bucketSize) {
+			KdNode* lowNode = new KdNode();
+			KdNode* highNode = new KdNode();
+			node.m_children[0] = lowNode;
+			node.m_children[1] = highNode;
+			Vector3D lowMaximum = maximum;
+			lowMaximum[dim] = node.m_cutVal;
+			Vector3D highMinimum = minimum;
+			highMinimum[dim] = node.m_cutVal;
+			unsigned int lowThreads = nOfThreads / 2;
+			std::thread low([&]() { createTree(*lowNode, start, mid, lowMaximum, minimum, lowThreads); });
+			createTree(*highNode, mid, end, maximum, highMinimum, nOfThreads - lowThreads);
+			low.join();
+			return;
+		}
+
 		if (mid-start <= m_bucketSize) {
 			// new leaf
 			KdLeaf* leaf = new KdLeaf();
@@ -313,7 +637,7 @@ namespace kdtree  {
 			node.m_children[0] = childNode;
 			float oldMax = maximum[dim];
 			maximum[dim] = node.m_cutVal;
-			createTree(*childNode, start, mid, maximum, minimum);
+			createTree(*childNode, start, mid, maximum, minimum, nOfThreads);
 			maximum[dim] = oldMax;
 		}
 
@@ -329,7 +653,7 @@ namespace kdtree  {
 			minimum[dim] = node.m_cutVal;
 			KdNode* childNode = new KdNode();
 			node.m_children[1] = childNode;
-			createTree(*childNode, mid, end, maximum, minimum);
+			createTree(*childNode, mid, end, maximum, minimum, nOfThreads);
 		}
 	}
 
@@ -707,7 +1031,7 @@ namespace kdtree  {
 		if (new_off < 0) {
 			m_children[0]->queryNode(rd, queryPriorityQueue);
 			rd = rd - SQR(old_off) + SQR(new_off);
-			if (rd < queryPriorityQueue->getMaxWeight()) {
+			if (rd < queryPriorityQueue->getMaxWeight() * g_queryErrorFactor && g_queryLeavesLeft > 0) {
 				g_queryOffsets[m_dim] = new_off;
 				m_children[1]->queryNode(rd, queryPriorityQueue);
 				g_queryOffsets[m_dim] = old_off;
@@ -716,7 +1040,7 @@ namespace kdtree  {
 		else {
 			m_children[1]->queryNode(rd, queryPriorityQueue);
 			rd = rd - SQR(old_off) + SQR(new_off);
-			if (rd < queryPriorityQueue->getMaxWeight()) {
+			if (rd < queryPriorityQueue->getMaxWeight() * g_queryErrorFactor && g_queryLeavesLeft > 0) {
 				g_queryOffsets[m_dim] = new_off;
 				m_children[0]->queryNode(rd, queryPriorityQueue);
 				g_queryOffsets[m_dim] = old_off;
@@ -760,6 +1084,9 @@ namespace kdtree  {
 	}
 
 	void KdLeaf::queryNode(float rd, PQueue* queryPriorityQueue) {
+		if (g_queryLeavesLeft != UINT_MAX) {
+			--g_queryLeavesLeft;
+		}
 		float sqrDist;
 		//use pointer arithmetic to speed up the linear traversing
 		KdTreePoint* point = m_points;
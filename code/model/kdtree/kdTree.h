@@ -33,6 +33,7 @@
 #include "vector3D.h"
 #include "PriorityQueue.h"
 #include <vector>
+#include <iostream>
 
 
 namespace kdtree  {
@@ -266,6 +267,28 @@ namespace kdtree  {
 		*/
 		KdTree(const Vector3D *positions, unsigned int nOfPositions, unsigned int maxBucketSize);
 
+		/**
+		* Creates a k-d tree from the positions stored as float coordinates (x, y, z), without 
+		* an intermediate copy
+		*
+		* @param coordinates
+		*			the coordinates of the first point
+		* @param nOfPositions
+		*			number of points
+		* @param stride
+		*			the number of floats from one point to the next (3 for packed points)
+		* @param maxBucketSize
+		*			number of points per bucket
+		* @param nOfThreads
+		*			the number of threads building the top levels of the tree
+		*/
+		KdTree(const float *coordinates, unsigned int nOfPositions, unsigned int stride, unsigned int maxBucketSize, unsigned int nOfThreads = 1);
+
+		/**
+		* Creates a k-d tree from the positions given by pointers to their float coordinates (x, y, z)
+		*/
+		KdTree(const float *const *positions, unsigned int nOfPositions, unsigned int maxBucketSize, unsigned int nOfThreads = 1);
+
 		/**
 		* Destructor
 		*/
@@ -279,6 +302,37 @@ namespace kdtree  {
 		*/
 		void queryPosition(const Vector3D &position);
 
+		/**
+		* re-entrant version of queryPosition(): the query works on the caller's <code>queue</code> 
+		* and writes the result to <code>neighbours</code> (the nearest one first) instead of the tree, 
+		* so several threads can query the same tree at the same time, each with its own queue.
+		*
+		* @param position
+		*			the position of the point to query with
+		* @param k
+		*			the number of nearest neighbours to look for
+		* @param queue
+		*			the priority queue used by the query
+		* @param neighbours
+		*			the neighbours found
+		*/
+		void queryPosition(const Vector3D &position, unsigned int k, PQueue& queue, std::vector<Neighbour>& neighbours) const;
+
+		/**
+		* approximate version of the re-entrant queryPosition(): a subtree is skipped if it can't contain
+		* a point closer than the k-th neighbour found so far divided by (1 + <code>epsilon</code>), so 
+		* the distance to the i-th neighbour returned is at most (1 + <code>epsilon</code>) times the one 
+		* to the true i-th nearest neighbour. The search also stops after visiting <code>maxLeaves</code> 
+		* leaves (0 means no limit), the bound on the distances being lost then
+		*
+		* @param epsilon
+		*			the relative error allowed on the distances (0 gives the exact neighbours)
+		* @param maxLeaves
+		*			the maximum number of leaves visited
+		*/
+		void queryPosition(const Vector3D &position, unsigned int k, float epsilon, unsigned int maxLeaves, 
+			PQueue& queue, std::vector<Neighbour>& neighbours) const;
+
 		/**
 		* look for the nearest neighbours with a maximal squared distance <code>maxSqrDistance</code>. 
 		* If the set number of neighbours is smaller than the number of neighbours at this maximum distance, 
@@ -295,6 +349,13 @@ namespace kdtree  {
 		*/
 		void queryRange(const Vector3D &position, float maxSqrDistance, bool queryAll = false );
 
+		/**
+		* re-entrant version of queryRange() (see the re-entrant queryPosition()), looking for
+		* <code>k</code> neighbours (or all of them if <code>queryAll</code> is true)
+		*/
+		void queryRange(const Vector3D &position, float maxSqrDistance, unsigned int k, bool queryAll, 
+			PQueue& queue, std::vector<Neighbour>& neighbours) const;
+
 		/**
 		* look for the nearest neighbours with a maximal distance <code>maxDistance</code> to line segment
 		* defined by v1 and v2. 
@@ -313,6 +374,13 @@ namespace kdtree  {
 		void queryLineIntersection( const Vector3D& v1, const Vector3D& v2, float maxDist, 
 			bool toLine = true, bool queryAll = false );
 
+		/**
+		* re-entrant version of queryLineIntersection() (see the re-entrant queryPosition()), 
+		* looking for <code>k</code> neighbours (or all of them if <code>queryAll</code> is true)
+		*/
+		void queryLineIntersection( const Vector3D& v1, const Vector3D& v2, float maxDist, bool toLine, 
+			unsigned int k, bool queryAll, PQueue& queue, std::vector<Neighbour>& neighbours) const;
+
 		/**
 		* look for the nearest neighbours with an cone from $v1$ to $v2$
 		* defined by v1 and v2. 
@@ -331,6 +399,13 @@ namespace kdtree  {
 		void queryConeIntersection( const Vector3D& eye, const Vector3D& v1, const Vector3D& v2, float maxAngle,
 			bool toLine = true, bool queryAll = false );
 
+		/**
+		* re-entrant version of queryConeIntersection() (see the re-entrant queryPosition()), 
+		* looking for <code>k</code> neighbours (or all of them if <code>queryAll</code> is true)
+		*/
+		void queryConeIntersection( const Vector3D& eye, const Vector3D& v1, const Vector3D& v2, float maxAngle, 
+			bool toLine, unsigned int k, bool queryAll, PQueue& queue, std::vector<Neighbour>& neighbours) const;
+
 		/**
 		* set the number of nearest neighbours which have to be looked at for a query
 		*
@@ -386,6 +461,27 @@ namespace kdtree  {
 		*/
 		inline unsigned int getNOfQueryNeighbours();
 
+		/**
+		* get the points in the order of the tree (with their indices in the positions given)
+		*/
+		inline const KdTreePoint* getPoints() const;
+		inline unsigned int getNOfPositions() const;
+
+		/**
+		* writes the tree (the points in the order of the tree, and the nodes depth first) to a binary
+		* stream, to be read back by read()
+		*
+		* @return false if the stream failed
+		*/
+		bool write(std::ostream& out) const;
+
+		/**
+		* reads a tree written by write()
+		*
+		* @return the tree, or NULL if the stream doesn't hold a valid tree
+		*/
+		static KdTree* read(std::istream& in);
+
 	protected:
 		/** 
 		* creates the tree using the sliding midpoint splitting rule
@@ -403,6 +499,22 @@ namespace kdtree  {
 		*/
 		void createTree(KdNode &node, int start, int end, Vector3D maximum, Vector3D minimum);
 
+		/**
+		* same as above, the two subtrees of a node being created by different threads as long as
+		* <code>nOfThreads</code> is larger than 1 (and the node is large enough)
+		*/
+		void createTree(KdNode &node, int start, int end, Vector3D maximum, Vector3D minimum, unsigned int nOfThreads);
+
+		// creates the tree once the points are in m_points
+		void build(unsigned int nOfThreads);
+
+		// an empty tree, filled by read()
+		KdTree();
+
+		void writeNode(std::ostream& out, const BaseKdNode* node) const;
+		// returns NULL if the node is invalid
+		BaseKdNode* readNode(std::istream& in, unsigned int depth);
+
 
 	private:
 
@@ -418,6 +530,9 @@ namespace kdtree  {
 		Vector3D                    m_boundingBoxLowCorner;
 		Vector3D	                m_boundingBoxHighCorner;
 
+		// moves the neighbours found from the queue to neighbours (the nearest one first)
+		static void collectNeighbours(PQueue& queue, std::vector<Neighbour>& neighbours);
+
 		// gets the minimum and maximum value of all points at dimension dim
 		void getMinMax(KdTreePoint *points, int nOfPoints, int dim, float &min, float &max);
 		// splits the points such that on return for all points:
@@ -437,6 +552,14 @@ namespace kdtree  {
 		return m_nOfNeighbours;
 	}
 
+	inline const KdTreePoint* KdTree::getPoints() const {
+		return m_points;
+	}
+
+	inline unsigned int KdTree::getNOfPositions() const {
+		return m_nOfPositions;
+	}
+
 	inline unsigned int KdTree::getNeighbourPositionIndex(const unsigned int neighbourIndex) {
 		return m_neighbours[neighbourIndex].index;
 	}
@@ -20,15 +20,64 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "kdtree_search.h"
 #include "kdtree/kdTree.h"
 #include "../model/point_set.h"
+#include "../basic/parallel.h"
+#include "../basic/logger.h"
+#include "../basic/instrumentation.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <thread>
 
 
 
 #define get_tree(x) ((kdtree::KdTree*)(x))
 
 
+namespace {
+	// The state of the queries (the priority queue and the neighbors found). It is owned by each 
+	// thread (instead of the tree), so different threads can search the same tree at the same time.
+	struct Query {
+		kdtree::PQueue					queue;
+		std::vector<kdtree::Neighbour>	neighbours;
+	};
+
+	thread_local Query query;
+
+	// the initial size of the queue of the queries that return all the points found (it grows as needed)
+	const unsigned int query_all_size = 32;
+
+	// number of points per bucket
+	const unsigned int max_bucket_size = 16;
+
+	const char			index_magic[4] = { 'P', 'F', 'K', 'D' };
+	const unsigned int	index_version = 1;
+
+	// 64-bit FNV-1a hash of the coordinates
+	Numeric::uint64 hash_coordinates(const float* coordinates, std::size_t num) {
+		Numeric::uint64 h = 14695981039346656037ULL;
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(coordinates);
+		for (std::size_t i = 0; i < num * sizeof(float); ++i)
+			h = (h ^ bytes[i]) * 1099511628211ULL;
+		return h;
+	}
+
+	std::string to_hex(Numeric::uint64 h) {
+		std::ostringstream out;
+		out << std::hex << std::setw(16) << std::setfill('0') << h;
+		return out.str();
+	}
+}
+
+
 KdTreeSearch::KdTreeSearch()  {
 	points_num_ = 0;
 	tree_ = nil;
+	max_visited_leaves_ = 0;
 }
 
 
@@ -46,58 +95,146 @@ void KdTreeSearch::begin()  {
 
 
 void KdTreeSearch::end()  {
-	points_num_ = vertices_.size();
-
-	kdtree::Vector3D* points = new kdtree::Vector3D[points_num_];
-	std::list<vec3*>::iterator it = vertices_.begin();
-	unsigned int idx = 0;
-	for (; it != vertices_.end(); ++it) {
-		vec3* v = *it;
-		points[idx].x = v->x;
-		points[idx].y = v->y;
-		points[idx].z = v->z;
-		++idx;
+	points_num_ = static_cast<unsigned int>(vertices_.size());
+
+	// the points are read through their pointers, the tree keeping its own copy
+	const float* const* positions = vertices_.empty() ? nil : &vertices_[0];
+	tree_ = new kdtree::KdTree(positions, points_num_, max_bucket_size);
+	std::vector<const float*>().swap(vertices_);
+}
+
+
+void KdTreeSearch::build(const std::vector<vec3>& points, unsigned int num_threads) {
+	begin();
+	points_num_ = static_cast<unsigned int>(points.size());
+	unsigned int nb_threads = parallel_num_threads(num_threads);
+	const float* coordinates = points.empty() ? nil : points[0].data();
+	tree_ = new kdtree::KdTree(coordinates, points_num_, 3, max_bucket_size, nb_threads);
+}
+
+
+std::string KdTreeSearch::points_hash(const std::vector<vec3>& points) {
+	return to_hex(hash_coordinates(points.empty() ? nil : points[0].data(), points.size() * 3));
+}
+
+
+bool KdTreeSearch::save(const std::string& file_name) const {
+	if (!tree_) {
+		Logger::warn("-") << "no kd-tree to save" << std::endl;
+		return false;
 	}
 
-	unsigned int maxBucketSize = 16 ;	// number of points per bucket
-	tree_ = new kdtree::KdTree(points, points_num_, maxBucketSize );
-	delete [] points;
+	// the hash of the points in their original order
+	const kdtree::KdTree* tree = get_tree(tree_);
+	std::vector<vec3> points(tree->getNOfPositions());
+	const kdtree::KdTreePoint* tree_points = tree->getPoints();
+	for (unsigned int i = 0; i < tree->getNOfPositions(); ++i) {
+		const kdtree::Vector3D& p = tree_points[i].pos;
+		points[tree_points[i].index] = vec3(p.x, p.y, p.z);
+	}
+	const std::string hash = points_hash(points);
+
+	// written to a temporary file first, so a concurrent load never sees a partial file
+	std::ostringstream temp;
+	temp << file_name << "." << std::this_thread::get_id() << ".tmp";
+	const std::string temp_name = temp.str();
+	{
+		std::ofstream output(temp_name.c_str(), std::ios::binary);
+		if (output.fail()) {
+			Logger::warn("-") << "could not write the kd-tree file: " << temp_name << std::endl;
+			return false;
+		}
+		output.write(index_magic, sizeof(index_magic));
+		output.write(reinterpret_cast<const char*>(&index_version), sizeof(index_version));
+		output.write(hash.data(), static_cast<std::streamsize>(hash.size()));
+		if (!tree->write(output)) {
+			output.close();
+			std::remove(temp_name.c_str());
+			Logger::warn("-") << "could not write the kd-tree file: " << temp_name << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(file_name.c_str());	// rename() doesn't replace existing files on Windows
+	if (std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+		std::remove(temp_name.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+bool KdTreeSearch::load(const std::string& file_name, const std::vector<vec3>& points) {
+	std::ifstream input(file_name.c_str(), std::ios::binary);
+	if (input.fail())
+		return false;
+
+	char magic[4];
+	unsigned int version = 0;
+	char hash[16];
+	input.read(magic, sizeof(magic));
+	input.read(reinterpret_cast<char*>(&version), sizeof(version));
+	input.read(hash, sizeof(hash));
+	if (!input || std::memcmp(magic, index_magic, sizeof(magic)) != 0 || version != index_version) {
+		Logger::warn("-") << "ignored invalid kd-tree file: " << file_name << std::endl;
+		return false;
+	}
+	if (std::string(hash, sizeof(hash)) != points_hash(points)) {
+		Logger::warn("-") << "ignored kd-tree file of other points: " << file_name << std::endl;
+		return false;
+	}
+
+	kdtree::KdTree* tree = kdtree::KdTree::read(input);
+	if (!tree || tree->getNOfPositions() != points.size()) {
+		delete tree;
+		Logger::warn("-") << "ignored invalid kd-tree file: " << file_name << std::endl;
+		return false;
+	}
+
+	begin();
+	tree_ = tree;
+	points_num_ = static_cast<unsigned int>(points.size());
+	return true;
 }
 
 
 void KdTreeSearch::add_point(vec3* v)  {
-	vertices_.push_back(v);
+	vertices_.push_back(v->data());
 }
 
 
 void KdTreeSearch::add_vertex_set(PointSet* vs)  {
 	std::vector<vec3>& points = vs->points();
+	vertices_.reserve(vertices_.size() + points.size());
 	for (std::size_t i = 0; i < points.size(); ++i)
-		vertices_.push_back(&(points[i]));
+		vertices_.push_back(points[i].data());
+}
+
+
+namespace {
+	EventCounter num_knn_queries("kNN searches");
 }
 
 
 int KdTreeSearch::find_closest_point(const vec3& p) const {
+	num_knn_queries.add();
 	kdtree::Vector3D v3d( p.x, p.y, p.z );
-	get_tree(tree_)->setNOfNeighbours( 1 );
-	get_tree(tree_)->queryPosition( v3d );
+	get_tree(tree_)->queryPosition( v3d, 1, float(epsilon_), max_visited_leaves_, query.queue, query.neighbours );
 
-	unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
-	if (num == 1) 
-		return get_tree(tree_)->getNeighbourPositionIndex(0);
+	if (query.neighbours.size() == 1) 
+		return query.neighbours[0].index;
 	else
 		return -1;
 }
 
 int KdTreeSearch::find_closest_point(const vec3& p, double& squared_distance) const {
+	num_knn_queries.add();
 	kdtree::Vector3D v3d( p.x, p.y, p.z );
-	get_tree(tree_)->setNOfNeighbours( 1 );
-	get_tree(tree_)->queryPosition( v3d );
+	get_tree(tree_)->queryPosition( v3d, 1, float(epsilon_), max_visited_leaves_, query.queue, query.neighbours );
 
-	unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
-	if (num == 1) {
-		squared_distance = get_tree(tree_)->getSquaredDistance(0);
-		return get_tree(tree_)->getNeighbourPositionIndex(0);
+	if (query.neighbours.size() == 1) {
+		squared_distance = query.neighbours[0].weight;
+		return query.neighbours[0].index;
 	} else 
 		return -1;
 }
@@ -105,51 +242,82 @@ int KdTreeSearch::find_closest_point(const vec3& p, double& squared_distance) co
 void KdTreeSearch::find_closest_K_points(
 	const vec3& p, unsigned int k, std::vector<unsigned int>& neighbors
 	)  const {
+		num_knn_queries.add();
 		kdtree::Vector3D v3d( p.x, p.y, p.z );
-		get_tree(tree_)->setNOfNeighbours( k );
-		get_tree(tree_)->queryPosition( v3d );
+		get_tree(tree_)->queryPosition( v3d, k, float(epsilon_), max_visited_leaves_, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
-		if (num == k) {
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		if (found.size() == k) {
 			neighbors.resize(k);
 			for (unsigned int i=0; i<k; ++i) {
-				neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
+				neighbors[i] = found[i].index;
 			}		
 		} else
-			std::cerr << "less than " << k << " points found" << std::endl;
+			Logger::warn("-") << "less than " << k << " points found" << std::endl;
 }
 
 void KdTreeSearch::find_closest_K_points(
 	const vec3& p, unsigned int k, std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
 	)  const {
+		num_knn_queries.add();
 		kdtree::Vector3D v3d( p.x, p.y, p.z );
-		get_tree(tree_)->setNOfNeighbours( k );
-		get_tree(tree_)->queryPosition( v3d );
+		get_tree(tree_)->queryPosition( v3d, k, float(epsilon_), max_visited_leaves_, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
-		if (num == k) {
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		if (found.size() == k) {
 			neighbors.resize(k);
 			squared_distances.resize(k);
 			for (unsigned int i=0; i<k; ++i) {
-				neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
-				squared_distances[i] = get_tree(tree_)->getSquaredDistance(i);
+				neighbors[i] = found[i].index;
+				squared_distances[i] = found[i].weight;
 			}		
 		} else
-			std::cerr << "less than " << k << " points found" << std::endl;
+			Logger::warn("-") << "less than " << k << " points found" << std::endl;
 }
 
 
 
+void KdTreeSearch::find_closest_K_points(
+	const vec3* queries, std::size_t n, unsigned int k,
+	unsigned int* neighbors, float* squared_distances, unsigned int num_threads /* = 0 */
+	) const {
+		num_knn_queries.add(n);
+		std::vector<std::size_t> order;
+		spatial_order(queries, n, order);
+
+		std::size_t num_blocks = (n + query_block_size - 1) / query_block_size;
+		parallel_for(num_blocks, [&](std::size_t b) {
+			std::size_t end = std::min(n, (b + 1) * query_block_size);
+			for (std::size_t j = b * query_block_size; j < end; ++j) {
+				std::size_t i = order[j];
+				const vec3& p = queries[i];
+				get_tree(tree_)->queryPosition( kdtree::Vector3D(p.x, p.y, p.z), k, float(epsilon_), max_visited_leaves_, query.queue, query.neighbours );
+
+				const std::vector<kdtree::Neighbour>& found = query.neighbours;
+				unsigned int* idx = neighbors + i * k;
+				for (unsigned int m = 0; m < k; ++m)
+					idx[m] = (m < found.size()) ? static_cast<unsigned int>(found[m].index) : invalid_index;
+				if (squared_distances) {
+					float* dist = squared_distances + i * k;
+					for (unsigned int m = 0; m < k; ++m)
+						dist[m] = (m < found.size()) ? found[m].weight : FLT_MAX;
+				}
+			}
+		}, nil, num_threads);
+}
+
+
 void KdTreeSearch::find_points_in_radius(
 	const vec3& p, double squared_radius, std::vector<unsigned int>& neighbors
 	)  const {
 		kdtree::Vector3D v3d( p.x, p.y, p.z );
-		get_tree(tree_)->queryRange( v3d, squared_radius, true );
+		get_tree(tree_)->queryRange( v3d, squared_radius, query_all_size, true, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		unsigned int num = static_cast<unsigned int>(found.size());
 		neighbors.resize(num);
 		for (unsigned int i=0; i<num; ++i) {
-			neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
+			neighbors[i] = found[i].index;
 		}	
 }
 
@@ -158,18 +326,65 @@ void KdTreeSearch::find_points_in_radius(
 	const vec3& p, double squared_radius, std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
 	)  const {
 		kdtree::Vector3D v3d( p.x, p.y, p.z );
-		get_tree(tree_)->queryRange( v3d, squared_radius, true );
+		get_tree(tree_)->queryRange( v3d, squared_radius, query_all_size, true, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		unsigned int num = static_cast<unsigned int>(found.size());
 		neighbors.resize(num);
 		squared_distances.resize(num);
 		for (unsigned int i=0; i<num; ++i) {
-			neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
-			squared_distances[i] = get_tree(tree_)->getSquaredDistance(i);
+			neighbors[i] = found[i].index;
+			squared_distances[i] = found[i].weight;
 		}	
 }
 
 
+void KdTreeSearch::find_points_in_radius(
+	const vec3* queries, std::size_t n, double squared_radius, 
+	std::vector<std::size_t>& offsets, std::vector<unsigned int>& neighbors, 
+	std::vector<float>* squared_distances /* = nil */, unsigned int num_threads /* = 0 */
+	) const {
+		std::vector<std::size_t> order;
+		spatial_order(queries, n, order);
+
+		// the results of each block of queries (in the spatial order), and then moved to their places
+		std::size_t num_blocks = (n + query_block_size - 1) / query_block_size;
+		std::vector< std::vector<kdtree::Neighbour> > found(num_blocks);
+		std::vector<std::size_t> counts(n, 0);
+		parallel_for(num_blocks, [&](std::size_t b) {
+			std::size_t end = std::min(n, (b + 1) * query_block_size);
+			for (std::size_t j = b * query_block_size; j < end; ++j) {
+				const vec3& p = queries[order[j]];
+				get_tree(tree_)->queryRange( kdtree::Vector3D(p.x, p.y, p.z), float(squared_radius), query_all_size, true, query.queue, query.neighbours );
+				found[b].insert(found[b].end(), query.neighbours.begin(), query.neighbours.end());
+				counts[order[j]] = query.neighbours.size();
+			}
+		}, nil, num_threads);
+
+		offsets.resize(n + 1);
+		offsets[0] = 0;
+		for (std::size_t i = 0; i < n; ++i)
+			offsets[i + 1] = offsets[i] + counts[i];
+		neighbors.resize(offsets[n]);
+		if (squared_distances)
+			squared_distances->resize(offsets[n]);
+
+		parallel_for(num_blocks, [&](std::size_t b) {
+			std::size_t end = std::min(n, (b + 1) * query_block_size);
+			const kdtree::Neighbour* from = found[b].empty() ? nil : &found[b][0];
+			for (std::size_t j = b * query_block_size; j < end; ++j) {
+				std::size_t i = order[j];
+				for (std::size_t m = offsets[i]; m < offsets[i + 1]; ++m, ++from) {
+					neighbors[m] = static_cast<unsigned int>(from->index);
+					if (squared_distances)
+						(*squared_distances)[m] = from->weight;
+				}
+			}
+			std::vector<kdtree::Neighbour>().swap(found[b]);
+		}, nil, num_threads);
+}
+
+
 unsigned int KdTreeSearch::find_points_in_cylinder(
 	const vec3& p1, const vec3& p2, double radius, 
 	std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances,
@@ -177,15 +392,16 @@ unsigned int KdTreeSearch::find_points_in_cylinder(
 	) const {
 		kdtree::Vector3D s( p1.x, p1.y, p1.z );
 		kdtree::Vector3D t( p2.x, p2.y, p2.z );
-		get_tree(tree_)->queryLineIntersection( s, t, radius, bToLine, true );
+		get_tree(tree_)->queryLineIntersection( s, t, radius, bToLine, query_all_size, true, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		unsigned int num = static_cast<unsigned int>(found.size());
 
 		neighbors.resize(num);
 		squared_distances.resize(num);
 		for (unsigned int i=0; i<num; ++i) {
-			neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
-			squared_distances[i] = get_tree(tree_)->getSquaredDistance(i);
+			neighbors[i] = found[i].index;
+			squared_distances[i] = found[i].weight;
 		}	
 
 		return num;
@@ -198,12 +414,13 @@ unsigned int KdTreeSearch::find_points_in_cylinder(
 	) const {
 		kdtree::Vector3D s( p1.x, p1.y, p1.z );
 		kdtree::Vector3D t( p2.x, p2.y, p2.z );
-		get_tree(tree_)->queryLineIntersection( s, t, radius, bToLine, true );
+		get_tree(tree_)->queryLineIntersection( s, t, radius, bToLine, query_all_size, true, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		unsigned int num = static_cast<unsigned int>(found.size());
 		neighbors.resize(num);
 		for (unsigned int i=0; i<num; ++i) {
-			neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
+			neighbors[i] = found[i].index;
 		}
 
 		return num;
@@ -218,14 +435,15 @@ unsigned int KdTreeSearch::find_points_in_cone(
 		kdtree::Vector3D eye3d( eye.x, eye.y, eye.z );
 		kdtree::Vector3D s( p1.x, p1.y, p1.z );
 		kdtree::Vector3D t( p2.x, p2.y, p2.z ); 
-		get_tree(tree_)->queryConeIntersection( eye3d, s, t, angle_range, bToLine, true );
+		get_tree(tree_)->queryConeIntersection( eye3d, s, t, angle_range, bToLine, query_all_size, true, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		unsigned int num = static_cast<unsigned int>(found.size());
 		neighbors.resize(num);
 		squared_distances.resize(num);
 		for (unsigned int i=0; i<num; ++i) {
-			neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
-			squared_distances[i] = get_tree(tree_)->getSquaredDistance(i);
+			neighbors[i] = found[i].index;
+			squared_distances[i] = found[i].weight;
 		}
 
 		return num;
@@ -239,12 +457,13 @@ unsigned int KdTreeSearch::find_points_in_cone(
 		kdtree::Vector3D eye3d( eye.x, eye.y, eye.z );
 		kdtree::Vector3D s( p1.x, p1.y, p1.z );
 		kdtree::Vector3D t( p2.x, p2.y, p2.z );
-		get_tree(tree_)->queryConeIntersection( eye3d, s, t, angle_range, bToLine, true);
+		get_tree(tree_)->queryConeIntersection( eye3d, s, t, angle_range, bToLine, query_all_size, true, query.queue, query.neighbours );
 
-		unsigned int num = get_tree(tree_)->getNOfFoundNeighbours();
+		const std::vector<kdtree::Neighbour>& found = query.neighbours;
+		unsigned int num = static_cast<unsigned int>(found.size());
 		neighbors.resize(num);
 		for (unsigned int i=0; i<num; ++i) {
-			neighbors[i] = get_tree(tree_)->getNeighbourPositionIndex(i);
+			neighbors[i] = found[i].index;
 		}
 
 		return num;
@@ -20,22 +20,31 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #ifndef __KDTREE_KDTREE_SEARCH__
 #define __KDTREE_KDTREE_SEARCH__
 
-#include "model_common.h"
-#include "../math/math_types.h"
-#include "../basic/counted.h"
-#include "../basic/smart_pointer.h"
+#include "point_search.h"
 
-#include <list>
+#include <vector>
+#include <string>
 
 
 
 class PointSet;
 
-class MODEL_API KdTreeSearch : public Counted {
+// The queries keep their state (the priority queue and the neighbors found) in buffers owned by 
+// the calling thread, so once the tree is built, it can be searched from any number of threads at 
+// the same time (e.g., from parallel_for()).
+class MODEL_API KdTreeSearch : public PointSearch {
 public:
 	KdTreeSearch();
 	virtual ~KdTreeSearch();
 
+	virtual Backend backend() const { return KD_TREE; }
+
+	// stops the closest point and K nearest neighbor queries after visiting this number of leaves 
+	// (of 16 points), even if closer points may remain (0 means no limit). Like the approximation 
+	// (see PointSearch::set_epsilon()), it trades the exactness of the neighbors for speed.
+	void set_max_visited_leaves(unsigned int n) { max_visited_leaves_ = n; }
+	unsigned int max_visited_leaves() const { return max_visited_leaves_; }
+
 	//______________ tree construction __________________________
 
 	virtual void begin() ;
@@ -43,6 +52,23 @@ public:
 	virtual void add_vertex_set(PointSet* vs) ;
 	virtual void end() ;
 
+	// Builds the tree of all the 'points' in one go, reading them in place (no list of pointers
+	// and no intermediate array). The indices returned by the queries are indices in 'points'.
+	// The top levels of the tree are created by up to 'num_threads' threads (0 means the number 
+	// of hardware threads).
+	virtual void build(const std::vector<vec3>& points, unsigned int num_threads = 0) ;
+
+	//______________ persistence ________________________________
+
+	// Saves the tree to a binary file, together with a hash of the points it was built from.
+	bool save(const std::string& file_name) const ;
+	// Loads a tree saved by save(), unless it was built from other points than 'points' (checked on
+	// their number and hash), which is much faster than building it again.
+	bool load(const std::string& file_name, const std::vector<vec3>& points) ;
+
+	// a hash of the coordinates of the points (as 16 hexadecimal digits)
+	static std::string points_hash(const std::vector<vec3>& points) ;
+
 	//________________ closest point ____________________________
 
 	// return the index of the closest point, -1 if not found
@@ -52,7 +78,7 @@ public:
 
 	//_________________ K-nearest neighbors ____________________
 
-	// NOTE: *squared* distances are returned
+	// NOTE: *squared* distances are returned. The neighbors are sorted in increasing distance.
 	virtual void find_closest_K_points(
 		const vec3& p, unsigned int k, 
 		std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
@@ -63,6 +89,12 @@ public:
 		std::vector<unsigned int>& neighbors
 		) const;
 
+	// Batch version (see PointSearch)
+	virtual void find_closest_K_points(
+		const vec3* queries, std::size_t n, unsigned int k,
+		unsigned int* neighbors, float* squared_distances, unsigned int num_threads = 0
+		) const;
+
 	//___________________ radius search __________________________
 
 	// fixed-radius kNN	search. Search for all points in the range.
@@ -75,6 +107,13 @@ public:
 		std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
 		) const ;
 
+	// Batch version (see PointSearch)
+	virtual void find_points_in_radius(
+		const vec3* queries, std::size_t n, double squared_radius, 
+		std::vector<std::size_t>& offsets, std::vector<unsigned int>& neighbors, 
+		std::vector<float>* squared_distances = nil, unsigned int num_threads = 0
+		) const ;
+
 	//____________________ cylinder range search _________________
 
 	// Search for the nearest points whose distances to line segment $v1$-$v2$ are smaller 
@@ -113,9 +152,10 @@ public:
 		) const ;
 
 protected:
-	std::list<vec3*>	vertices_;
+	std::vector<const float*>	vertices_;	// the coordinates of the points added
 	unsigned int		points_num_;
 	void*				tree_;
+	unsigned int		max_visited_leaves_;
 } ;
 
 
@@ -40,9 +40,11 @@
 #include "map.h"
 #include "map_geometry.h"
 #include "map_attributes.h"
+#include "../basic/logger.h"
 
 #include <stack>
 #include <algorithm>
+#include <atomic>
 
 
 
@@ -74,10 +76,31 @@ MapCombelObserver<Map::Facet>::~MapCombelObserver() {
 
 //////////////////////////////////////////////////////////////////////////
 
+unsigned int Map::new_id() {
+	static std::atomic<unsigned int> next_id(0) ;
+	return ++next_id ;
+}
+
 Map::~Map() { 
 	clear(); 
 }
 
+MemoryUsage Map::memory_usage() const {
+	MemoryUsage usage ;
+	usage.add("vertices", double(vertices_.memory_usage())) ;
+	usage.add("halfedges", double(halfedges_.memory_usage())) ;
+	usage.add("facets", double(facets_.memory_usage())) ;
+
+	MemoryUsage vertex_attributes, halfedge_attributes, facet_attributes ;
+	vertex_attribute_manager_.memory_usage(vertex_attributes) ;
+	halfedge_attribute_manager_.memory_usage(halfedge_attributes) ;
+	facet_attribute_manager_.memory_usage(facet_attributes) ;
+	usage.add("vertex attributes", vertex_attributes) ;
+	usage.add("halfedge attributes", halfedge_attributes) ;
+	usage.add("facet attributes", facet_attributes) ;
+	return usage ;
+}
+
 const Box3d& Map::bbox() const {
 	if (!bbox_is_valid_) {
 		bbox_ = Geom::bounding_box(this);
@@ -156,6 +179,13 @@ void Map::remove_facet_observer(MapCombelObserver<Facet>* obs) {
 
 
 void Map::notify_add_vertex(Vertex* v) {
+	++version_ ;
+	if(in_bulk_edit()) {
+		if(!vertex_observers_.empty() && pending_vertices_.alive.insert(v).second) {
+			pending_vertices_.order.push_back(v) ;
+		}
+		return ;
+	}
 	for(
 		std::vector<MapCombelObserver<Vertex>* >::iterator
 		it=vertex_observers_.begin(); it!=vertex_observers_.end(); it++
@@ -165,6 +195,10 @@ void Map::notify_add_vertex(Vertex* v) {
 }
 
 void Map::notify_remove_vertex(Vertex* v) {
+	++version_ ;
+	if(in_bulk_edit() && pending_vertices_.alive.erase(v) > 0) {
+		return ;	// created during the bulk edit, the observers don't know it
+	}
 	for(
 		std::vector<MapCombelObserver<Vertex>* >::iterator
 		it=vertex_observers_.begin(); it!=vertex_observers_.end(); it++
@@ -174,6 +208,13 @@ void Map::notify_remove_vertex(Vertex* v) {
 }
 
 void Map::notify_add_halfedge(Halfedge* h) {
+	++version_ ;
+	if(in_bulk_edit()) {
+		if(!halfedge_observers_.empty() && pending_halfedges_.alive.insert(h).second) {
+			pending_halfedges_.order.push_back(h) ;
+		}
+		return ;
+	}
 	for(
 		std::vector<MapCombelObserver<Halfedge>* >::iterator
 		it=halfedge_observers_.begin(); 
@@ -184,6 +225,10 @@ void Map::notify_add_halfedge(Halfedge* h) {
 }
 
 void Map::notify_remove_halfedge(Halfedge* h) {
+	++version_ ;
+	if(in_bulk_edit() && pending_halfedges_.alive.erase(h) > 0) {
+		return ;	// created during the bulk edit, the observers don't know it
+	}
 	for(
 		std::vector<MapCombelObserver<Halfedge>* >::iterator
 		it=halfedge_observers_.begin(); 
@@ -194,6 +239,13 @@ void Map::notify_remove_halfedge(Halfedge* h) {
 }
 
 void Map::notify_add_facet(Facet* f) {
+	++version_ ;
+	if(in_bulk_edit()) {
+		if(!facet_observers_.empty() && pending_facets_.alive.insert(f).second) {
+			pending_facets_.order.push_back(f) ;
+		}
+		return ;
+	}
 	for(
 		std::vector<MapCombelObserver<Facet>* >::iterator
 		it=facet_observers_.begin(); 
@@ -204,6 +256,10 @@ void Map::notify_add_facet(Facet* f) {
 }
 
 void Map::notify_remove_facet(Facet* f) {
+	++version_ ;
+	if(in_bulk_edit() && pending_facets_.alive.erase(f) > 0) {
+		return ;	// created during the bulk edit, the observers don't know it
+	}
 	for(
 		std::vector<MapCombelObserver<Facet>* >::iterator
 		it=facet_observers_.begin(); 
@@ -213,6 +269,50 @@ void Map::notify_remove_facet(Facet* f) {
 	}
 }
 
+// ____________________ Bulk edits _______________________
+
+void Map::begin_bulk_edit(unsigned int nb_vertices, unsigned int nb_halfedges, unsigned int nb_facets) {
+	++bulk_edit_depth_ ;
+	vertex_attribute_manager_.reserve(nb_vertices) ;
+	halfedge_attribute_manager_.reserve(nb_halfedges) ;
+	facet_attribute_manager_.reserve(nb_facets) ;
+	vertex_attribute_manager_.set_geometric_growth(true) ;
+	halfedge_attribute_manager_.set_geometric_growth(true) ;
+	facet_attribute_manager_.set_geometric_growth(true) ;
+}
+
+namespace {
+	// tells the observers of the elements created during a bulk edit
+	template <class CELL, class PENDING> 
+	void notify_pending(PENDING& pending, std::vector< MapCombelObserver<CELL>* >& observers) {
+		for(std::size_t i=0; i<pending.order.size(); i++) {
+			CELL* c = pending.order[i] ;
+			if(pending.alive.erase(c) == 0) {
+				continue ;	// removed (or already notified, if its address was reused)
+			}
+			for(std::size_t j=0; j<observers.size(); j++) {
+				observers[j]->add(c) ;
+			}
+		}
+		pending.order.clear() ;
+		pending.alive.clear() ;
+	}
+}
+
+void Map::end_bulk_edit() {
+	ogf_assert(bulk_edit_depth_ > 0) ;
+	if(--bulk_edit_depth_ > 0) {
+		return ;
+	}
+	vertex_attribute_manager_.set_geometric_growth(false) ;
+	halfedge_attribute_manager_.set_geometric_growth(false) ;
+	facet_attribute_manager_.set_geometric_growth(false) ;
+
+	notify_pending<Vertex>(pending_vertices_, vertex_observers_) ;
+	notify_pending<Halfedge>(pending_halfedges_, halfedge_observers_) ;
+	notify_pending<Facet>(pending_facets_, facet_observers_) ;
+}
+
 // ____________________ Modification _____________________
 
 void Map::clear() {
@@ -223,8 +323,209 @@ void Map::clear() {
 	vertex_attribute_manager_.clear() ;
 	halfedge_attribute_manager_.clear() ;
 	facet_attribute_manager_.clear() ;
+
+	pending_vertices_ = PendingAdds<Vertex>() ;
+	pending_halfedges_ = PendingAdds<Halfedge>() ;
+	pending_facets_ = PendingAdds<Facet>() ;
+
+	++version_ ;
+}
+
+
+void Map::recycle() {
+	ogf_assert(!in_bulk_edit()) ;
+	vertices_.recycle() ;
+	halfedges_.recycle() ;
+	facets_.recycle() ;
+
+	vertex_attribute_manager_.recycle() ;
+	halfedge_attribute_manager_.recycle() ;
+	facet_attribute_manager_.recycle() ;
+
+	invalidate_bbox() ;
+	++version_ ;
+}
+
+
+namespace {
+	template <class CELL>
+	void compact_cells(DList<CELL>& cells, AttributeManager& manager, const std::vector<CELL*>& order) {
+		ogf_assert(int(order.size()) == cells.size()) ;
+		std::vector<Record*> records(order.begin(), order.end()) ;
+		cells.reorder(order.empty() ? nil : &order[0], (unsigned int)order.size()) ;
+		manager.compact(records.empty() ? nil : &records[0], (unsigned int)records.size()) ;
+		cells.release_free_chunks() ;
+	}
+}
+
+void Map::compact() {
+	std::vector< std::pair<Numeric::uint64, Facet*> > keys ;
+	keys.reserve(size_of_facets()) ;
+	if(size_of_facets() > 0) {
+		Box3d box = Geom::bounding_box(this) ;
+		FOR_EACH_FACET(Map, this, it) {
+			keys.push_back(std::make_pair(Geom::morton_code(Geom::facet_center(it), box), it)) ;
+		}
+	}
+	std::stable_sort(keys.begin(), keys.end(), 
+		[](const std::pair<Numeric::uint64, Facet*>& a, const std::pair<Numeric::uint64, Facet*>& b) { return a.first < b.first ; }
+	) ;
+
+	std::vector<Facet*> facets(keys.size()) ;
+	for(std::size_t i=0; i<keys.size(); i++) {
+		facets[i] = keys[i].second ;
+	}
+	compact(facets) ;
+}
+
+void Map::compact(const std::vector<Facet*>& facets) {
+	ogf_assert(!in_bulk_edit()) ;
+	if(vertices_.has_inactive_items() || halfedges_.has_inactive_items() || facets_.has_inactive_items()) {
+		Logger::warn("Map") << "cannot compact a map with inactive items" << std::endl ;
+		return ;
+	}
+
+	std::vector<Halfedge*> halfedges ;
+	halfedges.reserve(size_of_halfedges()) ;
+	std::unordered_set<Halfedge*> visited_halfedges ;
+	for(std::size_t i=0; i<facets.size(); i++) {
+		Halfedge* h = facets[i]->halfedge() ;
+		do {
+			if(visited_halfedges.insert(h).second) {
+				halfedges.push_back(h) ;
+			}
+			if(visited_halfedges.insert(h->opposite()).second) {
+				halfedges.push_back(h->opposite()) ;
+			}
+			h = h->next() ;
+		} while(h != facets[i]->halfedge()) ;
+	}
+	FOR_EACH_HALFEDGE(Map, this, it) {	// not incident to any facet
+		if(visited_halfedges.insert(it).second) {
+			halfedges.push_back(it) ;
+		}
+	}
+
+	std::vector<Vertex*> vertices ;
+	vertices.reserve(size_of_vertices()) ;
+	std::unordered_set<Vertex*> visited_vertices ;
+	for(std::size_t i=0; i<halfedges.size(); i++) {
+		if(visited_vertices.insert(halfedges[i]->vertex()).second) {
+			vertices.push_back(halfedges[i]->vertex()) ;
+		}
+	}
+	FOR_EACH_VERTEX(Map, this, it) {	// isolated
+		if(visited_vertices.insert(it).second) {
+			vertices.push_back(it) ;
+		}
+	}
+
+	compact_cells(vertices_, vertex_attribute_manager_, vertices) ;
+	compact_cells(halfedges_, halfedge_attribute_manager_, halfedges) ;
+	compact_cells(facets_, facet_attribute_manager_, facets) ;
+
+	++version_ ;
 }
 
+namespace {
+	template <class CELL>
+	void clone_attributes(
+		AttributeManager& manager, AttributeManager* from_manager, 
+		const std::vector<CELL*>& cells, const std::vector<const CELL*>& from_cells,
+		const std::set<std::string>* names
+		) {
+			std::vector<Record*> records(cells.begin(), cells.end()) ;
+			std::vector<const Record*> from_records(from_cells.begin(), from_cells.end()) ;
+			manager.clone_records(
+				from_manager, records.empty() ? nil : &records[0], 
+				from_records.empty() ? nil : &from_records[0], (unsigned int)records.size(), names
+				) ;
+	}
+}
+
+void Map::clone_from(
+	Map* from, 
+	const std::set<std::string>* vertex_attributes,
+	const std::set<std::string>* halfedge_attributes,
+	const std::set<std::string>* facet_attributes
+	) {
+		ogf_assert(from != this) ;
+		ogf_assert(!in_bulk_edit()) ;
+		clear() ;
+
+		// the elements, in the order of from
+		std::vector<Vertex*>	vertices ;
+		std::vector<Halfedge*>	halfedges ;
+		std::vector<Facet*>		facets ;
+		std::vector<const Vertex*>		from_vertices ;
+		std::vector<const Halfedge*>	from_halfedges ;
+		std::vector<const Facet*>		from_facets ;
+		vertices.reserve(from->size_of_vertices()) ;
+		halfedges.reserve(from->size_of_halfedges()) ;
+		facets.reserve(from->size_of_facets()) ;
+		from_vertices.reserve(from->size_of_vertices()) ;
+		from_halfedges.reserve(from->size_of_halfedges()) ;
+		from_facets.reserve(from->size_of_facets()) ;
+
+		// the translation table, from the elements of from to their copies
+		MapVertexAttribute<Vertex*>		vertex_copy(from) ;
+		MapHalfedgeAttribute<Halfedge*>	halfedge_copy(from) ;
+		MapFacetAttribute<Facet*>		facet_copy(from) ;
+
+		FOR_EACH_VERTEX(Map, from, it) {
+			Vertex* v = vertices_.create() ;
+			v->set_point(it->point()) ;
+			vertex_copy[it] = v ;
+			vertices.push_back(v) ;
+			from_vertices.push_back(it) ;
+		}
+		FOR_EACH_HALFEDGE(Map, from, it) {
+			Halfedge* h = halfedges_.create() ;
+			halfedge_copy[it] = h ;
+			halfedges.push_back(h) ;
+			from_halfedges.push_back(it) ;
+		}
+		FOR_EACH_FACET(Map, from, it) {
+			Facet* f = facets_.create() ;
+			facet_copy[it] = f ;
+			facets.push_back(f) ;
+			from_facets.push_back(it) ;
+		}
+
+		// the links
+		for(std::size_t i=0; i<vertices.size(); i++) {
+			const Vertex* v = from_vertices[i] ;
+			vertices[i]->set_halfedge(v->halfedge() == nil ? nil : halfedge_copy[v->halfedge()]) ;
+		}
+		for(std::size_t i=0; i<halfedges.size(); i++) {
+			const Halfedge* h = from_halfedges[i] ;
+			Halfedge* copy = halfedges[i] ;
+			copy->set_opposite(halfedge_copy[h->opposite()]) ;
+			copy->set_next(halfedge_copy[h->next()]) ;
+			copy->set_prev(halfedge_copy[h->prev()]) ;
+			copy->set_vertex(h->vertex() == nil ? nil : vertex_copy[h->vertex()]) ;
+			copy->set_facet(h->facet() == nil ? nil : facet_copy[h->facet()]) ;
+		}
+		for(std::size_t i=0; i<facets.size(); i++) {
+			facets[i]->set_halfedge(halfedge_copy[from_facets[i]->halfedge()]) ;
+		}
+
+		// the attributes
+		clone_attributes(vertex_attribute_manager_, from->vertex_attribute_manager(), vertices, from_vertices, vertex_attributes) ;
+		clone_attributes(halfedge_attribute_manager_, from->halfedge_attribute_manager(), halfedges, from_halfedges, halfedge_attributes) ;
+		clone_attributes(facet_attribute_manager_, from->facet_attribute_manager(), facets, from_facets, facet_attributes) ;
+
+		for(std::size_t i=0; i<vertices.size(); i++) {
+			notify_add_vertex(vertices[i]) ;
+		}
+		for(std::size_t i=0; i<halfedges.size(); i++) {
+			notify_add_halfedge(halfedges[i]) ;
+		}
+		for(std::size_t i=0; i<facets.size(); i++) {
+			notify_add_facet(facets[i]) ;
+		}
+		invalidate_bbox() ;
+}
 
 void Map::clear_inactive_items() {
 	// TODO: traverse the inactive items list, 
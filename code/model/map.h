@@ -48,9 +48,13 @@
 #include "../basic/attribute.h"
 #include "../basic/counted.h"
 #include "../basic/smart_pointer.h"
+#include "../basic/memory_usage.h"
 
 #include <vector>
 #include <list>
+#include <unordered_set>
+#include <set>
+#include <string>
 
 
 
@@ -97,6 +101,7 @@ private:
 */
 
 class MapMutator ;
+class MapCopier ;
 
 
 class MODEL_API Map : public Counted
@@ -126,7 +131,7 @@ public:
 
 	// ______________ constructor and destructor ___________________
 
-	Map() : bbox_is_valid_(false) {}
+	Map() : bulk_edit_depth_(0), id_(new_id()), version_(0), bbox_is_valid_(false) {}
 
 	virtual ~Map();
 
@@ -153,6 +158,23 @@ public:
 	const Box3d& bbox() const;
 	void invalidate_bbox() { bbox_is_valid_ = false; }
 
+	/**
+	* The (id, version) pair identifies the state of the map, e.g., for the data derived 
+	* from it (such as the buffers of the renderer). The id is unique to each map, and the 
+	* version changes every time elements are created or deleted. The clients that modify 
+	* the geometry or the attributes (e.g., move vertices, change the colors) directly must
+	* call notify_change().
+	*/
+	unsigned int id() const { return id_; }
+	unsigned int version() const { return version_; }
+	void notify_change() { ++version_; }
+
+	/**
+	* the memory used by the elements ("vertices", "halfedges", "facets") 
+	* and by the attributes of each kind of element (e.g., "facet attributes/normal").
+	*/
+	MemoryUsage memory_usage() const ;
+
 	// ___________________ attributes _______________________
 
 	VertexAttributeManager* vertex_attribute_manager() const {
@@ -188,6 +210,38 @@ public:
 	void clear() ;
 	void clear_inactive_items() ;
 
+	/**
+	* removes all the elements, like clear(), but keeps the memory 
+	* of the elements and of the attributes (which stay bound), such 
+	* that the map can be reused for a similar task without allocations.
+	*/
+	void recycle() ;
+
+	/**
+	* improves the locality of the accesses after heavy editing: the facets are put 
+	* in the given order (by default, the order of the Morton codes of their centers),
+	* the halfedges facet by facet (each one followed by its opposite), and the vertices 
+	* in the order the halfedges reach them. The attributes are moved accordingly and 
+	* the chunks no longer used are released. Note that the elements are not moved in 
+	* memory, only their order and the storage of their attributes change. The map must
+	* not have inactive items, nor be in a bulk edit.
+	*/
+	void compact() ;
+	void compact(const std::vector<Facet*>& facets) ;
+
+	// __________________ bulk edits ________________________
+
+	/**
+	* starts a bulk edit (see MapBulkEdit), e.g., the many splits of a cut: the attribute 
+	* stores make room for the given numbers of new elements and grow geometrically, and 
+	* the observers are told of the new elements only at end_bulk_edit() (of those still 
+	* existing then). The removals of the other elements are notified right away. The bulk
+	* edits can be nested.
+	*/
+	void begin_bulk_edit(unsigned int nb_vertices = 0, unsigned int nb_halfedges = 0, unsigned int nb_facets = 0) ;
+	void end_bulk_edit() ;
+	bool in_bulk_edit() const { return bulk_edit_depth_ > 0 ; }
+
 	// __________________ stored normals ____________________
 
 	void compute_vertex_normals();
@@ -248,7 +302,22 @@ protected:
 	void deactivate_halfedge(Halfedge* h) ;
 	void deactivate_facet(Facet* f) ;
 
+	/**
+	* replaces the elements of this map with a copy of the (active) elements of from, 
+	* created in the same order, with the named attributes of from (all of them, or only
+	* the ones in the given sets). The attributes are cloned in bulk (see 
+	* AttributeManager::clone_records()), and the links are remapped through a table
+	* from the elements of from to their copies. See MapCopier::clone().
+	*/
+	void clone_from(
+		Map* from, 
+		const std::set<std::string>* vertex_attributes,
+		const std::set<std::string>* halfedge_attributes,
+		const std::set<std::string>* facet_attributes
+		) ;
+
 	friend class ::MapMutator ;
+	friend class ::MapCopier ;
 
 protected:
 	// MeshCombelObservers notification
@@ -274,6 +343,21 @@ private:
 	std::vector< MapCombelObserver<Halfedge>* >	halfedge_observers_ ;
 	std::vector< MapCombelObserver<Facet>* >	facet_observers_ ;
 
+	// the elements created during a bulk edit, which the observers are not told of yet
+	template <class CELL> struct PendingAdds {
+		std::vector<CELL*>			order ;	// in the order of creation
+		std::unordered_set<CELL*>	alive ;
+	} ;
+	int						bulk_edit_depth_ ;
+	PendingAdds<Vertex>		pending_vertices_ ;
+	PendingAdds<Halfedge>	pending_halfedges_ ;
+	PendingAdds<Facet>		pending_facets_ ;
+
+	static unsigned int new_id() ;
+
+	unsigned int	id_ ;
+	unsigned int	version_ ;
+
 	mutable bool	bbox_is_valid_;
 	mutable Box3d	bbox_;
 } ;
@@ -282,6 +366,24 @@ private:
 //______________________________________________________________
 
 
+/**
+* makes the edits done during its lifetime a bulk edit of the map (see Map::begin_bulk_edit()).
+*/
+class MODEL_API MapBulkEdit {
+public:
+	MapBulkEdit(Map* map, unsigned int nb_vertices = 0, unsigned int nb_halfedges = 0, unsigned int nb_facets = 0) : map_(map) {
+		map_->begin_bulk_edit(nb_vertices, nb_halfedges, nb_facets) ;
+	}
+	~MapBulkEdit() { map_->end_bulk_edit() ; }
+
+private:
+	Map* map_ ;
+} ;
+
+
+//______________________________________________________________
+
+
 /*
 * MapMutator is the base class for the classes that can modify the topology of a mesh.
 */
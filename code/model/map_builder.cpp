@@ -59,7 +59,8 @@ struct FacetKey {
 	Map::Vertex* v3 ;
 } ;
 
-static std::set<FacetKey>* all_facet_keys ;
+// thread local, so that different threads can build different maps at the same time
+static thread_local std::set<FacetKey>* all_facet_keys ;
 
 //_________________________________________________________
 
@@ -108,6 +109,10 @@ void MapBuilder::end_surface() {
 	if(color_.is_bound()) {
 		color_.unbind() ;
 	}
+	report_fixes() ;
+}
+
+void MapBuilder::report_fixes() {
 	if(!quiet_ && (nb_non_manifold_v_ != 0)) {
 		Logger::warn("MapBuilder") 
 			<< "Encountered " << nb_non_manifold_v_
@@ -129,6 +134,231 @@ void MapBuilder::end_surface() {
 	}
 }
 
+namespace {
+
+	const unsigned int NO_HALFEDGE = ~0u ;
+
+	// The connectivity of an indexed face set, with the halfedges of the facets first
+	// (halfedge c goes from the vertex of corner c to the next one) and then the border
+	// halfedges.
+	struct IndexedConnectivity {
+		std::vector<unsigned int> vertex ;			// the vertex each halfedge points to
+		std::vector<unsigned int> next ;
+		std::vector<unsigned int> prev ;
+		std::vector<unsigned int> opposite ;
+		std::vector<unsigned int> vertex_halfedge ;	// a halfedge pointing to each vertex
+		unsigned int nb_facet_halfedges ;
+
+		// returns false if the input needs to be fixed
+		bool build(
+			unsigned int nb_points, 
+			const std::vector<unsigned int>& face_offsets,
+			const std::vector<unsigned int>& face_indices
+			) {
+				unsigned int nb_facets = (unsigned int)face_offsets.size() - 1 ;
+				nb_facet_halfedges = (unsigned int)face_indices.size() ;
+
+				// Step 1 : the halfedges of the facets
+				vertex.resize(nb_facet_halfedges) ;
+				next.resize(nb_facet_halfedges) ;
+				prev.resize(nb_facet_halfedges) ;
+				std::vector<Numeric::uint64> keys(nb_facet_halfedges) ;
+				for(unsigned int f=0; f<nb_facets; f++) {
+					unsigned int b = face_offsets[f] ;
+					unsigned int e = face_offsets[f+1] ;
+					if(e < b + 3) {
+						return false ;
+					}
+					for(unsigned int c=b; c<e; c++) {
+						if(face_indices[c] >= nb_points) {
+							return false ;
+						}
+						for(unsigned int d=c+1; d<e; d++) {
+							if(face_indices[c] == face_indices[d]) {
+								return false ;
+							}
+						}
+						unsigned int n = (c + 1 < e) ? c + 1 : b ;
+						vertex[c] = face_indices[n] ;
+						next[c] = n ;
+						prev[n] = c ;
+						keys[c] = (Numeric::uint64(face_indices[c]) << 32) | face_indices[n] ;
+					}
+				}
+
+				// Step 2 : pair the halfedges, the sorted keys having the halfedge in the low bits
+				std::vector< std::pair<Numeric::uint64, unsigned int> > sorted(nb_facet_halfedges) ;
+				for(unsigned int c=0; c<nb_facet_halfedges; c++) {
+					sorted[c] = std::make_pair(keys[c], c) ;
+				}
+				std::sort(sorted.begin(), sorted.end()) ;
+				for(unsigned int i=1; i<nb_facet_halfedges; i++) {
+					if(sorted[i].first == sorted[i-1].first) {
+						return false ;	// duplicated edge
+					}
+				}
+				opposite.assign(nb_facet_halfedges, NO_HALFEDGE) ;
+				for(unsigned int c=0; c<nb_facet_halfedges; c++) {
+					Numeric::uint64 key = (keys[c] << 32) | (keys[c] >> 32) ;
+					std::vector< std::pair<Numeric::uint64, unsigned int> >::const_iterator it = 
+						std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(key, 0u)) ;
+					if(it != sorted.end() && it->first == key) {
+						opposite[c] = it->second ;
+					}
+				}
+
+				// Step 3 : the border halfedges (see MapBuilder::terminate_surface())
+				for(unsigned int c=0; c<nb_facet_halfedges; c++) {
+					if(opposite[c] == NO_HALFEDGE) {
+						opposite[c] = (unsigned int)vertex.size() ;
+						opposite.push_back(c) ;
+						vertex.push_back(vertex[prev[c]]) ;
+					}
+				}
+				unsigned int nb_halfedges = (unsigned int)vertex.size() ;
+				next.resize(nb_halfedges) ;
+				prev.resize(nb_halfedges) ;
+				for(unsigned int h=nb_facet_halfedges; h<nb_halfedges; h++) {
+					unsigned int n = opposite[h] ;
+					while(n < nb_facet_halfedges) {
+						n = opposite[prev[n]] ;
+					}
+					next[h] = n ;
+					unsigned int p = opposite[h] ;
+					while(p < nb_facet_halfedges) {
+						p = opposite[next[p]] ;
+					}
+					prev[h] = p ;
+				}
+
+				// Step 4 : check that the vertices are manifold, i.e., the halfedges
+				//   pointing to a vertex are all met when turning around it.
+				vertex_halfedge.assign(nb_points, NO_HALFEDGE) ;
+				std::vector<unsigned int> nb_incident(nb_points, 0) ;
+				for(unsigned int h=0; h<nb_halfedges; h++) {
+					if(h < nb_facet_halfedges) {
+						vertex_halfedge[vertex[h]] = h ;
+					}
+					nb_incident[vertex[h]]++ ;
+				}
+				for(unsigned int v=0; v<nb_points; v++) {
+					unsigned int h = vertex_halfedge[v] ;
+					if(h == NO_HALFEDGE) {
+						continue ;
+					}
+					unsigned int degree = 0 ;
+					unsigned int cir = h ;
+					do {
+						degree++ ;
+						cir = prev[opposite[cir]] ;
+					} while(cir != h && degree <= nb_incident[v]) ;
+					if(degree != nb_incident[v]) {
+						return false ;
+					}
+				}
+				return true ;
+		}
+	} ;
+
+}
+
+void MapBuilder::build_from_arrays(
+	const std::vector<vec3>& points, 
+	const std::vector<unsigned int>& face_offsets, 
+	const std::vector<unsigned int>& face_indices,
+	std::vector<Map::Facet*>* facets
+	) {
+		if(face_offsets.empty() || face_offsets.front() != 0 || face_offsets.back() != face_indices.size() ||
+			!std::is_sorted(face_offsets.begin(), face_offsets.end())
+			) {
+				Logger::err("MapBuilder") << "invalid face offsets" << std::endl ;
+				return ;
+		}
+		unsigned int nb_facets = (unsigned int)face_offsets.size() - 1 ;
+		if(facets != nil) {
+			facets->clear() ;
+		}
+
+		IndexedConnectivity connectivity ;
+		if(!connectivity.build((unsigned int)points.size(), face_offsets, face_indices)) {
+			// some of the facets or vertices need to be fixed
+			begin_surface() ;
+			for(std::size_t i=0; i<points.size(); i++) {
+				add_vertex(points[i]) ;
+			}
+			for(unsigned int f=0; f<nb_facets; f++) {
+				int nb = target()->size_of_facets() ;
+				begin_facet() ;
+				for(unsigned int c=face_offsets[f]; c<face_offsets[f+1]; c++) {
+					add_vertex_to_facet(int(face_indices[c])) ;
+				}
+				end_facet() ;
+				if(facets != nil) {
+					facets->push_back(target()->size_of_facets() > nb ? current_facet_ : nil) ;
+				}
+			}
+			end_surface() ;
+			return ;
+		}
+
+		transition(initial, final) ;
+		nb_non_manifold_v_ = 0 ;
+		nb_duplicate_e_    = 0 ;
+		nb_isolated_v_     = 0 ;
+
+		unsigned int nb_vertices = 0 ;
+		for(std::size_t v=0; v<points.size(); v++) {
+			if(connectivity.vertex_halfedge[v] != NO_HALFEDGE) {
+				nb_vertices++ ;
+			}
+		}
+		unsigned int nb_halfedges = (unsigned int)connectivity.vertex.size() ;
+		MapBulkEdit bulk_edit(target(), nb_vertices, nb_halfedges, nb_facets) ;
+
+		std::vector<Vertex*> vertices(points.size(), nil) ;
+		for(std::size_t v=0; v<points.size(); v++) {
+			if(connectivity.vertex_halfedge[v] == NO_HALFEDGE) {
+				nb_isolated_v_++ ;	// not created
+				continue ;
+			}
+			vertices[v] = new_vertex() ;
+			vertices[v]->set_point(points[v]) ;
+		}
+
+		std::vector<Map::Halfedge*> halfedges(nb_halfedges) ;
+		for(unsigned int h=0; h<nb_halfedges; h++) {
+			halfedges[h] = new_halfedge() ;
+		}
+		for(unsigned int h=0; h<nb_halfedges; h++) {
+			Map::Halfedge* cur = halfedges[h] ;
+			set_halfedge_vertex(cur, vertices[connectivity.vertex[h]]) ;
+			set_halfedge_opposite(cur, halfedges[connectivity.opposite[h]]) ;
+			make_sequence(cur, halfedges[connectivity.next[h]]) ;
+		}
+		for(std::size_t v=0; v<points.size(); v++) {
+			if(vertices[v] != nil) {
+				set_vertex_halfedge(vertices[v], halfedges[connectivity.vertex_halfedge[v]]) ;
+			}
+		}
+
+		if(facets != nil) {
+			facets->resize(nb_facets) ;
+		}
+		for(unsigned int f=0; f<nb_facets; f++) {
+			Map::Facet* facet = new_facet() ;
+			for(unsigned int c=face_offsets[f]; c<face_offsets[f+1]; c++) {
+				set_halfedge_facet(halfedges[c], facet) ;
+			}
+			set_facet_halfedge(facet, halfedges[face_offsets[f]]) ;
+			if(facets != nil) {
+				(*facets)[f] = facet ;
+			}
+		}
+
+		target()->assert_is_valid() ;
+		report_fixes() ;
+}
+
 void MapBuilder::reset() {
 	transition(final, initial) ;
 }
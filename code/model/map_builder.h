@@ -105,6 +105,22 @@ public:
 
 	virtual void create_vertices(unsigned int nb_vertices, bool with_colors = false) ;
 
+	/**
+	* builds the whole surface (i.e., in place of begin_surface() ... end_surface()) 
+	* from an indexed face set: the vertices of facet f are face_indices[face_offsets[f]] 
+	* to face_indices[face_offsets[f+1] - 1]. The halfedges are paired by sorting them,
+	* and all the elements are allocated at once. Input that needs to be fixed (invalid 
+	* facets, duplicated edges, non-manifold vertices) goes through the incremental path.
+	* If facets is given, it receives the facet created for each input facet (nil for
+	* the ignored ones).
+	*/
+	void build_from_arrays(
+		const std::vector<vec3>& points, 
+		const std::vector<unsigned int>& face_offsets, 
+		const std::vector<unsigned int>& face_indices,
+		std::vector<Map::Facet*>* facets = nil
+		) ;
+
 	Map::Vertex* current_vertex() ;
 	Map::Vertex* vertex(int i) ;
 	Map::Facet* current_facet() ;
@@ -162,6 +178,7 @@ private:
 		) ;
 
 	void terminate_surface() ;
+	void report_fixes() ;
 	friend class MapSerializer_eobj ;
 
 	void transition(state from, state to) ;
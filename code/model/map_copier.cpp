@@ -86,6 +86,74 @@ void MapCopier::copy(
 	}
 }
 
+void MapCopier::copy(
+					 MapBuilder& builder, Map* source,
+					 const std::vector<Map::Facet*>& facets,
+					 std::vector<Map::Facet*>& copies
+					 )
+{
+	bind_attribute_copiers(builder.target(), source) ;
+	MapVertexAttribute<int> vertex_id(source) ;
+	int cur_vertex_id = 0 ;
+
+	// Step 1 : clear vertex ids
+	FOR_EACH_VERTEX(Map, source, it) {
+		vertex_id[it] = -1 ;
+	}
+
+	// Step 2: enumerate the vertices of the facets
+	for(unsigned int i=0; i<facets.size(); i++) {
+		Map::Halfedge* h = facets[i]->halfedge() ;
+		do {
+			Map::Vertex* v = h->vertex() ;
+			if(vertex_id[v] == -1) {
+				vertex_id[v] = cur_vertex_id ;
+				builder.add_vertex(v->point()) ;
+				copy_vertex_attributes(builder.current_vertex(), v) ;
+				cur_vertex_id++ ;
+			}
+			h = h->next() ;
+		} while(h != facets[i]->halfedge()) ;
+	}
+
+	// Step 3: create facets, starting from the origin of their halfedge() 
+	copies.resize(facets.size()) ;
+	for(unsigned int i=0; i<facets.size(); i++) {
+		Map::Halfedge* h = facets[i]->halfedge() ;
+		builder.begin_facet() ;
+		do {
+			builder.add_vertex_to_facet(vertex_id[h->opposite()->vertex()]) ;
+			h = h->next() ;
+		} while(h != facets[i]->halfedge()) ;
+		builder.end_facet() ;
+		copies[i] = builder.current_facet() ;
+		copy_facet_attributes(copies[i], facets[i]) ;
+	}
+}
+
+void MapCopier::clone(Map* to, Map* from) {
+	if(copy_all_attributes_) {
+		to->clone_from(from, nil, nil, nil) ;
+	} else {
+		to->clone_from(
+			from, &vertex_attributes_to_copy_, &halfedge_attributes_to_copy_, &facet_attributes_to_copy_
+			) ;
+	}
+}
+
+void MapCopier::copy_facet_attributes(
+	Map* destination, const std::vector<Map::Facet*>& to,
+	Map* source, const std::vector<Map::Facet*>& from
+	)
+{
+	ogf_assert(to.size() == from.size()) ;
+	bind_attribute_copiers(destination, source) ;
+	for(unsigned int i=0; i<to.size(); ++i) {
+		if(to[i] != nil && from[i] != nil)
+			copy_facet_attributes(to[i], from[i]) ;
+	}
+}
+
 template <class RECORD> inline void bind_attribute_copiers(
 	std::vector< AttributeCopier<RECORD> >& copiers,
 	AttributeManager* to, AttributeManager* from,
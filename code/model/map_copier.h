@@ -150,6 +150,37 @@ public:
 		copy(to, from, vertex_id, cur_vertex_id) ;
 	}
 
+	/**
+	* replaces the content of to with a copy of from and of its attributes 
+	* (all of them, or the declared ones), much faster than copy() for a deep 
+	* copy: the elements are created at once, the links remapped through a 
+	* translation table, and the chunks of the trivially copyable attributes 
+	* copied wholesale (see Map::clone_from()). Note that, unlike copy(), the
+	* halfedge attributes are copied.
+	*/
+	void clone(Map* to, Map* from) ;
+
+	/**
+	* copies only the given facets of from (and their vertices), e.g., 
+	* to extract a selection without copying the whole mesh. copies[i]
+	* receives the copy of facets[i], whose halfedges correspond to the
+	* ones of facets[i] starting at their halfedge().
+	*/
+	void copy(
+		MapBuilder& to, Map* from, 
+		const std::vector<Map::Facet*>& facets,
+		std::vector<Map::Facet*>& copies
+		) ;
+
+	/**
+	* copies the attributes of the facets from[i] of source to the facets
+	* to[i] of destination (e.g., of the facets built from several ones)
+	*/
+	void copy_facet_attributes(
+		Map* destination, const std::vector<Map::Facet*>& to,
+		Map* source, const std::vector<Map::Facet*>& from
+		) ;
+
 protected:
 
 	// ------------------------------ copy attributes --------------------------------------------------------
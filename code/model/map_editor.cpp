@@ -653,3 +653,27 @@ void MapEditor::copy_attributes(Halfedge* to, Halfedge* from) {
 void MapEditor::copy_attributes(Facet* to, Facet* from) {
 	target()->facet_attribute_manager()->copy_record(to, from);
 }
+
+
+namespace {
+	template <class CELL>
+	void copy_records(AttributeManager* manager, const std::vector<CELL*>& to, const std::vector<CELL*>& from) {
+		ogf_assert(to.size() == from.size());
+		std::vector<Record*> lhs(to.begin(), to.end());
+		std::vector<const Record*> rhs(from.begin(), from.end());
+		if (!lhs.empty())
+			manager->copy_records(&lhs[0], &rhs[0], static_cast<unsigned int>(lhs.size()));
+	}
+}
+
+void MapEditor::copy_attributes(const std::vector<Vertex*>& to, const std::vector<Vertex*>& from) {
+	copy_records(target()->vertex_attribute_manager(), to, from);
+}
+
+void MapEditor::copy_attributes(const std::vector<Halfedge*>& to, const std::vector<Halfedge*>& from) {
+	copy_records(target()->halfedge_attribute_manager(), to, from);
+}
+
+void MapEditor::copy_attributes(const std::vector<Facet*>& to, const std::vector<Facet*>& from) {
+	copy_records(target()->facet_attribute_manager(), to, from);
+}
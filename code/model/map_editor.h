@@ -96,6 +96,11 @@ public:
 	void copy_attributes(Halfedge* to, Halfedge* from);
 	void copy_attributes(Facet* to, Facet* from);
 
+	// the same for many elements at once (to[i] gets the attributes of from[i]), attribute by attribute
+	void copy_attributes(const std::vector<Vertex*>& to, const std::vector<Vertex*>& from);
+	void copy_attributes(const std::vector<Halfedge*>& to, const std::vector<Halfedge*>& from);
+	void copy_attributes(const std::vector<Facet*>& to, const std::vector<Facet*>& from);
+
 protected:
 
 	//_________________ utilities ____________________
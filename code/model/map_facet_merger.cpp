@@ -0,0 +1,397 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "map_facet_merger.h"
+#include "map_attributes.h"
+#include "map_builder.h"
+#include "map_copier.h"
+#include "map_geometry.h"
+#include "iterators.h"
+#include "../basic/logger.h"
+#include "../basic/stop_watch.h"
+
+#include <algorithm>
+
+
+namespace {
+
+	typedef Map::Vertex		Vertex;
+	typedef Map::Halfedge	Halfedge;
+	typedef Map::Facet		Facet;
+
+
+	inline bool has_label(const Facet* f, const MapFacetAttribute<int>& label, int id) {
+		return f != nil && label[f] == id;
+	}
+
+
+	// numbers the planar regions of the facets from 0, returns the number of regions
+	int label_regions(Map* mesh, MapFacetAttribute<int>& region) {
+		MapFacetAttribute<Plane3d*> plane;
+		plane.bind_if_defined(mesh, "FacetSupportingPlane");
+		MapFacetAttribute<vec3> normal(mesh);
+		FOR_EACH_FACET(Map, mesh, it) {
+			region[it] = -1;
+			if (!plane.is_bound())
+				normal[it] = Geom::facet_normal(it);
+		}
+
+		int num = 0;
+		std::vector<Facet*> stack;
+		FOR_EACH_FACET(Map, mesh, it) {
+			if (region[it] != -1)
+				continue;
+			region[it] = num;
+			stack.push_back(it);
+			while (!stack.empty()) {
+				Facet* f = stack.back();
+				stack.pop_back();
+				Halfedge* h = f->halfedge();
+				do {
+					Facet* g = h->opposite()->facet();
+					if (g && region[g] == -1) {
+						bool coplanar = plane.is_bound() ? 
+							(plane[f] != nil && plane[g] == plane[f]) :
+							(dot(normal[f], normal[g]) > 1.0f - 1e-5f);
+						if (coplanar) {
+							region[g] = num;
+							stack.push_back(g);
+						}
+					}
+					h = h->next();
+				} while (h != f->halfedge());
+			}
+			++num;
+		}
+		return num;
+	}
+
+
+	// Can facet 'g' join the piece 'p' (a disk), the piece remaining a disk? The edges of 'g' shared
+	// with the piece must be a single run, and the other vertices of 'g' must not touch the piece.
+	bool can_join(Facet* g, int p, const MapFacetAttribute<int>& piece) {
+		std::vector<Halfedge*> edges;
+		std::vector<char> shared;
+		Halfedge* h = g->halfedge();
+		do {
+			edges.push_back(h);
+			shared.push_back(has_label(h->opposite()->facet(), piece, p));
+			h = h->next();
+		} while (h != g->halfedge());
+
+		const std::size_t n = edges.size();
+		std::size_t num_runs = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			if (shared[i] && !shared[(i + n - 1) % n])
+				++num_runs;
+		}
+		if (num_runs != 1)
+			return false;
+
+		// the vertex edges[i]->vertex() is where edges[i] ends and edges[i + 1] starts
+		for (std::size_t i = 0; i < n; ++i) {
+			if (shared[i] || shared[(i + 1) % n])
+				continue;
+			Halfedge* start = edges[i]->vertex()->halfedge();
+			Halfedge* c = start;
+			do {
+				if (has_label(c->facet(), piece, p))
+					return false;
+				c = c->next_around_vertex();
+			} while (c != start);
+		}
+		return true;
+	}
+
+
+	// numbers the pieces of the regions the merged facets are made of from 0, returns the number of pieces
+	int label_pieces(Map* mesh, const MapFacetAttribute<int>& region, MapFacetAttribute<int>& piece, std::vector<Facet*>& seeds) {
+		FOR_EACH_FACET(Map, mesh, it)
+			piece[it] = -1;
+
+		int num = 0;
+		std::vector<Facet*> added;
+		FOR_EACH_FACET(Map, mesh, it) {
+			if (piece[it] != -1)
+				continue;
+			piece[it] = num;
+			seeds.push_back(it);
+
+			// the neighbors of each facet added are tried (again), in the order of addition
+			added.assign(1, it);
+			for (std::size_t i = 0; i < added.size(); ++i) {
+				Facet* f = added[i];
+				Halfedge* h = f->halfedge();
+				do {
+					Facet* g = h->opposite()->facet();
+					if (g && piece[g] == -1 && region[g] == region[f] && can_join(g, num, piece)) {
+						piece[g] = num;
+						added.push_back(g);
+					}
+					h = h->next();
+				} while (h != f->halfedge());
+			}
+			++num;
+		}
+		return num;
+	}
+
+
+	// The boundary loops of the facets of the label of 'seed' (given by the halfedges, each pointing to 
+	// the next vertex of its loop), found by spreading from 'seed' over the facets of the label. Each 
+	// label is visited once ('reached' marks the facets and 'visited' the halfedges).
+	void boundary_loops(Facet* seed, const MapFacetAttribute<int>& label, MapFacetAttribute<char>& reached, MapHalfedgeAttribute<char>& visited, std::vector< std::vector<Halfedge*> >& loops) {
+		const int id = label[seed];
+		std::vector<Facet*> facets(1, seed);
+		std::vector<Facet*> stack(1, seed);
+		reached[seed] = 1;
+		while (!stack.empty()) {
+			Facet* f = stack.back();
+			stack.pop_back();
+			Halfedge* h = f->halfedge();
+			do {
+				Facet* g = h->opposite()->facet();
+				if (has_label(g, label, id) && !reached[g]) {
+					reached[g] = 1;
+					facets.push_back(g);
+					stack.push_back(g);
+				}
+				h = h->next();
+			} while (h != f->halfedge());
+		}
+
+		for (std::size_t i = 0; i < facets.size(); ++i) {
+			Halfedge* h = facets[i]->halfedge();
+			do {
+				if (!visited[h] && !has_label(h->opposite()->facet(), label, id)) {
+					loops.push_back(std::vector<Halfedge*>());
+					std::vector<Halfedge*>& loop = loops.back();
+					Halfedge* b = h;
+					do {
+						visited[b] = 1;
+						loop.push_back(b);
+						Halfedge* g = b->next();
+						while (has_label(g->opposite()->facet(), label, id))
+							g = g->opposite()->next();
+						b = g;
+					} while (b != h && !visited[b]);
+				}
+				h = h->next();
+			} while (h != facets[i]->halfedge());
+		}
+	}
+
+
+	// Is the vertex 'v' (ending the loop edge 'h' followed by the edge ending at 'next') a corner that must be 
+	// kept? It is unless it lies on a straight line between its neighbors and at most two labels (the border
+	// being one) meet it.
+	bool is_corner(Halfedge* h, const vec3& next, const MapFacetAttribute<int>& label) {
+		const vec3& p = h->opposite()->vertex()->point();
+		const vec3& v = h->vertex()->point();
+		vec3 a = v - p;
+		vec3 b = next - v;
+		double la = length(a), lb = length(b);
+		if (la <= 0 || lb <= 0 || dot(a, b) <= 0 || length(cross(a, b)) > 1e-6 * la * lb)
+			return true;
+
+		int labels[2] = { -2, -2 };
+		int num = 0;
+		Halfedge* start = h;
+		Halfedge* c = start;
+		do {
+			int l = c->facet() ? label[c->facet()] : -1;
+			if (l != labels[0] && l != labels[1]) {
+				if (num == 2)
+					return true;
+				labels[num++] = l;
+			}
+			c = c->next_around_vertex();
+		} while (c != start);
+		return false;
+	}
+
+
+	// the vertices of a loop that are kept (all of them if fewer than three are)
+	void loop_corners(const std::vector<Halfedge*>& loop, const MapFacetAttribute<int>& label, std::vector<Vertex*>& corners) {
+		corners.clear();
+		for (std::size_t i = 0; i < loop.size(); ++i) {
+			Halfedge* h = loop[i];
+			const vec3& next = loop[(i + 1) % loop.size()]->vertex()->point();
+			if (is_corner(h, next, label))
+				corners.push_back(h->vertex());
+		}
+		if (corners.size() < 3) {
+			corners.clear();
+			for (std::size_t i = 0; i < loop.size(); ++i)
+				corners.push_back(loop[i]->vertex());
+		}
+	}
+
+}
+
+
+Map* MapFacetMerger::merged(Map* mesh) {
+	StopWatch w;
+	Map* result = new Map;
+	if (!mesh || mesh->size_of_facets() == 0)
+		return result;
+
+	MapFacetAttribute<int> region(mesh);
+	label_regions(mesh, region);
+	MapFacetAttribute<int> piece(mesh);
+	std::vector<Facet*> seeds;
+	label_pieces(mesh, region, piece, seeds);
+
+	// the corners of the pieces, or of their facets if a piece isn't a disk (which can't be, but anyway)
+	MapVertexAttribute<int> index(mesh);
+	FOR_EACH_VERTEX(Map, mesh, it)
+		index[it] = -1;
+	MapFacetAttribute<char> reached(mesh);
+	FOR_EACH_FACET(Map, mesh, it)
+		reached[it] = 0;
+	MapHalfedgeAttribute<char> visited(mesh);
+	FOR_EACH_HALFEDGE(Map, mesh, it)
+		visited[it] = 0;
+
+	std::vector<vec3> points;
+	std::vector<unsigned int> face_offsets(1, 0);
+	std::vector<unsigned int> face_indices;
+	std::vector<Facet*> sources;
+	std::vector<int> regions;
+	std::vector<Vertex*> corners;
+	auto add_facet = [&](Facet* source, const std::vector<Vertex*>& vertices) {
+		for (std::size_t i = 0; i < vertices.size(); ++i) {
+			Vertex* v = vertices[i];
+			if (index[v] == -1) {
+				index[v] = static_cast<int>(points.size());
+				points.push_back(v->point());
+			}
+			face_indices.push_back(static_cast<unsigned int>(index[v]));
+		}
+		face_offsets.push_back(static_cast<unsigned int>(face_indices.size()));
+		sources.push_back(source);
+		regions.push_back(region[source]);
+	};
+
+	std::size_t num_dropped = 0;
+	for (std::size_t i = 0; i < seeds.size(); ++i) {
+		std::vector< std::vector<Halfedge*> > loops;
+		boundary_loops(seeds[i], piece, reached, visited, loops);
+		if (loops.size() == 1) {
+			loop_corners(loops[0], piece, corners);
+			num_dropped += loops[0].size() - corners.size();
+			add_facet(seeds[i], corners);
+			continue;
+		}
+		FOR_EACH_FACET(Map, mesh, it) {
+			if (piece[it] != piece[seeds[i]])
+				continue;
+			corners.clear();
+			Halfedge* h = it->halfedge();
+			do {
+				corners.push_back(h->vertex());
+				h = h->next();
+			} while (h != it->halfedge());
+			add_facet(it, corners);
+		}
+	}
+
+	MapBuilder builder(result);
+	builder.set_quiet(true);
+	std::vector<Facet*> facets;
+	builder.build_from_arrays(points, face_offsets, face_indices, &facets);
+
+	MapCopier copier;
+	copier.set_copy_all_attributes(true);
+	copier.copy_facet_attributes(result, facets, mesh, sources);
+
+	// the edges between different planes are sharp
+	MapFacetAttribute<int> facet_region(result);
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		if (facets[i])
+			facet_region[facets[i]] = regions[i];
+	}
+	MapHalfedgeAttribute<bool> edge_is_sharp(result, "SharpEdge");
+	FOR_EACH_EDGE(Map, result, it) {
+		Facet* f = it->facet();
+		Facet* g = it->opposite()->facet();
+		bool sharp = f && g && facet_region[f] != facet_region[g];
+		edge_is_sharp[it] = sharp;
+		edge_is_sharp[it->opposite()] = sharp;
+	}
+
+	Logger::out("-") << "merged " << mesh->size_of_facets() << " faces into " << result->size_of_facets()
+		<< " (" << num_dropped << " vertices dropped). " << w.elapsed() << " sec." << std::endl;
+	return result;
+}
+
+
+void MapFacetMerger::regions(Map* mesh, std::vector<Region>& result) {
+	result.clear();
+	if (!mesh)
+		return;
+
+	MapFacetAttribute<int> region(mesh);
+	int num = label_regions(mesh, region);
+
+	std::vector<Facet*> seeds(num, nil);
+	FOR_EACH_FACET(Map, mesh, it) {
+		if (!seeds[region[it]])
+			seeds[region[it]] = it;
+	}
+
+	MapFacetAttribute<char> reached(mesh);
+	FOR_EACH_FACET(Map, mesh, it)
+		reached[it] = 0;
+	MapHalfedgeAttribute<char> visited(mesh);
+	FOR_EACH_HALFEDGE(Map, mesh, it)
+		visited[it] = 0;
+
+	std::vector<Vertex*> corners;
+	for (int i = 0; i < num; ++i) {
+		std::vector< std::vector<Halfedge*> > loops;
+		boundary_loops(seeds[i], region, reached, visited, loops);
+
+		result.push_back(Region());
+		Region& r = result.back();
+		r.facet = seeds[i];
+		r.normal = Geom::facet_normal(seeds[i]);
+
+		// the outer boundary has the largest area along the normal
+		double max_area = -1e30;
+		for (std::size_t j = 0; j < loops.size(); ++j) {
+			loop_corners(loops[j], region, corners);
+			std::vector<vec3> ring(corners.size());
+			vec3 area(0, 0, 0);
+			for (std::size_t k = 0; k < corners.size(); ++k) {
+				ring[k] = corners[k]->point();
+				area = area + cross(corners[k]->point(), corners[(k + 1) % corners.size()]->point());
+			}
+			double a = dot(area, r.normal);
+			if (a > max_area) {
+				if (!r.outer.empty())
+					r.holes.push_back(r.outer);
+				r.outer.swap(ring);
+				max_area = a;
+			}
+			else
+				r.holes.push_back(ring);
+		}
+	}
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MAP_FACET_MERGER_H_
+#define _MAP_FACET_MERGER_H_
+
+#include "model_common.h"
+#include "map.h"
+
+#include <vector>
+
+
+/**
+* Merges the adjacent coplanar facets of a reconstructed model (e.g., the many pieces of a wall cut
+* by unrelated planes) into large polygons, for exporting, rendering, or GIS import. The facets are
+* coplanar if they have the same supporting plane (the "FacetSupportingPlane" attribute), or else the
+* same normal. The vertices left on the boundaries of the polygons that are no corners (i.e., on a
+* straight line between their neighbors) are dropped if no third polygon (nor the border) meets them,
+* so neighboring polygons stay watertight.
+*
+* The facets of a Map are simple polygons, so a planar region with holes (e.g., a wall with windows)
+* gives several facets in merged(), which grows each facet as long as it remains a disk. regions()
+* gives the whole regions, as an outer boundary and its holes.
+*/
+
+class MODEL_API MapFacetMerger
+{
+public:
+	// a planar region: the outer boundary (counterclockwise seen from the side of the normal of its 
+	// facets) and the holes (clockwise)
+	struct Region {
+		std::vector<vec3>				 outer;
+		std::vector< std::vector<vec3> > holes;
+		vec3							 normal;
+		Map::Facet*						 facet;		// one of the facets of the region in the mesh
+	};
+
+public:
+	// Returns a new mesh (to be deleted by the caller) with the merged facets, which get the facet 
+	// attributes of one of their facets. The edges between different planes are marked as sharp 
+	// edges (the "SharpEdge" attribute).
+	static Map* merged(Map* mesh);
+
+	// the planar regions of the mesh
+	static void regions(Map* mesh, std::vector<Region>& result);
+};
+
+
+#endif
@@ -39,7 +39,6 @@
 #include "map_geometry.h"
 #include "map_attributes.h"
 #include "map_copier.h"
-#include "map_builder.h"
 #include "../math/polygon2d.h"
 
 
@@ -173,6 +172,41 @@ namespace Geom {
 		return result ;
 	}
 
+	vec3 facet_center(const Map::Facet* f) {
+		vec3 result(0, 0, 0) ;
+		int nb = 0 ;
+		Map::Halfedge* cir = f->halfedge();
+		do {
+			result = result + cir->vertex()->point() ;
+			++nb ;
+			cir = cir->next() ;
+		} while(cir != f->halfedge()) ;
+		return result / double(nb) ;
+	}
+
+	// spreads the 21 lowest bits of x so that they are 3 bits apart
+	static Numeric::uint64 spread_bits(Numeric::uint64 x) {
+		x &= 0x1fffff ;
+		x = (x | (x << 32)) & 0x1f00000000ffffULL ;
+		x = (x | (x << 16)) & 0x1f0000ff0000ffULL ;
+		x = (x | (x << 8))  & 0x100f00f00f00f00fULL ;
+		x = (x | (x << 4))  & 0x10c30c30c30c30c3ULL ;
+		x = (x | (x << 2))  & 0x1249249249249249ULL ;
+		return x ;
+	}
+
+	Numeric::uint64 morton_code(const vec3& p, const Box3d& box) {
+		Numeric::uint64 code = 0 ;
+		for (unsigned int i = 0; i < 3; ++i) {
+			double extent = box.max(i) - box.min(i) ;
+			double t = (extent > 0) ? (p[i] - box.min(i)) / extent : 0.0 ;
+			t = ogf_max(0.0, ogf_min(t, 1.0)) ;
+			Numeric::uint64 x = Numeric::uint64(t * double(0x1fffff)) ;
+			code |= spread_bits(x) << i ;
+		}
+		return code ;
+	}
+
 	Box3d bounding_box(const Map* map) {
 		ogf_debug_assert(map->size_of_vertices() > 0);
 		Box3d result ;
@@ -189,12 +223,9 @@ namespace Geom {
 		Map* result = new Map;
 
 		if(result != nil) {
-			MapBuilder builder(result) ;
 			MapCopier copier ;
 			copier.set_copy_all_attributes(true) ;
-			builder.begin_surface() ;
-			copier.copy(builder, const_cast<Map*>(map)) ;
-			builder.end_surface() ;
+			copier.clone(result, const_cast<Map*>(map)) ;
 		}
 		return result ;
 	}
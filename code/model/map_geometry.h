@@ -59,8 +59,25 @@ namespace Geom {
 	MODEL_API Plane3d	facet_plane(const Map::Facet* f) ;
 	MODEL_API Polygon3d	facet_polygon(const Map::Facet* f) ;
 
+	// the same as above, writing into the caller's polygon 'plg' (e.g., a SmallPolygon3d)
+	template <class Polygon>
+	inline void facet_polygon(const Map::Facet* f, Polygon& plg) {
+		plg.clear() ;
+		Map::Halfedge* cir = f->halfedge() ;
+		do {
+			plg.push_back(cir->vertex()->point()) ;
+			cir = cir->next() ;
+		} while(cir != f->halfedge()) ;
+	}
+
 	double MODEL_API facet_area(const Map::Facet* f) ;
 
+	// the average of the vertices of the facet
+	MODEL_API vec3 facet_center(const Map::Facet* f) ;
+
+	// the position of p on the Z-order curve of box (21 bits per coordinate)
+	MODEL_API Numeric::uint64 morton_code(const vec3& p, const Box3d& box) ;
+
 	inline double edge_length(const Map::Halfedge* h) {
 		return length(vector(h)) ;
 	}
@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "map_geometry_cache.h"
+#include "map_geometry.h"
+
+
+MapGeometryCache::MapGeometryCache(Map* map) 
+	: MapCombelObserver<Map::Vertex>(map)
+	, MapCombelObserver<Map::Halfedge>(map)
+	, MapCombelObserver<Map::Facet>(map)
+	, stamp_(1)
+{
+	entries_.bind(map) ;
+}
+
+
+MapGeometryCache::~MapGeometryCache() {
+	entries_.unbind() ;
+}
+
+
+const vec3& MapGeometryCache::facet_normal(Map::Facet* f) {
+	Entry& e = entries_[f] ;
+	if (e.normal_stamp != stamp_) {
+		e.normal = Geom::facet_normal(f) ;
+		e.normal_stamp = stamp_ ;
+	}
+	return e.normal ;
+}
+
+
+double MapGeometryCache::facet_area(Map::Facet* f) {
+	Entry& e = entries_[f] ;
+	if (e.area_stamp != stamp_) {
+		e.area = Geom::facet_area(f) ;
+		e.area_stamp = stamp_ ;
+	}
+	return e.area ;
+}
+
+
+const Polygon2d& MapGeometryCache::facet_polygon_2d(Map::Facet* f, const Plane3d* plane) {
+	Entry& e = entries_[f] ;
+	if (e.polygon_stamp != stamp_ || e.frame != plane) {
+		// written in place, so an entry reuses the memory of its polygon
+		SmallPolygon3d plg ;
+		Geom::facet_polygon(f, plg) ;
+		Geom::to_2d(plane->point(), plane->base1(), plane->base2(), plg, e.polygon) ;
+		e.frame = plane ;
+		e.polygon_stamp = stamp_ ;
+	}
+	return e.polygon ;
+}
+
+
+void MapGeometryCache::invalidate(Map::Facet* f) {
+	Entry& e = entries_[f] ;
+	e.normal_stamp = 0 ;
+	e.area_stamp = 0 ;
+	e.polygon_stamp = 0 ;
+}
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _GEOM_MAP_GEOMETRY_CACHE_H_
+#define _GEOM_MAP_GEOMETRY_CACHE_H_
+
+#include "model_common.h"
+#include "map.h"
+#include "map_attributes.h"
+#include "../math/math_types.h"
+
+
+/**
+* MapGeometryCache keeps the geometry of the facets of a map (normal, area, and polygon 
+* in the 2d frame of a plane), computed on first request. It is opt-in: it exists only 
+* as long as the algorithm that creates it.
+*
+* The cache observes the map: creating or deleting a vertex, a halfedge or a facet 
+* invalidates all the entries. Moving vertices is not notified by the map, so call 
+* invalidate() (or invalidate(f)) after changing the positions.
+* The entries of different facets can be requested concurrently (e.g., from a 
+* parallel_for over the facets), provided the map is not edited meanwhile.
+*/
+
+class MODEL_API MapGeometryCache 
+	: public MapCombelObserver<Map::Vertex>
+	, public MapCombelObserver<Map::Halfedge>
+	, public MapCombelObserver<Map::Facet>
+{
+public:
+	MapGeometryCache(Map* map) ;
+	virtual ~MapGeometryCache() ;
+
+	const vec3& facet_normal(Map::Facet* f) ;
+	double facet_area(Map::Facet* f) ;
+
+	// the polygon of 'f' in the frame (point(), base1(), base2()) of 'plane'. 
+	// The polygon of a facet is kept for one plane at a time.
+	const Polygon2d& facet_polygon_2d(Map::Facet* f, const Plane3d* plane) ;
+
+	void invalidate() { ++stamp_ ; }
+	void invalidate(Map::Facet* f) ;
+
+	// MapCombelObserver interface
+	virtual void add(Map::Vertex* v)		{ invalidate() ; }
+	virtual void remove(Map::Vertex* v)		{ invalidate() ; }
+	virtual void add(Map::Halfedge* h)		{ invalidate() ; }
+	virtual void remove(Map::Halfedge* h)	{ invalidate() ; }
+	virtual void add(Map::Facet* f)			{ invalidate() ; }
+	virtual void remove(Map::Facet* f)		{ invalidate() ; }
+
+private:
+	struct Entry {
+		Entry() : normal_stamp(0), area_stamp(0), polygon_stamp(0), area(0.0), frame(nil) {}
+		unsigned int	normal_stamp ;
+		unsigned int	area_stamp ;
+		unsigned int	polygon_stamp ;
+		vec3			normal ;
+		double			area ;
+		const Plane3d*	frame ;
+		Polygon2d		polygon ;
+	} ;
+
+	MapFacetAttribute<Entry>	entries_ ;
+	unsigned int				stamp_ ;	// the entries with another stamp are out of date
+} ;
+
+#endif
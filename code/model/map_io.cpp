@@ -42,12 +42,16 @@
 #include "../basic/file_utils.h"
 #include "../model/map.h"
 #include "../basic/stop_watch.h"
+#include "../basic/tracer.h"
 #include "map_serializer.h"
 #include "map_serializer_obj.h"
+#include "map_serializer_ply.h"
+#include "map_serializer_glb.h"
 
 
 Map* MapIO::read(const std::string& file_name)
 {
+	TraceZone zone("MapIO::read", "io");
 	MapSerializer_var serializer = resolve_serializer(file_name);
 	if (!serializer.is_nil()) {
 		Map* mesh = new Map;
@@ -71,6 +75,7 @@ Map* MapIO::read(const std::string& file_name)
 
 bool MapIO::save(const std::string& file_name, const Map* mesh) 
 {
+	TraceZone zone("MapIO::save", "io");
 	MapSerializer_var serializer = resolve_serializer(file_name);
 	if (!serializer.is_nil()) {
 		StopWatch w;
@@ -105,6 +110,10 @@ MapSerializer* MapIO::resolve_serializer(const std::string& file_name) {
 		serializer = new MapSerializer_obj();
 	else if ( extension == "eobj" )
 		serializer = new MapSerializer_eobj();
+	else if ( extension == "ply" )
+		serializer = new MapSerializer_ply();
+	else if ( extension == "glb" )
+		serializer = new MapSerializer_glb();
 	else { 	
 		Logger::err("-") << "unknown file format" << std::endl;
 		return nil;
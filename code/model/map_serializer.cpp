@@ -41,8 +41,10 @@
 #include "../basic/assertions.h"
 #include "../model/map_builder.h"
 #include "map_serializer.h"
+#include "map_attributes.h"
 
 #include <fstream>
+#include <map>
 
 
 bool MapSerializer::do_read(
@@ -125,6 +127,28 @@ bool MapSerializer::serialize_write(
 
 
 
+bool MapSerializer::facet_plane_ids(const Map* mesh, std::vector<int>& ids) {
+	ids.clear() ;
+	Map* map = const_cast<Map*>(mesh) ;
+	if (!MapFacetAttribute<Plane3d*>::is_defined(map, "FacetSupportingPlane"))
+		return false ;
+
+	MapFacetAttribute<Plane3d*> supporting_plane(map, "FacetSupportingPlane") ;
+	std::map<const Plane3d*, int> numbers ;
+	ids.reserve(mesh->size_of_facets()) ;
+	FOR_EACH_FACET_CONST(Map, mesh, it) {
+		const Plane3d* plane = supporting_plane[it] ;
+		if (!plane) {
+			ids.push_back(-1) ;
+			continue ;
+		}
+		std::map<const Plane3d*, int>::iterator pos = numbers.insert(std::make_pair(plane, int(numbers.size()))).first ;
+		ids.push_back(pos->second) ;
+	}
+	return true ;
+}
+
+
 bool MapSerializer::binary() const {
 	return false ;
 }
@@ -97,6 +97,13 @@ protected:
 	virtual bool do_read(std::istream& in, AbstractMapBuilder& builder) ; 
 	virtual bool do_write(std::ostream& out, const Map* mesh) const;
 
+	/**
+	* numbers the supporting planes of the facets (the "FacetSupportingPlane" 
+	* attribute of the reconstructed models) in the order of the facets, -1 
+	* for no plane. Returns false if the mesh has no such attribute.
+	*/
+	static bool facet_plane_ids(const Map* mesh, std::vector<int>& ids) ;
+
 protected:
 	bool read_supported_ ;
 	bool write_supported_ ;
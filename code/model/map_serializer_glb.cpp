@@ -0,0 +1,182 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "map_serializer_glb.h"
+#include "map_enumerator.h"
+#include "../basic/parallel.h"
+
+#include <cstring>
+#include <sstream>
+#include <cfloat>
+
+
+namespace {
+
+	// the "componentType" and "target" values of glTF
+	const int GL_FLOAT = 5126;
+	const int GL_UNSIGNED_INT = 5125;
+	const int GL_ARRAY_BUFFER = 34962;
+	const int GL_ELEMENT_ARRAY_BUFFER = 34963;
+
+	// glTF is little endian, as are the hosts we build for
+	template <class T>
+	inline void append(std::vector<char>& buffer, const T& v) {
+		const char* p = reinterpret_cast<const char*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+	}
+
+	void write_buffer_view(std::ostream& json, std::size_t offset, std::size_t length, int target) {
+		json << "{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << length;
+		if (target != 0)
+			json << ",\"target\":" << target;
+		json << "}";
+	}
+}
+
+
+MapSerializer_glb::MapSerializer_glb() {
+	read_supported_ = false;
+	write_supported_ = true;
+}
+
+
+bool MapSerializer_glb::do_write(std::ostream& output, const Map* mesh) const {
+	Attribute<Vertex, int> vertex_id(mesh->vertex_attribute_manager());
+	MapEnumerator::enumerate_vertices(const_cast<Map*>(mesh), vertex_id);
+
+	std::vector<const Vertex*> vertices;
+	vertices.reserve(mesh->size_of_vertices());
+	FOR_EACH_VERTEX_CONST(Map, mesh, it)
+		vertices.push_back(it);
+
+	// the first triangle of each face
+	std::vector<const Facet*> facets;
+	facets.reserve(mesh->size_of_facets());
+	std::vector<std::size_t> first_triangle(1, 0);
+	first_triangle.reserve(mesh->size_of_facets() + 1);
+	FOR_EACH_FACET_CONST(Map, mesh, it) {
+		facets.push_back(it);
+		first_triangle.push_back(first_triangle.back() + ogf_max(it->degree(), 2) - 2);
+	}
+	const std::size_t num_triangles = first_triangle.back();
+
+	std::vector<int> plane_ids;
+	bool has_planes = facet_plane_ids(mesh, plane_ids);
+
+	// the binary buffer: the positions, the indices, the face of each triangle, and the plane of each face
+	const std::size_t positions_size = vertices.size() * 12;
+	const std::size_t indices_size = num_triangles * 12;
+	const std::size_t triangle_faces_size = num_triangles * 4;
+	const std::size_t face_planes_size = has_planes ? facets.size() * 4 : 0;
+	const std::size_t indices_offset = positions_size;
+	const std::size_t triangle_faces_offset = indices_offset + indices_size;
+	const std::size_t face_planes_offset = triangle_faces_offset + triangle_faces_size;
+	const std::size_t binary_size = face_planes_offset + face_planes_size;
+
+	std::vector<char> binary(binary_size + (4 - binary_size % 4) % 4, 0);
+	float* positions = reinterpret_cast<float*>(binary.data());
+	Numeric::uint32* indices = reinterpret_cast<Numeric::uint32*>(binary.data() + indices_offset);
+	Numeric::uint32* triangle_faces = reinterpret_cast<Numeric::uint32*>(binary.data() + triangle_faces_offset);
+	Numeric::int32* face_planes = reinterpret_cast<Numeric::int32*>(binary.data() + face_planes_offset);
+
+	parallel_for(vertices.size(), [&](std::size_t i) {
+		const vec3& p = vertices[i]->point();
+		positions[i * 3] = p.x;
+		positions[i * 3 + 1] = p.y;
+		positions[i * 3 + 2] = p.z;
+	});
+	parallel_for(facets.size(), [&](std::size_t i) {
+		const Halfedge* h = facets[i]->halfedge();
+		Numeric::uint32 first = static_cast<Numeric::uint32>(vertex_id[h->vertex()]);
+		std::size_t t = first_triangle[i];
+		for (const Halfedge* jt = h->next(); jt->next() != h; jt = jt->next(), ++t) {
+			indices[t * 3] = first;
+			indices[t * 3 + 1] = static_cast<Numeric::uint32>(vertex_id[jt->vertex()]);
+			indices[t * 3 + 2] = static_cast<Numeric::uint32>(vertex_id[jt->next()->vertex()]);
+			triangle_faces[t] = static_cast<Numeric::uint32>(i);
+		}
+		if (has_planes)
+			face_planes[i] = plane_ids[i];
+	});
+
+	// the bounding box is required for the positions
+	vec3 min_corner(FLT_MAX, FLT_MAX, FLT_MAX), max_corner(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (std::size_t i = 0; i < vertices.size(); ++i) {
+		const vec3& p = vertices[i]->point();
+		for (int a = 0; a < 3; ++a) {
+			min_corner[a] = ogf_min(min_corner[a], p[a]);
+			max_corner[a] = ogf_max(max_corner[a], p[a]);
+		}
+	}
+	if (vertices.empty())
+		min_corner = max_corner = vec3(0, 0, 0);
+
+	std::ostringstream json;
+	json.precision(9);
+	json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"PolyFit\"}";
+	json << ",\"extensionsUsed\":[\"POLYFIT_face_attributes\"]";
+	json << ",\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}]";
+	json << ",\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1,\"mode\":4";
+	json << ",\"extensions\":{\"POLYFIT_face_attributes\":{\"triangleFace\":2";
+	if (has_planes)
+		json << ",\"facePlane\":3";
+	json << "}}}]}]";
+	json << ",\"buffers\":[{\"byteLength\":" << binary.size() << "}]";
+	json << ",\"bufferViews\":[";
+	write_buffer_view(json, 0, positions_size, GL_ARRAY_BUFFER);
+	json << ",";
+	write_buffer_view(json, indices_offset, indices_size, GL_ELEMENT_ARRAY_BUFFER);
+	json << ",";
+	write_buffer_view(json, triangle_faces_offset, triangle_faces_size, 0);
+	if (has_planes) {
+		json << ",";
+		write_buffer_view(json, face_planes_offset, face_planes_size, 0);
+	}
+	json << "],\"accessors\":[";
+	json << "{\"bufferView\":0,\"componentType\":" << GL_FLOAT << ",\"count\":" << vertices.size() << ",\"type\":\"VEC3\""
+		<< ",\"min\":[" << min_corner.x << "," << min_corner.y << "," << min_corner.z << "]"
+		<< ",\"max\":[" << max_corner.x << "," << max_corner.y << "," << max_corner.z << "]}";
+	json << ",{\"bufferView\":1,\"componentType\":" << GL_UNSIGNED_INT << ",\"count\":" << num_triangles * 3 << ",\"type\":\"SCALAR\"}";
+	json << ",{\"bufferView\":2,\"componentType\":" << GL_UNSIGNED_INT << ",\"count\":" << num_triangles << ",\"type\":\"SCALAR\"}";
+	if (has_planes)	// the int32 ids are stored as uint32 (glTF has no 32-bit signed integers), -1 for no plane
+		json << ",{\"bufferView\":3,\"componentType\":" << GL_UNSIGNED_INT << ",\"count\":" << facets.size() << ",\"type\":\"SCALAR\"}";
+	json << "]}";
+
+	// the chunks are padded to 4 bytes, the JSON with spaces
+	std::string text = json.str();
+	text.append((4 - text.size() % 4) % 4, ' ');
+
+	std::vector<char> header;
+	const Numeric::uint32 total = static_cast<Numeric::uint32>(12 + 8 + text.size() + 8 + binary.size());
+	append(header, Numeric::uint32(0x46546C67));	// "glTF"
+	append(header, Numeric::uint32(2));
+	append(header, total);
+	append(header, Numeric::uint32(text.size()));
+	append(header, Numeric::uint32(0x4E4F534A));	// "JSON"
+	output.write(header.data(), header.size());
+	output.write(text.data(), text.size());
+
+	header.clear();
+	append(header, Numeric::uint32(binary.size()));
+	append(header, Numeric::uint32(0x004E4942));	// "BIN"
+	output.write(header.data(), header.size());
+	if (!binary.empty())
+		output.write(binary.data(), binary.size());
+	return !output.fail();
+}
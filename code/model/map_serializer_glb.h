@@ -0,0 +1,47 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MAP_SERIALIZER_GLB_H_
+#define _MAP_SERIALIZER_GLB_H_
+
+#include "model_common.h"
+#include "map_serializer.h"
+
+
+/**
+* Writes binary glTF 2.0 files (GLB) of the triangulated faces (each face is 
+* split into a fan, the faces of the reconstructed models being convex). The
+* extension "POLYFIT_face_attributes" of the primitive gives two accessors:
+* "triangleFace", the index of the original face of each triangle, and, if the
+* mesh has them, "facePlane", the supporting plane of each face (see 
+* MapSerializer::facet_plane_ids()). The buffers are written in one block.
+*/
+class MODEL_API MapSerializer_glb : public MapSerializer
+{
+public:
+	MapSerializer_glb();
+
+	virtual bool binary() const { return true; }
+
+protected:
+	virtual bool do_write(std::ostream& output, const Map* mesh) const;
+};
+
+
+#endif
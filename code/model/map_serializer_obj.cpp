@@ -43,9 +43,117 @@
 #include "../model/map_builder.h"
 #include "../model/map_enumerator.h"
 #include "../basic/generic_attributes_io.h"
+#include "../basic/mapped_file.h"
+#include "../basic/parallel.h"
+#include "../basic/text_io.h"
+
+#include <cstring>
+
+
+namespace {
+
+	using namespace TextIO;
+
+	// the v/f/anchor lines of a chunk of the file (the indices are zero-based)
+	struct ObjChunk {
+		ObjChunk() : unsupported(false) {}
+
+		std::vector<vec3>			points ;
+		std::vector<unsigned int>	face_sizes ;
+		std::vector<unsigned int>	face_indices ;
+		std::vector<std::size_t>	relative ;		// the face indices relative to the vertices of the chunk
+		std::vector<int>			anchors ;
+		bool						unsupported ;	// left to the stream reader
+	} ;
+
+	// parses the index of a corner ("i", "i/t", "i//n", or "i/t/n")
+	inline bool parse_corner(const char* first, const char* last, long long& index) {
+		bool negative = (*first == '-') ;
+		if (*first == '-' || *first == '+')
+			++first ;
+		const char* s = first ;
+		long long v = 0 ;
+		for (; s < last && *s >= '0' && *s <= '9'; ++s)
+			v = v * 10 + (*s - '0') ;
+		if (s == first || (s < last && *s != '/'))
+			return false ;
+		index = negative ? -v : v ;
+		return true ;
+	}
 
+	void parse_obj_chunk(const char* p, const char* end, ObjChunk& chunk) {
+		while (p < end && !chunk.unsupported) {
+			const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p)) ;
+			if (!eol)
+				eol = end ;
+
+			const char* first, *last ;
+			if (next_token(p, eol, first, last)) {
+				std::size_t length = last - first ;
+				if (length == 1 && *first == 'v') {
+					vec3 q ;
+					if (read_float(p, eol, q.x) && read_float(p, eol, q.y) && read_float(p, eol, q.z))
+						chunk.points.push_back(q) ;
+					else
+						chunk.unsupported = true ;
+				} 
+				else if (length == 1 && *first == 'f') {
+					unsigned int num = 0 ;
+					while (next_token(p, eol, first, last)) {
+						long long index = 0 ;
+						if (!parse_corner(first, last, index) || index == 0) {
+							chunk.unsupported = true ;
+							break ;
+						}
+						if (index < 0) {	// counted back from the last vertex read
+							chunk.relative.push_back(chunk.face_indices.size()) ;
+							index += static_cast<long long>(chunk.points.size()) + 1 ;
+						}
+						chunk.face_indices.push_back(static_cast<unsigned int>(index - 1)) ;
+						++num ;
+					}
+					chunk.face_sizes.push_back(num) ;
+				}
+				else if (length == 1 && *first == '#') {
+					std::string second_keyword ;
+					if (read_string(p, eol, second_keyword) && second_keyword == "anchor") {
+						int index = 0 ;
+						if (read_integer(p, eol, index))
+							chunk.anchors.push_back(index - 1) ;
+					}
+				}
+				else if ((length == 6 && std::strncmp(first, "mtllib", 6) == 0) || (length == 6 && std::strncmp(first, "usemtl", 6) == 0))
+					chunk.unsupported = true ;
+			}
+			p = eol + 1 ;
+		}
+	}
+
+
+	// Writes the lines of the items [0, n), format(i, text) appending the line of item i. The text of 
+	// consecutive chunks is formatted by different threads, and written at once.
+	template <class Format>
+	void write_lines(std::ostream& output, std::size_t n, const Format& format) {
+		const std::size_t chunk_size = 16 * 1024 ;
+		std::size_t num_chunks = std::size_t(parallel_num_threads()) * 2 ;
+		std::vector<std::string> texts(num_chunks) ;
+		for (std::size_t start = 0; start < n; start += num_chunks * chunk_size) {
+			parallel_for(num_chunks, [&](std::size_t i) {
+				std::size_t first = start + i * chunk_size ;
+				std::size_t last = ogf_min(first + chunk_size, n) ;
+				std::string& text = texts[i] ;
+				text.clear() ;
+				for (std::size_t j = first; j < last; ++j)
+					format(j, text) ;
+			}) ;
+			for (std::size_t i = 0; i < num_chunks; ++i)
+				output.write(texts[i].data(), texts[i].size()) ;
+		}
+	}
+}
 
-MapSerializer_obj::MapSerializer_obj() {
+
+MapSerializer_obj::MapSerializer_obj() : in_memory_read_(true) {
 	read_supported_ = true ;
 	write_supported_ = true ;
 }
@@ -55,12 +163,80 @@ bool MapSerializer_obj::serialize_read(
 									   ) 
 {
 	current_directory_ = FileUtils::dir_name(file_name) ;
-	bool flag = MapSerializer::serialize_read(file_name, mesh) ;
+	bool flag = false ;
+	bool done = false ;
+	if (in_memory_read_ && mesh) {
+		MappedFile file(file_name) ;
+		if (file.is_open()) {
+			MapBuilder builder(mesh) ;
+			done = flag = read_in_memory(file.data(), file.size(), builder) ;
+		}
+	}
+	if (!done)
+		flag = MapSerializer::serialize_read(file_name, mesh) ;
 	current_directory_ = "" ;
 	return flag;
 }
 
 
+bool MapSerializer_obj::read_in_memory(const char* data, std::size_t size, AbstractMapBuilder& builder) {
+	// the chunks start at the beginning of a line
+	const std::size_t min_chunk_size = 1024 * 1024 ;
+	std::size_t num_chunks = ogf_max(std::size_t(1), ogf_min(size / min_chunk_size, std::size_t(parallel_num_threads()) * 4)) ;
+	const char* end = data + size ;
+	std::vector<const char*> bounds(num_chunks + 1) ;
+	bounds[0] = data ;
+	bounds[num_chunks] = end ;
+	for (std::size_t i = 1; i < num_chunks; ++i) {
+		const char* p = ogf_max(data + size / num_chunks * i, bounds[i - 1]) ;
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p)) ;
+		bounds[i] = eol ? eol + 1 : end ;
+	}
+
+	std::vector<ObjChunk> chunks(num_chunks) ;
+	parallel_for(num_chunks, [&](std::size_t i) {
+		parse_obj_chunk(bounds[i], bounds[i + 1], chunks[i]) ;
+	}) ;
+
+	// where the chunks go in the indexed face set
+	std::vector<std::size_t> first_point(num_chunks + 1, 0), first_face(num_chunks + 1, 0), first_index(num_chunks + 1, 0) ;
+	std::vector<int> anchors ;
+	for (std::size_t i = 0; i < num_chunks; ++i) {
+		if (chunks[i].unsupported)
+			return false ;
+		first_point[i + 1] = first_point[i] + chunks[i].points.size() ;
+		first_face[i + 1] = first_face[i] + chunks[i].face_sizes.size() ;
+		first_index[i + 1] = first_index[i] + chunks[i].face_indices.size() ;
+		anchors.insert(anchors.end(), chunks[i].anchors.begin(), chunks[i].anchors.end()) ;
+	}
+
+	std::vector<vec3>			points(first_point[num_chunks]) ;
+	std::vector<unsigned int>	face_offsets(first_face[num_chunks] + 1, 0) ;
+	std::vector<unsigned int>	face_indices(first_index[num_chunks]) ;
+	parallel_for(num_chunks, [&](std::size_t i) {
+		ObjChunk& chunk = chunks[i] ;
+		std::copy(chunk.points.begin(), chunk.points.end(), points.begin() + first_point[i]) ;
+
+		// the relative indices wrap around, so adding the offset gives the absolute index
+		const unsigned int offset = static_cast<unsigned int>(first_point[i]) ;
+		for (std::size_t k = 0; k < chunk.relative.size(); ++k)
+			chunk.face_indices[chunk.relative[k]] += offset ;
+		std::copy(chunk.face_indices.begin(), chunk.face_indices.end(), face_indices.begin() + first_index[i]) ;
+
+		unsigned int corner = static_cast<unsigned int>(first_index[i]) ;
+		for (std::size_t k = 0; k < chunk.face_sizes.size(); ++k) {
+			corner += chunk.face_sizes[k] ;
+			face_offsets[first_face[i] + k + 1] = corner ;
+		}
+		ObjChunk().points.swap(chunk.points) ;
+	}) ;
+	std::vector<ObjChunk>().swap(chunks) ;
+
+	build(builder, points, face_offsets, face_indices, anchors, std::vector<Color>(), std::size_t(-1)) ;
+	return true ;
+}
+
+
 void MapSerializer_obj::read_mtl_lib(std::istream& input) {
 	LineInputStream in(input) ;
 	std::string keyword ;
@@ -79,11 +255,17 @@ void MapSerializer_obj::read_mtl_lib(std::istream& input) {
 }
 
 bool MapSerializer_obj::do_read(std::istream& input, AbstractMapBuilder& builder) {
-	MapFacetAttribute<Color> color_ ;
 	LineInputStream in(input) ;
-	MapBuilder* concrete_builder = dynamic_cast<MapBuilder*>(&builder) ;
 
-	builder.begin_surface() ;
+	// the file is read into an indexed face set first, which a MapBuilder
+	// creates at once (see MapBuilder::build_from_arrays())
+	std::vector<vec3>			points ;
+	std::vector<unsigned int>	face_offsets(1, 0) ;
+	std::vector<unsigned int>	face_indices ;
+	std::vector<Color>			face_colors ;
+	std::vector<int>			anchors ;
+	std::size_t first_colored_face = std::size_t(-1) ;	// the faces after the first "usemtl"
+
 	while(!in.eof()) {
 		in.get_line() ;
 
@@ -93,13 +275,12 @@ bool MapSerializer_obj::do_read(std::istream& input, AbstractMapBuilder& builder
 		if(keyword == "v") {
 			vec3 p ;
 			in >> p ;
-			builder.add_vertex(p) ;
+			points.push_back(p) ;
 		} else if(keyword == "vt") {
 			vec2 q ;
 			in >> q ;
 			//builder.add_tex_vertex(q) ;
 		} else if(keyword == "f") {
-			builder.begin_facet() ;
 			while(!in.eol()) {
 				std::string s ;
 				in >> s ;
@@ -107,7 +288,7 @@ bool MapSerializer_obj::do_read(std::istream& input, AbstractMapBuilder& builder
 					std::istringstream v_input(s) ;
 					int index ;
 					v_input >> index ;
-					builder.add_vertex_to_facet(index - 1) ;
+					face_indices.push_back((unsigned int)(index - 1)) ;
 					char c ;
 					v_input >> c ;
 					if(c == '/') {
@@ -116,17 +297,15 @@ bool MapSerializer_obj::do_read(std::istream& input, AbstractMapBuilder& builder
 					}
 				}
 			}
-			builder.end_facet() ;
-			if(color_.is_bound() && concrete_builder != nil) {
-				color_[concrete_builder->current_facet()] = current_material_ ;
-			}
+			face_offsets.push_back((unsigned int)face_indices.size()) ;
+			face_colors.push_back(current_material_) ;
 		} else if(keyword == "#") {
 			std::string second_keyword ;
 			in >> second_keyword ;
 			if(second_keyword == "anchor") {
 				int index ;
 				in >> index ;
-				builder.lock_vertex(index - 1) ;
+				anchors.push_back(index - 1) ;
 			} 
 		} else if(keyword == "mtllib") {
 			std::string mtl_lib_filename ;
@@ -148,43 +327,116 @@ bool MapSerializer_obj::do_read(std::istream& input, AbstractMapBuilder& builder
 			} else {
 				current_material_ = it->second ;
 			}
-			if(!color_.is_bound() && concrete_builder != nil) {
-				color_.bind(concrete_builder->target(), "color") ;
+			if(first_colored_face == std::size_t(-1)) {
+				first_colored_face = face_colors.size() ;
 			}
 		}
 	}
-
-	builder.end_surface() ;
-	color_.unbind() ;
 	material_lib_.clear() ;
+
+	build(builder, points, face_offsets, face_indices, anchors, face_colors, first_colored_face) ;
 	return true ;
 }
 
+
+void MapSerializer_obj::build(
+	AbstractMapBuilder& builder, 
+	const std::vector<vec3>& points, 
+	const std::vector<unsigned int>& face_offsets, 
+	const std::vector<unsigned int>& face_indices,
+	const std::vector<int>& anchors,
+	const std::vector<Color>& face_colors, 
+	std::size_t first_colored_face
+	)
+{
+	MapBuilder* concrete_builder = dynamic_cast<MapBuilder*>(&builder) ;
+	unsigned int nb_facets = (unsigned int)face_offsets.size() - 1 ;
+	std::vector<Map::Facet*> facets ;
+	if(concrete_builder != nil && anchors.empty()) {
+		concrete_builder->build_from_arrays(points, face_offsets, face_indices, &facets) ;
+	} else {
+		builder.begin_surface() ;
+		for(std::size_t i=0; i<points.size(); i++) {
+			builder.add_vertex(points[i]) ;
+		}
+		for(std::size_t i=0; i<anchors.size(); i++) {
+			builder.lock_vertex(anchors[i]) ;
+		}
+		for(unsigned int f=0; f<nb_facets; f++) {
+			int nb = (concrete_builder != nil) ? concrete_builder->target()->size_of_facets() : 0 ;
+			builder.begin_facet() ;
+			for(unsigned int c=face_offsets[f]; c<face_offsets[f+1]; c++) {
+				builder.add_vertex_to_facet(int(face_indices[c])) ;
+			}
+			builder.end_facet() ;
+			if(concrete_builder != nil) {
+				bool created = concrete_builder->target()->size_of_facets() > nb ;
+				facets.push_back(created ? concrete_builder->current_facet() : nil) ;
+			}
+		}
+		builder.end_surface() ;
+	}
+
+	if(concrete_builder != nil && first_colored_face < facets.size()) {
+		MapFacetAttribute<Color> color(concrete_builder->target(), "color") ;
+		for(std::size_t f=first_colored_face; f<facets.size(); f++) {
+			if(facets[f] != nil) {
+				color[facets[f]] = face_colors[f] ;
+			}
+		}
+	}
+}
+
+
+void MapSerializer_obj::write_vertices_and_facets(std::ostream& output, const Map* mesh, const Attribute<Vertex, int>& vertex_id) {
+	std::vector<const Vertex*> vertices ;
+	vertices.reserve(mesh->size_of_vertices()) ;
+	FOR_EACH_VERTEX_CONST(Map, mesh, it)
+		vertices.push_back(it) ;
+
+	// as operator<<() with the precision of the stream
+	const int precision = static_cast<int>(output.precision()) ;
+	write_lines(output, vertices.size(), [&](std::size_t i, std::string& text) {
+		const vec3& p = vertices[i]->point() ;
+		text += "v " ;
+		append_float(text, p.x, precision) ;
+		text += ' ' ;
+		append_float(text, p.y, precision) ;
+		text += ' ' ;
+		append_float(text, p.z, precision) ;
+		text += '\n' ;
+	}) ;
+
+	std::vector<const Facet*> facets ;
+	facets.reserve(mesh->size_of_facets()) ;
+	FOR_EACH_FACET_CONST(Map, mesh, it)
+		facets.push_back(it) ;
+
+	write_lines(output, facets.size(), [&](std::size_t i, std::string& text) {
+		const Map::Halfedge* h = facets[i]->halfedge() ;
+		const Map::Halfedge* jt = h ;
+		text += "f " ;
+		do {
+			append_integer(text, vertex_id[jt->vertex()]) ;
+			text += ' ' ;
+			jt = jt->next() ;
+		} while(jt != h) ;
+		text += '\n' ;
+	}) ;
+}
+
+
 bool MapSerializer_obj::do_write(std::ostream& out, const Map* mesh) const {
 	// Obj files numbering starts with 1
 	Attribute<Vertex, int>	vertex_id(mesh->vertex_attribute_manager());
 	MapEnumerator::enumerate_vertices(const_cast<Map*>(mesh), vertex_id, 1);
 
-	// Output Vertices
-	FOR_EACH_VERTEX_CONST(Map, mesh, it) {
-		out << "v " << it->point() << std::endl ;
-	} 
-
-	// Output facets
-	FOR_EACH_FACET_CONST(Map, mesh, it) {
-		Map::Halfedge* jt = it->halfedge() ;
-		out << "f " ;
-		do {
-			out << vertex_id[jt->vertex()] << " ";
-			jt = jt->next() ;
-		} while(jt != it->halfedge()) ;
-		out << std::endl ;
-	}
+	write_vertices_and_facets(out, mesh, vertex_id) ;
 
 	MapVertexLock is_locked(const_cast<Map*>(mesh));
 	FOR_EACH_VERTEX_CONST(Map, mesh, it) {
 		if(is_locked[it]) {
-			out << "# anchor " << vertex_id[it] << std::endl ;
+			out << "# anchor " << vertex_id[it] << "\n" ;
 		}
 	}
 
@@ -194,6 +446,11 @@ bool MapSerializer_obj::do_write(std::ostream& out, const Map* mesh) const {
 //_________________________________________________________
 
 MapSerializer_eobj::MapSerializer_eobj() : MapSerializer_obj() {
+	in_memory_read_ = false ;	// the attributes are read through the stream
+}
+
+bool MapSerializer_eobj::binary() const {
+	return true ;
 }
 
 static Map::Halfedge* find_halfedge_between(Map::Vertex* v1, Map::Vertex* v2) {
@@ -219,6 +476,7 @@ bool MapSerializer_eobj::do_read(std::istream& input, AbstractMapBuilder& out)
 	std::vector< SerializedAttribute<Map::Facet>    > f_attributes ;
 
 	std::vector<Map::Facet*> facets ;
+	int num_vertices = 0 ;
 
 	bool surface_terminated = false ;
 
@@ -237,6 +495,7 @@ bool MapSerializer_eobj::do_read(std::istream& input, AbstractMapBuilder& out)
 			vec3 p ;
 			in >> p ;
 			builder.add_vertex(p) ;
+			++num_vertices ;
 		} else if(keyword == "vt") {
 			vec2 q ;
 			in >> q ;
@@ -323,6 +582,34 @@ bool MapSerializer_eobj::do_read(std::istream& input, AbstractMapBuilder& out)
 					Logger::warn("MapSerializer_eobj") << "Invalid attribute location:" 
 						<< location << std::endl ; 
 				}
+			} else if(second_keyword == "binary_attribute") {
+				if(!surface_terminated) {
+					builder.terminate_surface() ;
+					surface_terminated = true ;
+				}
+				// the chunk follows this line, in the order of the vertices (facets) in the file
+				std::string location ;
+				in >> location ;
+				bool ok = false ;
+				if(location == "v") {
+					std::vector<Map::Vertex*> vertices ;
+					vertices.reserve(num_vertices) ;
+					for(int i=0; i<num_vertices; i++) {
+						vertices.push_back(builder.vertex(i)) ;
+					}
+					SerializedAttribute<Map::Vertex> attribute ;
+					ok = attribute.read_binary(map->vertex_attribute_manager(), input, vertices) ;
+				} else if(location == "f") {
+					SerializedAttribute<Map::Facet> attribute ;
+					ok = attribute.read_binary(map->facet_attribute_manager(), input, facets) ;
+				}
+				if(!ok) {
+					Logger::warn("MapSerializer_eobj") << "Invalid binary attribute on location:" 
+						<< location << std::endl ; 
+					if(input.fail()) {
+						break ;
+					}
+				}
 			} else if(second_keyword == "anchor") {
 				int index ;
 				in >> index ;
@@ -352,27 +639,13 @@ bool MapSerializer_eobj::do_write(std::ostream& output, const Map* mesh) const {
 	// Obj files numbering starts with 1 (instead of 0)
 	MapEnumerator::enumerate_vertices(const_cast<Map*>(mesh), vertex_id, 1) ;
 
-	// Output Vertices
-	{ FOR_EACH_VERTEX_CONST(Map, mesh, it) {
-		output << "v " << it->point() << std::endl ;
-	}} 
-
-	// Output facets
-
-	{ FOR_EACH_FACET_CONST(Map, mesh, it) {
-		Halfedge* jt = it->halfedge() ;
-		output << "f " ;
-		do {
-			output << vertex_id[jt-> vertex()] << " " ;
-			jt = jt->next() ;
-		} while(jt != it->halfedge()) ;
-		output << std::endl ;
-	}}
-
+	// Output Vertices and facets
+	write_vertices_and_facets(output, mesh, vertex_id) ;
 
 	{
 		std::vector<SerializedAttribute<Map::Vertex> > attributes ;
-		if(get_serializable_attributes(mesh->vertex_attribute_manager(), attributes, output, "vertex")) {
+		std::vector<SerializedAttribute<Map::Vertex> > binary_attributes ;
+		if(get_serializable_attributes(mesh->vertex_attribute_manager(), attributes, binary_attributes, output, "vertex")) {
 			int vid = 1 ;
 			FOR_EACH_VERTEX_CONST(Map, mesh, it) {
 				const Map::Vertex* v = it ;
@@ -382,6 +655,18 @@ bool MapSerializer_eobj::do_write(std::ostream& output, const Map* mesh) const {
 				vid++ ;
 			}
 		}
+		if(!binary_attributes.empty()) {
+			std::vector<const Map::Vertex*> vertices ;
+			vertices.reserve(mesh->size_of_vertices()) ;
+			FOR_EACH_VERTEX_CONST(Map, mesh, it) {
+				vertices.push_back(it) ;
+			}
+			for(unsigned int i=0; i<binary_attributes.size(); i++) {
+				output << "# binary_attribute v" << std::endl ;
+				binary_attributes[i].write_binary(output, vertices) ;
+				output << std::endl ;
+			}
+		}
 	}
 
 	{
@@ -399,7 +684,8 @@ bool MapSerializer_eobj::do_write(std::ostream& output, const Map* mesh) const {
 
 	{
 		std::vector<SerializedAttribute<Map::Facet> > attributes ;
-		if(get_serializable_attributes(mesh->facet_attribute_manager(), attributes, output, "facet")) {
+		std::vector<SerializedAttribute<Map::Facet> > binary_attributes ;
+		if(get_serializable_attributes(mesh->facet_attribute_manager(), attributes, binary_attributes, output, "facet")) {
 			int fid = 1 ;
 			FOR_EACH_FACET_CONST(Map, mesh, it) {
 				const Map::Facet* f = it ;
@@ -409,6 +695,18 @@ bool MapSerializer_eobj::do_write(std::ostream& output, const Map* mesh) const {
 				fid++ ;
 			}
 		}
+		if(!binary_attributes.empty()) {
+			std::vector<const Map::Facet*> facets ;
+			facets.reserve(mesh->size_of_facets()) ;
+			FOR_EACH_FACET_CONST(Map, mesh, it) {
+				facets.push_back(it) ;
+			}
+			for(unsigned int i=0; i<binary_attributes.size(); i++) {
+				output << "# binary_attribute f" << std::endl ;
+				binary_attributes[i].write_binary(output, facets) ;
+				output << std::endl ;
+			}
+		}
 	}
 
 	output << "# END" << std::endl ;
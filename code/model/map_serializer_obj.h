@@ -43,6 +43,12 @@
 #include "../basic/color.h"
 
 
+/**
+* A file is read through a memory mapping, its chunks being parsed by
+* different threads, unless it uses materials (it is then read through
+* the stream). The lines are written in large buffers, formatted by 
+* chunks in parallel.
+*/
 class MODEL_API MapSerializer_obj : public MapSerializer 
 {
 public:
@@ -57,7 +63,26 @@ protected:
 	virtual bool do_write(std::ostream& output, const Map* mesh) const; 
 	void read_mtl_lib(std::istream& input) ;
 
+	// parses the mapped file in parallel. Returns false if the file needs the stream reader
+	// (e.g., it uses materials), before anything is built.
+	bool read_in_memory(const char* data, std::size_t size, AbstractMapBuilder& builder) ;
+
+	// creates the mesh from the indexed face set read
+	void build(
+		AbstractMapBuilder& builder, 
+		const std::vector<vec3>& points, 
+		const std::vector<unsigned int>& face_offsets, 
+		const std::vector<unsigned int>& face_indices,
+		const std::vector<int>& anchors,
+		const std::vector<Color>& face_colors, 
+		std::size_t first_colored_face
+		) ;
+
+	// the "v" and "f" lines ('vertex_id' numbering the vertices from 1)
+	static void write_vertices_and_facets(std::ostream& output, const Map* mesh, const Attribute<Vertex, int>& vertex_id) ;
+
 protected:
+	bool		in_memory_read_ ;	// false for the formats extending obj
 	std::string	current_directory_ ;
 
 	typedef Color Material ;
@@ -71,7 +96,10 @@ protected:
 //_________________________________________________________
 
 /**
-* Extended obj file format, adds attributes.
+* Extended obj file format, adds attributes. The attributes of the vertices and the facets
+* whose values are trivially copyable (e.g., double, int or vec3) are written as binary
+* chunks ("# binary_attribute v|f" lines followed by the chunk, see 
+* SerializedAttribute::write_binary()), the others as text.
 */
 class MODEL_API MapSerializer_eobj : public MapSerializer_obj {
 public:
@@ -80,6 +108,9 @@ public:
 	virtual bool do_read(std::istream& input, AbstractMapBuilder& builder) ;        
 	virtual bool do_write(std::ostream& output, const Map* mesh) const; 
 
+	// the binary chunks are read and written as they are
+	virtual bool binary() const ;
+
 } ;
 
 
@@ -0,0 +1,144 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "map_serializer_ply.h"
+#include "map_attributes.h"
+#include "map_enumerator.h"
+#include "../basic/parallel.h"
+#include "../basic/color.h"
+
+#include <cstring>
+#include <algorithm>
+
+
+namespace {
+
+	bool host_is_little_endian() {
+		const Numeric::uint16 one = 1;
+		return *reinterpret_cast<const unsigned char*>(&one) == 1;
+	}
+
+	template <class T>
+	inline void write_value(char*& p, T v, bool swap) {
+		if (swap)
+			std::reverse_copy(reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v) + sizeof(T), p);
+		else
+			std::memcpy(p, &v, sizeof(T));
+		p += sizeof(T);
+	}
+
+	inline Numeric::uint8 color_component(float v) {
+		v = v * 255.0f + 0.5f;
+		ogf_clamp(v, 0.0f, 255.0f);
+		return static_cast<Numeric::uint8>(v);
+	}
+}
+
+
+MapSerializer_ply::MapSerializer_ply() {
+	read_supported_ = false;
+	write_supported_ = true;
+}
+
+
+bool MapSerializer_ply::do_write(std::ostream& output, const Map* mesh) const {
+	Map* map = const_cast<Map*>(mesh);
+	Attribute<Vertex, int> vertex_id(mesh->vertex_attribute_manager());
+	MapEnumerator::enumerate_vertices(map, vertex_id);
+
+	std::vector<const Vertex*> vertices;
+	vertices.reserve(mesh->size_of_vertices());
+	FOR_EACH_VERTEX_CONST(Map, mesh, it)
+		vertices.push_back(it);
+
+	// where the faces start in the buffer
+	std::vector<const Facet*> facets;
+	facets.reserve(mesh->size_of_facets());
+	std::vector<std::size_t> num_corners;
+	num_corners.reserve(mesh->size_of_facets());
+	std::size_t max_degree = 0;
+	FOR_EACH_FACET_CONST(Map, mesh, it) {
+		facets.push_back(it);
+		num_corners.push_back(it->degree());
+		max_degree = ogf_max(max_degree, num_corners.back());
+	}
+
+	std::vector<int> plane_ids;
+	bool has_planes = facet_plane_ids(mesh, plane_ids);
+	bool has_colors = MapFacetAttribute<Color>::is_defined(map, "color");
+	MapFacetAttribute<Color> color;
+	if (has_colors)
+		color.bind(map, "color");
+
+	// the number of corners fits in a byte, unless a face is really large
+	bool byte_counts = (max_degree < 256);
+
+	output << "ply\n";
+	output << "format binary_little_endian 1.0\n";
+	output << "comment generated by PolyFit\n";
+	output << "element vertex " << vertices.size() << "\n";
+	output << "property float x\nproperty float y\nproperty float z\n";
+	output << "element face " << facets.size() << "\n";
+	output << "property list " << (byte_counts ? "uchar" : "int") << " int vertex_indices\n";
+	if (has_planes)
+		output << "property int plane_id\n";
+	if (has_colors)
+		output << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+	output << "end_header\n";
+
+	const std::size_t vertex_size = 12;
+	const std::size_t face_size = (byte_counts ? 1 : 4) + (has_planes ? 4 : 0) + (has_colors ? 3 : 0);
+	std::vector<std::size_t> face_offsets(facets.size() + 1, vertices.size() * vertex_size);
+	for (std::size_t i = 0; i < facets.size(); ++i)
+		face_offsets[i + 1] = face_offsets[i] + face_size + num_corners[i] * 4;
+
+	const bool swap = !host_is_little_endian();
+	std::vector<char> buffer(face_offsets.back());
+	parallel_for(vertices.size(), [&](std::size_t i) {
+		char* p = buffer.data() + i * vertex_size;
+		const vec3& q = vertices[i]->point();
+		for (int a = 0; a < 3; ++a)
+			write_value(p, q[a], swap);
+	});
+	parallel_for(facets.size(), [&](std::size_t i) {
+		char* p = buffer.data() + face_offsets[i];
+		if (byte_counts)
+			write_value(p, static_cast<Numeric::uint8>(num_corners[i]), swap);
+		else
+			write_value(p, static_cast<Numeric::int32>(num_corners[i]), swap);
+		const Halfedge* h = facets[i]->halfedge();
+		const Halfedge* jt = h;
+		do {
+			write_value(p, static_cast<Numeric::int32>(vertex_id[jt->vertex()]), swap);
+			jt = jt->next();
+		} while (jt != h);
+		if (has_planes)
+			write_value(p, static_cast<Numeric::int32>(plane_ids[i]), swap);
+		if (has_colors) {
+			const Color& c = color[facets[i]];
+			write_value(p, color_component(c.r()), swap);
+			write_value(p, color_component(c.g()), swap);
+			write_value(p, color_component(c.b()), swap);
+		}
+	});
+
+	if (!buffer.empty())
+		output.write(buffer.data(), buffer.size());
+	return !output.fail();
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MAP_SERIALIZER_PLY_H_
+#define _MAP_SERIALIZER_PLY_H_
+
+#include "model_common.h"
+#include "map_serializer.h"
+
+
+/**
+* Writes binary little endian PLY files of polygon faces. The faces have the
+* "plane_id" property (see MapSerializer::facet_plane_ids()) and the colors
+* of the "color" attribute, if the mesh has them. The vertices and the faces 
+* are formatted in a single buffer, written at once.
+*/
+class MODEL_API MapSerializer_ply : public MapSerializer
+{
+public:
+	MapSerializer_ply();
+
+	virtual bool binary() const { return true; }
+
+protected:
+	virtual bool do_write(std::ostream& output, const Map* mesh) const;
+};
+
+
+#endif
@@ -0,0 +1,359 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "map_validator.h"
+#include "map.h"
+#include "map_geometry.h"
+#include "triangle_tree.h"
+#include "../basic/logger.h"
+#include "../basic/profiler.h"
+#include "../basic/parallel.h"
+#include "../basic/stop_watch.h"
+
+#include <unordered_map>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cmath>
+
+
+namespace {
+
+	// the facets processed together (by a task)
+	const std::size_t num_chunk_facets = 1024;
+	// the intersecting facets kept in a report
+	const std::size_t max_examples = 10;
+
+
+	struct PositionHash {
+		std::size_t operator()(const vec3& p) const {
+			unsigned int bits[3];
+			std::memcpy(bits, p.data(), sizeof(bits));
+			return std::size_t(bits[0]) * 73856093u ^ std::size_t(bits[1]) * 19349663u ^ std::size_t(bits[2]) * 83492791u;
+		}
+	};
+
+	struct PositionEqual {
+		bool operator()(const vec3& a, const vec3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+	};
+
+
+	// a halfedge of a facet, from the vertex 'source' to the vertex 'target'
+	struct Side {
+		unsigned int source;
+		unsigned int target;
+		unsigned int facet;
+		unsigned int prev;		// the side before it in the facet (whose corner is at 'source')
+	};
+
+	inline Numeric::uint64 edge_key(unsigned int a, unsigned int b) {
+		return (Numeric::uint64(std::min(a, b)) << 32) | std::max(a, b);
+	}
+
+
+	// the corners at the vertices (a corner is denoted by the side ending at it), joined into the fans
+	class Fans {
+	public:
+		Fans(std::size_t n) : parent_(n) {
+			for (std::size_t i = 0; i < n; ++i)
+				parent_[i] = static_cast<unsigned int>(i);
+		}
+		unsigned int find(unsigned int i) {
+			while (parent_[i] != i) {
+				parent_[i] = parent_[parent_[i]];
+				i = parent_[i];
+			}
+			return i;
+		}
+		void join(unsigned int a, unsigned int b) {
+			a = find(a);
+			b = find(b);
+			if (a != b)
+				parent_[std::max(a, b)] = std::min(a, b);
+		}
+
+	private:
+		std::vector<unsigned int> parent_;
+	};
+
+
+	// whether the segment [s, t] crosses the triangle (a, b, c), the coplanar cases excluded
+	bool segment_crosses_triangle(const vec3& s, const vec3& t, const vec3& a, const vec3& b, const vec3& c) {
+		const vec3 d = t - s;
+		const vec3 e1 = b - a, e2 = c - a;
+		const vec3 p = cross(d, e2);
+		const double det = dot(e1, p);
+		const double scale = length(e1) * length(e2) * length(d);
+		if (std::fabs(det) <= 1e-9 * scale)
+			return false;
+		const double inv = 1.0 / det;
+		const vec3 q = s - a;
+		const double u = dot(q, p) * inv;
+		if (u < 0.0 || u > 1.0)
+			return false;
+		const vec3 r = cross(q, e1);
+		const double v = dot(d, r) * inv;
+		if (v < 0.0 || u + v > 1.0)
+			return false;
+		const double w = dot(e2, r) * inv;
+		return w >= 0.0 && w <= 1.0;
+	}
+
+}
+
+
+MapValidator::Report MapValidator::validate(const Map* mesh, bool screen_self_intersections, unsigned int num_threads) {
+	ProfileStage stage("validate");
+	StopWatch w;
+	Report report;
+
+	// the vertices by their positions
+	std::vector<unsigned int> vertex_ids;
+	vertex_ids.reserve(mesh->size_of_vertices());
+	std::unordered_map<const Map::Vertex*, unsigned int> vertex_index;
+	vertex_index.reserve(mesh->size_of_vertices());
+	{
+		std::unordered_map<vec3, unsigned int, PositionHash, PositionEqual> positions;
+		positions.reserve(mesh->size_of_vertices());
+		FOR_EACH_VERTEX_CONST(Map, mesh, it) {
+			const unsigned int id = static_cast<unsigned int>(positions.size());
+			vertex_index[it] = static_cast<unsigned int>(vertex_ids.size());
+			vertex_ids.push_back(positions.insert(std::make_pair(it->point(), id)).first->second);
+		}
+		report.num_vertices = positions.size();
+	}
+
+	std::vector<const Map::Facet*> facets;
+	facets.reserve(mesh->size_of_facets());
+	FOR_EACH_FACET_CONST(Map, mesh, it)
+		facets.push_back(it);
+	report.num_facets = facets.size();
+	if (facets.empty()) {
+		Logger::warn("-") << "the model has no face to validate" << std::endl;
+		return report;
+	}
+
+	// the sides of the facets (in parallel: their degrees, their offsets, then the sides)
+	const std::size_t num_chunks = (facets.size() + num_chunk_facets - 1) / num_chunk_facets;
+	std::vector<unsigned int> offsets(facets.size() + 1, 0);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		const std::size_t last = std::min(facets.size(), (c + 1) * num_chunk_facets);
+		for (std::size_t f = c * num_chunk_facets; f < last; ++f)
+			offsets[f + 1] = facets[f]->degree();
+	}, nil, num_threads);
+	for (std::size_t f = 0; f < facets.size(); ++f)
+		offsets[f + 1] += offsets[f];
+
+	std::vector<Side> sides(offsets.back());
+	const Box3d& box = mesh->bbox();
+	const double min_area = 1e-12 * box.radius() * box.radius();
+	std::atomic<std::size_t> num_degenerate(0);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		std::size_t degenerate = 0;
+		const std::size_t last = std::min(facets.size(), (c + 1) * num_chunk_facets);
+		for (std::size_t f = c * num_chunk_facets; f < last; ++f) {
+			const unsigned int first = offsets[f];
+			const unsigned int degree = offsets[f + 1] - first;
+			const Map::Halfedge* h = facets[f]->halfedge();
+			unsigned int k = 0;
+			bool is_degenerate = degree < 3;
+			do {
+				Side& side = sides[first + k];
+				side.source = vertex_ids[vertex_index.find(h->opposite()->vertex())->second];
+				side.target = vertex_ids[vertex_index.find(h->vertex())->second];
+				side.facet = static_cast<unsigned int>(f);
+				side.prev = first + (k + degree - 1) % degree;
+				is_degenerate = is_degenerate || side.source == side.target;
+				h = h->next();
+				++k;
+			} while (h != facets[f]->halfedge());
+			if (is_degenerate || Geom::facet_area(facets[f]) <= min_area)
+				++degenerate;
+		}
+		num_degenerate += degenerate;
+	}, nil, num_threads);
+	report.num_degenerate_facets = num_degenerate;
+
+	// the edges: the sides sorted by their end points
+	std::vector< std::pair<Numeric::uint64, unsigned int> > edges;
+	edges.reserve(sides.size());
+	for (std::size_t i = 0; i < sides.size(); ++i) {
+		if (sides[i].source != sides[i].target)
+			edges.push_back(std::make_pair(edge_key(sides[i].source, sides[i].target), static_cast<unsigned int>(i)));
+	}
+	std::sort(edges.begin(), edges.end());
+
+	Fans fans(sides.size());
+	for (std::size_t i = 0; i < edges.size(); ) {
+		std::size_t j = i + 1;
+		while (j < edges.size() && edges[j].first == edges[i].first)
+			++j;
+		++report.num_edges;
+
+		if (j - i == 1)
+			++report.num_border_edges;
+		else if (j - i > 2)
+			++report.num_non_manifold_edges;
+		else {
+			const unsigned int a = edges[i].second, b = edges[i + 1].second;
+			if (sides[a].source == sides[b].source)
+				++report.num_inconsistent_edges;
+			// the corners of the two facets at each end of the edge are in the same fan
+			const unsigned int b_at_source = (sides[b].source == sides[a].source) ? sides[b].prev : b;
+			const unsigned int b_at_target = (sides[b].target == sides[a].target) ? b : sides[b].prev;
+			fans.join(sides[a].prev, b_at_source);
+			fans.join(a, b_at_target);
+		}
+		i = j;
+	}
+
+	// the fans around each vertex
+	std::vector< std::pair<unsigned int, unsigned int> > vertex_fans(sides.size());
+	for (std::size_t i = 0; i < sides.size(); ++i)
+		vertex_fans[i] = std::make_pair(sides[i].target, fans.find(static_cast<unsigned int>(i)));
+	std::sort(vertex_fans.begin(), vertex_fans.end());
+	vertex_fans.erase(std::unique(vertex_fans.begin(), vertex_fans.end()), vertex_fans.end());
+	for (std::size_t i = 1; i < vertex_fans.size(); ++i) {
+		if (vertex_fans[i].first == vertex_fans[i - 1].first && (i < 2 || vertex_fans[i - 2].first != vertex_fans[i].first))
+			++report.num_non_manifold_vertices;
+	}
+
+	if (screen_self_intersections) {
+		report.self_intersections_screened = true;
+		TriangleTree tree(mesh);
+		const std::size_t n = tree.num_triangles();
+		std::atomic<std::size_t> num_intersections(0);
+		std::mutex examples_mutex;
+		parallel_for((n + num_chunk_facets - 1) / num_chunk_facets, [&](std::size_t c) {
+			std::vector<unsigned int> candidates;
+			std::size_t found = 0;
+			const std::size_t last = std::min(n, (c + 1) * num_chunk_facets);
+			for (std::size_t t = c * num_chunk_facets; t < last; ++t) {
+				float box_min[3], box_max[3];
+				unsigned int ids[3];
+				for (int i = 0; i < 3; ++i) {
+					box_min[i] = std::min(std::min(tree.corner(t, 0)[i], tree.corner(t, 1)[i]), tree.corner(t, 2)[i]);
+					box_max[i] = std::max(std::max(tree.corner(t, 0)[i], tree.corner(t, 1)[i]), tree.corner(t, 2)[i]);
+					ids[i] = vertex_ids[tree.vertex(t, i)];
+				}
+				candidates.clear();
+				tree.overlapping(box_min, box_max, candidates);
+				for (std::size_t k = 0; k < candidates.size(); ++k) {
+					const unsigned int u = candidates[k];
+					if (u <= t || tree.facet(u) == tree.facet(t))
+						continue;
+					bool shared = false;
+					for (int i = 0; i < 3; ++i) {
+						const unsigned int id = vertex_ids[tree.vertex(u, i)];
+						shared = shared || id == ids[0] || id == ids[1] || id == ids[2];
+					}
+					if (shared)
+						continue;
+
+					bool crosses = false;
+					for (int i = 0; i < 3 && !crosses; ++i) {
+						crosses = segment_crosses_triangle(tree.corner(t, i), tree.corner(t, (i + 1) % 3), tree.corner(u, 0), tree.corner(u, 1), tree.corner(u, 2)) ||
+							segment_crosses_triangle(tree.corner(u, i), tree.corner(u, (i + 1) % 3), tree.corner(t, 0), tree.corner(t, 1), tree.corner(t, 2));
+					}
+					if (!crosses)
+						continue;
+					++found;
+					std::lock_guard<std::mutex> lock(examples_mutex);
+					const std::pair<unsigned int, unsigned int> pair(tree.facet(t), tree.facet(u));
+					std::vector< std::pair<unsigned int, unsigned int> >& examples = report.intersecting_facets;
+					if (examples.size() < max_examples && std::find(examples.begin(), examples.end(), pair) == examples.end())
+						examples.push_back(pair);
+				}
+			}
+			num_intersections += found;
+		}, nil, num_threads);
+		report.num_self_intersections = num_intersections;
+		std::sort(report.intersecting_facets.begin(), report.intersecting_facets.end());
+	}
+
+	Profiler::add_counter("border edges", double(report.num_border_edges));
+	Profiler::add_counter("non-manifold edges", double(report.num_non_manifold_edges));
+	Profiler::add_counter("non-manifold vertices", double(report.num_non_manifold_vertices));
+	Profiler::add_counter("inconsistent edges", double(report.num_inconsistent_edges));
+	Profiler::add_counter("self-intersections", double(report.num_self_intersections));
+
+	Logger::out("-") << "validated " << report.num_facets << " faces: " << report.summary() << ". " << w.elapsed() << " sec." << std::endl;
+	return report;
+}
+
+
+std::string MapValidator::Report::summary() const {
+	std::ostringstream output;
+	const char* separator = "";
+	if (num_facets == 0) {
+		output << "no face";
+		separator = ", ";
+	}
+	if (num_border_edges > 0) {
+		output << separator << "not closed (" << num_border_edges << " border edges)";
+		separator = ", ";
+	}
+	if (num_non_manifold_edges > 0) {
+		output << separator << num_non_manifold_edges << " non-manifold edges";
+		separator = ", ";
+	}
+	if (num_non_manifold_vertices > 0) {
+		output << separator << num_non_manifold_vertices << " non-manifold vertices";
+		separator = ", ";
+	}
+	if (num_inconsistent_edges > 0) {
+		output << separator << num_inconsistent_edges << " inconsistently oriented edges";
+		separator = ", ";
+	}
+	if (num_degenerate_facets > 0) {
+		output << separator << num_degenerate_facets << " degenerate faces";
+		separator = ", ";
+	}
+	if (num_self_intersections > 0) {
+		output << separator << num_self_intersections << " self-intersections";
+		separator = ", ";
+	}
+	if (std::string(separator).empty())
+		output << "closed, manifold and oriented";
+	return output.str();
+}
+
+
+std::string MapValidator::Report::to_json() const {
+	std::ostringstream output;
+	output << "{\"valid\": " << (is_valid() ? "true" : "false")
+		<< ", \"vertices\": " << num_vertices
+		<< ", \"edges\": " << num_edges
+		<< ", \"faces\": " << num_facets
+		<< ", \"border_edges\": " << num_border_edges
+		<< ", \"non_manifold_edges\": " << num_non_manifold_edges
+		<< ", \"non_manifold_vertices\": " << num_non_manifold_vertices
+		<< ", \"inconsistent_edges\": " << num_inconsistent_edges
+		<< ", \"degenerate_faces\": " << num_degenerate_facets;
+	if (self_intersections_screened) {
+		output << ", \"self_intersections\": " << num_self_intersections << ", \"intersecting_faces\": [";
+		for (std::size_t i = 0; i < intersecting_facets.size(); ++i)
+			output << (i > 0 ? ", [" : "[") << intersecting_facets[i].first << ", " << intersecting_facets[i].second << "]";
+		output << "]";
+	}
+	output << "}";
+	return output.str();
+}
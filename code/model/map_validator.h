@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MAP_VALIDATOR_H_
+#define _MAP_VALIDATOR_H_
+
+#include "model_common.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+
+class Map;
+
+
+/**
+* Checks that a model (e.g., a result, or a saved and reloaded one) is a closed, manifold and consistently 
+* oriented surface, e.g., for the gates of a batch. The vertices are identified by their positions (so the
+* copies of a vertex, e.g., split by the builder, are the same vertex), and the edges of the facets are 
+* paired by sorting their end points:
+*   - an edge of a single facet is a border edge (the surface is not closed), and an edge of more than two
+*     facets is non-manifold;
+*   - the two facets of an edge must traverse it in opposite directions (the property FaceSelection::
+*     re_orient() restores), or the edge is inconsistent;
+*   - the facets around a vertex must form a single fan through its manifold edges, or the vertex is
+*     non-manifold (e.g., two cubes touching at a corner);
+*   - a facet with fewer than three distinct corners, or no area, is degenerate.
+* The self-intersections are screened on the fans of the facets (see TriangleTree): the pairs of triangles 
+* of different facets without a common vertex are reported if an edge of one crosses the other (the 
+* coplanar overlaps are not), so a non-convex facet may be reported with its neighbors.
+*
+* The work is linear in the size of the model (except the sort of the edges), and the facets and the
+* screening are processed in parallel.
+*/
+
+class MODEL_API MapValidator
+{
+public:
+	struct Report {
+		Report() 
+			: num_vertices(0), num_edges(0), num_facets(0), num_border_edges(0), num_non_manifold_edges(0)
+			, num_inconsistent_edges(0), num_non_manifold_vertices(0), num_degenerate_facets(0)
+			, self_intersections_screened(false), num_self_intersections(0) {}
+
+		// the distinct vertices (by position) and edges
+		std::size_t num_vertices;
+		std::size_t num_edges;
+		std::size_t num_facets;
+
+		std::size_t num_border_edges;
+		std::size_t num_non_manifold_edges;
+		std::size_t num_inconsistent_edges;
+		std::size_t num_non_manifold_vertices;
+		std::size_t num_degenerate_facets;
+
+		bool		self_intersections_screened;
+		std::size_t num_self_intersections;		// the pairs of triangles
+		std::vector< std::pair<unsigned int, unsigned int> > intersecting_facets;	// a few of them (their indices)
+
+		bool is_closed() const   { return num_border_edges == 0; }
+		bool is_manifold() const { return num_non_manifold_edges == 0 && num_non_manifold_vertices == 0; }
+		bool is_oriented() const { return num_inconsistent_edges == 0; }
+		// closed, manifold, oriented, and without degenerate facets (the self-intersections are only screened)
+		bool is_valid() const    { return num_facets > 0 && is_closed() && is_manifold() && is_oriented() && num_degenerate_facets == 0; }
+
+		// e.g., "not closed (12 border edges), 2 non-manifold vertices"
+		std::string summary() const;
+		std::string to_json() const;
+	};
+
+	static Report validate(const Map* mesh, bool screen_self_intersections = true, unsigned int num_threads = 0);
+};
+
+
+#endif
@@ -0,0 +1,262 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "paged_point_set.h"
+#include "point_set.h"
+#include "vertex_group.h"
+#include "../basic/logger.h"
+
+#include <algorithm>
+
+
+namespace {
+	// the number of points in a page (768 KB of positions)
+	const std::size_t page_size = 65536;
+
+	template <class T>
+	bool read(std::ifstream& input, T& v) {
+		return !input.read(reinterpret_cast<char*>(&v), sizeof(T)).fail();
+	}
+}
+
+
+PagedPointSet::PagedPointSet(std::size_t cache_size)
+	: num_points_(0)
+	, has_colors_(false)
+	, has_normals_(false)
+	, max_pages_(ogf_max(std::size_t(1), cache_size / (page_size * sizeof(vec3))))
+	, num_page_reads_(0)
+{
+	block_offsets_[0] = block_offsets_[1] = block_offsets_[2] = 0;
+}
+
+
+// see PointSetSerializer_vg::save_bvg() for the layout of the file
+bool PagedPointSet::open(const std::string& file_name) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	file_.close();
+	file_.clear();
+	file_.open(file_name.c_str(), std::fstream::binary);
+	if (file_.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return false;
+	}
+	file_name_ = file_name;
+	segments_.clear();
+	pages_.clear();
+	page_table_.clear();
+
+	file_.seekg(0, file_.end);
+	std::streamoff length = file_.tellg();
+	file_.seekg(0, file_.beg);
+
+	// the blocks of points, colors and normals
+	std::streamoff offset = 0;
+	int num[3] = { 0, 0, 0 };
+	for (int b = 0; b < 3; ++b) {
+		file_.seekg(offset);
+		if (!read(file_, num[b]) || num[b] < 0) {
+			Logger::err("-") << "file \'" << file_name << "\' is not a valid .bvg file" << std::endl;
+			return false;
+		}
+		block_offsets_[b] = offset + std::streamoff(sizeof(int));
+		offset = block_offsets_[b] + std::streamoff(num[b]) * std::streamoff(sizeof(vec3));
+		if (offset > length) {
+			Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+			return false;
+		}
+	}
+	num_points_ = num[0];
+	has_colors_ = (num[1] == num[0] && num[0] > 0);
+	has_normals_ = (num[2] == num[0] && num[0] > 0);
+
+	// the descriptions of the segments, skipping their indices (and their children)
+	int num_groups = 0;
+	file_.seekg(offset);
+	if (!read(file_, num_groups))
+		return true;	// no groups
+
+	for (int i = 0; i < num_groups; ++i) {
+		int num_children = 0;
+		bool valid = true;
+		for (int j = 0; valid && j <= num_children; ++j) {
+			int type = 0, num_para = 0, num_char = 0, num_pts = 0;
+			valid = read(file_, type) && read(file_, num_para) && num_para == 4;
+			float para[4], rgb[3];
+			valid = valid && read(file_, para) && read(file_, num_char) && num_char >= 0;
+			std::string label(valid ? num_char : 0, ' ');
+			valid = valid && (num_char == 0 || !file_.read(&label[0], num_char).fail());
+			valid = valid && read(file_, rgb) && read(file_, num_pts) && num_pts >= 0;
+			if (!valid)
+				break;
+
+			if (j == 0) {
+				Segment s;
+				label.erase(std::remove(label.begin(), label.end(), ' '), label.end());	// as read_binary_string()
+				s.label = label;
+				s.color = Color(rgb[0], rgb[1], rgb[2]);
+				s.plane = Plane3d(para[0], para[1], para[2], para[3]);
+				s.size = num_pts;
+				s.indices_offset = file_.tellg();
+				segments_.push_back(s);
+			}
+			file_.seekg(std::streamoff(num_pts) * std::streamoff(sizeof(int)), file_.cur);
+			if (j == 0)
+				valid = read(file_, num_children) && num_children >= 0;
+		}
+		if (!valid || file_.tellg() > length) {
+			Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+			segments_.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool PagedPointSet::segment_indices(std::size_t s, std::vector<unsigned int>& indices) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const Segment& seg = segments_[s];
+	indices.resize(seg.size);
+	file_.clear();
+	file_.seekg(seg.indices_offset);
+	if (seg.size > 0 && file_.read(reinterpret_cast<char*>(indices.data()), seg.size * sizeof(int)).fail()) {
+		Logger::err("-") << "failed reading the points of segment " << s << " from \'" << file_name_ << "\'" << std::endl;
+		return false;
+	}
+	for (std::size_t i = 0; i < indices.size(); ++i) {
+		if (indices[i] >= num_points_) {
+			Logger::err("-") << "segment " << s << " has invalid point indices" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool PagedPointSet::read_points(const std::vector<unsigned int>& indices, std::vector<vec3>& points) {
+	return read_values(POINTS, indices, points);
+}
+
+
+bool PagedPointSet::read_colors(const std::vector<unsigned int>& indices, std::vector<vec3>& colors) {
+	return has_colors_ && read_values(COLORS, indices, colors);
+}
+
+
+bool PagedPointSet::read_normals(const std::vector<unsigned int>& indices, std::vector<vec3>& normals) {
+	return has_normals_ && read_values(NORMALS, indices, normals);
+}
+
+
+bool PagedPointSet::read_values(Block block, const std::vector<unsigned int>& indices, std::vector<vec3>& values) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	values.resize(indices.size());
+	std::size_t current = std::size_t(-1);
+	const std::vector<vec3>* p = nil;
+	for (std::size_t i = 0; i < indices.size(); ++i) {
+		std::size_t idx = indices[i];
+		if (idx >= num_points_)
+			return false;
+		std::size_t index = idx / page_size;
+		if (index != current) {	// the indices of a segment come in runs, mostly
+			p = &page(block, index);
+			current = index;
+		}
+		if (p->empty())	// failed reading
+			return false;
+		values[i] = (*p)[idx - index * page_size];
+	}
+	return true;
+}
+
+
+const std::vector<vec3>& PagedPointSet::page(Block block, std::size_t index) {
+	Numeric::uint64 key = (Numeric::uint64(block) << 48) | index;
+	std::unordered_map<Numeric::uint64, PageList::iterator>::iterator it = page_table_.find(key);
+	if (it != page_table_.end()) {
+		pages_.splice(pages_.begin(), pages_, it->second);
+		return it->second->second;
+	}
+
+	// reuses the least recently used page if the cache is full
+	std::vector<vec3> data;
+	if (pages_.size() >= max_pages_) {
+		page_table_.erase(pages_.back().first);
+		data.swap(pages_.back().second);
+		pages_.pop_back();
+	}
+
+	std::size_t first = index * page_size;
+	data.resize(ogf_min(page_size, num_points_ - first));
+	file_.clear();
+	file_.seekg(block_offsets_[block] + std::streamoff(first) * std::streamoff(sizeof(vec3)));
+	if (file_.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(vec3)).fail()) {
+		Logger::err("-") << "failed reading \'" << file_name_ << "\'" << std::endl;
+		data.clear();
+	}
+	++num_page_reads_;
+
+	pages_.push_front(std::make_pair(key, std::vector<vec3>()));
+	pages_.front().second.swap(data);
+	page_table_[key] = pages_.begin();
+	return pages_.front().second;
+}
+
+
+PointSet* PagedPointSet::load_segment(std::size_t s, std::vector<unsigned int>* indices) {
+	std::vector<unsigned int> idx;
+	if (!segment_indices(s, idx))
+		return nil;
+
+	PointSet* pset = new PointSet;
+	if (!read_points(idx, pset->points()) ||
+		(has_colors_ && !read_colors(idx, pset->colors())) ||
+		(has_normals_ && !read_normals(idx, pset->normals()))) {
+		delete pset;
+		return nil;
+	}
+
+	const Segment& seg = segments_[s];
+	VertexGroup::Ptr g = new VertexGroup(pset);
+	g->resize(idx.size());
+	for (std::size_t i = 0; i < idx.size(); ++i)
+		g->at(i) = static_cast<unsigned int>(i);
+	g->set_label(seg.label);
+	g->set_color(seg.color);
+	g->set_plane(seg.plane);
+	pset->groups().push_back(g);
+
+	if (indices)
+		indices->swap(idx);
+	return pset;
+}
+
+
+void PagedPointSet::fit_planes() {
+	for (std::size_t s = 0; s < segments_.size(); ++s) {
+		if (segments_[s].size < 3)
+			continue;
+		PointSet::Ptr pset = load_segment(s);
+		if (!pset)
+			continue;
+		pset->fit_plane(pset->groups()[0]);
+		segments_[s].plane = pset->groups()[0]->plane();
+	}
+}
@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _PAGED_POINT_SET_H_
+#define _PAGED_POINT_SET_H_
+
+#include "model_common.h"
+#include "../basic/basic_types.h"
+#include "../basic/color.h"
+#include "../basic/counted.h"
+#include "../basic/smart_pointer.h"
+#include "../math/math_types.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+
+class PointSet;
+
+/**
+* An out-of-core point set, for the scans that don't fit in memory. It reads a .bvg file in place:
+* opening it only reads the descriptions of the segments (the top-level vertex groups), and the 
+* points, colors and normals are read on demand, in pages kept in a LRU cache of a given size. A 
+* segment only refers to the span of its point indices in the file.
+*
+* The processing streams one segment at a time, e.g.,
+*   PagedPointSet pset(256 * 1024 * 1024);
+*   if (pset.open(file_name)) {
+*       for (std::size_t s = 0; s < pset.num_segments(); ++s) {
+*           PointSet::Ptr segment = pset.load_segment(s);
+*           ...
+*       }
+*   }
+* It is thread safe: different threads can read different segments.
+*/
+
+class MODEL_API PagedPointSet : public Counted
+{
+public:
+	typedef SmartPointer<PagedPointSet>	Ptr;
+
+	struct Segment {
+		std::string		label;
+		Color			color;
+		Plane3d			plane;
+		std::size_t		size;			// the number of points
+		std::streamoff	indices_offset;	// the position of the point indices in the file
+	};
+
+public:
+	// 'cache_size': the memory (in bytes) of the pages kept in memory
+	PagedPointSet(std::size_t cache_size = 256 * 1024 * 1024);
+
+	// returns false if the file can't be read or if it isn't a valid .bvg file
+	bool open(const std::string& file_name);
+
+	std::size_t num_points() const { return num_points_; }
+	bool has_colors() const { return has_colors_; }
+	bool has_normals() const { return has_normals_; }
+
+	std::size_t num_segments() const { return segments_.size(); }
+	const Segment& segment(std::size_t s) const { return segments_[s]; }
+
+	// the point indices of a segment
+	bool segment_indices(std::size_t s, std::vector<unsigned int>& indices);
+
+	// the points, colors or normals with the given indices (through the page cache)
+	bool read_points(const std::vector<unsigned int>& indices, std::vector<vec3>& points);
+	bool read_colors(const std::vector<unsigned int>& indices, std::vector<vec3>& colors);
+	bool read_normals(const std::vector<unsigned int>& indices, std::vector<vec3>& normals);
+
+	// A point set of only the points of segment 's' (and their colors and normals), whose single 
+	// vertex group is the segment. 'indices' (if given) receives the indices of the points in the 
+	// whole point set. Returns nil if reading failed.
+	PointSet* load_segment(std::size_t s, std::vector<unsigned int>* indices = nil);
+
+	// fits the plane of each segment to its points, loading one segment at a time
+	void fit_planes();
+
+	// the number of pages read from the file (i.e., the cache misses)
+	std::size_t num_page_reads() const { return num_page_reads_; }
+
+private:
+	enum Block { POINTS = 0, COLORS = 1, NORMALS = 2 };
+
+	bool read_values(Block block, const std::vector<unsigned int>& indices, std::vector<vec3>& values);
+	// the page with the given index, read if not in the cache (the mutex must be locked)
+	const std::vector<vec3>& page(Block block, std::size_t index);
+
+private:
+	std::string		file_name_;
+	std::ifstream	file_;
+	std::size_t		num_points_;
+	bool			has_colors_;
+	bool			has_normals_;
+	std::streamoff	block_offsets_[3];
+
+	std::vector<Segment>	segments_;
+
+	// the LRU cache of the pages, the most recently used first
+	typedef std::list< std::pair<Numeric::uint64, std::vector<vec3> > >	PageList;
+	PageList	pages_;
+	std::unordered_map<Numeric::uint64, PageList::iterator>	page_table_;
+	std::size_t	max_pages_;
+	std::size_t	num_page_reads_;
+	std::mutex	mutex_;
+};
+
+
+#endif
@@ -0,0 +1,380 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "plane_detector.h"
+#include "point_set.h"
+#include "point_search.h"
+#include "../math/principal_axes.h"
+#include "../basic/logger.h"
+#include "../basic/parallel.h"
+#include "../basic/progress.h"
+#include "../basic/stop_watch.h"
+
+#include <unordered_map>
+#include <random>
+#include <sstream>
+#include <cmath>
+
+
+namespace {
+
+	const unsigned int num_neighbors = 16;		// for the normals and the candidates
+	const std::size_t subset_size = 1 << 15;	// of the points scoring the candidates
+	const std::size_t batch_size = 64;			// of the candidates drawn at once
+	const std::size_t chunk_size = 65536;
+	const std::size_t query_block_size = 1 << 20;	// of the normal estimation
+
+	// a plane, as dot(normal, p) + d = 0
+	struct Candidate {
+		vec3		normal;
+		float		d;
+		bool		valid;
+		std::size_t	score;
+	};
+
+
+	inline bool compatible(const Candidate& c, const vec3& p, const vec3& n, float epsilon, float normal_threshold) {
+		return std::fabs(dot(c.normal, p) + c.d) <= epsilon && std::fabs(dot(c.normal, n)) >= normal_threshold;
+	}
+
+
+	// the normal of each point, from the principal axes of its nearest neighbors
+	void estimate_normals(const std::vector<vec3>& points, const PointSearch* search, std::vector<vec3>& normals, unsigned int num_threads) {
+		std::size_t n = points.size();
+		normals.resize(n);
+		std::vector<unsigned int> neighbors;
+		for (std::size_t first = 0; first < n; first += query_block_size) {
+			std::size_t count = ogf_min(query_block_size, n - first);
+			neighbors.resize(count * num_neighbors);
+			search->find_closest_K_points(&points[first], count, num_neighbors, &neighbors[0], nil, num_threads);
+			parallel_for(count, [&](std::size_t i) {
+				PrincipalAxes3d pca;
+				pca.begin();
+				const unsigned int* nb = &neighbors[i * num_neighbors];
+				for (unsigned int j = 0; j < num_neighbors; ++j) {
+					if (nb[j] != PointSearch::invalid_index)
+						pca.add_point(points[nb[j]]);
+				}
+				pca.end();
+				normals[first + i] = pca.axis(2);
+			}, nil, num_threads);
+		}
+	}
+
+
+	// the typical spacing of the points: the mean distance to the 6th nearest neighbor of a sample
+	double average_spacing(const std::vector<vec3>& points, const PointSearch* search) {
+		std::size_t step = ogf_max<std::size_t>(points.size() / 1000, 1);
+		double sum = 0.0;
+		std::size_t count = 0;
+		std::vector<unsigned int> neighbors;
+		std::vector<double> squared_distances;
+		for (std::size_t i = 0; i < points.size(); i += step) {
+			search->find_closest_K_points(points[i], 7, neighbors, squared_distances);	// the point itself comes first
+			if (squared_distances.size() == 7) {
+				sum += std::sqrt(squared_distances.back());
+				++count;
+			}
+		}
+		return count > 0 ? sum / count : 0.0;
+	}
+
+
+	// the points in 'indices' compatible with the plane, in the same order
+	void compatible_points(const std::vector<vec3>& points, const std::vector<vec3>& normals, const std::vector<unsigned int>& indices,
+		const Candidate& c, float epsilon, float normal_threshold, std::vector<unsigned int>& result, unsigned int num_threads)
+	{
+		std::size_t num_chunks = (indices.size() + chunk_size - 1) / chunk_size;
+		std::vector< std::vector<unsigned int> > chunks(num_chunks);
+		parallel_for(num_chunks, [&](std::size_t k) {
+			std::size_t last = ogf_min(indices.size(), (k + 1) * chunk_size);
+			for (std::size_t j = k * chunk_size; j < last; ++j) {
+				unsigned int i = indices[j];
+				if (compatible(c, points[i], normals[i], epsilon, normal_threshold))
+					chunks[k].push_back(i);
+			}
+		}, nil, num_threads);
+
+		result.clear();
+		for (std::size_t k = 0; k < num_chunks; ++k)
+			result.insert(result.end(), chunks[k].begin(), chunks[k].end());
+	}
+
+
+	unsigned int find_root(std::vector<unsigned int>& parent, unsigned int i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+
+
+	// keeps the largest connected component of the points (the first one if several have the same 
+	// size), the points being connected through the occupied cells of a grid in the plane
+	void keep_largest_component(const std::vector<vec3>& points, std::vector<unsigned int>& indices, const vec3& normal, float cell_size) {
+		if (indices.empty())
+			return;
+
+		// a basis of the plane
+		int axis = 0;
+		for (int a = 1; a < 3; ++a) {
+			if (std::fabs(normal[a]) < std::fabs(normal[axis]))
+				axis = a;
+		}
+		vec3 e(0, 0, 0);
+		e[axis] = 1.0f;
+		vec3 u = normalize(cross(normal, e));
+		vec3 v = cross(normal, u);
+
+		std::unordered_map<Numeric::uint64, unsigned int> cell_ids;
+		std::vector<Numeric::int32> cell_x, cell_y;
+		std::vector<unsigned int> cell_of(indices.size());
+		for (std::size_t k = 0; k < indices.size(); ++k) {
+			const vec3& p = points[indices[k]];
+			Numeric::int32 x = static_cast<Numeric::int32>(std::floor(dot(p, u) / cell_size));
+			Numeric::int32 y = static_cast<Numeric::int32>(std::floor(dot(p, v) / cell_size));
+			Numeric::uint64 key = (Numeric::uint64(Numeric::uint32(x)) << 32) | Numeric::uint32(y);
+			std::pair<std::unordered_map<Numeric::uint64, unsigned int>::iterator, bool> pos = 
+				cell_ids.insert(std::make_pair(key, static_cast<unsigned int>(cell_x.size())));
+			if (pos.second) {
+				cell_x.push_back(x);
+				cell_y.push_back(y);
+			}
+			cell_of[k] = pos.first->second;
+		}
+
+		// the cells are connected to their 8 neighbors (so 4 of them are enough for each cell)
+		std::size_t num_cells = cell_x.size();
+		std::vector<unsigned int> parent(num_cells);
+		for (std::size_t i = 0; i < num_cells; ++i)
+			parent[i] = static_cast<unsigned int>(i);
+		static const int offsets[4][2] = { { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+		for (std::size_t i = 0; i < num_cells; ++i) {
+			for (int k = 0; k < 4; ++k) {
+				Numeric::int32 x = cell_x[i] + offsets[k][0];
+				Numeric::int32 y = cell_y[i] + offsets[k][1];
+				Numeric::uint64 key = (Numeric::uint64(Numeric::uint32(x)) << 32) | Numeric::uint32(y);
+				std::unordered_map<Numeric::uint64, unsigned int>::const_iterator it = cell_ids.find(key);
+				if (it == cell_ids.end())
+					continue;
+				unsigned int a = find_root(parent, static_cast<unsigned int>(i));
+				unsigned int b = find_root(parent, it->second);
+				if (a != b)	// the root is the first cell of the component
+					parent[ogf_max(a, b)] = ogf_min(a, b);
+			}
+		}
+
+		std::vector<std::size_t> sizes(num_cells, 0);
+		for (std::size_t k = 0; k < indices.size(); ++k)
+			++sizes[find_root(parent, cell_of[k])];
+		unsigned int best = 0;
+		for (std::size_t i = 1; i < num_cells; ++i) {
+			if (sizes[i] > sizes[best])
+				best = static_cast<unsigned int>(i);
+		}
+
+		std::size_t count = 0;
+		for (std::size_t k = 0; k < indices.size(); ++k) {
+			if (find_root(parent, cell_of[k]) == best)
+				indices[count++] = indices[k];
+		}
+		indices.resize(count);
+	}
+
+
+	Candidate fit_plane(const std::vector<vec3>& points, const std::vector<unsigned int>& indices) {
+		PrincipalAxes3d pca;
+		pca.begin();
+		for (std::size_t k = 0; k < indices.size(); ++k)
+			pca.add_point(points[indices[k]]);
+		pca.end();
+
+		Candidate c;
+		c.normal = pca.axis(2);	// eigen vectors have been normalized
+		c.d = -dot(c.normal, pca.center());
+		c.valid = true;
+		c.score = indices.size();
+		return c;
+	}
+}
+
+
+std::size_t PlaneDetector::detect(PointSet* pset, const Parameters& params, unsigned int num_threads) {
+	const std::vector<vec3>& points = pset->points();
+	std::size_t n = points.size();
+	if (n < 3) {
+		Logger::warn("-") << "too few points for detecting planes" << std::endl;
+		return 0;
+	}
+
+	StopWatch w;
+	Logger::out("-") << "detecting planes..." << std::endl;
+
+	PointSearch_var search = pset->point_search(PointSearch::AUTO, num_threads);	// shared with the later stages
+
+	std::vector<vec3> estimated_normals;
+	if (!pset->has_normals())
+		estimate_normals(points, search, estimated_normals, num_threads);
+	const std::vector<vec3>& normals = pset->has_normals() ? pset->normals() : estimated_normals;
+
+	const Box3d& box = pset->bbox();
+	float epsilon = params.epsilon;
+	if (epsilon <= 0.0f)
+		epsilon = static_cast<float>(0.02 * box.radius());	// 1% of the diagonal
+	float cluster_epsilon = params.cluster_epsilon;
+	if (cluster_epsilon <= 0.0f)
+		cluster_epsilon = static_cast<float>(2.0 * average_spacing(points, search));
+	if (cluster_epsilon <= 0.0f)
+		cluster_epsilon = epsilon;
+	std::size_t min_points = params.min_points;
+	if (min_points == 0)
+		min_points = ogf_max<std::size_t>(n / 200, 10);
+	min_points = ogf_max<std::size_t>(min_points, 3);
+
+	const std::size_t max_draws = batch_size * 100;
+
+	std::vector<unsigned char> assigned(n, 0);
+	std::vector<unsigned int> remaining(n);
+	for (std::size_t i = 0; i < n; ++i)
+		remaining[i] = static_cast<unsigned int>(i);
+
+	std::mt19937 rng(params.seed);
+	std::vector<Candidate> candidates(batch_size);
+	std::vector<Numeric::uint32> draws(batch_size * 3);
+	std::vector<unsigned int> subset, support;
+	std::vector<VertexGroup::Ptr> segments;
+	std::size_t drawn = 0;	// the candidates drawn since the last segment
+
+	ProgressLogger progress(n);
+	while (remaining.size() >= min_points && !progress.is_canceled()) {
+		std::size_t r = remaining.size();
+
+		// the candidates, each from a random point and two of its neighbors that remain
+		for (std::size_t k = 0; k < draws.size(); ++k)
+			draws[k] = rng();
+		drawn += batch_size;
+		parallel_for(batch_size, [&](std::size_t k) {
+			Candidate& c = candidates[k];
+			c.valid = false;
+			c.score = 0;
+
+			unsigned int s = remaining[draws[k * 3] % r];
+			std::vector<unsigned int> neighbors;
+			search->find_closest_K_points(points[s], num_neighbors, neighbors);
+			std::size_t count = 0;
+			for (std::size_t j = 0; j < neighbors.size(); ++j) {
+				if (neighbors[j] != s && !assigned[neighbors[j]])
+					neighbors[count++] = neighbors[j];
+			}
+			if (count < 2)
+				return;
+			std::size_t ia = draws[k * 3 + 1] % count;
+			std::size_t ib = draws[k * 3 + 2] % (count - 1);
+			if (ib >= ia)
+				++ib;
+			unsigned int a = neighbors[ia], b = neighbors[ib];
+
+			vec3 da = points[a] - points[s];
+			vec3 db = points[b] - points[s];
+			vec3 normal = cross(da, db);
+			float len = length(normal);
+			if (len <= 1e-6f * length(da) * length(db))	// (almost) collinear
+				return;
+			c.normal = normal / len;
+			c.d = -dot(c.normal, points[s]);
+			c.valid =
+				std::fabs(dot(c.normal, normals[s])) >= params.normal_threshold &&
+				std::fabs(dot(c.normal, normals[a])) >= params.normal_threshold &&
+				std::fabs(dot(c.normal, normals[b])) >= params.normal_threshold;
+		}, nil, num_threads);
+
+		// the scores, on a random subset of the remaining points
+		if (r <= subset_size)
+			subset = remaining;
+		else {
+			subset.resize(subset_size);
+			for (std::size_t k = 0; k < subset_size; ++k)
+				subset[k] = remaining[rng() % r];
+		}
+		parallel_for(batch_size, [&](std::size_t k) {
+			Candidate& c = candidates[k];
+			if (!c.valid)
+				return;
+			for (std::size_t j = 0; j < subset.size(); ++j) {
+				unsigned int i = subset[j];
+				if (compatible(c, points[i], normals[i], epsilon, params.normal_threshold))
+					++c.score;
+			}
+		}, nil, num_threads);
+
+		std::size_t best = batch_size;
+		for (std::size_t k = 0; k < batch_size; ++k) {
+			if (candidates[k].valid && (best == batch_size || candidates[k].score > candidates[best].score))
+				best = k;
+		}
+
+		// the support of the best candidate, refitted once
+		support.clear();
+		if (best < batch_size && double(candidates[best].score) * r / subset.size() >= min_points) {
+			compatible_points(points, normals, remaining, candidates[best], epsilon, params.normal_threshold, support, num_threads);
+			keep_largest_component(points, support, candidates[best].normal, cluster_epsilon);
+			if (support.size() >= min_points) {
+				Candidate refined = fit_plane(points, support);
+				compatible_points(points, normals, remaining, refined, epsilon, params.normal_threshold, support, num_threads);
+				keep_largest_component(points, support, refined.normal, cluster_epsilon);
+			}
+		}
+
+		if (support.size() < min_points) {
+			// the probability of having missed a segment of min_points in all the candidates drawn
+			double ratio = double(min_points) / r;
+			double needed = ratio >= 1.0 ? 1.0 : std::log(1.0 - params.probability) / std::log(1.0 - ratio);
+			if (drawn >= ogf_min<double>(needed, double(max_draws)))
+				break;
+			continue;
+		}
+
+		Candidate plane = fit_plane(points, support);
+		VertexGroup* g = new VertexGroup(pset);
+		g->insert(g->end(), support.begin(), support.end());
+		g->set_plane(Plane3d(plane.normal.x, plane.normal.y, plane.normal.z, plane.d));
+		std::ostringstream name;
+		name << "plane_" << segments.size();
+		g->set_label(name.str());
+		g->set_color(random_color());
+		segments.push_back(g);
+
+		for (std::size_t k = 0; k < support.size(); ++k)
+			assigned[support[k]] = 1;
+		std::size_t count = 0;
+		for (std::size_t k = 0; k < r; ++k) {
+			if (!assigned[remaining[k]])
+				remaining[count++] = remaining[k];
+		}
+		remaining.resize(count);
+		drawn = 0;
+		progress.notify(n - remaining.size());
+	}
+
+	pset->groups() = segments;
+	Logger::out("-") << segments.size() << " planes detected (" << n - remaining.size() << " of " << n << " points). "
+		<< w.elapsed() << " sec." << std::endl;
+	return segments.size();
+}
@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _PLANE_DETECTOR_H_
+#define _PLANE_DETECTOR_H_
+
+#include "model_common.h"
+
+#include <cstddef>
+
+
+class PointSet;
+
+/**
+* Detection of the planar segments of a point set, in the spirit of the efficient RANSAC of 
+* Schnabel et al. (2007).
+* Each round draws a batch of candidate planes, each through a random point and two of its nearest 
+* neighbors (found with a PointSearch), and scores them on a random subset of the remaining points.
+* The points compatible with the best candidate (close to it, with a similar normal) are gathered 
+* on a grid in its plane, their largest connected component is refitted with PrincipalAxes3d and 
+* becomes a segment. The detection stops when no plane of the minimum size is likely to have been 
+* missed.
+* The candidates, the scores, and the extraction are computed in parallel. The segments only depend 
+* on the parameters (including the seed of the random numbers), not on the number of threads.
+*/
+
+class MODEL_API PlaneDetector
+{
+public:
+	struct Parameters {
+		Parameters()
+			: epsilon(0.0f)
+			, cluster_epsilon(0.0f)
+			, normal_threshold(0.9f)
+			, min_points(0)
+			, probability(0.99f)
+			, seed(0)
+		{}
+
+		float			epsilon;			// max distance of the points to their plane (0: 1% of the diagonal of the bounding box)
+		float			cluster_epsilon;	// max spacing of the neighboring points of a segment (0: from the density of the points)
+		float			normal_threshold;	// min |cos| of the angle between the normals of the points and their plane
+		unsigned int	min_points;			// min number of points of a segment (0: 0.5% of the points, at least 10)
+		float			probability;		// min probability of not having missed a segment of min_points when stopping
+		unsigned int	seed;				// of the random numbers
+	};
+
+	// Replaces the groups of 'pset' by the planar segments detected, with their planes. The normals
+	// of the points are estimated from their neighbors if the point set has none. The points that 
+	// don't belong to any segment are left out. Returns the number of segments.
+	static std::size_t detect(PointSet* pset, const Parameters& params = Parameters(), unsigned int num_threads = 0);
+};
+
+#endif
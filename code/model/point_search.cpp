@@ -0,0 +1,189 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_search.h"
+#include "kdtree_search.h"
+#include "grid_search.h"
+#include "map_geometry.h"
+#include "../basic/parallel.h"
+#include "../basic/file_utils.h"
+#include "../basic/logger.h"
+
+#include <algorithm>
+#include <cfloat>
+
+
+const unsigned int PointSearch::invalid_index;
+const std::size_t PointSearch::query_block_size;
+
+
+namespace {
+	// below this number of points, building and searching a kd-tree is cheap anyway
+	const std::size_t min_grid_points = 10000;
+
+	// the grid is used if the numbers of points in its occupied cells vary less than this 
+	// (relative to their mean)
+	const double max_grid_variation = 1.0;
+}
+
+
+PointSearch* PointSearch::create(const std::vector<vec3>& points, Backend backend /* = AUTO */, unsigned int num_threads /* = 0 */,
+	const std::string& cache_directory /* = "" */) 
+{
+	// the choice of AUTO only depends on the points, so a kd-tree found for them is the one it would make
+	std::string cache_file;
+	if (!cache_directory.empty() && backend != GRID) {
+		cache_file = cache_directory + "/" + KdTreeSearch::points_hash(points) + ".kdtree";
+		if (FileUtils::is_file(cache_file)) {
+			KdTreeSearch* tree = new KdTreeSearch;
+			if (tree->load(cache_file, points))
+				return tree;
+			delete tree;
+		}
+	}
+
+	if (backend == AUTO) {
+		if (points.size() >= min_grid_points) {
+			GridSearch* grid = new GridSearch;
+			grid->build(points, num_threads);
+			if (auto_chooses_grid(points.size(), grid->occupancy_variation()))
+				return grid;
+			delete grid;
+		}
+		backend = KD_TREE;
+	}
+
+	if (backend == GRID) {
+		PointSearch* grid = new GridSearch;
+		grid->build(points, num_threads);
+		return grid;
+	}
+
+	KdTreeSearch* tree = new KdTreeSearch;
+	tree->build(points, num_threads);
+	if (!cache_file.empty()) {
+		if (!FileUtils::is_directory(cache_directory) && !FileUtils::create_directory(cache_directory))
+			Logger::err("-") << "failed creating the cache directory: " << cache_directory << std::endl;
+		else
+			tree->save(cache_file);
+	}
+	return tree;
+}
+
+
+bool PointSearch::auto_chooses_grid(std::size_t num_points, double occupancy_variation) {
+	return num_points >= min_grid_points && occupancy_variation <= max_grid_variation;
+}
+
+
+void PointSearch::spatial_order(const vec3* queries, std::size_t n, std::vector<std::size_t>& order) {
+	Box3d box;
+	for (std::size_t i = 0; i < n; ++i)
+		box.add_point(queries[i]);
+
+	std::vector< std::pair<Numeric::uint64, std::size_t> > keys(n);
+	for (std::size_t i = 0; i < n; ++i)
+		keys[i] = std::make_pair(Geom::morton_code(queries[i], box), i);
+	std::sort(keys.begin(), keys.end());
+
+	order.resize(n);
+	for (std::size_t i = 0; i < n; ++i)
+		order[i] = keys[i].second;
+}
+
+
+void PointSearch::find_closest_K_points(
+	const vec3* queries, std::size_t n, unsigned int k,
+	unsigned int* neighbors, float* squared_distances, unsigned int num_threads /* = 0 */
+	) const {
+		std::vector<std::size_t> order;
+		spatial_order(queries, n, order);
+
+		std::size_t num_blocks = (n + query_block_size - 1) / query_block_size;
+		parallel_for(num_blocks, [&](std::size_t b) {
+			std::vector<unsigned int> found;
+			std::vector<double> sqr_distances;
+			std::size_t end = std::min(n, (b + 1) * query_block_size);
+			for (std::size_t j = b * query_block_size; j < end; ++j) {
+				std::size_t i = order[j];
+				found.clear();
+				sqr_distances.clear();
+				find_closest_K_points(queries[i], k, found, sqr_distances);
+
+				unsigned int* idx = neighbors + i * k;
+				for (unsigned int m = 0; m < k; ++m)
+					idx[m] = (m < found.size()) ? found[m] : invalid_index;
+				if (squared_distances) {
+					float* dist = squared_distances + i * k;
+					for (unsigned int m = 0; m < k; ++m)
+						dist[m] = (m < found.size()) ? float(sqr_distances[m]) : FLT_MAX;
+				}
+			}
+		}, nil, num_threads);
+}
+
+
+void PointSearch::find_points_in_radius(
+	const vec3* queries, std::size_t n, double squared_radius, 
+	std::vector<std::size_t>& offsets, std::vector<unsigned int>& neighbors, 
+	std::vector<float>* squared_distances /* = nil */, unsigned int num_threads /* = 0 */
+	) const {
+		std::vector<std::size_t> order;
+		spatial_order(queries, n, order);
+
+		// the results of each block of queries (in the spatial order), and then moved to their places
+		std::size_t num_blocks = (n + query_block_size - 1) / query_block_size;
+		std::vector< std::vector<unsigned int> > found(num_blocks);
+		std::vector< std::vector<double> > found_distances(num_blocks);
+		std::vector<std::size_t> counts(n, 0);
+		parallel_for(num_blocks, [&](std::size_t b) {
+			std::vector<unsigned int> nbs;
+			std::vector<double> sqr_distances;
+			std::size_t end = std::min(n, (b + 1) * query_block_size);
+			for (std::size_t j = b * query_block_size; j < end; ++j) {
+				find_points_in_radius(queries[order[j]], squared_radius, nbs, sqr_distances);
+				found[b].insert(found[b].end(), nbs.begin(), nbs.end());
+				found_distances[b].insert(found_distances[b].end(), sqr_distances.begin(), sqr_distances.end());
+				counts[order[j]] = nbs.size();
+			}
+		}, nil, num_threads);
+
+		offsets.resize(n + 1);
+		offsets[0] = 0;
+		for (std::size_t i = 0; i < n; ++i)
+			offsets[i + 1] = offsets[i] + counts[i];
+		neighbors.resize(offsets[n]);
+		if (squared_distances)
+			squared_distances->resize(offsets[n]);
+
+		parallel_for(num_blocks, [&](std::size_t b) {
+			std::size_t from = 0;
+			std::size_t end = std::min(n, (b + 1) * query_block_size);
+			for (std::size_t j = b * query_block_size; j < end; ++j) {
+				std::size_t i = order[j];
+				for (std::size_t m = offsets[i]; m < offsets[i + 1]; ++m, ++from) {
+					neighbors[m] = found[b][from];
+					if (squared_distances)
+						(*squared_distances)[m] = float(found_distances[b][from]);
+				}
+			}
+			std::vector<unsigned int>().swap(found[b]);
+			std::vector<double>().swap(found_distances[b]);
+		}, nil, num_threads);
+}
@@ -0,0 +1,136 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MODEL_POINT_SEARCH_H_
+#define _MODEL_POINT_SEARCH_H_
+
+#include "model_common.h"
+#include "../math/math_types.h"
+#include "../basic/counted.h"
+#include "../basic/smart_pointer.h"
+
+#include <vector>
+#include <string>
+
+
+// The interface of the spatial indices of a set of points (the closest point, K nearest neighbors, 
+// and fixed-radius queries). The indices returned are the indices of the points given to build(). 
+// Once built, an index can be searched from any number of threads at the same time.
+class MODEL_API PointSearch : public Counted {
+public:
+	enum Backend {
+		AUTO = 0,	// chosen from the number and the distribution of the points
+		KD_TREE = 1,
+		GRID = 2	// a hashed uniform grid, for points of roughly uniform density
+	};
+
+	// Creates and builds the index of 'points' (with up to 'num_threads' threads, 0 meaning the 
+	// number of hardware threads). If a 'cache_directory' is given, the kd-trees are kept there as 
+	// files named after the hash of their points, and loaded instead of built for the same points.
+	static PointSearch* create(const std::vector<vec3>& points, Backend backend = AUTO, unsigned int num_threads = 0,
+		const std::string& cache_directory = "");
+
+	// whether AUTO chooses the grid of 'num_points' points, given the occupancy variation of the grid 
+	// (see GridSearch::occupancy_variation())
+	static bool auto_chooses_grid(std::size_t num_points, double occupancy_variation);
+
+	PointSearch() : epsilon_(0) {}
+	virtual ~PointSearch() {}
+
+	virtual Backend backend() const = 0;
+
+	// Makes the closest point and K nearest neighbor queries approximate: the distance to the i-th
+	// neighbor found is at most (1 + epsilon) times the distance to the true i-th nearest neighbor,
+	// which lets the queries skip most of the candidates near the boundary of the neighborhood.
+	// 0 (the default) gives the exact neighbors. The radius queries are always exact.
+	void set_epsilon(double epsilon) { epsilon_ = epsilon; }
+	double epsilon() const { return epsilon_; }
+
+	virtual void build(const std::vector<vec3>& points, unsigned int num_threads = 0) = 0;
+
+	//________________ closest point ____________________________
+
+	// return the index of the closest point, -1 if not found
+	// NOTE: *squared* distance is returned
+	virtual int find_closest_point(const vec3& p, double& squared_distance) const = 0;
+	virtual int find_closest_point(const vec3& p) const = 0;
+
+	//_________________ K-nearest neighbors ____________________
+
+	// NOTE: *squared* distances are returned. The neighbors are sorted in increasing distance.
+	virtual void find_closest_K_points(
+		const vec3& p, unsigned int k, 
+		std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
+		) const = 0;
+
+	virtual void find_closest_K_points(
+		const vec3& p, unsigned int k, 
+		std::vector<unsigned int>& neighbors
+		) const = 0;
+
+	// Batch version: the K nearest neighbors of the n 'queries' are written to the arrays 'neighbors'
+	// and (if it is not nil) 'squared_distances', both of size n * k: the neighbors of queries[i] start 
+	// at i * k. If less than k points are found, the remaining entries are invalid_index (and FLT_MAX).
+	// The queries are processed in a spatial order (for the cache) by up to 'num_threads' threads (0 
+	// means the number of hardware threads).
+	virtual void find_closest_K_points(
+		const vec3* queries, std::size_t n, unsigned int k,
+		unsigned int* neighbors, float* squared_distances, unsigned int num_threads = 0
+		) const;
+
+	static const unsigned int invalid_index = ~0u;
+
+	//___________________ radius search __________________________
+
+	// fixed-radius kNN	search. Search for all points in the range, sorted in increasing distance.
+	// NOTE: *squared* radius of query ball
+	virtual void find_points_in_radius(const vec3& p, double squared_radius, 
+		std::vector<unsigned int>& neighbors
+		) const = 0;
+
+	virtual void find_points_in_radius(const vec3& p, double squared_radius, 
+		std::vector<unsigned int>& neighbors, std::vector<double>& squared_distances
+		) const = 0;
+
+	// Batch version: the points in the range of queries[i] are neighbors[offsets[i]] to 
+	// neighbors[offsets[i + 1] - 1] (offsets has n + 1 entries), with their squared distances 
+	// at the same positions in 'squared_distances' if it is not nil. See the batch K nearest 
+	// neighbors query for the threads.
+	virtual void find_points_in_radius(
+		const vec3* queries, std::size_t n, double squared_radius, 
+		std::vector<std::size_t>& offsets, std::vector<unsigned int>& neighbors, 
+		std::vector<float>* squared_distances = nil, unsigned int num_threads = 0
+		) const ;
+
+protected:
+	// the order of the queries along a Z-order curve, such that consecutive queries visit the same 
+	// parts of the index
+	static void spatial_order(const vec3* queries, std::size_t n, std::vector<std::size_t>& order);
+
+	// the number of consecutive queries (in the spatial order) handed to a thread at once
+	static const std::size_t query_block_size = 64;
+
+protected:
+	double	epsilon_;
+} ;
+
+
+typedef	SmartPointer<PointSearch>	PointSearch_var;
+
+#endif
@@ -19,15 +19,144 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "point_set.h"
 #include "vertex_group.h"
+#include "point_set_roi_index.h"
+#include "map_geometry.h"
+#include "../basic/parallel.h"
+#include "../math/plane_fitting.h"
 
+#include <atomic>
+#include <algorithm>
 
-PointSet::PointSet() : bbox_is_valid_(false)
+
+PointSet::PointSet() 
+	: id_(new_id()), version_(0), points_version_(0)
+	, padded_offset_(0), padded_version_(0), padded_size_(0)
+	, roi_index_(nil)
+	, point_search_version_(0)
+	, bbox_is_valid_(false)
 {
 }
 
+
+unsigned int PointSet::new_id() {
+	static std::atomic<unsigned int> next_id(0);
+	return ++next_id;
+}
+
 PointSet::~PointSet() {
+	delete roi_index_;
+}
+
+MemoryUsage PointSet::memory_usage() const {
+	MemoryUsage usage;
+	usage.add("points", MemoryUsage::of(points_));
+	usage.add("normals", MemoryUsage::of(normals_));
+	usage.add("colors", MemoryUsage::of(colors_));
+	usage.add("planar qualities", MemoryUsage::of(planar_qualities_));
+	usage.add("weights", MemoryUsage::of(weights_));
+	usage.add("padded points", MemoryUsage::of(padded_storage_));
+	if (roi_index_)
+		usage.add("roi index", roi_index_->memory_usage().total());
+
+	double groups = MemoryUsage::of(groups_);
+	for (std::size_t i = 0; i < groups_.size(); ++i) {
+		const VertexGroup* g = groups_[i];
+		groups += sizeof(VertexGroup) + MemoryUsage::of(*g) + MemoryUsage::of(g->boundary());
+		const VertexGroup::Footprint& fp = g->footprint();
+		groups += MemoryUsage::of(fp.points) + MemoryUsage::of(fp.hull) + MemoryUsage::of(fp.alpha_triangles);
+		const VertexGroup::Projection& proj = g->projection();
+		groups += MemoryUsage::of(proj.points) + MemoryUsage::of(proj.distances);
+	}
+	usage.add("vertex groups", groups);
+	return usage;
+}
+
+void PointSet::update_padded_points() {
+	if (padded_points())
+		return;
+
+	const std::size_t n = points_.size();
+	// left uninitialized, the pages are first touched by the threads filling them
+	padded_storage_.clear();
+	padded_storage_.resize(4 * n + 3);
+	// the floats of a vector are 4-byte aligned, so at most 3 floats are skipped
+	const std::size_t misalignment = reinterpret_cast<std::size_t>(padded_storage_.data()) % 16;
+	padded_offset_ = misalignment == 0 ? 0 : (16 - misalignment) / sizeof(float);
+	float* padded = padded_storage_.data() + padded_offset_;
+	std::fill(padded_storage_.data(), padded, 0.0f);
+	std::fill(padded + 4 * n, padded_storage_.data() + padded_storage_.size(), 0.0f);
+	parallel_for((n + 65535) / 65536, [&](std::size_t c) {
+		const std::size_t last = std::min(n, (c + 1) * 65536);
+		for (std::size_t i = c * 65536; i < last; ++i) {
+			padded[4 * i] = points_[i].x;
+			padded[4 * i + 1] = points_[i].y;
+			padded[4 * i + 2] = points_[i].z;
+			padded[4 * i + 3] = 0.0f;
+		}
+	});
+	padded_version_ = points_version_;
+	padded_size_ = n;
+}
+
+
+const float* PointSet::padded_points() const {
+	if (padded_storage_.empty() || padded_version_ != points_version_ || padded_size_ != points_.size())
+		return nil;
+	return padded_storage_.data() + padded_offset_;
+}
+
+
+void PointSet::release_padded_points() {
+	std::vector<float, LargeArrayAllocator<float> >().swap(padded_storage_);
+	padded_size_ = 0;
+}
+
+
+PointSearch_var PointSet::point_search(PointSearch::Backend backend, unsigned int num_threads, const std::string& cache_directory) const {
+	// built under the lock, so the concurrent requests wait for the same index
+	std::lock_guard<std::mutex> lock(point_search_mutex_);
+	if (point_search_ && point_search_version_ == points_version_ && 
+		(backend == PointSearch::AUTO || backend == point_search_->backend()))
+		return point_search_;
+
+	point_search_ = PointSearch::create(points_, backend, num_threads, cache_directory);
+	point_search_version_ = points_version_;
+	return point_search_;
+}
+
+
+void PointSet::set_point_search(PointSearch* search) {
+	std::lock_guard<std::mutex> lock(point_search_mutex_);
+	point_search_ = search;
+	point_search_version_ = points_version_;
+}
+
+
+void PointSet::release_point_search() {
+	std::lock_guard<std::mutex> lock(point_search_mutex_);
+	point_search_ = nil;
+}
+
+
+void PointSet::update_roi_index() {
+	if (roi_index_)
+		roi_index_->update();
+	else
+		roi_index_ = new PointSetRoiIndex(this);
+}
+
+
+const PointSetRoiIndex* PointSet::roi_index() const {
+	return (roi_index_ && roi_index_->is_up_to_date()) ? roi_index_ : nil;
+}
+
+
+void PointSet::release_roi_index() {
+	delete roi_index_;
+	roi_index_ = nil;
 }
 
+
 const Box3d& PointSet::bbox() const {
 	if (!bbox_is_valid_) {
 		Box3d result;
@@ -40,44 +169,179 @@ const Box3d& PointSet::bbox() const {
 	return bbox_;
 }
 
-void PointSet::delete_points(const std::vector<unsigned int>& indices) {
-	std::vector<int> keep(num_points(), 1);
-	for (std::size_t i = 0; i < indices.size(); ++i) {
-		unsigned int id = indices[i];
-		keep[id] = 0;
-	}
-	
-	std::vector<vec3>  new_points;
-	std::vector<vec3>  new_colors;
-	std::vector<vec3>  new_normals;
-	std::vector<float>  new_planar_qualities;
-	for (std::size_t i = 0; i < num_points(); ++i) {
-		if (keep[i] == 1) 
-			new_points.push_back(points_[i]);
+
+namespace {
+	// v[i] = old v[order[i]]
+	template <class T>
+	void permute(std::vector<T>& v, const std::vector<unsigned int>& order) {
+		if (v.size() != order.size())
+			return;
+		std::vector<T> result(v.size());
+		parallel_for((v.size() + 65535) / 65536, [&](std::size_t c) {
+			std::size_t last = ogf_min(v.size(), (c + 1) * 65536);
+			for (std::size_t i = c * 65536; i < last; ++i)
+				result[i] = v[order[i]];
+		});
+		v.swap(result);
 	}
-	if (has_colors()) {
-		for (std::size_t i = 0; i < num_points(); ++i) {
-			if (keep[i] == 1)
-				new_colors.push_back(colors_[i]);
+
+	// replaces each index by its new index ('filter': removes the indices whose new index is -1)
+	void remap(std::vector<unsigned int>& indices, const std::vector<unsigned int>& new_indices, bool filter = false) {
+		std::size_t k = 0;
+		for (std::size_t i = 0; i < indices.size(); ++i) {
+			unsigned int id = new_indices[indices[i]];
+			if (!filter || id != static_cast<unsigned int>(-1))
+				indices[k++] = id;
 		}
+		indices.resize(k);
 	}
-	if (has_normals()) {
-		for (std::size_t i = 0; i < num_points(); ++i) {
-			if (keep[i] == 1)
-				new_normals.push_back(normals_[i]);
+
+	// Sorts the keys (with their values) by a least significant digit radix sort, stable and in parallel:
+	// each pass counts the digits of the chunks of the keys, and the chunks scatter their keys at once.
+	// The passes on the digits all the keys share (e.g., the high bits of the Morton codes) are skipped.
+	void radix_sort(std::vector<Numeric::uint64>& keys, std::vector<unsigned int>& values) {
+		const std::size_t n = keys.size();
+		const unsigned int bits = 11;
+		const std::size_t num_buckets = std::size_t(1) << bits;
+		const std::size_t num_chunks = ogf_max<std::size_t>(1, ogf_min<std::size_t>(parallel_num_threads() * 4, n / 65536));
+		const std::size_t chunk_size = (n + num_chunks - 1) / num_chunks;
+
+		// the bits that differ between the keys
+		Numeric::uint64 all_or = 0, all_and = ~Numeric::uint64(0);
+		for (std::size_t i = 0; i < n; ++i) {
+			all_or |= keys[i];
+			all_and &= keys[i];
 		}
-	}
-	if (has_planar_qualities()) {
-		for (std::size_t i = 0; i < num_points(); ++i) {
-			if (keep[i] == 1)
-				new_planar_qualities.push_back(planar_qualities_[i]);
+		const Numeric::uint64 varying = all_or ^ all_and;
+
+		std::vector<Numeric::uint64> key_buffer(n);
+		std::vector<unsigned int> value_buffer(n);
+		std::vector<std::size_t> counts(num_chunks * num_buckets);
+		for (unsigned int shift = 0; shift < 64; shift += bits) {
+			const Numeric::uint64 mask = num_buckets - 1;
+			if (((varying >> shift) & mask) == 0)
+				continue;
+
+			std::fill(counts.begin(), counts.end(), 0);
+			parallel_for(num_chunks, [&](std::size_t c) {
+				std::size_t* count = &counts[c * num_buckets];
+				const std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+				for (std::size_t i = c * chunk_size; i < last; ++i)
+					++count[(keys[i] >> shift) & mask];
+			});
+
+			// the position of the first key of each digit of each chunk (by digit, then by chunk)
+			std::size_t offset = 0;
+			for (std::size_t d = 0; d < num_buckets; ++d) {
+				for (std::size_t c = 0; c < num_chunks; ++c) {
+					std::size_t& count = counts[c * num_buckets + d];
+					const std::size_t num = count;
+					count = offset;
+					offset += num;
+				}
+			}
+
+			parallel_for(num_chunks, [&](std::size_t c) {
+				std::size_t* pos = &counts[c * num_buckets];
+				const std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+				for (std::size_t i = c * chunk_size; i < last; ++i) {
+					const std::size_t p = pos[(keys[i] >> shift) & mask]++;
+					key_buffer[p] = keys[i];
+					value_buffer[p] = values[i];
+				}
+			});
+			keys.swap(key_buffer);
+			values.swap(value_buffer);
 		}
 	}
+}
+
+
+void PointSet::delete_points(const std::vector<unsigned int>& indices) {
+	if (indices.empty())
+		return;
+	notify_points_change();	// the neighborhoods change
+	const std::size_t chunk_size = 65536;
+	const unsigned int invalid = static_cast<unsigned int>(-1);
+	std::size_t n = num_points();
+	std::size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+	std::vector<unsigned char> keep(n, 1);
+	for (std::size_t i = 0; i < indices.size(); ++i)
+		keep[indices[i]] = 0;
+
+	// the first new index of each chunk (prefix sums of the kept points)
+	std::vector<std::size_t> first(num_chunks + 1, 0);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		std::size_t count = 0;
+		for (std::size_t i = c * chunk_size; i < last; ++i)
+			count += keep[i];
+		first[c + 1] = count;
+	});
+	for (std::size_t c = 0; c < num_chunks; ++c)
+		first[c + 1] += first[c];
+	std::size_t num_kept = first[num_chunks];
+
+	bool colors = has_colors(), normals = has_normals(), qualities = has_planar_qualities(), weights = has_weights();
+	std::vector<unsigned int> new_index(n);
+	std::vector<vec3>  new_points(num_kept);
+	std::vector<vec3>  new_colors(colors ? num_kept : 0);
+	std::vector<vec3>  new_normals(normals ? num_kept : 0);
+	std::vector<float>  new_planar_qualities(qualities ? num_kept : 0);
+	std::vector<float>  new_weights(weights ? num_kept : 0);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		std::size_t k = first[c];
+		for (std::size_t i = c * chunk_size; i < last; ++i) {
+			if (!keep[i]) {
+				new_index[i] = invalid;
+				continue;
+			}
+			new_index[i] = static_cast<unsigned int>(k);
+			new_points[k] = points_[i];
+			if (colors)
+				new_colors[k] = colors_[i];
+			if (normals)
+				new_normals[k] = normals_[i];
+			if (qualities)
+				new_planar_qualities[k] = planar_qualities_[i];
+			if (weights)
+				new_weights[k] = weights_[i];
+			++k;
+		}
+	});
+
+	points_.swap(new_points);
+	normals_.swap(new_normals);
+	colors_.swap(new_colors);
+	planar_qualities_.swap(new_planar_qualities);
+	weights_.swap(new_weights);
+	bbox_is_valid_ = false;
 
-	points_ = new_points;
-	normals_ = new_normals;
-	colors_ = new_colors;
-	planar_qualities_ = new_planar_qualities;
+	// the indices of the deleted points are removed from the groups, the others are remapped
+	parallel_for(groups_.size(), [&](std::size_t i) {
+		VertexGroup* g = groups_[i];
+		remap(*g, new_index, true);
+		std::vector<unsigned int> boundary = g->boundary();
+		remap(boundary, new_index, true);
+		g->set_boundary(boundary);
+		g->invalidate_footprint();
+		g->invalidate_projection();
+
+		std::vector<VertexGroup*> children = g->children();
+		for (std::size_t j = 0; j < children.size(); ++j)
+			remap(*children[j], new_index, true);
+	});
+}
+
+double PointSet::total_weight() const {
+	if (!has_weights())
+		return double(points_.size());
+	double total = 0.0;
+	for (std::size_t i = 0; i < weights_.size(); ++i)
+		total += weights_[i];
+	return total;
 }
 
 std::vector<unsigned int> PointSet::idle_points() const {
@@ -99,14 +363,107 @@ std::vector<unsigned int> PointSet::idle_points() const {
 }
 
 
-void PointSet::fit_plane(VertexGroup::Ptr g) {
-	PrincipalAxes3d pca;
-	pca.begin();
-	for (std::size_t j = 0; j < g->size(); ++j) {
-		pca.add_point(points_[g->at(j)]);
+
+
+void PointSet::reorder_by_groups(std::vector<unsigned int>* new_indices) {
+	++version_;
+	++points_version_;	// the planar qualities are permuted with the points, so they stay valid
+	const unsigned int invalid = static_cast<unsigned int>(-1);
+	std::vector<unsigned int> new_index(num_points(), invalid);
+	std::vector<unsigned int> order;	// the old index of each new position
+	order.reserve(num_points());
+	for (std::size_t i = 0; i < groups_.size(); ++i) {
+		const VertexGroup* g = groups_[i];
+		for (std::size_t j = 0; j < g->size(); ++j) {
+			unsigned int id = g->at(j);
+			if (new_index[id] == invalid) {
+				new_index[id] = static_cast<unsigned int>(order.size());
+				order.push_back(id);
+			}
+		}
 	}
-	pca.end();
+	for (std::size_t i = 0; i < new_index.size(); ++i) {
+		if (new_index[i] == invalid) {
+			new_index[i] = static_cast<unsigned int>(order.size());
+			order.push_back(static_cast<unsigned int>(i));
+		}
+	}
+
+	apply_order(order, new_index);
+	if (new_indices)
+		new_indices->swap(new_index);
+}
+
+
+void PointSet::reorder_spatially(std::vector<unsigned int>* new_indices) {
+	if (points_.empty())
+		return;
+	++version_;
+	++points_version_;	// the planar qualities are permuted with the points, so they stay valid
+
+	// the codes and the indices of the points, by chunks in parallel
+	const std::size_t n = points_.size();
+	const std::size_t chunk_size = 65536;
+	const std::size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+	const Box3d& box = bbox();
+	std::vector<Numeric::uint64> keys(n);
+	std::vector<unsigned int> order(n);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		const std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		for (std::size_t i = c * chunk_size; i < last; ++i) {
+			keys[i] = Geom::morton_code(points_[i], box);
+			order[i] = static_cast<unsigned int>(i);
+		}
+	});
+	radix_sort(keys, order);
+
+	std::vector<unsigned int> new_index(n);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		const std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		for (std::size_t i = c * chunk_size; i < last; ++i)
+			new_index[order[i]] = static_cast<unsigned int>(i);
+	});
+
+	apply_order(order, new_index);
 
-	Plane3d plane(pca.center(), pca.axis(2)); // eigen vectors have been normalized
-	g->set_plane(plane);
+	// the points of each group in the new order (the positions in the group change)
+	parallel_for(groups_.size(), [&](std::size_t i) {
+		VertexGroup* g = groups_[i];
+		std::sort(g->begin(), g->end());
+		g->invalidate_footprint();
+		g->invalidate_projection();
+	});
+
+	if (new_indices)
+		new_indices->swap(new_index);
+}
+
+
+void PointSet::apply_order(const std::vector<unsigned int>& order, const std::vector<unsigned int>& new_index) {
+	permute(points_, order);
+	if (has_colors())
+		permute(colors_, order);
+	if (has_normals())
+		permute(normals_, order);
+	if (has_planar_qualities())
+		permute(planar_qualities_, order);
+	if (has_weights())
+		permute(weights_, order);
+
+	for (std::size_t i = 0; i < groups_.size(); ++i) {
+		VertexGroup* g = groups_[i];
+		remap(*g, new_index);
+		std::vector<unsigned int> boundary = g->boundary();
+		remap(boundary, new_index);
+		g->set_boundary(boundary);
+
+		std::vector<VertexGroup*> children = g->children();
+		for (std::size_t j = 0; j < children.size(); ++j)
+			remap(*children[j], new_index);
+	}
+}
+
+
+void PointSet::fit_plane(VertexGroup::Ptr g) {
+	g->set_plane(PlaneFitting::fit(points_, g->data(), g->size()));
 }
@@ -26,12 +26,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "../math/math_types.h"
 #include "../basic/counted.h"
 #include "../basic/smart_pointer.h"
+#include "../basic/memory_usage.h"
+#include "../basic/numa.h"
 
 #include "vertex_group.h"
+#include "point_search.h"
 #include <list>
+#include <mutex>
 
 
 class VertexGroup;
+class PointSetRoiIndex;
 
 class MODEL_API PointSet : public Counted
 {
@@ -48,14 +53,36 @@ public:
 	std::vector<vec3>& colors() { return colors_; }
 	std::vector<vec3>& normals() { return normals_; }
 	std::vector<float>& planar_qualities() { return planar_qualities_; }
+	// the number of original points each point stands for (e.g., after downsampling)
+	std::vector<float>& weights() { return weights_; }
 	const std::vector<vec3>& points() const { return points_; }
 	const std::vector<vec3>& colors() const { return colors_; }
 	const std::vector<vec3>& normals() const { return normals_; }
 	const std::vector<float>& planar_qualities() const { return planar_qualities_; }
+	const std::vector<float>& weights() const { return weights_; }
+
+	// The parameters the planar qualities were computed with (see HypothesisGenerator::compute_point_confidences()),
+	// so that they can be reused, e.g., once saved with the points: the three neighborhood sizes and the
+	// resulting average spacing of the points. They are invalidated when the points change (see 
+	// notify_points_change()).
+	struct QualityParameters {
+		QualityParameters() : average_spacing(0.0f) { sizes[0] = sizes[1] = sizes[2] = 0; }
+		bool is_valid() const { return sizes[0] > 0 && sizes[1] > 0 && sizes[2] > 0; }
+
+		unsigned int	sizes[3];
+		float			average_spacing;
+	};
+	QualityParameters& quality_parameters() { return quality_parameters_; }
+	const QualityParameters& quality_parameters() const { return quality_parameters_; }
 
 	bool    has_normals() const { return normals_.size() > 0 && normals_.size() == points_.size(); }
 	bool	has_colors() const  { return colors_.size() > 0 && colors_.size() == points_.size(); }
 	bool    has_planar_qualities() const { return planar_qualities_.size() > 0 && planar_qualities_.size() == points_.size(); }
+	bool    has_weights() const { return weights_.size() > 0 && weights_.size() == points_.size(); }
+
+	// the weight of a point (1 if the points have no weights) and the sum of the weights
+	float	weight(std::size_t i) const { return has_weights() ? weights_[i] : 1.0f; }
+	double	total_weight() const;
 	
 	void	delete_points(const std::vector<unsigned int>& indices);
 
@@ -67,16 +94,107 @@ public:
 	// the points that don't belong to any vertex groups
 	std::vector<unsigned int> idle_points() const;
 
+	// Permutes the points (and their colors, normals and planar qualities) so that the points of 
+	// each group are contiguous (in the order of the groups, a point in several groups going with 
+	// the first one), followed by the idle points, and remaps the indices of the groups. If given,
+	// 'new_indices' receives the new index of each point.
+	void reorder_by_groups(std::vector<unsigned int>* new_indices = nil);
+
+	// Permutes the points (and their attributes) in the order of the Morton codes of their positions in
+	// the bounding box, so that the points near in space are near in memory (e.g., for the kNN queries
+	// of the index built afterwards, while the points arrive in the order of the scans), and remaps the 
+	// indices of the groups. The indices of each group are sorted, so its points are visited in the same
+	// order (and reorder_by_groups() keeps it within each group). If given, 'new_indices' receives the 
+	// new index of each point.
+	void reorder_spatially(std::vector<unsigned int>* new_indices = nil);
+
 	void fit_plane(VertexGroup::Ptr g);
 
+	// A mirror of the points padded to 4 floats each (x, y, z, 0) at a 16-byte aligned address, for the
+	// kernels that load a point at once (e.g., aligned 128-bit loads, see Plane3d::count_within_padded()).
+	// The points() keep their layout (the mirror is a copy for the kernels that only read the points), and
+	// the mirror is only kept if requested: update_padded_points() (re)builds it if the points changed since
+	// (see points_version()), and padded_points() returns it, or nil if it is not up to date. Its pages are
+	// first touched by the threads filling it (see Numa).
+	void update_padded_points();
+	const float* padded_points() const;
+	void release_padded_points();
+
+	// The spatial index of the points (see PointSearch), built on the first request and shared by the 
+	// stages that search the points (e.g., the segmentation and the point confidences), so a pipeline 
+	// builds it once. It is rebuilt if the points changed since (see points_version()) or another 
+	// backend is requested (AUTO takes the index kept, whatever its backend), with up to 'num_threads'
+	// threads and the kd-trees cached in 'cache_directory' (see PointSearch::create()). It can be 
+	// requested from several threads at a time, and searched from any threads once returned. The index
+	// stays valid for the clients holding it after it is replaced. 
+	// NOTE: the clients changing the settings of the index (e.g., its epsilon) restore them afterwards.
+	PointSearch_var point_search(PointSearch::Backend backend = PointSearch::AUTO, unsigned int num_threads = 0, 
+		const std::string& cache_directory = "") const;
+	// shares an index of the current points built elsewhere (e.g., while they were read, see 
+	// StreamingIndexBuilder)
+	void set_point_search(PointSearch* search);
+	void release_point_search();
+
+	// A coarse spatial index of the points and of their groups (see PointSetRoiIndex), to extract the
+	// points inside a box (e.g., a tile, or a crop) in time proportional to the points extracted. It is
+	// only kept if requested: update_roi_index() (re)builds the parts of it that are out of date (the 
+	// grid if the points changed since, and the groups of the points if the groups changed), and 
+	// roi_index() returns it, or nil if it is not up to date.
+	void update_roi_index();
+	const PointSetRoiIndex* roi_index() const;
+	void release_roi_index();
+
 	const Box3d& bbox() const;
 	void invalidate_bbox() { bbox_is_valid_ = false; }
 
+	// The (id, version) pair identifies the state of the point set, e.g., for the data derived 
+	// from it (such as the buffers of the renderer). The id is unique to each point set, and
+	// the version changes when points are deleted or reordered. The clients that modify the 
+	// points, their attributes or the groups directly must call notify_change().
+	unsigned int id() const { return id_; }
+	unsigned int version() const { return version_; }
+	void notify_change() { ++version_; }
+
+	// The points version only changes with the points themselves (added, deleted, or moved), not with
+	// their groups, so the data derived from the positions alone (e.g., the planar qualities and the 
+	// confidences of the faces) are reused across the edits of the groups. The clients that add or move
+	// points must call notify_points_change(), which also invalidates the quality parameters.
+	unsigned int points_version() const { return points_version_; }
+	void notify_points_change() { ++version_; ++points_version_; quality_parameters_ = QualityParameters(); }
+
+	// the memory used by the points, the normals, the colors, the planar qualities, the weights, and
+	// the vertex groups
+	MemoryUsage memory_usage() const;
+
+private:
+	static unsigned int new_id();
+
+	// permutes the points and their attributes ('order' is the old index of each new position, and
+	// 'new_index' the new index of each point), and remaps the groups
+	void apply_order(const std::vector<unsigned int>& order, const std::vector<unsigned int>& new_index);
+
 private:
+	unsigned int	id_;
+	unsigned int	version_;
+	unsigned int	points_version_;
+
 	std::vector<vec3>  points_;
 	std::vector<vec3>  colors_;
 	std::vector<vec3>  normals_;
 	std::vector<float> planar_qualities_;
+	std::vector<float> weights_;
+	QualityParameters  quality_parameters_;
+
+	std::vector<float, LargeArrayAllocator<float> >	padded_storage_;	// with room for the alignment
+	std::size_t			padded_offset_;		// of the first point in the storage
+	unsigned int		padded_version_;	// the points version the mirror was built for
+	std::size_t			padded_size_;
+
+	PointSetRoiIndex*	roi_index_;
+
+	mutable PointSearch_var	point_search_;
+	mutable unsigned int	point_search_version_;	// the points version it was built for
+	mutable std::mutex		point_search_mutex_;
 
 	mutable bool	bbox_is_valid_;
 	mutable Box3d	bbox_;
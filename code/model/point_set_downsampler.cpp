@@ -0,0 +1,178 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_set_downsampler.h"
+#include "point_set.h"
+#include "../basic/logger.h"
+#include "../basic/parallel.h"
+
+#include <unordered_map>
+#include <cfloat>
+
+
+namespace {
+
+	const std::size_t chunk_size = 65536;
+	const int bits_per_axis = 21;
+
+	// a voxel and a segment
+	struct Cell {
+		Numeric::uint64	voxel;
+		int				group;
+		bool operator==(const Cell& other) const { return voxel == other.voxel && group == other.group; }
+	};
+
+	struct CellHash {
+		std::size_t operator()(const Cell& c) const {
+			Numeric::uint64 h = (c.voxel ^ (Numeric::uint64(Numeric::uint32(c.group)) * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+			return static_cast<std::size_t>(h ^ (h >> 31));
+		}
+	};
+
+	// the points of a cell
+	struct CellPoints {
+		double		sum[3];
+		double		weight;
+		std::size_t	count;
+		std::size_t	best;		// the point closest to the centroid
+		double		best_dist;
+	};
+}
+
+
+std::size_t PointSetDownsampler::voxel_grid(PointSet* pset, float cell_size, unsigned int num_threads) {
+	const std::vector<vec3>& points = pset->points();
+	std::size_t n = points.size();
+	if (cell_size <= 0.0f || n == 0)
+		return n;
+
+	const Box3d& box = pset->bbox();
+	const double origin[3] = { box.x_min(), box.y_min(), box.z_min() };
+	double extent = ogf_max(box.x_max() - box.x_min(), box.y_max() - box.y_min(), box.z_max() - box.z_min());
+	if (extent / cell_size >= double(1 << bits_per_axis)) {
+		Logger::warn("-") << "cell size " << cell_size << " is too small for the extent of the points (" << extent << "), no downsampling" << std::endl;
+		return n;
+	}
+
+	// the segment of each point: the first group containing it
+	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+	std::vector<int> group_of(n, -1);
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		const VertexGroup* g = groups[i];
+		for (std::size_t j = 0; j < g->size(); ++j) {
+			if (group_of[g->at(j)] == -1)
+				group_of[g->at(j)] = static_cast<int>(i);
+		}
+	}
+
+	// the cell of each point, and its shard
+	std::size_t num_shards = std::size_t(parallel_num_threads(num_threads)) * 4;
+	std::size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+	std::vector<Numeric::uint64> voxels(n);
+	std::vector<unsigned int> shard_of(n);
+	std::vector<std::size_t> counts(num_chunks * num_shards, 0);	// of each chunk in each shard
+	CellHash hash;
+	parallel_for(num_chunks, [&](std::size_t c) {
+		std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		for (std::size_t i = c * chunk_size; i < last; ++i) {
+			Numeric::uint64 key = 0;
+			for (int a = 0; a < 3; ++a) {
+				double v = ogf_max((points[i][a] - origin[a]) / cell_size, 0.0);
+				key = (key << bits_per_axis) | ogf_min(static_cast<Numeric::uint64>(v), (Numeric::uint64(1) << bits_per_axis) - 1);
+			}
+			voxels[i] = key;
+			Cell cell = { key, group_of[i] };
+			shard_of[i] = static_cast<unsigned int>(hash(cell) % num_shards);
+			++counts[c * num_shards + shard_of[i]];
+		}
+	}, nil, num_threads);
+
+	// the points sorted by shard (in increasing order in each shard)
+	std::vector<std::size_t> starts(num_chunks * num_shards), shard_first(num_shards + 1, 0);
+	std::size_t total = 0;
+	for (std::size_t s = 0; s < num_shards; ++s) {
+		shard_first[s] = total;
+		for (std::size_t c = 0; c < num_chunks; ++c) {
+			starts[c * num_shards + s] = total;
+			total += counts[c * num_shards + s];
+		}
+	}
+	shard_first[num_shards] = total;
+	std::vector<unsigned int> sorted(n);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		std::size_t* pos = &starts[c * num_shards];
+		for (std::size_t i = c * chunk_size; i < last; ++i)
+			sorted[pos[shard_of[i]]++] = static_cast<unsigned int>(i);
+	}, nil, num_threads);
+
+	// the representative of each cell, and its weight
+	std::vector<unsigned char> keep(n, 0);
+	std::vector<float> weights(n, 0.0f);
+	parallel_for(num_shards, [&](std::size_t s) {
+		std::unordered_map<Cell, CellPoints, CellHash> cells;
+		for (std::size_t k = shard_first[s]; k < shard_first[s + 1]; ++k) {
+			std::size_t i = sorted[k];
+			Cell cell = { voxels[i], group_of[i] };
+			std::pair<std::unordered_map<Cell, CellPoints, CellHash>::iterator, bool> pos = cells.insert(std::make_pair(cell, CellPoints()));
+			CellPoints& c = pos.first->second;
+			if (pos.second) {
+				c.sum[0] = c.sum[1] = c.sum[2] = 0.0;
+				c.weight = 0.0;
+				c.count = 0;
+				c.best = i;
+				c.best_dist = DBL_MAX;
+			}
+			for (int a = 0; a < 3; ++a)
+				c.sum[a] += points[i][a];
+			c.weight += pset->weight(i);
+			++c.count;
+		}
+
+		for (std::size_t k = shard_first[s]; k < shard_first[s + 1]; ++k) {
+			std::size_t i = sorted[k];
+			Cell cell = { voxels[i], group_of[i] };
+			CellPoints& c = cells[cell];
+			double dist = 0.0;
+			for (int a = 0; a < 3; ++a) {
+				double d = points[i][a] - c.sum[a] / c.count;
+				dist += d * d;
+			}
+			if (dist < c.best_dist) {	// the first of the closest ones
+				c.best_dist = dist;
+				c.best = i;
+			}
+		}
+
+		for (std::unordered_map<Cell, CellPoints, CellHash>::const_iterator it = cells.begin(); it != cells.end(); ++it) {
+			keep[it->second.best] = 1;
+			weights[it->second.best] = static_cast<float>(it->second.weight);
+		}
+	}, nil, num_threads);
+
+	std::vector<unsigned int> deleted;
+	deleted.reserve(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		if (!keep[i])
+			deleted.push_back(static_cast<unsigned int>(i));
+	}
+	pset->weights().swap(weights);
+	pset->delete_points(deleted);
+	return pset->num_points();
+}
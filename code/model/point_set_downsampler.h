@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _POINT_SET_DOWNSAMPLER_H_
+#define _POINT_SET_DOWNSAMPLER_H_
+
+#include "model_common.h"
+
+#include <cstddef>
+
+
+class PointSet;
+
+/**
+* Downsampling of the dense point sets on a voxel grid. The points of each cell of the grid that
+* belong to the same segment (the first group containing them, or none) are replaced by the one
+* closest to their centroid, which keeps its position, normal, color and groups, and gets the total
+* weight of the points it stands for (see PointSet::weights()). So the weighted point counts (e.g.,
+* the supporting points of the faces) keep their scale.
+*
+* The occupied cells are hashed in shards, each shard handled by one thread. The result doesn't
+* depend on the number of threads.
+*/
+
+class MODEL_API PointSetDownsampler
+{
+public:
+	// returns the number of points after downsampling (the point set is unchanged if the cell size 
+	// isn't positive, or is too small for the extent of the points)
+	static std::size_t voxel_grid(PointSet* pset, float cell_size, unsigned int num_threads = 0);
+};
+
+#endif
@@ -19,10 +19,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "point_set_io.h"
 #include "point_set_serializer_vg.h"
+#include "point_set_serializer_bvgz.h"
+#include "point_set_serializer_ply.h"
 #include "../model/point_set.h"
 #include "../basic/stop_watch.h"
 #include "../basic/file_utils.h"
 #include "../basic/logger.h"
+#include "../basic/tracer.h"
 
 #include <fstream>
 #include <list>
@@ -30,6 +33,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 PointSet* PointSetIO::read(const std::string& file_name)
 {
+	return read(file_name, PointsCallback());
+}
+
+
+PointSet* PointSetIO::read(const std::string& file_name, const PointsCallback& points_read)
+{
+	TraceZone zone("PointSetIO::read", "io");
 	std::ifstream in(file_name.c_str()) ;
 	if(in.fail()) {
 		Logger::err("-") << "cannot open file: " << file_name << std::endl;
@@ -47,7 +57,11 @@ PointSet* PointSetIO::read(const std::string& file_name)
 	if (ext == "vg")
 		PointSetSerializer_vg::load_vg(pset, file_name);
 	else if (ext == "bvg")
-		PointSetSerializer_vg::load_bvg(pset, file_name);
+		PointSetSerializer_vg::load_bvg(pset, file_name, points_read);
+	else if (ext == "bvgz")
+		PointSetSerializer_bvgz::load_bvgz(pset, file_name);
+	else if (ext == "ply")
+		PointSetSerializer_ply::load_ply(pset, file_name);
 
 	else {
 		Logger::err("-") << "reading file failed (unknown file format)" << std::endl;
@@ -57,16 +71,23 @@ PointSet* PointSetIO::read(const std::string& file_name)
 		
 	if (pset->num_points() < 1) {
 		Logger::err("-") << "reading file failed (no data exist)" << std::endl;
+		if (points_read)
+			points_read(nil, 0, 0);
 		delete pset;
 		return nil;
 	}
 
+	// all the points, e.g., of the formats read at once (or of a .bvg file that could not be mapped)
+	if (points_read)
+		points_read(pset->points().data(), pset->num_points(), pset->num_points());
+
 	Logger::out("-") << "done. " << w.elapsed() << " sec." << std::endl;
 
 	return pset;
 }
 
 bool PointSetIO::save(const std::string& file_name, const PointSet* point_set) {
+	TraceZone zone("PointSetIO::save", "io");
 	if (!point_set) {
 		Logger::err("-") << "Point set is null" << std::endl;
 		return false;
@@ -90,6 +111,10 @@ bool PointSetIO::save(const std::string& file_name, const PointSet* point_set) {
 		PointSetSerializer_vg::save_vg(point_set, file_name);
 	else if (ext == "bvg")
 		PointSetSerializer_vg::save_bvg(point_set, file_name);
+	else if (ext == "bvgz")
+		PointSetSerializer_bvgz::save_bvgz(point_set, file_name);
+	else if (ext == "ply")
+		PointSetSerializer_ply::save_ply(point_set, file_name);
 
 	else {
 		Logger::err("-") << "saving file failed (unknown file format)" << std::endl;
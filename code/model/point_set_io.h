@@ -21,8 +21,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define _POINT_SET_IO_H_
 
 #include "model_common.h"
+#include "../math/math_types.h"
 
 #include <string>
+#include <functional>
 
 
 class PointSet;
@@ -33,6 +35,17 @@ public:
 	// for both point cloud and mesh
 	static PointSet* read(const std::string& file_name);
 
+	// Called by the progressive read as the points arrive (in the reading thread): the first 'num' of
+	// the 'total' points are read, at 'points' (in their final storage, which stays valid until the read
+	// returns). It is called with (nil, 0, 0) if the points become invalid, before the read fails.
+	typedef std::function<void(const vec3* points, std::size_t num, std::size_t total)> PointsCallback;
+
+	// The same as read(), reporting the points as they are read to 'points_read', e.g., for showing
+	// a large point cloud being loaded in the background. Only the .bvg files are read progressively,
+	// the points of the other formats are reported once they are all read (as are the points of all
+	// the formats at the end).
+	static PointSet* read(const std::string& file_name, const PointsCallback& points_read);
+
 	// save the point set to a file. return false if failed.
 	static bool		 save(const std::string& file_name, const PointSet* point_set);
 };
@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_set_normals.h"
+#include "point_search.h"
+#include "../math/principal_axes.h"
+#include "../basic/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+float PointSetNormals::estimate(
+	const std::vector<vec3>& points, const PointSearch* search, const unsigned int sizes[3],
+	std::vector<float>& planar_qualities, std::vector<vec3>* normals,
+	std::vector<unsigned int>* graph, unsigned int graph_size,
+	unsigned int num_threads, ProgressLogger* progress)
+{
+	planar_qualities.resize(points.size());
+	if (normals)
+		normals->resize(points.size());
+	if (graph)
+		graph->assign(points.size() * graph_size, PointSearch::invalid_index);
+	if (points.empty())
+		return 0.0f;
+
+	const unsigned int quality_size = std::max(sizes[0], std::max(sizes[1], sizes[2]));
+	const unsigned int max_size = std::max(quality_size, graph ? graph_size : 0u);
+
+	// The neighbors are queried in batches (into flat arrays reused by all the batches), 
+	// and then the points of each batch are processed in parallel.
+	const std::size_t batch_size = 16384;
+	const std::size_t num_batch = std::min(batch_size, points.size());
+	std::vector<unsigned int> batch_neighbors(num_batch * max_size);
+	std::vector<float> batch_sqr_distances(num_batch * max_size);
+
+	std::vector<float> spacings(points.size(), 0.0f);
+	for (std::size_t first = 0; first < points.size(); first += batch_size) {
+		std::size_t n = std::min(batch_size, points.size() - first);
+		search->find_closest_K_points(&points[first], n, max_size, batch_neighbors.data(), batch_sqr_distances.data(), num_threads);
+
+		parallel_for(n, [&](std::size_t b) {
+			std::size_t i = first + b;
+			const unsigned int* neighbors = &batch_neighbors[b * max_size];
+			const float* sqr_distances = &batch_sqr_distances[b * max_size];
+			std::size_t num_neighbors = 0;
+			while (num_neighbors < max_size && neighbors[num_neighbors] != PointSearch::invalid_index)
+				++num_neighbors;
+			if (graph)
+				std::copy(neighbors, neighbors + std::min<std::size_t>(graph_size, num_neighbors), &(*graph)[i * graph_size]);
+
+			std::size_t num[3];
+			for (int j = 0; j < 3; ++j)
+				num[j] = std::min<std::size_t>(sizes[j], num_neighbors);
+
+			double eigen_values[3][3];
+			double avg = 0;
+			PrincipalAxes3d pca;
+			pca.begin();
+			for (std::size_t k = 0; k < num_neighbors; ++k) {
+				pca.add_point(points[neighbors[k]]);
+				if (k < num[0])
+					avg += std::sqrt(double(sqr_distances[k]));
+
+				for (int j = 0; j < 3; ++j) {
+					if (k + 1 == num[j]) {
+						PrincipalAxes3d prefix = pca;
+						prefix.end();
+						for (int m = 0; m < 3; ++m)
+							eigen_values[j][m] = prefix.eigen_value(3 - m - 1); // eigen values are sorted in descending order
+						if (j == 1 && normals)
+							(*normals)[i] = prefix.axis(2);
+					}
+				}
+			}
+			if (num_neighbors < quality_size) {	// as find_closest_K_points() of a single point
+				planar_qualities[i] = 0.0f;
+				return;
+			}
+			spacings[i] = static_cast<float>(avg / num[0]);
+
+			double conf = 0.0;
+			for (int j = 0; j < 3; ++j) {
+				conf += (1 - 3.0 * eigen_values[j][0] / (eigen_values[j][0] + eigen_values[j][1] + eigen_values[j][2])) * (eigen_values[j][1] / eigen_values[j][2]);
+			}
+			conf /= 3.0;
+			planar_qualities[i] = static_cast<float>(conf);
+		}, progress, num_threads);
+	}
+
+	// summed in order, so the result doesn't depend on the number of threads
+	double total = 0;
+	for (std::size_t i = 0; i < spacings.size(); ++i)
+		total += spacings[i];
+	return static_cast<float>(total / points.size());
+}
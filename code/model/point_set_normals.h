@@ -0,0 +1,58 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _POINT_SET_NORMALS_H_
+#define _POINT_SET_NORMALS_H_
+
+#include "model_common.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+class PointSearch;
+class ProgressLogger;
+
+/**
+* The local geometry of the points, from the covariances of three neighborhoods of each point (its 
+* sizes[0], sizes[1], and sizes[2] nearest neighbors). The smaller neighborhoods are the prefixes of
+* the largest one (the neighbors are sorted by distance), so a single K nearest neighbor query per 
+* point gives the three covariances, from the partial sums when reaching their sizes.
+* It computes in the same pass the planar quality of each point (the confidence of Nan and Wonka 
+* (2017), 0 if the point has less neighbors than the largest size), and optionally the normals (the 
+* smallest principal axis of the middle neighborhood, not oriented) and the graph of the nearest 
+* neighbors (the first 'graph_size' neighbors of each point, at i * graph_size for the i-th point, 
+* invalid_index if there are less).
+* The points are queried in batches, processed by up to 'num_threads' threads (0 meaning the number
+* of hardware threads).
+*/
+
+class MODEL_API PointSetNormals
+{
+public:
+	// returns the average spacing of the points (the mean distance to their sizes[0] nearest neighbors)
+	static float estimate(
+		const std::vector<vec3>& points, const PointSearch* search, const unsigned int sizes[3],
+		std::vector<float>& planar_qualities, std::vector<vec3>* normals = nil,
+		std::vector<unsigned int>* graph = nil, unsigned int graph_size = 0,
+		unsigned int num_threads = 0, ProgressLogger* progress = nil
+	);
+};
+
+#endif
@@ -0,0 +1,311 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_set_roi_index.h"
+#include "point_set.h"
+#include "vertex_group.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+
+namespace {
+
+	inline bool inside(const Box3d& box, const vec3& p) {
+		return p.x >= box.x_min() && p.x <= box.x_max() && p.y >= box.y_min() && p.y <= box.y_max() && p.z >= box.z_min() && p.z <= box.z_max();
+	}
+
+	inline bool inside(const Box3d& box, const Box3d& b) {
+		return b.x_min() >= box.x_min() && b.x_max() <= box.x_max() && b.y_min() >= box.y_min() && b.y_max() <= box.y_max() && b.z_min() >= box.z_min() && b.z_max() <= box.z_max();
+	}
+
+	inline bool intersect(const Box3d& a, const Box3d& b) {
+		return a.x_min() <= b.x_max() && b.x_min() <= a.x_max() && a.y_min() <= b.y_max() && b.y_min() <= a.y_max() && a.z_min() <= b.z_max() && b.z_min() <= a.z_max();
+	}
+
+	// avoids the grids of too many cells for the points spread over a large box
+	const std::size_t max_num_cells = std::size_t(1) << 22;
+
+}
+
+
+PointSetRoiIndex::PointSetRoiIndex(const PointSet* pset, unsigned int points_per_cell)
+	: pset_(pset)
+	, points_per_cell_(std::max(points_per_cell, 1u))
+	, points_version_(pset->points_version())
+	, version_(pset->version())
+{
+	build_grid();
+	build_groups();
+}
+
+
+bool PointSetRoiIndex::is_up_to_date() const {
+	return points_version_ == pset_->points_version() && version_ == pset_->version();
+}
+
+
+void PointSetRoiIndex::update() {
+	if (points_version_ != pset_->points_version()) {
+		points_version_ = pset_->points_version();
+		build_grid();
+	}
+	if (version_ != pset_->version()) {
+		version_ = pset_->version();
+		build_groups();
+	}
+}
+
+
+void PointSetRoiIndex::build_grid() {
+	const std::vector<vec3>& points = pset_->points();
+	const std::size_t n = points.size();
+
+	for (int d = 0; d < 3; ++d) {
+		cell_size_[d] = 1.0f;
+		num_cells_[d] = 1;
+	}
+	origin_ = vec3(0, 0, 0);
+	bbox_.clear();
+	if (n > 0) {
+		// not the cached one of the point set, which the clients moving the points may not invalidate
+		Box3d box;
+		for (std::size_t v = 0; v < n; ++v)
+			box.add_point(points[v]);
+		bbox_ = box;
+		origin_ = vec3(box.x_min(), box.y_min(), box.z_min());
+		const float extent[3] = { box.width(), box.height(), box.depth() };
+
+		// cubic cells, the axes thinner than a cell having a single layer of cells (e.g., the height of 
+		// a flat scene)
+		const double target = double(std::min(max_num_cells, std::max(std::size_t(1), n / points_per_cell_)));
+		bool thin[3] = { false, false, false };
+		double size = 0.0;
+		for (int iter = 0; iter < 3; ++iter) {
+			double volume = 1.0;
+			int dims = 0;
+			for (int d = 0; d < 3; ++d) {
+				if (!thin[d]) {
+					volume *= extent[d];
+					++dims;
+				}
+			}
+			if (dims == 0 || volume <= 0.0) {
+				// flat along one of the remaining axes: the next iteration treats it as thin
+				bool found = false;
+				for (int d = 0; d < 3; ++d) {
+					if (!thin[d] && extent[d] <= 0.0f) {
+						thin[d] = true;
+						found = true;
+					}
+				}
+				if (!found)
+					break;
+				continue;
+			}
+			size = std::pow(volume / target, 1.0 / dims);
+			bool changed = false;
+			for (int d = 0; d < 3; ++d) {
+				if (!thin[d] && extent[d] < size) {
+					thin[d] = true;
+					changed = true;
+				}
+			}
+			if (!changed)
+				break;
+		}
+
+		for (int d = 0; d < 3; ++d) {
+			if (thin[d] || size <= 0.0)
+				continue;
+			num_cells_[d] = std::max(1, std::min(int(std::ceil(extent[d] / size)), 1 << 14));
+			cell_size_[d] = extent[d] / num_cells_[d];
+		}
+	}
+
+	const std::size_t num = std::size_t(num_cells_[0]) * num_cells_[1] * num_cells_[2];
+	std::vector<unsigned int> cells(n);
+	cell_offsets_.assign(num + 1, 0);
+	for (std::size_t v = 0; v < n; ++v) {
+		cells[v] = static_cast<unsigned int>(cell_of(points[v]));
+		++cell_offsets_[cells[v] + 1];
+	}
+	for (std::size_t c = 1; c <= num; ++c)
+		cell_offsets_[c] += cell_offsets_[c - 1];
+
+	// counting sort, the points of each cell staying in increasing order
+	cell_points_.resize(n);
+	cell_boxes_.assign(num, Box3d());
+	std::vector<unsigned int> next(cell_offsets_.begin(), cell_offsets_.end() - 1);
+	for (std::size_t v = 0; v < n; ++v) {
+		cell_points_[next[cells[v]]++] = static_cast<unsigned int>(v);
+		cell_boxes_[cells[v]].add_point(points[v]);
+	}
+}
+
+
+void PointSetRoiIndex::build_groups() {
+	const std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	const std::size_t n = pset_->points().size();
+
+	group_offsets_.assign(n + 1, 0);
+	for (std::size_t g = 0; g < groups.size(); ++g) {
+		const VertexGroup* group = groups[g];
+		for (std::size_t i = 0; i < group->size(); ++i) {
+			if (group->at(i) < n)
+				++group_offsets_[group->at(i) + 1];
+		}
+	}
+	for (std::size_t v = 1; v <= n; ++v)
+		group_offsets_[v] += group_offsets_[v - 1];
+
+	point_groups_.resize(group_offsets_[n]);
+	std::vector<unsigned int> next(group_offsets_.begin(), group_offsets_.end() - 1);
+	for (std::size_t g = 0; g < groups.size(); ++g) {
+		const VertexGroup* group = groups[g];
+		for (std::size_t i = 0; i < group->size(); ++i) {
+			if (group->at(i) < n)
+				point_groups_[next[group->at(i)]++] = static_cast<unsigned int>(g);
+		}
+	}
+}
+
+
+std::size_t PointSetRoiIndex::cell_of(const vec3& p) const {
+	int cell[3];
+	for (int d = 0; d < 3; ++d) {
+		int i = int((p[d] - origin_[d]) / cell_size_[d]);
+		cell[d] = i < 0 ? 0 : (i >= num_cells_[d] ? num_cells_[d] - 1 : i);
+	}
+	return (std::size_t(cell[2]) * num_cells_[1] + cell[1]) * num_cells_[0] + cell[0];
+}
+
+
+void PointSetRoiIndex::cell_range(const Box3d& box, int lower[3], int upper[3]) const {
+	for (int d = 0; d < 3; ++d) {
+		int i0 = int(std::floor((box.min(d) - origin_[d]) / cell_size_[d]));
+		int i1 = int(std::floor((box.max(d) - origin_[d]) / cell_size_[d]));
+		// the points on the far bound of the grid are in its last cells
+		lower[d] = i0 < 0 ? 0 : (i0 >= num_cells_[d] ? num_cells_[d] - 1 : i0);
+		upper[d] = i1 < 0 ? 0 : (i1 >= num_cells_[d] ? num_cells_[d] - 1 : i1);
+	}
+}
+
+
+void PointSetRoiIndex::points_in(const Box3d& box, std::vector<unsigned int>& indices) const {
+	indices.clear();
+	const std::vector<vec3>& points = pset_->points();
+	if (points.empty() || !box.initialized() || !intersect(box, bbox_))
+		return;
+
+	int lower[3], upper[3];
+	cell_range(box, lower, upper);
+	for (int k = lower[2]; k <= upper[2]; ++k) {
+		for (int j = lower[1]; j <= upper[1]; ++j) {
+			for (int i = lower[0]; i <= upper[0]; ++i) {
+				const std::size_t c = (std::size_t(k) * num_cells_[1] + j) * num_cells_[0] + i;
+				const unsigned int first = cell_offsets_[c];
+				const unsigned int last = cell_offsets_[c + 1];
+				if (first == last)
+					continue;
+				// the bounding box of the points of the cell tells whether they all are inside
+				if (inside(box, cell_boxes_[c]))
+					indices.insert(indices.end(), cell_points_.begin() + first, cell_points_.begin() + last);
+				else if (intersect(box, cell_boxes_[c])) {
+					for (unsigned int m = first; m < last; ++m) {
+						if (inside(box, points[cell_points_[m]]))
+							indices.push_back(cell_points_[m]);
+					}
+				}
+			}
+		}
+	}
+
+	// the points of a single cell are in increasing order already
+	if (upper[0] > lower[0] || upper[1] > lower[1] || upper[2] > lower[2])
+		std::sort(indices.begin(), indices.end());
+}
+
+
+PointSet* PointSetRoiIndex::extract(const Box3d& box, unsigned int min_group_size, std::vector<unsigned int>* indices) const {
+	std::vector<unsigned int> own;
+	std::vector<unsigned int>& ids = indices ? *indices : own;
+	points_in(box, ids);
+
+	PointSet* result = new PointSet;
+	result->points().resize(ids.size());
+	for (std::size_t k = 0; k < ids.size(); ++k)
+		result->points()[k] = pset_->points()[ids[k]];
+	if (pset_->has_normals()) {
+		result->normals().resize(ids.size());
+		for (std::size_t k = 0; k < ids.size(); ++k)
+			result->normals()[k] = pset_->normals()[ids[k]];
+	}
+	if (pset_->has_colors()) {
+		result->colors().resize(ids.size());
+		for (std::size_t k = 0; k < ids.size(); ++k)
+			result->colors()[k] = pset_->colors()[ids[k]];
+	}
+	if (pset_->has_weights()) {
+		result->weights().resize(ids.size());
+		for (std::size_t k = 0; k < ids.size(); ++k)
+			result->weights()[k] = pset_->weights()[ids[k]];
+	}
+
+	// the parts of the groups, only the groups of the points extracted being visited
+	const std::vector<VertexGroup::Ptr>& groups = pset_->groups();
+	if (groups.empty() || group_offsets_.size() != pset_->points().size() + 1)
+		return result;
+
+	std::unordered_map<unsigned int, VertexGroup::Ptr> parts;
+	for (std::size_t k = 0; k < ids.size(); ++k) {
+		for (unsigned int m = group_offsets_[ids[k]]; m < group_offsets_[ids[k] + 1]; ++m) {
+			VertexGroup::Ptr& part = parts[point_groups_[m]];
+			if (!part)
+				part = new VertexGroup(result);
+			part->push_back(static_cast<unsigned int>(k));
+		}
+	}
+
+	std::vector<unsigned int> order;
+	order.reserve(parts.size());
+	for (std::unordered_map<unsigned int, VertexGroup::Ptr>::const_iterator it = parts.begin(); it != parts.end(); ++it)
+		order.push_back(it->first);
+	std::sort(order.begin(), order.end());
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		VertexGroup::Ptr& part = parts[order[i]];
+		if (part->size() < min_group_size)
+			continue;
+		const VertexGroup* g = groups[order[i]];
+		part->set_label(g->label());
+		part->set_color(g->color());
+		part->set_plane(g->plane());
+		result->groups().push_back(part);
+	}
+	return result;
+}
+
+
+MemoryUsage PointSetRoiIndex::memory_usage() const {
+	MemoryUsage usage;
+	usage.add("cells", MemoryUsage::of(cell_offsets_) + MemoryUsage::of(cell_points_) + MemoryUsage::of(cell_boxes_));
+	usage.add("groups of the points", MemoryUsage::of(group_offsets_) + MemoryUsage::of(point_groups_));
+	return usage;
+}
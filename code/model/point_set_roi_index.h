@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MODEL_POINT_SET_ROI_INDEX_H_
+#define _MODEL_POINT_SET_ROI_INDEX_H_
+
+#include "model_common.h"
+#include "../basic/basic_types.h"
+#include "../math/math_types.h"
+#include "../basic/memory_usage.h"
+
+#include <vector>
+
+
+class PointSet;
+
+// A coarse uniform grid of the points of a point set, for extracting the points inside a box (a region
+// of interest, e.g., a tile or an interactive crop) in time proportional to the points extracted: the 
+// cells inside the box are taken whole (as contiguous ranges of the indices of the points), and only
+// the points of the cells on the boundary of the box are tested. It also keeps the groups of each 
+// point, so the parts of the groups inside the box come without visiting the whole groups.
+// The index refers to the point set it was built for, which must outlive it. It becomes out of date
+// when the points or the groups change (see is_up_to_date() and update()).
+class MODEL_API PointSetRoiIndex {
+public:
+	// about 'points_per_cell' points in each cell on average
+	PointSetRoiIndex(const PointSet* pset, unsigned int points_per_cell = 1024);
+
+	const PointSet* point_set() const { return pset_; }
+
+	// whether the index is the one of the current points and groups
+	bool is_up_to_date() const;
+	// rebuilds the grid if the points changed since, and the groups of the points if the groups changed
+	void update();
+
+	std::size_t num_cells() const { return cell_boxes_.size(); }
+
+	// the indices of the points inside 'box' (the bounds included), in increasing order. It is a view
+	// of the points in the point set.
+	void points_in(const Box3d& box, std::vector<unsigned int>& indices) const;
+
+	// A new point set of the points inside 'box', in increasing order of their indices (received by 
+	// 'indices', if given), with their normals, colors and weights, and with the parts of size at least
+	// 'min_group_size' of the groups (with the labels, the colors and the planes of the whole groups,
+	// in the order of the groups).
+	PointSet* extract(const Box3d& box, unsigned int min_group_size = 1, std::vector<unsigned int>* indices = nil) const;
+
+	MemoryUsage memory_usage() const;
+
+private:
+	void build_grid();
+	void build_groups();
+
+	// the cell containing p (clamped to the grid)
+	std::size_t cell_of(const vec3& p) const;
+	void cell_range(const Box3d& box, int lower[3], int upper[3]) const;
+
+private:
+	const PointSet*	pset_;
+	unsigned int	points_per_cell_;
+	unsigned int	points_version_;	// of the point set the grid was built for
+	unsigned int	version_;			// of the point set the groups were taken from
+
+	Box3d			bbox_;				// of the points
+	vec3			origin_;
+	float			cell_size_[3];
+	int				num_cells_[3];
+
+	// the points of each cell (in increasing order): the ones of the cell c are between 
+	// cell_offsets_[c] and cell_offsets_[c + 1] in cell_points_
+	std::vector<unsigned int>	cell_offsets_;
+	std::vector<unsigned int>	cell_points_;
+	std::vector<Box3d>			cell_boxes_;	// the bounding boxes of the points in each cell
+
+	// the groups of each point (by their indices in PointSet::groups()), the same way
+	std::vector<unsigned int>	group_offsets_;
+	std::vector<unsigned int>	point_groups_;
+};
+
+
+#endif
@@ -0,0 +1,557 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_set_serializer_bvgz.h"
+
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+#include "../basic/basic_types.h"
+#include "../basic/logger.h"
+#include "../basic/progress.h"
+#include "../basic/block_codec.h"
+#include "../basic/mapped_file.h"
+#include "../basic/parallel.h"
+#include "../model/point_set.h"
+#include "../model/vertex_group.h"
+
+
+/*
+The file starts with a header:
+	magic "BVGZ", version (int), flags (unsigned int), position_bits (int), num_points (uint64),
+	bbox min (3 float), bbox max (3 float), num_blocks (unsigned int)
+followed by 'num_blocks' descriptors:
+	raw size (uint64), stored size (uint64)
+then by the stored bytes of all the blocks (compressed, or raw if they are of the same size). The
+points are in blocks of 'points_per_block' points, the last block has the vertex groups.
+
+A block of points has all the x, then all the y and all the z (as variable-length differences with
+the previous point, zigzag encoded), then the three channels of the colors (8 bits each), then the
+two octahedral components of the normals (16 bits each).
+*/
+
+namespace {
+
+	const char			magic[4] = { 'B', 'V', 'G', 'Z' };
+	const int			version = 1;
+	const std::size_t	points_per_block = 65536;
+
+	enum { HAS_COLORS = 1, HAS_NORMALS = 2 };
+
+
+	class ByteWriter {
+	public:
+		std::vector<unsigned char> bytes;
+
+		template <class T>
+		void put(const T& v) {
+			const unsigned char* p = reinterpret_cast<const unsigned char*>(&v);
+			bytes.insert(bytes.end(), p, p + sizeof(T));
+		}
+
+		void put_varint(Numeric::uint64 v) {
+			for (; v >= 0x80; v >>= 7)
+				bytes.push_back(static_cast<unsigned char>(v | 0x80));
+			bytes.push_back(static_cast<unsigned char>(v));
+		}
+
+		void put_signed(Numeric::int64 v) {
+			put_varint((Numeric::uint64(v) << 1) ^ Numeric::uint64(v >> 63));
+		}
+	};
+
+
+	// reads with bounds checking, 'failed' is set as soon as a read goes beyond the end
+	class ByteReader {
+	public:
+		ByteReader(const unsigned char* data, std::size_t size) : p_(data), end_(data + size), failed_(false) {}
+
+		bool failed() const { return failed_; }
+
+		template <class T>
+		bool get(T& v) {
+			if (failed_ || std::size_t(end_ - p_) < sizeof(T))
+				return set_failed();
+			std::memcpy(&v, p_, sizeof(T));
+			p_ += sizeof(T);
+			return true;
+		}
+
+		bool get_varint(Numeric::uint64& v) {
+			v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (failed_ || p_ == end_)
+					return set_failed();
+				unsigned char b = *p_++;
+				v |= Numeric::uint64(b & 0x7f) << shift;
+				if (b < 0x80)
+					return true;
+			}
+			return set_failed();
+		}
+
+		bool get_signed(Numeric::int64& v) {
+			Numeric::uint64 u;
+			if (!get_varint(u))
+				return false;
+			v = Numeric::int64(u >> 1) ^ -Numeric::int64(u & 1);
+			return true;
+		}
+
+		bool get_string(std::string& str) {
+			Numeric::uint64 size;
+			if (!get_varint(size) || size > Numeric::uint64(end_ - p_))
+				return set_failed();
+			str.assign(reinterpret_cast<const char*>(p_), static_cast<std::size_t>(size));
+			p_ += size;
+			return true;
+		}
+
+	private:
+		bool set_failed() { failed_ = true; return false; }
+
+	private:
+		const unsigned char* p_;
+		const unsigned char* end_;
+		bool failed_;
+	};
+
+
+	// maps the coordinates to integers in [0, 2^bits - 1] in the bounding box
+	class Quantizer {
+	public:
+		Quantizer(const float* bmin, const float* bmax, int bits) {
+			double levels = double((Numeric::int64(1) << bits) - 1);
+			for (int a = 0; a < 3; ++a) {
+				min_[a] = bmin[a];
+				double extent = double(bmax[a]) - double(bmin[a]);
+				scale_[a] = (extent > 0) ? levels / extent : 0.0;
+				step_[a] = (extent > 0) ? extent / levels : 0.0;
+				max_[a] = Numeric::int64(levels);
+			}
+		}
+
+		Numeric::int64 quantize(float v, int axis) const {
+			Numeric::int64 q = static_cast<Numeric::int64>(std::floor((double(v) - min_[axis]) * scale_[axis] + 0.5));
+			ogf_clamp(q, Numeric::int64(0), max_[axis]);
+			return q;
+		}
+
+		float dequantize(Numeric::int64 q, int axis) const {
+			return static_cast<float>(min_[axis] + double(q) * step_[axis]);
+		}
+
+	private:
+		double min_[3], scale_[3], step_[3];
+		Numeric::int64 max_[3];
+	};
+
+
+	inline float sign_not_zero(float v) { return (v < 0.0f) ? -1.0f : 1.0f; }
+
+	// rounds v * max to the nearest integer in [0, max]
+	inline float to_integer(float v, float max) {
+		float r = std::floor(v * max + 0.5f);
+		ogf_clamp(r, 0.0f, max);
+		return r;
+	}
+
+	inline unsigned short to_unorm16(float v) {	// v in [-1, 1]
+		return static_cast<unsigned short>(to_integer(v * 0.5f + 0.5f, 65535.0f));
+	}
+
+	inline float from_unorm16(unsigned short u) {
+		return float(u) / 65535.0f * 2.0f - 1.0f;
+	}
+
+	// projects the direction on the octahedron |x| + |y| + |z| = 1, its lower half being folded
+	void encode_normal(const vec3& n, unsigned short& u, unsigned short& v) {
+		float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+		if (l1 == 0.0f) {
+			u = v = to_unorm16(0.0f);
+			return;
+		}
+		float x = n.x / l1, y = n.y / l1;
+		if (n.z < 0.0f) {
+			float t = x;
+			x = (1.0f - std::fabs(y)) * sign_not_zero(t);
+			y = (1.0f - std::fabs(t)) * sign_not_zero(y);
+		}
+		u = to_unorm16(x);
+		v = to_unorm16(y);
+	}
+
+	vec3 decode_normal(unsigned short u, unsigned short v) {
+		float x = from_unorm16(u), y = from_unorm16(v);
+		float z = 1.0f - std::fabs(x) - std::fabs(y);
+		if (z < 0.0f) {
+			float t = x;
+			x = (1.0f - std::fabs(y)) * sign_not_zero(t);
+			y = (1.0f - std::fabs(t)) * sign_not_zero(y);
+		}
+		return normalize(vec3(x, y, z));
+	}
+
+
+	void encode_points(const PointSet* pset, std::size_t first, std::size_t last, unsigned int flags, const Quantizer& quantizer, ByteWriter& w) {
+		const std::vector<vec3>& points = pset->points();
+		for (int a = 0; a < 3; ++a) {
+			Numeric::int64 prev = 0;
+			for (std::size_t i = first; i < last; ++i) {
+				Numeric::int64 q = quantizer.quantize(points[i][a], a);
+				w.put_signed(q - prev);
+				prev = q;
+			}
+		}
+
+		if (flags & HAS_COLORS) {
+			const std::vector<vec3>& colors = pset->colors();
+			for (int a = 0; a < 3; ++a) {
+				for (std::size_t i = first; i < last; ++i)
+					w.put(static_cast<unsigned char>(to_integer(colors[i][a], 255.0f)));
+			}
+		}
+
+		if (flags & HAS_NORMALS) {
+			const std::vector<vec3>& normals = pset->normals();
+			std::vector<unsigned short> v(last - first);
+			for (std::size_t i = first; i < last; ++i) {
+				unsigned short u;
+				encode_normal(normals[i], u, v[i - first]);
+				w.put(u);
+			}
+			for (std::size_t i = 0; i < v.size(); ++i)
+				w.put(v[i]);
+		}
+	}
+
+
+	bool decode_points(ByteReader& r, std::size_t first, std::size_t last, unsigned int flags, const Quantizer& quantizer, PointSet* pset) {
+		std::vector<vec3>& points = pset->points();
+		for (int a = 0; a < 3; ++a) {
+			Numeric::int64 q = 0, delta;
+			for (std::size_t i = first; i < last; ++i) {
+				if (!r.get_signed(delta))
+					return false;
+				q += delta;
+				points[i][a] = quantizer.dequantize(q, a);
+			}
+		}
+
+		if (flags & HAS_COLORS) {
+			std::vector<vec3>& colors = pset->colors();
+			unsigned char c;
+			for (int a = 0; a < 3; ++a) {
+				for (std::size_t i = first; i < last; ++i) {
+					if (!r.get(c))
+						return false;
+					colors[i][a] = c / 255.0f;
+				}
+			}
+		}
+
+		if (flags & HAS_NORMALS) {
+			std::vector<vec3>& normals = pset->normals();
+			std::vector<unsigned short> u(last - first);
+			for (std::size_t i = 0; i < u.size(); ++i) {
+				if (!r.get(u[i]))
+					return false;
+			}
+			unsigned short v;
+			for (std::size_t i = first; i < last; ++i) {
+				if (!r.get(v))
+					return false;
+				normals[i] = decode_normal(u[i - first], v);
+			}
+		}
+		return true;
+	}
+
+
+	void encode_group(const VertexGroup* g, ByteWriter& w) {
+		const std::string& label = g->label();
+		w.put_varint(label.size());
+		w.bytes.insert(w.bytes.end(), label.begin(), label.end());
+
+		const Plane3d& plane = g->plane();
+		w.put(static_cast<float>(plane.a()));
+		w.put(static_cast<float>(plane.b()));
+		w.put(static_cast<float>(plane.c()));
+		w.put(static_cast<float>(plane.d()));
+
+		const Color& c = g->color();
+		w.put(c.r());
+		w.put(c.g());
+		w.put(c.b());
+
+		w.put_varint(g->size());
+		Numeric::int64 prev = 0;
+		for (std::size_t i = 0; i < g->size(); ++i) {
+			w.put_signed(Numeric::int64(g->at(i)) - prev);
+			prev = g->at(i);
+		}
+	}
+
+
+	// returns nil if the data is bad
+	VertexGroup* decode_group(ByteReader& r, std::size_t num_points) {
+		std::string label;
+		float para[4], rgb[3];
+		Numeric::uint64 size;
+		if (!r.get_string(label) || !r.get(para) || !r.get(rgb) || !r.get_varint(size) || size > num_points)
+			return nil;
+
+		std::vector<unsigned int> indices(static_cast<std::size_t>(size));
+		Numeric::int64 idx = 0, delta;
+		for (std::size_t i = 0; i < indices.size(); ++i) {
+			if (!r.get_signed(delta))
+				return nil;
+			idx += delta;
+			if (idx < 0 || idx >= Numeric::int64(num_points))
+				return nil;
+			indices[i] = static_cast<unsigned int>(idx);
+		}
+
+		VertexGroup* g = new VertexGroup;
+		g->swap(indices);
+		g->set_label(label);
+		g->set_plane(Plane3d(para[0], para[1], para[2], para[3]));
+		g->set_color(Color(rgb[0], rgb[1], rgb[2]));
+		return g;
+	}
+
+
+	void encode_groups(const PointSet* pset, ByteWriter& w) {
+		const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+		w.put_varint(groups.size());
+		for (std::size_t i = 0; i < groups.size(); ++i) {
+			encode_group(groups[i], w);
+
+			std::vector<VertexGroup*> children = groups[i]->children();
+			w.put_varint(children.size());
+			for (std::size_t j = 0; j < children.size(); ++j)
+				encode_group(children[j], w);
+		}
+	}
+
+
+	bool decode_groups(ByteReader& r, PointSet* pset, std::vector<VertexGroup::Ptr>& groups) {
+		Numeric::uint64 num_groups;
+		if (!r.get_varint(num_groups))
+			return false;
+		for (Numeric::uint64 i = 0; i < num_groups; ++i) {
+			VertexGroup::Ptr g = decode_group(r, pset->points().size());
+			Numeric::uint64 num_children;
+			if (!g || !r.get_varint(num_children))
+				return false;
+			g->set_point_set(pset);
+			groups.push_back(g);
+
+			for (Numeric::uint64 j = 0; j < num_children; ++j) {
+				// not a smart pointer: the parent only keeps a plain pointer to its children
+				VertexGroup* chld = decode_group(r, pset->points().size());
+				if (!chld)
+					return false;
+				chld->set_point_set(pset);
+				g->add_child(chld);
+			}
+		}
+		return true;
+	}
+
+}
+
+
+void PointSetSerializer_bvgz::save_bvgz(const PointSet* pset, const std::string& file_name, int position_bits) {
+	std::ofstream output(file_name.c_str(), std::fstream::binary);
+	if (output.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return;
+	}
+	if (position_bits < 8 || position_bits > 30) {
+		Logger::warn("-") << "invalid number of bits per coordinate (" << position_bits << "), using 16 instead" << std::endl;
+		position_bits = 16;
+	}
+
+	const std::vector<vec3>& points = pset->points();
+	std::size_t num_points = points.size();
+	unsigned int flags = 0;
+	if (pset->has_colors())
+		flags |= HAS_COLORS;
+	if (pset->has_normals())
+		flags |= HAS_NORMALS;
+
+	float bmin[3] = { 0.0f, 0.0f, 0.0f }, bmax[3] = { 0.0f, 0.0f, 0.0f };
+	if (num_points > 0) {
+		for (int a = 0; a < 3; ++a)
+			bmin[a] = bmax[a] = points[0][a];
+		for (std::size_t i = 1; i < num_points; ++i) {
+			for (int a = 0; a < 3; ++a) {
+				bmin[a] = ogf_min(bmin[a], points[i][a]);
+				bmax[a] = ogf_max(bmax[a], points[i][a]);
+			}
+		}
+	}
+	Quantizer quantizer(bmin, bmax, position_bits);
+
+	// the blocks of points then the block of the groups
+	std::size_t num_point_blocks = (num_points + points_per_block - 1) / points_per_block;
+	std::size_t num_blocks = num_point_blocks + 1;
+	std::vector<Numeric::uint64> raw_sizes(num_blocks);
+	std::vector< std::vector<unsigned char> > blocks(num_blocks);
+
+	ProgressLogger progress(num_blocks);
+	parallel_for(num_blocks, [&](std::size_t b) {
+		ByteWriter w;
+		if (b < num_point_blocks)
+			encode_points(pset, b * points_per_block, ogf_min((b + 1) * points_per_block, num_points), flags, quantizer, w);
+		else
+			encode_groups(pset, w);
+
+		raw_sizes[b] = w.bytes.size();
+		BlockCodec::compress(w.bytes.data(), w.bytes.size(), blocks[b]);
+		if (blocks[b].size() >= w.bytes.size())
+			blocks[b].swap(w.bytes);	// stored as is
+	}, &progress);
+
+	ByteWriter header;
+	header.bytes.insert(header.bytes.end(), magic, magic + 4);
+	header.put(version);
+	header.put(flags);
+	header.put(position_bits);
+	header.put(Numeric::uint64(num_points));
+	header.put(bmin);
+	header.put(bmax);
+	header.put(static_cast<unsigned int>(num_blocks));
+	for (std::size_t b = 0; b < num_blocks; ++b) {
+		header.put(raw_sizes[b]);
+		header.put(Numeric::uint64(blocks[b].size()));
+	}
+
+	output.write(reinterpret_cast<const char*>(header.bytes.data()), header.bytes.size());
+	for (std::size_t b = 0; b < num_blocks; ++b)
+		output.write(reinterpret_cast<const char*>(blocks[b].data()), blocks[b].size());
+	if (output.fail())
+		Logger::err("-") << "failed writing file \'" << file_name << "\'" << std::endl;
+}
+
+
+void PointSetSerializer_bvgz::load_bvgz(PointSet* pset, const std::string& file_name) {
+	MappedFile file(file_name);
+	if (!file.is_open()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return;
+	}
+
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+	ByteReader header(data, file.size());
+
+	char m[4];
+	int ver = 0, position_bits = 0;
+	unsigned int flags = 0, num_blocks = 0;
+	Numeric::uint64 num_points = 0;
+	float bmin[3], bmax[3];
+	if (!header.get(m) || std::memcmp(m, magic, 4) != 0) {
+		Logger::err("-") << "file \'" << file_name << "\' is not a .bvgz file" << std::endl;
+		return;
+	}
+	if (!header.get(ver) || ver != version) {
+		Logger::err("-") << "file \'" << file_name << "\' has an unsupported version (" << ver << ")" << std::endl;
+		return;
+	}
+	header.get(flags);
+	header.get(position_bits);
+	header.get(num_points);
+	header.get(bmin);
+	header.get(bmax);
+	header.get(num_blocks);
+
+	// The sizes of the header are checked before anything is allocated from them: each block takes two
+	// sizes in the header, and each point takes at least 3 bytes before the compression, which shrinks
+	// the data at most 256 times (see the check of the blocks below).
+	const Numeric::uint64 file_size = file.size();
+	const Numeric::uint64 fixed_size = 4 + sizeof(int) * 2 + sizeof(unsigned int) * 2 + sizeof(Numeric::uint64) + sizeof(float) * 6;
+	if (header.failed() || position_bits < 8 || position_bits > 30 || num_points > file_size * 256 ||
+		num_blocks > (file_size - fixed_size) / (sizeof(Numeric::uint64) * 2)) {
+		Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+		return;
+	}
+
+	std::size_t num_point_blocks = static_cast<std::size_t>((num_points + points_per_block - 1) / points_per_block);
+	std::vector<Numeric::uint64> raw_sizes(num_blocks), stored_sizes(num_blocks), offsets(num_blocks + 1);
+	for (std::size_t b = 0; b < num_blocks; ++b) {
+		header.get(raw_sizes[b]);
+		header.get(stored_sizes[b]);
+	}
+	if (header.failed() || num_blocks != num_point_blocks + 1) {
+		Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+		return;
+	}
+	offsets[0] = fixed_size + sizeof(Numeric::uint64) * 2 * Numeric::uint64(num_blocks);
+	for (std::size_t b = 0; b < num_blocks; ++b) {
+		// the block must end within the file (offsets[b] doesn't exceed the size of the file)
+		if (stored_sizes[b] > file_size - offsets[b]) {
+			Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+			return;
+		}
+		offsets[b + 1] = offsets[b] + stored_sizes[b];
+	}
+
+	std::size_t n = static_cast<std::size_t>(num_points);
+	pset->points().resize(n);
+	if (flags & HAS_COLORS)
+		pset->colors().resize(n);
+	if (flags & HAS_NORMALS)
+		pset->normals().resize(n);
+	Quantizer quantizer(bmin, bmax, position_bits);
+
+	std::vector<VertexGroup::Ptr> groups;
+	std::vector<char> valid(num_blocks, 0);
+	ProgressLogger progress(num_blocks);
+	parallel_for(num_blocks, [&](std::size_t b) {
+		const unsigned char* stored = data + offsets[b];
+		std::vector<unsigned char> raw;
+		if (stored_sizes[b] != raw_sizes[b]) {
+			if (raw_sizes[b] > stored_sizes[b] * 256 + 16)	// beyond what the compression can reach
+				return;
+			raw.resize(static_cast<std::size_t>(raw_sizes[b]));
+			if (!BlockCodec::decompress(stored, std::size_t(stored_sizes[b]), raw.data(), raw.size()))
+				return;
+			stored = raw.data();
+		}
+
+		ByteReader r(stored, std::size_t(raw_sizes[b]));
+		if (b < num_point_blocks)
+			valid[b] = decode_points(r, b * points_per_block, ogf_min((b + 1) * points_per_block, n), flags, quantizer, pset);
+		else
+			valid[b] = decode_groups(r, pset, groups);
+	}, &progress);
+
+	if (std::find(valid.begin(), valid.end(), 0) != valid.end()) {
+		Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+		pset->points().clear();
+		pset->colors().clear();
+		pset->normals().clear();
+		return;
+	}
+	pset->groups().insert(pset->groups().end(), groups.begin(), groups.end());
+	pset->invalidate_bbox();
+}
@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _POINT_SERIALIZER_BVGZ_H_
+#define _POINT_SERIALIZER_BVGZ_H_
+
+#include "model_common.h"
+
+#include <string>
+
+
+class PointSet;
+
+/**
+* A compact binary format of the point sets and their vertex groups (.bvgz), which is lossy:
+*   - the positions are quantized in the bounding box of the points (using 'position_bits' bits per
+*     coordinate) and stored as variable-length differences between consecutive points;
+*   - the colors are stored with 8 bits per channel;
+*   - the normals are unit vectors, stored in the octahedral encoding with 16 bits per component;
+*   - the point indices of the groups are stored as variable-length differences.
+* The points are stored in blocks (and the groups in one more block), each one compressed on its
+* own by BlockCodec, so that the blocks are encoded and decoded in parallel.
+*/
+
+class MODEL_API PointSetSerializer_bvgz
+{
+public:
+	static void load_bvgz(PointSet* pset, const std::string& file_name);
+	// 'position_bits' is in [8, 30], a coordinate is then within extent / (2^position_bits - 1) / 2
+	// of its original value, where extent is the size of the bounding box along its axis
+	static void save_bvgz(const PointSet* pset, const std::string& file_name, int position_bits = 16);
+};
+
+#endif
@@ -0,0 +1,526 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_set_serializer_ply.h"
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <locale>
+#include <map>
+
+#include "../basic/basic_types.h"
+#include "../basic/logger.h"
+#include "../basic/progress.h"
+#include "../basic/color.h"
+#include "../basic/mapped_file.h"
+#include "../basic/parallel.h"
+#include "../model/point_set.h"
+#include "../model/vertex_group.h"
+
+
+namespace {
+
+	enum Format { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+	enum Type { INVALID, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+	struct Property {
+		std::string	name;
+		Type		type;
+		bool		is_list;
+		Type		count_type;	// of a list
+	};
+
+	struct Element {
+		std::string				name;
+		std::size_t				count;
+		std::vector<Property>	properties;
+	};
+
+	const std::size_t vertices_per_chunk = 65536;
+
+
+	Type type_of(const std::string& name) {
+		if (name == "char" || name == "int8")		return INT8;
+		if (name == "uchar" || name == "uint8")		return UINT8;
+		if (name == "short" || name == "int16")		return INT16;
+		if (name == "ushort" || name == "uint16")	return UINT16;
+		if (name == "int" || name == "int32")		return INT32;
+		if (name == "uint" || name == "uint32")		return UINT32;
+		if (name == "float" || name == "float32")	return FLOAT32;
+		if (name == "double" || name == "float64")	return FLOAT64;
+		return INVALID;
+	}
+
+	std::size_t size_of(Type type) {
+		switch (type) {
+		case INT8: case UINT8:		return 1;
+		case INT16: case UINT16:	return 2;
+		case INT32: case UINT32: case FLOAT32:	return 4;
+		case FLOAT64:				return 8;
+		default:					return 0;
+		}
+	}
+
+	bool host_is_little_endian() {
+		const Numeric::uint16 one = 1;
+		return *reinterpret_cast<const unsigned char*>(&one) == 1;
+	}
+
+	// reads a value of the given type, in the byte order of the file
+	inline double read_value(const char* p, Type type, bool swap) {
+		char b[8];
+		std::size_t size = size_of(type);
+		if (swap)
+			std::reverse_copy(p, p + size, b);
+		else
+			std::memcpy(b, p, size);
+
+		switch (type) {
+		case INT8:		{ Numeric::int8 v;    std::memcpy(&v, b, 1); return v; }
+		case UINT8:		{ Numeric::uint8 v;   std::memcpy(&v, b, 1); return v; }
+		case INT16:		{ Numeric::int16 v;   std::memcpy(&v, b, 2); return v; }
+		case UINT16:	{ Numeric::uint16 v;  std::memcpy(&v, b, 2); return v; }
+		case INT32:		{ Numeric::int32 v;   std::memcpy(&v, b, 4); return v; }
+		case UINT32:	{ Numeric::uint32 v;  std::memcpy(&v, b, 4); return v; }
+		case FLOAT32:	{ Numeric::float32 v; std::memcpy(&v, b, 4); return v; }
+		case FLOAT64:	{ Numeric::float64 v; std::memcpy(&v, b, 8); return v; }
+		default:		return 0;
+		}
+	}
+
+	template <class T>
+	inline void write_value(char*& p, T v, bool swap) {
+		if (swap)
+			std::reverse_copy(reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v) + sizeof(T), p);
+		else
+			std::memcpy(p, &v, sizeof(T));
+		p += sizeof(T);
+	}
+
+
+	// parses the header, 'body' is set to the first byte after it
+	bool read_header(const char* data, const char* end, Format& format, std::vector<Element>& elements, const char*& body) {
+		static const char end_header[] = "end_header";
+		const char* last = std::search(data, end, end_header, end_header + sizeof(end_header) - 1);
+		if (last == end)
+			return false;
+		body = static_cast<const char*>(std::memchr(last, '\n', end - last));
+		if (!body)
+			return false;
+		++body;
+
+		std::istringstream input(std::string(data, last));
+		input.imbue(std::locale::classic());
+		std::string line, keyword;
+		std::getline(input, line);
+		if (line.compare(0, 3, "ply") != 0)
+			return false;
+
+		bool has_format = false;
+		while (std::getline(input, line)) {
+			std::istringstream in(line);
+			in.imbue(std::locale::classic());
+			if (!(in >> keyword))
+				continue;
+			if (keyword == "format") {
+				std::string name;
+				in >> name;
+				if (name == "ascii")						format = ASCII;
+				else if (name == "binary_little_endian")	format = BINARY_LITTLE_ENDIAN;
+				else if (name == "binary_big_endian")		format = BINARY_BIG_ENDIAN;
+				else
+					return false;
+				has_format = true;
+			}
+			else if (keyword == "element") {
+				Element e;
+				if (!(in >> e.name >> e.count))
+					return false;
+				elements.push_back(e);
+			}
+			else if (keyword == "property") {
+				if (elements.empty())
+					return false;
+				Property p;
+				std::string type;
+				in >> type;
+				p.is_list = (type == "list");
+				p.count_type = INVALID;
+				if (p.is_list) {
+					std::string count_type;
+					in >> count_type >> type;
+					p.count_type = type_of(count_type);
+					if (p.count_type == INVALID || p.count_type == FLOAT32 || p.count_type == FLOAT64)
+						return false;
+				}
+				p.type = type_of(type);
+				if (!(in >> p.name) || p.type == INVALID)
+					return false;
+				elements.back().properties.push_back(p);
+			}
+			// and the comments and obj_info are ignored
+		}
+		return has_format;
+	}
+
+
+	// moves 'p' beyond the items of a binary element (returns false if it goes beyond 'end')
+	bool skip_binary_element(const Element& e, const char*& p, const char* end, bool swap) {
+		for (std::size_t i = 0; i < e.count; ++i) {
+			for (std::size_t j = 0; j < e.properties.size(); ++j) {
+				const Property& prop = e.properties[j];
+				std::size_t size = size_of(prop.count_type);
+				if (prop.is_list) {
+					if (std::size_t(end - p) < size)
+						return false;
+					std::size_t num = static_cast<std::size_t>(read_value(p, prop.count_type, swap));
+					p += size;
+					size = num * size_of(prop.type);
+				}
+				else
+					size = size_of(prop.type);
+				if (std::size_t(end - p) < size)
+					return false;
+				p += size;
+			}
+		}
+		return true;
+	}
+
+
+	// the index of the first property with one of the names (-1 if none)
+	int find_property(const Element& e, const char* const* names, std::size_t num_names) {
+		for (std::size_t i = 0; i < num_names; ++i) {
+			for (std::size_t j = 0; j < e.properties.size(); ++j) {
+				if (e.properties[j].name == names[i] && !e.properties[j].is_list)
+					return static_cast<int>(j);
+			}
+		}
+		return -1;
+	}
+
+	// the properties of the vertices that are read: x, y, z, nx, ny, nz, red, green, blue, segment id
+	struct VertexLayout {
+		int			index[10];
+		std::size_t	offset[10];	// of the binary properties, in a vertex
+		std::size_t	size;		// of a binary vertex
+
+		bool has(int first, int num) const {
+			for (int i = first; i < first + num; ++i) {
+				if (index[i] < 0)
+					return false;
+			}
+			return true;
+		}
+	};
+
+	VertexLayout vertex_layout(const Element& e) {
+		static const char* const names[9][3] = {
+			{ "x", "x", "x" }, { "y", "y", "y" }, { "z", "z", "z" },
+			{ "nx", "normal_x", "nx" }, { "ny", "normal_y", "ny" }, { "nz", "normal_z", "nz" },
+			{ "red", "r", "diffuse_red" }, { "green", "g", "diffuse_green" }, { "blue", "b", "diffuse_blue" }
+		};
+		static const char* const label_names[] = { "segment_id", "segment", "label", "plane_id" };
+
+		VertexLayout layout;
+		for (int i = 0; i < 9; ++i)
+			layout.index[i] = find_property(e, names[i], 3);
+		layout.index[9] = find_property(e, label_names, 4);
+
+		std::vector<std::size_t> offsets(e.properties.size(), 0);
+		layout.size = 0;
+		for (std::size_t j = 0; j < e.properties.size(); ++j) {
+			offsets[j] = layout.size;
+			layout.size += size_of(e.properties[j].type);
+		}
+		for (int i = 0; i < 10; ++i)
+			layout.offset[i] = (layout.index[i] >= 0) ? offsets[layout.index[i]] : 0;
+		return layout;
+	}
+
+	// the scale making the colors in [0, 1]
+	inline float color_scale(Type type) {
+		switch (type) {
+		case UINT8:		return 1.0f / 255.0f;
+		case UINT16:	return 1.0f / 65535.0f;
+		default:		return 1.0f;
+		}
+	}
+
+
+	// puts the points with the same non-negative label into a group (in the order of the labels)
+	void build_groups(PointSet* pset, const std::vector<int>& labels) {
+		std::map<int, VertexGroup*> groups;
+		int last_label = -1;
+		VertexGroup* last_group = nil;
+		for (std::size_t i = 0; i < labels.size(); ++i) {
+			int label = labels[i];
+			if (label < 0)
+				continue;
+			if (label != last_label || !last_group) {	// the labels come in runs, mostly
+				VertexGroup*& g = groups[label];
+				if (!g) {
+					g = new VertexGroup(pset);
+					std::ostringstream name;
+					name << "segment_" << label;
+					g->set_label(name.str());
+					g->set_color(random_color());
+				}
+				last_label = label;
+				last_group = g;
+			}
+			last_group->push_back(static_cast<unsigned int>(i));
+		}
+
+		std::vector<VertexGroup::Ptr> result;
+		for (std::map<int, VertexGroup*>::const_iterator it = groups.begin(); it != groups.end(); ++it)
+			result.push_back(it->second);
+
+		// each group is fitted by one thread
+		parallel_for(result.size(), [&](std::size_t i) {
+			if (result[i]->size() >= 3)
+				pset->fit_plane(result[i]);
+		});
+		pset->groups().insert(pset->groups().end(), result.begin(), result.end());
+	}
+
+
+	bool read_binary_vertices(const Element& e, const VertexLayout& layout, const char* data, const char* end, bool swap, PointSet* pset, std::vector<int>& labels) {
+		if (std::size_t(end - data) / ogf_max(layout.size, std::size_t(1)) < e.count)
+			return false;
+
+		std::vector<vec3>& points = pset->points();
+		std::vector<vec3>& normals = pset->normals();
+		std::vector<vec3>& colors = pset->colors();
+		const std::vector<Property>& props = e.properties;
+		bool has_normals = layout.has(3, 3);
+		bool has_colors = layout.has(6, 3);
+		bool has_labels = layout.has(9, 1);
+		float scale = has_colors ? color_scale(props[layout.index[6]].type) : 1.0f;
+
+		std::size_t num_chunks = (e.count + vertices_per_chunk - 1) / vertices_per_chunk;
+		parallel_for(num_chunks, [&](std::size_t c) {
+			std::size_t first = c * vertices_per_chunk;
+			std::size_t last = ogf_min(first + vertices_per_chunk, e.count);
+			for (std::size_t i = first; i < last; ++i) {
+				const char* v = data + i * layout.size;
+				for (int a = 0; a < 3; ++a)
+					points[i][a] = static_cast<float>(read_value(v + layout.offset[a], props[layout.index[a]].type, swap));
+				if (has_normals) {
+					for (int a = 0; a < 3; ++a)
+						normals[i][a] = static_cast<float>(read_value(v + layout.offset[3 + a], props[layout.index[3 + a]].type, swap));
+				}
+				if (has_colors) {
+					for (int a = 0; a < 3; ++a)
+						colors[i][a] = static_cast<float>(read_value(v + layout.offset[6 + a], props[layout.index[6 + a]].type, swap)) * scale;
+				}
+				if (has_labels)
+					labels[i] = static_cast<int>(read_value(v + layout.offset[9], props[layout.index[9]].type, swap));
+			}
+		});
+		return true;
+	}
+
+
+	// ascii files are read sequentially, with a stream
+	bool read_ascii_vertices(const std::vector<Element>& elements, std::size_t vertex_element, const VertexLayout& layout, const char* data, const char* end, PointSet* pset, std::vector<int>& labels) {
+		std::istringstream input(std::string(data, end));
+		input.imbue(std::locale::classic());
+
+		// the elements before the vertices, one line per item
+		std::string line;
+		for (std::size_t i = 0; i < vertex_element; ++i) {
+			for (std::size_t j = 0; j < elements[i].count; ++j) {
+				if (!std::getline(input, line))
+					return false;
+			}
+		}
+
+		const Element& e = elements[vertex_element];
+		float scale = layout.has(6, 3) ? color_scale(e.properties[layout.index[6]].type) : 1.0f;
+		std::vector<double> values(e.properties.size());
+		for (std::size_t i = 0; i < e.count; ++i) {
+			for (std::size_t j = 0; j < values.size(); ++j) {
+				if (!(input >> values[j]))
+					return false;
+			}
+			pset->points()[i] = vec3(float(values[layout.index[0]]), float(values[layout.index[1]]), float(values[layout.index[2]]));
+			if (layout.has(3, 3))
+				pset->normals()[i] = vec3(float(values[layout.index[3]]), float(values[layout.index[4]]), float(values[layout.index[5]]));
+			if (layout.has(6, 3))
+				pset->colors()[i] = vec3(float(values[layout.index[6]]), float(values[layout.index[7]]), float(values[layout.index[8]])) * scale;
+			if (layout.has(9, 1))
+				labels[i] = static_cast<int>(values[layout.index[9]]);
+		}
+		return true;
+	}
+}
+
+
+void PointSetSerializer_ply::load_ply(PointSet* pset, const std::string& file_name) {
+	MappedFile file(file_name);
+	if (!file.is_open()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return;
+	}
+	const char* data = file.data();
+	const char* end = data + file.size();
+
+	Format format = ASCII;
+	std::vector<Element> elements;
+	const char* body = nil;
+	if (!read_header(data, end, format, elements, body)) {
+		Logger::err("-") << "file \'" << file_name << "\' has no valid PLY header" << std::endl;
+		return;
+	}
+
+	std::size_t vertex_element = 0;
+	while (vertex_element < elements.size() && elements[vertex_element].name != "vertex")
+		++vertex_element;
+	if (vertex_element == elements.size()) {
+		Logger::err("-") << "file \'" << file_name << "\' has no vertices" << std::endl;
+		return;
+	}
+
+	const Element& e = elements[vertex_element];
+	VertexLayout layout = vertex_layout(e);
+	if (!layout.has(0, 3)) {
+		Logger::err("-") << "the vertices of file \'" << file_name << "\' have no x, y, z" << std::endl;
+		return;
+	}
+	for (std::size_t j = 0; j < e.properties.size(); ++j) {
+		if (e.properties[j].is_list) {
+			Logger::err("-") << "the vertices of file \'" << file_name << "\' have a list property (not supported)" << std::endl;
+			return;
+		}
+	}
+
+	pset->points().resize(e.count);
+	if (layout.has(3, 3))
+		pset->normals().resize(e.count);
+	if (layout.has(6, 3))
+		pset->colors().resize(e.count);
+	std::vector<int> labels(layout.has(9, 1) ? e.count : 0, -1);
+
+	bool success = false;
+	if (format == ASCII)
+		success = read_ascii_vertices(elements, vertex_element, layout, body, end, pset, labels);
+	else {
+		bool swap = ((format == BINARY_LITTLE_ENDIAN) != host_is_little_endian());
+		const char* p = body;
+		success = true;
+		for (std::size_t i = 0; success && i < vertex_element; ++i)
+			success = skip_binary_element(elements[i], p, end, swap);
+		success = success && read_binary_vertices(e, layout, p, end, swap, pset, labels);
+	}
+
+	if (!success) {
+		Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+		pset->points().clear();
+		pset->normals().clear();
+		pset->colors().clear();
+		return;
+	}
+
+	if (!labels.empty())
+		build_groups(pset, labels);
+	pset->invalidate_bbox();
+}
+
+
+void PointSetSerializer_ply::save_ply(const PointSet* pset, const std::string& file_name) {
+	std::ofstream output(file_name.c_str(), std::fstream::binary);
+	if (output.fail()) {
+		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
+		return;
+	}
+
+	const std::vector<vec3>& points = pset->points();
+	const std::vector<vec3>& normals = pset->normals();
+	const std::vector<vec3>& colors = pset->colors();
+	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+	bool has_normals = pset->has_normals();
+	bool has_colors = pset->has_colors();
+	bool has_labels = !groups.empty();
+
+	std::vector<int> labels(has_labels ? points.size() : 0, -1);
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		const VertexGroup* g = groups[i];
+		for (std::size_t j = 0; j < g->size(); ++j) {
+			if (g->at(j) < labels.size())
+				labels[g->at(j)] = static_cast<int>(i);
+		}
+	}
+
+	output << "ply" << std::endl;
+	output << "format binary_little_endian 1.0" << std::endl;
+	output << "element vertex " << points.size() << std::endl;
+	output << "property float x" << std::endl << "property float y" << std::endl << "property float z" << std::endl;
+	if (has_normals)
+		output << "property float nx" << std::endl << "property float ny" << std::endl << "property float nz" << std::endl;
+	if (has_colors)
+		output << "property uchar red" << std::endl << "property uchar green" << std::endl << "property uchar blue" << std::endl;
+	if (has_labels)
+		output << "property int segment_id" << std::endl;
+	output << "end_header" << std::endl;
+
+	std::size_t vertex_size = 12 + (has_normals ? 12 : 0) + (has_colors ? 3 : 0) + (has_labels ? 4 : 0);
+	bool swap = !host_is_little_endian();
+
+	// consecutive chunks of the vertices are formatted by different threads
+	std::size_t num_chunks = (points.size() + vertices_per_chunk - 1) / vertices_per_chunk;
+	std::size_t chunks_per_round = std::size_t(parallel_num_threads()) * 2;
+	std::vector< std::vector<char> > buffers(chunks_per_round);
+	ProgressLogger progress(num_chunks);
+	for (std::size_t start = 0; start < num_chunks; start += chunks_per_round) {
+		std::size_t num = ogf_min(chunks_per_round, num_chunks - start);
+		parallel_for(num, [&](std::size_t c) {
+			std::size_t first = (start + c) * vertices_per_chunk;
+			std::size_t last = ogf_min(first + vertices_per_chunk, points.size());
+			std::vector<char>& buffer = buffers[c];
+			buffer.resize((last - first) * vertex_size);
+			char* p = buffer.data();
+			for (std::size_t i = first; i < last; ++i) {
+				for (int a = 0; a < 3; ++a)
+					write_value(p, points[i][a], swap);
+				if (has_normals) {
+					for (int a = 0; a < 3; ++a)
+						write_value(p, normals[i][a], swap);
+				}
+				if (has_colors) {
+					for (int a = 0; a < 3; ++a) {
+						float v = colors[i][a] * 255.0f + 0.5f;
+						ogf_clamp(v, 0.0f, 255.0f);
+						write_value(p, static_cast<Numeric::uint8>(v), swap);
+					}
+				}
+				if (has_labels)
+					write_value(p, static_cast<Numeric::int32>(labels[i]), swap);
+			}
+		});
+		for (std::size_t c = 0; c < num; ++c)
+			output.write(buffers[c].data(), buffers[c].size());
+		progress.notify(start + num);
+	}
+
+	if (output.fail())
+		Logger::err("-") << "failed writing file \'" << file_name << "\'" << std::endl;
+}
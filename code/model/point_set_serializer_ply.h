@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _POINT_SERIALIZER_PLY_H_
+#define _POINT_SERIALIZER_PLY_H_
+
+#include "model_common.h"
+
+#include <string>
+
+
+class PointSet;
+
+/**
+* Point sets in the PLY format (the vertices of the file, the other elements are skipped).
+*
+* The positions, normals (nx, ny, nz) and colors (red, green, blue) of the vertices are read in 
+* bulk. A per-vertex segment id (an integer property named "segment_id", "segment", "label" or 
+* "plane_id") gives the vertex groups: the points with the same non-negative id make a group, whose
+* plane is fitted to its points.
+*/
+
+class MODEL_API PointSetSerializer_ply
+{
+public:
+	// reads ascii, binary little endian and binary big endian files
+	static void load_ply(PointSet* pset, const std::string& file_name);
+
+	// saves in binary little endian, the top-level groups as "segment_id" (-1 for the points of no
+	// group). The children of the groups are not saved.
+	static void save_ply(const PointSet* pset, const std::string& file_name);
+};
+
+#endif
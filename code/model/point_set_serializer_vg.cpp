@@ -21,17 +21,132 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "point_set_serializer_vg.h"
 
 #include <cassert>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <locale>
+#include <utility>
 
 #include "../basic/basic_types.h"
 #include "../basic/logger.h"
 #include "../basic/progress.h"
 #include "../basic/color.h"
+#include "../basic/mapped_file.h"
+#include "../basic/parallel.h"
+#include "../basic/text_io.h"
 #include "../model/point_set.h"
 
 
 //#define TRANSLATE_RELATIVE_TO_FIRST_POINT
 
 
+namespace {
+
+	//________________ parsing the ASCII format in memory ____________________
+
+	using namespace TextIO;
+
+	// the end of a block of numbers, i.e., the beginning of the next keyword (only keywords have ':')
+	const char* block_end(const char* p, const char* end) {
+		const char* colon = static_cast<const char*>(std::memchr(p, ':', end - p));
+		if (!colon)
+			return end;
+		while (colon > p && !is_space(colon[-1]))
+			--colon;
+		return colon;
+	}
+
+	// Parses the 'count' floats of [begin, end). Large blocks are split (between tokens) into 
+	// chunks parsed by different threads, once the tokens of each chunk have been counted.
+	bool parse_float_block(const char* begin, const char* end, float* values, std::size_t count) {
+		const std::size_t min_chunk_size = 256 * 1024;
+		std::size_t size = end - begin;
+		std::size_t num_chunks = ogf_max(std::size_t(1), ogf_min(size / min_chunk_size, std::size_t(parallel_num_threads()) * 4));
+
+		std::vector<const char*> bounds(num_chunks + 1);
+		bounds[0] = begin;
+		bounds[num_chunks] = end;
+		for (std::size_t i = 1; i < num_chunks; ++i) {
+			const char* p = ogf_max(begin + size / num_chunks * i, bounds[i - 1]);
+			while (p < end && !is_space(*p))
+				++p;
+			bounds[i] = p;
+		}
+
+		std::vector<std::size_t> first(num_chunks + 1, 0);
+		parallel_for(num_chunks, [&](std::size_t i) {
+			std::size_t num = 0;
+			const char* p = bounds[i];
+			while (skip_token(p, bounds[i + 1]))
+				++num;
+			first[i + 1] = num;
+		});
+		for (std::size_t i = 0; i < num_chunks; ++i)
+			first[i + 1] += first[i];
+		if (first[num_chunks] != count)
+			return false;
+
+		std::vector<char> valid(num_chunks, 1);
+		parallel_for(num_chunks, [&](std::size_t i) {
+			const char* p = bounds[i];
+			for (std::size_t j = first[i]; j < first[i + 1]; ++j) {
+				if (!read_float(p, bounds[i + 1], values[j])) {
+					valid[i] = 0;
+					return;
+				}
+			}
+		});
+		return std::find(valid.begin(), valid.end(), 0) == valid.end();
+	}
+
+	// the version of the (optional) block of the planar qualities, in both formats
+	const int planar_qualities_version = 1;
+	// the tag of the block in the binary format ("QUAL")
+	const int planar_qualities_tag = 0x4C415551;
+
+	// reads "keyword: num" and the block of num vec3 that follows
+	bool read_vec3_block(const char*& p, const char* end, std::vector<vec3>& v) {
+		long long num = 0;
+		if (!skip_token(p, end) || !read_integer(p, end, num) || num < 0)
+			return false;
+		const char* last = block_end(p, end);
+		v.resize(static_cast<std::size_t>(num));
+		if (num > 0 && !parse_float_block(p, last, v[0].data(), v.size() * 3))
+			return false;
+		p = last;
+		return true;
+	}
+
+	//________________ formatting the ASCII format ____________________
+
+	// writes the values (e.g., vectors) as operator<<() does (followed by a space), the text of
+	// consecutive chunks being formatted by different threads
+	template <class T>
+	void write_value_block(std::ostream& output, const std::vector<T>& v, ProgressLogger& progress, std::size_t& done) {
+		const std::size_t chunk_size = 32 * 1024;
+		std::size_t num_chunks = ogf_max(std::size_t(1), std::size_t(parallel_num_threads())) * 2;
+		std::vector<std::string> texts(num_chunks);
+		for (std::size_t start = 0; start < v.size(); start += num_chunks * chunk_size) {
+			parallel_for(num_chunks, [&](std::size_t i) {
+				std::size_t first = start + i * chunk_size;
+				std::size_t last = ogf_min(first + chunk_size, v.size());
+				std::ostringstream out;
+				out.imbue(output.getloc());
+				out.precision(output.precision());
+				for (std::size_t j = first; j < last; ++j)
+					out << v[j] << " ";
+				texts[i] = out.str();
+			});
+			for (std::size_t i = 0; i < num_chunks; ++i)
+				output.write(texts[i].data(), texts[i].size());
+			done = ogf_min(done + num_chunks * chunk_size, done + (v.size() - start));
+			progress.notify(done);
+		}
+	}
+}
+
+
 /*
 // file format definition
 num_points: num
@@ -75,6 +190,11 @@ idx ...
 
 ...
 
+planar_quality_parameters: version s1 s2 s3 spacing    // optional: the version of the block (1), the neighborhood sizes
+                                                        // and the average spacing the planar qualities were computed with
+num_planar_qualities: num                               // must equal to num_points
+q ...
+
 */
 void PointSetSerializer_vg::save_vg(const PointSet* pset, const std::string& file_name) {
 	// open file
@@ -93,25 +213,17 @@ void PointSetSerializer_vg::save_vg(const PointSet* pset, const std::string& fil
 	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
 	ProgressLogger progress(points.size() + colors.size() + normals.size() + groups.size());
 
+	std::size_t done = 0;
 	output << "num_points: " << points.size() << std::endl;
-	for (std::size_t i = 0; i < points.size(); ++i) {
-		output << points[i] << " ";
-		progress.next();
-	}
+	write_value_block(output, points, progress, done);
 	output << std::endl;
 
 	output << "num_colors: " << colors.size() << std::endl;
-	for (std::size_t i = 0; i < colors.size(); ++i) {
-		output << colors[i] << " ";
-		progress.next();
-	}
+	write_value_block(output, colors, progress, done);
 	output << std::endl;
 
 	output << "num_normals: " << normals.size() << std::endl;
-	for (std::size_t i = 0; i < normals.size(); ++i) {
-		output << normals[i] << " ";
-		progress.next();
-	}
+	write_value_block(output, normals, progress, done);
 	output << std::endl;
 
 	output << "num_groups: " << groups.size() << std::endl;
@@ -126,7 +238,17 @@ void PointSetSerializer_vg::save_vg(const PointSet* pset, const std::string& fil
 			VertexGroup* chld = children[j];
 			write_ascii_group(output, chld);
 		}
-		progress.next();
+		progress.notify(++done);
+	}
+
+	// the planar qualities, only with the parameters they were computed with
+	const PointSet::QualityParameters& parameters = pset->quality_parameters();
+	if (pset->has_planar_qualities() && parameters.is_valid()) {
+		output << "planar_quality_parameters: " << planar_qualities_version << " " << parameters.sizes[0] << " "
+			<< parameters.sizes[1] << " " << parameters.sizes[2] << " " << parameters.average_spacing << std::endl;
+		output << "num_planar_qualities: " << pset->planar_qualities().size() << std::endl;
+		write_value_block(output, pset->planar_qualities(), progress, done);
+		output << std::endl;
 	}
 }
 
@@ -168,6 +290,156 @@ void PointSetSerializer_vg::write_ascii_group(std::ostream& output, VertexGroup*
 
 
 void PointSetSerializer_vg::load_vg(PointSet* pset, const std::string& file_name) {
+#ifndef TRANSLATE_RELATIVE_TO_FIRST_POINT
+	MappedFile file(file_name);
+	if (file.is_open()) {
+		file.advise_sequential();
+		if (!load_vg(pset, file.data(), file.data() + file.size()))
+			Logger::err("-") << "file \'" << file_name << "\' is corrupted or truncated" << std::endl;
+		return;
+	}
+#endif
+	load_vg_stream(pset, file_name);
+}
+
+
+bool PointSetSerializer_vg::load_vg(PointSet* pset, const char* data, const char* end) {
+	ProgressLogger progress(end - data);
+	const char* p = data;
+
+	if (!read_vec3_block(p, end, pset->points()))
+		return false;
+	progress.notify(p - data);
+
+	std::vector<vec3>& colors = pset->colors();
+	if (!read_vec3_block(p, end, colors))
+		return false;
+	// in case the color values are in [0, 255], converting to [0, 1]
+	parallel_for(colors.size(), [&](std::size_t i) {
+		if (colors[i].x > 1.0f || colors[i].y > 1.0f || colors[i].z > 1.0f)
+			colors[i] /= 255.0f;
+	});
+	progress.notify(p - data);
+
+	if (!read_vec3_block(p, end, pset->normals()))
+		return false;
+	progress.notify(p - data);
+
+	//////////////////////////////////////////////////////////////////////////
+
+	std::size_t num_groups = 0;
+	if (!skip_token(p, end))
+		return true;	// no groups
+	if (!read_integer(p, end, num_groups))
+		return false;
+
+	bool failed = false;
+	for (std::size_t i = 0; i < num_groups; ++i) {
+		VertexGroup::Ptr g = read_ascii_group(p, end, failed);
+		if (failed)
+			return false;
+
+		if (g && !g->empty()) {
+			g->set_point_set(pset);
+			pset->groups().push_back(std::move(g));
+		}
+
+		int num_children = 0;
+		if (!skip_token(p, end) || !read_integer(p, end, num_children))
+			return false;
+		for (int j = 0; j < num_children; ++j) {
+			// not a smart pointer: the parent only keeps a plain pointer to its children
+			VertexGroup* chld = read_ascii_group(p, end, failed);
+			if (failed)
+				return false;
+			if (chld && !chld->empty() && g) {
+				chld->set_point_set(pset);
+				g->add_child(chld);
+			}
+			else
+				delete chld;
+		}
+
+		progress.notify(p - data);
+	}
+
+	// the planar qualities if exist (the blocks of the unknown versions are ignored)
+	const char* q = p;
+	std::string keyword;
+	if (!read_string(q, end, keyword) || keyword != "planar_quality_parameters:")
+		return true;
+	int version = 0;
+	PointSet::QualityParameters parameters;
+	std::size_t num = 0;
+	if (!read_integer(q, end, version) || !read_integer(q, end, parameters.sizes[0]) || !read_integer(q, end, parameters.sizes[1]) ||
+		!read_integer(q, end, parameters.sizes[2]) || !read_float(q, end, parameters.average_spacing) || 
+		!skip_token(q, end) || !read_integer(q, end, num))
+		return false;
+	const char* last = block_end(q, end);
+	if (version == planar_qualities_version && num == pset->num_points()) {
+		std::vector<float>& qualities = pset->planar_qualities();
+		qualities.resize(num);
+		if (num > 0 && !parse_float_block(q, last, qualities.data(), num)) {
+			qualities.clear();
+			return false;
+		}
+		pset->quality_parameters() = parameters;
+	}
+	p = last;
+	return true;
+}
+
+
+VertexGroup* PointSetSerializer_vg::read_ascii_group(const char*& p, const char* end, bool& failed) {
+	int type = 0, num = 0;
+	if (!skip_token(p, end) || !read_integer(p, end, type) || !skip_token(p, end) || !read_integer(p, end, num) || num < 0) {
+		failed = true;
+		return nil;
+	}
+
+	std::vector<float> para(num);
+	bool valid = skip_token(p, end);
+	for (int i = 0; valid && i < num; ++i)
+		valid = read_float(p, end, para[i]);
+
+	std::string label;
+	float r = 0, g = 0, b = 0;
+	std::size_t num_points = 0;
+	valid = valid && skip_token(p, end) && read_string(p, end, label);
+	valid = valid && skip_token(p, end) && read_float(p, end, r) && read_float(p, end, g) && read_float(p, end, b);
+	valid = valid && skip_token(p, end) && read_integer(p, end, num_points);
+	if (!valid) {
+		failed = true;
+		return nil;
+	}
+
+	// the indices in bulk
+	std::vector<unsigned int> indices(num_points);
+	for (std::size_t i = 0; i < num_points; ++i) {
+		if (!read_integer(p, end, indices[i])) {
+			failed = true;
+			return nil;
+		}
+	}
+
+	if (num != 4)
+		return nil;     // bad/unknown data (skipped)
+
+	// in case the color values are in [0, 255], converting to [0, 1]
+	if (r > 1.0f || g > 1.0f || b > 1.0f) {
+		r /= 255.0f; g /= 255.0f; b /= 255.0f;
+	}
+
+	VertexGroup* grp = new VertexGroup;
+	assign_group_parameters(grp, para);
+	grp->swap(indices);
+	grp->set_label(label);
+	grp->set_color(Color(r, g, b));
+	return grp;
+}
+
+
+void PointSetSerializer_vg::load_vg_stream(PointSet* pset, const std::string& file_name) {
 	std::ifstream input(file_name.c_str());
 	if (input.fail()) {
 		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
@@ -242,22 +514,43 @@ void PointSetSerializer_vg::load_vg(PointSet* pset, const std::string& file_name
 
 		if (!g->empty()) {
 			g->set_point_set(pset);
-			pset->groups().push_back(g);
+			pset->groups().push_back(std::move(g));
 		}
 
 		int num_children = 0;
 		input >> dumy >> num_children;
 		for (int j = 0; j<num_children; ++j) {
-			VertexGroup::Ptr chld = read_ascii_group(input);
-			if (!chld->empty()) {
+			// not a smart pointer: the parent only keeps a plain pointer to its children
+			VertexGroup* chld = read_ascii_group(input);
+			if (chld && !chld->empty()) {
 				chld->set_point_set(pset);
 				g->add_child(chld);
 			}
+			else
+				delete chld;
 		}
 
 		std::streamoff pos = input.tellg();
 		progress.notify(pos);
 	}
+
+	// the planar qualities if exist (the blocks of the unknown versions are ignored)
+	if (!(input >> dumy) || dumy != "planar_quality_parameters:")
+		return;
+	int version = 0;
+	PointSet::QualityParameters parameters;
+	input >> version >> parameters.sizes[0] >> parameters.sizes[1] >> parameters.sizes[2] >> parameters.average_spacing;
+	input >> dumy >> num;
+	if (input.fail() || version != planar_qualities_version || num != pset->num_points())
+		return;
+	std::vector<float>& qualities = pset->planar_qualities();
+	qualities.resize(num);
+	for (std::size_t i = 0; i < num; ++i)
+		input >> qualities[i];
+	if (input.fail())
+		qualities.clear();
+	else
+		pset->quality_parameters() = parameters;
 }
 
 
@@ -306,7 +599,201 @@ VertexGroup* PointSetSerializer_vg::read_ascii_group(std::istream& input) {
 }
 
 
+namespace {
+
+	// reads 'bytes' bytes at 'data' (moving it), unless they go beyond 'end'
+	bool read_block(const char*& data, const char* end, void* dst, std::size_t bytes) {
+		if (static_cast<std::size_t>(end - data) < bytes)
+			return false;
+
+		// the large blocks are copied by several threads, each one faulting in its own pages
+		const std::size_t chunk_size = 16 * 1024 * 1024;
+		if (bytes >= 4 * chunk_size) {
+			const char* src = data;
+			char* to = static_cast<char*>(dst);
+			std::size_t num_chunks = (bytes + chunk_size - 1) / chunk_size;
+			parallel_for(num_chunks, [&](std::size_t i) {
+				std::size_t first = i * chunk_size;
+				std::memcpy(to + first, src + first, std::min(chunk_size, bytes - first));
+			});
+		}
+		else if (bytes > 0)
+			std::memcpy(dst, data, bytes);
+
+		data += bytes;
+		return true;
+	}
+
+	template <class T>
+	bool read_value(const char*& data, const char* end, T& value) {
+		return read_block(data, end, &value, sizeof(T));
+	}
+
+	// reads a block of 'num' records (announced by the file, so checked against its size first)
+	template <class T>
+	bool read_array(const char*& data, const char* end, std::vector<T>& v, int num) {
+		if (num < 0 || static_cast<std::size_t>(end - data) / sizeof(T) < static_cast<std::size_t>(num))
+			return false;
+		v.resize(num);
+		return read_block(data, end, v.data(), num * sizeof(T));
+	}
+}
+
+
 void PointSetSerializer_vg::load_bvg(PointSet* pset, const std::string& file_name) {
+	load_bvg(pset, file_name, PointSetIO::PointsCallback());
+}
+
+
+void PointSetSerializer_vg::load_bvg(PointSet* pset, const std::string& file_name, const PointSetIO::PointsCallback& points_read) {
+	MappedFile file(file_name);
+	if (!file.is_open()) {
+		load_bvg_stream(pset, file_name);
+		return;
+	}
+	file.advise_sequential();
+
+	const char* data = file.data();
+	read_bvg(pset, data, data + file.size(), "file \'" + file_name + "\'", points_read);
+}
+
+
+bool PointSetSerializer_vg::read_bvg(PointSet* pset, const char*& data, const char* end, const std::string& name, const PointSetIO::PointsCallback& points_read) {
+	int num = 0;
+	if (!read_value(data, end, num) || num <= 0) {
+		Logger::err("-") << "no point exists in " << name << std::endl;
+		return false;
+	}
+
+	// the points block
+	std::vector<vec3>& points = pset->points();
+	if (!points_read) {
+		if (!read_array(data, end, points, num)) {
+			points.clear();
+			Logger::err("-") << name << " is truncated" << std::endl;
+			return false;
+		}
+	}
+	else {
+		// in chunks (checked against the size of the file first), each one reported once copied
+		if (static_cast<std::size_t>(end - data) / sizeof(vec3) < static_cast<std::size_t>(num)) {
+			Logger::err("-") << name << " is truncated" << std::endl;
+			return false;
+		}
+		points.resize(num);
+		const std::size_t chunk_size = 1 << 20;
+		ProgressLogger progress(points.size());
+		for (std::size_t first = 0; first < points.size(); first += chunk_size) {
+			if (progress.is_canceled()) {
+				points_read(nil, 0, 0);
+				points.clear();
+				Logger::warn("-") << "reading " << name << " canceled" << std::endl;
+				return false;
+			}
+			const std::size_t n = std::min(chunk_size, points.size() - first);
+			read_block(data, end, &points[first], n * sizeof(vec3));
+			points_read(points.data(), first + n, points.size());
+			progress.notify(first + n);
+		}
+	}
+
+	// the colors block if exists
+	if (!read_value(data, end, num)) {
+		Logger::err("-") << name << " is truncated" << std::endl;
+		return false;
+	}
+	if (num > 0) {
+		if (num != points.size()) {
+			Logger::err("-") << "color-point number not match" << std::endl;
+			return false;
+		}
+		if (!read_array(data, end, pset->colors(), num)) {
+			pset->colors().clear();
+			Logger::err("-") << name << " is truncated" << std::endl;
+			return false;
+		}
+	}
+
+	// the normals block if exists
+	if (!read_value(data, end, num)) {
+		Logger::err("-") << name << " is truncated" << std::endl;
+		return false;
+	}
+	if (num > 0) {
+		if (num != points.size()) {
+			Logger::err("-") << "normal-point number not match" << std::endl;
+			return false;
+		}
+		if (!read_array(data, end, pset->normals(), num)) {
+			pset->normals().clear();
+			Logger::err("-") << name << " is truncated" << std::endl;
+			return false;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	int num_groups = 0;
+	if (!read_value(data, end, num_groups))
+		return true;		// no groups
+
+	bool truncated = false;
+	for (int i = 0; i < num_groups && !truncated; ++i) {
+		VertexGroup::Ptr g = read_binary_group(data, end, truncated);
+		if (!g)
+			continue;
+
+		if (!g->empty()) {
+			g->set_point_set(pset);
+			pset->groups().push_back(std::move(g));
+		}
+
+		int num_children = 0;
+		if (!read_value(data, end, num_children)) {
+			truncated = true;
+			break;
+		}
+		for (int j = 0; j < num_children; ++j) {
+			VertexGroup* chld = read_binary_group(data, end, truncated);
+			if (!chld)
+				break;
+			if (!chld->empty()) {
+				chld->set_point_set(pset);
+				g->add_child(chld);
+			}
+			else
+				delete chld;
+		}
+	}
+	if (truncated) {
+		Logger::err("-") << name << " is truncated" << std::endl;
+		return false;
+	}
+
+	// the planar qualities if exist (the blocks of the unknown versions are ignored)
+	const char* q = data;
+	int tag = 0, version = 0;
+	if (!read_value(q, end, tag) || tag != planar_qualities_tag)
+		return true;
+	PointSet::QualityParameters parameters;
+	if (!read_value(q, end, version) || !read_value(q, end, num) || !read_value(q, end, parameters.sizes) || 
+		!read_value(q, end, parameters.average_spacing)) {
+		Logger::err("-") << name << " is truncated" << std::endl;
+		return false;
+	}
+	if (version == planar_qualities_version && num == points.size()) {
+		if (!read_array(q, end, pset->planar_qualities(), num)) {
+			pset->planar_qualities().clear();
+			Logger::err("-") << name << " is truncated" << std::endl;
+			return false;
+		}
+		pset->quality_parameters() = parameters;
+		data = q;
+	}
+	return true;
+}
+
+void PointSetSerializer_vg::load_bvg_stream(PointSet* pset, const std::string& file_name) {
 	std::ifstream input(file_name.c_str(), std::fstream::binary);
 	if (input.fail()) {
 		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
@@ -359,13 +846,16 @@ void PointSetSerializer_vg::load_bvg(PointSet* pset, const std::string& file_nam
 
 		if (!g->empty()) {
 			g->set_point_set(pset);
-			pset->groups().push_back(g);
+			pset->groups().push_back(std::move(g));
 		}
 
 		int num_children = 0;
 		input.read((char*)&num_children, sizeof(int));
 		for (int j = 0; j < num_children; ++j) {
-			VertexGroup::Ptr chld = read_binary_group(input);
+			// not a smart pointer: the parent only keeps a plain pointer to its children
+			VertexGroup* chld = read_binary_group(input);
+			if (!chld)
+				break;
 			if (!chld->empty()) {
 				chld->set_point_set(pset);
 				g->add_child(chld);
@@ -374,6 +864,26 @@ void PointSetSerializer_vg::load_bvg(PointSet* pset, const std::string& file_nam
 				delete chld;
 		}
 	}
+
+	// the planar qualities if exist (the blocks of the unknown versions are ignored)
+	int tag = 0, version = 0;
+	input.read((char*)&tag, sizeof(int));
+	if (input.fail() || tag != planar_qualities_tag)
+		return;
+	PointSet::QualityParameters parameters;
+	input.read((char*)&version, sizeof(int));
+	input.read((char*)&num, sizeof(int));
+	input.read((char*)parameters.sizes, sizeof(parameters.sizes));
+	input.read((char*)&parameters.average_spacing, sizeof(float));
+	if (input.fail() || version != planar_qualities_version || num != points.size())
+		return;
+	std::vector<float>& qualities = pset->planar_qualities();
+	qualities.resize(num);
+	input.read((char*)qualities.data(), num * sizeof(float));
+	if (input.fail())
+		qualities.clear();
+	else
+		pset->quality_parameters() = parameters;
 }
 
 
@@ -384,7 +894,11 @@ void PointSetSerializer_vg::save_bvg(const PointSet* pset, const std::string& fi
 		Logger::err("-") << "could not open file\'" << file_name << "\'" << std::endl;
 		return;
 	}
+	write_bvg(pset, output);
+}
+
 
+bool PointSetSerializer_vg::write_bvg(const PointSet* pset, std::ostream& output) {
 	// write the points block
 	const std::vector<vec3>& points = pset->points();
 	std::size_t num = points.size();
@@ -422,6 +936,18 @@ void PointSetSerializer_vg::save_bvg(const PointSet* pset, const std::string& fi
 			write_binary_group(output, chld);
 		}
 	}
+
+	// the planar qualities, only with the parameters they were computed with
+	const PointSet::QualityParameters& parameters = pset->quality_parameters();
+	if (pset->has_planar_qualities() && parameters.is_valid()) {
+		const std::vector<float>& qualities = pset->planar_qualities();
+		int header[3] = { planar_qualities_tag, planar_qualities_version, static_cast<int>(qualities.size()) };
+		output.write((char*)header, sizeof(header));
+		output.write((char*)parameters.sizes, sizeof(parameters.sizes));
+		output.write((char*)&parameters.average_spacing, sizeof(float));
+		output.write((char*)qualities.data(), qualities.size() * sizeof(float));
+	}
+	return !output.fail();
 }
 
 
@@ -504,6 +1030,48 @@ VertexGroup* PointSetSerializer_vg::read_binary_group(std::istream& input) {
 }
 
 
+VertexGroup* PointSetSerializer_vg::read_binary_group(const char*& data, const char* end, bool& truncated) {
+	int type = 0, num = 0;
+	if (!read_value(data, end, type) || !read_value(data, end, num)) {
+		truncated = true;
+		return nil;
+	}
+	if (num != 4)
+		return nil;     // bad/unknown data
+
+	std::vector<float> para;
+	int num_char = 0;
+	if (!read_array(data, end, para, num) || !read_value(data, end, num_char) || num_char < 0 || end - data < num_char) {
+		truncated = true;
+		return nil;
+	}
+
+	std::string label(data, num_char);
+	std::replace(label.begin(), label.end(), ' ', '-');
+	data += num_char;
+
+	float arr[3];
+	int num_points = 0;
+	if (!read_block(data, end, arr, sizeof(arr)) || !read_value(data, end, num_points)) {
+		truncated = true;
+		return nil;
+	}
+
+	VertexGroup* grp = new VertexGroup;
+	assign_group_parameters(grp, para);
+	grp->set_label(label);
+	grp->set_color(Color(arr));
+
+	// the point indices in bulk
+	if (!read_array(data, end, *grp, num_points)) {
+		delete grp;
+		truncated = true;
+		return nil;
+	}
+	return grp;
+}
+
+
 // for binary file format, no string stuff except labels. we add size info before each label
 void PointSetSerializer_vg::write_binary_group(std::ostream& output, VertexGroup* g) {
 	//int type = g->type();
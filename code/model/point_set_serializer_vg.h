@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define _POINT_SERIALIZER_VERTEX_GROUP_H_
 
 #include "model_common.h"
+#include "point_set_io.h"
 
 
 #include <string>
@@ -39,13 +40,35 @@ public:
 	static void save_vg(const PointSet* pset, const std::string& file_name);
 
 	static void load_bvg(PointSet* pset, const std::string& file_name);
+	// reports the points to 'points_read' as they are copied (see PointSetIO::read())
+	static void load_bvg(PointSet* pset, const std::string& file_name, const PointSetIO::PointsCallback& points_read);
 	static void save_bvg(const PointSet* pset, const std::string& file_name);
 
+	// the content of a .bvg file written to a stream, or parsed from memory (moving 'data' to its end),
+	// e.g., as a part of a larger file. 'name' stands for the source in the messages.
+	static bool write_bvg(const PointSet* pset, std::ostream& output);
+	static bool read_bvg(PointSet* pset, const char*& data, const char* end, const std::string& name, 
+		const PointSetIO::PointsCallback& points_read = PointSetIO::PointsCallback());
+
 private:
 	static VertexGroup* read_ascii_group(std::istream& input);
+	// parses a group from memory, moving 'data' to its end ('failed' is set if the text is invalid
+	// or ends early; nil is also returned for the groups of unknown types)
+	static VertexGroup* read_ascii_group(const char*& data, const char* end, bool& failed);
+
+	// parses the text of a whole file in memory
+	static bool load_vg(PointSet* pset, const char* data, const char* end);
+	// reads the file with streams (when it can't be mapped in memory)
+	static void load_vg_stream(PointSet* pset, const std::string& file_name);
 	static void write_ascii_group(std::ostream& output, VertexGroup* g);
 
 	static VertexGroup* read_binary_group(std::istream& input);
+	// reads a group from memory, moving 'data' to its end (returns nil if the group is bad or if it 
+	// goes beyond 'end')
+	static VertexGroup* read_binary_group(const char*& data, const char* end, bool& truncated);
+
+	// reads the file with streams (when it can't be mapped in memory)
+	static void load_bvg_stream(PointSet* pset, const std::string& file_name);
 	static void write_binary_group(std::ostream& output, VertexGroup* g);
 
 	// string are stored as array of chars in binary file
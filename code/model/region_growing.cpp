@@ -0,0 +1,256 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "region_growing.h"
+#include "point_set.h"
+#include "point_set_normals.h"
+#include "point_search.h"
+#include "../math/principal_axes.h"
+#include "../basic/logger.h"
+#include "../basic/parallel.h"
+#include "../basic/progress.h"
+#include "../basic/stop_watch.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+
+
+namespace {
+
+	const std::size_t chunk_size = 65536;
+
+	struct Region {
+		std::size_t					rank;		// of its seed, in the order of the planar qualities
+		std::vector<unsigned int>	points;
+		vec3						normal;		// its plane, as dot(normal, p) + d = 0
+		float						d;
+		vec3						center;
+		int							label;		// in the array of labels
+	};
+
+
+	unsigned int find_root(std::vector<unsigned int>& parent, unsigned int i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+}
+
+
+std::size_t RegionGrowing::segment(PointSet* pset, const Parameters& params, unsigned int num_threads) {
+	const std::vector<vec3>& points = pset->points();
+	std::size_t n = points.size();
+	if (n < 3) {
+		Logger::warn("-") << "too few points for growing regions" << std::endl;
+		return 0;
+	}
+
+	StopWatch w;
+	Logger::out("-") << "growing regions..." << std::endl;
+
+	// the normals, the planar qualities, and the graph of the nearest neighbors, in one pass
+	PointSearch_var search = pset->point_search(PointSearch::AUTO, num_threads);	// shared with the later stages
+	const unsigned int sizes[3] = { 6, 16, 25 };	// as the point confidences of the hypothesis generator
+	const unsigned int k = ogf_max(params.num_neighbors, 1u);
+	std::vector<unsigned int> graph;
+	std::vector<float>& qualities = pset->planar_qualities();
+	float spacing = PointSetNormals::estimate(points, search, sizes, qualities, pset->has_normals() ? nil : &pset->normals(), &graph, k, num_threads);
+	search.forget();
+	const std::vector<vec3>& normals = pset->normals();
+
+	float epsilon = params.epsilon;
+	if (epsilon <= 0.0f)
+		epsilon = 2.0f * spacing;
+	if (epsilon <= 0.0f)
+		epsilon = static_cast<float>(0.02 * pset->bbox().radius());	// 1% of the diagonal
+	std::size_t min_points = params.min_points;
+	if (min_points == 0)
+		min_points = ogf_max<std::size_t>(n / 1000, 10);
+	const float threshold = params.normal_threshold;
+
+	// the seeds, in decreasing planar quality
+	std::vector<unsigned int> order(n);
+	for (std::size_t i = 0; i < n; ++i)
+		order[i] = static_cast<unsigned int>(i);
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return qualities[a] > qualities[b] || (qualities[a] == qualities[b] && a < b);
+	});
+
+	// the region of each point (-1 if none). Each thread takes the next seed that remains and grows 
+	// its region, claiming the points by compare-and-swap.
+	std::unique_ptr< std::atomic<int>[] > labels(new std::atomic<int>[n]);
+	for (std::size_t i = 0; i < n; ++i)
+		labels[i].store(-1, std::memory_order_relaxed);
+	std::atomic<std::size_t> next_seed(0);
+	std::atomic<int> next_label(0);
+
+	unsigned int threads = parallel_num_threads(num_threads);
+	std::vector< std::vector<Region> > thread_regions(threads);
+	parallel_for(threads, [&](std::size_t t) {
+		std::vector<Region>& regions = thread_regions[t];
+		std::size_t rank;
+		while ((rank = next_seed.fetch_add(1, std::memory_order_relaxed)) < n) {
+			unsigned int s = order[rank];
+			if (labels[s].load(std::memory_order_relaxed) != -1 || qualities[s] <= 0.0f)
+				continue;
+			int label = next_label.fetch_add(1, std::memory_order_relaxed);
+			int expected = -1;
+			if (!labels[s].compare_exchange_strong(expected, label, std::memory_order_relaxed))
+				continue;
+
+			Region region;
+			region.rank = rank;
+			region.points.push_back(s);
+			region.normal = normals[s];
+			region.d = -dot(region.normal, points[s]);
+			PrincipalAxes3d pca;
+			pca.begin();
+			pca.add_point(points[s]);
+			std::size_t refit_size = 16;	// refitted each time the region doubles
+
+			for (std::size_t j = 0; j < region.points.size(); ++j) {
+				const unsigned int* neighbors = &graph[std::size_t(region.points[j]) * k];
+				for (unsigned int m = 0; m < k && neighbors[m] != PointSearch::invalid_index; ++m) {
+					unsigned int i = neighbors[m];
+					if (labels[i].load(std::memory_order_relaxed) != -1)
+						continue;
+					if (std::fabs(dot(region.normal, points[i]) + region.d) > epsilon || std::fabs(dot(region.normal, normals[i])) < threshold)
+						continue;
+					expected = -1;
+					if (!labels[i].compare_exchange_strong(expected, label, std::memory_order_relaxed))
+						continue;
+					region.points.push_back(i);
+					pca.add_point(points[i]);
+					if (region.points.size() == refit_size) {
+						PrincipalAxes3d fitted = pca;
+						fitted.end();
+						region.normal = fitted.axis(2);	// eigen vectors have been normalized
+						region.d = -dot(region.normal, fitted.center());
+						refit_size *= 2;
+					}
+				}
+			}
+
+			if (region.points.size() < min_points) {	// the points are released for the other seeds
+				for (std::size_t j = 0; j < region.points.size(); ++j)
+					labels[region.points[j]].store(-1, std::memory_order_relaxed);
+				continue;
+			}
+			pca.end();
+			region.normal = pca.axis(2);
+			region.center = pca.center();
+			region.d = -dot(region.normal, region.center);
+			region.label = label;
+			regions.push_back(std::move(region));
+		}
+	}, nil, threads);
+
+	// the regions in the order of their seeds
+	std::vector<Region> regions;
+	for (std::size_t t = 0; t < threads; ++t) {
+		for (std::size_t j = 0; j < thread_regions[t].size(); ++j)
+			regions.push_back(std::move(thread_regions[t][j]));
+	}
+	std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.rank < b.rank; });
+	std::vector<int> region_of(next_label.load(), -1);
+	for (std::size_t r = 0; r < regions.size(); ++r)
+		region_of[regions[r].label] = static_cast<int>(r);
+
+	// the pairs of adjacent regions, from the edges of the graph
+	std::size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+	std::vector< std::vector< std::pair<unsigned int, unsigned int> > > chunk_pairs(num_chunks);
+	parallel_for(num_chunks, [&](std::size_t c) {
+		std::vector< std::pair<unsigned int, unsigned int> >& pairs = chunk_pairs[c];
+		std::size_t last = ogf_min(n, (c + 1) * chunk_size);
+		for (std::size_t i = c * chunk_size; i < last; ++i) {
+			int a = labels[i].load(std::memory_order_relaxed);
+			if (a == -1)
+				continue;
+			const unsigned int* neighbors = &graph[i * k];
+			for (unsigned int m = 0; m < k && neighbors[m] != PointSearch::invalid_index; ++m) {
+				int b = labels[neighbors[m]].load(std::memory_order_relaxed);
+				if (b == -1 || b == a)
+					continue;
+				unsigned int ra = region_of[a], rb = region_of[b];
+				pairs.push_back(std::make_pair(ogf_min(ra, rb), ogf_max(ra, rb)));
+			}
+			if (pairs.size() > 4096) {	// most pairs come many times
+				std::sort(pairs.begin(), pairs.end());
+				pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+			}
+		}
+	}, nil, threads);
+	std::vector< std::pair<unsigned int, unsigned int> > pairs;
+	for (std::size_t c = 0; c < num_chunks; ++c)
+		pairs.insert(pairs.end(), chunk_pairs[c].begin(), chunk_pairs[c].end());
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+	// the adjacent regions of the same plane are merged (into the one of the first seed)
+	std::vector<unsigned int> parent(regions.size());
+	for (std::size_t r = 0; r < regions.size(); ++r)
+		parent[r] = static_cast<unsigned int>(r);
+	for (std::size_t j = 0; j < pairs.size(); ++j) {
+		const Region& a = regions[pairs[j].first];
+		const Region& b = regions[pairs[j].second];
+		if (std::fabs(dot(a.normal, b.normal)) < threshold ||
+			std::fabs(dot(a.normal, b.center) + a.d) > epsilon ||
+			std::fabs(dot(b.normal, a.center) + b.d) > epsilon)
+			continue;
+		unsigned int ra = find_root(parent, pairs[j].first);
+		unsigned int rb = find_root(parent, pairs[j].second);
+		if (ra != rb)
+			parent[ogf_max(ra, rb)] = ogf_min(ra, rb);
+	}
+
+	std::vector<int> group_of(regions.size(), -1);
+	std::vector<VertexGroup::Ptr> groups;
+	for (std::size_t r = 0; r < regions.size(); ++r) {
+		unsigned int root = find_root(parent, static_cast<unsigned int>(r));
+		if (group_of[root] == -1) {
+			group_of[root] = static_cast<int>(groups.size());
+			VertexGroup* g = new VertexGroup(pset);
+			std::ostringstream name;
+			name << "segment_" << groups.size();
+			g->set_label(name.str());
+			g->set_color(random_color());
+			groups.push_back(g);
+		}
+		VertexGroup* g = groups[group_of[root]];
+		g->insert(g->end(), regions[r].points.begin(), regions[r].points.end());
+	}
+
+	// each group is fitted by one thread
+	parallel_for(groups.size(), [&](std::size_t i) {
+		pset->fit_plane(groups[i]);
+	}, nil, threads);
+
+	std::size_t num_points = 0;
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		num_points += groups[i]->size();
+	pset->groups() = groups;
+	Logger::out("-") << groups.size() << " regions (" << num_points << " of " << n << " points, " << regions.size() - groups.size()
+		<< " merged). " << w.elapsed() << " sec." << std::endl;
+	return groups.size();
+}
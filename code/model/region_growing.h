@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _REGION_GROWING_H_
+#define _REGION_GROWING_H_
+
+#include "model_common.h"
+
+#include <cstddef>
+
+
+class PointSet;
+
+/**
+* Segmentation of a point set into planar regions by region growing, for the noisy point clouds 
+* (e.g., airborne scans) RANSAC tends to cut across (see PlaneDetector).
+* The normals (if the point set has none) and the planar qualities of the points are estimated in
+* a single pass of K nearest neighbor queries (see PointSetNormals), which also gives the graph of
+* the nearest neighbors the regions grow in. The regions are seeded in decreasing planar quality, 
+* and grown by several threads at the same time, which claim the points with atomic operations on a
+* shared array of labels. A region accepts the neighbors close to its plane (refitted as it grows)
+* with a similar normal. The adjacent regions of the same plane (e.g., two seeds of a wall grown by 
+* different threads) are merged at the end.
+* With several threads, the points where two regions meet go to the one reaching them first, so the
+* boundaries of the segments may change a little from one run to another.
+*/
+
+class MODEL_API RegionGrowing
+{
+public:
+	struct Parameters {
+		Parameters()
+			: epsilon(0.0f)
+			, normal_threshold(0.9f)
+			, num_neighbors(12)
+			, min_points(0)
+		{}
+
+		float			epsilon;			// max distance of the points to the plane of their region (0: twice the average spacing)
+		float			normal_threshold;	// min |cos| of the angle between the normals of the points and their plane
+		unsigned int	num_neighbors;		// the neighbors a region grows to from each point
+		unsigned int	min_points;			// min number of points of a region (0: 0.1% of the points, at least 10)
+	};
+
+	// Replaces the groups of 'pset' by the regions, with their planes (ready for refining, see 
+	// HypothesisGenerator::refine_planes()), the points of the smaller regions being left out. It 
+	// also sets the planar qualities of the points, and their normals if they have none. Returns the
+	// number of regions.
+	static std::size_t segment(PointSet* pset, const Parameters& params = Parameters(), unsigned int num_threads = 0);
+};
+
+#endif
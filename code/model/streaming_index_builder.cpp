@@ -0,0 +1,142 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "streaming_index_builder.h"
+#include "../basic/logger.h"
+#include "../basic/stop_watch.h"
+#include "../basic/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+StreamingIndexBuilder::StreamingIndexBuilder(PointSearch::Backend backend /* = PointSearch::AUTO */, double cell_size /* = 0 */, unsigned int num_threads /* = 0 */)
+: backend_(backend)
+, user_cell_size_(cell_size)
+, num_threads_(num_threads)
+, cell_size_(0.0)
+, num_added_(0)
+, total_(0)
+, failed_(backend == PointSearch::KD_TREE)
+, average_spacing_(0.0)
+{
+}
+
+
+StreamingIndexBuilder::~StreamingIndexBuilder() {
+	tasks_.wait();
+}
+
+
+PointSetIO::PointsCallback StreamingIndexBuilder::callback() {
+	return [this](const vec3* points, std::size_t num, std::size_t total) { add(points, num, total); };
+}
+
+
+void StreamingIndexBuilder::add(const vec3* points, std::size_t num, std::size_t total) {
+	if (points == nil) {
+		// the points become invalid when the call returns
+		failed_ = true;
+		tasks_.cancel();
+		tasks_.wait();
+		return;
+	}
+	if (failed_ || num <= num_added_)
+		return;
+
+	if (num_added_ == 0) {
+		cell_size_ = GridSearch::chunk_cell_size(points, num, user_cell_size_);
+		anchor_ = points[0];
+		total_ = total;
+	}
+
+	chunks_.push_back(Chunk());
+	Chunk* chunk = &chunks_.back();
+	chunk->first = num_added_;
+	chunk->size = num - num_added_;
+	num_added_ = num;
+	tasks_.run([this, chunk, points]() { sort_chunk(chunk, points); });
+}
+
+
+void StreamingIndexBuilder::sort_chunk(Chunk* chunk, const vec3* points) {
+	if (failed_)
+		return;
+	const vec3* first = points + chunk->first;
+	for (std::size_t i = 0; i < chunk->size; ++i)
+		chunk->box.add_point(first[i]);
+	if (!GridSearch::chunk_keys(first, chunk->first, chunk->size, cell_size_, anchor_, chunk->keys))
+		failed_ = true;
+}
+
+
+PointSearch* StreamingIndexBuilder::finish(const std::vector<vec3>& points) {
+	tasks_.wait();
+	if (failed_ || points.empty() || num_added_ != points.size() || total_ != points.size()) {
+		chunks_.clear();
+		return nil;
+	}
+
+	StopWatch w;
+	bbox_ = Box3d();
+	for (std::size_t i = 0; i < chunks_.size(); ++i)
+		bbox_.add_box(chunks_[i].box);
+
+	// the sorted chunks are merged by pairs (each round in parallel)
+	const std::size_t num_chunks = chunks_.size();
+	std::vector<GridSearch::Keys> runs(num_chunks);
+	for (std::size_t i = 0; i < chunks_.size(); ++i)
+		runs[i].swap(chunks_[i].keys);
+	chunks_.clear();
+	while (runs.size() > 1) {
+		std::vector<GridSearch::Keys> merged((runs.size() + 1) / 2);
+		TaskGroup group;
+		for (std::size_t i = 0; i < merged.size(); ++i) {
+			group.run([&runs, &merged, i]() {
+				if (2 * i + 1 == runs.size()) {
+					merged[i].swap(runs[2 * i]);
+					return;
+				}
+				const GridSearch::Keys& a = runs[2 * i];
+				const GridSearch::Keys& b = runs[2 * i + 1];
+				merged[i].resize(a.size() + b.size());
+				std::merge(a.begin(), a.end(), b.begin(), b.end(), merged[i].begin());
+				GridSearch::Keys().swap(runs[2 * i]);
+				GridSearch::Keys().swap(runs[2 * i + 1]);
+			});
+		}
+		group.wait();
+		runs.swap(merged);
+	}
+
+	GridSearch* grid = new GridSearch(cell_size_);
+	if (!grid->build_from_chunks(points, cell_size_, anchor_, runs[0]) ||
+		(backend_ == PointSearch::AUTO && !PointSearch::auto_chooses_grid(points.size(), grid->occupancy_variation()))) 
+	{
+		delete grid;
+		return nil;
+	}
+
+	// the points of an occupied cell on a surface are spread over about a square cell
+	average_spacing_ = grid->cell_size() * std::sqrt(double(grid->num_occupied_cells()) / points.size());
+	Profiler::add_counter("index chunks merged", double(num_chunks));
+	Logger::out("-") << "point index built while reading (" << grid->num_occupied_cells() << " cells). merged in " 
+		<< w.elapsed() << " sec." << std::endl;
+	return grid;
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _MODEL_STREAMING_INDEX_BUILDER_H_
+#define _MODEL_STREAMING_INDEX_BUILDER_H_
+
+#include "model_common.h"
+#include "point_search.h"
+#include "point_set_io.h"
+#include "grid_search.h"
+#include "../math/math_types.h"
+#include "../basic/thread_pool.h"
+
+#include <deque>
+#include <atomic>
+
+
+// Builds the spatial index of the points while they are read (see PointSetIO::read() with a callback),
+// instead of after: each chunk of points read is handed to a task of the pool, which sorts its cells
+// and measures its bounding box, and finish() merges the chunks. Only the grid is built by chunks (a 
+// kd-tree splits all the points at once), with the cell size chosen from the first chunk.
+// Example:
+//   StreamingIndexBuilder builder(PointSearch::AUTO);
+//   PointSet* pset = PointSetIO::read(file_name, builder.callback());
+//   PointSearch_var search = pset ? builder.finish(pset->points()) : nil;
+//   if (!search)	// not built while reading (e.g., a kd-tree)
+//       search = PointSearch::create(pset->points());
+// The points must not change until finish().
+class MODEL_API StreamingIndexBuilder
+{
+public:
+	// 'backend' as for PointSearch::create() (nothing is built for a kd-tree), 'cell_size' as for 
+	// GridSearch (0 means chosen from the first chunk), and up to 'num_threads' threads for the merging
+	StreamingIndexBuilder(PointSearch::Backend backend = PointSearch::AUTO, double cell_size = 0, unsigned int num_threads = 0);
+	~StreamingIndexBuilder();	// waits for the chunks
+
+	// the callback of the read, which calls add()
+	PointSetIO::PointsCallback callback();
+
+	// the first 'num' of the 'total' points are read: the ones not added yet are a new chunk
+	void add(const vec3* points, std::size_t num, std::size_t total);
+
+	// Waits for the chunks and returns the index of the 'points' read (the same as PointSearch::create()
+	// would choose, except for the cell size of the grid), or nil if it was not built while reading 
+	// (a kd-tree, no points, the read failed or the points span too many cells).
+	PointSearch* finish(const std::vector<vec3>& points);
+
+	// of the points read (after finish())
+	const Box3d& bbox() const { return bbox_; }
+	// estimated from the cells, as for points on surfaces (0 if no grid was built)
+	double average_spacing() const { return average_spacing_; }
+
+private:
+	struct Chunk {
+		std::size_t			first;
+		std::size_t			size;
+		GridSearch::Keys	keys;
+		Box3d				box;
+	};
+
+	void sort_chunk(Chunk* chunk, const vec3* points);
+
+private:
+	PointSearch::Backend	backend_;
+	double					user_cell_size_;
+	unsigned int			num_threads_;
+
+	double					cell_size_;		// chosen with the first chunk
+	vec3					anchor_;
+	std::size_t				num_added_;
+	std::size_t				total_;
+	std::atomic<bool>		failed_;
+	std::deque<Chunk>		chunks_;		// stable for the tasks
+	TaskGroup				tasks_;
+
+	Box3d					bbox_;
+	double					average_spacing_;
+};
+
+#endif
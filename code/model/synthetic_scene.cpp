@@ -0,0 +1,262 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "synthetic_scene.h"
+#include "point_set.h"
+#include "vertex_group.h"
+#include "../basic/logger.h"
+#include "../basic/color.h"
+#include "../math/math_types.h"
+
+#include <random>
+#include <sstream>
+#include <cmath>
+
+
+namespace {
+
+	// a convex face, with its vertices in counterclockwise order (seen from outside)
+	struct Face {
+		std::vector<vec3>	polygon;
+		vec3				normal;
+		double				area;
+		std::string			label;
+	};
+
+	// the footprint of a building (counterclockwise, seen from above)
+	struct Footprint {
+		vec2 corners[4];
+
+		bool contains(const vec2& p) const {
+			for (int i = 0; i < 4; ++i) {
+				const vec2 e = corners[(i + 1) % 4] - corners[i];
+				const vec2 d = p - corners[i];
+				if (e.x * d.y - e.y * d.x < 0.0f)
+					return false;
+			}
+			return true;
+		}
+	};
+
+	const float cell_size = 40.0f;	// of the grid of the buildings (larger than their rotated footprints)
+
+
+	void add_face(std::vector<Face>& faces, const std::vector<vec3>& polygon, const std::string& label) {
+		Face f;
+		f.polygon = polygon;
+		f.label = label;
+		vec3 n(0, 0, 0);
+		for (std::size_t i = 1; i + 1 < polygon.size(); ++i)
+			n = n + cross(polygon[i] - polygon[0], polygon[i + 1] - polygon[0]);
+		f.area = 0.5 * n.length();
+		f.normal = normalize(n);
+		faces.push_back(f);
+	}
+
+
+	// the visible faces (i.e., not the bottom) of a building
+	void add_building(std::vector<Face>& faces, const Footprint& footprint, float height, bool gable, float roof_height, std::size_t index) {
+		vec3 base[4], top[4];
+		for (int i = 0; i < 4; ++i) {
+			base[i] = vec3(footprint.corners[i].x, footprint.corners[i].y, 0.0f);
+			top[i] = vec3(footprint.corners[i].x, footprint.corners[i].y, height);
+		}
+
+		std::ostringstream name;
+		name << "building_" << index << "_";
+		const std::string prefix = name.str();
+
+		// the ridge of a gable roof is parallel to the edges 0-1 and 2-3, above the middle of the others
+		const vec3 up(0, 0, height + roof_height);
+		const vec3 ridge_a = (base[3] + base[0]) * 0.5f + up;
+		const vec3 ridge_b = (base[1] + base[2]) * 0.5f + up;
+
+		std::vector<vec3> polygon;
+		for (int i = 0; i < 4; ++i) {
+			int j = (i + 1) % 4;
+			polygon.clear();
+			polygon.push_back(base[i]);
+			polygon.push_back(base[j]);
+			polygon.push_back(top[j]);
+			if (gable && i == 1)
+				polygon.push_back(ridge_b);
+			else if (gable && i == 3)
+				polygon.push_back(ridge_a);
+			polygon.push_back(top[i]);
+			std::ostringstream wall;
+			wall << prefix << "wall_" << i;
+			add_face(faces, polygon, wall.str());
+		}
+
+		if (gable) {
+			polygon.clear();
+			polygon.push_back(top[0]);	polygon.push_back(top[1]);	polygon.push_back(ridge_b);	polygon.push_back(ridge_a);
+			add_face(faces, polygon, prefix + "roof_0");
+			polygon.clear();
+			polygon.push_back(top[2]);	polygon.push_back(top[3]);	polygon.push_back(ridge_a);	polygon.push_back(ridge_b);
+			add_face(faces, polygon, prefix + "roof_1");
+		}
+		else {
+			polygon.assign(top, top + 4);
+			add_face(faces, polygon, prefix + "roof");
+		}
+	}
+
+
+	struct Hole {
+		vec3  center;
+		float radius;
+	};
+
+}
+
+
+PointSet* SyntheticScene::generate(const Parameters& params) {
+	std::mt19937 random(params.seed);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	auto uniform_in = [&](float a, float b) { return a + (b - a) * uniform(random); };
+
+	// the buildings, until there are enough planes
+	std::vector<Footprint> footprints;
+	std::vector<float> heights, roof_heights;
+	std::vector<bool> gables;
+	std::size_t num_planes = params.ground ? 1 : 0;
+	while (footprints.empty() || num_planes < params.num_planes) {
+		const float w = uniform_in(8.0f, 20.0f);
+		const float d = uniform_in(8.0f, 20.0f);
+		const float angle = params.rotate ? uniform_in(0.0f, 1.5707963f) : 0.0f;
+		const float c = std::cos(angle), s = std::sin(angle);
+		const vec2 local[4] = { vec2(-w, -d), vec2(w, -d), vec2(w, d), vec2(-w, d) };
+
+		// the buildings fill the grid row by row (the number of columns is fixed afterwards)
+		Footprint f;
+		for (int i = 0; i < 4; ++i)
+			f.corners[i] = vec2(0.5f * (c * local[i].x - s * local[i].y), 0.5f * (s * local[i].x + c * local[i].y));
+		footprints.push_back(f);
+		heights.push_back(uniform_in(5.0f, 30.0f));
+		gables.push_back(uniform(random) < params.gable_ratio);
+		roof_heights.push_back(gables.back() ? uniform_in(2.0f, 6.0f) : 0.0f);
+		num_planes += gables.back() ? 6 : 5;
+	}
+
+	const std::size_t num_buildings = footprints.size();
+	const std::size_t num_columns = static_cast<std::size_t>(std::ceil(std::sqrt(double(num_buildings))));
+	const std::size_t num_rows = (num_buildings + num_columns - 1) / num_columns;
+	std::vector<Face> faces;
+	for (std::size_t i = 0; i < num_buildings; ++i) {
+		const vec2 center((i % num_columns + 0.5f) * cell_size, (i / num_columns + 0.5f) * cell_size);
+		for (int j = 0; j < 4; ++j)
+			footprints[i].corners[j] = footprints[i].corners[j] + center;
+		add_building(faces, footprints[i], heights[i], gables[i], roof_heights[i], i);
+	}
+	const float width = num_columns * cell_size;
+	const float depth = num_rows * cell_size;
+	if (params.ground) {
+		std::vector<vec3> polygon;
+		polygon.push_back(vec3(0, 0, 0));	polygon.push_back(vec3(width, 0, 0));
+		polygon.push_back(vec3(width, depth, 0));	polygon.push_back(vec3(0, depth, 0));
+		add_face(faces, polygon, "ground");
+	}
+
+	// the density is given by the number of points on all the faces (without the holes)
+	double total_area = 0.0;
+	for (std::size_t i = 0; i < faces.size(); ++i)
+		total_area += faces[i].area;
+	const double density = params.num_points / total_area;
+
+	PointSet* pset = new PointSet;
+	std::vector<vec3>& points = pset->points();
+	std::vector<vec3>& normals = pset->normals();
+	const std::size_t num_outliers = static_cast<std::size_t>(params.num_points * params.outlier_ratio);
+	points.reserve(params.num_points + num_outliers);
+	normals.reserve(params.num_points + num_outliers);
+
+	std::normal_distribution<float> noise(0.0f, params.noise);
+	const float missing_ratio = std::min(std::max(params.missing_ratio, 0.0f), 0.99f);
+	for (std::size_t i = 0; i < faces.size(); ++i) {
+		const Face& f = faces[i];
+
+		// the triangles of the fan of the face, sampled in proportion to their areas
+		std::vector<double> triangle_areas;
+		for (std::size_t j = 1; j + 1 < f.polygon.size(); ++j)
+			triangle_areas.push_back(0.5 * length(cross(f.polygon[j] - f.polygon[0], f.polygon[j + 1] - f.polygon[0])));
+		std::discrete_distribution<std::size_t> triangle(triangle_areas.begin(), triangle_areas.end());
+		auto sample = [&]() -> vec3 {
+			const std::size_t t = triangle(random);
+			const float r = std::sqrt(uniform(random));
+			const float v = uniform(random);
+			return f.polygon[0] * (1.0f - r) + f.polygon[t + 1] * (r * (1.0f - v)) + f.polygon[t + 2] * (r * v);
+		};
+
+		// a few holes of the total area of the missing part (ignoring their overlaps)
+		std::vector<Hole> holes;
+		if (missing_ratio > 0.0f) {
+			const int num_holes = 1 + static_cast<int>(uniform(random) * 3.0f) % 3;
+			const float radius = static_cast<float>(std::sqrt(missing_ratio * f.area / (num_holes * 3.14159265)));
+			for (int j = 0; j < num_holes; ++j) {
+				Hole h;
+				h.center = sample();
+				h.radius = radius;
+				holes.push_back(h);
+			}
+		}
+
+		// the points of the ground are not under the buildings
+		const bool is_ground = params.ground && i + 1 == faces.size();
+
+		const double expected = density * f.area;
+		const std::size_t num = static_cast<std::size_t>(expected) + ((uniform(random) < expected - std::floor(expected)) ? 1 : 0);
+		VertexGroup* g = new VertexGroup(pset);
+		g->set_label(f.label);
+		g->set_color(Color(uniform_in(0.3f, 1.0f), uniform_in(0.3f, 1.0f), uniform_in(0.3f, 1.0f)));
+		g->set_plane(Plane3d(f.polygon[0], f.normal));
+		for (std::size_t j = 0; j < num; ++j) {
+			const vec3 p = sample();
+			bool missing = false;
+			for (std::size_t k = 0; k < holes.size() && !missing; ++k)
+				missing = distance2(p, holes[k].center) < holes[k].radius * holes[k].radius;
+			if (!missing && is_ground) {
+				const std::size_t col = std::min(static_cast<std::size_t>(p.x / cell_size), num_columns - 1);
+				const std::size_t row = std::min(static_cast<std::size_t>(p.y / cell_size), num_rows - 1);
+				const std::size_t b = row * num_columns + col;
+				missing = (b < num_buildings && footprints[b].contains(vec2(p.x, p.y)));
+			}
+			if (missing)
+				continue;
+			g->push_back(static_cast<unsigned int>(points.size()));
+			points.push_back(p + f.normal * noise(random));
+			normals.push_back(f.normal);
+		}
+		pset->groups().push_back(g);
+	}
+
+	// the outliers are anywhere in the bounding box of the scene, with random normals
+	float max_height = 0.0f;
+	for (std::size_t i = 0; i < num_buildings; ++i)
+		max_height = std::max(max_height, heights[i] + roof_heights[i]);
+	for (std::size_t i = 0; i < num_outliers; ++i) {
+		points.push_back(vec3(uniform_in(0.0f, width), uniform_in(0.0f, depth), uniform_in(0.0f, 1.2f * max_height)));
+		vec3 n(uniform_in(-1.0f, 1.0f), uniform_in(-1.0f, 1.0f), uniform_in(-1.0f, 1.0f));
+		normals.push_back(normalize(n + vec3(0, 0, 1e-6f)));
+	}
+
+	Logger::out("-") << "synthetic scene: " << num_buildings << " buildings, " << pset->groups().size() << " planes, "
+		<< points.size() << " points (" << num_outliers << " outliers)" << std::endl;
+	return pset;
+}
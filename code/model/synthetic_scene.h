@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _SYNTHETIC_SCENE_H_
+#define _SYNTHETIC_SCENE_H_
+
+#include "model_common.h"
+#include "../basic/basic_types.h"
+
+#include <cstddef>
+
+
+class PointSet;
+
+/**
+* Parametric scenes of buildings for the scaling experiments: the buildings (boxes with a flat or a
+* gable roof, with random sizes and orientations) stand on a grid, optionally on the ground. Their
+* visible faces are sampled uniformly with a noise along the normals, some holes (missing data), and
+* some outliers in the bounding box of the scene. Each face is a segment (a group with its exact
+* plane), the outliers belong to no segment.
+* The scene only depends on the parameters (including the seed of the random numbers).
+*/
+
+class MODEL_API SyntheticScene
+{
+public:
+	struct Parameters {
+		Parameters()
+			: num_planes(50)
+			, num_points(1000000)
+			, noise(0.02f)
+			, outlier_ratio(0.0f)
+			, missing_ratio(0.0f)
+			, gable_ratio(0.5f)
+			, ground(true)
+			, rotate(true)
+			, seed(0)
+		{}
+
+		std::size_t		num_planes;		// the buildings are added until the scene has this number of planes (5 per flat roof building, 6 per gable one, 1 for the ground)
+		std::size_t		num_points;		// on the faces before the holes are cut (i.e., sets the density), excluding the outliers
+		float			noise;			// standard deviation of the distances of the points to their faces (the buildings are 5 to 30 high)
+		float			outlier_ratio;	// the number of outliers, relative to 'num_points'
+		float			missing_ratio;	// the part of the area of each face without points (in [0, 1))
+		float			gable_ratio;	// the probability of a building to have a gable roof
+		bool			ground;			// if the ground around the buildings is sampled
+		bool			rotate;			// if the buildings have random orientations (about the vertical axis)
+		unsigned int	seed;			// of the random numbers
+	};
+
+	// Returns the point set (with normals and groups) of a scene.
+	static PointSet* generate(const Parameters& params = Parameters());
+};
+
+#endif
@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "triangle_tree.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// the squared distance of p to a box
+	inline float sqr_distance_to_box(const vec3& p, const float* box_min, const float* box_max) {
+		float result = 0.0f;
+		for (int i = 0; i < 3; ++i) {
+			const float d = std::max(std::max(box_min[i] - p[i], p[i] - box_max[i]), 0.0f);
+			result += d * d;
+		}
+		return result;
+	}
+
+	inline float clamp01(float x) { return std::min(std::max(x, 0.0f), 1.0f); }
+
+}
+
+
+TriangleTree::TriangleTree(const Map* mesh) : num_facets_(0) {
+	std::unordered_map<const Map::Vertex*, unsigned int> vertex_index;
+	vertex_index.reserve(mesh->size_of_vertices());
+	unsigned int v = 0;
+	FOR_EACH_VERTEX_CONST(Map, mesh, it)
+		vertex_index[it] = v++;
+
+	// the fans of the facets
+	unsigned int index = 0;
+	FOR_EACH_FACET_CONST(Map, mesh, it) {
+		const Map::Halfedge* first = it->halfedge();
+		const vec3& p = first->vertex()->point();
+		for (const Map::Halfedge* h = first->next(); h->next() != first; h = h->next()) {
+			const vec3& q = h->vertex()->point();
+			const vec3& r = h->next()->vertex()->point();
+			corners_.push_back(p);
+			corners_.push_back(q);
+			corners_.push_back(r);
+			vertices_.push_back(vertex_index[first->vertex()]);
+			vertices_.push_back(vertex_index[h->vertex()]);
+			vertices_.push_back(vertex_index[h->next()->vertex()]);
+			facets_.push_back(index);
+			areas_.push_back(0.5f * length(cross(q - p, r - p)));
+		}
+		++index;
+	}
+	num_facets_ = index;
+
+	if (facets_.empty())
+		return;
+	std::vector<unsigned int> order(facets_.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = static_cast<unsigned int>(i);
+	nodes_.reserve(2 * facets_.size() / block_size + 1);
+	block_of_.resize(facets_.size());
+	build(order, 0, order.size());
+}
+
+
+unsigned int TriangleTree::build(std::vector<unsigned int>& order, std::size_t begin, std::size_t end) {
+	const std::vector<vec3>& corners = corners_;
+	Node node;
+	for (int i = 0; i < 3; ++i) {
+		node.box_min[i] = 1e30f;
+		node.box_max[i] = -1e30f;
+	}
+	for (std::size_t k = begin; k < end; ++k) {
+		for (int c = 0; c < 3; ++c) {
+			const vec3& p = corners[3 * order[k] + c];
+			for (int i = 0; i < 3; ++i) {
+				node.box_min[i] = std::min(node.box_min[i], p[i]);
+				node.box_max[i] = std::max(node.box_max[i], p[i]);
+			}
+		}
+	}
+
+	const unsigned int index = static_cast<unsigned int>(nodes_.size());
+	nodes_.push_back(node);
+
+	if (end - begin <= block_size) {
+		nodes_[index].is_leaf = true;
+		nodes_[index].begin = static_cast<unsigned int>(blocks_.size());
+		add_block(&order[begin], end - begin);
+		nodes_[index].end = static_cast<unsigned int>(blocks_.size());
+		return index;
+	}
+
+	// splits at the median of the centers along the longest side of the box
+	int axis = 0;
+	for (int i = 1; i < 3; ++i) {
+		if (node.box_max[i] - node.box_min[i] > node.box_max[axis] - node.box_min[axis])
+			axis = i;
+	}
+	const std::size_t middle = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](unsigned int a, unsigned int b) {
+		return corners[3 * a][axis] + corners[3 * a + 1][axis] + corners[3 * a + 2][axis] <
+			corners[3 * b][axis] + corners[3 * b + 1][axis] + corners[3 * b + 2][axis];
+	});
+
+	nodes_[index].is_leaf = false;
+	const unsigned int left = build(order, begin, middle);
+	const unsigned int right = build(order, middle, end);
+	nodes_[index].begin = left;
+	nodes_[index].end = right;
+	return index;
+}
+
+
+void TriangleTree::add_block(const unsigned int* triangles, std::size_t n) {
+	const std::vector<vec3>& corners = corners_;
+	Block block;
+	for (std::size_t j = 0; j < block_size; ++j) {
+		const unsigned int t = triangles[std::min(j, n - 1)];	// the last one repeated
+		const vec3& a = corners[3 * t];
+		const vec3 e0 = corners[3 * t + 1] - a;
+		const vec3 e1 = corners[3 * t + 2] - a;
+		const vec3 e2 = corners[3 * t + 2] - corners[3 * t + 1];
+		block.ax[j] = a.x;		block.ay[j] = a.y;		block.az[j] = a.z;
+		block.e0x[j] = e0.x;	block.e0y[j] = e0.y;	block.e0z[j] = e0.z;
+		block.e1x[j] = e1.x;	block.e1y[j] = e1.y;	block.e1z[j] = e1.z;
+		block.e2x[j] = e2.x;	block.e2y[j] = e2.y;	block.e2z[j] = e2.z;
+
+		const float d00 = dot(e0, e0), d01 = dot(e0, e1), d11 = dot(e1, e1), d22 = dot(e2, e2);
+		const float det = d00 * d11 - d01 * d01;
+		block.d00[j] = d00;
+		block.d01[j] = d01;
+		block.d11[j] = d11;
+		block.inv_det[j] = det > 1e-12f * d00 * d11 ? 1.0f / det : 0.0f;
+		block.inv00[j] = d00 > 0.0f ? 1.0f / d00 : 0.0f;
+		block.inv11[j] = d11 > 0.0f ? 1.0f / d11 : 0.0f;
+		block.inv22[j] = d22 > 0.0f ? 1.0f / d22 : 0.0f;
+		block.triangle[j] = t;
+	}
+	for (std::size_t j = 0; j < n; ++j)
+		block_of_[triangles[j]] = static_cast<unsigned int>(blocks_.size());
+	blocks_.push_back(block);
+}
+
+
+// The nearest point is inside the triangle if the projection of p is (then at the distance to the plane),
+// or else on one of its edges. All of them are computed for all the triangles of the block (without 
+// branches), and the smallest is kept.
+float TriangleTree::block_closest(const Block& b, const vec3& p, unsigned int& triangle, float best) const {
+	float d2[block_size];
+	for (int j = 0; j < block_size; ++j) {
+		const float vx = p.x - b.ax[j], vy = p.y - b.ay[j], vz = p.z - b.az[j];
+		const float d20 = vx * b.e0x[j] + vy * b.e0y[j] + vz * b.e0z[j];
+		const float d21 = vx * b.e1x[j] + vy * b.e1y[j] + vz * b.e1z[j];
+
+		// inside
+		const float s = (b.d11[j] * d20 - b.d01[j] * d21) * b.inv_det[j];
+		const float t = (b.d00[j] * d21 - b.d01[j] * d20) * b.inv_det[j];
+		const float qx = vx - s * b.e0x[j] - t * b.e1x[j];
+		const float qy = vy - s * b.e0y[j] - t * b.e1y[j];
+		const float qz = vz - s * b.e0z[j] - t * b.e1z[j];
+		const bool inside = b.inv_det[j] > 0.0f && s >= 0.0f && t >= 0.0f && s + t <= 1.0f;
+		const float plane = qx * qx + qy * qy + qz * qz;
+
+		// the edges a-b, a-c and b-c
+		const float u0 = clamp01(d20 * b.inv00[j]);
+		const float w0x = vx - u0 * b.e0x[j], w0y = vy - u0 * b.e0y[j], w0z = vz - u0 * b.e0z[j];
+		const float u1 = clamp01(d21 * b.inv11[j]);
+		const float w1x = vx - u1 * b.e1x[j], w1y = vy - u1 * b.e1y[j], w1z = vz - u1 * b.e1z[j];
+		const float bx = vx - b.e0x[j], by = vy - b.e0y[j], bz = vz - b.e0z[j];
+		const float u2 = clamp01((bx * b.e2x[j] + by * b.e2y[j] + bz * b.e2z[j]) * b.inv22[j]);
+		const float w2x = bx - u2 * b.e2x[j], w2y = by - u2 * b.e2y[j], w2z = bz - u2 * b.e2z[j];
+		const float edges = std::min(std::min(w0x * w0x + w0y * w0y + w0z * w0z, w1x * w1x + w1y * w1y + w1z * w1z),
+			w2x * w2x + w2y * w2y + w2z * w2z);
+
+		d2[j] = inside ? plane : edges;
+	}
+
+	for (int j = 0; j < block_size; ++j) {
+		if (d2[j] < best) {
+			best = d2[j];
+			triangle = b.triangle[j];
+		}
+	}
+	return best;
+}
+
+
+float TriangleTree::closest(const vec3& p, unsigned int& triangle, float max_sqr_distance) const {
+	float best = max_sqr_distance;
+	if (nodes_.empty())
+		return best;
+
+	unsigned int stack[64];
+	std::size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes_[stack[--top]];
+		if (sqr_distance_to_box(p, node.box_min, node.box_max) >= best)
+			continue;
+		if (node.is_leaf) {
+			for (unsigned int k = node.begin; k < node.end; ++k)
+				best = block_closest(blocks_[k], p, triangle, best);
+			continue;
+		}
+
+		// the nearer child is visited first (pushed last)
+		const float dl = sqr_distance_to_box(p, nodes_[node.begin].box_min, nodes_[node.begin].box_max);
+		const float dr = sqr_distance_to_box(p, nodes_[node.end].box_min, nodes_[node.end].box_max);
+		if (dl < dr) {
+			stack[top++] = node.end;
+			stack[top++] = node.begin;
+		}
+		else {
+			stack[top++] = node.begin;
+			stack[top++] = node.end;
+		}
+	}
+	return best;
+}
+
+
+void TriangleTree::closest(const vec3* points, const unsigned int* indices, std::size_t n, float* sqr_distances, unsigned int* triangles) const {
+	if (nodes_.empty()) {
+		std::fill(sqr_distances, sqr_distances + n, 1e30f);
+		return;
+	}
+
+	unsigned int previous = blocks_[0].triangle[0];
+	for (std::size_t i = 0; i < n; ++i) {
+		const vec3& p = points[indices ? indices[i] : i];
+		// the block of the nearest triangle of the previous point bounds the search
+		unsigned int triangle = previous;
+		const float bound = block_closest(blocks_[block_of_[previous]], p, triangle, 1e30f);
+		sqr_distances[i] = closest(p, triangle, bound);
+		triangles[i] = triangle;
+		previous = triangle;
+	}
+}
+
+
+void TriangleTree::overlapping(const float* box_min, const float* box_max, std::vector<unsigned int>& result) const {
+	if (nodes_.empty())
+		return;
+
+	unsigned int stack[64];
+	std::size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes_[stack[--top]];
+		bool overlaps = true;
+		for (int i = 0; i < 3; ++i)
+			overlaps = overlaps && node.box_min[i] <= box_max[i] && box_min[i] <= node.box_max[i];
+		if (!overlaps)
+			continue;
+		if (!node.is_leaf) {
+			stack[top++] = node.begin;
+			stack[top++] = node.end;
+			continue;
+		}
+
+		for (unsigned int k = node.begin; k < node.end; ++k) {
+			const Block& block = blocks_[k];
+			for (int j = 0; j < block_size; ++j) {
+				// the padding repeats the last triangle
+				if (j > 0 && block.triangle[j] == block.triangle[j - 1])
+					break;
+				const unsigned int t = block.triangle[j];
+				bool hit = true;
+				for (int i = 0; i < 3; ++i) {
+					const float a = corners_[3 * t][i], b = corners_[3 * t + 1][i], c = corners_[3 * t + 2][i];
+					hit = hit && std::min(std::min(a, b), c) <= box_max[i] && box_min[i] <= std::max(std::max(a, b), c);
+				}
+				if (hit)
+					result.push_back(t);
+			}
+		}
+	}
+}
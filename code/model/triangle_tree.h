@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _TRIANGLE_TREE_H_
+#define _TRIANGLE_TREE_H_
+
+#include "model_common.h"
+#include "map.h"
+#include "../math/math_types.h"
+
+#include <vector>
+
+
+/**
+* A bounding volume hierarchy over the triangles of the facets of a Map (each facet is split into a fan), for
+* the distances of many points to the surface (e.g., of the input points to the reconstructed model, see
+* ReconstructionEvaluator). The triangles of a leaf are stored by coordinates in blocks of 'block_size' 
+* (padded with copies of the last one), and the distances of a point to a block are computed at once by a 
+* branch-free loop over the block, which the compiler vectorizes.
+*/
+
+class MODEL_API TriangleTree
+{
+public:
+	enum { block_size = 4 };
+
+	TriangleTree(const Map* mesh);
+
+	std::size_t num_triangles() const { return facets_.size(); }
+	// the facet of a triangle (its index in the facet list of the map) and its area
+	unsigned int facet(std::size_t triangle) const { return facets_[triangle]; }
+	float area(std::size_t triangle) const { return areas_[triangle]; }
+	std::size_t num_facets() const { return num_facets_; }
+	// the corners of a triangle, and their vertices (their indices in the vertex list of the map)
+	const vec3& corner(std::size_t triangle, int i) const { return corners_[3 * triangle + i]; }
+	unsigned int vertex(std::size_t triangle, int i) const { return vertices_[3 * triangle + i]; }
+
+	// The squared distance of 'p' to the surface and the nearest triangle (the squared distance is 
+	// 'max_sqr_distance' and the triangle is unchanged if none is closer).
+	float closest(const vec3& p, unsigned int& triangle, float max_sqr_distance = 1e30f) const;
+
+	// The squared distances (and the nearest triangles) of the points[indices[i]] (or of the points[i] if 
+	// 'indices' is nil). The nearest triangle of a point bounds the search for the next one, which is
+	// fast for the coherent points (e.g., the points of a segment).
+	void closest(const vec3* points, const unsigned int* indices, std::size_t n, float* sqr_distances, unsigned int* triangles) const;
+
+	// collects the triangles whose boxes overlap the box [box_min, box_max] (e.g., of another triangle)
+	void overlapping(const float* box_min, const float* box_max, std::vector<unsigned int>& result) const;
+
+private:
+	struct Node {
+		float			box_min[3];
+		float			box_max[3];
+		// for leaves: the blocks [begin, end); for inner nodes: the two children
+		unsigned int	begin;
+		unsigned int	end;
+		bool			is_leaf;
+	};
+
+	// the triangles of a block, by coordinate (see the kernel in the .cpp)
+	struct Block {
+		float ax[block_size], ay[block_size], az[block_size];		// the first corner
+		float e0x[block_size], e0y[block_size], e0z[block_size];	// b - a
+		float e1x[block_size], e1y[block_size], e1z[block_size];	// c - a
+		float e2x[block_size], e2y[block_size], e2z[block_size];	// c - b
+		float d00[block_size], d01[block_size], d11[block_size];	// the dot products of the edges
+		float inv_det[block_size];									// 0 for the degenerate triangles
+		float inv00[block_size], inv11[block_size], inv22[block_size];	// the inverse squared lengths (or 0)
+		unsigned int triangle[block_size];
+	};
+
+	unsigned int build(std::vector<unsigned int>& order, std::size_t begin, std::size_t end);
+	void add_block(const unsigned int* triangles, std::size_t n);
+	float block_closest(const Block& block, const vec3& p, unsigned int& triangle, float best) const;
+
+private:
+	std::vector<Node>			nodes_;
+	std::vector<Block>			blocks_;
+	std::vector<unsigned int>	block_of_;	// the block of each triangle
+	std::vector<vec3>			corners_;	// 3 per triangle
+	std::vector<unsigned int>	vertices_;	// of the corners
+	std::vector<unsigned int>	facets_;	// of the triangles
+	std::vector<float>			areas_;
+	std::size_t					num_facets_;
+};
+
+
+#endif
@@ -36,6 +36,32 @@ class VertexGroup : public std::vector<unsigned int>, public Counted
 public:
 	typedef SmartPointer<VertexGroup>	Ptr;
 
+	// The footprint of the group in the 2D frame of its plane, computed once for the stages that need
+	// it (see SegmentFootprint): the projected points (in the order of the group), their convex hull 
+	// (counterclockwise), the triangles of their alpha shape (three corners each, if computed with a 
+	// radius > 0), and the area of the alpha shape (or of the hull, without alpha shape).
+	struct Footprint {
+		Footprint() : radius(0.0f), area(0.0), valid(false) {}
+
+		std::vector<vec2>	points;
+		std::vector<vec2>	hull;
+		std::vector<vec2>	alpha_triangles;
+		float				radius;
+		double				area;
+		bool				valid;
+	};
+
+	// The points of the group projected in the 2D frame of its plane (see Geom::to_2d()), with their
+	// signed distances to the plane, both in the order of the group. They are computed once the plane is
+	// final (see SegmentProjection), for the stages that work in the 2D frame of the plane.
+	struct Projection {
+		Projection() : valid(false) {}
+
+		std::vector<vec2>	points;
+		std::vector<float>	distances;
+		bool				valid;
+	};
+
 public:
 	VertexGroup(PointSet* pset = nil) 
 		: label_("unknown")
@@ -62,11 +88,25 @@ public:
 	const Color& color() const { return color_; }
 	void set_color(const Color& c) { color_ = c; }
 
-	void set_plane(const Plane3d& plane) { plane_ = plane; }
+	// the footprint and the projection are invalidated, as they lie in the frame of the plane
+	void set_plane(const Plane3d& plane) { plane_ = plane; invalidate_footprint(); invalidate_projection(); }
 	const Plane3d& plane() const { return plane_; }
 
 	const std::vector<unsigned int>& boundary() const { return boundary_; }
 	void set_boundary(const std::vector<unsigned int>& bd) { boundary_ = bd; }
+
+	// The clients that change the points of the group directly must invalidate the footprint (it is
+	// invalidated when the plane is refit, e.g., after a merge).
+	const Footprint& footprint() const { return footprint_; }
+	Footprint& footprint() { return footprint_; }
+	bool has_footprint() const { return footprint_.valid; }
+	void invalidate_footprint() { footprint_ = Footprint(); }
+
+	// The same for the projection, which is also taken as outdated if the number of points changed.
+	const Projection& projection() const { return projection_; }
+	Projection& projection() { return projection_; }
+	bool has_projection() const { return projection_.valid && projection_.points.size() == size(); }
+	void invalidate_projection() { projection_ = Projection(); }
 	
 	//////////////////////////////////////////////////////////////////////////
 
@@ -95,7 +135,8 @@ private:
 	Color			color_;
 
 	std::vector<unsigned int>	boundary_;
-	std::vector<vec3>			facet_; 
+	Footprint					footprint_;
+	Projection					projection_;
 
 	VertexGroup*			parent_;
 	std::set<VertexGroup*>	children_;
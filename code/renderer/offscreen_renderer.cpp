@@ -0,0 +1,440 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "offscreen_renderer.h"
+#include "surface_render.h"
+#include "point_set_render.h"
+#include "../model/map.h"
+#include "../model/point_set.h"
+#include "../basic/logger.h"
+
+#include <GL/glew.h>
+#ifdef HAS_EGL
+#	include <EGL/egl.h>
+#	include <EGL/eglext.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+
+namespace {
+
+	// the CRC of the chunks of a PNG image
+	struct CRCTable {
+		CRCTable() {
+			for (unsigned int i = 0; i < 256; ++i) {
+				unsigned int c = i;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+				values[i] = c;
+			}
+		}
+		unsigned int values[256];
+	};
+
+	unsigned int crc32(const unsigned char* data, std::size_t size) {
+		static const CRCTable table;
+		unsigned int crc = 0xffffffffu;
+		for (std::size_t i = 0; i < size; ++i)
+			crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return crc ^ 0xffffffffu;
+	}
+
+
+	void put_uint32(std::vector<unsigned char>& out, unsigned int v) {
+		out.push_back(static_cast<unsigned char>(v >> 24));
+		out.push_back(static_cast<unsigned char>(v >> 16));
+		out.push_back(static_cast<unsigned char>(v >> 8));
+		out.push_back(static_cast<unsigned char>(v));
+	}
+
+	void write_chunk(std::ofstream& output, const char* type, const std::vector<unsigned char>& data) {
+		std::vector<unsigned char> chunk;
+		put_uint32(chunk, static_cast<unsigned int>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		put_uint32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));	// of the type and the data
+		output.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+
+}
+
+
+float OffscreenRenderer::Camera::pixelGLRatio(float x, float y, float z) const {
+	float depth = std::fabs(dot(vec3(x, y, z) - eye_, dir_));
+	return 2.0f * depth * std::tan(fov_ * 0.5f) / height_;
+}
+
+
+OffscreenRenderer::OffscreenRenderer(int width, int height)
+	: width_(width)
+	, height_(height)
+	, valid_(false)
+	, display_(nil)
+	, context_(nil)
+	, fbo_(0)
+	, color_rbo_(0)
+	, depth_rbo_(0)
+	, surface_render_(nil)
+	, point_set_render_(nil)
+{
+	camera_.height_ = height_;
+	if (!create_context())
+		return;
+
+	if (create_framebuffer()) {
+		surface_render_ = new SurfaceRender(this);
+		EdgeStyle s = surface_render_->mesh_style();
+		s.visible = false;	// as the result in the viewer
+		surface_render_->set_mesh_style(s);
+		point_set_render_ = new PointSetRender(this);
+		valid_ = true;
+	}
+	else
+		destroy_context();
+}
+
+
+OffscreenRenderer::~OffscreenRenderer() {
+	if (!valid_)
+		return;
+
+#ifdef HAS_EGL
+	eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_);
+#endif
+	// their buffers are released in the context
+	delete surface_render_;
+	delete point_set_render_;
+	glDeleteRenderbuffers(1, &color_rbo_);
+	glDeleteRenderbuffers(1, &depth_rbo_);
+	glDeleteFramebuffers(1, &fbo_);
+	destroy_context();
+}
+
+
+CameraBase* OffscreenRenderer::get_camera() const {
+	return &camera_;
+}
+
+
+bool OffscreenRenderer::create_context() {
+#ifdef HAS_EGL
+	// the surfaceless platform (Mesa) needs no device, the default display may be another one
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = 
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (get_platform_display)
+		display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nil);
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+			Logger::err("-") << "failed initializing EGL for offscreen rendering" << std::endl;
+			return false;
+		}
+	}
+
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	EGLContext context = EGL_NO_CONTEXT;
+	// the renderers use the fixed-function pipeline, i.e., the default (compatibility) context of OpenGL
+	if (eglBindAPI(EGL_OPENGL_API) && eglChooseConfig(display, config_attribs, &config, 1, &num_configs) && num_configs > 0)
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, nil);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		Logger::err("-") << "failed creating an OpenGL context for offscreen rendering (EGL " << major << "." << minor << ")" << std::endl;
+		if (context != EGL_NO_CONTEXT)
+			eglDestroyContext(display, context);
+		eglTerminate(display);
+		return false;
+	}
+	display_ = display;
+	context_ = context;
+
+	// GLEW looks for the GLX display (there is none) once it has loaded the functions
+	GLenum err = glewInit();
+	if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY) {
+		Logger::err("-") << glewGetErrorString(err) << std::endl;
+		destroy_context();
+		return false;
+	}
+	return true;
+#else
+	Logger::err("-") << "offscreen rendering requires EGL (not available in this build)" << std::endl;
+	return false;
+#endif
+}
+
+
+void OffscreenRenderer::destroy_context() {
+#ifdef HAS_EGL
+	if (display_) {
+		eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context_)
+			eglDestroyContext(display_, context_);
+		eglTerminate(display_);
+	}
+#endif
+	display_ = nil;
+	context_ = nil;
+}
+
+
+bool OffscreenRenderer::create_framebuffer() {
+	if (!GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object) {
+		Logger::err("-") << "offscreen rendering requires framebuffer objects" << std::endl;
+		return false;
+	}
+
+	glGenFramebuffers(1, &fbo_);
+	glGenRenderbuffers(1, &color_rbo_);
+	glGenRenderbuffers(1, &depth_rbo_);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_rbo_);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo_);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rbo_);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rbo_);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		Logger::err("-") << "incomplete framebuffer for offscreen rendering" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteRenderbuffers(1, &color_rbo_);
+		glDeleteRenderbuffers(1, &depth_rbo_);
+		glDeleteFramebuffers(1, &fbo_);
+		fbo_ = color_rbo_ = depth_rbo_ = 0;
+		return false;
+	}
+	// there is no default framebuffer to draw into
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	// the same states as the viewer (see PaintCanvas::init())
+	glEnable(GL_DEPTH_TEST);
+	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+	glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
+	glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, GL_FALSE);
+	glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SEPARATE_SPECULAR_COLOR);
+	glEnable(GL_LIGHT0);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_NORMALIZE);
+	float specular[] = { 0.6f, 0.6f, 0.6f, 0.5f };
+	glMaterialfv(GL_FRONT, GL_SPECULAR, specular);
+	glMaterialf(GL_FRONT, GL_SHININESS, 64.0f);
+	glEnable(GL_COLOR_MATERIAL);
+	glViewport(0, 0, width_, height_);
+	return true;
+}
+
+
+void OffscreenRenderer::setup_view(const Box3d& box, float azimuth, float elevation) {
+	const float to_radians = 3.14159265f / 180.0f;
+	const float a = azimuth * to_radians;
+	const float e = elevation * to_radians;
+	const vec3 dir(std::cos(e) * std::sin(a), std::cos(e) * std::cos(a), -std::sin(e));
+
+	// the bounding sphere fits in the narrower field of view
+	const float aspect = static_cast<float>(width_) / height_;
+	float half_fov = camera_.fov_ * 0.5f;
+	if (aspect < 1.0f)
+		half_fov = std::atan(std::tan(half_fov) * aspect);
+	const float radius = std::max(box.radius(), 1e-6f);
+	const float distance = radius / std::sin(half_fov);
+	const vec3 center = box.center();
+
+	camera_.eye_ = center - dir * distance;
+	camera_.dir_ = dir;
+
+	const float z_near = std::max(distance - radius, distance * 0.005f);
+	const float z_far = distance + radius;
+	const float top = z_near * std::tan(camera_.fov_ * 0.5f);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glFrustum(-top * aspect, top * aspect, -top, top, z_near, z_far);
+
+	// the light is given in the eye coordinates (as in the viewer)
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	float light[] = { 0.27f, 0.27f, 0.92f, 0.0f };
+	glLightfv(GL_LIGHT0, GL_POSITION, light);
+
+	// looking at the center with the z axis up (or the y axis, looking along the z axis)
+	vec3 up(0, 0, 1);
+	if (std::fabs(dir.z) > 0.999f)
+		up = vec3(0, 1, 0);
+	const vec3 s = normalize(cross(dir, up));
+	const vec3 u = cross(s, dir);
+	const vec3& eye = camera_.eye_;
+	float m[16] = {
+		s.x, u.x, -dir.x, 0.0f,
+		s.y, u.y, -dir.y, 0.0f,
+		s.z, u.z, -dir.z, 0.0f,
+		-dot(s, eye), -dot(u, eye), dot(dir, eye), 1.0f
+	};
+	glLoadMatrixf(m);
+}
+
+
+bool OffscreenRenderer::render(Map* mesh, PointSet* pset, float azimuth, float elevation, std::vector<unsigned char>& rgba) {
+	if (!valid_)
+		return false;
+
+	Box3d box;
+	if (mesh && mesh->size_of_facets() > 0)
+		box.add_box(mesh->bbox());
+	if (pset && pset->num_points() > 0)
+		box.add_box(pset->bbox());
+	if (!box.initialized()) {
+		Logger::warn("-") << "nothing to render" << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+#ifdef HAS_EGL
+	if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+		Logger::err("-") << "failed making the offscreen context current" << std::endl;
+		return false;
+	}
+#endif
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	setup_view(box, azimuth, elevation);
+
+	if (pset && pset->num_points() > 0)
+		point_set_render_->draw(pset);
+	if (mesh && mesh->size_of_facets() > 0)
+		surface_render_->draw(mesh, false);
+	glFinish();
+
+	// the rows are read bottom up
+	const std::size_t row = static_cast<std::size_t>(width_) * 4;
+	std::vector<unsigned char> pixels(row * height_);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	bool ok = (glGetError() == GL_NO_ERROR);
+
+#ifdef HAS_EGL
+	eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);	// for the next thread
+#endif
+	if (!ok) {
+		Logger::err("-") << "failed reading the offscreen image" << std::endl;
+		return false;
+	}
+
+	rgba.resize(pixels.size());
+	for (int y = 0; y < height_; ++y) {
+		const unsigned char* src = pixels.data() + (height_ - 1 - y) * row;
+		unsigned char* dst = rgba.data() + y * row;
+		for (std::size_t i = 0; i < row; i += 4) {
+			dst[i] = src[i];
+			dst[i + 1] = src[i + 1];
+			dst[i + 2] = src[i + 2];
+			dst[i + 3] = 255;	// the images are opaque
+		}
+	}
+	return true;
+}
+
+
+int OffscreenRenderer::render_views(Map* mesh, PointSet* pset, int num_views, const std::string& base) {
+	int num_saved = 0;
+	std::vector<unsigned char> rgba;
+	for (int i = 0; i < num_views; ++i) {
+		const float azimuth = 360.0f * i / num_views;
+		if (!render(mesh, pset, azimuth, 30.0f, rgba))
+			break;
+
+		std::ostringstream file_name;
+		file_name << base << ".view" << i << ".png";
+		if (save_png(file_name.str(), width_, height_, rgba))
+			++num_saved;
+		else
+			Logger::err("-") << "failed saving image to file: " << file_name.str() << std::endl;
+	}
+	return num_saved;
+}
+
+
+bool OffscreenRenderer::save_png(const std::string& file_name, int width, int height, const std::vector<unsigned char>& rgba) {
+	if (width <= 0 || height <= 0 || rgba.size() != static_cast<std::size_t>(width) * height * 4)
+		return false;
+
+	std::ofstream output(file_name.c_str(), std::ios::binary);
+	if (output.fail())
+		return false;
+
+	const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	output.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<unsigned char> header;
+	put_uint32(header, static_cast<unsigned int>(width));
+	put_uint32(header, static_cast<unsigned int>(height));
+	header.push_back(8);	// bits per channel
+	header.push_back(6);	// RGBA
+	header.push_back(0);	// deflate
+	header.push_back(0);	// the adaptive filters
+	header.push_back(0);	// not interlaced
+	write_chunk(output, "IHDR", header);
+
+	// the rows (each after its filter, none) in the stored (uncompressed) blocks of a zlib stream
+	const std::size_t row = static_cast<std::size_t>(width) * 4;
+	std::vector<unsigned char> raw;
+	raw.reserve((row + 1) * height);
+	for (int y = 0; y < height; ++y) {
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba.begin() + y * row, rgba.begin() + (y + 1) * row);
+	}
+
+	std::vector<unsigned char> data;
+	data.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	data.push_back(0x78);
+	data.push_back(0x01);
+	const std::size_t max_block = 65535;
+	for (std::size_t pos = 0; pos < raw.size(); pos += max_block) {
+		const std::size_t size = std::min(max_block, raw.size() - pos);
+		const unsigned int len = static_cast<unsigned int>(size);
+		data.push_back(pos + size == raw.size() ? 1 : 0);	// the final block
+		data.push_back(static_cast<unsigned char>(len & 0xff));
+		data.push_back(static_cast<unsigned char>(len >> 8));
+		data.push_back(static_cast<unsigned char>(~len & 0xff));
+		data.push_back(static_cast<unsigned char>((~len >> 8) & 0xff));
+		data.insert(data.end(), raw.begin() + pos, raw.begin() + pos + size);
+	}
+	unsigned int a = 1, b = 0;	// Adler-32
+	for (std::size_t i = 0; i < raw.size(); ++i) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	put_uint32(data, (b << 16) | a);
+	write_chunk(output, "IDAT", data);
+
+	write_chunk(output, "IEND", std::vector<unsigned char>());
+	return !output.fail();
+}
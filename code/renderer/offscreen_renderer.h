@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _RENDERER_OFFSCREEN_RENDERER_H_
+#define _RENDERER_OFFSCREEN_RENDERER_H_
+
+#include "renderer_common.h"
+#include "../basic/canvas.h"
+#include "../math/math_types.h"
+
+#include <vector>
+#include <string>
+#include <mutex>
+
+
+class Map;
+class PointSet;
+class SurfaceRender;
+class PointSetRender;
+
+// Renders models and point sets into images without a window (e.g., the thumbnails of the batch
+// reconstruction): an OpenGL context without a surface (EGL, on the default or the surfaceless device)
+// draws into a framebuffer object with the SurfaceRender and the PointSetRender (i.e., with their buffer
+// paths), and the pixels are read back. The context is only current while rendering, so the renderer
+// can be shared by several threads (they render one after another). Without EGL (i.e., not built with
+// HAS_EGL), or if no context can be created, is_valid() is false and nothing is rendered.
+class RENDERER_API OffscreenRenderer : public Canvas
+{
+public:
+	OffscreenRenderer(int width = 512, int height = 512);
+	~OffscreenRenderer();
+
+	bool is_valid() const { return valid_; }
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+
+	virtual void update_graphics() {}
+	virtual void update_all() {}
+	virtual CameraBase* get_camera() const;
+
+	// Renders 'mesh' and 'pset' (either can be nil) seen from the 'azimuth' (around the z axis, 0 looking
+	// along the y axis) and the 'elevation' (in degrees, positive looking down) at the distance showing
+	// their bounding box, into 'rgba' (width() x height() pixels, top row first). Returns false on failure.
+	bool render(Map* mesh, PointSet* pset, float azimuth, float elevation, std::vector<unsigned char>& rgba);
+
+	// Renders 'num_views' images at the azimuths evenly spaced around the scene (looking down at 30
+	// degrees) and saves them as "<base>.view<i>.png". Returns the number of images saved.
+	int render_views(Map* mesh, PointSet* pset, int num_views, const std::string& base);
+
+	// saves the 'rgba' pixels (top row first) as an (uncompressed) PNG image
+	static bool save_png(const std::string& file_name, int width, int height, const std::vector<unsigned char>& rgba);
+
+private:
+	bool create_context();
+	void destroy_context();
+	bool create_framebuffer();
+	void setup_view(const Box3d& box, float azimuth, float elevation);
+
+	// the projection of the current view, for the renderers that scale their drawing to the pixels
+	class Camera : public CameraBase {
+	public:
+		Camera() : fov_(0.7853982f), height_(1), eye_(0, 0, 0), dir_(0, 1, 0) {}
+		virtual float pixelGLRatio(float x, float y, float z) const;
+
+		float	fov_;		// vertical field of view, in radians
+		int		height_;	// of the viewport, in pixels
+		vec3	eye_;
+		vec3	dir_;		// the view direction (unit)
+	};
+
+private:
+	int		width_;
+	int		height_;
+	bool	valid_;
+
+	void*	display_;	// EGLDisplay
+	void*	context_;	// EGLContext
+
+	unsigned int	fbo_;
+	unsigned int	color_rbo_;
+	unsigned int	depth_rbo_;
+
+	SurfaceRender*	surface_render_;
+	PointSetRender*	point_set_render_;
+
+	mutable Camera	camera_;
+	std::mutex		mutex_;		// a single thread renders at a time
+};
+
+
+#endif
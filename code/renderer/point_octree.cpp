@@ -0,0 +1,235 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "point_octree.h"
+
+#include <queue>
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+	// the nodes are not subdivided further (e.g., for duplicated points)
+	const unsigned int max_depth = 21;
+
+	// the nodes with at most this number of points are leaves
+	const unsigned int max_leaf_points = PointOctree::grid_size * PointOctree::grid_size * PointOctree::grid_size;
+
+	inline int octant(const vec3& p, const vec3& c) {
+		return (p.x >= c.x ? 1 : 0) | (p.y >= c.y ? 2 : 0) | (p.z >= c.z ? 4 : 0);
+	}
+
+	// the 6 planes (normalized) of the view frustum of 'mvp', Gribb & Hartmann
+	void frustum_planes(const float mvp[16], float planes[6][4]) {
+		for (int i = 0; i < 3; ++i) {
+			for (int s = 0; s < 2; ++s) {
+				float* pl = planes[i * 2 + s];
+				float sign = (s == 0) ? 1.0f : -1.0f;
+				for (int k = 0; k < 4; ++k)
+					pl[k] = mvp[k * 4 + 3] + sign * mvp[k * 4 + i];
+				float len = std::sqrt(pl[0] * pl[0] + pl[1] * pl[1] + pl[2] * pl[2]);
+				if (len > 0.0f) {
+					for (int k = 0; k < 4; ++k)
+						pl[k] /= len;
+				}
+			}
+		}
+	}
+
+	inline bool sphere_is_visible(const float planes[6][4], const vec3& c, float radius) {
+		for (int i = 0; i < 6; ++i) {
+			const float* pl = planes[i];
+			if (pl[0] * c.x + pl[1] * c.y + pl[2] * c.z + pl[3] < -radius)
+				return false;
+		}
+		return true;
+	}
+}
+
+
+bool PointOctree::build(const std::vector<vec3>& points, const std::atomic<bool>* cancel) {
+	order_.clear();
+	nodes_.clear();
+	if (points.empty())
+		return true;
+
+	Box3d box;
+	for (std::size_t i = 0; i < points.size(); ++i)
+		box.add_point(points[i]);
+	float size = ogf_max(box.width(), ogf_max(box.height(), box.depth()));
+
+	order_.resize(points.size());
+	for (std::size_t i = 0; i < points.size(); ++i)
+		order_[i] = static_cast<unsigned int>(i);
+	scratch_.resize(points.size());
+
+	Node root;
+	root.center = box.center();
+	root.half_size = 0.5f * size * 1.001f + 1e-6f;	// all points strictly inside
+	root.begin = 0;
+	root.num_own = 0;
+	root.end = static_cast<unsigned int>(points.size());
+	std::fill(root.children, root.children + 8, -1);
+	nodes_.push_back(root);
+
+	build_node(0, points, 0, cancel);
+
+	std::vector<unsigned int>().swap(scratch_);
+	if (cancel && *cancel) {
+		order_.clear();
+		nodes_.clear();
+		return false;
+	}
+	return true;
+}
+
+
+void PointOctree::build_node(int index, const std::vector<vec3>& points, unsigned int depth, const std::atomic<bool>* cancel) {
+	if (cancel && *cancel)
+		return;
+
+	// a copy: the nodes are reallocated when adding the children
+	const Node node = nodes_[index];
+	unsigned int n = node.end - node.begin;
+	if (n <= max_leaf_points || depth >= max_depth) {
+		nodes_[index].num_own = n;
+		return;
+	}
+
+	// the subsample: the first point in each cell of the grid is moved to the front
+	const vec3 corner = node.center - vec3(node.half_size, node.half_size, node.half_size);
+	const float cells_per_unit = grid_size / (2.0f * node.half_size);
+	std::vector<unsigned char> occupied(grid_size * grid_size * grid_size, 0);
+	unsigned int own_end = node.begin;
+	for (unsigned int i = node.begin; i < node.end; ++i) {
+		const vec3 p = (points[order_[i]] - corner) * cells_per_unit;
+		int cx = ogf_min(grid_size - 1, ogf_max(0, int(p.x)));
+		int cy = ogf_min(grid_size - 1, ogf_max(0, int(p.y)));
+		int cz = ogf_min(grid_size - 1, ogf_max(0, int(p.z)));
+		unsigned char& cell = occupied[(cz * grid_size + cy) * grid_size + cx];
+		if (!cell) {
+			cell = 1;
+			std::swap(order_[own_end++], order_[i]);
+		}
+	}
+	nodes_[index].num_own = own_end - node.begin;
+
+	// the remaining points are sorted by the octant (counting sort)
+	unsigned int count[8] = { 0 };
+	for (unsigned int i = own_end; i < node.end; ++i)
+		++count[octant(points[order_[i]], node.center)];
+	unsigned int start[8];
+	unsigned int offset = own_end;
+	for (int k = 0; k < 8; ++k) {
+		start[k] = offset;
+		offset += count[k];
+	}
+	unsigned int pos[8];
+	std::copy(start, start + 8, pos);
+	for (unsigned int i = own_end; i < node.end; ++i) {
+		unsigned int idx = order_[i];
+		scratch_[pos[octant(points[idx], node.center)]++] = idx;
+	}
+	std::copy(scratch_.begin() + own_end, scratch_.begin() + node.end, order_.begin() + own_end);
+
+	const float h = 0.5f * node.half_size;
+	for (int k = 0; k < 8; ++k) {
+		if (count[k] == 0)
+			continue;
+		Node child;
+		child.center = node.center + vec3((k & 1) ? h : -h, (k & 2) ? h : -h, (k & 4) ? h : -h);
+		child.half_size = h;
+		child.begin = start[k];
+		child.num_own = 0;
+		child.end = start[k] + count[k];
+		std::fill(child.children, child.children + 8, -1);
+		int child_index = static_cast<int>(nodes_.size());
+		nodes_.push_back(child);
+		nodes_[index].children[k] = child_index;
+		build_node(child_index, points, depth + 1, cancel);
+	}
+}
+
+
+void PointOctree::select(
+	const float mvp[16], const float projection[16], int viewport_height, float point_size,
+	std::size_t budget, std::vector< std::pair<unsigned int, unsigned int> >& ranges) const
+{
+	ranges.clear();
+	if (nodes_.empty())
+		return;
+
+	float planes[6][4];
+	frustum_planes(mvp, planes);
+
+	// the size (in pixels) on the screen of a sphere of radius 1 at a clip-space w of 1
+	const float scale = std::fabs(projection[5]) * viewport_height;
+	const float sqrt3 = 1.7320508f;
+	const bool perspective = (projection[11] != 0.0f);
+
+	typedef std::pair<float, int> Entry;	// (size of the bounding sphere on the screen, node)
+	std::priority_queue<Entry> queue;
+	const Node& root = nodes_[0];
+	if (sphere_is_visible(planes, root.center, root.half_size * sqrt3))
+		queue.push(Entry(1e30f, 0));
+
+	std::size_t count = 0;
+	while (!queue.empty()) {
+		Entry top = queue.top();
+		queue.pop();
+		const Node& node = nodes_[top.second];
+		if (count + node.num_own > budget)
+			continue;	// smaller nodes may still fit
+		if (node.num_own > 0)
+			ranges.push_back(std::make_pair(node.begin, node.begin + node.num_own));
+		count += node.num_own;
+
+		// refined only if the samples of the node (one per cell) are apart on the screen
+		if (top.first < 1e30f && top.first / (grid_size * sqrt3) <= point_size)
+			continue;
+
+		for (int k = 0; k < 8; ++k) {
+			if (node.children[k] < 0)
+				continue;
+			const Node& child = nodes_[node.children[k]];
+			float radius = child.half_size * sqrt3;
+			if (!sphere_is_visible(planes, child.center, radius))
+				continue;
+			const vec3& c = child.center;
+			float size = radius * scale;
+			if (perspective) {
+				float w = mvp[3] * c.x + mvp[7] * c.y + mvp[11] * c.z + mvp[15];
+				size = (w > radius) ? size / w : 1e30f;	// the camera is close to (or inside) the node
+			}
+			queue.push(Entry(size, node.children[k]));
+		}
+	}
+
+	// the ranges of a node and its children are adjacent
+	std::sort(ranges.begin(), ranges.end());
+	std::size_t num = 0;
+	for (std::size_t i = 0; i < ranges.size(); ++i) {
+		if (num > 0 && ranges[num - 1].second == ranges[i].first)
+			ranges[num - 1].second = ranges[i].second;
+		else
+			ranges[num++] = ranges[i];
+	}
+	ranges.resize(num);
+}
@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2017  Liangliang Nan
+https://3d.bk.tudelft.nl/liangliang/ - liangliang.nan@gmail.com
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _RENDERER_POINT_OCTREE_H_
+#define _RENDERER_POINT_OCTREE_H_
+
+#include "renderer_common.h"
+#include "../math/math_types.h"
+
+#include <vector>
+#include <atomic>
+#include <utility>
+
+
+/**
+* A level-of-detail octree of a point cloud. Each node owns a subsample of the points 
+* of its cube (at most one point per cell of a grid_size^3 grid), and its children own
+* the remaining ones, so that drawing a node and its ancestors draws an increasingly 
+* dense sample of the cloud. The points are ordered such that the points owned by a 
+* node are contiguous, followed by the points of its children: a node, or a whole 
+* subtree, is a single range of the ordered points.
+*/
+
+class RENDERER_API PointOctree
+{
+public:
+	struct Node {
+		vec3			center;
+		float			half_size;
+		unsigned int	begin;		// the points owned by the node are [begin, begin + num_own)
+		unsigned int	num_own;
+		unsigned int	end;		// the points of the subtree are [begin, end)
+		int				children[8];	// -1 for no child
+	};
+
+	// a node owns at most one point per cell of a grid of this resolution
+	static const int grid_size = 16;
+
+public:
+	PointOctree() {}
+
+	// builds the octree of 'points'. It returns false if 'cancel' becomes true meanwhile.
+	bool build(const std::vector<vec3>& points, const std::atomic<bool>* cancel = nil);
+
+	bool is_empty() const { return nodes_.empty(); }
+
+	// order()[i] is the (original) index of the i-th point
+	const std::vector<unsigned int>& order() const { return order_; }
+	const std::vector<Node>& nodes() const { return nodes_; }
+
+	// Selects the nodes to draw at most 'budget' points, from the coarsest to the finest: 
+	// the nodes outside the view frustum are skipped, and the larger the node on the
+	// screen, the sooner it is refined. A node is not refined once its points are closer 
+	// than 'point_size' pixels on the screen. 'mvp' is the (column-major) product of the 
+	// projection and the modelview matrices, 'projection' the projection matrix, and 
+	// 'viewport_height' in pixels. The result is the ranges [first, second) of the ordered 
+	// points, sorted and merged.
+	void select(
+		const float mvp[16], const float projection[16], int viewport_height, float point_size,
+		std::size_t budget, std::vector< std::pair<unsigned int, unsigned int> >& ranges
+	) const;
+
+private:
+	void build_node(int index, const std::vector<vec3>& points, unsigned int depth, const std::atomic<bool>* cancel);
+
+private:
+	std::vector<unsigned int>	order_;
+	std::vector<Node>			nodes_;
+	std::vector<unsigned int>	scratch_;	// only during the construction
+};
+
+
+#endif
@@ -20,15 +20,77 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 
 #include "point_set_render.h"
+#include "point_octree.h"
 #include "../model/point_set.h"
 #include "../model/vertex_group.h"
 
+#include "../basic/logger.h"
+
 #include <GL/glew.h>
 
+#include <chrono>
+#include <algorithm>
+
+
+namespace {
+
+	inline unsigned char to_byte(float v) {
+		ogf_clamp(v, 0.0f, 1.0f);
+		return static_cast<unsigned char>(v * 255.0f + 0.5f);
+	}
+
+	template <class T>
+	void upload(GLenum target, GLuint& buffer, const T* data, std::size_t n) {
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		glBufferData(target, n * sizeof(T), data, GL_STATIC_DRAW);
+		glBindBuffer(target, 0);
+	}
+
+	// the arrays of the buffers (a nonzero normal/color buffer enables the corresponding array)
+	void enable_arrays(GLuint points, GLuint normals, GLuint colors) {
+		glBindBuffer(GL_ARRAY_BUFFER, points);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, nil);
+		if (normals) {
+			glBindBuffer(GL_ARRAY_BUFFER, normals);
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glNormalPointer(GL_FLOAT, 0, nil);
+		}
+		if (colors) {
+			glBindBuffer(GL_ARRAY_BUFFER, colors);
+			glEnableClientState(GL_COLOR_ARRAY);
+			glColorPointer(4, GL_UNSIGNED_BYTE, 0, nil);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	PointOctree* build_octree(std::vector<vec3> points, const std::atomic<bool>* cancel) {
+		PointOctree* octree = new PointOctree;
+		if (!octree->build(points, cancel)) {
+			delete octree;
+			return nil;
+		}
+		return octree;
+	}
+
+	void disable_arrays() {
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+	}
+}
+
 
 
 PointSetRender::PointSetRender(Canvas* cvs)
 	: canvas_(cvs)
+	, point_budget_(5000000)
+	, interactive_point_budget_(1000000)
+	, interacting_(false)
+	, octree_(nil)
+	, octree_cancel_(false)
 {
 	per_point_color_ = false;
 
@@ -44,8 +106,198 @@ PointSetRender::PointSetRender(Canvas* cvs)
 
 PointSetRender::~PointSetRender(void)
 {
+	release_buffers();
+	release_loading_points();
+
+	octree_cancel_ = true;
+	if (octree_future_.valid())
+		delete octree_future_.get();
+	delete octree_;
+}
+
+
+PointSetRender::PointSetState::PointSetState(const PointSet* pset)
+	: pset_id(pset->id())
+	, pset_version(pset->version())
+	, num_points(pset->num_points())
+	, points_data(pset->points().empty() ? nil : &pset->points()[0])
+{
+}
+
+
+PointSetRender::PointBuffers* PointSetRender::buffers(PointSet* pset) {
+	if (!GLEW_VERSION_1_5)
+		return nil;
+
+	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+	std::size_t num_grouped = 0;
+	for (std::size_t i = 0; i < groups.size(); ++i)
+		num_grouped += groups[i]->size();
+
+	// besides the version, a few cheap tests catch the changes that were not notified
+	PointBuffers& b = buffers_;
+	PointSetState state(pset);
+	const PointOctree* tree = octree(pset);
+	if (b.point_vbo != 0 && b.state == state && b.octree == tree &&
+		b.group_offsets.size() == groups.size() + 1 && b.group_offsets.back() == num_grouped)
+		return &b;
+
+	// the points are uploaded in the order of the octree (if any)
+	std::size_t n = pset->num_points();
+	const unsigned int* order = tree ? &tree->order()[0] : nil;
+	std::vector<vec3> ordered;
+	if (order) {
+		ordered.resize(n);
+		const std::vector<vec3>& points = pset->points();
+		for (std::size_t i = 0; i < n; ++i)
+			ordered[i] = points[order[i]];
+		upload(GL_ARRAY_BUFFER, b.point_vbo, &ordered[0].x, n * 3);
+	}
+	else
+		upload(GL_ARRAY_BUFFER, b.point_vbo, &pset->points()[0].x, n * 3);
+
+	if (pset->has_normals()) {
+		const std::vector<vec3>& normals = pset->normals();
+		if (order) {
+			for (std::size_t i = 0; i < n; ++i)
+				ordered[i] = normals[order[i]];
+			upload(GL_ARRAY_BUFFER, b.normal_vbo, &ordered[0].x, n * 3);
+		}
+		else
+			upload(GL_ARRAY_BUFFER, b.normal_vbo, &normals[0].x, n * 3);
+	}
+	else if (b.normal_vbo) {
+		glDeleteBuffers(1, &b.normal_vbo);
+		b.normal_vbo = 0;
+	}
+	std::vector<vec3>().swap(ordered);
+
+	if (pset->has_colors()) {
+		// as bytes (a third of the memory of the floats)
+		const std::vector<vec3>& colors = pset->colors();
+		std::vector<unsigned char> bytes(n * 4, 255);
+		for (std::size_t i = 0; i < n; ++i) {
+			const vec3& c = colors[order ? order[i] : i];
+			for (int k = 0; k < 3; ++k)
+				bytes[i * 4 + k] = to_byte(c[k]);
+		}
+		upload(GL_ARRAY_BUFFER, b.color_vbo, &bytes[0], bytes.size());
+	}
+	else if (b.color_vbo) {
+		glDeleteBuffers(1, &b.color_vbo);
+		b.color_vbo = 0;
+	}
+
+	// the position of each point in the buffers
+	std::vector<unsigned int> position;
+	if (order && num_grouped > 0) {
+		position.resize(n);
+		for (std::size_t i = 0; i < n; ++i)
+			position[order[i]] = static_cast<unsigned int>(i);
+	}
+
+	std::vector<unsigned int> indices;
+	indices.reserve(num_grouped);
+	b.group_offsets.assign(1, 0);
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		const VertexGroup* g = groups[i];
+		if (order) {
+			for (std::size_t j = 0; j < g->size(); ++j)
+				indices.push_back(position[g->at(j)]);
+		}
+		else
+			indices.insert(indices.end(), g->begin(), g->end());
+		b.group_offsets.push_back(indices.size());
+	}
+	if (!indices.empty())
+		upload(GL_ELEMENT_ARRAY_BUFFER, b.group_ibo, &indices[0], indices.size());
+	else if (b.group_ibo) {
+		glDeleteBuffers(1, &b.group_ibo);
+		b.group_ibo = 0;
+	}
+
+	b.state = state;
+	b.octree = tree;
+	return &b;
+}
+
+
+void PointSetRender::release_buffers() {
+	GLuint ids[4] = { buffers_.point_vbo, buffers_.normal_vbo, buffers_.color_vbo, buffers_.group_ibo };
+	for (int i = 0; i < 4; ++i) {
+		if (ids[i] != 0)
+			glDeleteBuffers(1, &ids[i]);
+	}
+	buffers_ = PointBuffers();
+}
+
+
+const PointOctree* PointSetRender::octree(PointSet* pset) {
+	PointSetState state(pset);
+
+	// takes the octree that is ready
+	if (octree_future_.valid() && octree_future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		PointOctree* tree = octree_future_.get();
+		if (tree) {
+			delete octree_;
+			octree_ = tree;
+			octree_state_ = octree_future_state_;
+		}
+	}
+
+	if (pset->num_points() <= point_budget_) 
+		return nil;
+	if (octree_ && octree_state_ == state)
+		return octree_;
+
+	if (!octree_future_.valid()) {
+		Logger::out("-") << "building the level of detail of the points in the background..." << std::endl;
+		octree_future_state_ = state;
+		octree_cancel_ = false;
+		octree_future_ = std::async(std::launch::async, build_octree, pset->points(), &octree_cancel_);
+	}
+	else if (!(octree_future_state_ == state))
+		octree_cancel_ = true;	// outdated, and restarted when it stops
+	return nil;
+}
+
+
+void PointSetRender::draw_points(const PointBuffers& b) {
+	if (!b.octree) {
+		glDrawArrays(GL_POINTS, 0, GLsizei(b.state.num_points));
+		return;
+	}
+
+	float modelview[16], projection[16], mvp[16];
+	GLint viewport[4];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	for (int c = 0; c < 4; ++c) {
+		for (int r = 0; r < 4; ++r) {
+			float v = 0.0f;
+			for (int k = 0; k < 4; ++k)
+				v += projection[k * 4 + r] * modelview[c * 4 + k];
+			mvp[c * 4 + r] = v;
+		}
+	}
+
+	std::size_t budget = interacting_ ? interactive_point_budget_ : point_budget_;
+	std::vector< std::pair<unsigned int, unsigned int> > ranges;
+	b.octree->select(mvp, projection, viewport[3], point_set_style_.size, budget, ranges);
+	if (ranges.empty())
+		return;
+
+	std::vector<GLint> first(ranges.size());
+	std::vector<GLsizei> count(ranges.size());
+	for (std::size_t i = 0; i < ranges.size(); ++i) {
+		first[i] = GLint(ranges[i].first);
+		count[i] = GLsizei(ranges[i].second - ranges[i].first);
+	}
+	glMultiDrawArrays(GL_POINTS, &first[0], &count[0], GLsizei(ranges.size()));
 }
 
+
 const PointStyle& PointSetRender::point_set_style() const {
 	return point_set_style_;
 }
@@ -67,7 +319,8 @@ void PointSetRender::set_per_point_color(bool x) {
 }
 
 
-void PointSetRender::draw(PointSet*	pset) {
+void PointSetRender::draw(PointSet*	pset, bool interacting) {
+	interacting_ = interacting;
 	glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_FALSE);
 	glDisable(GL_MULTISAMPLE);
 
@@ -78,14 +331,80 @@ void PointSetRender::draw(PointSet*	pset) {
 			draw_point_set_uniform_color(pset);
 	}
 
-	if (vertex_group_style_.visible)
+	if (vertex_group_style_.visible) {
 		draw_vertex_groups(pset);
+		draw_footprints(pset);
+	}
 
 	glEnable(GL_MULTISAMPLE);
 	glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
 }
 
 
+void PointSetRender::draw_loading_points(const vec3* points, std::size_t num, std::size_t total) {
+	if (!points || num == 0 || !point_set_style_.visible)
+		return;
+
+	if (points != loading_.points || total != loading_.total || num < loading_.num_read) {
+		release_loading_points();
+		loading_.points = points;
+		loading_.total = total;
+		loading_.stride = std::max<std::size_t>(1, (total + point_budget_ - 1) / std::max<std::size_t>(1, point_budget_));
+	}
+	
+	const std::size_t stride = loading_.stride;
+	glPointSize(point_set_style_.size);
+	glColor3fv(point_set_style_.color.data());
+	glDisable(GL_LIGHTING);	// the normals may not be read yet
+	if (!GLEW_VERSION_1_5) {
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, GLsizei(stride * sizeof(vec3)), points);
+		glDrawArrays(GL_POINTS, 0, GLsizei((num + stride - 1) / stride));
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glEnable(GL_LIGHTING);
+		return;
+	}
+
+	if (loading_.vbo == 0) {
+		glGenBuffers(1, &loading_.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, loading_.vbo);
+		glBufferData(GL_ARRAY_BUFFER, ((total + stride - 1) / stride) * sizeof(vec3), nil, GL_STATIC_DRAW);
+	}
+	else
+		glBindBuffer(GL_ARRAY_BUFFER, loading_.vbo);
+
+	// the points read since the last call
+	if (num > loading_.num_read) {
+		std::vector<vec3> kept;
+		kept.reserve((num - loading_.num_read) / stride + 1);
+		std::size_t i = loading_.num_read;
+		if (i % stride != 0)
+			i += stride - i % stride;
+		for (; i < num; i += stride)
+			kept.push_back(points[i]);
+		loading_.num_read = num;
+		if (!kept.empty()) {
+			glBufferSubData(GL_ARRAY_BUFFER, loading_.num_uploaded * sizeof(vec3), kept.size() * sizeof(vec3), kept.data());
+			loading_.num_uploaded += kept.size();
+		}
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, nil);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDrawArrays(GL_POINTS, 0, GLsizei(loading_.num_uploaded));
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glEnable(GL_LIGHTING);
+}
+
+
+void PointSetRender::release_loading_points() {
+	if (loading_.vbo != 0)
+		glDeleteBuffers(1, &loading_.vbo);
+	loading_ = LoadingBuffer();
+}
+
+
 void PointSetRender::draw_point_set_per_point_color(PointSet* pset) {
 	if (!pset)
 		return;
@@ -97,11 +416,23 @@ void PointSetRender::draw_point_set_per_point_color(PointSet* pset) {
 	if (num < 1)
 		return;
 
+	glPointSize(point_set_style_.size);
+
+	if (PointBuffers* b = buffers(pset)) {
+		if (pset->has_normals())
+			glEnable(GL_LIGHTING);
+		else
+			glDisable(GL_LIGHTING); // always off for points without normals
+		enable_arrays(b->point_vbo, b->normal_vbo, b->color_vbo);
+		draw_points(*b);
+		disable_arrays();
+		glEnable(GL_LIGHTING);
+		return;
+	}
+
 	float* points = &(pset->points()[0].x);
 	float* colors = &(pset->colors()[0].x);
 
-	glPointSize(point_set_style_.size);
-
 	if (pset->has_normals()) {
 		float* normals = &(pset->normals()[0].x);
 		glEnable(GL_LIGHTING);
@@ -140,10 +471,22 @@ void PointSetRender::draw_point_set_uniform_color(PointSet* pset) {
 	if (num < 1)
 		return;
 
-	float* points = &(pset->points()[0].x);
-
 	glPointSize(point_set_style_.size);
 	glColor3fv(point_set_style_.color.data());
+
+	if (PointBuffers* b = buffers(pset)) {
+		if (pset->has_normals())
+			glEnable(GL_LIGHTING);
+		else
+			glDisable(GL_LIGHTING); // always off for points without normals
+		enable_arrays(b->point_vbo, b->normal_vbo, 0);
+		draw_points(*b);
+		disable_arrays();
+		glEnable(GL_LIGHTING);
+		return;
+	}
+
+	float* points = &(pset->points()[0].x);
 	if (pset->has_normals()) {
 		float* normals = &(pset->normals()[0].x);
 		glEnable(GL_LIGHTING);
@@ -167,6 +510,28 @@ void PointSetRender::draw_point_set_uniform_color(PointSet* pset) {
 	}
 }
 
+void PointSetRender::draw_footprints(PointSet* pset) {
+	if (!pset)
+		return;
+
+	glDisable(GL_LIGHTING);
+	glColor3f(0.0f, 1.0f, 1.0f);
+	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		const VertexGroup* g = groups[i];
+		if (!g->is_visible() || !g->is_highlighted() || !g->has_footprint())
+			continue;
+
+		const std::vector<vec2>& hull = g->footprint().hull;
+		glBegin(GL_LINE_LOOP);
+		for (std::size_t j = 0; j < hull.size(); ++j)
+			glVertex3fv(g->plane().to_3d(hull[j]).data());
+		glEnd();
+	}
+	glEnable(GL_LIGHTING);
+}
+
+
 void PointSetRender::draw_vertex_groups(PointSet* pset) {
 	if (!pset)
 		return;
@@ -175,12 +540,40 @@ void PointSetRender::draw_vertex_groups(PointSet* pset) {
 	if (num < 1)
 		return;
 
+	glPointSize(vertex_group_style_.size);
+
+	PointBuffers* b = buffers(pset);
+	if (b && b->group_ibo) {
+		bool lighting = pset->has_normals();
+		if (lighting)
+			glEnable(GL_LIGHTING);
+		else
+			glDisable(GL_LIGHTING); // always off for points without normals
+
+		enable_arrays(b->point_vbo, lighting ? b->normal_vbo : 0, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, b->group_ibo);
+		const std::vector<VertexGroup::Ptr>& groups = pset->groups();
+		for (std::size_t i = 0; i < groups.size(); ++i) {
+			const VertexGroup* g = groups[i];
+			std::size_t count = b->group_offsets[i + 1] - b->group_offsets[i];
+			if (!g->is_visible() || count == 0)
+				continue;
+
+			if (g->is_highlighted())
+				glColor3f(0.0f, 1.0f, 1.0f);
+			else
+				glColor3fv(g->color().data());
+			const std::size_t offset = b->group_offsets[i] * sizeof(unsigned int);
+			glDrawElements(GL_POINTS, GLsizei(count), GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset));
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		disable_arrays();
+		return;
+	}
+
 	const std::vector<vec3>& points = pset->points();
 	const std::vector<vec3>& normals = pset->normals();
-	const std::vector<vec3>& colors = pset->colors();
 	const std::vector<VertexGroup::Ptr>& groups = pset->groups();
-
-	glPointSize(vertex_group_style_.size);
 	if (pset->has_normals()) {
 		glEnable(GL_LIGHTING);
 
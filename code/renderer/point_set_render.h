@@ -24,16 +24,22 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "renderer_common.h"
 #include "rendering_styles.h"
+#include "../math/math_types.h"
+
+#include <vector>
+#include <atomic>
+#include <future>
 
 
 class Canvas;
 class PointSet;
+class PointOctree;
 
 class RENDERER_API PointSetRender
 {
 public:
 	PointSetRender(Canvas* cvs);
-	~PointSetRender(void);
+	virtual ~PointSetRender(void);
 
 	bool per_point_color() const { return per_point_color_; }
 	void set_per_point_color(bool x);
@@ -44,7 +50,23 @@ public:
 	const PointStyle& vertex_group_style() const;
 	void set_vertex_group_style(const PointStyle& x);
 
-	virtual void draw(PointSet*	pset);
+	// Point sets with more points than the budget are drawn with a level of detail (an octree
+	// built in the background): the visible parts are drawn, as dense as the budget allows.
+	// A smaller budget is used 'interacting' (while the camera is manipulated).
+	std::size_t point_budget() const { return point_budget_; }
+	void set_point_budget(std::size_t n) { point_budget_ = n; }
+	std::size_t interactive_point_budget() const { return interactive_point_budget_; }
+	void set_interactive_point_budget(std::size_t n) { interactive_point_budget_ = n; }
+
+	virtual void draw(PointSet*	pset, bool interacting = false);
+
+	// Draws the first 'num' of the 'total' points of a point set being read (see PointSetIO::read()), 
+	// e.g., in the background. The points are appended to a vertex buffer sized for all of them, so
+	// each call only uploads the points read since the last one. Beyond the point budget, only every
+	// k-th point is kept. 'points' must be valid during the call, and the points of another read 
+	// (i.e., at another address) start a new buffer. release_loading_points() frees the buffer.
+	void draw_loading_points(const vec3* points, std::size_t num, std::size_t total);
+	void release_loading_points();
 
 protected:
 	// whole point set
@@ -53,6 +75,51 @@ protected:
 
 	// segments (vertex groups)
 	virtual void draw_vertex_groups(PointSet* pset);
+	// the convex hulls of the footprints of the highlighted segments (if computed, see VertexGroup::Footprint)
+	virtual void draw_footprints(PointSet* pset);
+
+	// the state of a point set the data derived from it was built from
+	struct PointSetState {
+		PointSetState() : pset_id(0), pset_version(0), num_points(0), points_data(nil) {}
+		explicit PointSetState(const PointSet* pset);
+		bool operator==(const PointSetState& s) const {
+			return pset_id == s.pset_id && pset_version == s.pset_version && num_points == s.num_points && points_data == s.points_data;
+		}
+		unsigned int	pset_id;
+		unsigned int	pset_version;
+		std::size_t		num_points;
+		const void*		points_data;
+	};
+
+	// The GPU copies of a point set: the positions, the normals, the colors (as bytes), and the
+	// indices of the points of all the groups (one range per group). They are uploaded once, 
+	// and only again when the point set changes (see PointSet::version()), so switching between
+	// the coloring modes or showing/highlighting groups costs nothing. With a level of detail,
+	// the points are in the order of the octree.
+	struct PointBuffers {
+		PointBuffers() : octree(nil), point_vbo(0), normal_vbo(0), color_vbo(0), group_ibo(0) {}
+		PointSetState		state;
+		const PointOctree*	octree;
+
+		unsigned int	point_vbo;
+		unsigned int	normal_vbo;
+		unsigned int	color_vbo;
+		unsigned int	group_ibo;
+		// the range of group i in the index buffer is [group_offsets[i], group_offsets[i + 1])
+		std::vector<std::size_t>	group_offsets;
+	};
+
+	// the buffers of 'pset', updated if needed. It returns nil if vertex buffers are not 
+	// supported (then the client-side arrays and the immediate mode are used).
+	PointBuffers* buffers(PointSet* pset);
+	void release_buffers();
+
+	// the octree of 'pset' if its level of detail is used and ready, nil otherwise (its
+	// construction is started if needed)
+	const PointOctree* octree(PointSet* pset);
+
+	// draws the points of the buffers (the visible ones within the budget, with an octree)
+	void draw_points(const PointBuffers& b);
 
 protected:
 	Canvas*			canvas_;
@@ -61,6 +128,30 @@ protected:
 	PointStyle		vertex_group_style_;
 
 	bool			per_point_color_;
+
+	PointBuffers	buffers_;
+
+	std::size_t		point_budget_;
+	std::size_t		interactive_point_budget_;
+	bool			interacting_;
+
+	// the points of the point set being read
+	struct LoadingBuffer {
+		LoadingBuffer() : points(nil), total(0), stride(1), num_read(0), num_uploaded(0), vbo(0) {}
+		const vec3*		points;
+		std::size_t		total;
+		std::size_t		stride;
+		std::size_t		num_read;		// the points already appended (or skipped by the stride)
+		std::size_t		num_uploaded;	// the points in the buffer
+		unsigned int	vbo;
+	};
+	LoadingBuffer	loading_;
+
+	PointOctree*				octree_;		// the last octree built
+	PointSetState				octree_state_;
+	std::future<PointOctree*>	octree_future_;	// the octree being built
+	PointSetState				octree_future_state_;
+	std::atomic<bool>			octree_cancel_;
 };
 
 
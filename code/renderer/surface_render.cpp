@@ -24,6 +24,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 // these two are here for cylinders
 #include "../model/map_geometry.h" 
 #include "../math/quaternion.h"
+#include "../math/polygon2d.h"
+
+#include <map>
+
+#include <cstddef>	// for offsetof
 
 /* this is how we can safely include GLU */
 #ifdef _WIN32
@@ -37,8 +42,56 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 static GLUquadric* g_quadric = 0;
 
+
+namespace {
+
+	// a corner of a triangle of the surface buffer
+	struct SurfaceVertex {
+		float point[3];
+		float normal[3];
+		float color[4];
+	};
+
+	// the number of meshes whose buffers are kept
+	const std::size_t max_buffered_meshes = 4;
+
+	// the meshes with fewer facets are fluid enough without a proxy
+	const int min_proxy_facets = 20000;
+
+	template <class T>
+	void upload(GLenum target, unsigned int& buffer, const std::vector<T>& data) {
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		glBufferData(target, data.size() * sizeof(T), data.empty() ? nil : &data[0], GL_STATIC_DRAW);
+		glBindBuffer(target, 0);
+	}
+
+	void draw_triangles(unsigned int vbo, unsigned int num_vertices, bool colored) {
+		const GLsizei stride = sizeof(SurfaceVertex);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, stride, (const GLvoid*)offsetof(SurfaceVertex, point));
+		glNormalPointer(GL_FLOAT, stride, (const GLvoid*)offsetof(SurfaceVertex, normal));
+		if (colored) {
+			glEnableClientState(GL_COLOR_ARRAY);
+			glColorPointer(4, GL_FLOAT, stride, (const GLvoid*)offsetof(SurfaceVertex, color));
+		}
+		glDrawArrays(GL_TRIANGLES, 0, num_vertices);
+		if (colored)
+			glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+
 SurfaceRender::SurfaceRender(Canvas* cvs) 
 	: canvas_(cvs)
+	, num_draws_(0)
+	, ramp_texture_(0)
 {
 	per_face_color_ = true;
 
@@ -59,12 +112,32 @@ SurfaceRender::SurfaceRender(Canvas* cvs)
 
 
 SurfaceRender::~SurfaceRender() {
+	for (std::size_t i = 0; i < buffers_.size(); ++i)
+		release_buffers(buffers_[i]);
+
+	if (ramp_texture_)
+		glDeleteTextures(1, &ramp_texture_);
+	if (id_buffer_.fbo) {
+		glDeleteFramebuffers(1, &id_buffer_.fbo);
+		glDeleteRenderbuffers(1, &id_buffer_.color_rbo);
+		glDeleteRenderbuffers(1, &id_buffer_.depth_rbo);
+	}
+
 	if (g_quadric)
 		gluDeleteQuadric(g_quadric);
 }
 
 
 void SurfaceRender::draw(Map* mesh, bool interacting) {
+	++num_draws_;
+
+	// the full mesh is drawn again once the camera stops
+	MeshBuffers* b = interacting ? buffers(mesh) : nil;
+	if (b && b->num_proxy_vertices > 0) {
+		draw_proxy(*b);
+		return;
+	}
+
 	if (surface_style_.visible) {
 		if (mesh_style_.visible) {
 			glEnable(GL_POLYGON_OFFSET_FILL);
@@ -108,10 +181,385 @@ void SurfaceRender::set_sharp_edge_style(const EdgeStyle& x) {
 	sharp_edge_style_ = x;
 }
 
-void SurfaceRender::draw_surface(Map* mesh) {
-	if (per_face_color_)
-		facet_color_.bind_if_defined(mesh, "color");
+SurfaceRender::MeshBuffers* SurfaceRender::buffers(Map* mesh) {
+	if (!GLEW_VERSION_1_5)
+		return nil;
+
+	MeshBuffers* b = nil;
+	for (std::size_t i = 0; i < buffers_.size() && !b; ++i) {
+		if (buffers_[i].mesh_id == mesh->id())
+			b = &buffers_[i];
+	}
+	if (!b) {
+		if (buffers_.size() < max_buffered_meshes) {
+			buffers_.push_back(MeshBuffers());
+			b = &buffers_.back();
+		}
+		else {
+			b = &buffers_[0];
+			for (std::size_t i = 1; i < buffers_.size(); ++i) {
+				if (buffers_[i].last_use < b->last_use)
+					b = &buffers_[i];
+			}
+		}
+	}
+
+	bool colored = per_face_color_ && MapFacetAttribute<Color>::is_defined(mesh, "color");
+	if (b->surface_vbo == 0 || b->mesh_id != mesh->id() || b->mesh_version != mesh->version() || b->colored != colored) {
+		b->colored = colored;
+		build_buffers(mesh, *b);
+		b->mesh_id = mesh->id();
+		b->mesh_version = mesh->version();
+	}
+	b->last_use = num_draws_;
+	return b;
+}
+
+
+void SurfaceRender::build_buffers(Map* mesh, MeshBuffers& b) {
+	if (!MapFacetNormal::is_defined(mesh))
+		mesh->compute_facet_normals();
+	MapFacetNormal normal(mesh);
+	if (b.colored)
+		facet_color_.bind(mesh, "color");
+
+	// the facets (convex, like the polygons of the immediate mode) are triangulated as fans
+	std::vector<SurfaceVertex> corners;
+	corners.reserve(std::size_t(mesh->size_of_halfedges()) * 3 / 2);
+	std::vector<unsigned char> facet_ids;
+	facet_ids.reserve(corners.capacity() * 4);
+	b.facets.clear();
+	b.facets.reserve(mesh->size_of_facets());
+	FOR_EACH_FACET(Map, mesh, it) {
+		b.facets.push_back(it);
+		unsigned int id = static_cast<unsigned int>(b.facets.size());
+		const unsigned char id_color[4] = { 
+			static_cast<unsigned char>(id & 0xff), static_cast<unsigned char>((id >> 8) & 0xff), static_cast<unsigned char>((id >> 16) & 0xff), 255 
+		};
+
+		SurfaceVertex v;
+		const vec3& n = normal[it];
+		v.normal[0] = n.x;	v.normal[1] = n.y;	v.normal[2] = n.z;
+		const Color& c = b.colored ? facet_color_[it] : surface_style_.color;
+		for (int k = 0; k < 4; ++k)
+			v.color[k] = c[k];
+
+		Map::Halfedge* first = it->halfedge();
+		for (Map::Halfedge* h = first->next(); h->next() != first; h = h->next()) {
+			const Map::Vertex* fan[3] = { first->vertex(), h->vertex(), h->next()->vertex() };
+			for (int k = 0; k < 3; ++k) {
+				const vec3& p = fan[k]->point();
+				v.point[0] = p.x;	v.point[1] = p.y;	v.point[2] = p.z;
+				corners.push_back(v);
+				facet_ids.insert(facet_ids.end(), id_color, id_color + 4);
+			}
+		}
+	}
+
+	if (facet_color_.is_bound())
+		facet_color_.unbind();
+
+	// the vertices, and the end points of the edges
+	MapVertexAttribute<unsigned int> index(mesh);
+	b.points.clear();
+	b.points.reserve(mesh->size_of_vertices());
+	FOR_EACH_VERTEX_CONST(Map, mesh, it) {
+		index[it] = static_cast<unsigned int>(b.points.size());
+		b.points.push_back(it->point());
+	}
+
+	MapHalfedgeAttribute<bool> edge_is_sharp;
+	bool has_sharp = edge_is_sharp.bind_if_defined(mesh, "SharpEdge");
+	std::vector<unsigned int> edges;
+	edges.reserve(mesh->size_of_halfedges());
+	b.sharp_edges.clear();
+	FOR_EACH_EDGE_CONST(Map, mesh, it) {
+		unsigned int s = index[it->opposite()->vertex()];
+		unsigned int t = index[it->vertex()];
+		edges.push_back(t);
+		edges.push_back(s);
+		if ((has_sharp && edge_is_sharp[it]) || it->is_border_edge()) {
+			b.sharp_edges.push_back(t);
+			b.sharp_edges.push_back(s);
+		}
+	}
+
+	upload(GL_ARRAY_BUFFER, b.surface_vbo, corners);
+	upload(GL_ARRAY_BUFFER, b.facet_id_vbo, facet_ids);
+	b.scalar_name.clear();	// uploaded again when needed
+	upload(GL_ARRAY_BUFFER, b.vertex_vbo, b.points);
+	upload(GL_ELEMENT_ARRAY_BUFFER, b.edge_ibo, edges);
+	upload(GL_ELEMENT_ARRAY_BUFFER, b.sharp_edge_ibo, b.sharp_edges);
+	b.num_surface_vertices = static_cast<unsigned int>(corners.size());
+	b.num_edge_indices = static_cast<unsigned int>(edges.size());
+
+	build_proxy(mesh, b);
+}
+
+
+void SurfaceRender::build_proxy(Map* mesh, MeshBuffers& b) {
+	b.num_proxy_vertices = 0;
+	b.num_proxy_edge_vertices = 0;
+	if (mesh->size_of_facets() < min_proxy_facets || !MapFacetAttribute<Plane3d*>::is_defined(mesh, "FacetSupportingPlane"))
+		return;
+
+	MapFacetAttribute<Plane3d*> supporting_plane(mesh, "FacetSupportingPlane");
+	MapFacetNormal normal(mesh);
+	if (b.colored)
+		facet_color_.bind(mesh, "color");
+
+	// the vertices of the facets of each plane (in the plane), and the look of its first facet
+	struct PlaneFacets {
+		Polygon2d		points;
+		vec3			normal;
+		Color			color;
+	};
+	std::map<const Plane3d*, std::size_t> plane_index;
+	std::vector<const Plane3d*> planes;
+	std::vector<PlaneFacets> facets;
+	MapVertexAttribute<int> last_plane(mesh);	// 1 + the last plane of a vertex, to add it once per plane
+	FOR_EACH_FACET_CONST(Map, mesh, it) {
+		const Plane3d* plane = supporting_plane[it];
+		if (!plane)
+			continue;
+		std::map<const Plane3d*, std::size_t>::iterator pos = plane_index.find(plane);
+		if (pos == plane_index.end()) {
+			pos = plane_index.insert(std::make_pair(plane, facets.size())).first;
+			planes.push_back(plane);
+			facets.push_back(PlaneFacets());
+			facets.back().normal = normal[it];
+			facets.back().color = b.colored ? facet_color_[it] : surface_style_.color;
+		}
+		int index = static_cast<int>(pos->second);
+		Map::Halfedge* h = it->halfedge();
+		do {
+			Map::Vertex* v = h->vertex();
+			if (last_plane[v] != index + 1) {
+				last_plane[v] = index + 1;
+				facets[index].points.push_back(plane->to_2d(v->point()));
+			}
+			h = h->next();
+		} while (h != it->halfedge());
+	}
+
+	if (facet_color_.is_bound())
+		facet_color_.unbind();
+
+	std::vector<SurfaceVertex> corners;
+	std::vector<vec3> outlines;
+	Polygon2d hull;
+	for (std::size_t i = 0; i < facets.size(); ++i) {
+		if (facets[i].points.size() < 3)
+			continue;
+		Geom::convex_hull(facets[i].points, hull);
+		if (hull.size() < 3)
+			continue;
+
+		SurfaceVertex v;
+		const vec3& n = facets[i].normal;
+		v.normal[0] = n.x;	v.normal[1] = n.y;	v.normal[2] = n.z;
+		for (int k = 0; k < 4; ++k)
+			v.color[k] = facets[i].color[k];
+		for (std::size_t j = 0; j < hull.size(); ++j) {
+			outlines.push_back(planes[i]->to_3d(hull[j]));
+			outlines.push_back(planes[i]->to_3d(hull[(j + 1) % hull.size()]));
+			if (j < 2)
+				continue;
+			const vec2* fan[3] = { &hull[0], &hull[j - 1], &hull[j] };
+			for (int k = 0; k < 3; ++k) {
+				const vec3 p = planes[i]->to_3d(*fan[k]);
+				v.point[0] = p.x;	v.point[1] = p.y;	v.point[2] = p.z;
+				corners.push_back(v);
+			}
+		}
+	}
 
+	upload(GL_ARRAY_BUFFER, b.proxy_vbo, corners);
+	upload(GL_ARRAY_BUFFER, b.proxy_edge_vbo, outlines);
+	b.num_proxy_vertices = static_cast<unsigned int>(corners.size());
+	b.num_proxy_edge_vertices = static_cast<unsigned int>(outlines.size());
+}
+
+
+bool SurfaceRender::update_scalar(Map* mesh, MeshBuffers& b) {
+	if (!MapFacetAttribute<double>::is_defined(mesh, facet_scalar_))
+		return false;
+	if (b.scalar_vbo != 0 && b.scalar_name == facet_scalar_ && b.scalar_version == mesh->version())
+		return true;
+
+	MapFacetAttribute<double> scalar(mesh, facet_scalar_);
+	std::vector<float> values;
+	values.reserve(b.num_surface_vertices);
+	b.scalar_min = Numeric::big_double;
+	b.scalar_max = -Numeric::big_double;
+	for (std::size_t i = 0; i < b.facets.size(); ++i) {
+		Map::Facet* f = b.facets[i];
+		double value = scalar[f];
+		b.scalar_min = ogf_min(b.scalar_min, value);
+		b.scalar_max = ogf_max(b.scalar_max, value);
+		// the corners of the fan of the facet (see build_buffers())
+		std::size_t num = 3 * (f->degree() - 2);
+		values.insert(values.end(), num, static_cast<float>(value));
+	}
+	upload(GL_ARRAY_BUFFER, b.scalar_vbo, values);
+	b.scalar_name = facet_scalar_;
+	b.scalar_version = mesh->version();
+	return true;
+}
+
+
+unsigned int SurfaceRender::ramp_texture() {
+	if (ramp_texture_)
+		return ramp_texture_;
+
+	// blue, cyan, green, yellow, red
+	const float stops[5][3] = { { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } };
+	const int size = 256;
+	std::vector<unsigned char> texels(size * 3);
+	for (int i = 0; i < size; ++i) {
+		float t = 4.0f * i / (size - 1);
+		int k = ogf_min(3, int(t));
+		float w = t - k;
+		for (int c = 0; c < 3; ++c)
+			texels[i * 3 + c] = static_cast<unsigned char>(255.0f * ((1.0f - w) * stops[k][c] + w * stops[k + 1][c]) + 0.5f);
+	}
+
+	glGenTextures(1, &ramp_texture_);
+	glBindTexture(GL_TEXTURE_1D, ramp_texture_);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, size, 0, GL_RGB, GL_UNSIGNED_BYTE, &texels[0]);
+	glBindTexture(GL_TEXTURE_1D, 0);
+	return ramp_texture_;
+}
+
+
+Map::Facet* SurfaceRender::pick_facet(Map* mesh, int x, int y) {
+	if (!GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object)
+		return nil;
+	MeshBuffers* b = buffers(mesh);
+	if (!b)
+		return nil;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	int width = viewport[0] + viewport[2];
+	int height = viewport[1] + viewport[3];
+	if (x < viewport[0] || y < viewport[1] || x >= width || y >= height)
+		return nil;
+
+	float view[32];
+	glGetFloatv(GL_MODELVIEW_MATRIX, view);
+	glGetFloatv(GL_PROJECTION_MATRIX, view + 16);
+
+	GLint previous_fbo = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_fbo);
+
+	IdBuffer& ib = id_buffer_;
+	bool outdated = (ib.mesh_id != mesh->id() || ib.mesh_version != mesh->version() || !std::equal(view, view + 32, ib.view));
+	if (ib.fbo == 0 || ib.width != width || ib.height != height) {
+		if (ib.fbo == 0) {
+			glGenFramebuffers(1, &ib.fbo);
+			glGenRenderbuffers(1, &ib.color_rbo);
+			glGenRenderbuffers(1, &ib.depth_rbo);
+		}
+		glBindRenderbuffer(GL_RENDERBUFFER, ib.color_rbo);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, ib.depth_rbo);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, ib.fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ib.color_rbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, ib.depth_rbo);
+		ib.width = width;
+		ib.height = height;
+		outdated = true;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, ib.fbo);
+
+	if (outdated) {
+		glPushAttrib(GL_ALL_ATTRIB_BITS);
+		glDisable(GL_LIGHTING);
+		glDisable(GL_BLEND);
+		glDisable(GL_DITHER);
+		glDisable(GL_MULTISAMPLE);
+		glDisable(GL_TEXTURE_1D);
+		glDisable(GL_TEXTURE_2D);
+		glEnable(GL_DEPTH_TEST);
+		glShadeModel(GL_FLAT);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);		// no facet
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		glBindBuffer(GL_ARRAY_BUFFER, b->surface_vbo);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(SurfaceVertex), (const GLvoid*)offsetof(SurfaceVertex, point));
+		glBindBuffer(GL_ARRAY_BUFFER, b->facet_id_vbo);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, nil);
+		glDrawArrays(GL_TRIANGLES, 0, b->num_surface_vertices);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glPopAttrib();
+
+		std::copy(view, view + 32, ib.view);
+		ib.mesh_id = mesh->id();
+		ib.mesh_version = mesh->version();
+	}
+
+	unsigned char pixel[4] = { 0, 0, 0, 0 };
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	glBindFramebuffer(GL_FRAMEBUFFER, previous_fbo);
+
+	unsigned int id = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+	if (id == 0 || id > b->facets.size())
+		return nil;
+	return b->facets[id - 1];
+}
+
+
+void SurfaceRender::draw_proxy(const MeshBuffers& b) {
+	if (surface_style_.visible) {
+		glEnable(GL_LIGHTING);
+		glColor4fv(surface_style_.color.data());
+		glShadeModel(GL_FLAT);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(0.5f, -0.0001f);
+		draw_triangles(b.proxy_vbo, b.num_proxy_vertices, b.colored);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+
+	// the outlines of the planes replace the edges
+	if (mesh_style_.visible || sharp_edge_style_.visible) {
+		glDisable(GL_LIGHTING);
+		glColor4fv(sharp_edge_style_.color.data());
+		glLineWidth(sharp_edge_style_.width + 1.0f);
+		glBindBuffer(GL_ARRAY_BUFFER, b.proxy_edge_vbo);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, nil);
+		glDrawArrays(GL_LINES, 0, b.num_proxy_edge_vertices);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+
+void SurfaceRender::release_buffers(MeshBuffers& b) {
+	unsigned int ids[8] = { b.surface_vbo, b.vertex_vbo, b.edge_ibo, b.sharp_edge_ibo, b.proxy_vbo, b.proxy_edge_vbo, b.facet_id_vbo, b.scalar_vbo };
+	for (int i = 0; i < 8; ++i) {
+		if (ids[i] != 0)
+			glDeleteBuffers(1, &ids[i]);
+	}
+	b = MeshBuffers();
+}
+
+
+void SurfaceRender::draw_surface(Map* mesh) {
 	glEnable(GL_MULTISAMPLE);
 
 	glEnable(GL_LIGHTING);
@@ -120,6 +568,42 @@ void SurfaceRender::draw_surface(Map* mesh) {
 	glShadeModel(GL_FLAT);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+	if (MeshBuffers* b = buffers(mesh)) {
+		if (!facet_scalar_.empty() && update_scalar(mesh, *b)) {
+			// the texture coordinates are the values, mapped to [0, 1] by the texture matrix
+			glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+			glEnable(GL_TEXTURE_1D);
+			glBindTexture(GL_TEXTURE_1D, ramp_texture());
+			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+			glMatrixMode(GL_TEXTURE);
+			glPushMatrix();
+			glLoadIdentity();
+			double range = b->scalar_max - b->scalar_min;
+			glScaled(range > 0.0 ? 1.0 / range : 1.0, 1.0, 1.0);
+			glTranslated(-b->scalar_min, 0.0, 0.0);
+			glMatrixMode(GL_MODELVIEW);
+
+			glBindBuffer(GL_ARRAY_BUFFER, b->scalar_vbo);
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glTexCoordPointer(1, GL_FLOAT, 0, nil);
+			draw_triangles(b->surface_vbo, b->num_surface_vertices, false);
+			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+			glMatrixMode(GL_TEXTURE);
+			glPopMatrix();
+			glMatrixMode(GL_MODELVIEW);
+			glBindTexture(GL_TEXTURE_1D, 0);
+			glDisable(GL_TEXTURE_1D);
+		}
+		else
+			draw_triangles(b->surface_vbo, b->num_surface_vertices, b->colored);
+		return;
+	}
+
+	// the immediate mode (without vertex buffers)
+	if (per_face_color_)
+		facet_color_.bind_if_defined(mesh, "color");
+
 	if (!MapFacetNormal::is_defined(mesh))
 		mesh->compute_facet_normals();
 	MapFacetNormal normal(mesh);
@@ -152,6 +636,12 @@ void SurfaceRender::draw_mesh(Map* mesh) {
 
 	glDisable(GL_LIGHTING);
 	glLineWidth(mesh_style_.width);
+
+	if (MeshBuffers* b = buffers(mesh)) {
+		draw_edges(*b, b->edge_ibo, b->num_edge_indices);
+		return;
+	}
+
 	glBegin(GL_LINES);
 	FOR_EACH_EDGE_CONST(Map, mesh, it) {
 //		if (it->is_border_edge())
@@ -168,6 +658,40 @@ void SurfaceRender::draw_mesh(Map* mesh) {
 void SurfaceRender::draw_corner_edges(Map* mesh, bool interacting) {
 	glColor4fv(sharp_edge_style_.color.data());
 
+	MeshBuffers* b = buffers(mesh);
+	if (b && interacting) {
+		glDisable(GL_LIGHTING);
+		glLineWidth(sharp_edge_style_.width + 1.0f);
+		draw_edges(*b, b->sharp_edge_ibo, static_cast<unsigned int>(b->sharp_edges.size()));
+		return;
+	}
+	else if (b) {
+		// the cylinders are still drawn one by one, but only the sharp edges are visited
+		const vec3& c = mesh->bbox().center();
+		float ratio = canvas_->get_camera()->pixelGLRatio(c.x, c.y, c.z);
+		float r = (sharp_edge_style_.width + 1) * ratio;
+		int slices = 20;
+
+		glEnable(GL_LIGHTING);
+		glShadeModel(GL_SMOOTH);
+		for (std::size_t i = 0; i < b->sharp_edges.size(); i += 2) {
+			const vec3& t = b->points[b->sharp_edges[i]];
+			const vec3& s = b->points[b->sharp_edges[i + 1]];
+			glPushMatrix();
+			glTranslated(t.x, t.y, t.z);
+			gluSphere(g_quadric, r, slices, slices);
+			glPopMatrix();
+
+			glPushMatrix();
+			glTranslated(s.x, s.y, s.z);
+			gluSphere(g_quadric, r, slices, slices);
+			glMultMatrixd(Quaternion(vec3(0, 0, 1), t - s).matrix());
+			gluCylinder(g_quadric, r, r, length(t - s), slices, 1);
+			glPopMatrix();
+		}
+		return;
+	}
+
     MapHalfedgeAttribute<bool> edge_is_sharp(mesh, "SharpEdge");
 
 	if (interacting) {
@@ -219,6 +743,18 @@ void SurfaceRender::draw_corner_edges(Map* mesh, bool interacting) {
 }
 
 
+void SurfaceRender::draw_edges(const MeshBuffers& b, unsigned int ibo, unsigned int num_indices) {
+	glBindBuffer(GL_ARRAY_BUFFER, b.vertex_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, nil);
+	glDrawElements(GL_LINES, num_indices, GL_UNSIGNED_INT, nil);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
 void SurfaceRender::set_per_face_color(bool x) {
 	per_face_color_ = x;
 }
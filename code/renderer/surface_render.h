@@ -24,6 +24,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "rendering_styles.h"
 #include "../model/map_attributes.h"
 
+#include <vector>
+#include <string>
+#include <algorithm>
+
 
 class Map;
 class Canvas;
@@ -32,7 +36,7 @@ class RENDERER_API SurfaceRender
 {
 public:
 	SurfaceRender(Canvas* cvs) ;
-	~SurfaceRender();
+	virtual ~SurfaceRender();
 
 	virtual void draw(Map* mesh, bool interacting);
 
@@ -53,11 +57,95 @@ public:
 	const EdgeStyle& sharp_edge_style() const;
 	void set_sharp_edge_style(const EdgeStyle& x);
 
+	// The facets are colored by the facet attribute (of type double) with this name through a
+	// color ramp from its minimum (blue) to its maximum (red), instead of their colors. The
+	// empty name (the default) shows the colors. Only the values are uploaded on a change.
+	const std::string& facet_scalar() const { return facet_scalar_; }
+	void set_facet_scalar(const std::string& name) { facet_scalar_ = name; }
+
+	// The facet of 'mesh' drawn at the pixel (x, y) of the viewport (with the origin at the
+	// bottom left), nil if none. The facets are drawn with their indices as colors into an
+	// offscreen id buffer, which is drawn again only when the view or the mesh changes, so
+	// picking again (e.g., on hovering) only reads a pixel. It requires framebuffer objects.
+	Map::Facet* pick_facet(Map* mesh, int x, int y);
+
 protected:
 	virtual void draw_surface(Map* mesh);
 	virtual void draw_mesh(Map* mesh);
 	virtual void draw_corner_edges(Map* mesh, bool interacting);
 
+	// The retained-mode data of a mesh: its facets triangulated into an interleaved vertex 
+	// buffer (position, normal, and color), the positions of its vertices, and the index 
+	// buffers of its edges and its sharp edges. It is built once, and is only rebuilt when 
+	// the mesh changes (i.e., its id or its version, see Map::version()).
+	struct MeshBuffers {
+		MeshBuffers() : mesh_id(0), mesh_version(0), colored(false), last_use(0),
+			surface_vbo(0), vertex_vbo(0), edge_ibo(0), sharp_edge_ibo(0), num_surface_vertices(0), num_edge_indices(0),
+			proxy_vbo(0), proxy_edge_vbo(0), num_proxy_vertices(0), num_proxy_edge_vertices(0),
+			facet_id_vbo(0), scalar_version(0), scalar_vbo(0), scalar_min(0), scalar_max(0) {}
+		unsigned int	mesh_id;
+		unsigned int	mesh_version;
+		bool			colored;		// if the per-face colors are in the surface buffer
+		unsigned int	last_use;
+
+		unsigned int	surface_vbo;
+		unsigned int	vertex_vbo;
+		unsigned int	edge_ibo;
+		unsigned int	sharp_edge_ibo;
+		unsigned int	num_surface_vertices;
+		unsigned int	num_edge_indices;
+
+		std::vector<vec3>			points;			// the vertices of the mesh
+		std::vector<unsigned int>	sharp_edges;	// pairs of indices in 'points'
+
+		// The coarse proxy drawn while interacting with a large candidate mesh: the facets on
+		// the same supporting plane are merged into their convex hull (triangulated in
+		// 'proxy_vbo', and outlined by the segments in 'proxy_edge_vbo').
+		unsigned int	proxy_vbo;
+		unsigned int	proxy_edge_vbo;
+		unsigned int	num_proxy_vertices;
+		unsigned int	num_proxy_edge_vertices;
+
+		// the facets in the order of the surface buffer, and their indices (plus 1) as colors
+		std::vector<Map::Facet*>	facets;
+		unsigned int	facet_id_vbo;
+		// the values of the scalar shown, per corner of the surface buffer
+		std::string		scalar_name;
+		unsigned int	scalar_version;
+		unsigned int	scalar_vbo;
+		double			scalar_min;
+		double			scalar_max;
+	};
+
+	// the offscreen buffer of the facet indices, and the view and the mesh it was drawn for
+	struct IdBuffer {
+		IdBuffer() : fbo(0), color_rbo(0), depth_rbo(0), width(0), height(0), mesh_id(0), mesh_version(0) {
+			std::fill(view, view + 32, 0.0f);
+		}
+		unsigned int	fbo;
+		unsigned int	color_rbo;
+		unsigned int	depth_rbo;
+		int				width;
+		int				height;
+		float			view[32];	// the modelview and the projection matrices
+		unsigned int	mesh_id;
+		unsigned int	mesh_version;
+	};
+
+	// the buffers of 'mesh', updated if needed. It returns nil if vertex buffers are not 
+	// supported (then the immediate mode is used).
+	MeshBuffers* buffers(Map* mesh);
+	void build_buffers(Map* mesh, MeshBuffers& b);
+	// the proxy of 'mesh', if it has many facets with their supporting planes ("FacetSupportingPlane")
+	void build_proxy(Map* mesh, MeshBuffers& b);
+	void draw_proxy(const MeshBuffers& b);
+	// uploads the values of the facet scalar, if needed. It returns false if the mesh doesn't have it.
+	bool update_scalar(Map* mesh, MeshBuffers& b);
+	unsigned int ramp_texture();
+	void release_buffers(MeshBuffers& b);
+	// draws the edges given by the index buffer 'ibo' (of the vertex buffer of 'b')
+	void draw_edges(const MeshBuffers& b, unsigned int ibo, unsigned int num_indices);
+
 protected:
 	Canvas* canvas_;
 
@@ -68,6 +156,14 @@ protected:
 
 	EdgeStyle    mesh_style_;
 	EdgeStyle	 sharp_edge_style_;
+
+	// a few meshes are drawn (e.g., the candidate faces and the result), the least recently used is replaced
+	std::vector<MeshBuffers>	buffers_;
+	unsigned int				num_draws_;
+
+	std::string		facet_scalar_;
+	unsigned int	ramp_texture_;
+	IdBuffer		id_buffer_;
 } ;
 
 